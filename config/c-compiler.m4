@@ -752,3 +752,38 @@ if test x"$Ac_cachevar" = x"yes"; then
 fi
 undefine([Ac_cachevar])dnl
 ])# PGAC_AVX512_POPCNT_INTRINSICS
+
+# PGAC_AVX512_CRC32C_INTRINSICS
+# -----------------------------
+# Check if the compiler supports the AVX-512 carry-less multiplication
+# instructions used for CRC-32C, using the _mm512_clmulepi64_epi128,
+# _mm512_ternarylogic_epi64, _mm512_extracti32x4_epi32 and _mm_crc32_u64
+# intrinsic functions.
+#
+# Optional compiler flags can be passed as argument (e.g., -mavx512vl
+# -mvpclmulqdq -msse4.2).  If the intrinsics are supported, sets
+# pgac_avx512_crc32c_intrinsics and CFLAGS_CRC_AVX512.
+AC_DEFUN([PGAC_AVX512_CRC32C_INTRINSICS],
+[define([Ac_cachevar], [AS_TR_SH([pgac_cv_avx512_crc32c_intrinsics_$1])])dnl
+AC_CACHE_CHECK([for _mm512_clmulepi64_epi128 with CFLAGS=$1], [Ac_cachevar],
+[pgac_save_CFLAGS=$CFLAGS
+CFLAGS="$pgac_save_CFLAGS $1"
+AC_LINK_IFELSE([AC_LANG_PROGRAM([#include <immintrin.h>],
+  [const char buf@<:@sizeof(__m512i)@:>@;
+   __m512i x = _mm512_loadu_si512((const void *) buf);
+   __m512i k = _mm512_broadcast_i32x4(_mm_setr_epi32(1, 0, 2, 0));
+   __m128i z;
+   x = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0),
+                                 _mm512_clmulepi64_epi128(x, k, 17), x, 0x96);
+   z = _mm512_extracti32x4_epi32(x, 3);
+   /* return computed value, to prevent the above being optimized away */
+   return _mm_crc32_u64(0, _mm_extract_epi64(z, 0)) == 0;])],
+  [Ac_cachevar=yes],
+  [Ac_cachevar=no])
+CFLAGS="$pgac_save_CFLAGS"])
+if test x"$Ac_cachevar" = x"yes"; then
+  CFLAGS_CRC_AVX512="$1"
+  pgac_avx512_crc32c_intrinsics=yes
+fi
+undefine([Ac_cachevar])dnl
+])# PGAC_AVX512_CRC32C_INTRINSICS
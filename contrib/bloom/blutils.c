@@ -132,8 +132,10 @@ blhandler(PG_FUNCTION_ARGS)
 	amroutine->ambuild = blbuild;
 	amroutine->ambuildempty = blbuildempty;
 	amroutine->aminsert = blinsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->aminsertcleanup = NULL;
 	amroutine->ambulkdelete = blbulkdelete;
+	amroutine->amretaildelete = NULL;
 	amroutine->amvacuumcleanup = blvacuumcleanup;
 	amroutine->amcanreturn = NULL;
 	amroutine->amcostestimate = blcostestimate;
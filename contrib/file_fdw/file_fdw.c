@@ -16,6 +16,7 @@
 #include <unistd.h>
 
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/reloptions.h"
 #include "access/sysattr.h"
 #include "access/table.h"
@@ -27,13 +28,19 @@
 #include "commands/vacuum.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
+#include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#include "port/atomics.h"
+#include "storage/fd.h"
 #include "utils/acl.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/sampling.h"
@@ -108,8 +115,39 @@ typedef struct FileFdwExecutionState
 	List	   *options;		/* merged COPY options, excluding filename and
 								 * is_program */
 	CopyFromState cstate;		/* COPY execution state */
+
+	/* for parallel scans; see file_parallel_read() */
+	struct FileFdwParallelState *pstate;	/* shared state, or NULL */
+	FILE	   *pfile;			/* the data file */
+	bool		in_chunk;		/* in the middle of a chunk? */
+	bool		pdone;			/* no more chunks to read? */
+	off_t		readpos;		/* file position of the next byte */
+	off_t		chunk_end;		/* end of current chunk's byte range */
+	int			backslashes;	/* # of backslashes just before readpos */
 } FileFdwExecutionState;
 
+/*
+ * Shared state of a parallel scan.
+ *
+ * A parallel scan splits the file into chunks of chunk_size bytes, which the
+ * participating processes claim one at a time.  Each chunk is responsible
+ * for the lines that start within it.  This works only for text format, in
+ * which a newline that is not escaped by a backslash always ends a line; for
+ * encodings in which a backslash byte can be part of a multibyte character,
+ * the whole file is a single chunk.
+ */
+typedef struct FileFdwParallelState
+{
+	pg_atomic_uint64 next_chunk;	/* next chunk to be claimed */
+	uint64		file_size;		/* size of file when scan started */
+	uint64		chunk_size;		/* size of each chunk */
+} FileFdwParallelState;
+
+#define FILE_FDW_PARALLEL_CHUNK_SIZE	(8 * 1024 * 1024)
+
+/* The scan that file_parallel_read() currently reads for */
+static FileFdwExecutionState *current_parallel_scan = NULL;
+
 /*
  * SQL functions
  */
@@ -137,6 +175,17 @@ static void fileBeginForeignScan(ForeignScanState *node, int eflags);
 static TupleTableSlot *fileIterateForeignScan(ForeignScanState *node);
 static void fileReScanForeignScan(ForeignScanState *node);
 static void fileEndForeignScan(ForeignScanState *node);
+static Size fileEstimateDSMForeignScan(ForeignScanState *node,
+									   ParallelContext *pcxt);
+static void fileInitializeDSMForeignScan(ForeignScanState *node,
+										 ParallelContext *pcxt,
+										 void *coordinate);
+static void fileReInitializeDSMForeignScan(ForeignScanState *node,
+										   ParallelContext *pcxt,
+										   void *coordinate);
+static void fileInitializeWorkerForeignScan(ForeignScanState *node,
+											shm_toc *toc,
+											void *coordinate);
 static bool fileAnalyzeForeignTable(Relation relation,
 									AcquireSampleRowsFunc *func,
 									BlockNumber *totalpages);
@@ -157,6 +206,9 @@ static bool check_selective_binary_conversion(RelOptInfo *baserel,
 											  List **columns);
 static void estimate_size(PlannerInfo *root, RelOptInfo *baserel,
 						  FileFdwPlanState *fdw_private);
+static bool parallel_scan_supported(char *filename, bool is_program,
+									List *options);
+static int	file_parallel_read(void *outbuf, int minread, int maxread);
 static void estimate_costs(PlannerInfo *root, RelOptInfo *baserel,
 						   FileFdwPlanState *fdw_private,
 						   Cost *startup_cost, Cost *total_cost);
@@ -182,6 +234,10 @@ file_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->IterateForeignScan = fileIterateForeignScan;
 	fdwroutine->ReScanForeignScan = fileReScanForeignScan;
 	fdwroutine->EndForeignScan = fileEndForeignScan;
+	fdwroutine->EstimateDSMForeignScan = fileEstimateDSMForeignScan;
+	fdwroutine->InitializeDSMForeignScan = fileInitializeDSMForeignScan;
+	fdwroutine->ReInitializeDSMForeignScan = fileReInitializeDSMForeignScan;
+	fdwroutine->InitializeWorkerForeignScan = fileInitializeWorkerForeignScan;
 	fdwroutine->AnalyzeForeignTable = fileAnalyzeForeignTable;
 	fdwroutine->IsForeignScanParallelSafe = fileIsForeignScanParallelSafe;
 
@@ -589,6 +645,58 @@ fileGetForeignPaths(PlannerInfo *root,
 	 * appropriate pathkeys into the ForeignPath node to tell the planner
 	 * that.
 	 */
+
+	/*
+	 * Consider a parallel scan, if the file can be split into chunks.  The
+	 * costs are estimated as for the serial scan, except that the CPU cost is
+	 * spread over the participants as cost_seqscan() does.
+	 */
+	if (baserel->consider_parallel && baserel->lateral_relids == NULL &&
+		parallel_scan_supported(fdw_private->filename,
+								fdw_private->is_program,
+								fdw_private->options))
+	{
+		int			parallel_workers;
+
+		parallel_workers = compute_parallel_worker(baserel,
+												   fdw_private->pages, -1,
+												   max_parallel_workers_per_gather);
+		if (parallel_workers > 0)
+		{
+			ForeignPath *path;
+			double		parallel_divisor = parallel_workers;
+			Cost		cpu_run_cost;
+
+			if (parallel_leader_participation)
+			{
+				double		leader_contribution;
+
+				leader_contribution = 1.0 - (0.3 * parallel_workers);
+				if (leader_contribution > 0)
+					parallel_divisor += leader_contribution;
+			}
+
+			cpu_run_cost = total_cost - startup_cost -
+				seq_page_cost * fdw_private->pages;
+			total_cost = startup_cost + seq_page_cost * fdw_private->pages +
+				cpu_run_cost / parallel_divisor;
+
+			path = create_foreignscan_path(root, baserel,
+										   NULL,	/* default pathtarget */
+										   clamp_row_est(baserel->rows /
+														 parallel_divisor),
+										   startup_cost,
+										   total_cost,
+										   NIL, /* no pathkeys */
+										   NULL,	/* no outer rel */
+										   NULL,	/* no extra plan */
+										   NIL, /* no fdw_restrictinfo list */
+										   coptions);
+			path->path.parallel_aware = true;
+			path->path.parallel_workers = parallel_workers;
+			add_partial_path(baserel, (Path *) path);
+		}
+	}
 }
 
 /*
@@ -688,15 +796,22 @@ fileBeginForeignScan(ForeignScanState *node, int eflags)
 	/*
 	 * Create CopyState from FDW options.  We always acquire all columns, so
 	 * as to match the expected ScanTupleSlot signature.
+	 *
+	 * A parallel-aware scan doesn't know yet whether it will be reading from
+	 * the file directly or a chunk at a time, so it creates its CopyState on
+	 * first use.
 	 */
-	cstate = BeginCopyFrom(NULL,
-						   node->ss.ss_currentRelation,
-						   NULL,
-						   filename,
-						   is_program,
-						   NULL,
-						   NIL,
-						   options);
+	if (plan->scan.plan.parallel_aware)
+		cstate = NULL;
+	else
+		cstate = BeginCopyFrom(NULL,
+							   node->ss.ss_currentRelation,
+							   NULL,
+							   filename,
+							   is_program,
+							   NULL,
+							   NIL,
+							   options);
 
 	/*
 	 * Save state in node->fdw_state.  We must save enough information to call
@@ -707,6 +822,10 @@ fileBeginForeignScan(ForeignScanState *node, int eflags)
 	festate->is_program = is_program;
 	festate->options = options;
 	festate->cstate = cstate;
+	festate->pstate = NULL;
+	festate->pfile = NULL;
+	festate->in_chunk = false;
+	festate->pdone = false;
 
 	node->fdw_state = (void *) festate;
 }
@@ -727,6 +846,29 @@ fileIterateForeignScan(ForeignScanState *node)
 	bool		found;
 	ErrorContextCallback errcallback;
 
+	/* Start the scan now, if that was postponed */
+	if (festate->cstate == NULL)
+	{
+		if (festate->pstate)
+		{
+			festate->pfile = AllocateFile(festate->filename, PG_BINARY_R);
+			if (festate->pfile == NULL)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not open file \"%s\" for reading: %m",
+								festate->filename)));
+		}
+		festate->cstate = BeginCopyFrom(NULL,
+										node->ss.ss_currentRelation,
+										NULL,
+										festate->pstate ? NULL : festate->filename,
+										festate->is_program,
+										festate->pstate ? file_parallel_read : NULL,
+										NIL,
+										festate->options);
+	}
+	current_parallel_scan = festate;
+
 	/* Set up callback to identify error line number. */
 	errcallback.callback = CopyFromErrorCallback;
 	errcallback.arg = (void *) festate->cstate;
@@ -773,6 +915,23 @@ fileReScanForeignScan(ForeignScanState *node)
 {
 	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
 
+	/*
+	 * For a parallel-aware scan, just forget the current state; the next
+	 * call of fileIterateForeignScan() starts over.
+	 */
+	if (((ForeignScan *) node->ss.ps.plan)->scan.plan.parallel_aware)
+	{
+		if (festate->cstate)
+			EndCopyFrom(festate->cstate);
+		festate->cstate = NULL;
+		if (festate->pfile)
+			FreeFile(festate->pfile);
+		festate->pfile = NULL;
+		festate->in_chunk = false;
+		festate->pdone = false;
+		return;
+	}
+
 	EndCopyFrom(festate->cstate);
 
 	festate->cstate = BeginCopyFrom(NULL,
@@ -795,8 +954,85 @@ fileEndForeignScan(ForeignScanState *node)
 	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
 
 	/* if festate is NULL, we are in EXPLAIN; nothing to do */
-	if (festate)
+	if (festate == NULL)
+		return;
+
+	if (festate->cstate)
 		EndCopyFrom(festate->cstate);
+	if (festate->pfile)
+		FreeFile(festate->pfile);
+	if (current_parallel_scan == festate)
+		current_parallel_scan = NULL;
+}
+
+/*
+ * fileEstimateDSMForeignScan
+ *		Estimate the size of the shared state of a parallel scan
+ */
+static Size
+fileEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt)
+{
+	return sizeof(FileFdwParallelState);
+}
+
+/*
+ * fileInitializeDSMForeignScan
+ *		Set up the shared state of a parallel scan
+ */
+static void
+fileInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							 void *coordinate)
+{
+	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
+	FileFdwParallelState *pstate = (FileFdwParallelState *) coordinate;
+	struct stat stat_buf;
+
+	if (stat(festate->filename, &stat_buf) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not stat file \"%s\": %m",
+						festate->filename)));
+
+	pg_atomic_init_u64(&pstate->next_chunk, 0);
+	pstate->file_size = stat_buf.st_size;
+
+	/*
+	 * The client encoding might have changed since planning; if it's now one
+	 * that can't be split, use a single chunk.
+	 */
+	if (parallel_scan_supported(festate->filename, festate->is_program,
+								festate->options))
+		pstate->chunk_size = FILE_FDW_PARALLEL_CHUNK_SIZE;
+	else
+		pstate->chunk_size = Max(pstate->file_size, 1);
+
+	festate->pstate = pstate;
+}
+
+/*
+ * fileReInitializeDSMForeignScan
+ *		Reset the shared state of a parallel scan before a rescan
+ */
+static void
+fileReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	FileFdwParallelState *pstate = (FileFdwParallelState *) coordinate;
+
+	pg_atomic_write_u64(&pstate->next_chunk, 0);
+}
+
+/*
+ * fileInitializeWorkerForeignScan
+ *		Attach to the shared state of a parallel scan
+ */
+static void
+fileInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc,
+								void *coordinate)
+{
+	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
+
+	festate->pstate = (FileFdwParallelState *) coordinate;
 }
 
 /*
@@ -988,6 +1224,227 @@ check_selective_binary_conversion(RelOptInfo *baserel,
 	return true;
 }
 
+/*
+ * Check whether a file can be scanned in parallel, by splitting it into
+ * chunks at line boundaries (see FileFdwParallelState).
+ */
+static bool
+parallel_scan_supported(char *filename, bool is_program, List *options)
+{
+	int			encoding = pg_get_client_encoding();
+	ListCell   *lc;
+
+	if (is_program)
+		return false;
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "format") == 0)
+		{
+			/* in CSV, a quoted field can contain newlines */
+			if (strcmp(defGetString(def), "text") != 0)
+				return false;
+		}
+		else if (strcmp(def->defname, "header") == 0)
+		{
+			bool		header;
+
+			/* every participant would skip its first line */
+			if (!parse_bool(defGetString(def), &header) || header)
+				return false;
+		}
+		else if (strcmp(def->defname, "encoding") == 0)
+			encoding = pg_char_to_encoding(defGetString(def));
+	}
+
+	/* backslashes and newlines must always be what they seem */
+	if (encoding < 0 || PG_ENCODING_IS_CLIENT_ONLY(encoding))
+		return false;
+
+	return true;
+}
+
+/*
+ * Count the backslashes immediately before file position pos.
+ */
+static int
+count_backslashes_before(FILE *file, off_t pos)
+{
+	char		buf[BLCKSZ];
+	int			count = 0;
+
+	while (pos > 0)
+	{
+		size_t		len = Min(pos, (off_t) sizeof(buf));
+		size_t		i;
+
+		if (fseeko(file, pos - len, SEEK_SET) != 0 ||
+			fread(buf, 1, len, file) != len)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from COPY file: %m")));
+
+		for (i = len; i > 0 && buf[i - 1] == '\\'; i--)
+			count++;
+		if (i > 0)
+			break;
+		pos -= len;
+	}
+
+	return count;
+}
+
+/*
+ * Claim the next chunk of a parallel scan that has any lines starting in it,
+ * and position the file at its first line.  Returns false if there are no
+ * more chunks.
+ */
+static bool
+file_parallel_next_chunk(FileFdwExecutionState *festate)
+{
+	FileFdwParallelState *pstate = festate->pstate;
+
+	for (;;)
+	{
+		uint64		chunk = pg_atomic_fetch_add_u64(&pstate->next_chunk, 1);
+		off_t		start;
+		int			backslashes;
+		int			c;
+
+		if (chunk >= (pstate->file_size + pstate->chunk_size - 1) / pstate->chunk_size)
+			return false;
+
+		start = chunk * pstate->chunk_size;
+		festate->chunk_end = Min(start + pstate->chunk_size,
+								 pstate->file_size);
+
+		/*
+		 * The chunk's first line starts after the first unescaped newline at
+		 * or after start - 1, unless this is the first chunk.
+		 */
+		if (start > 0)
+		{
+			start--;
+			backslashes = count_backslashes_before(festate->pfile, start);
+			if (fseeko(festate->pfile, start, SEEK_SET) != 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read from COPY file: %m")));
+			while ((c = getc(festate->pfile)) != EOF)
+			{
+				start++;
+				if (c == '\n' && backslashes % 2 == 0)
+					break;
+				backslashes = (c == '\\') ? backslashes + 1 : 0;
+			}
+			if (ferror(festate->pfile))
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read from COPY file: %m")));
+
+			/* if a line spans the whole chunk, it's not ours */
+			if (c == EOF || start >= festate->chunk_end)
+				continue;
+		}
+		else if (fseeko(festate->pfile, 0, SEEK_SET) != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from COPY file: %m")));
+
+		festate->readpos = start;
+		festate->backslashes = 0;
+		return true;
+	}
+}
+
+/*
+ * Data source callback for COPY in a parallel scan
+ *
+ * This delivers the lines of the chunks that this process claims, one chunk
+ * after another.  A chunk's last line is the one that runs into its last
+ * byte, and it ends with the first unescaped newline at or after that byte.
+ */
+static int
+file_parallel_read(void *outbuf, int minread, int maxread)
+{
+	FileFdwExecutionState *festate = current_parallel_scan;
+	char	   *buf = (char *) outbuf;
+	int			nread = 0;
+
+	Assert(festate != NULL && festate->pstate != NULL);
+
+	while (nread < maxread && !festate->pdone)
+	{
+		if (!festate->in_chunk)
+		{
+			if (!file_parallel_next_chunk(festate))
+			{
+				festate->pdone = true;
+				break;
+			}
+			festate->in_chunk = true;
+		}
+
+		if (festate->readpos < festate->chunk_end - 1)
+		{
+			/* Copy the part of the chunk that surely belongs to it */
+			size_t		len = Min(maxread - nread,
+								  festate->chunk_end - 1 - festate->readpos);
+			size_t		n;
+			size_t		i;
+
+			n = fread(buf + nread, 1, len, festate->pfile);
+			if (n == 0)
+			{
+				if (ferror(festate->pfile))
+					ereport(ERROR,
+							(errcode_for_file_access(),
+							 errmsg("could not read from COPY file: %m")));
+				/* the file was truncated under us */
+				festate->in_chunk = false;
+				festate->pdone = true;
+				break;
+			}
+
+			/* keep track of trailing backslashes */
+			for (i = n; i > 0 && buf[nread + i - 1] == '\\'; i--)
+				;
+			if (i == 0)
+				festate->backslashes += n;
+			else
+				festate->backslashes = n - i;
+
+			festate->readpos += n;
+			nread += n;
+		}
+		else
+		{
+			/* Copy the rest of the chunk's last line */
+			int			c = getc(festate->pfile);
+
+			if (c == EOF)
+			{
+				if (ferror(festate->pfile))
+					ereport(ERROR,
+							(errcode_for_file_access(),
+							 errmsg("could not read from COPY file: %m")));
+				festate->in_chunk = false;
+				continue;
+			}
+
+			buf[nread++] = (char) c;
+			festate->readpos++;
+			if (c == '\n' && festate->backslashes % 2 == 0)
+				festate->in_chunk = false;
+			festate->backslashes = (c == '\\') ? festate->backslashes + 1 : 0;
+		}
+	}
+
+	return nread;
+}
+
 /*
  * Estimate size of a foreign table.
  *
@@ -11,12 +11,14 @@
 #include "access/htup_details.h"
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "port/pg_numa.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 
 
 #define NUM_BUFFERCACHE_PAGES_MIN_ELEM	8
-#define NUM_BUFFERCACHE_PAGES_ELEM	9
+#define NUM_BUFFERCACHE_PAGES_V1_1_ELEM	9
+#define NUM_BUFFERCACHE_PAGES_ELEM	10
 #define NUM_BUFFERCACHE_SUMMARY_ELEM 5
 #define NUM_BUFFERCACHE_USAGE_COUNTS_ELEM 4
 
@@ -43,6 +45,9 @@ typedef struct
 	 * because of bufmgr.c's PrivateRefCount infrastructure.
 	 */
 	int32		pinning_backends;
+
+	/* NUMA node the buffer's memory is on, or -1 if unknown */
+	int32		numa_node;
 } BufferCachePagesRec;
 
 
@@ -89,9 +94,9 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 		fctx = (BufferCachePagesContext *) palloc(sizeof(BufferCachePagesContext));
 
 		/*
-		 * To smoothly support upgrades from version 1.0 of this extension
+		 * To smoothly support upgrades from older versions of this extension
 		 * transparently handle the (non-)existence of the pinning_backends
-		 * column. We unfortunately have to get the result type for that... -
+		 * and numa_node columns. We unfortunately have to get the result type for that... -
 		 * we can't use the result type determined by the function definition
 		 * without potentially crashing when somebody uses the old (or even
 		 * wrong) function definition though.
@@ -122,9 +127,12 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 		TupleDescInitEntry(tupledesc, (AttrNumber) 8, "usage_count",
 						   INT2OID, -1, 0);
 
-		if (expected_tupledesc->natts == NUM_BUFFERCACHE_PAGES_ELEM)
+		if (expected_tupledesc->natts >= NUM_BUFFERCACHE_PAGES_V1_1_ELEM)
 			TupleDescInitEntry(tupledesc, (AttrNumber) 9, "pinning_backends",
 							   INT4OID, -1, 0);
+		if (expected_tupledesc->natts == NUM_BUFFERCACHE_PAGES_ELEM)
+			TupleDescInitEntry(tupledesc, (AttrNumber) 10, "numa_node",
+							   INT4OID, -1, 0);
 
 		fctx->tupdesc = BlessTupleDesc(tupledesc);
 
@@ -178,6 +186,38 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 				fctx->record[i].isvalid = false;
 
 			UnlockBufHdr(bufHdr, buf_state);
+
+			fctx->record[i].numa_node = -1;
+		}
+
+		/*
+		 * Ask the kernel which NUMA node the first page of each buffer is on,
+		 * if the caller wants to know.  Pages that were never touched are not
+		 * on any node yet.
+		 */
+		if (expected_tupledesc->natts == NUM_BUFFERCACHE_PAGES_ELEM)
+		{
+			void	  **pages;
+			int		   *status;
+
+			pages = (void **) palloc_extended(sizeof(void *) * NBuffers,
+											  MCXT_ALLOC_HUGE);
+			status = (int *) palloc_extended(sizeof(int) * NBuffers,
+											 MCXT_ALLOC_HUGE);
+			for (i = 0; i < NBuffers; i++)
+				pages[i] = BufferGetBlock(i + 1);
+
+			if (pg_numa_query_pages(NBuffers, pages, status) == 0)
+			{
+				for (i = 0; i < NBuffers; i++)
+				{
+					if (status[i] >= 0)
+						fctx->record[i].numa_node = status[i];
+				}
+			}
+
+			pfree(pages);
+			pfree(status);
 		}
 	}
 
@@ -233,6 +273,19 @@ pg_buffercache_pages(PG_FUNCTION_ARGS)
 			nulls[8] = false;
 		}
 
+		/*
+		 * The NUMA node is a property of the buffer's memory, so report it
+		 * even for unused buffers.  Unused for older callers, but the array
+		 * is always long enough.
+		 */
+		if (fctx->record[i].numa_node >= 0)
+		{
+			values[9] = Int32GetDatum(fctx->record[i].numa_node);
+			nulls[9] = false;
+		}
+		else
+			nulls[9] = true;
+
 		/* Build and return the tuple. */
 		tuple = heap_form_tuple(fctx->tupdesc, values, nulls);
 		result = HeapTupleGetDatum(tuple);
@@ -26,3 +26,23 @@ SET ROLE pg_monitor;
 SELECT count(*) > 0 FROM pg_buffercache;
 SELECT buffers_used + buffers_unused > 0 FROM pg_buffercache_summary();
 SELECT count(*) > 0 FROM pg_buffercache_usage_counts();
+RESET role;
+
+-- numa_node is either unknown or a valid node
+SELECT bool_and(numa_node >= 0) IS NOT FALSE FROM pg_buffercache;
+
+-- Callers using the pre-1.6 result type still work
+SELECT count(*) > 0 FROM pg_buffercache_pages() AS p
+	(bufferid integer, relfilenode oid, reltablespace oid, reldatabase oid,
+	 relforknumber int2, relblocknumber int8, isdirty bool, usagecount int2,
+	 pinning_backends int4);
+
+-- Check that updating from 1.5 adds the numa_node column
+DROP EXTENSION pg_buffercache;
+CREATE EXTENSION pg_buffercache VERSION '1.5';
+SELECT attname FROM pg_attribute
+  WHERE attrelid = 'pg_buffercache'::regclass AND attnum > 8 ORDER BY attnum;
+ALTER EXTENSION pg_buffercache UPDATE TO '1.6';
+SELECT attname FROM pg_attribute
+  WHERE attrelid = 'pg_buffercache'::regclass AND attnum > 8 ORDER BY attnum;
+SELECT count(*) = count(bufferid) FROM pg_buffercache;
@@ -10,11 +10,14 @@
  *		and we need to lock the relations so that we don't try to prewarm
  *		pages from a relation that is in the process of being dropped.
  *
- *		While prewarming, autoprewarm will use two workers.  There's a
- *		leader worker that reads and sorts the list of blocks to be
- *		prewarmed and then launches a per-database worker for each
- *		relevant database in turn.  The former keeps running after the
- *		initial prewarm is complete to update the dump file periodically.
+ *		While prewarming, there's a leader worker that reads and sorts the
+ *		list of blocks to be prewarmed and then launches a group of
+ *		per-database workers for each relevant database in turn.  The
+ *		per-database workers share out the database's blocks one relation
+ *		fork at a time and read them with a read stream, so that runs of
+ *		adjacent blocks become large sequential reads.  The leader keeps
+ *		running after the initial prewarm is complete to update the dump
+ *		file periodically.
  *
  *	Copyright (c) 2016-2024, PostgreSQL Global Development Group
  *
@@ -35,6 +38,7 @@
 #include "pgstat.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/interrupt.h"
+#include "postmaster/postmaster.h"
 #include "storage/buf_internals.h"
 #include "storage/dsm.h"
 #include "storage/dsm_registry.h"
@@ -44,6 +48,7 @@
 #include "storage/lwlock.h"
 #include "storage/proc.h"
 #include "storage/procsignal.h"
+#include "storage/read_stream.h"
 #include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
@@ -57,6 +62,13 @@
 
 #define AUTOPREWARM_FILE "autoprewarm.blocks"
 
+/*
+ * Maximum number of blocks a per-database worker claims at once.  A claim
+ * never spans relation forks, so this only matters for large forks, where
+ * it lets the other workers share the work.
+ */
+#define AUTOPREWARM_CLAIM_BLOCKS 4096
+
 /* Metadata for each block we dump. */
 typedef struct BlockInfoRecord
 {
@@ -65,6 +77,7 @@ typedef struct BlockInfoRecord
 	RelFileNumber filenumber;
 	ForkNumber	forknum;
 	BlockNumber blocknum;
+	uint32		usagecount;
 } BlockInfoRecord;
 
 /* Shared state information for autoprewarm bgworker. */
@@ -79,9 +92,19 @@ typedef struct AutoPrewarmSharedState
 	Oid			database;
 	int			prewarm_start_idx;
 	int			prewarm_stop_idx;
+	int			prewarm_next_idx;	/* next block not yet claimed */
 	int			prewarmed_blocks;
 } AutoPrewarmSharedState;
 
+/* Callback state for reading part of one relation fork with a read stream. */
+typedef struct AutoPrewarmReadStreamData
+{
+	BlockInfoRecord *block_info;
+	int			pos;
+	int			stop_idx;
+	BlockNumber nblocks;
+} AutoPrewarmReadStreamData;
+
 PGDLLEXPORT void autoprewarm_main(Datum main_arg);
 PGDLLEXPORT void autoprewarm_database_main(Datum main_arg);
 
@@ -91,10 +114,15 @@ PG_FUNCTION_INFO_V1(autoprewarm_dump_now);
 static void apw_load_buffers(void);
 static int	apw_dump_now(bool is_bgworker, bool dump_unlogged);
 static void apw_start_leader_worker(void);
-static void apw_start_database_worker(void);
+static void apw_start_database_workers(void);
+static bool apw_claim_blocks(BlockInfoRecord *block_info, int *start,
+							 int *stop);
+static int	apw_prewarm_blocks(Relation rel, BlockInfoRecord *block_info,
+							   int start, int stop);
 static bool apw_init_shmem(void);
 static void apw_detach_shmem(int code, Datum arg);
 static int	apw_compare_blockinfo(const void *p, const void *q);
+static int	apw_compare_usagecount(const void *p, const void *q);
 
 /* Pointer to shared-memory state. */
 static AutoPrewarmSharedState *apw_state = NULL;
@@ -102,6 +130,7 @@ static AutoPrewarmSharedState *apw_state = NULL;
 /* GUC variables. */
 static bool autoprewarm = true; /* start worker? */
 static int	autoprewarm_interval = 300; /* dump interval */
+static int	autoprewarm_workers = 4;	/* per-database workers */
 
 /*
  * Module load callback.
@@ -121,6 +150,18 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_workers",
+							"Sets the number of workers prewarming each database concurrently.",
+							NULL,
+							&autoprewarm_workers,
+							4,
+							1, MAX_BACKENDS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	if (!process_shared_preload_libraries_in_progress)
 		return;
 
@@ -269,14 +310,15 @@ autoprewarm_main(Datum main_arg)
 }
 
 /*
- * Read the dump file and launch per-database workers one at a time to
- * prewarm the buffers found there.
+ * Read the dump file and launch per-database workers one database at a time
+ * to prewarm the buffers found there.
  */
 static void
 apw_load_buffers(void)
 {
 	FILE	   *file = NULL;
 	int			num_elements,
+				num_loaded,
 				i;
 	BlockInfoRecord *blkinfo;
 	dsm_segment *seg;
@@ -329,24 +371,49 @@ apw_load_buffers(void)
 	seg = dsm_create(sizeof(BlockInfoRecord) * num_elements, 0);
 	blkinfo = (BlockInfoRecord *) dsm_segment_address(seg);
 
-	/* Read records, one per line. */
+	/*
+	 * Read records, one per line.  Files written by older versions lack the
+	 * usage count; treat those blocks as having been used once.
+	 */
 	for (i = 0; i < num_elements; i++)
 	{
+		char		line[128];
 		unsigned	forknum;
+		int			nfields;
 
-		if (fscanf(file, "%u,%u,%u,%u,%u\n", &blkinfo[i].database,
-				   &blkinfo[i].tablespace, &blkinfo[i].filenumber,
-				   &forknum, &blkinfo[i].blocknum) != 5)
+		blkinfo[i].usagecount = 1;
+		if (fgets(line, sizeof(line), file) == NULL)
+			nfields = 0;
+		else
+			nfields = sscanf(line, "%u,%u,%u,%u,%u,%u", &blkinfo[i].database,
+							 &blkinfo[i].tablespace, &blkinfo[i].filenumber,
+							 &forknum, &blkinfo[i].blocknum,
+							 &blkinfo[i].usagecount);
+		if (nfields != 5 && nfields != 6)
 			ereport(ERROR,
 					(errmsg("autoprewarm block dump file is corrupted at line %d",
 							i + 1)));
 		blkinfo[i].forknum = forknum;
+		blkinfo[i].usagecount = Min(blkinfo[i].usagecount, BM_MAX_USAGE_COUNT);
 	}
 
 	FreeFile(file);
 
+	/*
+	 * If the buffer pool is now smaller than the dump, only the hottest
+	 * blocks can stay resident, so don't bother reading the rest.
+	 */
+	if (num_elements > StrategyActiveBuffers())
+	{
+		qsort(blkinfo, num_elements, sizeof(BlockInfoRecord),
+			  apw_compare_usagecount);
+		num_loaded = StrategyActiveBuffers();
+	}
+	else
+		num_loaded = num_elements;
+
 	/* Sort the blocks to be loaded. */
-	qsort(blkinfo, num_elements, sizeof(BlockInfoRecord),
+	qsort(blkinfo, num_loaded, sizeof(BlockInfoRecord),
 		  apw_compare_blockinfo);
 
 	/* Populate shared memory state. */
@@ -355,7 +422,7 @@ apw_load_buffers(void)
 	apw_state->prewarmed_blocks = 0;
 
 	/* Get the info position of the first block of the next database. */
-	while (apw_state->prewarm_start_idx < num_elements)
+	while (apw_state->prewarm_start_idx < num_loaded)
 	{
 		int			j = apw_state->prewarm_start_idx;
 		Oid			current_db = blkinfo[j].database;
@@ -365,7 +432,7 @@ apw_load_buffers(void)
 		 * not belong to this database.
 		 */
 		j++;
-		while (j < num_elements)
+		while (j < num_loaded)
 		{
 			if (current_db != blkinfo[j].database)
 			{
@@ -389,8 +456,9 @@ apw_load_buffers(void)
 		if (current_db == InvalidOid)
 			break;
 
-		/* Configure stop point and database for next per-database worker. */
+		/* Configure stop point and database for next per-database workers. */
 		apw_state->prewarm_stop_idx = j;
+		apw_state->prewarm_next_idx = apw_state->prewarm_start_idx;
 		apw_state->database = current_db;
 		Assert(apw_state->prewarm_start_idx < apw_state->prewarm_stop_idx);
 
@@ -406,10 +474,10 @@ apw_load_buffers(void)
 			break;
 
 		/*
-		 * Start a per-database worker to load blocks for this database; this
-		 * function will return once the per-database worker exits.
+		 * Start per-database workers to load blocks for this database; this
+		 * function will return once they have all exited.
 		 */
-		apw_start_database_worker();
+		apw_start_database_workers();
 
 		/* Prepare for next database. */
 		apw_state->prewarm_start_idx = apw_state->prewarm_stop_idx;
@@ -430,18 +498,18 @@ apw_load_buffers(void)
 }
 
 /*
- * Prewarm all blocks for one database (and possibly also global objects, if
- * those got grouped with this database).
+ * Prewarm blocks for one database (and possibly also global objects, if
+ * those got grouped with this database).  Several of these workers may run
+ * at once for the same database; each repeatedly claims the next run of
+ * blocks until there are none left or we run out of free buffers.
  */
 void
 autoprewarm_database_main(Datum main_arg)
 {
-	int			pos;
 	BlockInfoRecord *block_info;
-	Relation	rel = NULL;
-	BlockNumber nblocks = 0;
-	BlockInfoRecord *old_blk = NULL;
 	dsm_segment *seg;
+	int			start;
+	int			stop;
 
 	/* Establish signal handlers; once that's done, unblock signals. */
 	pqsignal(SIGTERM, die);
@@ -456,67 +524,24 @@ autoprewarm_database_main(Datum main_arg)
 				 errmsg("could not map dynamic shared memory segment")));
 	BackgroundWorkerInitializeConnectionByOid(apw_state->database, InvalidOid, 0);
 	block_info = (BlockInfoRecord *) dsm_segment_address(seg);
-	pos = apw_state->prewarm_start_idx;
 
-	/*
-	 * Loop until we run out of blocks to prewarm or until we run out of free
-	 * buffers.
-	 */
-	while (pos < apw_state->prewarm_stop_idx && have_free_buffer())
+	while (have_free_buffer() &&
+		   apw_claim_blocks(block_info, &start, &stop))
 	{
-		BlockInfoRecord *blk = &block_info[pos++];
-		Buffer		buf;
+		BlockInfoRecord *blk = &block_info[start];
+		Relation	rel = NULL;
+		Oid			reloid;
+		int			prewarmed = 0;
 
 		CHECK_FOR_INTERRUPTS();
 
-		/*
-		 * Quit if we've reached records for another database. If previous
-		 * blocks are of some global objects, then continue pre-warming.
-		 */
-		if (old_blk != NULL && old_blk->database != blk->database &&
-			old_blk->database != 0)
-			break;
-
-		/*
-		 * As soon as we encounter a block of a new relation, close the old
-		 * relation. Note that rel will be NULL if try_relation_open failed
-		 * previously; in that case, there is nothing to close.
-		 */
-		if (old_blk != NULL && old_blk->filenumber != blk->filenumber &&
-			rel != NULL)
-		{
-			relation_close(rel, AccessShareLock);
-			rel = NULL;
-			CommitTransactionCommand();
-		}
-
-		/*
-		 * Try to open each new relation, but only once, when we first
-		 * encounter it. If it's been dropped, skip the associated blocks.
-		 */
-		if (old_blk == NULL || old_blk->filenumber != blk->filenumber)
-		{
-			Oid			reloid;
-
-			Assert(rel == NULL);
-			StartTransactionCommand();
-			reloid = RelidByRelfilenumber(blk->tablespace, blk->filenumber);
-			if (OidIsValid(reloid))
-				rel = try_relation_open(reloid, AccessShareLock);
+		/* If the relation has been dropped, skip the claimed blocks. */
+		StartTransactionCommand();
+		reloid = RelidByRelfilenumber(blk->tablespace, blk->filenumber);
+		if (OidIsValid(reloid))
+			rel = try_relation_open(reloid, AccessShareLock);
 
-			if (!rel)
-				CommitTransactionCommand();
-		}
-		if (!rel)
-		{
-			old_blk = blk;
-			continue;
-		}
-
-		/* Once per fork, check for fork existence and size. */
-		if (old_blk == NULL ||
-			old_blk->filenumber != blk->filenumber ||
-			old_blk->forknum != blk->forknum)
+		if (rel)
 		{
 			/*
 			 * smgrexists is not safe for illegal forknum, hence check whether
@@ -525,39 +550,134 @@ autoprewarm_database_main(Datum main_arg)
 			if (blk->forknum > InvalidForkNumber &&
 				blk->forknum <= MAX_FORKNUM &&
 				smgrexists(RelationGetSmgr(rel), blk->forknum))
-				nblocks = RelationGetNumberOfBlocksInFork(rel, blk->forknum);
-			else
-				nblocks = 0;
-		}
+				prewarmed = apw_prewarm_blocks(rel, block_info, start, stop);
 
-		/* Check whether blocknum is valid and within fork file size. */
-		if (blk->blocknum >= nblocks)
-		{
-			/* Move to next forknum. */
-			old_blk = blk;
-			continue;
-		}
-
-		/* Prewarm buffer. */
-		buf = ReadBufferExtended(rel, blk->forknum, blk->blocknum, RBM_NORMAL,
-								 NULL);
-		if (BufferIsValid(buf))
-		{
-			apw_state->prewarmed_blocks++;
-			ReleaseBuffer(buf);
+			relation_close(rel, AccessShareLock);
 		}
+		CommitTransactionCommand();
 
-		old_blk = blk;
+		LWLockAcquire(&apw_state->lock, LW_EXCLUSIVE);
+		apw_state->prewarmed_blocks += prewarmed;
+		LWLockRelease(&apw_state->lock);
 	}
 
 	dsm_detach(seg);
+}
 
-	/* Release lock on previous relation. */
-	if (rel)
+/*
+ * Claim the next run of blocks for the current database.  A run consists of
+ * blocks of a single relation fork, at most AUTOPREWARM_CLAIM_BLOCKS of them.
+ * Returns false if there is nothing left to claim.
+ */
+static bool
+apw_claim_blocks(BlockInfoRecord *block_info, int *start, int *stop)
+{
+	BlockInfoRecord *first;
+	int			end;
+	int			pos;
+
+	LWLockAcquire(&apw_state->lock, LW_EXCLUSIVE);
+	pos = apw_state->prewarm_next_idx;
+	end = apw_state->prewarm_stop_idx;
+	if (pos >= end)
 	{
-		relation_close(rel, AccessShareLock);
-		CommitTransactionCommand();
+		LWLockRelease(&apw_state->lock);
+		return false;
+	}
+
+	*start = pos;
+	first = &block_info[pos++];
+	end = Min(end, *start + AUTOPREWARM_CLAIM_BLOCKS);
+	while (pos < end &&
+		   block_info[pos].database == first->database &&
+		   block_info[pos].tablespace == first->tablespace &&
+		   block_info[pos].filenumber == first->filenumber &&
+		   block_info[pos].forknum == first->forknum)
+		pos++;
+	*stop = apw_state->prewarm_next_idx = pos;
+	LWLockRelease(&apw_state->lock);
+
+	return true;
+}
+
+/*
+ * Read stream callback returning the claimed blocks in order.  The records
+ * are sorted by block number, so the stream can combine neighbouring blocks
+ * into larger reads.
+ */
+static BlockNumber
+apw_read_stream_next_block(ReadStream *stream,
+						   void *callback_private_data,
+						   void *per_buffer_data)
+{
+	AutoPrewarmReadStreamData *p = callback_private_data;
+	BlockInfoRecord *blk;
+
+	if (p->pos >= p->stop_idx || !have_free_buffer())
+		return InvalidBlockNumber;
+
+	/* The fork may have been truncated since the dump was written. */
+	blk = &p->block_info[p->pos++];
+	if (blk->blocknum >= p->nblocks)
+	{
+		p->pos = p->stop_idx;
+		return InvalidBlockNumber;
+	}
+
+	*((uint32 *) per_buffer_data) = blk->usagecount;
+	return blk->blocknum;
+}
+
+/*
+ * Prewarm the claimed blocks block_info[start .. stop - 1], which all belong
+ * to one fork of rel.  Returns the number of blocks loaded.
+ */
+static int
+apw_prewarm_blocks(Relation rel, BlockInfoRecord *block_info, int start,
+				   int stop)
+{
+	AutoPrewarmReadStreamData p;
+	ForkNumber	forknum = block_info[start].forknum;
+	ReadStream *stream;
+	Buffer		buf;
+	uint32	   *usagecount;
+	int			prewarmed = 0;
+
+	p.block_info = block_info;
+	p.pos = start;
+	p.stop_idx = stop;
+	p.nblocks = RelationGetNumberOfBlocksInFork(rel, forknum);
+
+	stream = read_stream_begin_relation(READ_STREAM_FULL,
+										NULL,
+										rel,
+										forknum,
+										apw_read_stream_next_block,
+										&p,
+										sizeof(uint32));
+
+	while ((buf = read_stream_next_buffer(stream, (void **) &usagecount)) !=
+		   InvalidBuffer)
+	{
+		BlockNumber blocknum = BufferGetBlockNumber(buf);
+
+		CHECK_FOR_INTERRUPTS();
+		ReleaseBuffer(buf);
+
+		/*
+		 * Each further access bumps the usage count once, giving the block
+		 * back the standing it had when the dump was written.  These are
+		 * all buffer hits, barring the block being evicted in between.
+		 */
+		for (uint32 i = 1; i < *usagecount; i++)
+			ReleaseBuffer(ReadBufferExtended(rel, forknum, blocknum,
+											 RBM_NORMAL, NULL));
+
+		prewarmed++;
 	}
+	read_stream_end(stream);
+
+	return prewarmed;
 }
 
 /*
@@ -626,6 +746,8 @@ apw_dump_now(bool is_bgworker, bool dump_unlogged)
 			block_info_array[num_blocks].forknum =
 				BufTagGetForkNum(&bufHdr->tag);
 			block_info_array[num_blocks].blocknum = bufHdr->tag.blockNum;
+			block_info_array[num_blocks].usagecount =
+				BUF_STATE_GET_USAGECOUNT(buf_state);
 			++num_blocks;
 		}
 
@@ -658,12 +780,13 @@ apw_dump_now(bool is_bgworker, bool dump_unlogged)
 	{
 		CHECK_FOR_INTERRUPTS();
 
-		ret = fprintf(file, "%u,%u,%u,%u,%u\n",
+		ret = fprintf(file, "%u,%u,%u,%u,%u,%u\n",
 					  block_info_array[i].database,
 					  block_info_array[i].tablespace,
 					  block_info_array[i].filenumber,
 					  (uint32) block_info_array[i].forknum,
-					  block_info_array[i].blocknum);
+					  block_info_array[i].blocknum,
+					  block_info_array[i].usagecount);
 		if (ret < 0)
 		{
 			int			save_errno = errno;
@@ -842,13 +965,15 @@ apw_start_leader_worker(void)
 }
 
 /*
- * Start autoprewarm per-database worker process.
+ * Start up to autoprewarm_workers per-database worker processes, and wait for
+ * all of them to exit.  It's an error only if not even one can be started.
  */
 static void
-apw_start_database_worker(void)
+apw_start_database_workers(void)
 {
 	BackgroundWorker worker;
-	BackgroundWorkerHandle *handle;
+	BackgroundWorkerHandle **handles;
+	int			nworkers = 0;
 
 	MemSet(&worker, 0, sizeof(BackgroundWorker));
 	worker.bgw_flags =
@@ -863,17 +988,25 @@ apw_start_database_worker(void)
 	/* must set notify PID to wait for shutdown */
 	worker.bgw_notify_pid = MyProcPid;
 
-	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+	handles = palloc_array(BackgroundWorkerHandle *, autoprewarm_workers);
+	while (nworkers < autoprewarm_workers &&
+		   RegisterDynamicBackgroundWorker(&worker, &handles[nworkers]))
+		nworkers++;
+
+	if (nworkers == 0)
 		ereport(ERROR,
 				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
 				 errmsg("registering dynamic bgworker autoprewarm failed"),
 				 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
 
 	/*
-	 * Ignore return value; if it fails, postmaster has died, but we have
+	 * Ignore return values; if it fails, postmaster has died, but we have
 	 * checks for that elsewhere.
 	 */
-	WaitForBackgroundWorkerShutdown(handle);
+	for (int i = 0; i < nworkers; i++)
+		WaitForBackgroundWorkerShutdown(handles[i]);
+
+	pfree(handles);
 }
 
 /* Compare member elements to check whether they are not equal. */
@@ -889,10 +1022,9 @@ do { \
  * apw_compare_blockinfo
  *
  * We depend on all records for a particular database being consecutive
- * in the dump file; each per-database worker will preload blocks until
- * it sees a block for some other database.  Sorting by tablespace,
- * filenumber, forknum, and blocknum isn't critical for correctness, but
- * helps us get a sequential I/O pattern.
+ * in the dump file, and the records of a relation fork being consecutive and
+ * in block order; the per-database workers claim blocks one fork at a time
+ * and read each run of them with a read stream.
  */
 static int
 apw_compare_blockinfo(const void *p, const void *q)
@@ -908,3 +1040,21 @@ apw_compare_blockinfo(const void *p, const void *q)
 
 	return 0;
 }
+
+/*
+ * apw_compare_usagecount
+ *
+ * Order records by descending usage count, so that the hottest blocks come
+ * first when there are more of them than buffers.
+ */
+static int
+apw_compare_usagecount(const void *p, const void *q)
+{
+	const BlockInfoRecord *a = (const BlockInfoRecord *) p;
+	const BlockInfoRecord *b = (const BlockInfoRecord *) q;
+
+	if (a->usagecount != b->usagecount)
+		return a->usagecount > b->usagecount ? -1 : 1;
+
+	return apw_compare_blockinfo(p, q);
+}
@@ -0,0 +1,17 @@
+/* contrib/pg_stat_statements/pg_stat_statements--1.12--1.13.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_stat_statements UPDATE TO '1.13'" to load this file. \quit
+
+CREATE FUNCTION pg_stat_statements_percentiles(
+    IN percentiles float8[] DEFAULT '{0.5,0.9,0.99,0.999}',
+    OUT userid oid,
+    OUT dbid oid,
+    OUT toplevel bool,
+    OUT queryid bigint,
+    OUT plan_time_percentiles float8[],
+    OUT exec_time_percentiles float8[]
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_stat_statements_percentiles'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
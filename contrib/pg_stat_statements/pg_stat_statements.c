@@ -29,9 +29,20 @@
  * query-text file) should be accessed only while holding either the
  * pgss->mutex spinlock, or exclusive lock on pgss->lock.  We use the mutex to
  * allow reserving file space while holding only shared lock on pgss->lock.
- * Rewriting the entire external query-text file, eg for garbage collection,
- * requires holding pgss->lock exclusively; this allows individual entries
- * in the file to be read or written while holding only shared lock.
+ * Replacing the external query-text file, eg at the end of a garbage
+ * collection, requires holding pgss->lock exclusively; this allows individual
+ * entries in the file to be read or written while holding only shared lock.
+ * Garbage collection builds the replacement file while holding the lock
+ * shared, and additionally holds pgss->gc_lock so that only one process
+ * does so at a time.
+ *
+ * To keep the shared lock and the entry spinlock off the per-execution path,
+ * each backend accumulates counters in a local "pending" hashtable and merges
+ * them into the shared entries at most once every
+ * pg_stat_statements.flush_interval, much as the cumulative statistics
+ * system does with its pending statistics.  A backend's pending entry can
+ * only exist while it believes the shared entry does, so the query text
+ * needs to be stored only on the path that finds no pending entry.
  *
  *
  * Copyright (c) 2008-2024, PostgreSQL Global Development Group
@@ -49,6 +60,7 @@
 
 #include "access/parallel.h"
 #include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
 #include "common/hashfn.h"
 #include "common/int.h"
 #include "executor/instrument.h"
@@ -63,6 +75,7 @@
 #include "parser/scanner.h"
 #include "parser/scansup.h"
 #include "pgstat.h"
+#include "port/pg_bitutils.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/lwlock.h"
@@ -70,6 +83,7 @@
 #include "storage/spin.h"
 #include "tcop/utility.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/timestamp.h"
@@ -84,8 +98,11 @@ PG_MODULE_MAGIC;
  */
 #define PGSS_TEXT_FILE	PG_STAT_TMP_DIR "/pgss_query_texts.stat"
 
+/* Replacement query text file, while being built by garbage collection */
+#define PGSS_TEXT_FILE_TMP	PGSS_TEXT_FILE ".tmp"
+
 /* Magic number identifying the stats file format */
-static const uint32 PGSS_FILE_HEADER = 0x20220408;
+static const uint32 PGSS_FILE_HEADER = 0x20261015;
 
 /* PostgreSQL major version number, changes in which invalidate all entries */
 static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
@@ -100,6 +117,20 @@ static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
 #define USAGE_DEALLOC_PERCENT	5	/* free this % of entries at once */
 #define IS_STICKY(c)	((c.calls[PGSS_PLAN] + c.calls[PGSS_EXEC]) == 0)
 
+/*
+ * Planning and execution times are also counted in log-linear histograms:
+ * times below 2^PGSS_HIST_SUB_BITS microseconds get a bucket each, and each
+ * power-of-two range above that is split into 2^PGSS_HIST_SUB_BITS equal
+ * buckets, up to 2^PGSS_HIST_MAX_BITS microseconds (about 9.5 hours).  Any
+ * bucket is thus at most 25% wider than its lower bound.  Longer times are
+ * counted in the last bucket.
+ */
+#define PGSS_HIST_SUB_BITS		2
+#define PGSS_HIST_SUB			(1 << PGSS_HIST_SUB_BITS)
+#define PGSS_HIST_MAX_BITS		35
+#define PGSS_HIST_NBUCKETS \
+	((PGSS_HIST_MAX_BITS - PGSS_HIST_SUB_BITS + 1) * PGSS_HIST_SUB)
+
 /*
  * Extension version number, for supporting older extension versions' objects
  */
@@ -113,6 +144,7 @@ typedef enum pgssVersion
 	PGSS_V1_9,
 	PGSS_V1_10,
 	PGSS_V1_11,
+	PGSS_V1_12,
 } pgssVersion;
 
 typedef enum pgssStoreKind
@@ -204,6 +236,11 @@ typedef struct Counters
 	int64		jit_emission_count; /* number of times emission time has been
 									 * > 0 */
 	double		jit_emission_time;	/* total time to emit jit code */
+	int64		jit_cache_hits; /* # of jit modules found in the jit cache */
+	int64		jit_cache_misses;	/* # of jit modules missing from the jit
+									 * cache */
+	/* histograms of planning/execution times */
+	int64		time_hist[PGSS_NUMKIND][PGSS_HIST_NBUCKETS];
 } Counters;
 
 /*
@@ -234,12 +271,34 @@ typedef struct pgssEntry
 	slock_t		mutex;			/* protects the counters only */
 } pgssEntry;
 
+/*
+ * Statistics accumulated by this backend and not yet merged into the shared
+ * hashtable
+ */
+typedef struct pgssPendingEntry
+{
+	pgssHashKey key;			/* hash key of entry - MUST BE FIRST */
+	Counters	counters;		/* statistics since the last flush */
+} pgssPendingEntry;
+
+/*
+ * Where garbage collection moved an entry's query text
+ */
+typedef struct pgssTextReloc
+{
+	pgssHashKey key;			/* hash key of entry - MUST BE FIRST */
+	Size		old_offset;		/* offset in the old query text file */
+	Size		new_offset;		/* offset in the compacted file */
+	bool		dropped;		/* text was unreadable and is dropped */
+} pgssTextReloc;
+
 /*
  * Global shared state
  */
 typedef struct pgssSharedState
 {
 	LWLock	   *lock;			/* protects hashtable search/modification */
+	LWLock	   *gc_lock;		/* serializes query text garbage collection */
 	double		cur_median_usage;	/* current median usage in hashtable */
 	Size		mean_query_len; /* current mean entry text length */
 	slock_t		mutex;			/* protects following fields only: */
@@ -269,6 +328,10 @@ static ProcessUtility_hook_type prev_ProcessUtility = NULL;
 static pgssSharedState *pgss = NULL;
 static HTAB *pgss_hash = NULL;
 
+/* Backend-local statistics not yet flushed to the shared hashtable */
+static HTAB *pgss_pending = NULL;
+static TimestampTz pgss_last_flush = 0;
+
 /*---- GUC variables ----*/
 
 typedef enum
@@ -292,6 +355,8 @@ static bool pgss_track_utility = true;	/* whether to track utility commands */
 static bool pgss_track_planning = false;	/* whether to track planning
 											 * duration */
 static bool pgss_save = true;	/* whether to save stats across shutdown */
+static int	pgss_flush_interval = 1000; /* max delay of counter flushes, in
+										 * msec */
 
 
 #define pgss_enabled(level) \
@@ -318,8 +383,10 @@ PG_FUNCTION_INFO_V1(pg_stat_statements_1_8);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_9);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_10);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_11);
+PG_FUNCTION_INFO_V1(pg_stat_statements_1_12);
 PG_FUNCTION_INFO_V1(pg_stat_statements);
 PG_FUNCTION_INFO_V1(pg_stat_statements_info);
+PG_FUNCTION_INFO_V1(pg_stat_statements_percentiles);
 
 static void pgss_shmem_request(void);
 static void pgss_shmem_startup(void);
@@ -349,6 +416,21 @@ static void pgss_store(const char *query, uint64 queryId,
 					   const WalUsage *walusage,
 					   const struct JitInstrumentation *jitusage,
 					   JumbleState *jstate);
+static void pgss_accum_counters(Counters *c, pgssStoreKind kind,
+								double total_time, uint64 rows,
+								const BufferUsage *bufusage,
+								const WalUsage *walusage,
+								const struct JitInstrumentation *jitusage);
+static void pgss_merge_counters(Counters *dst, const Counters *src);
+static int	pgss_hist_bucket(double time);
+static double pgss_hist_bound(int bucket);
+static double pgss_hist_percentile(const Counters *c, pgssStoreKind kind,
+								   double fraction);
+static pgssPendingEntry *pgss_pending_entry(pgssHashKey *key);
+static bool pgss_flush_due(void);
+static void pgss_flush_pending(bool force);
+static void pgss_flush_pending_locked(void);
+static void pgss_pending_shutdown(int code, Datum arg);
 static void pg_stat_statements_internal(FunctionCallInfo fcinfo,
 										pgssVersion api_version,
 										bool showtext);
@@ -455,6 +537,19 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomIntVariable("pg_stat_statements.flush_interval",
+							"Sets the maximum delay before a session's statistics are visible in pg_stat_statements.",
+							"0 makes every execution update the shared statistics immediately.",
+							&pgss_flush_interval,
+							1000,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
 	MarkGUCPrefixReserved("pg_stat_statements");
 
 	/*
@@ -491,7 +586,7 @@ pgss_shmem_request(void)
 		prev_shmem_request_hook();
 
 	RequestAddinShmemSpace(pgss_memsize());
-	RequestNamedLWLockTranche("pg_stat_statements", 1);
+	RequestNamedLWLockTranche("pg_stat_statements", 2);
 }
 
 /*
@@ -533,7 +628,10 @@ pgss_shmem_startup(void)
 	if (!found)
 	{
 		/* First time through ... */
-		pgss->lock = &(GetNamedLWLockTranche("pg_stat_statements"))->lock;
+		LWLockPadded *locks = GetNamedLWLockTranche("pg_stat_statements");
+
+		pgss->lock = &locks[0].lock;
+		pgss->gc_lock = &locks[1].lock;
 		pgss->cur_median_usage = ASSUMED_MEDIAN_INIT;
 		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 		SpinLockInit(&pgss->mutex);
@@ -571,8 +669,9 @@ pgss_shmem_startup(void)
 	 * processes running when this code is reached.
 	 */
 
-	/* Unlink query text file possibly left over from crash */
+	/* Unlink query text files possibly left over from crash */
 	unlink(PGSS_TEXT_FILE);
+	unlink(PGSS_TEXT_FILE_TMP);
 
 	/* Allocate new query text temp file */
 	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
@@ -1282,8 +1381,10 @@ pgss_store(const char *query, uint64 queryId,
 {
 	pgssHashKey key;
 	pgssEntry  *entry;
+	pgssPendingEntry *pending;
 	char	   *norm_query = NULL;
 	int			encoding = GetDatabaseEncoding();
+	bool		do_gc = false;
 
 	Assert(query != NULL);
 
@@ -1298,13 +1399,6 @@ pgss_store(const char *query, uint64 queryId,
 	if (queryId == UINT64CONST(0))
 		return;
 
-	/*
-	 * Confine our attention to the relevant part of the string, if the query
-	 * is a portion of a multi-statement source string, and update query
-	 * location and length if needed.
-	 */
-	query = CleanQuerytext(query, &query_location, &query_len);
-
 	/* Set up key for hashtable search */
 
 	/* clear padding */
@@ -1315,6 +1409,34 @@ pgss_store(const char *query, uint64 queryId,
 	key.queryid = queryId;
 	key.toplevel = (nesting_level == 0);
 
+	/*
+	 * If we already have pending statistics for this entry, the shared entry
+	 * and its query text existed when we started them, so there's no need to
+	 * look at shared memory at all: just accumulate locally.
+	 */
+	if (pgss_pending)
+	{
+		pending = (pgssPendingEntry *) hash_search(pgss_pending, &key,
+												   HASH_FIND, NULL);
+		if (pending)
+		{
+			if (!jstate)
+			{
+				pgss_accum_counters(&pending->counters, kind, total_time, rows,
+									bufusage, walusage, jitusage);
+				pgss_flush_pending(false);
+			}
+			return;
+		}
+	}
+
+	/*
+	 * Confine our attention to the relevant part of the string, if the query
+	 * is a portion of a multi-statement source string, and update query
+	 * location and length if needed.
+	 */
+	query = CleanQuerytext(query, &query_location, &query_len);
+
 	/* Lookup the hash table entry with shared lock. */
 	LWLockAcquire(pgss->lock, LW_SHARED);
 
@@ -1326,7 +1448,6 @@ pgss_store(const char *query, uint64 queryId,
 		Size		query_offset;
 		int			gc_count;
 		bool		stored;
-		bool		do_gc;
 
 		/*
 		 * Create a new, normalized query string if caller asked.  We don't
@@ -1377,121 +1498,413 @@ pgss_store(const char *query, uint64 queryId,
 		/* OK to create a new hashtable entry */
 		entry = entry_alloc(&key, query_offset, query_len, encoding,
 							jstate != NULL);
-
-		/* If needed, perform garbage collection while exclusive lock held */
-		if (do_gc)
-			gc_qtexts();
 	}
 
 	/* Increment the counts, except when jstate is not NULL */
 	if (!jstate)
+	{
+		Assert(kind == PGSS_PLAN || kind == PGSS_EXEC);
+
+		pending = pgss_pending_entry(&key);
+		pgss_accum_counters(&pending->counters, kind, total_time, rows,
+							bufusage, walusage, jitusage);
+
+		/* If a flush is due, do it now that we hold the lock anyway */
+		if (pgss_flush_due())
+			pgss_flush_pending_locked();
+	}
+
+done:
+	LWLockRelease(pgss->lock);
+
+	/* We postpone this clean-up until we're out of the lock */
+	if (norm_query)
+		pfree(norm_query);
+
+	/* Likewise garbage collection, which acquires the lock itself */
+	if (do_gc)
+		gc_qtexts();
+}
+
+/*
+ * Accumulate the statistics of one planning or execution into *c.
+ */
+static void
+pgss_accum_counters(Counters *c, pgssStoreKind kind,
+					double total_time, uint64 rows,
+					const BufferUsage *bufusage,
+					const WalUsage *walusage,
+					const struct JitInstrumentation *jitusage)
+{
+	c->calls[kind] += 1;
+	c->total_time[kind] += total_time;
+	c->time_hist[kind][pgss_hist_bucket(total_time)]++;
+
+	if (c->calls[kind] == 1)
+	{
+		c->min_time[kind] = total_time;
+		c->max_time[kind] = total_time;
+		c->mean_time[kind] = total_time;
+	}
+	else
 	{
 		/*
-		 * Grab the spinlock while updating the counters (see comment about
-		 * locking rules at the head of the file)
+		 * Welford's method for accurately computing variance. See
+		 * <http://www.johndcook.com/blog/standard_deviation/>
 		 */
-		volatile pgssEntry *e = (volatile pgssEntry *) entry;
+		double		old_mean = c->mean_time[kind];
+
+		c->mean_time[kind] +=
+			(total_time - old_mean) / c->calls[kind];
+		c->sum_var_time[kind] +=
+			(total_time - old_mean) * (total_time - c->mean_time[kind]);
+
+		/* Calculate min and max time */
+		if (c->min_time[kind] > total_time)
+			c->min_time[kind] = total_time;
+		if (c->max_time[kind] < total_time)
+			c->max_time[kind] = total_time;
+	}
+	c->rows += rows;
+	c->shared_blks_hit += bufusage->shared_blks_hit;
+	c->shared_blks_read += bufusage->shared_blks_read;
+	c->shared_blks_dirtied += bufusage->shared_blks_dirtied;
+	c->shared_blks_written += bufusage->shared_blks_written;
+	c->local_blks_hit += bufusage->local_blks_hit;
+	c->local_blks_read += bufusage->local_blks_read;
+	c->local_blks_dirtied += bufusage->local_blks_dirtied;
+	c->local_blks_written += bufusage->local_blks_written;
+	c->temp_blks_read += bufusage->temp_blks_read;
+	c->temp_blks_written += bufusage->temp_blks_written;
+	c->shared_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->shared_blk_read_time);
+	c->shared_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->shared_blk_write_time);
+	c->local_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->local_blk_read_time);
+	c->local_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->local_blk_write_time);
+	c->temp_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->temp_blk_read_time);
+	c->temp_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->temp_blk_write_time);
+	c->usage += USAGE_EXEC(total_time);
+	c->wal_records += walusage->wal_records;
+	c->wal_fpi += walusage->wal_fpi;
+	c->wal_bytes += walusage->wal_bytes;
+	if (jitusage)
+	{
+		c->jit_functions += jitusage->created_functions;
+		c->jit_generation_time += INSTR_TIME_GET_MILLISEC(jitusage->generation_counter);
 
-		Assert(kind == PGSS_PLAN || kind == PGSS_EXEC);
+		if (INSTR_TIME_GET_MILLISEC(jitusage->deform_counter))
+			c->jit_deform_count++;
+		c->jit_deform_time += INSTR_TIME_GET_MILLISEC(jitusage->deform_counter);
+
+		if (INSTR_TIME_GET_MILLISEC(jitusage->inlining_counter))
+			c->jit_inlining_count++;
+		c->jit_inlining_time += INSTR_TIME_GET_MILLISEC(jitusage->inlining_counter);
+
+		if (INSTR_TIME_GET_MILLISEC(jitusage->optimization_counter))
+			c->jit_optimization_count++;
+		c->jit_optimization_time += INSTR_TIME_GET_MILLISEC(jitusage->optimization_counter);
+
+		if (INSTR_TIME_GET_MILLISEC(jitusage->emission_counter))
+			c->jit_emission_count++;
+		c->jit_emission_time += INSTR_TIME_GET_MILLISEC(jitusage->emission_counter);
+
+		c->jit_cache_hits += jitusage->cache_hits;
+		c->jit_cache_misses += jitusage->cache_misses;
+	}
+}
 
-		SpinLockAcquire(&e->mutex);
+/*
+ * Merge the pending statistics *src into the shared entry's counters *dst.
+ * Caller must hold the entry's mutex.
+ */
+static void
+pgss_merge_counters(Counters *dst, const Counters *src)
+{
+	/* "Unstick" entry if it was previously sticky */
+	if (IS_STICKY((*dst)))
+		dst->usage = USAGE_INIT;
 
-		/* "Unstick" entry if it was previously sticky */
-		if (IS_STICKY(e->counters))
-			e->counters.usage = USAGE_INIT;
+	for (int kind = 0; kind < PGSS_NUMKIND; kind++)
+	{
+		double		n_a = dst->calls[kind];
+		double		n_b = src->calls[kind];
 
-		e->counters.calls[kind] += 1;
-		e->counters.total_time[kind] += total_time;
+		if (src->calls[kind] == 0)
+			continue;
 
-		if (e->counters.calls[kind] == 1)
+		if (dst->calls[kind] == 0)
 		{
-			e->counters.min_time[kind] = total_time;
-			e->counters.max_time[kind] = total_time;
-			e->counters.mean_time[kind] = total_time;
+			dst->mean_time[kind] = src->mean_time[kind];
+			dst->sum_var_time[kind] = src->sum_var_time[kind];
 		}
 		else
 		{
 			/*
-			 * Welford's method for accurately computing variance. See
-			 * <http://www.johndcook.com/blog/standard_deviation/>
+			 * Combine the means and variances of the two samples, using the
+			 * pairwise form of Welford's method (Chan et al.).
 			 */
-			double		old_mean = e->counters.mean_time[kind];
+			double		delta = src->mean_time[kind] - dst->mean_time[kind];
 
-			e->counters.mean_time[kind] +=
-				(total_time - old_mean) / e->counters.calls[kind];
-			e->counters.sum_var_time[kind] +=
-				(total_time - old_mean) * (total_time - e->counters.mean_time[kind]);
+			dst->mean_time[kind] += delta * n_b / (n_a + n_b);
+			dst->sum_var_time[kind] += src->sum_var_time[kind] +
+				delta * delta * n_a * n_b / (n_a + n_b);
+		}
 
-			/*
-			 * Calculate min and max time. min = 0 and max = 0 means that the
-			 * min/max statistics were reset
-			 */
-			if (e->counters.min_time[kind] == 0
-				&& e->counters.max_time[kind] == 0)
-			{
-				e->counters.min_time[kind] = total_time;
-				e->counters.max_time[kind] = total_time;
-			}
-			else
-			{
-				if (e->counters.min_time[kind] > total_time)
-					e->counters.min_time[kind] = total_time;
-				if (e->counters.max_time[kind] < total_time)
-					e->counters.max_time[kind] = total_time;
-			}
+		/*
+		 * min = 0 and max = 0 means that the min/max statistics were reset
+		 */
+		if (dst->min_time[kind] == 0 && dst->max_time[kind] == 0)
+		{
+			dst->min_time[kind] = src->min_time[kind];
+			dst->max_time[kind] = src->max_time[kind];
 		}
-		e->counters.rows += rows;
-		e->counters.shared_blks_hit += bufusage->shared_blks_hit;
-		e->counters.shared_blks_read += bufusage->shared_blks_read;
-		e->counters.shared_blks_dirtied += bufusage->shared_blks_dirtied;
-		e->counters.shared_blks_written += bufusage->shared_blks_written;
-		e->counters.local_blks_hit += bufusage->local_blks_hit;
-		e->counters.local_blks_read += bufusage->local_blks_read;
-		e->counters.local_blks_dirtied += bufusage->local_blks_dirtied;
-		e->counters.local_blks_written += bufusage->local_blks_written;
-		e->counters.temp_blks_read += bufusage->temp_blks_read;
-		e->counters.temp_blks_written += bufusage->temp_blks_written;
-		e->counters.shared_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->shared_blk_read_time);
-		e->counters.shared_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->shared_blk_write_time);
-		e->counters.local_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->local_blk_read_time);
-		e->counters.local_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->local_blk_write_time);
-		e->counters.temp_blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->temp_blk_read_time);
-		e->counters.temp_blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->temp_blk_write_time);
-		e->counters.usage += USAGE_EXEC(total_time);
-		e->counters.wal_records += walusage->wal_records;
-		e->counters.wal_fpi += walusage->wal_fpi;
-		e->counters.wal_bytes += walusage->wal_bytes;
-		if (jitusage)
+		else
 		{
-			e->counters.jit_functions += jitusage->created_functions;
-			e->counters.jit_generation_time += INSTR_TIME_GET_MILLISEC(jitusage->generation_counter);
+			if (dst->min_time[kind] > src->min_time[kind])
+				dst->min_time[kind] = src->min_time[kind];
+			if (dst->max_time[kind] < src->max_time[kind])
+				dst->max_time[kind] = src->max_time[kind];
+		}
+
+		dst->calls[kind] += src->calls[kind];
+		dst->total_time[kind] += src->total_time[kind];
+		for (int b = 0; b < PGSS_HIST_NBUCKETS; b++)
+			dst->time_hist[kind][b] += src->time_hist[kind][b];
+	}
+	dst->rows += src->rows;
+	dst->shared_blks_hit += src->shared_blks_hit;
+	dst->shared_blks_read += src->shared_blks_read;
+	dst->shared_blks_dirtied += src->shared_blks_dirtied;
+	dst->shared_blks_written += src->shared_blks_written;
+	dst->local_blks_hit += src->local_blks_hit;
+	dst->local_blks_read += src->local_blks_read;
+	dst->local_blks_dirtied += src->local_blks_dirtied;
+	dst->local_blks_written += src->local_blks_written;
+	dst->temp_blks_read += src->temp_blks_read;
+	dst->temp_blks_written += src->temp_blks_written;
+	dst->shared_blk_read_time += src->shared_blk_read_time;
+	dst->shared_blk_write_time += src->shared_blk_write_time;
+	dst->local_blk_read_time += src->local_blk_read_time;
+	dst->local_blk_write_time += src->local_blk_write_time;
+	dst->temp_blk_read_time += src->temp_blk_read_time;
+	dst->temp_blk_write_time += src->temp_blk_write_time;
+	dst->usage += src->usage;
+	dst->wal_records += src->wal_records;
+	dst->wal_fpi += src->wal_fpi;
+	dst->wal_bytes += src->wal_bytes;
+	dst->jit_functions += src->jit_functions;
+	dst->jit_generation_time += src->jit_generation_time;
+	dst->jit_deform_count += src->jit_deform_count;
+	dst->jit_deform_time += src->jit_deform_time;
+	dst->jit_inlining_count += src->jit_inlining_count;
+	dst->jit_inlining_time += src->jit_inlining_time;
+	dst->jit_optimization_count += src->jit_optimization_count;
+	dst->jit_optimization_time += src->jit_optimization_time;
+	dst->jit_emission_count += src->jit_emission_count;
+	dst->jit_emission_time += src->jit_emission_time;
+	dst->jit_cache_hits += src->jit_cache_hits;
+	dst->jit_cache_misses += src->jit_cache_misses;
+}
+
+/*
+ * Histogram bucket for a planning or execution time, given in msec.
+ */
+static int
+pgss_hist_bucket(double time)
+{
+	uint64		usec;
+	int			msb;
+
+	/* also catches NaN */
+	if (!(time > 0))
+		return 0;
+	if (time >= (double) (UINT64CONST(1) << PGSS_HIST_MAX_BITS) / 1000.0)
+		return PGSS_HIST_NBUCKETS - 1;
+
+	usec = (uint64) (time * 1000.0);
+	if (usec < PGSS_HIST_SUB)
+		return (int) usec;
+
+	msb = pg_leftmost_one_pos64(usec);
+	return (msb - PGSS_HIST_SUB_BITS + 1) * PGSS_HIST_SUB +
+		(int) ((usec >> (msb - PGSS_HIST_SUB_BITS)) & (PGSS_HIST_SUB - 1));
+}
+
+/*
+ * Lower bound of a histogram bucket, in msec.  PGSS_HIST_NBUCKETS gives the
+ * upper bound of the last bucket.
+ */
+static double
+pgss_hist_bound(int bucket)
+{
+	int			group = bucket / PGSS_HIST_SUB;
+	int			sub = bucket % PGSS_HIST_SUB;
+	int			msb;
+
+	if (group == 0)
+		return sub / 1000.0;
 
-			if (INSTR_TIME_GET_MILLISEC(jitusage->deform_counter))
-				e->counters.jit_deform_count++;
-			e->counters.jit_deform_time += INSTR_TIME_GET_MILLISEC(jitusage->deform_counter);
+	msb = group + PGSS_HIST_SUB_BITS - 1;
+	return (double) ((UINT64CONST(1) << msb) +
+					 ((uint64) sub << (msb - PGSS_HIST_SUB_BITS))) / 1000.0;
+}
+
+/*
+ * Estimate the given percentile (0..1) of the planning or execution times
+ * recorded in *c, in msec, interpolating linearly within the bucket where it
+ * falls.  The result is clamped to the observed min/max times, unless those
+ * have been reset.  Returns -1 if no times have been recorded.
+ */
+static double
+pgss_hist_percentile(const Counters *c, pgssStoreKind kind, double fraction)
+{
+	const int64 *hist = c->time_hist[kind];
+	int64		total = 0;
+	int64		cum = 0;
+	double		rank;
+	double		result = -1;
+
+	for (int b = 0; b < PGSS_HIST_NBUCKETS; b++)
+		total += hist[b];
+	if (total == 0)
+		return -1;
 
-			if (INSTR_TIME_GET_MILLISEC(jitusage->inlining_counter))
-				e->counters.jit_inlining_count++;
-			e->counters.jit_inlining_time += INSTR_TIME_GET_MILLISEC(jitusage->inlining_counter);
+	rank = fraction * total;
+	for (int b = 0; b < PGSS_HIST_NBUCKETS; b++)
+	{
+		if (hist[b] == 0)
+			continue;
 
-			if (INSTR_TIME_GET_MILLISEC(jitusage->optimization_counter))
-				e->counters.jit_optimization_count++;
-			e->counters.jit_optimization_time += INSTR_TIME_GET_MILLISEC(jitusage->optimization_counter);
+		if (cum + hist[b] >= rank)
+		{
+			double		lo = pgss_hist_bound(b);
+			double		hi = pgss_hist_bound(b + 1);
 
-			if (INSTR_TIME_GET_MILLISEC(jitusage->emission_counter))
-				e->counters.jit_emission_count++;
-			e->counters.jit_emission_time += INSTR_TIME_GET_MILLISEC(jitusage->emission_counter);
+			result = lo + (hi - lo) * (rank - cum) / hist[b];
+			break;
 		}
+		cum += hist[b];
+	}
 
-		SpinLockRelease(&e->mutex);
+	if (c->min_time[kind] != 0 || c->max_time[kind] != 0)
+	{
+		result = Max(result, c->min_time[kind]);
+		result = Min(result, c->max_time[kind]);
 	}
 
-done:
+	return result;
+}
+
+/*
+ * Find or create this backend's pending entry for the given key.
+ */
+static pgssPendingEntry *
+pgss_pending_entry(pgssHashKey *key)
+{
+	pgssPendingEntry *pending;
+	bool		found;
+
+	if (pgss_pending == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(pgssHashKey);
+		ctl.entrysize = sizeof(pgssPendingEntry);
+		pgss_pending = hash_create("pg_stat_statements pending", 64,
+								   &ctl, HASH_ELEM | HASH_BLOBS);
+
+		/* Make sure nothing is lost when the backend exits */
+		before_shmem_exit(pgss_pending_shutdown, (Datum) 0);
+	}
+
+	pending = (pgssPendingEntry *) hash_search(pgss_pending, key,
+											   HASH_ENTER, &found);
+	if (!found)
+		memset(&pending->counters, 0, sizeof(Counters));
+
+	return pending;
+}
+
+/*
+ * Is it time to flush this backend's pending statistics?  If so, the flush
+ * is assumed to happen and the clock restarts.
+ */
+static bool
+pgss_flush_due(void)
+{
+	TimestampTz now;
+
+	if (pgss_flush_interval <= 0)
+		return true;
+
+	now = GetCurrentTimestamp();
+	if (!TimestampDifferenceExceeds(pgss_last_flush, now, pgss_flush_interval))
+		return false;
+
+	pgss_last_flush = now;
+	return true;
+}
+
+/*
+ * Flush this backend's pending statistics, if there are any and either
+ * "force" is true or pg_stat_statements.flush_interval has elapsed.
+ */
+static void
+pgss_flush_pending(bool force)
+{
+	if (pgss_pending == NULL || hash_get_num_entries(pgss_pending) == 0)
+		return;
+
+	if (!force && !pgss_flush_due())
+		return;
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
+	pgss_flush_pending_locked();
 	LWLockRelease(pgss->lock);
+}
 
-	/* We postpone this clean-up until we're out of the lock */
-	if (norm_query)
-		pfree(norm_query);
+/*
+ * Merge all of this backend's pending statistics into the shared hashtable.
+ *
+ * Caller must hold pgss->lock, in either mode.  Statistics for entries that
+ * were deallocated or reset since we started accumulating them are discarded;
+ * the next execution of such a query goes through the slow path of
+ * pgss_store() and creates the entry afresh.
+ */
+static void
+pgss_flush_pending_locked(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	pgssPendingEntry *pending;
+
+	hash_seq_init(&hash_seq, pgss_pending);
+	while ((pending = hash_seq_search(&hash_seq)) != NULL)
+	{
+		pgssEntry  *entry;
+
+		entry = (pgssEntry *) hash_search(pgss_hash, &pending->key,
+										  HASH_FIND, NULL);
+		if (entry)
+		{
+			SpinLockAcquire(&entry->mutex);
+			pgss_merge_counters(&entry->counters, &pending->counters);
+			SpinLockRelease(&entry->mutex);
+		}
+
+		hash_search(pgss_pending, &pending->key, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * before_shmem_exit callback: flush whatever is still pending.
+ */
+static void
+pgss_pending_shutdown(int code, Datum arg)
+{
+	/* Can't flush if we died while holding the lock */
+	if (LWLockHeldByMe(pgss->lock))
+		return;
+
+	pgss_flush_pending(true);
 }
 
 /*
@@ -1549,7 +1962,8 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
 #define PG_STAT_STATEMENTS_COLS_V1_9	33
 #define PG_STAT_STATEMENTS_COLS_V1_10	43
 #define PG_STAT_STATEMENTS_COLS_V1_11	49
-#define PG_STAT_STATEMENTS_COLS			49	/* maximum of above */
+#define PG_STAT_STATEMENTS_COLS_V1_12	51
+#define PG_STAT_STATEMENTS_COLS			51	/* maximum of above */
 
 /*
  * Retrieve statement statistics.
@@ -1561,6 +1975,16 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
  * expected API version is identified by embedding it in the C name of the
  * function.  Unfortunately we weren't bright enough to do that for 1.1.
  */
+Datum
+pg_stat_statements_1_12(PG_FUNCTION_ARGS)
+{
+	bool		showtext = PG_GETARG_BOOL(0);
+
+	pg_stat_statements_internal(fcinfo, PGSS_V1_12, showtext);
+
+	return (Datum) 0;
+}
+
 Datum
 pg_stat_statements_1_11(PG_FUNCTION_ARGS)
 {
@@ -1662,6 +2086,9 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 				 errmsg("pg_stat_statements must be loaded via \"shared_preload_libraries\"")));
 
+	/* Make our own session's statistics visible */
+	pgss_flush_pending(true);
+
 	InitMaterializedSRF(fcinfo, 0);
 
 	/*
@@ -1705,6 +2132,10 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			if (api_version != PGSS_V1_11)
 				elog(ERROR, "incorrect number of output arguments");
 			break;
+		case PG_STAT_STATEMENTS_COLS_V1_12:
+			if (api_version != PGSS_V1_12)
+				elog(ERROR, "incorrect number of output arguments");
+			break;
 		default:
 			elog(ERROR, "incorrect number of output arguments");
 	}
@@ -1950,6 +2381,14 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 		{
 			values[i++] = Int64GetDatumFast(tmp.jit_deform_count);
 			values[i++] = Float8GetDatumFast(tmp.jit_deform_time);
+		}
+		if (api_version >= PGSS_V1_12)
+		{
+			values[i++] = Int64GetDatumFast(tmp.jit_cache_hits);
+			values[i++] = Int64GetDatumFast(tmp.jit_cache_misses);
+		}
+		if (api_version >= PGSS_V1_11)
+		{
 			values[i++] = TimestampTzGetDatum(stats_since);
 			values[i++] = TimestampTzGetDatum(minmax_stats_since);
 		}
@@ -1962,6 +2401,7 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 					 api_version == PGSS_V1_9 ? PG_STAT_STATEMENTS_COLS_V1_9 :
 					 api_version == PGSS_V1_10 ? PG_STAT_STATEMENTS_COLS_V1_10 :
 					 api_version == PGSS_V1_11 ? PG_STAT_STATEMENTS_COLS_V1_11 :
+					 api_version == PGSS_V1_12 ? PG_STAT_STATEMENTS_COLS_V1_12 :
 					 -1 /* fail if you forget to update this assert */ ));
 
 		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
@@ -2010,6 +2450,112 @@ pg_stat_statements_info(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
+/* Number of output arguments (columns) for pg_stat_statements_percentiles */
+#define PG_STAT_STATEMENTS_PERCENTILES_COLS	6
+
+/*
+ * Return estimated percentiles of the planning and execution times of each
+ * statement, computed from the time histograms.
+ */
+Datum
+pg_stat_statements_percentiles(PG_FUNCTION_ARGS)
+{
+	ArrayType  *fractions_array = PG_GETARG_ARRAYTYPE_P(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			userid = GetUserId();
+	bool		is_allowed_role;
+	Datum	   *fractions;
+	bool	   *fractions_nulls;
+	int			nfractions;
+	Datum	   *results;
+	HASH_SEQ_STATUS hash_seq;
+	pgssEntry  *entry;
+
+	is_allowed_role = has_privs_of_role(userid, ROLE_PG_READ_ALL_STATS);
+
+	if (!pgss || !pgss_hash)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_stat_statements must be loaded via \"shared_preload_libraries\"")));
+
+	deconstruct_array_builtin(fractions_array, FLOAT8OID,
+							  &fractions, &fractions_nulls, &nfractions);
+	for (int i = 0; i < nfractions; i++)
+	{
+		double		fraction;
+
+		if (fractions_nulls[i])
+			ereport(ERROR,
+					(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+					 errmsg("percentile value cannot be null")));
+
+		fraction = DatumGetFloat8(fractions[i]);
+		if (fraction < 0 || fraction > 1 || isnan(fraction))
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("percentile value %g is not between 0 and 1",
+							fraction)));
+	}
+	results = palloc(Max(nfractions, 1) * sizeof(Datum));
+
+	/* Make our own session's statistics visible */
+	pgss_flush_pending(true);
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
+
+	hash_seq_init(&hash_seq, pgss_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[PG_STAT_STATEMENTS_PERCENTILES_COLS] = {0};
+		bool		nulls[PG_STAT_STATEMENTS_PERCENTILES_COLS] = {0};
+		int			i = 0;
+		Counters	tmp;
+
+		/* copy counters to a local variable to keep locking time short */
+		SpinLockAcquire(&entry->mutex);
+		tmp = entry->counters;
+		SpinLockRelease(&entry->mutex);
+
+		/* Skip entry if unexecuted (ie, it's a pending "sticky" entry) */
+		if (IS_STICKY(tmp))
+			continue;
+
+		values[i++] = ObjectIdGetDatum(entry->key.userid);
+		values[i++] = ObjectIdGetDatum(entry->key.dbid);
+		values[i++] = BoolGetDatum(entry->key.toplevel);
+		if (is_allowed_role || entry->key.userid == userid)
+			values[i++] = Int64GetDatum((int64) entry->key.queryid);
+		else
+			nulls[i++] = true;
+
+		for (int kind = 0; kind < PGSS_NUMKIND; kind++)
+		{
+			if (tmp.calls[kind] == 0)
+			{
+				nulls[i++] = true;
+				continue;
+			}
+
+			for (int j = 0; j < nfractions; j++)
+				results[j] = Float8GetDatum(pgss_hist_percentile(&tmp, kind,
+																 DatumGetFloat8(fractions[j])));
+			values[i++] = PointerGetDatum(construct_array_builtin(results,
+																  nfractions,
+																  FLOAT8OID));
+		}
+
+		Assert(i == PG_STAT_STATEMENTS_PERCENTILES_COLS);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	LWLockRelease(pgss->lock);
+
+	return (Datum) 0;
+}
+
 /*
  * Estimate shared memory space needed.
  */
@@ -2449,7 +2995,16 @@ need_gc_qtexts(void)
  * becomes unreasonably large, with no other method of compaction likely to
  * occur in the foreseeable future.
  *
- * The caller must hold an exclusive lock on pgss->lock.
+ * So as not to stall every other session for the duration of a rewrite, the
+ * live texts are copied into a new file while holding pgss->lock only in
+ * shared mode.  That keeps entries from being created or removed, but lets
+ * counters be updated and new texts be appended to the old file.  Exclusive
+ * lock is then held just long enough to copy the texts of entries created
+ * in the meantime, rename the new file into place and update the offsets.
+ * Only one process garbage-collects at a time; others find pgss->gc_lock
+ * taken and leave it to that process.
+ *
+ * The caller must not hold pgss->lock.
  *
  * At the first sign of trouble we unlink the query text file to get a clean
  * slate (although existing statistics are retained), rather than risk
@@ -2458,21 +3013,39 @@ need_gc_qtexts(void)
 static void
 gc_qtexts(void)
 {
-	char	   *qbuffer;
+	char	   *qbuffer = NULL;
 	Size		qbuffer_size;
 	FILE	   *qfile = NULL;
+	int			fd = -1;
+	bool		exclusive = false;
+	HASHCTL		ctl;
+	HTAB	   *relocs;
 	HASH_SEQ_STATUS hash_seq;
 	pgssEntry  *entry;
+	pgssTextReloc *reloc;
 	Size		extent;
 	int			nentries;
+	int			gc_count;
+
+	if (!LWLockConditionalAcquire(pgss->gc_lock, LW_EXCLUSIVE))
+		return;
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
 
 	/*
-	 * When called from pgss_store, some other session might have proceeded
-	 * with garbage collection in the no-lock-held interim of lock strength
-	 * escalation.  Check once more that this is actually necessary.
+	 * Some other session might have proceeded with garbage collection since
+	 * our caller decided it was needed.  Check once more that this is
+	 * actually necessary.
 	 */
 	if (!need_gc_qtexts())
+	{
+		LWLockRelease(pgss->lock);
+		LWLockRelease(pgss->gc_lock);
 		return;
+	}
+
+	/* gc_count only changes under exclusive lock, so no need for the mutex */
+	gc_count = pgss->gc_count;
 
 	/*
 	 * Load the old texts file.  If we fail (out of memory, for instance),
@@ -2485,22 +3058,23 @@ gc_qtexts(void)
 	if (qbuffer == NULL)
 		goto gc_fail;
 
-	/*
-	 * We overwrite the query texts file in place, so as to reduce the risk of
-	 * an out-of-disk-space failure.  Since the file is guaranteed not to get
-	 * larger, this should always work on traditional filesystems; though we
-	 * could still lose on copy-on-write filesystems.
-	 */
-	qfile = AllocateFile(PGSS_TEXT_FILE, PG_BINARY_W);
+	qfile = AllocateFile(PGSS_TEXT_FILE_TMP, PG_BINARY_W);
 	if (qfile == NULL)
 	{
 		ereport(LOG,
 				(errcode_for_file_access(),
 				 errmsg("could not write file \"%s\": %m",
-						PGSS_TEXT_FILE)));
+						PGSS_TEXT_FILE_TMP)));
 		goto gc_fail;
 	}
 
+	ctl.keysize = sizeof(pgssHashKey);
+	ctl.entrysize = sizeof(pgssTextReloc);
+	ctl.hcxt = CurrentMemoryContext;
+	relocs = hash_create("pg_stat_statements text relocations",
+						 hash_get_num_entries(pgss_hash), &ctl,
+						 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
 	extent = 0;
 	nentries = 0;
 
@@ -2513,49 +3087,166 @@ gc_qtexts(void)
 									  qbuffer,
 									  qbuffer_size);
 
+		/* Unreadable texts get another chance below */
 		if (qry == NULL)
-		{
-			/* Trouble ... drop the text */
-			entry->query_offset = 0;
-			entry->query_len = -1;
-			/* entry will not be counted in mean query length computation */
 			continue;
-		}
 
 		if (fwrite(qry, 1, query_len + 1, qfile) != query_len + 1)
 		{
 			ereport(LOG,
 					(errcode_for_file_access(),
 					 errmsg("could not write file \"%s\": %m",
-							PGSS_TEXT_FILE)));
+							PGSS_TEXT_FILE_TMP)));
 			hash_seq_term(&hash_seq);
 			goto gc_fail;
 		}
 
-		entry->query_offset = extent;
+		reloc = (pgssTextReloc *) hash_search(relocs, &entry->key,
+											  HASH_ENTER, NULL);
+		reloc->old_offset = entry->query_offset;
+		reloc->new_offset = extent;
+		reloc->dropped = false;
 		extent += query_len + 1;
 		nentries++;
 	}
 
+	free(qbuffer);
+	qbuffer = NULL;
+
+	/* Promote to exclusive lock to install the new file */
+	LWLockRelease(pgss->lock);
+	LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
+	exclusive = true;
+
+	/*
+	 * If the texts were reset in the interim, our copy is stale and there is
+	 * nothing left to collect anyway.
+	 */
+	if (pgss->gc_count != gc_count)
+	{
+		FreeFile(qfile);
+		(void) unlink(PGSS_TEXT_FILE_TMP);
+		hash_destroy(relocs);
+		LWLockRelease(pgss->lock);
+		LWLockRelease(pgss->gc_lock);
+		return;
+	}
+
 	/*
-	 * Truncate away any now-unused space.  If this fails for some odd reason,
-	 * we log it, but there's no need to fail.
+	 * Copy the texts of entries we haven't seen above, reading them directly
+	 * from the old file.  These are entries created since we started, plus
+	 * any whose text we couldn't fetch from our snapshot of the file.  We
+	 * don't touch the hashtable entries until the new file is in place, so
+	 * that an error thrown here leaves everything consistent.
 	 */
-	if (ftruncate(fileno(qfile), extent) != 0)
+	fd = OpenTransientFile(PGSS_TEXT_FILE, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
 		ereport(LOG,
 				(errcode_for_file_access(),
-				 errmsg("could not truncate file \"%s\": %m",
+				 errmsg("could not read file \"%s\": %m",
 						PGSS_TEXT_FILE)));
+		goto gc_fail;
+	}
+
+	hash_seq_init(&hash_seq, pgss_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		int			query_len = entry->query_len;
+		bool		found;
+		char	   *qry;
+
+		if (query_len < 0)
+			continue;
+
+		reloc = (pgssTextReloc *) hash_search(relocs, &entry->key,
+											  HASH_ENTER, &found);
+		if (found && reloc->old_offset == entry->query_offset)
+			continue;
+
+		reloc->old_offset = entry->query_offset;
+		reloc->new_offset = extent;
+		reloc->dropped = true;
+
+		qry = palloc_extended(query_len + 1,
+							  MCXT_ALLOC_HUGE | MCXT_ALLOC_NO_OOM);
+		if (qry == NULL)
+			continue;
+
+		if (pg_pread(fd, qry, query_len + 1, entry->query_offset) != query_len + 1 ||
+			qry[query_len] != '\0')
+		{
+			/* Trouble ... drop the text */
+			pfree(qry);
+			continue;
+		}
+
+		if (fwrite(qry, 1, query_len + 1, qfile) != query_len + 1)
+		{
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not write file \"%s\": %m",
+							PGSS_TEXT_FILE_TMP)));
+			pfree(qry);
+			hash_seq_term(&hash_seq);
+			goto gc_fail;
+		}
+		pfree(qry);
+
+		reloc->dropped = false;
+		extent += query_len + 1;
+		nentries++;
+	}
+
+	CloseTransientFile(fd);
+	fd = -1;
 
 	if (FreeFile(qfile))
 	{
 		ereport(LOG,
 				(errcode_for_file_access(),
 				 errmsg("could not write file \"%s\": %m",
-						PGSS_TEXT_FILE)));
+						PGSS_TEXT_FILE_TMP)));
 		qfile = NULL;
 		goto gc_fail;
 	}
+	qfile = NULL;
+
+	/*
+	 * Readers that loaded the old file without holding the lock will notice
+	 * the change of gc_count below and reload.
+	 */
+	if (rename(PGSS_TEXT_FILE_TMP, PGSS_TEXT_FILE) != 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						PGSS_TEXT_FILE_TMP, PGSS_TEXT_FILE)));
+		goto gc_fail;
+	}
+
+	/* Point the entries into the new file */
+	hash_seq_init(&hash_seq, pgss_hash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		if (entry->query_len < 0)
+			continue;
+
+		reloc = (pgssTextReloc *) hash_search(relocs, &entry->key,
+											  HASH_FIND, NULL);
+		Assert(reloc != NULL && reloc->old_offset == entry->query_offset);
+
+		if (reloc->dropped)
+		{
+			entry->query_offset = 0;
+			entry->query_len = -1;
+			/* entry will not be counted in mean query length computation */
+		}
+		else
+			entry->query_offset = reloc->new_offset;
+	}
+
+	hash_destroy(relocs);
 
 	elog(DEBUG1, "pgss gc of queries file shrunk size from %zu to %zu",
 		 pgss->extent, extent);
@@ -2572,24 +3263,34 @@ gc_qtexts(void)
 	else
 		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 
-	free(qbuffer);
-
 	/*
 	 * OK, count a garbage collection cycle.  (Note: even though we have
 	 * exclusive lock on pgss->lock, we must take pgss->mutex for this, since
 	 * other processes may examine gc_count while holding only the mutex.
-	 * Also, we have to advance the count *after* we've rewritten the file,
+	 * Also, we have to advance the count *after* we've replaced the file,
 	 * else other processes might not realize they read a stale file.)
 	 */
 	record_gc_qtexts();
 
+	LWLockRelease(pgss->lock);
+	LWLockRelease(pgss->gc_lock);
+
 	return;
 
 gc_fail:
 	/* clean up resources */
 	if (qfile)
 		FreeFile(qfile);
+	if (fd >= 0)
+		CloseTransientFile(fd);
 	free(qbuffer);
+	(void) unlink(PGSS_TEXT_FILE_TMP);
+
+	if (!exclusive)
+	{
+		LWLockRelease(pgss->lock);
+		LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
+	}
 
 	/*
 	 * Since the contents of the external file are now uncertain, mark all
@@ -2633,6 +3334,9 @@ gc_fail:
 	 * pgss->lock acquired in shared or exclusive mode respectively.)
 	 */
 	record_gc_qtexts();
+
+	LWLockRelease(pgss->lock);
+	LWLockRelease(pgss->gc_lock);
 }
 
 #define SINGLE_ENTRY_RESET(e) \
@@ -2673,6 +3377,9 @@ entry_reset(Oid userid, Oid dbid, uint64 queryid, bool minmax_only)
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 				 errmsg("pg_stat_statements must be loaded via \"shared_preload_libraries\"")));
 
+	/* Our own pending statistics predate the reset, so flush them first */
+	pgss_flush_pending(true);
+
 	LWLockAcquire(pgss->lock, LW_EXCLUSIVE);
 	num_entries = hash_get_num_entries(pgss_hash);
 
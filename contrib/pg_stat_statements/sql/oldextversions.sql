@@ -58,4 +58,13 @@ SELECT count(*) > 0 AS has_data FROM pg_stat_statements;
 SELECT pg_get_functiondef('pg_stat_statements_reset'::regproc);
 SELECT pg_stat_statements_reset() IS NOT NULL AS t;
 
+-- New JIT cache columns in pg_stat_statements in 1.12
+AlTER EXTENSION pg_stat_statements UPDATE TO '1.12';
+\d pg_stat_statements
+SELECT count(*) > 0 AS has_data FROM pg_stat_statements;
+
+-- New function pg_stat_statements_percentiles in 1.13
+AlTER EXTENSION pg_stat_statements UPDATE TO '1.13';
+SELECT count(*) > 0 AS has_data FROM pg_stat_statements_percentiles();
+
 DROP EXTENSION pg_stat_statements;
@@ -7,6 +7,7 @@
 #include "access/gist.h"
 #include "access/itup.h"
 #include "access/stratnum.h"
+#include "common/int.h"
 #include "storage/bufpage.h"
 
 /*
@@ -41,9 +42,15 @@
 
 typedef char trgm[3];
 
-#define CMPCHAR(a,b) ( ((a)==(b)) ? 0 : ( ((a)<(b)) ? -1 : 1 ) )
-#define CMPPCHAR(a,b,i)  CMPCHAR( *(((const char*)(a))+i), *(((const char*)(b))+i) )
-#define CMPTRGM(a,b) ( CMPPCHAR(a,b,0) ? CMPPCHAR(a,b,0) : ( CMPPCHAR(a,b,1) ? CMPPCHAR(a,b,1) : CMPPCHAR(a,b,2) ) )
+/*
+ * Trigrams are ordered by comparing their bytes as (platform-dependent)
+ * "char"s, since that is what the on-disk sorted arrays were built with.
+ * TRGMKEY packs a trigram into an integer that sorts the same way, so that a
+ * comparison costs a single integer compare.
+ */
+#define TRGMCHARKEY(a,i)	((uint32) ((int) (((const char *) (a))[i]) - CHAR_MIN))
+#define TRGMKEY(a)	((TRGMCHARKEY(a,0) << 16) | (TRGMCHARKEY(a,1) << 8) | TRGMCHARKEY(a,2))
+#define CMPTRGM(a,b) pg_cmp_u32(TRGMKEY(a), TRGMKEY(b))
 
 #define CPTRGM(a,b) do {				\
 	*(((char*)(a))+0) = *(((char*)(b))+0);	\
@@ -166,6 +166,52 @@ comp_trgm(const void *a, const void *b)
 	return CMPTRGM(a, b);
 }
 
+#ifdef IGNORECASE
+/*
+ * Case-fold a word consisting of ASCII characters only into dst, without
+ * the overhead of lowerstr_with_len().  Returns false if the word contains
+ * other characters, or if the database's locale does not lower-case every
+ * ASCII character to a single ASCII character.
+ */
+static bool
+lower_ascii_word(char *dst, const char *src, int len)
+{
+	static bool initialized = false;
+	static bool usable = false;
+	static char lower_map[128];
+
+	if (!initialized)
+	{
+		usable = true;
+		for (int c = 1; c < 128; c++)
+		{
+			char		ch = (char) c;
+			char	   *lowered = lowerstr_with_len(&ch, 1);
+
+			if (strlen(lowered) != 1 || IS_HIGHBIT_SET(lowered[0]))
+				usable = false;
+			lower_map[c] = lowered[0];
+			pfree(lowered);
+		}
+		initialized = true;
+	}
+
+	if (!usable)
+		return false;
+
+	for (int i = 0; i < len; i++)
+	{
+		unsigned char c = (unsigned char) src[i];
+
+		if (IS_HIGHBIT_SET(c) || c == '\0')
+			return false;
+		dst[i] = lower_map[c];
+	}
+
+	return true;
+}
+#endif
+
 /*
  * Finds first word in string, returns pointer to the word,
  * endword points to the character after word
@@ -303,16 +349,17 @@ generate_trgm_only(trgm *trg, char *str, int slen, TrgmBound *bounds)
 	while ((bword = find_word(eword, slen - (eword - str), &eword, &charlen)) != NULL)
 	{
 #ifdef IGNORECASE
-		bword = lowerstr_with_len(bword, eword - bword);
-		bytelen = strlen(bword);
+		bytelen = eword - bword;
+		if (!lower_ascii_word(buf + LPADDING, bword, bytelen))
+		{
+			bword = lowerstr_with_len(bword, bytelen);
+			bytelen = strlen(bword);
+			memcpy(buf + LPADDING, bword, bytelen);
+			pfree(bword);
+		}
 #else
 		bytelen = eword - bword;
-#endif
-
 		memcpy(buf + LPADDING, bword, bytelen);
-
-#ifdef IGNORECASE
-		pfree(bword);
 #endif
 
 		buf[LPADDING + bytelen] = ' ';
@@ -1009,19 +1056,22 @@ cnt_sml(TRGM *trg1, TRGM *trg2, bool inexact)
 	if (len1 <= 0 || len2 <= 0)
 		return (float4) 0.0;
 
-	while (ptr1 - GETARR(trg1) < len1 && ptr2 - GETARR(trg2) < len2)
+	/*
+	 * Intersect the sorted arrays.  This is written without data-dependent
+	 * branches, which the CPU could only guess at.
+	 */
 	{
-		int			res = CMPTRGM(ptr1, ptr2);
+		int			i = 0,
+					j = 0;
 
-		if (res < 0)
-			ptr1++;
-		else if (res > 0)
-			ptr2++;
-		else
+		while (i < len1 && j < len2)
 		{
-			ptr1++;
-			ptr2++;
-			count++;
+			uint32		key1 = TRGMKEY(ptr1 + i);
+			uint32		key2 = TRGMKEY(ptr2 + j);
+
+			count += (key1 == key2);
+			i += (key1 <= key2);
+			j += (key1 >= key2);
 		}
 	}
 
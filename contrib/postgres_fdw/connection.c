@@ -257,9 +257,11 @@ GetConnection(UserMapping *user, bool will_prep_stmt, PgFdwConnState **state)
 	 */
 	PG_TRY();
 	{
-		/* Process a pending asynchronous request if any. */
+		/* Process a pending asynchronous request or prefetch if any. */
 		if (entry->state.pendingAreq)
 			process_pending_request(entry->state.pendingAreq);
+		if (entry->state.pendingPrefetch)
+			process_pending_prefetch(entry->state.pendingPrefetch);
 		/* Start a new transaction or subtransaction if needed. */
 		begin_remote_xact(entry);
 	}
@@ -834,9 +836,11 @@ GetPrepStmtNumber(PGconn *conn)
 PGresult *
 pgfdw_exec_query(PGconn *conn, const char *query, PgFdwConnState *state)
 {
-	/* First, process a pending asynchronous request, if any. */
+	/* First, process a pending asynchronous request or prefetch, if any. */
 	if (state && state->pendingAreq)
 		process_pending_request(state->pendingAreq);
+	if (state && state->pendingPrefetch)
+		process_pending_prefetch(state->pendingPrefetch);
 
 	if (!PQsendQuery(conn, query))
 		return NULL;
@@ -1636,8 +1640,9 @@ pgfdw_abort_cleanup(ConnCacheEntry *entry, bool toplevel)
 	 * an asynchronous fetch begun by fetch_more_data_begin() was not done
 	 * successfully and thus the per-connection state was not reset in
 	 * fetch_more_data(); in that case reset the per-connection state here.
+	 * Likewise for a prefetch that was never collected.
 	 */
-	if (entry->state.pendingAreq)
+	if (entry->state.pendingAreq || entry->state.pendingPrefetch)
 		memset(&entry->state, 0, sizeof(entry->state));
 
 	/* Disarm changing_xact_state if it all worked */
@@ -1923,7 +1928,7 @@ pgfdw_finish_abort_cleanup(List *pending_entries, List *cancel_requested,
 		}
 
 		/* Reset the per-connection state if needed */
-		if (entry->state.pendingAreq)
+		if (entry->state.pendingAreq || entry->state.pendingPrefetch)
 			memset(&entry->state, 0, sizeof(entry->state));
 
 		/* We're done with this entry; unset the changing_xact_state flag */
@@ -1968,7 +1973,7 @@ pgfdw_finish_abort_cleanup(List *pending_entries, List *cancel_requested,
 		entry->have_error = false;
 
 		/* Reset the per-connection state if needed */
-		if (entry->state.pendingAreq)
+		if (entry->state.pendingAreq || entry->state.pendingPrefetch)
 			memset(&entry->state, 0, sizeof(entry->state));
 
 		/* We're done with this entry; unset the changing_xact_state flag */
@@ -124,6 +124,8 @@ postgres_fdw_validator(PG_FUNCTION_ARGS)
 			strcmp(def->defname, "updatable") == 0 ||
 			strcmp(def->defname, "truncatable") == 0 ||
 			strcmp(def->defname, "async_capable") == 0 ||
+			strcmp(def->defname, "prefetch") == 0 ||
+			strcmp(def->defname, "parallel_safe") == 0 ||
 			strcmp(def->defname, "parallel_commit") == 0 ||
 			strcmp(def->defname, "parallel_abort") == 0 ||
 			strcmp(def->defname, "keep_connections") == 0)
@@ -271,6 +273,12 @@ InitPgFdwOptions(void)
 		/* async_capable is available on both server and table */
 		{"async_capable", ForeignServerRelationId, false},
 		{"async_capable", ForeignTableRelationId, false},
+		/* prefetch is available on both server and table */
+		{"prefetch", ForeignServerRelationId, false},
+		{"prefetch", ForeignTableRelationId, false},
+		/* parallel_safe is available on both server and table */
+		{"parallel_safe", ForeignServerRelationId, false},
+		{"parallel_safe", ForeignTableRelationId, false},
 		{"parallel_commit", ForeignServerRelationId, false},
 		{"parallel_abort", ForeignServerRelationId, false},
 		{"keep_connections", ForeignServerRelationId, false},
@@ -77,6 +77,8 @@ enum FdwScanPrivateIndex
 	FdwScanPrivateRetrievedAttrs,
 	/* Integer representing the desired fetch_size */
 	FdwScanPrivateFetchSize,
+	/* Boolean flag showing whether to prefetch the next batch */
+	FdwScanPrivatePrefetch,
 
 	/*
 	 * String describing join i.e. names of relations being joined and types
@@ -168,8 +170,14 @@ typedef struct PgFdwScanState
 	/* for asynchronous execution */
 	bool		async_capable;	/* engage asynchronous-capable logic? */
 
+	/* for prefetching the next batch during synchronous execution */
+	bool		prefetch;		/* request next batch before it's needed? */
+	HeapTuple  *next_tuples;	/* array of prefetched tuples */
+	int			next_num_tuples;	/* # of prefetched tuples, or -1 if none */
+
 	/* working memory contexts */
 	MemoryContext batch_cxt;	/* context holding current batch of tuples */
+	MemoryContext next_batch_cxt;	/* context holding prefetched batch */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 
 	int			fetch_size;		/* number of tuples per fetch */
@@ -379,6 +387,9 @@ static void postgresBeginForeignInsert(ModifyTableState *mtstate,
 static void postgresEndForeignInsert(EState *estate,
 									 ResultRelInfo *resultRelInfo);
 static int	postgresIsForeignRelUpdatable(Relation rel);
+static bool postgresIsForeignScanParallelSafe(PlannerInfo *root,
+											  RelOptInfo *rel,
+											  RangeTblEntry *rte);
 static bool postgresPlanDirectModify(PlannerInfo *root,
 									 ModifyTable *plan,
 									 Index resultRelation,
@@ -449,6 +460,8 @@ static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
 									  void *arg);
 static void create_cursor(ForeignScanState *node);
 static void fetch_more_data(ForeignScanState *node);
+static int	store_fetched_rows(ForeignScanState *node, PGresult *res,
+							   HeapTuple **tuples);
 static void close_cursor(PGconn *conn, unsigned int cursor_number,
 						 PgFdwConnState *conn_state);
 static PgFdwModifyState *create_foreign_modify(EState *estate,
@@ -561,6 +574,7 @@ postgres_fdw_handler(PG_FUNCTION_ARGS)
 	routine->IterateForeignScan = postgresIterateForeignScan;
 	routine->ReScanForeignScan = postgresReScanForeignScan;
 	routine->EndForeignScan = postgresEndForeignScan;
+	routine->IsForeignScanParallelSafe = postgresIsForeignScanParallelSafe;
 
 	/* Functions for updating foreign tables */
 	routine->AddForeignUpdateTargets = postgresAddForeignUpdateTargets;
@@ -642,8 +656,8 @@ postgresGetForeignRelSize(PlannerInfo *root,
 
 	/*
 	 * Extract user-settable option values.  Note that per-table settings of
-	 * use_remote_estimate, fetch_size and async_capable override per-server
-	 * settings of them, respectively.
+	 * use_remote_estimate, fetch_size, async_capable and prefetch override
+	 * per-server settings of them, respectively.
 	 */
 	fpinfo->use_remote_estimate = false;
 	fpinfo->fdw_startup_cost = DEFAULT_FDW_STARTUP_COST;
@@ -651,6 +665,7 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	fpinfo->shippable_extensions = NIL;
 	fpinfo->fetch_size = 100;
 	fpinfo->async_capable = false;
+	fpinfo->prefetch = false;
 
 	apply_server_options(fpinfo);
 	apply_table_options(fpinfo);
@@ -1408,9 +1423,10 @@ postgresGetForeignPlan(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match order in enum FdwScanPrivateIndex.
 	 */
-	fdw_private = list_make3(makeString(sql.data),
+	fdw_private = list_make4(makeString(sql.data),
 							 retrieved_attrs,
-							 makeInteger(fpinfo->fetch_size));
+							 makeInteger(fpinfo->fetch_size),
+							 makeBoolean(fpinfo->prefetch));
 	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
 		fdw_private = lappend(fdw_private,
 							  makeString(fpinfo->relation_name));
@@ -1585,6 +1601,19 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 
 	/* Set the async-capable flag */
 	fsstate->async_capable = node->ss.ps.async_capable;
+
+	/*
+	 * Asynchronous execution already overlaps fetches with local work, so
+	 * prefetching is only done in synchronous mode.
+	 */
+	fsstate->prefetch = !fsstate->async_capable &&
+		boolVal(list_nth(fsplan->fdw_private, FdwScanPrivatePrefetch));
+	fsstate->next_tuples = NULL;
+	fsstate->next_num_tuples = -1;
+	if (fsstate->prefetch)
+		fsstate->next_batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+														"postgres_fdw prefetched tuple data",
+														ALLOCSET_DEFAULT_SIZES);
 }
 
 /*
@@ -1660,6 +1689,15 @@ postgresReScanForeignScan(ForeignScanState *node)
 		fsstate->conn_state->pendingAreq->requestee == (PlanState *) node)
 		fetch_more_data(node);
 
+	/*
+	 * Likewise, complete a prefetch for this node, and throw away any
+	 * prefetched batch, since the cursor will be repositioned.
+	 */
+	if (fsstate->conn_state->pendingPrefetch == node)
+		process_pending_prefetch(node);
+	fsstate->next_tuples = NULL;
+	fsstate->next_num_tuples = -1;
+
 	/*
 	 * If any internal parameters affecting this node have changed, we'd
 	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
@@ -2334,6 +2372,52 @@ postgresIsForeignRelUpdatable(Relation rel)
 		(1 << CMD_INSERT) | (1 << CMD_UPDATE) | (1 << CMD_DELETE) : 0;
 }
 
+/*
+ * postgresIsForeignScanParallelSafe
+ *		Determine whether a foreign table may be scanned in a parallel worker
+ *
+ * Each worker opens its own connection and remote transaction, which does
+ * not see the leader's remote snapshot or any remote changes made earlier in
+ * the local transaction.  So this is only allowed where the user says that
+ * doesn't matter.
+ */
+static bool
+postgresIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
+								  RangeTblEntry *rte)
+{
+	bool		parallel_safe;
+	ForeignTable *table;
+	ForeignServer *server;
+	ListCell   *lc;
+
+	/*
+	 * By default, scans are not parallel safe.  This can be overridden by a
+	 * per-server setting, which in turn can be overridden by a per-table
+	 * setting.
+	 */
+	parallel_safe = false;
+
+	table = GetForeignTable(rte->relid);
+	server = GetForeignServer(table->serverid);
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "parallel_safe") == 0)
+			parallel_safe = defGetBoolean(def);
+	}
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "parallel_safe") == 0)
+			parallel_safe = defGetBoolean(def);
+	}
+
+	return parallel_safe;
+}
+
 /*
  * postgresRecheckForeignScan
  *		Execute a local join execution plan for a foreign join
@@ -3715,9 +3799,11 @@ create_cursor(ForeignScanState *node)
 	StringInfoData buf;
 	PGresult   *res;
 
-	/* First, process a pending asynchronous request, if any. */
+	/* First, process a pending asynchronous request or prefetch, if any. */
 	if (fsstate->conn_state->pendingAreq)
 		process_pending_request(fsstate->conn_state->pendingAreq);
+	if (fsstate->conn_state->pendingPrefetch)
+		process_pending_prefetch(fsstate->conn_state->pendingPrefetch);
 
 	/*
 	 * Construct array of query parameter values in text format.  We do the
@@ -3787,76 +3873,185 @@ fetch_more_data(ForeignScanState *node)
 	PGresult   *volatile res = NULL;
 	MemoryContext oldcontext;
 
-	/*
-	 * We'll store the tuples in the batch_cxt.  First, flush the previous
-	 * batch.
-	 */
-	fsstate->tuples = NULL;
-	MemoryContextReset(fsstate->batch_cxt);
-	oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
+	/* If the next batch was prefetched, make sure we have its result. */
+	if (fsstate->conn_state->pendingPrefetch == node)
+		process_pending_prefetch(node);
 
-	/* PGresult must be released before leaving this function. */
-	PG_TRY();
+	if (fsstate->next_num_tuples >= 0)
 	{
-		PGconn	   *conn = fsstate->conn;
-		int			numrows;
-		int			i;
+		MemoryContext cxt = fsstate->batch_cxt;
 
-		if (fsstate->async_capable)
-		{
-			Assert(fsstate->conn_state->pendingAreq);
+		/*
+		 * Make the prefetched batch the current one, and recycle the previous
+		 * batch's context for the next prefetch.
+		 */
+		fsstate->batch_cxt = fsstate->next_batch_cxt;
+		fsstate->next_batch_cxt = cxt;
+		MemoryContextReset(cxt);
 
-			/*
-			 * The query was already sent by an earlier call to
-			 * fetch_more_data_begin.  So now we just fetch the result.
-			 */
-			res = pgfdw_get_result(conn);
-			/* On error, report the original query, not the FETCH. */
-			if (PQresultStatus(res) != PGRES_TUPLES_OK)
-				pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+		fsstate->tuples = fsstate->next_tuples;
+		fsstate->num_tuples = fsstate->next_num_tuples;
+		fsstate->next_tuple = 0;
+		fsstate->next_tuples = NULL;
+		fsstate->next_num_tuples = -1;
 
-			/* Reset per-connection state */
-			fsstate->conn_state->pendingAreq = NULL;
-		}
-		else
+		/* Must be EOF if we didn't get as many tuples as we asked for. */
+		fsstate->eof_reached = (fsstate->num_tuples < fsstate->fetch_size);
+	}
+	else
+	{
+		/*
+		 * We'll store the tuples in the batch_cxt.  First, flush the previous
+		 * batch.
+		 */
+		fsstate->tuples = NULL;
+		MemoryContextReset(fsstate->batch_cxt);
+		oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
+
+		/* PGresult must be released before leaving this function. */
+		PG_TRY();
 		{
-			char		sql[64];
+			PGconn	   *conn = fsstate->conn;
 
-			/* This is a regular synchronous fetch. */
-			snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
-					 fsstate->fetch_size, fsstate->cursor_number);
+			if (fsstate->async_capable)
+			{
+				Assert(fsstate->conn_state->pendingAreq);
 
-			res = pgfdw_exec_query(conn, sql, fsstate->conn_state);
-			/* On error, report the original query, not the FETCH. */
-			if (PQresultStatus(res) != PGRES_TUPLES_OK)
-				pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
-		}
+				/*
+				 * The query was already sent by an earlier call to
+				 * fetch_more_data_begin.  So now we just fetch the result.
+				 */
+				res = pgfdw_get_result(conn);
+				/* On error, report the original query, not the FETCH. */
+				if (PQresultStatus(res) != PGRES_TUPLES_OK)
+					pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
 
-		/* Convert the data into HeapTuples */
-		numrows = PQntuples(res);
-		fsstate->tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
-		fsstate->num_tuples = numrows;
-		fsstate->next_tuple = 0;
+				/* Reset per-connection state */
+				fsstate->conn_state->pendingAreq = NULL;
+			}
+			else
+			{
+				char		sql[64];
+
+				/* This is a regular synchronous fetch. */
+				snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+						 fsstate->fetch_size, fsstate->cursor_number);
+
+				res = pgfdw_exec_query(conn, sql, fsstate->conn_state);
+				/* On error, report the original query, not the FETCH. */
+				if (PQresultStatus(res) != PGRES_TUPLES_OK)
+					pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+			}
 
-		for (i = 0; i < numrows; i++)
+			/* Convert the data into HeapTuples */
+			fsstate->num_tuples = store_fetched_rows(node, res,
+													 &fsstate->tuples);
+			fsstate->next_tuple = 0;
+
+			/* Update fetch_ct_2 */
+			if (fsstate->fetch_ct_2 < 2)
+				fsstate->fetch_ct_2++;
+
+			/* Must be EOF if we didn't get as many tuples as we asked for. */
+			fsstate->eof_reached = (fsstate->num_tuples < fsstate->fetch_size);
+		}
+		PG_FINALLY();
 		{
-			Assert(IsA(node->ss.ps.plan, ForeignScan));
-
-			fsstate->tuples[i] =
-				make_tuple_from_result_row(res, i,
-										   fsstate->rel,
-										   fsstate->attinmeta,
-										   fsstate->retrieved_attrs,
-										   node,
-										   fsstate->temp_cxt);
+			PQclear(res);
 		}
+		PG_END_TRY();
 
-		/* Update fetch_ct_2 */
-		if (fsstate->fetch_ct_2 < 2)
-			fsstate->fetch_ct_2++;
+		MemoryContextSwitchTo(oldcontext);
+	}
 
-		/* Must be EOF if we didn't get as many tuples as we asked for. */
-		fsstate->eof_reached = (numrows < fsstate->fetch_size);
+	/*
+	 * If prefetching, ask for the following batch right away, so that the
+	 * remote server and the network work on it while we process this one.
+	 * We can only do that while nobody else is using the connection.
+	 */
+	if (fsstate->prefetch && !fsstate->eof_reached &&
+		fsstate->conn_state->pendingAreq == NULL &&
+		fsstate->conn_state->pendingPrefetch == NULL)
+	{
+		char		sql[64];
+
+		snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+				 fsstate->fetch_size, fsstate->cursor_number);
+
+		if (!PQsendQuery(fsstate->conn, sql))
+			pgfdw_report_error(ERROR, NULL, fsstate->conn, false,
+							   fsstate->query);
+
+		fsstate->conn_state->pendingPrefetch = node;
+		/* The cursor is now past the second batch; see ReScan */
+		fsstate->fetch_ct_2 = 2;
+	}
+}
+
+/*
+ * Convert the rows of a FETCH result into an array of HeapTuples, allocated
+ * in the current memory context.  Returns the number of rows.
+ */
+static int
+store_fetched_rows(ForeignScanState *node, PGresult *res, HeapTuple **tuples)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	int			numrows = PQntuples(res);
+	int			i;
+
+	*tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
+
+	for (i = 0; i < numrows; i++)
+	{
+		Assert(IsA(node->ss.ps.plan, ForeignScan));
+
+		(*tuples)[i] =
+			make_tuple_from_result_row(res, i,
+									   fsstate->rel,
+									   fsstate->attinmeta,
+									   fsstate->retrieved_attrs,
+									   node,
+									   fsstate->temp_cxt);
+	}
+
+	return numrows;
+}
+
+/*
+ * Collect the result of a prefetch begun by fetch_more_data().
+ *
+ * This must be done before anything else can be sent over the connection.
+ * The rows are kept in the node's next_batch_cxt until fetch_more_data()
+ * gets to them.
+ */
+void
+process_pending_prefetch(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PGresult   *volatile res = NULL;
+	MemoryContext oldcontext;
+
+	Assert(fsstate->conn_state->pendingPrefetch == node);
+	Assert(fsstate->next_num_tuples < 0);
+
+	MemoryContextReset(fsstate->next_batch_cxt);
+	oldcontext = MemoryContextSwitchTo(fsstate->next_batch_cxt);
+
+	/* PGresult must be released before leaving this function. */
+	PG_TRY();
+	{
+		res = pgfdw_get_result(fsstate->conn);
+
+		/* The connection is free again, whatever the result */
+		fsstate->conn_state->pendingPrefetch = NULL;
+
+		/* On error, report the original query, not the FETCH. */
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, fsstate->conn, false,
+							   fsstate->query);
+
+		fsstate->next_num_tuples = store_fetched_rows(node, res,
+													  &fsstate->next_tuples);
 	}
 	PG_FINALLY();
 	{
@@ -4092,9 +4287,11 @@ execute_foreign_modify(EState *estate,
 		   operation == CMD_UPDATE ||
 		   operation == CMD_DELETE);
 
-	/* First, process a pending asynchronous request, if any. */
+	/* First, process a pending asynchronous request or prefetch, if any. */
 	if (fmstate->conn_state->pendingAreq)
 		process_pending_request(fmstate->conn_state->pendingAreq);
+	if (fmstate->conn_state->pendingPrefetch)
+		process_pending_prefetch(fmstate->conn_state->pendingPrefetch);
 
 	/*
 	 * If the existing query was deparsed and prepared for a different number
@@ -4541,9 +4738,11 @@ execute_dml_stmt(ForeignScanState *node)
 	int			numParams = dmstate->numParams;
 	const char **values = dmstate->param_values;
 
-	/* First, process a pending asynchronous request, if any. */
+	/* First, process a pending asynchronous request or prefetch, if any. */
 	if (dmstate->conn_state->pendingAreq)
 		process_pending_request(dmstate->conn_state->pendingAreq);
+	if (dmstate->conn_state->pendingPrefetch)
+		process_pending_prefetch(dmstate->conn_state->pendingPrefetch);
 
 	/*
 	 * Construct array of query parameter values in text format.
@@ -6217,6 +6416,8 @@ apply_server_options(PgFdwRelationInfo *fpinfo)
 			(void) parse_int(defGetString(def), &fpinfo->fetch_size, 0, NULL);
 		else if (strcmp(def->defname, "async_capable") == 0)
 			fpinfo->async_capable = defGetBoolean(def);
+		else if (strcmp(def->defname, "prefetch") == 0)
+			fpinfo->prefetch = defGetBoolean(def);
 	}
 }
 
@@ -6240,6 +6441,8 @@ apply_table_options(PgFdwRelationInfo *fpinfo)
 			(void) parse_int(defGetString(def), &fpinfo->fetch_size, 0, NULL);
 		else if (strcmp(def->defname, "async_capable") == 0)
 			fpinfo->async_capable = defGetBoolean(def);
+		else if (strcmp(def->defname, "prefetch") == 0)
+			fpinfo->prefetch = defGetBoolean(def);
 	}
 }
 
@@ -6275,6 +6478,7 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate;
 	fpinfo->fetch_size = fpinfo_o->fetch_size;
 	fpinfo->async_capable = fpinfo_o->async_capable;
+	fpinfo->prefetch = fpinfo_o->prefetch;
 
 	/* Merge the table level options from either side of the join. */
 	if (fpinfo_i)
@@ -6306,6 +6510,9 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 		 */
 		fpinfo->async_capable = fpinfo_o->async_capable ||
 			fpinfo_i->async_capable;
+
+		/* Likewise for prefetching */
+		fpinfo->prefetch = fpinfo_o->prefetch || fpinfo_i->prefetch;
 	}
 }
 
@@ -7427,6 +7634,10 @@ fetch_more_data_begin(AsyncRequest *areq)
 
 	Assert(!fsstate->conn_state->pendingAreq);
 
+	/* Another scan's prefetch must be out of the way first. */
+	if (fsstate->conn_state->pendingPrefetch)
+		process_pending_prefetch(fsstate->conn_state->pendingPrefetch);
+
 	/* Create the cursor synchronously. */
 	if (!fsstate->cursor_exists)
 		create_cursor(node);
@@ -7775,14 +7986,13 @@ conversion_error_callback(void *arg)
 EquivalenceMember *
 find_em_for_rel(PlannerInfo *root, EquivalenceClass *ec, RelOptInfo *rel)
 {
-	ListCell   *lc;
-
 	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+	EquivalenceMemberIterator it;
+	EquivalenceMember *em;
 
-	foreach(lc, ec->ec_members)
+	setup_eclass_member_iterator(&it, ec, rel->relids);
+	while ((em = eclass_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
-
 		/*
 		 * Note we require !bms_is_empty, else we'd accept constant
 		 * expressions which are not suitable for the purpose.
@@ -7846,10 +8056,6 @@ find_em_for_rel_target(PlannerInfo *root, EquivalenceClass *ec,
 			if (em->em_is_const)
 				continue;
 
-			/* Ignore child members */
-			if (em->em_is_child)
-				continue;
-
 			/* Match if same expression (after stripping relabel) */
 			em_expr = em->em_expr;
 			while (em_expr && IsA(em_expr, RelabelType))
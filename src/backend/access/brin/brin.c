@@ -33,6 +33,7 @@
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
+#include "storage/lmgr.h"
 #include "tcop/tcopprot.h"		/* pgrminclude ignore */
 #include "utils/acl.h"
 #include "utils/datum.h"
@@ -274,8 +275,10 @@ brinhandler(PG_FUNCTION_ARGS)
 	amroutine->ambuild = brinbuild;
 	amroutine->ambuildempty = brinbuildempty;
 	amroutine->aminsert = brininsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->aminsertcleanup = brininsertcleanup;
 	amroutine->ambulkdelete = brinbulkdelete;
+	amroutine->amretaildelete = NULL;
 	amroutine->amvacuumcleanup = brinvacuumcleanup;
 	amroutine->amcanreturn = NULL;
 	amroutine->amcostestimate = brincostestimate;
@@ -326,7 +329,7 @@ initialize_brin_insertstate(Relation idxRel, IndexInfo *indexInfo)
  * the summary tuple, we need to update the index tuple.
  *
  * If autosummarization is enabled, check if we need to summarize the previous
- * page range.
+ * page range, and do so right away if we can.
  *
  * If the range is not currently summarized (i.e. the revmap returns NULL for
  * it), there's nothing to do for this tuple.
@@ -394,17 +397,34 @@ brininsert(Relation idxRel, Datum *values, bool *nulls,
 										 NULL, BUFFER_LOCK_SHARE);
 			if (!lastPageTuple)
 			{
-				bool		recorded;
-
-				recorded = AutoVacuumRequestWork(AVW_BRINSummarizeRange,
-												 RelationGetRelid(idxRel),
-												 lastPageRange);
-				if (!recorded)
-					ereport(LOG,
-							(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
-							 errmsg("request for BRIN range summarization for index \"%s\" page %u was not recorded",
-									RelationGetRelationName(idxRel),
-									lastPageRange)));
+				/*
+				 * Try to summarize the previous range right away, so that
+				 * scans don't have to return it as a whole until autovacuum
+				 * gets around to it.  Summarization is serialized by the
+				 * ShareUpdateExclusiveLock on the table; if somebody else
+				 * (such as VACUUM) holds it, don't wait, but leave the work
+				 * to autovacuum.
+				 */
+				if (ConditionalLockRelation(heapRel, ShareUpdateExclusiveLock))
+				{
+					brinsummarize(idxRel, heapRel, lastPageRange, false,
+								  NULL, NULL);
+					UnlockRelation(heapRel, ShareUpdateExclusiveLock);
+				}
+				else
+				{
+					bool		recorded;
+
+					recorded = AutoVacuumRequestWork(AVW_BRINSummarizeRange,
+													 RelationGetRelid(idxRel),
+													 lastPageRange);
+					if (!recorded)
+						ereport(LOG,
+								(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+								 errmsg("request for BRIN range summarization for index \"%s\" page %u was not recorded",
+										RelationGetRelationName(idxRel),
+										lastPageRange)));
+				}
 			}
 			else
 				LockBuffer(buf, BUFFER_LOCK_UNLOCK);
@@ -755,7 +775,11 @@ bringetbitmap(IndexScanDesc scan, TIDBitmap *tbm)
 		}
 		else
 		{
-			dtup = brin_deform_tuple(bdesc, btup, dtup);
+			/*
+			 * btup stays put until the next range, so the summary values
+			 * don't need to be copied out of it.
+			 */
+			dtup = brin_deform_tuple_nocopy(bdesc, btup, dtup);
 			if (dtup->bt_placeholder)
 			{
 				/*
@@ -912,16 +936,15 @@ bringetbitmap(IndexScanDesc scan, TIDBitmap *tbm)
 		if (addrange)
 		{
 			BlockNumber pageno;
+			BlockNumber lastpage;
 
-			for (pageno = heapBlk;
-				 pageno <= Min(nblocks, heapBlk + opaque->bo_pagesPerRange) - 1;
-				 pageno++)
-			{
-				MemoryContextSwitchTo(oldcxt);
+			lastpage = Min(nblocks, heapBlk + opaque->bo_pagesPerRange) - 1;
+
+			MemoryContextSwitchTo(oldcxt);
+			for (pageno = heapBlk; pageno <= lastpage; pageno++)
 				tbm_add_page(tbm, pageno);
-				totalpages++;
-				MemoryContextSwitchTo(perRangeCxt);
-			}
+			totalpages += lastpage - heapBlk + 1;
+			MemoryContextSwitchTo(perRangeCxt);
 		}
 	}
 
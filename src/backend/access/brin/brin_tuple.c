@@ -52,6 +52,10 @@
 static inline void brin_deconstruct_tuple(BrinDesc *brdesc,
 										  char *tp, bits8 *nullbits, bool nulls,
 										  Datum *values, bool *allnulls, bool *hasnulls);
+static BrinMemTuple *brin_deform_tuple_internal(BrinDesc *brdesc,
+												BrinTuple *tuple,
+												BrinMemTuple *dMemtuple,
+												bool copy);
 
 
 /*
@@ -551,6 +555,27 @@ brin_memtuple_initialize(BrinMemTuple *dtuple, BrinDesc *brdesc)
  */
 BrinMemTuple *
 brin_deform_tuple(BrinDesc *brdesc, BrinTuple *tuple, BrinMemTuple *dMemtuple)
+{
+	return brin_deform_tuple_internal(brdesc, tuple, dMemtuple, true);
+}
+
+/*
+ * Like brin_deform_tuple, but the by-reference values of the result point
+ * into 'tuple' rather than being copied, so the caller must keep the
+ * BrinTuple around (and unmodified) for as long as it uses the BrinMemTuple.
+ * This is cheaper when the summaries are only inspected, as when checking
+ * scan keys against them.
+ */
+BrinMemTuple *
+brin_deform_tuple_nocopy(BrinDesc *brdesc, BrinTuple *tuple,
+						 BrinMemTuple *dMemtuple)
+{
+	return brin_deform_tuple_internal(brdesc, tuple, dMemtuple, false);
+}
+
+static BrinMemTuple *
+brin_deform_tuple_internal(BrinDesc *brdesc, BrinTuple *tuple,
+						   BrinMemTuple *dMemtuple, bool copy)
 {
 	BrinMemTuple *dtup;
 	Datum	   *values;
@@ -604,14 +629,22 @@ brin_deform_tuple(BrinDesc *brdesc, BrinTuple *tuple, BrinMemTuple *dMemtuple)
 		}
 
 		/*
-		 * We would like to skip datumCopy'ing the values datum in some cases,
-		 * caller permitting ...
+		 * Copy the values, unless the caller promised to keep the tuple
+		 * around.
 		 */
-		for (i = 0; i < brdesc->bd_info[keyno]->oi_nstored; i++)
-			dtup->bt_columns[keyno].bv_values[i] =
-				datumCopy(values[valueno++],
-						  brdesc->bd_info[keyno]->oi_typcache[i]->typbyval,
-						  brdesc->bd_info[keyno]->oi_typcache[i]->typlen);
+		if (copy)
+		{
+			for (i = 0; i < brdesc->bd_info[keyno]->oi_nstored; i++)
+				dtup->bt_columns[keyno].bv_values[i] =
+					datumCopy(values[valueno++],
+							  brdesc->bd_info[keyno]->oi_typcache[i]->typbyval,
+							  brdesc->bd_info[keyno]->oi_typcache[i]->typlen);
+		}
+		else
+		{
+			for (i = 0; i < brdesc->bd_info[keyno]->oi_nstored; i++)
+				dtup->bt_columns[keyno].bv_values[i] = values[valueno++];
+		}
 
 		dtup->bt_columns[keyno].bv_hasnulls = hasnulls[keyno];
 		dtup->bt_columns[keyno].bv_allnulls = false;
@@ -0,0 +1,1739 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_handler.c
+ *	  columnar table access method code
+ *
+ * Rows are only ever inserted into a columnar table; UPDATE, DELETE and
+ * row locking are not supported.  See the README for the storage format.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_handler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/genam.h"
+#include "access/multixact.h"
+#include "access/sysattr.h"
+#include "access/tableam.h"
+#include "access/transam.h"
+#include "access/tsmapi.h"
+#include "access/xact.h"
+#include "catalog/index.h"
+#include "catalog/storage.h"
+#include "catalog/storage_xlog.h"
+#include "commands/progress.h"
+#include "commands/vacuum.h"
+#include "common/int.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/bitmapset.h"
+#include "optimizer/optimizer.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/bufmgr.h"
+#include "storage/predicate.h"
+#include "storage/procarray.h"
+#include "storage/read_stream.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/tuplesort.h"
+
+typedef struct ColumnarScanDescData
+{
+	TableScanDescData rs_base;	/* AM independent part of the descriptor */
+
+	/* copy of the stripe directory, read at the start of the scan */
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+
+	/* limits set for TID range scans, as row numbers; endrow is exclusive */
+	uint64		minrow;
+	uint64		endrow;
+
+	bool		inited;			/* false = scan not started yet */
+	int			curidx;			/* index of the current directory entry */
+	ColumnarStripe *stripe;		/* current stripe, or NULL */
+	int64		currow;			/* last row returned, within the stripe */
+
+	bool	   *needed;			/* columns to decode, NULL means all */
+	int			nprojkeys;		/* keys to skip stripes with */
+	ScanKey		projkeys;
+
+	MemoryContext stripecxt;	/* holds the current stripe */
+	BufferAccessStrategy strategy;
+
+	/* for ANALYZE: written stripes by starting block, and the current slice */
+	int		   *byblock;
+	int			nbyblock;
+	uint32		slice_end;
+	bool		slice_live;
+	bool		slice_dead;
+
+	/* for TABLESAMPLE: current block of the row number space */
+	BlockNumber sampleblock;
+} ColumnarScanDescData;
+
+typedef struct ColumnarScanDescData *ColumnarScanDesc;
+
+/*
+ * Parallel scans hand out whole stripes.  All participants read the
+ * directory after the leader did, and entries are only ever appended to it,
+ * so an index into the directory means the same in all participants.
+ */
+typedef struct ParallelColumnarScanDescData
+{
+	ParallelTableScanDescData base;
+	pg_atomic_uint32 next_stripe;	/* next directory entry to scan */
+} ParallelColumnarScanDescData;
+
+typedef struct ParallelColumnarScanDescData *ParallelColumnarScanDesc;
+
+typedef struct IndexFetchColumnarData
+{
+	IndexFetchTableData xs_base;	/* AM independent part of the descriptor */
+
+	/* copy of the stripe directory, re-read when a row isn't found */
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+
+	ColumnarStripe *stripe;		/* last stripe rows were fetched from */
+	MemoryContext cxt;			/* holds the directory */
+	MemoryContext stripecxt;	/* holds the stripe */
+
+	/* inserter of the last row fetched, for CLUSTER */
+	TransactionId last_xmin;
+	CommandId	last_cid;
+} IndexFetchColumnarData;
+
+static const TableAmRoutine columnar_methods;
+
+
+/* ------------------------------------------------------------------------
+ * Helper functions
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Did the transaction that inserted the rows of the stripe abort?
+ */
+static bool
+columnar_stripe_aborted(const ColumnarStripeEntry *entry)
+{
+	if (entry->flags & COLUMNAR_STRIPE_INVALID)
+		return true;
+	if (!TransactionIdIsNormal(entry->xmin))
+		return false;
+	if (TransactionIdIsCurrentTransactionId(entry->xmin) ||
+		TransactionIdIsInProgress(entry->xmin))
+		return false;
+	return !TransactionIdDidCommit(entry->xmin);
+}
+
+/*
+ * Return the first row number whose TID is >= tid, or > tid if after is
+ * true.  TIDs with offsets outside the range used by columnar tables are
+ * allowed.
+ */
+static uint64
+columnar_tid_bound(ItemPointer tid, bool after)
+{
+	uint64		row;
+	OffsetNumber off = ItemPointerGetOffsetNumberNoCheck(tid);
+
+	row = (uint64) ItemPointerGetBlockNumberNoCheck(tid) *
+		COLUMNAR_ROWS_PER_TID_BLOCK;
+	if (after)
+		row += Min(off, COLUMNAR_ROWS_PER_TID_BLOCK);
+	else
+		row += Min(Max(off, 1), COLUMNAR_ROWS_PER_TID_BLOCK + 1) - 1;
+
+	return row;
+}
+
+/*
+ * Test a row against the scan keys given to table_beginscan().
+ */
+static bool
+columnar_key_test(TupleTableSlot *slot, int nkeys, ScanKey keys)
+{
+	for (int i = 0; i < nkeys; i++)
+	{
+		ScanKey		key = &keys[i];
+		int			attoff = key->sk_attno - 1;
+
+		if (key->sk_flags & SK_ISNULL)
+			return false;
+		if (slot->tts_isnull[attoff])
+			return false;
+		if (!DatumGetBool(FunctionCall2Coll(&key->sk_func,
+											key->sk_collation,
+											slot->tts_values[attoff],
+											key->sk_argument)))
+			return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------
+ * Slot related callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static const TupleTableSlotOps *
+columnar_slot_callbacks(Relation relation)
+{
+	return &TTSOpsVirtual;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Sequential scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static TableScanDesc
+columnar_beginscan(Relation relation, Snapshot snapshot,
+				   int nkeys, ScanKey key,
+				   ParallelTableScanDesc parallel_scan,
+				   uint32 flags)
+{
+	ColumnarScanDesc scan;
+
+	/*
+	 * Rows buffered by this backend have to be written out first, for the
+	 * scan to see them.
+	 */
+	columnar_flush_pending(relation);
+
+	RelationIncrementReferenceCount(relation);
+
+	scan = (ColumnarScanDesc) palloc0(sizeof(ColumnarScanDescData));
+
+	scan->rs_base.rs_rd = relation;
+	scan->rs_base.rs_snapshot = snapshot;
+	scan->rs_base.rs_nkeys = nkeys;
+	scan->rs_base.rs_flags = flags;
+	scan->rs_base.rs_parallel = parallel_scan;
+
+	if (nkeys > 0)
+	{
+		scan->rs_base.rs_key = palloc(sizeof(ScanKeyData) * nkeys);
+		memcpy(scan->rs_base.rs_key, key, sizeof(ScanKeyData) * nkeys);
+	}
+
+	/* see heap_beginscan() */
+	if (scan->rs_base.rs_flags & (SO_TYPE_SEQSCAN | SO_TYPE_SAMPLESCAN))
+	{
+		Assert(snapshot);
+		PredicateLockRelation(relation, snapshot);
+	}
+
+	if ((flags & SO_ALLOW_STRAT) &&
+		!RelationUsesLocalBuffers(relation) &&
+		RelationGetNumberOfBlocks(relation) > NBuffers / 4)
+		scan->strategy = GetAccessStrategy(BAS_BULKREAD);
+
+	scan->stripecxt = AllocSetContextCreate(CurrentMemoryContext,
+											"columnar scan stripe",
+											ALLOCSET_DEFAULT_SIZES);
+	scan->stripes = columnar_read_directory(relation, &scan->nstripes);
+	scan->minrow = 0;
+	scan->endrow = PG_UINT64_MAX;
+	scan->curidx = -1;
+
+	return (TableScanDesc) scan;
+}
+
+static void
+columnar_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
+				bool allow_strat, bool allow_sync, bool allow_pagemode)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	if (set_params)
+	{
+		if (allow_strat)
+			scan->rs_base.rs_flags |= SO_ALLOW_STRAT;
+		else
+			scan->rs_base.rs_flags &= ~SO_ALLOW_STRAT;
+
+		if (allow_sync)
+			scan->rs_base.rs_flags |= SO_ALLOW_SYNC;
+		else
+			scan->rs_base.rs_flags &= ~SO_ALLOW_SYNC;
+
+		if (allow_pagemode)
+			scan->rs_base.rs_flags |= SO_ALLOW_PAGEMODE;
+		else
+			scan->rs_base.rs_flags &= ~SO_ALLOW_PAGEMODE;
+	}
+
+	if (key != NULL && scan->rs_base.rs_nkeys > 0)
+		memcpy(scan->rs_base.rs_key, key,
+			   scan->rs_base.rs_nkeys * sizeof(ScanKeyData));
+
+	/*
+	 * There's no need to re-read the directory: the snapshot is the same, so
+	 * any stripe added since can't be visible to the scan.
+	 */
+	scan->inited = false;
+	scan->curidx = -1;
+	scan->stripe = NULL;
+	MemoryContextReset(scan->stripecxt);
+}
+
+static void
+columnar_endscan(TableScanDesc sscan)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	RelationDecrementReferenceCount(scan->rs_base.rs_rd);
+
+	MemoryContextDelete(scan->stripecxt);
+	if (scan->stripes)
+		pfree(scan->stripes);
+	if (scan->byblock)
+		pfree(scan->byblock);
+	if (scan->needed)
+		pfree(scan->needed);
+	if (scan->projkeys)
+		pfree(scan->projkeys);
+	if (scan->rs_base.rs_key)
+		pfree(scan->rs_base.rs_key);
+
+	if (scan->strategy != NULL)
+		FreeAccessStrategy(scan->strategy);
+
+	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
+		UnregisterSnapshot(scan->rs_base.rs_snapshot);
+
+	pfree(scan);
+}
+
+/*
+ * Advance to the next stripe to return rows from, in the given direction.
+ * Returns false at the end of the scan.
+ */
+static bool
+columnar_scan_next_stripe(ColumnarScanDesc scan, ScanDirection direction)
+{
+	Relation	rel = scan->rs_base.rs_rd;
+	Snapshot	snapshot = scan->rs_base.rs_snapshot;
+	bool		forward = ScanDirectionIsForward(direction);
+
+	for (;;)
+	{
+		ColumnarStripeEntry *entry;
+		int			idx;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (scan->rs_base.rs_parallel != NULL)
+		{
+			ParallelColumnarScanDesc pscan;
+
+			Assert(forward);
+			pscan = (ParallelColumnarScanDesc) scan->rs_base.rs_parallel;
+			idx = (int) pg_atomic_fetch_add_u32(&pscan->next_stripe, 1);
+		}
+		else if (!scan->inited)
+			idx = forward ? 0 : scan->nstripes - 1;
+		else
+			idx = scan->curidx + (forward ? 1 : -1);
+
+		if (idx < 0 || idx >= scan->nstripes)
+		{
+			scan->inited = false;
+			scan->curidx = -1;
+			return false;
+		}
+		scan->inited = true;
+		scan->curidx = idx;
+
+		entry = &scan->stripes[idx];
+		if (entry->first_row + entry->nrows <= scan->minrow ||
+			entry->first_row >= scan->endrow)
+			continue;
+
+		if (!columnar_stripe_visible(entry, snapshot))
+		{
+			if (TransactionIdIsNormal(entry->xmin) &&
+				!(entry->flags & COLUMNAR_STRIPE_INVALID))
+				CheckForSerializableConflictOut(rel, entry->xmin, snapshot);
+			continue;
+		}
+
+		MemoryContextReset(scan->stripecxt);
+		scan->stripe = columnar_begin_stripe(rel, entry, scan->stripecxt,
+											 scan->strategy);
+		if (scan->nprojkeys > 0 &&
+			columnar_stripe_excluded(scan->stripe, scan->nprojkeys,
+									 scan->projkeys))
+		{
+			scan->stripe = NULL;
+			continue;
+		}
+
+		scan->currow = forward ? -1 : (int64) entry->nrows;
+		return true;
+	}
+}
+
+static bool
+columnar_getnextslot(TableScanDesc sscan, ScanDirection direction,
+					 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = scan->rs_base.rs_rd;
+
+	for (;;)
+	{
+		ColumnarStripe *stripe;
+		uint64		row;
+
+		if (scan->stripe == NULL &&
+			!columnar_scan_next_stripe(scan, direction))
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+		stripe = scan->stripe;
+
+		scan->currow += ScanDirectionIsForward(direction) ? 1 : -1;
+		if (scan->currow < 0 || scan->currow >= stripe->header->nrows)
+		{
+			scan->stripe = NULL;
+			continue;
+		}
+
+		row = stripe->entry.first_row + scan->currow;
+		if (row < scan->minrow || row >= scan->endrow)
+			continue;
+
+		columnar_stripe_fill_slot(rel, stripe, (uint32) scan->currow,
+								  scan->needed, slot, scan->strategy);
+		slot->tts_tableOid = RelationGetRelid(rel);
+
+		if (scan->rs_base.rs_nkeys > 0 &&
+			!columnar_key_test(slot, scan->rs_base.rs_nkeys,
+							   scan->rs_base.rs_key))
+			continue;
+
+		pgstat_count_heap_getnext(rel);
+
+		return true;
+	}
+}
+
+static void
+columnar_set_tidrange(TableScanDesc sscan, ItemPointer mintid,
+					  ItemPointer maxtid)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	scan->minrow = columnar_tid_bound(mintid, false);
+	scan->endrow = columnar_tid_bound(maxtid, true);
+}
+
+static bool
+columnar_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
+							  TupleTableSlot *slot)
+{
+	/* columnar_getnextslot() already obeys the limits */
+	return columnar_getnextslot(sscan, direction, slot);
+}
+
+static void
+columnar_set_projection(TableScanDesc sscan, Bitmapset *attrs,
+						int nkeys, ScanKey keys)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	int			natts = RelationGetNumberOfAttributes(scan->rs_base.rs_rd);
+	int			x = -1;
+
+	if (scan->needed)
+	{
+		pfree(scan->needed);
+		scan->needed = NULL;
+	}
+	if (scan->projkeys)
+	{
+		pfree(scan->projkeys);
+		scan->projkeys = NULL;
+	}
+	scan->nprojkeys = 0;
+
+	if (attrs != NULL)
+	{
+		scan->needed = palloc0(natts * sizeof(bool));
+
+		while ((x = bms_next_member(attrs, x)) >= 0)
+		{
+			AttrNumber	attno = x + FirstLowInvalidHeapAttributeNumber;
+
+			if (attno == InvalidAttrNumber)
+			{
+				/* whole-row reference */
+				pfree(scan->needed);
+				scan->needed = NULL;
+				break;
+			}
+			if (attno > 0 && attno <= natts)
+				scan->needed[attno - 1] = true;
+		}
+
+		/* the columns of the scan's own keys are always needed */
+		if (scan->needed)
+		{
+			for (int i = 0; i < scan->rs_base.rs_nkeys; i++)
+				scan->needed[scan->rs_base.rs_key[i].sk_attno - 1] = true;
+		}
+	}
+
+	if (nkeys > 0)
+	{
+		scan->projkeys = palloc(nkeys * sizeof(ScanKeyData));
+		memcpy(scan->projkeys, keys, nkeys * sizeof(ScanKeyData));
+		scan->nprojkeys = nkeys;
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Parallel scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static Size
+columnar_parallelscan_estimate(Relation rel)
+{
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+static Size
+columnar_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+
+	cpscan->base.phs_relid = RelationGetRelid(rel);
+	cpscan->base.phs_syncscan = false;
+	pg_atomic_init_u32(&cpscan->next_stripe, 0);
+
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+static void
+columnar_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+
+	pg_atomic_write_u32(&cpscan->next_stripe, 0);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Index Scan Callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static IndexFetchTableData *
+columnar_index_fetch_begin(Relation rel)
+{
+	IndexFetchColumnarData *cscan = palloc0(sizeof(IndexFetchColumnarData));
+
+	cscan->xs_base.rel = rel;
+	cscan->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									   "columnar index fetch",
+									   ALLOCSET_SMALL_SIZES);
+	cscan->stripecxt = AllocSetContextCreate(cscan->cxt,
+											 "columnar index fetch stripe",
+											 ALLOCSET_DEFAULT_SIZES);
+
+	return &cscan->xs_base;
+}
+
+static void
+columnar_index_fetch_reset(IndexFetchTableData *scan)
+{
+	/* the cached directory and stripe stay valid */
+}
+
+static void
+columnar_index_fetch_end(IndexFetchTableData *scan)
+{
+	IndexFetchColumnarData *cscan = (IndexFetchColumnarData *) scan;
+
+	MemoryContextDelete(cscan->cxt);
+	pfree(cscan);
+}
+
+/*
+ * Fetch the row with the given TID, if it's visible to the snapshot.  The
+ * row is stored in slot, unless that's NULL.
+ *
+ * The directory is re-read whenever the row's stripe isn't found in the
+ * cached copy, or isn't written yet.  Rows of a stripe still being inserted
+ * by another transaction have to be reported for the sake of unique checks,
+ * but their values can't be read yet; they're returned as all nulls.
+ */
+static bool
+columnar_fetch_row(IndexFetchColumnarData *cscan, ItemPointer tid,
+				   Snapshot snapshot, TupleTableSlot *slot, bool *all_dead)
+{
+	Relation	rel = cscan->xs_base.rel;
+	uint64		row = columnar_tid_to_row(tid);
+	ColumnarStripeEntry *entry;
+	CommandId	cid;
+	int			idx;
+
+	if (all_dead)
+		*all_dead = false;
+
+	/* rows buffered by this backend */
+	if (columnar_fetch_pending(rel, row, slot, &cid))
+	{
+		if (snapshot->snapshot_type == SNAPSHOT_DIRTY)
+		{
+			snapshot->xmin = snapshot->xmax = InvalidTransactionId;
+			snapshot->speculativeToken = 0;
+		}
+		if (snapshot->snapshot_type == SNAPSHOT_MVCC &&
+			cid >= snapshot->curcid)
+			return false;
+		if (slot)
+			slot->tts_tableOid = RelationGetRelid(rel);
+		cscan->last_xmin = GetCurrentTransactionId();
+		cscan->last_cid = cid;
+		return true;
+	}
+
+	idx = columnar_find_stripe(cscan->stripes, cscan->nstripes, row);
+	if (idx < 0 || (cscan->stripes[idx].flags & COLUMNAR_STRIPE_RESERVED))
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(cscan->cxt);
+
+		if (cscan->stripes)
+			pfree(cscan->stripes);
+		cscan->stripes = columnar_read_directory(rel, &cscan->nstripes);
+		MemoryContextSwitchTo(oldcxt);
+
+		idx = columnar_find_stripe(cscan->stripes, cscan->nstripes, row);
+		if (idx < 0)
+			return false;
+	}
+	entry = &cscan->stripes[idx];
+
+	if (entry->flags & COLUMNAR_STRIPE_RESERVED)
+	{
+		TransactionId xmin = entry->xmin;
+
+		if (snapshot->snapshot_type == SNAPSHOT_DIRTY)
+		{
+			snapshot->xmin = snapshot->xmax = InvalidTransactionId;
+			snapshot->speculativeToken = 0;
+		}
+
+		if ((snapshot->snapshot_type == SNAPSHOT_DIRTY ||
+			 snapshot->snapshot_type == SNAPSHOT_ANY ||
+			 snapshot->snapshot_type == SNAPSHOT_NON_VACUUMABLE) &&
+			!TransactionIdIsCurrentTransactionId(xmin) &&
+			TransactionIdIsInProgress(xmin))
+		{
+			if (snapshot->snapshot_type == SNAPSHOT_DIRTY)
+				snapshot->xmin = xmin;
+			if (slot)
+			{
+				ExecClearTuple(slot);
+				memset(slot->tts_isnull, true,
+					   slot->tts_tupleDescriptor->natts * sizeof(bool));
+				ExecStoreVirtualTuple(slot);
+				slot->tts_tid = *tid;
+				slot->tts_tableOid = RelationGetRelid(rel);
+			}
+			cscan->last_xmin = xmin;
+			cscan->last_cid = entry->cid;
+			return true;
+		}
+
+		if (all_dead && columnar_stripe_aborted(entry))
+			*all_dead = true;
+		return false;
+	}
+
+	if (!columnar_stripe_visible(entry, snapshot))
+	{
+		if (all_dead && columnar_stripe_aborted(entry))
+			*all_dead = true;
+		return false;
+	}
+
+	if (slot)
+	{
+		if (cscan->stripe == NULL ||
+			cscan->stripe->entry.first_row != entry->first_row)
+		{
+			cscan->stripe = NULL;
+			MemoryContextReset(cscan->stripecxt);
+			cscan->stripe = columnar_begin_stripe(rel, entry,
+												  cscan->stripecxt, NULL);
+		}
+		columnar_stripe_fill_slot(rel, cscan->stripe,
+								  (uint32) (row - entry->first_row),
+								  NULL, slot, NULL);
+		ExecMaterializeSlot(slot);
+		slot->tts_tableOid = RelationGetRelid(rel);
+	}
+
+	cscan->last_xmin = entry->xmin;
+	cscan->last_cid = entry->cid;
+	return true;
+}
+
+static bool
+columnar_index_fetch_tuple(struct IndexFetchTableData *scan,
+						   ItemPointer tid,
+						   Snapshot snapshot,
+						   TupleTableSlot *slot,
+						   bool *call_again, bool *all_dead)
+{
+	IndexFetchColumnarData *cscan = (IndexFetchColumnarData *) scan;
+
+	/* there are no HOT chains */
+	*call_again = false;
+
+	return columnar_fetch_row(cscan, tid, snapshot, slot, all_dead);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Callbacks for non-modifying operations on individual tuples for
+ * columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static bool
+columnar_fetch_row_version(Relation relation,
+						   ItemPointer tid,
+						   Snapshot snapshot,
+						   TupleTableSlot *slot)
+{
+	IndexFetchTableData *scan = columnar_index_fetch_begin(relation);
+	bool		found;
+
+	found = columnar_fetch_row((IndexFetchColumnarData *) scan, tid,
+							   snapshot, slot, NULL);
+	columnar_index_fetch_end(scan);
+
+	return found;
+}
+
+static bool
+columnar_tuple_tid_valid(TableScanDesc sscan, ItemPointer tid)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	ColumnarStripeEntry *last;
+
+	if (!ItemPointerIsValid(tid) ||
+		ItemPointerGetOffsetNumber(tid) > COLUMNAR_ROWS_PER_TID_BLOCK ||
+		scan->nstripes == 0)
+		return false;
+
+	last = &scan->stripes[scan->nstripes - 1];
+	return columnar_tid_to_row(tid) < last->first_row + last->nrows;
+}
+
+static void
+columnar_get_latest_tid(TableScanDesc sscan, ItemPointer tid)
+{
+	/* rows are never updated, so every TID is the latest version */
+}
+
+static bool
+columnar_tuple_satisfies_snapshot(Relation rel, TupleTableSlot *slot,
+								  Snapshot snapshot)
+{
+	IndexFetchTableData *scan = columnar_index_fetch_begin(rel);
+	bool		visible;
+
+	visible = columnar_fetch_row((IndexFetchColumnarData *) scan,
+								 &slot->tts_tid, snapshot, NULL, NULL);
+	columnar_index_fetch_end(scan);
+
+	return visible;
+}
+
+/*
+ * Only index entries pointing to rows of aborted transactions can be
+ * deleted; rows are never deleted otherwise.
+ */
+static TransactionId
+columnar_index_delete_tuples(Relation rel, TM_IndexDeleteOp *delstate)
+{
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+
+	stripes = columnar_read_directory(rel, &nstripes);
+
+	for (int i = 0; i < delstate->ndeltids; i++)
+	{
+		TM_IndexDelete *ideltid = &delstate->deltids[i];
+		TM_IndexStatus *istatus = delstate->status + ideltid->id;
+		int			idx;
+
+		idx = columnar_find_stripe(stripes, nstripes,
+								   columnar_tid_to_row(&ideltid->tid));
+		if (idx >= 0 && columnar_stripe_aborted(&stripes[idx]))
+			istatus->knowndeletable = true;
+	}
+
+	if (stripes)
+		pfree(stripes);
+
+	/* rows of aborted transactions were never visible to anyone */
+	return InvalidTransactionId;
+}
+
+
+/* ----------------------------------------------------------------------------
+ *  Functions for manipulations of physical tuples for columnar AM.
+ * ----------------------------------------------------------------------------
+ */
+
+static void
+columnar_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
+					  int options, struct BulkInsertStateData *bistate)
+{
+	CheckForSerializableConflictIn(relation, NULL, InvalidBlockNumber);
+
+	columnar_insert(relation, slot, cid);
+	slot->tts_tableOid = RelationGetRelid(relation);
+
+	pgstat_count_heap_insert(relation, 1);
+}
+
+static void
+columnar_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
+					  CommandId cid, int options,
+					  struct BulkInsertStateData *bistate)
+{
+	CheckForSerializableConflictIn(relation, NULL, InvalidBlockNumber);
+
+	for (int i = 0; i < ntuples; i++)
+	{
+		columnar_insert(relation, slots[i], cid);
+		slots[i]->tts_tableOid = RelationGetRelid(relation);
+	}
+
+	pgstat_count_heap_insert(relation, ntuples);
+}
+
+static void
+columnar_tuple_insert_speculative(Relation relation, TupleTableSlot *slot,
+								  CommandId cid, int options,
+								  struct BulkInsertStateData *bistate,
+								  uint32 specToken)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("INSERT ... ON CONFLICT is not supported on columnar table \"%s\"",
+					RelationGetRelationName(relation))));
+}
+
+static void
+columnar_tuple_complete_speculative(Relation relation, TupleTableSlot *slot,
+									uint32 specToken, bool succeeded)
+{
+	elog(ERROR, "unexpected speculative insertion into columnar table \"%s\"",
+		 RelationGetRelationName(relation));
+}
+
+static TM_Result
+columnar_tuple_delete(Relation relation, ItemPointer tid, CommandId cid,
+					  Snapshot snapshot, Snapshot crosscheck, bool wait,
+					  TM_FailureData *tmfd, bool changingPart)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot delete rows from columnar table \"%s\"",
+					RelationGetRelationName(relation))));
+	return TM_Ok;				/* keep compiler quiet */
+}
+
+static TM_Result
+columnar_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
+					  CommandId cid, Snapshot snapshot, Snapshot crosscheck,
+					  bool wait, Bitmapset *unindexed_attrs,
+					  TM_FailureData *tmfd, LockTupleMode *lockmode,
+					  TU_UpdateIndexes *update_indexes)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot update rows in columnar table \"%s\"",
+					RelationGetRelationName(relation))));
+	return TM_Ok;				/* keep compiler quiet */
+}
+
+static TM_Result
+columnar_tuple_lock(Relation relation, ItemPointer tid, Snapshot snapshot,
+					TupleTableSlot *slot, CommandId cid, LockTupleMode mode,
+					LockWaitPolicy wait_policy, uint8 flags,
+					TM_FailureData *tmfd)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("cannot lock rows in columnar table \"%s\"",
+					RelationGetRelationName(relation))));
+	return TM_Ok;				/* keep compiler quiet */
+}
+
+static void
+columnar_finish_bulk_insert(Relation relation, int options)
+{
+	/* write out what's left of the last stripe */
+	columnar_flush_pending(relation);
+}
+
+
+/* ------------------------------------------------------------------------
+ * DDL related callbacks for columnar AM.
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_relation_set_new_filelocator(Relation rel,
+									  const RelFileLocator *newrlocator,
+									  char persistence,
+									  TransactionId *freezeXid,
+									  MultiXactId *minmulti)
+{
+	SMgrRelation srel;
+
+	/* rows buffered for the old storage are gone with it */
+	columnar_discard_pending(rel);
+
+	/* see heapam_relation_set_new_filelocator() */
+	*freezeXid = RecentXmin;
+	*minmulti = GetOldestMultiXactId();
+
+	srel = RelationCreateStorage(*newrlocator, persistence, true);
+
+	if (persistence == RELPERSISTENCE_UNLOGGED)
+	{
+		Assert(rel->rd_rel->relkind == RELKIND_RELATION ||
+			   rel->rd_rel->relkind == RELKIND_MATVIEW);
+		smgrcreate(srel, INIT_FORKNUM, false);
+		log_smgrcreate(newrlocator, INIT_FORKNUM);
+	}
+
+	smgrclose(srel);
+}
+
+static void
+columnar_relation_nontransactional_truncate(Relation rel)
+{
+	columnar_discard_pending(rel);
+	RelationTruncate(rel, 0);
+}
+
+static void
+columnar_relation_copy_data(Relation rel, const RelFileLocator *newrlocator)
+{
+	SMgrRelation dstrel;
+
+	columnar_flush_pending(rel);
+
+	/* see heapam_relation_copy_data() */
+	FlushRelationBuffers(rel);
+
+	dstrel = RelationCreateStorage(*newrlocator, rel->rd_rel->relpersistence, true);
+
+	RelationCopyStorage(RelationGetSmgr(rel), dstrel, MAIN_FORKNUM,
+						rel->rd_rel->relpersistence);
+
+	for (ForkNumber forkNum = MAIN_FORKNUM + 1;
+		 forkNum <= MAX_FORKNUM; forkNum++)
+	{
+		if (smgrexists(RelationGetSmgr(rel), forkNum))
+		{
+			smgrcreate(dstrel, forkNum, false);
+
+			if (RelationIsPermanent(rel) ||
+				(rel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED &&
+				 forkNum == INIT_FORKNUM))
+				log_smgrcreate(newrlocator, forkNum);
+			RelationCopyStorage(RelationGetSmgr(rel), dstrel, forkNum,
+								rel->rd_rel->relpersistence);
+		}
+	}
+
+	RelationDropStorage(rel);
+	smgrclose(dstrel);
+}
+
+/*
+ * Rewrite the table for VACUUM FULL or CLUSTER.  This is the only way the
+ * space used by rows of aborted transactions is reclaimed.
+ *
+ * Rows of transactions that committed before OldestXmin are written frozen,
+ * the others keep their inserting transaction and command.  When an index
+ * is given, rows are read in its order; they're never sorted explicitly,
+ * so use_sort is ignored.
+ */
+static void
+columnar_relation_copy_for_cluster(Relation OldTable, Relation NewTable,
+								   Relation OldIndex, bool use_sort,
+								   TransactionId OldestXmin,
+								   TransactionId *xid_cutoff,
+								   MultiXactId *multi_cutoff,
+								   double *num_tuples,
+								   double *tups_vacuumed,
+								   double *tups_recently_dead)
+{
+	TableScanDesc tableScan = NULL;
+	IndexScanDesc indexScan = NULL;
+	TupleTableSlot *slot;
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+	ColumnarWriteState *wstate = NULL;
+	TransactionId wxmin = InvalidTransactionId;
+	CommandId	wcid = InvalidCommandId;
+
+	columnar_flush_pending(OldTable);
+
+	*num_tuples = 0;
+	*tups_vacuumed = 0;
+	*tups_recently_dead = 0;
+
+	/* rows of aborted transactions are left behind */
+	stripes = columnar_read_directory(OldTable, &nstripes);
+	for (int i = 0; i < nstripes; i++)
+	{
+		if (columnar_stripe_aborted(&stripes[i]))
+			*tups_vacuumed += stripes[i].nrows;
+	}
+	if (stripes)
+		pfree(stripes);
+
+	slot = table_slot_create(OldTable, NULL);
+
+	if (OldIndex != NULL)
+	{
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_INDEX_SCAN_HEAP);
+
+		indexScan = index_beginscan(OldTable, OldIndex, SnapshotAny, 0, 0);
+		index_rescan(indexScan, NULL, 0, NULL, 0);
+	}
+	else
+	{
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_SEQ_SCAN_HEAP);
+
+		tableScan = table_beginscan(OldTable, SnapshotAny, 0, (ScanKey) NULL);
+	}
+
+	for (;;)
+	{
+		TransactionId xmin;
+		CommandId	cid;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (indexScan != NULL)
+		{
+			IndexFetchColumnarData *cscan;
+
+			if (!index_getnext_slot(indexScan, ForwardScanDirection, slot))
+				break;
+
+			cscan = (IndexFetchColumnarData *) indexScan->xs_heapfetch;
+			xmin = cscan->last_xmin;
+			cid = cscan->last_cid;
+		}
+		else
+		{
+			ColumnarScanDesc cscan = (ColumnarScanDesc) tableScan;
+
+			if (!table_scan_getnextslot(tableScan, ForwardScanDirection, slot))
+				break;
+
+			xmin = cscan->stripe->entry.xmin;
+			cid = cscan->stripe->entry.cid;
+		}
+
+		if (!TransactionIdIsNormal(xmin) ||
+			(TransactionIdPrecedes(xmin, OldestXmin) &&
+			 TransactionIdDidCommit(xmin)))
+		{
+			xmin = FrozenTransactionId;
+			cid = FirstCommandId;
+		}
+
+		/* stripes can only hold rows of one transaction and command */
+		if (wstate == NULL || xmin != wxmin || cid != wcid)
+		{
+			if (wstate != NULL)
+				columnar_end_write(wstate, NewTable);
+			wstate = columnar_begin_write(NewTable, xmin, cid);
+			wxmin = xmin;
+			wcid = cid;
+		}
+
+		slot_getallattrs(slot);
+		columnar_write_row(wstate, NewTable, slot->tts_values, slot->tts_isnull);
+
+		*num_tuples += 1;
+		pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_TUPLES_WRITTEN,
+									 *num_tuples);
+	}
+
+	if (wstate != NULL)
+		columnar_end_write(wstate, NewTable);
+
+	if (indexScan != NULL)
+		index_endscan(indexScan);
+	if (tableScan != NULL)
+		table_endscan(tableScan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	/* all rows of transactions before OldestXmin were frozen */
+	*xid_cutoff = OldestXmin;
+}
+
+/*
+ * Lazy VACUUM only freezes stripes and marks those of aborted transactions
+ * invalid; see columnar_vacuum_directory().  Their space is only reclaimed
+ * by VACUUM FULL, and index entries pointing to their rows are removed by
+ * index_delete_tuples.
+ */
+static void
+columnar_vacuum_rel(Relation rel, VacuumParams *params,
+					BufferAccessStrategy bstrategy)
+{
+	struct VacuumCutoffs cutoffs;
+	uint64		nrows;
+	bool		frozenxid_updated;
+	bool		minmulti_updated;
+
+	vacuum_get_cutoffs(rel, params, &cutoffs);
+
+	nrows = columnar_vacuum_directory(rel, cutoffs.OldestXmin);
+
+	vac_update_relstats(rel, RelationGetNumberOfBlocks(rel), (double) nrows,
+						0, rel->rd_rel->relhasindex,
+						cutoffs.OldestXmin, cutoffs.OldestMxact,
+						&frozenxid_updated, &minmulti_updated, false);
+
+	pgstat_report_vacuum(RelationGetRelid(rel), rel->rd_rel->relisshared,
+						 (PgStat_Counter) nrows, 0);
+}
+
+static int
+columnar_cmp_start_block(const void *a, const void *b, void *arg)
+{
+	ColumnarStripeEntry *stripes = (ColumnarStripeEntry *) arg;
+	BlockNumber ba = stripes[*(const int *) a].start_block;
+	BlockNumber bb = stripes[*(const int *) b].start_block;
+
+	return pg_cmp_u32(ba, bb);
+}
+
+/*
+ * ANALYZE samples physical blocks.  Each block holding data of a stripe
+ * stands for a slice of the stripe's rows, so that the number of rows
+ * returned per block is right on average.  Other blocks have no rows.
+ */
+static bool
+columnar_scan_analyze_next_block(TableScanDesc sscan, ReadStream *stream)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = scan->rs_base.rs_rd;
+	Buffer		buf;
+	BlockNumber blkno;
+	int			lo;
+	int			hi;
+
+	buf = read_stream_next_buffer(stream, NULL);
+	if (!BufferIsValid(buf))
+		return false;
+	blkno = BufferGetBlockNumber(buf);
+	ReleaseBuffer(buf);
+
+	if (scan->byblock == NULL)
+	{
+		scan->byblock = palloc(Max(scan->nstripes, 1) * sizeof(int));
+		scan->nbyblock = 0;
+		for (int i = 0; i < scan->nstripes; i++)
+		{
+			if (!(scan->stripes[i].flags & COLUMNAR_STRIPE_RESERVED) &&
+				scan->stripes[i].nblocks > 0)
+				scan->byblock[scan->nbyblock++] = i;
+		}
+		qsort_arg(scan->byblock, scan->nbyblock, sizeof(int),
+				  columnar_cmp_start_block, scan->stripes);
+	}
+
+	scan->currow = 0;
+	scan->slice_end = 0;
+
+	lo = 0;
+	hi = scan->nbyblock - 1;
+	while (lo <= hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+		ColumnarStripeEntry *entry = &scan->stripes[scan->byblock[mid]];
+
+		if (blkno < entry->start_block)
+			hi = mid - 1;
+		else if (blkno >= entry->start_block + entry->nblocks)
+			lo = mid + 1;
+		else
+		{
+			uint64		k = blkno - entry->start_block;
+
+			scan->currow = k * entry->nrows / entry->nblocks;
+			scan->slice_end = (k + 1) * entry->nrows / entry->nblocks;
+
+			/* see heapam_scan_analyze_next_tuple() for the accounting */
+			scan->slice_dead = columnar_stripe_aborted(entry);
+			scan->slice_live = !scan->slice_dead &&
+				(!TransactionIdIsNormal(entry->xmin) ||
+				 TransactionIdIsCurrentTransactionId(entry->xmin) ||
+				 !TransactionIdIsInProgress(entry->xmin));
+
+			if (scan->slice_live &&
+				(scan->stripe == NULL ||
+				 scan->stripe->entry.first_row != entry->first_row))
+			{
+				scan->stripe = NULL;
+				MemoryContextReset(scan->stripecxt);
+				scan->stripe = columnar_begin_stripe(rel, entry,
+													 scan->stripecxt,
+													 scan->strategy);
+			}
+			break;
+		}
+	}
+
+	return true;
+}
+
+static bool
+columnar_scan_analyze_next_tuple(TableScanDesc sscan, TransactionId OldestXmin,
+								 double *liverows, double *deadrows,
+								 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	while (scan->currow < scan->slice_end)
+	{
+		uint32		rowidx = (uint32) scan->currow++;
+
+		if (scan->slice_dead)
+		{
+			*deadrows += 1;
+			continue;
+		}
+		if (!scan->slice_live)
+			continue;
+
+		columnar_stripe_fill_slot(scan->rs_base.rs_rd, scan->stripe, rowidx,
+								  NULL, slot, scan->strategy);
+		*liverows += 1;
+		return true;
+	}
+
+	ExecClearTuple(slot);
+	return false;
+}
+
+static double
+columnar_index_build_range_scan(Relation tableRelation,
+								Relation indexRelation,
+								IndexInfo *indexInfo,
+								bool allow_sync,
+								bool anyvisible,
+								bool progress,
+								BlockNumber start_blockno,
+								BlockNumber numblocks,
+								IndexBuildCallback callback,
+								void *callback_state,
+								TableScanDesc scan)
+{
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	double		reltuples;
+	ExprState  *predicate;
+	TupleTableSlot *slot;
+	EState	   *estate;
+	ExprContext *econtext;
+	Snapshot	snapshot;
+	bool		need_unregister_snapshot = false;
+	Bitmapset  *attrs = NULL;
+
+	/*
+	 * Need an EState for evaluation of index expressions and partial-index
+	 * predicates.  Also a slot to hold the current tuple.
+	 */
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+	slot = table_slot_create(tableRelation, NULL);
+
+	/* Arrange for econtext's scan tuple to be the tuple under test */
+	econtext->ecxt_scantuple = slot;
+
+	/* Set up execution state for predicate, if any. */
+	predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+
+	/*
+	 * As for heap, a serial build uses SnapshotAny, and a concurrent one an
+	 * MVCC snapshot.  SnapshotAny doesn't return rows of aborted
+	 * transactions, and there are no deleted rows, so all rows returned are
+	 * alive.
+	 */
+	if (!scan)
+	{
+		if (IsBootstrapProcessingMode() || indexInfo->ii_Concurrent)
+		{
+			snapshot = RegisterSnapshot(GetTransactionSnapshot());
+			need_unregister_snapshot = true;
+		}
+		else
+			snapshot = SnapshotAny;
+
+		scan = table_beginscan_strat(tableRelation, snapshot, 0, NULL,
+									 true, allow_sync);
+	}
+
+	if (!allow_sync)
+	{
+		ColumnarScanDesc cscan = (ColumnarScanDesc) scan;
+
+		cscan->minrow = (uint64) start_blockno * COLUMNAR_ROWS_PER_TID_BLOCK;
+		if (numblocks != InvalidBlockNumber)
+			cscan->endrow = ((uint64) start_blockno + numblocks) *
+				COLUMNAR_ROWS_PER_TID_BLOCK;
+	}
+
+	/* only decode the indexed columns */
+	for (int i = 0; i < indexInfo->ii_NumIndexAttrs; i++)
+	{
+		AttrNumber	attno = indexInfo->ii_IndexAttrNumbers[i];
+
+		if (attno != 0)
+			attrs = bms_add_member(attrs,
+								   attno - FirstLowInvalidHeapAttributeNumber);
+	}
+	pull_varattnos((Node *) indexInfo->ii_Expressions, 1, &attrs);
+	pull_varattnos((Node *) indexInfo->ii_Predicate, 1, &attrs);
+	table_scan_set_projection(scan, attrs, 0, NULL);
+
+	reltuples = 0;
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		reltuples += 1;
+
+		MemoryContextReset(econtext->ecxt_per_tuple_memory);
+
+		/*
+		 * In a partial index, discard tuples that don't satisfy the
+		 * predicate.
+		 */
+		if (predicate != NULL)
+		{
+			if (!ExecQual(predicate, econtext))
+				continue;
+		}
+
+		/*
+		 * For the current heap tuple, extract all the attributes we use in
+		 * this index, and note which are null.  This also performs
+		 * evaluation of any expressions needed.
+		 */
+		FormIndexDatum(indexInfo,
+					   slot,
+					   estate,
+					   values,
+					   isnull);
+
+		/* Call the AM's callback routine to process the tuple */
+		callback(indexRelation, &slot->tts_tid, values, isnull, true,
+				 callback_state);
+	}
+
+	table_endscan(scan);
+
+	/* we can now forget our snapshot, if set and registered by us */
+	if (need_unregister_snapshot)
+		UnregisterSnapshot(snapshot);
+
+	ExecDropSingleTupleTableSlot(slot);
+
+	FreeExecutorState(estate);
+
+	/* These may have been pointing to the now-gone estate */
+	indexInfo->ii_ExpressionsState = NIL;
+	indexInfo->ii_PredicateState = NULL;
+
+	return reltuples;
+}
+
+static void
+columnar_index_validate_scan(Relation tableRelation,
+							 Relation indexRelation,
+							 IndexInfo *indexInfo,
+							 Snapshot snapshot,
+							 ValidateIndexState *state)
+{
+	TableScanDesc scan;
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	ExprState  *predicate;
+	TupleTableSlot *slot;
+	EState	   *estate;
+	ExprContext *econtext;
+	ItemPointer indexcursor = NULL;
+	ItemPointerData decoded;
+	bool		tuplesort_empty = false;
+
+	/*
+	 * sanity checks
+	 */
+	Assert(OidIsValid(indexRelation->rd_rel->relam));
+
+	/*
+	 * Need an EState for evaluation of index expressions and partial-index
+	 * predicates.  Also a slot to hold the current tuple.
+	 */
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+	slot = table_slot_create(tableRelation, NULL);
+
+	/* Arrange for econtext's scan tuple to be the tuple under test */
+	econtext->ecxt_scantuple = slot;
+
+	/* Set up execution state for predicate, if any. */
+	predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+
+	/*
+	 * Rows are returned in TID order, the same order as the TIDs in the
+	 * tuplesort, so the two can be merged.
+	 */
+	scan = table_beginscan_strat(tableRelation, snapshot, 0, NULL,
+								 true, false);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		ItemPointer tid = &slot->tts_tid;
+
+		CHECK_FOR_INTERRUPTS();
+
+		state->htups += 1;
+
+		/*
+		 * "merge" by skipping through the index tuples until we find or pass
+		 * the current row.
+		 */
+		while (!tuplesort_empty &&
+			   (!indexcursor ||
+				ItemPointerCompare(indexcursor, tid) < 0))
+		{
+			Datum		ts_val;
+			bool		ts_isnull;
+
+			tuplesort_empty = !tuplesort_getdatum(state->tuplesort, true,
+												  false, &ts_val, &ts_isnull,
+												  NULL);
+			Assert(tuplesort_empty || !ts_isnull);
+			if (!tuplesort_empty)
+			{
+				itemptr_decode(&decoded, DatumGetInt64(ts_val));
+				indexcursor = &decoded;
+			}
+			else
+			{
+				/* Be tidy */
+				indexcursor = NULL;
+			}
+		}
+
+		/*
+		 * If the tuplesort has overshot, then this row is missing from the
+		 * index, so insert it.
+		 */
+		if (tuplesort_empty || ItemPointerCompare(indexcursor, tid) > 0)
+		{
+			MemoryContextReset(econtext->ecxt_per_tuple_memory);
+
+			/*
+			 * In a partial index, discard tuples that don't satisfy the
+			 * predicate.
+			 */
+			if (predicate != NULL)
+			{
+				if (!ExecQual(predicate, econtext))
+					continue;
+			}
+
+			FormIndexDatum(indexInfo,
+						   slot,
+						   estate,
+						   values,
+						   isnull);
+
+			index_insert(indexRelation,
+						 values,
+						 isnull,
+						 tid,
+						 tableRelation,
+						 indexInfo->ii_Unique ?
+						 UNIQUE_CHECK_YES : UNIQUE_CHECK_NO,
+						 false,
+						 indexInfo);
+
+			state->tups_inserted += 1;
+		}
+	}
+
+	table_endscan(scan);
+
+	ExecDropSingleTupleTableSlot(slot);
+
+	FreeExecutorState(estate);
+
+	/* These may have been pointing to the now-gone estate */
+	indexInfo->ii_ExpressionsState = NIL;
+	indexInfo->ii_PredicateState = NULL;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Miscellaneous callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Values are detoasted before they're stored in a stripe, and chunks are
+ * compressed as a whole instead, so there's no need for a TOAST table.
+ */
+static bool
+columnar_relation_needs_toast_table(Relation rel)
+{
+	return false;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Planner related callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_estimate_rel_size(Relation rel, int32 *attr_widths,
+						   BlockNumber *pages, double *tuples,
+						   double *allvisfrac)
+{
+	table_block_relation_estimate_size(rel, attr_widths, pages,
+									   tuples, allvisfrac,
+									   0, COLUMNAR_BYTES_PER_PAGE);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Executor related callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * TABLESAMPLE works on the space of row numbers, divided into blocks the
+ * same way TIDs are; the physical blocks of the table have no relationship
+ * with the rows.
+ */
+static bool
+columnar_scan_sample_next_block(TableScanDesc sscan,
+								SampleScanState *scanstate)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	TsmRoutine *tsm = scanstate->tsmroutine;
+	ColumnarStripeEntry *last;
+	BlockNumber nblocks;
+	BlockNumber blockno;
+
+	if (scan->nstripes == 0)
+		return false;
+
+	last = &scan->stripes[scan->nstripes - 1];
+	nblocks = (BlockNumber) ((last->first_row + last->nrows +
+							  COLUMNAR_ROWS_PER_TID_BLOCK - 1) /
+							 COLUMNAR_ROWS_PER_TID_BLOCK);
+
+	if (tsm->NextSampleBlock)
+		blockno = tsm->NextSampleBlock(scanstate, nblocks);
+	else if (!scan->inited)
+		blockno = 0;
+	else if (scan->sampleblock + 1 < nblocks)
+		blockno = scan->sampleblock + 1;
+	else
+		blockno = InvalidBlockNumber;
+
+	if (!BlockNumberIsValid(blockno))
+	{
+		scan->inited = false;
+		return false;
+	}
+
+	scan->sampleblock = blockno;
+	scan->inited = true;
+
+	CHECK_FOR_INTERRUPTS();
+
+	return true;
+}
+
+static bool
+columnar_scan_sample_next_tuple(TableScanDesc sscan,
+								SampleScanState *scanstate,
+								TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = scan->rs_base.rs_rd;
+	TsmRoutine *tsm = scanstate->tsmroutine;
+
+	for (;;)
+	{
+		OffsetNumber tupoffset;
+		ItemPointerData tid;
+		uint64		row;
+		int			idx;
+		ColumnarStripeEntry *entry;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Ask the tablesample method which rows to check in this block. */
+		tupoffset = tsm->NextSampleTuple(scanstate, scan->sampleblock,
+										 COLUMNAR_ROWS_PER_TID_BLOCK);
+		if (!OffsetNumberIsValid(tupoffset))
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+
+		ItemPointerSet(&tid, scan->sampleblock, tupoffset);
+		row = columnar_tid_to_row(&tid);
+
+		idx = columnar_find_stripe(scan->stripes, scan->nstripes, row);
+		if (idx < 0)
+			continue;
+		entry = &scan->stripes[idx];
+
+		if (scan->stripe == NULL ||
+			scan->stripe->entry.first_row != entry->first_row)
+		{
+			if (!columnar_stripe_visible(entry, scan->rs_base.rs_snapshot))
+				continue;
+
+			scan->stripe = NULL;
+			MemoryContextReset(scan->stripecxt);
+			scan->stripe = columnar_begin_stripe(rel, entry, scan->stripecxt,
+												 scan->strategy);
+		}
+
+		columnar_stripe_fill_slot(rel, scan->stripe,
+								  (uint32) (row - entry->first_row),
+								  scan->needed, slot, scan->strategy);
+		slot->tts_tableOid = RelationGetRelid(rel);
+
+		/* Count successfully-fetched tuples as heap fetches */
+		pgstat_count_heap_getnext(rel);
+
+		return true;
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Definition of the columnar table access method.
+ * ------------------------------------------------------------------------
+ */
+
+static const TableAmRoutine columnar_methods = {
+	.type = T_TableAmRoutine,
+
+	.slot_callbacks = columnar_slot_callbacks,
+
+	.scan_begin = columnar_beginscan,
+	.scan_end = columnar_endscan,
+	.scan_rescan = columnar_rescan,
+	.scan_getnextslot = columnar_getnextslot,
+
+	.scan_set_tidrange = columnar_set_tidrange,
+	.scan_getnextslot_tidrange = columnar_getnextslot_tidrange,
+
+	.scan_set_projection = columnar_set_projection,
+
+	.parallelscan_estimate = columnar_parallelscan_estimate,
+	.parallelscan_initialize = columnar_parallelscan_initialize,
+	.parallelscan_reinitialize = columnar_parallelscan_reinitialize,
+
+	.index_fetch_begin = columnar_index_fetch_begin,
+	.index_fetch_reset = columnar_index_fetch_reset,
+	.index_fetch_end = columnar_index_fetch_end,
+	.index_fetch_tuple = columnar_index_fetch_tuple,
+
+	.tuple_insert = columnar_tuple_insert,
+	.tuple_insert_speculative = columnar_tuple_insert_speculative,
+	.tuple_complete_speculative = columnar_tuple_complete_speculative,
+	.multi_insert = columnar_multi_insert,
+	.tuple_delete = columnar_tuple_delete,
+	.tuple_update = columnar_tuple_update,
+	.tuple_lock = columnar_tuple_lock,
+	.finish_bulk_insert = columnar_finish_bulk_insert,
+
+	.tuple_fetch_row_version = columnar_fetch_row_version,
+	.tuple_get_latest_tid = columnar_get_latest_tid,
+	.tuple_tid_valid = columnar_tuple_tid_valid,
+	.tuple_satisfies_snapshot = columnar_tuple_satisfies_snapshot,
+	.index_delete_tuples = columnar_index_delete_tuples,
+
+	.relation_set_new_filelocator = columnar_relation_set_new_filelocator,
+	.relation_nontransactional_truncate = columnar_relation_nontransactional_truncate,
+	.relation_copy_data = columnar_relation_copy_data,
+	.relation_copy_for_cluster = columnar_relation_copy_for_cluster,
+	.relation_vacuum = columnar_vacuum_rel,
+	.scan_analyze_next_block = columnar_scan_analyze_next_block,
+	.scan_analyze_next_tuple = columnar_scan_analyze_next_tuple,
+	.index_build_range_scan = columnar_index_build_range_scan,
+	.index_validate_scan = columnar_index_validate_scan,
+
+	.relation_size = table_block_relation_size,
+	.relation_needs_toast_table = columnar_relation_needs_toast_table,
+	.relation_toast_am = NULL,
+	.relation_fetch_toast_slice = NULL,
+
+	.relation_estimate_size = columnar_estimate_rel_size,
+
+	.scan_bitmap_next_block = NULL,
+	.scan_bitmap_next_tuple = NULL,
+	.scan_sample_next_block = columnar_scan_sample_next_block,
+	.scan_sample_next_tuple = columnar_scan_sample_next_tuple
+};
+
+Datum
+columnar_tableam_handler(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(&columnar_methods);
+}
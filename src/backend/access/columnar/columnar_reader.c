@@ -0,0 +1,247 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_reader.c
+ *	  Decoding of the stripes of columnar tables.
+ *
+ * A stripe is read column by column: its header is read first, to decide
+ * whether the stripe can be skipped at all, and then only the chunks of the
+ * columns needed are read and decoded.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_reader.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/detoast.h"
+#include "access/stratnum.h"
+#include "access/tupmacs.h"
+#include "utils/rel.h"
+
+
+/*
+ * Start reading a stripe, by reading its header.  All memory is allocated
+ * in cxt, which the caller resets when done with the stripe.
+ */
+ColumnarStripe *
+columnar_begin_stripe(Relation rel, const ColumnarStripeEntry *entry,
+					  MemoryContext cxt, BufferAccessStrategy strategy)
+{
+	MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+	ColumnarStripe *stripe;
+	ColumnarStripeHeader fixed;
+	int			natts = RelationGetNumberOfAttributes(rel);
+
+	stripe = palloc(sizeof(ColumnarStripe));
+	stripe->entry = *entry;
+	stripe->natts = natts;
+	stripe->loaded = palloc0(natts * sizeof(bool));
+	stripe->values = palloc0(natts * sizeof(Datum *));
+	stripe->isnull = palloc0(natts * sizeof(bool *));
+	stripe->cxt = cxt;
+
+	columnar_read_bytes(rel, entry, 0, offsetof(ColumnarStripeHeader, chunks),
+						(char *) &fixed, strategy);
+	if (fixed.nrows != entry->nrows)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("stripe at block %u of columnar table \"%s\" has %u rows, expected %u",
+						entry->start_block, RelationGetRelationName(rel),
+						fixed.nrows, entry->nrows)));
+
+	stripe->header = palloc(SizeOfColumnarStripeHeader(fixed.natts));
+	columnar_read_bytes(rel, entry, 0, SizeOfColumnarStripeHeader(fixed.natts),
+						(char *) stripe->header, strategy);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return stripe;
+}
+
+/*
+ * Can the stripe be skipped, because no row in it can satisfy all of the
+ * scan keys?  Only the min and max values of the chunks are looked at, so
+ * this is a conservative check.
+ *
+ * The keys have to use strict operators of btree operator families.
+ * Equality keys are of no use here; the caller is expected to express them
+ * as a pair of >= and <= keys.
+ */
+bool
+columnar_stripe_excluded(ColumnarStripe *stripe, int nkeys, ScanKey keys)
+{
+	ColumnarStripeHeader *header = stripe->header;
+
+	for (int i = 0; i < nkeys; i++)
+	{
+		ScanKey		key = &keys[i];
+		ColumnarChunkInfo *chunk;
+		Datum		bound;
+
+		if (key->sk_attno < 1 || key->sk_attno > header->natts)
+			continue;
+		if (key->sk_flags & SK_ISNULL)
+			continue;
+
+		chunk = &header->chunks[key->sk_attno - 1];
+
+		/* with a strict operator, null values never match */
+		if (chunk->nnulls == header->nrows)
+			return true;
+		if (!chunk->has_minmax)
+			continue;
+
+		switch (key->sk_strategy)
+		{
+			case BTLessStrategyNumber:
+			case BTLessEqualStrategyNumber:
+				bound = chunk->min;
+				break;
+			case BTGreaterEqualStrategyNumber:
+			case BTGreaterStrategyNumber:
+				bound = chunk->max;
+				break;
+			default:
+				continue;
+		}
+
+		if (!DatumGetBool(FunctionCall2Coll(&key->sk_func,
+											key->sk_collation,
+											bound,
+											key->sk_argument)))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Decode the values of one column of the stripe.
+ */
+void
+columnar_load_column(Relation rel, ColumnarStripe *stripe, int attoff,
+					 BufferAccessStrategy strategy)
+{
+	MemoryContext oldcxt;
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(rel), attoff);
+	uint32		nrows = stripe->header->nrows;
+	Datum	   *values;
+	bool	   *isnull;
+
+	Assert(!stripe->loaded[attoff]);
+
+	oldcxt = MemoryContextSwitchTo(stripe->cxt);
+
+	values = palloc(Max(nrows, 1) * sizeof(Datum));
+	isnull = palloc(Max(nrows, 1) * sizeof(bool));
+
+	if (att->attisdropped)
+	{
+		memset(isnull, true, nrows * sizeof(bool));
+	}
+	else if (attoff >= stripe->header->natts)
+	{
+		Datum		value;
+		bool		null;
+
+		/* column added after the stripe was written */
+		value = getmissingattr(RelationGetDescr(rel), attoff + 1, &null);
+		for (uint32 i = 0; i < nrows; i++)
+		{
+			values[i] = value;
+			isnull[i] = null;
+		}
+	}
+	else
+	{
+		ColumnarChunkInfo *chunk = &stripe->header->chunks[attoff];
+		char	   *data;
+		bits8	   *bitmap = NULL;
+		uint32		off;
+
+		data = palloc(chunk->size);
+		columnar_read_bytes(rel, &stripe->entry, chunk->offset, chunk->size,
+							data, strategy);
+		if (VARATT_IS_COMPRESSED(data))
+			data = (char *) detoast_attr((struct varlena *) data);
+
+		off = VARHDRSZ;
+		if (chunk->nnulls > 0)
+		{
+			bitmap = (bits8 *) (data + off);
+			off += BITMAPLEN(nrows);
+		}
+
+		for (uint32 i = 0; i < nrows; i++)
+		{
+			if (bitmap && att_isnull(i, bitmap))
+			{
+				values[i] = (Datum) 0;
+				isnull[i] = true;
+				continue;
+			}
+
+			off = att_align_pointer(off, att->attalign, att->attlen,
+									data + off);
+			values[i] = fetchatt(att, data + off);
+			isnull[i] = false;
+			off = att_addlength_pointer(off, att->attlen, data + off);
+		}
+
+		if (off > VARSIZE(data))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid chunk for column \"%s\" in stripe at block %u of columnar table \"%s\"",
+							NameStr(att->attname), stripe->entry.start_block,
+							RelationGetRelationName(rel))));
+	}
+
+	stripe->values[attoff] = values;
+	stripe->isnull[attoff] = isnull;
+	stripe->loaded[attoff] = true;
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * Store the given row of the stripe in a virtual slot.  If needed isn't
+ * NULL, only the columns it's true for are filled in, the others are set to
+ * null.
+ *
+ * The slot points into the stripe's memory, so it's only valid until the
+ * stripe is done with.
+ */
+void
+columnar_stripe_fill_slot(Relation rel, ColumnarStripe *stripe,
+						  uint32 rowidx, const bool *needed,
+						  TupleTableSlot *slot, BufferAccessStrategy strategy)
+{
+	Assert(rowidx < stripe->header->nrows);
+
+	ExecClearTuple(slot);
+
+	for (int attoff = 0; attoff < stripe->natts; attoff++)
+	{
+		if (needed != NULL && !needed[attoff])
+		{
+			slot->tts_values[attoff] = (Datum) 0;
+			slot->tts_isnull[attoff] = true;
+			continue;
+		}
+
+		if (!stripe->loaded[attoff])
+			columnar_load_column(rel, stripe, attoff, strategy);
+
+		slot->tts_values[attoff] = stripe->values[attoff][rowidx];
+		slot->tts_isnull[attoff] = stripe->isnull[attoff][rowidx];
+	}
+
+	ExecStoreVirtualTuple(slot);
+	columnar_row_to_tid(stripe->entry.first_row + rowidx, &slot->tts_tid);
+}
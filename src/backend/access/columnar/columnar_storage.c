@@ -0,0 +1,601 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_storage.c
+ *	  Page-level storage of columnar tables: metapage, stripe directory and
+ *	  stripe data.
+ *
+ * All changes are WAL-logged with generic WAL records.  Stripe data is
+ * written to newly added blocks only, so there's never a need to modify a
+ * data page in place.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_storage.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/generic_xlog.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "commands/vacuum.h"
+#include "storage/lmgr.h"
+#include "storage/procarray.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+
+static Buffer columnar_lock_metapage(Relation rel, int mode, bool create);
+static Buffer columnar_new_page(Relation rel);
+static void columnar_init_dir_page(Page page);
+
+
+/*
+ * Pin and lock the metapage.  If the relation is still empty, the metapage
+ * is created if asked to, otherwise InvalidBuffer is returned.
+ */
+static Buffer
+columnar_lock_metapage(Relation rel, int mode, bool create)
+{
+	Buffer		buf;
+	Page		page;
+	ColumnarMetaPageData *meta;
+
+	if (RelationGetNumberOfBlocks(rel) == 0)
+	{
+		if (!create)
+			return InvalidBuffer;
+
+		LockRelationForExtension(rel, ExclusiveLock);
+		if (RelationGetNumberOfBlocks(rel) == 0)
+		{
+			GenericXLogState *state;
+
+			buf = columnar_new_page(rel);
+			Assert(BufferGetBlockNumber(buf) == COLUMNAR_METAPAGE_BLKNO);
+
+			state = GenericXLogStart(rel);
+			page = GenericXLogRegisterBuffer(state, buf,
+											 GENERIC_XLOG_FULL_IMAGE);
+			PageInit(page, BLCKSZ, 0);
+			meta = ColumnarPageGetMeta(page);
+			meta->magic = COLUMNAR_MAGIC;
+			meta->version = COLUMNAR_VERSION;
+			meta->dir_first = InvalidBlockNumber;
+			meta->dir_last = InvalidBlockNumber;
+			meta->next_row = 0;
+			((PageHeader) page)->pd_lower =
+				((char *) meta + sizeof(ColumnarMetaPageData)) - (char *) page;
+			GenericXLogFinish(state);
+
+			UnlockRelationForExtension(rel, ExclusiveLock);
+
+			/* we have the buffer exclusively locked, which will do */
+			return buf;
+		}
+		UnlockRelationForExtension(rel, ExclusiveLock);
+	}
+
+	buf = ReadBuffer(rel, COLUMNAR_METAPAGE_BLKNO);
+	LockBuffer(buf, mode);
+
+	page = BufferGetPage(buf);
+	meta = ColumnarPageGetMeta(page);
+	if (meta->magic != COLUMNAR_MAGIC)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("table \"%s\" is not a columnar table",
+						RelationGetRelationName(rel))));
+	if (meta->version != COLUMNAR_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("columnar table \"%s\" has version %u, expected %u",
+						RelationGetRelationName(rel),
+						meta->version, COLUMNAR_VERSION)));
+
+	return buf;
+}
+
+/*
+ * Add a block to the relation, and return it pinned and exclusively locked.
+ */
+static Buffer
+columnar_new_page(Relation rel)
+{
+	return ExtendBufferedRel(BMR_REL(rel), MAIN_FORKNUM, NULL, EB_LOCK_FIRST);
+}
+
+static void
+columnar_init_dir_page(Page page)
+{
+	ColumnarDirPageOpaque opaque;
+
+	PageInit(page, BLCKSZ, sizeof(ColumnarDirPageOpaqueData));
+	opaque = ColumnarPageGetDirOpaque(page);
+	opaque->next = InvalidBlockNumber;
+	opaque->nentries = 0;
+	opaque->page_id = COLUMNAR_DIR_PAGE_ID;
+}
+
+/*
+ * Reserve nrows consecutive row numbers, for a stripe to be inserted by
+ * transaction xmin and command cid.  A directory entry marked as reserved is
+ * added for them, and its location returned in *dirblock and *dirindex for
+ * columnar_write_stripe().
+ *
+ * Returns the first row number reserved.
+ */
+uint64
+columnar_reserve_rows(Relation rel, uint32 nrows,
+					  TransactionId xmin, CommandId cid,
+					  BlockNumber *dirblock, uint16 *dirindex)
+{
+	Buffer		metabuf;
+	Buffer		dirbuf;
+	Buffer		newbuf = InvalidBuffer;
+	ColumnarMetaPageData *meta;
+	GenericXLogState *state;
+	Page		dirpage;
+	ColumnarDirPageOpaque opaque;
+	ColumnarStripeEntry *entry;
+	uint64		first_row;
+
+	metabuf = columnar_lock_metapage(rel, BUFFER_LOCK_EXCLUSIVE, true);
+	meta = ColumnarPageGetMeta(BufferGetPage(metabuf));
+
+	first_row = meta->next_row;
+	if (first_row + nrows > COLUMNAR_MAX_ROW_NUMBER)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot insert more rows into columnar table \"%s\"",
+						RelationGetRelationName(rel)),
+				 errhint("Rewrite the table with VACUUM FULL.")));
+
+	if (BlockNumberIsValid(meta->dir_last))
+	{
+		dirbuf = ReadBuffer(rel, meta->dir_last);
+		LockBuffer(dirbuf, BUFFER_LOCK_EXCLUSIVE);
+		opaque = ColumnarPageGetDirOpaque(BufferGetPage(dirbuf));
+		if (opaque->nentries >= COLUMNAR_DIR_ENTRIES_PER_PAGE)
+			newbuf = columnar_new_page(rel);
+	}
+	else
+	{
+		dirbuf = InvalidBuffer;
+		newbuf = columnar_new_page(rel);
+	}
+
+	state = GenericXLogStart(rel);
+	meta = ColumnarPageGetMeta(GenericXLogRegisterBuffer(state, metabuf, 0));
+
+	if (BufferIsValid(newbuf))
+	{
+		BlockNumber newblk = BufferGetBlockNumber(newbuf);
+
+		if (BufferIsValid(dirbuf))
+		{
+			opaque = ColumnarPageGetDirOpaque(GenericXLogRegisterBuffer(state,
+																		dirbuf,
+																		0));
+			opaque->next = newblk;
+		}
+		else
+			meta->dir_first = newblk;
+		meta->dir_last = newblk;
+
+		dirpage = GenericXLogRegisterBuffer(state, newbuf,
+											GENERIC_XLOG_FULL_IMAGE);
+		columnar_init_dir_page(dirpage);
+		*dirblock = newblk;
+	}
+	else
+	{
+		dirpage = GenericXLogRegisterBuffer(state, dirbuf, 0);
+		*dirblock = BufferGetBlockNumber(dirbuf);
+	}
+
+	opaque = ColumnarPageGetDirOpaque(dirpage);
+	*dirindex = opaque->nentries;
+	entry = &ColumnarPageGetDirEntries(dirpage)[opaque->nentries++];
+	entry->first_row = first_row;
+	entry->nrows = nrows;
+	entry->xmin = xmin;
+	entry->cid = cid;
+	entry->start_block = InvalidBlockNumber;
+	entry->nblocks = 0;
+	entry->flags = COLUMNAR_STRIPE_RESERVED;
+	((PageHeader) dirpage)->pd_lower =
+		((char *) (entry + 1)) - (char *) dirpage;
+
+	meta->next_row = first_row + nrows;
+
+	GenericXLogFinish(state);
+
+	if (BufferIsValid(newbuf))
+		UnlockReleaseBuffer(newbuf);
+	if (BufferIsValid(dirbuf))
+		UnlockReleaseBuffer(dirbuf);
+	UnlockReleaseBuffer(metabuf);
+
+	return first_row;
+}
+
+/*
+ * Write the data of a stripe, whose row numbers were reserved with
+ * columnar_reserve_rows(), and mark its directory entry as written.
+ *
+ * nrows may be less than the number of row numbers reserved.  The remaining
+ * ones are given back if no other row numbers were reserved in between.
+ */
+void
+columnar_write_stripe(Relation rel, BlockNumber dirblock, uint16 dirindex,
+					  uint32 nrows, const char *data, Size len)
+{
+	BlockNumber start_block = InvalidBlockNumber;
+	uint32		nblocks;
+	uint32		blkno;
+	Buffer		metabuf;
+	Buffer		dirbuf;
+	GenericXLogState *state;
+	ColumnarMetaPageData *meta;
+	ColumnarStripeEntry *entry;
+
+	nblocks = (len + COLUMNAR_BYTES_PER_PAGE - 1) / COLUMNAR_BYTES_PER_PAGE;
+
+	/*
+	 * Hold the extension lock while adding the data blocks, so that they're
+	 * consecutive.  Only columnar_reserve_rows() extends the relation
+	 * otherwise, one block at a time.
+	 */
+	LockRelationForExtension(rel, ExclusiveLock);
+	for (blkno = 0; blkno < nblocks;)
+	{
+		Buffer		buffers[MAX_GENERIC_XLOG_PAGES];
+		int			nbuffers = 0;
+
+		state = GenericXLogStart(rel);
+		while (nbuffers < MAX_GENERIC_XLOG_PAGES && blkno < nblocks)
+		{
+			Buffer		buf = columnar_new_page(rel);
+			Page		page;
+			Size		off = (Size) blkno * COLUMNAR_BYTES_PER_PAGE;
+			Size		n = Min(len - off, COLUMNAR_BYTES_PER_PAGE);
+
+			if (blkno == 0)
+				start_block = BufferGetBlockNumber(buf);
+			else if (BufferGetBlockNumber(buf) != start_block + blkno)
+				elog(ERROR, "unexpected block %u in columnar table \"%s\", expected %u",
+					 BufferGetBlockNumber(buf), RelationGetRelationName(rel),
+					 start_block + blkno);
+
+			page = GenericXLogRegisterBuffer(state, buf,
+											 GENERIC_XLOG_FULL_IMAGE);
+			PageInit(page, BLCKSZ, 0);
+			memcpy(PageGetContents(page), data + off, n);
+			((PageHeader) page)->pd_lower = MAXALIGN(SizeOfPageHeaderData) + n;
+
+			buffers[nbuffers++] = buf;
+			blkno++;
+		}
+		GenericXLogFinish(state);
+
+		for (int i = 0; i < nbuffers; i++)
+			UnlockReleaseBuffer(buffers[i]);
+	}
+	UnlockRelationForExtension(rel, ExclusiveLock);
+
+	/* Now that the data is there, publish the stripe */
+	metabuf = columnar_lock_metapage(rel, BUFFER_LOCK_EXCLUSIVE, false);
+	dirbuf = ReadBuffer(rel, dirblock);
+	LockBuffer(dirbuf, BUFFER_LOCK_EXCLUSIVE);
+
+	state = GenericXLogStart(rel);
+	meta = ColumnarPageGetMeta(GenericXLogRegisterBuffer(state, metabuf, 0));
+	entry = &ColumnarPageGetDirEntries(GenericXLogRegisterBuffer(state,
+																 dirbuf,
+																 0))[dirindex];
+	Assert(entry->flags & COLUMNAR_STRIPE_RESERVED);
+	Assert(nrows <= entry->nrows);
+
+	if (meta->next_row == entry->first_row + entry->nrows)
+		meta->next_row = entry->first_row + nrows;
+
+	entry->nrows = nrows;
+	entry->start_block = start_block;
+	entry->nblocks = nblocks;
+	entry->flags &= ~COLUMNAR_STRIPE_RESERVED;
+
+	GenericXLogFinish(state);
+
+	UnlockReleaseBuffer(dirbuf);
+	UnlockReleaseBuffer(metabuf);
+}
+
+/*
+ * Return a palloc'd copy of the whole stripe directory, in order of row
+ * numbers.
+ */
+ColumnarStripeEntry *
+columnar_read_directory(Relation rel, int *nentries)
+{
+	Buffer		metabuf;
+	BlockNumber blkno;
+	ColumnarStripeEntry *entries;
+	int			maxentries = 0;
+
+	*nentries = 0;
+
+	metabuf = columnar_lock_metapage(rel, BUFFER_LOCK_SHARE, false);
+	if (!BufferIsValid(metabuf))
+		return NULL;
+	blkno = ColumnarPageGetMeta(BufferGetPage(metabuf))->dir_first;
+	UnlockReleaseBuffer(metabuf);
+
+	entries = NULL;
+	while (BlockNumberIsValid(blkno))
+	{
+		Buffer		buf;
+		Page		page;
+		ColumnarDirPageOpaque opaque;
+
+		buf = ReadBuffer(rel, blkno);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		opaque = ColumnarPageGetDirOpaque(page);
+		if (opaque->page_id != COLUMNAR_DIR_PAGE_ID)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("unexpected page type 0x%04X in columnar table \"%s\" block %u",
+							opaque->page_id, RelationGetRelationName(rel),
+							blkno)));
+
+		if (*nentries + opaque->nentries > maxentries)
+		{
+			maxentries = Max(maxentries * 2,
+							 *nentries + COLUMNAR_DIR_ENTRIES_PER_PAGE);
+			if (entries == NULL)
+				entries = palloc(maxentries * sizeof(ColumnarStripeEntry));
+			else
+				entries = repalloc(entries,
+								   maxentries * sizeof(ColumnarStripeEntry));
+		}
+		memcpy(&entries[*nentries], ColumnarPageGetDirEntries(page),
+			   opaque->nentries * sizeof(ColumnarStripeEntry));
+		*nentries += opaque->nentries;
+
+		blkno = opaque->next;
+		UnlockReleaseBuffer(buf);
+	}
+
+	return entries;
+}
+
+/*
+ * Copy len bytes at the given offset of a stripe's data into dest.
+ */
+void
+columnar_read_bytes(Relation rel, const ColumnarStripeEntry *entry,
+					uint32 offset, uint32 len, char *dest,
+					BufferAccessStrategy strategy)
+{
+	while (len > 0)
+	{
+		BlockNumber blkno = offset / COLUMNAR_BYTES_PER_PAGE;
+		uint32		pageoff = offset % COLUMNAR_BYTES_PER_PAGE;
+		uint32		n = Min(len, COLUMNAR_BYTES_PER_PAGE - pageoff);
+		Buffer		buf;
+
+		if (blkno >= entry->nblocks)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid offset %u in stripe at block %u of columnar table \"%s\"",
+							offset, entry->start_block,
+							RelationGetRelationName(rel))));
+
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, entry->start_block + blkno,
+								 RBM_NORMAL, strategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		memcpy(dest, PageGetContents(BufferGetPage(buf)) + pageoff, n);
+		UnlockReleaseBuffer(buf);
+
+		dest += n;
+		offset += n;
+		len -= n;
+	}
+}
+
+/*
+ * Are the rows of a stripe visible to the snapshot?
+ *
+ * Rows are never deleted or updated, so this only depends on the status of
+ * the inserting transaction.  Stripes whose data isn't written yet are
+ * invisible, see columnar_fetch_row() for how those are handled.
+ *
+ * SnapshotAny and SnapshotNonVacuumable see the rows of all transactions
+ * that didn't abort.  Indexing rows of aborted transactions would be of no
+ * use, and might even make a unique index build fail.
+ */
+bool
+columnar_stripe_visible(const ColumnarStripeEntry *entry, Snapshot snapshot)
+{
+	TransactionId xmin = entry->xmin;
+
+	if (snapshot->snapshot_type == SNAPSHOT_DIRTY)
+	{
+		snapshot->xmin = snapshot->xmax = InvalidTransactionId;
+		snapshot->speculativeToken = 0;
+	}
+
+	if (entry->flags & (COLUMNAR_STRIPE_RESERVED | COLUMNAR_STRIPE_INVALID))
+		return false;
+
+	/* frozen rows are visible to everyone */
+	if (!TransactionIdIsNormal(xmin))
+		return true;
+
+	switch (snapshot->snapshot_type)
+	{
+		case SNAPSHOT_MVCC:
+			if (TransactionIdIsCurrentTransactionId(xmin))
+				return entry->cid < snapshot->curcid;
+			if (XidInMVCCSnapshot(xmin, snapshot))
+				return false;
+			return TransactionIdDidCommit(xmin);
+
+		case SNAPSHOT_SELF:
+			if (TransactionIdIsCurrentTransactionId(xmin))
+				return true;
+			if (TransactionIdIsInProgress(xmin))
+				return false;
+			return TransactionIdDidCommit(xmin);
+
+		case SNAPSHOT_DIRTY:
+			if (TransactionIdIsCurrentTransactionId(xmin))
+				return true;
+			if (TransactionIdIsInProgress(xmin))
+			{
+				snapshot->xmin = xmin;
+				return true;
+			}
+			return TransactionIdDidCommit(xmin);
+
+		case SNAPSHOT_ANY:
+		case SNAPSHOT_NON_VACUUMABLE:
+			if (TransactionIdIsCurrentTransactionId(xmin) ||
+				TransactionIdIsInProgress(xmin))
+				return true;
+			return TransactionIdDidCommit(xmin);
+
+		case SNAPSHOT_TOAST:
+		case SNAPSHOT_HISTORIC_MVCC:
+			break;
+	}
+
+	elog(ERROR, "unsupported snapshot type %d for columnar table",
+		 (int) snapshot->snapshot_type);
+	return false;				/* keep compiler quiet */
+}
+
+/*
+ * Find the directory entry holding the given row number, by binary search.
+ * Returns -1 if there's none.
+ */
+int
+columnar_find_stripe(const ColumnarStripeEntry *entries, int nentries,
+					 uint64 row)
+{
+	int			lo = 0;
+	int			hi = nentries - 1;
+
+	while (lo <= hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (row < entries[mid].first_row)
+			hi = mid - 1;
+		else if (row >= entries[mid].first_row + entries[mid].nrows)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+
+	return -1;
+}
+
+/*
+ * Freeze the stripes of committed transactions older than OldestXmin, and
+ * mark those of aborted transactions as invalid, so that no clog lookups are
+ * needed for any of them anymore.  Afterwards, OldestXmin can be used as the
+ * table's relfrozenxid.
+ *
+ * Returns the number of rows of the stripes that remain valid.
+ */
+uint64
+columnar_vacuum_directory(Relation rel, TransactionId OldestXmin)
+{
+	Buffer		metabuf;
+	BlockNumber blkno;
+	uint64		nrows = 0;
+
+	metabuf = columnar_lock_metapage(rel, BUFFER_LOCK_SHARE, false);
+	if (!BufferIsValid(metabuf))
+		return 0;
+	blkno = ColumnarPageGetMeta(BufferGetPage(metabuf))->dir_first;
+	UnlockReleaseBuffer(metabuf);
+
+	while (BlockNumberIsValid(blkno))
+	{
+		Buffer		buf;
+		Page		page;
+		GenericXLogState *state = NULL;
+		ColumnarDirPageOpaque opaque;
+		ColumnarStripeEntry *entries;
+
+		vacuum_delay_point();
+
+		buf = ReadBuffer(rel, blkno);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+		opaque = ColumnarPageGetDirOpaque(page);
+		if (opaque->page_id != COLUMNAR_DIR_PAGE_ID)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("unexpected page type 0x%04X in columnar table \"%s\" block %u",
+							opaque->page_id, RelationGetRelationName(rel),
+							blkno)));
+		entries = ColumnarPageGetDirEntries(page);
+
+		for (int i = 0; i < opaque->nentries; i++)
+		{
+			ColumnarStripeEntry *entry = &entries[i];
+			bool		freeze = false;
+			bool		invalidate = false;
+
+			if (entry->flags & COLUMNAR_STRIPE_INVALID)
+				continue;
+
+			if (!TransactionIdIsNormal(entry->xmin))
+				;
+			else if (TransactionIdIsCurrentTransactionId(entry->xmin) ||
+					 TransactionIdIsInProgress(entry->xmin))
+				;
+			else if (!TransactionIdDidCommit(entry->xmin))
+				invalidate = true;
+			else if ((entry->flags & COLUMNAR_STRIPE_RESERVED) == 0 &&
+					 TransactionIdPrecedes(entry->xmin, OldestXmin))
+				freeze = true;
+
+			if (freeze || invalidate)
+			{
+				/* register the page the first time it needs a change */
+				if (state == NULL)
+				{
+					state = GenericXLogStart(rel);
+					entries = ColumnarPageGetDirEntries(GenericXLogRegisterBuffer(state,
+																				  buf,
+																				  0));
+					entry = &entries[i];
+				}
+				if (freeze)
+					entry->xmin = FrozenTransactionId;
+				else
+					entry->flags |= COLUMNAR_STRIPE_INVALID;
+			}
+
+			if (!invalidate && (entry->flags & COLUMNAR_STRIPE_RESERVED) == 0)
+				nrows += entry->nrows;
+		}
+
+		if (state != NULL)
+			GenericXLogFinish(state);
+
+		blkno = opaque->next;
+		UnlockReleaseBuffer(buf);
+	}
+
+	return nrows;
+}
@@ -0,0 +1,577 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_writer.c
+ *	  Buffering of inserted rows and building of stripes for columnar
+ *	  tables.
+ *
+ * Rows inserted into a columnar table are collected in backend-local
+ * memory, column by column, until there are enough of them for a stripe,
+ * or until they have to be written for some other reason:
+ *
+ * - A stripe only holds rows of one command of one subtransaction, so the
+ *	 pending rows are written when rows come from another one.
+ * - Scans only see written stripes, so the pending rows of a table are
+ *	 written before it's scanned, see columnar_flush_pending().
+ * - At commit, all pending rows are written, see PreCommit_Columnar().
+ *
+ * The row numbers of the pending rows are reserved in the directory right
+ * away, so the rows have TIDs that can be put into indexes.  Fetching a row
+ * by TID looks at the pending rows too, see columnar_fetch_pending().
+ *
+ * Rows of aborted subtransactions are simply forgotten.  Their reserved
+ * directory entries have an aborted xmin, so they're never visible.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_writer.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/detoast.h"
+#include "access/relation.h"
+#include "access/toast_compression.h"
+#include "access/toast_internals.h"
+#include "access/tupmacs.h"
+#include "access/xact.h"
+#include "utils/datum.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/typcache.h"
+
+/*
+ * Limits on the size of a stripe.  The number of rows is also the number of
+ * row numbers reserved at a time.
+ */
+#define COLUMNAR_STRIPE_MAX_ROWS	150000
+#define COLUMNAR_STRIPE_MAX_BYTES	(64 * 1024 * 1024)
+
+/* chunks smaller than this aren't worth compressing */
+#define COLUMNAR_CHUNK_MIN_COMPRESS 256
+
+struct ColumnarWriteState
+{
+	Oid			relid;
+	TransactionId xmin;
+	CommandId	cid;
+	SubTransactionId subid;		/* for pending rows, see below */
+	int			natts;
+
+	/* reservation of row numbers for the current stripe */
+	uint64		first_row;
+	BlockNumber dirblock;
+	uint16		dirindex;
+
+	/* rows of the current stripe, column by column */
+	uint32		nrows;
+	uint32		maxrows;		/* allocated length of the arrays */
+	Datum	  **values;
+	bool	  **isnull;
+
+	/* comparison functions for computing min and max, or NULL */
+	FmgrInfo  **cmpfns;
+
+	MemoryContext cxt;			/* holds this struct */
+	MemoryContext rowcxt;		/* holds the rows of the current stripe */
+
+	struct ColumnarWriteState *next;	/* next pending write state */
+};
+
+/*
+ * The pending rows of the current transaction, one write state per table.
+ * They live in TopTransactionContext.
+ */
+static ColumnarWriteState *pending_writes = NULL;
+
+static void columnar_write_current_stripe(ColumnarWriteState *state,
+										  Relation rel);
+static void columnar_build_chunk(ColumnarWriteState *state,
+								 Form_pg_attribute att, int attoff,
+								 StringInfo buf, ColumnarChunkInfo *info);
+static void append_zeros(StringInfo buf, int n);
+static ColumnarWriteState *columnar_find_pending(Oid relid,
+												 ColumnarWriteState ***prev);
+
+
+/*
+ * Prepare for writing rows into a columnar table, as stripes inserted by
+ * transaction xmin and command cid.  The write state is allocated in the
+ * current memory context.
+ */
+ColumnarWriteState *
+columnar_begin_write(Relation rel, TransactionId xmin, CommandId cid)
+{
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+	ColumnarWriteState *state;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext,
+								"columnar write",
+								ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	state = palloc0(sizeof(ColumnarWriteState));
+	state->relid = RelationGetRelid(rel);
+	state->xmin = xmin;
+	state->cid = cid;
+	state->natts = tupdesc->natts;
+	state->values = palloc0(state->natts * sizeof(Datum *));
+	state->isnull = palloc0(state->natts * sizeof(bool *));
+	state->cmpfns = palloc0(state->natts * sizeof(FmgrInfo *));
+	state->cxt = cxt;
+	state->rowcxt = AllocSetContextCreate(cxt,
+										  "columnar write rows",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	for (int i = 0; i < state->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+		TypeCacheEntry *typentry;
+
+		if (att->attisdropped || !att->attbyval)
+			continue;
+
+		typentry = lookup_type_cache(att->atttypid,
+									 TYPECACHE_CMP_PROC_FINFO);
+		if (OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			state->cmpfns[i] = &typentry->cmp_proc_finfo;
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return state;
+}
+
+/*
+ * Add a row, and return its row number.  Varlena values are detoasted, so
+ * the row doesn't depend on any other storage.
+ */
+uint64
+columnar_write_row(ColumnarWriteState *state, Relation rel,
+				   const Datum *values, const bool *isnull)
+{
+	MemoryContext oldcxt;
+	uint32		rowidx;
+
+	if (state->nrows == 0)
+		state->first_row = columnar_reserve_rows(rel,
+												 COLUMNAR_STRIPE_MAX_ROWS,
+												 state->xmin, state->cid,
+												 &state->dirblock,
+												 &state->dirindex);
+
+	oldcxt = MemoryContextSwitchTo(state->rowcxt);
+
+	if (state->nrows >= state->maxrows)
+	{
+		uint32		newmax = Max(state->maxrows * 2, 1024);
+
+		newmax = Min(newmax, COLUMNAR_STRIPE_MAX_ROWS);
+		for (int i = 0; i < state->natts; i++)
+		{
+			if (state->values[i] == NULL)
+			{
+				state->values[i] = palloc(newmax * sizeof(Datum));
+				state->isnull[i] = palloc(newmax * sizeof(bool));
+			}
+			else
+			{
+				state->values[i] = repalloc(state->values[i],
+											newmax * sizeof(Datum));
+				state->isnull[i] = repalloc(state->isnull[i],
+											newmax * sizeof(bool));
+			}
+		}
+		state->maxrows = newmax;
+	}
+
+	rowidx = state->nrows++;
+	for (int i = 0; i < state->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(RelationGetDescr(rel), i);
+		Datum		value = values[i];
+
+		state->isnull[i][rowidx] = isnull[i] || att->attisdropped;
+		if (state->isnull[i][rowidx])
+		{
+			state->values[i][rowidx] = (Datum) 0;
+			continue;
+		}
+
+		if (att->attlen == -1 &&
+			(VARATT_IS_EXTERNAL(DatumGetPointer(value)) ||
+			 VARATT_IS_COMPRESSED(DatumGetPointer(value))))
+			value = PointerGetDatum(detoast_attr((struct varlena *)
+												 DatumGetPointer(value)));
+		else
+			value = datumCopy(value, att->attbyval, att->attlen);
+		state->values[i][rowidx] = value;
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	if (state->nrows >= COLUMNAR_STRIPE_MAX_ROWS ||
+		MemoryContextMemAllocated(state->rowcxt, false) >=
+		COLUMNAR_STRIPE_MAX_BYTES)
+		columnar_write_current_stripe(state, rel);
+
+	return state->first_row + rowidx;
+}
+
+/*
+ * Write out the remaining rows, and free the write state.
+ */
+void
+columnar_end_write(ColumnarWriteState *state, Relation rel)
+{
+	if (state->nrows > 0)
+		columnar_write_current_stripe(state, rel);
+	MemoryContextDelete(state->cxt);
+}
+
+/*
+ * Build a stripe from the rows collected, and write it.
+ */
+static void
+columnar_write_current_stripe(ColumnarWriteState *state, Relation rel)
+{
+	MemoryContext oldcxt;
+	ColumnarStripeHeader *header;
+	Size		hdrsize = SizeOfColumnarStripeHeader(state->natts);
+	StringInfoData stream;
+	StringInfoData chunk;
+
+	Assert(state->nrows > 0);
+
+	oldcxt = MemoryContextSwitchTo(state->rowcxt);
+
+	header = palloc0(hdrsize);
+	header->natts = state->natts;
+	header->nrows = state->nrows;
+
+	initStringInfo(&stream);
+	append_zeros(&stream, hdrsize);
+
+	initStringInfo(&chunk);
+	for (int i = 0; i < state->natts; i++)
+	{
+		resetStringInfo(&chunk);
+		columnar_build_chunk(state, TupleDescAttr(RelationGetDescr(rel), i),
+							 i, &chunk, &header->chunks[i]);
+		header->chunks[i].offset = stream.len;
+		appendBinaryStringInfo(&stream,
+							   chunk.data, header->chunks[i].size);
+	}
+	memcpy(stream.data, header, hdrsize);
+
+	columnar_write_stripe(rel, state->dirblock, state->dirindex,
+						  state->nrows, stream.data, stream.len);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	state->nrows = 0;
+	state->maxrows = 0;
+	memset(state->values, 0, state->natts * sizeof(Datum *));
+	memset(state->isnull, 0, state->natts * sizeof(bool *));
+	MemoryContextReset(state->rowcxt);
+}
+
+/*
+ * Build the chunk of one column into buf, compressing it if worthwhile.
+ */
+static void
+columnar_build_chunk(ColumnarWriteState *state, Form_pg_attribute att,
+					 int attoff, StringInfo buf, ColumnarChunkInfo *info)
+{
+	Datum	   *values = state->values[attoff];
+	bool	   *isnull = state->isnull[attoff];
+	FmgrInfo   *cmpfn = state->cmpfns[attoff];
+	int			bitmapoff = 0;
+	Datum		compressed;
+
+	memset(info, 0, sizeof(ColumnarChunkInfo));
+
+	append_zeros(buf, VARHDRSZ);
+
+	for (uint32 i = 0; i < state->nrows; i++)
+		if (isnull[i])
+			info->nnulls++;
+	if (info->nnulls > 0)
+	{
+		bitmapoff = buf->len;
+		append_zeros(buf, BITMAPLEN(state->nrows));
+	}
+
+	for (uint32 i = 0; i < state->nrows; i++)
+	{
+		Datum		value = values[i];
+		int			off;
+		char	   *ptr;
+
+		if (isnull[i])
+			continue;
+
+		if (info->nnulls > 0)
+			((bits8 *) buf->data + bitmapoff)[i >> 3] |= (1 << (i & 0x07));
+
+		off = att_align_datum(buf->len, att->attalign, att->attlen, value);
+		append_zeros(buf, off - buf->len);
+
+		off = att_addlength_datum(buf->len, att->attlen, value);
+		enlargeStringInfo(buf, off - buf->len);
+		ptr = buf->data + buf->len;
+		if (att->attbyval)
+			store_att_byval(ptr, value, att->attlen);
+		else
+			memcpy(ptr, DatumGetPointer(value), off - buf->len);
+		buf->len = off;
+
+		if (cmpfn != NULL)
+		{
+			Oid			collation = att->attcollation;
+
+			if (!info->has_minmax)
+			{
+				info->min = info->max = value;
+				info->has_minmax = true;
+			}
+			else if (DatumGetInt32(FunctionCall2Coll(cmpfn, collation,
+													 value, info->min)) < 0)
+				info->min = value;
+			else if (DatumGetInt32(FunctionCall2Coll(cmpfn, collation,
+													 value, info->max)) > 0)
+				info->max = value;
+		}
+	}
+	SET_VARSIZE(buf->data, buf->len);
+	info->size = buf->len;
+
+	if (buf->len < COLUMNAR_CHUNK_MIN_COMPRESS)
+		return;
+
+	compressed = toast_compress_datum(PointerGetDatum(buf->data),
+									  att->attcompression);
+	if (DatumGetPointer(compressed) != NULL)
+	{
+		info->size = VARSIZE(DatumGetPointer(compressed));
+		resetStringInfo(buf);
+		appendBinaryStringInfo(buf, DatumGetPointer(compressed), info->size);
+		pfree(DatumGetPointer(compressed));
+	}
+}
+
+static void
+append_zeros(StringInfo buf, int n)
+{
+	enlargeStringInfo(buf, n);
+	memset(buf->data + buf->len, 0, n);
+	buf->len += n;
+	buf->data[buf->len] = '\0';
+}
+
+
+/* ----------------------------------------------------------------
+ *		Pending rows of the current transaction
+ * ----------------------------------------------------------------
+ */
+
+static ColumnarWriteState *
+columnar_find_pending(Oid relid, ColumnarWriteState ***prev)
+{
+	ColumnarWriteState **p;
+
+	for (p = &pending_writes; *p != NULL; p = &(*p)->next)
+	{
+		if ((*p)->relid == relid)
+		{
+			if (prev)
+				*prev = p;
+			return *p;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Insert a row into a columnar table, as part of command cid, and set the
+ * slot's TID.
+ */
+void
+columnar_insert(Relation rel, TupleTableSlot *slot, CommandId cid)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState **prev;
+	uint64		row;
+
+	state = columnar_find_pending(RelationGetRelid(rel), &prev);
+	if (state != NULL &&
+		(state->cid != cid || state->subid != GetCurrentSubTransactionId()))
+	{
+		*prev = state->next;
+		columnar_end_write(state, rel);
+		state = NULL;
+	}
+
+	if (state == NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(TopTransactionContext);
+
+		state = columnar_begin_write(rel, GetCurrentTransactionId(), cid);
+		state->subid = GetCurrentSubTransactionId();
+		state->next = pending_writes;
+		pending_writes = state;
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	slot_getallattrs(slot);
+	row = columnar_write_row(state, rel, slot->tts_values, slot->tts_isnull);
+	columnar_row_to_tid(row, &slot->tts_tid);
+}
+
+/*
+ * Write the pending rows of a table, if there are any.
+ */
+void
+columnar_flush_pending(Relation rel)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState **prev;
+
+	state = columnar_find_pending(RelationGetRelid(rel), &prev);
+	if (state != NULL)
+	{
+		*prev = state->next;
+		columnar_end_write(state, rel);
+	}
+}
+
+/*
+ * Forget the pending rows of a table, because its storage is being replaced.
+ */
+void
+columnar_discard_pending(Relation rel)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState **prev;
+
+	state = columnar_find_pending(RelationGetRelid(rel), &prev);
+	if (state != NULL)
+	{
+		*prev = state->next;
+		MemoryContextDelete(state->cxt);
+	}
+}
+
+/*
+ * Look for a row among the pending rows of a table.  If it's there, store a
+ * copy of it in the slot, unless that's NULL, and return the command that
+ * inserted it.
+ */
+bool
+columnar_fetch_pending(Relation rel, uint64 row, TupleTableSlot *slot,
+					   CommandId *cid)
+{
+	ColumnarWriteState *state;
+	uint32		rowidx;
+
+	state = columnar_find_pending(RelationGetRelid(rel), NULL);
+	if (state == NULL || state->nrows == 0 ||
+		row < state->first_row || row >= state->first_row + state->nrows)
+		return false;
+
+	rowidx = row - state->first_row;
+
+	if (slot != NULL)
+	{
+		ExecClearTuple(slot);
+		for (int i = 0; i < state->natts; i++)
+		{
+			slot->tts_values[i] = state->values[i][rowidx];
+			slot->tts_isnull[i] = state->isnull[i][rowidx];
+		}
+		ExecStoreVirtualTuple(slot);
+		ExecMaterializeSlot(slot);
+		columnar_row_to_tid(row, &slot->tts_tid);
+	}
+
+	*cid = state->cid;
+	return true;
+}
+
+/*
+ * Write all pending rows, at commit or prepare.
+ */
+void
+PreCommit_Columnar(void)
+{
+	while (pending_writes != NULL)
+	{
+		ColumnarWriteState *state = pending_writes;
+		Relation	rel;
+
+		pending_writes = state->next;
+
+		/* the table might have been dropped since */
+		rel = try_relation_open(state->relid, NoLock);
+		if (rel == NULL)
+		{
+			MemoryContextDelete(state->cxt);
+			continue;
+		}
+		columnar_end_write(state, rel);
+		relation_close(rel, NoLock);
+	}
+}
+
+/*
+ * The pending rows are gone with TopTransactionContext at the end of the
+ * transaction.
+ */
+void
+AtEOXact_Columnar(bool isCommit)
+{
+	Assert(!isCommit || pending_writes == NULL);
+	pending_writes = NULL;
+}
+
+/*
+ * At subtransaction commit, the pending rows become the parent's.  At
+ * abort, the pending rows of the subtransaction are forgotten.  Rows are
+ * only added to pending rows of the same subtransaction, so those of the
+ * parent aren't affected.
+ */
+void
+AtEOSubXact_Columnar(bool isCommit, SubTransactionId mySubid,
+					 SubTransactionId parentSubid)
+{
+	ColumnarWriteState **p = &pending_writes;
+
+	while (*p != NULL)
+	{
+		ColumnarWriteState *state = *p;
+
+		if (state->subid != mySubid)
+		{
+			p = &state->next;
+			continue;
+		}
+
+		if (isCommit)
+		{
+			state->subid = parentSubid;
+			p = &state->next;
+		}
+		else
+		{
+			*p = state->next;
+			MemoryContextDelete(state->cxt);
+		}
+	}
+}
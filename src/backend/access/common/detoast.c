@@ -17,11 +17,43 @@
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/toast_internals.h"
+#include "access/xact.h"
 #include "common/int.h"
 #include "common/pg_lzcompress.h"
+#include "miscadmin.h"
+#include "storage/proc.h"
 #include "utils/expandeddatum.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 
+/*
+ * Cache of recently detoasted out-of-line values.
+ *
+ * Queries often detoast the same value several times, for instance when a
+ * column is passed to more than one function or operator.  Out-of-line
+ * values are never modified once stored, and a value ID can't be reused by
+ * the same TOAST table within one transaction, so we keep the last few
+ * fully detoasted values of the current transaction around and hand out
+ * copies of them.  Their total size is limited to work_mem.
+ */
+#define TOAST_CACHE_ENTRIES		8
+
+typedef struct ToastCacheEntry
+{
+	Oid			toastrelid;
+	Oid			valueid;
+	struct varlena *value;		/* NULL if the entry is unused */
+} ToastCacheEntry;
+
+static ToastCacheEntry toast_cache[TOAST_CACHE_ENTRIES];
+static int	toast_cache_next = 0;
+static Size toast_cache_bytes = 0;
+static MemoryContext toast_cache_context = NULL;
+static LocalTransactionId toast_cache_lxid = InvalidLocalTransactionId;
+
+static struct varlena *toast_cache_lookup(struct varatt_external *toast_pointer);
+static void toast_cache_remember(struct varatt_external *toast_pointer,
+								 struct varlena *value);
 static struct varlena *toast_fetch_datum(struct varlena *attr);
 static struct varlena *toast_fetch_datum_slice(struct varlena *attr,
 											   int32 sliceoffset,
@@ -117,6 +149,15 @@ detoast_attr(struct varlena *attr)
 {
 	if (VARATT_IS_EXTERNAL_ONDISK(attr))
 	{
+		struct varatt_external toast_pointer;
+		struct varlena *cached;
+
+		/* Maybe we've detoasted it recently */
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+		cached = toast_cache_lookup(&toast_pointer);
+		if (cached != NULL)
+			return cached;
+
 		/*
 		 * This is an externally stored datum --- fetch it back from there
 		 */
@@ -129,6 +170,8 @@ detoast_attr(struct varlena *attr)
 			attr = toast_decompress_datum(tmp);
 			pfree(tmp);
 		}
+
+		toast_cache_remember(&toast_pointer, attr);
 	}
 	else if (VARATT_IS_EXTERNAL_INDIRECT(attr))
 	{
@@ -332,6 +375,93 @@ detoast_attr_slice(struct varlena *attr,
 	return result;
 }
 
+/*
+ * Return a palloc'd copy of the cached detoasted value for the given TOAST
+ * pointer, or NULL if it's not cached.
+ */
+static struct varlena *
+toast_cache_lookup(struct varatt_external *toast_pointer)
+{
+	/* The cache's memory went away with the previous transaction */
+	if (toast_cache_lxid != MyProc->vxid.lxid)
+		return NULL;
+
+	for (int i = 0; i < TOAST_CACHE_ENTRIES; i++)
+	{
+		ToastCacheEntry *entry = &toast_cache[i];
+
+		if (entry->value != NULL &&
+			entry->valueid == toast_pointer->va_valueid &&
+			entry->toastrelid == toast_pointer->va_toastrelid)
+		{
+			struct varlena *result;
+
+			result = (struct varlena *) palloc(VARSIZE(entry->value));
+			memcpy(result, entry->value, VARSIZE(entry->value));
+			return result;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Remember a copy of a value that was just detoasted, if it's not too big.
+ */
+static void
+toast_cache_remember(struct varatt_external *toast_pointer,
+					 struct varlena *value)
+{
+	Size		budget = (Size) work_mem * 1024;
+	Size		size = VARSIZE(value);
+	ToastCacheEntry *entry;
+
+	/* Don't let one value take more than a quarter of the cache */
+	if (size > budget / 4 || !IsTransactionState())
+		return;
+
+	/*
+	 * Start afresh in a new transaction.  The previous transaction's context
+	 * was deleted along with TopTransactionContext, so just forget it.
+	 */
+	if (toast_cache_lxid != MyProc->vxid.lxid)
+	{
+		toast_cache_context = AllocSetContextCreate(TopTransactionContext,
+													"TOAST value cache",
+													ALLOCSET_DEFAULT_SIZES);
+		for (int i = 0; i < TOAST_CACHE_ENTRIES; i++)
+			toast_cache[i].value = NULL;
+		toast_cache_next = 0;
+		toast_cache_bytes = 0;
+		toast_cache_lxid = MyProc->vxid.lxid;
+	}
+
+	/* Make room, evicting the oldest entries first */
+	for (int i = 0; i < TOAST_CACHE_ENTRIES; i++)
+	{
+		entry = &toast_cache[(toast_cache_next + i) % TOAST_CACHE_ENTRIES];
+
+		if (i > 0 && toast_cache_bytes + size <= budget)
+			break;
+		if (entry->value != NULL)
+		{
+			toast_cache_bytes -= VARSIZE(entry->value);
+			pfree(entry->value);
+			entry->value = NULL;
+		}
+	}
+
+	entry = &toast_cache[toast_cache_next];
+	toast_cache_next = (toast_cache_next + 1) % TOAST_CACHE_ENTRIES;
+
+	entry->toastrelid = toast_pointer->va_toastrelid;
+	entry->valueid = toast_pointer->va_valueid;
+	entry->value = (struct varlena *) MemoryContextAlloc(toast_cache_context,
+														 size);
+	memcpy(entry->value, value, size);
+	toast_cache_bytes += size;
+}
+
 /* ----------
  * toast_fetch_datum -
  *
@@ -485,6 +615,8 @@ toast_decompress_datum(struct varlena *attr)
 			return pglz_decompress_datum(attr);
 		case TOAST_LZ4_COMPRESSION_ID:
 			return lz4_decompress_datum(attr);
+		case TOAST_ZSTD_COMPRESSION_ID:
+			return zstd_decompress_datum(attr);
 		default:
 			elog(ERROR, "invalid compression method id %d", cmid);
 			return NULL;		/* keep compiler quiet */
@@ -528,6 +660,8 @@ toast_decompress_datum_slice(struct varlena *attr, int32 slicelength)
 			return pglz_decompress_datum_slice(attr, slicelength);
 		case TOAST_LZ4_COMPRESSION_ID:
 			return lz4_decompress_datum_slice(attr, slicelength);
+		case TOAST_ZSTD_COMPRESSION_ID:
+			return zstd_decompress_datum_slice(attr, slicelength);
 		default:
 			elog(ERROR, "invalid compression method id %d", cmid);
 			return NULL;		/* keep compiler quiet */
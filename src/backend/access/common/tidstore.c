@@ -147,8 +147,6 @@ struct TidStoreIter
 	TidStoreIterResult output;
 };
 
-static void tidstore_iter_extract_tids(TidStoreIter *iter, BlockNumber blkno,
-									   BlocktableEntry *page);
 
 /*
  * Create a TidStore. The TidStore will live in the memory context that is
@@ -486,13 +484,6 @@ TidStoreBeginIterate(TidStore *ts)
 	iter = palloc0(sizeof(TidStoreIter));
 	iter->ts = ts;
 
-	/*
-	 * We start with an array large enough to contain at least the offsets
-	 * from one completely full bitmap element.
-	 */
-	iter->output.max_offset = 2 * BITS_PER_BITMAPWORD;
-	iter->output.offsets = palloc(sizeof(OffsetNumber) * iter->output.max_offset);
-
 	if (TidStoreIsShared(ts))
 		iter->tree_iter.shared = shared_ts_begin_iterate(ts->tree.shared);
 	else
@@ -503,9 +494,9 @@ TidStoreBeginIterate(TidStore *ts)
 
 
 /*
- * Scan the TidStore and return the TIDs of the next block. The offsets in
- * each iteration result are ordered, as are the block numbers over all
- * iterations.
+ * Scan the TidStore and return the next block.  The block numbers over all
+ * iterations are ordered.  Use TidStoreGetBlockOffsets() to get the offsets
+ * of the block.
  */
 TidStoreIterResult *
 TidStoreIterateNext(TidStoreIter *iter)
@@ -521,12 +512,66 @@ TidStoreIterateNext(TidStoreIter *iter)
 	if (page == NULL)
 		return NULL;
 
-	/* Collect TIDs from the key-value pair */
-	tidstore_iter_extract_tids(iter, (BlockNumber) key, page);
+	iter->output.blkno = (BlockNumber) key;
+	iter->output.internal_page = page;
 
 	return &(iter->output);
 }
 
+/*
+ * Get the offsets of the block of an iteration result into the given array,
+ * in order.  Returns the number of offsets of the block, which can be more
+ * than max_offsets, in which case only the first max_offsets are stored.
+ *
+ * The result stays valid until the TidStore is modified, so this can be
+ * called after TidStoreIterateNext() has returned following blocks.
+ */
+int
+TidStoreGetBlockOffsets(TidStoreIterResult *result,
+						OffsetNumber *offsets,
+						int max_offsets)
+{
+	BlocktableEntry *page = result->internal_page;
+	int			num_offsets = 0;
+	int			wordnum;
+
+	if (page->header.nwords == 0)
+	{
+		/* we have offsets in the header */
+		for (int i = 0; i < NUM_FULL_OFFSETS; i++)
+		{
+			if (page->header.full_offsets[i] != InvalidOffsetNumber)
+			{
+				if (num_offsets < max_offsets)
+					offsets[num_offsets] = page->header.full_offsets[i];
+				num_offsets++;
+			}
+		}
+	}
+	else
+	{
+		for (wordnum = 0; wordnum < page->header.nwords; wordnum++)
+		{
+			bitmapword	w = page->words[wordnum];
+			int			off = wordnum * BITS_PER_BITMAPWORD;
+
+			while (w != 0)
+			{
+				if (w & 1)
+				{
+					if (num_offsets < max_offsets)
+						offsets[num_offsets] = (OffsetNumber) off;
+					num_offsets++;
+				}
+				off++;
+				w >>= 1;
+			}
+		}
+	}
+
+	return num_offsets;
+}
+
 /*
  * Finish the iteration on TidStore.
  *
@@ -540,7 +585,6 @@ TidStoreEndIterate(TidStoreIter *iter)
 	else
 		local_ts_end_iterate(iter->tree_iter.local);
 
-	pfree(iter->output.offsets);
 	pfree(iter);
 }
 
@@ -574,49 +618,3 @@ TidStoreGetHandle(TidStore *ts)
 
 	return (dsa_pointer) shared_ts_get_handle(ts->tree.shared);
 }
-
-/* Extract TIDs from the given key-value pair */
-static void
-tidstore_iter_extract_tids(TidStoreIter *iter, BlockNumber blkno,
-						   BlocktableEntry *page)
-{
-	TidStoreIterResult *result = (&iter->output);
-	int			wordnum;
-
-	result->num_offsets = 0;
-	result->blkno = blkno;
-
-	if (page->header.nwords == 0)
-	{
-		/* we have offsets in the header */
-		for (int i = 0; i < NUM_FULL_OFFSETS; i++)
-		{
-			if (page->header.full_offsets[i] != InvalidOffsetNumber)
-				result->offsets[result->num_offsets++] = page->header.full_offsets[i];
-		}
-	}
-	else
-	{
-		for (wordnum = 0; wordnum < page->header.nwords; wordnum++)
-		{
-			bitmapword	w = page->words[wordnum];
-			int			off = wordnum * BITS_PER_BITMAPWORD;
-
-			/* Make sure there is enough space to add offsets */
-			if ((result->num_offsets + BITS_PER_BITMAPWORD) > result->max_offset)
-			{
-				result->max_offset *= 2;
-				result->offsets = repalloc(result->offsets,
-										   sizeof(OffsetNumber) * result->max_offset);
-			}
-
-			while (w != 0)
-			{
-				if (w & 1)
-					result->offsets[result->num_offsets++] = (OffsetNumber) off;
-				off++;
-				w >>= 1;
-			}
-		}
-	}
-}
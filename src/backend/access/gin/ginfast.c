@@ -41,6 +41,15 @@ int			gin_pending_list_limit = 0;
 #define GIN_PAGE_FREESIZE \
 	( BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(GinPageOpaqueData)) )
 
+/*
+ * A cleanup triggered by an insertion moves the oldest pending pages into
+ * the main index in runs of this fraction of the pending list size limit,
+ * and stops as soon as the list is back under the limit.  That spreads the
+ * cleanup over several insertions instead of making a single insertion pay
+ * for the whole list.
+ */
+#define GIN_PENDING_CLEANUP_RUNS	4
+
 typedef struct KeyArray
 {
 	Datum	   *keys;			/* expansible array */
@@ -796,6 +805,10 @@ ginInsertCleanup(GinState *ginstate, bool full_clean,
 	bool		cleanupFinish = false;
 	bool		fsm_vac = false;
 	Size		workMemory;
+	Size		cleanupSize = 0;
+	BlockNumber runPages = InvalidBlockNumber;
+	BlockNumber nrunpages = 0;
+	bool		underLimit;
 
 	/*
 	 * We would like to prevent concurrent cleanup process. For that we will
@@ -825,6 +838,14 @@ ginInsertCleanup(GinState *ginstate, bool full_clean,
 		if (!ConditionalLockPage(index, GIN_METAPAGE_BLKNO, ExclusiveLock))
 			return;
 		workMemory = work_mem;
+
+		/*
+		 * Clean up incrementally: flush a run of pages at a time, and only
+		 * as many runs as needed to get the list under the limit again.
+		 */
+		cleanupSize = GinGetPendingListCleanupSize(index);
+		runPages = Max(cleanupSize * 1024L / GIN_PAGE_FREESIZE /
+					   GIN_PENDING_CLEANUP_RUNS, 1);
 	}
 
 	metabuffer = ReadBuffer(index, GIN_METAPAGE_BLKNO);
@@ -891,17 +912,19 @@ ginInsertCleanup(GinState *ginstate, bool full_clean,
 		 * read page's datums into accum
 		 */
 		processPendingPage(&accum, &datums, page, FirstOffsetNumber);
+		nrunpages++;
 
 		vacuum_delay_point();
 
 		/*
 		 * Is it time to flush memory to disk?	Flush if we are at the end of
 		 * the pending list, or if we have a full row and memory is getting
-		 * full.
+		 * full or the current run is complete.
 		 */
 		if (GinPageGetOpaque(page)->rightlink == InvalidBlockNumber ||
 			(GinPageHasFullRow(page) &&
-			 (accum.allocatedMemory >= workMemory * 1024L)))
+			 (accum.allocatedMemory >= workMemory * 1024L ||
+			  nrunpages >= runPages)))
 		{
 			ItemPointerData *list;
 			uint32		nlist;
@@ -977,14 +1000,22 @@ ginInsertCleanup(GinState *ginstate, bool full_clean,
 			fsm_vac = true;
 
 			Assert(blkno == metadata->head);
+			underLimit = metadata->nPendingPages * GIN_PAGE_FREESIZE <=
+				cleanupSize * 1024L;
 			LockBuffer(metabuffer, GIN_UNLOCK);
 
 			/*
 			 * if we removed the whole pending list or we cleanup tail (which
-			 * we remembered on start our cleanup process) then just exit
+			 * we remembered on start our cleanup process) then just exit.
+			 * An incremental cleanup is also done once the list no longer
+			 * exceeds the limit.
 			 */
 			if (blkno == InvalidBlockNumber || cleanupFinish)
 				break;
+			if (!forceCleanup && underLimit)
+				break;
+
+			nrunpages = 0;
 
 			/*
 			 * release memory used so far and reinit state
@@ -15,14 +15,130 @@
 #include "postgres.h"
 
 #include "access/gin_private.h"
+#include "access/gin_tuple.h"
+#include "access/parallel.h"
+#include "access/table.h"
 #include "access/tableam.h"
 #include "access/xloginsert.h"
+#include "catalog/index.h"
 #include "miscadmin.h"
 #include "nodes/execnodes.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
 #include "storage/predicate.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
+#include "utils/datum.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/tuplesort.h"
+
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_GIN_SHARED			UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xB000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xB000000000000005)
+
+/*
+ * Maximum number of TIDs in a GinTuple.  Longer lists of a key are split
+ * into several tuples, which the leader merges again.
+ */
+#define GIN_TUPLE_MAX_ITEMS				(1024 * 1024)
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment.
+ */
+typedef struct GinBuildShared
+{
+	/*
+	 * These fields are not modified during the build.  They primarily exist
+	 * for the benefit of worker processes that need to create state
+	 * corresponding to that used by the leader.
+	 */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	int			scantuplesortstates;
+
+	/*
+	 * workersdonecv is used to monitor the progress of workers.  All parallel
+	 * participants must indicate that they are done before leader can use
+	 * results built by the workers (and before leader can write the data into
+	 * the index).
+	 */
+	ConditionVariable workersdonecv;
+
+	/*
+	 * mutex protects all fields before heapdesc.
+	 *
+	 * These fields contain status information of interest to GIN index
+	 * builds that must work just the same when an index is built in parallel.
+	 */
+	slock_t		mutex;
+
+	/*
+	 * Mutable state that is maintained by workers, and reported back to
+	 * leader at end of the scans.
+	 *
+	 * nparticipantsdone is number of worker processes finished.
+	 *
+	 * reltuples is the total number of input heap tuples.
+	 *
+	 * indtuples is the total number of entries extracted from them.
+	 */
+	int			nparticipantsdone;
+	double		reltuples;
+	double		indtuples;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} GinBuildShared;
+
+/*
+ * Return pointer to a GinBuildShared's parallel table scan.
+ *
+ * c.f. shm_toc_allocate as to why BUFFERALIGN is used, rather than just
+ * MAXALIGN.
+ */
+#define ParallelTableScanFromGinBuildShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(GinBuildShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct GinLeader
+{
+	/* parallel context itself */
+	ParallelContext *pcxt;
+
+	/*
+	 * nparticipanttuplesorts is the exact number of worker processes
+	 * successfully launched, plus one leader process if it participates as a
+	 * worker (only DISABLE_LEADER_PARTICIPATION builds avoid leader
+	 * participating as a worker).
+	 */
+	int			nparticipanttuplesorts;
+
+	/*
+	 * Leader process convenience pointers to shared state (leader avoids TOC
+	 * lookups).
+	 *
+	 * ginshared is the shared state for entire build.  sharedsort is the
+	 * shared, tuplesort-managed state passed to each process tuplesort.
+	 * snapshot is the snapshot used by the scan iff an MVCC snapshot is
+	 * required.
+	 */
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} GinLeader;
 
 typedef struct
 {
@@ -32,8 +148,64 @@ typedef struct
 	MemoryContext tmpCtx;
 	MemoryContext funcCtx;
 	BuildAccumulator accum;
+
+	/* memory the accumulator may use before it's dumped, in kB */
+	int			work_mem;
+
+	/*
+	 * bs_leader is only present when a parallel index build is performed,
+	 * and only in the leader process.
+	 */
+	GinLeader  *bs_leader;
+
+	/*
+	 * The sortstate is used by workers (including the leader), to which the
+	 * accumulated entries are dumped.  It has to be part of the build state,
+	 * because that's the only thing passed to the build callback.
+	 */
+	Tuplesortstate *bs_sortstate;
+	double		bs_reltuples;
 } GinBuildState;
 
+/*
+ * Entries of a single key, collected by the leader from the sorted GinTuples
+ * of the workers before they are inserted into the index.
+ */
+typedef struct GinBuffer
+{
+	OffsetNumber attnum;
+	GinNullCategory category;
+	Datum		key;			/* copied, unless category isn't normal */
+	bool		typbyval;
+	int16		typlen;
+	uint32		nitems;
+	uint32		maxitems;		/* allocated size of items */
+	ItemPointerData *items;		/* sorted, without duplicates */
+} GinBuffer;
+
+static void _gin_begin_parallel(GinBuildState *buildstate, Relation heap,
+								Relation index, bool isconcurrent,
+								int request);
+static void _gin_end_parallel(GinLeader *ginleader);
+static Size _gin_parallel_estimate_shared(Relation heap, Snapshot snapshot);
+static double _gin_parallel_heapscan(GinBuildState *buildstate);
+static double _gin_parallel_merge(GinBuildState *buildstate);
+static void _gin_leader_participate_as_worker(GinBuildState *buildstate,
+											  Relation heap, Relation index);
+static void _gin_parallel_scan_and_build(GinBuildState *buildstate,
+										 GinBuildShared *ginshared,
+										 Sharedsort *sharedsort,
+										 Relation heap, Relation index,
+										 int sortmem, bool progress);
+static void _gin_dump_accum_to_sort(GinBuildState *buildstate);
+static GinTuple *_gin_build_tuple(GinState *ginstate, OffsetNumber attrnum,
+								  GinNullCategory category, Datum key,
+								  ItemPointerData *items, uint32 nitems,
+								  Size *len);
+static void _gin_buffer_store(GinBuildState *buildstate, GinBuffer *buffer,
+							  GinTuple *tup);
+static void _gin_buffer_flush(GinBuildState *buildstate, GinBuffer *buffer,
+							  uint32 nitems);
 
 /*
  * Adds array of item pointers to tuple's posting list, or
@@ -288,7 +460,7 @@ ginBuildCallback(Relation index, ItemPointer tid, Datum *values,
 							   values[i], isnull[i], tid);
 
 	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= (Size) maintenance_work_mem * 1024L)
+	if (buildstate->accum.allocatedMemory >= (Size) buildstate->work_mem * 1024L)
 	{
 		ItemPointerData *list;
 		Datum		key;
@@ -313,6 +485,74 @@ ginBuildCallback(Relation index, ItemPointer tid, Datum *values,
 	MemoryContextSwitchTo(oldCtx);
 }
 
+/*
+ * Build callback of the participants of a parallel build.  Like
+ * ginBuildCallback, but the accumulated entries are dumped into the
+ * participant's tuplesort rather than into the index.
+ */
+static void
+ginBuildCallbackParallel(Relation index, ItemPointer tid, Datum *values,
+						 bool *isnull, bool tupleIsAlive, void *state)
+{
+	GinBuildState *buildstate = (GinBuildState *) state;
+	MemoryContext oldCtx;
+	int			i;
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+	for (i = 0; i < buildstate->ginstate.origTupdesc->natts; i++)
+		ginHeapTupleBulkInsert(buildstate, (OffsetNumber) (i + 1),
+							   values[i], isnull[i], tid);
+
+	/* If we've maxed out our available memory, dump everything to the sort */
+	if (buildstate->accum.allocatedMemory >= (Size) buildstate->work_mem * 1024L)
+		_gin_dump_accum_to_sort(buildstate);
+
+	MemoryContextSwitchTo(oldCtx);
+}
+
+/*
+ * Dump the entries collected in the accumulator into the participant's
+ * tuplesort, as GinTuples, and reset the accumulator.
+ *
+ * Must be called in buildstate->tmpCtx.
+ */
+static void
+_gin_dump_accum_to_sort(GinBuildState *buildstate)
+{
+	ItemPointerData *list;
+	Datum		key;
+	GinNullCategory category;
+	uint32		nlist;
+	OffsetNumber attnum;
+
+	Assert(CurrentMemoryContext == buildstate->tmpCtx);
+
+	ginBeginBAScan(&buildstate->accum);
+	while ((list = ginGetBAEntry(&buildstate->accum,
+								 &attnum, &key, &category, &nlist)) != NULL)
+	{
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		for (uint32 off = 0; off < nlist; off += GIN_TUPLE_MAX_ITEMS)
+		{
+			GinTuple   *tup;
+			Size		len;
+
+			tup = _gin_build_tuple(&buildstate->ginstate, attnum, category,
+								   key, list + off,
+								   Min(nlist - off, GIN_TUPLE_MAX_ITEMS),
+								   &len);
+			tuplesort_putgintuple(buildstate->bs_sortstate, tup, len);
+			pfree(tup);
+		}
+	}
+
+	MemoryContextReset(buildstate->tmpCtx);
+	ginInitBA(&buildstate->accum);
+}
+
 IndexBuildResult *
 ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 {
@@ -335,6 +575,10 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	initGinState(&buildstate.ginstate, index);
 	buildstate.indtuples = 0;
 	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.work_mem = maintenance_work_mem;
+	buildstate.bs_leader = NULL;
+	buildstate.bs_sortstate = NULL;
+	buildstate.bs_reltuples = 0;
 
 	/* initialize the meta page */
 	MetaBuffer = GinNewBuffer(index);
@@ -376,25 +620,70 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	ginInitBA(&buildstate.accum);
 
 	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
+	 * Attempt to launch parallel worker scan when required.  The workers
+	 * scan the table and accumulate entries just like a serial build does,
+	 * but dump them into a shared tuplesort, sorted by key and TID.
 	 */
-	reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
-									   ginBuildCallback, (void *) &buildstate,
-									   NULL);
-
-	/* dump remaining entries to the index */
-	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
-	ginBeginBAScan(&buildstate.accum);
-	while ((list = ginGetBAEntry(&buildstate.accum,
-								 &attnum, &key, &category, &nlist)) != NULL)
+	if (indexInfo->ii_ParallelWorkers > 0)
+		_gin_begin_parallel(&buildstate, heap, index, indexInfo->ii_Concurrent,
+							indexInfo->ii_ParallelWorkers);
+
+	/*
+	 * If parallel build requested and at least one worker process was
+	 * successfully launched, set up coordination state, wait for workers to
+	 * complete, and merge the posting lists of each key from the shared
+	 * tuplesort into the index.
+	 *
+	 * In serial mode, scan the table and dump the accumulated entries into
+	 * the index directly.
+	 */
+	if (buildstate.bs_leader)
 	{
-		/* there could be many entries, so be willing to abort here */
-		CHECK_FOR_INTERRUPTS();
-		ginEntryInsert(&buildstate.ginstate, attnum, key, category,
-					   list, nlist, &buildstate.buildStats);
+		SortCoordinate coordinate;
+
+		coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+		coordinate->isWorker = false;
+		coordinate->nParticipants =
+			buildstate.bs_leader->nparticipanttuplesorts;
+		coordinate->sharedsort = buildstate.bs_leader->sharedsort;
+
+		/*
+		 * Begin leader tuplesort.  As in a parallel btree build, the leader
+		 * receives the same share of maintenance_work_mem as a serial sort;
+		 * by the time it needs it, the workers are done.
+		 */
+		buildstate.bs_sortstate =
+			tuplesort_begin_index_gin(heap, index, maintenance_work_mem,
+									  coordinate, TUPLESORT_NONE);
+
+		/* wait for the workers, and merge their results into the index */
+		reltuples = _gin_parallel_merge(&buildstate);
+
+		_gin_end_parallel(buildstate.bs_leader);
+	}
+	else						/* no parallel index build */
+	{
+		/*
+		 * Do the heap scan.  We disallow sync scan here because
+		 * dataPlaceToPage prefers to receive tuples in TID order.
+		 */
+		reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
+										   ginBuildCallback, (void *) &buildstate,
+										   NULL);
+
+		/* dump remaining entries to the index */
+		oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+		ginBeginBAScan(&buildstate.accum);
+		while ((list = ginGetBAEntry(&buildstate.accum,
+									 &attnum, &key, &category, &nlist)) != NULL)
+		{
+			/* there could be many entries, so be willing to abort here */
+			CHECK_FOR_INTERRUPTS();
+			ginEntryInsert(&buildstate.ginstate, attnum, key, category,
+						   list, nlist, &buildstate.buildStats);
+		}
+		MemoryContextSwitchTo(oldCtx);
 	}
-	MemoryContextSwitchTo(oldCtx);
 
 	MemoryContextDelete(buildstate.funcCtx);
 	MemoryContextDelete(buildstate.tmpCtx);
@@ -534,3 +823,720 @@ gininsert(Relation index, Datum *values, bool *isnull,
 
 	return false;
 }
+
+/*
+ * Create parallel context, and launch workers for leader.
+ *
+ * buildstate argument should be initialized (with the exception of the
+ * tuplesort states, which may later be created based on shared
+ * state initially set up here).
+ *
+ * isconcurrent indicates if operation is CREATE INDEX CONCURRENTLY.
+ *
+ * request is the target number of parallel worker processes to launch.
+ *
+ * Sets buildstate's GinLeader, which caller must use to shut down parallel
+ * mode by passing it to _gin_end_parallel() at the very end of its index
+ * build.  If not even a single worker process can be launched, this is
+ * never set, and caller should proceed with a serial index build.
+ */
+static void
+_gin_begin_parallel(GinBuildState *buildstate, Relation heap, Relation index,
+					bool isconcurrent, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		estginshared;
+	Size		estsort;
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	GinLeader  *ginleader = (GinLeader *) palloc0(sizeof(GinLeader));
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	bool		leaderparticipates = true;
+	int			querylen;
+
+#ifdef DISABLE_LEADER_PARTICIPATION
+	leaderparticipates = false;
+#endif
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of gin index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_gin_parallel_build_main",
+								 request);
+
+	scantuplesortstates = leaderparticipates ? request + 1 : request;
+
+	/*
+	 * Prepare for scan of the base relation.  In a normal index build, we use
+	 * SnapshotAny because we must retrieve all tuples and do our own time
+	 * qual checks (because we have to index RECENTLY_DEAD tuples).  In a
+	 * concurrent build, we take a regular MVCC snapshot and index whatever's
+	 * live according to that.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_GIN_SHARED workspace.
+	 */
+	estginshared = _gin_parallel_estimate_shared(heap, snapshot);
+	shm_toc_estimate_chunk(&pcxt->estimator, estginshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/*
+	 * Estimate space for WalUsage and BufferUsage -- PARALLEL_KEY_WAL_USAGE
+	 * and PARALLEL_KEY_BUFFER_USAGE.
+	 *
+	 * If there are no extensions loaded that care, we could skip this.  We
+	 * have no way of knowing whether anyone's looking at pgWalUsage or
+	 * pgBufferUsage, so do it unconditionally.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	ginshared = (GinBuildShared *) shm_toc_allocate(pcxt->toc, estginshared);
+	/* Initialize immutable state */
+	ginshared->heaprelid = RelationGetRelid(heap);
+	ginshared->indexrelid = RelationGetRelid(index);
+	ginshared->isconcurrent = isconcurrent;
+	ginshared->scantuplesortstates = scantuplesortstates;
+	ConditionVariableInit(&ginshared->workersdonecv);
+	SpinLockInit(&ginshared->mutex);
+
+	/* Initialize mutable state */
+	ginshared->nparticipantsdone = 0;
+	ginshared->reltuples = 0.0;
+	ginshared->indtuples = 0.0;
+
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromGinBuildShared(ginshared),
+								  snapshot);
+
+	/*
+	 * Store shared tuplesort-private state, for which we reserved space.
+	 * Then, initialize opaque state using tuplesort routine.
+	 */
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_GIN_SHARED, ginshared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	ginleader->pcxt = pcxt;
+	ginleader->nparticipanttuplesorts = pcxt->nworkers_launched;
+	if (leaderparticipates)
+		ginleader->nparticipanttuplesorts++;
+	ginleader->ginshared = ginshared;
+	ginleader->sharedsort = sharedsort;
+	ginleader->snapshot = snapshot;
+	ginleader->walusage = walusage;
+	ginleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_gin_end_parallel(ginleader);
+		return;
+	}
+
+	/* Save leader state now that it's clear build will be parallel */
+	buildstate->bs_leader = ginleader;
+
+	/* Join heap scan ourselves */
+	if (leaderparticipates)
+		_gin_leader_participate_as_worker(buildstate, heap, index);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_gin_end_parallel(GinLeader *ginleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(ginleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < ginleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&ginleader->bufferusage[i], &ginleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(ginleader->snapshot))
+		UnregisterSnapshot(ginleader->snapshot);
+	DestroyParallelContext(ginleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Within leader, wait for end of heap scan.
+ *
+ * When called, parallel heap scan started by _gin_begin_parallel() will
+ * already be underway within worker processes (when leader participates
+ * as a worker, we should end up here just as workers are finishing).
+ *
+ * Returns the total number of heap tuples scanned.
+ */
+static double
+_gin_parallel_heapscan(GinBuildState *state)
+{
+	GinBuildShared *ginshared = state->bs_leader->ginshared;
+	int			nparticipanttuplesorts;
+
+	nparticipanttuplesorts = state->bs_leader->nparticipanttuplesorts;
+	for (;;)
+	{
+		SpinLockAcquire(&ginshared->mutex);
+		if (ginshared->nparticipantsdone == nparticipanttuplesorts)
+		{
+			/* copy the data into leader state */
+			state->bs_reltuples = ginshared->reltuples;
+			state->indtuples = ginshared->indtuples;
+
+			SpinLockRelease(&ginshared->mutex);
+			break;
+		}
+		SpinLockRelease(&ginshared->mutex);
+
+		ConditionVariableSleep(&ginshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+
+	ConditionVariableCancelSleep();
+
+	return state->bs_reltuples;
+}
+
+/*
+ * Within leader, wait for end of heap scan and merge per-worker results.
+ *
+ * After waiting for all workers to finish, read the GinTuples produced by
+ * the workers from the shared tuplesort, sorted by key and first TID.  The
+ * TID lists of each key are merged in a GinBuffer and inserted into the
+ * index once we see the next key, so that each key is inserted only once
+ * (modulo very long TID lists, see below).
+ *
+ * Returns the total number of heap tuples scanned.
+ */
+static double
+_gin_parallel_merge(GinBuildState *state)
+{
+	GinTuple   *tup;
+	Size		tuplen;
+	double		reltuples;
+	GinBuffer	buffer;
+	MemoryContext oldCtx;
+
+	/* wait for workers to scan table and produce partial results */
+	reltuples = _gin_parallel_heapscan(state);
+
+	/* do the actual sort in the leader */
+	tuplesort_performsort(state->bs_sortstate);
+
+	memset(&buffer, 0, sizeof(GinBuffer));
+
+	/* the key and TIDs collected in the buffer live in tmpCtx */
+	oldCtx = MemoryContextSwitchTo(state->tmpCtx);
+
+	while ((tup = tuplesort_getgintuple(state->bs_sortstate, &tuplen, true)) != NULL)
+	{
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		if (buffer.nitems > 0)
+		{
+			if (buffer.attnum != tup->attrnum ||
+				ginCompareEntries(&state->ginstate, buffer.attnum,
+								  buffer.key, buffer.category,
+								  GinTupleGetKey(tup), tup->category) != 0)
+			{
+				/* a new key, so insert the previous one */
+				_gin_buffer_flush(state, &buffer, buffer.nitems);
+				MemoryContextReset(state->tmpCtx);
+				memset(&buffer, 0, sizeof(GinBuffer));
+			}
+			else if (buffer.nitems >= GIN_TUPLE_MAX_ITEMS)
+			{
+				ItemPointer first = GinTupleGetItems(tup);
+				uint32		nflush = 0;
+
+				/*
+				 * The TID list of this key is getting long.  The tuples are
+				 * sorted by their first TID, so TIDs before the first TID of
+				 * this tuple can't be followed by any more TIDs from the
+				 * remaining tuples.  Insert those now, to keep the memory
+				 * used by the buffer bounded.
+				 */
+				while (nflush < buffer.nitems &&
+					   ItemPointerCompare(&buffer.items[nflush], first) < 0)
+					nflush++;
+
+				if (nflush > 0)
+					_gin_buffer_flush(state, &buffer, nflush);
+			}
+		}
+
+		_gin_buffer_store(state, &buffer, tup);
+	}
+
+	/* insert the last key */
+	if (buffer.nitems > 0)
+		_gin_buffer_flush(state, &buffer, buffer.nitems);
+
+	tuplesort_end(state->bs_sortstate);
+
+	MemoryContextSwitchTo(oldCtx);
+
+	return reltuples;
+}
+
+/*
+ * Add the TIDs of a GinTuple to the buffer.  If the buffer is empty, the
+ * tuple's key is copied into it as well; otherwise the key must be the same.
+ *
+ * Must be called in buildstate->tmpCtx.
+ */
+static void
+_gin_buffer_store(GinBuildState *buildstate, GinBuffer *buffer,
+				  GinTuple *tup)
+{
+	ItemPointer items = GinTupleGetItems(tup);
+
+	Assert(CurrentMemoryContext == buildstate->tmpCtx);
+
+	if (buffer->nitems == 0)
+	{
+		buffer->attnum = tup->attrnum;
+		buffer->category = tup->category;
+		buffer->typbyval = tup->typbyval;
+		buffer->typlen = tup->typlen;
+
+		if (tup->category == GIN_CAT_NORM_KEY)
+			buffer->key = datumCopy(GinTupleGetKey(tup),
+									tup->typbyval, tup->typlen);
+		else
+			buffer->key = (Datum) 0;
+	}
+
+	if (buffer->nitems == 0 ||
+		ItemPointerCompare(&buffer->items[buffer->nitems - 1], items) < 0)
+	{
+		/* the common case: the new TIDs simply follow the collected ones */
+		if (buffer->nitems + tup->nitems > buffer->maxitems)
+		{
+			buffer->maxitems = Max(buffer->maxitems * 2,
+								   buffer->nitems + tup->nitems);
+			if (buffer->items == NULL)
+				buffer->items = palloc(sizeof(ItemPointerData) * buffer->maxitems);
+			else
+				buffer->items = repalloc(buffer->items,
+										 sizeof(ItemPointerData) * buffer->maxitems);
+		}
+
+		memcpy(&buffer->items[buffer->nitems], items,
+			   sizeof(ItemPointerData) * tup->nitems);
+		buffer->nitems += tup->nitems;
+	}
+	else
+	{
+		/* TID ranges of different workers overlap, merge them */
+		ItemPointer merged;
+		int			nmerged;
+
+		merged = ginMergeItemPointers(buffer->items, buffer->nitems,
+									  items, tup->nitems, &nmerged);
+		pfree(buffer->items);
+		buffer->items = merged;
+		buffer->nitems = nmerged;
+		buffer->maxitems = nmerged;
+	}
+}
+
+/*
+ * Insert the first nitems TIDs collected in the buffer into the index, and
+ * remove them from the buffer.
+ */
+static void
+_gin_buffer_flush(GinBuildState *buildstate, GinBuffer *buffer,
+				  uint32 nitems)
+{
+	MemoryContext oldCtx;
+
+	Assert(nitems > 0 && nitems <= buffer->nitems);
+
+	oldCtx = MemoryContextSwitchTo(buildstate->funcCtx);
+	ginEntryInsert(&buildstate->ginstate, buffer->attnum, buffer->key,
+				   buffer->category, buffer->items, nitems,
+				   &buildstate->buildStats);
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->funcCtx);
+
+	memmove(buffer->items, &buffer->items[nitems],
+			sizeof(ItemPointerData) * (buffer->nitems - nitems));
+	buffer->nitems -= nitems;
+}
+
+/*
+ * Returns size of shared memory required to store state for a parallel
+ * gin index build based on the snapshot its parallel scan will use.
+ */
+static Size
+_gin_parallel_estimate_shared(Relation heap, Snapshot snapshot)
+{
+	/* c.f. shm_toc_allocate as to why BUFFERALIGN is used */
+	return add_size(BUFFERALIGN(sizeof(GinBuildShared)),
+					table_parallelscan_estimate(heap, snapshot));
+}
+
+/*
+ * Within leader, participate as a parallel worker.
+ */
+static void
+_gin_leader_participate_as_worker(GinBuildState *buildstate, Relation heap,
+								  Relation index)
+{
+	GinLeader  *ginleader = buildstate->bs_leader;
+	int			sortmem;
+
+	/*
+	 * Might as well use reliable figure when doling out maintenance_work_mem
+	 * (when requested number of workers were not launched, this will be
+	 * somewhat higher than it is for other workers).
+	 */
+	sortmem = maintenance_work_mem / ginleader->nparticipanttuplesorts;
+
+	/* Perform work common to all participants */
+	_gin_parallel_scan_and_build(buildstate, ginleader->ginshared,
+								 ginleader->sharedsort, heap, index,
+								 sortmem, true);
+}
+
+/*
+ * Perform a worker's portion of a parallel sort.
+ *
+ * This scans the worker's portion of the table, accumulates the entries
+ * like a serial build does, and dumps them into a tuplesort whenever the
+ * accumulator gets full.
+ *
+ * sortmem is the amount of working memory to use within each worker,
+ * expressed in KBs.  It is split evenly between the accumulator and the
+ * tuplesort.
+ *
+ * When this returns, workers are done, and need only release resources.
+ */
+static void
+_gin_parallel_scan_and_build(GinBuildState *state,
+							 GinBuildShared *ginshared, Sharedsort *sharedsort,
+							 Relation heap, Relation index,
+							 int sortmem, bool progress)
+{
+	SortCoordinate coordinate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+	MemoryContext oldCtx;
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	state->work_mem = sortmem / 2;
+
+	/* Begin "partial" tuplesort */
+	state->bs_sortstate = tuplesort_begin_index_gin(heap, index,
+													sortmem / 2, coordinate,
+													TUPLESORT_NONE);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = ginshared->isconcurrent;
+
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromGinBuildShared(ginshared));
+
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   ginBuildCallbackParallel, state, scan);
+
+	/* dump remaining entries to the tuplesort */
+	oldCtx = MemoryContextSwitchTo(state->tmpCtx);
+	_gin_dump_accum_to_sort(state);
+	MemoryContextSwitchTo(oldCtx);
+
+	/* sort the entries collected by this worker */
+	tuplesort_performsort(state->bs_sortstate);
+
+	state->bs_reltuples += reltuples;
+
+	/*
+	 * Done.  Record ambuild statistics.
+	 */
+	SpinLockAcquire(&ginshared->mutex);
+	ginshared->nparticipantsdone++;
+	ginshared->reltuples += state->bs_reltuples;
+	ginshared->indtuples += state->indtuples;
+	SpinLockRelease(&ginshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&ginshared->workersdonecv);
+
+	tuplesort_end(state->bs_sortstate);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_gin_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	GinBuildState buildstate;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			sortmem;
+
+	/*
+	 * The only possible status flag that can be set to the parallel worker is
+	 * PROC_IN_SAFE_IC.
+	 */
+	Assert((MyProc->statusFlags == 0) ||
+		   (MyProc->statusFlags == PROC_IN_SAFE_IC));
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up gin shared state */
+	ginshared = shm_toc_lookup(toc, PARALLEL_KEY_GIN_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!ginshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(ginshared->heaprelid, heapLockmode);
+	indexRel = index_open(ginshared->indexrelid, indexLockmode);
+
+	/* initialize the build state, as ginbuild does */
+	initGinState(&buildstate.ginstate, indexRel);
+	buildstate.indtuples = 0;
+	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.bs_leader = NULL;
+	buildstate.bs_sortstate = NULL;
+	buildstate.bs_reltuples = 0;
+
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "Gin build temporary context",
+											  ALLOCSET_DEFAULT_SIZES);
+	buildstate.funcCtx = AllocSetContextCreate(CurrentMemoryContext,
+											   "Gin build temporary context for user-defined function",
+											   ALLOCSET_DEFAULT_SIZES);
+
+	buildstate.accum.ginstate = &buildstate.ginstate;
+	ginInitBA(&buildstate.accum);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	/*
+	 * Might as well use reliable figure when doling out maintenance_work_mem
+	 * (when requested number of workers were not launched, this will be
+	 * somewhat higher than it is for other workers).
+	 */
+	sortmem = maintenance_work_mem / ginshared->scantuplesortstates;
+
+	_gin_parallel_scan_and_build(&buildstate, ginshared, sharedsort,
+								 heapRel, indexRel, sortmem, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	MemoryContextDelete(buildstate.funcCtx);
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Form a GinTuple holding a key and a list of TIDs, to be passed to the
+ * leader through the tuplesort.  The size of the tuple is returned in *len.
+ */
+static GinTuple *
+_gin_build_tuple(GinState *ginstate, OffsetNumber attrnum,
+				 GinNullCategory category, Datum key,
+				 ItemPointerData *items, uint32 nitems,
+				 Size *len)
+{
+	Form_pg_attribute attr = TupleDescAttr(ginstate->origTupdesc, attrnum - 1);
+	GinTuple   *tuple;
+	Size		keylen = 0;
+	Size		tuplen;
+
+	if (category == GIN_CAT_NORM_KEY)
+	{
+		if (attr->attbyval)
+			keylen = sizeof(Datum);
+		else
+		{
+			/* the tuple must be self-contained, so don't store toast pointers */
+			if (attr->attlen == -1)
+				key = PointerGetDatum(PG_DETOAST_DATUM(key));
+			keylen = datumGetSize(key, false, attr->attlen);
+		}
+	}
+
+	tuplen = SizeOfGinTuple(keylen, nitems);
+
+	tuple = palloc0(tuplen);
+	tuple->tuplen = tuplen;
+	tuple->attrnum = attrnum;
+	tuple->category = category;
+	tuple->typbyval = attr->attbyval;
+	tuple->typlen = attr->attlen;
+	tuple->keylen = keylen;
+	tuple->nitems = nitems;
+
+	if (category == GIN_CAT_NORM_KEY)
+	{
+		if (attr->attbyval)
+			memcpy(GinTupleGetKeyData(tuple), &key, sizeof(Datum));
+		else
+			memcpy(GinTupleGetKeyData(tuple), DatumGetPointer(key), keylen);
+	}
+
+	memcpy(GinTupleGetItems(tuple), items, sizeof(ItemPointerData) * nitems);
+
+	*len = tuplen;
+
+	return tuple;
+}
+
+/*
+ * Compare two GinTuples by attribute number, key category, key and first
+ * TID.  This is the sort order of the tuplesort used by parallel builds;
+ * ssup holds the comparators of the index keys.
+ */
+int
+_gin_compare_tuples(GinTuple *a, GinTuple *b, SortSupport ssup)
+{
+	int			r;
+
+	if (a->attrnum < b->attrnum)
+		return -1;
+	if (a->attrnum > b->attrnum)
+		return 1;
+
+	if (a->category < b->category)
+		return -1;
+	if (a->category > b->category)
+		return 1;
+
+	if (a->category == GIN_CAT_NORM_KEY)
+	{
+		r = ApplySortComparator(GinTupleGetKey(a), false,
+								GinTupleGetKey(b), false,
+								&ssup[a->attrnum - 1]);
+		if (r != 0)
+			return r;
+	}
+
+	return ItemPointerCompare(GinTupleGetItems(a), GinTupleGetItems(b));
+}
@@ -73,7 +73,7 @@ hashhandler(PG_FUNCTION_ARGS)
 	amroutine->amclusterable = false;
 	amroutine->ampredlocks = true;
 	amroutine->amcanparallel = false;
-	amroutine->amcanbuildparallel = false;
+	amroutine->amcanbuildparallel = true;
 	amroutine->amcaninclude = false;
 	amroutine->amusemaintenanceworkmem = false;
 	amroutine->amsummarizing = false;
@@ -84,8 +84,10 @@ hashhandler(PG_FUNCTION_ARGS)
 	amroutine->ambuild = hashbuild;
 	amroutine->ambuildempty = hashbuildempty;
 	amroutine->aminsert = hashinsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->aminsertcleanup = NULL;
 	amroutine->ambulkdelete = hashbulkdelete;
+	amroutine->amretaildelete = NULL;
 	amroutine->amvacuumcleanup = hashvacuumcleanup;
 	amroutine->amcanreturn = NULL;
 	amroutine->amcostestimate = hashcostestimate;
@@ -153,6 +155,10 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	 * NOTE: this test will need adjustment if a bucket is ever different from
 	 * one page.  Also, "initial index size" accounting does not include the
 	 * metapage, nor the first bitmap page.
+	 *
+	 * A parallel build always sorts: the workers compute the hash codes and
+	 * sort their share of the tuples, which leaves the leader with only the
+	 * insertions to do.
 	 */
 	sort_threshold = (maintenance_work_mem * 1024L) / BLCKSZ;
 	if (index->rd_rel->relpersistence != RELPERSISTENCE_TEMP)
@@ -160,8 +166,11 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	else
 		sort_threshold = Min(sort_threshold, NLocBuffer);
 
-	if (num_buckets >= (uint32) sort_threshold)
-		buildstate.spool = _h_spoolinit(heap, index, num_buckets);
+	if (num_buckets >= (uint32) sort_threshold ||
+		indexInfo->ii_ParallelWorkers > 0)
+		buildstate.spool = _h_spoolinit(heap, index, num_buckets,
+										indexInfo->ii_Concurrent,
+										indexInfo->ii_ParallelWorkers);
 	else
 		buildstate.spool = NULL;
 
@@ -169,10 +178,14 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	buildstate.indtuples = 0;
 	buildstate.heapRel = heap;
 
-	/* do the heap scan */
-	reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
-									   hashbuildCallback,
-									   (void *) &buildstate, NULL);
+	/* do the heap scan, or wait for the parallel workers to do it */
+	if (buildstate.spool && _h_spool_is_parallel(buildstate.spool))
+		reltuples = _h_parallel_heapscan(buildstate.spool,
+										 &buildstate.indtuples);
+	else
+		reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
+										   hashbuildCallback,
+										   (void *) &buildstate, NULL);
 	pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_TOTAL,
 								 buildstate.indtuples);
 
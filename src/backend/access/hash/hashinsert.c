@@ -19,11 +19,40 @@
 #include "access/hash_xlog.h"
 #include "access/xloginsert.h"
 #include "miscadmin.h"
+#include "storage/bufmgr.h"
 #include "storage/predicate.h"
 #include "utils/rel.h"
 
+/*
+ * Insertion hints.  When a bucket has a long chain of overflow pages, all
+ * but the last of them are usually full, yet every insertion would visit
+ * each of them in turn.  So we remember, per bucket, the overflow page we
+ * last inserted into, and start looking for free space there.  Earlier
+ * pages of the chain are only revisited when the hint is lost, which is
+ * fine since vacuum squeezes free space towards the start of the chain
+ * anyway, freeing the pages at its end.
+ *
+ * The hints are a small direct-mapped cache in backend-local memory, keyed
+ * by relfilelocator and bucket number.  A hint may be stale: the page may
+ * have been freed by vacuum or even reused elsewhere, so it's checked before
+ * use.
+ */
+#define HASH_INSERT_HINTS	64
+
+typedef struct HashInsertHint
+{
+	RelFileLocator locator;
+	Bucket		bucket;
+	BlockNumber blkno;			/* InvalidBlockNumber if unused */
+} HashInsertHint;
+
+static HashInsertHint hash_insert_hints[HASH_INSERT_HINTS];
+static bool hash_insert_hints_valid = false;
+
 static void _hash_vacuum_one_page(Relation rel, Relation hrel,
 								  Buffer metabuf, Buffer buf);
+static HashInsertHint *_hash_insert_hint(Relation rel, Bucket bucket);
+static Buffer _hash_getbuf_from_hint(Relation rel, Bucket bucket);
 
 /*
  *	_hash_doinsert() -- Handle insertion of a single index tuple.
@@ -151,7 +180,27 @@ restart_insert:
 		 */
 		nextblkno = pageopaque->hasho_nextblkno;
 
-		if (BlockNumberIsValid(nextblkno))
+		/*
+		 * If this is the primary bucket page, try to skip ahead to the page
+		 * we used last time.
+		 */
+		if (buf == bucket_buf && BlockNumberIsValid(nextblkno))
+		{
+			Buffer		hintbuf;
+
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			hintbuf = _hash_getbuf_from_hint(rel, bucket);
+			if (BufferIsValid(hintbuf))
+			{
+				buf = hintbuf;
+				page = BufferGetPage(buf);
+				pageopaque = HashPageGetOpaque(page);
+				continue;
+			}
+			buf = _hash_getbuf(rel, nextblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
+			page = BufferGetPage(buf);
+		}
+		else if (BlockNumberIsValid(nextblkno))
 		{
 			/*
 			 * ovfl page exists; go get it.  if it doesn't have room, we'll
@@ -189,6 +238,16 @@ restart_insert:
 		Assert(pageopaque->hasho_bucket == bucket);
 	}
 
+	/* Remember where we found room in the bucket's overflow chain */
+	if (buf != bucket_buf)
+	{
+		HashInsertHint *hint = _hash_insert_hint(rel, bucket);
+
+		hint->locator = rel->rd_locator;
+		hint->bucket = bucket;
+		hint->blkno = BufferGetBlockNumber(buf);
+	}
+
 	/*
 	 * Write-lock the metapage so we can increment the tuple count. After
 	 * incrementing it, check to see if it's time for a split.
@@ -255,6 +314,78 @@ restart_insert:
 	_hash_dropbuf(rel, metabuf);
 }
 
+/*
+ *	_hash_insert_hint() -- find the insertion hint slot for a bucket.
+ */
+static HashInsertHint *
+_hash_insert_hint(Relation rel, Bucket bucket)
+{
+	uint32		h;
+
+	if (!hash_insert_hints_valid)
+	{
+		for (int i = 0; i < HASH_INSERT_HINTS; i++)
+			hash_insert_hints[i].blkno = InvalidBlockNumber;
+		hash_insert_hints_valid = true;
+	}
+
+	h = hash_combine(murmurhash32(rel->rd_locator.relNumber),
+					 murmurhash32(bucket));
+
+	return &hash_insert_hints[h % HASH_INSERT_HINTS];
+}
+
+/*
+ *	_hash_getbuf_from_hint() -- get the overflow page we last inserted into.
+ *
+ * Returns the write-locked page if the hint is still good, that is the page
+ * is an overflow page of the given bucket, else InvalidBuffer.  The caller
+ * must hold a pin on the primary bucket page, which prevents vacuum from
+ * freeing overflow pages of the bucket meanwhile; so if the page belongs to
+ * the bucket, it's part of its chain.
+ */
+static Buffer
+_hash_getbuf_from_hint(Relation rel, Bucket bucket)
+{
+	HashInsertHint *hint = _hash_insert_hint(rel, bucket);
+	Buffer		buf;
+	Page		page;
+	HashPageOpaque opaque;
+
+	if (!BlockNumberIsValid(hint->blkno) ||
+		hint->bucket != bucket ||
+		!RelFileLocatorEquals(hint->locator, rel->rd_locator))
+		return InvalidBuffer;
+
+	/*
+	 * The relfilenumber might have been reused for a smaller relation since
+	 * we made the hint.
+	 */
+	if (hint->blkno >= RelationGetNumberOfBlocks(rel))
+	{
+		hint->blkno = InvalidBlockNumber;
+		return InvalidBuffer;
+	}
+
+	buf = ReadBuffer(rel, hint->blkno);
+	LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+	page = BufferGetPage(buf);
+	opaque = HashPageGetOpaque(page);
+
+	if (PageIsNew(page) ||
+		PageGetSpecialSize(page) != MAXALIGN(sizeof(HashPageOpaqueData)) ||
+		opaque->hasho_page_id != HASHO_PAGE_ID ||
+		(opaque->hasho_flag & LH_PAGE_TYPE) != LH_OVERFLOW_PAGE ||
+		opaque->hasho_bucket != bucket)
+	{
+		_hash_relbuf(rel, buf);
+		hint->blkno = InvalidBlockNumber;
+		return InvalidBuffer;
+	}
+
+	return buf;
+}
+
 /*
  *	_hash_pgaddtup() -- add a tuple to a particular page in the index.
  *
@@ -13,6 +13,11 @@
  * hash code value.  That's no big problem though, since we'll still have
  * plenty of locality of access.
  *
+ * The sort can be done in parallel, the way nbtsort.c does it: workers scan
+ * ranges of the table, compute the hash codes of their tuples and produce
+ * sorted runs in a shared tuplesort, and the leader merges the runs and
+ * inserts the tuples into the index.
+ *
  *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -26,12 +31,122 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "catalog/index.h"
 #include "commands/progress.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/pg_bitutils.h"
+#include "storage/condition_variable.h"
+#include "storage/proc.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
 #include "utils/tuplesort.h"
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_HASH_SHARED		UINT64CONST(0xD000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xD000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xD000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xD000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xD000000000000005)
+
+/*
+ * Status for hash index builds performed in parallel.  This is allocated in
+ * a dynamic shared memory segment.
+ */
+typedef struct HashShared
+{
+	/*
+	 * These fields are not modified during the build.  They primarily exist
+	 * for the benefit of worker processes that need to create state
+	 * corresponding to that used by the leader.
+	 */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	int			scantuplesortstates;
+	uint32		num_buckets;
+
+	/*
+	 * workersdonecv is used to monitor the progress of workers.  All parallel
+	 * participants must indicate that they are done before leader can use
+	 * results built by the workers (and before leader can write the data into
+	 * the index).
+	 */
+	ConditionVariable workersdonecv;
+
+	/*
+	 * mutex protects all fields before heapdesc.
+	 */
+	slock_t		mutex;
+
+	/*
+	 * Mutable state that is maintained by workers, and reported back to
+	 * leader at end of the scans.
+	 *
+	 * nparticipantsdone is number of worker processes finished.
+	 *
+	 * reltuples is the total number of input heap tuples.
+	 *
+	 * indtuples is the total number of tuples that made it into the index.
+	 */
+	int			nparticipantsdone;
+	double		reltuples;
+	double		indtuples;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} HashShared;
+
+/*
+ * Return pointer to a HashShared's parallel table scan.
+ *
+ * c.f. shm_toc_allocate as to why BUFFERALIGN is used, rather than just
+ * MAXALIGN.
+ */
+#define ParallelTableScanFromHashShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(HashShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct HashLeader
+{
+	/* parallel context itself */
+	ParallelContext *pcxt;
+
+	/*
+	 * nparticipanttuplesorts is the exact number of worker processes
+	 * successfully launched, plus one leader process if it participates as a
+	 * worker (only DISABLE_LEADER_PARTICIPATION builds avoid leader
+	 * participating as a worker).
+	 */
+	int			nparticipanttuplesorts;
+
+	/*
+	 * Leader process convenience pointers to shared state (leader avoids TOC
+	 * lookups).
+	 *
+	 * hashshared is the shared state for entire build.  sharedsort is the
+	 * shared, tuplesort-managed state passed to each process tuplesort.
+	 * snapshot is the snapshot used by the scan iff an MVCC snapshot is
+	 * required.
+	 */
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} HashLeader;
 
 /*
  * Status record for spooling/sorting phase.
@@ -50,35 +165,68 @@ struct HSpool
 	uint32		high_mask;
 	uint32		low_mask;
 	uint32		max_buckets;
+
+	/*
+	 * hashleader is only present when a parallel build is performed, and
+	 * only in the leader process.
+	 */
+	HashLeader *hashleader;
+
+	double		indtuples;		/* # tuples spooled, in a worker */
 };
 
+static void _h_spool_setmasks(HSpool *hspool, uint32 num_buckets);
+static void _h_begin_parallel(HSpool *hspool, Relation heap, Relation index,
+							  uint32 num_buckets, bool isconcurrent,
+							  int request);
+static void _h_end_parallel(HashLeader *hashleader);
+static Size _h_parallel_estimate_shared(Relation heap, Snapshot snapshot);
+static void _h_parallel_scan_and_sort(HashShared *hashshared,
+									  Sharedsort *sharedsort,
+									  Relation heap, Relation index,
+									  int sortmem, bool progress);
+static void _h_parallel_callback(Relation index, ItemPointer tid,
+								 Datum *values, bool *isnull,
+								 bool tupleIsAlive, void *state);
+
 
 /*
  * create and initialize a spool structure
+ *
+ * If request is more than zero, try to launch that many parallel workers to
+ * scan the table and sort the tuples; the caller must then use
+ * _h_parallel_heapscan() rather than scanning the table itself, if
+ * _h_spool_is_parallel() says that workers were launched.
  */
 HSpool *
-_h_spoolinit(Relation heap, Relation index, uint32 num_buckets)
+_h_spoolinit(Relation heap, Relation index, uint32 num_buckets,
+			 bool isconcurrent, int request)
 {
 	HSpool	   *hspool = (HSpool *) palloc0(sizeof(HSpool));
+	SortCoordinate coordinate = NULL;
 
 	hspool->index = index;
+	_h_spool_setmasks(hspool, num_buckets);
 
-	/*
-	 * Determine the bitmask for hash code values.  Since there are currently
-	 * num_buckets buckets in the index, the appropriate mask can be computed
-	 * as follows.
-	 *
-	 * NOTE : This hash mask calculation should be in sync with similar
-	 * calculation in _hash_init_metabuffer.
-	 */
-	hspool->high_mask = pg_nextpower2_32(num_buckets + 1) - 1;
-	hspool->low_mask = (hspool->high_mask >> 1);
-	hspool->max_buckets = num_buckets - 1;
+	if (request > 0)
+		_h_begin_parallel(hspool, heap, index, num_buckets, isconcurrent,
+						  request);
+
+	if (hspool->hashleader)
+	{
+		coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+		coordinate->isWorker = false;
+		coordinate->nParticipants =
+			hspool->hashleader->nparticipanttuplesorts;
+		coordinate->sharedsort = hspool->hashleader->sharedsort;
+	}
 
 	/*
 	 * We size the sort area as maintenance_work_mem rather than work_mem to
 	 * speed index creation.  This should be OK since a single backend can't
-	 * run multiple index creations in parallel.
+	 * run multiple index creations in parallel.  As in a parallel btree
+	 * build, the leader of a parallel build gets the same amount; by the
+	 * time it needs it, the workers are done.
 	 */
 	hspool->sortstate = tuplesort_begin_index_hash(heap,
 												   index,
@@ -86,22 +234,54 @@ _h_spoolinit(Relation heap, Relation index, uint32 num_buckets)
 												   hspool->low_mask,
 												   hspool->max_buckets,
 												   maintenance_work_mem,
-												   NULL,
+												   coordinate,
 												   TUPLESORT_NONE);
 
 	return hspool;
 }
 
+/*
+ * Set up the spool's bucket masks for an index with num_buckets buckets.
+ */
+static void
+_h_spool_setmasks(HSpool *hspool, uint32 num_buckets)
+{
+	/*
+	 * Determine the bitmask for hash code values.  Since there are currently
+	 * num_buckets buckets in the index, the appropriate mask can be computed
+	 * as follows.
+	 *
+	 * NOTE : This hash mask calculation should be in sync with similar
+	 * calculation in _hash_init_metabuffer.
+	 */
+	hspool->high_mask = pg_nextpower2_32(num_buckets + 1) - 1;
+	hspool->low_mask = (hspool->high_mask >> 1);
+	hspool->max_buckets = num_buckets - 1;
+}
+
 /*
  * clean up a spool structure and its substructures.
+ *
+ * This also shuts down the workers of a parallel build.
  */
 void
 _h_spooldestroy(HSpool *hspool)
 {
 	tuplesort_end(hspool->sortstate);
+	if (hspool->hashleader)
+		_h_end_parallel(hspool->hashleader);
 	pfree(hspool);
 }
 
+/*
+ * Are parallel workers scanning the table for this spool?
+ */
+bool
+_h_spool_is_parallel(HSpool *hspool)
+{
+	return hspool->hashleader != NULL;
+}
+
 /*
  * spool an index entry into the sort file.
  */
@@ -152,3 +332,451 @@ _h_indexbuild(HSpool *hspool, Relation heapRel)
 									 ++tups_done);
 	}
 }
+
+
+/*-------------------------------------------------------------------------
+ * Routines for parallel build
+ *-------------------------------------------------------------------------
+ */
+
+/*
+ * Create parallel context, and launch workers for leader.
+ *
+ * isconcurrent indicates if operation is CREATE INDEX CONCURRENTLY.
+ *
+ * request is the target number of parallel worker processes to launch.
+ *
+ * Sets hspool's HashLeader, which _h_spooldestroy() uses to shut down
+ * parallel mode at the very end of the index build.  If not even a single
+ * worker process can be launched, this is never set, and caller should
+ * proceed with a serial index build.
+ */
+static void
+_h_begin_parallel(HSpool *hspool, Relation heap, Relation index,
+				  uint32 num_buckets, bool isconcurrent, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		esthashshared;
+	Size		estsort;
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	HashLeader *hashleader = (HashLeader *) palloc0(sizeof(HashLeader));
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	bool		leaderparticipates = true;
+	int			querylen;
+
+#ifdef DISABLE_LEADER_PARTICIPATION
+	leaderparticipates = false;
+#endif
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of hash
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_hash_parallel_build_main",
+								 request);
+
+	scantuplesortstates = leaderparticipates ? request + 1 : request;
+
+	/*
+	 * Prepare for scan of the base relation.  In a normal index build, we use
+	 * SnapshotAny because we must retrieve all tuples and do our own time
+	 * qual checks (because we have to index RECENTLY_DEAD tuples).  In a
+	 * concurrent build, we take a regular MVCC snapshot and index whatever's
+	 * live according to that.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_HASH_SHARED workspace.
+	 */
+	esthashshared = _h_parallel_estimate_shared(heap, snapshot);
+	shm_toc_estimate_chunk(&pcxt->estimator, esthashshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/*
+	 * Estimate space for WalUsage and BufferUsage -- PARALLEL_KEY_WAL_USAGE
+	 * and PARALLEL_KEY_BUFFER_USAGE.
+	 *
+	 * If there are no extensions loaded that care, we could skip this.  We
+	 * have no way of knowing whether anyone's looking at pgWalUsage or
+	 * pgBufferUsage, so do it unconditionally.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	hashshared = (HashShared *) shm_toc_allocate(pcxt->toc, esthashshared);
+	/* Initialize immutable state */
+	hashshared->heaprelid = RelationGetRelid(heap);
+	hashshared->indexrelid = RelationGetRelid(index);
+	hashshared->isconcurrent = isconcurrent;
+	hashshared->scantuplesortstates = scantuplesortstates;
+	hashshared->num_buckets = num_buckets;
+	ConditionVariableInit(&hashshared->workersdonecv);
+	SpinLockInit(&hashshared->mutex);
+
+	/* Initialize mutable state */
+	hashshared->nparticipantsdone = 0;
+	hashshared->reltuples = 0.0;
+	hashshared->indtuples = 0.0;
+
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromHashShared(hashshared),
+								  snapshot);
+
+	/*
+	 * Store shared tuplesort-private state, for which we reserved space.
+	 * Then, initialize opaque state using tuplesort routine.
+	 */
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_HASH_SHARED, hashshared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	hashleader->pcxt = pcxt;
+	hashleader->nparticipanttuplesorts = pcxt->nworkers_launched;
+	if (leaderparticipates)
+		hashleader->nparticipanttuplesorts++;
+	hashleader->hashshared = hashshared;
+	hashleader->sharedsort = sharedsort;
+	hashleader->snapshot = snapshot;
+	hashleader->walusage = walusage;
+	hashleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_h_end_parallel(hashleader);
+		return;
+	}
+
+	/* Save leader state now that it's clear build will be parallel */
+	hspool->hashleader = hashleader;
+
+	/*
+	 * Join heap scan ourselves.  Might as well use reliable figure when doling
+	 * out maintenance_work_mem (when requested number of workers were not
+	 * launched, this will be somewhat higher than it is for other workers).
+	 */
+	if (leaderparticipates)
+		_h_parallel_scan_and_sort(hashshared, sharedsort, heap, index,
+								  maintenance_work_mem /
+								  hashleader->nparticipanttuplesorts,
+								  true);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_h_end_parallel(HashLeader *hashleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(hashleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < hashleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&hashleader->bufferusage[i], &hashleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(hashleader->snapshot))
+		UnregisterSnapshot(hashleader->snapshot);
+	DestroyParallelContext(hashleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Within leader, wait for end of heap scan.
+ *
+ * When called, parallel heap scan started by _h_spoolinit() will already be
+ * underway within worker processes (when leader participates as a worker,
+ * we should end up here just as workers are finishing).
+ *
+ * Returns the total number of heap tuples scanned, and sets *indtuples to
+ * the number of tuples spooled.
+ */
+double
+_h_parallel_heapscan(HSpool *hspool, double *indtuples)
+{
+	HashShared *hashshared = hspool->hashleader->hashshared;
+	int			nparticipanttuplesorts;
+	double		reltuples;
+
+	nparticipanttuplesorts = hspool->hashleader->nparticipanttuplesorts;
+	for (;;)
+	{
+		SpinLockAcquire(&hashshared->mutex);
+		if (hashshared->nparticipantsdone == nparticipanttuplesorts)
+		{
+			/* copy the data into leader state */
+			reltuples = hashshared->reltuples;
+			*indtuples = hashshared->indtuples;
+
+			SpinLockRelease(&hashshared->mutex);
+			break;
+		}
+		SpinLockRelease(&hashshared->mutex);
+
+		ConditionVariableSleep(&hashshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+
+	ConditionVariableCancelSleep();
+
+	return reltuples;
+}
+
+/*
+ * Returns size of shared memory required to store state for a parallel
+ * hash index build based on the snapshot its parallel scan will use.
+ */
+static Size
+_h_parallel_estimate_shared(Relation heap, Snapshot snapshot)
+{
+	/* c.f. shm_toc_allocate as to why BUFFERALIGN is used */
+	return add_size(BUFFERALIGN(sizeof(HashShared)),
+					table_parallelscan_estimate(heap, snapshot));
+}
+
+/*
+ * Per-tuple callback for the table scan of a parallel participant
+ */
+static void
+_h_parallel_callback(Relation index, ItemPointer tid, Datum *values,
+					 bool *isnull, bool tupleIsAlive, void *state)
+{
+	HSpool	   *hspool = (HSpool *) state;
+	Datum		index_values[1];
+	bool		index_isnull[1];
+
+	/* convert data to a hash key; on failure, do not insert anything */
+	if (!_hash_convert_tuple(index,
+							 values, isnull,
+							 index_values, index_isnull))
+		return;
+
+	_h_spool(hspool, tid, index_values, index_isnull);
+	hspool->indtuples += 1;
+}
+
+/*
+ * Perform a worker's portion of a parallel sort.
+ *
+ * This generates a tuplesort for the worker portion of the table.
+ *
+ * sortmem is the amount of working memory to use within each worker,
+ * expressed in KBs.
+ *
+ * When this returns, workers are done, and need only release resources.
+ */
+static void
+_h_parallel_scan_and_sort(HashShared *hashshared, Sharedsort *sharedsort,
+						  Relation heap, Relation index,
+						  int sortmem, bool progress)
+{
+	HSpool	   *hspool = (HSpool *) palloc0(sizeof(HSpool));
+	SortCoordinate coordinate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+
+	hspool->index = index;
+	_h_spool_setmasks(hspool, hashshared->num_buckets);
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	/* Begin "partial" tuplesort */
+	hspool->sortstate = tuplesort_begin_index_hash(heap,
+												   index,
+												   hspool->high_mask,
+												   hspool->low_mask,
+												   hspool->max_buckets,
+												   sortmem,
+												   coordinate,
+												   TUPLESORT_NONE);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = hashshared->isconcurrent;
+
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromHashShared(hashshared));
+
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   _h_parallel_callback,
+									   (void *) hspool, scan);
+
+	/* sort the tuples collected by this worker */
+	tuplesort_performsort(hspool->sortstate);
+
+	/*
+	 * Done.  Record ambuild statistics.
+	 */
+	SpinLockAcquire(&hashshared->mutex);
+	hashshared->nparticipantsdone++;
+	hashshared->reltuples += reltuples;
+	hashshared->indtuples += hspool->indtuples;
+	SpinLockRelease(&hashshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&hashshared->workersdonecv);
+
+	tuplesort_end(hspool->sortstate);
+	pfree(hspool);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_hash_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			sortmem;
+
+	/*
+	 * The only possible status flag that can be set to the parallel worker is
+	 * PROC_IN_SAFE_IC.
+	 */
+	Assert((MyProc->statusFlags == 0) ||
+		   (MyProc->statusFlags == PROC_IN_SAFE_IC));
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up hash shared state */
+	hashshared = shm_toc_lookup(toc, PARALLEL_KEY_HASH_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!hashshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(hashshared->heaprelid, heapLockmode);
+	indexRel = index_open(hashshared->indexrelid, indexLockmode);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	/*
+	 * Might as well use reliable figure when doling out maintenance_work_mem
+	 * (when requested number of workers were not launched, this will be
+	 * somewhat higher than it is for other workers).
+	 */
+	sortmem = maintenance_work_mem / hashshared->scantuplesortstates;
+
+	_h_parallel_scan_and_sort(hashshared, sharedsort, heapRel, indexRel,
+							  sortmem, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
@@ -433,6 +433,47 @@ heap_setscanlimits(TableScanDesc sscan, BlockNumber startBlk, BlockNumber numBlk
 	scan->rs_numblocks = numBlks;
 }
 
+/*
+ * heap_scan_set_projection - let the scan skip tuples that can't qualify
+ *
+ * The keys on fixed-width attributes are remembered, and evaluated by
+ * heap_prepare_pagescan() directly on the page, before tuple visibility is
+ * checked, so that tuples not satisfying them are never looked at again.
+ * Keys on variable-width attributes are left to the caller: they could
+ * require detoasting while the buffer is locked, and the TOAST data of
+ * dead tuples might already be gone.
+ *
+ * The set of needed attributes isn't used, as tuples handed out in a slot
+ * are deformed lazily, only up to the last attribute actually looked at.
+ */
+void
+heap_scan_set_projection(TableScanDesc sscan, Bitmapset *attrs,
+						 int nkeys, ScanKey keys)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+	TupleDesc	tupdesc = RelationGetDescr(sscan->rs_rd);
+	int			i;
+
+	Assert(!scan->rs_inited);	/* else too late to change */
+
+	if (scan->rs_filterkeys)
+		pfree(scan->rs_filterkeys);
+	scan->rs_filterkeys = NULL;
+	scan->rs_nfilterkeys = 0;
+
+	for (i = 0; i < nkeys; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, keys[i].sk_attno - 1);
+
+		if (attr->attlen <= 0)
+			continue;
+
+		if (scan->rs_filterkeys == NULL)
+			scan->rs_filterkeys = palloc(sizeof(ScanKeyData) * nkeys);
+		scan->rs_filterkeys[scan->rs_nfilterkeys++] = keys[i];
+	}
+}
+
 /*
  * Per-tuple loop for heap_prepare_pagescan(). Pulled out so it can be called
  * multiple times, with constant arguments for all_visible,
@@ -447,6 +488,9 @@ page_collect_tuples(HeapScanDesc scan, Snapshot snapshot,
 {
 	int			ntup = 0;
 	OffsetNumber lineoff;
+	TupleDesc	tupdesc = RelationGetDescr(scan->rs_base.rs_rd);
+	int			nkeys = scan->rs_nfilterkeys;
+	ScanKey		keys = scan->rs_filterkeys;
 
 	for (lineoff = FirstOffsetNumber; lineoff <= lines; lineoff++)
 	{
@@ -462,15 +506,31 @@ page_collect_tuples(HeapScanDesc scan, Snapshot snapshot,
 		loctup.t_tableOid = RelationGetRelid(scan->rs_base.rs_rd);
 		ItemPointerSet(&(loctup.t_self), block, lineoff);
 
+		/*
+		 * Skip tuples that can't qualify without checking their visibility,
+		 * which is more expensive than a comparison of a fixed-width value.
+		 * Serializable transactions have to check all tuples for conflicts,
+		 * though, so the keys are only tested afterwards for them.
+		 */
+		if (nkeys > 0 && !check_serializable &&
+			!HeapKeyTest(&loctup, tupdesc, nkeys, keys))
+			continue;
+
 		if (all_visible)
 			valid = true;
 		else
 			valid = HeapTupleSatisfiesVisibility(&loctup, snapshot, buffer);
 
 		if (check_serializable)
+		{
 			HeapCheckForSerializableConflictOut(valid, scan->rs_base.rs_rd,
 												&loctup, buffer, snapshot);
 
+			if (valid && nkeys > 0 &&
+				!HeapKeyTest(&loctup, tupdesc, nkeys, keys))
+				valid = false;
+		}
+
 		if (valid)
 		{
 			scan->rs_vistuples[ntup] = lineoff;
@@ -487,7 +547,8 @@ page_collect_tuples(HeapScanDesc scan, Snapshot snapshot,
  * heap_prepare_pagescan - Prepare current scan page to be scanned in pagemode
  *
  * Preparation currently consists of 1. prune the scan's rs_cbuf page, and 2.
- * fill the rs_vistuples[] array with the OffsetNumbers of visible tuples.
+ * fill the rs_vistuples[] array with the OffsetNumbers of visible tuples,
+ * leaving out those not satisfying the keys set by heap_scan_set_projection().
  */
 void
 heap_prepare_pagescan(TableScanDesc sscan)
@@ -1063,6 +1124,8 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 	scan->rs_strategy = NULL;	/* set in initscan */
 	scan->rs_vmbuffer = InvalidBuffer;
 	scan->rs_empty_tuples_pending = 0;
+	scan->rs_nfilterkeys = 0;
+	scan->rs_filterkeys = NULL;
 
 	/*
 	 * Disable page-at-a-time mode if it's not a MVCC-safe snapshot.
@@ -1235,6 +1298,9 @@ heap_endscan(TableScanDesc sscan)
 	if (scan->rs_base.rs_key)
 		pfree(scan->rs_base.rs_key);
 
+	if (scan->rs_filterkeys)
+		pfree(scan->rs_filterkeys);
+
 	if (scan->rs_strategy != NULL)
 		FreeAccessStrategy(scan->rs_strategy);
 
@@ -2183,15 +2249,14 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
 					CommandId cid, int options)
 {
 	/*
-	 * To allow parallel inserts, we need to ensure that they are safe to be
-	 * performed in workers. We have the infrastructure to allow parallel
-	 * inserts in general except for the cases where inserts generate a new
-	 * CommandId (eg. inserts into a table having a foreign key column).
+	 * Parallel workers can insert only if the leader had already used the
+	 * current CommandId before the parallel operation started, as CREATE
+	 * TABLE AS does; GetCurrentCommandId() checks that for us.  Inserts that
+	 * need a new CommandId (eg. inserts into a table having a foreign key
+	 * column) therefore remain impossible in workers.
 	 */
 	if (IsParallelWorker())
-		ereport(ERROR,
-				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
-				 errmsg("cannot insert tuples in a parallel worker")));
+		(void) GetCurrentCommandId(true);
 
 	tup->t_data->t_infomask &= ~(HEAP_XACT_MASK);
 	tup->t_data->t_infomask2 &= ~(HEAP2_XACT_MASK);
@@ -3148,6 +3213,7 @@ simple_heap_delete(Relation relation, ItemPointer tid)
 TM_Result
 heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 			CommandId cid, Snapshot crosscheck, bool wait,
+			Bitmapset *unindexed_attrs,
 			TM_FailureData *tmfd, LockTupleMode *lockmode,
 			TU_UpdateIndexes *update_indexes)
 {
@@ -3225,6 +3291,16 @@ heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 	 */
 	hot_attrs = RelationGetIndexAttrBitmap(relation,
 										   INDEX_ATTR_BITMAP_HOT_BLOCKING);
+
+	/*
+	 * The caller may know that some of those columns only matter to indexes
+	 * that have no entries for either version of this tuple, such as partial
+	 * indexes whose predicate neither version satisfies.  Changing them
+	 * doesn't prevent a HOT update then; the HOT chain stays invisible to
+	 * those indexes, and all other indexes see unchanged keys.
+	 */
+	if (unindexed_attrs != NULL)
+		hot_attrs = bms_del_members(hot_attrs, unindexed_attrs);
 	sum_attrs = RelationGetIndexAttrBitmap(relation,
 										   INDEX_ATTR_BITMAP_SUMMARIZED);
 	key_attrs = RelationGetIndexAttrBitmap(relation, INDEX_ATTR_BITMAP_KEY);
@@ -4226,7 +4302,7 @@ simple_heap_update(Relation relation, ItemPointer otid, HeapTuple tup,
 
 	result = heap_update(relation, otid, tup,
 						 GetCurrentCommandId(true), InvalidSnapshot,
-						 true /* wait for commit */ ,
+						 true /* wait for commit */ , NULL,
 						 &tmfd, &lockmode, update_indexes);
 	switch (result)
 	{
@@ -23,6 +23,7 @@
 #include "access/heapam.h"
 #include "access/heaptoast.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/rewriteheap.h"
 #include "access/syncscan.h"
 #include "access/tableam.h"
@@ -35,16 +36,105 @@
 #include "catalog/storage_xlog.h"
 #include "commands/progress.h"
 #include "executor/executor.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
+#include "optimizer/optimizer.h"
 #include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/bufpage.h"
+#include "storage/condition_variable.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
 #include "storage/procarray.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/rel.h"
+#include "utils/tuplesort.h"
+
+/* Magic numbers for parallel CLUSTER state sharing */
+#define PARALLEL_KEY_CLUSTER_SHARED		UINT64CONST(0xE000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xE000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xE000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xE000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xE000000000000005)
+
+/*
+ * Status for the scan-and-sort phase of a parallel CLUSTER, stored in
+ * dynamic shared memory.  Each participant scans part of the old heap and
+ * sorts the tuples it keeps into its own run; the leader then merges the
+ * runs and writes the new heap by itself.
+ */
+typedef struct ClusterShared
+{
+	/*
+	 * These fields are not modified during the scan.  They primarily exist
+	 * for the benefit of worker processes that need to open the relations
+	 * and apply the same visibility rules as the leader.
+	 */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	TransactionId OldestXmin;
+	int			scantuplesortstates;
+
+	/*
+	 * workersdonecv is used to monitor the progress of workers.  All parallel
+	 * participants must indicate that they are done before leader can start
+	 * merging their runs.
+	 */
+	ConditionVariable workersdonecv;
+
+	/*
+	 * mutex protects all fields before heapdesc.
+	 *
+	 * These fields contain status information of interest to the leader,
+	 * with the same meaning as the counters returned by
+	 * heapam_relation_copy_for_cluster().
+	 */
+	slock_t		mutex;
+	int			nparticipantsdone;
+	double		num_tuples;
+	double		tups_vacuumed;
+	double		tups_recently_dead;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} ClusterShared;
+
+/*
+ * Return pointer to a ClusterShared's parallel table scan.
+ *
+ * c.f. shm_toc_allocate as to why BUFFERALIGN is used, rather than just
+ * MAXALIGN.
+ */
+#define ParallelTableScanFromClusterShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(ClusterShared)))
+
+/*
+ * State kept by the leader of a parallel CLUSTER.
+ */
+typedef struct ClusterLeader
+{
+	/* parallel context itself */
+	ParallelContext *pcxt;
+
+	/*
+	 * nparticipanttuplesorts is the exact number of worker processes
+	 * successfully launched, plus one leader process if it participates as a
+	 * worker.
+	 */
+	int			nparticipanttuplesorts;
+
+	/* shared state in the DSM segment */
+	ClusterShared *shared;
+	Sharedsort *sharedsort;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} ClusterLeader;
 
 static void reform_and_rewrite_tuple(HeapTuple tuple,
 									 Relation OldHeap, Relation NewHeap,
@@ -56,6 +146,25 @@ static bool SampleHeapTupleVisible(TableScanDesc scan, Buffer buffer,
 
 static BlockNumber heapam_scan_get_blocks_done(HeapScanDesc hscan);
 
+static bool heapam_cluster_tuple_is_dead(Relation OldHeap, HeapTuple tuple,
+										 Buffer buf, TransactionId OldestXmin,
+										 bool is_system_catalog,
+										 double *tups_recently_dead);
+static ClusterLeader *heapam_cluster_begin_parallel(Relation OldHeap,
+													Relation OldIndex,
+													TransactionId OldestXmin,
+													int request);
+static void heapam_cluster_end_parallel(ClusterLeader *leader);
+static Tuplesortstate *heapam_cluster_parallel_scan(ClusterLeader *leader,
+													Relation OldHeap,
+													Relation OldIndex,
+													double *num_tuples,
+													double *tups_vacuumed,
+													double *tups_recently_dead);
+static void heapam_cluster_scan_and_sort(Relation OldHeap, Relation OldIndex,
+										 ClusterShared *shared,
+										 Sharedsort *sharedsort, int sortmem);
+
 static const TableAmRoutine heapam_methods;
 
 
@@ -314,8 +423,9 @@ heapam_tuple_delete(Relation relation, ItemPointer tid, CommandId cid,
 static TM_Result
 heapam_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
 					CommandId cid, Snapshot snapshot, Snapshot crosscheck,
-					bool wait, TM_FailureData *tmfd,
-					LockTupleMode *lockmode, TU_UpdateIndexes *update_indexes)
+					bool wait, Bitmapset *unindexed_attrs,
+					TM_FailureData *tmfd, LockTupleMode *lockmode,
+					TU_UpdateIndexes *update_indexes)
 {
 	bool		shouldFree = true;
 	HeapTuple	tuple = ExecFetchSlotHeapTuple(slot, true, &shouldFree);
@@ -326,7 +436,7 @@ heapam_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
 	tuple->t_tableOid = slot->tts_tableOid;
 
 	result = heap_update(relation, otid, tuple, cid, crosscheck, wait,
-						 tmfd, lockmode, update_indexes);
+						 unindexed_attrs, tmfd, lockmode, update_indexes);
 	ItemPointerCopy(&tuple->t_self, &slot->tts_tid);
 
 	/*
@@ -706,6 +816,7 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 	bool	   *isnull;
 	BufferHeapTupleTableSlot *hslot;
 	BlockNumber prev_cblock = InvalidBlockNumber;
+	ClusterLeader *leader = NULL;
 
 	/* Remember if it's a system catalog */
 	is_system_catalog = IsSystemRelation(OldHeap);
@@ -726,8 +837,28 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 								 *multi_cutoff);
 
 
+	/*
+	 * In scan-and-sort mode, try to have parallel workers help with scanning
+	 * and sorting the OldHeap, using the same rules as a parallel CREATE
+	 * INDEX to decide how many.  System catalogs are always done serially.
+	 */
+	if (use_sort && !is_system_catalog)
+	{
+		int			request;
+
+		request = plan_create_index_workers(RelationGetRelid(OldHeap),
+											RelationGetRelid(OldIndex));
+		if (request > 0)
+			leader = heapam_cluster_begin_parallel(OldHeap, OldIndex,
+												   OldestXmin, request);
+	}
+
 	/* Set up sorting if wanted */
-	if (use_sort)
+	if (leader != NULL)
+		tuplesort = heapam_cluster_parallel_scan(leader, OldHeap, OldIndex,
+												 num_tuples, tups_vacuumed,
+												 tups_recently_dead);
+	else if (use_sort)
 		tuplesort = tuplesort_begin_cluster(oldTupDesc, OldIndex,
 											maintenance_work_mem,
 											NULL, TUPLESORT_NONE);
@@ -735,11 +866,18 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 		tuplesort = NULL;
 
 	/*
-	 * Prepare to scan the OldHeap.  To ensure we see recently-dead tuples
-	 * that still need to be copied, we scan with SnapshotAny and use
-	 * HeapTupleSatisfiesVacuum for the visibility test.
+	 * Prepare to scan the OldHeap, unless the parallel participants already
+	 * did.  To ensure we see recently-dead tuples that still need to be
+	 * copied, we scan with SnapshotAny and use HeapTupleSatisfiesVacuum for
+	 * the visibility test.
 	 */
-	if (OldIndex != NULL && !use_sort)
+	if (leader != NULL)
+	{
+		tableScan = NULL;
+		heapScan = NULL;
+		indexScan = NULL;
+	}
+	else if (OldIndex != NULL && !use_sort)
 	{
 		const int	ci_index[] = {
 			PROGRESS_CLUSTER_PHASE,
@@ -781,7 +919,7 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 	 * module.  Note that we don't bother sorting dead tuples (they won't get
 	 * to the new table anyway).
 	 */
-	for (;;)
+	while (indexScan != NULL || tableScan != NULL)
 	{
 		HeapTuple	tuple;
 		Buffer		buf;
@@ -838,58 +976,9 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 		tuple = ExecFetchSlotHeapTuple(slot, false, NULL);
 		buf = hslot->buffer;
 
-		LockBuffer(buf, BUFFER_LOCK_SHARE);
-
-		switch (HeapTupleSatisfiesVacuum(tuple, OldestXmin, buf))
-		{
-			case HEAPTUPLE_DEAD:
-				/* Definitely dead */
-				isdead = true;
-				break;
-			case HEAPTUPLE_RECENTLY_DEAD:
-				*tups_recently_dead += 1;
-				/* fall through */
-			case HEAPTUPLE_LIVE:
-				/* Live or recently dead, must copy it */
-				isdead = false;
-				break;
-			case HEAPTUPLE_INSERT_IN_PROGRESS:
-
-				/*
-				 * Since we hold exclusive lock on the relation, normally the
-				 * only way to see this is if it was inserted earlier in our
-				 * own transaction.  However, it can happen in system
-				 * catalogs, since we tend to release write lock before commit
-				 * there.  Give a warning if neither case applies; but in any
-				 * case we had better copy it.
-				 */
-				if (!is_system_catalog &&
-					!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tuple->t_data)))
-					elog(WARNING, "concurrent insert in progress within table \"%s\"",
-						 RelationGetRelationName(OldHeap));
-				/* treat as live */
-				isdead = false;
-				break;
-			case HEAPTUPLE_DELETE_IN_PROGRESS:
-
-				/*
-				 * Similar situation to INSERT_IN_PROGRESS case.
-				 */
-				if (!is_system_catalog &&
-					!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(tuple->t_data)))
-					elog(WARNING, "concurrent delete in progress within table \"%s\"",
-						 RelationGetRelationName(OldHeap));
-				/* treat as recently dead */
-				*tups_recently_dead += 1;
-				isdead = false;
-				break;
-			default:
-				elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
-				isdead = false; /* keep compiler quiet */
-				break;
-		}
-
-		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		isdead = heapam_cluster_tuple_is_dead(OldHeap, tuple, buf, OldestXmin,
+											  is_system_catalog,
+											  tups_recently_dead);
 
 		if (isdead)
 		{
@@ -985,6 +1074,10 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 		tuplesort_end(tuplesort);
 	}
 
+	/* The workers' sorted runs have been consumed; shut them down */
+	if (leader != NULL)
+		heapam_cluster_end_parallel(leader);
+
 	/* Write out any remaining tuples, and fsync if needed */
 	end_heap_rewrite(rwstate);
 
@@ -993,6 +1086,452 @@ heapam_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 	pfree(isnull);
 }
 
+/*
+ * Decide whether a tuple of the OldHeap read by CLUSTER or VACUUM FULL is
+ * dead and can be left out of the new heap.  Recently-dead tuples, which
+ * must be copied, are counted in *tups_recently_dead.  The caller must hold
+ * a pin on the tuple's buffer.
+ */
+static bool
+heapam_cluster_tuple_is_dead(Relation OldHeap, HeapTuple tuple, Buffer buf,
+							 TransactionId OldestXmin, bool is_system_catalog,
+							 double *tups_recently_dead)
+{
+	bool		isdead;
+
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+
+	switch (HeapTupleSatisfiesVacuum(tuple, OldestXmin, buf))
+	{
+		case HEAPTUPLE_DEAD:
+			/* Definitely dead */
+			isdead = true;
+			break;
+		case HEAPTUPLE_RECENTLY_DEAD:
+			*tups_recently_dead += 1;
+			/* fall through */
+		case HEAPTUPLE_LIVE:
+			/* Live or recently dead, must copy it */
+			isdead = false;
+			break;
+		case HEAPTUPLE_INSERT_IN_PROGRESS:
+
+			/*
+			 * Since we hold exclusive lock on the relation, normally the only
+			 * way to see this is if it was inserted earlier in our own
+			 * transaction.  However, it can happen in system catalogs, since
+			 * we tend to release write lock before commit there.  Give a
+			 * warning if neither case applies; but in any case we had better
+			 * copy it.
+			 */
+			if (!is_system_catalog &&
+				!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tuple->t_data)))
+				elog(WARNING, "concurrent insert in progress within table \"%s\"",
+					 RelationGetRelationName(OldHeap));
+			/* treat as live */
+			isdead = false;
+			break;
+		case HEAPTUPLE_DELETE_IN_PROGRESS:
+
+			/*
+			 * Similar situation to INSERT_IN_PROGRESS case.
+			 */
+			if (!is_system_catalog &&
+				!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetUpdateXid(tuple->t_data)))
+				elog(WARNING, "concurrent delete in progress within table \"%s\"",
+					 RelationGetRelationName(OldHeap));
+			/* treat as recently dead */
+			*tups_recently_dead += 1;
+			isdead = false;
+			break;
+		default:
+			elog(ERROR, "unexpected HeapTupleSatisfiesVacuum result");
+			isdead = false;		/* keep compiler quiet */
+			break;
+	}
+
+	LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+
+	return isdead;
+}
+
+/*
+ * Create parallel context, and launch workers for the scan-and-sort phase of
+ * CLUSTER.
+ *
+ * request is the target number of parallel worker processes to launch.
+ *
+ * Returns NULL if not even a single worker process could be launched, in
+ * which case the caller should proceed serially.  Otherwise, the caller must
+ * pass the result to heapam_cluster_end_parallel() once it has read out the
+ * merged sort.
+ */
+static ClusterLeader *
+heapam_cluster_begin_parallel(Relation OldHeap, Relation OldIndex,
+							  TransactionId OldestXmin, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Size		estshared;
+	Size		estsort;
+	ClusterShared *shared;
+	Sharedsort *sharedsort;
+	ClusterLeader *leader;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			querylen;
+
+	/*
+	 * Enter parallel mode, and create context for parallel scan-and-sort.
+	 * The leader always participates as a worker.
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "heapam_parallel_cluster_main",
+								 request);
+
+	scantuplesortstates = request + 1;
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_CLUSTER_SHARED workspace, and
+	 * PARALLEL_KEY_TUPLESORT tuplesort workspace.  As in the serial case, the
+	 * scan uses SnapshotAny, and visibility is checked using OldestXmin.
+	 */
+	estshared = add_size(BUFFERALIGN(sizeof(ClusterShared)),
+						 table_parallelscan_estimate(OldHeap, SnapshotAny));
+	shm_toc_estimate_chunk(&pcxt->estimator, estshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/*
+	 * Estimate space for WalUsage and BufferUsage -- PARALLEL_KEY_WAL_USAGE
+	 * and PARALLEL_KEY_BUFFER_USAGE.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial scan) */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	/* Store shared state, for which we reserved space */
+	shared = (ClusterShared *) shm_toc_allocate(pcxt->toc, estshared);
+	/* Initialize immutable state */
+	shared->heaprelid = RelationGetRelid(OldHeap);
+	shared->indexrelid = RelationGetRelid(OldIndex);
+	shared->OldestXmin = OldestXmin;
+	shared->scantuplesortstates = scantuplesortstates;
+	ConditionVariableInit(&shared->workersdonecv);
+	SpinLockInit(&shared->mutex);
+	/* Initialize mutable state */
+	shared->nparticipantsdone = 0;
+	shared->num_tuples = 0.0;
+	shared->tups_vacuumed = 0.0;
+	shared->tups_recently_dead = 0.0;
+	table_parallelscan_initialize(OldHeap,
+								  ParallelTableScanFromClusterShared(shared),
+								  SnapshotAny);
+
+	/*
+	 * Store shared tuplesort-private state, for which we reserved space.
+	 * Then, initialize opaque state using tuplesort routine.
+	 */
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_CLUSTER_SHARED, shared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	leader = (ClusterLeader *) palloc0(sizeof(ClusterLeader));
+	leader->pcxt = pcxt;
+	leader->nparticipanttuplesorts = pcxt->nworkers_launched + 1;
+	leader->shared = shared;
+	leader->sharedsort = sharedsort;
+	leader->walusage = walusage;
+	leader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial scan) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		heapam_cluster_end_parallel(leader);
+		return NULL;
+	}
+
+	return leader;
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+heapam_cluster_end_parallel(ClusterLeader *leader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(leader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < leader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&leader->bufferusage[i], &leader->walusage[i]);
+
+	DestroyParallelContext(leader->pcxt);
+	ExitParallelMode();
+	pfree(leader);
+}
+
+/*
+ * Within leader, take part in the parallel scan of the OldHeap, then wait
+ * for the workers to finish theirs.
+ *
+ * Fills in the tuple counters the same way the serial scan does, and returns
+ * a tuplesort that merges the runs sorted by all participants.
+ */
+static Tuplesortstate *
+heapam_cluster_parallel_scan(ClusterLeader *leader,
+							 Relation OldHeap, Relation OldIndex,
+							 double *num_tuples, double *tups_vacuumed,
+							 double *tups_recently_dead)
+{
+	ClusterShared *shared = leader->shared;
+	ParallelBlockTableScanDesc pbscan;
+	SortCoordinate coordinate;
+	const int	progress_index[] = {
+		PROGRESS_CLUSTER_PHASE,
+		PROGRESS_CLUSTER_TOTAL_HEAP_BLKS
+	};
+	int64		progress_val[2];
+
+	pbscan = (ParallelBlockTableScanDesc)
+		ParallelTableScanFromClusterShared(shared);
+
+	/* Set phase and total heap blocks */
+	progress_val[0] = PROGRESS_CLUSTER_PHASE_SEQ_SCAN_HEAP;
+	progress_val[1] = pbscan->phs_nblocks;
+	pgstat_progress_update_multi_param(2, progress_index, progress_val);
+
+	/* Join the scan ourselves */
+	heapam_cluster_scan_and_sort(OldHeap, OldIndex, shared,
+								 leader->sharedsort,
+								 maintenance_work_mem /
+								 leader->nparticipanttuplesorts);
+
+	/*
+	 * Make sure that the failure-to-start case will not hang forever, then
+	 * wait for all participants to finish their share.
+	 */
+	WaitForParallelWorkersToAttach(leader->pcxt);
+	for (;;)
+	{
+		SpinLockAcquire(&shared->mutex);
+		if (shared->nparticipantsdone == leader->nparticipanttuplesorts)
+		{
+			*num_tuples = shared->num_tuples;
+			*tups_vacuumed = shared->tups_vacuumed;
+			*tups_recently_dead = shared->tups_recently_dead;
+			SpinLockRelease(&shared->mutex);
+			break;
+		}
+		SpinLockRelease(&shared->mutex);
+
+		ConditionVariableSleep(&shared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CLUSTER_SCAN);
+	}
+	ConditionVariableCancelSleep();
+
+	pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_BLKS_SCANNED,
+								 pbscan->phs_nblocks);
+	pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_TUPLES_SCANNED,
+								 *num_tuples);
+
+	/* Set up the leader's tuplesort, which will merge the sorted runs */
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = false;
+	coordinate->nParticipants = leader->nparticipanttuplesorts;
+	coordinate->sharedsort = leader->sharedsort;
+
+	return tuplesort_begin_cluster(RelationGetDescr(OldHeap), OldIndex,
+								   maintenance_work_mem, coordinate,
+								   TUPLESORT_NONE);
+}
+
+/*
+ * Perform a worker's portion of a parallel scan-and-sort: scan part of the
+ * OldHeap and sort the tuples that must be kept into a run of the shared
+ * tuplesort.  This is used by the leader as well as by worker processes.
+ *
+ * Dead tuples are only counted here.  In scan-and-sort mode, the heap
+ * rewrite module has not seen any tuples yet, so there is nothing that
+ * rewrite_heap_dead_tuple() could do with them.
+ */
+static void
+heapam_cluster_scan_and_sort(Relation OldHeap, Relation OldIndex,
+							 ClusterShared *shared, Sharedsort *sharedsort,
+							 int sortmem)
+{
+	SortCoordinate coordinate;
+	Tuplesortstate *tuplesort;
+	TableScanDesc scan;
+	TupleTableSlot *slot;
+	double		num_tuples = 0;
+	double		tups_vacuumed = 0;
+	double		tups_recently_dead = 0;
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	tuplesort = tuplesort_begin_cluster(RelationGetDescr(OldHeap), OldIndex,
+										sortmem, coordinate,
+										TUPLESORT_NONE);
+
+	scan = table_beginscan_parallel(OldHeap,
+									ParallelTableScanFromClusterShared(shared));
+	slot = table_slot_create(OldHeap, NULL);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		HeapTuple	tuple;
+
+		CHECK_FOR_INTERRUPTS();
+
+		tuple = ExecFetchSlotHeapTuple(slot, false, NULL);
+
+		if (heapam_cluster_tuple_is_dead(OldHeap, tuple,
+										 ((BufferHeapTupleTableSlot *) slot)->buffer,
+										 shared->OldestXmin, false,
+										 &tups_recently_dead))
+		{
+			tups_vacuumed += 1;
+			continue;
+		}
+
+		num_tuples += 1;
+		tuplesort_putheaptuple(tuplesort, tuple);
+	}
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+
+	/* Sort our run, and make it available to the leader */
+	tuplesort_performsort(tuplesort);
+
+	/* Report our counts, and tell the leader that we're done */
+	SpinLockAcquire(&shared->mutex);
+	shared->nparticipantsdone++;
+	shared->num_tuples += num_tuples;
+	shared->tups_vacuumed += tups_vacuumed;
+	shared->tups_recently_dead += tups_recently_dead;
+	SpinLockRelease(&shared->mutex);
+
+	ConditionVariableSignal(&shared->workersdonecv);
+
+	tuplesort_end(tuplesort);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+heapam_parallel_cluster_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	ClusterShared *shared;
+	Sharedsort *sharedsort;
+	Relation	OldHeap;
+	Relation	OldIndex;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up shared state */
+	shared = shm_toc_lookup(toc, PARALLEL_KEY_CLUSTER_SHARED, false);
+
+	/*
+	 * Open relations using the lock mode held by the leader, which group
+	 * locking lets us share.
+	 */
+	OldHeap = table_open(shared->heaprelid, AccessExclusiveLock);
+	OldIndex = index_open(shared->indexrelid, AccessExclusiveLock);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	heapam_cluster_scan_and_sort(OldHeap, OldIndex, shared, sharedsort,
+								 maintenance_work_mem /
+								 shared->scantuplesortstates);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(OldIndex, AccessExclusiveLock);
+	table_close(OldHeap, AccessExclusiveLock);
+}
+
 /*
  * Prepare to analyze the next block in the read stream.  Returns false if
  * the stream is exhausted and true otherwise. The scan must have been started
@@ -2598,6 +3137,7 @@ static const TableAmRoutine heapam_methods = {
 	.scan_end = heap_endscan,
 	.scan_rescan = heap_rescan,
 	.scan_getnextslot = heap_getnextslot,
+	.scan_set_projection = heap_scan_set_projection,
 
 	.scan_set_tidrange = heap_set_tidrange,
 	.scan_getnextslot_tidrange = heap_getnextslot_tidrange,
@@ -30,7 +30,9 @@
 #include "access/heaptoast.h"
 #include "access/toast_helper.h"
 #include "access/toast_internals.h"
+#include "storage/bufmgr.h"
 #include "utils/fmgroids.h"
+#include "utils/spccache.h"
 
 
 /* ----------
@@ -640,6 +642,11 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 	int			num_indexes;
 	int			validIndex;
 	SnapshotData SnapshotToast;
+#ifdef USE_PREFETCH
+	int			prefetch_distance = 0;
+	BlockNumber prefetch_next = InvalidBlockNumber;
+	BlockNumber prefetch_limit = InvalidBlockNumber;
+#endif
 
 	/* Look for the valid index of toast relation */
 	validIndex = toast_open_indexes(toastrel,
@@ -684,6 +691,20 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 		nscankeys = 3;
 	}
 
+#ifdef USE_PREFETCH
+
+	/*
+	 * When fetching more than a couple of pages' worth of chunks, prefetch
+	 * the heap pages ahead of the index scan.  We can't know where the
+	 * chunks are without reading the index, but the chunks of one value are
+	 * normally stored in consecutive blocks, so we prefetch the blocks
+	 * following the first chunk's.
+	 */
+	if (endchunk - startchunk + 1 > 2 * EXTERN_TUPLES_PER_PAGE)
+		prefetch_distance =
+			get_tablespace_io_concurrency(toastrel->rd_rel->reltablespace);
+#endif
+
 	/* Prepare for scan */
 	init_toast_snapshot(&SnapshotToast);
 	toastscan = systable_beginscan_ordered(toastrel, toastidxs[validIndex],
@@ -759,6 +780,26 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 									 curchunk, totalchunks, valueid,
 									 RelationGetRelationName(toastrel))));
 
+#ifdef USE_PREFETCH
+		if (prefetch_distance > 0)
+		{
+			BlockNumber blkno = ItemPointerGetBlockNumber(&ttup->t_self);
+
+			if (prefetch_next == InvalidBlockNumber)
+			{
+				BlockNumber nblocks = RelationGetNumberOfBlocks(toastrel);
+				BlockNumber needed;
+
+				needed = (endchunk - curchunk) / EXTERN_TUPLES_PER_PAGE + 1;
+				prefetch_next = blkno + 1;
+				prefetch_limit = Min(nblocks, prefetch_next + needed);
+			}
+			while (prefetch_next < prefetch_limit &&
+				   prefetch_next <= blkno + prefetch_distance)
+				(void) PrefetchBuffer(toastrel, MAIN_FORKNUM, prefetch_next++);
+		}
+#endif
+
 		/*
 		 * Copy the data into proper place in our result
 		 */
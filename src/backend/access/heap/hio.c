@@ -19,6 +19,7 @@
 #include "access/hio.h"
 #include "access/htup_details.h"
 #include "access/visibilitymap.h"
+#include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
@@ -210,6 +211,50 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
 	return released_locks;
 }
 
+/*
+ * Minimum number of pages to extend a relation by: one page for every
+ * EXTEND_SIZE_CLASS_DIVISOR pages it has, rounded down to a power of two.
+ * We estimate the relation's size from our insertion target block, which is
+ * usually near its end, to avoid an lseek() per extension.
+ */
+#define EXTEND_SIZE_CLASS_DIVISOR 128
+
+static uint32
+RelationExtendSizeClass(Relation relation)
+{
+	BlockNumber targblock = RelationGetTargetBlock(relation);
+
+	if (!BlockNumberIsValid(targblock) ||
+		targblock < EXTEND_SIZE_CLASS_DIVISOR)
+		return 1;
+
+	return pg_prevpower2_32(targblock / EXTEND_SIZE_CLASS_DIVISOR);
+}
+
+/*
+ * Take the next of the pages that RelationAddBlocks() set aside for this
+ * backend, if any.
+ */
+static bool
+RelationTakeReservedBlock(Relation relation, BlockNumber *blkno)
+{
+	SMgrRelation reln = RelationGetSmgr(relation);
+
+	if (!BlockNumberIsValid(reln->smgr_reserved_next))
+		return false;
+
+	*blkno = reln->smgr_reserved_next;
+	if (reln->smgr_reserved_next >= reln->smgr_reserved_last)
+	{
+		reln->smgr_reserved_next = InvalidBlockNumber;
+		reln->smgr_reserved_last = InvalidBlockNumber;
+	}
+	else
+		reln->smgr_reserved_next++;
+
+	return true;
+}
+
 /*
  * Extend the relation. By multiple pages, if beneficial.
  *
@@ -226,13 +271,20 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
  * benefits with higher numbers. This partially is because copyfrom.c's
  * MAX_BUFFERED_TUPLES / MAX_BUFFERED_BYTES prevents larger multi_inserts.
  *
+ * Larger relations are extended by more pages at a time, see
+ * RelationExtendSizeClass(), so that a growing table takes the extension lock
+ * less and less often.
+ *
+ * Without a bistate, surplus pages that we don't hand to other backends via
+ * the FSM are set aside for this backend in its smgr_reserved_next /
+ * smgr_reserved_last range, and used before asking the FSM.  That way
+ * concurrent inserters each fill their own pages, instead of all being
+ * directed to the same page by the FSM.  Reserved pages that never get used
+ * are found by the next VACUUM.
+ *
  * Returns a buffer for a newly extended block. If possible, the buffer is
  * returned exclusively locked. *did_unlock is set to true if the lock had to
  * be released, false otherwise.
- *
- *
- * XXX: It would likely be beneficial for some workloads to extend more
- * aggressively, e.g. using a heuristic based on the relation size.
  */
 static Buffer
 RelationAddBlocks(Relation relation, BulkInsertState bistate,
@@ -244,6 +296,8 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 	BlockNumber last_block = InvalidBlockNumber;
 	uint32		extend_by_pages;
 	uint32		not_in_fsm_pages;
+	uint32		reserved_pages = 0;
+	uint32		waitcount = 0;
 	Buffer		buffer;
 	Page		page;
 
@@ -260,8 +314,6 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 	}
 	else
 	{
-		uint32		waitcount;
-
 		/*
 		 * Try to extend at least by the number of pages the caller needs. We
 		 * can remember the additional pages (either via FSM or bistate).
@@ -270,8 +322,6 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 
 		if (!RELATION_IS_LOCAL(relation))
 			waitcount = RelationExtensionLockWaiterCount(relation);
-		else
-			waitcount = 0;
 
 		/*
 		 * Multiply the number of pages to extend by the number of waiters. Do
@@ -300,6 +350,10 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 		if (bistate)
 			extend_by_pages = Max(extend_by_pages, bistate->already_extended_by);
 
+		/* Extend a large relation by at least its size class. */
+		extend_by_pages = Max(extend_by_pages,
+							  RelationExtendSizeClass(relation));
+
 		/*
 		 * Can't extend by more than MAX_BUFFERS_TO_EXTEND_BY, we need to pin
 		 * them all concurrently.
@@ -348,6 +402,29 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 	last_block = first_block + (extend_by_pages - 1);
 	Assert(first_block == BufferGetBlockNumber(buffer));
 
+	/*
+	 * Without a bistate, set aside our share of the pages we won't use right
+	 * away; the other waiters for the extension lock get the rest via the
+	 * FSM.
+	 */
+	if (use_fsm && bistate == NULL && extend_by_pages > not_in_fsm_pages)
+	{
+		SMgrRelation reln = RelationGetSmgr(relation);
+
+		reserved_pages = (extend_by_pages - not_in_fsm_pages) / (waitcount + 1);
+		if (reserved_pages > 0)
+		{
+			reln->smgr_reserved_next = first_block + not_in_fsm_pages;
+			reln->smgr_reserved_last =
+				reln->smgr_reserved_next + reserved_pages - 1;
+		}
+		else
+		{
+			reln->smgr_reserved_next = InvalidBlockNumber;
+			reln->smgr_reserved_last = InvalidBlockNumber;
+		}
+	}
+
 	/*
 	 * Relation is now extended. Initialize the page. We do this here, before
 	 * potentially releasing the lock on the page, because it allows us to
@@ -368,7 +445,7 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 	 * not pin), we don't want to do IO while holding a buffer lock. This will
 	 * necessitate a bit more extensive checking in our caller.
 	 */
-	if (use_fsm && not_in_fsm_pages < extend_by_pages)
+	if (use_fsm && not_in_fsm_pages + reserved_pages < extend_by_pages)
 	{
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 		*did_unlock = true;
@@ -390,7 +467,7 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 
 		ReleaseBuffer(victim_buffers[i]);
 
-		if (use_fsm && i >= not_in_fsm_pages)
+		if (use_fsm && i >= not_in_fsm_pages + reserved_pages)
 		{
 			Size		freespace = BufferGetPageSize(victim_buffers[i]) -
 				SizeOfPageHeaderData;
@@ -399,9 +476,10 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 		}
 	}
 
-	if (use_fsm && not_in_fsm_pages < extend_by_pages)
+	if (use_fsm && not_in_fsm_pages + reserved_pages < extend_by_pages)
 	{
-		BlockNumber first_fsm_block = first_block + not_in_fsm_pages;
+		BlockNumber first_fsm_block = first_block + not_in_fsm_pages +
+			reserved_pages;
 
 		FreeSpaceMapVacuumRange(relation, first_fsm_block, last_block);
 	}
@@ -433,6 +511,12 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 #undef MAX_BUFFERS_TO_EXTEND_BY
 }
 
+/*
+ * How many times RelationGetBufferForTuple() may pass over a page whose
+ * buffer lock is held by someone else before it waits for one.
+ */
+#define HEAP_INSERT_MAX_BUSY_SKIPS 4
+
 /*
  * RelationGetBufferForTuple
  *
@@ -513,9 +597,12 @@ RelationGetBufferForTuple(Relation relation, Size len,
 				saveFreeSpace = 0,
 				targetFreeSpace = 0;
 	BlockNumber targetBlock,
-				otherBlock;
+				otherBlock,
+				reservedBlock;
 	bool		unlockedTargetBuffer;
 	bool		recheckVmPins;
+	bool		mayAvoidBusy;
+	int			busySkips = 0;
 
 	len = MAXALIGN(len);		/* be conservative */
 
@@ -597,6 +684,13 @@ RelationGetBufferForTuple(Relation relation, Size len,
 			targetBlock = nblocks - 1;
 	}
 
+	/*
+	 * A page that other backends may be inserting into, i.e. one that came
+	 * from the FSM or is merely our cached guess, may be passed over if its
+	 * buffer lock is busy; see below.
+	 */
+	mayAvoidBusy = use_fsm && bistate == NULL;
+
 loop:
 	while (targetBlock != InvalidBlockNumber)
 	{
@@ -617,17 +711,55 @@ loop:
 		{
 			/* easy case */
 			buffer = ReadBufferBI(relation, targetBlock, RBM_NORMAL, bistate);
-			if (PageIsAllVisible(BufferGetPage(buffer)))
-				visibilitymap_pin(relation, targetBlock, vmbuffer);
 
 			/*
-			 * If the page is empty, pin vmbuffer to set all_frozen bit later.
+			 * If another backend holds the lock on this page, it's probably
+			 * inserting into it too.  Rather than queue up behind it, ask the
+			 * FSM for a different page, a few times.  When many backends
+			 * insert at once, this spreads them over separate pages.  If the
+			 * FSM has nothing else to offer, come back and wait after all;
+			 * contention alone is no reason to extend the relation.
+			 *
+			 * If we do get the lock, we haven't pinned the visibility map
+			 * page yet.  That's left to GetVisibilityMapPins() below, which
+			 * releases the lock while it does so.  It doesn't know about the
+			 * pin HEAP_INSERT_FROZEN needs, so always wait in that case.
 			 */
-			if ((options & HEAP_INSERT_FROZEN) &&
-				(PageGetMaxOffsetNumber(BufferGetPage(buffer)) == 0))
-				visibilitymap_pin(relation, targetBlock, vmbuffer);
-
-			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+			if (mayAvoidBusy && busySkips < HEAP_INSERT_MAX_BUSY_SKIPS &&
+				(options & HEAP_INSERT_FROZEN) == 0)
+			{
+				if (!ConditionalLockBuffer(buffer))
+				{
+					BlockNumber busyBlock = targetBlock;
+
+					ReleaseBuffer(buffer);
+					busySkips++;
+					targetBlock = GetOtherPageWithFreeSpace(relation, busyBlock,
+															targetFreeSpace);
+					if (targetBlock == InvalidBlockNumber ||
+						targetBlock == busyBlock)
+					{
+						targetBlock = busyBlock;
+						busySkips = HEAP_INSERT_MAX_BUSY_SKIPS;
+					}
+					continue;
+				}
+			}
+			else
+			{
+				if (PageIsAllVisible(BufferGetPage(buffer)))
+					visibilitymap_pin(relation, targetBlock, vmbuffer);
+
+				/*
+				 * If the page is empty, pin vmbuffer to set all_frozen bit
+				 * later.
+				 */
+				if ((options & HEAP_INSERT_FROZEN) &&
+					(PageGetMaxOffsetNumber(BufferGetPage(buffer)) == 0))
+					visibilitymap_pin(relation, targetBlock, vmbuffer);
+
+				LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+			}
 		}
 		else if (otherBlock == targetBlock)
 		{
@@ -750,6 +882,17 @@ loop:
 			/* Without FSM, always fall out of the loop and extend */
 			break;
 		}
+		else if (RelationTakeReservedBlock(relation, &reservedBlock))
+		{
+			/*
+			 * An earlier extension set aside pages for us, use those before
+			 * asking the FSM.  Record the free space left on this page, as
+			 * above.
+			 */
+			RecordPageWithFreeSpace(relation, targetBlock, pageFreeSpace);
+			targetBlock = reservedBlock;
+			mayAvoidBusy = false;
+		}
 		else
 		{
 			/*
@@ -760,6 +903,7 @@ loop:
 														targetBlock,
 														pageFreeSpace,
 														targetFreeSpace);
+			mayAvoidBusy = true;
 		}
 	}
 
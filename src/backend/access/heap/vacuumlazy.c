@@ -20,6 +20,13 @@
  * that there only needs to be one call to lazy_vacuum, after the initial pass
  * completes.
  *
+ * The initial pass can be performed by parallel vacuum workers together with
+ * the leader.  They claim chunks of blocks from shared state in DSM, and add
+ * the TIDs they find to the shared TID store.  If that becomes full, everyone
+ * stops claiming chunks, and once all are done with their current chunk, the
+ * leader calls lazy_vacuum.  The workers are then launched again for the
+ * remaining blocks.
+ *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -33,10 +40,12 @@
 
 #include <math.h>
 
+#include "access/amapi.h"
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "access/heapam_xlog.h"
 #include "access/htup_details.h"
+#include "access/itup.h"
 #include "access/multixact.h"
 #include "access/tidstore.h"
 #include "access/transam.h"
@@ -49,12 +58,14 @@
 #include "common/int.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
+#include "optimizer/paths.h"
 #include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "storage/read_stream.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -110,6 +121,24 @@
  */
 #define SKIP_PAGES_THRESHOLD	((BlockNumber) 32)
 
+/*
+ * Non-aggressive VACUUMs eagerly scan some all-visible but not all-frozen
+ * pages, to freeze them before an aggressive VACUUM has to.  The number of
+ * such pages that fail to be frozen is capped for each region of this many
+ * blocks, by vacuum_max_eager_freeze_failure_rate.  The number of pages that
+ * are successfully frozen that way is capped at this fraction of the
+ * all-visible but not all-frozen pages.
+ */
+#define EAGER_SCAN_REGION_SIZE	((BlockNumber) 4096)
+#define MAX_EAGER_FREEZE_SUCCESS_RATE	0.2
+
+/*
+ * Flags passed along with each block of the initial heap pass, as the
+ * per-buffer data of the read stream.
+ */
+#define VAC_BLK_ALL_VISIBLE_ACCORDING_TO_VM	0x01
+#define VAC_BLK_WAS_EAGER_SCANNED			0x02
+
 /*
  * Size of the prefetch window for lazy vacuum backwards truncation scan.
  * Needs to be a power of 2.
@@ -122,6 +151,14 @@
  */
 #define ParallelVacuumIsActive(vacrel) ((vacrel)->pvs != NULL)
 
+/*
+ * Number of blocks handed out at a time to the processes taking part in a
+ * parallel heap scan.  They only check whether dead_items is full before
+ * claiming another chunk, so this also bounds how far past its limit
+ * dead_items can grow.
+ */
+#define PARALLEL_SCAN_CHUNK_BLOCKS	((BlockNumber) 1024)
+
 /* Phases of vacuum during which we report error context. */
 typedef enum
 {
@@ -133,6 +170,57 @@ typedef enum
 	VACUUM_ERRCB_PHASE_TRUNCATE,
 } VacErrPhase;
 
+/*
+ * Counters of a worker's share of a parallel heap scan, handed back to the
+ * leader.  See LVRelState for the meaning of the fields.
+ */
+typedef struct LVScanCounters
+{
+	bool		valid;			/* filled in by a worker? */
+	BlockNumber scanned_pages;
+	BlockNumber eager_scanned_pages;
+	BlockNumber frozen_pages;
+	BlockNumber lpdead_item_pages;
+	BlockNumber missed_dead_pages;
+	BlockNumber nonempty_pages;
+	int64		tuples_deleted;
+	int64		tuples_frozen;
+	int64		lpdead_items;
+	int64		live_tuples;
+	int64		recently_dead_tuples;
+	int64		missed_dead_tuples;
+	TransactionId NewRelfrozenXid;
+	MultiXactId NewRelminMxid;
+	bool		skippedallvis;
+} LVScanCounters;
+
+/*
+ * Shared state of a parallel heap scan, in the DSM segment of the parallel
+ * vacuum.  Everything but next_block and counters is set by the leader before
+ * launching workers.
+ */
+typedef struct LVParallelScanShared
+{
+	BlockNumber rel_pages;
+	int			nindexes;
+	bool		aggressive;
+	bool		skipwithvm;
+	bool		do_index_vacuuming;
+	struct VacuumCutoffs cutoffs;
+	BlockNumber eager_scan_max_fails_per_region;
+	BlockNumber eager_scan_max_successes;
+
+	/* first block of the next chunk to hand out */
+	pg_atomic_uint64 next_block;
+
+	/* number of pages frozen by eager scanning, by all processes */
+	pg_atomic_uint32 eager_scan_successes;
+
+	/* per worker, indexed by ParallelWorkerNumber */
+	int			nworkers;
+	LVScanCounters counters[FLEXIBLE_ARRAY_MEMBER];
+} LVParallelScanShared;
+
 typedef struct LVRelState
 {
 	/* Target heap relation and its indexes */
@@ -143,6 +231,21 @@ typedef struct LVRelState
 	/* Buffer access strategy and parallel vacuum state */
 	BufferAccessStrategy bstrategy;
 	ParallelVacuumState *pvs;
+	/* Shared state of a parallel heap scan, or NULL if not scanning so */
+	LVParallelScanShared *pscan;
+
+	/*
+	 * State for retail deletion of index entries, see lazy_retail_collect().
+	 * retail_index marks the indexes it's possible for, and retail_itups has
+	 * the index tuples for all of dead_items for those indexes, or is NULL
+	 * if they couldn't all be formed.
+	 */
+	bool	   *retail_index;
+	MemoryContext retail_cxt;
+	char	   *retail_page;	/* copy of the page being pruned */
+	IndexTuple **retail_itups;	/* per index */
+	int			retail_nitups;
+	int			retail_maxitups;
 
 	/* Aggressive VACUUM? (must set relfrozenxid >= FreezeLimit) */
 	bool		aggressive;
@@ -189,6 +292,8 @@ typedef struct LVRelState
 
 	BlockNumber rel_pages;		/* total number of pages */
 	BlockNumber scanned_pages;	/* # pages examined (not skipped via VM) */
+	BlockNumber eager_scanned_pages;	/* # all-visible pages eagerly
+										 * scanned, see above */
 	BlockNumber removed_pages;	/* # pages removed by relation truncation */
 	BlockNumber frozen_pages;	/* # pages with newly frozen tuples */
 	BlockNumber lpdead_item_pages;	/* # pages with LP_DEAD items */
@@ -212,10 +317,22 @@ typedef struct LVRelState
 	int64		missed_dead_tuples; /* # removable, but not removed */
 
 	/* State maintained by heap_vac_scan_next_block() */
+	BlockNumber scan_end;		/* end of the range of blocks being scanned */
 	BlockNumber current_block;	/* last block returned */
 	BlockNumber next_unskippable_block; /* next unskippable block */
 	bool		next_unskippable_allvis;	/* its visibility status */
+	bool		next_unskippable_eager_scanned; /* scanned only eagerly? */
 	Buffer		next_unskippable_vmbuffer;	/* buffer containing its VM bit */
+
+	/*
+	 * Eager scanning state, see heap_vacuum_eager_scan_setup().  The
+	 * success count is kept in pscan instead during a parallel heap scan.
+	 */
+	BlockNumber eager_scan_max_fails_per_region;
+	BlockNumber eager_scan_max_successes;
+	BlockNumber eager_scan_successes;
+	BlockNumber eager_scan_remaining_fails; /* in the current region */
+	BlockNumber next_eager_scan_region_start;
 } LVRelState;
 
 /* Struct for saving and restoring vacuum error information. */
@@ -229,9 +346,22 @@ typedef struct LVSavedErrInfo
 
 /* non-export function prototypes */
 static void lazy_scan_heap(LVRelState *vacrel);
+static void lazy_scan_heap_range(LVRelState *vacrel, BlockNumber start,
+								 BlockNumber end,
+								 BlockNumber *next_fsm_block_to_vacuum);
+static void lazy_scan_heap_parallel(LVRelState *vacrel,
+									BlockNumber *next_fsm_block_to_vacuum);
+static void lazy_scan_heap_chunks(LVRelState *vacrel);
+static void lazy_scan_gather_counters(LVRelState *vacrel);
+static void heap_vacuum_eager_scan_setup(LVRelState *vacrel);
 static bool heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
-									 bool *all_visible_according_to_vm);
+									 uint8 *blk_info);
+static BlockNumber heap_vac_scan_read_stream_next(ReadStream *stream,
+												  void *callback_private_data,
+												  void *per_buffer_data);
 static void find_next_unskippable_block(LVRelState *vacrel, bool *skipsallvis);
+static bool eager_scan_block(LVRelState *vacrel, BlockNumber blkno);
+static void eager_scan_count_result(LVRelState *vacrel, bool frozen);
 static bool lazy_scan_new_or_empty(LVRelState *vacrel, Buffer buf,
 								   BlockNumber blkno, Page page,
 								   bool sharelock, Buffer vmbuffer);
@@ -244,15 +374,24 @@ static bool lazy_scan_noprune(LVRelState *vacrel, Buffer buf,
 							  bool *has_lpdead_items);
 static void lazy_vacuum(LVRelState *vacrel);
 static bool lazy_vacuum_all_indexes(LVRelState *vacrel);
+static BlockNumber vacuum_reap_lp_read_stream_next(ReadStream *stream,
+												   void *callback_private_data,
+												   void *per_buffer_data);
 static void lazy_vacuum_heap_rel(LVRelState *vacrel);
 static void lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno,
 								  Buffer buffer, OffsetNumber *offsets,
 								  int num_offsets, Buffer vmbuffer);
 static bool lazy_check_wraparound_failsafe(LVRelState *vacrel);
 static void lazy_cleanup_all_indexes(LVRelState *vacrel);
+static void lazy_retail_init(LVRelState *vacrel);
+static void lazy_retail_reset(LVRelState *vacrel);
+static void lazy_retail_forget(LVRelState *vacrel);
+static void lazy_retail_collect(LVRelState *vacrel, BlockNumber blkno,
+								OffsetNumber *deadoffsets, int ndeadoffsets);
 static IndexBulkDeleteResult *lazy_vacuum_one_index(Relation indrel,
 													IndexBulkDeleteResult *istat,
 													double reltuples,
+													IndexTuple *retail_itups,
 													LVRelState *vacrel);
 static IndexBulkDeleteResult *lazy_cleanup_one_index(Relation indrel,
 													 IndexBulkDeleteResult *istat,
@@ -264,6 +403,8 @@ static void lazy_truncate_heap(LVRelState *vacrel);
 static BlockNumber count_nondeletable_pages(LVRelState *vacrel,
 											bool *lock_waiter_detected);
 static void dead_items_alloc(LVRelState *vacrel, int nworkers);
+static int	lazy_parallel_scan_workers(LVRelState *vacrel);
+static void lazy_parallel_scan_init(LVRelState *vacrel, int nworkers);
 static void dead_items_add(LVRelState *vacrel, BlockNumber blkno, OffsetNumber *offsets,
 						   int num_offsets);
 static void dead_items_reset(LVRelState *vacrel);
@@ -408,6 +549,7 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 
 	/* Initialize page counters explicitly (be tidy) */
 	vacrel->scanned_pages = 0;
+	vacrel->eager_scanned_pages = 0;
 	vacrel->removed_pages = 0;
 	vacrel->frozen_pages = 0;
 	vacrel->lpdead_item_pages = 0;
@@ -466,6 +608,8 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 
 	vacrel->skipwithvm = skipwithvm;
 
+	heap_vacuum_eager_scan_setup(vacrel);
+
 	if (verbose)
 	{
 		if (vacrel->aggressive)
@@ -489,6 +633,7 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 	 */
 	lazy_check_wraparound_failsafe(vacrel);
 	dead_items_alloc(vacrel, params->nworkers);
+	lazy_retail_init(vacrel);
 
 	/*
 	 * Call lazy_scan_heap to perform all required heap pruning, index
@@ -650,12 +795,13 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 							 vacrel->relnamespace,
 							 vacrel->relname,
 							 vacrel->num_index_scans);
-			appendStringInfo(&buf, _("pages: %u removed, %u remain, %u scanned (%.2f%% of total)\n"),
+			appendStringInfo(&buf, _("pages: %u removed, %u remain, %u scanned (%.2f%% of total), %u eagerly scanned\n"),
 							 vacrel->removed_pages,
 							 new_rel_pages,
 							 vacrel->scanned_pages,
 							 orig_rel_pages == 0 ? 100.0 :
-							 100.0 * vacrel->scanned_pages / orig_rel_pages);
+							 100.0 * vacrel->scanned_pages / orig_rel_pages,
+							 vacrel->eager_scanned_pages);
 			appendStringInfo(&buf,
 							 _("tuples: %lld removed, %lld remain, %lld are dead but not yet removable\n"),
 							 (long long) vacrel->tuples_deleted,
@@ -816,13 +962,8 @@ static void
 lazy_scan_heap(LVRelState *vacrel)
 {
 	BlockNumber rel_pages = vacrel->rel_pages,
-				blkno,
 				next_fsm_block_to_vacuum = 0;
-	bool		all_visible_according_to_vm;
-
-	TidStore   *dead_items = vacrel->dead_items;
 	VacDeadItemsInfo *dead_items_info = vacrel->dead_items_info;
-	Buffer		vmbuffer = InvalidBuffer;
 	const int	initprog_index[] = {
 		PROGRESS_VACUUM_PHASE,
 		PROGRESS_VACUUM_TOTAL_HEAP_BLKS,
@@ -836,47 +977,115 @@ lazy_scan_heap(LVRelState *vacrel)
 	initprog_val[2] = dead_items_info->max_bytes;
 	pgstat_progress_update_multi_param(3, initprog_index, initprog_val);
 
-	/* Initialize for the first heap_vac_scan_next_block() call */
-	vacrel->current_block = InvalidBlockNumber;
-	vacrel->next_unskippable_block = InvalidBlockNumber;
+	if (vacrel->pscan != NULL)
+		lazy_scan_heap_parallel(vacrel, &next_fsm_block_to_vacuum);
+	else
+		lazy_scan_heap_range(vacrel, 0, rel_pages, &next_fsm_block_to_vacuum);
+
+	/* report that everything is now scanned */
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, rel_pages);
+
+	/* now we can compute the new value for pg_class.reltuples */
+	vacrel->new_live_tuples = vac_estimate_reltuples(vacrel->rel, rel_pages,
+													 vacrel->scanned_pages,
+													 vacrel->live_tuples);
+
+	/*
+	 * Also compute the total number of surviving heap entries.  In the
+	 * (unlikely) scenario that new_live_tuples is -1, take it as zero.
+	 */
+	vacrel->new_rel_tuples =
+		Max(vacrel->new_live_tuples, 0) + vacrel->recently_dead_tuples +
+		vacrel->missed_dead_tuples;
+
+	/*
+	 * Do index vacuuming (call each index's ambulkdelete routine), then do
+	 * related heap vacuuming
+	 */
+	if (dead_items_info->num_items > 0)
+		lazy_vacuum(vacrel);
+
+	/*
+	 * Vacuum the remainder of the Free Space Map.  We must do this whether or
+	 * not there were indexes, and whether or not we bypassed index vacuuming.
+	 */
+	if (rel_pages > next_fsm_block_to_vacuum)
+		FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum,
+								rel_pages);
+
+	/* report all blocks vacuumed */
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, rel_pages);
+
+	/* Do final index cleanup (call each index's amvacuumcleanup routine) */
+	if (vacrel->nindexes > 0 && vacrel->do_index_cleanup)
+		lazy_cleanup_all_indexes(vacrel);
+}
+
+/*
+ *	lazy_scan_heap_range() -- initial pass over a range of heap blocks
+ *
+ * Processes the blocks from start up to end that can't be skipped using the
+ * visibility map.
+ *
+ * next_fsm_block_to_vacuum is NULL when called for a chunk of a parallel
+ * heap scan.  Whether dead_items is full is then checked by the caller,
+ * between chunks, and FSM vacuuming is left to the leader.
+ */
+static void
+lazy_scan_heap_range(LVRelState *vacrel, BlockNumber start, BlockNumber end,
+					 BlockNumber *next_fsm_block_to_vacuum)
+{
+	BlockNumber blkno = InvalidBlockNumber;
+	bool		parallel = (next_fsm_block_to_vacuum == NULL);
+	Buffer		vmbuffer = InvalidBuffer;
+	ReadStream *stream;
+
+	/*
+	 * Initialize for the first heap_vac_scan_next_block() call.  With start
+	 * 0, this relies on 0 - 1 wrapping around to InvalidBlockNumber.
+	 */
+	vacrel->scan_end = end;
+	vacrel->current_block = start - 1;
+	vacrel->next_unskippable_block = start - 1;
 	vacrel->next_unskippable_allvis = false;
+	vacrel->next_unskippable_eager_scanned = false;
 	vacrel->next_unskippable_vmbuffer = InvalidBuffer;
+	vacrel->eager_scan_remaining_fails = 0;
+	vacrel->next_eager_scan_region_start = start;
+
+	/*
+	 * Read the blocks we'll process through a read stream, so that they can
+	 * be prefetched.  The stream asks heap_vac_scan_next_block() for the
+	 * next block ahead of time, so vacrel->current_block is usually ahead of
+	 * the block being processed.
+	 */
+	stream = read_stream_begin_relation(READ_STREAM_MAINTENANCE,
+										vacrel->bstrategy,
+										vacrel->rel,
+										MAIN_FORKNUM,
+										heap_vac_scan_read_stream_next,
+										vacrel,
+										sizeof(uint8));
 
-	while (heap_vac_scan_next_block(vacrel, &blkno, &all_visible_according_to_vm))
+	for (;;)
 	{
 		Buffer		buf;
 		Page		page;
+		void	   *per_buffer_data;
+		uint8		blk_info;
+		bool		all_visible_according_to_vm;
+		bool		was_eager_scanned;
 		bool		has_lpdead_items;
 		bool		got_cleanup_lock = false;
 
-		vacrel->scanned_pages++;
-
-		/* Report as block scanned, update error traceback information */
-		pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
-		update_vacuum_error_info(vacrel, NULL, VACUUM_ERRCB_PHASE_SCAN_HEAP,
-								 blkno, InvalidOffsetNumber);
-
-		vacuum_delay_point();
-
 		/*
-		 * Regularly check if wraparound failsafe should trigger.
-		 *
-		 * There is a similar check inside lazy_vacuum_all_indexes(), but
-		 * relfrozenxid might start to look dangerously old before we reach
-		 * that point.  This check also provides failsafe coverage for the
-		 * one-pass strategy, and the two-pass strategy with the index_cleanup
-		 * param set to 'off'.
+		 * Consider if we definitely have enough space to process TIDs on the
+		 * next page already.  If we are close to overrunning the available
+		 * space for dead_items TIDs, pause and do a cycle of vacuuming before
+		 * we tackle it.
 		 */
-		if (vacrel->scanned_pages % FAILSAFE_EVERY_PAGES == 0)
-			lazy_check_wraparound_failsafe(vacrel);
-
-		/*
-		 * Consider if we definitely have enough space to process TIDs on page
-		 * already.  If we are close to overrunning the available space for
-		 * dead_items TIDs, pause and do a cycle of vacuuming before we tackle
-		 * this page.
-		 */
-		if (TidStoreMemoryUsage(dead_items) > dead_items_info->max_bytes)
+		if (!parallel && vacrel->dead_items_info->num_items > 0 &&
+			TidStoreMemoryUsage(vacrel->dead_items) > vacrel->dead_items_info->max_bytes)
 		{
 			/*
 			 * Before beginning index vacuuming, we release any pin we may
@@ -896,17 +1105,56 @@ lazy_scan_heap(LVRelState *vacrel)
 
 			/*
 			 * Vacuum the Free Space Map to make newly-freed space visible on
-			 * upper-level FSM pages.  Note we have not yet processed blkno.
+			 * upper-level FSM pages.  blkno is the last block we processed.
 			 */
-			FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum,
-									blkno);
-			next_fsm_block_to_vacuum = blkno;
+			FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
+									blkno + 1);
+			*next_fsm_block_to_vacuum = blkno + 1;
 
 			/* Report that we are once again scanning the heap */
 			pgstat_progress_update_param(PROGRESS_VACUUM_PHASE,
 										 PROGRESS_VACUUM_PHASE_SCAN_HEAP);
 		}
 
+		buf = read_stream_next_buffer(stream, &per_buffer_data);
+
+		/* The range is exhausted */
+		if (!BufferIsValid(buf))
+			break;
+
+		blk_info = *((uint8 *) per_buffer_data);
+		all_visible_according_to_vm =
+			(blk_info & VAC_BLK_ALL_VISIBLE_ACCORDING_TO_VM) != 0;
+		was_eager_scanned = (blk_info & VAC_BLK_WAS_EAGER_SCANNED) != 0;
+		blkno = BufferGetBlockNumber(buf);
+		page = BufferGetPage(buf);
+
+		vacrel->scanned_pages++;
+		if (was_eager_scanned)
+			vacrel->eager_scanned_pages++;
+
+		/* Report as block scanned, update error traceback information */
+		if (!parallel)
+			pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
+		update_vacuum_error_info(vacrel, NULL, VACUUM_ERRCB_PHASE_SCAN_HEAP,
+								 blkno, InvalidOffsetNumber);
+
+		vacuum_delay_point();
+
+		/*
+		 * Regularly check if wraparound failsafe should trigger.
+		 *
+		 * There is a similar check inside lazy_vacuum_all_indexes(), but
+		 * relfrozenxid might start to look dangerously old before we reach
+		 * that point.  This check also provides failsafe coverage for the
+		 * one-pass strategy, and the two-pass strategy with the index_cleanup
+		 * param set to 'off'.  In a parallel heap scan, only the leader
+		 * checks.
+		 */
+		if (vacrel->scanned_pages % FAILSAFE_EVERY_PAGES == 0 &&
+			!IsParallelWorker())
+			lazy_check_wraparound_failsafe(vacrel);
+
 		/*
 		 * Pin the visibility map page in case we need to mark the page
 		 * all-visible.  In most cases this will be very cheap, because we'll
@@ -914,10 +1162,6 @@ lazy_scan_heap(LVRelState *vacrel)
 		 */
 		visibilitymap_pin(vacrel->rel, blkno, &vmbuffer);
 
-		buf = ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
-								 vacrel->bstrategy);
-		page = BufferGetPage(buf);
-
 		/*
 		 * We need a buffer cleanup lock to prune HOT chains and defragment
 		 * the page in lazy_scan_prune.  But when it's not possible to acquire
@@ -976,6 +1220,16 @@ lazy_scan_heap(LVRelState *vacrel)
 							vmbuffer, all_visible_according_to_vm,
 							&has_lpdead_items);
 
+		/*
+		 * If we only scanned the page to try to freeze it, remember whether
+		 * that worked, to decide whether to keep trying for other pages.
+		 */
+		if (was_eager_scanned)
+			eager_scan_count_result(vacrel,
+									(visibilitymap_get_status(vacrel->rel, blkno,
+															  &vmbuffer) &
+									 VISIBILITYMAP_ALL_FROZEN) != 0);
+
 		/*
 		 * Now drop the buffer lock and, potentially, update the FSM.
 		 *
@@ -1010,58 +1264,223 @@ lazy_scan_heap(LVRelState *vacrel)
 			 * table has indexes. There will only be newly-freed space if we
 			 * held the cleanup lock and lazy_scan_prune() was called.
 			 */
-			if (got_cleanup_lock && vacrel->nindexes == 0 && has_lpdead_items &&
-				blkno - next_fsm_block_to_vacuum >= VACUUM_FSM_EVERY_PAGES)
+			if (!parallel && got_cleanup_lock && vacrel->nindexes == 0 &&
+				has_lpdead_items &&
+				blkno - *next_fsm_block_to_vacuum >= VACUUM_FSM_EVERY_PAGES)
 			{
-				FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum,
+				FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
 										blkno);
-				next_fsm_block_to_vacuum = blkno;
+				*next_fsm_block_to_vacuum = blkno;
 			}
 		}
 		else
 			UnlockReleaseBuffer(buf);
 	}
 
+	read_stream_end(stream);
+
 	vacrel->blkno = InvalidBlockNumber;
 	if (BufferIsValid(vmbuffer))
 		ReleaseBuffer(vmbuffer);
+}
 
-	/* report that everything is now scanned */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
+/*
+ *	lazy_scan_heap_parallel() -- initial pass over the heap, in parallel
+ *
+ * Launches workers to scan the heap together with us, see
+ * lazy_scan_heap_chunks().  If they stop because dead_items is full, does a
+ * round of index and heap vacuuming, and starts over for the remaining
+ * blocks.
+ */
+static void
+lazy_scan_heap_parallel(LVRelState *vacrel,
+						BlockNumber *next_fsm_block_to_vacuum)
+{
+	LVParallelScanShared *pscan = vacrel->pscan;
 
-	/* now we can compute the new value for pg_class.reltuples */
-	vacrel->new_live_tuples = vac_estimate_reltuples(vacrel->rel, rel_pages,
-													 vacrel->scanned_pages,
-													 vacrel->live_tuples);
+	for (;;)
+	{
+		uint64		next_block;
 
-	/*
-	 * Also compute the total number of surviving heap entries.  In the
-	 * (unlikely) scenario that new_live_tuples is -1, take it as zero.
-	 */
-	vacrel->new_rel_tuples =
-		Max(vacrel->new_live_tuples, 0) + vacrel->recently_dead_tuples +
-		vacrel->missed_dead_tuples;
+		/* Might have been changed by the failsafe */
+		pscan->do_index_vacuuming = vacrel->do_index_vacuuming;
 
-	/*
-	 * Do index vacuuming (call each index's ambulkdelete routine), then do
-	 * related heap vacuuming
-	 */
-	if (dead_items_info->num_items > 0)
+		parallel_vacuum_table_scan_begin(vacrel->pvs);
+		lazy_scan_heap_chunks(vacrel);
+		parallel_vacuum_table_scan_end(vacrel->pvs);
+
+		lazy_scan_gather_counters(vacrel);
+
+		next_block = pg_atomic_read_u64(&pscan->next_block);
+		if (next_block >= vacrel->rel_pages)
+			break;
+
+		/* Perform a round of index and heap vacuuming */
+		vacrel->consider_bypass_optimization = false;
 		lazy_vacuum(vacrel);
 
-	/*
-	 * Vacuum the remainder of the Free Space Map.  We must do this whether or
-	 * not there were indexes, and whether or not we bypassed index vacuuming.
-	 */
-	if (blkno > next_fsm_block_to_vacuum)
-		FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum, blkno);
+		/* Vacuum the FSM for the blocks processed so far */
+		FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
+								(BlockNumber) next_block);
+		*next_fsm_block_to_vacuum = (BlockNumber) next_block;
 
-	/* report all blocks vacuumed */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, blkno);
+		/* Report that we are once again scanning the heap */
+		pgstat_progress_update_param(PROGRESS_VACUUM_PHASE,
+									 PROGRESS_VACUUM_PHASE_SCAN_HEAP);
+	}
+}
 
-	/* Do final index cleanup (call each index's amvacuumcleanup routine) */
-	if (vacrel->nindexes > 0 && vacrel->do_index_cleanup)
-		lazy_cleanup_all_indexes(vacrel);
+/*
+ *	lazy_scan_heap_chunks() -- take part in a parallel heap scan
+ *
+ * Claims chunks of blocks from the shared state and processes them, until
+ * all blocks have been handed out, or dead_items is full.  Called by both the
+ * leader and the workers.
+ */
+static void
+lazy_scan_heap_chunks(LVRelState *vacrel)
+{
+	LVParallelScanShared *pscan = vacrel->pscan;
+
+	for (;;)
+	{
+		uint64		start;
+		BlockNumber end;
+
+		/*
+		 * Leave the remaining blocks for after the next round of index and
+		 * heap vacuuming, if there's no space left for more TIDs.
+		 */
+		if (vacrel->dead_items_info->num_items > 0 &&
+			TidStoreMemoryUsage(vacrel->dead_items) > vacrel->dead_items_info->max_bytes)
+			break;
+
+		start = pg_atomic_fetch_add_u64(&pscan->next_block,
+										PARALLEL_SCAN_CHUNK_BLOCKS);
+		if (start >= vacrel->rel_pages)
+			break;
+		end = Min(start + PARALLEL_SCAN_CHUNK_BLOCKS, vacrel->rel_pages);
+
+		lazy_scan_heap_range(vacrel, (BlockNumber) start, end, NULL);
+
+		pgstat_progress_parallel_incr_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED,
+											end - start);
+	}
+}
+
+/*
+ * Add the counters of the workers of a parallel heap scan to the leader's,
+ * and reset them for the next round.
+ */
+static void
+lazy_scan_gather_counters(LVRelState *vacrel)
+{
+	LVParallelScanShared *pscan = vacrel->pscan;
+
+	for (int i = 0; i < pscan->nworkers; i++)
+	{
+		LVScanCounters *counters = &pscan->counters[i];
+
+		if (!counters->valid)
+			continue;
+
+		vacrel->scanned_pages += counters->scanned_pages;
+		vacrel->eager_scanned_pages += counters->eager_scanned_pages;
+		vacrel->frozen_pages += counters->frozen_pages;
+		vacrel->lpdead_item_pages += counters->lpdead_item_pages;
+		vacrel->missed_dead_pages += counters->missed_dead_pages;
+		vacrel->nonempty_pages = Max(vacrel->nonempty_pages,
+									 counters->nonempty_pages);
+		vacrel->tuples_deleted += counters->tuples_deleted;
+		vacrel->tuples_frozen += counters->tuples_frozen;
+		vacrel->lpdead_items += counters->lpdead_items;
+		vacrel->live_tuples += counters->live_tuples;
+		vacrel->recently_dead_tuples += counters->recently_dead_tuples;
+		vacrel->missed_dead_tuples += counters->missed_dead_tuples;
+		if (TransactionIdPrecedes(counters->NewRelfrozenXid,
+								  vacrel->NewRelfrozenXid))
+			vacrel->NewRelfrozenXid = counters->NewRelfrozenXid;
+		if (MultiXactIdPrecedes(counters->NewRelminMxid,
+								vacrel->NewRelminMxid))
+			vacrel->NewRelminMxid = counters->NewRelminMxid;
+		vacrel->skippedallvis |= counters->skippedallvis;
+
+		memset(counters, 0, sizeof(LVScanCounters));
+	}
+}
+
+/*
+ *	heap_parallel_vacuum_scan_worker() -- a worker's share of a parallel
+ *										   heap scan
+ *
+ * Called by parallel_vacuum_main() in parallel vacuum workers launched by
+ * parallel_vacuum_table_scan_begin().
+ */
+void
+heap_parallel_vacuum_scan_worker(Relation rel, ParallelVacuumState *pvs,
+								 void *scan_shared,
+								 BufferAccessStrategy bstrategy)
+{
+	LVParallelScanShared *pscan = (LVParallelScanShared *) scan_shared;
+	LVScanCounters *counters;
+	LVRelState *vacrel;
+	ErrorContextCallback errcallback;
+
+	Assert(IsParallelWorker());
+	Assert(ParallelWorkerNumber < pscan->nworkers);
+
+	vacrel = (LVRelState *) palloc0(sizeof(LVRelState));
+	vacrel->relnamespace = get_namespace_name(RelationGetNamespace(rel));
+	vacrel->relname = pstrdup(RelationGetRelationName(rel));
+	vacrel->indname = NULL;
+	vacrel->phase = VACUUM_ERRCB_PHASE_UNKNOWN;
+	errcallback.callback = vacuum_error_callback;
+	errcallback.arg = vacrel;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* Set up the same state as the leader's, see heap_vacuum_rel() */
+	vacrel->rel = rel;
+	vacrel->nindexes = pscan->nindexes;
+	vacrel->bstrategy = bstrategy;
+	vacrel->aggressive = pscan->aggressive;
+	vacrel->skipwithvm = pscan->skipwithvm;
+	vacrel->do_index_vacuuming = pscan->do_index_vacuuming;
+	vacrel->cutoffs = pscan->cutoffs;
+	vacrel->eager_scan_max_fails_per_region =
+		pscan->eager_scan_max_fails_per_region;
+	vacrel->eager_scan_max_successes = pscan->eager_scan_max_successes;
+	vacrel->vistest = GlobalVisTestFor(rel);
+	vacrel->NewRelfrozenXid = vacrel->cutoffs.OldestXmin;
+	vacrel->NewRelminMxid = vacrel->cutoffs.OldestMxact;
+	vacrel->rel_pages = pscan->rel_pages;
+	vacrel->dead_items = parallel_vacuum_get_dead_items(pvs,
+														&vacrel->dead_items_info);
+	vacrel->pscan = pscan;
+
+	lazy_scan_heap_chunks(vacrel);
+
+	/* Hand our counters over to the leader */
+	counters = &pscan->counters[ParallelWorkerNumber];
+	counters->scanned_pages = vacrel->scanned_pages;
+	counters->eager_scanned_pages = vacrel->eager_scanned_pages;
+	counters->frozen_pages = vacrel->frozen_pages;
+	counters->lpdead_item_pages = vacrel->lpdead_item_pages;
+	counters->missed_dead_pages = vacrel->missed_dead_pages;
+	counters->nonempty_pages = vacrel->nonempty_pages;
+	counters->tuples_deleted = vacrel->tuples_deleted;
+	counters->tuples_frozen = vacrel->tuples_frozen;
+	counters->lpdead_items = vacrel->lpdead_items;
+	counters->live_tuples = vacrel->live_tuples;
+	counters->recently_dead_tuples = vacrel->recently_dead_tuples;
+	counters->missed_dead_tuples = vacrel->missed_dead_tuples;
+	counters->NewRelfrozenXid = vacrel->NewRelfrozenXid;
+	counters->NewRelminMxid = vacrel->NewRelminMxid;
+	counters->skippedallvis = vacrel->skippedallvis;
+	counters->valid = true;
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
 }
 
 /*
@@ -1072,8 +1491,9 @@ lazy_scan_heap(LVRelState *vacrel)
  * and various thresholds to skip blocks which do not need to be processed and
  * sets blkno to the next block to process.
  *
- * The block number and visibility status of the next block to process are set
- * in *blkno and *all_visible_according_to_vm.  The return value is false if
+ * The block number of the next block to process is set in *blkno, and flags
+ * telling whether it was all-visible according to the VM and whether it's
+ * only scanned eagerly are set in *blk_info.  The return value is false if
  * there are no further blocks to process.
  *
  * vacrel is an in/out parameter here.  Vacuum options and information about
@@ -1084,22 +1504,22 @@ lazy_scan_heap(LVRelState *vacrel)
  */
 static bool
 heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
-						 bool *all_visible_according_to_vm)
+						 uint8 *blk_info)
 {
 	BlockNumber next_block;
 
 	/* relies on InvalidBlockNumber + 1 overflowing to 0 on first call */
 	next_block = vacrel->current_block + 1;
 
-	/* Have we reached the end of the relation? */
-	if (next_block >= vacrel->rel_pages)
+	/* Have we reached the end of the range (usually, of the relation)? */
+	if (next_block >= vacrel->scan_end)
 	{
 		if (BufferIsValid(vacrel->next_unskippable_vmbuffer))
 		{
 			ReleaseBuffer(vacrel->next_unskippable_vmbuffer);
 			vacrel->next_unskippable_vmbuffer = InvalidBuffer;
 		}
-		*blkno = vacrel->rel_pages;
+		*blkno = vacrel->scan_end;
 		return false;
 	}
 
@@ -1138,6 +1558,21 @@ heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
 			next_block = vacrel->next_unskippable_block;
 			if (skipsallvis)
 				vacrel->skippedallvis = true;
+
+			/*
+			 * The range of a parallel heap scan can end with skippable
+			 * blocks, which we might just have skipped.
+			 */
+			if (next_block >= vacrel->scan_end)
+			{
+				if (BufferIsValid(vacrel->next_unskippable_vmbuffer))
+				{
+					ReleaseBuffer(vacrel->next_unskippable_vmbuffer);
+					vacrel->next_unskippable_vmbuffer = InvalidBuffer;
+				}
+				*blkno = vacrel->current_block = vacrel->scan_end;
+				return false;
+			}
 		}
 	}
 
@@ -1150,7 +1585,7 @@ heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
 		 * otherwise they would've been unskippable.
 		 */
 		*blkno = vacrel->current_block = next_block;
-		*all_visible_according_to_vm = true;
+		*blk_info = VAC_BLK_ALL_VISIBLE_ACCORDING_TO_VM;
 		return true;
 	}
 	else
@@ -1162,11 +1597,34 @@ heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
 		Assert(next_block == vacrel->next_unskippable_block);
 
 		*blkno = vacrel->current_block = next_block;
-		*all_visible_according_to_vm = vacrel->next_unskippable_allvis;
+		*blk_info = 0;
+		if (vacrel->next_unskippable_allvis)
+			*blk_info |= VAC_BLK_ALL_VISIBLE_ACCORDING_TO_VM;
+		if (vacrel->next_unskippable_eager_scanned)
+			*blk_info |= VAC_BLK_WAS_EAGER_SCANNED;
 		return true;
 	}
 }
 
+/*
+ * Read stream callback for the initial heap pass, returning the blocks
+ * heap_vac_scan_next_block() chooses.  Its flags are passed along as the
+ * per-buffer data.
+ */
+static BlockNumber
+heap_vac_scan_read_stream_next(ReadStream *stream,
+							   void *callback_private_data,
+							   void *per_buffer_data)
+{
+	LVRelState *vacrel = (LVRelState *) callback_private_data;
+	BlockNumber blkno;
+
+	if (!heap_vac_scan_next_block(vacrel, &blkno, (uint8 *) per_buffer_data))
+		return InvalidBlockNumber;
+
+	return blkno;
+}
+
 /*
  * Find the next unskippable block in a vacuum scan using the visibility map.
  * The next unskippable block and its visibility information is updated in
@@ -1179,6 +1637,9 @@ heap_vac_scan_next_block(LVRelState *vacrel, BlockNumber *blkno,
  * (Actually, non-aggressive VACUUMs can choose to skip all-visible pages with
  * older XIDs/MXIDs.  The *skippedallvis flag will be set here when the choice
  * to skip such a range is actually made, making everything safe.)
+ *
+ * Non-aggressive VACUUMs also treat some all-visible pages as unskippable, to
+ * try to freeze them; see eager_scan_block().
  */
 static void
 find_next_unskippable_block(LVRelState *vacrel, bool *skipsallvis)
@@ -1187,14 +1648,27 @@ find_next_unskippable_block(LVRelState *vacrel, bool *skipsallvis)
 	BlockNumber next_unskippable_block = vacrel->next_unskippable_block + 1;
 	Buffer		next_unskippable_vmbuffer = vacrel->next_unskippable_vmbuffer;
 	bool		next_unskippable_allvis;
+	bool		next_unskippable_eager_scanned = false;
 
 	*skipsallvis = false;
 
 	for (;;)
 	{
-		uint8		mapbits = visibilitymap_get_status(vacrel->rel,
-													   next_unskippable_block,
-													   &next_unskippable_vmbuffer);
+		uint8		mapbits;
+
+		/*
+		 * Stop at the end of the range.  That's only reached here when the
+		 * range of a parallel heap scan ends before the last block.
+		 */
+		if (next_unskippable_block >= vacrel->scan_end)
+		{
+			next_unskippable_allvis = false;
+			break;
+		}
+
+		mapbits = visibilitymap_get_status(vacrel->rel,
+										   next_unskippable_block,
+										   &next_unskippable_vmbuffer);
 
 		next_unskippable_allvis = (mapbits & VISIBILITYMAP_ALL_VISIBLE) != 0;
 
@@ -1235,6 +1709,13 @@ find_next_unskippable_block(LVRelState *vacrel, bool *skipsallvis)
 			if (vacrel->aggressive)
 				break;
 
+			/* Scan it anyway if we're freezing such blocks eagerly */
+			if (eager_scan_block(vacrel, next_unskippable_block))
+			{
+				next_unskippable_eager_scanned = true;
+				break;
+			}
+
 			/*
 			 * All-visible block is safe to skip in non-aggressive case.  But
 			 * remember that the final range contains such a block for later.
@@ -1248,9 +1729,121 @@ find_next_unskippable_block(LVRelState *vacrel, bool *skipsallvis)
 	/* write the local variables back to vacrel */
 	vacrel->next_unskippable_block = next_unskippable_block;
 	vacrel->next_unskippable_allvis = next_unskippable_allvis;
+	vacrel->next_unskippable_eager_scanned = next_unskippable_eager_scanned;
 	vacrel->next_unskippable_vmbuffer = next_unskippable_vmbuffer;
 }
 
+/*
+ *	heap_vacuum_eager_scan_setup() -- decide whether to scan eagerly
+ *
+ * A non-aggressive VACUUM skips all-visible pages, even if they hold tuples
+ * that are old enough to be frozen, so that work piles up for the next
+ * aggressive VACUUM.  For tables that are mostly inserted into, that can be
+ * most of the table, all at once.  To spread out that work, non-aggressive
+ * VACUUMs scan some of the all-visible but not all-frozen pages too, and
+ * freeze them when possible.
+ *
+ * Scanning a page that can't be frozen is wasted effort, so the number of
+ * such failures is capped for each region of EAGER_SCAN_REGION_SIZE blocks,
+ * by vacuum_max_eager_freeze_failure_rate.  The number of successes is
+ * capped too, so that the work is spread over several VACUUMs, rather than
+ * done by the first one.
+ *
+ * Eager scanning is only worthwhile if some of the table's tuples are old
+ * enough to have to be frozen, which they can't be if relfrozenxid and
+ * relminmxid are newer than the freeze cutoffs.
+ */
+static void
+heap_vacuum_eager_scan_setup(LVRelState *vacrel)
+{
+	BlockNumber all_visible;
+	BlockNumber all_frozen;
+
+	vacrel->eager_scan_max_fails_per_region = 0;
+	vacrel->eager_scan_max_successes = 0;
+	vacrel->eager_scan_successes = 0;
+
+	/* Aggressive VACUUMs have to scan all those pages anyway */
+	if (vacrel->aggressive || !vacrel->skipwithvm)
+		return;
+
+	if (vacuum_max_eager_freeze_failure_rate <= 0)
+		return;
+
+	if (!TransactionIdPrecedes(vacrel->cutoffs.relfrozenxid,
+							   vacrel->cutoffs.FreezeLimit) &&
+		!MultiXactIdPrecedes(vacrel->cutoffs.relminmxid,
+							 vacrel->cutoffs.MultiXactCutoff))
+		return;
+
+	visibilitymap_count(vacrel->rel, &all_visible, &all_frozen);
+	if (all_visible <= all_frozen)
+		return;
+
+	vacrel->eager_scan_max_successes = (BlockNumber)
+		(MAX_EAGER_FREEZE_SUCCESS_RATE * (all_visible - all_frozen));
+	vacrel->eager_scan_max_fails_per_region = (BlockNumber)
+		(vacuum_max_eager_freeze_failure_rate * EAGER_SCAN_REGION_SIZE);
+}
+
+/*
+ * Should all-visible but not all-frozen block blkno be scanned eagerly?
+ *
+ * Starts a new region of the failure budget, if blkno is past the current
+ * one.  The first and last regions of a range of blocks, usually a chunk of
+ * a parallel heap scan, get a proportional share of the budget.
+ */
+static bool
+eager_scan_block(LVRelState *vacrel, BlockNumber blkno)
+{
+	BlockNumber successes;
+
+	if (vacrel->eager_scan_max_fails_per_region == 0)
+		return false;
+
+	if (blkno >= vacrel->next_eager_scan_region_start)
+	{
+		BlockNumber region_start;
+		BlockNumber region_end;
+
+		region_start = Max(blkno - blkno % EAGER_SCAN_REGION_SIZE,
+						   vacrel->next_eager_scan_region_start);
+		region_end = Min((uint64) blkno - blkno % EAGER_SCAN_REGION_SIZE +
+						 EAGER_SCAN_REGION_SIZE, vacrel->scan_end);
+		vacrel->eager_scan_remaining_fails = (BlockNumber)
+			((uint64) vacrel->eager_scan_max_fails_per_region *
+			 (region_end - region_start) / EAGER_SCAN_REGION_SIZE);
+		vacrel->next_eager_scan_region_start = region_end;
+	}
+
+	if (vacrel->eager_scan_remaining_fails == 0)
+		return false;
+
+	if (vacrel->pscan != NULL)
+		successes = pg_atomic_read_u32(&vacrel->pscan->eager_scan_successes);
+	else
+		successes = vacrel->eager_scan_successes;
+
+	return successes < vacrel->eager_scan_max_successes;
+}
+
+/*
+ * Record whether a block that was eagerly scanned could be frozen.
+ */
+static void
+eager_scan_count_result(LVRelState *vacrel, bool frozen)
+{
+	if (!frozen)
+	{
+		if (vacrel->eager_scan_remaining_fails > 0)
+			vacrel->eager_scan_remaining_fails--;
+	}
+	else if (vacrel->pscan != NULL)
+		pg_atomic_fetch_add_u32(&vacrel->pscan->eager_scan_successes, 1);
+	else
+		vacrel->eager_scan_successes++;
+}
+
 /*
  *	lazy_scan_new_or_empty() -- lazy_scan_heap() new/empty page handling.
  *
@@ -1436,6 +2029,10 @@ lazy_scan_prune(LVRelState *vacrel,
 	if (vacrel->nindexes == 0)
 		prune_options |= HEAP_PAGE_PRUNE_MARK_UNUSED_NOW;
 
+	/* Keep the tuples that pruning removes around for lazy_retail_collect */
+	if (vacrel->retail_itups != NULL)
+		memcpy(vacrel->retail_page, page, BLCKSZ);
+
 	heap_page_prune_and_freeze(rel, buf, vacrel->vistest, prune_options,
 							   &vacrel->cutoffs, &presult, PRUNE_VACUUM_SCAN,
 							   &vacrel->offnum,
@@ -1497,6 +2094,8 @@ lazy_scan_prune(LVRelState *vacrel,
 		qsort(presult.deadoffsets, presult.lpdead_items, sizeof(OffsetNumber),
 			  cmpOffsetNumbers);
 
+		lazy_retail_collect(vacrel, blkno, presult.deadoffsets,
+							presult.lpdead_items);
 		dead_items_add(vacrel, blkno, presult.deadoffsets, presult.lpdead_items);
 	}
 
@@ -1817,6 +2416,8 @@ lazy_scan_noprune(LVRelState *vacrel,
 		 */
 		vacrel->lpdead_item_pages++;
 
+		/* The tuples of these items are long gone */
+		lazy_retail_forget(vacrel);
 		dead_items_add(vacrel, blkno, deadoffsets, lpdead_items);
 
 		vacrel->lpdead_items += lpdead_items;
@@ -2023,8 +2624,14 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
 			Relation	indrel = vacrel->indrels[idx];
 			IndexBulkDeleteResult *istat = vacrel->indstats[idx];
 
+			IndexTuple *retail_itups = NULL;
+
+			if (vacrel->retail_itups != NULL)
+				retail_itups = vacrel->retail_itups[idx];
+
 			vacrel->indstats[idx] = lazy_vacuum_one_index(indrel, istat,
 														  old_live_tuples,
+														  retail_itups,
 														  vacrel);
 
 			/* Report the number of indexes vacuumed */
@@ -2080,6 +2687,28 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
 	return allindexes;
 }
 
+/*
+ * Read stream callback for the second heap pass, returning the blocks that
+ * have dead items.  The TidStore iteration result is passed along as the
+ * per-buffer data.
+ */
+static BlockNumber
+vacuum_reap_lp_read_stream_next(ReadStream *stream,
+								void *callback_private_data,
+								void *per_buffer_data)
+{
+	TidStoreIter *iter = (TidStoreIter *) callback_private_data;
+	TidStoreIterResult *iter_result;
+
+	iter_result = TidStoreIterateNext(iter);
+	if (iter_result == NULL)
+		return InvalidBlockNumber;
+
+	memcpy(per_buffer_data, iter_result, sizeof(TidStoreIterResult));
+
+	return iter_result->blkno;
+}
+
 /*
  *	lazy_vacuum_heap_rel() -- second pass over the heap for two pass strategy
  *
@@ -2100,11 +2729,11 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
 static void
 lazy_vacuum_heap_rel(LVRelState *vacrel)
 {
+	ReadStream *stream;
 	BlockNumber vacuumed_pages = 0;
 	Buffer		vmbuffer = InvalidBuffer;
 	LVSavedErrInfo saved_err_info;
 	TidStoreIter *iter;
-	TidStoreIterResult *iter_result;
 
 	Assert(vacrel->do_index_vacuuming);
 	Assert(vacrel->do_index_cleanup);
@@ -2119,19 +2748,46 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 							 VACUUM_ERRCB_PHASE_VACUUM_HEAP,
 							 InvalidBlockNumber, InvalidOffsetNumber);
 
+	/*
+	 * Read the blocks with dead items through a read stream, so that they can
+	 * be prefetched.  The stream gets them from the TidStore iteration ahead
+	 * of time, along with the iteration results, to get the offsets from
+	 * when the block's turn comes.
+	 */
 	iter = TidStoreBeginIterate(vacrel->dead_items);
-	while ((iter_result = TidStoreIterateNext(iter)) != NULL)
+	stream = read_stream_begin_relation(READ_STREAM_MAINTENANCE,
+										vacrel->bstrategy,
+										vacrel->rel,
+										MAIN_FORKNUM,
+										vacuum_reap_lp_read_stream_next,
+										iter,
+										sizeof(TidStoreIterResult));
+
+	for (;;)
 	{
 		BlockNumber blkno;
 		Buffer		buf;
 		Page		page;
+		TidStoreIterResult *iter_result;
+		OffsetNumber offsets[MaxOffsetNumber];
+		int			num_offsets;
 		Size		freespace;
 
 		vacuum_delay_point();
 
-		blkno = iter_result->blkno;
+		buf = read_stream_next_buffer(stream, (void **) &iter_result);
+
+		/* The relation is exhausted */
+		if (!BufferIsValid(buf))
+			break;
+
+		blkno = BufferGetBlockNumber(buf);
 		vacrel->blkno = blkno;
 
+		num_offsets = TidStoreGetBlockOffsets(iter_result, offsets,
+											  lengthof(offsets));
+		Assert(num_offsets <= lengthof(offsets));
+
 		/*
 		 * Pin the visibility map page in case we need to mark the page
 		 * all-visible.  In most cases this will be very cheap, because we'll
@@ -2140,11 +2796,9 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 		visibilitymap_pin(vacrel->rel, blkno, &vmbuffer);
 
 		/* We need a non-cleanup exclusive lock to mark dead_items unused */
-		buf = ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
-								 vacrel->bstrategy);
 		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
-		lazy_vacuum_heap_page(vacrel, blkno, buf, iter_result->offsets,
-							  iter_result->num_offsets, vmbuffer);
+		lazy_vacuum_heap_page(vacrel, blkno, buf, offsets, num_offsets,
+							  vmbuffer);
 
 		/* Now that we've vacuumed the page, record its available space */
 		page = BufferGetPage(buf);
@@ -2154,6 +2808,8 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 		RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
 		vacuumed_pages++;
 	}
+
+	read_stream_end(stream);
 	TidStoreEndIterate(iter);
 
 	vacrel->blkno = InvalidBlockNumber;
@@ -2398,6 +3054,197 @@ lazy_cleanup_all_indexes(LVRelState *vacrel)
 	pgstat_progress_update_multi_param(2, progress_end_index, progress_end_val);
 }
 
+/*
+ * Set up for retail deletion of index entries, if it's enabled and possible
+ * for any of the indexes.
+ */
+static void
+lazy_retail_init(LVRelState *vacrel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(vacrel->rel);
+	bool		any = false;
+
+	if (vacuum_retail_delete_limit <= 0 || vacrel->nindexes == 0 ||
+		!vacrel->do_index_vacuuming || ParallelVacuumIsActive(vacrel))
+		return;
+
+	vacrel->retail_index = palloc0(vacrel->nindexes * sizeof(bool));
+	for (int idx = 0; idx < vacrel->nindexes; idx++)
+	{
+		Relation	indrel = vacrel->indrels[idx];
+		TupleDesc	itupdesc = RelationGetDescr(indrel);
+		bool		possible;
+
+		possible = (indrel->rd_indam->amretaildelete != NULL &&
+					RelationGetIndexExpressions(indrel) == NIL &&
+					RelationGetIndexPredicate(indrel) == NIL);
+
+		/* The heap values must be usable as they are */
+		for (int i = 0; possible && i < itupdesc->natts; i++)
+		{
+			AttrNumber	attnum = indrel->rd_index->indkey.values[i];
+
+			if (attnum <= 0 ||
+				TupleDescAttr(itupdesc, i)->atttypid !=
+				TupleDescAttr(tupdesc, attnum - 1)->atttypid)
+				possible = false;
+		}
+
+		vacrel->retail_index[idx] = possible;
+		any |= possible;
+	}
+
+	if (!any)
+		return;
+
+	vacrel->retail_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											   "Vacuum retail deletion",
+											   ALLOCSET_DEFAULT_SIZES);
+	vacrel->retail_page = palloc(BLCKSZ);
+	lazy_retail_reset(vacrel);
+}
+
+/*
+ * Start over collecting index tuples for retail deletion, after dead_items
+ * was reset.
+ */
+static void
+lazy_retail_reset(LVRelState *vacrel)
+{
+	if (vacrel->retail_cxt == NULL)
+		return;
+
+	MemoryContextReset(vacrel->retail_cxt);
+	vacrel->retail_itups = MemoryContextAllocZero(vacrel->retail_cxt,
+												  vacrel->nindexes * sizeof(IndexTuple *));
+	vacrel->retail_nitups = 0;
+	vacrel->retail_maxitups = 0;
+}
+
+/*
+ * Give up on retail deletion for the current dead_items, because we can't
+ * form the index tuples of some of them.
+ */
+static void
+lazy_retail_forget(LVRelState *vacrel)
+{
+	if (vacrel->retail_itups == NULL)
+		return;
+
+	MemoryContextReset(vacrel->retail_cxt);
+	vacrel->retail_itups = NULL;
+}
+
+/*
+ * Form the index tuples for the dead items lazy_scan_prune() is about to add
+ * to dead_items, for retail deletion.
+ *
+ * The tuples are taken from the copy of the page made before pruning.  Items
+ * that were already LP_DEAD before have no tuple left, so we have to give up
+ * on retail deletion if there are any.  We also give up if there are more
+ * dead items than vacuum_retail_delete_limit, or if any of the index values
+ * are toasted: the TOAST table might not have them anymore.
+ */
+static void
+lazy_retail_collect(LVRelState *vacrel, BlockNumber blkno,
+					OffsetNumber *deadoffsets, int ndeadoffsets)
+{
+	Page		page = (Page) vacrel->retail_page;
+	TupleDesc	tupdesc = RelationGetDescr(vacrel->rel);
+	MemoryContext oldcxt;
+
+	if (vacrel->retail_itups == NULL)
+		return;
+
+	if (vacrel->retail_nitups + ndeadoffsets > vacuum_retail_delete_limit)
+	{
+		lazy_retail_forget(vacrel);
+		return;
+	}
+
+	oldcxt = MemoryContextSwitchTo(vacrel->retail_cxt);
+
+	if (vacrel->retail_nitups + ndeadoffsets > vacrel->retail_maxitups)
+	{
+		int			newmax = Max(vacrel->retail_maxitups * 2, 64);
+
+		newmax = Max(newmax, vacrel->retail_nitups + ndeadoffsets);
+		for (int idx = 0; idx < vacrel->nindexes; idx++)
+		{
+			if (!vacrel->retail_index[idx])
+				continue;
+			if (vacrel->retail_itups[idx] == NULL)
+				vacrel->retail_itups[idx] = palloc(newmax * sizeof(IndexTuple));
+			else
+				vacrel->retail_itups[idx] = repalloc(vacrel->retail_itups[idx],
+													 newmax * sizeof(IndexTuple));
+		}
+		vacrel->retail_maxitups = newmax;
+	}
+
+	for (int i = 0; i < ndeadoffsets; i++)
+	{
+		OffsetNumber offnum = deadoffsets[i];
+		ItemId		itemid = PageGetItemId(page, offnum);
+		HeapTupleData tuple;
+
+		/*
+		 * The index entries of a HOT chain point to its root item, which is
+		 * a redirect if the root tuple was pruned before.  All the tuples of
+		 * the chain have the same values for the indexed columns.
+		 */
+		if (ItemIdIsRedirected(itemid))
+			itemid = PageGetItemId(page, ItemIdGetRedirect(itemid));
+
+		if (!ItemIdIsNormal(itemid))
+		{
+			MemoryContextSwitchTo(oldcxt);
+			lazy_retail_forget(vacrel);
+			return;
+		}
+
+		tuple.t_data = (HeapTupleHeader) PageGetItem(page, itemid);
+		tuple.t_len = ItemIdGetLength(itemid);
+		tuple.t_tableOid = RelationGetRelid(vacrel->rel);
+		ItemPointerSet(&tuple.t_self, blkno, offnum);
+
+		for (int idx = 0; idx < vacrel->nindexes; idx++)
+		{
+			Relation	indrel = vacrel->indrels[idx];
+			TupleDesc	itupdesc = RelationGetDescr(indrel);
+			Datum		values[INDEX_MAX_KEYS];
+			bool		isnull[INDEX_MAX_KEYS];
+			IndexTuple	itup;
+
+			if (!vacrel->retail_index[idx])
+				continue;
+
+			for (int j = 0; j < itupdesc->natts; j++)
+			{
+				values[j] = heap_getattr(&tuple,
+										 indrel->rd_index->indkey.values[j],
+										 tupdesc, &isnull[j]);
+
+				if (!isnull[j] && TupleDescAttr(itupdesc, j)->attlen == -1 &&
+					VARATT_IS_EXTERNAL(DatumGetPointer(values[j])))
+				{
+					MemoryContextSwitchTo(oldcxt);
+					lazy_retail_forget(vacrel);
+					return;
+				}
+			}
+
+			itup = index_form_tuple(itupdesc, values, isnull);
+			itup->t_tid = tuple.t_self;
+			vacrel->retail_itups[idx][vacrel->retail_nitups] = itup;
+		}
+
+		vacrel->retail_nitups++;
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
 /*
  *	lazy_vacuum_one_index() -- vacuum index relation.
  *
@@ -2409,11 +3256,15 @@ lazy_cleanup_all_indexes(LVRelState *vacrel)
  *		bulkdelete callback.  It's always assumed to be estimated.
  *		See indexam.sgml for more info.
  *
+ *		If retail_itups isn't NULL, it has the index tuples of all of
+ *		dead_items, and the AM's amretaildelete routine is tried first.
+ *
  * Returns bulk delete stats derived from input stats
  */
 static IndexBulkDeleteResult *
 lazy_vacuum_one_index(Relation indrel, IndexBulkDeleteResult *istat,
-					  double reltuples, LVRelState *vacrel)
+					  double reltuples, IndexTuple *retail_itups,
+					  LVRelState *vacrel)
 {
 	IndexVacuumInfo ivinfo;
 	LVSavedErrInfo saved_err_info;
@@ -2439,9 +3290,18 @@ lazy_vacuum_one_index(Relation indrel, IndexBulkDeleteResult *istat,
 							 VACUUM_ERRCB_PHASE_VACUUM_INDEX,
 							 InvalidBlockNumber, InvalidOffsetNumber);
 
-	/* Do bulk deletion */
-	istat = vac_bulkdel_one_index(&ivinfo, istat, (void *) vacrel->dead_items,
-								  vacrel->dead_items_info);
+	/* Do retail deletion if possible, else bulk deletion */
+	Assert(retail_itups == NULL ||
+		   vacrel->retail_nitups == vacrel->dead_items_info->num_items);
+	if (retail_itups != NULL &&
+		index_retail_delete(&ivinfo, retail_itups, vacrel->retail_nitups))
+		ereport(ivinfo.message_level,
+				(errmsg("removed %d row versions from index \"%s\" by retail deletion",
+						vacrel->retail_nitups,
+						RelationGetRelationName(indrel))));
+	else
+		istat = vac_bulkdel_one_index(&ivinfo, istat, (void *) vacrel->dead_items,
+									  vacrel->dead_items_info);
 
 	/* Revert to the previous phase information for error traceback */
 	restore_vacuum_error_info(vacrel, &saved_err_info);
@@ -2820,13 +3680,23 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 	int			vac_work_mem = AmAutoVacuumWorkerProcess() &&
 		autovacuum_work_mem != -1 ?
 		autovacuum_work_mem : maintenance_work_mem;
+	int			nworkers_table_scan = 0;
+
+	/*
+	 * Workers can take part in the initial heap scan if the table is large
+	 * enough.  Not for temporary tables though, see below.
+	 */
+	if (nworkers >= 0 && !RelationUsesLocalBuffers(vacrel->rel))
+		nworkers_table_scan = lazy_parallel_scan_workers(vacrel);
 
 	/*
 	 * Initialize state for a parallel vacuum.  As of now, only one worker can
-	 * be used for an index, so we invoke parallelism only if there are at
-	 * least two indexes on a table.
+	 * be used for an index, so we invoke parallelism for the index phases
+	 * only if there are at least two indexes on a table.
 	 */
-	if (nworkers >= 0 && vacrel->nindexes > 1 && vacrel->do_index_vacuuming)
+	if (nworkers >= 0 &&
+		((vacrel->nindexes > 1 && vacrel->do_index_vacuuming) ||
+		 nworkers_table_scan > 0))
 	{
 		/*
 		 * Since parallel workers cannot access data in temporary tables, we
@@ -2846,6 +3716,9 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 		else
 			vacrel->pvs = parallel_vacuum_init(vacrel->rel, vacrel->indrels,
 											   vacrel->nindexes, nworkers,
+											   nworkers_table_scan,
+											   offsetof(LVParallelScanShared, counters) +
+											   nworkers_table_scan * sizeof(LVScanCounters),
 											   vac_work_mem,
 											   vacrel->verbose ? INFO : DEBUG2,
 											   vacrel->bstrategy);
@@ -2858,6 +3731,7 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 		{
 			vacrel->dead_items = parallel_vacuum_get_dead_items(vacrel->pvs,
 																&vacrel->dead_items_info);
+			lazy_parallel_scan_init(vacrel, nworkers_table_scan);
 			return;
 		}
 	}
@@ -2875,6 +3749,78 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 	vacrel->dead_items = TidStoreCreateLocal(dead_items_info->max_bytes, true);
 }
 
+/*
+ * Decide how many parallel workers to use for the initial heap scan.
+ *
+ * Like for parallel sequential scans, the table must be at least
+ * min_parallel_table_scan_size large, and another worker is added each time
+ * it triples in size.  Pages that we'll likely skip using the visibility map
+ * don't count, though.
+ */
+static int
+lazy_parallel_scan_workers(LVRelState *vacrel)
+{
+	BlockNumber pages = vacrel->rel_pages;
+	uint64		threshold;
+	int			nworkers = 1;
+
+	if (VacuumFailsafeActive)
+		return 0;
+
+	if (vacrel->skipwithvm)
+	{
+		BlockNumber all_visible;
+		BlockNumber all_frozen;
+
+		visibilitymap_count(vacrel->rel, &all_visible, &all_frozen);
+		pages -= Min(pages, vacrel->aggressive ? all_frozen : all_visible);
+	}
+
+	threshold = Max(min_parallel_table_scan_size, 1);
+	if (pages < threshold)
+		return 0;
+
+	while (pages >= threshold * 3)
+	{
+		nworkers++;
+		threshold *= 3;
+		if (nworkers >= max_parallel_maintenance_workers)
+			break;
+	}
+
+	return nworkers;
+}
+
+/*
+ * Set up the shared state of a parallel heap scan, if parallel_vacuum_init()
+ * planned for one.
+ */
+static void
+lazy_parallel_scan_init(LVRelState *vacrel, int nworkers)
+{
+	LVParallelScanShared *pscan;
+
+	pscan = (LVParallelScanShared *) parallel_vacuum_get_scan_shared(vacrel->pvs);
+	if (pscan == NULL)
+		return;
+
+	pscan->rel_pages = vacrel->rel_pages;
+	pscan->nindexes = vacrel->nindexes;
+	pscan->aggressive = vacrel->aggressive;
+	pscan->skipwithvm = vacrel->skipwithvm;
+	pscan->do_index_vacuuming = vacrel->do_index_vacuuming;
+	pscan->cutoffs = vacrel->cutoffs;
+	pscan->eager_scan_max_fails_per_region =
+		vacrel->eager_scan_max_fails_per_region;
+	pscan->eager_scan_max_successes = vacrel->eager_scan_max_successes;
+	pg_atomic_init_u64(&pscan->next_block, 0);
+	pg_atomic_init_u32(&pscan->eager_scan_successes, 0);
+	pscan->nworkers = nworkers;
+	memset(pscan->counters, 0, nworkers * sizeof(LVScanCounters));
+
+	vacrel->pscan = pscan;
+}
+
 /*
  * Add the given block number and offset numbers to dead_items.
  */
@@ -2884,8 +3830,14 @@ dead_items_add(LVRelState *vacrel, BlockNumber blkno, OffsetNumber *offsets,
 {
 	TidStore   *dead_items = vacrel->dead_items;
 
+	/*
+	 * In a parallel heap scan, other processes are adding items concurrently.
+	 * The lock is cheap when the store isn't shared, so take it regardless.
+	 */
+	TidStoreLockExclusive(dead_items);
 	TidStoreSetBlockOffsets(dead_items, blkno, offsets, num_offsets);
 	vacrel->dead_items_info->num_items += num_offsets;
+	TidStoreUnlock(dead_items);
 
 	/* update the memory usage report */
 	pgstat_progress_update_param(PROGRESS_VACUUM_DEAD_TUPLE_BYTES,
@@ -2903,9 +3855,13 @@ dead_items_reset(LVRelState *vacrel)
 	if (ParallelVacuumIsActive(vacrel))
 	{
 		parallel_vacuum_reset_dead_items(vacrel->pvs);
+		vacrel->dead_items = parallel_vacuum_get_dead_items(vacrel->pvs,
+															&vacrel->dead_items_info);
 		return;
 	}
 
+	lazy_retail_reset(vacrel);
+
 	/* Recreate the tidstore with the same max_bytes limitation */
 	TidStoreDestroy(dead_items);
 	vacrel->dead_items = TidStoreCreateLocal(vacrel->dead_items_info->max_bytes, true);
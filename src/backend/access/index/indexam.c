@@ -18,6 +18,7 @@
  *		index_rescan	- restart a scan of an index
  *		index_endscan	- end a scan
  *		index_insert	- insert an index tuple into a relation
+ *		index_insert_batch - insert a batch of index tuples
  *		index_markpos	- mark a scan position
  *		index_restrpos	- restore a scan position
  *		index_parallelscan_estimate - estimate shared memory for parallel scan
@@ -233,6 +234,36 @@ index_insert(Relation indexRelation,
 											 indexInfo);
 }
 
+/* ----------------
+ *		index_insert_batch - insert a batch of index tuples into a relation
+ *
+ *		Equivalent to calling index_insert for each of the ntuples entries,
+ *		with UNIQUE_CHECK_NO and indexUnchanged = false, only in an order of
+ *		the AM's choosing.  Only to be used if the AM provides aminsertbatch.
+ * ----------------
+ */
+void
+index_insert_batch(Relation indexRelation,
+				   Datum **values,
+				   bool **isnull,
+				   ItemPointer heap_tids,
+				   int ntuples,
+				   Relation heapRelation,
+				   IndexInfo *indexInfo)
+{
+	RELATION_CHECKS;
+	CHECK_REL_PROCEDURE(aminsertbatch);
+
+	if (!(indexRelation->rd_indam->ampredlocks))
+		CheckForSerializableConflictIn(indexRelation,
+									   (ItemPointer) NULL,
+									   InvalidBlockNumber);
+
+	indexRelation->rd_indam->aminsertbatch(indexRelation, values, isnull,
+										   heap_tids, ntuples, heapRelation,
+										   indexInfo);
+}
+
 /* -------------------------
  *		index_insert_cleanup - clean up after all index inserts are done
  * -------------------------
@@ -759,6 +790,27 @@ index_bulk_delete(IndexVacuumInfo *info,
 												 callback, callback_state);
 }
 
+/* ----------------
+ *		index_retail_delete - delete the given index entries
+ *
+ *		itups are index tuples formed from the dead heap tuples, with
+ *		their TIDs.  Returns false if the AM didn't delete all of them,
+ *		in which case index_bulk_delete must be used.
+ * ----------------
+ */
+bool
+index_retail_delete(IndexVacuumInfo *info, IndexTuple *itups, int nitups)
+{
+	Relation	indexRelation = info->index;
+
+	RELATION_CHECKS;
+
+	if (indexRelation->rd_indam->amretaildelete == NULL)
+		return false;
+
+	return indexRelation->rd_indam->amretaildelete(info, itups, nitups);
+}
+
 /* ----------------
  *		index_vacuum_cleanup - do post-deletion cleanup of an index
  *
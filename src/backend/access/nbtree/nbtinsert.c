@@ -29,9 +29,19 @@
 /* Minimum tree height for application of fastpath optimization */
 #define BTREE_FASTPATH_MIN_LEVEL	2
 
+/* State for sorting the tuples of a batch, see _bt_doinsert_batch */
+typedef struct BTBatchSortContext
+{
+	TupleDesc	itupdesc;
+	BTScanInsert key;			/* attributes' ordering procs, no values */
+} BTBatchSortContext;
+
 
 static BTStack _bt_search_insert(Relation rel, Relation heaprel,
 								 BTInsertState insertstate);
+static bool _bt_search_insert_hint(Relation rel, BTInsertState insertstate,
+								   BlockNumber hintblkno);
+static int	_bt_batch_cmp(const void *a, const void *b, void *arg);
 static TransactionId _bt_check_unique(Relation rel, BTInsertState insertstate,
 									  Relation heapRel,
 									  IndexUniqueCheck checkUnique, bool *is_unique,
@@ -275,6 +285,182 @@ search:
 	return is_unique;
 }
 
+/*
+ *	_bt_doinsert_batch() -- Handle insertion of a batch of index tuples.
+ *
+ *		This routine is called by the public interface routine, btinsertbatch.
+ *		By here, the tuples are filled in, including their TIDs.  There is no
+ *		uniqueness checking, as with UNIQUE_CHECK_NO.
+ *
+ *		The tuples are sorted (in place) in index order first.  Successive
+ *		tuples then tend to go to the same leaf page, which is tried before
+ *		descending the tree from the root again; see _bt_search_insert_hint.
+ *		A batch of tuples with random keys thus costs one full descent for
+ *		each leaf page it touches, rather than one for each tuple.
+ */
+void
+_bt_doinsert_batch(Relation rel, IndexTuple *itups, int ntuples,
+				   Relation heapRel)
+{
+	BTBatchSortContext cxt;
+	BlockNumber hintblkno = InvalidBlockNumber;
+
+	if (ntuples > 1)
+	{
+		cxt.itupdesc = RelationGetDescr(rel);
+		cxt.key = _bt_mkscankey(rel, NULL);
+		qsort_arg(itups, ntuples, sizeof(IndexTuple), _bt_batch_cmp, &cxt);
+		pfree(cxt.key);
+	}
+
+	for (int i = 0; i < ntuples; i++)
+	{
+		IndexTuple	itup = itups[i];
+		BTInsertStateData insertstate;
+		BTScanInsert itup_key;
+		BTStack		stack = NULL;
+		OffsetNumber newitemoff;
+
+		CHECK_FOR_INTERRUPTS();
+
+		itup_key = _bt_mkscankey(rel, itup);
+
+		/* see _bt_doinsert */
+		insertstate.itup = itup;
+		insertstate.itemsz = MAXALIGN(IndexTupleSize(itup));
+		insertstate.itup_key = itup_key;
+		insertstate.bounds_valid = false;
+		insertstate.buf = InvalidBuffer;
+		insertstate.postingoff = 0;
+
+		if (!BlockNumberIsValid(hintblkno) || !itup_key->heapkeyspace ||
+			!_bt_search_insert_hint(rel, &insertstate, hintblkno))
+			stack = _bt_search_insert(rel, heapRel, &insertstate);
+
+		CheckForSerializableConflictIn(rel, NULL, BufferGetBlockNumber(insertstate.buf));
+
+		newitemoff = _bt_findinsertloc(rel, &insertstate, false, false,
+									   stack, heapRel);
+
+		/* Remember the page for the next tuple, before it's released */
+		hintblkno = BufferGetBlockNumber(insertstate.buf);
+
+		_bt_insertonpg(rel, heapRel, itup_key, insertstate.buf, InvalidBuffer,
+					   stack, itup, insertstate.itemsz, newitemoff,
+					   insertstate.postingoff, false);
+
+		if (stack)
+			_bt_freestack(stack);
+		pfree(itup_key);
+	}
+}
+
+/*
+ *	_bt_search_insert_hint() -- try the leaf page of the previous insertion
+ *
+ * Used by _bt_doinsert_batch in place of a full _bt_search_insert, when the
+ * previous tuple of the batch went to the leaf page hintblkno.  If the new
+ * tuple also belongs on that page, it's locked in insertstate->buf, and true
+ * is returned.  The caller then uses a NULL stack, as with the fastpath
+ * optimization; we likewise require that the page has enough free space for
+ * the new tuple, so that a page split is never needed.
+ *
+ * The new tuple belongs on the page if it sorts after the page's first data
+ * item, and not after its high key.  This holds regardless of what might
+ * have happened to the page since our previous insertion, but only with
+ * heapkeyspace indexes, in which the heap TID makes every key unique.
+ */
+static bool
+_bt_search_insert_hint(Relation rel, BTInsertState insertstate,
+					   BlockNumber hintblkno)
+{
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+
+	Assert(insertstate->itup_key->heapkeyspace);
+
+	buf = _bt_getbuf(rel, hintblkno, BT_WRITE);
+	page = BufferGetPage(buf);
+	opaque = BTPageGetOpaque(page);
+
+	if (P_ISLEAF(opaque) &&
+		!P_IGNORE(opaque) &&
+		!P_INCOMPLETE_SPLIT(opaque) &&
+		PageGetFreeSpace(page) > insertstate->itemsz &&
+		PageGetMaxOffsetNumber(page) >= P_FIRSTDATAKEY(opaque) &&
+		_bt_compare(rel, insertstate->itup_key, page,
+					P_FIRSTDATAKEY(opaque)) > 0 &&
+		(P_RIGHTMOST(opaque) ||
+		 _bt_compare(rel, insertstate->itup_key, page, P_HIKEY) <= 0))
+	{
+		insertstate->buf = buf;
+		return true;
+	}
+
+	_bt_relbuf(rel, buf);
+	return false;
+}
+
+/*
+ * qsort_arg comparator for the tuples of a batch, in index order
+ *
+ * Ties are broken by heap TID, as in a heapkeyspace index.
+ */
+static int
+_bt_batch_cmp(const void *a, const void *b, void *arg)
+{
+	IndexTuple	itup1 = *((const IndexTuple *) a);
+	IndexTuple	itup2 = *((const IndexTuple *) b);
+	BTBatchSortContext *cxt = (BTBatchSortContext *) arg;
+	int			nkeyatts = cxt->key->keysz;
+	ScanKey		scankey = cxt->key->scankeys;
+
+	for (int i = 1; i <= nkeyatts; i++, scankey++)
+	{
+		Datum		datum1,
+					datum2;
+		bool		isNull1,
+					isNull2;
+		int32		result;
+
+		datum1 = index_getattr(itup1, i, cxt->itupdesc, &isNull1);
+		datum2 = index_getattr(itup2, i, cxt->itupdesc, &isNull2);
+
+		if (isNull1)
+		{
+			if (isNull2)
+				result = 0;		/* NULL "=" NULL */
+			else if (scankey->sk_flags & SK_BT_NULLS_FIRST)
+				result = -1;	/* NULL "<" NOT_NULL */
+			else
+				result = 1;		/* NULL ">" NOT_NULL */
+		}
+		else if (isNull2)
+		{
+			if (scankey->sk_flags & SK_BT_NULLS_FIRST)
+				result = 1;		/* NOT_NULL ">" NULL */
+			else
+				result = -1;	/* NOT_NULL "<" NULL */
+		}
+		else
+		{
+			result = DatumGetInt32(FunctionCall2Coll(&scankey->sk_func,
+													 scankey->sk_collation,
+													 datum1,
+													 datum2));
+
+			if (scankey->sk_flags & SK_BT_DESC)
+				INVERT_COMPARE_RESULT(result);
+		}
+
+		if (result != 0)
+			return result;
+	}
+
+	return ItemPointerCompare(&itup1->t_tid, &itup2->t_tid);
+}
+
 /*
  *	_bt_search_insert() -- _bt_search() wrapper for inserts
  *
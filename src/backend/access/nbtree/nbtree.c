@@ -31,6 +31,7 @@
 #include "storage/indexfsm.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
+#include "storage/read_stream.h"
 #include "storage/smgr.h"
 #include "utils/fmgrprotos.h"
 #include "utils/index_selfuncs.h"
@@ -86,7 +87,9 @@ typedef struct BTParallelScanDescData *BTParallelScanDesc;
 static void btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 						 IndexBulkDeleteCallback callback, void *callback_state,
 						 BTCycleId cycleid);
-static void btvacuumpage(BTVacState *vstate, BlockNumber scanblkno);
+static void btvacuumpage(BTVacState *vstate, Buffer buf);
+static bool btretaildeleteone(Relation rel, Relation heaprel,
+							  IndexTuple itup);
 static BTVacuumPosting btreevacuumposting(BTVacState *vstate,
 										  IndexTuple posting,
 										  OffsetNumber updatedoffset,
@@ -128,8 +131,10 @@ bthandler(PG_FUNCTION_ARGS)
 	amroutine->ambuild = btbuild;
 	amroutine->ambuildempty = btbuildempty;
 	amroutine->aminsert = btinsert;
+	amroutine->aminsertbatch = btinsertbatch;
 	amroutine->aminsertcleanup = NULL;
 	amroutine->ambulkdelete = btbulkdelete;
+	amroutine->amretaildelete = btretaildelete;
 	amroutine->amvacuumcleanup = btvacuumcleanup;
 	amroutine->amcanreturn = btcanreturn;
 	amroutine->amcostestimate = btcostestimate;
@@ -199,6 +204,34 @@ btinsert(Relation rel, Datum *values, bool *isnull,
 	return result;
 }
 
+/*
+ *	btinsertbatch() -- insert a batch of index tuples into a btree.
+ *
+ *		The tuples are inserted in index order, so that neighboring keys can
+ *		share the work of descending the tree; see _bt_doinsert_batch.
+ */
+void
+btinsertbatch(Relation rel, Datum **values, bool **isnull,
+			  ItemPointer ht_ctids, int ntuples, Relation heapRel,
+			  IndexInfo *indexInfo)
+{
+	IndexTuple *itups;
+
+	itups = palloc(sizeof(IndexTuple) * ntuples);
+	for (int i = 0; i < ntuples; i++)
+	{
+		itups[i] = index_form_tuple(RelationGetDescr(rel), values[i],
+									isnull[i]);
+		itups[i]->t_tid = ht_ctids[i];
+	}
+
+	_bt_doinsert_batch(rel, itups, ntuples, heapRel);
+
+	for (int i = 0; i < ntuples; i++)
+		pfree(itups[i]);
+	pfree(itups);
+}
+
 /*
  *	btgettuple() -- Get the next tuple in the scan.
  */
@@ -244,6 +277,13 @@ btgettuple(IndexScanDesc scan, ScanDirection dir)
 					so->killedItems[so->numKilled++] = so->currPos.itemIndex;
 			}
 
+			/*
+			 * A skip scan that changes direction has to read on from here
+			 * without skipping
+			 */
+			if (so->skip && dir != so->currPos.dir)
+				_bt_skip_change_dir(scan, dir);
+
 			/*
 			 * Now continue the scan.
 			 */
@@ -254,7 +294,8 @@ btgettuple(IndexScanDesc scan, ScanDirection dir)
 		if (res)
 			break;
 		/* ... otherwise see if we need another primitive index scan */
-	} while (so->numArrayKeys && _bt_start_prim_scan(scan, dir));
+	} while ((so->numArrayKeys && _bt_start_prim_scan(scan, dir)) ||
+			 (so->skip && _bt_skip_advance(scan, dir)));
 
 	return res;
 }
@@ -300,7 +341,9 @@ btgetbitmap(IndexScanDesc scan, TIDBitmap *tbm)
 			}
 		}
 		/* Now see if we need another primitive index scan */
-	} while (so->numArrayKeys && _bt_start_prim_scan(scan, ForwardScanDirection));
+	} while ((so->numArrayKeys &&
+			  _bt_start_prim_scan(scan, ForwardScanDirection)) ||
+			 (so->skip && _bt_skip_advance(scan, ForwardScanDirection)));
 
 	return ntids;
 }
@@ -324,8 +367,9 @@ btbeginscan(Relation rel, int nkeys, int norderbys)
 	so = (BTScanOpaque) palloc(sizeof(BTScanOpaqueData));
 	BTScanPosInvalidate(so->currPos);
 	BTScanPosInvalidate(so->markPos);
+	/* leave room for the extra key of a skip scan, see _bt_skip_setup */
 	if (scan->numberOfKeys > 0)
-		so->keyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
+		so->keyData = (ScanKey) palloc((scan->numberOfKeys + 1) * sizeof(ScanKeyData));
 	else
 		so->keyData = NULL;
 
@@ -335,9 +379,20 @@ btbeginscan(Relation rel, int nkeys, int norderbys)
 	so->orderProcs = NULL;
 	so->arrayContext = NULL;
 
+	so->skip = NULL;
+	so->skipContext = NULL;
+
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
 
+	so->prefetchTarget = -1;	/* until the first tuple is fetched */
+	so->prefetchDistance = 0;
+	so->prefetchLeaf = false;
+	so->prefetchPage = InvalidBlockNumber;
+	so->prefetchItem = 0;
+	so->prefetchLastBlock = InvalidBlockNumber;
+	so->prefetchVMBuffer = InvalidBuffer;
+
 	/*
 	 * We don't know yet whether the scan will be index-only, so we do not
 	 * allocate the tuple workspace arrays until btrescan.  However, we set up
@@ -377,6 +432,11 @@ btrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 	BTScanPosUnpinIfPinned(so->markPos);
 	BTScanPosInvalidate(so->markPos);
 
+	/* Ramp up prefetching again, the new scan might stop early */
+	so->prefetchDistance = 0;
+	so->prefetchPage = InvalidBlockNumber;
+	so->prefetchLastBlock = InvalidBlockNumber;
+
 	/*
 	 * Allocate tuple workspace arrays, if needed for an index-only scan and
 	 * not already done in a previous rescan call.  To save on palloc
@@ -408,6 +468,9 @@ btrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 				scan->numberOfKeys * sizeof(ScanKeyData));
 	so->numberOfKeys = 0;		/* until _bt_preprocess_keys sets it */
 	so->numArrayKeys = 0;		/* ditto */
+
+	/* Can the scan skip through the index's first column? */
+	_bt_skip_setup(scan);
 }
 
 /*
@@ -430,6 +493,9 @@ btendscan(IndexScanDesc scan)
 	so->markItemIndex = -1;
 	BTScanPosUnpinIfPinned(so->markPos);
 
+	if (BufferIsValid(so->prefetchVMBuffer))
+		ReleaseBuffer(so->prefetchVMBuffer);
+
 	/* No need to invalidate positions, the RAM is about to be freed. */
 
 	/* Release storage */
@@ -438,6 +504,9 @@ btendscan(IndexScanDesc scan)
 	/* so->arrayKeys and so->orderProcs are in arrayContext */
 	if (so->arrayContext != NULL)
 		MemoryContextDelete(so->arrayContext);
+	/* so->skip is in skipContext */
+	if (so->skipContext != NULL)
+		MemoryContextDelete(so->skipContext);
 	if (so->killedItems != NULL)
 		pfree(so->killedItems);
 	if (so->currTuples != NULL)
@@ -527,6 +596,10 @@ btrestrpos(IndexScanDesc scan)
 		}
 		else
 			BTScanPosInvalidate(so->currPos);
+
+		/* Restore a skip scan's key on the first column */
+		if (so->skip)
+			_bt_skip_restore(scan);
 	}
 }
 
@@ -829,6 +902,135 @@ btbulkdelete(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 	return stats;
 }
 
+/*
+ * Retail deletion of the index tuples pointing to dead heap tuples.
+ *
+ * Instead of scanning the whole index, each tuple is looked up by its key and
+ * heap TID.  That's only possible in heapkeyspace indexes, and only worth it
+ * if the descents read fewer pages than a scan of the whole index.  Returns
+ * false if some tuples weren't deleted, leaving it to btbulkdelete.
+ *
+ * This doesn't delete empty pages.  That's left to the next VACUUM that does
+ * scan the index.
+ */
+bool
+btretaildelete(IndexVacuumInfo *info, IndexTuple *itups, int nitups)
+{
+	Relation	rel = info->index;
+	bool		heapkeyspace,
+				allequalimage;
+
+	_bt_metaversion(rel, &heapkeyspace, &allequalimage);
+	if (!heapkeyspace)
+		return false;
+
+	if ((double) nitups * (_bt_getrootheight(rel) + 1) >=
+		(double) RelationGetNumberOfBlocks(rel))
+		return false;
+
+	for (int i = 0; i < nitups; i++)
+	{
+		vacuum_delay_point();
+
+		if (!btretaildeleteone(rel, info->heaprel, itups[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Delete the index tuple with itup's key and heap TID, or the TID from the
+ * posting list tuple holding it.  Returns false if it couldn't be found.
+ */
+static bool
+btretaildeleteone(Relation rel, Relation heaprel, IndexTuple itup)
+{
+	BTScanInsert key;
+	BTStack		stack;
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+	OffsetNumber offnum,
+				maxoff;
+	bool		found = false;
+
+	key = _bt_mkscankey(rel, itup);
+	Assert(key->scantid != NULL);
+
+	stack = _bt_search(rel, heaprel, key, &buf, BT_READ);
+	_bt_freestack(stack);
+
+	/*
+	 * Like btvacuumpage(), we need a cleanup lock to delete items.  The page
+	 * might have been split while we didn't hold a lock, moving the tuple to
+	 * the right.  Just give up in that case.
+	 */
+	_bt_upgradelockbufcleanup(rel, buf);
+	page = BufferGetPage(buf);
+	opaque = BTPageGetOpaque(page);
+
+	if (P_IGNORE(opaque) ||
+		(!P_RIGHTMOST(opaque) && _bt_compare(rel, key, page, P_HIKEY) > 0))
+	{
+		_bt_relbuf(rel, buf);
+		pfree(key);
+		return false;
+	}
+
+	maxoff = PageGetMaxOffsetNumber(page);
+	for (offnum = P_FIRSTDATAKEY(opaque);
+		 offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		IndexTuple	curtup = (IndexTuple) PageGetItem(page,
+													  PageGetItemId(page, offnum));
+
+		if (!BTreeTupleIsPosting(curtup))
+		{
+			if (ItemPointerEquals(&curtup->t_tid, &itup->t_tid))
+			{
+				_bt_delitems_vacuum(rel, buf, &offnum, 1, NULL, 0);
+				found = true;
+				break;
+			}
+		}
+		else
+		{
+			int			nitem = BTreeTupleGetNPosting(curtup);
+			ItemPointer items = BTreeTupleGetPosting(curtup);
+
+			for (int i = 0; i < nitem; i++)
+			{
+				BTVacuumPosting vacposting;
+
+				if (!ItemPointerEquals(&items[i], &itup->t_tid))
+					continue;
+
+				/* A posting list always keeps at least one other TID */
+				vacposting = palloc(offsetof(BTVacuumPostingData, deletetids) +
+									sizeof(uint16));
+				vacposting->itup = curtup;
+				vacposting->updatedoffset = offnum;
+				vacposting->ndeletedtids = 1;
+				vacposting->deletetids[0] = i;
+
+				_bt_delitems_vacuum(rel, buf, NULL, 0, &vacposting, 1);
+				pfree(vacposting);
+				found = true;
+				break;
+			}
+			if (found)
+				break;
+		}
+	}
+
+	_bt_relbuf(rel, buf);
+	pfree(key);
+
+	return found;
+}
+
 /*
  * Post-VACUUM cleanup.
  *
@@ -930,8 +1132,9 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 	Relation	rel = info->index;
 	BTVacState	vstate;
 	BlockNumber num_pages;
-	BlockNumber scanblkno;
 	bool		needLock;
+	BlockRangeReadStreamPrivate p;
+	ReadStream *stream = NULL;
 
 	/*
 	 * Reset fields that track information about the entire index now.  This
@@ -975,8 +1178,8 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 
 	/*
 	 * The outer loop iterates over all index pages except the metapage, in
-	 * physical order (we hope the kernel will cooperate in providing
-	 * read-ahead for speed).  It is critical that we visit all leaf pages,
+	 * physical order, reading them through a read stream so that they can be
+	 * prefetched.  It is critical that we visit all leaf pages,
 	 * including ones added after we start the scan, else we might fail to
 	 * delete some deletable tuples.  Hence, we must repeatedly check the
 	 * relation length.  We must acquire the relation-extension lock while
@@ -1000,9 +1203,11 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 	 */
 	needLock = !RELATION_IS_LOCAL(rel);
 
-	scanblkno = BTREE_METAPAGE + 1;
+	p.current_blocknum = BTREE_METAPAGE + 1;
 	for (;;)
 	{
+		Buffer		buf;
+
 		/* Get the current relation length */
 		if (needLock)
 			LockRelationForExtension(rel, ExclusiveLock);
@@ -1015,18 +1220,40 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 										 num_pages);
 
 		/* Quit if we've scanned the whole relation */
-		if (scanblkno >= num_pages)
+		if (p.current_blocknum >= num_pages)
 			break;
-		/* Iterate over pages, then loop back to recheck length */
-		for (; scanblkno < num_pages; scanblkno++)
+
+		/*
+		 * Iterate over pages, then loop back to recheck length.  The stream
+		 * is reset to continue with the pages added in the meantime.
+		 */
+		p.last_exclusive = num_pages;
+		if (stream == NULL)
+			stream = read_stream_begin_relation(READ_STREAM_MAINTENANCE |
+												READ_STREAM_FULL,
+												info->strategy,
+												rel,
+												MAIN_FORKNUM,
+												block_range_read_stream_cb,
+												&p,
+												0);
+		else
+			read_stream_reset(stream);
+
+		while ((buf = read_stream_next_buffer(stream, NULL)) != InvalidBuffer)
 		{
-			btvacuumpage(&vstate, scanblkno);
+			BlockNumber scanblkno = BufferGetBlockNumber(buf);
+
+			btvacuumpage(&vstate, buf);
 			if (info->report_progress)
 				pgstat_progress_update_param(PROGRESS_SCAN_BLOCKS_DONE,
 											 scanblkno);
 		}
 	}
 
+	if (stream != NULL)
+		read_stream_end(stream);
+
 	/* Set statistics num_pages field to final size of index */
 	stats->num_pages = num_pages;
 
@@ -1049,7 +1276,8 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 /*
  * btvacuumpage --- VACUUM one page
  *
- * This processes a single page for btvacuumscan().  In some cases we must
+ * This processes a single page for btvacuumscan(), which has read and pinned
+ * buf.  We release the pin.  In some cases we must
  * backtrack to re-examine and VACUUM pages that were the scanblkno during
  * a previous call here.  This is how we handle page splits (that happened
  * after our cycleid was acquired) whose right half page happened to reuse
@@ -1057,7 +1285,7 @@ btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
  * recycled (i.e. before the page split).
  */
 static void
-btvacuumpage(BTVacState *vstate, BlockNumber scanblkno)
+btvacuumpage(BTVacState *vstate, Buffer buf)
 {
 	IndexVacuumInfo *info = vstate->info;
 	IndexBulkDeleteResult *stats = vstate->stats;
@@ -1068,7 +1296,7 @@ btvacuumpage(BTVacState *vstate, BlockNumber scanblkno)
 	bool		attempt_pagedel;
 	BlockNumber blkno,
 				backtrack_to;
-	Buffer		buf;
+	BlockNumber scanblkno = BufferGetBlockNumber(buf);
 	Page		page;
 	BTPageOpaque opaque;
 
@@ -1086,10 +1314,12 @@ backtrack:
 	 * We can't use _bt_getbuf() here because it always applies
 	 * _bt_checkpage(), which will barf on an all-zero page. We want to
 	 * recycle all-zero pages, not fail.  Also, we want to use a nondefault
-	 * buffer access strategy.
+	 * buffer access strategy.  The scanblkno page was read by our caller;
+	 * pages we backtrack to are read here.
 	 */
-	buf = ReadBufferExtended(rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
-							 info->strategy);
+	if (blkno != scanblkno)
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
+								 info->strategy);
 	_bt_lockbuf(rel, buf, BT_READ);
 	page = BufferGetPage(buf);
 	opaque = NULL;
@@ -17,18 +17,41 @@
 
 #include "access/nbtree.h"
 #include "access/relscan.h"
+#include "access/visibilitymap.h"
 #include "access/xact.h"
+#include "catalog/pg_am_d.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
+#include "utils/uuid.h"
+
+/*
+ * Kinds of leading key attributes that binary searches can compare without
+ * calling the opclass comparison function, see _bt_fastcmp_kind().
+ */
+typedef enum BTFastCmpKind
+{
+	BT_FASTCMP_NONE,
+	BT_FASTCMP_INT4,
+	BT_FASTCMP_INT8,
+	BT_FASTCMP_UUID,
+} BTFastCmpKind;
 
 
 static void _bt_drop_lock_and_maybe_pin(IndexScanDesc scan, BTScanPos sp);
 static OffsetNumber _bt_binsrch(Relation rel, BTScanInsert key, Buffer buf);
 static int	_bt_binsrch_posting(BTScanInsert key, Page page,
 								OffsetNumber offnum);
+static int32 _bt_compare_prefix(Relation rel, BTScanInsert key, Page page,
+								OffsetNumber offnum, int *cmpcol);
+static BTFastCmpKind _bt_fastcmp_kind(BTScanInsert key);
+static inline int32 _bt_compare_fast(Relation rel, BTScanInsert key,
+									 BTFastCmpKind fastcmp, Page page,
+									 OffsetNumber offnum, int *cmpcol);
 static bool _bt_readpage(IndexScanDesc scan, ScanDirection dir,
 						 OffsetNumber offnum, bool firstPage);
 static void _bt_saveitem(BTScanOpaque so, int itemIndex,
@@ -39,6 +62,10 @@ static int	_bt_setuppostingitems(BTScanOpaque so, int itemIndex,
 static inline void _bt_savepostingitem(BTScanOpaque so, int itemIndex,
 									   OffsetNumber offnum,
 									   ItemPointer heapTid, int tupleOffset);
+static void _bt_prefetch(IndexScanDesc scan, ScanDirection dir);
+#ifdef USE_PREFETCH
+static void _bt_prefetch_heap_block(IndexScanDesc scan, ItemPointer tid);
+#endif
 static bool _bt_steppage(IndexScanDesc scan, ScanDirection dir);
 static bool _bt_readnextpage(IndexScanDesc scan, BlockNumber blkno, ScanDirection dir);
 static bool _bt_parallel_readpage(IndexScanDesc scan, BlockNumber blkno,
@@ -344,6 +371,9 @@ _bt_binsrch(Relation rel,
 				high;
 	int32		result,
 				cmpval;
+	int			lowcmpcol,
+				highcmpcol;
+	BTFastCmpKind fastcmp;
 
 	page = BufferGetPage(buf);
 	opaque = BTPageGetOpaque(page);
@@ -377,23 +407,39 @@ _bt_binsrch(Relation rel,
 	 * 'low' are <= scan key, all slots at or after 'high' are > scan key.
 	 *
 	 * We can fall out when high == low.
+	 *
+	 * lowcmpcol and highcmpcol are the first attributes that weren't found
+	 * equal to the scan key in the tuples before 'low' and at 'high', see
+	 * _bt_compare_prefix().
 	 */
 	high++;						/* establish the loop invariant for high */
+	lowcmpcol = highcmpcol = 1;
+	fastcmp = _bt_fastcmp_kind(key);
 
 	cmpval = key->nextkey ? 0 : 1;	/* select comparison value */
 
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
+		int			cmpcol = Min(lowcmpcol, highcmpcol);
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		if (fastcmp != BT_FASTCMP_NONE && cmpcol == 1)
+			result = _bt_compare_fast(rel, key, fastcmp, page, mid, &cmpcol);
+		else
+			result = _bt_compare_prefix(rel, key, page, mid, &cmpcol);
 
 		if (result >= cmpval)
+		{
 			low = mid + 1;
+			lowcmpcol = cmpcol;
+		}
 		else
+		{
 			high = mid;
+			highcmpcol = cmpcol;
+		}
 	}
 
 	/*
@@ -475,6 +521,9 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 				stricthigh;
 	int32		result,
 				cmpval;
+	int			lowcmpcol,
+				highcmpcol;
+	BTFastCmpKind fastcmp;
 
 	page = BufferGetPage(insertstate->buf);
 	opaque = BTPageGetOpaque(page);
@@ -515,26 +564,40 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 	 * maintained to save additional search effort for caller.
 	 *
 	 * We can fall out when high == low.
+	 *
+	 * As in _bt_binsrch(), lowcmpcol and highcmpcol track the attributes
+	 * known to be equal to the scan key in the tuples bounding the search.
+	 * Nothing is known about the bounds of a previous search.
 	 */
 	if (!insertstate->bounds_valid)
 		high++;					/* establish the loop invariant for high */
 	stricthigh = high;			/* high initially strictly higher */
+	lowcmpcol = highcmpcol = 1;
+	fastcmp = _bt_fastcmp_kind(key);
 
 	cmpval = 1;					/* !nextkey comparison value */
 
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
+		int			cmpcol = Min(lowcmpcol, highcmpcol);
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		if (fastcmp != BT_FASTCMP_NONE && cmpcol == 1)
+			result = _bt_compare_fast(rel, key, fastcmp, page, mid, &cmpcol);
+		else
+			result = _bt_compare_prefix(rel, key, page, mid, &cmpcol);
 
 		if (result >= cmpval)
+		{
 			low = mid + 1;
+			lowcmpcol = cmpcol;
+		}
 		else
 		{
 			high = mid;
+			highcmpcol = cmpcol;
 			if (result != 0)
 				stricthigh = high;
 		}
@@ -651,6 +714,110 @@ _bt_binsrch_posting(BTScanInsert key, Page page, OffsetNumber offnum)
 	return low;
 }
 
+/*
+ * Can binary searches compare the first attribute of the scan key to index
+ * tuples directly, rather than through the opclass comparison function?
+ *
+ * That's the case for the default int4, int8 and uuid opclasses, whose
+ * comparison functions are simple enough to inline, when the scan key's
+ * first value isn't NULL.  The function OID identifies the comparison, and
+ * implies the types of both sides, so this is safe regardless of the opclass
+ * the index was actually built with.
+ */
+static BTFastCmpKind
+_bt_fastcmp_kind(BTScanInsert key)
+{
+	ScanKey		scankey = &key->scankeys[0];
+
+	if (key->keysz < 1 || (scankey->sk_flags & SK_ISNULL))
+		return BT_FASTCMP_NONE;
+
+	switch (scankey->sk_func.fn_oid)
+	{
+		case F_BTINT4CMP:
+			return BT_FASTCMP_INT4;
+		case F_BTINT8CMP:
+			return BT_FASTCMP_INT8;
+		case F_UUID_CMP:
+			return BT_FASTCMP_UUID;
+		default:
+			return BT_FASTCMP_NONE;
+	}
+}
+
+/*
+ *	_bt_compare_fast() -- _bt_compare_prefix() for a fast comparison kind.
+ *
+ * Compares the first attribute directly.  If it's equal to the scan key's,
+ * the other attributes and the heap TID are compared by _bt_compare_prefix()
+ * as usual.  So are tuples with NULLs, whose first attribute might be NULL,
+ * and the tuples compared in special ways: the "minus infinity" first data
+ * key of an internal page, and pivot tuples with all key attributes
+ * truncated.
+ *
+ * Without NULLs, the first attribute always starts right at the data offset
+ * of the tuple, which is MAXALIGNed.
+ */
+static inline int32
+_bt_compare_fast(Relation rel, BTScanInsert key, BTFastCmpKind fastcmp,
+				 Page page, OffsetNumber offnum, int *cmpcol)
+{
+	BTPageOpaque opaque = BTPageGetOpaque(page);
+	ScanKey		scankey = &key->scankeys[0];
+	IndexTuple	itup;
+	char	   *data;
+	int32		result;
+
+	Assert(*cmpcol == 1);
+
+	if (!P_ISLEAF(opaque) && offnum == P_FIRSTDATAKEY(opaque))
+		return _bt_compare_prefix(rel, key, page, offnum, cmpcol);
+
+	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	if (IndexTupleHasNulls(itup) ||
+		(BTreeTupleIsPivot(itup) && BTreeTupleGetNAtts(itup, rel) == 0))
+		return _bt_compare_prefix(rel, key, page, offnum, cmpcol);
+
+	data = (char *) itup + IndexInfoFindDataOffset(itup->t_info);
+
+	/* Compare the scan key to the tuple, the opposite of sk_func's order */
+	switch (fastcmp)
+	{
+		case BT_FASTCMP_INT4:
+			{
+				int32		a = DatumGetInt32(scankey->sk_argument);
+				int32		b = *(int32 *) data;
+
+				result = (a > b) - (a < b);
+				break;
+			}
+		case BT_FASTCMP_INT8:
+			{
+				int64		a = DatumGetInt64(scankey->sk_argument);
+				int64		b = *(int64 *) data;
+
+				result = (a > b) - (a < b);
+				break;
+			}
+		case BT_FASTCMP_UUID:
+			result = memcmp(DatumGetPointer(scankey->sk_argument), data,
+							UUID_LEN);
+			break;
+		default:
+			pg_unreachable();
+	}
+
+	if (scankey->sk_flags & SK_BT_DESC)
+		INVERT_COMPARE_RESULT(result);
+
+	if (result != 0)
+		return result;
+
+	/* The first attribute is equal, let the general case take it from here */
+	*cmpcol = 2;
+	return _bt_compare_prefix(rel, key, page, offnum, cmpcol);
+}
+
 /*----------
  *	_bt_compare() -- Compare insertion-type scankey to tuple on a page.
  *
@@ -683,6 +850,35 @@ _bt_compare(Relation rel,
 			BTScanInsert key,
 			Page page,
 			OffsetNumber offnum)
+{
+	int			cmpcol = 1;
+
+	return _bt_compare_prefix(rel, key, page, offnum, &cmpcol);
+}
+
+/*
+ *	_bt_compare_prefix() -- _bt_compare(), skipping known-equal attributes.
+ *
+ * On entry, *cmpcol is the first scan key attribute to compare: the caller
+ * knows that the tuple's attributes before it are equal to the scan key's.
+ * On return, *cmpcol is the attribute that decided the result, or one past
+ * the last attribute compared if they were all equal.
+ *
+ * A binary search can use this to skip comparing leading attributes.  If the
+ * tuples bounding the search range on both sides are equal to the scan key
+ * on their first N attributes, so are all the tuples in between, since the
+ * tuples on a page are in order.  That saves comparing the same long leading
+ * values over and over again in multi-column indexes where many tuples share
+ * them.  This only holds within a page, which can't change while we look at
+ * it; a search can't carry what it learned over to another page, which
+ * might have been split concurrently.
+ */
+static int32
+_bt_compare_prefix(Relation rel,
+				   BTScanInsert key,
+				   Page page,
+				   OffsetNumber offnum,
+				   int *cmpcol)
 {
 	TupleDesc	itupdesc = RelationGetDescr(rel);
 	BTPageOpaque opaque = BTPageGetOpaque(page);
@@ -702,7 +898,10 @@ _bt_compare(Relation rel,
 	 * --- see NOTE above.
 	 */
 	if (!P_ISLEAF(opaque) && offnum == P_FIRSTDATAKEY(opaque))
+	{
+		*cmpcol = 1;
 		return 1;
+	}
 
 	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
 	ntupatts = BTreeTupleGetNAtts(itup, rel);
@@ -722,8 +921,9 @@ _bt_compare(Relation rel,
 	ncmpkey = Min(ntupatts, key->keysz);
 	Assert(key->heapkeyspace || ncmpkey == key->keysz);
 	Assert(!BTreeTupleIsPosting(itup) || key->allequalimage);
-	scankey = key->scankeys;
-	for (int i = 1; i <= ncmpkey; i++)
+	Assert(*cmpcol >= 1 && *cmpcol <= ncmpkey + 1);
+	scankey = key->scankeys + (*cmpcol - 1);
+	for (int i = *cmpcol; i <= ncmpkey; i++)
 	{
 		Datum		datum;
 		bool		isNull;
@@ -767,10 +967,14 @@ _bt_compare(Relation rel,
 
 		/* if the keys are unequal, return the difference */
 		if (result != 0)
+		{
+			*cmpcol = i;
 			return result;
+		}
 
 		scankey++;
 	}
+	*cmpcol = ncmpkey + 1;
 
 	/*
 	 * All non-truncated attributes (other than heap TID) were found to be
@@ -1471,6 +1675,8 @@ readcomplete:
 	if (scan->xs_want_itup)
 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
+	_bt_prefetch(scan, dir);
+
 	return true;
 }
 
@@ -1521,9 +1727,108 @@ _bt_next(IndexScanDesc scan, ScanDirection dir)
 	if (scan->xs_want_itup)
 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
+	_bt_prefetch(scan, dir);
+
 	return true;
 }
 
+/*
+ *	_bt_prefetch() -- Prefetch pages the scan will soon need.
+ *
+ * Called each time the scan returns an item.  Issues prefetch requests for
+ * the heap pages of the next few items of currPos, so that the heap fetches
+ * that follow each item don't have to wait for one random read at a time.
+ * Index-only scans only prefetch the heap pages that aren't all-visible,
+ * since those are the only ones they'll visit.  The distance ramps up from
+ * one item to effective_io_concurrency, so that scans that stop after a few
+ * items don't issue many useless requests.
+ *
+ * When the scan moves to a new leaf page that's not the last one it will
+ * read, the right sibling is prefetched too.  In parallel scans, another
+ * process might read that page, so we don't do that.
+ *
+ * Heap pages are only prefetched for heap tables.  The TIDs of other table
+ * AMs don't necessarily refer to blocks.  Bitmap scans have no heap
+ * relation here and prefetch heap pages themselves.
+ */
+static void
+_bt_prefetch(IndexScanDesc scan, ScanDirection dir)
+{
+#ifdef USE_PREFETCH
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	heaprel = scan->heapRelation;
+
+	if (unlikely(so->prefetchTarget < 0))
+	{
+		so->prefetchTarget = 0;
+		if (heaprel != NULL && heaprel->rd_rel->relam == HEAP_TABLE_AM_OID)
+			so->prefetchTarget =
+				get_tablespace_io_concurrency(heaprel->rd_rel->reltablespace);
+		so->prefetchLeaf = scan->parallel_scan == NULL &&
+			get_tablespace_io_concurrency(scan->indexRelation->rd_rel->reltablespace) > 0;
+	}
+
+	if (so->prefetchPage != so->currPos.currPage)
+	{
+		/* Moved to another leaf page */
+		so->prefetchPage = so->currPos.currPage;
+		so->prefetchItem = so->currPos.itemIndex;
+
+		if (so->prefetchLeaf && ScanDirectionIsForward(dir) &&
+			so->currPos.moreRight && so->currPos.nextPage != P_NONE)
+			PrefetchBuffer(scan->indexRelation, MAIN_FORKNUM,
+						   so->currPos.nextPage);
+	}
+
+	if (so->prefetchTarget == 0)
+		return;
+
+	if (so->prefetchDistance < so->prefetchTarget)
+		so->prefetchDistance = Min(Max(so->prefetchDistance * 2, 1),
+								   so->prefetchTarget);
+
+	if (ScanDirectionIsForward(dir))
+	{
+		so->prefetchItem = Max(so->prefetchItem, so->currPos.itemIndex + 1);
+		while (so->prefetchItem <= so->currPos.lastItem &&
+			   so->prefetchItem <= so->currPos.itemIndex + so->prefetchDistance)
+			_bt_prefetch_heap_block(scan,
+									&so->currPos.items[so->prefetchItem++].heapTid);
+	}
+	else
+	{
+		so->prefetchItem = Min(so->prefetchItem, so->currPos.itemIndex - 1);
+		while (so->prefetchItem >= so->currPos.firstItem &&
+			   so->prefetchItem >= so->currPos.itemIndex - so->prefetchDistance)
+			_bt_prefetch_heap_block(scan,
+									&so->currPos.items[so->prefetchItem--].heapTid);
+	}
+#endif							/* USE_PREFETCH */
+}
+
+#ifdef USE_PREFETCH
+/*
+ * Prefetch the heap page of one TID for _bt_prefetch(), unless it's the one
+ * we prefetched last, as consecutive items often point to the same page.
+ */
+static void
+_bt_prefetch_heap_block(IndexScanDesc scan, ItemPointer tid)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BlockNumber blkno = ItemPointerGetBlockNumber(tid);
+
+	if (blkno == so->prefetchLastBlock)
+		return;
+	so->prefetchLastBlock = blkno;
+
+	if (scan->xs_want_itup &&
+		VM_ALL_VISIBLE(scan->heapRelation, blkno, &so->prefetchVMBuffer))
+		return;
+
+	PrefetchBuffer(scan->heapRelation, MAIN_FORKNUM, blkno);
+}
+#endif							/* USE_PREFETCH */
+
 /*
  *	_bt_readpage() -- Load data from current index page into so->currPos
  *
@@ -1634,6 +1939,60 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum,
 	 */
 	Assert(BTScanPosIsPinned(so->currPos));
 
+	if (so->skip)
+	{
+		BTSkipData *skip = so->skip;
+
+		skip->havestop = false;
+
+		/*
+		 * A group that starts on the leaf page where the last group ended
+		 * saved nothing by descending the tree (see _bt_skip_advance)
+		 */
+		if (skip->cur.mode == BTSKIP_GROUP)
+		{
+			if (firstPage && so->currPos.currPage == skip->lastpage)
+				skip->nwasted++;
+			else if (firstPage)
+				skip->nwasted = 0;
+			skip->lastpage = so->currPos.currPage;
+		}
+
+		/*
+		 * A skip scan looking for the next value of the first index column
+		 * only needs the first tuple it comes to.  It then ends the primitive
+		 * scan, just like a tuple that fails a required key would.
+		 */
+		if (skip->cur.mode == BTSKIP_SEEK)
+		{
+			if (ScanDirectionIsForward(dir))
+				offnum = Max(offnum, minoff);
+			else
+				offnum = Min(offnum, maxoff);
+
+			if (offnum >= minoff && offnum <= maxoff)
+			{
+				_bt_skip_stop(scan, (IndexTuple)
+							  PageGetItem(page, PageGetItemId(page, offnum)));
+				if (ScanDirectionIsForward(dir))
+				{
+					so->currPos.moreRight = false;
+					so->currPos.firstItem = 0;
+					so->currPos.lastItem = -1;
+					so->currPos.itemIndex = 0;
+				}
+				else
+				{
+					so->currPos.moreLeft = false;
+					so->currPos.firstItem = MaxTIDsPerBTreePage;
+					so->currPos.lastItem = MaxTIDsPerBTreePage - 1;
+					so->currPos.itemIndex = MaxTIDsPerBTreePage - 1;
+				}
+				return false;
+			}
+		}
+	}
+
 	/*
 	 * Prechecking the value of the continuescan flag for the last item on the
 	 * page (for backwards scan it will be the first item on a page).  If we
@@ -1775,7 +2134,11 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum,
 			}
 			/* When !continuescan, there can't be any more matches, so stop */
 			if (!pstate.continuescan)
+			{
+				if (so->skip)
+					_bt_skip_stop(scan, itup);
 				break;
+			}
 
 			offnum = OffsetNumberNext(offnum);
 		}
@@ -1800,6 +2163,8 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum,
 			truncatt = BTreeTupleGetNAtts(itup, scan->indexRelation);
 			pstate.prechecked = false;	/* precheck didn't cover HIKEY */
 			_bt_checkkeys(scan, &pstate, arrayKeys, itup, truncatt);
+			if (!pstate.continuescan && so->skip)
+				_bt_skip_stop(scan, itup);
 		}
 
 		if (!pstate.continuescan)
@@ -1920,6 +2285,8 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum,
 			{
 				/* there can't be any more matches, so stop */
 				so->currPos.moreLeft = false;
+				if (so->skip)
+					_bt_skip_stop(scan, itup);
 				break;
 			}
 
@@ -2087,6 +2454,22 @@ _bt_steppage(IndexScanDesc scan, ScanDirection dir)
 			else
 				so->markPos.moreLeft = true;
 		}
+
+		/*
+		 * A skip scan's markPos needs the key on the first index column that
+		 * it was read with, which btrestrpos restores.  The tuple that might
+		 * have ended the primitive scan on this page is not saved, though, so
+		 * again unset moreRight or moreLeft: the restored scan finds it again
+		 * by reading on.
+		 */
+		if (so->skip)
+		{
+			_bt_skip_mark(scan);
+			if (ScanDirectionIsForward(dir))
+				so->markPos.moreRight = true;
+			else
+				so->markPos.moreLeft = true;
+		}
 	}
 
 	if (ScanDirectionIsForward(dir))
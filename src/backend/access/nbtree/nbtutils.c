@@ -31,6 +31,7 @@
 
 #define LOOK_AHEAD_REQUIRED_RECHECKS 	3
 #define LOOK_AHEAD_DEFAULT_DISTANCE 	5
+#define BTSKIP_MAX_WASTED				4
 
 typedef struct BTSortArrayContext
 {
@@ -91,6 +92,9 @@ static bool _bt_compare_scankey_args(IndexScanDesc scan, ScanKey op,
 									 bool *result);
 static bool _bt_fix_scankey_strategy(ScanKey skey, int16 *indoption);
 static void _bt_mark_scankey_required(ScanKey skey);
+static void _bt_skip_lookup_op(Relation rel, StrategyNumber strat,
+							   FmgrInfo *finfo);
+static ScanKey _bt_skip_inkeys(IndexScanDesc scan, int *numberOfKeys);
 static bool _bt_check_compare(IndexScanDesc scan, ScanDirection dir,
 							  IndexTuple tuple, int tupnatts, TupleDesc tupdesc,
 							  bool advancenonrequired, bool prechecked, bool firstmatch,
@@ -2467,13 +2471,451 @@ end_toplevel_scan:
 	return false;
 }
 
+/*
+ * Look up the first index column's operator for strat, for a skip scan
+ *
+ * Note: it's possible that this would fail, if the opfamily is incomplete,
+ * but it seems quite unlikely that an opfamily would omit non-cross-type
+ * comparison operators for the opclass's own input type.
+ */
+static void
+_bt_skip_lookup_op(Relation rel, StrategyNumber strat, FmgrInfo *finfo)
+{
+	Oid			opfamily = rel->rd_opfamily[0];
+	Oid			opcintype = rel->rd_opcintype[0];
+	Oid			cmp_op;
+	RegProcedure cmp_proc;
+
+	cmp_op = get_opfamily_member(opfamily, opcintype, opcintype, strat);
+	if (!OidIsValid(cmp_op))
+		elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+			 strat, opcintype, opcintype, opfamily);
+	cmp_proc = get_opcode(cmp_op);
+	if (!RegProcedureIsValid(cmp_proc))
+		elog(ERROR, "missing oprcode for operator %u", cmp_op);
+
+	/* CurrentMemoryContext is the skip scan's context */
+	fmgr_info(cmp_proc, finfo);
+}
+
+/*
+ * _bt_skip_setup() -- Decide whether a scan can skip, at btrescan time
+ *
+ * A scan is made a skip scan when its first scan key is on the second index
+ * column, leaving the first column without any keys at all.  Without help
+ * from us, such a scan would have to read the whole index.  Scans with array
+ * keys or row comparison keys already make their own arrangements for
+ * primitive index scans and required keys, so we leave them alone.  Parallel
+ * scans are left alone too, since the participants share a single notion of
+ * where the scan is, with no room for our per-scan state.
+ *
+ * The workspace is set up on the first call, and only reset by later rescans
+ * (which can't change anything but the keys' arguments).
+ */
+void
+_bt_skip_setup(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	BTSkipData *skip;
+	MemoryContext oldContext;
+
+	if (scan->parallel_scan != NULL || scan->numberOfKeys < 1 ||
+		scan->keyData[0].sk_attno != 2)
+	{
+		so->skip = NULL;
+		return;
+	}
+	for (int i = 0; i < scan->numberOfKeys; i++)
+	{
+		if (scan->keyData[i].sk_flags & (SK_SEARCHARRAY | SK_ROW_HEADER))
+		{
+			so->skip = NULL;
+			return;
+		}
+	}
+
+	if (so->skip != NULL)
+	{
+		/* Forget about the previous scan's values */
+		skip = so->skip;
+		if (!skip->attbyval)
+		{
+			if (DatumGetPointer(skip->cur.value) != NULL)
+				pfree(DatumGetPointer(skip->cur.value));
+			if (DatumGetPointer(skip->mark.value) != NULL)
+				pfree(DatumGetPointer(skip->mark.value));
+			if (DatumGetPointer(skip->stopvalue) != NULL)
+				pfree(DatumGetPointer(skip->stopvalue));
+		}
+	}
+	else
+	{
+		Form_pg_attribute attr = TupleDescAttr(RelationGetDescr(rel), 0);
+
+		if (so->skipContext == NULL)
+			so->skipContext = AllocSetContextCreate(CurrentMemoryContext,
+													"BTree skip context",
+													ALLOCSET_SMALL_SIZES);
+		oldContext = MemoryContextSwitchTo(so->skipContext);
+
+		skip = (BTSkipData *) palloc0(sizeof(BTSkipData));
+		skip->keys = (ScanKey) palloc((scan->numberOfKeys + 1) *
+									  sizeof(ScanKeyData));
+		_bt_skip_lookup_op(rel, BTEqualStrategyNumber, &skip->eqproc);
+		_bt_skip_lookup_op(rel, BTLessStrategyNumber, &skip->ltproc);
+		_bt_skip_lookup_op(rel, BTGreaterStrategyNumber, &skip->gtproc);
+		skip->orderproc = index_getprocinfo(rel, 1, BTORDER_PROC);
+		skip->collation = rel->rd_indcollation[0];
+		skip->attbyval = attr->attbyval;
+		skip->attlen = attr->attlen;
+
+		MemoryContextSwitchTo(oldContext);
+		so->skip = skip;
+	}
+
+	/* Start out looking for the first value in whichever direction */
+	skip->cur.mode = BTSKIP_SEEK;
+	skip->cur.haskey = false;
+	skip->cur.value = (Datum) 0;
+	skip->mark.value = (Datum) 0;
+	skip->havestop = false;
+	skip->stopvalue = (Datum) 0;
+	skip->nwasted = 0;
+	skip->lastpage = InvalidBlockNumber;
+}
+
+/*
+ * Release a value of the first column owned by the skip scan workspace
+ */
+static inline void
+_bt_skip_free_value(BTSkipData *skip, Datum *value)
+{
+	if (!skip->attbyval && DatumGetPointer(*value) != NULL)
+		pfree(DatumGetPointer(*value));
+	*value = (Datum) 0;
+}
+
+/*
+ * Copy position src to dst, along with its own copy of the value
+ */
+static void
+_bt_skip_copy_pos(BTScanOpaque so, BTSkipPosData *dst, BTSkipPosData *src)
+{
+	BTSkipData *skip = so->skip;
+
+	_bt_skip_free_value(skip, &dst->value);
+	*dst = *src;
+	if (src->haskey && !src->isnull)
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(so->skipContext);
+
+		dst->value = datumCopy(src->value, skip->attbyval, skip->attlen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	else
+		dst->value = (Datum) 0;
+}
+
+/*
+ * Are nulls at the end of the first column in scan direction dir?
+ */
+static inline bool
+_bt_skip_nulls_last(IndexScanDesc scan, ScanDirection dir)
+{
+	bool		nullsfirst;
+
+	nullsfirst = (scan->indexRelation->rd_indoption[0] & INDOPTION_NULLS_FIRST) != 0;
+
+	return ScanDirectionIsForward(dir) ? !nullsfirst : nullsfirst;
+}
+
+/*
+ * _bt_skip_inkeys() -- Get the input scan keys of a skip scan
+ *
+ * Builds the key on the first index column for the current position, and
+ * appends a fresh copy of scan->keyData[] (_bt_preprocess_keys scribbles on
+ * its input keys, which are sure to be used again with another key on the
+ * first column).  Sets *numberOfKeys to the number of input keys.
+ */
+static ScanKey
+_bt_skip_inkeys(IndexScanDesc scan, int *numberOfKeys)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipData *skip = so->skip;
+	BTSkipPosData *cur = &skip->cur;
+	ScanKey		skey = &skip->keys[0];
+
+	memcpy(&skip->keys[1], scan->keyData,
+		   scan->numberOfKeys * sizeof(ScanKeyData));
+	*numberOfKeys = scan->numberOfKeys;
+	if (!cur->haskey)
+		return &skip->keys[1];
+
+	if (cur->mode == BTSKIP_GROUP)
+	{
+		/* "= value", or "IS NULL" */
+		if (cur->isnull)
+			ScanKeyEntryInitialize(skey, SK_ISNULL | SK_SEARCHNULL, 1,
+								   InvalidStrategy, InvalidOid, InvalidOid,
+								   InvalidOid, (Datum) 0);
+		else
+			ScanKeyEntryInitializeWithInfo(skey, 0, 1, BTEqualStrategyNumber,
+										   InvalidOid, skip->collation,
+										   &skip->eqproc, cur->value);
+	}
+	else if (cur->isnull)
+	{
+		/* Past the nulls, which only come first in cur->dir */
+		Assert(!_bt_skip_nulls_last(scan, cur->dir));
+		ScanKeyEntryInitialize(skey, SK_ISNULL | SK_SEARCHNOTNULL, 1,
+							   InvalidStrategy, InvalidOid, InvalidOid,
+							   InvalidOid, (Datum) 0);
+	}
+	else
+	{
+		/*
+		 * Past the value in cur->dir.  That's "> value" for a forward scan of
+		 * an ASC column.  _bt_fix_scankey_strategy commutes the strategy of
+		 * keys on DESC columns, so use the opposite operator for those.
+		 */
+		bool		greater = ScanDirectionIsForward(cur->dir);
+
+		if (scan->indexRelation->rd_indoption[0] & INDOPTION_DESC)
+			greater = !greater;
+		ScanKeyEntryInitializeWithInfo(skey, 0, 1,
+									   greater ? BTGreaterStrategyNumber :
+									   BTLessStrategyNumber,
+									   InvalidOid, skip->collation,
+									   greater ? &skip->gtproc : &skip->ltproc,
+									   cur->value);
+	}
+
+	(*numberOfKeys)++;
+	return skey;
+}
+
+/*
+ * _bt_skip_stop() -- Remember the tuple that ends a skip scan's _bt_readpage
+ *
+ * Called by _bt_readpage for the tuple that made it set continuescan=false
+ * (possibly the page's high key), and for the first tuple read by a
+ * BTSKIP_SEEK primitive scan.  Remembers its first column, which is where
+ * _bt_skip_advance will continue.
+ */
+void
+_bt_skip_stop(IndexScanDesc scan, IndexTuple tuple)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipData *skip = so->skip;
+	Datum		value;
+	bool		isnull;
+
+	Assert(BTreeTupleGetNAtts(tuple, scan->indexRelation) >= 1);
+
+	value = index_getattr(tuple, 1, RelationGetDescr(scan->indexRelation),
+						  &isnull);
+
+	_bt_skip_free_value(skip, &skip->stopvalue);
+	skip->havestop = true;
+	skip->stopisnull = isnull;
+	if (!isnull)
+	{
+		MemoryContext oldContext = MemoryContextSwitchTo(so->skipContext);
+
+		skip->stopvalue = datumCopy(value, skip->attbyval, skip->attlen);
+		MemoryContextSwitchTo(oldContext);
+	}
+}
+
+/*
+ * Make the value of the first column that ended the last primitive scan the
+ * current one
+ */
+static void
+_bt_skip_take_stop(BTSkipData *skip)
+{
+	_bt_skip_free_value(skip, &skip->cur.value);
+	skip->cur.haskey = true;
+	skip->cur.isnull = skip->stopisnull;
+	skip->cur.value = skip->stopvalue;
+	skip->stopvalue = (Datum) 0;
+}
+
+/*
+ * _bt_skip_advance() -- Set up a skip scan's next primitive index scan
+ *
+ * Called after _bt_first or _bt_next return false, like _bt_start_prim_scan.
+ * Returns true if there is another primitive index scan to perform, false if
+ * the skip scan is over.
+ *
+ * A skip scan starts with a BTSKIP_SEEK primitive scan, which has no key on
+ * the first index column, and only reads the first tuple it comes to before
+ * it ends.  That tuple's first column value v gives the first group: a
+ * BTSKIP_GROUP primitive scan with a "= v" key on the first column.  That key
+ * makes all the keys on the second column required, so _bt_first can use
+ * them to position the scan, and the scan ends as soon as it is past them.
+ *
+ * The tuple that ended the group's scan often tells us the next value.  When
+ * its first column differs from v, no other values can come between the two,
+ * and the next group is the stopping tuple's value.  Otherwise (the scan
+ * stopped because of a key on the second column) we need another BTSKIP_SEEK
+ * scan, this time with a key on the first column that starts it past v.
+ *
+ * Each descent of the tree costs a few page accesses, which is only worth it
+ * if it skips some leaf pages.  When the groups are so small that the scan
+ * keeps landing on the leaf page where the previous group ended, we switch
+ * to a BTSKIP_RANGE primitive scan, which reads on through all the remaining
+ * values of the first column without skipping.
+ *
+ * Nulls are a value like any other, with "IS NULL" as its group's key, and
+ * "IS NOT NULL" for starting past them.
+ */
+bool
+_bt_skip_advance(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipData *skip = so->skip;
+	BTSkipPosData *cur = &skip->cur;
+	bool		havestop = skip->havestop;
+
+	skip->havestop = false;
+
+	/* A skip scan whose direction changed doesn't get here with a key */
+	Assert(!cur->haskey || cur->mode == BTSKIP_GROUP || cur->dir == dir);
+
+	switch (cur->mode)
+	{
+		case BTSKIP_SEEK:
+		case BTSKIP_RANGE:
+			if (!havestop)
+				break;			/* reached the end of the index */
+
+			/*
+			 * The first tuple past the previous value, or the first null
+			 * tuple after the non-null values of a BTSKIP_RANGE scan
+			 */
+			_bt_skip_take_stop(skip);
+			cur->mode = BTSKIP_GROUP;
+			so->numberOfKeys = 0;
+			return true;
+
+		case BTSKIP_GROUP:
+			if (havestop && skip->nwasted < BTSKIP_MAX_WASTED &&
+				(cur->isnull != skip->stopisnull ||
+				 (!cur->isnull &&
+				  DatumGetInt32(FunctionCall2Coll(skip->orderproc,
+												  skip->collation,
+												  skip->stopvalue,
+												  cur->value)) != 0)))
+			{
+				/* Stopped at the next value, read its group next */
+				_bt_skip_take_stop(skip);
+				so->numberOfKeys = 0;
+				return true;
+			}
+
+			/* Nothing comes after nulls that are last in this direction */
+			if (cur->isnull && _bt_skip_nulls_last(scan, dir))
+				break;
+
+			/* Start past the current value */
+			if (skip->nwasted >= BTSKIP_MAX_WASTED)
+				cur->mode = BTSKIP_RANGE;
+			else
+				cur->mode = BTSKIP_SEEK;
+			cur->dir = dir;
+			so->numberOfKeys = 0;
+			return true;
+	}
+
+	/* The scan is over, start from scratch if the caller keeps going */
+	_bt_skip_free_value(skip, &cur->value);
+	cur->mode = BTSKIP_SEEK;
+	cur->haskey = false;
+	skip->nwasted = 0;
+	skip->lastpage = InvalidBlockNumber;
+	so->numberOfKeys = 0;
+
+	return false;
+}
+
+/*
+ * _bt_skip_change_dir() -- Continue a skip scan in the other direction
+ *
+ * Called when the caller changes the scan direction in the middle of a
+ * primitive scan.  The key on the first column only makes sense for the old
+ * direction, and the moreLeft/moreRight flags of currPos might have been set
+ * by a primitive scan that started in the middle of the index.  Drop the key,
+ * and read on from the current position without skipping.
+ */
+void
+_bt_skip_change_dir(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipData *skip = so->skip;
+
+	if (skip->cur.mode != BTSKIP_RANGE || skip->cur.haskey)
+	{
+		_bt_skip_free_value(skip, &skip->cur.value);
+		skip->cur.mode = BTSKIP_RANGE;
+		skip->cur.haskey = false;
+		skip->cur.dir = dir;
+		so->numberOfKeys = 0;
+		_bt_preprocess_keys(scan);
+	}
+	skip->havestop = false;
+	so->currPos.moreLeft = true;
+	so->currPos.moreRight = true;
+}
+
+/*
+ * _bt_skip_mark() -- Save a skip scan's position along with markPos
+ */
+void
+_bt_skip_mark(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+
+	_bt_skip_copy_pos(so, &so->skip->mark, &so->skip->cur);
+}
+
+/*
+ * _bt_skip_restore() -- Restore a skip scan's position along with markPos
+ *
+ * An invalid markPos means that the mark was set before the scan started (or
+ * after it ended), so the scan starts over.
+ */
+void
+_bt_skip_restore(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTSkipData *skip = so->skip;
+
+	skip->havestop = false;
+	so->numberOfKeys = 0;
+	if (BTScanPosIsValid(so->markPos))
+	{
+		_bt_skip_copy_pos(so, &skip->cur, &skip->mark);
+		_bt_preprocess_keys(scan);
+	}
+	else
+	{
+		_bt_skip_free_value(skip, &skip->cur.value);
+		skip->cur.mode = BTSKIP_SEEK;
+		skip->cur.haskey = false;
+	}
+}
+
 /*
  *	_bt_preprocess_keys() -- Preprocess scan keys
  *
  * The given search-type keys (taken from scan->keyData[])
  * are copied to so->keyData[] with possible transformation.
  * scan->numberOfKeys is the number of input keys, so->numberOfKeys gets
- * the number of output keys (possibly less, never greater).
+ * the number of output keys (possibly less, never greater).  A skip scan
+ * adds one more input key, on the first index column, ahead of the others;
+ * see _bt_skip_inkeys.
  *
  * The output keys are marked with additional sk_flags bits beyond the
  * system-standard bits supplied by the caller.  The DESC and NULLS_FIRST
@@ -2614,6 +3056,11 @@ _bt_preprocess_keys(IndexScanDesc scan)
 		keyDataMap = MemoryContextAlloc(so->arrayContext,
 										numberOfKeys * sizeof(int));
 	}
+	else if (so->skip)
+	{
+		/* Skip scans (never with arrays) add a key on the first column */
+		inkeys = _bt_skip_inkeys(scan, &numberOfKeys);
+	}
 	else
 		inkeys = scan->keyData;
 
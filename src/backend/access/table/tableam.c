@@ -344,7 +344,7 @@ simple_table_tuple_update(Relation rel, ItemPointer otid,
 	result = table_tuple_update(rel, otid, slot,
 								GetCurrentCommandId(true),
 								snapshot, InvalidSnapshot,
-								true /* wait for commit */ ,
+								true /* wait for commit */ , NULL,
 								&tmfd, &lockmode, update_indexes);
 
 	switch (result)
@@ -298,7 +298,7 @@ TransactionIdSetPageStatus(TransactionId xid, int nsubxids,
 	LWLock	   *lock;
 
 	/* Can't use group update when PGPROC overflows. */
-	StaticAssertDecl(THRESHOLD_SUBTRANS_CLOG_OPT <= PGPROC_MAX_CACHED_SUBXIDS,
+	StaticAssertDecl(THRESHOLD_SUBTRANS_CLOG_OPT <= PGPROC_MIN_CACHED_SUBXIDS,
 					 "group clog threshold less than PGPROC cached subxids");
 
 	/* Get the SLRU bank lock for the page we are going to access. */
@@ -87,6 +87,7 @@
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/spin.h"
 #include "utils/fmgrprotos.h"
 #include "utils/guc_hooks.h"
 #include "utils/memutils.h"
@@ -329,6 +330,37 @@ typedef struct mXactCacheEnt
 static dclist_head MXactCache = DCLIST_STATIC_INIT(MXactCache);
 static MemoryContext MXactContext = NULL;
 
+/*
+ * Definitions for the shared MultiXactId cache.
+ *
+ * Row-lock checks on FK-heavy workloads keep asking many backends for the
+ * members of the same few multixacts, and each such lookup has to read two
+ * SLRU pages under exclusive bank locks.  To avoid that, small multixacts
+ * are also kept in a direct-mapped shared table, slot (multi % size), with
+ * their members stored inline.  Multixacts never change once created, so an
+ * entry stays valid for as long as its multi can legitimately be looked up.
+ *
+ * RecordNewMultiXact() writes the slot for every multi it records, either
+ * with the new members or by invalidating it.  Because multis are created
+ * in sequence, each slot is rewritten at least once every multixact_cache_size
+ * multis, so an entry left over from before MultiXactId wraparound can never
+ * be returned for a reused multi.
+ */
+#define MXACT_SHARED_CACHE_MEMBERS	4
+
+typedef struct MXactSharedCacheEnt
+{
+	slock_t		mutex;			/* protects the fields below */
+	MultiXactId multi;			/* InvalidMultiXactId if unused */
+	int			nmembers;
+	MultiXactMember members[MXACT_SHARED_CACHE_MEMBERS];
+} MXactSharedCacheEnt;
+
+/* GUC variable */
+int			multixact_cache_size = 4096;
+
+static MXactSharedCacheEnt *MXactSharedCache = NULL;
+
 #ifdef MULTIXACT_DEBUG
 #define debug_elog2(a,b) elog(a,b)
 #define debug_elog3(a,b,c) elog(a,b,c)
@@ -355,6 +387,9 @@ static MultiXactId mXactCacheGetBySet(int nmembers, MultiXactMember *members);
 static int	mXactCacheGetById(MultiXactId multi, MultiXactMember **members);
 static void mXactCachePut(MultiXactId multi, int nmembers,
 						  MultiXactMember *members);
+static int	mXactSharedCacheGet(MultiXactId multi, MultiXactMember **members);
+static void mXactSharedCachePut(MultiXactId multi, int nmembers,
+								MultiXactMember *members);
 
 static char *mxstatus_to_string(MultiXactStatus status);
 
@@ -964,6 +999,8 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 
 	if (prevlock != NULL)
 		LWLockRelease(prevlock);
+
+	mXactSharedCachePut(multi, nmembers, members);
 }
 
 /*
@@ -1336,6 +1373,16 @@ GetMultiXactIdMembers(MultiXactId multi, MultiXactMember **members,
 				 errmsg("MultiXactId %u has not been created yet -- apparent wraparound",
 						multi)));
 
+	/* Now that we know it's in range, try the shared cache */
+	length = mXactSharedCacheGet(multi, members);
+	if (length >= 0)
+	{
+		mXactCachePut(multi, length, *members);
+		debug_elog3(DEBUG2, "GetMembers: found %s in the shared cache",
+					mxid_to_string(multi, length, *members));
+		return length;
+	}
+
 	/*
 	 * Find out the offset at which we need to start reading MultiXactMembers
 	 * and the number of members in the multixact.  We determine the latter as
@@ -1519,9 +1566,10 @@ retry:
 	Assert(truelength > 0);
 
 	/*
-	 * Copy the result into the local cache.
+	 * Copy the result into the local and shared caches.
 	 */
 	mXactCachePut(multi, truelength, ptr);
+	mXactSharedCachePut(multi, truelength, ptr);
 
 	debug_elog3(DEBUG2, "GetMembers: no cache for %s",
 				mxid_to_string(multi, truelength, ptr));
@@ -1701,6 +1749,72 @@ mXactCachePut(MultiXactId multi, int nmembers, MultiXactMember *members)
 	}
 }
 
+/*
+ * mXactSharedCacheGet
+ *		returns the composing MultiXactMember set from the shared cache, as
+ *		a palloc'd array that caller must free, or -1 if the multi is not
+ *		cached.
+ *
+ * The caller must have checked that multi is within the valid range.
+ */
+static int
+mXactSharedCacheGet(MultiXactId multi, MultiXactMember **members)
+{
+	MXactSharedCacheEnt *entry;
+	MultiXactMember buf[MXACT_SHARED_CACHE_MEMBERS];
+	int			nmembers = -1;
+
+	if (MXactSharedCache == NULL)
+		return -1;
+
+	entry = &MXactSharedCache[multi % multixact_cache_size];
+
+	SpinLockAcquire(&entry->mutex);
+	if (entry->multi == multi)
+	{
+		nmembers = entry->nmembers;
+		memcpy(buf, entry->members, nmembers * sizeof(MultiXactMember));
+	}
+	SpinLockRelease(&entry->mutex);
+
+	if (nmembers < 0)
+		return -1;
+
+	*members = palloc(nmembers * sizeof(MultiXactMember));
+	memcpy(*members, buf, nmembers * sizeof(MultiXactMember));
+	return nmembers;
+}
+
+/*
+ * mXactSharedCachePut
+ *		Store a MultiXactId and its members in the shared cache, or just
+ *		invalidate its slot if it has too many members to store inline.
+ *
+ * This must not fail, since RecordNewMultiXact calls it in a critical
+ * section.
+ */
+static void
+mXactSharedCachePut(MultiXactId multi, int nmembers, MultiXactMember *members)
+{
+	MXactSharedCacheEnt *entry;
+
+	if (MXactSharedCache == NULL)
+		return;
+
+	entry = &MXactSharedCache[multi % multixact_cache_size];
+
+	SpinLockAcquire(&entry->mutex);
+	if (nmembers <= MXACT_SHARED_CACHE_MEMBERS)
+	{
+		entry->multi = multi;
+		entry->nmembers = nmembers;
+		memcpy(entry->members, members, nmembers * sizeof(MultiXactMember));
+	}
+	else
+		entry->multi = InvalidMultiXactId;
+	SpinLockRelease(&entry->mutex);
+}
+
 static char *
 mxstatus_to_string(MultiXactStatus status)
 {
@@ -1907,6 +2021,8 @@ MultiXactShmemSize(void)
 	size = SHARED_MULTIXACT_STATE_SIZE;
 	size = add_size(size, SimpleLruShmemSize(multixact_offset_buffers, 0));
 	size = add_size(size, SimpleLruShmemSize(multixact_member_buffers, 0));
+	size = add_size(size, mul_size(multixact_cache_size,
+								   sizeof(MXactSharedCacheEnt)));
 
 	return size;
 }
@@ -1956,6 +2072,24 @@ MultiXactShmemInit(void)
 	 */
 	OldestMemberMXactId = MultiXactState->perBackendXactIds;
 	OldestVisibleMXactId = OldestMemberMXactId + MaxOldestSlot;
+
+	/* And the shared members cache, if enabled */
+	if (multixact_cache_size > 0)
+	{
+		MXactSharedCache = (MXactSharedCacheEnt *)
+			ShmemInitStruct("Shared MultiXact Member Cache",
+							mul_size(multixact_cache_size,
+									 sizeof(MXactSharedCacheEnt)),
+							&found);
+		if (!found)
+		{
+			for (int i = 0; i < multixact_cache_size; i++)
+			{
+				SpinLockInit(&MXactSharedCache[i].mutex);
+				MXactSharedCache[i].multi = InvalidMultiXactId;
+			}
+		}
+	}
 }
 
 /*
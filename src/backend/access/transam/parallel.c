@@ -15,6 +15,10 @@
 #include "postgres.h"
 
 #include "access/brin.h"
+#include "access/gin.h"
+#include "access/gist_private.h"
+#include "access/hash.h"
+#include "access/heapam.h"
 #include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/session.h"
@@ -25,6 +29,7 @@
 #include "catalog/pg_enum.h"
 #include "catalog/storage.h"
 #include "commands/async.h"
+#include "commands/copyfrom_internal.h"
 #include "commands/vacuum.h"
 #include "executor/execParallel.h"
 #include "libpq/libpq.h"
@@ -146,8 +151,23 @@ static const struct
 	{
 		"_brin_parallel_build_main", _brin_parallel_build_main
 	},
+	{
+		"_gin_parallel_build_main", _gin_parallel_build_main
+	},
+	{
+		"_gist_parallel_build_main", _gist_parallel_build_main
+	},
+	{
+		"_hash_parallel_build_main", _hash_parallel_build_main
+	},
 	{
 		"parallel_vacuum_main", parallel_vacuum_main
+	},
+	{
+		"ParallelCopyFromMain", ParallelCopyFromMain
+	},
+	{
+		"heapam_parallel_cluster_main", heapam_parallel_cluster_main
 	}
 };
 
@@ -553,8 +573,10 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 {
 	MemoryContext oldcontext;
 	BackgroundWorker worker;
+	BackgroundWorker *workers;
+	BackgroundWorkerHandle **handles;
+	int			nregistered;
 	int			i;
-	bool		any_registrations_failed = false;
 
 	/* Skip this if we have no workers. */
 	if (pcxt->nworkers == 0 || pcxt->nworkers_to_launch == 0)
@@ -585,19 +607,29 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	worker.bgw_notify_pid = MyProcPid;
 
 	/*
-	 * Start workers.
+	 * Start workers.  They differ only in their worker number, and are
+	 * registered all at once so that the postmaster can start them together.
 	 *
 	 * The caller must be able to tolerate ending up with fewer workers than
 	 * expected, so there is no need to throw an error here if registration
 	 * fails.  It wouldn't help much anyway, because registering the worker in
 	 * no way guarantees that it will start up and initialize successfully.
 	 */
+	workers = palloc_array(BackgroundWorker, pcxt->nworkers_to_launch);
+	handles = palloc_array(BackgroundWorkerHandle *, pcxt->nworkers_to_launch);
 	for (i = 0; i < pcxt->nworkers_to_launch; ++i)
 	{
-		memcpy(worker.bgw_extra, &i, sizeof(int));
-		if (!any_registrations_failed &&
-			RegisterDynamicBackgroundWorker(&worker,
-											&pcxt->worker[i].bgwhandle))
+		memcpy(&workers[i], &worker, sizeof(BackgroundWorker));
+		memcpy(workers[i].bgw_extra, &i, sizeof(int));
+	}
+	nregistered = RegisterDynamicBackgroundWorkers(workers,
+												   pcxt->nworkers_to_launch,
+												   handles);
+
+	for (i = 0; i < pcxt->nworkers_to_launch; ++i)
+	{
+		pcxt->worker[i].bgwhandle = handles[i];
+		if (i < nregistered)
 		{
 			shm_mq_set_handle(pcxt->worker[i].error_mqh,
 							  pcxt->worker[i].bgwhandle);
@@ -607,20 +639,19 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 		{
 			/*
 			 * If we weren't able to register the worker, then we've bumped up
-			 * against the max_worker_processes limit, and future
-			 * registrations will probably fail too, so arrange to skip them.
-			 * But we still have to execute this code for the remaining slots
-			 * to make sure that we forget about the error queues we budgeted
-			 * for those workers.  Otherwise, we'll wait for them to start,
-			 * but they never will.
+			 * against the max_worker_processes limit.  We still have to
+			 * execute this code for the remaining slots to make sure that we
+			 * forget about the error queues we budgeted for those workers.
+			 * Otherwise, we'll wait for them to start, but they never will.
 			 */
-			any_registrations_failed = true;
-			pcxt->worker[i].bgwhandle = NULL;
 			shm_mq_detach(pcxt->worker[i].error_mqh);
 			pcxt->worker[i].error_mqh = NULL;
 		}
 	}
 
+	pfree(workers);
+	pfree(handles);
+
 	/*
 	 * Now that nworkers_launched has taken its final value, we can initialize
 	 * known_attached_workers.
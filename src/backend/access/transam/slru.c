@@ -46,7 +46,10 @@
  *
  * As with the regular buffer manager, it is possible for another process
  * to re-dirty a page that is currently being written out.  This is handled
- * by re-setting the page's page_dirty flag.
+ * by re-setting the page's page_dirty flag.  Also like the regular buffer
+ * manager, the background writer writes out dirty pages that are about to
+ * be replaced, so that backends seldom have to do so while looking for a
+ * free slot; see SimpleLruWriteVictims().
  *
  *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
@@ -133,6 +136,22 @@ typedef struct SlruWriteAllData *SlruWriteAll;
  */
 #define SlotGetBankNumber(slotno)	((slotno) >> SLRU_BANK_BITSHIFT)
 
+/*
+ * Number of pages following a sequentially read page that we ask the kernel
+ * to read ahead.
+ */
+#define SLRU_READAHEAD_PAGES	8
+
+/*
+ * The SLRUs initialized in this process, for SimpleLruWriteVictims(), along
+ * with the bank at which to resume writing in each.
+ */
+#define MAX_REGISTERED_SLRUS	32
+
+static SlruCtl RegisteredSlrus[MAX_REGISTERED_SLRUS];
+static int	RegisteredSlruNextBank[MAX_REGISTERED_SLRUS];
+static int	NumRegisteredSlrus = 0;
+
 
 /*
  * Populate a file tag describing a segment file.  We only use the segment
@@ -329,7 +348,20 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 	ctl->sync_handler = sync_handler;
 	ctl->long_segment_names = long_segment_names;
 	ctl->bank_mask = (nslots / SLRU_BANK_SIZE) - 1;
+	ctl->last_read_pageno = -1;
 	strlcpy(ctl->Dir, subdir, sizeof(ctl->Dir));
+
+	/* Remember the SLRU for background writing, unless we already do */
+	for (int i = 0; i < NumRegisteredSlrus; i++)
+	{
+		if (RegisteredSlrus[i] == ctl)
+			return;
+	}
+	if (NumRegisteredSlrus < MAX_REGISTERED_SLRUS)
+	{
+		RegisteredSlruNextBank[NumRegisteredSlrus] = 0;
+		RegisteredSlrus[NumRegisteredSlrus++] = ctl;
+	}
 }
 
 /*
@@ -830,6 +862,26 @@ SlruPhysicalReadPage(SlruCtl ctl, int64 pageno, int slotno)
 	}
 	pgstat_report_wait_end();
 
+	/*
+	 * If this process seems to be reading the SLRU sequentially, as happens
+	 * for example when looking up the multixacts or subtransactions of a
+	 * range of old transactions, ask the kernel to read ahead the following
+	 * pages of the segment, so that the next misses don't have to wait for
+	 * the disk.
+	 */
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	if (pageno == ctl->last_read_pageno + 1)
+	{
+		int			npages = Min(SLRU_READAHEAD_PAGES,
+								 SLRU_PAGES_PER_SEGMENT - rpageno - 1);
+
+		if (npages > 0)
+			(void) posix_fadvise(fd, offset + BLCKSZ, (off_t) npages * BLCKSZ,
+								 POSIX_FADV_WILLNEED);
+	}
+#endif
+	ctl->last_read_pageno = pageno;
+
 	if (CloseTransientFile(fd) != 0)
 	{
 		slru_errcause = SLRU_CLOSE_FAILED;
@@ -1168,8 +1220,11 @@ SlruSelectLRUPage(SlruCtl ctl, int64 pageno)
 
 		Assert(LWLockHeldByMe(SimpleLruGetBankLock(ctl, pageno)));
 
-		/* See if page already has a buffer assigned */
-		for (int slotno = 0; slotno < shared->num_slots; slotno++)
+		/*
+		 * See if page already has a buffer assigned.  It can only be in its
+		 * own bank, so there's no need to look anywhere else.
+		 */
+		for (int slotno = bankstart; slotno < bankend; slotno++)
 		{
 			if (shared->page_status[slotno] != SLRU_PAGE_EMPTY &&
 				shared->page_number[slotno] == pageno)
@@ -1294,6 +1349,81 @@ SlruSelectLRUPage(SlruCtl ctl, int64 pageno)
 	}
 }
 
+/*
+ * Write out dirty pages that are next in line for replacement.
+ *
+ * This is called by the background writer.  For each bank of each SLRU
+ * initialized in this process, we find the page that SlruSelectLRUPage()
+ * would evict next, and write it if it's dirty.  Banks that still have a free
+ * slot are left alone, as are banks whose lock we can't get immediately,
+ * so as not to hold up backends.  We stop after writing maxpages pages, and
+ * resume at the following bank next time.  Returns the number of pages
+ * written.
+ */
+int
+SimpleLruWriteVictims(int maxpages)
+{
+	int			nwritten = 0;
+
+	for (int i = 0; i < NumRegisteredSlrus && nwritten < maxpages; i++)
+	{
+		SlruCtl		ctl = RegisteredSlrus[i];
+		SlruShared	shared = ctl->shared;
+		int			nbanks = shared->num_slots / SLRU_BANK_SIZE;
+
+		for (int n = 0; n < nbanks && nwritten < maxpages; n++)
+		{
+			int			bankno = RegisteredSlruNextBank[i];
+			int			bankstart = bankno * SLRU_BANK_SIZE;
+			int			bankend = bankstart + SLRU_BANK_SIZE;
+			LWLock	   *banklock = &shared->bank_locks[bankno].lock;
+			int64		latest_page_number;
+			int			cur_count;
+			int			victim = -1;
+			int			victim_delta = -1;
+			bool		have_free = false;
+
+			RegisteredSlruNextBank[i] = (bankno + 1) % nbanks;
+
+			if (!LWLockConditionalAcquire(banklock, LW_EXCLUSIVE))
+				continue;
+
+			cur_count = shared->bank_cur_lru_count[bankno];
+			latest_page_number = pg_atomic_read_u64(&shared->latest_page_number);
+			for (int slotno = bankstart; slotno < bankend; slotno++)
+			{
+				int			this_delta;
+
+				if (shared->page_status[slotno] == SLRU_PAGE_EMPTY)
+				{
+					have_free = true;
+					break;
+				}
+				if (shared->page_status[slotno] != SLRU_PAGE_VALID ||
+					shared->page_number[slotno] == latest_page_number)
+					continue;
+
+				this_delta = cur_count - shared->page_lru_count[slotno];
+				if (this_delta > victim_delta)
+				{
+					victim = slotno;
+					victim_delta = this_delta;
+				}
+			}
+
+			if (!have_free && victim >= 0 && shared->page_dirty[victim])
+			{
+				SlruInternalWritePage(ctl, victim, NULL);
+				nwritten++;
+			}
+
+			LWLockRelease(banklock);
+		}
+	}
+
+	return nwritten;
+}
+
 /*
  * Write dirty pages to disk during checkpoint or database shutdown.  Flushing
  * is deferred until the next call to ProcessSyncRequests(), though we do fsync
@@ -90,10 +90,12 @@
 #include "access/xlogutils.h"
 #include "catalog/pg_type.h"
 #include "catalog/storage.h"
+#include "common/hashfn.h"
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
+#include "port/pg_bitutils.h"
 #include "replication/origin.h"
 #include "replication/syncrep.h"
 #include "storage/fd.h"
@@ -111,8 +113,9 @@
  */
 #define TWOPHASE_DIR "pg_twophase"
 
-/* GUC variable, can't be changed after startup */
+/* GUC variables, can't be changed after startup */
 int			max_prepared_xacts = 0;
+int			prepared_state_cache_size = 2048;
 
 /*
  * This struct describes one global transaction that is in prepared state
@@ -147,6 +150,9 @@ int			max_prepared_xacts = 0;
 typedef struct GlobalTransactionData
 {
 	GlobalTransaction next;		/* list link for free list */
+	GlobalTransaction gidLink;	/* next entry in the same GID hash bucket */
+	GlobalTransaction xidLink;	/* next entry in the same XID hash bucket */
+	int			arrayIndex;		/* position in TwoPhaseState->prepXacts */
 	int			pgprocno;		/* ID of associated dummy PGPROC */
 	TimestampTz prepared_at;	/* time of preparation */
 
@@ -167,6 +173,14 @@ typedef struct GlobalTransactionData
 	bool		ondisk;			/* true if prepare state file is on disk */
 	bool		inredo;			/* true if entry was added via xlog_redo */
 	char		gid[GIDSIZE];	/* The GID assigned to the prepared xact */
+
+	/*
+	 * Space for a copy of the state data written at PREPARE time, so that
+	 * COMMIT PREPARED needn't read it back from WAL.  Its size is set by
+	 * prepared_state_cache_size; state_len is 0 if no copy was kept.
+	 */
+	char	   *state_data;
+	uint32		state_len;
 }			GlobalTransactionData;
 
 /*
@@ -181,6 +195,14 @@ typedef struct TwoPhaseStateData
 	/* Number of valid prepXacts entries. */
 	int			numPrepXacts;
 
+	/*
+	 * Hash buckets for finding prepXacts entries by GID and by XID, chained
+	 * through gidLink and xidLink.  numBuckets is a power of 2.
+	 */
+	int			numBuckets;
+	GlobalTransaction *gidBuckets;
+	GlobalTransaction *xidBuckets;
+
 	/* There are max_prepared_xacts items in this array */
 	GlobalTransaction prepXacts[FLEXIBLE_ARRAY_MEMBER];
 } TwoPhaseStateData;
@@ -218,7 +240,9 @@ static void RecordTransactionAbortPrepared(TransactionId xid,
 										   const char *gid);
 static void ProcessRecords(char *bufptr, TransactionId xid,
 						   const TwoPhaseCallback callbacks[]);
+static void AddGXact(GlobalTransaction gxact);
 static void RemoveGXact(GlobalTransaction gxact);
+static bool GXactGetCachedState(GlobalTransaction gxact, char **buf, int *len);
 
 static void XlogReadTwoPhaseData(XLogRecPtr lsn, char **buf, int *len);
 static char *ProcessTwoPhaseBuffer(TransactionId xid,
@@ -230,6 +254,31 @@ static void MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid,
 static void RemoveTwoPhaseFile(TransactionId xid, bool giveWarning);
 static void RecreateTwoPhaseFile(TransactionId xid, void *content, int len);
 
+/*
+ * Number of buckets of each of the GID and XID hashes
+ */
+static int
+TwoPhaseNumBuckets(void)
+{
+	return pg_nextpower2_32(Max(max_prepared_xacts, 1));
+}
+
+static inline GlobalTransaction *
+GXactGidBucket(const char *gid)
+{
+	uint32		hash = hash_bytes((const unsigned char *) gid, strlen(gid));
+
+	return &TwoPhaseState->gidBuckets[hash & (TwoPhaseState->numBuckets - 1)];
+}
+
+static inline GlobalTransaction *
+GXactXidBucket(TransactionId xid)
+{
+	uint32		hash = murmurhash32(xid);
+
+	return &TwoPhaseState->xidBuckets[hash & (TwoPhaseState->numBuckets - 1)];
+}
+
 /*
  * Initialization of shared memory
  */
@@ -245,6 +294,16 @@ TwoPhaseShmemSize(void)
 	size = MAXALIGN(size);
 	size = add_size(size, mul_size(max_prepared_xacts,
 								   sizeof(GlobalTransactionData)));
+	size = MAXALIGN(size);
+
+	/* the hash buckets */
+	size = add_size(size, mul_size(2 * TwoPhaseNumBuckets(),
+								   sizeof(GlobalTransaction)));
+	size = MAXALIGN(size);
+
+	/* and the space for copies of state data */
+	size = add_size(size, mul_size(max_prepared_xacts,
+								   MAXALIGN(prepared_state_cache_size)));
 
 	return size;
 }
@@ -260,6 +319,8 @@ TwoPhaseShmemInit(void)
 	if (!IsUnderPostmaster)
 	{
 		GlobalTransaction gxacts;
+		char	   *ptr;
+		int			nbuckets = TwoPhaseNumBuckets();
 		int			i;
 
 		Assert(!found);
@@ -273,6 +334,15 @@ TwoPhaseShmemInit(void)
 			((char *) TwoPhaseState +
 			 MAXALIGN(offsetof(TwoPhaseStateData, prepXacts) +
 					  sizeof(GlobalTransaction) * max_prepared_xacts));
+		ptr = (char *) gxacts +
+			MAXALIGN(sizeof(GlobalTransactionData) * max_prepared_xacts);
+
+		TwoPhaseState->numBuckets = nbuckets;
+		TwoPhaseState->gidBuckets = (GlobalTransaction *) ptr;
+		TwoPhaseState->xidBuckets = TwoPhaseState->gidBuckets + nbuckets;
+		MemSet(ptr, 0, 2 * nbuckets * sizeof(GlobalTransaction));
+		ptr += MAXALIGN(2 * nbuckets * sizeof(GlobalTransaction));
+
 		for (i = 0; i < max_prepared_xacts; i++)
 		{
 			/* insert into linked list */
@@ -281,6 +351,10 @@ TwoPhaseShmemInit(void)
 
 			/* associate it with a PGPROC assigned by InitProcGlobal */
 			gxacts[i].pgprocno = GetNumberFromPGProc(&PreparedXactProcs[i]);
+
+			gxacts[i].state_data = ptr;
+			gxacts[i].state_len = 0;
+			ptr += MAXALIGN(prepared_state_cache_size);
 		}
 	}
 	else
@@ -360,7 +434,6 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 				TimestampTz prepared_at, Oid owner, Oid databaseid)
 {
 	GlobalTransaction gxact;
-	int			i;
 
 	if (strlen(gid) >= GIDSIZE)
 		ereport(ERROR,
@@ -385,9 +458,8 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 	LWLockAcquire(TwoPhaseStateLock, LW_EXCLUSIVE);
 
 	/* Check for conflicting GID */
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	for (gxact = *GXactGidBucket(gid); gxact != NULL; gxact = gxact->gidLink)
 	{
-		gxact = TwoPhaseState->prepXacts[i];
 		if (strcmp(gxact->gid, gid) == 0)
 		{
 			ereport(ERROR,
@@ -412,8 +484,7 @@ MarkAsPreparing(TransactionId xid, const char *gid,
 	gxact->ondisk = false;
 
 	/* And insert it into the active array */
-	Assert(TwoPhaseState->numPrepXacts < max_prepared_xacts);
-	TwoPhaseState->prepXacts[TwoPhaseState->numPrepXacts++] = gxact;
+	AddGXact(gxact);
 
 	LWLockRelease(TwoPhaseStateLock);
 
@@ -485,6 +556,7 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	gxact->valid = false;
 	gxact->inredo = false;
 	strcpy(gxact->gid, gid);
+	gxact->state_len = 0;
 
 	/*
 	 * Remember that we have this GlobalTransaction entry locked for us. If we
@@ -507,10 +579,10 @@ GXactLoadSubxactData(GlobalTransaction gxact, int nsubxacts,
 	PGPROC	   *proc = GetPGProcByNumber(gxact->pgprocno);
 
 	/* We need no extra lock since the GXACT isn't valid yet */
-	if (nsubxacts > PGPROC_MAX_CACHED_SUBXIDS)
+	if (nsubxacts > max_cached_subxids)
 	{
 		proc->subxidStatus.overflowed = true;
-		nsubxacts = PGPROC_MAX_CACHED_SUBXIDS;
+		nsubxacts = max_cached_subxids;
 	}
 	if (nsubxacts > 0)
 	{
@@ -551,7 +623,7 @@ MarkAsPrepared(GlobalTransaction gxact, bool lock_held)
 static GlobalTransaction
 LockGXact(const char *gid, Oid user)
 {
-	int			i;
+	GlobalTransaction gxact;
 
 	/* on first call, register the exit hook */
 	if (!twophaseExitRegistered)
@@ -562,9 +634,8 @@ LockGXact(const char *gid, Oid user)
 
 	LWLockAcquire(TwoPhaseStateLock, LW_EXCLUSIVE);
 
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	for (gxact = *GXactGidBucket(gid); gxact != NULL; gxact = gxact->gidLink)
 	{
-		GlobalTransaction gxact = TwoPhaseState->prepXacts[i];
 		PGPROC	   *proc = GetPGProcByNumber(gxact->pgprocno);
 
 		/* Ignore not-yet-valid GIDs */
@@ -618,6 +689,31 @@ LockGXact(const char *gid, Oid user)
 	return NULL;
 }
 
+/*
+ * AddGXact
+ *		Add a prepared transaction, whose GID and XID must be set, to the
+ *		shared memory array and hashes.
+ */
+static void
+AddGXact(GlobalTransaction gxact)
+{
+	GlobalTransaction *bucket;
+
+	Assert(LWLockHeldByMeInMode(TwoPhaseStateLock, LW_EXCLUSIVE));
+	Assert(TwoPhaseState->numPrepXacts < max_prepared_xacts);
+
+	gxact->arrayIndex = TwoPhaseState->numPrepXacts;
+	TwoPhaseState->prepXacts[TwoPhaseState->numPrepXacts++] = gxact;
+
+	bucket = GXactGidBucket(gxact->gid);
+	gxact->gidLink = *bucket;
+	*bucket = gxact;
+
+	bucket = GXactXidBucket(gxact->xid);
+	gxact->xidLink = *bucket;
+	*bucket = gxact;
+}
+
 /*
  * RemoveGXact
  *		Remove the prepared transaction from the shared memory array.
@@ -627,27 +723,34 @@ LockGXact(const char *gid, Oid user)
 static void
 RemoveGXact(GlobalTransaction gxact)
 {
-	int			i;
+	int			i = gxact->arrayIndex;
+	GlobalTransaction *link;
 
 	Assert(LWLockHeldByMeInMode(TwoPhaseStateLock, LW_EXCLUSIVE));
 
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
-	{
-		if (gxact == TwoPhaseState->prepXacts[i])
-		{
-			/* remove from the active array */
-			TwoPhaseState->numPrepXacts--;
-			TwoPhaseState->prepXacts[i] = TwoPhaseState->prepXacts[TwoPhaseState->numPrepXacts];
-
-			/* and put it back in the freelist */
-			gxact->next = TwoPhaseState->freeGXacts;
-			TwoPhaseState->freeGXacts = gxact;
-
-			return;
-		}
-	}
-
-	elog(ERROR, "failed to find %p in GlobalTransaction array", gxact);
+	if (i < 0 || i >= TwoPhaseState->numPrepXacts ||
+		TwoPhaseState->prepXacts[i] != gxact)
+		elog(ERROR, "failed to find %p in GlobalTransaction array", gxact);
+
+	/* remove from the active array */
+	TwoPhaseState->numPrepXacts--;
+	TwoPhaseState->prepXacts[i] = TwoPhaseState->prepXacts[TwoPhaseState->numPrepXacts];
+	TwoPhaseState->prepXacts[i]->arrayIndex = i;
+
+	/* and from the hash chains */
+	for (link = GXactGidBucket(gxact->gid); *link != gxact;
+		 link = &(*link)->gidLink)
+		Assert(*link != NULL);
+	*link = gxact->gidLink;
+
+	for (link = GXactXidBucket(gxact->xid); *link != gxact;
+		 link = &(*link)->xidLink)
+		Assert(*link != NULL);
+	*link = gxact->xidLink;
+
+	/* and put it back in the freelist */
+	gxact->next = TwoPhaseState->freeGXacts;
+	TwoPhaseState->freeGXacts = gxact;
 }
 
 /*
@@ -799,8 +902,7 @@ pg_prepared_xact(PG_FUNCTION_ARGS)
 static GlobalTransaction
 TwoPhaseGetGXact(TransactionId xid, bool lock_held)
 {
-	GlobalTransaction result = NULL;
-	int			i;
+	GlobalTransaction result;
 
 	static TransactionId cached_xid = InvalidTransactionId;
 	static GlobalTransaction cached_gxact = NULL;
@@ -817,15 +919,10 @@ TwoPhaseGetGXact(TransactionId xid, bool lock_held)
 	if (!lock_held)
 		LWLockAcquire(TwoPhaseStateLock, LW_SHARED);
 
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	for (result = *GXactXidBucket(xid); result != NULL; result = result->xidLink)
 	{
-		GlobalTransaction gxact = TwoPhaseState->prepXacts[i];
-
-		if (gxact->xid == xid)
-		{
-			result = gxact;
+		if (result->xid == xid)
 			break;
-		}
 	}
 
 	if (!lock_held)
@@ -1189,6 +1286,23 @@ EndPrepare(GlobalTransaction gxact)
 				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 				 errmsg("two-phase state file maximum length exceeded")));
 
+	/*
+	 * If the state data is small enough, keep a copy of it in the gxact, so
+	 * that COMMIT PREPARED won't have to read it back from WAL.  Nobody else
+	 * looks at the copy before we mark the gxact valid.
+	 */
+	if (records.total_len <= prepared_state_cache_size)
+	{
+		char	   *ptr = gxact->state_data;
+
+		for (record = records.head; record != NULL; record = record->next)
+		{
+			memcpy(ptr, record->data, record->len);
+			ptr += record->len;
+		}
+		gxact->state_len = records.total_len;
+	}
+
 	/*
 	 * Now writing 2PC state data to WAL. We let the WAL's CRC protection
 	 * cover us, so no need to calculate a separate CRC.
@@ -1529,12 +1643,16 @@ FinishPreparedTransaction(const char *gid, bool isCommit)
 	/*
 	 * Read and validate 2PC state data. State data will typically be stored
 	 * in WAL files if the LSN is after the last checkpoint record, or moved
-	 * to disk if for some reason they have lived for a long time.
+	 * to disk if for some reason they have lived for a long time.  But if
+	 * EndPrepare kept a copy in shared memory, we needn't read either.
 	 */
-	if (gxact->ondisk)
-		buf = ReadTwoPhaseFile(xid, false);
-	else
-		XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, NULL);
+	if (!GXactGetCachedState(gxact, &buf, NULL))
+	{
+		if (gxact->ondisk)
+			buf = ReadTwoPhaseFile(xid, false);
+		else
+			XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, NULL);
+	}
 
 
 	/*
@@ -1682,6 +1800,26 @@ FinishPreparedTransaction(const char *gid, bool isCommit)
 	pfree(buf);
 }
 
+/*
+ * If a copy of the prepared transaction's state data is kept in shared memory,
+ * return it in a palloc'd buffer and its length in *len, if len isn't NULL.
+ *
+ * Caller must either hold TwoPhaseStateLock or have the gxact locked.
+ */
+static bool
+GXactGetCachedState(GlobalTransaction gxact, char **buf, int *len)
+{
+	if (gxact->state_len == 0)
+		return false;
+
+	*buf = palloc(gxact->state_len);
+	memcpy(*buf, gxact->state_data, gxact->state_len);
+	if (len != NULL)
+		*len = gxact->state_len;
+
+	return true;
+}
+
 /*
  * Scan 2PC state data in memory and call the indicated callbacks for each 2PC record.
  */
@@ -1855,7 +1993,8 @@ CheckPointTwoPhase(XLogRecPtr redo_horizon)
 			char	   *buf;
 			int			len;
 
-			XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, &len);
+			if (!GXactGetCachedState(gxact, &buf, &len))
+				XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, &len);
 			RecreateTwoPhaseFile(gxact->xid, buf, len);
 			gxact->ondisk = true;
 			gxact->prepare_start_lsn = InvalidXLogRecPtr;
@@ -2554,10 +2693,10 @@ PrepareRedoAdd(char *buf, XLogRecPtr start_lsn,
 	gxact->ondisk = XLogRecPtrIsInvalid(start_lsn);
 	gxact->inredo = true;		/* yes, added in redo */
 	strcpy(gxact->gid, gid);
+	gxact->state_len = 0;
 
 	/* And insert it into the active array */
-	Assert(TwoPhaseState->numPrepXacts < max_prepared_xacts);
-	TwoPhaseState->prepXacts[TwoPhaseState->numPrepXacts++] = gxact;
+	AddGXact(gxact);
 
 	if (origin_id != InvalidRepOriginId)
 	{
@@ -2581,17 +2720,14 @@ PrepareRedoAdd(char *buf, XLogRecPtr start_lsn,
 void
 PrepareRedoRemove(TransactionId xid, bool giveWarning)
 {
-	GlobalTransaction gxact = NULL;
-	int			i;
+	GlobalTransaction gxact;
 	bool		found = false;
 
 	Assert(LWLockHeldByMeInMode(TwoPhaseStateLock, LW_EXCLUSIVE));
 	Assert(RecoveryInProgress());
 
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	for (gxact = *GXactXidBucket(xid); gxact != NULL; gxact = gxact->xidLink)
 	{
-		gxact = TwoPhaseState->prepXacts[i];
-
 		if (gxact->xid == xid)
 		{
 			Assert(gxact->inredo);
@@ -2634,14 +2770,12 @@ bool
 LookupGXact(const char *gid, XLogRecPtr prepare_end_lsn,
 			TimestampTz origin_prepare_timestamp)
 {
-	int			i;
+	GlobalTransaction gxact;
 	bool		found = false;
 
 	LWLockAcquire(TwoPhaseStateLock, LW_SHARED);
-	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	for (gxact = *GXactGidBucket(gid); gxact != NULL; gxact = gxact->gidLink)
 	{
-		GlobalTransaction gxact = TwoPhaseState->prepXacts[i];
-
 		/* Ignore not-yet-valid GIDs. */
 		if (gxact->valid && strcmp(gxact->gid, gid) == 0)
 		{
@@ -2658,12 +2792,15 @@ LookupGXact(const char *gid, XLogRecPtr prepare_end_lsn,
 			 * do this optimization if we encounter many collisions in GID
 			 * between publisher and subscriber.
 			 */
-			if (gxact->ondisk)
-				buf = ReadTwoPhaseFile(gxact->xid, false);
-			else
+			if (!GXactGetCachedState(gxact, &buf, NULL))
 			{
-				Assert(gxact->prepare_start_lsn);
-				XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, NULL);
+				if (gxact->ondisk)
+					buf = ReadTwoPhaseFile(gxact->xid, false);
+				else
+				{
+					Assert(gxact->prepare_start_lsn);
+					XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, NULL);
+				}
 			}
 
 			hdr = (TwoPhaseFileHeader *) buf;
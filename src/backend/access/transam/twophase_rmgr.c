@@ -16,6 +16,7 @@
 
 #include "access/multixact.h"
 #include "access/twophase_rmgr.h"
+#include "executor/execQueryCache.h"
 #include "pgstat.h"
 #include "storage/lock.h"
 #include "storage/predicate.h"
@@ -27,7 +28,8 @@ const TwoPhaseCallback twophase_recover_callbacks[TWOPHASE_RM_MAX_ID + 1] =
 	lock_twophase_recover,		/* Lock */
 	NULL,						/* pgstat */
 	multixact_twophase_recover, /* MultiXact */
-	predicatelock_twophase_recover	/* PredicateLock */
+	predicatelock_twophase_recover,	/* PredicateLock */
+	querycache_twophase_recover /* QueryCache */
 };
 
 const TwoPhaseCallback twophase_postcommit_callbacks[TWOPHASE_RM_MAX_ID + 1] =
@@ -36,7 +38,8 @@ const TwoPhaseCallback twophase_postcommit_callbacks[TWOPHASE_RM_MAX_ID + 1] =
 	lock_twophase_postcommit,	/* Lock */
 	pgstat_twophase_postcommit, /* pgstat */
 	multixact_twophase_postcommit,	/* MultiXact */
-	NULL						/* PredicateLock */
+	NULL,						/* PredicateLock */
+	querycache_twophase_postcommit	/* QueryCache */
 };
 
 const TwoPhaseCallback twophase_postabort_callbacks[TWOPHASE_RM_MAX_ID + 1] =
@@ -45,7 +48,8 @@ const TwoPhaseCallback twophase_postabort_callbacks[TWOPHASE_RM_MAX_ID + 1] =
 	lock_twophase_postabort,	/* Lock */
 	pgstat_twophase_postabort,	/* pgstat */
 	multixact_twophase_postabort,	/* MultiXact */
-	NULL						/* PredicateLock */
+	NULL,						/* PredicateLock */
+	querycache_twophase_postabort	/* QueryCache */
 };
 
 const TwoPhaseCallback twophase_standby_recover_callbacks[TWOPHASE_RM_MAX_ID + 1] =
@@ -54,5 +58,6 @@ const TwoPhaseCallback twophase_standby_recover_callbacks[TWOPHASE_RM_MAX_ID + 1
 	lock_twophase_standby_recover,	/* Lock */
 	NULL,						/* pgstat */
 	NULL,						/* MultiXact */
-	NULL						/* PredicateLock */
+	NULL,						/* PredicateLock */
+	NULL						/* QueryCache */
 };
@@ -21,6 +21,7 @@
 #include "access/xlogutils.h"
 #include "commands/dbcommands.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
@@ -78,6 +79,7 @@ GetNewTransactionId(bool isSubXact)
 {
 	FullTransactionId full_xid;
 	TransactionId xid;
+	bool		overflowed = false;
 
 	/*
 	 * Workers synchronize transaction state at the beginning of each parallel
@@ -266,18 +268,25 @@ GetNewTransactionId(bool isSubXact)
 		Assert(substat->count == MyProc->subxidStatus.count);
 		Assert(substat->overflowed == MyProc->subxidStatus.overflowed);
 
-		if (nxids < PGPROC_MAX_CACHED_SUBXIDS)
+		if (nxids < max_cached_subxids)
 		{
 			MyProc->subxids.xids[nxids] = xid;
 			pg_write_barrier();
 			MyProc->subxidStatus.count = substat->count = nxids + 1;
 		}
-		else
+		else if (!MyProc->subxidStatus.overflowed)
+		{
 			MyProc->subxidStatus.overflowed = substat->overflowed = true;
+			overflowed = true;
+		}
 	}
 
 	LWLockRelease(XidGenLock);
 
+	/* count each transaction whose cache overflows once */
+	if (overflowed)
+		pgstat_report_subxid_overflow();
+
 	return full_xid;
 }
 
@@ -83,7 +83,9 @@
 #include "replication/snapbuild.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/large_object.h"
@@ -115,6 +117,7 @@ int			max_wal_size_mb = 1024; /* 1 GB */
 int			min_wal_size_mb = 80;	/* 80 MB */
 int			wal_keep_size_mb = 0;
 int			XLOGbuffers = -1;
+int			wal_write_concurrency = 1;
 int			XLogArchiveTimeout = 0;
 int			XLogArchiveMode = ARCHIVE_MODE_OFF;
 char	   *XLogArchiveCommand = NULL;
@@ -126,6 +129,7 @@ char	   *wal_consistency_checking_string = NULL;
 bool	   *wal_consistency_checking = NULL;
 bool		wal_init_zero = true;
 bool		wal_recycle = true;
+bool		wal_writer_group_commit = false;
 bool		log_checkpoints = true;
 int			wal_sync_method = DEFAULT_WAL_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_REPLICA;
@@ -143,11 +147,12 @@ bool		XLOG_DEBUG = false;
 int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 
 /*
- * Number of WAL insertion locks to use. A higher value allows more insertions
- * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * Number of WAL insertion locks to use (wal_insert_locks). A higher value
+ * allows more insertions to happen concurrently, but adds some CPU overhead
+ * to flushing the WAL, which needs to iterate all the locks.  -1 means to
+ * choose a value based on the number of CPUs, see XLOGChooseNumInsertLocks.
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			XLOGinsertLocks = -1;
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -527,6 +532,14 @@ typedef struct XLogCtlData
 	 */
 	bool		WalWriterSleeping;
 
+	/*
+	 * WAL-writer-driven group commit, see XLogGroupFlush().  groupFlushRqst
+	 * is the highest position that a committing backend has asked the WAL
+	 * writer to flush; groupFlushCV is broadcast whenever it has flushed.
+	 */
+	pg_atomic_uint64 groupFlushRqst;
+	ConditionVariable groupFlushCV;
+
 	/*
 	 * During recovery, we keep a copy of the latest checkpoint record here.
 	 * lastCheckPointRecPtr points to start of checkpoint record and
@@ -646,6 +659,12 @@ static bool updateMinRecoveryPoint = true;
 static int	MyLockNo = 0;
 static bool holdingAllLocks = false;
 
+/*
+ * If valid, the furthest position we may advertise as inserted up to, while
+ * CopyXLogRecordToWAL() has not filled in the record's CRC yet.
+ */
+static XLogRecPtr insertingAtLimit = InvalidXLogRecPtr;
+
 #ifdef WAL_DEBUG
 static MemoryContext walDebugCxt = NULL;
 #endif
@@ -667,6 +686,8 @@ static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 static void AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli,
 								  bool opportunistic);
 static void XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible);
+static void XLogWriteConcurrently(char *from, Size nbytes, uint32 startoffset,
+								  TimeLineID tli);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
 								   bool find_free, XLogSegNo max_segno,
 								   TimeLineID tli);
@@ -694,7 +715,11 @@ static int	get_sync_bit(int method);
 static void CopyXLogRecordToWAL(int write_len, bool isLogSwitch,
 								XLogRecData *rdata,
 								XLogRecPtr StartPos, XLogRecPtr EndPos,
-								TimeLineID tli);
+								TimeLineID tli, bool crc_pending);
+static inline void CopyXLogRecordBytes(char *dest, const char *src, int len,
+									   int offset, pg_crc32c *crc,
+									   char **crcdest);
+static pg_crc32c XLogRecordDataCRC(XLogRecData *rdata);
 static void ReserveXLogInsertLocation(int size, XLogRecPtr *StartPos,
 									  XLogRecPtr *EndPos, XLogRecPtr *PrevPtr);
 static bool ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos,
@@ -731,7 +756,9 @@ static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
  * The first XLogRecData in the chain must be for the record header, and its
  * data must be MAXALIGNed.  XLogInsertRecord fills in the xl_prev and
  * xl_crc fields in the header, the rest of the header must already be filled
- * by the caller.
+ * by the caller.  Normally xl_crc must already contain the CRC of the record
+ * data following the header; with 'crc_pending', that is calculated here,
+ * preferably while the data is being copied into the WAL buffers.
  *
  * Returns XLOG pointer to end of record (beginning of next record).
  * This can be used as LSN for data pages affected by the logged action.
@@ -744,7 +771,8 @@ XLogInsertRecord(XLogRecData *rdata,
 				 XLogRecPtr fpw_lsn,
 				 uint8 flags,
 				 int num_fpi,
-				 bool topxid_included)
+				 bool topxid_included,
+				 bool crc_pending)
 {
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	pg_crc32c	rdata_crc;
@@ -797,7 +825,7 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
 	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * determined by wal_insert_locks. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -902,13 +930,34 @@ XLogInsertRecord(XLogRecData *rdata,
 	if (inserted)
 	{
 		/*
-		 * Now that xl_prev has been filled in, calculate CRC of the record
-		 * header.
+		 * If the CRC of the record data is still to be calculated, we'd like
+		 * to do that while copying the data, so that it only has to be read
+		 * once.  That means the header is written before its CRC is known, so
+		 * nobody must be allowed to write out the WAL from StartPos onwards
+		 * until we are done; see GetXLogBuffer().  We cannot hold that off
+		 * if we need to recycle a WAL buffer within our own record to make
+		 * room for the rest of it, so calculate the CRC up front for records
+		 * that might not fit in the WAL buffers.
 		 */
-		rdata_crc = rechdr->xl_crc;
-		COMP_CRC32C(rdata_crc, rechdr, offsetof(XLogRecord, xl_crc));
-		FIN_CRC32C(rdata_crc);
-		rechdr->xl_crc = rdata_crc;
+		if (crc_pending &&
+			(class != WALINSERT_NORMAL ||
+			 EndPos / XLOG_BLCKSZ - StartPos / XLOG_BLCKSZ >= XLOGbuffers - 1))
+		{
+			rechdr->xl_crc = XLogRecordDataCRC(rdata);
+			crc_pending = false;
+		}
+
+		if (!crc_pending)
+		{
+			/*
+			 * Now that xl_prev has been filled in, calculate CRC of the
+			 * record header.
+			 */
+			rdata_crc = rechdr->xl_crc;
+			COMP_CRC32C(rdata_crc, rechdr, offsetof(XLogRecord, xl_crc));
+			FIN_CRC32C(rdata_crc);
+			rechdr->xl_crc = rdata_crc;
+		}
 
 		/*
 		 * All the record data, including the header, is now ready to be
@@ -916,7 +965,7 @@ XLogInsertRecord(XLogRecData *rdata,
 		 */
 		CopyXLogRecordToWAL(rechdr->xl_tot_len,
 							class == WALINSERT_SPECIAL_SWITCH, rdata,
-							StartPos, EndPos, insertTLI);
+							StartPos, EndPos, insertTLI, crc_pending);
 
 		/*
 		 * Unless record is flagged as not important, update LSN of last
@@ -1215,16 +1264,36 @@ ReserveXLogSwitch(XLogRecPtr *StartPos, XLogRecPtr *EndPos, XLogRecPtr *PrevPtr)
 /*
  * Subroutine of XLogInsertRecord.  Copies a WAL record to an already-reserved
  * area in the WAL.
+ *
+ * If crc_pending is true, xl_crc has not been calculated yet.  We calculate
+ * it from the data as we copy it, and store it into the header, both in the
+ * caller's copy and in the WAL buffer, once we're done.
  */
 static void
 CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
-					XLogRecPtr StartPos, XLogRecPtr EndPos, TimeLineID tli)
+					XLogRecPtr StartPos, XLogRecPtr EndPos, TimeLineID tli,
+					bool crc_pending)
 {
 	char	   *currpos;
 	int			freespace;
 	int			written;
 	XLogRecPtr	CurrPos;
 	XLogPageHeader pagehdr;
+	XLogRecord *rechdr = (XLogRecord *) rdata->data;
+	pg_crc32c	rdata_crc;
+	pg_crc32c  *crc = NULL;
+	char	   *crcdest = NULL;
+
+	/*
+	 * Until the CRC is in place, don't let anyone write out the page the
+	 * record starts on, or any later one.
+	 */
+	if (crc_pending)
+	{
+		INIT_CRC32C(rdata_crc);
+		crc = &rdata_crc;
+		insertingAtLimit = StartPos - StartPos % XLOG_BLCKSZ;
+	}
 
 	/*
 	 * Get a pointer to the right place in the right WAL buffer to start
@@ -1253,7 +1322,8 @@ CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
 			 * Write what fits on this page, and continue on the next page.
 			 */
 			Assert(CurrPos % XLOG_BLCKSZ >= SizeOfXLogShortPHD || freespace == 0);
-			memcpy(currpos, rdata_data, freespace);
+			CopyXLogRecordBytes(currpos, rdata_data, freespace, written,
+								crc, &crcdest);
 			rdata_data += freespace;
 			rdata_len -= freespace;
 			written += freespace;
@@ -1288,7 +1358,8 @@ CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
 		}
 
 		Assert(CurrPos % XLOG_BLCKSZ >= SizeOfXLogShortPHD || rdata_len == 0);
-		memcpy(currpos, rdata_data, rdata_len);
+		CopyXLogRecordBytes(currpos, rdata_data, rdata_len, written,
+							crc, &crcdest);
 		currpos += rdata_len;
 		CurrPos += rdata_len;
 		freespace -= rdata_len;
@@ -1298,6 +1369,18 @@ CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
 	}
 	Assert(written == write_len);
 
+	if (crc_pending)
+	{
+		/* Finish the CRC with the header, and fill it in */
+		COMP_CRC32C(rdata_crc, rechdr, offsetof(XLogRecord, xl_crc));
+		FIN_CRC32C(rdata_crc);
+		rechdr->xl_crc = rdata_crc;
+		Assert(crcdest != NULL);
+		memcpy(crcdest, &rdata_crc, sizeof(pg_crc32c));
+
+		insertingAtLimit = InvalidXLogRecPtr;
+	}
+
 	/*
 	 * If this was an xlog-switch, it's not enough to write the switch record,
 	 * we also have to consume all the remaining space in the WAL segment.  We
@@ -1359,6 +1442,63 @@ CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
 				errmsg_internal("space reserved for WAL record does not match what was written"));
 }
 
+/*
+ * Subroutine of CopyXLogRecordToWAL.  Copies 'len' bytes of record data,
+ * found at 'offset' from the beginning of the record, to 'dest'.
+ *
+ * If 'crc' is not NULL, the copied bytes are also added to it, except for
+ * those of the fixed-size record header, and *crcdest is set to point to
+ * where xl_crc lands in the WAL buffers.  The CRC is calculated from the
+ * source just before copying it, so that it is read from memory once.
+ */
+static inline void
+CopyXLogRecordBytes(char *dest, const char *src, int len, int offset,
+					pg_crc32c *crc, char **crcdest)
+{
+	if (crc != NULL)
+	{
+		if (offset < SizeOfXLogRecord)
+		{
+			int			skip = Min(len, SizeOfXLogRecord - offset);
+
+			/*
+			 * The record starts MAXALIGNed and pages end MAXALIGNed, so
+			 * xl_crc is never split across pages.
+			 */
+			if (offset <= offsetof(XLogRecord, xl_crc) &&
+				offsetof(XLogRecord, xl_crc) < offset + len)
+			{
+				Assert(offsetof(XLogRecord, xl_crc) + sizeof(pg_crc32c) <=
+					   offset + len);
+				*crcdest = dest + (offsetof(XLogRecord, xl_crc) - offset);
+			}
+			COMP_CRC32C(*crc, src + skip, len - skip);
+		}
+		else
+			COMP_CRC32C(*crc, src, len);
+	}
+
+	memcpy(dest, src, len);
+}
+
+/*
+ * Calculate the CRC of the data of a WAL record, excluding the fixed-size
+ * record header, as XLogRecordAssemble() would.
+ */
+static pg_crc32c
+XLogRecordDataCRC(XLogRecData *rdata)
+{
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, rdata->data + SizeOfXLogRecord,
+				rdata->len - SizeOfXLogRecord);
+	for (rdata = rdata->next; rdata != NULL; rdata = rdata->next)
+		COMP_CRC32C(crc, rdata->data, rdata->len);
+
+	return crc;
+}
+
 /*
  * Acquire a WAL insertion lock, for inserting to WAL.
  */
@@ -1381,7 +1521,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProcNumber % NUM_XLOGINSERT_LOCKS;
+		lockToTry = MyProcNumber % XLOGinsertLocks;
 	MyLockNo = lockToTry;
 
 	/*
@@ -1399,7 +1539,7 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % XLOGinsertLocks;
 	}
 }
 
@@ -1417,7 +1557,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < XLOGinsertLocks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1443,7 +1583,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < XLOGinsertLocks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1471,8 +1611,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[XLOGinsertLocks - 1].l.lock,
+						&WALInsertLocks[XLOGinsertLocks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1548,7 +1688,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < XLOGinsertLocks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1694,6 +1834,10 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 		else
 			initializedUpto = ptr;
 
+		if (insertingAtLimit != InvalidXLogRecPtr &&
+			initializedUpto > insertingAtLimit)
+			initializedUpto = insertingAtLimit;
+
 		WALInsertLockUpdateInsertingAt(initializedUpto);
 
 		AdvanceXLInsertBuffer(ptr, tli, false);
@@ -2426,7 +2570,16 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 			from = XLogCtl->pages + startidx * (Size) XLOG_BLCKSZ;
 			nbytes = npages * (Size) XLOG_BLCKSZ;
 			nleft = nbytes;
-			do
+
+			/* Split larger writes into concurrent I/Os, if enabled */
+			if (wal_write_concurrency > 1 && npages > 1 && pgaio_enabled())
+			{
+				XLogWriteConcurrently(from, nbytes, startoffset, tli);
+				startoffset += nbytes;
+				nleft = 0;
+			}
+
+			while (nleft > 0)
 			{
 				errno = 0;
 
@@ -2474,7 +2627,7 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 				nleft -= written;
 				from += written;
 				startoffset += written;
-			} while (nleft > 0);
+			}
 
 			npages = 0;
 
@@ -2617,6 +2770,133 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 #endif
 }
 
+/*
+ * Write out nbytes of WAL from "from" to the open log file at startoffset,
+ * as up to wal_write_concurrency asynchronous writes that are in flight at
+ * the same time.  On storage that can service several requests in parallel,
+ * such as striped or network block devices, this finishes a large write (or,
+ * with an O_DSYNC wal_sync_method, a large write and its flush) sooner than
+ * one pg_pwrite() would.  Returns once everything has been written; errors
+ * are reported with PANIC, just like in XLogWrite.
+ *
+ * Each write covers a run of whole pages.  Any part of a write that could
+ * not be submitted, or that the kernel completed only partially, is finished
+ * synchronously.
+ */
+static void
+XLogWriteConcurrently(char *from, Size nbytes, uint32 startoffset,
+					  TimeLineID tli)
+{
+	int			handles[PGAIO_MAX_IN_FLIGHT];
+	Size		chunk_len[PGAIO_MAX_IN_FLIGHT];
+	int			nchunks;
+	int			npages = nbytes / XLOG_BLCKSZ;
+	int			pages_per_chunk;
+	instr_time	start;
+
+	nchunks = Min(Min(wal_write_concurrency, PGAIO_MAX_IN_FLIGHT), npages);
+	pages_per_chunk = (npages + nchunks - 1) / nchunks;
+	nchunks = (npages + pages_per_chunk - 1) / pages_per_chunk;
+
+	if (track_wal_io_timing)
+		INSTR_TIME_SET_CURRENT(start);
+	else
+		INSTR_TIME_SET_ZERO(start);
+
+	/* Start them all */
+	for (int i = 0; i < nchunks; i++)
+	{
+		Size		offset = (Size) i * pages_per_chunk * XLOG_BLCKSZ;
+		struct iovec iov;
+
+		chunk_len[i] = Min((Size) pages_per_chunk * XLOG_BLCKSZ,
+						   nbytes - offset);
+		iov.iov_base = from + offset;
+		iov.iov_len = chunk_len[i];
+
+		handles[i] = pgaio_acquire();
+		if (handles[i] >= 0 &&
+			!pgaio_start_writev(handles[i], openLogFile, &iov, 1,
+								startoffset + offset))
+		{
+			pgaio_release(handles[i]);
+			handles[i] = -1;
+		}
+	}
+
+	/* Collect the results, completing any leftovers synchronously */
+	for (int i = 0; i < nchunks; i++)
+	{
+		Size		offset = (Size) i * pages_per_chunk * XLOG_BLCKSZ;
+		Size		done = 0;
+
+		if (handles[i] >= 0)
+		{
+			ssize_t		result;
+
+			result = pgaio_wait_for(handles[i], WAIT_EVENT_WAL_WRITE);
+			if (result < 0)
+			{
+				char		xlogfname[MAXFNAMELEN];
+
+				XLogFileName(xlogfname, tli, openLogSegNo, wal_segment_size);
+				errno = -result;
+				ereport(PANIC,
+						(errcode_for_file_access(),
+						 errmsg("could not write to log file \"%s\" at offset %u, length %zu: %m",
+								xlogfname, (uint32) (startoffset + offset),
+								chunk_len[i])));
+			}
+			done = result;
+		}
+
+		while (done < chunk_len[i])
+		{
+			ssize_t		written;
+
+			errno = 0;
+			pgstat_report_wait_start(WAIT_EVENT_WAL_WRITE);
+			written = pg_pwrite(openLogFile, from + offset + done,
+								chunk_len[i] - done,
+								startoffset + offset + done);
+			pgstat_report_wait_end();
+
+			if (written <= 0)
+			{
+				char		xlogfname[MAXFNAMELEN];
+				int			save_errno;
+
+				if (errno == EINTR)
+					continue;
+
+				save_errno = errno;
+				XLogFileName(xlogfname, tli, openLogSegNo, wal_segment_size);
+				errno = save_errno;
+				ereport(PANIC,
+						(errcode_for_file_access(),
+						 errmsg("could not write to log file \"%s\" at offset %u, length %zu: %m",
+								xlogfname, (uint32) (startoffset + offset + done),
+								chunk_len[i] - done)));
+			}
+			done += written;
+		}
+	}
+
+	/*
+	 * Count each write separately in pg_stat_wal, but the elapsed time only
+	 * once, since the writes overlapped.
+	 */
+	if (track_wal_io_timing)
+	{
+		instr_time	end;
+
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(PendingWalStats.wal_write_time, end, start);
+	}
+
+	PendingWalStats.wal_write += nchunks;
+}
+
 /*
  * Record the LSN for an asynchronous transaction commit/abort
  * and nudge the WALWriter if there is work for it to do.
@@ -2951,6 +3231,88 @@ XLogFlush(XLogRecPtr record)
 			 LSN_FORMAT_ARGS(LogwrtResult.Flush));
 }
 
+/*
+ * Ensure that all XLOG data through the given position is flushed to disk,
+ * for a transaction commit.
+ *
+ * With wal_writer_group_commit, the flush is left to the WAL writer: we
+ * advertise the position we need, wake the WAL writer, and sleep until it
+ * reports having flushed far enough (see XLogGroupFlushServe()).  Backends
+ * committing concurrently thus share one flush without convoying on
+ * WALWriteLock, and the WAL writer flushes again as soon as it is done if
+ * more commits arrived meanwhile, so that batches grow with the commit rate.
+ *
+ * If the WAL writer doesn't get to it within XLOG_GROUP_FLUSH_TIMEOUT, for
+ * example because it is not running, we flush by ourselves.
+ */
+#define XLOG_GROUP_FLUSH_TIMEOUT	100 /* ms */
+
+void
+XLogGroupFlush(XLogRecPtr record)
+{
+	Latch	   *walwriterLatch = ProcGlobal->walwriterLatch;
+
+	if (!wal_writer_group_commit || walwriterLatch == NULL ||
+		AmWalWriterProcess() || !XLogInsertAllowed())
+	{
+		XLogFlush(record);
+		return;
+	}
+
+	/* Quick exit if already known flushed */
+	RefreshXLogWriteResult(LogwrtResult);
+	if (record <= LogwrtResult.Flush)
+		return;
+
+	pg_atomic_monotonic_advance_u64(&XLogCtl->groupFlushRqst, record);
+	SetLatch(walwriterLatch);
+
+	ConditionVariablePrepareToSleep(&XLogCtl->groupFlushCV);
+	for (;;)
+	{
+		RefreshXLogWriteResult(LogwrtResult);
+		if (record <= LogwrtResult.Flush)
+			break;
+		if (ConditionVariableTimedSleep(&XLogCtl->groupFlushCV,
+										XLOG_GROUP_FLUSH_TIMEOUT,
+										WAIT_EVENT_WAL_GROUP_FLUSH))
+			break;
+	}
+	ConditionVariableCancelSleep();
+
+	/* Fall back to flushing by ourselves if we timed out */
+	if (record > LogwrtResult.Flush)
+		XLogFlush(record);
+}
+
+/*
+ * Flush the WAL for backends waiting in XLogGroupFlush().
+ *
+ * This is invoked by the WAL writer whenever its latch is set.  Returns true
+ * if there was anything to flush; the caller should then call us again
+ * without sleeping, to serve any commits that queued up during the flush.
+ */
+bool
+XLogGroupFlushServe(void)
+{
+	XLogRecPtr	rqst;
+
+	if (RecoveryInProgress())
+		return false;
+
+	rqst = pg_atomic_read_u64(&XLogCtl->groupFlushRqst);
+	RefreshXLogWriteResult(LogwrtResult);
+	if (rqst <= LogwrtResult.Flush)
+		return false;
+
+	/* This writes and flushes everything inserted so far, not just rqst */
+	XLogFlush(rqst);
+
+	ConditionVariableBroadcast(&XLogCtl->groupFlushCV);
+
+	return true;
+}
+
 /*
  * Write & flush xlog, but without specifying exactly where to.
  *
@@ -4632,6 +4994,57 @@ check_wal_buffers(int *newval, void **extra, GucSource source)
 	return true;
 }
 
+/*
+ * Auto-tune the number of WAL insertion locks.
+ *
+ * We use one lock per four CPUs, but never fewer than 8, which was the
+ * hard-wired number before this became configurable, nor more than 64.
+ * Beyond that point, the cost of WaitXLogInsertionsToFinish visiting every
+ * lock tends to outweigh what is gained on the insertion side.
+ */
+static int
+XLOGChooseNumInsertLocks(void)
+{
+	int			nlocks = 8;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	long		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus > 0)
+		nlocks = Max(nlocks, (int) Min(ncpus / 4, 64));
+#endif
+
+	return nlocks;
+}
+
+/*
+ * GUC check_hook for wal_insert_locks
+ */
+bool
+check_wal_insert_locks(int *newval, void **extra, GucSource source)
+{
+	/*
+	 * -1 indicates a request for auto-tune.  As for wal_buffers, leave the
+	 * boot_val alone until XLOGShmemSize is called.
+	 */
+	if (*newval == -1)
+	{
+		if (XLOGinsertLocks == -1)
+			return true;
+
+		*newval = XLOGChooseNumInsertLocks();
+	}
+
+	if (*newval == 0)
+	{
+		GUC_check_errdetail("\"%s\" must be -1 or at least 1.",
+							"wal_insert_locks");
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * GUC check_hook for wal_consistency_checking
  */
@@ -4860,11 +5273,25 @@ XLOGShmemSize(void)
 	}
 	Assert(XLOGbuffers > 0);
 
+	/* Likewise for wal_insert_locks */
+	if (XLOGinsertLocks == -1)
+	{
+		char		buf[32];
+
+		snprintf(buf, sizeof(buf), "%d", XLOGChooseNumInsertLocks());
+		SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER,
+						PGC_S_DYNAMIC_DEFAULT);
+		if (XLOGinsertLocks == -1)	/* failed to apply it? */
+			SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER,
+							PGC_S_OVERRIDE);
+	}
+	Assert(XLOGinsertLocks > 0);
+
 	/* XLogCtl */
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), XLOGinsertLocks + 1));
 	/* xlblocks array */
 	size = add_size(size, mul_size(sizeof(pg_atomic_uint64), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
@@ -4957,9 +5384,9 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * XLOGinsertLocks;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < XLOGinsertLocks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
 		pg_atomic_init_u64(&WALInsertLocks[i].l.insertingAt, InvalidXLogRecPtr);
@@ -4973,6 +5400,7 @@ XLOGShmemInit(void)
 	 */
 	allocptr = (char *) TYPEALIGN(XLOG_BLCKSZ, allocptr);
 	XLogCtl->pages = allocptr;
+	ShmemNumaInterleave(XLogCtl->pages, (Size) XLOG_BLCKSZ * XLOGbuffers);
 	memset(XLogCtl->pages, 0, (Size) XLOG_BLCKSZ * XLOGbuffers);
 
 	/*
@@ -4983,6 +5411,8 @@ XLOGShmemInit(void)
 	XLogCtl->SharedRecoveryState = RECOVERY_STATE_CRASH;
 	XLogCtl->InstallXLogFileSegmentActive = false;
 	XLogCtl->WalWriterSleeping = false;
+	pg_atomic_init_u64(&XLogCtl->groupFlushRqst, InvalidXLogRecPtr);
+	ConditionVariableInit(&XLogCtl->groupFlushCV);
 
 	SpinLockInit(&XLogCtl->Insert.insertpos_lck);
 	SpinLockInit(&XLogCtl->info_lck);
@@ -6495,7 +6925,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < XLOGinsertLocks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -134,10 +134,20 @@ static bool begininsert_called = false;
 /* Memory context to hold the registered buffer and data references. */
 static MemoryContext xloginsert_cxt;
 
+#ifdef USE_ZSTD
+/*
+ * zstd compression context for full-page images, created on first use and
+ * kept for the life of the process.  ZSTD_compress() would set up and tear
+ * down a context, including its sizable workspace, for every single image.
+ */
+static ZSTD_CCtx *zstd_fpi_cctx = NULL;
+#endif
+
 static XLogRecData *XLogRecordAssemble(RmgrId rmid, uint8 info,
 									   XLogRecPtr RedoRecPtr, bool doPageWrites,
 									   XLogRecPtr *fpw_lsn, int *num_fpi,
-									   bool *topxid_included);
+									   bool *topxid_included,
+									   bool *crc_pending);
 static bool XLogCompressBackupBlock(char *page, uint16 hole_offset,
 									uint16 hole_length, char *dest, uint16 *dlen);
 
@@ -509,6 +519,7 @@ XLogInsert(RmgrId rmid, uint8 info)
 		XLogRecPtr	fpw_lsn;
 		XLogRecData *rdt;
 		int			num_fpi = 0;
+		bool		crc_pending;
 
 		/*
 		 * Get values needed to decide whether to do full-page writes. Since
@@ -518,10 +529,11 @@ XLogInsert(RmgrId rmid, uint8 info)
 		GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
 
 		rdt = XLogRecordAssemble(rmid, info, RedoRecPtr, doPageWrites,
-								 &fpw_lsn, &num_fpi, &topxid_included);
+								 &fpw_lsn, &num_fpi, &topxid_included,
+								 &crc_pending);
 
 		EndPos = XLogInsertRecord(rdt, fpw_lsn, curinsert_flags, num_fpi,
-								  topxid_included);
+								  topxid_included, crc_pending);
 	} while (EndPos == InvalidXLogRecPtr);
 
 	XLogResetInsertion();
@@ -543,11 +555,17 @@ XLogInsert(RmgrId rmid, uint8 info)
  *
  * *topxid_included is set if the topmost transaction ID is logged with the
  * current subtransaction.
+ *
+ * *crc_pending is set if the CRC of the record data was not calculated here.
+ * That is done for records carrying full-page images: XLogInsertRecord() can
+ * then calculate the CRC while it copies the record into the WAL buffers, so
+ * that the page images are read from shared buffers only once.
  */
 static XLogRecData *
 XLogRecordAssemble(RmgrId rmid, uint8 info,
 				   XLogRecPtr RedoRecPtr, bool doPageWrites,
-				   XLogRecPtr *fpw_lsn, int *num_fpi, bool *topxid_included)
+				   XLogRecPtr *fpw_lsn, int *num_fpi, bool *topxid_included,
+				   bool *crc_pending)
 {
 	XLogRecData *rdt;
 	uint64		total_len = 0;
@@ -898,12 +916,17 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	 * Note that the record header isn't added into the CRC initially since we
 	 * don't know the prev-link yet.  Thus, the CRC will represent the CRC of
 	 * the whole record in the order: rdata, then backup blocks, then record
-	 * header.
+	 * header.  For records with full-page images, leave it all to
+	 * XLogInsertRecord(); see above.
 	 */
 	INIT_CRC32C(rdata_crc);
-	COMP_CRC32C(rdata_crc, hdr_scratch + SizeOfXLogRecord, hdr_rdt.len - SizeOfXLogRecord);
-	for (rdt = hdr_rdt.next; rdt != NULL; rdt = rdt->next)
-		COMP_CRC32C(rdata_crc, rdt->data, rdt->len);
+	*crc_pending = (*num_fpi > 0);
+	if (!*crc_pending)
+	{
+		COMP_CRC32C(rdata_crc, hdr_scratch + SizeOfXLogRecord, hdr_rdt.len - SizeOfXLogRecord);
+		for (rdt = hdr_rdt.next; rdt != NULL; rdt = rdt->next)
+			COMP_CRC32C(rdata_crc, rdt->data, rdt->len);
+	}
 
 	/*
 	 * Ensure that the XLogRecord is not too large.
@@ -987,8 +1010,14 @@ XLogCompressBackupBlock(char *page, uint16 hole_offset, uint16 hole_length,
 
 		case WAL_COMPRESSION_ZSTD:
 #ifdef USE_ZSTD
-			len = ZSTD_compress(dest, COMPRESS_BUFSIZE, source, orig_len,
-								ZSTD_CLEVEL_DEFAULT);
+			if (zstd_fpi_cctx == NULL)
+				zstd_fpi_cctx = ZSTD_createCCtx();
+			if (zstd_fpi_cctx != NULL)
+				len = ZSTD_compressCCtx(zstd_fpi_cctx, dest, COMPRESS_BUFSIZE,
+										source, orig_len, ZSTD_CLEVEL_DEFAULT);
+			else
+				len = ZSTD_compress(dest, COMPRESS_BUFSIZE, source, orig_len,
+									ZSTD_CLEVEL_DEFAULT);
 			if (ZSTD_isError(len))
 				len = -1;		/* failure */
 #else
@@ -2107,9 +2107,23 @@ RestoreBlockImage(XLogReaderState *record, uint8 block_id, char *page)
 		else if ((bkpb->bimg_info & BKPIMAGE_COMPRESS_ZSTD) != 0)
 		{
 #ifdef USE_ZSTD
-			size_t		decomp_result = ZSTD_decompress(tmp.data,
-														BLCKSZ - bkpb->hole_length,
-														ptr, bkpb->bimg_len);
+			static ZSTD_DCtx *dctx = NULL;
+			size_t		decomp_result;
+
+			/*
+			 * Reuse one decompression context; ZSTD_decompress() would
+			 * allocate and free one for every image.
+			 */
+			if (dctx == NULL)
+				dctx = ZSTD_createDCtx();
+			if (dctx != NULL)
+				decomp_result = ZSTD_decompressDCtx(dctx, tmp.data,
+													BLCKSZ - bkpb->hole_length,
+													ptr, bkpb->bimg_len);
+			else
+				decomp_result = ZSTD_decompress(tmp.data,
+												BLCKSZ - bkpb->hole_length,
+												ptr, bkpb->bimg_len);
 
 			if (ZSTD_isError(decomp_result))
 				decomp_success = false;
@@ -94,3 +94,28 @@ XLogRecStoreStats(XLogStats *stats, XLogReaderState *record)
 	stats->record_stats[rmid][recid].rec_len += rec_len;
 	stats->record_stats[rmid][recid].fpi_len += fpi_len;
 }
+
+/*
+ * Add the counts in *other to *stats, as if the records counted in *other
+ * had been counted in *stats.  This allows statistics to be collected for
+ * separate ranges of WAL and combined afterwards.
+ */
+void
+XLogStatsMerge(XLogStats *stats, const XLogStats *other)
+{
+	stats->count += other->count;
+
+	for (int ri = 0; ri <= RM_MAX_ID; ri++)
+	{
+		stats->rmgr_stats[ri].count += other->rmgr_stats[ri].count;
+		stats->rmgr_stats[ri].rec_len += other->rmgr_stats[ri].rec_len;
+		stats->rmgr_stats[ri].fpi_len += other->rmgr_stats[ri].fpi_len;
+
+		for (int rj = 0; rj < MAX_XLINFO_TYPES; rj++)
+		{
+			stats->record_stats[ri][rj].count += other->record_stats[ri][rj].count;
+			stats->record_stats[ri][rj].rec_len += other->record_stats[ri][rj].rec_len;
+			stats->record_stats[ri][rj].fpi_len += other->record_stats[ri][rj].fpi_len;
+		}
+	}
+}
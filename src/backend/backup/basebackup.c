@@ -28,6 +28,7 @@
 #include "common/compression.h"
 #include "common/file_perm.h"
 #include "common/file_utils.h"
+#include "jit/jit.h"
 #include "lib/stringinfo.h"
 #include "miscadmin.h"
 #include "nodes/pg_list.h"
@@ -178,6 +179,9 @@ static const char *const excludeDirContents[] =
 	/* Contents removed on startup, see DeleteAllExportedSnapshotFiles(). */
 	"pg_snapshots",
 
+	/* Contents removed on startup, see RemoveJitCacheFiles(). */
+	PG_JIT_CACHE_DIR,
+
 	/* Contents zeroed on startup, see StartupSUBTRANS(). */
 	"pg_subtrans",
 
@@ -4628,7 +4628,14 @@ RemoveTempRelationsCallback(int code, Datum arg)
 void
 ResetTempTableNamespace(void)
 {
-	if (OidIsValid(myTempNamespace))
+	/*
+	 * DISCARD ALL, which connection poolers issue whenever a server
+	 * connection is handed to a new client, gets here every time.  Most such
+	 * sessions never created a temp object, so check that there's something
+	 * to drop before running the full dependency-driven deletion.
+	 */
+	if (OidIsValid(myTempNamespace) &&
+		hasDependentObjects(NamespaceRelationId, myTempNamespace))
 		RemoveTempRelations(myTempNamespace);
 }
 
@@ -301,6 +301,8 @@ RelationTruncate(Relation rel, BlockNumber nblocks)
 	 */
 	reln = RelationGetSmgr(rel);
 	reln->smgr_targblock = InvalidBlockNumber;
+	reln->smgr_reserved_next = InvalidBlockNumber;
+	reln->smgr_reserved_last = InvalidBlockNumber;
 	for (int i = 0; i <= MAX_FORKNUM; ++i)
 		reln->smgr_cached_nblocks[i] = InvalidBlockNumber;
 
@@ -685,6 +685,8 @@ REVOKE EXECUTE ON FUNCTION pg_stat_have_stats(text, oid, oid) FROM public;
 
 REVOKE EXECUTE ON FUNCTION pg_stat_reset_subscription_stats(oid) FROM public;
 
+REVOKE EXECUTE ON FUNCTION pg_stat_reset_profile() FROM public;
+
 REVOKE EXECUTE ON FUNCTION lo_import(text) FROM public;
 
 REVOKE EXECUTE ON FUNCTION lo_import(text, oid) FROM public;
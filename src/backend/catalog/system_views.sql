@@ -885,7 +885,8 @@ CREATE VIEW pg_stat_activity AS
             s.backend_xmin,
             S.query_id,
             S.query,
-            S.backend_type
+            S.backend_type,
+            S.allocated_bytes
     FROM pg_stat_get_activity(NULL) AS S
         LEFT JOIN pg_database AS D ON (S.datid = D.oid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
@@ -911,7 +912,11 @@ CREATE VIEW pg_stat_replication AS
             W.replay_lag,
             W.sync_priority,
             W.sync_state,
-            W.reply_time
+            W.reply_time,
+            W.compression,
+            W.compression_in_bytes,
+            W.compression_out_bytes,
+            W.compression_time
     FROM pg_stat_get_activity(NULL) AS S
         JOIN pg_stat_get_wal_senders() AS W ON (S.pid = W.pid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
@@ -1003,6 +1008,9 @@ CREATE VIEW pg_stat_gssapi AS
     FROM pg_stat_get_activity(NULL) AS S
     WHERE S.client_port IS NOT NULL;
 
+CREATE VIEW pg_stat_protocol_compression AS
+    SELECT * FROM pg_stat_get_protocol_compression();
+
 CREATE VIEW pg_replication_slots AS
     SELECT
             L.slot_name,
@@ -1066,6 +1074,12 @@ CREATE VIEW pg_stat_database AS
             pg_stat_get_db_temp_files(D.oid) AS temp_files,
             pg_stat_get_db_temp_bytes(D.oid) AS temp_bytes,
             pg_stat_get_db_deadlocks(D.oid) AS deadlocks,
+            pg_stat_get_db_deadlock_checks(D.oid) AS deadlock_checks,
+            pg_stat_get_db_deadlock_full_checks(D.oid) AS deadlock_full_checks,
+            pg_stat_get_db_deadlock_check_time(D.oid) AS deadlock_check_time,
+            pg_stat_get_db_subxid_overflows(D.oid) AS subxid_overflows,
+            pg_stat_get_db_predlock_promotions(D.oid) AS predlock_promotions,
+            pg_stat_get_db_serialization_failures(D.oid) AS serialization_failures,
             pg_stat_get_db_checksum_failures(D.oid) AS checksum_failures,
             pg_stat_get_db_checksum_last_failure(D.oid) AS checksum_last_failure,
             pg_stat_get_db_blk_read_time(D.oid) AS blk_read_time,
@@ -1138,6 +1152,18 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_buffer_residency AS
+    SELECT
+            C.oid AS relid,
+            N.nspname AS schemaname,
+            C.relname AS relname,
+            R.relforknumber,
+            R.buffers
+    FROM pg_stat_get_buffer_residency() R
+         JOIN pg_class C
+           ON C.oid = pg_filenode_relation(R.reltablespace, R.relfilenode)
+         LEFT JOIN pg_namespace N ON N.oid = C.relnamespace;
+
 CREATE VIEW pg_stat_checkpointer AS
     SELECT
         pg_stat_get_checkpointer_num_timed() AS num_timed,
@@ -1166,6 +1192,7 @@ SELECT
        b.op_bytes,
        b.hits,
        b.evictions,
+       b.eviction_retries,
        b.reuses,
        b.fsyncs,
        b.fsync_time,
@@ -1374,3 +1401,20 @@ CREATE VIEW pg_stat_subscription_stats AS
 
 CREATE VIEW pg_wait_events AS
     SELECT * FROM pg_get_wait_events();
+
+CREATE VIEW pg_stat_profile AS
+    SELECT
+            S.query_id,
+            S.node_type,
+            S.plan_node_id,
+            S.wait_event_type,
+            S.wait_event,
+            count(*) AS samples
+    FROM pg_stat_get_profile_samples() AS S
+    GROUP BY S.query_id, S.node_type, S.plan_node_id,
+             S.wait_event_type, S.wait_event;
+
+REVOKE ALL ON pg_stat_profile FROM PUBLIC;
+GRANT SELECT ON pg_stat_profile TO pg_read_all_stats;
+REVOKE EXECUTE ON FUNCTION pg_stat_get_profile_samples() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_stat_get_profile_samples() TO pg_read_all_stats;
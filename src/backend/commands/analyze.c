@@ -36,6 +36,7 @@
 #include "common/pg_prng.h"
 #include "executor/executor.h"
 #include "foreign/fdwapi.h"
+#include "lib/hyperloglog.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "parser/parse_oper.h"
@@ -53,9 +54,11 @@
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/sampling.h"
+#include "utils/snapmgr.h"
 #include "utils/sortsupport.h"
 #include "utils/spccache.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 #include "utils/timestamp.h"
 
 
@@ -72,6 +75,12 @@ typedef struct AnlIndexData
 /* Default statistics target (GUC parameter) */
 int			default_statistics_target = 100;
 
+/* Estimate n_distinct from a scan of the whole table? (GUC parameter) */
+bool		analyze_ndistinct_full_scan = false;
+
+/* Register width of the HyperLogLog sketches used for that */
+#define SCAN_NDISTINCT_BWIDTH	14
+
 /* A few variables that don't seem worth passing around as parameters */
 static MemoryContext anl_context = NULL;
 static BufferAccessStrategy vac_strategy;
@@ -94,6 +103,8 @@ static int	compare_rows(const void *a, const void *b, void *arg);
 static int	acquire_inherited_sample_rows(Relation onerel, int elevel,
 										  HeapTuple *rows, int targrows,
 										  double *totalrows, double *totaldeadrows);
+static double *scan_ndistinct(Relation onerel,
+							  VacAttrStats **vacattrstats, int attr_cnt);
 static void update_attstats(Oid relid, bool inh,
 							int natts, VacAttrStats **vacattrstats);
 static Datum std_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull);
@@ -538,6 +549,12 @@ do_analyze_rel(Relation onerel, VacuumParams *params,
 	{
 		MemoryContext col_context,
 					old_context;
+		double	   *scanned_ndistinct = NULL;
+
+		if (analyze_ndistinct_full_scan && !inh && attr_cnt > 0 &&
+			(onerel->rd_rel->relkind == RELKIND_RELATION ||
+			 onerel->rd_rel->relkind == RELKIND_MATVIEW))
+			scanned_ndistinct = scan_ndistinct(onerel, vacattrstats, attr_cnt);
 
 		pgstat_progress_update_param(PROGRESS_ANALYZE_PHASE,
 									 PROGRESS_ANALYZE_PHASE_COMPUTE_STATS);
@@ -559,6 +576,11 @@ do_analyze_rel(Relation onerel, VacuumParams *params,
 								 numrows,
 								 totalrows);
 
+			/* Prefer the estimate from a full scan, if we made one */
+			if (scanned_ndistinct != NULL && scanned_ndistinct[i] != 0.0 &&
+				stats->stats_valid)
+				stats->stadistinct = scanned_ndistinct[i];
+
 			/*
 			 * If the appropriate flavor of the n_distinct option is
 			 * specified, override with the corresponding value.
@@ -1578,6 +1600,125 @@ acquire_inherited_sample_rows(Relation onerel, int elevel,
 }
 
 
+/*
+ * scan_ndistinct() -- estimate n_distinct of each column from a full scan
+ *
+ * A sample of a few tens of thousands of rows says little about the number
+ * of distinct values in a column that has many of them, particularly if
+ * their frequencies are skewed.  With analyze_ndistinct_full_scan, every
+ * live row of the table is fed into one HyperLogLog sketch per column, which
+ * gives an estimate within a few percent at the price of reading the whole
+ * table.
+ *
+ * Returns an array of estimates, following the conventions of stadistinct,
+ * in the order of vacattrstats.  An entry is 0 (unknown) if the column's
+ * type has no hash function or the column holds only nulls.
+ */
+static double *
+scan_ndistinct(Relation onerel, VacAttrStats **vacattrstats, int attr_cnt)
+{
+	double	   *result = palloc0_array(double, attr_cnt);
+	hyperLogLogState *sketches = palloc0_array(hyperLogLogState, attr_cnt);
+	FmgrInfo  **hashfns = palloc0_array(FmgrInfo *, attr_cnt);
+	double	   *nonnullrows = palloc0_array(double, attr_cnt);
+	double		totalrows = 0;
+	bool		any = false;
+	MemoryContext tuple_context;
+	MemoryContext old_context;
+	Snapshot	snapshot;
+	TableScanDesc scan;
+	TupleTableSlot *slot;
+
+	for (int i = 0; i < attr_cnt; i++)
+	{
+		TypeCacheEntry *typentry;
+
+		typentry = lookup_type_cache(vacattrstats[i]->attrtypid,
+									 TYPECACHE_HASH_PROC_FINFO);
+		if (OidIsValid(typentry->hash_proc))
+		{
+			hashfns[i] = &typentry->hash_proc_finfo;
+			initHyperLogLog(&sketches[i], SCAN_NDISTINCT_BWIDTH);
+			any = true;
+		}
+	}
+	if (!any)
+		return result;
+
+	tuple_context = AllocSetContextCreate(CurrentMemoryContext,
+										  "Analyze ndistinct scan",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	snapshot = RegisterSnapshot(GetTransactionSnapshot());
+	slot = table_slot_create(onerel, NULL);
+	scan = table_beginscan(onerel, snapshot, 0, NULL);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+	{
+		if ((uint64) totalrows % 1024 == 0)
+			vacuum_delay_point();
+		totalrows += 1;
+
+		old_context = MemoryContextSwitchTo(tuple_context);
+		for (int i = 0; i < attr_cnt; i++)
+		{
+			VacAttrStats *stats = vacattrstats[i];
+			Datum		value;
+			bool		isnull;
+			uint32		hash;
+
+			if (hashfns[i] == NULL)
+				continue;
+			value = slot_getattr(slot, stats->tupattnum, &isnull);
+			if (isnull)
+				continue;
+			nonnullrows[i] += 1;
+			hash = DatumGetUInt32(FunctionCall1Coll(hashfns[i],
+													stats->attrcollid,
+													value));
+			addHyperLogLog(&sketches[i], hash);
+		}
+		MemoryContextSwitchTo(old_context);
+		MemoryContextReset(tuple_context);
+	}
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+	UnregisterSnapshot(snapshot);
+	MemoryContextDelete(tuple_context);
+
+	for (int i = 0; i < attr_cnt; i++)
+	{
+		double		ndistinct;
+
+		if (hashfns[i] == NULL)
+			continue;
+
+		if (nonnullrows[i] > 0)
+		{
+			ndistinct = floor(estimateHyperLogLog(&sketches[i]) + 0.5);
+			ndistinct = Max(ndistinct, 1.0);
+			ndistinct = Min(ndistinct, nonnullrows[i]);
+
+			/*
+			 * As compute_scalar_stats() does, assume that the number of
+			 * distinct values scales with the table if it's large relative
+			 * to the number of rows.
+			 */
+			if (ndistinct > 0.1 * totalrows)
+				ndistinct = -(ndistinct / totalrows);
+			result[i] = ndistinct;
+		}
+		freeHyperLogLog(&sketches[i]);
+	}
+
+	pfree(sketches);
+	pfree(hashfns);
+	pfree(nonnullrows);
+
+	return result;
+}
+
 /*
  *	update_attstats() -- update attribute statistics for one relation
  *
@@ -72,10 +72,14 @@
  *	  Then we signal any backends that may be interested in our messages
  *	  (including our own backend, if listening).  This is done by
  *	  SignalBackends(), which scans the list of listening backends and sends a
- *	  PROCSIG_NOTIFY_INTERRUPT signal to every listening backend (we don't
- *	  know which backend is listening on which channel so we must signal them
- *	  all).  We can exclude backends that are already up to date, though, and
- *	  we can also exclude backends that are in other databases (unless they
+ *	  PROCSIG_NOTIFY_INTERRUPT signal to every listening backend that might
+ *	  be interested.  Each listener advertises a small bitmap of hashed
+ *	  channel names it listens on; a backend whose bitmap shares no bit with
+ *	  our channels doesn't care about our messages, and if it had read
+ *	  everything before them, we just move its queue pointer past them
+ *	  instead of waking it up.  The same is done for backends in other
+ *	  databases.  We can also exclude backends that are already up to date,
+ *	  and backends in other databases that are not caught up (unless they
  *	  are way behind and should be kicked to make them advance their
  *	  pointers).
  *
@@ -246,6 +250,7 @@ typedef struct QueueBackendStatus
 	Oid			dboid;			/* backend's database OID, or InvalidOid */
 	ProcNumber	nextListener;	/* id of next listener, or INVALID_PROC_NUMBER */
 	QueuePosition pos;			/* backend has read queue up to here */
+	uint64		channels;		/* ChannelHashBit() of channels listened on */
 } QueueBackendStatus;
 
 /*
@@ -301,6 +306,7 @@ static AsyncQueueControl *asyncQueueControl;
 #define QUEUE_BACKEND_DBOID(i)		(asyncQueueControl->backend[i].dboid)
 #define QUEUE_NEXT_LISTENER(i)		(asyncQueueControl->backend[i].nextListener)
 #define QUEUE_BACKEND_POS(i)		(asyncQueueControl->backend[i].pos)
+#define QUEUE_BACKEND_CHANNELS(i)	(asyncQueueControl->backend[i].channels)
 
 /*
  * The SLRU buffer area through which we access the notification queue
@@ -421,6 +427,14 @@ static bool amRegisteredListener = false;
 /* have we advanced to a page that's a multiple of QUEUE_CLEANUP_DELAY? */
 static bool tryAdvanceTail = false;
 
+/*
+ * Queue positions of the first and just past the last entry written by the
+ * current transaction.  Writers are serialized, so nobody else's entries are
+ * in between.
+ */
+static QueuePosition notifyQueueStart;
+static QueuePosition notifyQueueEnd;
+
 /* GUC parameters */
 bool		Trace_notify = false;
 
@@ -437,6 +451,8 @@ static void Exec_ListenCommit(const char *channel);
 static void Exec_UnlistenCommit(const char *channel);
 static void Exec_UnlistenAllCommit(void);
 static bool IsListeningOn(const char *channel);
+static inline uint64 ChannelHashBit(const char *channel);
+static void asyncQueueSetChannels(uint64 channels, bool replace);
 static void asyncQueueUnregister(void);
 static bool asyncQueueIsFull(void);
 static bool asyncQueueAdvance(volatile QueuePosition *position, int entryLength);
@@ -527,6 +543,7 @@ AsyncShmemInit(void)
 			QUEUE_BACKEND_DBOID(i) = InvalidOid;
 			QUEUE_NEXT_LISTENER(i) = INVALID_PROC_NUMBER;
 			SET_QUEUE_POS(QUEUE_BACKEND_POS(i), 0, 0);
+			QUEUE_BACKEND_CHANNELS(i) = 0;
 		}
 	}
 
@@ -871,6 +888,8 @@ PreCommit_Notify(void)
 	/* Preflight for any pending listen/unlisten actions */
 	if (pendingActions != NULL)
 	{
+		uint64		channels = 0;
+
 		foreach(p, pendingActions->actions)
 		{
 			ListenAction *actrec = (ListenAction *) lfirst(p);
@@ -879,6 +898,7 @@ PreCommit_Notify(void)
 			{
 				case LISTEN_LISTEN:
 					Exec_ListenPreCommit();
+					channels |= ChannelHashBit(actrec->channel);
 					break;
 				case LISTEN_UNLISTEN:
 					/* there is no Exec_UnlistenPreCommit() */
@@ -888,6 +908,13 @@ PreCommit_Notify(void)
 					break;
 			}
 		}
+
+		/*
+		 * Advertise the new channels before we commit, so that notifiers
+		 * committing after us will not skip us.
+		 */
+		if (channels != 0)
+			asyncQueueSetChannels(channels, false);
 	}
 
 	/* Queue any pending notifies (must happen after the above) */
@@ -944,7 +971,10 @@ PreCommit_Notify(void)
 				ereport(ERROR,
 						(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 						 errmsg("too many notifications in the NOTIFY queue")));
+			if (nextNotify == list_head(pendingNotifies->events))
+				notifyQueueStart = QUEUE_HEAD;
 			nextNotify = asyncQueueAddEntries(nextNotify);
+			notifyQueueEnd = QUEUE_HEAD;
 			LWLockRelease(NotifyQueueLock);
 		}
 
@@ -1005,6 +1035,16 @@ AtCommit_Notify(void)
 	if (amRegisteredListener && listenChannels == NIL)
 		asyncQueueUnregister();
 
+	/* Otherwise, stop advertising channels we have stopped listening on */
+	if (amRegisteredListener && pendingActions != NULL)
+	{
+		uint64		channels = 0;
+
+		foreach(p, listenChannels)
+			channels |= ChannelHashBit((char *) lfirst(p));
+		asyncQueueSetChannels(channels, true);
+	}
+
 	/*
 	 * Send signals to listening backends.  We need do this only if there are
 	 * pending notifies, which were previously added to the shared queue by
@@ -1099,6 +1139,7 @@ Exec_ListenPreCommit(void)
 	QUEUE_BACKEND_POS(MyProcNumber) = max;
 	QUEUE_BACKEND_PID(MyProcNumber) = MyProcPid;
 	QUEUE_BACKEND_DBOID(MyProcNumber) = MyDatabaseId;
+	QUEUE_BACKEND_CHANNELS(MyProcNumber) = 0;
 	/* Insert backend into list of listeners at correct position */
 	if (prevListener != INVALID_PROC_NUMBER)
 	{
@@ -1223,6 +1264,39 @@ IsListeningOn(const char *channel)
 	return false;
 }
 
+/*
+ * Map a channel name to the bit that represents it in the channels bitmap
+ * of QueueBackendStatus.
+ */
+static inline uint64
+ChannelHashBit(const char *channel)
+{
+	uint32		hash = hash_bytes((const unsigned char *) channel,
+								  strlen(channel));
+
+	return UINT64CONST(1) << (hash % 64);
+}
+
+/*
+ * Add to, or with replace = true, set the bitmap of channels we advertise as
+ * listening on.  We must be registered as a listener.
+ *
+ * Since we only change our own entry, shared lock suffices; notifiers look
+ * at the bitmap while holding exclusive lock.
+ */
+static void
+asyncQueueSetChannels(uint64 channels, bool replace)
+{
+	Assert(amRegisteredListener);
+
+	LWLockAcquire(NotifyQueueLock, LW_SHARED);
+	if (replace)
+		QUEUE_BACKEND_CHANNELS(MyProcNumber) = channels;
+	else
+		QUEUE_BACKEND_CHANNELS(MyProcNumber) |= channels;
+	LWLockRelease(NotifyQueueLock);
+}
+
 /*
  * Remove our entry from the listeners array when we are no longer listening
  * on any channel.  NB: must not fail if we're already not listening.
@@ -1242,6 +1316,7 @@ asyncQueueUnregister(void)
 	/* Mark our entry as invalid */
 	QUEUE_BACKEND_PID(MyProcNumber) = InvalidPid;
 	QUEUE_BACKEND_DBOID(MyProcNumber) = InvalidOid;
+	QUEUE_BACKEND_CHANNELS(MyProcNumber) = 0;
 	/* and remove it from the list */
 	if (QUEUE_FIRST_LISTENER == MyProcNumber)
 		QUEUE_FIRST_LISTENER = QUEUE_NEXT_LISTENER(MyProcNumber);
@@ -1572,6 +1647,12 @@ asyncQueueFillWarning(void)
  * behind.  Waken them anyway if they're far enough behind, so that they'll
  * advance their queue position pointers, allowing the global tail to advance.
  *
+ * A listener that has read everything up to our first message and whose
+ * channels bitmap shows no interest in any of our channels, or that is in
+ * another database, would just skip our messages; we advance its pointer
+ * over them ourselves and don't signal it.  This keeps the number of
+ * wakeups proportional to the number of interested listeners.
+ *
  * Since we know the ProcNumber and the Pid the signaling is quite cheap.
  *
  * This is called during CommitTransaction(), so it's important for it
@@ -1583,6 +1664,11 @@ SignalBackends(void)
 	int32	   *pids;
 	ProcNumber *procnos;
 	int			count;
+	uint64		channels = 0;
+	ListCell   *p;
+
+	foreach(p, pendingNotifies->events)
+		channels |= ChannelHashBit(((Notification *) lfirst(p))->data);
 
 	/*
 	 * Identify backends that we need to signal.  We don't want to send
@@ -1604,6 +1690,16 @@ SignalBackends(void)
 
 		Assert(pid != InvalidPid);
 		pos = QUEUE_BACKEND_POS(i);
+
+		/* Skip it over our messages if none can be of interest to it */
+		if (QUEUE_POS_EQUAL(pos, notifyQueueStart) &&
+			(QUEUE_BACKEND_DBOID(i) != MyDatabaseId ||
+			 (QUEUE_BACKEND_CHANNELS(i) & channels) == 0))
+		{
+			QUEUE_BACKEND_POS(i) = notifyQueueEnd;
+			continue;
+		}
+
 		if (QUEUE_BACKEND_DBOID(i) == MyDatabaseId)
 		{
 			/*
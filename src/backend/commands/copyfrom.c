@@ -45,6 +45,7 @@
 #include "rewrite/rewriteHandler.h"
 #include "storage/fd.h"
 #include "tcop/tcopprot.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/portal.h"
@@ -102,6 +103,7 @@ typedef struct CopyMultiInsertInfo
 
 /* non-export function prototypes */
 static void ClosePipeFromProgram(CopyFromState cstate);
+static CopyBinaryFastType CopyGetBinaryFastType(Oid recv_func, int32 typmod);
 
 /*
  * error context callback for COPY FROM
@@ -395,6 +397,7 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 		bool		line_buf_valid = cstate->line_buf_valid;
 		uint64		save_cur_lineno = cstate->cur_lineno;
 		MemoryContext oldcontext;
+		bool	   *batched = NULL;
 
 		Assert(buffer->bistate != NULL);
 
@@ -417,11 +420,23 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 						   buffer->bistate);
 		MemoryContextSwitchTo(oldcontext);
 
+		/*
+		 * Insert the index entries of all the tuples at once into the indexes
+		 * that support it.  Which row an error happens on is unknown.
+		 */
+		if (resultRelInfo->ri_NumIndices > 0)
+		{
+			cstate->relname_only = true;
+			batched = ExecInsertIndexTuplesBatch(resultRelInfo, slots, nused,
+												 estate);
+			cstate->relname_only = false;
+		}
+
 		for (i = 0; i < nused; i++)
 		{
 			/*
-			 * If there are any indexes, update them for all the inserted
-			 * tuples, and run AFTER ROW INSERT triggers.
+			 * If there are any indexes, update the remaining ones for all the
+			 * inserted tuples, and run AFTER ROW INSERT triggers.
 			 */
 			if (resultRelInfo->ri_NumIndices > 0)
 			{
@@ -429,9 +444,9 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 
 				cstate->cur_lineno = buffer->linenos[i];
 				recheckIndexes =
-					ExecInsertIndexTuples(resultRelInfo,
-										  buffer->slots[i], estate, false,
-										  false, NULL, NIL, false);
+					ExecInsertRemainingIndexTuples(resultRelInfo,
+												   buffer->slots[i], estate,
+												   batched);
 				ExecARInsertTriggers(estate, resultRelInfo,
 									 slots[i], recheckIndexes,
 									 cstate->transition_capture);
@@ -455,6 +470,9 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 			ExecClearTuple(slots[i]);
 		}
 
+		if (batched)
+			pfree(batched);
+
 		/* Update the row counter and progress of the COPY command */
 		*processed += nused;
 		pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED,
@@ -630,6 +648,7 @@ CopyFrom(CopyFromState cstate)
 	ResultRelInfo *resultRelInfo;
 	ResultRelInfo *target_resultRelInfo;
 	ResultRelInfo *prevResultRelInfo = NULL;
+	ResultRelInfo *bistateResultRelInfo = NULL;
 	EState	   *estate = CreateExecutorState(); /* for ExecConstraints() */
 	ModifyTableState *mtstate;
 	ExprContext *econtext;
@@ -944,6 +963,13 @@ CopyFrom(CopyFromState cstate)
 	 */
 	ExecBSInsertTriggers(estate, resultRelInfo);
 
+	/*
+	 * If requested, and if it's safe, start workers to parse the input.  We
+	 * still insert the rows ourselves.
+	 */
+	if (cstate->opts.parallel_workers > 0)
+		BeginParallelCopyFrom(cstate);
+
 	econtext = GetPerTupleExprContext(estate);
 
 	/* Set up callback to identify error line number */
@@ -1094,8 +1120,6 @@ CopyFrom(CopyFromState cstate)
 											 &processed);
 				}
 
-				if (bistate != NULL)
-					ReleaseBulkInsertStatePin(bistate);
 				prevResultRelInfo = resultRelInfo;
 			}
 
@@ -1263,6 +1287,22 @@ CopyFrom(CopyFromState cstate)
 					}
 					else
 					{
+						/*
+						 * The bulk insert state may still hold a pin and
+						 * bulk extension state for another partition; drop
+						 * those before using it for this one.  This is done
+						 * here rather than whenever the target partition
+						 * changes, so that rows routed to partitions using
+						 * multi-insert buffers in between don't throw away
+						 * the state of a partition that needs single inserts.
+						 */
+						if (bistate != NULL &&
+							bistateResultRelInfo != resultRelInfo)
+						{
+							ReleaseBulkInsertStatePin(bistate);
+							bistateResultRelInfo = resultRelInfo;
+						}
+
 						/* OK, store the tuple and create index entries for it */
 						table_tuple_insert(resultRelInfo->ri_RelationDesc,
 										   myslot, mycid, ti_options, bistate);
@@ -1307,6 +1347,10 @@ CopyFrom(CopyFromState cstate)
 	/* Done, clean up */
 	error_context_stack = errcallback.previous;
 
+	/* Shut down parallel workers, collecting their count of skipped rows */
+	if (cstate->pcopy)
+		EndParallelCopyFrom(cstate);
+
 	if (cstate->opts.on_error != COPY_ON_ERROR_STOP &&
 		cstate->num_errors > 0)
 		ereport(NOTICE,
@@ -1381,6 +1425,7 @@ BeginCopyFrom(ParseState *pstate,
 				num_defaults;
 	FmgrInfo   *in_functions;
 	Oid		   *typioparams;
+	CopyBinaryFastType *binary_fast = NULL;
 	Oid			in_func_oid;
 	int		   *defmap;
 	ExprState **defexprs;
@@ -1413,6 +1458,13 @@ BeginCopyFrom(ParseState *pstate,
 	/* Extract options from the statement node tree */
 	ProcessCopyOptions(pstate, &cstate->opts, true /* is_from */ , options);
 
+	/* Parallel workers set up their own state from the same lists */
+	if (cstate->opts.parallel_workers > 0)
+	{
+		cstate->parallel_attnamelist = copyObject(attnamelist);
+		cstate->parallel_options = copyObject(options);
+	}
+
 	/* Process the target relation */
 	cstate->rel = rel;
 
@@ -1607,6 +1659,9 @@ BeginCopyFrom(ParseState *pstate,
 	typioparams = (Oid *) palloc(num_phys_attrs * sizeof(Oid));
 	defmap = (int *) palloc(num_phys_attrs * sizeof(int));
 	defexprs = (ExprState **) palloc(num_phys_attrs * sizeof(ExprState *));
+	if (cstate->opts.binary)
+		binary_fast = (CopyBinaryFastType *)
+			palloc0(num_phys_attrs * sizeof(CopyBinaryFastType));
 
 	for (int attnum = 1; attnum <= num_phys_attrs; attnum++)
 	{
@@ -1624,6 +1679,9 @@ BeginCopyFrom(ParseState *pstate,
 			getTypeInputInfo(att->atttypid,
 							 &in_func_oid, &typioparams[attnum - 1]);
 		fmgr_info(in_func_oid, &in_functions[attnum - 1]);
+		if (cstate->opts.binary)
+			binary_fast[attnum - 1] = CopyGetBinaryFastType(in_func_oid,
+															att->atttypmod);
 
 		/* Get default info if available */
 		defexprs[attnum - 1] = NULL;
@@ -1686,6 +1744,7 @@ BeginCopyFrom(ParseState *pstate,
 	/* We keep those variables in cstate. */
 	cstate->in_functions = in_functions;
 	cstate->typioparams = typioparams;
+	cstate->binary_fast = binary_fast;
 	cstate->defmap = defmap;
 	cstate->defexprs = defexprs;
 	cstate->volatile_defexprs = volatile_defexprs;
@@ -1804,6 +1863,46 @@ EndCopyFrom(CopyFromState cstate)
 	pfree(cstate);
 }
 
+/*
+ * Decide whether NextCopyFrom() can decode a binary field of a column itself,
+ * given the receive function and typmod of the column.  This is only the case
+ * for fixed-width types whose receive function does nothing more than
+ * byte-swapping and a range check.
+ */
+static CopyBinaryFastType
+CopyGetBinaryFastType(Oid recv_func, int32 typmod)
+{
+	switch (recv_func)
+	{
+		case F_BOOLRECV:
+			return COPY_BINARY_BOOL;
+		case F_INT2RECV:
+			return COPY_BINARY_INT2;
+		case F_INT4RECV:
+			return COPY_BINARY_INT4;
+		case F_OIDRECV:
+			return COPY_BINARY_OID;
+		case F_INT8RECV:
+			return COPY_BINARY_INT8;
+		case F_FLOAT4RECV:
+			return COPY_BINARY_FLOAT4;
+		case F_FLOAT8RECV:
+			return COPY_BINARY_FLOAT8;
+		case F_DATE_RECV:
+			return COPY_BINARY_DATE;
+		case F_TIMESTAMP_RECV:
+		case F_TIMESTAMPTZ_RECV:
+			/* rounding to the precision is left to the receive function */
+			if (typmod < 0)
+				return COPY_BINARY_TIMESTAMP;
+			break;
+		case F_UUID_RECV:
+			return COPY_BINARY_UUID;
+	}
+
+	return COPY_BINARY_RECV;
+}
+
 /*
  * Closes the pipe from an external program, checking the pclose() return code.
  */
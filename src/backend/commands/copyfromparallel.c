@@ -0,0 +1,703 @@
+/*-------------------------------------------------------------------------
+ *
+ * copyfromparallel.c
+ *		Parallel parsing of text/CSV input for COPY FROM.
+ *
+ * With the PARALLEL option, the leader splits the input into lines and
+ * ships them to worker processes in chunks of about PARALLEL_COPY_CHUNK_SIZE
+ * bytes.  Each worker parses its chunks into fields, runs the input
+ * functions and evaluates default expressions, and sends the resulting
+ * tuples back to the leader, which inserts them.  Parallel workers cannot
+ * insert tuples themselves, so the insertion, index maintenance and
+ * constraint checking still happen in the leader.
+ *
+ * Chunks are handed out round-robin, and the leader reads the results of
+ * each chunk from the worker that parsed it before moving on to the next
+ * one, so the rows are inserted in the same order as serial COPY would.
+ * Each worker has one message queue for input, carrying messages of the
+ * form
+ *
+ *		[uint64 line number preceding the chunk][lines, each ending in '\n']
+ *
+ * and one for output, carrying one message per row,
+ *
+ *		[uint64 line number][HeapTupleHeader]
+ *
+ * followed by a message holding just a line number at the end of each chunk.
+ * The lines are sent in the server encoding, so the workers need no
+ * encoding conversion.  Lines with soft errors (ON_ERROR ignore) are dropped
+ * by the worker, which counts them in shared memory.
+ *
+ * The leader stays in parallel mode while it inserts, so we only go parallel
+ * when nothing run by the leader for each row could need to do something
+ * forbidden in parallel mode: the target must be a plain table without
+ * triggers (including foreign key triggers), and the expressions evaluated
+ * in either process must be parallel safe.  Otherwise COPY silently falls
+ * back to parsing the input in the leader.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/commands/copyfromparallel.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/parallel.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_type.h"
+#include "commands/copyfrom_internal.h"
+#include "commands/progress.h"
+#include "executor/executor.h"
+#include "mb/pg_wchar.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "optimizer/clauses.h"
+#include "pgstat.h"
+#include "storage/latch.h"
+#include "storage/shm_mq.h"
+#include "tcop/tcopprot.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/wait_event.h"
+
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_COPY_SHARED		UINT64CONST(0xC000000000000001)
+#define PARALLEL_KEY_COPY_ATTNAMES		UINT64CONST(0xC000000000000002)
+#define PARALLEL_KEY_COPY_OPTIONS		UINT64CONST(0xC000000000000003)
+#define PARALLEL_KEY_COPY_QUEUES		UINT64CONST(0xC000000000000004)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xC000000000000005)
+
+/* Target size of a chunk of input lines, and of each message queue */
+#define PARALLEL_COPY_CHUNK_SIZE		65536
+#define PARALLEL_COPY_QUEUE_SIZE		(4 * PARALLEL_COPY_CHUNK_SIZE)
+
+/*
+ * Shared state, in the DSM segment.  The input and output queues of each
+ * worker follow it in a separate chunk.
+ */
+typedef struct ParallelCopyShared
+{
+	Oid			relid;			/* target relation */
+	pg_atomic_uint64 num_errors;	/* rows skipped by workers */
+} ParallelCopyShared;
+
+/*
+ * Leader's private state, hanging off CopyFromState.
+ */
+typedef struct ParallelCopyState
+{
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	int			nworkers;		/* number of workers launched */
+	shm_mq_handle **inqh;		/* input queue of each worker */
+	shm_mq_handle **outqh;		/* output queue of each worker */
+
+	StringInfoData chunk;		/* chunk being filled or sent */
+	bool		chunk_ready;	/* chunk complete, waiting for queue space */
+	uint64		read_lineno;	/* input line number of the leader */
+	uint64		nsent;			/* number of chunks sent */
+	uint64		nconsumed;		/* number of chunks fully read back */
+	bool		input_done;		/* reached end of input? */
+	bool		inputs_detached;	/* told the workers there's no more? */
+} ParallelCopyState;
+
+/* In a worker, the part of the current chunk not yet read by COPY */
+static char *worker_chunk_data;
+static Size worker_chunk_len;
+
+static bool ParallelCopyFromIsSafe(CopyFromState cstate);
+static List *ParallelCopyWorkerOptions(List *options);
+static bool ParallelCopySendInput(CopyFromState cstate);
+static void ParallelCopyWorkerGone(ParallelCopyState *pcopy) pg_attribute_noreturn();
+static int	ParallelCopyReadChunk(void *outbuf, int minread, int maxread);
+
+/*
+ * Check whether the COPY can use parallel workers, see file header comment.
+ */
+static bool
+ParallelCopyFromIsSafe(CopyFromState cstate)
+{
+	Relation	rel = cstate->rel;
+	TupleDesc	tupDesc = RelationGetDescr(rel);
+	PlannerInfo *root;
+	ListCell   *cur;
+
+	if (IsInParallelMode())
+		return false;
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION || rel->trigdesc != NULL)
+		return false;
+
+	/* Workers can't see our temporary tables */
+	if (RelationUsesLocalBuffers(rel))
+		return false;
+
+	/* A dummy planner state is enough for is_parallel_safe() */
+	root = makeNode(PlannerInfo);
+	root->glob = makeNode(PlannerGlobal);
+
+	/* The input functions run in the workers */
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+		Form_pg_attribute att = TupleDescAttr(tupDesc, attnum - 1);
+
+		if (func_parallel(cstate->in_functions[attnum - 1].fn_oid) != PROPARALLEL_SAFE)
+			return false;
+
+		/* domain constraints could call anything */
+		if (get_typtype(att->atttypid) == TYPTYPE_DOMAIN)
+			return false;
+	}
+
+	/* So do the default expressions */
+	for (int i = 0; i < tupDesc->natts; i++)
+	{
+		if (TupleDescAttr(tupDesc, i)->attisdropped)
+			continue;
+		if (cstate->defexprs[i] != NULL &&
+			!is_parallel_safe(root, (Node *) cstate->defexprs[i]->expr))
+			return false;
+	}
+
+	/* The WHERE clause and CHECK constraints run in the leader */
+	if (!is_parallel_safe(root, cstate->whereClause))
+		return false;
+
+	if (tupDesc->constr)
+	{
+		for (int i = 0; i < tupDesc->constr->num_check; i++)
+		{
+			Node	   *check = stringToNode(tupDesc->constr->check[i].ccbin);
+
+			if (!is_parallel_safe(root, check))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Make the COPY options to be used by workers.  The leader deals with the
+ * header line and the encoding conversion.
+ */
+static List *
+ParallelCopyWorkerOptions(List *options)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *defel = lfirst_node(DefElem, lc);
+
+		if (strcmp(defel->defname, "header") == 0 ||
+			strcmp(defel->defname, "encoding") == 0 ||
+			strcmp(defel->defname, "parallel") == 0)
+			continue;
+		result = lappend(result, defel);
+	}
+
+	return lappend(result,
+				   makeDefElem("encoding",
+							   (Node *) makeString(pstrdup(GetDatabaseEncodingName())),
+							   -1));
+}
+
+/*
+ * Start parallel workers for a COPY FROM, if possible.
+ *
+ * On success, cstate->pcopy is set and NextCopyFrom() returns the rows
+ * parsed by the workers.  If the COPY is not parallel safe, or no workers
+ * could be launched, cstate->pcopy is left NULL and COPY parses the input
+ * itself.
+ */
+void
+BeginParallelCopyFrom(CopyFromState cstate)
+{
+	ParallelCopyState *pcopy;
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	char	   *attnames_str;
+	char	   *options_str;
+	char	   *sharedattnames;
+	char	   *sharedoptions;
+	char	   *sharedquery;
+	char	   *queues;
+	int			querylen;
+	int			nworkers = cstate->opts.parallel_workers;
+	MemoryContext oldcontext;
+
+	Assert(nworkers > 0);
+	Assert(cstate->pcopy == NULL);
+
+	if (!ParallelCopyFromIsSafe(cstate))
+	{
+		elog(DEBUG1, "COPY FROM is not parallel safe, parsing input in leader");
+		return;
+	}
+
+	oldcontext = MemoryContextSwitchTo(cstate->copycontext);
+
+	attnames_str = nodeToString(cstate->parallel_attnamelist);
+	options_str = nodeToString(ParallelCopyWorkerOptions(cstate->parallel_options));
+
+	/*
+	 * We will be inserting while in parallel mode, where a transaction ID
+	 * can't be assigned, so get one now.
+	 */
+	(void) GetCurrentTransactionId();
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "ParallelCopyFromMain", nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(attnames_str) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(options_str) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(PARALLEL_COPY_QUEUE_SIZE, 2 * nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 4);
+
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, parse serially */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		MemoryContextSwitchTo(oldcontext);
+		return;
+	}
+
+	shared = shm_toc_allocate(pcxt->toc, sizeof(ParallelCopyShared));
+	shared->relid = RelationGetRelid(cstate->rel);
+	pg_atomic_init_u64(&shared->num_errors, 0);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_SHARED, shared);
+
+	sharedattnames = shm_toc_allocate(pcxt->toc, strlen(attnames_str) + 1);
+	strcpy(sharedattnames, attnames_str);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_ATTNAMES, sharedattnames);
+
+	sharedoptions = shm_toc_allocate(pcxt->toc, strlen(options_str) + 1);
+	strcpy(sharedoptions, options_str);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_OPTIONS, sharedoptions);
+
+	queues = shm_toc_allocate(pcxt->toc,
+							  mul_size(PARALLEL_COPY_QUEUE_SIZE, 2 * nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_COPY_QUEUES, queues);
+
+	if (debug_query_string)
+	{
+		sharedquery = shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	pcopy = palloc0(sizeof(ParallelCopyState));
+	pcopy->pcxt = pcxt;
+	pcopy->shared = shared;
+	pcopy->inqh = palloc0(nworkers * sizeof(shm_mq_handle *));
+	pcopy->outqh = palloc0(nworkers * sizeof(shm_mq_handle *));
+	initStringInfo(&pcopy->chunk);
+
+	for (int i = 0; i < nworkers; i++)
+	{
+		shm_mq	   *inq;
+		shm_mq	   *outq;
+
+		inq = shm_mq_create(queues + (2 * i) * PARALLEL_COPY_QUEUE_SIZE,
+							PARALLEL_COPY_QUEUE_SIZE);
+		shm_mq_set_sender(inq, MyProc);
+		pcopy->inqh[i] = shm_mq_attach(inq, pcxt->seg, NULL);
+
+		outq = shm_mq_create(queues + (2 * i + 1) * PARALLEL_COPY_QUEUE_SIZE,
+							 PARALLEL_COPY_QUEUE_SIZE);
+		shm_mq_set_receiver(outq, MyProc);
+		pcopy->outqh[i] = shm_mq_attach(outq, pcxt->seg, NULL);
+	}
+
+	LaunchParallelWorkers(pcxt);
+
+	if (pcxt->nworkers_launched == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		MemoryContextSwitchTo(oldcontext);
+		return;
+	}
+
+	/* Notice if a worker dies before attaching to its queues */
+	pcopy->nworkers = pcxt->nworkers_launched;
+	for (int i = 0; i < pcopy->nworkers; i++)
+	{
+		shm_mq_set_handle(pcopy->inqh[i], pcxt->worker[i].bgwhandle);
+		shm_mq_set_handle(pcopy->outqh[i], pcxt->worker[i].bgwhandle);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	cstate->pcopy = pcopy;
+}
+
+/*
+ * Read more input lines and pass them to the next worker.  Returns false if
+ * nothing could be done because that worker's queue is full.
+ */
+static bool
+ParallelCopySendInput(CopyFromState cstate)
+{
+	ParallelCopyState *pcopy = cstate->pcopy;
+	StringInfo	chunk = &pcopy->chunk;
+	bool		progress = false;
+
+	if (pcopy->inputs_detached)
+		return false;
+
+	/*
+	 * Fill a chunk of lines, remembering where the first line starts.  The
+	 * line counter in cstate is shared with the rows returned by
+	 * ParallelCopyFromNext(), so keep our own while reading.
+	 */
+	if (!pcopy->chunk_ready && !pcopy->input_done)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(cstate->copycontext);
+		uint64		row_lineno = cstate->cur_lineno;
+
+		cstate->cur_lineno = pcopy->read_lineno;
+		while (chunk->len < PARALLEL_COPY_CHUNK_SIZE)
+		{
+			uint64		prev_lineno;
+
+			if (!CopyFromReadLine(cstate, &prev_lineno))
+			{
+				pcopy->input_done = true;
+				break;
+			}
+
+			if (chunk->len == 0)
+				appendBinaryStringInfo(chunk, &prev_lineno, sizeof(uint64));
+			appendBinaryStringInfo(chunk, cstate->line_buf.data,
+								   cstate->line_buf.len);
+			appendStringInfoChar(chunk, '\n');
+		}
+		pcopy->chunk_ready = (chunk->len > 0);
+		pcopy->read_lineno = cstate->cur_lineno;
+		cstate->cur_lineno = row_lineno;
+		cstate->line_buf_valid = false;
+
+		MemoryContextSwitchTo(oldcontext);
+		progress = true;
+	}
+
+	if (pcopy->chunk_ready)
+	{
+		shm_mq_result res;
+
+		res = shm_mq_send(pcopy->inqh[pcopy->nsent % pcopy->nworkers],
+						  chunk->len, chunk->data, true, true);
+		if (res == SHM_MQ_DETACHED)
+			ParallelCopyWorkerGone(pcopy);
+		if (res == SHM_MQ_SUCCESS)
+		{
+			pcopy->nsent++;
+			pcopy->chunk_ready = false;
+			resetStringInfo(chunk);
+			progress = true;
+		}
+	}
+
+	/* Once everything has been sent, let the workers finish */
+	if (pcopy->input_done && !pcopy->chunk_ready)
+	{
+		for (int i = 0; i < pcopy->nworkers; i++)
+			shm_mq_detach(pcopy->inqh[i]);
+		pcopy->inputs_detached = true;
+		progress = true;
+	}
+
+	return progress;
+}
+
+/*
+ * A worker detached from its queue before we were done with it.  It most
+ * likely failed, so wait for the workers to exit to get its error reported.
+ */
+static void
+ParallelCopyWorkerGone(ParallelCopyState *pcopy)
+{
+	for (int i = 0; i < pcopy->nworkers; i++)
+	{
+		if (!pcopy->inputs_detached)
+			shm_mq_detach(pcopy->inqh[i]);
+		shm_mq_detach(pcopy->outqh[i]);
+	}
+	pcopy->inputs_detached = true;
+
+	WaitForParallelWorkersToFinish(pcopy->pcxt);
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INTERNAL_ERROR),
+			 errmsg("parallel COPY worker exited unexpectedly")));
+}
+
+/*
+ * Get the next row parsed by the workers, in input order.  Return false if
+ * no more rows.
+ *
+ * Used by NextCopyFrom() in place of parsing the input.  The values are
+ * allocated in CurrentMemoryContext.
+ */
+bool
+ParallelCopyFromNext(CopyFromState cstate, Datum *values, bool *nulls)
+{
+	ParallelCopyState *pcopy = cstate->pcopy;
+
+	for (;;)
+	{
+		bool		progress = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (pcopy->nconsumed < pcopy->nsent)
+		{
+			shm_mq_handle *mqh = pcopy->outqh[pcopy->nconsumed % pcopy->nworkers];
+			shm_mq_result res;
+			Size		nbytes;
+			void	   *data;
+
+			res = shm_mq_receive(mqh, &nbytes, &data, true);
+			if (res == SHM_MQ_DETACHED)
+				ParallelCopyWorkerGone(pcopy);
+			if (res == SHM_MQ_SUCCESS)
+			{
+				HeapTupleData tuple;
+
+				Assert(nbytes >= sizeof(uint64));
+				memcpy(&cstate->cur_lineno, data, sizeof(uint64));
+
+				/* a bare line number marks the end of the chunk */
+				if (nbytes == sizeof(uint64))
+				{
+					pcopy->nconsumed++;
+					continue;
+				}
+
+				tuple.t_len = nbytes - sizeof(uint64);
+				tuple.t_data = palloc(tuple.t_len);
+				memcpy(tuple.t_data, (char *) data + sizeof(uint64),
+					   tuple.t_len);
+				ItemPointerSetInvalid(&tuple.t_self);
+				tuple.t_tableOid = InvalidOid;
+
+				heap_deform_tuple(&tuple, RelationGetDescr(cstate->rel),
+								  values, nulls);
+				return true;
+			}
+		}
+
+		/* While the oldest chunk is being worked on, feed the workers */
+		if (ParallelCopySendInput(cstate))
+			progress = true;
+
+		if (pcopy->input_done && pcopy->nconsumed == pcopy->nsent)
+			return false;
+
+		if (!progress)
+		{
+			(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+							 WAIT_EVENT_PARALLEL_COPY_FROM);
+			ResetLatch(MyLatch);
+		}
+	}
+}
+
+/*
+ * Wait for the workers to exit and leave parallel mode.
+ */
+void
+EndParallelCopyFrom(CopyFromState cstate)
+{
+	ParallelCopyState *pcopy = cstate->pcopy;
+
+	Assert(pcopy->inputs_detached);
+
+	for (int i = 0; i < pcopy->nworkers; i++)
+		shm_mq_detach(pcopy->outqh[i]);
+
+	WaitForParallelWorkersToFinish(pcopy->pcxt);
+
+	cstate->num_errors += pg_atomic_read_u64(&pcopy->shared->num_errors);
+	pgstat_progress_update_param(PROGRESS_COPY_TUPLES_SKIPPED,
+								 cstate->num_errors);
+
+	DestroyParallelContext(pcopy->pcxt);
+	ExitParallelMode();
+
+	cstate->pcopy = NULL;
+}
+
+/*
+ * Data source callback for workers: return bytes of the current chunk.
+ */
+static int
+ParallelCopyReadChunk(void *outbuf, int minread, int maxread)
+{
+	Size		nbytes = Min(worker_chunk_len, (Size) maxread);
+
+	memcpy(outbuf, worker_chunk_data, nbytes);
+	worker_chunk_data += nbytes;
+	worker_chunk_len -= nbytes;
+
+	return (int) nbytes;
+}
+
+/*
+ * Parallel COPY FROM worker entry point.
+ */
+void
+ParallelCopyFromMain(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCopyShared *shared;
+	char	   *queues;
+	shm_mq	   *inq;
+	shm_mq	   *outq;
+	shm_mq_handle *inqh;
+	shm_mq_handle *outqh;
+	List	   *attnamelist;
+	List	   *options;
+	Relation	rel;
+	TupleDesc	tupDesc;
+	CopyFromState cstate;
+	ExprContext *econtext;
+	Datum	   *values;
+	bool	   *nulls;
+	ErrorContextCallback errcallback;
+	bool		leader_gone = false;
+
+	/* Set debug_query_string for individual workers first */
+	debug_query_string = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	shared = shm_toc_lookup(toc, PARALLEL_KEY_COPY_SHARED, false);
+	attnamelist = stringToNode(shm_toc_lookup(toc, PARALLEL_KEY_COPY_ATTNAMES, false));
+	options = stringToNode(shm_toc_lookup(toc, PARALLEL_KEY_COPY_OPTIONS, false));
+
+	queues = shm_toc_lookup(toc, PARALLEL_KEY_COPY_QUEUES, false);
+	inq = (shm_mq *) (queues + (2 * ParallelWorkerNumber) * PARALLEL_COPY_QUEUE_SIZE);
+	shm_mq_set_receiver(inq, MyProc);
+	inqh = shm_mq_attach(inq, seg, NULL);
+	outq = (shm_mq *) (queues + (2 * ParallelWorkerNumber + 1) * PARALLEL_COPY_QUEUE_SIZE);
+	shm_mq_set_sender(outq, MyProc);
+	outqh = shm_mq_attach(outq, seg, NULL);
+
+	/* The leader holds the same lock, so this can't block */
+	rel = table_open(shared->relid, RowExclusiveLock);
+	tupDesc = RelationGetDescr(rel);
+
+	cstate = BeginCopyFrom(NULL, rel, NULL, NULL, false, ParallelCopyReadChunk,
+						   attnamelist, options);
+
+	econtext = CreateStandaloneExprContext();
+	values = palloc(tupDesc->natts * sizeof(Datum));
+	nulls = palloc(tupDesc->natts * sizeof(bool));
+
+	errcallback.callback = CopyFromErrorCallback;
+	errcallback.arg = (void *) cstate;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	while (!leader_gone)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+		uint64		prev_lineno;
+
+		/* the leader detaches once all the input has been sent */
+		res = shm_mq_receive(inqh, &nbytes, &data, false);
+		if (res != SHM_MQ_SUCCESS)
+			break;
+
+		Assert(nbytes >= sizeof(uint64));
+		memcpy(&prev_lineno, data, sizeof(uint64));
+		worker_chunk_data = (char *) data + sizeof(uint64);
+		worker_chunk_len = nbytes - sizeof(uint64);
+		CopyFromRestartInput(cstate, prev_lineno);
+
+		for (;;)
+		{
+			MemoryContext oldcontext;
+			HeapTuple	tuple;
+			shm_mq_iovec iov[2];
+			bool		found;
+
+			CHECK_FOR_INTERRUPTS();
+
+			ResetExprContext(econtext);
+			oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+			found = NextCopyFrom(cstate, econtext, values, nulls);
+			if (!found)
+			{
+				MemoryContextSwitchTo(oldcontext);
+				break;
+			}
+
+			if (cstate->opts.on_error != COPY_ON_ERROR_STOP &&
+				cstate->escontext->error_occurred)
+			{
+				/* skip the row, see CopyFrom() */
+				cstate->escontext->error_occurred = false;
+				MemoryContextSwitchTo(oldcontext);
+				continue;
+			}
+
+			tuple = heap_form_tuple(tupDesc, values, nulls);
+			iov[0].data = (char *) &cstate->cur_lineno;
+			iov[0].len = sizeof(uint64);
+			iov[1].data = (char *) tuple->t_data;
+			iov[1].len = tuple->t_len;
+			res = shm_mq_sendv(outqh, iov, 2, false, false);
+
+			MemoryContextSwitchTo(oldcontext);
+
+			if (res != SHM_MQ_SUCCESS)
+			{
+				leader_gone = true;
+				break;
+			}
+		}
+
+		if (!leader_gone &&
+			shm_mq_send(outqh, sizeof(uint64), &cstate->cur_lineno,
+						false, true) != SHM_MQ_SUCCESS)
+			leader_gone = true;
+	}
+
+	error_context_stack = errcallback.previous;
+
+	pg_atomic_add_fetch_u64(&shared->num_errors, cstate->num_errors);
+
+	shm_mq_detach(outqh);
+	shm_mq_detach(inqh);
+
+	EndCopyFrom(cstate);
+	table_close(rel, RowExclusiveLock);
+}
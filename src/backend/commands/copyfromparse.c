@@ -72,9 +72,14 @@
 #include "miscadmin.h"
 #include "nodes/miscnodes.h"
 #include "pgstat.h"
+#include "port/pg_bitutils.h"
 #include "port/pg_bswap.h"
+#include "port/simd.h"
 #include "utils/builtins.h"
+#include "utils/date.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
+#include "utils/uuid.h"
 
 #define ISOCTAL(c) (((c) >= '0') && ((c) <= '7'))
 #define OCTVALUE(c) ((c) - '0')
@@ -147,15 +152,47 @@ if (1) \
 /* NOTE: there's a copy of this in copyto.c */
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
 
+/*
+ * Set of bytes that the parsing loops below must look at individually.
+ * Runs of other bytes are skipped (and copied, where applicable) a vector at
+ * a time by CopySkipOrdinaryBytes().
+ */
+#define COPY_MAX_SPECIAL_CHARS	5
+
+typedef struct CopySpecialChars
+{
+	int			nchars;
+#ifndef USE_NO_SIMD
+	Vector8		chars[COPY_MAX_SPECIAL_CHARS];
+#endif
+} CopySpecialChars;
+
 
 /* non-export function prototypes */
+/* Binary field size of each of the CopyBinaryFastType types */
+static const int CopyBinaryFastTypeSize[] = {
+	[COPY_BINARY_RECV] = -1,
+	[COPY_BINARY_BOOL] = 1,
+	[COPY_BINARY_INT2] = sizeof(int16),
+	[COPY_BINARY_INT4] = sizeof(int32),
+	[COPY_BINARY_OID] = sizeof(Oid),
+	[COPY_BINARY_INT8] = sizeof(int64),
+	[COPY_BINARY_FLOAT4] = sizeof(float4),
+	[COPY_BINARY_FLOAT8] = sizeof(float8),
+	[COPY_BINARY_DATE] = sizeof(DateADT),
+	[COPY_BINARY_TIMESTAMP] = sizeof(Timestamp),
+	[COPY_BINARY_UUID] = UUID_LEN,
+};
+
 static bool CopyReadLine(CopyFromState cstate);
 static bool CopyReadLineText(CopyFromState cstate);
 static int	CopyReadAttributesText(CopyFromState cstate);
 static int	CopyReadAttributesCSV(CopyFromState cstate);
 static Datum CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 									 Oid typioparam, int32 typmod,
-									 bool *isnull);
+									 CopyBinaryFastType fast, bool *isnull);
+static Datum CopyReadBinaryFixedAttribute(CopyFromState cstate,
+										  CopyBinaryFastType fast);
 
 
 /* Low-level communications functions */
@@ -166,6 +203,10 @@ static inline bool CopyGetInt16(CopyFromState cstate, int16 *val);
 static void CopyLoadInputBuf(CopyFromState cstate);
 static int	CopyReadBinaryData(CopyFromState cstate, char *dest, int nbytes);
 
+static inline void CopyAddSpecialChar(CopySpecialChars *sc, char c);
+static inline int CopySkipOrdinaryBytes(const CopySpecialChars *sc,
+										const char *s, int len);
+
 void
 ReceiveCopyBegin(CopyFromState cstate)
 {
@@ -752,6 +793,35 @@ CopyReadBinaryData(CopyFromState cstate, char *dest, int nbytes)
  */
 bool
 NextCopyFromRawFields(CopyFromState cstate, char ***fields, int *nfields)
+{
+	int			fldct;
+
+	/* read the next line into line_buf */
+	if (!CopyFromReadLine(cstate, NULL))
+		return false;
+
+	/* Parse the line into de-escaped field values */
+	if (cstate->opts.csv_mode)
+		fldct = CopyReadAttributesCSV(cstate);
+	else
+		fldct = CopyReadAttributesText(cstate);
+
+	*fields = cstate->raw_fields;
+	*nfields = fldct;
+	return true;
+}
+
+/*
+ * Read the next input line into line_buf, checking the header line first if
+ * needed.  Return false if no more lines.
+ *
+ * If 'prev_lineno' isn't NULL, it is set to the line number preceding the
+ * line read.  Parallel COPY FROM uses this function directly to split the
+ * input into lines without parsing them into fields, and passes that number
+ * to CopyFromRestartInput() in the worker that parses the line.
+ */
+bool
+CopyFromReadLine(CopyFromState cstate, uint64 *prev_lineno)
 {
 	int			fldct;
 	bool		done;
@@ -815,6 +885,8 @@ NextCopyFromRawFields(CopyFromState cstate, char ***fields, int *nfields)
 			return false;
 	}
 
+	if (prev_lineno)
+		*prev_lineno = cstate->cur_lineno;
 	cstate->cur_lineno++;
 
 	/* Actually read the line into memory here */
@@ -828,17 +900,30 @@ NextCopyFromRawFields(CopyFromState cstate, char ***fields, int *nfields)
 	if (done && cstate->line_buf.len == 0)
 		return false;
 
-	/* Parse the line into de-escaped field values */
-	if (cstate->opts.csv_mode)
-		fldct = CopyReadAttributesCSV(cstate);
-	else
-		fldct = CopyReadAttributesText(cstate);
-
-	*fields = cstate->raw_fields;
-	*nfields = fldct;
 	return true;
 }
 
+/*
+ * Prepare to read a fresh stream of input from the data source callback,
+ * after it has reported EOF for the previous one.  'lineno' is the line
+ * number of the line preceding the new input, for error messages.
+ *
+ * Parallel COPY FROM workers use this to read each chunk of lines sent by
+ * the leader as if it were a separate file.
+ */
+void
+CopyFromRestartInput(CopyFromState cstate, uint64 lineno)
+{
+	Assert(cstate->copy_src == COPY_CALLBACK);
+
+	cstate->raw_buf_index = cstate->raw_buf_len = 0;
+	cstate->input_buf_index = cstate->input_buf_len = 0;
+	cstate->raw_reached_eof = false;
+	cstate->input_reached_eof = false;
+	cstate->line_buf_valid = false;
+	cstate->cur_lineno = lineno;
+}
+
 /*
  * Read next tuple from file for COPY FROM. Return false if no more tuples.
  *
@@ -873,6 +958,10 @@ NextCopyFrom(CopyFromState cstate, ExprContext *econtext,
 	MemSet(nulls, true, num_phys_attrs * sizeof(bool));
 	MemSet(cstate->defaults, false, num_phys_attrs * sizeof(bool));
 
+	/* Rows already converted by parallel workers need no further work */
+	if (cstate->pcopy)
+		return ParallelCopyFromNext(cstate, values, nulls);
+
 	if (!cstate->opts.binary)
 	{
 		char	  **field_strings;
@@ -1062,6 +1151,7 @@ NextCopyFrom(CopyFromState cstate, ExprContext *econtext,
 												&in_functions[m],
 												typioparams[m],
 												att->atttypmod,
+												cstate->binary_fast[m],
 												&nulls[m]);
 			cstate->cur_attname = NULL;
 		}
@@ -1168,6 +1258,60 @@ CopyReadLine(CopyFromState cstate)
 	return result;
 }
 
+/*
+ * Add c to the set of bytes that CopySkipOrdinaryBytes() must stop at.
+ */
+static inline void
+CopyAddSpecialChar(CopySpecialChars *sc, char c)
+{
+	Assert(sc->nchars < COPY_MAX_SPECIAL_CHARS);
+#ifndef USE_NO_SIMD
+	sc->chars[sc->nchars] = vector8_broadcast((uint8) c);
+#endif
+	sc->nchars++;
+}
+
+/*
+ * Return the number of bytes at the start of s[0..len-1] that are not in
+ * the set sc, examining sizeof(Vector8) bytes at a time.
+ *
+ * Only whole vectors are examined, so the result may fall short of the first
+ * special byte by up to sizeof(Vector8) - 1 bytes near the end of the input;
+ * callers handle the remainder byte by byte, as they would without this.
+ * Without SIMD support this always returns 0.
+ *
+ * All supported server encodings have the property that all bytes in a
+ * multi-byte sequence have the high bit set, so we can't mistake part of a
+ * multibyte character for one of the (ASCII) special characters.
+ */
+static inline int
+CopySkipOrdinaryBytes(const CopySpecialChars *sc, const char *s, int len)
+{
+#ifndef USE_NO_SIMD
+	int			i = 0;
+
+	while (len - i >= (int) sizeof(Vector8))
+	{
+		Vector8		chunk;
+		Vector8		match;
+
+		vector8_load(&chunk, (const uint8 *) s + i);
+		match = vector8_eq(chunk, sc->chars[0]);
+		for (int j = 1; j < sc->nchars; j++)
+			match = vector8_or(match, vector8_eq(chunk, sc->chars[j]));
+
+		if (vector8_is_highbit_set(match))
+			return i + pg_rightmost_one_pos32(vector8_highbit_mask(match));
+
+		i += sizeof(Vector8);
+	}
+
+	return i;
+#else
+	return 0;
+#endif
+}
+
 /*
  * CopyReadLineText - inner loop of CopyReadLine for text mode
  */
@@ -1187,6 +1331,7 @@ CopyReadLineText(CopyFromState cstate)
 				last_was_esc = false;
 	char		quotec = '\0';
 	char		escapec = '\0';
+	CopySpecialChars specials = {0};
 
 	if (cstate->opts.csv_mode)
 	{
@@ -1197,6 +1342,16 @@ CopyReadLineText(CopyFromState cstate)
 			escapec = '\0';
 	}
 
+	/* bytes that the loop below has to look at individually */
+	CopyAddSpecialChar(&specials, '\n');
+	CopyAddSpecialChar(&specials, '\r');
+	CopyAddSpecialChar(&specials, '\\');
+	if (cstate->opts.csv_mode)
+	{
+		CopyAddSpecialChar(&specials, quotec);
+		CopyAddSpecialChar(&specials, escapec);
+	}
+
 	/*
 	 * The objective of this loop is to transfer the entire next input line
 	 * into line_buf.  Hence, we only care for detecting newlines (\r and/or
@@ -1229,6 +1384,7 @@ CopyReadLineText(CopyFromState cstate)
 	for (;;)
 	{
 		int			prev_raw_ptr;
+		int			nskip;
 		char		c;
 
 		/*
@@ -1261,6 +1417,25 @@ CopyReadLineText(CopyFromState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip over any run of bytes that can neither end the line nor affect
+		 * the CSV quoting state.  The only thing they change is that what
+		 * follows is no longer at the start of the line, nor after an escape.
+		 * The skipped bytes stay in input_buf, to be transferred to line_buf
+		 * in bulk like everything else.
+		 */
+		nskip = CopySkipOrdinaryBytes(&specials,
+									  copy_input_buf + input_buf_ptr,
+									  copy_buf_len - input_buf_ptr);
+		if (nskip > 0)
+		{
+			input_buf_ptr += nskip;
+			first_char_in_line = false;
+			last_was_esc = false;
+			if (input_buf_ptr >= copy_buf_len)
+				continue;
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = input_buf_ptr;
 		c = copy_input_buf[input_buf_ptr++];
@@ -1537,6 +1712,7 @@ static int
 CopyReadAttributesText(CopyFromState cstate)
 {
 	char		delimc = cstate->opts.delim[0];
+	CopySpecialChars specials = {0};
 	int			fieldno;
 	char	   *output_ptr;
 	char	   *cur_ptr;
@@ -1572,6 +1748,9 @@ CopyReadAttributesText(CopyFromState cstate)
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
+	CopyAddSpecialChar(&specials, delimc);
+	CopyAddSpecialChar(&specials, '\\');
+
 	/* Outer loop iterates over fields */
 	fieldno = 0;
 	for (;;)
@@ -1608,6 +1787,17 @@ CopyReadAttributesText(CopyFromState cstate)
 		for (;;)
 		{
 			char		c;
+			int			nskip;
+
+			/* copy any run of plain bytes in one go */
+			nskip = CopySkipOrdinaryBytes(&specials, cur_ptr,
+										  line_end_ptr - cur_ptr);
+			if (nskip > 0)
+			{
+				memcpy(output_ptr, cur_ptr, nskip);
+				output_ptr += nskip;
+				cur_ptr += nskip;
+			}
 
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
@@ -1793,6 +1983,8 @@ CopyReadAttributesCSV(CopyFromState cstate)
 	char		delimc = cstate->opts.delim[0];
 	char		quotec = cstate->opts.quote[0];
 	char		escapec = cstate->opts.escape[0];
+	CopySpecialChars unquoted_specials = {0};
+	CopySpecialChars quoted_specials = {0};
 	int			fieldno;
 	char	   *output_ptr;
 	char	   *cur_ptr;
@@ -1828,6 +2020,11 @@ CopyReadAttributesCSV(CopyFromState cstate)
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
+	CopyAddSpecialChar(&unquoted_specials, delimc);
+	CopyAddSpecialChar(&unquoted_specials, quotec);
+	CopyAddSpecialChar(&quoted_specials, quotec);
+	CopyAddSpecialChar(&quoted_specials, escapec);
+
 	/* Outer loop iterates over fields */
 	fieldno = 0;
 	for (;;)
@@ -1864,6 +2061,17 @@ CopyReadAttributesCSV(CopyFromState cstate)
 			/* Not in quote */
 			for (;;)
 			{
+				int			nskip;
+
+				nskip = CopySkipOrdinaryBytes(&unquoted_specials, cur_ptr,
+											  line_end_ptr - cur_ptr);
+				if (nskip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nskip);
+					output_ptr += nskip;
+					cur_ptr += nskip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -1887,6 +2095,17 @@ CopyReadAttributesCSV(CopyFromState cstate)
 			/* In quote */
 			for (;;)
 			{
+				int			nskip;
+
+				nskip = CopySkipOrdinaryBytes(&quoted_specials, cur_ptr,
+											  line_end_ptr - cur_ptr);
+				if (nskip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nskip);
+					output_ptr += nskip;
+					cur_ptr += nskip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -1985,7 +2204,7 @@ endfield:
 static Datum
 CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 						Oid typioparam, int32 typmod,
-						bool *isnull)
+						CopyBinaryFastType fast, bool *isnull)
 {
 	int32		fld_size;
 	Datum		result;
@@ -2004,6 +2223,17 @@ CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
 				 errmsg("invalid field size")));
 
+	/*
+	 * Decode fixed-width types directly, if the field has the right size.
+	 * Otherwise let the receive function complain.
+	 */
+	if (fast != COPY_BINARY_RECV &&
+		fld_size == CopyBinaryFastTypeSize[fast])
+	{
+		*isnull = false;
+		return CopyReadBinaryFixedAttribute(cstate, fast);
+	}
+
 	/* reset attribute_buf to empty, and load raw data in it */
 	resetStringInfo(&cstate->attribute_buf);
 
@@ -2030,3 +2260,113 @@ CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 	*isnull = false;
 	return result;
 }
+
+/*
+ * Decode a field of a fixed-width type, bypassing the receive function.  The
+ * checks must match those of the receive function, see
+ * CopyGetBinaryFastType().
+ */
+static Datum
+CopyReadBinaryFixedAttribute(CopyFromState cstate, CopyBinaryFastType fast)
+{
+	int			fld_size = CopyBinaryFastTypeSize[fast];
+	char		localbuf[UUID_LEN];
+	const char *data;
+	uint16		val16;
+	uint32		val32;
+	uint64		val64;
+
+	/* Use the bytes in place if they are all in raw_buf already */
+	if (RAW_BUF_BYTES(cstate) >= fld_size)
+	{
+		data = cstate->raw_buf + cstate->raw_buf_index;
+		cstate->raw_buf_index += fld_size;
+	}
+	else
+	{
+		if (CopyReadBinaryData(cstate, localbuf, fld_size) != fld_size)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("unexpected EOF in COPY data")));
+		data = localbuf;
+	}
+
+	switch (fast)
+	{
+		case COPY_BINARY_BOOL:
+			return BoolGetDatum(*data != 0);
+		case COPY_BINARY_INT2:
+			memcpy(&val16, data, sizeof(val16));
+			return Int16GetDatum((int16) pg_ntoh16(val16));
+		case COPY_BINARY_INT4:
+			memcpy(&val32, data, sizeof(val32));
+			return Int32GetDatum((int32) pg_ntoh32(val32));
+		case COPY_BINARY_OID:
+			memcpy(&val32, data, sizeof(val32));
+			return ObjectIdGetDatum((Oid) pg_ntoh32(val32));
+		case COPY_BINARY_INT8:
+			memcpy(&val64, data, sizeof(val64));
+			return Int64GetDatum((int64) pg_ntoh64(val64));
+		case COPY_BINARY_FLOAT4:
+			{
+				union
+				{
+					float4		f;
+					uint32		i;
+				}			swap;
+
+				memcpy(&val32, data, sizeof(val32));
+				swap.i = pg_ntoh32(val32);
+				return Float4GetDatum(swap.f);
+			}
+		case COPY_BINARY_FLOAT8:
+			{
+				union
+				{
+					float8		f;
+					uint64		i;
+				}			swap;
+
+				memcpy(&val64, data, sizeof(val64));
+				swap.i = pg_ntoh64(val64);
+				return Float8GetDatum(swap.f);
+			}
+		case COPY_BINARY_DATE:
+			{
+				DateADT		date;
+
+				memcpy(&val32, data, sizeof(val32));
+				date = (DateADT) pg_ntoh32(val32);
+				if (!DATE_NOT_FINITE(date) && !IS_VALID_DATE(date))
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("date out of range")));
+				return DateADTGetDatum(date);
+			}
+		case COPY_BINARY_TIMESTAMP:
+			{
+				Timestamp	timestamp;
+
+				memcpy(&val64, data, sizeof(val64));
+				timestamp = (Timestamp) pg_ntoh64(val64);
+				if (!TIMESTAMP_NOT_FINITE(timestamp) &&
+					!IS_VALID_TIMESTAMP(timestamp))
+					ereport(ERROR,
+							(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+							 errmsg("timestamp out of range")));
+				return TimestampGetDatum(timestamp);
+			}
+		case COPY_BINARY_UUID:
+			{
+				pg_uuid_t  *uuid = (pg_uuid_t *) palloc(sizeof(pg_uuid_t));
+
+				memcpy(uuid->data, data, UUID_LEN);
+				return UUIDPGetDatum(uuid);
+			}
+		case COPY_BINARY_RECV:
+			break;
+	}
+
+	elog(ERROR, "unexpected binary COPY fast path type: %d", (int) fast);
+	return (Datum) 0;			/* keep compiler quiet */
+}
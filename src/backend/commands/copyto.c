@@ -29,8 +29,12 @@
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "port/pg_bswap.h"
+#include "port/simd.h"
 #include "storage/fd.h"
 #include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
@@ -47,6 +51,28 @@ typedef enum CopyDest
 	COPY_CALLBACK,				/* to callback function */
 } CopyDest;
 
+/*
+ * Columns of some common types are converted to output format inline,
+ * instead of calling their output or send function through fmgr.  The
+ * results must be exactly what those functions would produce.
+ */
+typedef enum CopyOutFastPath
+{
+	COPY_OUT_FMGR = 0,			/* no fast path; call the function */
+	COPY_OUT_INT2,
+	COPY_OUT_INT4,
+	COPY_OUT_INT8,
+	COPY_OUT_OID,
+	COPY_OUT_FLOAT4,			/* binary format only */
+	COPY_OUT_FLOAT8,			/* binary format only */
+} CopyOutFastPath;
+
+/*
+ * When writing to a file, rows are collected in fe_msgbuf until it holds at
+ * least this many bytes, to save on stdio calls.
+ */
+#define COPY_FILE_FLUSH_SIZE	65536
+
 /*
  * This struct contains all the state variables used throughout a COPY TO
  * operation.
@@ -90,8 +116,11 @@ typedef struct CopyToStateData
 	MemoryContext copycontext;	/* per-copy execution context */
 
 	FmgrInfo   *out_functions;	/* lookup info for output functions */
+	CopyOutFastPath *out_fastpath;	/* per-column fast path, if any */
+	bool		escape_digits;	/* must integers be escaped in text mode? */
 	MemoryContext rowcontext;	/* per-row evaluation context */
 	uint64		bytes_processed;	/* number of bytes processed so far */
+	int			row_start;		/* offset of current row in fe_msgbuf */
 } CopyToStateData;
 
 /* DestReceiver for COPY (query) TO */
@@ -109,6 +138,7 @@ static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
 /* non-export function prototypes */
 static void EndCopy(CopyToState cstate);
 static void ClosePipeToProgram(CopyToState cstate);
+static CopyOutFastPath CopyGetOutFastPath(Oid out_func_oid);
 static void CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot);
 static void CopyAttributeOutText(CopyToState cstate, const char *string);
 static void CopyAttributeOutCSV(CopyToState cstate, const char *string,
@@ -121,6 +151,7 @@ static void CopySendData(CopyToState cstate, const void *databuf, int datasize);
 static void CopySendString(CopyToState cstate, const char *str);
 static void CopySendChar(CopyToState cstate, char c);
 static void CopySendEndOfRow(CopyToState cstate);
+static void CopyFlushToFile(CopyToState cstate);
 static void CopySendInt32(CopyToState cstate, int32 val);
 static void CopySendInt16(CopyToState cstate, int16 val);
 
@@ -160,7 +191,9 @@ SendCopyEnd(CopyToState cstate)
  * CopySendString does the same for null-terminated strings
  * CopySendChar does the same for single characters
  * CopySendEndOfRow does the appropriate thing at end of each data row
- *	(data is not actually flushed except by CopySendEndOfRow)
+ *	(data is not actually flushed except by CopySendEndOfRow, which may
+ *	collect several rows before writing to a file; CopyFlushToFile writes
+ *	out whatever is left)
  *
  * NB: no data conversion is applied by these functions
  *----------
@@ -200,39 +233,6 @@ CopySendEndOfRow(CopyToState cstate)
 				CopySendString(cstate, "\r\n");
 #endif
 			}
-
-			if (fwrite(fe_msgbuf->data, fe_msgbuf->len, 1,
-					   cstate->copy_file) != 1 ||
-				ferror(cstate->copy_file))
-			{
-				if (cstate->is_program)
-				{
-					if (errno == EPIPE)
-					{
-						/*
-						 * The pipe will be closed automatically on error at
-						 * the end of transaction, but we might get a better
-						 * error message from the subprocess' exit code than
-						 * just "Broken Pipe"
-						 */
-						ClosePipeToProgram(cstate);
-
-						/*
-						 * If ClosePipeToProgram() didn't throw an error, the
-						 * program terminated normally, but closed the pipe
-						 * first. Restore errno, and throw an error.
-						 */
-						errno = EPIPE;
-					}
-					ereport(ERROR,
-							(errcode_for_file_access(),
-							 errmsg("could not write to COPY program: %m")));
-				}
-				else
-					ereport(ERROR,
-							(errcode_for_file_access(),
-							 errmsg("could not write to COPY file: %m")));
-			}
 			break;
 		case COPY_FRONTEND:
 			/* The FE/BE protocol uses \n as newline for all platforms */
@@ -248,10 +248,72 @@ CopySendEndOfRow(CopyToState cstate)
 	}
 
 	/* Update the progress */
-	cstate->bytes_processed += fe_msgbuf->len;
+	cstate->bytes_processed += fe_msgbuf->len - cstate->row_start;
 	pgstat_progress_update_param(PROGRESS_COPY_BYTES_PROCESSED, cstate->bytes_processed);
 
+	/*
+	 * Rows going to a file are written out in batches.  Other destinations
+	 * expect each row as a separate message, and got it above.
+	 */
+	if (cstate->copy_dest == COPY_FILE)
+	{
+		if (fe_msgbuf->len < COPY_FILE_FLUSH_SIZE)
+		{
+			cstate->row_start = fe_msgbuf->len;
+			return;
+		}
+		CopyFlushToFile(cstate);
+	}
+
+	resetStringInfo(fe_msgbuf);
+	cstate->row_start = 0;
+}
+
+/*
+ * Write out the rows collected in fe_msgbuf to the file or program.
+ */
+static void
+CopyFlushToFile(CopyToState cstate)
+{
+	StringInfo	fe_msgbuf = cstate->fe_msgbuf;
+
+	Assert(cstate->copy_dest == COPY_FILE);
+
+	if (fe_msgbuf->len > 0 &&
+		(fwrite(fe_msgbuf->data, fe_msgbuf->len, 1,
+				cstate->copy_file) != 1 ||
+		 ferror(cstate->copy_file)))
+	{
+		if (cstate->is_program)
+		{
+			if (errno == EPIPE)
+			{
+				/*
+				 * The pipe will be closed automatically on error at the end
+				 * of transaction, but we might get a better error message
+				 * from the subprocess' exit code than just "Broken Pipe"
+				 */
+				ClosePipeToProgram(cstate);
+
+				/*
+				 * If ClosePipeToProgram() didn't throw an error, the program
+				 * terminated normally, but closed the pipe first. Restore
+				 * errno, and throw an error.
+				 */
+				errno = EPIPE;
+			}
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to COPY program: %m")));
+		}
+		else
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to COPY file: %m")));
+	}
+
 	resetStringInfo(fe_msgbuf);
+	cstate->row_start = 0;
 }
 
 /*
@@ -763,6 +825,8 @@ DoCopyTo(CopyToState cstate)
 
 	/* Get info about the columns we need to process. */
 	cstate->out_functions = (FmgrInfo *) palloc(num_phys_attrs * sizeof(FmgrInfo));
+	cstate->out_fastpath = (CopyOutFastPath *)
+		palloc0(num_phys_attrs * sizeof(CopyOutFastPath));
 	foreach(cur, cstate->attnumlist)
 	{
 		int			attnum = lfirst_int(cur);
@@ -779,8 +843,15 @@ DoCopyTo(CopyToState cstate)
 							  &out_func_oid,
 							  &isvarlena);
 		fmgr_info(out_func_oid, &cstate->out_functions[attnum - 1]);
+		cstate->out_fastpath[attnum - 1] = CopyGetOutFastPath(out_func_oid);
 	}
 
+	/*
+	 * Integers consist of digits and '-', and the delimiter cannot be a digit
+	 * in text mode.  Unless it is '-', they need no escaping.
+	 */
+	cstate->escape_digits = (cstate->opts.delim[0] == '-');
+
 	/*
 	 * Create a temporary memory context that we can reset once per row to
 	 * recover palloc'd memory.  This avoids any problems with leaks inside
@@ -887,6 +958,10 @@ DoCopyTo(CopyToState cstate)
 		CopySendEndOfRow(cstate);
 	}
 
+	/* Write out any rows still buffered for a file */
+	if (cstate->copy_dest == COPY_FILE)
+		CopyFlushToFile(cstate);
+
 	MemoryContextDelete(cstate->rowcontext);
 
 	if (fe_copy)
@@ -895,6 +970,123 @@ DoCopyTo(CopyToState cstate)
 	return processed;
 }
 
+/*
+ * Identify the fast path, if any, that can replace a call of the given
+ * output or send function.
+ */
+static CopyOutFastPath
+CopyGetOutFastPath(Oid out_func_oid)
+{
+	switch (out_func_oid)
+	{
+		case F_INT2OUT:
+		case F_INT2SEND:
+			return COPY_OUT_INT2;
+		case F_INT4OUT:
+		case F_INT4SEND:
+			return COPY_OUT_INT4;
+		case F_INT8OUT:
+		case F_INT8SEND:
+			return COPY_OUT_INT8;
+		case F_OIDOUT:
+		case F_OIDSEND:
+			return COPY_OUT_OID;
+		case F_FLOAT4SEND:
+			return COPY_OUT_FLOAT4;
+		case F_FLOAT8SEND:
+			return COPY_OUT_FLOAT8;
+		default:
+			return COPY_OUT_FMGR;
+	}
+}
+
+/*
+ * Try to send the text representation of an integer column's value without
+ * calling its output function.  Returns false if the column has no such
+ * fast path.
+ */
+static inline bool
+CopyAttributeOutTextFast(CopyToState cstate, CopyOutFastPath fastpath,
+						 Datum value, bool use_quote)
+{
+	char		buf[MAXINT8LEN + 1];
+	int			len;
+
+	switch (fastpath)
+	{
+		case COPY_OUT_INT2:
+			len = pg_itoa(DatumGetInt16(value), buf);
+			break;
+		case COPY_OUT_INT4:
+			len = pg_ltoa(DatumGetInt32(value), buf);
+			break;
+		case COPY_OUT_INT8:
+			len = pg_lltoa(DatumGetInt64(value), buf);
+			break;
+		case COPY_OUT_OID:
+			len = pg_ultoa_n(DatumGetObjectId(value), buf);
+			buf[len] = '\0';
+			break;
+		default:
+			return false;
+	}
+
+	if (cstate->opts.csv_mode)
+		CopyAttributeOutCSV(cstate, buf, use_quote);
+	else if (cstate->escape_digits)
+		CopyAttributeOutText(cstate, buf);
+	else
+	{
+		/* digits and '-' are the same in every client encoding */
+		CopySendData(cstate, buf, len);
+	}
+
+	return true;
+}
+
+/*
+ * Try to send the binary representation of a column's value without calling
+ * its send function.  Returns false if the column has no such fast path.
+ */
+static inline bool
+CopyAttributeOutBinaryFast(CopyToState cstate, CopyOutFastPath fastpath,
+						   Datum value)
+{
+	switch (fastpath)
+	{
+		case COPY_OUT_INT2:
+			CopySendInt32(cstate, sizeof(int16));
+			CopySendInt16(cstate, DatumGetInt16(value));
+			break;
+		case COPY_OUT_INT4:
+			CopySendInt32(cstate, sizeof(int32));
+			CopySendInt32(cstate, DatumGetInt32(value));
+			break;
+		case COPY_OUT_OID:
+			CopySendInt32(cstate, sizeof(Oid));
+			CopySendInt32(cstate, (int32) DatumGetObjectId(value));
+			break;
+		case COPY_OUT_FLOAT4:
+			CopySendInt32(cstate, sizeof(float4));
+			CopySendInt32(cstate, (int32) DatumGetUInt32(value));
+			break;
+		case COPY_OUT_INT8:
+		case COPY_OUT_FLOAT8:
+			{
+				/* float8 has the same bit layout as its Datum */
+				uint64		buf = pg_hton64((uint64) DatumGetInt64(value));
+
+				CopySendInt32(cstate, sizeof(int64));
+				CopySendData(cstate, &buf, sizeof(buf));
+				break;
+			}
+		default:
+			return false;
+	}
+
+	return true;
+}
+
 /*
  * Emit one row during DoCopyTo().
  */
@@ -941,8 +1133,16 @@ CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot)
 		}
 		else
 		{
+			CopyOutFastPath fastpath = cstate->out_fastpath[attnum - 1];
+
 			if (!cstate->opts.binary)
 			{
+				if (fastpath != COPY_OUT_FMGR &&
+					CopyAttributeOutTextFast(cstate, fastpath, value,
+											 cstate->opts.csv_mode &&
+											 cstate->opts.force_quote_flags[attnum - 1]))
+					continue;
+
 				string = OutputFunctionCall(&out_functions[attnum - 1],
 											value);
 				if (cstate->opts.csv_mode)
@@ -955,6 +1155,10 @@ CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot)
 			{
 				bytea	   *outputbytes;
 
+				if (fastpath != COPY_OUT_FMGR &&
+					CopyAttributeOutBinaryFast(cstate, fastpath, value))
+					continue;
+
 				outputbytes = SendFunctionCall(&out_functions[attnum - 1],
 											   value);
 				CopySendInt32(cstate, VARSIZE(outputbytes) - VARHDRSZ);
@@ -1067,9 +1271,31 @@ CopyAttributeOutText(CopyToState cstate, const char *string)
 	}
 	else
 	{
+		const char *end = ptr + strlen(ptr);
+
 		start = ptr;
-		while ((c = *ptr) != '\0')
+		while (ptr < end)
 		{
+			/*
+			 * Most text needs no escaping at all, so skip over whole vectors
+			 * of bytes that contain no control character, backslash or
+			 * delimiter.
+			 */
+			if (end - ptr >= sizeof(Vector8))
+			{
+				Vector8		chunk;
+
+				vector8_load(&chunk, (const uint8 *) ptr);
+				if (!vector8_has_le(chunk, 0x1f) &&
+					!vector8_has(chunk, '\\') &&
+					!vector8_has(chunk, (uint8) delimc))
+				{
+					ptr += sizeof(Vector8);
+					continue;
+				}
+			}
+
+			c = *ptr;
 			if ((unsigned char) c < (unsigned char) 0x20)
 			{
 				/*
@@ -29,6 +29,7 @@
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_am.h"
 #include "catalog/toasting.h"
 #include "commands/createas.h"
 #include "commands/matview.h"
@@ -56,6 +57,8 @@ typedef struct
 	CommandId	output_cid;		/* cmin to insert in output tuples */
 	int			ti_options;		/* table_tuple_insert performance options */
 	BulkInsertState bistate;	/* bulk insert state */
+	GatherState *parallel_gather;	/* top Gather whose workers may insert
+									 * into rel themselves, or NULL */
 } DR_intorel;
 
 /* utility functions for CTAS definition creation */
@@ -64,6 +67,9 @@ static ObjectAddress create_ctas_nodata(List *tlist, IntoClause *into);
 
 /* DestReceiver routines for collecting data */
 static void intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
+static void intorel_startup_parallel(DestReceiver *self, int operation,
+									 TupleDesc typeinfo);
+static bool intorel_parallel_insert_ok(Relation rel);
 static bool intorel_receive(TupleTableSlot *slot, DestReceiver *self);
 static void intorel_shutdown(DestReceiver *self);
 static void intorel_destroy(DestReceiver *self);
@@ -137,6 +143,8 @@ create_ctas_internal(List *attrList, IntoClause *into)
 
 		StoreViewQuery(intoRelationAddr.objectId, query, false);
 		CommandCounterIncrement();
+
+		CreateIncrementalMatViewTriggers(intoRelationAddr.objectId);
 	}
 
 	return intoRelationAddr;
@@ -327,6 +335,17 @@ ExecCreateTableAs(ParseState *pstate, CreateTableAsStmt *stmt,
 		/* call ExecutorStart to prepare the plan for execution */
 		ExecutorStart(queryDesc, GetIntoRelEFlags(into));
 
+		/*
+		 * If the plan's top node is a Gather that passes on its workers'
+		 * tuples unchanged, the workers might insert them into the new table
+		 * themselves; intorel_startup decides once the table exists.
+		 */
+		if (IsA(queryDesc->planstate, GatherState) &&
+			queryDesc->planstate->ps_ProjInfo == NULL &&
+			queryDesc->estate->es_junkFilter == NULL)
+			((DR_intorel *) dest)->parallel_gather =
+				(GatherState *) queryDesc->planstate;
+
 		/* run the plan to completion */
 		ExecutorRun(queryDesc, ForwardScanDirection, 0, true);
 
@@ -447,6 +466,26 @@ CreateIntoRelDestReceiver(IntoClause *intoClause)
 	return (DestReceiver *) self;
 }
 
+/*
+ * CreateParallelIntoRelDestReceiver -- create a DestReceiver for a parallel
+ * worker inserting into a table that the leader created already
+ */
+DestReceiver *
+CreateParallelIntoRelDestReceiver(Oid relid)
+{
+	DR_intorel *self = (DR_intorel *) palloc0(sizeof(DR_intorel));
+
+	self->pub.receiveSlot = intorel_receive;
+	self->pub.rStartup = intorel_startup_parallel;
+	self->pub.rShutdown = intorel_shutdown;
+	self->pub.rDestroy = intorel_destroy;
+	self->pub.mydest = DestIntoRel;
+	self->into = makeNode(IntoClause);
+	ObjectAddressSet(self->reladdr, RelationRelationId, relid);
+
+	return (DestReceiver *) self;
+}
+
 /*
  * intorel_startup --- executor startup
  */
@@ -569,6 +608,47 @@ intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 	 * This may be harmless, but this function hasn't planned for it.
 	 */
 	Assert(RelationGetTargetBlock(intoRelationDesc) == InvalidBlockNumber);
+
+	/* Let the workers of the top Gather node insert, if they can */
+	if (myState->parallel_gather != NULL && !into->skipData &&
+		intorel_parallel_insert_ok(intoRelationDesc))
+		myState->parallel_gather->into_relid = intoRelationAddr.objectId;
+}
+
+/*
+ * intorel_startup_parallel --- executor startup in a parallel worker
+ */
+static void
+intorel_startup_parallel(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	DR_intorel *myState = (DR_intorel *) self;
+
+	/* The leader holds AccessExclusiveLock already; see intorel_startup */
+	myState->rel = table_open(myState->reladdr.objectId, RowExclusiveLock);
+	myState->output_cid = GetCurrentCommandId(true);
+	myState->ti_options = TABLE_INSERT_SKIP_FSM;
+	myState->bistate = GetBulkInsertState();
+}
+
+/*
+ * intorel_parallel_insert_ok --- can parallel workers insert into rel?
+ *
+ * Workers cannot see a temporary table's local buffers, and only heap is
+ * known to cope with several processes of a lock group inserting at once.
+ * We also insist that a permanent table be WAL-logged: a worker does not
+ * know that the table was created in this transaction, so it would log its
+ * inserts even where the leader skips WAL for the new relfilenumber.
+ */
+static bool
+intorel_parallel_insert_ok(Relation rel)
+{
+	if (RelationUsesLocalBuffers(rel))
+		return false;
+	if (rel->rd_rel->relam != HEAP_TABLE_AM_OID)
+		return false;
+	if (RelationIsPermanent(rel) && !RelationNeedsWAL(rel))
+		return false;
+	return true;
 }
 
 /*
@@ -1608,6 +1608,7 @@ createdb_failure_callback(int code, Datum arg)
 	if (fparms->strategy == CREATEDB_WAL_LOG)
 	{
 		DropDatabaseBuffers(fparms->dest_dboid);
+		RelSizeCacheForgetDatabase(fparms->dest_dboid);
 		ForgetDatabaseSyncRequests(fparms->dest_dboid);
 
 		/* Release lock on the target database. */
@@ -1808,9 +1809,11 @@ dropdb(const char *dbname, bool missing_ok, bool force)
 	/*
 	 * Drop pages for this database that are in the shared buffer cache. This
 	 * is important to ensure that no remaining backend tries to write out a
-	 * dirty buffer to the dead database later...
+	 * dirty buffer to the dead database later...  Cached relation sizes
+	 * must go as well, in case the database OID is reused.
 	 */
 	DropDatabaseBuffers(db_id);
+	RelSizeCacheForgetDatabase(db_id);
 
 	/*
 	 * Tell checkpointer to forget any pending fsync and unlink requests for
@@ -2090,9 +2093,11 @@ movedb(const char *dbname, const char *tblspcname)
 	 * buffers that should never be used again seems worth the cycles.
 	 *
 	 * Note: it'd be sufficient to get rid of buffers matching db_id and
-	 * src_tblspcoid, but bufmgr.c presently provides no API for that.
+	 * src_tblspcoid, but bufmgr.c presently provides no API for that.  The
+	 * same goes for cached relation sizes.
 	 */
 	DropDatabaseBuffers(db_id);
+	RelSizeCacheForgetDatabase(db_id);
 
 	/*
 	 * Check for existence of files in the target directory, i.e., objects of
@@ -3372,6 +3377,7 @@ dbase_redo(XLogReaderState *record)
 
 		/* Drop pages for this database that are in the shared buffer cache */
 		DropDatabaseBuffers(xlrec->db_id);
+		RelSizeCacheForgetDatabase(xlrec->db_id);
 
 		/* Also, clean out any fsync requests that might be pending in md.c */
 		ForgetDatabaseSyncRequests(xlrec->db_id);
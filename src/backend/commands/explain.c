@@ -113,6 +113,8 @@ static void show_grouping_set_keys(PlanState *planstate,
 								   List *ancestors, ExplainState *es);
 static void show_group_keys(GroupState *gstate, List *ancestors,
 							ExplainState *es);
+static void show_repartition_keys(RepartitionState *rstate, List *ancestors,
+								  ExplainState *es);
 static void show_sort_group_keys(PlanState *planstate, const char *qlabel,
 								 int nkeys, int nPresortedKeys, AttrNumber *keycols,
 								 Oid *sortOperators, Oid *collations, bool *nullsFirst,
@@ -137,6 +139,8 @@ static const char *explain_get_index_name(Oid indexId);
 static bool peek_buffer_usage(ExplainState *es, const BufferUsage *usage);
 static void show_buffer_usage(ExplainState *es, const BufferUsage *usage);
 static void show_wal_usage(ExplainState *es, const WalUsage *usage);
+static void show_hwcounter_usage(ExplainState *es,
+								 const HwCounterUsage *usage);
 static void show_memory_counters(ExplainState *es,
 								 const MemoryContextCounters *mem_counters);
 static void ExplainIndexScanDetails(Oid indexid, ScanDirection indexorderdir,
@@ -206,6 +210,8 @@ ExplainQuery(ParseState *pstate, ExplainStmt *stmt,
 			es->buffers = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "wal") == 0)
 			es->wal = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "hwcounters") == 0)
+			es->hwcounters = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "settings") == 0)
 			es->settings = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "generic_plan") == 0)
@@ -280,6 +286,12 @@ ExplainQuery(ParseState *pstate, ExplainStmt *stmt,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("EXPLAIN option WAL requires ANALYZE")));
 
+	/* check that HWCOUNTERS is used with EXPLAIN ANALYZE */
+	if (es->hwcounters && !es->analyze)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("EXPLAIN option HWCOUNTERS requires ANALYZE")));
+
 	/* if the timing was not set explicitly, set default value */
 	es->timing = (timing_set) ? es->timing : es->analyze;
 
@@ -638,6 +650,12 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 		instrument_option |= INSTRUMENT_BUFFERS;
 	if (es->wal)
 		instrument_option |= INSTRUMENT_WAL;
+	if (es->hwcounters)
+	{
+		/* fail now, rather than silently reporting zeroes */
+		InstrHwCountersInit();
+		instrument_option |= INSTRUMENT_HWCOUNTERS;
+	}
 
 	/*
 	 * We always collect timing for the entire statement, even when node-level
@@ -1041,6 +1059,14 @@ ExplainPrintJIT(ExplainState *es, int jit_flags, JitInstrumentation *ji)
 						 "Expressions", jit_flags & PGJIT_EXPR ? "true" : "false",
 						 "Deforming", jit_flags & PGJIT_DEFORM ? "true" : "false");
 
+		if (ji->cache_hits + ji->cache_misses > 0)
+		{
+			ExplainIndentText(es);
+			appendStringInfo(es->str, "Cache: %s %zu, %s %zu\n",
+							 "Hits", ji->cache_hits,
+							 "Misses", ji->cache_misses);
+		}
+
 		if (es->analyze && es->timing)
 		{
 			ExplainIndentText(es);
@@ -1067,6 +1093,14 @@ ExplainPrintJIT(ExplainState *es, int jit_flags, JitInstrumentation *ji)
 		ExplainPropertyBool("Deforming", jit_flags & PGJIT_DEFORM, es);
 		ExplainCloseGroup("Options", "Options", true, es);
 
+		if (ji->cache_hits + ji->cache_misses > 0)
+		{
+			ExplainOpenGroup("Cache", "Cache", true, es);
+			ExplainPropertyInteger("Hits", NULL, ji->cache_hits, es);
+			ExplainPropertyInteger("Misses", NULL, ji->cache_misses, es);
+			ExplainCloseGroup("Cache", "Cache", true, es);
+		}
+
 		if (es->analyze && es->timing)
 		{
 			ExplainOpenGroup("Timing", "Timing", true, es);
@@ -1533,6 +1567,9 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		case T_Memoize:
 			pname = sname = "Memoize";
 			break;
+		case T_Repartition:
+			pname = sname = "Repartition";
+			break;
 		case T_Sort:
 			pname = sname = "Sort";
 			break;
@@ -2252,6 +2289,10 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			show_memoize_info(castNode(MemoizeState, planstate), ancestors,
 							  es);
 			break;
+		case T_Repartition:
+			show_repartition_keys(castNode(RepartitionState, planstate),
+								  ancestors, es);
+			break;
 		default:
 			break;
 	}
@@ -2276,14 +2317,17 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		}
 	}
 
-	/* Show buffer/WAL usage */
+	/* Show buffer/WAL usage and hardware counters */
 	if (es->buffers && planstate->instrument)
 		show_buffer_usage(es, &planstate->instrument->bufusage);
 	if (es->wal && planstate->instrument)
 		show_wal_usage(es, &planstate->instrument->walusage);
+	if (es->hwcounters && planstate->instrument)
+		show_hwcounter_usage(es, &planstate->instrument->hwcounters);
 
-	/* Prepare per-worker buffer/WAL usage */
-	if (es->workers_state && (es->buffers || es->wal) && es->verbose)
+	/* Prepare per-worker buffer/WAL usage and hardware counters */
+	if (es->workers_state && (es->buffers || es->wal || es->hwcounters) &&
+		es->verbose)
 	{
 		WorkerInstrumentation *w = planstate->worker_instrument;
 
@@ -2300,6 +2344,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 				show_buffer_usage(es, &instrument->bufusage);
 			if (es->wal)
 				show_wal_usage(es, &instrument->walusage);
+			if (es->hwcounters)
+				show_hwcounter_usage(es, &instrument->hwcounters);
 			ExplainCloseWorker(n, es);
 		}
 	}
@@ -2749,6 +2795,24 @@ show_group_keys(GroupState *gstate, List *ancestors,
 	ancestors = list_delete_first(ancestors);
 }
 
+/*
+ * Show the partitioning keys for a Repartition node.
+ */
+static void
+show_repartition_keys(RepartitionState *rstate, List *ancestors,
+					  ExplainState *es)
+{
+	Repartition *plan = (Repartition *) rstate->ps.plan;
+
+	/* The key columns refer to the tlist of the child plan */
+	ancestors = lcons(plan, ancestors);
+	show_sort_group_keys(outerPlanState(rstate), "Partition Key",
+						 plan->numCols, 0, plan->partColIdx,
+						 NULL, NULL, NULL,
+						 ancestors, es);
+	ancestors = list_delete_first(ancestors);
+}
+
 /*
  * Common code to show sort/group keys, which are represented in plan nodes
  * as arrays of targetlist indexes.  If it's a sort key rather than a group
@@ -3370,6 +3434,10 @@ show_memoize_info(MemoizeState *mstate, List *ancestors, ExplainState *es)
 		appendStringInfo(es->str, "Cache Mode: %s\n", mstate->binary_mode ? "binary" : "logical");
 	}
 
+	/* Only mention a shared cache if the planner asked for one */
+	if (((Memoize *) plan)->shared_cache)
+		ExplainPropertyBool("Shared Cache", true, es);
+
 	pfree(keystr.data);
 
 	if (!es->analyze)
@@ -3942,6 +4010,46 @@ show_wal_usage(ExplainState *es, const WalUsage *usage)
 	}
 }
 
+/*
+ * Show hardware counters.
+ */
+static void
+show_hwcounter_usage(ExplainState *es, const HwCounterUsage *usage)
+{
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		/* Show nothing for nodes that never ran. */
+		if (usage->cycles > 0)
+		{
+			ExplainIndentText(es);
+			appendStringInfo(es->str, "Hardware: cycles=%lld",
+							 (long long) usage->cycles);
+			if (usage->instructions > 0)
+				appendStringInfo(es->str, " instructions=%lld ipc=%.2f",
+								 (long long) usage->instructions,
+								 (double) usage->instructions / usage->cycles);
+			if (usage->llc_misses > 0)
+				appendStringInfo(es->str, " llc misses=%lld",
+								 (long long) usage->llc_misses);
+			if (usage->branch_misses > 0)
+				appendStringInfo(es->str, " branch misses=%lld",
+								 (long long) usage->branch_misses);
+			appendStringInfoChar(es->str, '\n');
+		}
+	}
+	else
+	{
+		ExplainPropertyInteger("CPU Cycles", NULL,
+							   usage->cycles, es);
+		ExplainPropertyInteger("Instructions", NULL,
+							   usage->instructions, es);
+		ExplainPropertyInteger("LLC Misses", NULL,
+							   usage->llc_misses, es);
+		ExplainPropertyInteger("Branch Misses", NULL,
+							   usage->branch_misses, es);
+	}
+}
+
 /*
  * Show memory usage details.
  */
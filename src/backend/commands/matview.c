@@ -20,26 +20,45 @@
 #include "access/multixact.h"
 #include "access/tableam.h"
 #include "access/xact.h"
+#include "catalog/dependency.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_inherits.h"
 #include "catalog/pg_opclass.h"
+#include "catalog/pg_trigger.h"
 #include "commands/cluster.h"
 #include "commands/matview.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
+#include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/spi.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
+#include "parser/parse_collate.h"
+#include "parser/parse_func.h"
+#include "parser/parser.h"
+#include "parser/parsetree.h"
 #include "pgstat.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/lmgr.h"
 #include "tcop/tcopprot.h"
+#include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
+#include "utils/regproc.h"
 #include "utils/rel.h"
+#include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
+#include "utils/tuplestore.h"
+#include "utils/typcache.h"
 
 
 typedef struct
@@ -921,6 +940,1301 @@ is_usable_unique_index(Relation indexRel)
 }
 
 
+/*
+ * Incremental maintenance
+ *
+ * A materialized view created WITH (incremental_maintenance) is kept up to
+ * date by AFTER ... FOR EACH STATEMENT triggers on each of its base tables.
+ * The trigger evaluates the view's query with the base table replaced by the
+ * statement's transition table, which yields the change to apply to the
+ * view: the rows to remove for deleted tuples, the rows to add for inserted
+ * ones.  For a view with aggregates, the change of each group is folded into
+ * the existing row; that needs a count(*) per group, to tell when a group
+ * becomes empty, and a count() per sum() and avg(), to tell when the result
+ * becomes NULL.  Those are added to the view as hidden columns when it is
+ * created, see PrepareIncrementalMatViewQuery().
+ *
+ * All maintenance of a view is serialized by an ExclusiveLock on it, held
+ * until the end of the transaction.  The changes are computed and applied
+ * with a current snapshot, so a transaction that waited for the lock sees
+ * the base tables as they were when the view was last maintained.
+ *
+ * That only works if the other base tables are unchanged since then.  A
+ * statement that modifies several base tables of a view, through writable
+ * CTEs or triggers, fires the AFTER triggers of each once all of them have
+ * been modified, and the change of each table would be joined with the
+ * others' new contents.  To detect that, BEFORE ... FOR EACH STATEMENT
+ * triggers record the statements in progress on each base table.  When a
+ * statement ends while another base table of the view has one in progress,
+ * the view is recomputed from scratch instead, and once more when the last
+ * of those statements ends.
+ */
+
+/* names of the transition tables of the maintenance triggers */
+#define IVM_OLD_TABLE_NAME	"__ivm_oldtab__"
+#define IVM_NEW_TABLE_NAME	"__ivm_newtab__"
+
+typedef enum IvmColumnKind
+{
+	IVM_COLUMN_PLAIN,			/* an output column, or a grouping column */
+	IVM_COLUMN_COUNT,			/* count(*) or count(expression) */
+	IVM_COLUMN_SUM,				/* sum(expression) */
+	IVM_COLUMN_AVG,				/* avg(expression) */
+	IVM_COLUMN_UNSUPPORTED,		/* any other aggregate */
+} IvmColumnKind;
+
+typedef struct IvmColumn
+{
+	IvmColumnKind kind;
+	const char *name;			/* quoted column name */
+	Oid			typid;			/* column type */
+	Oid			eqop;			/* equality operator, for PLAIN columns */
+	bool		notnull;		/* PLAIN column is known not to be NULL */
+	int			countcol;		/* index of the count(), for SUM and AVG */
+	int			sumcol;			/* index of the sum(), for AVG */
+} IvmColumn;
+
+typedef struct IvmMatView
+{
+	const char *name;			/* qualified, quoted name of the view */
+	Query	   *query;			/* the view's query */
+	bool		hasaggs;		/* does the view aggregate, or group? */
+	int			countstar;		/* index of the count(*) column */
+	int			ncolumns;
+	IvmColumn  *columns;
+	char	   *collist;		/* comma-separated list of column names */
+} IvmMatView;
+
+/* a statement in progress on a base table, see ivm_statement_begin() */
+typedef struct IvmPendingStatement
+{
+	Oid			matviewOid;
+	Oid			relid;			/* the base table */
+	SubTransactionId subxid;	/* subtransaction that started it */
+} IvmPendingStatement;
+
+/*
+ * Statements in progress, and views to recompute at the end of the last one.
+ * Both live in TopTransactionContext, and are forgotten when it's reset.
+ */
+static List *ivm_pending_statements = NIL;
+static List *ivm_recompute_views = NIL;
+static bool ivm_pending_callback_registered = false;
+static MemoryContextCallback ivm_pending_callback;
+
+static Query *ivm_get_view_query(Relation matviewRel);
+static IvmColumnKind ivm_aggregate_kind(Aggref *aggref);
+static TargetEntry *ivm_find_aggregate(List *targetList, IvmColumnKind kind,
+									   Aggref *of);
+static Expr *ivm_make_aggregate(ParseState *pstate, char *aggname, Expr *arg);
+static bool ivm_check_vars_walker(Node *node, void *context);
+static void ivm_unsupported(const char *feature) pg_attribute_noreturn();
+static void ivm_create_trigger(Oid relid, Oid matviewOid, int16 timing,
+							   int16 event);
+static void ivm_statement_begin(Oid matviewOid, Oid relid);
+static bool ivm_statement_end(Oid matviewOid, Oid relid);
+static void ivm_pending_reset(void *arg);
+static IvmMatView *ivm_get_matview(Relation matviewRel);
+static bool ivm_expr_is_notnull(Query *query, Expr *expr);
+static char *ivm_delta_query(IvmMatView *mv, Relation rel,
+							 const char *enrname);
+static void ivm_append_match(StringInfo buf, IvmMatView *mv,
+							 const char *left, const char *right);
+static void ivm_append_set_clause(StringInfo buf, IvmMatView *mv, char op);
+static void ivm_apply_delta(IvmMatView *mv, const char *delta, bool insert);
+static void ivm_recompute(IvmMatView *mv);
+static void ivm_execute(const char *sql, int expected);
+
+/*
+ * PrepareIncrementalMatViewQuery
+ *
+ * Check that the query of a materialized view created WITH
+ * (incremental_maintenance) is one that we know how to maintain, and add
+ * the hidden columns that maintenance requires to its target list.
+ *
+ * Hidden columns that the query already has are not added again, so that
+ * the definition of the view, as printed by pg_dump, produces the same view.
+ */
+void
+PrepareIncrementalMatViewQuery(ParseState *pstate, Query *query)
+{
+	bool		hasaggs;
+	List	   *relids = NIL;
+	List	   *hidden = NIL;
+	ListCell   *lc;
+	ParseExprKind save_expr_kind;
+
+	Assert(query->commandType == CMD_SELECT);
+
+	if (query->cteList != NIL)
+		ivm_unsupported("WITH");
+	if (query->setOperations != NULL)
+		ivm_unsupported("UNION/INTERSECT/EXCEPT");
+	if (query->distinctClause != NIL)
+		ivm_unsupported("DISTINCT");
+	if (query->sortClause != NIL)
+		ivm_unsupported("ORDER BY");
+	if (query->limitCount != NULL || query->limitOffset != NULL)
+		ivm_unsupported("LIMIT/OFFSET");
+	if (query->havingQual != NULL)
+		ivm_unsupported("HAVING");
+	if (query->groupingSets != NIL)
+		ivm_unsupported("GROUPING SETS");
+	if (query->rowMarks != NIL)
+		ivm_unsupported("FOR UPDATE/SHARE");
+	if (query->hasSubLinks)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("subqueries are not supported in incrementally maintained materialized views")));
+	if (query->hasWindowFuncs)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("window functions are not supported in incrementally maintained materialized views")));
+	if (query->hasTargetSRFs)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-returning functions are not supported in incrementally maintained materialized views")));
+
+	/* Only inner joins of plain tables, each referenced once */
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+
+		if (rte->rtekind == RTE_JOIN)
+		{
+			if (rte->jointype != JOIN_INNER)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("outer joins are not supported in incrementally maintained materialized views")));
+			continue;
+		}
+
+		if (rte->rtekind != RTE_RELATION)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("incrementally maintained materialized views can only reference plain tables")));
+		if (rte->relkind != RELKIND_RELATION)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("incrementally maintained materialized views can only reference plain tables"),
+					 errdetail_relkind_not_supported(rte->relkind)));
+		if (rte->tablesample != NULL)
+			ivm_unsupported("TABLESAMPLE");
+		/*
+		 * Changes to a parent or child would not fire the triggers of the
+		 * other, so reject both; CheckIncrementalMatViewInheritance() keeps
+		 * it that way.
+		 */
+		if (has_subclass(rte->relid))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("inheritance is not supported in incrementally maintained materialized views"),
+					 errdetail("Table \"%s\" has inheritance children.",
+							   get_rel_name(rte->relid))));
+		if (has_superclass(rte->relid))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("inheritance is not supported in incrementally maintained materialized views"),
+					 errdetail("Table \"%s\" is an inheritance child.",
+							   get_rel_name(rte->relid))));
+		if (list_member_oid(relids, rte->relid))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("incrementally maintained materialized views cannot reference a table more than once")));
+		relids = lappend_oid(relids, rte->relid);
+
+		/*
+		 * Creating the maintenance triggers will need this lock anyway.  Take
+		 * it now, before the view is populated, so that no changes to the
+		 * table can be missed by both the populating query and the triggers.
+		 */
+		LockRelationOid(rte->relid, ShareRowExclusiveLock);
+	}
+	if (relids == NIL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("incrementally maintained materialized views must reference at least one table")));
+
+	(void) ivm_check_vars_walker((Node *) query->targetList, NULL);
+	(void) ivm_check_vars_walker((Node *) query->jointree, NULL);
+
+	/* Evaluating the query twice must give the same result */
+	if (contain_mutable_functions((Node *) query->targetList) ||
+		contain_mutable_functions((Node *) query->jointree))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("functions in an incrementally maintained materialized view must be marked IMMUTABLE")));
+
+	hasaggs = query->hasAggs || query->groupClause != NIL;
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		/* there's no ORDER BY, so only grouping columns could be junk */
+		if (tle->resjunk)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("grouping columns of an incrementally maintained materialized view must be in its select list")));
+
+		if (IsA(tle->expr, Aggref))
+		{
+			Aggref	   *aggref = (Aggref *) tle->expr;
+
+			if (ivm_aggregate_kind(aggref) == IVM_COLUMN_UNSUPPORTED)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("aggregate function %s is not supported in incrementally maintained materialized views",
+								format_procedure(aggref->aggfnoid))));
+			if (aggref->aggdistinct != NIL || aggref->aggorder != NIL ||
+				aggref->aggfilter != NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("aggregate functions in incrementally maintained materialized views cannot use DISTINCT, ORDER BY or FILTER")));
+			Assert(aggref->agglevelsup == 0);
+		}
+		else if (contain_agg_clause((Node *) tle->expr))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("aggregate functions in incrementally maintained materialized views must be output columns by themselves")));
+		else if (hasaggs)
+		{
+			if (tle->ressortgroupref == 0 ||
+				get_sortgroupref_clause_noerr(tle->ressortgroupref,
+											  query->groupClause) == NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("output columns of an incrementally maintained materialized view with aggregates must be grouping columns or aggregate function calls")));
+		}
+		else
+		{
+			/* rows are matched by value, so we need to compare them */
+			Oid			typid = exprType((Node *) tle->expr);
+			TypeCacheEntry *typentry;
+
+			typentry = lookup_type_cache(typid,
+										 TYPECACHE_EQ_OPR | TYPECACHE_LT_OPR);
+			if (!OidIsValid(typentry->eq_opr))
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_FUNCTION),
+						 errmsg("could not identify an equality operator for type %s",
+								format_type_be(typid))));
+			if (!OidIsValid(typentry->lt_opr))
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_FUNCTION),
+						 errmsg("could not identify an ordering operator for type %s",
+								format_type_be(typid))));
+		}
+	}
+
+	if (!hasaggs)
+		return;
+
+	/* Determine the hidden columns to add */
+	save_expr_kind = pstate->p_expr_kind;
+	pstate->p_expr_kind = EXPR_KIND_SELECT_TARGET;
+
+	if (ivm_find_aggregate(query->targetList, IVM_COLUMN_COUNT, NULL) == NULL)
+		hidden = lappend(hidden,
+						 makeTargetEntry(ivm_make_aggregate(pstate, "count", NULL),
+										 0, pstrdup("__ivm_count__"), false));
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		IvmColumnKind kind;
+		Aggref	   *aggref;
+		Expr	   *arg;
+
+		if (!IsA(tle->expr, Aggref))
+			continue;
+		aggref = (Aggref *) tle->expr;
+		kind = ivm_aggregate_kind(aggref);
+		if (kind != IVM_COLUMN_SUM && kind != IVM_COLUMN_AVG)
+			continue;
+		arg = linitial_node(TargetEntry, aggref->args)->expr;
+
+		if (ivm_find_aggregate(query->targetList, IVM_COLUMN_COUNT, aggref) == NULL &&
+			ivm_find_aggregate(hidden, IVM_COLUMN_COUNT, aggref) == NULL)
+			hidden = lappend(hidden,
+							 makeTargetEntry(ivm_make_aggregate(pstate, "count", arg),
+											 0, psprintf("__ivm_count_%d__", tle->resno),
+											 false));
+
+		if (kind == IVM_COLUMN_AVG &&
+			ivm_find_aggregate(query->targetList, IVM_COLUMN_SUM, aggref) == NULL &&
+			ivm_find_aggregate(hidden, IVM_COLUMN_SUM, aggref) == NULL)
+			hidden = lappend(hidden,
+							 makeTargetEntry(ivm_make_aggregate(pstate, "sum", arg),
+											 0, psprintf("__ivm_sum_%d__", tle->resno),
+											 false));
+	}
+
+	pstate->p_expr_kind = save_expr_kind;
+
+	foreach(lc, hidden)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		tle->resno = list_length(query->targetList) + 1;
+		query->targetList = lappend(query->targetList, tle);
+	}
+	query->hasAggs = true;
+}
+
+/*
+ * CreateIncrementalMatViewTriggers
+ *
+ * Create the triggers that maintain a materialized view, if it was created
+ * WITH (incremental_maintenance).  The view's query must have been stored
+ * already.
+ */
+void
+CreateIncrementalMatViewTriggers(Oid matviewOid)
+{
+	Relation	matviewRel;
+	Query	   *query;
+	ListCell   *lc;
+
+	matviewRel = table_open(matviewOid, NoLock);
+	if (!RelationIsIncrementallyMaintained(matviewRel))
+	{
+		table_close(matviewRel, NoLock);
+		return;
+	}
+
+	query = ivm_get_view_query(matviewRel);
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		AclResult	aclresult;
+
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+
+		/* the triggers are internal, so check the privilege here */
+		aclresult = pg_class_aclcheck(rte->relid, GetUserId(), ACL_TRIGGER);
+		if (aclresult != ACLCHECK_OK)
+			aclcheck_error(aclresult, OBJECT_TABLE, get_rel_name(rte->relid));
+
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_BEFORE,
+						   TRIGGER_TYPE_INSERT);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_BEFORE,
+						   TRIGGER_TYPE_DELETE);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_BEFORE,
+						   TRIGGER_TYPE_UPDATE);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_BEFORE,
+						   TRIGGER_TYPE_TRUNCATE);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_AFTER,
+						   TRIGGER_TYPE_INSERT);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_AFTER,
+						   TRIGGER_TYPE_DELETE);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_AFTER,
+						   TRIGGER_TYPE_UPDATE);
+		ivm_create_trigger(rte->relid, matviewOid, TRIGGER_TYPE_AFTER,
+						   TRIGGER_TYPE_TRUNCATE);
+	}
+
+	/* Make changes-so-far visible */
+	CommandCounterIncrement();
+
+	table_close(matviewRel, NoLock);
+}
+
+/*
+ * CheckIncrementalMatViewInheritance
+ *
+ * Error out if a table about to become an inheritance parent or child is a
+ * base table of an incrementally maintained materialized view.
+ */
+void
+CheckIncrementalMatViewInheritance(Oid relid)
+{
+	Relation	rel;
+	TriggerDesc *trigdesc;
+
+	rel = table_open(relid, NoLock);
+	trigdesc = rel->trigdesc;
+	for (int i = 0; trigdesc != NULL && i < trigdesc->numtriggers; i++)
+	{
+		Trigger    *trigger = &trigdesc->triggers[i];
+
+		if (trigger->tgfoid != F_MATVIEW_INCREMENTAL_MAINTENANCE)
+			continue;
+		Assert(trigger->tgnargs == 1);
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("inheritance is not supported in incrementally maintained materialized views"),
+				 errdetail("Table \"%s\" is used by materialized view \"%s\".",
+						   RelationGetRelationName(rel),
+						   get_rel_name(atooid(trigger->tgargs[0])))));
+	}
+	table_close(rel, NoLock);
+}
+
+/*
+ * Create one maintenance trigger on a base table.  The triggers fire even
+ * when session_replication_role is "replica", so that the view also follows
+ * changes applied by logical replication.  Only the AFTER triggers need the
+ * transition tables.
+ */
+static void
+ivm_create_trigger(Oid relid, Oid matviewOid, int16 timing, int16 event)
+{
+	CreateTrigStmt *trigger;
+	ObjectAddress address;
+	ObjectAddress matviewAddress;
+	TriggerTransition *transition;
+
+	trigger = makeNode(CreateTrigStmt);
+	trigger->replace = false;
+	trigger->isconstraint = false;
+	trigger->trigname = "IVM_Trigger";
+	trigger->relation = NULL;
+	trigger->funcname = SystemFuncName("matview_incremental_maintenance");
+	trigger->args = list_make1(makeString(psprintf("%u", matviewOid)));
+	trigger->row = false;
+	trigger->timing = timing;
+	trigger->events = event;
+	trigger->columns = NIL;
+	trigger->whenClause = NULL;
+	trigger->transitionRels = NIL;
+	trigger->deferrable = false;
+	trigger->initdeferred = false;
+	trigger->constrrel = NULL;
+
+	if (timing == TRIGGER_TYPE_AFTER &&
+		(event == TRIGGER_TYPE_UPDATE || event == TRIGGER_TYPE_DELETE))
+	{
+		transition = makeNode(TriggerTransition);
+		transition->name = IVM_OLD_TABLE_NAME;
+		transition->isNew = false;
+		transition->isTable = true;
+		trigger->transitionRels = lappend(trigger->transitionRels, transition);
+	}
+	if (timing == TRIGGER_TYPE_AFTER &&
+		(event == TRIGGER_TYPE_UPDATE || event == TRIGGER_TYPE_INSERT))
+	{
+		transition = makeNode(TriggerTransition);
+		transition->name = IVM_NEW_TABLE_NAME;
+		transition->isNew = true;
+		transition->isTable = true;
+		trigger->transitionRels = lappend(trigger->transitionRels, transition);
+	}
+
+	address = CreateTriggerFiringOn(trigger, NULL, relid, InvalidOid,
+									InvalidOid, InvalidOid, InvalidOid,
+									InvalidOid, NULL, true, false,
+									TRIGGER_FIRES_ALWAYS);
+
+	/* the trigger goes away with the view */
+	ObjectAddressSet(matviewAddress, RelationRelationId, matviewOid);
+	recordDependencyOn(&address, &matviewAddress, DEPENDENCY_AUTO);
+}
+
+/*
+ * matview_incremental_maintenance
+ *
+ * Trigger function applying the changes made to a base table, by the
+ * statement the trigger fired for, to a materialized view.  The OID of the
+ * view is the trigger's argument.  Fired BEFORE the statement, it only
+ * records that the statement is in progress.
+ */
+Datum
+matview_incremental_maintenance(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Trigger    *trigger;
+	Oid			matviewOid;
+	Relation	matviewRel;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			save_nestlevel;
+	int			old_depth;
+	bool		truncate;
+	bool		have_old;
+	bool		have_new;
+	bool		recompute;
+	IvmMatView *mv;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("function \"%s\" was not called by trigger manager",
+						"matview_incremental_maintenance")));
+	if (!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event) ||
+		TRIGGER_FIRED_INSTEAD(trigdata->tg_event))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("function \"%s\" must be fired BEFORE or AFTER STATEMENT",
+						"matview_incremental_maintenance")));
+
+	trigger = trigdata->tg_trigger;
+	if (trigger->tgnargs != 1)
+		elog(ERROR, "wrong number of arguments for function \"%s\"",
+			 "matview_incremental_maintenance");
+	matviewOid = atooid(trigger->tgargs[0]);
+
+	if (TRIGGER_FIRED_BEFORE(trigdata->tg_event))
+	{
+		ivm_statement_begin(matviewOid, RelationGetRelid(trigdata->tg_relation));
+		return PointerGetDatum(NULL);
+	}
+
+	recompute = ivm_statement_end(matviewOid,
+								  RelationGetRelid(trigdata->tg_relation));
+	truncate = TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event);
+	have_old = trigdata->tg_oldtable != NULL &&
+		tuplestore_tuple_count(trigdata->tg_oldtable) > 0;
+	have_new = trigdata->tg_newtable != NULL &&
+		tuplestore_tuple_count(trigdata->tg_newtable) > 0;
+	if (!recompute && !truncate && !have_old && !have_new)
+		return PointerGetDatum(NULL);
+
+	/*
+	 * This serializes maintenance of the view, and conflicts with REFRESH.
+	 * It doesn't block readers.
+	 */
+	matviewRel = table_open(matviewOid, ExclusiveLock);
+
+	/* there's nothing to maintain until the view is refreshed */
+	if (!RelationIsPopulated(matviewRel))
+	{
+		table_close(matviewRel, NoLock);
+		return PointerGetDatum(NULL);
+	}
+
+	/*
+	 * Run the maintenance queries as the owner of the view, like REFRESH
+	 * does.
+	 */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(matviewRel->rd_rel->relowner,
+						   save_sec_context | SECURITY_RESTRICTED_OPERATION);
+	save_nestlevel = NewGUCNestLevel();
+	RestrictSearchPath();
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	if (SPI_register_trigger_data(trigdata) != SPI_OK_TD_REGISTER)
+		elog(ERROR, "SPI_register_trigger_data failed");
+
+	mv = ivm_get_matview(matviewRel);
+
+	old_depth = matview_maintenance_depth;
+	OpenMatViewIncrementalMaintenance();
+	PG_TRY();
+	{
+		if (recompute || truncate)
+			ivm_recompute(mv);
+		else
+		{
+			/* for an UPDATE, remove the old rows before adding new ones */
+			if (have_old)
+				ivm_apply_delta(mv,
+								ivm_delta_query(mv, trigdata->tg_relation,
+												trigger->tgoldtable),
+								false);
+			if (have_new)
+				ivm_apply_delta(mv,
+								ivm_delta_query(mv, trigdata->tg_relation,
+												trigger->tgnewtable),
+								true);
+		}
+	}
+	PG_CATCH();
+	{
+		matview_maintenance_depth = old_depth;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	CloseMatViewIncrementalMaintenance();
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	table_close(matviewRel, NoLock);
+
+	/* Roll back any GUC changes */
+	AtEOXact_GUC(false, save_nestlevel);
+
+	/* Restore userid and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	return PointerGetDatum(NULL);
+}
+
+/*
+ * Record that a statement on a base table of a view has started.
+ */
+static void
+ivm_statement_begin(Oid matviewOid, Oid relid)
+{
+	MemoryContext oldcxt;
+	IvmPendingStatement *pending;
+
+	if (!ivm_pending_callback_registered)
+	{
+		ivm_pending_callback.func = ivm_pending_reset;
+		ivm_pending_callback.arg = NULL;
+		MemoryContextRegisterResetCallback(TopTransactionContext,
+										   &ivm_pending_callback);
+		ivm_pending_callback_registered = true;
+	}
+
+	oldcxt = MemoryContextSwitchTo(TopTransactionContext);
+	pending = palloc(sizeof(IvmPendingStatement));
+	pending->matviewOid = matviewOid;
+	pending->relid = relid;
+	pending->subxid = GetCurrentSubTransactionId();
+	ivm_pending_statements = lappend(ivm_pending_statements, pending);
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * Record that a statement on a base table of a view has ended, and return
+ * whether the view must be recomputed rather than maintained incrementally.
+ */
+static bool
+ivm_statement_end(Oid matviewOid, Oid relid)
+{
+	MemoryContext oldcxt;
+	IvmPendingStatement *mine = NULL;
+	bool		others = false;
+	bool		result = false;
+	ListCell   *lc;
+
+	oldcxt = MemoryContextSwitchTo(TopTransactionContext);
+
+	foreach(lc, ivm_pending_statements)
+	{
+		IvmPendingStatement *pending = lfirst(lc);
+
+		/* statements of aborted subtransactions never end */
+		if (!SubTransactionIsActive(pending->subxid))
+		{
+			ivm_pending_statements =
+				foreach_delete_current(ivm_pending_statements, lc);
+			pfree(pending);
+			continue;
+		}
+		if (pending->matviewOid != matviewOid)
+			continue;
+		if (pending->relid == relid)
+			mine = pending;		/* the innermost one, if nested */
+		else
+			others = true;
+	}
+
+	if (mine != NULL)
+	{
+		ivm_pending_statements = list_delete_ptr(ivm_pending_statements, mine);
+		pfree(mine);
+	}
+
+	if (others)
+	{
+		ivm_recompute_views = list_append_unique_oid(ivm_recompute_views,
+													 matviewOid);
+		result = true;
+	}
+	else if (list_member_oid(ivm_recompute_views, matviewOid))
+	{
+		ivm_recompute_views = list_delete_oid(ivm_recompute_views, matviewOid);
+		result = true;
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return result;
+}
+
+/*
+ * Forget the statements in progress when their transaction ends.
+ */
+static void
+ivm_pending_reset(void *arg)
+{
+	ivm_pending_statements = NIL;
+	ivm_recompute_views = NIL;
+	ivm_pending_callback_registered = false;
+}
+
+/*
+ * Get the query of a materialized view from its ON SELECT rule.
+ */
+static Query *
+ivm_get_view_query(Relation matviewRel)
+{
+	RewriteRule *rule;
+
+	if (matviewRel->rd_rel->relhasrules == false ||
+		matviewRel->rd_rules->numLocks != 1)
+		elog(ERROR,
+			 "materialized view \"%s\" is missing rewrite information",
+			 RelationGetRelationName(matviewRel));
+
+	rule = matviewRel->rd_rules->rules[0];
+	if (rule->event != CMD_SELECT || list_length(rule->actions) != 1)
+		elog(ERROR,
+			 "the rule for materialized view \"%s\" is not a single SELECT action",
+			 RelationGetRelationName(matviewRel));
+
+	return linitial_node(Query, rule->actions);
+}
+
+/*
+ * Classify an aggregate of an incrementally maintained view.  sum() and avg()
+ * of floating-point types are not supported, because adding and subtracting
+ * the changes would accumulate rounding errors.
+ */
+static IvmColumnKind
+ivm_aggregate_kind(Aggref *aggref)
+{
+	switch (aggref->aggfnoid)
+	{
+		case F_COUNT_:
+		case F_COUNT_ANY:
+			return IVM_COLUMN_COUNT;
+		case F_SUM_INT2:
+		case F_SUM_INT4:
+		case F_SUM_INT8:
+		case F_SUM_NUMERIC:
+			return IVM_COLUMN_SUM;
+		case F_AVG_INT2:
+		case F_AVG_INT4:
+		case F_AVG_INT8:
+		case F_AVG_NUMERIC:
+			return IVM_COLUMN_AVG;
+		default:
+			return IVM_COLUMN_UNSUPPORTED;
+	}
+}
+
+/*
+ * Find the target list entry of an aggregate of the given kind, over the
+ * same argument as "of"; or count(*), if "of" is NULL.
+ */
+static TargetEntry *
+ivm_find_aggregate(List *targetList, IvmColumnKind kind, Aggref *of)
+{
+	ListCell   *lc;
+
+	foreach(lc, targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		Aggref	   *aggref;
+
+		if (tle->resjunk || !IsA(tle->expr, Aggref))
+			continue;
+		aggref = (Aggref *) tle->expr;
+		if (ivm_aggregate_kind(aggref) != kind ||
+			aggref->aggdistinct != NIL || aggref->aggorder != NIL ||
+			aggref->aggfilter != NULL)
+			continue;
+
+		if (of == NULL)
+		{
+			if (aggref->aggstar)
+				return tle;
+		}
+		else if (!aggref->aggstar &&
+				 equal(linitial_node(TargetEntry, aggref->args)->expr,
+					   linitial_node(TargetEntry, of->args)->expr))
+			return tle;
+	}
+
+	return NULL;
+}
+
+/*
+ * Build a call of the named aggregate over "arg", or with "*" if it is NULL.
+ */
+static Expr *
+ivm_make_aggregate(ParseState *pstate, char *aggname, Expr *arg)
+{
+	FuncCall   *fn;
+	List	   *args = NIL;
+	Node	   *result;
+
+	fn = makeFuncCall(SystemFuncName(aggname), NIL, COERCE_EXPLICIT_CALL, -1);
+	if (arg != NULL)
+		args = list_make1(copyObject(arg));
+	else
+		fn->agg_star = true;
+
+	result = ParseFuncOrColumn(pstate, fn->funcname, args, NULL, fn, false, -1);
+	assign_expr_collations(pstate, result);
+
+	return (Expr *) result;
+}
+
+/*
+ * Reject references to system columns and whole-row references, which
+ * the transition tables can't provide.
+ */
+static bool
+ivm_check_vars_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Var))
+	{
+		if (((Var *) node)->varattno <= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("system columns and whole-row references are not supported in incrementally maintained materialized views")));
+		return false;
+	}
+	return expression_tree_walker(node, ivm_check_vars_walker, context);
+}
+
+static void
+ivm_unsupported(const char *feature)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+	/* translator: %s is a SQL clause, such as DISTINCT */
+			 errmsg("%s is not supported in incrementally maintained materialized views",
+					feature)));
+}
+
+/*
+ * Collect what maintenance needs to know about the columns of a view.
+ */
+static IvmMatView *
+ivm_get_matview(Relation matviewRel)
+{
+	IvmMatView *mv = palloc0(sizeof(IvmMatView));
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	StringInfoData collist;
+	ListCell   *lc;
+	int			i = 0;
+
+	mv->name = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+										  RelationGetRelationName(matviewRel));
+	mv->query = ivm_get_view_query(matviewRel);
+	mv->hasaggs = mv->query->hasAggs || mv->query->groupClause != NIL;
+	mv->countstar = -1;
+	mv->ncolumns = tupdesc->natts;
+	mv->columns = palloc0(sizeof(IvmColumn) * mv->ncolumns);
+
+	initStringInfo(&collist);
+	foreach(lc, mv->query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		IvmColumn  *col;
+
+		if (tle->resjunk)
+			continue;
+		if (i >= mv->ncolumns)
+			elog(ERROR, "materialized view \"%s\" has too few columns",
+				 RelationGetRelationName(matviewRel));
+
+		col = &mv->columns[i];
+		col->name = quote_identifier(NameStr(TupleDescAttr(tupdesc, i)->attname));
+		col->typid = TupleDescAttr(tupdesc, i)->atttypid;
+		col->countcol = -1;
+		col->sumcol = -1;
+
+		if (i > 0)
+			appendStringInfoString(&collist, ", ");
+		appendStringInfoString(&collist, col->name);
+
+		if (IsA(tle->expr, Aggref))
+		{
+			Aggref	   *aggref = (Aggref *) tle->expr;
+			TargetEntry *other;
+
+			col->kind = ivm_aggregate_kind(aggref);
+			if (col->kind == IVM_COLUMN_COUNT && aggref->aggstar &&
+				mv->countstar < 0)
+				mv->countstar = i;
+			if (col->kind == IVM_COLUMN_SUM || col->kind == IVM_COLUMN_AVG)
+			{
+				other = ivm_find_aggregate(mv->query->targetList,
+										   IVM_COLUMN_COUNT, aggref);
+				if (other == NULL)
+					elog(ERROR, "count() column for column %d of materialized view \"%s\" not found",
+						 i + 1, RelationGetRelationName(matviewRel));
+				col->countcol = other->resno - 1;
+			}
+			if (col->kind == IVM_COLUMN_AVG)
+			{
+				other = ivm_find_aggregate(mv->query->targetList,
+										   IVM_COLUMN_SUM, aggref);
+				if (other == NULL)
+					elog(ERROR, "sum() column for column %d of materialized view \"%s\" not found",
+						 i + 1, RelationGetRelationName(matviewRel));
+				col->sumcol = other->resno - 1;
+			}
+			if (col->kind == IVM_COLUMN_UNSUPPORTED)
+				elog(ERROR, "unsupported aggregate function %u in materialized view \"%s\"",
+					 aggref->aggfnoid, RelationGetRelationName(matviewRel));
+		}
+		else
+		{
+			col->kind = IVM_COLUMN_PLAIN;
+			if (mv->hasaggs)
+				col->eqop = get_sortgroupref_clause(tle->ressortgroupref,
+													mv->query->groupClause)->eqop;
+			else
+				col->eqop = lookup_type_cache(col->typid,
+											  TYPECACHE_EQ_OPR)->eq_opr;
+			if (!OidIsValid(col->eqop))
+				elog(ERROR, "could not identify an equality operator for type %s",
+					 format_type_be(col->typid));
+			col->notnull = ivm_expr_is_notnull(mv->query, tle->expr);
+		}
+		i++;
+	}
+	if (i != mv->ncolumns)
+		elog(ERROR, "materialized view \"%s\" has too many columns",
+			 RelationGetRelationName(matviewRel));
+	if (mv->hasaggs && mv->countstar < 0)
+		elog(ERROR, "count(*) column of materialized view \"%s\" not found",
+			 RelationGetRelationName(matviewRel));
+	mv->collist = collist.data;
+
+	return mv;
+}
+
+/*
+ * Is the expression a column of a base table with a NOT NULL constraint?
+ * The view has no outer joins, so it then can't be NULL in the view either.
+ */
+static bool
+ivm_expr_is_notnull(Query *query, Expr *expr)
+{
+	Var		   *var = (Var *) expr;
+	RangeTblEntry *rte;
+	HeapTuple	tp;
+	bool		result;
+
+	if (!IsA(var, Var) || var->varlevelsup != 0 || var->varattno <= 0)
+		return false;
+	rte = rt_fetch(var->varno, query->rtable);
+	if (rte->rtekind != RTE_RELATION)
+		return false;
+
+	tp = SearchSysCacheAttNum(rte->relid, var->varattno);
+	if (!HeapTupleIsValid(tp))
+		return false;
+	result = ((Form_pg_attribute) GETSTRUCT(tp))->attnotnull;
+	ReleaseSysCache(tp);
+
+	return result;
+}
+
+/*
+ * Build the query computing the change to the view, given the table that
+ * holds the rows deleted from, or inserted into, the base table "rel".
+ */
+static char *
+ivm_delta_query(IvmMatView *mv, Relation rel, const char *enrname)
+{
+	Query	   *query = copyObject(mv->query);
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	ListCell   *lc;
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		List	   *colnames = NIL;
+
+		if (rte->rtekind != RTE_RELATION ||
+			rte->relid != RelationGetRelid(rel))
+			continue;
+
+		/*
+		 * The transition table has the columns of the table as it is now, so
+		 * use their current names, not any aliases.
+		 */
+		for (int i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+			colnames = lappend(colnames,
+							   makeString(attr->attisdropped ? pstrdup("") :
+										  pstrdup(NameStr(attr->attname))));
+		}
+
+		rte->rtekind = RTE_NAMEDTUPLESTORE;
+		rte->enrname = pstrdup(enrname);
+		rte->inh = false;
+		rte->eref->colnames = colnames;
+		if (rte->alias != NULL)
+			rte->alias = makeAlias(rte->alias->aliasname, NIL);
+	}
+
+	return pg_get_querydef(query, false);
+}
+
+/*
+ * Append a condition matching the grouping columns (or, for a view without
+ * aggregates, all columns) of the rows called "left" and "right".
+ */
+static void
+ivm_append_match(StringInfo buf, IvmMatView *mv,
+				 const char *left, const char *right)
+{
+	bool		first = true;
+
+	for (int i = 0; i < mv->ncolumns; i++)
+	{
+		IvmColumn  *col = &mv->columns[i];
+		char	   *leftop;
+		char	   *rightop;
+
+		if (col->kind != IVM_COLUMN_PLAIN)
+			continue;
+
+		leftop = psprintf("%s.%s", left, col->name);
+		rightop = psprintf("%s.%s", right, col->name);
+
+		if (!first)
+			appendStringInfoString(buf, " AND ");
+		first = false;
+
+		if (col->notnull)
+			generate_operator_clause(buf, leftop, col->typid, col->eqop,
+									 rightop, col->typid);
+		else
+		{
+			appendStringInfoString(buf, "(");
+			generate_operator_clause(buf, leftop, col->typid, col->eqop,
+									 rightop, col->typid);
+			appendStringInfo(buf, " OR (%s IS NULL AND %s IS NULL))",
+							 leftop, rightop);
+		}
+	}
+
+	if (first)
+		appendStringInfoString(buf, "true");
+}
+
+/*
+ * Append the SET clause folding the change "d" of a group into its row "mv".
+ * "op" is '+' to add rows to the group, '-' to remove them.
+ */
+static void
+ivm_append_set_clause(StringInfo buf, IvmMatView *mv, char op)
+{
+	bool		first = true;
+
+	for (int i = 0; i < mv->ncolumns; i++)
+	{
+		IvmColumn  *col = &mv->columns[i];
+		char	   *count;
+		char	   *sum;
+
+		if (col->kind == IVM_COLUMN_PLAIN)
+			continue;
+
+		if (!first)
+			appendStringInfoString(buf, ", ");
+		first = false;
+
+		switch (col->kind)
+		{
+			case IVM_COLUMN_COUNT:
+				appendStringInfo(buf, "%s = (mv.%s OPERATOR(pg_catalog.%c) d.%s)",
+								 col->name, col->name, op, col->name);
+				break;
+			case IVM_COLUMN_SUM:
+				count = psprintf("(mv.%s OPERATOR(pg_catalog.%c) d.%s)",
+								 mv->columns[col->countcol].name, op,
+								 mv->columns[col->countcol].name);
+				appendStringInfo(buf,
+								 "%s = CASE WHEN %s OPERATOR(pg_catalog.=) 0 THEN NULL "
+								 "ELSE (COALESCE(mv.%s, 0) OPERATOR(pg_catalog.%c) COALESCE(d.%s, 0)) END",
+								 col->name, count, col->name, op, col->name);
+				break;
+			case IVM_COLUMN_AVG:
+				count = psprintf("(mv.%s OPERATOR(pg_catalog.%c) d.%s)",
+								 mv->columns[col->countcol].name, op,
+								 mv->columns[col->countcol].name);
+				sum = psprintf("(COALESCE(mv.%s, 0) OPERATOR(pg_catalog.%c) COALESCE(d.%s, 0))",
+							   mv->columns[col->sumcol].name, op,
+							   mv->columns[col->sumcol].name);
+				appendStringInfo(buf,
+								 "%s = CASE WHEN %s OPERATOR(pg_catalog.=) 0 THEN NULL "
+								 "ELSE (%s::%s OPERATOR(pg_catalog./) %s::%s) END",
+								 col->name, count,
+								 sum, format_type_be_qualified(col->typid),
+								 count, format_type_be_qualified(col->typid));
+				break;
+			default:
+				elog(ERROR, "unexpected column kind %d", (int) col->kind);
+		}
+	}
+}
+
+/*
+ * Apply the change computed by the query "delta" to the view.  "insert" is
+ * true if the rows are to be added to the view, false if they are to be
+ * removed.
+ */
+static void
+ivm_apply_delta(IvmMatView *mv, const char *delta, bool insert)
+{
+	StringInfoData buf;
+	const char *countstar = NULL;
+	bool		grouped = mv->query->groupClause != NIL;
+
+	initStringInfo(&buf);
+
+	if (mv->hasaggs)
+		countstar = mv->columns[mv->countstar].name;
+
+	if (mv->hasaggs && !grouped)
+	{
+		/* the view has exactly one row, and so has the change */
+		appendStringInfo(&buf, "UPDATE %s AS mv SET ", mv->name);
+		ivm_append_set_clause(&buf, mv, insert ? '+' : '-');
+		appendStringInfo(&buf, " FROM (%s) AS d(%s)", delta, mv->collist);
+		ivm_execute(buf.data, SPI_OK_UPDATE);
+	}
+	else if (mv->hasaggs && insert)
+	{
+		/* update the groups that exist, and add the others */
+		appendStringInfo(&buf,
+						 "WITH d AS MATERIALIZED (SELECT * FROM (%s) AS x(%s)), "
+						 "upd AS (UPDATE %s AS mv SET ",
+						 delta, mv->collist, mv->name);
+		ivm_append_set_clause(&buf, mv, '+');
+		appendStringInfoString(&buf, " FROM d WHERE ");
+		ivm_append_match(&buf, mv, "mv", "d");
+		appendStringInfo(&buf,
+						 " RETURNING d.*) "
+						 "INSERT INTO %s SELECT * FROM d "
+						 "WHERE NOT EXISTS (SELECT 1 FROM upd WHERE ",
+						 mv->name);
+		ivm_append_match(&buf, mv, "upd", "d");
+		appendStringInfoString(&buf, ")");
+		ivm_execute(buf.data, SPI_OK_INSERT);
+	}
+	else if (mv->hasaggs)
+	{
+		/* remove the groups that become empty, and update the others */
+		appendStringInfo(&buf,
+						 "WITH d AS MATERIALIZED (SELECT * FROM (%s) AS x(%s)), "
+						 "del AS (DELETE FROM %s AS mv USING d WHERE ",
+						 delta, mv->collist, mv->name);
+		ivm_append_match(&buf, mv, "mv", "d");
+		appendStringInfo(&buf,
+						 " AND mv.%s OPERATOR(pg_catalog.=) d.%s) "
+						 "UPDATE %s AS mv SET ",
+						 countstar, countstar, mv->name);
+		ivm_append_set_clause(&buf, mv, '-');
+		appendStringInfoString(&buf, " FROM d WHERE ");
+		ivm_append_match(&buf, mv, "mv", "d");
+		appendStringInfo(&buf, " AND mv.%s OPERATOR(pg_catalog.<>) d.%s",
+						 countstar, countstar);
+		ivm_execute(buf.data, SPI_OK_UPDATE);
+	}
+	else if (insert)
+	{
+		appendStringInfo(&buf, "INSERT INTO %s SELECT * FROM (%s) AS d",
+						 mv->name, delta);
+		ivm_execute(buf.data, SPI_OK_INSERT);
+	}
+	else
+	{
+		StringInfoData partition;
+
+		/*
+		 * The view may have duplicate rows.  Remove as many of each as the
+		 * change has.
+		 */
+		initStringInfo(&partition);
+		for (int i = 0; i < mv->ncolumns; i++)
+			appendStringInfo(&partition, "%sd.%s",
+							 i > 0 ? ", " : "", mv->columns[i].name);
+
+		appendStringInfo(&buf,
+						 "DELETE FROM %s WHERE ctid OPERATOR(pg_catalog.=) ANY ("
+						 "SELECT t.tid FROM ("
+						 "SELECT mv.ctid AS tid, d.__ivm_count__ AS cnt, "
+						 "pg_catalog.row_number() OVER (PARTITION BY %s) AS rn "
+						 "FROM %s AS mv, "
+						 "(SELECT %s, pg_catalog.count(*) AS __ivm_count__ "
+						 "FROM (%s) AS x(%s) GROUP BY %s) AS d WHERE ",
+						 mv->name, partition.data, mv->name,
+						 mv->collist, delta, mv->collist, mv->collist);
+		ivm_append_match(&buf, mv, "mv", "d");
+		appendStringInfoString(&buf,
+							   ") AS t WHERE t.rn OPERATOR(pg_catalog.<=) t.cnt)");
+		ivm_execute(buf.data, SPI_OK_DELETE);
+	}
+
+	pfree(buf.data);
+}
+
+/*
+ * Recompute the view from scratch, after a base table was truncated, or
+ * when the changes of several base tables can't be applied one at a time.
+ */
+static void
+ivm_recompute(IvmMatView *mv)
+{
+	char	   *sql;
+
+	sql = psprintf("DELETE FROM %s", mv->name);
+	ivm_execute(sql, SPI_OK_DELETE);
+
+	sql = psprintf("INSERT INTO %s %s", mv->name,
+				   pg_get_querydef(mv->query, false));
+	ivm_execute(sql, SPI_OK_INSERT);
+}
+
+/*
+ * Execute a maintenance query.
+ */
+static void
+ivm_execute(const char *sql, int expected)
+{
+	SPIPlanPtr	plan;
+	Snapshot	test_snapshot;
+	Snapshot	crosscheck_snapshot;
+	int			ret;
+
+	plan = SPI_prepare(sql, 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare returned %s for %s",
+			 SPI_result_code_string(SPI_result), sql);
+
+	/*
+	 * As in ri_triggers.c, in transaction-snapshot mode we look at the base
+	 * tables and the view with a current snapshot, so that we see the
+	 * changes of transactions that maintained the view before us, and let
+	 * the executor fail if we'd modify rows of the view that the transaction
+	 * snapshot can't see.
+	 */
+	if (IsolationUsesXactSnapshot())
+	{
+		CommandCounterIncrement();	/* be sure all my own work is visible */
+		test_snapshot = GetLatestSnapshot();
+		crosscheck_snapshot = GetTransactionSnapshot();
+	}
+	else
+	{
+		/* the default SPI behavior is okay */
+		test_snapshot = InvalidSnapshot;
+		crosscheck_snapshot = InvalidSnapshot;
+	}
+
+	ret = SPI_execute_snapshot(plan, NULL, NULL,
+							   test_snapshot, crosscheck_snapshot,
+							   false, true, 0);
+	if (ret != expected)
+		elog(ERROR, "SPI_execute_snapshot returned %s for %s",
+			 SPI_result_code_string(ret), sql);
+
+	SPI_freeplan(plan);
+}
+
 /*
  * This should be used to test whether the backend is in a context where it is
  * OK to allow DML statements to modify materialized views.  We only want to
@@ -296,6 +296,9 @@ PortalCleanup(Portal portal)
 				CurrentResourceOwner = portal->resowner;
 
 			ExecutorFinish(queryDesc);
+			if (portal->cplan)
+				ReportCachedPlanRows(portal->cplan, queryDesc->plannedstmt,
+									 queryDesc->estate->es_total_processed);
 			ExecutorEnd(queryDesc);
 			FreeQueryDesc(queryDesc);
 
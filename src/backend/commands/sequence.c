@@ -35,13 +35,16 @@
 #include "commands/defrem.h"
 #include "commands/sequence.h"
 #include "commands/tablecmds.h"
+#include "common/hashfn.h"
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "parser/parse_type.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -57,6 +60,12 @@
  */
 #define SEQ_LOG_VALS	32
 
+/*
+ * Sequences that use the shared sequence cache pre-log this many values at a
+ * time instead, since all sessions draw from them.
+ */
+#define SEQ_SHARED_LOG_VALS	256
+
 /*
  * The "special area" of a sequence's buffer page looks like this.
  */
@@ -96,6 +105,51 @@ static HTAB *seqhashtab = NULL; /* hash table for SeqTable items */
  */
 static SeqTableData *last_used_seq = NULL;
 
+/*
+ * Shared sequence cache
+ *
+ * A nextval() that can't be served from the session's own cache has to lock
+ * the sequence's buffer, and every so often write WAL, so a sequence used by
+ * many sessions at once becomes a point of contention.  With
+ * shared_sequence_cache_size > 0, the values that nextval_internal() logs in
+ * advance are instead moved into a small table in shared memory, from which
+ * any session can take them under a spinlock without touching the buffer.
+ * The sequence tuple then shows them as already fetched, just like the values
+ * in a session's own cache, so losing an entry only leaves a gap.
+ *
+ * Only WAL-logged sequences without CYCLE use the cache.  The table is
+ * set-associative like the relation size cache: a sequence's OID hashes to
+ * one bucket of SEQ_CACHE_WAYS entries, protected by a spinlock.  Entries
+ * remember the relfilenumber they were filled for, so that the values of a
+ * rewritten sequence whose transaction aborted are not used.  setval(),
+ * ALTER SEQUENCE and friends remove the entry.
+ */
+#define SEQ_CACHE_WAYS	4
+
+typedef struct SeqCacheEntry
+{
+	Oid			dbOid;
+	Oid			relid;			/* InvalidOid if the entry is unused */
+	RelFileNumber relNumber;	/* relfilenumber the values belong to */
+	int64		next;			/* next value to hand out */
+	int64		increment;		/* copy of sequence's increment field */
+	int64		remaining;		/* number of values left, from next on */
+	bool		recently_used;	/* clock sweep reference bit */
+} SeqCacheEntry;
+
+typedef struct SeqCacheBucket
+{
+	slock_t		mutex;			/* protects the fields below */
+	int			clock_hand;
+	SeqCacheEntry ways[SEQ_CACHE_WAYS];
+} SeqCacheBucket;
+
+/* GUC variable: number of sequences the shared cache can hold */
+int			shared_sequence_cache_size = 0;
+
+static SeqCacheBucket *SeqCache = NULL;
+static int	SeqCacheNumBuckets = 0;
+
 static void fill_seq_with_data(Relation rel, HeapTuple tuple);
 static void fill_seq_fork_with_data(Relation rel, HeapTuple tuple, ForkNumber forkNum);
 static Relation lock_and_open_sequence(SeqTable seq);
@@ -111,6 +165,10 @@ static void init_params(ParseState *pstate, List *options, bool for_identity,
 						List **owned_by);
 static void do_setval(Oid relid, int64 next, bool iscalled);
 static void process_owned_by(Relation seqrel, List *owned_by, bool for_identity);
+static bool SeqCacheFetch(Relation seqrel, SeqTable elm, int64 maxcount);
+static void SeqCacheStore(Relation seqrel, int64 first, int64 count,
+						  int64 increment);
+static void SeqCacheForget(Oid relid);
 
 
 /*
@@ -324,6 +382,7 @@ ResetSequence(Oid seq_relid)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+	SeqCacheForget(seq_relid);
 
 	sequence_close(seq_rel, NoLock);
 }
@@ -519,6 +578,7 @@ AlterSequence(ParseState *pstate, AlterSeqStmt *stmt)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+	SeqCacheForget(relid);
 
 	/* process OWNED BY if given */
 	if (owned_by)
@@ -555,6 +615,7 @@ SequenceChangePersistence(Oid relid, char newrelpersistence)
 	RelationSetNewRelfilenumber(seqrel, newrelpersistence);
 	fill_seq_with_data(seqrel, &seqdatatuple);
 	UnlockReleaseBuffer(buf);
+	SeqCacheForget(relid);
 
 	sequence_close(seqrel, NoLock);
 }
@@ -575,6 +636,8 @@ DeleteSequenceTuple(Oid relid)
 
 	ReleaseSysCache(tuple);
 	table_close(rel, RowExclusiveLock);
+
+	SeqCacheForget(relid);
 }
 
 /*
@@ -635,6 +698,8 @@ nextval_internal(Oid relid, bool check_permissions)
 				rescnt = 0;
 	bool		cycle;
 	bool		logit = false;
+	bool		shared;
+	bool		share_logged = false;
 
 	/* open and lock sequence */
 	init_sequence(relid, &elm, &seqrel);
@@ -679,10 +744,26 @@ nextval_internal(Oid relid, bool check_permissions)
 	cycle = pgsform->seqcycle;
 	ReleaseSysCache(pgstuple);
 
+	/* Try to take values that another session has logged for everyone */
+	shared = SeqCache != NULL && !cycle && RelationNeedsWAL(seqrel);
+	if (shared && SeqCacheFetch(seqrel, elm, cache))
+	{
+		sequence_close(seqrel, NoLock);
+		return elm->last;
+	}
+
 	/* lock page buffer and read tuple */
 	seq = read_seq_tuple(seqrel, &buf, &seqdatatuple);
 	page = BufferGetPage(buf);
 
+	/* Somebody may have refilled the shared cache while we waited */
+	if (shared && SeqCacheFetch(seqrel, elm, cache))
+	{
+		UnlockReleaseBuffer(buf);
+		sequence_close(seqrel, NoLock);
+		return elm->last;
+	}
+
 	last = next = result = seq->last_value;
 	fetch = cache;
 	log = seq->log_cnt;
@@ -706,7 +787,7 @@ nextval_internal(Oid relid, bool check_permissions)
 	if (log < fetch || !seq->is_called)
 	{
 		/* forced log to satisfy local demand for values */
-		fetch = log = fetch + SEQ_LOG_VALS;
+		fetch = log = fetch + (shared ? SEQ_SHARED_LOG_VALS : SEQ_LOG_VALS);
 		logit = true;
 	}
 	else
@@ -716,7 +797,7 @@ nextval_internal(Oid relid, bool check_permissions)
 		if (PageGetLSN(page) <= redoptr)
 		{
 			/* last update of seq was before checkpoint */
-			fetch = log = fetch + SEQ_LOG_VALS;
+			fetch = log = fetch + (shared ? SEQ_SHARED_LOG_VALS : SEQ_LOG_VALS);
 			logit = true;
 		}
 	}
@@ -779,6 +860,17 @@ nextval_internal(Oid relid, bool check_permissions)
 	log -= fetch;				/* adjust for any unfetched numbers */
 	Assert(log >= 0);
 
+	/*
+	 * If we're logging values in advance for the shared cache, the ones we
+	 * don't use ourselves go there.  Without CYCLE, they are the "log"
+	 * values following "last", and "next" is the last of them.
+	 */
+	if (shared && logit && log > 0)
+	{
+		Assert(next == last + log * incby);
+		share_logged = true;
+	}
+
 	/* save info in local cache */
 	elm->increment = incby;
 	elm->last = result;			/* last returned number */
@@ -842,12 +934,28 @@ nextval_internal(Oid relid, bool check_permissions)
 	}
 
 	/* Now update sequence tuple to the intended final state */
-	seq->last_value = last;		/* last fetched number */
+	if (share_logged)
+	{
+		/* all logged values are fetched, most of them by the shared cache */
+		seq->last_value = next;
+		seq->log_cnt = 0;
+	}
+	else
+	{
+		seq->last_value = last; /* last fetched number */
+		seq->log_cnt = log;		/* how much is logged */
+	}
 	seq->is_called = true;
-	seq->log_cnt = log;			/* how much is logged */
 
 	END_CRIT_SECTION();
 
+	/*
+	 * Publish the extra values only now that they are logged, and before
+	 * releasing the buffer lock, so that no setval() can slip in between.
+	 */
+	if (share_logged)
+		SeqCacheStore(seqrel, last + incby, log, incby);
+
 	UnlockReleaseBuffer(buf);
 
 	sequence_close(seqrel, NoLock);
@@ -1029,6 +1137,9 @@ do_setval(Oid relid, int64 next, bool iscalled)
 
 	END_CRIT_SECTION();
 
+	/* Values handed out in advance are no longer valid */
+	SeqCacheForget(relid);
+
 	UnlockReleaseBuffer(buf);
 
 	sequence_close(seqrel, NoLock);
@@ -1885,6 +1996,214 @@ ResetSequenceCaches(void)
 	last_used_seq = NULL;
 }
 
+static inline int
+SeqCacheBucketCount(void)
+{
+	return (shared_sequence_cache_size + SEQ_CACHE_WAYS - 1) / SEQ_CACHE_WAYS;
+}
+
+/*
+ * Report shared-memory space needed by SeqCacheShmemInit.
+ */
+Size
+SeqCacheShmemSize(void)
+{
+	return mul_size(SeqCacheBucketCount(), sizeof(SeqCacheBucket));
+}
+
+/*
+ * Initialize the shared sequence cache during postmaster startup.
+ */
+void
+SeqCacheShmemInit(void)
+{
+	bool		found;
+	int			nbuckets = SeqCacheBucketCount();
+
+	if (nbuckets == 0)
+		return;
+
+	SeqCache = (SeqCacheBucket *)
+		ShmemInitStruct("Shared Sequence Cache", SeqCacheShmemSize(), &found);
+	SeqCacheNumBuckets = nbuckets;
+
+	if (!found)
+	{
+		for (int i = 0; i < nbuckets; i++)
+		{
+			SeqCacheBucket *bucket = &SeqCache[i];
+
+			SpinLockInit(&bucket->mutex);
+			bucket->clock_hand = 0;
+			for (int j = 0; j < SEQ_CACHE_WAYS; j++)
+				bucket->ways[j].relid = InvalidOid;
+		}
+	}
+}
+
+/*
+ * Return the bucket for the given sequence of our database, or NULL if the
+ * cache is disabled.
+ */
+static SeqCacheBucket *
+SeqCacheGetBucket(Oid relid)
+{
+	uint32		hash;
+
+	if (SeqCache == NULL)
+		return NULL;
+
+	hash = hash_combine(murmurhash32(MyDatabaseId), murmurhash32(relid));
+
+	return &SeqCache[hash % SeqCacheNumBuckets];
+}
+
+/*
+ * Find the entry for the given sequence in a bucket whose lock we hold.
+ */
+static SeqCacheEntry *
+SeqCacheFindEntry(SeqCacheBucket *bucket, Oid relid)
+{
+	for (int i = 0; i < SEQ_CACHE_WAYS; i++)
+	{
+		SeqCacheEntry *entry = &bucket->ways[i];
+
+		if (entry->relid == relid && entry->dbOid == MyDatabaseId)
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * SeqCacheFetch
+ *		Take up to maxcount values of a sequence from the shared cache
+ *
+ * On success, the values are installed as the session's cached values in
+ * elm, exactly as nextval_internal() does after fetching them itself, and
+ * elm->last is the one to return.  Returns false if the cache had none.
+ */
+static bool
+SeqCacheFetch(Relation seqrel, SeqTable elm, int64 maxcount)
+{
+	SeqCacheBucket *bucket;
+	SeqCacheEntry *entry;
+	int64		count = 0;
+	int64		first = 0;
+	int64		increment = 0;
+
+	bucket = SeqCacheGetBucket(RelationGetRelid(seqrel));
+	if (bucket == NULL)
+		return false;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = SeqCacheFindEntry(bucket, RelationGetRelid(seqrel));
+	if (entry != NULL && entry->remaining > 0 &&
+		entry->relNumber == seqrel->rd_locator.relNumber)
+	{
+		count = Min(maxcount, entry->remaining);
+		first = entry->next;
+		increment = entry->increment;
+		entry->remaining -= count;
+		if (entry->remaining > 0)
+			entry->next += count * increment;
+		entry->recently_used = true;
+	}
+	SpinLockRelease(&bucket->mutex);
+
+	if (count == 0)
+		return false;
+
+	elm->increment = increment;
+	elm->last = first;			/* value to return */
+	elm->cached = first + (count - 1) * increment;	/* last fetched number */
+	elm->last_valid = true;
+
+	last_used_seq = elm;
+
+	return true;
+}
+
+/*
+ * SeqCacheStore
+ *		Offer count values of a sequence, starting at first, to all sessions
+ *
+ * The values must have been WAL-logged, and the sequence tuple must show
+ * them as fetched.  Any values left over from before are dropped.
+ */
+static void
+SeqCacheStore(Relation seqrel, int64 first, int64 count, int64 increment)
+{
+	SeqCacheBucket *bucket;
+	SeqCacheEntry *entry;
+
+	bucket = SeqCacheGetBucket(RelationGetRelid(seqrel));
+	if (bucket == NULL)
+		return;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = SeqCacheFindEntry(bucket, RelationGetRelid(seqrel));
+	if (entry == NULL)
+	{
+		for (int i = 0; i < SEQ_CACHE_WAYS; i++)
+		{
+			if (bucket->ways[i].relid == InvalidOid)
+			{
+				entry = &bucket->ways[i];
+				break;
+			}
+		}
+	}
+
+	/* no free entry; run the clock hand until it finds an unused one */
+	while (entry == NULL)
+	{
+		SeqCacheEntry *victim = &bucket->ways[bucket->clock_hand];
+
+		bucket->clock_hand = (bucket->clock_hand + 1) % SEQ_CACHE_WAYS;
+		if (victim->recently_used)
+			victim->recently_used = false;
+		else
+			entry = victim;
+	}
+
+	entry->dbOid = MyDatabaseId;
+	entry->relid = RelationGetRelid(seqrel);
+	entry->relNumber = seqrel->rd_locator.relNumber;
+	entry->next = first;
+	entry->increment = increment;
+	entry->remaining = count;
+	entry->recently_used = true;
+	SpinLockRelease(&bucket->mutex);
+}
+
+/*
+ * SeqCacheForget
+ *		Drop the shared cache's values of a sequence of our database
+ *
+ * Callers must prevent nextval_internal() from refilling the entry from
+ * the sequence's old state: setval() holds the buffer lock, others hold a
+ * lock on the sequence that conflicts with nextval()'s.
+ */
+static void
+SeqCacheForget(Oid relid)
+{
+	SeqCacheBucket *bucket;
+	SeqCacheEntry *entry;
+
+	bucket = SeqCacheGetBucket(relid);
+	if (bucket == NULL)
+		return;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = SeqCacheFindEntry(bucket, relid);
+	if (entry != NULL)
+	{
+		entry->relid = InvalidOid;
+		entry->recently_used = false;
+	}
+	SpinLockRelease(&bucket->mutex);
+}
+
 /*
  * Mask a Sequence page before performing consistency checks on it.
  */
@@ -58,6 +58,7 @@
 #include "commands/comment.h"
 #include "commands/defrem.h"
 #include "commands/event_trigger.h"
+#include "commands/matview.h"
 #include "commands/sequence.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
@@ -3424,6 +3425,10 @@ StoreCatalogInheritance1(Oid relationId, Oid parentOid,
 	ObjectAddress childobject,
 				parentobject;
 
+	/* incrementally maintained views can't follow changes to the other */
+	CheckIncrementalMatViewInheritance(relationId);
+	CheckIncrementalMatViewInheritance(parentOid);
+
 	/* store the pg_inherits row */
 	StoreSingleInheritance(relationId, parentOid, seqNumber);
 
@@ -14923,6 +14928,25 @@ ATExecSetRelOptions(Relation rel, List *defList, AlterTableType operation,
 			break;
 	}
 
+	/*
+	 * Incremental maintenance of a materialized view needs a suitable query
+	 * and hidden columns, so it can only be chosen at creation.
+	 */
+	if (rel->rd_rel->relkind == RELKIND_MATVIEW)
+	{
+		StdRdOptions *opts;
+
+		opts = (StdRdOptions *) heap_reloptions(RELKIND_MATVIEW, newOptions,
+												false);
+		if ((opts != NULL && opts->incremental_maintenance) !=
+			RelationIsIncrementallyMaintained(rel))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot change incremental maintenance of existing materialized view \"%s\"",
+							RelationGetRelationName(rel)),
+					 errhint("Create a new materialized view instead.")));
+	}
+
 	/* Special-case validation of view options */
 	if (rel->rd_rel->relkind == RELKIND_VIEW)
 	{
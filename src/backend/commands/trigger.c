@@ -44,6 +44,7 @@
 #include "partitioning/partdesc.h"
 #include "pgstat.h"
 #include "rewrite/rewriteManip.h"
+#include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
@@ -55,6 +56,7 @@
 #include "utils/plancache.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/spccache.h"
 #include "utils/syscache.h"
 #include "utils/tuplestore.h"
 
@@ -3876,6 +3878,22 @@ struct AfterTriggersTableData
 
 static AfterTriggersData afterTriggers;
 
+/*
+ * While firing events, we look ahead in the event list and issue prefetch
+ * requests for the heap blocks that the next events' tuples live in, so that
+ * fetching them by ctid doesn't stall on one synchronous read per event.
+ * The cursor runs up to this many events ahead of the event being fired.
+ */
+#define AFTER_TRIGGER_PREFETCH_DISTANCE		64
+
+typedef struct AfterTriggerPrefetchState
+{
+	AfterTriggerEventChunk *chunk;	/* chunk containing next event */
+	AfterTriggerEvent event;	/* next event to consider */
+	uint64		pos;			/* position of that event in the list */
+	BlockNumber last_block;		/* block we prefetched last */
+} AfterTriggerPrefetchState;
+
 static void AfterTriggerExecute(EState *estate,
 								AfterTriggerEvent event,
 								ResultRelInfo *relInfo,
@@ -3907,6 +3925,13 @@ static SetConstraintState SetConstraintStateCopy(SetConstraintState origstate);
 static SetConstraintState SetConstraintStateAddItem(SetConstraintState state,
 													Oid tgoid, bool tgisdeferred);
 static void cancel_prior_stmt_triggers(Oid relid, CmdType cmdType, int tgevent);
+#ifdef USE_PREFETCH
+static void afterTriggerPrefetchEvents(AfterTriggerPrefetchState *pf,
+									   uint64 pos, Relation rel,
+									   CommandId firing_id);
+static void afterTriggerPrefetchTuple(AfterTriggerPrefetchState *pf,
+									  Relation rel, ItemPointer ctid);
+#endif
 
 
 /*
@@ -4637,6 +4662,16 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 	Instrumentation *instr = NULL;
 	TupleTableSlot *slot1 = NULL,
 			   *slot2 = NULL;
+#ifdef USE_PREFETCH
+	uint64		pos = 0;
+	AfterTriggerPrefetchState pf;
+	bool		prefetch = false;
+
+	pf.chunk = events->head;
+	pf.event = pf.chunk ? (AfterTriggerEvent) CHUNK_DATA_START(pf.chunk) : NULL;
+	pf.pos = 0;
+	pf.last_block = InvalidBlockNumber;
+#endif
 
 	/* Make a local EState if need be */
 	if (estate == NULL)
@@ -4660,6 +4695,10 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 		{
 			AfterTriggerShared evtshared = GetTriggerSharedData(event);
 
+#ifdef USE_PREFETCH
+			pos++;
+#endif
+
 			/*
 			 * Is it one for me to fire?
 			 */
@@ -4699,8 +4738,18 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 					if (trigdesc == NULL)	/* should not happen */
 						elog(ERROR, "relation %u has no triggers",
 							 evtshared->ats_relid);
+#ifdef USE_PREFETCH
+					prefetch = RELKIND_HAS_TABLE_AM(rel->rd_rel->relkind) &&
+						get_tablespace_io_concurrency(rel->rd_rel->reltablespace) > 0;
+					pf.last_block = InvalidBlockNumber;
+#endif
 				}
 
+#ifdef USE_PREFETCH
+				if (prefetch)
+					afterTriggerPrefetchEvents(&pf, pos, rel, firing_id);
+#endif
+
 				/*
 				 * Look up source and destination partition result rels of a
 				 * cross-partition update event.
@@ -4778,6 +4827,87 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 	return all_fired;
 }
 
+#ifdef USE_PREFETCH
+/*
+ * afterTriggerPrefetchEvents()
+ *
+ *	Advance the prefetch cursor to AFTER_TRIGGER_PREFETCH_DISTANCE events past
+ *	position pos (counting from 1), the event about to be fired, prefetching
+ *	the tuples of any events on rel that will be fired in this cycle.  Events
+ *	on other relations are skipped; they are rare in the large lists where
+ *	prefetching matters.
+ */
+static void
+afterTriggerPrefetchEvents(AfterTriggerPrefetchState *pf, uint64 pos,
+						   Relation rel, CommandId firing_id)
+{
+	while (pf->pos < pos + AFTER_TRIGGER_PREFETCH_DISTANCE)
+	{
+		AfterTriggerEvent event;
+		AfterTriggerShared evtshared;
+
+		/* Step to the next chunk if we're at the end of this one */
+		while (pf->chunk != NULL && (char *) pf->event >= pf->chunk->freeptr)
+		{
+			pf->chunk = pf->chunk->next;
+			if (pf->chunk != NULL)
+				pf->event = (AfterTriggerEvent) CHUNK_DATA_START(pf->chunk);
+		}
+		if (pf->chunk == NULL)
+			break;
+
+		event = pf->event;
+		pf->event = (AfterTriggerEvent) ((char *) event + SizeofTriggerEvent(event));
+		pf->pos++;
+
+		/* The event about to be fired will be fetched right away anyway */
+		if (pf->pos <= pos)
+			continue;
+
+		evtshared = GetTriggerSharedData(event);
+		if (!(event->ate_flags & AFTER_TRIGGER_IN_PROGRESS) ||
+			evtshared->ats_firing_id != firing_id ||
+			evtshared->ats_relid != RelationGetRelid(rel))
+			continue;
+
+		switch (event->ate_flags & AFTER_TRIGGER_TUP_BITS)
+		{
+			case AFTER_TRIGGER_1CTID:
+				afterTriggerPrefetchTuple(pf, rel, &event->ate_ctid1);
+				break;
+			case AFTER_TRIGGER_2CTID:
+				afterTriggerPrefetchTuple(pf, rel, &event->ate_ctid1);
+				afterTriggerPrefetchTuple(pf, rel, &event->ate_ctid2);
+				break;
+			default:
+				/* FDW and cross-partition events are not prefetched */
+				break;
+		}
+	}
+}
+
+/*
+ * Prefetch the block of one event tuple, unless we just did.
+ */
+static void
+afterTriggerPrefetchTuple(AfterTriggerPrefetchState *pf, Relation rel,
+						  ItemPointer ctid)
+{
+	BlockNumber blkno;
+
+	/* statement-level events carry no ctid */
+	if (!ItemPointerIsValid(ctid))
+		return;
+
+	blkno = ItemPointerGetBlockNumber(ctid);
+	if (blkno == pf->last_block)
+		return;
+
+	PrefetchBuffer(rel, MAIN_FORKNUM, blkno);
+	pf->last_block = blkno;
+}
+#endif
+
 
 /*
  * GetAfterTriggersTableData
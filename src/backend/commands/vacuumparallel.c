@@ -16,6 +16,12 @@
  * the parallel context is re-initialized so that the same DSM can be used for
  * multiple passes of index bulk-deletion and index cleanup.
  *
+ * The workers can also take part in the table's first pass, scanning the
+ * table together with the leader and adding the dead items they find to the
+ * shared dead items space.  How the scan is divided up is up to the table's
+ * VACUUM code, which gets a chunk of the DSM segment for its shared state.
+ * This is only implemented for heap, see vacuumlazy.c.
+ *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -27,6 +33,7 @@
 #include "postgres.h"
 
 #include "access/amapi.h"
+#include "access/heapam.h"
 #include "access/table.h"
 #include "access/xact.h"
 #include "commands/progress.h"
@@ -49,6 +56,7 @@
 #define PARALLEL_VACUUM_KEY_BUFFER_USAGE	3
 #define PARALLEL_VACUUM_KEY_WAL_USAGE		4
 #define PARALLEL_VACUUM_KEY_INDEX_STATS		5
+#define PARALLEL_VACUUM_KEY_TABLE_SCAN		6
 
 /*
  * Shared information among parallel workers.  So this is allocated in the DSM
@@ -64,6 +72,12 @@ typedef struct PVShared
 	Oid			relid;
 	int			elevel;
 
+	/*
+	 * Are the workers being launched to scan the table, rather than to
+	 * process indexes?
+	 */
+	bool		table_scan;
+
 	/*
 	 * Fields for both index vacuum and cleanup.
 	 *
@@ -93,6 +107,15 @@ typedef struct PVShared
 	 */
 	int			ring_nbuffers;
 
+	/*
+	 * Cost-based delay parameters of the leader when it is an autovacuum
+	 * worker, whose parameters differ from the vacuum_cost_delay and
+	 * vacuum_cost_limit GUCs that parallel workers would otherwise use.
+	 * cost_delay is -1 for other leaders.
+	 */
+	double		cost_delay;
+	int			cost_limit;
+
 	/*
 	 * Shared vacuum cost balance.  During parallel vacuum,
 	 * VacuumSharedCostBalance points to this value and it accumulates the
@@ -207,6 +230,17 @@ struct ParallelVacuumState
 	int			nindexes_parallel_cleanup;
 	int			nindexes_parallel_condcleanup;
 
+	/*
+	 * The number of workers that can help scanning the table, zero if the
+	 * table is scanned by the leader alone.  scan_shared is the table's
+	 * shared state for that, in DSM.
+	 */
+	int			nworkers_table_scan;
+	void	   *scan_shared;
+
+	/* Have workers been launched since the DSM was (re)initialized? */
+	bool		dsm_used;
+
 	/* Buffer access strategy used by leader process */
 	BufferAccessStrategy bstrategy;
 
@@ -221,6 +255,7 @@ struct ParallelVacuumState
 };
 
 static int	parallel_vacuum_compute_workers(Relation *indrels, int nindexes, int nrequested,
+											int nworkers_table_scan,
 											bool *will_parallel_vacuum);
 static void parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scans,
 												bool vacuum);
@@ -236,11 +271,16 @@ static void parallel_vacuum_error_callback(void *arg);
  * Try to enter parallel mode and create a parallel context.  Then initialize
  * shared memory state.
  *
+ * nworkers_table_scan is the number of workers that would be worth using to
+ * scan the table, and scan_shared_size the size of the shared state that the
+ * table's VACUUM code needs for that, if any.
+ *
  * On success, return parallel vacuum state.  Otherwise return NULL.
  */
 ParallelVacuumState *
 parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
-					 int nrequested_workers, int vac_work_mem,
+					 int nrequested_workers, int nworkers_table_scan,
+					 Size scan_shared_size, int vac_work_mem,
 					 int elevel, BufferAccessStrategy bstrategy)
 {
 	ParallelVacuumState *pvs;
@@ -258,18 +298,19 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	int			querylen;
 
 	/*
-	 * A parallel vacuum must be requested and there must be indexes on the
-	 * relation
+	 * A parallel vacuum must be requested, and there must be indexes on the
+	 * relation or the table must be worth scanning in parallel
 	 */
 	Assert(nrequested_workers >= 0);
-	Assert(nindexes > 0);
+	Assert(nindexes > 0 || nworkers_table_scan > 0);
 
 	/*
 	 * Compute the number of parallel vacuum workers to launch
 	 */
-	will_parallel_vacuum = (bool *) palloc0(sizeof(bool) * nindexes);
+	will_parallel_vacuum = (bool *) palloc0(sizeof(bool) * Max(nindexes, 1));
 	parallel_workers = parallel_vacuum_compute_workers(indrels, nindexes,
 													   nrequested_workers,
+													   nworkers_table_scan,
 													   will_parallel_vacuum);
 	if (parallel_workers <= 0)
 	{
@@ -284,6 +325,7 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	pvs->will_parallel_vacuum = will_parallel_vacuum;
 	pvs->bstrategy = bstrategy;
 	pvs->heaprel = rel;
+	pvs->nworkers_table_scan = Min(nworkers_table_scan, parallel_workers);
 
 	EnterParallelMode();
 	pcxt = CreateParallelContext("postgres", "parallel_vacuum_main",
@@ -301,6 +343,13 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	shm_toc_estimate_chunk(&pcxt->estimator, est_shared_len);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 
+	/* Estimate size for the table scan -- PARALLEL_VACUUM_KEY_TABLE_SCAN */
+	if (pvs->nworkers_table_scan > 0)
+	{
+		shm_toc_estimate_chunk(&pcxt->estimator, scan_shared_size);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
 	/*
 	 * Estimate space for BufferUsage and WalUsage --
 	 * PARALLEL_VACUUM_KEY_BUFFER_USAGE and PARALLEL_VACUUM_KEY_WAL_USAGE.
@@ -385,6 +434,14 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	/* Use the same buffer size for all workers */
 	shared->ring_nbuffers = GetAccessStrategyBufferCount(bstrategy);
 
+	if (AmAutoVacuumWorkerProcess())
+	{
+		shared->cost_delay = vacuum_cost_delay;
+		shared->cost_limit = vacuum_cost_limit;
+	}
+	else
+		shared->cost_delay = -1;
+
 	pg_atomic_init_u32(&(shared->cost_balance), 0);
 	pg_atomic_init_u32(&(shared->active_nworkers), 0);
 	pg_atomic_init_u32(&(shared->idx), 0);
@@ -392,6 +449,14 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_SHARED, shared);
 	pvs->shared = shared;
 
+	/* Prepare space for the table scan, the caller initializes it */
+	if (pvs->nworkers_table_scan > 0)
+	{
+		pvs->scan_shared = shm_toc_allocate(pcxt->toc, scan_shared_size);
+		shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_TABLE_SCAN,
+					   pvs->scan_shared);
+	}
+
 	/*
 	 * Allocate space for each worker's BufferUsage and WalUsage; no need to
 	 * initialize
@@ -485,8 +550,8 @@ parallel_vacuum_reset_dead_items(ParallelVacuumState *pvs)
 										   LWTRANCHE_PARALLEL_VACUUM_DSA);
 
 	/* Update the DSA pointer for dead_items to the new one */
-	pvs->shared->dead_items_dsa_handle = dsa_get_handle(TidStoreGetDSA(dead_items));
-	pvs->shared->dead_items_handle = TidStoreGetHandle(dead_items);
+	pvs->shared->dead_items_dsa_handle = dsa_get_handle(TidStoreGetDSA(pvs->dead_items));
+	pvs->shared->dead_items_handle = TidStoreGetHandle(pvs->dead_items);
 
 	/* Reset the counter */
 	dead_items_info->num_items = 0;
@@ -531,6 +596,100 @@ parallel_vacuum_cleanup_all_indexes(ParallelVacuumState *pvs, long num_table_tup
 	parallel_vacuum_process_all_indexes(pvs, num_index_scans, false);
 }
 
+/*
+ * Returns the table's shared state for scanning it in parallel, or NULL if
+ * the table is to be scanned by the leader alone.
+ */
+void *
+parallel_vacuum_get_scan_shared(ParallelVacuumState *pvs)
+{
+	return pvs->scan_shared;
+}
+
+/*
+ * Launch workers for scanning the table.  The caller does its share of the
+ * scan, and then calls parallel_vacuum_table_scan_end() to wait for the
+ * workers to finish theirs.  The caller must have initialized the shared
+ * state returned by parallel_vacuum_get_scan_shared() beforehand.
+ *
+ * Returns the number of workers launched.
+ */
+int
+parallel_vacuum_table_scan_begin(ParallelVacuumState *pvs)
+{
+	int			nworkers;
+
+	Assert(!IsParallelWorker());
+
+	/* The DSM segment might not have room for any workers */
+	nworkers = Min(pvs->nworkers_table_scan, pvs->pcxt->nworkers);
+	pvs->shared->table_scan = (nworkers > 0);
+	if (nworkers == 0)
+		return 0;
+
+	if (pvs->dsm_used)
+		ReinitializeParallelDSM(pvs->pcxt);
+
+	/* See parallel_vacuum_process_all_indexes() */
+	pg_atomic_write_u32(&(pvs->shared->cost_balance), VacuumCostBalance);
+	pg_atomic_write_u32(&(pvs->shared->active_nworkers), 0);
+
+	ReinitializeParallelWorkers(pvs->pcxt, nworkers);
+	LaunchParallelWorkers(pvs->pcxt);
+	pvs->dsm_used = true;
+
+	if (pvs->pcxt->nworkers_launched > 0)
+	{
+		VacuumCostBalance = 0;
+		VacuumCostBalanceLocal = 0;
+
+		VacuumSharedCostBalance = &(pvs->shared->cost_balance);
+		VacuumActiveNWorkers = &(pvs->shared->active_nworkers);
+
+		/* The leader takes part in the scan */
+		pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+	}
+
+	ereport(pvs->shared->elevel,
+			(errmsg(ngettext("launched %d parallel vacuum worker for table scanning (planned: %d)",
+							 "launched %d parallel vacuum workers for table scanning (planned: %d)",
+							 pvs->pcxt->nworkers_launched),
+					pvs->pcxt->nworkers_launched, nworkers)));
+
+	return pvs->pcxt->nworkers_launched;
+}
+
+/*
+ * Wait for the workers launched by parallel_vacuum_table_scan_begin() to
+ * finish.  Once this returns, their results can be collected from the shared
+ * state.
+ */
+void
+parallel_vacuum_table_scan_end(ParallelVacuumState *pvs)
+{
+	Assert(!IsParallelWorker());
+
+	/* Nothing to do if parallel_vacuum_table_scan_begin() didn't launch */
+	if (!pvs->shared->table_scan)
+		return;
+
+	if (VacuumActiveNWorkers)
+		pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+
+	WaitForParallelWorkersToFinish(pvs->pcxt);
+
+	for (int i = 0; i < pvs->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&pvs->buffer_usage[i], &pvs->wal_usage[i]);
+
+	/* Carry the shared balance value back, and disable shared costing */
+	if (VacuumSharedCostBalance)
+	{
+		VacuumCostBalance = pg_atomic_read_u32(VacuumSharedCostBalance);
+		VacuumSharedCostBalance = NULL;
+		VacuumActiveNWorkers = NULL;
+	}
+}
+
 /*
  * Compute the number of parallel worker processes to request.  Both index
  * vacuum and index cleanup can be executed with parallel workers.
@@ -540,12 +699,14 @@ parallel_vacuum_cleanup_all_indexes(ParallelVacuumState *pvs, long num_table_tup
  *
  * nrequested is the number of parallel workers that user requested.  If
  * nrequested is 0, we compute the parallel degree based on nindexes, that is
- * the number of indexes that support parallel vacuum.  This function also
- * sets will_parallel_vacuum to remember indexes that participate in parallel
- * vacuum.
+ * the number of indexes that support parallel vacuum, and on
+ * nworkers_table_scan, the number of workers worth using for the table scan.
+ * This function also sets will_parallel_vacuum to remember indexes that
+ * participate in parallel vacuum.
  */
 static int
 parallel_vacuum_compute_workers(Relation *indrels, int nindexes, int nrequested,
+								int nworkers_table_scan,
 								bool *will_parallel_vacuum)
 {
 	int			nindexes_parallel = 0;
@@ -588,13 +749,15 @@ parallel_vacuum_compute_workers(Relation *indrels, int nindexes, int nrequested,
 	/* The leader process takes one index */
 	nindexes_parallel--;
 
-	/* No index supports parallel vacuum */
-	if (nindexes_parallel <= 0)
+	/* Compute the parallel degree */
+	parallel_workers = Max(nindexes_parallel, nworkers_table_scan);
+
+	/* Neither the indexes nor the table are worth processing in parallel */
+	if (parallel_workers <= 0)
 		return 0;
 
-	/* Compute the parallel degree */
-	parallel_workers = (nrequested > 0) ?
-		Min(nrequested, nindexes_parallel) : nindexes_parallel;
+	if (nrequested > 0)
+		parallel_workers = Min(nrequested, parallel_workers);
 
 	/* Cap by max_parallel_maintenance_workers */
 	parallel_workers = Min(parallel_workers, max_parallel_maintenance_workers);
@@ -664,12 +827,13 @@ parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scan
 
 	/* Reset the parallel index processing and progress counters */
 	pg_atomic_write_u32(&(pvs->shared->idx), 0);
+	pvs->shared->table_scan = false;
 
 	/* Setup the shared cost-based vacuum delay and launch workers */
 	if (nworkers > 0)
 	{
 		/* Reinitialize parallel context to relaunch parallel workers */
-		if (num_index_scans > 0)
+		if (pvs->dsm_used)
 			ReinitializeParallelDSM(pvs->pcxt);
 
 		/*
@@ -688,6 +852,7 @@ parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scan
 		ReinitializeParallelWorkers(pvs->pcxt, nworkers);
 
 		LaunchParallelWorkers(pvs->pcxt);
+		pvs->dsm_used = true;
 
 		if (pvs->pcxt->nworkers_launched > 0)
 		{
@@ -981,8 +1146,9 @@ parallel_vacuum_index_is_parallel_safe(Relation indrel, int num_index_scans,
 /*
  * Perform work within a launched parallel process.
  *
- * Since parallel vacuum workers perform only index vacuum or index cleanup,
- * we don't need to report progress information.
+ * Parallel vacuum workers perform index vacuum, index cleanup or their share
+ * of the table scan.  Progress information is only reported through the
+ * leader.
  */
 void
 parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
@@ -1026,7 +1192,6 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	 * matched to the leader's one.
 	 */
 	vac_open_indexes(rel, RowExclusiveLock, &nindexes, &indrels);
-	Assert(nindexes > 0);
 
 	if (shared->maintenance_work_mem_worker > 0)
 		maintenance_work_mem = shared->maintenance_work_mem_worker;
@@ -1042,6 +1207,12 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 
 	/* Set cost-based vacuum delay */
 	VacuumUpdateCosts();
+	if (shared->cost_delay >= 0)
+	{
+		vacuum_cost_delay = shared->cost_delay;
+		vacuum_cost_limit = shared->cost_limit;
+		VacuumCostActive = (vacuum_cost_delay > 0);
+	}
 	VacuumCostBalance = 0;
 	VacuumPageHit = 0;
 	VacuumPageMiss = 0;
@@ -1077,8 +1248,24 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	/* Prepare to track buffer usage during parallel execution */
 	InstrStartParallelQuery();
 
-	/* Process indexes to perform vacuum/cleanup */
-	parallel_vacuum_process_safe_indexes(&pvs);
+	if (shared->table_scan)
+	{
+		void	   *scan_shared;
+
+		scan_shared = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_TABLE_SCAN,
+									 false);
+
+		/* Scan our share of the table */
+		pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+		heap_parallel_vacuum_scan_worker(rel, &pvs, scan_shared,
+										 pvs.bstrategy);
+		pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+	}
+	else
+	{
+		/* Process indexes to perform vacuum/cleanup */
+		parallel_vacuum_process_safe_indexes(&pvs);
+	}
 
 	/* Report buffer/WAL usage during parallel execution */
 	buffer_usage = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_BUFFER_USAGE, false);
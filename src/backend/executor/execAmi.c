@@ -44,6 +44,7 @@
 #include "executor/nodeNestloop.h"
 #include "executor/nodeProjectSet.h"
 #include "executor/nodeRecursiveunion.h"
+#include "executor/nodeRepartition.h"
 #include "executor/nodeResult.h"
 #include "executor/nodeSamplescan.h"
 #include "executor/nodeSeqscan.h"
@@ -257,6 +258,10 @@ ExecReScan(PlanState *node)
 			ExecReScanMemoize((MemoizeState *) node);
 			break;
 
+		case T_RepartitionState:
+			ExecReScanRepartition((RepartitionState *) node);
+			break;
+
 		case T_SortState:
 			ExecReScanSort((SortState *) node);
 			break;
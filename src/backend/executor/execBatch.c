@@ -0,0 +1,417 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Support for evaluating quals over batches of tuples
+ *
+ * The expression interpreter evaluates a qual one tuple at a time, paying
+ * for opcode dispatch and a function call through fmgr for every operator.
+ * For the common case of a qual that is just an AND of comparisons between
+ * a column of a built-in integer, float, date or timestamp type and a
+ * constant, and of IS [NOT] NULL tests on columns, we can do better: the
+ * qual is translated into a list of simple terms, and each term is applied
+ * to the column values of a whole batch of tuples in a tight loop that the
+ * compiler can vectorize.  BETWEEN arrives here as two comparisons.
+ *
+ * The translation works from the compiled ExprState, so it sees the qual
+ * after all the planner and executor simplifications, and falls back (by
+ * returning NULL) for anything it doesn't recognize.  Since comparisons of
+ * these types can't fail and the functions are strict, evaluating all the
+ * terms for all the tuples gives the same results as the interpreter's
+ * short-circuit evaluation.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/execBatch.h"
+#include "executor/execExpr.h"
+#include "executor/tuptable.h"
+#include "utils/date.h"
+#include "utils/float.h"
+#include "utils/fmgroids.h"
+#include "utils/timestamp.h"
+
+/* Value types, and kinds of test, handled by batch quals */
+typedef enum BatchQualKind
+{
+	BQ_INT2,
+	BQ_INT4,					/* also date */
+	BQ_INT8,					/* also timestamp and timestamptz */
+	BQ_FLOAT4,
+	BQ_FLOAT8,
+	BQ_ISNULL,
+	BQ_ISNOTNULL,
+} BatchQualKind;
+
+typedef enum BatchQualCmp
+{
+	BQ_EQ,
+	BQ_NE,
+	BQ_LT,
+	BQ_LE,
+	BQ_GT,
+	BQ_GE,
+} BatchQualCmp;
+
+/* One ANDed term: "column cmp constant", or a null test on a column */
+typedef struct BatchQualTerm
+{
+	int			attnum;			/* attribute number - 1 */
+	BatchQualKind kind;
+	BatchQualCmp cmp;
+	Datum		constval;
+} BatchQualTerm;
+
+struct BatchQual
+{
+	int			last_attnum;	/* deform the tuples up to this attribute */
+	int			nterms;
+	BatchQualTerm terms[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/* The comparison functions we know how to evaluate inline */
+static const struct
+{
+	Oid			fnoid;
+	BatchQualKind kind;
+	BatchQualCmp cmp;
+}			batch_qual_funcs[] =
+{
+	{F_INT2EQ, BQ_INT2, BQ_EQ},
+	{F_INT2NE, BQ_INT2, BQ_NE},
+	{F_INT2LT, BQ_INT2, BQ_LT},
+	{F_INT2LE, BQ_INT2, BQ_LE},
+	{F_INT2GT, BQ_INT2, BQ_GT},
+	{F_INT2GE, BQ_INT2, BQ_GE},
+	{F_INT4EQ, BQ_INT4, BQ_EQ},
+	{F_INT4NE, BQ_INT4, BQ_NE},
+	{F_INT4LT, BQ_INT4, BQ_LT},
+	{F_INT4LE, BQ_INT4, BQ_LE},
+	{F_INT4GT, BQ_INT4, BQ_GT},
+	{F_INT4GE, BQ_INT4, BQ_GE},
+	{F_DATE_EQ, BQ_INT4, BQ_EQ},
+	{F_DATE_NE, BQ_INT4, BQ_NE},
+	{F_DATE_LT, BQ_INT4, BQ_LT},
+	{F_DATE_LE, BQ_INT4, BQ_LE},
+	{F_DATE_GT, BQ_INT4, BQ_GT},
+	{F_DATE_GE, BQ_INT4, BQ_GE},
+	{F_INT8EQ, BQ_INT8, BQ_EQ},
+	{F_INT8NE, BQ_INT8, BQ_NE},
+	{F_INT8LT, BQ_INT8, BQ_LT},
+	{F_INT8LE, BQ_INT8, BQ_LE},
+	{F_INT8GT, BQ_INT8, BQ_GT},
+	{F_INT8GE, BQ_INT8, BQ_GE},
+	{F_TIMESTAMP_EQ, BQ_INT8, BQ_EQ},
+	{F_TIMESTAMP_NE, BQ_INT8, BQ_NE},
+	{F_TIMESTAMP_LT, BQ_INT8, BQ_LT},
+	{F_TIMESTAMP_LE, BQ_INT8, BQ_LE},
+	{F_TIMESTAMP_GT, BQ_INT8, BQ_GT},
+	{F_TIMESTAMP_GE, BQ_INT8, BQ_GE},
+	{F_FLOAT4EQ, BQ_FLOAT4, BQ_EQ},
+	{F_FLOAT4NE, BQ_FLOAT4, BQ_NE},
+	{F_FLOAT4LT, BQ_FLOAT4, BQ_LT},
+	{F_FLOAT4LE, BQ_FLOAT4, BQ_LE},
+	{F_FLOAT4GT, BQ_FLOAT4, BQ_GT},
+	{F_FLOAT4GE, BQ_FLOAT4, BQ_GE},
+	{F_FLOAT8EQ, BQ_FLOAT8, BQ_EQ},
+	{F_FLOAT8NE, BQ_FLOAT8, BQ_NE},
+	{F_FLOAT8LT, BQ_FLOAT8, BQ_LT},
+	{F_FLOAT8LE, BQ_FLOAT8, BQ_LE},
+	{F_FLOAT8GT, BQ_FLOAT8, BQ_GT},
+	{F_FLOAT8GE, BQ_FLOAT8, BQ_GE},
+};
+
+static bool BatchQualMakeCompare(ExprEvalStep *varop, ExprEvalStep *funcop,
+								 BatchQualTerm *term);
+static void BatchQualCompare(const BatchQualTerm *term, const Datum *values,
+							 const bool *nulls, int nslots, bool *matches);
+
+/*
+ * Translate a "column cmp constant" comparison step into a term.
+ */
+static bool
+BatchQualMakeCompare(ExprEvalStep *varop, ExprEvalStep *funcop,
+					 BatchQualTerm *term)
+{
+	FunctionCallInfo fcinfo = funcop->d.func.fcinfo_data;
+	Oid			fnoid = funcop->d.func.finfo->fn_oid;
+	int			constarg;
+	int			i;
+
+	if (funcop->d.func.nargs != 2)
+		return false;
+
+	/*
+	 * The column must be one argument, and the other one must be a
+	 * constant, which ExecInitFunc() stores directly into the arguments
+	 * without a step of its own.
+	 */
+	if (varop->resvalue == &fcinfo->args[0].value &&
+		varop->resnull == &fcinfo->args[0].isnull)
+		constarg = 1;
+	else if (varop->resvalue == &fcinfo->args[1].value &&
+			 varop->resnull == &fcinfo->args[1].isnull)
+		constarg = 0;
+	else
+		return false;
+
+	if (fcinfo->args[constarg].isnull)
+		return false;
+
+	for (i = 0; i < lengthof(batch_qual_funcs); i++)
+	{
+		if (batch_qual_funcs[i].fnoid == fnoid)
+			break;
+	}
+	if (i == lengthof(batch_qual_funcs))
+		return false;
+
+	term->kind = batch_qual_funcs[i].kind;
+	term->cmp = batch_qual_funcs[i].cmp;
+	term->constval = fcinfo->args[constarg].value;
+
+	/* "constant cmp column" is the commuted comparison */
+	if (constarg == 0)
+	{
+		switch (term->cmp)
+		{
+			case BQ_LT:
+				term->cmp = BQ_GT;
+				break;
+			case BQ_LE:
+				term->cmp = BQ_GE;
+				break;
+			case BQ_GT:
+				term->cmp = BQ_LT;
+				break;
+			case BQ_GE:
+				term->cmp = BQ_LE;
+				break;
+			case BQ_EQ:
+			case BQ_NE:
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Build a BatchQual equivalent to the given qual, which must have been
+ * built by ExecInitQual() for a scan node and be ready for execution.
+ *
+ * Returns NULL if the qual doesn't have the simple form we can evaluate
+ * over batches.
+ */
+BatchQual *
+ExecBuildBatchQual(ExprState *qual)
+{
+	BatchQual  *bq;
+	ExprEvalStep *steps;
+	int			nsteps;
+	int			off;
+
+	/*
+	 * We expect a SCAN_FETCHSOME step, then SCAN_VAR, test and QUAL steps
+	 * for each term, and finally DONE.
+	 */
+	if (qual == NULL || qual->steps_len < 5 || (qual->steps_len - 2) % 3 != 0)
+		return NULL;
+
+	steps = qual->steps;
+	nsteps = qual->steps_len;
+
+	if (ExecEvalStepOp(qual, &steps[0]) != EEOP_SCAN_FETCHSOME ||
+		ExecEvalStepOp(qual, &steps[nsteps - 1]) != EEOP_DONE)
+		return NULL;
+
+	bq = palloc(offsetof(BatchQual, terms) +
+				sizeof(BatchQualTerm) * ((nsteps - 2) / 3));
+	bq->last_attnum = steps[0].d.fetch.last_var;
+	bq->nterms = 0;
+
+	for (off = 1; off < nsteps - 1; off += 3)
+	{
+		ExprEvalStep *varop = &steps[off];
+		ExprEvalStep *testop = &steps[off + 1];
+		ExprEvalStep *qualop = &steps[off + 2];
+		BatchQualTerm *term = &bq->terms[bq->nterms];
+
+		if (ExecEvalStepOp(qual, varop) != EEOP_SCAN_VAR ||
+			ExecEvalStepOp(qual, qualop) != EEOP_QUAL ||
+			testop->resvalue != qualop->resvalue ||
+			varop->d.var.attnum >= bq->last_attnum)
+			break;
+
+		term->attnum = varop->d.var.attnum;
+
+		switch (ExecEvalStepOp(qual, testop))
+		{
+			case EEOP_NULLTEST_ISNULL:
+			case EEOP_NULLTEST_ISNOTNULL:
+				if (varop->resnull != testop->resnull)
+					goto fail;
+				term->kind =
+					ExecEvalStepOp(qual, testop) == EEOP_NULLTEST_ISNULL ?
+					BQ_ISNULL : BQ_ISNOTNULL;
+				term->cmp = BQ_EQ;	/* unused */
+				term->constval = (Datum) 0;
+				break;
+			case EEOP_FUNCEXPR_STRICT:
+				if (!BatchQualMakeCompare(varop, testop, term))
+					goto fail;
+				break;
+			default:
+				goto fail;
+		}
+
+		bq->nterms++;
+	}
+
+	if (off == nsteps - 1)
+		return bq;
+
+fail:
+	pfree(bq);
+	return NULL;
+}
+
+/* Inline comparisons of integer types */
+#define BQ_INT_EQ(a, b) ((a) == (b))
+#define BQ_INT_NE(a, b) ((a) != (b))
+#define BQ_INT_LT(a, b) ((a) < (b))
+#define BQ_INT_LE(a, b) ((a) <= (b))
+#define BQ_INT_GT(a, b) ((a) > (b))
+#define BQ_INT_GE(a, b) ((a) >= (b))
+
+/* Apply one comparison to all the values; nulls fail strict comparisons */
+#define BQ_COMPARE_LOOP(type, getter, cmpfn) \
+	do { \
+		type		c = getter(term->constval); \
+		for (int i = 0; i < nslots; i++) \
+			matches[i] &= !nulls[i] & cmpfn(getter(values[i]), c); \
+	} while (0)
+
+#define BQ_COMPARE(type, getter, eq, ne, lt, le, gt, ge) \
+	do { \
+		switch (term->cmp) \
+		{ \
+			case BQ_EQ: \
+				BQ_COMPARE_LOOP(type, getter, eq); \
+				break; \
+			case BQ_NE: \
+				BQ_COMPARE_LOOP(type, getter, ne); \
+				break; \
+			case BQ_LT: \
+				BQ_COMPARE_LOOP(type, getter, lt); \
+				break; \
+			case BQ_LE: \
+				BQ_COMPARE_LOOP(type, getter, le); \
+				break; \
+			case BQ_GT: \
+				BQ_COMPARE_LOOP(type, getter, gt); \
+				break; \
+			case BQ_GE: \
+				BQ_COMPARE_LOOP(type, getter, ge); \
+				break; \
+		} \
+	} while (0)
+
+/*
+ * Apply a comparison term to a batch of column values.
+ */
+static void
+BatchQualCompare(const BatchQualTerm *term, const Datum *values,
+				 const bool *nulls, int nslots, bool *matches)
+{
+	switch (term->kind)
+	{
+		case BQ_INT2:
+			BQ_COMPARE(int16, DatumGetInt16,
+					   BQ_INT_EQ, BQ_INT_NE, BQ_INT_LT,
+					   BQ_INT_LE, BQ_INT_GT, BQ_INT_GE);
+			break;
+		case BQ_INT4:
+			BQ_COMPARE(int32, DatumGetInt32,
+					   BQ_INT_EQ, BQ_INT_NE, BQ_INT_LT,
+					   BQ_INT_LE, BQ_INT_GT, BQ_INT_GE);
+			break;
+		case BQ_INT8:
+			BQ_COMPARE(int64, DatumGetInt64,
+					   BQ_INT_EQ, BQ_INT_NE, BQ_INT_LT,
+					   BQ_INT_LE, BQ_INT_GT, BQ_INT_GE);
+			break;
+		case BQ_FLOAT4:
+			BQ_COMPARE(float4, DatumGetFloat4,
+					   float4_eq, float4_ne, float4_lt,
+					   float4_le, float4_gt, float4_ge);
+			break;
+		case BQ_FLOAT8:
+			BQ_COMPARE(float8, DatumGetFloat8,
+					   float8_eq, float8_ne, float8_lt,
+					   float8_le, float8_gt, float8_ge);
+			break;
+		case BQ_ISNULL:
+		case BQ_ISNOTNULL:
+			Assert(false);
+			break;
+	}
+}
+
+/*
+ * Evaluate a batch qual for the tuples in 'slots', setting matches[i] to
+ * whether slots[i] passes it.  Returns the number of matching tuples.
+ */
+int
+ExecBatchQual(BatchQual *bq, TupleTableSlot **slots, int nslots,
+			  bool *matches)
+{
+	Datum		values[EXEC_BATCH_SIZE];
+	bool		nulls[EXEC_BATCH_SIZE];
+	int			nmatches = 0;
+
+	Assert(nslots <= EXEC_BATCH_SIZE);
+
+	for (int i = 0; i < nslots; i++)
+	{
+		slot_getsomeattrs(slots[i], bq->last_attnum);
+		matches[i] = true;
+	}
+
+	for (int t = 0; t < bq->nterms; t++)
+	{
+		const BatchQualTerm *term = &bq->terms[t];
+
+		/* gather the column into arrays so the tests below vectorize */
+		for (int i = 0; i < nslots; i++)
+		{
+			values[i] = slots[i]->tts_values[term->attnum];
+			nulls[i] = slots[i]->tts_isnull[term->attnum];
+		}
+
+		if (term->kind == BQ_ISNULL)
+		{
+			for (int i = 0; i < nslots; i++)
+				matches[i] &= nulls[i];
+		}
+		else if (term->kind == BQ_ISNOTNULL)
+		{
+			for (int i = 0; i < nslots; i++)
+				matches[i] &= !nulls[i];
+		}
+		else
+			BatchQualCompare(term, values, nulls, nslots, matches);
+	}
+
+	for (int i = 0; i < nslots; i++)
+		nmatches += matches[i];
+
+	return nmatches;
+}
@@ -66,6 +66,7 @@ typedef struct ExprSetupInfo
 static void ExecReadyExpr(ExprState *state);
 static void ExecInitExprRec(Expr *node, ExprState *state,
 							Datum *resv, bool *resnull);
+static void *ExecExprArenaAlloc0(ExprState *state, Size size);
 static void ExecInitFunc(ExprEvalStep *scratch, Expr *node, List *args,
 						 Oid funcid, Oid inputcollid,
 						 ExprState *state);
@@ -229,6 +230,14 @@ ExecInitQual(List *qual, PlanState *parent)
 
 	Assert(IsA(qual, List));
 
+	/* A plan node's own qual may have been kept from an earlier execution */
+	if (parent != NULL && parent->plan != NULL && qual == parent->plan->qual)
+	{
+		state = ExecGetCachedQual(qual, parent);
+		if (state != NULL)
+			return state;
+	}
+
 	state = makeNode(ExprState);
 	state->expr = (Expr *) qual;
 	state->parent = parent;
@@ -867,14 +876,21 @@ ExecCheck(ExprState *state, ExprContext *econtext)
  * Prepare a compiled expression for execution.  This has to be called for
  * every ExprState before it can be executed.
  *
- * NB: While this currently only calls ExecReadyInterpretedExpr(),
- * this will likely get extended to further expression evaluation methods.
- * Therefore this should be used instead of directly calling
+ * Expressions are JIT compiled if possible, otherwise interpreted.  With
+ * jit_tier_up_threshold set, expressions that would be JIT compiled start
+ * out interpreted, and are only compiled once they have been evaluated that
+ * often.  This should be used instead of directly calling
  * ExecReadyInterpretedExpr().
  */
 static void
 ExecReadyExpr(ExprState *state)
 {
+	if (jit_tier_up_threshold > 0 && jit_expr_wanted(state))
+	{
+		ExecReadyTieredExpr(state);
+		return;
+	}
+
 	if (jit_compile_expr(state))
 		return;
 
@@ -1250,8 +1266,8 @@ ExecInitExprRec(Expr *node, ExprState *state,
 				}
 
 				/* Set up the primary fmgr lookup information */
-				finfo = palloc0(sizeof(FmgrInfo));
-				fcinfo = palloc0(SizeForFunctionCallInfo(2));
+				finfo = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+				fcinfo = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(2));
 				fmgr_info(cmpfuncid, finfo);
 				fmgr_info_set_expr((Node *) node, finfo);
 				InitFunctionCallInfoData(*fcinfo, finfo, 2,
@@ -1585,8 +1601,8 @@ ExecInitExprRec(Expr *node, ExprState *state,
 					scratch.opcode = EEOP_IOCOERCE_SAFE;
 
 				/* lookup the source type's output function */
-				scratch.d.iocoerce.finfo_out = palloc0(sizeof(FmgrInfo));
-				scratch.d.iocoerce.fcinfo_data_out = palloc0(SizeForFunctionCallInfo(1));
+				scratch.d.iocoerce.finfo_out = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+				scratch.d.iocoerce.fcinfo_data_out = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(1));
 
 				getTypeOutputInfo(exprType((Node *) iocoerce->arg),
 								  &iofunc, &typisvarlena);
@@ -1597,8 +1613,8 @@ ExecInitExprRec(Expr *node, ExprState *state,
 										 1, InvalidOid, NULL, NULL);
 
 				/* lookup the result type's input function */
-				scratch.d.iocoerce.finfo_in = palloc0(sizeof(FmgrInfo));
-				scratch.d.iocoerce.fcinfo_data_in = palloc0(SizeForFunctionCallInfo(3));
+				scratch.d.iocoerce.finfo_in = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+				scratch.d.iocoerce.fcinfo_data_in = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(3));
 
 				getTypeInputInfo(iocoerce->resulttype,
 								 &iofunc, &typioparam);
@@ -2056,8 +2072,8 @@ ExecInitExprRec(Expr *node, ExprState *state,
 							 BTORDER_PROC, lefttype, righttype, opfamily);
 
 					/* Set up the primary fmgr lookup information */
-					finfo = palloc0(sizeof(FmgrInfo));
-					fcinfo = palloc0(SizeForFunctionCallInfo(2));
+					finfo = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+					fcinfo = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(2));
 					fmgr_info(proc, finfo);
 					fmgr_info_set_expr((Node *) node, finfo);
 					InitFunctionCallInfoData(*fcinfo, finfo, 2,
@@ -2199,8 +2215,8 @@ ExecInitExprRec(Expr *node, ExprState *state,
 				 */
 
 				/* Perform function lookup */
-				finfo = palloc0(sizeof(FmgrInfo));
-				fcinfo = palloc0(SizeForFunctionCallInfo(2));
+				finfo = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+				fcinfo = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(2));
 				fmgr_info(typentry->cmp_proc, finfo);
 				fmgr_info_set_expr((Node *) node, finfo);
 				InitFunctionCallInfoData(*fcinfo, finfo, 2,
@@ -2605,6 +2621,24 @@ ExprEvalPushStep(ExprState *es, const ExprEvalStep *s)
 	memcpy(&es->steps[es->steps_len++], s, sizeof(ExprEvalStep));
 }
 
+/*
+ * Allocate zeroed, fixed-size expression workspace that lives as long as the
+ * expression and is never freed or resized on its own, such as the FmgrInfo
+ * and FunctionCallInfo of a function call step.  When the expression is
+ * being built in its executor's per-query context, the space comes from the
+ * executor's arena, which saves the per-chunk overhead of the allocation.
+ */
+static void *
+ExecExprArenaAlloc0(ExprState *state, Size size)
+{
+	EState	   *estate = state->parent ? state->parent->state : NULL;
+
+	if (estate != NULL && CurrentMemoryContext == estate->es_query_cxt)
+		return MemoryContextAllocZero(ExecGetArenaContext(estate), size);
+
+	return palloc0(size);
+}
+
 /*
  * Perform setup necessary for the evaluation of a function-like expression,
  * appending argument evaluation steps to the steps list in *state, and
@@ -2645,8 +2679,8 @@ ExecInitFunc(ExprEvalStep *scratch, Expr *node, List *args, Oid funcid,
 							   FUNC_MAX_ARGS)));
 
 	/* Allocate function lookup data and parameter workspace for this call */
-	scratch->d.func.finfo = palloc0(sizeof(FmgrInfo));
-	scratch->d.func.fcinfo_data = palloc0(SizeForFunctionCallInfo(nargs));
+	scratch->d.func.finfo = ExecExprArenaAlloc0(state, sizeof(FmgrInfo));
+	scratch->d.func.fcinfo_data = ExecExprArenaAlloc0(state, SizeForFunctionCallInfo(nargs));
 	flinfo = scratch->d.func.finfo;
 	fcinfo = scratch->d.func.fcinfo_data;
 
@@ -0,0 +1,432 @@
+/*-------------------------------------------------------------------------
+ *
+ * execExprCache.c
+ *	  Reuse of expression states across executions of a generic plan
+ *
+ * Initializing a plan node's qual and projection looks up every function
+ * involved, checks permissions on it and builds the array of steps that
+ * execExprInterp.c runs.  For short queries executed over and over from a
+ * generic cached plan, redoing this at every ExecutorStart() is a large
+ * part of the total cost.  When plancache.c marks a PlannedStmt as a
+ * generic plan, we therefore build these states once, in a memory context
+ * belonging to the plan, and later executions only point them at their own
+ * PlanState, result slot and ExprContext.
+ *
+ * Only expressions that are built from a few simple node types are cached
+ * (see expr_is_cacheable()).  Their steps fetch everything that depends on
+ * the execution (tuples, parameter values) from the ExprContext at run
+ * time, and keep no pointers to per-query memory.  Functions are limited to
+ * built-in and C-language ones without SECURITY DEFINER or SET clauses, so
+ * that what they cache in fn_extra stays valid.  Permission checks and the
+ * function-execute hook are repeated each time cached states are reused,
+ * as ExecInitFunc() would have done.  Cached states are interpreted, so
+ * nothing is cached when the query is to be JIT-compiled.
+ *
+ * The states of a plan node can be used by only one executor at a time; a
+ * second executor running the same plan concurrently (say, another open
+ * cursor) builds its own.  A plan node's cache is checked out by the first
+ * PlanState that asks for it and handed back by ExecEndNode().  If the
+ * query fails in between, the cache is never handed back.  It is then
+ * considered free again once the top-level transaction that checked it out
+ * is over, since no executor outlives its top-level transaction.
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execExprCache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/parallel.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_proc.h"
+#include "executor/execExpr.h"
+#include "executor/executor.h"
+#include "jit/jit.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "pgstat.h"
+#include "storage/proc.h"
+#include "utils/acl.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+typedef struct expr_cacheable_context
+{
+	bool		allow_extern_params;	/* may PARAM_EXTERN Params appear? */
+	List	   *funcids;		/* OIDs of functions called */
+} expr_cacheable_context;
+
+static PlanExprCache *ExecCheckOutPlanExprCache(PlanState *planstate);
+static bool expr_is_cacheable(Node *expr, PlanState *planstate,
+							  List **funcids);
+static bool expr_cacheable_walker(Node *node,
+								  expr_cacheable_context *context);
+static bool func_is_cacheable(Oid funcid);
+static void ExecForgetSlotInfo(ExprState *state);
+
+
+/*
+ * ExecGetCachedQual
+ *		Return the cached ExprState for the qual of parent's plan node
+ *
+ * Returns NULL if the caller should build the qual itself.
+ */
+ExprState *
+ExecGetCachedQual(List *qual, PlanState *parent)
+{
+	PlanExprCache *cache;
+	MemoryContext oldcontext;
+	List	   *funcids;
+
+	Assert(qual == parent->plan->qual);
+
+	cache = ExecCheckOutPlanExprCache(parent);
+	if (cache == NULL)
+		return NULL;
+
+	if (!cache->qual_done)
+	{
+		oldcontext = MemoryContextSwitchTo(cache->context);
+		if (expr_is_cacheable((Node *) qual, parent, &funcids))
+		{
+			/* ExecInitQual() will call us again; make it build the qual */
+			cache->building = true;
+			PG_TRY();
+			{
+				cache->qual = ExecInitQual(qual, parent);
+			}
+			PG_FINALLY();
+			{
+				cache->building = false;
+			}
+			PG_END_TRY();
+			ExecForgetSlotInfo(cache->qual);
+			cache->funcids = list_concat(cache->funcids, funcids);
+		}
+		MemoryContextSwitchTo(oldcontext);
+		cache->qual_done = true;
+	}
+
+	if (cache->qual == NULL)
+		return NULL;
+
+	cache->qual->parent = parent;
+	return cache->qual;
+}
+
+/*
+ * ExecGetCachedProjection
+ *		Return the cached ProjectionInfo for planstate's targetlist
+ *
+ * The projection is pointed at planstate's ExprContext and result slot.
+ * Returns NULL if the caller should build the projection itself.
+ */
+ProjectionInfo *
+ExecGetCachedProjection(PlanState *planstate, TupleDesc inputDesc)
+{
+	PlanExprCache *cache;
+	ProjectionInfo *projInfo;
+	MemoryContext oldcontext;
+	List	   *funcids;
+
+	cache = ExecCheckOutPlanExprCache(planstate);
+	if (cache == NULL)
+		return NULL;
+
+	if (!cache->proj_done)
+	{
+		List	   *tlist = planstate->plan->targetlist;
+
+		oldcontext = MemoryContextSwitchTo(cache->context);
+		if (expr_is_cacheable((Node *) tlist, planstate, &funcids))
+		{
+			cache->projection =
+				ExecBuildProjectionInfo(tlist,
+										planstate->ps_ExprContext,
+										planstate->ps_ResultTupleSlot,
+										planstate,
+										inputDesc);
+			ExecForgetSlotInfo(&cache->projection->pi_state);
+			cache->funcids = list_concat(cache->funcids, funcids);
+		}
+		MemoryContextSwitchTo(oldcontext);
+		cache->proj_done = true;
+	}
+
+	projInfo = cache->projection;
+	if (projInfo == NULL)
+		return NULL;
+
+	projInfo->pi_exprContext = planstate->ps_ExprContext;
+	projInfo->pi_state.resultslot = planstate->ps_ResultTupleSlot;
+	projInfo->pi_state.parent = planstate;
+	return projInfo;
+}
+
+/*
+ * ExecReleasePlanExprCache
+ *		Hand the expression cache checked out by planstate back to its plan
+ */
+void
+ExecReleasePlanExprCache(PlanState *planstate)
+{
+	PlanExprCache *cache = planstate->exprcache;
+
+	Assert(cache != NULL && cache->in_use);
+
+	/* don't leave pointers to the soon-to-be-freed executor state around */
+	if (cache->qual)
+		cache->qual->parent = NULL;
+	if (cache->projection)
+	{
+		cache->projection->pi_exprContext = NULL;
+		cache->projection->pi_state.resultslot = NULL;
+		cache->projection->pi_state.parent = NULL;
+	}
+
+	cache->in_use = false;
+	planstate->exprcache = NULL;
+}
+
+/*
+ * Check out the expression cache of planstate's plan node for planstate,
+ * creating it if needed.  Returns NULL if cached expression states cannot
+ * be used.
+ */
+static PlanExprCache *
+ExecCheckOutPlanExprCache(PlanState *planstate)
+{
+	Plan	   *plan = planstate->plan;
+	EState	   *estate = planstate->state;
+	PlanExprCache *cache;
+	ListCell   *lc;
+
+	/* already checked out by this node? */
+	if (planstate->exprcache != NULL)
+	{
+		cache = planstate->exprcache;
+		return cache->building ? NULL : cache;
+	}
+
+	if (estate->es_plannedstmt == NULL ||
+		!estate->es_plannedstmt->cacheExprStates)
+		return NULL;
+
+	/* cached states are never JIT-compiled, nor tracked as function calls */
+	if (estate->es_jit_flags != PGJIT_NONE ||
+		pgstat_track_functions != TRACK_FUNC_OFF)
+		return NULL;
+
+	/* a worker's copy of the plan won't be executed again */
+	if (IsParallelWorker())
+		return NULL;
+
+	cache = plan->exprcache;
+	if (cache == NULL)
+	{
+		MemoryContext cxt;
+
+		/* the cache lives as long as the plan itself */
+		cxt = AllocSetContextCreate(GetMemoryChunkContext(plan),
+									"Plan expression cache",
+									ALLOCSET_SMALL_SIZES);
+		cache = (PlanExprCache *) MemoryContextAllocZero(cxt,
+														 sizeof(PlanExprCache));
+		cache->type = T_PlanExprCache;
+		cache->context = cxt;
+		plan->exprcache = cache;
+	}
+	else
+	{
+		/* in use by another executor in this transaction? */
+		if (cache->in_use && cache->checkout_lxid == MyProc->vxid.lxid)
+			return NULL;
+
+		/* Redo the checks ExecInitFunc() made while building the states */
+		foreach(lc, cache->funcids)
+		{
+			Oid			funcid = lfirst_oid(lc);
+			AclResult	aclresult;
+
+			aclresult = object_aclcheck(ProcedureRelationId, funcid,
+										GetUserId(), ACL_EXECUTE);
+			if (aclresult != ACLCHECK_OK)
+				aclcheck_error(aclresult, OBJECT_FUNCTION,
+							   get_func_name(funcid));
+			InvokeFunctionExecuteHook(funcid);
+		}
+	}
+
+	cache->in_use = true;
+	cache->checkout_lxid = MyProc->vxid.lxid;
+	planstate->exprcache = cache;
+
+	return cache;
+}
+
+/*
+ * Can the ExprState for expr be reused by later executions?  If so, the
+ * functions it calls are returned in *funcids.
+ */
+static bool
+expr_is_cacheable(Node *expr, PlanState *planstate, List **funcids)
+{
+	ParamListInfo params = planstate->state->es_param_list_info;
+	expr_cacheable_context context;
+
+	/*
+	 * Extern Params are fine if they compile to EEOP_PARAM_EXTERN, which
+	 * fetches the value at run time; not if a paramCompile hook would turn
+	 * them into a callback bound to this execution.
+	 */
+	context.allow_extern_params = (params == NULL ||
+								   params->paramCompile == NULL);
+	context.funcids = NIL;
+
+	if (expr_cacheable_walker(expr, &context))
+	{
+		list_free(context.funcids);
+		return false;
+	}
+
+	*funcids = context.funcids;
+	return true;
+}
+
+/*
+ * Returns true if the expression tree contains a node we don't know to be
+ * safe to cache.
+ */
+static bool
+expr_cacheable_walker(Node *node, expr_cacheable_context *context)
+{
+	Oid			funcid;
+
+	if (node == NULL)
+		return false;
+
+	switch (nodeTag(node))
+	{
+		case T_List:
+		case T_TargetEntry:
+		case T_Const:
+		case T_RelabelType:
+		case T_BoolExpr:
+		case T_BooleanTest:
+			break;
+
+		case T_Var:
+			/* whole-row Vars keep conversion state for the execution */
+			if (((Var *) node)->varattno == InvalidAttrNumber)
+				return true;
+			break;
+
+		case T_Param:
+			{
+				Param	   *param = (Param *) node;
+
+				if (param->paramkind == PARAM_EXTERN)
+				{
+					if (!context->allow_extern_params)
+						return true;
+				}
+				else if (param->paramkind != PARAM_EXEC)
+					return true;
+			}
+			break;
+
+		case T_NullTest:
+			/* row-valued tests keep a tuple descriptor for the execution */
+			if (((NullTest *) node)->argisrow)
+				return true;
+			break;
+
+		case T_OpExpr:
+		case T_DistinctExpr:
+		case T_NullIfExpr:
+			funcid = ((OpExpr *) node)->opfuncid;
+			if (!OidIsValid(funcid) || !func_is_cacheable(funcid))
+				return true;
+			context->funcids = lappend_oid(context->funcids, funcid);
+			break;
+
+		case T_FuncExpr:
+			if (((FuncExpr *) node)->funcretset)
+				return true;
+			funcid = ((FuncExpr *) node)->funcid;
+			if (!func_is_cacheable(funcid))
+				return true;
+			context->funcids = lappend_oid(context->funcids, funcid);
+			break;
+
+		default:
+			return true;
+	}
+
+	return expression_tree_walker(node, expr_cacheable_walker,
+								  (void *) context);
+}
+
+/*
+ * Is a FmgrInfo for the function safe to keep across executions?  We trust
+ * built-in and C-language functions to keep only execution-independent data
+ * in fn_extra; other languages and fmgr_security_definer() may not.
+ */
+static bool
+func_is_cacheable(Oid funcid)
+{
+	HeapTuple	proctup;
+	Form_pg_proc procform;
+	bool		result;
+
+	proctup = SearchSysCache1(PROCOID, ObjectIdGetDatum(funcid));
+	if (!HeapTupleIsValid(proctup))
+		return false;
+	procform = (Form_pg_proc) GETSTRUCT(proctup);
+
+	result = (procform->prolang == INTERNALlanguageId ||
+			  procform->prolang == ClanguageId) &&
+		!procform->prosecdef &&
+		heap_attisnull(proctup, Anum_pg_proc_proconfig, NULL);
+
+	ReleaseSysCache(proctup);
+
+	return result;
+}
+
+/*
+ * Forget what the steps of a freshly built state know about the slots of
+ * the execution that built it.  The descriptors noted in the fetch steps
+ * belong to that execution; they are only needed for JIT compilation and
+ * cross-checks, so dropping them is harmless.
+ */
+static void
+ExecForgetSlotInfo(ExprState *state)
+{
+	for (int i = 0; i < state->steps_len; i++)
+	{
+		ExprEvalStep *op = &state->steps[i];
+
+		switch (ExecEvalStepOp(state, op))
+		{
+			case EEOP_INNER_FETCHSOME:
+			case EEOP_OUTER_FETCHSOME:
+			case EEOP_SCAN_FETCHSOME:
+				op->d.fetch.fixed = false;
+				op->d.fetch.known_desc = NULL;
+				op->d.fetch.kind = NULL;
+				break;
+			default:
+				break;
+		}
+	}
+}
@@ -62,6 +62,7 @@
 #include "executor/execExpr.h"
 #include "executor/nodeSubplan.h"
 #include "funcapi.h"
+#include "jit/jit.h"
 #include "miscadmin.h"
 #include "nodes/miscnodes.h"
 #include "nodes/nodeFuncs.h"
@@ -142,6 +143,7 @@ static ExprEvalOpLookup reverse_dispatch_table[EEOP_LAST];
 
 
 static Datum ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull);
+static Datum ExecInterpExprTierUp(ExprState *state, ExprContext *econtext, bool *isnull);
 static void ExecInitInterpreter(void);
 
 /* support functions */
@@ -1894,6 +1896,71 @@ out:
 	return state->resvalue;
 }
 
+/*
+ * Prepare an expression for interpreted execution, to be JIT compiled once
+ * it has been evaluated jit_tier_up_threshold times.
+ *
+ * Until then, the expression is evaluated by ExecInterpExprTierUp(), which
+ * counts evaluations.  Expressions simple enough for one of the fast-path
+ * evalfuncs are not worth compiling, and are left interpreted.
+ */
+void
+ExecReadyTieredExpr(ExprState *state)
+{
+	ExecReadyInterpretedExpr(state);
+
+	if (state->evalfunc_private != (void *) ExecInterpExpr)
+		return;
+
+	Assert(state->evalfunc == ExecInterpExprStillValid);
+	state->jit_countdown = jit_tier_up_threshold;
+	state->evalfunc = ExecInterpExprTierUp;
+}
+
+/*
+ * Expression evaluation callback for an expression set up by
+ * ExecReadyTieredExpr().
+ */
+static Datum
+ExecInterpExprTierUp(ExprState *state, ExprContext *econtext, bool *isNull)
+{
+	ExprStateEvalFunc interpfunc = (ExprStateEvalFunc) state->evalfunc_private;
+
+	/* first time through, do what ExecInterpExprStillValid() would */
+	if (!(state->flags & EEO_FLAG_TIER_UP_CHECKED))
+	{
+		CheckExprStillValid(state, econtext);
+		state->flags |= EEO_FLAG_TIER_UP_CHECKED;
+	}
+
+	if (--state->jit_countdown <= 0)
+	{
+		MemoryContext oldcontext;
+		bool		compiled;
+
+		/*
+		 * The compiled expression's state has to live as long as the
+		 * expression, not just as long as the current evaluation.
+		 */
+		oldcontext = MemoryContextSwitchTo(state->parent->state->es_query_cxt);
+		compiled = jit_compile_expr(state);
+		MemoryContextSwitchTo(oldcontext);
+
+		/*
+		 * On success, evalfunc now points to the compiled code.  The steps
+		 * are unchanged, so it picks up with exactly the same state as the
+		 * interpreter would.  Otherwise keep interpreting, without counting.
+		 */
+		if (compiled)
+			return state->evalfunc(state, econtext, isNull);
+
+		state->evalfunc = interpfunc;
+		state->evalfunc_private = (void *) interpfunc;
+	}
+
+	return interpfunc(state, econtext, isNull);
+}
+
 /*
  * Expression evaluation callback that performs extra checks before executing
  * the expression. Declared extern so other methods of execution can use it
@@ -41,6 +41,7 @@ static inline TupleHashEntry LookupTupleHashEntry_internal(TupleHashTable hashta
 #define SH_SCOPE extern
 #define SH_STORE_HASH
 #define SH_GET_HASH(tb, a) a->hash
+#define SH_USE_TAGS
 #define SH_DEFINE
 #include "lib/simplehash.h"
 
@@ -352,6 +353,18 @@ TupleHashTableHash(TupleHashTable hashtable, TupleTableSlot *slot)
 	return hash;
 }
 
+/*
+ * Hint that a lookup with the given hash value is coming up, so that the
+ * bucket it starts at can be brought into cache in the meantime.
+ */
+void
+TupleHashTablePrefetch(TupleHashTable hashtable, uint32 hash)
+{
+	tuplehash_hash *tb = hashtable->hashtab;
+
+	pg_prefetch_mem(&tb->data[hash & tb->sizemask]);
+}
+
 /*
  * A variant of LookupTupleHashEntry for callers that have already computed
  * the hash value.
@@ -113,6 +113,7 @@
 #include "catalog/index.h"
 #include "executor/executor.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
 #include "storage/lmgr.h"
 #include "utils/snapmgr.h"
 
@@ -141,6 +142,14 @@ static bool index_unchanged_by_update(ResultRelInfo *resultRelInfo,
 									  Relation indexRelation);
 static bool index_expression_changed_walker(Node *node,
 											Bitmapset *allUpdatedCols);
+static List *ExecInsertIndexTuplesInternal(ResultRelInfo *resultRelInfo,
+										   TupleTableSlot *slot, EState *estate,
+										   bool update,
+										   bool noDupErr,
+										   bool *specConflict,
+										   List *arbiterIndexes,
+										   bool onlySummarizing,
+										   const bool *skipIndexes);
 
 /* ----------------------------------------------------------------
  *		ExecOpenIndices
@@ -303,6 +312,158 @@ ExecInsertIndexTuples(ResultRelInfo *resultRelInfo,
 					  bool *specConflict,
 					  List *arbiterIndexes,
 					  bool onlySummarizing)
+{
+	return ExecInsertIndexTuplesInternal(resultRelInfo, slot, estate,
+										 update, noDupErr, specConflict,
+										 arbiterIndexes, onlySummarizing,
+										 NULL);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInsertIndexTuplesBatch
+ *
+ *		This routine inserts the index tuples of a batch of newly
+ *		inserted tuples, for those indexes that can do it in one go:
+ *		indexes without unique or exclusion constraints, whose AM
+ *		provides aminsertbatch.  That lets the AM sort the entries
+ *		and add them in one pass, instead of searching the index
+ *		for each of them separately.
+ *
+ *		Returns an array of ri_NumIndices flags telling which indexes
+ *		were taken care of, or NULL if none were.  The caller must
+ *		then insert the index tuples for the remaining indexes one
+ *		tuple at a time, with ExecInsertRemainingIndexTuples.
+ *
+ *		The index values are kept in the EState's per-tuple memory
+ *		context until all tuples have been processed, so the caller
+ *		shouldn't use a large batch with expression indexes.
+ * ----------------------------------------------------------------
+ */
+bool *
+ExecInsertIndexTuplesBatch(ResultRelInfo *resultRelInfo,
+						   TupleTableSlot **slots, int nslots,
+						   EState *estate)
+{
+	bool	   *batched = NULL;
+	int			numIndices = resultRelInfo->ri_NumIndices;
+	RelationPtr relationDescs = resultRelInfo->ri_IndexRelationDescs;
+	IndexInfo **indexInfoArray = resultRelInfo->ri_IndexRelationInfo;
+	Relation	heapRelation = resultRelInfo->ri_RelationDesc;
+	ExprContext *econtext;
+	MemoryContext oldcontext;
+	Datum	  **values;
+	bool	  **isnull;
+	ItemPointer tids;
+
+	if (nslots < 2)
+		return NULL;
+
+	econtext = GetPerTupleExprContext(estate);
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	values = palloc(sizeof(Datum *) * nslots);
+	isnull = palloc(sizeof(bool *) * nslots);
+	tids = palloc(sizeof(ItemPointerData) * nslots);
+
+	for (int i = 0; i < numIndices; i++)
+	{
+		Relation	indexRelation = relationDescs[i];
+		IndexInfo  *indexInfo;
+		ExprState  *predicate = NULL;
+		int			ntuples = 0;
+
+		if (indexRelation == NULL)
+			continue;
+
+		indexInfo = indexInfoArray[i];
+
+		if (!indexInfo->ii_ReadyForInserts ||
+			indexRelation->rd_index->indisunique ||
+			indexInfo->ii_ExclusionOps != NULL ||
+			indexRelation->rd_indam->aminsertbatch == NULL)
+			continue;
+
+		if (indexInfo->ii_Predicate != NIL)
+		{
+			/* see ExecInsertIndexTuples */
+			predicate = indexInfo->ii_PredicateState;
+			if (predicate == NULL)
+			{
+				predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+				indexInfo->ii_PredicateState = predicate;
+			}
+		}
+
+		for (int j = 0; j < nslots; j++)
+		{
+			TupleTableSlot *slot = slots[j];
+
+			Assert(ItemPointerIsValid(&slot->tts_tid));
+			Assert(slot->tts_tableOid == RelationGetRelid(heapRelation));
+
+			econtext->ecxt_scantuple = slot;
+
+			if (predicate != NULL && !ExecQual(predicate, econtext))
+				continue;
+
+			values[ntuples] = palloc(sizeof(Datum) * indexInfo->ii_NumIndexAttrs);
+			isnull[ntuples] = palloc(sizeof(bool) * indexInfo->ii_NumIndexAttrs);
+			FormIndexDatum(indexInfo, slot, estate,
+						   values[ntuples], isnull[ntuples]);
+			tids[ntuples] = slot->tts_tid;
+			ntuples++;
+		}
+
+		if (ntuples > 0)
+			index_insert_batch(indexRelation, values, isnull, tids, ntuples,
+							   heapRelation, indexInfo);
+
+		if (batched == NULL)
+		{
+			MemoryContextSwitchTo(oldcontext);
+			batched = palloc0(sizeof(bool) * numIndices);
+			MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+		}
+		batched[i] = true;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return batched;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInsertRemainingIndexTuples
+ *
+ *		Like ExecInsertIndexTuples for a newly inserted tuple, but
+ *		skips the indexes that are marked in 'batched', as returned
+ *		by ExecInsertIndexTuplesBatch.  'batched' can be NULL.
+ * ----------------------------------------------------------------
+ */
+List *
+ExecInsertRemainingIndexTuples(ResultRelInfo *resultRelInfo,
+							   TupleTableSlot *slot, EState *estate,
+							   const bool *batched)
+{
+	return ExecInsertIndexTuplesInternal(resultRelInfo, slot, estate,
+										 false, false, NULL, NIL, false,
+										 batched);
+}
+
+/*
+ * Workhorse of ExecInsertIndexTuples and ExecInsertRemainingIndexTuples.
+ * Indexes with skipIndexes[i] set are left alone, if skipIndexes isn't NULL.
+ */
+static List *
+ExecInsertIndexTuplesInternal(ResultRelInfo *resultRelInfo,
+							  TupleTableSlot *slot,
+							  EState *estate,
+							  bool update,
+							  bool noDupErr,
+							  bool *specConflict,
+							  List *arbiterIndexes,
+							  bool onlySummarizing,
+							  const bool *skipIndexes)
 {
 	ItemPointer tupleid = &slot->tts_tid;
 	List	   *result = NIL;
@@ -352,6 +513,10 @@ ExecInsertIndexTuples(ResultRelInfo *resultRelInfo,
 		if (indexRelation == NULL)
 			continue;
 
+		/* Skip indexes the caller has already taken care of */
+		if (skipIndexes != NULL && skipIndexes[i])
+			continue;
+
 		indexInfo = indexInfoArray[i];
 
 		/* If the index is marked as read-only, ignore it */
@@ -506,6 +671,131 @@ ExecInsertIndexTuples(ResultRelInfo *resultRelInfo,
 	return result;
 }
 
+/*
+ * Add the table columns that the given index refers to, in its key and
+ * INCLUDE columns, expressions or predicate, to *attrs.
+ */
+static void
+index_referenced_attrs(IndexInfo *indexInfo, Bitmapset **attrs)
+{
+	for (int attr = 0; attr < indexInfo->ii_NumIndexAttrs; attr++)
+	{
+		int			attrnum = indexInfo->ii_IndexAttrNumbers[attr];
+
+		if (attrnum != 0)
+			*attrs = bms_add_member(*attrs,
+									attrnum - FirstLowInvalidHeapAttributeNumber);
+	}
+	pull_varattnos((Node *) indexInfo->ii_Expressions, 1, attrs);
+	pull_varattnos((Node *) indexInfo->ii_Predicate, 1, attrs);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecGetUnindexedAttrs
+ *
+ *		Find the columns whose changes no index needs to see in an
+ *		UPDATE of the row in 'oldslot' to the one in 'slot'.
+ *
+ *		A partial index whose predicate is false for both versions of
+ *		the row contains neither of them, so it doesn't care what
+ *		happens to the columns it refers to.  The columns referenced
+ *		only by such indexes are returned, for table_tuple_update()'s
+ *		unindexed_attrs; the table AM may then do a HOT update even
+ *		though they changed.  Returns NULL if there are none.
+ *
+ *		Only partial indexes that refer to columns targeted by the
+ *		UPDATE are checked, so as not to spend time evaluating
+ *		predicates that can't make a difference.  Summarizing indexes
+ *		are ignored, since they don't prevent HOT updates anyway.
+ *		The result is allocated in the per-tuple memory context.
+ * ----------------------------------------------------------------
+ */
+Bitmapset *
+ExecGetUnindexedAttrs(ResultRelInfo *resultRelInfo, TupleTableSlot *oldslot,
+					  TupleTableSlot *slot, EState *estate)
+{
+	int			numIndices = resultRelInfo->ri_NumIndices;
+	IndexInfo **indexInfoArray = resultRelInfo->ri_IndexRelationInfo;
+	ExprContext *econtext;
+	TupleTableSlot *save_scantuple;
+	MemoryContext oldcontext;
+	Bitmapset  *updatedCols = NULL;
+	Bitmapset  *unindexed = NULL;
+	Bitmapset  *indexed = NULL;
+	bool	   *exempt = NULL;
+	int			i;
+
+	/* Quick exit if there are no partial indexes to consider */
+	for (i = 0; i < numIndices; i++)
+	{
+		if (indexInfoArray[i]->ii_Predicate != NIL &&
+			!indexInfoArray[i]->ii_Summarizing)
+			break;
+	}
+	if (i >= numIndices)
+		return NULL;
+
+	econtext = GetPerTupleExprContext(estate);
+	save_scantuple = econtext->ecxt_scantuple;
+	oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	for (; i < numIndices; i++)
+	{
+		IndexInfo  *indexInfo = indexInfoArray[i];
+		ExprState  *predicate;
+		Bitmapset  *attrs = NULL;
+
+		if (indexInfo->ii_Predicate == NIL || indexInfo->ii_Summarizing)
+			continue;
+
+		if (updatedCols == NULL)
+			updatedCols = bms_union(ExecGetUpdatedCols(resultRelInfo, estate),
+									ExecGetExtraUpdatedCols(resultRelInfo,
+															estate));
+		index_referenced_attrs(indexInfo, &attrs);
+		if (!bms_overlap(attrs, updatedCols))
+			continue;
+
+		/* Prepare the predicate, if we haven't already */
+		predicate = indexInfo->ii_PredicateState;
+		if (predicate == NULL)
+		{
+			MemoryContextSwitchTo(estate->es_query_cxt);
+			predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+			indexInfo->ii_PredicateState = predicate;
+			MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+		}
+
+		econtext->ecxt_scantuple = oldslot;
+		if (ExecQual(predicate, econtext))
+			continue;
+		econtext->ecxt_scantuple = slot;
+		if (ExecQual(predicate, econtext))
+			continue;
+
+		if (exempt == NULL)
+			exempt = palloc0_array(bool, numIndices);
+		exempt[i] = true;
+		unindexed = bms_add_members(unindexed, attrs);
+	}
+
+	/* Keep only the columns that no other index refers to */
+	if (unindexed != NULL)
+	{
+		for (i = 0; i < numIndices; i++)
+		{
+			if (!exempt[i] && !indexInfoArray[i]->ii_Summarizing)
+				index_referenced_attrs(indexInfoArray[i], &indexed);
+		}
+		unindexed = bms_del_members(unindexed, indexed);
+	}
+
+	econtext->ecxt_scantuple = save_scantuple;
+	MemoryContextSwitchTo(oldcontext);
+
+	return unindexed;
+}
+
 /* ----------------------------------------------------------------
  *		ExecCheckIndexConstraints
  *
@@ -45,6 +45,7 @@
 #include "catalog/partition.h"
 #include "commands/matview.h"
 #include "commands/trigger.h"
+#include "executor/execQueryCache.h"
 #include "executor/executor.h"
 #include "executor/nodeSubplan.h"
 #include "foreign/fdwapi.h"
@@ -311,7 +312,9 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	EState	   *estate;
 	CmdType		operation;
 	DestReceiver *dest;
+	DestReceiver *plandest;
 	bool		sendTuples;
+	bool		fromcache = false;
 	MemoryContext oldcontext;
 
 	/* sanity checks */
@@ -339,6 +342,7 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	 */
 	operation = queryDesc->operation;
 	dest = queryDesc->dest;
+	plandest = dest;
 
 	/*
 	 * startup tuple receiver, if we will be emitting tuples
@@ -360,15 +364,28 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 			elog(ERROR, "can't re-execute query flagged for single execution");
 		queryDesc->already_executed = true;
 
-		ExecutePlan(estate,
-					queryDesc->planstate,
-					queryDesc->plannedstmt->parallelModeNeeded,
-					operation,
-					sendTuples,
-					count,
-					direction,
-					dest,
-					execute_once);
+		/*
+		 * A query that sends its whole result in one go may find it in the
+		 * query cache, or leave it there for next time.
+		 */
+		if (sendTuples && count == 0 && execute_once &&
+			ScanDirectionIsForward(direction) &&
+			QueryCacheApplies(queryDesc))
+			fromcache = QueryCacheBegin(queryDesc, dest, &plandest);
+
+		if (!fromcache)
+			ExecutePlan(estate,
+						queryDesc->planstate,
+						queryDesc->plannedstmt->parallelModeNeeded,
+						operation,
+						sendTuples,
+						count,
+						direction,
+						plandest,
+						execute_once);
+
+		if (plandest != dest)
+			QueryCacheEnd(queryDesc, plandest);
 	}
 
 	/*
@@ -1207,6 +1224,8 @@ InitResultRelInfo(ResultRelInfo *resultRelInfo,
 	resultRelInfo->ri_RangeTableIndex = resultRelationIndex;
 	resultRelInfo->ri_RelationDesc = resultRelationDesc;
 	resultRelInfo->ri_NumIndices = 0;
+	/* cached results of queries on the relation may become stale */
+	QueryCacheNoteChange(MyDatabaseId, RelationGetRelid(resultRelationDesc));
 	resultRelInfo->ri_IndexRelationDescs = NULL;
 	resultRelInfo->ri_IndexRelationInfo = NULL;
 	/* make a copy so as not to depend on relcache info not changing... */
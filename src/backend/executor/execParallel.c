@@ -23,6 +23,7 @@
 
 #include "postgres.h"
 
+#include "commands/createas.h"
 #include "executor/execParallel.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -36,6 +37,7 @@
 #include "executor/nodeIndexonlyscan.h"
 #include "executor/nodeIndexscan.h"
 #include "executor/nodeMemoize.h"
+#include "executor/nodeRepartition.h"
 #include "executor/nodeSeqscan.h"
 #include "executor/nodeSort.h"
 #include "executor/nodeSubplan.h"
@@ -64,6 +66,7 @@
 #define PARALLEL_KEY_QUERY_TEXT		UINT64CONST(0xE000000000000008)
 #define PARALLEL_KEY_JIT_INSTRUMENTATION UINT64CONST(0xE000000000000009)
 #define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xE00000000000000A)
+#define PARALLEL_KEY_INTO_REL			UINT64CONST(0xE00000000000000B)
 
 #define PARALLEL_TUPLE_QUEUE_SIZE		65536
 
@@ -78,6 +81,16 @@ typedef struct FixedParallelExecutorState
 	int			jit_flags;
 } FixedParallelExecutorState;
 
+/*
+ * Table into which workers insert their result tuples themselves, instead of
+ * sending them to the leader, and the number of tuples each one inserted.
+ */
+typedef struct ParallelIntoRel
+{
+	Oid			relid;
+	uint64		processed[FLEXIBLE_ARRAY_MEMBER];
+} ParallelIntoRel;
+
 /*
  * DSM structure for accumulating per-PlanState instrumentation.
  *
@@ -271,6 +284,11 @@ ExecParallelEstimate(PlanState *planstate, ExecParallelEstimateContext *e)
 				ExecBitmapHeapEstimate((BitmapHeapScanState *) planstate,
 									   e->pcxt);
 			break;
+		case T_RepartitionState:
+			if (planstate->plan->parallel_aware)
+				ExecRepartitionEstimate((RepartitionState *) planstate,
+										e->pcxt);
+			break;
 		case T_HashJoinState:
 			if (planstate->plan->parallel_aware)
 				ExecHashJoinEstimate((HashJoinState *) planstate,
@@ -495,6 +513,11 @@ ExecParallelInitializeDSM(PlanState *planstate,
 				ExecBitmapHeapInitializeDSM((BitmapHeapScanState *) planstate,
 											d->pcxt);
 			break;
+		case T_RepartitionState:
+			if (planstate->plan->parallel_aware)
+				ExecRepartitionInitializeDSM((RepartitionState *) planstate,
+											 d->pcxt);
+			break;
 		case T_HashJoinState:
 			if (planstate->plan->parallel_aware)
 				ExecHashJoinInitializeDSM((HashJoinState *) planstate,
@@ -586,7 +609,7 @@ ExecParallelSetupTupleQueues(ParallelContext *pcxt, bool reinitialize)
 ParallelExecutorInfo *
 ExecInitParallelPlan(PlanState *planstate, EState *estate,
 					 Bitmapset *sendParams, int nworkers,
-					 int64 tuples_needed)
+					 int64 tuples_needed, Oid into_relid)
 {
 	ParallelExecutorInfo *pei;
 	ParallelContext *pcxt;
@@ -598,6 +621,7 @@ ExecInitParallelPlan(PlanState *planstate, EState *estate,
 	char	   *paramlistinfo_space;
 	BufferUsage *bufusage_space;
 	WalUsage   *walusage_space;
+	ParallelIntoRel *into_rel;
 	SharedExecutorInstrumentation *instrumentation = NULL;
 	SharedJitInstrumentation *jit_instrumentation = NULL;
 	int			pstmt_len;
@@ -683,6 +707,15 @@ ExecInitParallelPlan(PlanState *planstate, EState *estate,
 						   mul_size(PARALLEL_TUPLE_QUEUE_SIZE, pcxt->nworkers));
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 
+	/* Estimate space for the target table of worker inserts, if any. */
+	if (OidIsValid(into_relid))
+	{
+		shm_toc_estimate_chunk(&pcxt->estimator,
+							   add_size(offsetof(ParallelIntoRel, processed),
+										mul_size(sizeof(uint64), pcxt->nworkers)));
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
 	/*
 	 * Give parallel-aware nodes a chance to add to the estimates, and get a
 	 * count of how many PlanState nodes there are.
@@ -779,6 +812,18 @@ ExecInitParallelPlan(PlanState *planstate, EState *estate,
 	/* We don't need the TupleQueueReaders yet, though. */
 	pei->reader = NULL;
 
+	/* Tell the workers where to insert their tuples, if they are to do so. */
+	if (OidIsValid(into_relid))
+	{
+		into_rel = shm_toc_allocate(pcxt->toc,
+									add_size(offsetof(ParallelIntoRel, processed),
+											 mul_size(sizeof(uint64), pcxt->nworkers)));
+		into_rel->relid = into_relid;
+		memset(into_rel->processed, 0, sizeof(uint64) * pcxt->nworkers);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_INTO_REL, into_rel);
+		pei->into_processed = into_rel->processed;
+	}
+
 	/*
 	 * If instrumentation options were supplied, allocate space for the data.
 	 * It only gets partially initialized here; the rest happens during
@@ -922,6 +967,8 @@ ExecParallelReinitialize(PlanState *planstate,
 	pei->tqueue = ExecParallelSetupTupleQueues(pei->pcxt, true);
 	pei->reader = NULL;
 	pei->finished = false;
+	if (pei->into_processed != NULL)
+		memset(pei->into_processed, 0, sizeof(uint64) * pei->pcxt->nworkers);
 
 	fpes = shm_toc_lookup(pei->pcxt->toc, PARALLEL_KEY_EXECUTOR_FIXED, false);
 
@@ -995,13 +1042,21 @@ ExecParallelReInitializeDSM(PlanState *planstate,
 				ExecBitmapHeapReInitializeDSM((BitmapHeapScanState *) planstate,
 											  pcxt);
 			break;
+		case T_RepartitionState:
+			if (planstate->plan->parallel_aware)
+				ExecRepartitionReInitializeDSM((RepartitionState *) planstate,
+											   pcxt);
+			break;
 		case T_HashJoinState:
 			if (planstate->plan->parallel_aware)
 				ExecHashJoinReInitializeDSM((HashJoinState *) planstate,
 											pcxt);
 			break;
-		case T_HashState:
 		case T_SortState:
+			if (planstate->plan->parallel_aware)
+				ExecSortReInitializeDSM((SortState *) planstate, pcxt);
+			break;
+		case T_HashState:
 		case T_IncrementalSortState:
 		case T_MemoizeState:
 			/* these nodes have DSM state, but no reinitialization is required */
@@ -1171,6 +1226,13 @@ ExecParallelFinish(ParallelExecutorInfo *pei)
 	for (i = 0; i < nworkers; i++)
 		InstrAccumParallelQuery(&pei->buffer_usage[i], &pei->wal_usage[i]);
 
+	/* Count the tuples that workers inserted themselves as processed. */
+	if (pei->into_processed != NULL)
+	{
+		for (i = 0; i < nworkers; i++)
+			pei->planstate->state->es_processed += pei->into_processed[i];
+	}
+
 	pei->finished = true;
 }
 
@@ -1346,6 +1408,11 @@ ExecParallelInitializeWorker(PlanState *planstate, ParallelWorkerContext *pwcxt)
 				ExecBitmapHeapInitializeWorker((BitmapHeapScanState *) planstate,
 											   pwcxt);
 			break;
+		case T_RepartitionState:
+			if (planstate->plan->parallel_aware)
+				ExecRepartitionInitializeWorker((RepartitionState *) planstate,
+												pwcxt);
+			break;
 		case T_HashJoinState:
 			if (planstate->plan->parallel_aware)
 				ExecHashJoinInitializeWorker((HashJoinState *) planstate,
@@ -1402,7 +1469,9 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 	FixedParallelExecutorState *fpes;
 	BufferUsage *buffer_usage;
 	WalUsage   *wal_usage;
+	ParallelIntoRel *into_rel;
 	DestReceiver *receiver;
+	DestReceiver *tqueue_receiver = NULL;
 	QueryDesc  *queryDesc;
 	SharedExecutorInstrumentation *instrumentation;
 	SharedJitInstrumentation *jit_instrumentation;
@@ -1416,6 +1485,17 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 
 	/* Set up DestReceiver, SharedExecutorInstrumentation, and QueryDesc. */
 	receiver = ExecParallelGetReceiver(seg, toc);
+	into_rel = shm_toc_lookup(toc, PARALLEL_KEY_INTO_REL, true);
+	if (into_rel != NULL)
+	{
+		/*
+		 * Insert our tuples into the target table ourselves.  We stay
+		 * attached to the tuple queue, so that the leader notices when we are
+		 * done.
+		 */
+		tqueue_receiver = receiver;
+		receiver = CreateParallelIntoRelDestReceiver(into_rel->relid);
+	}
 	instrumentation = shm_toc_lookup(toc, PARALLEL_KEY_INSTRUMENTATION, true);
 	if (instrumentation != NULL)
 		instrument_options = instrumentation->instrument_options;
@@ -1480,6 +1560,11 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 	InstrEndParallelQuery(&buffer_usage[ParallelWorkerNumber],
 						  &wal_usage[ParallelWorkerNumber]);
 
+	/* Report the number of tuples we inserted, if any. */
+	if (into_rel != NULL)
+		into_rel->processed[ParallelWorkerNumber] =
+			queryDesc->estate->es_processed;
+
 	/* Report instrumentation data if any instrumentation options are set. */
 	if (instrumentation != NULL)
 		ExecParallelReportInstrumentation(queryDesc->planstate,
@@ -1500,4 +1585,6 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 	dsa_detach(area);
 	FreeQueryDesc(queryDesc);
 	receiver->rDestroy(receiver);
+	if (tqueue_receiver != NULL)
+		tqueue_receiver->rDestroy(tqueue_receiver);
 }
@@ -102,6 +102,7 @@
 #include "executor/nodeNestloop.h"
 #include "executor/nodeProjectSet.h"
 #include "executor/nodeRecursiveunion.h"
+#include "executor/nodeRepartition.h"
 #include "executor/nodeResult.h"
 #include "executor/nodeSamplescan.h"
 #include "executor/nodeSeqscan.h"
@@ -118,9 +119,12 @@
 #include "executor/nodeWorktablescan.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "postmaster/profiler.h"
+#include "storage/proc.h"
 
 static TupleTableSlot *ExecProcNodeFirst(PlanState *node);
 static TupleTableSlot *ExecProcNodeInstr(PlanState *node);
+static TupleTableSlot *ExecProcNodeProfile(PlanState *node);
 static bool ExecShutdownNode_walker(PlanState *node, void *context);
 
 
@@ -332,6 +336,11 @@ ExecInitNode(Plan *node, EState *estate, int eflags)
 												   eflags);
 			break;
 
+		case T_Repartition:
+			result = (PlanState *) ExecInitRepartition((Repartition *) node,
+													   estate, eflags);
+			break;
+
 		case T_Group:
 			result = (PlanState *) ExecInitGroup((Group *) node,
 												 estate, eflags);
@@ -453,10 +462,13 @@ ExecProcNodeFirst(PlanState *node)
 
 	/*
 	 * If instrumentation is required, change the wrapper to one that just
-	 * does instrumentation.  Otherwise we can dispense with all wrappers and
+	 * does instrumentation.  Likewise if the sampling profiler needs to know
+	 * which node we're in.  Otherwise we can dispense with all wrappers and
 	 * have ExecProcNode() directly call the relevant function from now on.
 	 */
-	if (node->instrument)
+	if (ProfilerEnabled())
+		node->ExecProcNode = ExecProcNodeProfile;
+	else if (node->instrument)
 		node->ExecProcNode = ExecProcNodeInstr;
 	else
 		node->ExecProcNode = node->ExecProcNodeReal;
@@ -484,6 +496,62 @@ ExecProcNodeInstr(PlanState *node)
 	return result;
 }
 
+/*
+ * ExecProcNode wrapper that advertises the node in MyProc->exec_node_info
+ * for the sampling profiler while it runs, and does instrumentation if
+ * needed.  The previous value is restored on exit, so that the parent node
+ * is advertised again once its child returns.
+ */
+static TupleTableSlot *
+ExecProcNodeProfile(PlanState *node)
+{
+	uint32		save_node_info = MyProc->exec_node_info;
+	TupleTableSlot *result;
+
+	MyProc->exec_node_info = PROFILER_NODE_INFO(nodeTag(node->plan),
+												node->plan->plan_node_id);
+
+	if (node->instrument)
+		result = ExecProcNodeInstr(node);
+	else
+		result = node->ExecProcNodeReal(node);
+
+	MyProc->exec_node_info = save_node_info;
+
+	return result;
+}
+
+/*
+ * ExecProcNodeBatch variant that performs instrumentation calls, and
+ * advertises the node for the sampling profiler if that's enabled.
+ */
+int
+ExecProcNodeBatchInstr(PlanState *node, TupleTableSlot **slots, int maxslots)
+{
+	uint32		save_node_info = 0;
+	int			nslots;
+
+	if (ProfilerEnabled())
+	{
+		save_node_info = MyProc->exec_node_info;
+		MyProc->exec_node_info = PROFILER_NODE_INFO(nodeTag(node->plan),
+													node->plan->plan_node_id);
+	}
+
+	if (node->instrument)
+		InstrStartNode(node->instrument);
+
+	nslots = node->ExecProcNodeBatch(node, slots, maxslots);
+
+	if (node->instrument)
+		InstrStopNode(node->instrument, nslots);
+
+	if (ProfilerEnabled())
+		MyProc->exec_node_info = save_node_info;
+
+	return nslots;
+}
+
 
 /* ----------------------------------------------------------------
  *		MultiExecProcNode
@@ -502,6 +570,7 @@ Node *
 MultiExecProcNode(PlanState *node)
 {
 	Node	   *result;
+	uint32		save_node_info = 0;
 
 	check_stack_depth();
 
@@ -510,6 +579,13 @@ MultiExecProcNode(PlanState *node)
 	if (node->chgParam != NULL) /* something changed */
 		ExecReScan(node);		/* let ReScan handle this */
 
+	if (ProfilerEnabled())
+	{
+		save_node_info = MyProc->exec_node_info;
+		MyProc->exec_node_info = PROFILER_NODE_INFO(nodeTag(node->plan),
+													node->plan->plan_node_id);
+	}
+
 	switch (nodeTag(node))
 	{
 			/*
@@ -538,6 +614,9 @@ MultiExecProcNode(PlanState *node)
 			break;
 	}
 
+	if (ProfilerEnabled())
+		MyProc->exec_node_info = save_node_info;
+
 	return result;
 }
 
@@ -713,6 +792,10 @@ ExecEndNode(PlanState *node)
 			ExecEndMemoize((MemoizeState *) node);
 			break;
 
+		case T_RepartitionState:
+			ExecEndRepartition((RepartitionState *) node);
+			break;
+
 		case T_GroupState:
 			ExecEndGroup((GroupState *) node);
 			break;
@@ -755,6 +838,10 @@ ExecEndNode(PlanState *node)
 			elog(ERROR, "unrecognized node type: %d", (int) nodeTag(node));
 			break;
 	}
+
+	/* Hand any expression states kept in the plan node back to it */
+	if (node->exprcache != NULL)
+		ExecReleasePlanExprCache(node);
 }
 
 /*
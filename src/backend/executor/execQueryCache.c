@@ -0,0 +1,1194 @@
+/*-------------------------------------------------------------------------
+ *
+ * execQueryCache.c
+ *	  Shared cache of the results of read-only queries
+ *
+ * Applications such as dashboards often run the same read-only queries over
+ * and over, against tables that change much less often than the queries
+ * are run.  When query_cache_size is set and a session enables query_cache,
+ * ExecutorRun() keeps the complete result of such a query in shared memory,
+ * and later executions that find the result still valid send it to their
+ * destination without running the plan.
+ *
+ * The planner marks a plan as cacheable (PlannedStmt->queryCacheable) if it
+ * is a SELECT with a query identifier and without row locks, that calls
+ * only immutable functions, and that reads nothing but permanent user
+ * tables, partitioned tables and materialized views without row level
+ * security.  Its result then depends on nothing but the query and the
+ * contents of those relations.  ExecutorRun() consults the cache only when
+ * the whole result goes to the destination in one go, so not for cursors
+ * or EXPLAIN ANALYZE.  It doesn't in serializable transactions, whose
+ * predicate locks would be missed, in transactions that have written
+ * something, whose own changes the cache knows nothing about, nor during
+ * recovery.  Permissions are still checked by ExecutorStart().
+ *
+ * An entry is keyed by the database, the query identifier, the statement's
+ * text, its parameter values, its result row type and the settings that
+ * affect how the constants in the text are read.
+ *
+ * Invalidation
+ * ------------
+ *
+ * Relations are hashed into a fixed number of stripes.  A transaction that
+ * might have changed a relation, because it set up a result relation for it
+ * (InitResultRelInfo()) or queued a relcache invalidation for it (inval.c,
+ * which covers DDL and TRUNCATE), marks that relation's stripe.  The
+ * functions and domains a plan depends on (PlannedStmt->invalItems) are
+ * hashed into the same stripes, by their syscache hash value, and a
+ * transaction that queues a catcache invalidation for one of them marks its
+ * stripe, so that CREATE OR REPLACE FUNCTION and ALTER DOMAIN invalidate
+ * the results of queries using them just as the plans themselves are.  Just
+ * before it becomes visible to others, it counts itself in the "inflight"
+ * counter of each stripe it marked.  Once visible, it raises the stripes'
+ * "lastmod" to the current xactCompletionCount and uncounts itself.
+ *
+ * A snapshot sees exactly the transactions that completed before its
+ * snapXactCompletionCount was taken.  So if no stripe of a query's
+ * relations is inflight, and no stripe has a lastmod beyond a snapshot's
+ * completion count, that snapshot sees every change to those relations
+ * that is visible to anybody, and no change that is not visible to it can
+ * become visible without first going through inflight.  A result computed
+ * under one snapshot is therefore stored only if that holds for its
+ * snapshot, and served to a query running under another snapshot only if
+ * it holds for both.  Two relations sharing a stripe only cost needless
+ * invalidations.
+ *
+ * A prepared transaction stays inflight until COMMIT PREPARED or ROLLBACK
+ * PREPARED, through a 2PC record.  Changes are tracked whether or not the
+ * cache is enabled, so that the record is there even if the server is
+ * restarted with the cache enabled while the transaction is prepared.
+ *
+ * Memory
+ * ------
+ *
+ * Entries are allocated in a DSA area that lives in the main shared memory
+ * segment and never grows beyond query_cache_size.  An entry can't take
+ * more than a sixteenth of that.  When an allocation fails, entries are
+ * evicted from the tail of an LRU list until it succeeds.  A single LWLock
+ * protects the hash table and the LRU list.  Since sending a result to the
+ * client can take a while, a backend pins the entry it reads and sends the
+ * tuples straight from shared memory without holding the lock.  An entry
+ * that is evicted or invalidated meanwhile is freed once it is unpinned.
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execQueryCache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/parallel.h"
+#include "access/transam.h"
+#include "access/twophase_rmgr.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/catalog.h"
+#include "catalog/pg_class.h"
+#include "common/hashfn.h"
+#include "executor/execQueryCache.h"
+#include "executor/executor.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "nodes/queryjumble.h"
+#include "optimizer/optimizer.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+
+/* Number of stripes that relations are hashed into for invalidation */
+#define QUERY_CACHE_STRIPES		1024
+
+/* Number of hash buckets */
+#define QUERY_CACHE_BUCKETS		4096
+
+/* Smallest DSA area we create, whatever query_cache_size says */
+#define QUERY_CACHE_MIN_SIZE	(1024 * 1024)
+
+/*
+ * Settings that affect how the constants in a statement's text are turned
+ * into values, hence part of the cache key.
+ */
+static const char *const query_cache_key_settings[] = {
+	"DateStyle",
+	"IntervalStyle",
+	"TimeZone",
+	"array_nulls",
+	"lc_monetary",
+	"search_path",
+	"standard_conforming_strings",
+	"xmloption",
+};
+
+typedef struct QueryCacheStripe
+{
+	pg_atomic_uint32 inflight;	/* committing transactions that changed it */
+	pg_atomic_uint64 lastmod;	/* completion count after the last change */
+} QueryCacheStripe;
+
+typedef struct QueryCacheShared
+{
+	LWLock		lock;			/* protects buckets and the LRU list */
+	dsa_pointer lru_head;		/* most recently used entry */
+	dsa_pointer lru_tail;		/* least recently used entry */
+	QueryCacheStripe stripes[QUERY_CACHE_STRIPES];
+	dsa_pointer buckets[QUERY_CACHE_BUCKETS];
+	/* the DSA area follows */
+} QueryCacheShared;
+
+/*
+ * A cached result, in a single DSA allocation.  Except for the links and
+ * the pin count, an entry doesn't change once it is in the hash table.  The
+ * key, the stripes of the query's relations and the tuples follow the
+ * header, each MAXALIGN'd.
+ */
+typedef struct QueryCacheEntry
+{
+	dsa_pointer next;			/* next entry in the same bucket */
+	dsa_pointer lru_prev;		/* more recently used entry */
+	dsa_pointer lru_next;		/* less recently used entry */
+	uint32		hash;			/* hash of the key */
+	int			refcount;		/* backends sending the tuples */
+	bool		dead;			/* removed, free when no longer pinned? */
+	uint64		created;		/* completion count of the computing snapshot */
+	uint32		keylen;			/* length of the key */
+	int			nstripes;		/* number of stripes */
+	uint64		ntuples;		/* number of tuples */
+	Size		tupleslen;		/* total length of the tuples */
+} QueryCacheEntry;
+
+#define QCEntryKey(e) \
+	((char *) (e) + MAXALIGN(sizeof(QueryCacheEntry)))
+#define QCEntryStripes(e) \
+	((uint16 *) (QCEntryKey(e) + MAXALIGN((e)->keylen)))
+#define QCEntryTuples(e) \
+	((char *) QCEntryStripes(e) + MAXALIGN((e)->nstripes * sizeof(uint16)))
+
+/*
+ * DestReceiver that passes tuples on to the query's destination and keeps
+ * a copy of them for the cache.
+ */
+typedef struct QueryCacheCapture
+{
+	DestReceiver pub;
+	DestReceiver *dest;			/* the query's destination */
+	StringInfoData key;			/* cache key of the query */
+	uint32		hash;			/* hash of the key */
+	StringInfoData tuples;		/* MAXALIGN'd copies of the tuples */
+	uint64		ntuples;		/* number of tuples */
+	Size		limit;			/* maximum size of an entry */
+	bool		failed;			/* too large, or stopped early? */
+} QueryCacheCapture;
+
+/* GUC variables */
+int			query_cache_size = 0;
+bool		query_cache = false;
+
+static QueryCacheShared *QueryCache = NULL;
+static dsa_area *QueryCacheArea = NULL;
+
+/* entry we are sending tuples from, if any */
+static dsa_pointer pinnedEntry = InvalidDsaPointer;
+
+/* stripes of the relations the current transaction may have changed */
+static uint64 changedStripes[QUERY_CACHE_STRIPES / 64];
+static bool changedAny = false;
+
+/* have we counted ourselves as inflight in changedStripes? */
+static bool countedInflight = false;
+
+static Size query_cache_area_size(void);
+static dsa_area *query_cache_get_area(void);
+static void query_cache_shmem_exit(int code, Datum arg);
+static bool query_cache_relation_is_cacheable(Oid relid);
+static void query_cache_build_key(QueryDesc *queryDesc, StringInfo key);
+static int	query_cache_stripes(PlannedStmt *stmt, uint16 *stripes);
+static bool query_cache_stripes_unchanged(const uint16 *stripes,
+										  int nstripes, uint64 horizon);
+static void query_cache_count_inflight(const uint64 *bitmap);
+static void query_cache_release_stripes(const uint64 *bitmap);
+static dsa_pointer query_cache_lookup(const char *key, uint32 keylen,
+									  uint32 hash, QueryCacheEntry **entryp);
+static void query_cache_remove(dsa_pointer dp, QueryCacheEntry *entry);
+static void query_cache_lru_unlink(QueryCacheEntry *entry);
+static void query_cache_lru_push(dsa_pointer dp, QueryCacheEntry *entry);
+static void query_cache_unpin(void);
+static void query_cache_send(QueryDesc *queryDesc, DestReceiver *dest,
+							 QueryCacheEntry *entry);
+static void query_cache_store(QueryDesc *queryDesc,
+							  QueryCacheCapture *capture);
+static bool query_cache_receive(TupleTableSlot *slot, DestReceiver *self);
+static void query_cache_startup(DestReceiver *self, int operation,
+								TupleDesc typeinfo);
+static void query_cache_shutdown(DestReceiver *self);
+static void query_cache_destroy(DestReceiver *self);
+
+/*
+ * Stripe of a relation.
+ */
+static inline int
+query_cache_stripe(Oid dbId, Oid relId)
+{
+	return hash_combine(murmurhash32(dbId), murmurhash32(relId)) %
+		QUERY_CACHE_STRIPES;
+}
+
+/*
+ * Stripe of a syscache entry that a plan can depend on.
+ */
+static inline int
+query_cache_catcache_stripe(Oid dbId, int cacheId, uint32 hashValue)
+{
+	return hash_combine(murmurhash32(dbId),
+						hash_combine(murmurhash32(cacheId), hashValue)) %
+		QUERY_CACHE_STRIPES;
+}
+
+static Size
+query_cache_area_size(void)
+{
+	return MAXALIGN(Max((Size) query_cache_size * 1024,
+						QUERY_CACHE_MIN_SIZE));
+}
+
+/*
+ * Report shared memory space needed by QueryCacheShmemInit
+ */
+Size
+QueryCacheShmemSize(void)
+{
+	Size		size;
+
+	if (query_cache_size == 0)
+		return 0;
+
+	size = MAXALIGN(sizeof(QueryCacheShared));
+	size = add_size(size, query_cache_area_size());
+
+	return size;
+}
+
+/*
+ * Initialize the query cache during startup
+ */
+void
+QueryCacheShmemInit(void)
+{
+	bool		found;
+
+	if (query_cache_size == 0)
+		return;
+
+	QueryCache = (QueryCacheShared *)
+		ShmemInitStruct("Query Cache", QueryCacheShmemSize(), &found);
+
+	if (!IsUnderPostmaster)
+	{
+		dsa_area   *dsa;
+		int			i;
+
+		Assert(!found);
+
+		LWLockInitialize(&QueryCache->lock, LWTRANCHE_QUERY_CACHE);
+		QueryCache->lru_head = InvalidDsaPointer;
+		QueryCache->lru_tail = InvalidDsaPointer;
+		for (i = 0; i < QUERY_CACHE_STRIPES; i++)
+		{
+			pg_atomic_init_u32(&QueryCache->stripes[i].inflight, 0);
+			pg_atomic_init_u64(&QueryCache->stripes[i].lastmod, 0);
+		}
+		for (i = 0; i < QUERY_CACHE_BUCKETS; i++)
+			QueryCache->buckets[i] = InvalidDsaPointer;
+
+		/*
+		 * The postmaster can't create DSM segments, and we'd rather evict
+		 * entries than use more memory anyway, so the area never grows.
+		 */
+		dsa = dsa_create_in_place((char *) QueryCache +
+								  MAXALIGN(sizeof(QueryCacheShared)),
+								  query_cache_area_size(),
+								  LWTRANCHE_QUERY_CACHE_DSA, 0);
+		dsa_pin(dsa);
+		dsa_set_size_limit(dsa, query_cache_area_size());
+		dsa_detach(dsa);
+	}
+	else
+		Assert(found);
+
+	/* Cache keys include the query identifier */
+	EnableQueryId();
+}
+
+/*
+ * Attach to the DSA area, if we haven't yet.
+ */
+static dsa_area *
+query_cache_get_area(void)
+{
+	MemoryContext oldcontext;
+
+	if (QueryCacheArea != NULL)
+		return QueryCacheArea;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	QueryCacheArea = dsa_attach_in_place((char *) QueryCache +
+										 MAXALIGN(sizeof(QueryCacheShared)),
+										 NULL);
+	dsa_pin_mapping(QueryCacheArea);
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Don't leave an entry pinned if we exit while sending it */
+	before_shmem_exit(query_cache_shmem_exit, 0);
+
+	return QueryCacheArea;
+}
+
+static void
+query_cache_shmem_exit(int code, Datum arg)
+{
+	query_cache_unpin();
+}
+
+/*
+ * Can the result of the given query go into the query cache, as far as can
+ * be told before planning it?
+ */
+bool
+QueryCacheQueryIsCacheable(Query *parse)
+{
+	return parse->commandType == CMD_SELECT &&
+		parse->utilityStmt == NULL &&
+		parse->queryId != UINT64CONST(0) &&
+		!parse->hasModifyingCTE &&
+		parse->rowMarks == NIL &&
+		!contain_mutable_functions((Node *) parse);
+}
+
+/*
+ * Can the result of the given plan go into the query cache, given that
+ * QueryCacheQueryIsCacheable() was true for its query?
+ */
+bool
+QueryCachePlanIsCacheable(PlannedStmt *stmt)
+{
+	ListCell   *lc;
+
+	foreach(lc, stmt->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+
+		switch (rte->rtekind)
+		{
+			case RTE_RELATION:
+				if (rte->tablesample != NULL ||
+					!query_cache_relation_is_cacheable(rte->relid))
+					return false;
+				break;
+			case RTE_NAMEDTUPLESTORE:
+				return false;
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Is a query reading the given relation fit for the query cache?
+ *
+ * We know of changes only to plain user relations.  Temporary relations
+ * would be no use to other sessions, and the result of a query on a table
+ * with row level security depends on who runs it.
+ */
+static bool
+query_cache_relation_is_cacheable(Oid relid)
+{
+	HeapTuple	tp;
+	Form_pg_class reltup;
+	bool		result;
+
+	if (IsCatalogRelationOid(relid))
+		return false;
+
+	tp = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(tp))
+		return false;
+	reltup = (Form_pg_class) GETSTRUCT(tp);
+
+	result = (reltup->relkind == RELKIND_RELATION ||
+			  reltup->relkind == RELKIND_PARTITIONED_TABLE ||
+			  reltup->relkind == RELKIND_MATVIEW) &&
+		reltup->relpersistence != RELPERSISTENCE_TEMP &&
+		!reltup->relrowsecurity;
+
+	ReleaseSysCache(tp);
+
+	return result;
+}
+
+/*
+ * Can the given execution of a query be served from, or have its result
+ * stored in, the query cache?  The caller has checked that the query runs
+ * forward to completion, sending all its tuples.
+ */
+bool
+QueryCacheApplies(QueryDesc *queryDesc)
+{
+	EState	   *estate = queryDesc->estate;
+
+	if (!query_cache || QueryCache == NULL ||
+		!queryDesc->plannedstmt->queryCacheable)
+		return false;
+
+	if (queryDesc->sourceText == NULL ||
+		queryDesc->queryEnv != NULL ||
+		queryDesc->instrument_options != 0 ||
+		(queryDesc->params != NULL && queryDesc->params->paramFetch != NULL))
+		return false;
+
+	if (estate->es_top_eflags &
+		(EXEC_FLAG_REWIND | EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK))
+		return false;
+
+	/* we need to know which transactions the snapshot sees */
+	if (estate->es_snapshot->snapXactCompletionCount == 0)
+		return false;
+
+	if (IsolationIsSerializable() || IsParallelWorker() ||
+		TransactionIdIsValid(GetTopTransactionIdIfAny()) ||
+		RecoveryInProgress())
+		return false;
+
+	return true;
+}
+
+/*
+ * Start executing a query that QueryCacheApplies() to.
+ *
+ * If the cache has a valid result for the query, send it to dest and
+ * return true.  Otherwise return false.  *capture is then set to the
+ * DestReceiver to run the plan into; unless it is dest itself, the caller
+ * must pass it to QueryCacheEnd() once the plan has run to completion.
+ */
+bool
+QueryCacheBegin(QueryDesc *queryDesc, DestReceiver *dest,
+				DestReceiver **capture)
+{
+	uint64		horizon = queryDesc->estate->es_snapshot->snapXactCompletionCount;
+	QueryCacheCapture *self;
+	QueryCacheEntry *entry = NULL;
+	dsa_pointer dp;
+	uint32		hash;
+	StringInfoData key;
+	Size		limit;
+
+	*capture = dest;
+
+	limit = Min(query_cache_area_size() / 16, MaxAllocSize / 2);
+
+	initStringInfo(&key);
+	query_cache_build_key(queryDesc, &key);
+	if (key.len > limit)
+	{
+		pfree(key.data);
+		return false;
+	}
+	hash = hash_bytes((unsigned char *) key.data, key.len);
+
+	(void) query_cache_get_area();
+
+	LWLockAcquire(&QueryCache->lock, LW_EXCLUSIVE);
+	dp = query_cache_lookup(key.data, key.len, hash, &entry);
+	if (DsaPointerIsValid(dp))
+	{
+		if (query_cache_stripes_unchanged(QCEntryStripes(entry),
+										  entry->nstripes,
+										  Min(entry->created, horizon)))
+		{
+			query_cache_lru_unlink(entry);
+			query_cache_lru_push(dp, entry);
+			entry->refcount++;
+			pinnedEntry = dp;
+		}
+		else
+		{
+			query_cache_remove(dp, entry);
+			dp = InvalidDsaPointer;
+		}
+	}
+	LWLockRelease(&QueryCache->lock);
+
+	if (DsaPointerIsValid(dp))
+	{
+		pfree(key.data);
+
+		PG_TRY();
+		{
+			query_cache_send(queryDesc, dest, entry);
+		}
+		PG_FINALLY();
+		{
+			query_cache_unpin();
+		}
+		PG_END_TRY();
+
+		return true;
+	}
+
+	/* Not cached, so run the plan and keep a copy of its result */
+	self = (QueryCacheCapture *) palloc0(sizeof(QueryCacheCapture));
+	self->pub.receiveSlot = query_cache_receive;
+	self->pub.rStartup = query_cache_startup;
+	self->pub.rShutdown = query_cache_shutdown;
+	self->pub.rDestroy = query_cache_destroy;
+	self->pub.mydest = dest->mydest;
+	self->dest = dest;
+	self->key = key;
+	self->hash = hash;
+	initStringInfo(&self->tuples);
+	self->limit = limit;
+
+	*capture = (DestReceiver *) self;
+
+	return false;
+}
+
+/*
+ * Store the result captured by the DestReceiver returned by
+ * QueryCacheBegin(), if the plan ran to completion.
+ */
+void
+QueryCacheEnd(QueryDesc *queryDesc, DestReceiver *capture)
+{
+	QueryCacheCapture *self = (QueryCacheCapture *) capture;
+
+	if (!self->failed)
+		query_cache_store(queryDesc, self);
+
+	if (self->tuples.data)
+		pfree(self->tuples.data);
+	pfree(self->key.data);
+	pfree(self);
+}
+
+/*
+ * Build the cache key of the given query execution.
+ */
+static void
+query_cache_build_key(QueryDesc *queryDesc, StringInfo key)
+{
+	PlannedStmt *stmt = queryDesc->plannedstmt;
+	TupleDesc	tupdesc = queryDesc->tupDesc;
+	ParamListInfo params = queryDesc->params;
+	int			location = stmt->stmt_location;
+	int			len = stmt->stmt_len;
+	int			i;
+
+	appendBinaryStringInfo(key, &MyDatabaseId, sizeof(Oid));
+	appendBinaryStringInfo(key, &stmt->queryId, sizeof(uint64));
+
+	/* result row type */
+	appendBinaryStringInfo(key, &tupdesc->natts, sizeof(int));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		appendBinaryStringInfo(key, &attr->atttypid, sizeof(Oid));
+		appendBinaryStringInfo(key, &attr->atttypmod, sizeof(int32));
+	}
+
+	/* the statement's text, within a possibly multi-statement string */
+	if (location < 0)
+	{
+		location = 0;
+		len = 0;
+	}
+	if (len <= 0)
+		len = strlen(queryDesc->sourceText + location);
+	appendBinaryStringInfo(key, &len, sizeof(int));
+	appendBinaryStringInfo(key, queryDesc->sourceText + location, len);
+
+	/* settings that affect how constants in the text are read */
+	for (i = 0; i < lengthof(query_cache_key_settings); i++)
+	{
+		const char *value = GetConfigOption(query_cache_key_settings[i],
+											true, false);
+
+		if (value == NULL)
+			value = "";
+		appendBinaryStringInfo(key, value, strlen(value) + 1);
+	}
+
+	/* parameter values */
+	if (params == NULL)
+		return;
+
+	appendBinaryStringInfo(key, &params->numParams, sizeof(int));
+	for (i = 0; i < params->numParams; i++)
+	{
+		ParamExternData *prm = &params->params[i];
+		int16		typlen;
+		bool		typbyval;
+
+		appendBinaryStringInfo(key, &prm->ptype, sizeof(Oid));
+		appendBinaryStringInfo(key, &prm->isnull, sizeof(bool));
+		if (prm->isnull || !OidIsValid(prm->ptype))
+			continue;
+
+		get_typlenbyval(prm->ptype, &typlen, &typbyval);
+		if (typbyval)
+			appendBinaryStringInfo(key, &prm->value, sizeof(Datum));
+		else if (typlen == -1)
+		{
+			struct varlena *value;
+
+			value = pg_detoast_datum((struct varlena *)
+									 DatumGetPointer(prm->value));
+			appendBinaryStringInfo(key, value, VARSIZE(value));
+		}
+		else if (typlen == -2)
+			appendBinaryStringInfo(key, DatumGetCString(prm->value),
+								   strlen(DatumGetCString(prm->value)) + 1);
+		else
+			appendBinaryStringInfo(key, DatumGetPointer(prm->value), typlen);
+	}
+}
+
+/*
+ * Compute the stripes of the relations, functions and domains the given plan
+ * depends on.  The stripes array must have room for QUERY_CACHE_STRIPES entries.  Returns
+ * the number of stripes, which come out sorted and without duplicates.
+ */
+static int
+query_cache_stripes(PlannedStmt *stmt, uint16 *stripes)
+{
+	uint64		bitmap[QUERY_CACHE_STRIPES / 64];
+	ListCell   *lc;
+	int			nstripes = 0;
+	int			i;
+
+	memset(bitmap, 0, sizeof(bitmap));
+	foreach(lc, stmt->relationOids)
+	{
+		int			stripe = query_cache_stripe(MyDatabaseId, lfirst_oid(lc));
+
+		bitmap[stripe / 64] |= UINT64CONST(1) << (stripe % 64);
+	}
+	foreach(lc, stmt->invalItems)
+	{
+		PlanInvalItem *item = lfirst_node(PlanInvalItem, lc);
+		int			stripe = query_cache_catcache_stripe(MyDatabaseId,
+														 item->cacheId,
+														 item->hashValue);
+
+		bitmap[stripe / 64] |= UINT64CONST(1) << (stripe % 64);
+	}
+
+	for (i = 0; i < QUERY_CACHE_STRIPES; i++)
+	{
+		if (bitmap[i / 64] & (UINT64CONST(1) << (i % 64)))
+			stripes[nstripes++] = i;
+	}
+
+	return nstripes;
+}
+
+/*
+ * Would a snapshot with the given completion count see all changes to the
+ * given stripes, and is no change to them about to become visible?
+ */
+static bool
+query_cache_stripes_unchanged(const uint16 *stripes, int nstripes,
+							  uint64 horizon)
+{
+	int			i;
+
+	pg_memory_barrier();
+
+	for (i = 0; i < nstripes; i++)
+	{
+		QueryCacheStripe *stripe = &QueryCache->stripes[stripes[i]];
+
+		if (pg_atomic_read_u32(&stripe->inflight) != 0)
+			return false;
+
+		/*
+		 * A committing transaction raises lastmod before it decrements
+		 * inflight, so having seen inflight at zero we must not read a
+		 * lastmod older than that.
+		 */
+		pg_read_barrier();
+
+		if (pg_atomic_read_u64(&stripe->lastmod) > horizon)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Find the entry with the given key.  Caller must hold the lock.
+ */
+static dsa_pointer
+query_cache_lookup(const char *key, uint32 keylen, uint32 hash,
+				   QueryCacheEntry **entryp)
+{
+	dsa_pointer dp = QueryCache->buckets[hash % QUERY_CACHE_BUCKETS];
+
+	while (DsaPointerIsValid(dp))
+	{
+		QueryCacheEntry *entry = dsa_get_address(QueryCacheArea, dp);
+
+		if (entry->hash == hash && entry->keylen == keylen &&
+			memcmp(QCEntryKey(entry), key, keylen) == 0)
+		{
+			*entryp = entry;
+			return dp;
+		}
+		dp = entry->next;
+	}
+
+	return InvalidDsaPointer;
+}
+
+/*
+ * Remove an entry from the hash table and the LRU list, and free it unless
+ * it is pinned.  Caller must hold the lock exclusively.
+ */
+static void
+query_cache_remove(dsa_pointer dp, QueryCacheEntry *entry)
+{
+	dsa_pointer *link = &QueryCache->buckets[entry->hash % QUERY_CACHE_BUCKETS];
+
+	while (*link != dp)
+	{
+		QueryCacheEntry *prev = dsa_get_address(QueryCacheArea, *link);
+
+		Assert(DsaPointerIsValid(*link));
+		link = &prev->next;
+	}
+	*link = entry->next;
+
+	query_cache_lru_unlink(entry);
+
+	if (entry->refcount == 0)
+		dsa_free(QueryCacheArea, dp);
+	else
+		entry->dead = true;
+}
+
+static void
+query_cache_lru_unlink(QueryCacheEntry *entry)
+{
+	if (DsaPointerIsValid(entry->lru_prev))
+		((QueryCacheEntry *) dsa_get_address(QueryCacheArea,
+											 entry->lru_prev))->lru_next =
+			entry->lru_next;
+	else
+		QueryCache->lru_head = entry->lru_next;
+
+	if (DsaPointerIsValid(entry->lru_next))
+		((QueryCacheEntry *) dsa_get_address(QueryCacheArea,
+											 entry->lru_next))->lru_prev =
+			entry->lru_prev;
+	else
+		QueryCache->lru_tail = entry->lru_prev;
+
+	entry->lru_prev = entry->lru_next = InvalidDsaPointer;
+}
+
+static void
+query_cache_lru_push(dsa_pointer dp, QueryCacheEntry *entry)
+{
+	entry->lru_prev = InvalidDsaPointer;
+	entry->lru_next = QueryCache->lru_head;
+	if (DsaPointerIsValid(QueryCache->lru_head))
+		((QueryCacheEntry *) dsa_get_address(QueryCacheArea,
+											 QueryCache->lru_head))->lru_prev = dp;
+	else
+		QueryCache->lru_tail = dp;
+	QueryCache->lru_head = dp;
+}
+
+/*
+ * Release the entry we pinned to send its tuples, if any.
+ */
+static void
+query_cache_unpin(void)
+{
+	QueryCacheEntry *entry;
+
+	if (!DsaPointerIsValid(pinnedEntry))
+		return;
+
+	LWLockAcquire(&QueryCache->lock, LW_EXCLUSIVE);
+	entry = dsa_get_address(QueryCacheArea, pinnedEntry);
+	Assert(entry->refcount > 0);
+	if (--entry->refcount == 0 && entry->dead)
+		dsa_free(QueryCacheArea, pinnedEntry);
+	LWLockRelease(&QueryCache->lock);
+
+	pinnedEntry = InvalidDsaPointer;
+}
+
+/*
+ * Send the tuples of a pinned entry to the query's destination.
+ */
+static void
+query_cache_send(QueryDesc *queryDesc, DestReceiver *dest,
+				 QueryCacheEntry *entry)
+{
+	EState	   *estate = queryDesc->estate;
+	TupleTableSlot *slot;
+	char	   *ptr = QCEntryTuples(entry);
+	uint64		i;
+
+	slot = MakeSingleTupleTableSlot(queryDesc->tupDesc, &TTSOpsMinimalTuple);
+
+	for (i = 0; i < entry->ntuples; i++)
+	{
+		MinimalTuple tuple = (MinimalTuple) ptr;
+
+		CHECK_FOR_INTERRUPTS();
+
+		ExecStoreMinimalTuple(tuple, slot, false);
+		if (!dest->receiveSlot(slot, dest))
+			break;
+		estate->es_processed++;
+
+		ptr += MAXALIGN(tuple->t_len);
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+}
+
+/*
+ * Put a captured result into the cache, replacing any entry with the same
+ * key, unless a change to the query's relations might have been missed.
+ */
+static void
+query_cache_store(QueryDesc *queryDesc, QueryCacheCapture *capture)
+{
+	uint64		horizon = queryDesc->estate->es_snapshot->snapXactCompletionCount;
+	uint16	   *stripes;
+	int			nstripes;
+	Size		size;
+	dsa_pointer dp;
+	QueryCacheEntry *entry;
+
+	stripes = (uint16 *) palloc(QUERY_CACHE_STRIPES * sizeof(uint16));
+	nstripes = query_cache_stripes(queryDesc->plannedstmt, stripes);
+
+	size = MAXALIGN(sizeof(QueryCacheEntry)) +
+		MAXALIGN(capture->key.len) +
+		MAXALIGN(nstripes * sizeof(uint16)) +
+		capture->tuples.len;
+	if (size > capture->limit)
+	{
+		pfree(stripes);
+		return;
+	}
+
+	LWLockAcquire(&QueryCache->lock, LW_EXCLUSIVE);
+
+	if (!query_cache_stripes_unchanged(stripes, nstripes, horizon))
+	{
+		LWLockRelease(&QueryCache->lock);
+		pfree(stripes);
+		return;
+	}
+
+	/* Someone may have stored the result meanwhile; ours is as good */
+	dp = query_cache_lookup(capture->key.data, capture->key.len,
+							capture->hash, &entry);
+	if (DsaPointerIsValid(dp))
+		query_cache_remove(dp, entry);
+
+	/* Evict entries until there's room */
+	while (!DsaPointerIsValid(dp = dsa_allocate_extended(QueryCacheArea, size,
+														 DSA_ALLOC_NO_OOM)))
+	{
+		dsa_pointer victim = QueryCache->lru_tail;
+
+		if (!DsaPointerIsValid(victim))
+			break;
+		query_cache_remove(victim, dsa_get_address(QueryCacheArea, victim));
+	}
+
+	if (DsaPointerIsValid(dp))
+	{
+		uint32		bucket = capture->hash % QUERY_CACHE_BUCKETS;
+
+		entry = dsa_get_address(QueryCacheArea, dp);
+		entry->hash = capture->hash;
+		entry->refcount = 0;
+		entry->dead = false;
+		entry->created = horizon;
+		entry->keylen = capture->key.len;
+		entry->nstripes = nstripes;
+		entry->ntuples = capture->ntuples;
+		entry->tupleslen = capture->tuples.len;
+		memcpy(QCEntryKey(entry), capture->key.data, capture->key.len);
+		memcpy(QCEntryStripes(entry), stripes, nstripes * sizeof(uint16));
+		memcpy(QCEntryTuples(entry), capture->tuples.data, capture->tuples.len);
+
+		entry->next = QueryCache->buckets[bucket];
+		QueryCache->buckets[bucket] = dp;
+		query_cache_lru_push(dp, entry);
+	}
+
+	LWLockRelease(&QueryCache->lock);
+
+	pfree(stripes);
+}
+
+/*
+ * Send a tuple on to the query's destination, and keep a copy of it.
+ */
+static bool
+query_cache_receive(TupleTableSlot *slot, DestReceiver *self)
+{
+	QueryCacheCapture *capture = (QueryCacheCapture *) self;
+	MinimalTuple tuple;
+	bool		shouldFree;
+
+	if (!capture->dest->receiveSlot(slot, capture->dest))
+	{
+		capture->failed = true;
+		return false;
+	}
+
+	if (capture->failed)
+		return true;
+
+	tuple = ExecFetchSlotMinimalTuple(slot, &shouldFree);
+	if (capture->tuples.len + MAXALIGN(tuple->t_len) > capture->limit)
+	{
+		/* Too large to cache; stop copying */
+		capture->failed = true;
+		pfree(capture->tuples.data);
+		capture->tuples.data = NULL;
+	}
+	else
+	{
+		appendBinaryStringInfo(&capture->tuples, tuple, tuple->t_len);
+		while (capture->tuples.len % MAXIMUM_ALIGNOF != 0)
+			appendStringInfoCharMacro(&capture->tuples, '\0');
+		capture->ntuples++;
+	}
+
+	if (shouldFree)
+		pfree(tuple);
+
+	return true;
+}
+
+/*
+ * ExecutorRun() starts up and shuts down the query's destination itself.
+ */
+static void
+query_cache_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+}
+
+static void
+query_cache_shutdown(DestReceiver *self)
+{
+}
+
+static void
+query_cache_destroy(DestReceiver *self)
+{
+}
+
+/*
+ * Note that the current transaction may change the contents of the given
+ * relation, or of all relations of the database if relId is InvalidOid.
+ */
+void
+QueryCacheNoteChange(Oid dbId, Oid relId)
+{
+	if (!OidIsValid(relId))
+		memset(changedStripes, 0xFF, sizeof(changedStripes));
+	else
+	{
+		int			stripe = query_cache_stripe(dbId, relId);
+
+		changedStripes[stripe / 64] |= UINT64CONST(1) << (stripe % 64);
+	}
+	changedAny = true;
+}
+
+/*
+ * Note that the current transaction is changing the syscache entry with the
+ * given hash value, which plans might depend on.
+ */
+void
+QueryCacheNoteCatalogChange(Oid dbId, int cacheId, uint32 hashValue)
+{
+	int			stripe;
+
+	/* These are the caches that PlanInvalItems refer to */
+	if (cacheId != PROCOID && cacheId != TYPEOID)
+		return;
+
+	stripe = query_cache_catcache_stripe(dbId, cacheId, hashValue);
+	changedStripes[stripe / 64] |= UINT64CONST(1) << (stripe % 64);
+	changedAny = true;
+}
+
+static void
+query_cache_count_inflight(const uint64 *bitmap)
+{
+	int			i;
+
+	for (i = 0; i < QUERY_CACHE_STRIPES; i++)
+	{
+		if (bitmap[i / 64] & (UINT64CONST(1) << (i % 64)))
+			pg_atomic_fetch_add_u32(&QueryCache->stripes[i].inflight, 1);
+	}
+}
+
+/*
+ * Raise lastmod of the given stripes to the current completion count, and
+ * then uncount a transaction from their inflight counters.
+ */
+static void
+query_cache_release_stripes(const uint64 *bitmap)
+{
+	uint64		count;
+	int			i;
+
+	LWLockAcquire(ProcArrayLock, LW_SHARED);
+	count = TransamVariables->xactCompletionCount;
+	LWLockRelease(ProcArrayLock);
+
+	for (i = 0; i < QUERY_CACHE_STRIPES; i++)
+	{
+		QueryCacheStripe *stripe = &QueryCache->stripes[i];
+		uint64		lastmod;
+
+		if (!(bitmap[i / 64] & (UINT64CONST(1) << (i % 64))))
+			continue;
+
+		lastmod = pg_atomic_read_u64(&stripe->lastmod);
+		while (lastmod < count &&
+			   !pg_atomic_compare_exchange_u64(&stripe->lastmod, &lastmod,
+											   count))
+			;
+		pg_atomic_fetch_sub_u32(&stripe->inflight, 1);
+	}
+}
+
+/*
+ * Pre-commit processing: count ourselves as inflight in the stripes we
+ * changed, before we become visible to other transactions.
+ */
+void
+PreCommit_QueryCache(void)
+{
+	if (!changedAny || QueryCache == NULL)
+		return;
+
+	/* Without an XID, we changed nothing */
+	if (!TransactionIdIsValid(GetTopTransactionIdIfAny()))
+		return;
+
+	query_cache_count_inflight(changedStripes);
+	countedInflight = true;
+}
+
+/*
+ * PREPARE processing: leave it to the prepared transaction to be inflight
+ * until it is committed or rolled back.
+ */
+void
+AtPrepare_QueryCache(void)
+{
+	if (!changedAny || !TransactionIdIsValid(GetTopTransactionIdIfAny()))
+		return;
+
+	RegisterTwoPhaseRecord(TWOPHASE_RM_QUERYCACHE_ID, 0,
+						   changedStripes, sizeof(changedStripes));
+
+	if (QueryCache != NULL)
+	{
+		query_cache_count_inflight(changedStripes);
+		countedInflight = true;
+	}
+}
+
+/*
+ * Post-PREPARE processing: the prepared transaction now owns our inflight
+ * counts.
+ */
+void
+PostPrepare_QueryCache(void)
+{
+	countedInflight = false;
+	AtEOXact_QueryCache();
+}
+
+/*
+ * Post-commit or post-abort processing.  We're visible to everyone now, or
+ * never will be.
+ */
+void
+AtEOXact_QueryCache(void)
+{
+	if (countedInflight)
+		query_cache_release_stripes(changedStripes);
+
+	if (changedAny)
+		memset(changedStripes, 0, sizeof(changedStripes));
+	changedAny = false;
+	countedInflight = false;
+}
+
+/*
+ * 2PC processing routine for recovery of a prepared transaction
+ */
+void
+querycache_twophase_recover(TransactionId xid, uint16 info,
+							void *recdata, uint32 len)
+{
+	Assert(len == sizeof(changedStripes));
+
+	if (QueryCache != NULL)
+		query_cache_count_inflight((uint64 *) recdata);
+}
+
+/*
+ * 2PC processing routine for COMMIT PREPARED
+ */
+void
+querycache_twophase_postcommit(TransactionId xid, uint16 info,
+							   void *recdata, uint32 len)
+{
+	Assert(len == sizeof(changedStripes));
+
+	if (QueryCache != NULL)
+		query_cache_release_stripes((uint64 *) recdata);
+}
+
+/*
+ * 2PC processing routine for ROLLBACK PREPARED
+ */
+void
+querycache_twophase_postabort(TransactionId xid, uint16 info,
+							  void *recdata, uint32 len)
+{
+	querycache_twophase_postcommit(xid, info, recdata, len);
+}
@@ -137,6 +137,7 @@ CreateExecutorState(void)
 	estate->es_queryEnv = NULL;
 
 	estate->es_query_cxt = qcontext;
+	estate->es_arena_cxt = NULL;
 
 	estate->es_tupleTable = NIL;
 
@@ -226,6 +227,31 @@ FreeExecutorState(EState *estate)
 	MemoryContextDelete(estate->es_query_cxt);
 }
 
+/* ----------------
+ *		ExecGetArenaContext
+ *
+ *		Return the per-query arena, creating it on first use.
+ *
+ *		The arena is a bump context below es_query_cxt, for executor state
+ *		that is allocated once, never pfree'd or repalloc'd on its own, and
+ *		released with everything else by FreeExecutorState().  Bump chunks
+ *		carry no header, so they are cheaper to allocate than aset chunks;
+ *		but pfree, repalloc and GetMemoryChunkSpace must never be applied to
+ *		them.  The context is created lazily so that queries which have no
+ *		use for it don't pay for it.
+ * ----------------
+ */
+MemoryContext
+ExecGetArenaContext(EState *estate)
+{
+	if (estate->es_arena_cxt == NULL)
+		estate->es_arena_cxt = BumpContextCreate(estate->es_query_cxt,
+												 "ExecutorArena",
+												 ALLOCSET_DEFAULT_SIZES);
+
+	return estate->es_arena_cxt;
+}
+
 /*
  * Internal implementation for CreateExprContext() and CreateWorkExprContext()
  * that allows control over the AllocSet parameters.
@@ -538,6 +564,11 @@ void
 ExecAssignProjectionInfo(PlanState *planstate,
 						 TupleDesc inputDesc)
 {
+	/* The projection may have been kept from an earlier execution */
+	planstate->ps_ProjInfo = ExecGetCachedProjection(planstate, inputDesc);
+	if (planstate->ps_ProjInfo != NULL)
+		return;
+
 	planstate->ps_ProjInfo =
 		ExecBuildProjectionInfo(planstate->plan->targetlist,
 								planstate->ps_ExprContext,
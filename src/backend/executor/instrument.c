@@ -14,16 +14,264 @@
 #include "postgres.h"
 
 #include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) && defined(HAVE__GET_CPUID) && !defined(WIN32)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define USE_TSC_NODE_TIMING
+#endif
 
 #include "executor/instrument.h"
+#include "storage/fd.h"
 
 BufferUsage pgBufferUsage;
 static BufferUsage save_pgBufferUsage;
 WalUsage	pgWalUsage;
 static WalUsage save_pgWalUsage;
 
+#ifdef USE_TSC_NODE_TIMING
+/*
+ * Per-node timing reads the clock at every entry to and exit from a plan
+ * node, which for cheap nodes costs more than the node itself.  Where the
+ * CPU has an invariant time-stamp counter that the kernel also trusts as
+ * its clocksource, InstrStartNode/InstrStopNode read the TSC instead, and
+ * convert the elapsed ticks to nanoseconds using a rate calibrated against
+ * the system clock on first use.  Node start times are then in TSC ticks,
+ * while the accumulated counters stay in the usual instr_time unit.
+ *
+ * tsc_state is 0 until checked, 1 if the TSC is used, -1 if not.
+ */
+static int	tsc_state = 0;
+static double tsc_ns_per_tick;
+#endif
+
+#ifdef __linux__
+/*
+ * Hardware counters are read with perf_event_open(2), as one event group
+ * so that all of them are scheduled together.  The group is opened on
+ * first use and kept open for the life of the process.  Only the cycles
+ * counter (the group leader) is required; the others may be unsupported,
+ * for instance in virtual machines, and then read as zero.
+ */
+#define HWC_NUM_EVENTS	4
+
+static const uint64 hwc_events[HWC_NUM_EVENTS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static int	hwc_group_fd = -2;	/* -2 if not tried yet, -1 if failed */
+static int	hwc_errno;			/* errno of the failure, if any */
+static int	hwc_slot[HWC_NUM_EVENTS];	/* position in group read, or -1 */
+static int	hwc_nopen;
+
+static bool hwcounters_open(void);
+#endif
+
 static void BufferUsageAdd(BufferUsage *dst, const BufferUsage *add);
 static void WalUsageAdd(WalUsage *dst, WalUsage *add);
+static void HwCounterUsageAdd(HwCounterUsage *dst, const HwCounterUsage *add);
+
+
+#ifdef USE_TSC_NODE_TIMING
+static void
+tsc_init(void)
+{
+	unsigned int eax,
+				ebx,
+				ecx,
+				edx;
+	FILE	   *file;
+	char		clocksource[32];
+	bool		trusted = false;
+	instr_time	clock_start;
+	instr_time	clock_elapsed;
+	uint64		tsc_start;
+	uint64		tsc_end;
+
+	tsc_state = -1;
+
+	/* CPUID.80000007H:EDX[8] advertises an invariant TSC */
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+		(edx & (1 << 8)) == 0)
+		return;
+
+#ifdef __linux__
+	/* The kernel won't use the TSC if it's unsynchronized across CPUs */
+	file = AllocateFile("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+	if (file)
+	{
+		if (fgets(clocksource, sizeof(clocksource), file) &&
+			strcmp(clocksource, "tsc\n") == 0)
+			trusted = true;
+		FreeFile(file);
+	}
+#else
+	(void) file;
+	(void) clocksource;
+	trusted = true;
+#endif
+	if (!trusted)
+		return;
+
+	/* Calibrate against the system clock over about a millisecond */
+	INSTR_TIME_SET_CURRENT(clock_start);
+	tsc_start = __rdtsc();
+	do
+	{
+		INSTR_TIME_SET_CURRENT(clock_elapsed);
+		INSTR_TIME_SUBTRACT(clock_elapsed, clock_start);
+	} while (INSTR_TIME_GET_NANOSEC(clock_elapsed) < NS_PER_MS);
+	tsc_end = __rdtsc();
+
+	if (tsc_end <= tsc_start)
+		return;
+
+	tsc_ns_per_tick = (double) INSTR_TIME_GET_NANOSEC(clock_elapsed) /
+		(tsc_end - tsc_start);
+	tsc_state = 1;
+}
+#endif
+
+/* Read the current time for node timing, in TSC ticks if possible */
+static inline void
+node_time_set_current(instr_time *t)
+{
+#ifdef USE_TSC_NODE_TIMING
+	if (unlikely(tsc_state == 0))
+		tsc_init();
+	if (tsc_state > 0)
+	{
+		t->ticks = __rdtsc();
+		return;
+	}
+#endif
+	INSTR_TIME_SET_CURRENT(*t);
+}
+
+/* counter += end - start, with start and end from node_time_set_current */
+static inline void
+node_time_accum_diff(instr_time *counter, instr_time end, instr_time start)
+{
+#ifdef USE_TSC_NODE_TIMING
+	if (tsc_state > 0)
+	{
+		counter->ticks += (int64) ((end.ticks - start.ticks) * tsc_ns_per_tick);
+		return;
+	}
+#endif
+	INSTR_TIME_ACCUM_DIFF(*counter, end, start);
+}
+
+#ifdef __linux__
+static bool
+hwcounters_open(void)
+{
+	if (hwc_group_fd != -2)
+		return hwc_group_fd >= 0;
+
+	hwc_group_fd = -1;
+	hwc_nopen = 0;
+	for (int i = 0; i < HWC_NUM_EVENTS; i++)
+	{
+		struct perf_event_attr attr;
+		int			fd;
+
+		hwc_slot[i] = -1;
+
+		if (i > 0 && hwc_group_fd < 0)
+			continue;
+		if (!AcquireExternalFD())
+		{
+			hwc_errno = EMFILE;
+			continue;
+		}
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = hwc_events[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		/* count this process in user space only, on whichever CPU */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fd = syscall(__NR_perf_event_open, &attr, 0, -1, hwc_group_fd,
+					 PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0)
+		{
+			if (i == 0)
+				hwc_errno = errno;
+			ReleaseExternalFD();
+			continue;
+		}
+
+		if (i == 0)
+			hwc_group_fd = fd;
+		hwc_slot[i] = hwc_nopen++;
+	}
+
+	return hwc_group_fd >= 0;
+}
+#endif
+
+/* Read the current hardware counter values; zeroes if unavailable */
+static void
+hwcounters_read(HwCounterUsage *usage)
+{
+#ifdef __linux__
+	uint64		values[1 + HWC_NUM_EVENTS];
+	int64		counts[HWC_NUM_EVENTS] = {0};
+
+	if (hwcounters_open() &&
+		read(hwc_group_fd, values, sizeof(values)) >=
+		(ssize_t) ((1 + hwc_nopen) * sizeof(uint64)))
+	{
+		for (int i = 0; i < HWC_NUM_EVENTS; i++)
+		{
+			if (hwc_slot[i] >= 0)
+				counts[i] = values[1 + hwc_slot[i]];
+		}
+	}
+
+	usage->cycles = counts[0];
+	usage->instructions = counts[1];
+	usage->llc_misses = counts[2];
+	usage->branch_misses = counts[3];
+#else
+	memset(usage, 0, sizeof(HwCounterUsage));
+#endif
+}
+
+/*
+ * Check that hardware counters can be read by this process, throwing an
+ * error if not.  Parallel workers open their counters lazily, and just
+ * report zeroes if that fails.
+ */
+void
+InstrHwCountersInit(void)
+{
+#ifdef __linux__
+	if (!hwcounters_open())
+	{
+		errno = hwc_errno;
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("could not open hardware performance counters: %m"),
+				 errhint("Check that the kernel supports perf events and that \"kernel.perf_event_paranoid\" is at most 2.")));
+	}
+#else
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("hardware performance counters are not supported on this platform")));
+#endif
+}
 
 
 /* Allocate new instrumentation structure(s) */
@@ -34,10 +282,12 @@ InstrAlloc(int n, int instrument_options, bool async_mode)
 
 	/* initialize all fields to zeroes, then modify as needed */
 	instr = palloc0(n * sizeof(Instrumentation));
-	if (instrument_options & (INSTRUMENT_BUFFERS | INSTRUMENT_TIMER | INSTRUMENT_WAL))
+	if (instrument_options & (INSTRUMENT_BUFFERS | INSTRUMENT_TIMER |
+							  INSTRUMENT_WAL | INSTRUMENT_HWCOUNTERS))
 	{
 		bool		need_buffers = (instrument_options & INSTRUMENT_BUFFERS) != 0;
 		bool		need_wal = (instrument_options & INSTRUMENT_WAL) != 0;
+		bool		need_hwcounters = (instrument_options & INSTRUMENT_HWCOUNTERS) != 0;
 		bool		need_timer = (instrument_options & INSTRUMENT_TIMER) != 0;
 		int			i;
 
@@ -45,6 +295,7 @@ InstrAlloc(int n, int instrument_options, bool async_mode)
 		{
 			instr[i].need_bufusage = need_buffers;
 			instr[i].need_walusage = need_wal;
+			instr[i].need_hwcounters = need_hwcounters;
 			instr[i].need_timer = need_timer;
 			instr[i].async_mode = async_mode;
 		}
@@ -60,6 +311,7 @@ InstrInit(Instrumentation *instr, int instrument_options)
 	memset(instr, 0, sizeof(Instrumentation));
 	instr->need_bufusage = (instrument_options & INSTRUMENT_BUFFERS) != 0;
 	instr->need_walusage = (instrument_options & INSTRUMENT_WAL) != 0;
+	instr->need_hwcounters = (instrument_options & INSTRUMENT_HWCOUNTERS) != 0;
 	instr->need_timer = (instrument_options & INSTRUMENT_TIMER) != 0;
 }
 
@@ -67,9 +319,12 @@ InstrInit(Instrumentation *instr, int instrument_options)
 void
 InstrStartNode(Instrumentation *instr)
 {
-	if (instr->need_timer &&
-		!INSTR_TIME_SET_CURRENT_LAZY(instr->starttime))
-		elog(ERROR, "InstrStartNode called twice in a row");
+	if (instr->need_timer)
+	{
+		if (!INSTR_TIME_IS_ZERO(instr->starttime))
+			elog(ERROR, "InstrStartNode called twice in a row");
+		node_time_set_current(&instr->starttime);
+	}
 
 	/* save buffer usage totals at node entry, if needed */
 	if (instr->need_bufusage)
@@ -77,6 +332,10 @@ InstrStartNode(Instrumentation *instr)
 
 	if (instr->need_walusage)
 		instr->walusage_start = pgWalUsage;
+
+	/* read hardware counters last, to leave out our own overhead */
+	if (instr->need_hwcounters)
+		hwcounters_read(&instr->hwcounters_start);
 }
 
 /* Exit from a plan node */
@@ -86,6 +345,22 @@ InstrStopNode(Instrumentation *instr, double nTuples)
 	double		save_tuplecount = instr->tuplecount;
 	instr_time	endtime;
 
+	/* read hardware counters first, to leave out our own overhead */
+	if (instr->need_hwcounters)
+	{
+		HwCounterUsage hwcounters;
+
+		hwcounters_read(&hwcounters);
+		instr->hwcounters.cycles +=
+			hwcounters.cycles - instr->hwcounters_start.cycles;
+		instr->hwcounters.instructions +=
+			hwcounters.instructions - instr->hwcounters_start.instructions;
+		instr->hwcounters.llc_misses +=
+			hwcounters.llc_misses - instr->hwcounters_start.llc_misses;
+		instr->hwcounters.branch_misses +=
+			hwcounters.branch_misses - instr->hwcounters_start.branch_misses;
+	}
+
 	/* count the returned tuples */
 	instr->tuplecount += nTuples;
 
@@ -95,8 +370,8 @@ InstrStopNode(Instrumentation *instr, double nTuples)
 		if (INSTR_TIME_IS_ZERO(instr->starttime))
 			elog(ERROR, "InstrStopNode called without start");
 
-		INSTR_TIME_SET_CURRENT(endtime);
-		INSTR_TIME_ACCUM_DIFF(instr->counter, endtime, instr->starttime);
+		node_time_set_current(&endtime);
+		node_time_accum_diff(&instr->counter, endtime, instr->starttime);
 
 		INSTR_TIME_SET_ZERO(instr->starttime);
 	}
@@ -193,6 +468,9 @@ InstrAggNode(Instrumentation *dst, Instrumentation *add)
 
 	if (dst->need_walusage)
 		WalUsageAdd(&dst->walusage, &add->walusage);
+
+	if (dst->need_hwcounters)
+		HwCounterUsageAdd(&dst->hwcounters, &add->hwcounters);
 }
 
 /* note current values during parallel executor startup */
@@ -289,3 +567,13 @@ WalUsageAccumDiff(WalUsage *dst, const WalUsage *add, const WalUsage *sub)
 	dst->wal_records += add->wal_records - sub->wal_records;
 	dst->wal_fpi += add->wal_fpi - sub->wal_fpi;
 }
+
+/* helper function for hardware counter accumulation */
+static void
+HwCounterUsageAdd(HwCounterUsage *dst, const HwCounterUsage *add)
+{
+	dst->cycles += add->cycles;
+	dst->instructions += add->instructions;
+	dst->llc_misses += add->llc_misses;
+	dst->branch_misses += add->branch_misses;
+}
@@ -255,6 +255,7 @@
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "common/hashfn.h"
+#include "executor/execBatch.h"
 #include "executor/execExpr.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -414,7 +415,7 @@ static int	hash_choose_num_partitions(double input_groups,
 static void initialize_hash_entry(AggState *aggstate,
 								  TupleHashTable hashtable,
 								  TupleHashEntry entry);
-static void lookup_hash_entries(AggState *aggstate);
+static void lookup_hash_entries(AggState *aggstate, uint32 *hashes);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
 static void agg_fill_hash_table(AggState *aggstate);
 static bool agg_refill_hash_table(AggState *aggstate);
@@ -558,7 +559,8 @@ fetch_input_tuple(AggState *aggstate)
 		slot = aggstate->sort_slot;
 	}
 	else
-		slot = ExecProcNode(outerPlanState(aggstate));
+		slot = ExecBatchReaderNext(outerPlanState(aggstate),
+								   aggstate->input_reader);
 
 	if (!TupIsNull(slot) && aggstate->sort_out)
 		tuplesort_puttupleslot(aggstate->sort_out, slot);
@@ -2090,9 +2092,12 @@ initialize_hash_entry(AggState *aggstate, TupleHashTable hashtable,
  * the tuple multiple times for multiple grouping sets, it can be partitioned
  * for each grouping set, making the refilling of the hash table very
  * efficient.
+ *
+ * If the caller already computed the tuple's hash value for each grouping
+ * set, they're passed in hashes[], otherwise it's NULL.
  */
 static void
-lookup_hash_entries(AggState *aggstate)
+lookup_hash_entries(AggState *aggstate, uint32 *hashes)
 {
 	AggStatePerGroup *pergroup = aggstate->hash_pergroup;
 	TupleTableSlot *outerslot = aggstate->tmpcontext->ecxt_outertuple;
@@ -2116,8 +2121,15 @@ lookup_hash_entries(AggState *aggstate)
 						  outerslot,
 						  hashslot);
 
-		entry = LookupTupleHashEntry(hashtable, hashslot,
-									 p_isnew, &hash);
+		if (hashes != NULL)
+		{
+			hash = hashes[setno];
+			entry = LookupTupleHashEntryHash(hashtable, hashslot,
+											 p_isnew, hash);
+		}
+		else
+			entry = LookupTupleHashEntry(hashtable, hashslot,
+										 p_isnew, &hash);
 
 		if (entry != NULL)
 		{
@@ -2447,7 +2459,7 @@ agg_retrieve_direct(AggState *aggstate)
 					if (aggstate->aggstrategy == AGG_MIXED &&
 						aggstate->current_phase == 1)
 					{
-						lookup_hash_entries(aggstate);
+						lookup_hash_entries(aggstate, NULL);
 					}
 
 					/* Advance the aggregates (or combine functions) */
@@ -2539,35 +2551,67 @@ agg_retrieve_direct(AggState *aggstate)
 static void
 agg_fill_hash_table(AggState *aggstate)
 {
-	TupleTableSlot *outerslot;
+	PlanState  *outerPlan = outerPlanState(aggstate);
 	ExprContext *tmpcontext = aggstate->tmpcontext;
+	int			num_hashes = aggstate->num_hashes;
+	TupleTableSlot *slots[EXEC_BATCH_SIZE];
+	uint32	   *hashes;
+
+	/* AGG_HASHED never sorts its input */
+	Assert(aggstate->sort_in == NULL && aggstate->sort_out == NULL);
+
+	hashes = palloc(sizeof(uint32) * num_hashes * EXEC_BATCH_SIZE);
 
 	/*
-	 * Process each outer-plan tuple, and then fetch the next one, until we
-	 * exhaust the outer plan.
+	 * Process the outer-plan tuples a batch at a time, until we exhaust the
+	 * outer plan.  For a large hash table, the lookups are dominated by
+	 * cache misses, so first compute the hash values of the whole batch,
+	 * starting to fetch the buckets they're going to probe, and only then
+	 * do the lookups and advance the aggregates tuple by tuple.
 	 */
 	for (;;)
 	{
-		outerslot = fetch_input_tuple(aggstate);
-		if (TupIsNull(outerslot))
+		int			nslots;
+
+		nslots = ExecProcNodeBatch(outerPlan, slots, EXEC_BATCH_SIZE);
+		if (nslots == 0)
 			break;
 
-		/* set up for lookup_hash_entries and advance_aggregates */
-		tmpcontext->ecxt_outertuple = outerslot;
+		for (int i = 0; i < nslots; i++)
+		{
+			for (int setno = 0; setno < num_hashes; setno++)
+			{
+				AggStatePerHash perhash = &aggstate->perhash[setno];
+				uint32		hash;
 
-		/* Find or build hashtable entries */
-		lookup_hash_entries(aggstate);
+				prepare_hash_slot(perhash, slots[i], perhash->hashslot);
+				hash = TupleHashTableHash(perhash->hashtable, perhash->hashslot);
+				TupleHashTablePrefetch(perhash->hashtable, hash);
+				hashes[i * num_hashes + setno] = hash;
+			}
+		}
 
-		/* Advance the aggregates (or combine functions) */
-		advance_aggregates(aggstate);
+		for (int i = 0; i < nslots; i++)
+		{
+			/* set up for lookup_hash_entries and advance_aggregates */
+			tmpcontext->ecxt_outertuple = slots[i];
 
-		/*
-		 * Reset per-input-tuple context after each tuple, but note that the
-		 * hash lookups do this too
-		 */
-		ResetExprContext(aggstate->tmpcontext);
+			/* Find or build hashtable entries */
+			lookup_hash_entries(aggstate, &hashes[i * num_hashes]);
+
+			/* Advance the aggregates (or combine functions) */
+			advance_aggregates(aggstate);
+
+			/*
+			 * Reset per-input-tuple context after each tuple, but note that
+			 * the hash lookups do this too
+			 */
+			ResetExprContext(aggstate->tmpcontext);
+		}
 	}
 
+	pfree(hashes);
+
 	/* finalize spills, if any */
 	hashagg_finish_initial_spills(aggstate);
 
@@ -3303,6 +3347,7 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		eflags &= ~EXEC_FLAG_REWIND;
 	outerPlan = outerPlan(node);
 	outerPlanState(aggstate) = ExecInitNode(outerPlan, estate, eflags);
+	aggstate->input_reader = palloc0(sizeof(ExecBatchReader));
 
 	/*
 	 * initialize source tuple type.
@@ -4371,6 +4416,7 @@ ExecReScanAgg(AggState *node)
 	int			setno;
 
 	node->agg_done = false;
+	ExecBatchReaderReset(node->input_reader);
 
 	if (node->aggstrategy == AGG_HASHED)
 	{
@@ -359,7 +359,7 @@ BitmapAdjustPrefetchIterator(BitmapHeapScanState *node,
 		else if (prefetch_iterator)
 		{
 			/* Do not let the prefetch iterator get behind the main one */
-			TBMIterateResult *tbmpre = tbm_iterate(prefetch_iterator);
+			TBMIterateResult *tbmpre = tbm_iterate_blocks(prefetch_iterator);
 
 			if (tbmpre == NULL || tbmpre->blockno != blockno)
 				elog(ERROR, "prefetch and main iterators are out of sync");
@@ -391,7 +391,7 @@ BitmapAdjustPrefetchIterator(BitmapHeapScanState *node,
 			 * case.
 			 */
 			if (prefetch_iterator)
-				tbm_shared_iterate(prefetch_iterator);
+				tbm_shared_iterate_blocks(prefetch_iterator);
 		}
 	}
 #endif							/* USE_PREFETCH */
@@ -458,7 +458,7 @@ BitmapPrefetch(BitmapHeapScanState *node, TableScanDesc scan)
 		{
 			while (node->prefetch_pages < node->prefetch_target)
 			{
-				TBMIterateResult *tbmpre = tbm_iterate(prefetch_iterator);
+				TBMIterateResult *tbmpre = tbm_iterate_blocks(prefetch_iterator);
 				bool		skip_fetch;
 
 				if (tbmpre == NULL)
@@ -517,7 +517,7 @@ BitmapPrefetch(BitmapHeapScanState *node, TableScanDesc scan)
 				if (!do_prefetch)
 					return;
 
-				tbmpre = tbm_shared_iterate(prefetch_iterator);
+				tbmpre = tbm_shared_iterate_blocks(prefetch_iterator);
 				if (tbmpre == NULL)
 				{
 					/* No more pages to prefetch */
@@ -30,6 +30,7 @@
 
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/execParallel.h"
 #include "executor/executor.h"
 #include "executor/nodeGather.h"
@@ -71,6 +72,7 @@ ExecInitGather(Gather *node, EState *estate, int eflags)
 	gatherstate->need_to_scan_locally =
 		!node->single_copy && parallel_leader_participation;
 	gatherstate->tuples_needed = -1;
+	gatherstate->local_reader = palloc0(sizeof(ExecBatchReader));
 
 	/*
 	 * Miscellaneous initialization
@@ -167,7 +169,8 @@ ExecGather(PlanState *pstate)
 												 estate,
 												 gather->initParam,
 												 gather->num_workers,
-												 node->tuples_needed);
+												 node->tuples_needed,
+												 node->into_relid);
 			else
 				ExecParallelReinitialize(outerPlanState(node),
 										 node->pei,
@@ -284,7 +287,8 @@ gather_getnext(GatherState *gatherstate)
 			/* Install our DSA area while executing the plan. */
 			estate->es_query_dsa =
 				gatherstate->pei ? gatherstate->pei->area : NULL;
-			outerTupleSlot = ExecProcNode(outerPlan);
+			outerTupleSlot = ExecBatchReaderNext(outerPlan,
+												 gatherstate->local_reader);
 			estate->es_query_dsa = NULL;
 
 			if (!TupIsNull(outerTupleSlot))
@@ -443,6 +447,9 @@ ExecReScanGather(GatherState *node)
 	/* Mark node so that shared state will be rebuilt at next call */
 	node->initialized = false;
 
+	/* Forget any tuples of the local plan we haven't returned */
+	ExecBatchReaderReset(node->local_reader);
+
 	/*
 	 * Set child node's chgParam to tell it that the next scan might deliver a
 	 * different set of rows within the leader process.  (The overall rowset
@@ -14,21 +14,31 @@
 
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/execParallel.h"
 #include "executor/nodeGatherMerge.h"
 #include "executor/tqueue.h"
-#include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "optimizer/optimizer.h"
+#include "utils/memutils.h"
 
 /*
  * When we read tuples from workers, it's a good idea to read several at once
  * for efficiency when possible: this minimizes context-switching overhead.
- * But reading too many at a time wastes memory without improving performance.
- * We'll read up to MAX_TUPLE_STORE tuples (in addition to the first one).
+ * Workers send their tuples several to a tuple queue message, so we read
+ * them a message's worth or more at a time.  But reading too many at a time
+ * wastes memory without improving performance.  We'll read up to
+ * MAX_TUPLE_STORE tuples (in addition to the first one).
  */
-#define MAX_TUPLE_STORE 10
+#define MAX_TUPLE_STORE 64
+
+/*
+ * We have one slot for each participant in the merge.  We use SlotNumber
+ * to store slot indexes.  This doesn't actually provide any formal
+ * type-safety, but it makes the code more self-documenting.
+ */
+typedef int32 SlotNumber;
 
 /*
  * Pending-tuple array for each worker.  This holds additional tuples that
@@ -46,8 +56,36 @@ typedef struct GMReaderTupleBuffer
 	bool		done;			/* true if reader is known exhausted */
 } GMReaderTupleBuffer;
 
+/*
+ * Loser tree (tournament tree) used to merge the participants' streams.
+ *
+ * Each participant is a leaf of an implicit binary tree: the leaf for slot
+ * number i is at position nleaves + i, and the parent of position p is
+ * p / 2.  Each internal node 1 .. nleaves - 1 remembers the loser of the
+ * match played there, and node[0] holds the overall winner, that is the
+ * participant whose current tuple sorts first.  When the winner advances to
+ * its next tuple, only the matches on its path to the root are replayed, at
+ * one comparison per level.  A binary heap needs up to two comparisons per
+ * level to sift the replaced element down, which matters once there are
+ * many workers, since the leader is then the bottleneck.
+ *
+ * A participant without a current tuple (not live) loses every match.
+ */
+typedef struct GMLoserTree
+{
+	int			nleaves;		/* number of participants */
+	SlotNumber *node;			/* node[0] is the winner, the rest losers */
+	SlotNumber *winner;			/* workspace for gm_tree_build */
+	bool	   *live;			/* does participant have a current tuple? */
+} GMLoserTree;
+
 static TupleTableSlot *ExecGatherMerge(PlanState *pstate);
-static int32 heap_compare_slots(Datum a, Datum b, void *arg);
+static int32 gm_compare_slots(GatherMergeState *node, SlotNumber slot1,
+							  SlotNumber slot2);
+static bool gm_slot_precedes(GatherMergeState *gm_state, SlotNumber a,
+							 SlotNumber b);
+static void gm_tree_build(GatherMergeState *gm_state);
+static void gm_tree_replay(GatherMergeState *gm_state, SlotNumber slot);
 static TupleTableSlot *gather_merge_getnext(GatherMergeState *gm_state);
 static MinimalTuple gm_readnext_tuple(GatherMergeState *gm_state, int nreader,
 									  bool nowait, bool *done);
@@ -84,6 +122,7 @@ ExecInitGatherMerge(GatherMerge *node, EState *estate, int eflags)
 	gm_state->initialized = false;
 	gm_state->gm_initialized = false;
 	gm_state->tuples_needed = -1;
+	gm_state->local_reader = palloc0(sizeof(ExecBatchReader));
 
 	/*
 	 * Miscellaneous initialization
@@ -211,7 +250,8 @@ ExecGatherMerge(PlanState *pstate)
 												 estate,
 												 gm->initParam,
 												 gm->num_workers,
-												 node->tuples_needed);
+												 node->tuples_needed,
+												 InvalidOid);
 			else
 				ExecParallelReinitialize(outerPlanState(node),
 										 node->pei,
@@ -342,6 +382,9 @@ ExecReScanGatherMerge(GatherMergeState *node)
 	/* Free any unused tuples, so we don't leak memory across rescans */
 	gather_merge_clear_tuples(node);
 
+	/* Forget any tuples of the local plan we haven't returned */
+	ExecBatchReaderReset(node->local_reader);
+
 	/* Mark node so that shared state will be rebuilt at next call */
 	node->initialized = false;
 	node->gm_initialized = false;
@@ -380,8 +423,8 @@ ExecReScanGatherMerge(GatherMergeState *node)
  * not leaking memory across rescans.
  *
  * In the gm_slots[] array, index 0 is for the leader, and indexes 1 to n
- * are for workers.  The values placed into gm_heap correspond to indexes
- * in gm_slots[].  The gm_tuple_buffers[] array, however, is indexed from
+ * are for workers.  The leaves of gm_tree correspond to indexes in
+ * gm_slots[].  The gm_tuple_buffers[] array, however, is indexed from
  * 0 to n-1; it has no entry for the leader.
  */
 static void
@@ -389,6 +432,7 @@ gather_merge_setup(GatherMergeState *gm_state)
 {
 	GatherMerge *gm = castNode(GatherMerge, gm_state->ps.plan);
 	int			nreaders = gm->num_workers;
+	GMLoserTree *tree;
 	int			i;
 
 	/*
@@ -419,10 +463,21 @@ gather_merge_setup(GatherMergeState *gm_state)
 								   &TTSOpsMinimalTuple);
 	}
 
+	/*
+	 * Tuples read from workers are freed in about the order they were read,
+	 * which suits a generation context.
+	 */
+	gm_state->gm_tuple_cxt = GenerationContextCreate(CurrentMemoryContext,
+													 "GatherMerge tuples",
+													 ALLOCSET_DEFAULT_SIZES);
+
 	/* Allocate the resources for the merge */
-	gm_state->gm_heap = binaryheap_allocate(nreaders + 1,
-											heap_compare_slots,
-											gm_state);
+	tree = (GMLoserTree *) palloc(sizeof(GMLoserTree));
+	tree->nleaves = 0;
+	tree->node = (SlotNumber *) palloc((nreaders + 1) * sizeof(SlotNumber));
+	tree->winner = (SlotNumber *) palloc((nreaders + 1) * sizeof(SlotNumber));
+	tree->live = (bool *) palloc0((nreaders + 1) * sizeof(bool));
+	gm_state->gm_tree = tree;
 }
 
 /*
@@ -430,11 +485,12 @@ gather_merge_setup(GatherMergeState *gm_state)
  *
  * Reset data structures to ensure they're empty.  Then pull at least one
  * tuple from leader + each worker (or set its "done" indicator), and set up
- * the heap.
+ * the loser tree.
  */
 static void
 gather_merge_init(GatherMergeState *gm_state)
 {
+	GMLoserTree *tree = gm_state->gm_tree;
 	int			nreaders = gm_state->nreaders;
 	bool		nowait = true;
 	int			i;
@@ -457,15 +513,16 @@ gather_merge_init(GatherMergeState *gm_state)
 		ExecClearTuple(gm_state->gm_slots[i + 1]);
 	}
 
-	/* Reset binary heap to empty */
-	binaryheap_reset(gm_state->gm_heap);
+	/* Reset loser tree to empty */
+	tree->nleaves = nreaders + 1;
+	memset(tree->live, 0, tree->nleaves * sizeof(bool));
 
 	/*
 	 * First, try to read a tuple from each worker (including leader) in
 	 * nowait mode.  After this, if not all workers were able to produce a
 	 * tuple (or a "done" indication), then re-read from remaining workers,
-	 * this time using wait mode.  Add all live readers (those producing at
-	 * least one tuple) to the heap.
+	 * this time using wait mode.  Mark all readers producing at least one
+	 * tuple as live.
 	 */
 reread:
 	for (i = 0; i <= nreaders; i++)
@@ -480,8 +537,7 @@ reread:
 			{
 				/* Don't have a tuple yet, try to get one */
 				if (gather_merge_readnext(gm_state, i, nowait))
-					binaryheap_add_unordered(gm_state->gm_heap,
-											 Int32GetDatum(i));
+					tree->live[i] = true;
 			}
 			else
 			{
@@ -505,8 +561,8 @@ reread:
 		}
 	}
 
-	/* Now heapify the heap. */
-	binaryheap_build(gm_state->gm_heap);
+	/* Now play the initial tournament. */
+	gm_tree_build(gm_state);
 
 	gm_state->gm_initialized = true;
 }
@@ -524,28 +580,31 @@ gather_merge_clear_tuples(GatherMergeState *gm_state)
 	{
 		GMReaderTupleBuffer *tuple_buffer = &gm_state->gm_tuple_buffers[i];
 
-		while (tuple_buffer->readCounter < tuple_buffer->nTuples)
-			pfree(tuple_buffer->tuple[tuple_buffer->readCounter++]);
+		tuple_buffer->nTuples = tuple_buffer->readCounter = 0;
 
 		ExecClearTuple(gm_state->gm_slots[i + 1]);
 	}
+
+	/* That leaves only pending tuples in gm_tuple_cxt; free them all */
+	MemoryContextReset(gm_state->gm_tuple_cxt);
 }
 
 /*
  * Read the next tuple for gather merge.
  *
- * Fetch the sorted tuple out of the heap.
+ * Fetch the sorted tuple out of the loser tree.
  */
 static TupleTableSlot *
 gather_merge_getnext(GatherMergeState *gm_state)
 {
-	int			i;
+	GMLoserTree *tree = gm_state->gm_tree;
+	SlotNumber	i;
 
 	if (!gm_state->gm_initialized)
 	{
 		/*
 		 * First time through: pull the first tuple from each participant, and
-		 * set up the heap.
+		 * set up the loser tree.
 		 */
 		gather_merge_init(gm_state);
 	}
@@ -553,31 +612,27 @@ gather_merge_getnext(GatherMergeState *gm_state)
 	{
 		/*
 		 * Otherwise, pull the next tuple from whichever participant we
-		 * returned from last time, and reinsert that participant's index into
-		 * the heap, because it might now compare differently against the
-		 * other elements of the heap.
+		 * returned from last time, and replay its matches, because it might
+		 * now compare differently against the other participants.  If the
+		 * reader is exhausted, it'll just lose all of them.
 		 */
-		i = DatumGetInt32(binaryheap_first(gm_state->gm_heap));
+		i = tree->node[0];
 
-		if (gather_merge_readnext(gm_state, i, false))
-			binaryheap_replace_first(gm_state->gm_heap, Int32GetDatum(i));
-		else
-		{
-			/* reader exhausted, remove it from heap */
-			(void) binaryheap_remove_first(gm_state->gm_heap);
-		}
+		if (!gather_merge_readnext(gm_state, i, false))
+			tree->live[i] = false;
+		gm_tree_replay(gm_state, i);
 	}
 
-	if (binaryheap_empty(gm_state->gm_heap))
+	i = tree->node[0];
+	if (!tree->live[i])
 	{
-		/* All the queues are exhausted, and so is the heap */
+		/* Even the winner is exhausted, so all the queues are */
 		gather_merge_clear_tuples(gm_state);
 		return NULL;
 	}
 	else
 	{
 		/* Return next tuple from whichever participant has the leading one */
-		i = DatumGetInt32(binaryheap_first(gm_state->gm_heap));
 		return gm_state->gm_slots[i];
 	}
 }
@@ -645,7 +700,8 @@ gather_merge_readnext(GatherMergeState *gm_state, int reader, bool nowait)
 
 			/* Install our DSA area while executing the plan. */
 			estate->es_query_dsa = gm_state->pei ? gm_state->pei->area : NULL;
-			outerTupleSlot = ExecProcNode(outerPlan);
+			outerTupleSlot = ExecBatchReaderNext(outerPlan,
+												 gm_state->local_reader);
 			estate->es_query_dsa = NULL;
 
 			if (!TupIsNull(outerTupleSlot))
@@ -709,6 +765,8 @@ gm_readnext_tuple(GatherMergeState *gm_state, int nreader, bool nowait,
 {
 	TupleQueueReader *reader;
 	MinimalTuple tup;
+	MinimalTuple copy;
+	MemoryContext oldcontext;
 
 	/* Check for async events, particularly messages from workers. */
 	CHECK_FOR_INTERRUPTS();
@@ -724,30 +782,104 @@ gm_readnext_tuple(GatherMergeState *gm_state, int nreader, bool nowait,
 	reader = gm_state->reader[nreader - 1];
 	tup = TupleQueueReaderNext(reader, nowait, done);
 
+	if (!tup)
+		return NULL;
+
 	/*
 	 * Since we'll be buffering these across multiple calls, we need to make a
 	 * copy.
 	 */
-	return tup ? heap_copy_minimal_tuple(tup) : NULL;
+	oldcontext = MemoryContextSwitchTo(gm_state->gm_tuple_cxt);
+	copy = heap_copy_minimal_tuple(tup);
+	MemoryContextSwitchTo(oldcontext);
+
+	return copy;
 }
 
 /*
- * We have one slot for each item in the heap array.  We use SlotNumber
- * to store slot indexes.  This doesn't actually provide any formal
- * type-safety, but it makes the code more self-documenting.
+ * Play the initial tournament among all participants of the loser tree.
  */
-typedef int32 SlotNumber;
+static void
+gm_tree_build(GatherMergeState *gm_state)
+{
+	GMLoserTree *tree = gm_state->gm_tree;
+	int			nleaves = tree->nleaves;
+	int			p;
+
+	for (p = nleaves - 1; p >= 1; p--)
+	{
+		int			left = 2 * p;
+		int			right = 2 * p + 1;
+		SlotNumber	a;
+		SlotNumber	b;
+
+		a = (left >= nleaves) ? left - nleaves : tree->winner[left];
+		b = (right >= nleaves) ? right - nleaves : tree->winner[right];
+
+		if (gm_slot_precedes(gm_state, b, a))
+		{
+			tree->winner[p] = b;
+			tree->node[p] = a;
+		}
+		else
+		{
+			tree->winner[p] = a;
+			tree->node[p] = b;
+		}
+	}
+
+	tree->node[0] = (nleaves > 1) ? tree->winner[1] : 0;
+}
+
+/*
+ * Replay the matches of the given participant, which must be the previous
+ * winner, after its current tuple has changed.
+ */
+static void
+gm_tree_replay(GatherMergeState *gm_state, SlotNumber slot)
+{
+	GMLoserTree *tree = gm_state->gm_tree;
+	SlotNumber	winner = slot;
+	int			p;
+
+	Assert(slot == tree->node[0]);
+
+	for (p = (tree->nleaves + slot) / 2; p >= 1; p /= 2)
+	{
+		if (gm_slot_precedes(gm_state, tree->node[p], winner))
+		{
+			SlotNumber	loser = winner;
+
+			winner = tree->node[p];
+			tree->node[p] = loser;
+		}
+	}
+
+	tree->node[0] = winner;
+}
+
+/*
+ * Does the current tuple of participant a sort strictly before that of b?
+ * A participant that is not live sorts after everything.
+ */
+static bool
+gm_slot_precedes(GatherMergeState *gm_state, SlotNumber a, SlotNumber b)
+{
+	GMLoserTree *tree = gm_state->gm_tree;
+
+	if (!tree->live[a])
+		return false;
+	if (!tree->live[b])
+		return true;
+	return gm_compare_slots(gm_state, a, b) < 0;
+}
 
 /*
  * Compare the tuples in the two given slots.
  */
 static int32
-heap_compare_slots(Datum a, Datum b, void *arg)
+gm_compare_slots(GatherMergeState *node, SlotNumber slot1, SlotNumber slot2)
 {
-	GatherMergeState *node = (GatherMergeState *) arg;
-	SlotNumber	slot1 = DatumGetInt32(a);
-	SlotNumber	slot2 = DatumGetInt32(b);
-
 	TupleTableSlot *s1 = node->gm_slots[slot1];
 	TupleTableSlot *s2 = node->gm_slots[slot2];
 	int			nkey;
@@ -772,10 +904,7 @@ heap_compare_slots(Datum a, Datum b, void *arg)
 									  datum2, isNull2,
 									  sortKey);
 		if (compare != 0)
-		{
-			INVERT_COMPARE_RESULT(compare);
 			return compare;
-		}
 	}
 	return 0;
 }
@@ -30,6 +30,7 @@
 #include "access/parallel.h"
 #include "catalog/pg_statistic.h"
 #include "commands/tablespace.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
@@ -143,6 +144,7 @@ MultiExecPrivateHash(HashState *node)
 	TupleTableSlot *slot;
 	ExprContext *econtext;
 	uint32		hashvalue;
+	ExecBatchReader reader;
 
 	/*
 	 * get state info from node
@@ -160,9 +162,10 @@ MultiExecPrivateHash(HashState *node)
 	 * Get all tuples from the node below the Hash node and insert into the
 	 * hash table (or temp files).
 	 */
+	ExecBatchReaderReset(&reader);
 	for (;;)
 	{
-		slot = ExecProcNode(outerNode);
+		slot = ExecBatchReaderNext(outerNode, &reader);
 		if (TupIsNull(slot))
 			break;
 		/* We have to compute the hash value */
@@ -220,6 +223,7 @@ MultiExecParallelHash(HashState *node)
 	TupleTableSlot *slot;
 	ExprContext *econtext;
 	uint32		hashvalue;
+	ExecBatchReader reader;
 	Barrier    *build_barrier;
 	int			i;
 
@@ -277,9 +281,10 @@ MultiExecParallelHash(HashState *node)
 				ExecParallelHashIncreaseNumBuckets(hashtable);
 			ExecParallelHashEnsureBatchAccessors(hashtable);
 			ExecParallelHashTableSetCurrentBatch(hashtable, 0);
+			ExecBatchReaderReset(&reader);
 			for (;;)
 			{
-				slot = ExecProcNode(outerNode);
+				slot = ExecBatchReaderNext(outerNode, &reader);
 				if (TupIsNull(slot))
 					break;
 				econtext->ecxt_outertuple = slot;
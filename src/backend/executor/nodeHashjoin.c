@@ -164,11 +164,14 @@
 
 #include "access/htup_details.h"
 #include "access/parallel.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "utils/memutils.h"
 #include "utils/sharedtuplestore.h"
 #include "utils/wait_event.h"
 
@@ -194,6 +197,16 @@ static TupleTableSlot *ExecHashJoinOuterGetTuple(PlanState *outerNode,
 static TupleTableSlot *ExecParallelHashJoinOuterGetTuple(PlanState *outerNode,
 														 HashJoinState *hjstate,
 														 uint32 *hashvalue);
+static bool ExecHashJoinOuterHashValue(HashJoinState *hjstate,
+									   TupleTableSlot *slot,
+									   uint32 *hashvalue);
+static void ExecHashJoinPrefetchOuterBatch(HashJoinState *hjstate);
+static void ExecHashJoinRadixSetup(HashJoinState *hjstate);
+static TupleTableSlot *ExecHashJoinRadixNext(PlanState *outerNode,
+											 HashJoinState *hjstate,
+											 uint32 *hashvalue);
+static void ExecHashJoinRadixFill(PlanState *outerNode,
+								  HashJoinState *hjstate);
 static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
 												 BufFile *file,
 												 uint32 *hashvalue,
@@ -314,7 +327,8 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 						 (outerNode->plan->startup_cost < hashNode->ps.plan->total_cost &&
 						  !node->hj_OuterNotEmpty))
 				{
-					node->hj_FirstOuterTupleSlot = ExecProcNode(outerNode);
+					node->hj_FirstOuterTupleSlot =
+						ExecBatchReaderNext(outerNode, node->hj_OuterReader);
 					if (TupIsNull(node->hj_FirstOuterTupleSlot))
 					{
 						node->hj_OuterNotEmpty = false;
@@ -345,6 +359,9 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 				hashNode->hashtable = hashtable;
 				(void) MultiExecProcNode((PlanState *) hashNode);
 
+				/* decide whether to probe the table in radix partitions */
+				ExecHashJoinRadixSetup(node);
+
 				/*
 				 * If the inner relation is completely empty, and we're not
 				 * doing a left outer join, we can quit without scanning the
@@ -751,6 +768,9 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hashNode = (Hash *) innerPlan(node);
 
 	outerPlanState(hjstate) = ExecInitNode(outerNode, estate, eflags);
+	hjstate->hj_OuterReader = palloc0(sizeof(ExecBatchReader));
+	hjstate->hj_OuterHashes = palloc(sizeof(uint32) * EXEC_BATCH_SIZE);
+	hjstate->hj_OuterHashable = palloc(sizeof(bool) * EXEC_BATCH_SIZE);
 	outerDesc = ExecGetResultType(outerPlanState(hjstate));
 	innerPlanState(hjstate) = ExecInitNode((Plan *) hashNode, estate, eflags);
 	innerDesc = ExecGetResultType(innerPlanState(hjstate));
@@ -896,6 +916,15 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 
 	if (curbatch == 0)			/* if it is the first pass */
 	{
+		if (hjstate->hj_RadixBuffer != NULL &&
+			hjstate->hj_RadixBuffer->npartitions > 0)
+		{
+			slot = ExecHashJoinRadixNext(outerNode, hjstate, hashvalue);
+			if (!TupIsNull(slot))
+				hjstate->hj_OuterNotEmpty = true;
+			return slot;
+		}
+
 		/*
 		 * Check to see if first outer tuple was already fetched by
 		 * ExecHashJoin() and not used yet.
@@ -904,21 +933,14 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 		if (!TupIsNull(slot))
 			hjstate->hj_FirstOuterTupleSlot = NULL;
 		else
-			slot = ExecProcNode(outerNode);
+			slot = ExecBatchReaderNext(outerNode, hjstate->hj_OuterReader);
 
 		while (!TupIsNull(slot))
 		{
 			/*
 			 * We have to compute the tuple's hash value.
 			 */
-			ExprContext *econtext = hjstate->js.ps.ps_ExprContext;
-
-			econtext->ecxt_outertuple = slot;
-			if (ExecHashGetHashValue(hashtable, econtext,
-									 hjstate->hj_OuterHashKeys,
-									 true,	/* outer tuple */
-									 HJ_FILL_OUTER(hjstate),
-									 hashvalue))
+			if (ExecHashJoinOuterHashValue(hjstate, slot, hashvalue))
 			{
 				/* remember outer relation is not empty for possible rescan */
 				hjstate->hj_OuterNotEmpty = true;
@@ -930,7 +952,7 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 			 * That tuple couldn't match because of a NULL, so discard it and
 			 * continue with the next one.
 			 */
-			slot = ExecProcNode(outerNode);
+			slot = ExecBatchReaderNext(outerNode, hjstate->hj_OuterReader);
 		}
 	}
 	else if (curbatch < hashtable->nbatch)
@@ -975,25 +997,22 @@ ExecParallelHashJoinOuterGetTuple(PlanState *outerNode,
 	 */
 	if (curbatch == 0 && hashtable->nbatch == 1)
 	{
-		slot = ExecProcNode(outerNode);
+		if (hjstate->hj_RadixBuffer != NULL &&
+			hjstate->hj_RadixBuffer->npartitions > 0)
+			return ExecHashJoinRadixNext(outerNode, hjstate, hashvalue);
+
+		slot = ExecBatchReaderNext(outerNode, hjstate->hj_OuterReader);
 
 		while (!TupIsNull(slot))
 		{
-			ExprContext *econtext = hjstate->js.ps.ps_ExprContext;
-
-			econtext->ecxt_outertuple = slot;
-			if (ExecHashGetHashValue(hashtable, econtext,
-									 hjstate->hj_OuterHashKeys,
-									 true,	/* outer tuple */
-									 HJ_FILL_OUTER(hjstate),
-									 hashvalue))
+			if (ExecHashJoinOuterHashValue(hjstate, slot, hashvalue))
 				return slot;
 
 			/*
 			 * That tuple couldn't match because of a NULL, so discard it and
 			 * continue with the next one.
 			 */
-			slot = ExecProcNode(outerNode);
+			slot = ExecBatchReaderNext(outerNode, hjstate->hj_OuterReader);
 		}
 	}
 	else if (curbatch < hashtable->nbatch)
@@ -1020,6 +1039,303 @@ ExecParallelHashJoinOuterGetTuple(PlanState *outerNode,
 	return NULL;
 }
 
+/*
+ * ExecHashJoinOuterHashValue
+ *
+ *		compute the hash value of an outer tuple just returned by
+ *		hj_OuterReader.  Returns false if the tuple can't match anything
+ *		because of a NULL key.
+ *
+ * When the outer plan returns tuples in batches, the hash values of a whole
+ * batch are computed as soon as its first tuple is looked at, so that the
+ * hash table buckets to be probed can be prefetched; see
+ * ExecHashJoinPrefetchOuterBatch().
+ */
+static bool
+ExecHashJoinOuterHashValue(HashJoinState *hjstate, TupleTableSlot *slot,
+						   uint32 *hashvalue)
+{
+	ExecBatchReader *reader = hjstate->hj_OuterReader;
+	ExprContext *econtext;
+
+	if (reader->nslots > 1)
+	{
+		int			i = reader->next - 1;
+
+		Assert(reader->slots[i] == slot);
+
+		if (i == 0)
+			ExecHashJoinPrefetchOuterBatch(hjstate);
+
+		*hashvalue = hjstate->hj_OuterHashes[i];
+		return hjstate->hj_OuterHashable[i];
+	}
+
+	econtext = hjstate->js.ps.ps_ExprContext;
+	econtext->ecxt_outertuple = slot;
+	return ExecHashGetHashValue(hjstate->hj_HashTable, econtext,
+								hjstate->hj_OuterHashKeys,
+								true,	/* outer tuple */
+								HJ_FILL_OUTER(hjstate),
+								hashvalue);
+}
+
+/*
+ * ExecHashJoinPrefetchOuterBatch
+ *
+ *		compute the hash values of all tuples in hj_OuterReader's current
+ *		batch, and prefetch the parts of the hash table they will probe.
+ *
+ * A large hash table doesn't fit into CPU caches, so probing it one tuple at
+ * a time stalls on a cache miss for the bucket, and another for the first
+ * tuple in it.  Issuing the loads for a whole batch of probes up front lets
+ * them overlap.  For a private table, we wait until the bucket headers of
+ * the whole batch are on their way before prefetching the tuples they point
+ * to; for a shared table, finding the tuple costs a DSA address translation,
+ * so only the buckets are prefetched.
+ */
+static void
+ExecHashJoinPrefetchOuterBatch(HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	ExecBatchReader *reader = hjstate->hj_OuterReader;
+	ExprContext *econtext = hjstate->js.ps.ps_ExprContext;
+	bool		parallel = hashtable->parallel_state != NULL;
+	int			bucketnos[EXEC_BATCH_SIZE];
+
+	for (int i = 0; i < reader->nslots; i++)
+	{
+		int			bucketno;
+		int			batchno;
+
+		bucketnos[i] = -1;
+
+		econtext->ecxt_outertuple = reader->slots[i];
+		hjstate->hj_OuterHashable[i] =
+			ExecHashGetHashValue(hashtable, econtext,
+								 hjstate->hj_OuterHashKeys,
+								 true,	/* outer tuple */
+								 HJ_FILL_OUTER(hjstate),
+								 &hjstate->hj_OuterHashes[i]);
+		if (!hjstate->hj_OuterHashable[i])
+			continue;
+
+		ExecHashGetBucketAndBatch(hashtable, hjstate->hj_OuterHashes[i],
+								  &bucketno, &batchno);
+		if (batchno != hashtable->curbatch)
+			continue;
+
+		if (parallel)
+			pg_prefetch_mem(&hashtable->buckets.shared[bucketno]);
+		else
+			pg_prefetch_mem(&hashtable->buckets.unshared[bucketno]);
+		bucketnos[i] = bucketno;
+	}
+
+	if (parallel)
+		return;
+
+	for (int i = 0; i < reader->nslots; i++)
+	{
+		if (bucketnos[i] >= 0)
+		{
+			HashJoinTuple tuple = hashtable->buckets.unshared[bucketnos[i]];
+
+			if (tuple != NULL)
+				pg_prefetch_mem(tuple);
+		}
+	}
+}
+
+/*
+ * ExecHashJoinRadixSetup
+ *
+ *		decide whether the hash table just built is to be probed in radix
+ *		partitions, and set up hj_RadixBuffer accordingly.  See the comments
+ *		at HJ_RADIX_MIN_TABLE_SIZE.
+ */
+static void
+ExecHashJoinRadixSetup(HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	HashJoinRadixBuffer *radix = hjstate->hj_RadixBuffer;
+	double		tablesize;
+	int			npartitions = 0;
+
+	if (hashtable->parallel_state != NULL)
+	{
+		/* we don't know the exact size of a shared table, so estimate */
+		Plan	   *innerPlan = innerPlanState(hjstate)->plan;
+
+		tablesize = hashtable->nbuckets * sizeof(dsa_pointer_atomic) +
+			hashtable->totalTuples *
+			(HJTUPLE_OVERHEAD +
+			 MAXALIGN(SizeofMinimalTupleHeader + innerPlan->plan_width));
+	}
+	else
+		tablesize = hashtable->nbuckets * sizeof(HashJoinTuple) +
+			hashtable->spaceUsed;
+
+	if (tablesize >= HJ_RADIX_MIN_TABLE_SIZE)
+	{
+		double		dpartitions = tablesize / HJ_RADIX_PARTITION_SIZE;
+
+		dpartitions = Min(dpartitions, HJ_RADIX_MAX_PARTITIONS);
+		npartitions = pg_nextpower2_32((uint32) dpartitions);
+		npartitions = Min(npartitions, HJ_RADIX_MAX_PARTITIONS);
+		npartitions = Min(npartitions, hashtable->nbuckets);
+	}
+
+	if (npartitions <= 1)
+	{
+		if (radix != NULL)
+			radix->npartitions = 0;
+		return;
+	}
+
+	if (radix == NULL)
+	{
+		MemoryContext cxt = hjstate->js.ps.state->es_query_cxt;
+
+		radix = MemoryContextAllocZero(cxt, sizeof(HashJoinRadixBuffer));
+		radix->cxt = AllocSetContextCreate(cxt,
+										   "HashJoin radix buffer",
+										   ALLOCSET_DEFAULT_SIZES);
+		radix->maxtuples = 1024;
+		radix->tuples = MemoryContextAlloc(cxt,
+										   sizeof(MinimalTuple) * radix->maxtuples);
+		radix->hashvalues = MemoryContextAlloc(cxt,
+											   sizeof(uint32) * radix->maxtuples);
+		radix->order = MemoryContextAlloc(cxt,
+										  sizeof(int) * radix->maxtuples);
+		radix->partstart = MemoryContextAlloc(cxt,
+											  sizeof(int) * (HJ_RADIX_MAX_PARTITIONS + 1));
+		hjstate->hj_RadixBuffer = radix;
+	}
+	else
+		MemoryContextReset(radix->cxt);
+
+	radix->npartitions = npartitions;
+	radix->partshift = hashtable->log2_nbuckets - pg_leftmost_one_pos32(npartitions);
+	radix->ntuples = 0;
+	radix->next = 0;
+	radix->exhausted = false;
+}
+
+/*
+ * ExecHashJoinRadixNext
+ *
+ *		get the next outer tuple to probe the hash table with, in radix
+ *		partition order.  Returns NULL at the end of the outer relation.
+ */
+static TupleTableSlot *
+ExecHashJoinRadixNext(PlanState *outerNode, HashJoinState *hjstate,
+					  uint32 *hashvalue)
+{
+	HashJoinRadixBuffer *radix = hjstate->hj_RadixBuffer;
+	int			i;
+
+	if (radix->next >= radix->ntuples)
+	{
+		if (radix->exhausted)
+			return NULL;
+
+		ExecHashJoinRadixFill(outerNode, hjstate);
+		if (radix->ntuples == 0)
+			return NULL;
+	}
+
+	i = radix->order[radix->next++];
+	*hashvalue = radix->hashvalues[i];
+	ExecForceStoreMinimalTuple(radix->tuples[i], hjstate->hj_OuterTupleSlot,
+							   false);
+	return hjstate->hj_OuterTupleSlot;
+}
+
+/*
+ * ExecHashJoinRadixFill
+ *
+ *		read up to work_mem worth of outer tuples into hj_RadixBuffer, and
+ *		sort them by partition.
+ *
+ * Tuples that can't match because of a NULL key are discarded here, just
+ * like ExecHashJoinOuterGetTuple() would.
+ */
+static void
+ExecHashJoinRadixFill(PlanState *outerNode, HashJoinState *hjstate)
+{
+	HashJoinRadixBuffer *radix = hjstate->hj_RadixBuffer;
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	Size		limit = (Size) work_mem * 1024;
+	Size		used = 0;
+	int		   *partstart = radix->partstart;
+
+	MemoryContextReset(radix->cxt);
+	radix->ntuples = 0;
+	radix->next = 0;
+
+	while (used < limit)
+	{
+		TupleTableSlot *slot;
+		uint32		hashvalue;
+		MemoryContext oldcxt;
+		MinimalTuple tuple;
+
+		slot = hjstate->hj_FirstOuterTupleSlot;
+		if (!TupIsNull(slot))
+			hjstate->hj_FirstOuterTupleSlot = NULL;
+		else
+			slot = ExecBatchReaderNext(outerNode, hjstate->hj_OuterReader);
+
+		if (TupIsNull(slot))
+		{
+			radix->exhausted = true;
+			break;
+		}
+
+		if (!ExecHashJoinOuterHashValue(hjstate, slot, &hashvalue))
+			continue;
+
+		if (radix->ntuples >= radix->maxtuples)
+		{
+			radix->maxtuples *= 2;
+			radix->tuples = repalloc_huge(radix->tuples,
+										  sizeof(MinimalTuple) * radix->maxtuples);
+			radix->hashvalues = repalloc_huge(radix->hashvalues,
+											  sizeof(uint32) * radix->maxtuples);
+			radix->order = repalloc_huge(radix->order,
+										 sizeof(int) * radix->maxtuples);
+		}
+
+		oldcxt = MemoryContextSwitchTo(radix->cxt);
+		tuple = ExecCopySlotMinimalTuple(slot);
+		MemoryContextSwitchTo(oldcxt);
+
+		radix->tuples[radix->ntuples] = tuple;
+		radix->hashvalues[radix->ntuples] = hashvalue;
+		radix->ntuples++;
+		used += GetMemoryChunkSpace(tuple) +
+			sizeof(MinimalTuple) + sizeof(uint32) + sizeof(int);
+	}
+
+	/* counting sort of the tuples by partition */
+	memset(partstart, 0, sizeof(int) * (radix->npartitions + 1));
+	for (int i = 0; i < radix->ntuples; i++)
+	{
+		int			bucketno = radix->hashvalues[i] & (hashtable->nbuckets - 1);
+
+		partstart[(bucketno >> radix->partshift) + 1]++;
+	}
+	for (int p = 0; p < radix->npartitions; p++)
+		partstart[p + 1] += partstart[p];
+	for (int i = 0; i < radix->ntuples; i++)
+	{
+		int			bucketno = radix->hashvalues[i] & (hashtable->nbuckets - 1);
+
+		radix->order[partstart[bucketno >> radix->partshift]++] = i;
+	}
+}
+
 /*
  * ExecHashJoinNewBatch
  *		switch to a new hashjoin batch
@@ -1334,7 +1650,7 @@ ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
 	{
 		MemoryContext oldctx = MemoryContextSwitchTo(hashtable->spillCxt);
 
-		file = BufFileCreateTemp(false);
+		file = BufFileCreateCompressTemp(false);
 		*fileptr = file;
 
 		MemoryContextSwitchTo(oldctx);
@@ -1469,6 +1785,14 @@ ExecReScanHashJoin(HashJoinState *node)
 
 	node->hj_MatchedOuter = false;
 	node->hj_FirstOuterTupleSlot = NULL;
+	ExecBatchReaderReset(node->hj_OuterReader);
+	if (node->hj_RadixBuffer != NULL)
+	{
+		MemoryContextReset(node->hj_RadixBuffer->cxt);
+		node->hj_RadixBuffer->ntuples = 0;
+		node->hj_RadixBuffer->next = 0;
+		node->hj_RadixBuffer->exhausted = false;
+	}
 
 	/*
 	 * if chgParam of subnode is not null then plan will be re-scanned by
@@ -1508,7 +1832,7 @@ ExecParallelHashJoinPartitionOuter(HashJoinState *hjstate)
 	/* Execute outer plan, writing all tuples to shared tuplestores. */
 	for (;;)
 	{
-		slot = ExecProcNode(outerState);
+		slot = ExecBatchReaderNext(outerState, hjstate->hj_OuterReader);
 		if (TupIsNull(slot))
 			break;
 		econtext->ecxt_outertuple = slot;
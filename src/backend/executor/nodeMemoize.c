@@ -50,6 +50,20 @@
  * demanding, then that may allow us to start putting useful entries back into
  * the cache again.
  *
+ * In a parallel query, each participant runs its own copy of the node and
+ * would otherwise fill its own cache with largely the same entries.  When
+ * the planner asks for it, the participants also share a cache in dynamic
+ * shared memory.  Every cache entry that a participant completes by reading
+ * its subplan is published there, and a participant that misses in its local
+ * cache looks in the shared cache before rescanning the subplan.  Shared
+ * entries are immutable once published; a reader copies a whole entry into
+ * its local cache while holding the lock on the entry's bucket.  The shared
+ * cache has a memory budget of its own and evicts entries using a clock
+ * sweep over its buckets, which approximates LRU without requiring a list
+ * that all participants would have to update on every hit.  The shared
+ * cache is only used when the subplan depends on no parameters other than
+ * the cache keys, so that its entries never have to be invalidated.
+ *
  *
  * INTERFACE ROUTINES
  *		ExecMemoize			- lookup cache, exec subplan when not found
@@ -71,7 +85,11 @@
 #include "executor/nodeMemoize.h"
 #include "lib/ilist.h"
 #include "miscadmin.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+#include "storage/lwlock.h"
 #include "utils/datum.h"
+#include "utils/dsa.h"
 #include "utils/lsyscache.h"
 
 /* States of the ExecMemoize state machine */
@@ -90,6 +108,11 @@
 #define CACHE_TUPLE_BYTES(t)			(sizeof(MemoizeTuple) + \
 										 (t)->mintuple->t_len)
 
+/* Number of locks protecting the buckets of a shared cache */
+#define MEMOIZE_SHARED_LOCKS		32
+/* Upper limit on the number of buckets in a shared cache */
+#define MEMOIZE_SHARED_MAX_BUCKETS	(1 << 20)
+
  /* MemoizeTuple Stores an individually cached tuple */
 typedef struct MemoizeTuple
 {
@@ -123,6 +146,44 @@ typedef struct MemoizeEntry
 } MemoizeEntry;
 
 
+/*
+ * MemoizeSharedEntry
+ *		A complete cache entry in a shared cache
+ *
+ * Each entry is a single DSA allocation.  The header is followed by the key
+ * tuple and then by the cached tuples, each starting at a MAXALIGN'd offset.
+ */
+typedef struct MemoizeSharedEntry
+{
+	dsa_pointer next;			/* next entry in the same bucket */
+	uint32		hash;			/* hash value of the key */
+	uint32		ntuples;		/* number of cached tuples */
+	pg_atomic_uint32 referenced;	/* clock sweep reference bit */
+	Size		size;			/* size of the whole allocation */
+} MemoizeSharedEntry;
+
+/*
+ * MemoizeSharedCache
+ *		The control structure of a shared cache, in the parallel query's DSM
+ *		segment
+ *
+ * Each bucket is a list of entries linked by their 'next' pointers.  Bucket
+ * b is protected by locks[b % MEMOIZE_SHARED_LOCKS].
+ */
+typedef struct MemoizeSharedCache
+{
+	uint32		nbuckets;		/* number of buckets, a power of 2 */
+	pg_atomic_uint32 clock_hand;	/* next bucket for the clock sweep */
+	pg_atomic_uint64 mem_used;	/* bytes used by entries */
+	uint64		mem_limit;		/* memory budget for entries */
+	LWLock		locks[MEMOIZE_SHARED_LOCKS];
+	dsa_pointer buckets[FLEXIBLE_ARRAY_MEMBER];
+} MemoizeSharedCache;
+
+#define SharedEntryKey(e) \
+	((MinimalTuple) ((char *) (e) + MAXALIGN(sizeof(MemoizeSharedEntry))))
+
+
 #define SH_PREFIX memoize
 #define SH_ELEMENT_TYPE MemoizeEntry
 #define SH_KEY_TYPE MemoizeKey *
@@ -135,6 +196,7 @@ static uint32 MemoizeHash_hash(struct memoize_hash *tb,
 static bool MemoizeHash_equal(struct memoize_hash *tb,
 							  const MemoizeKey *key1,
 							  const MemoizeKey *key2);
+static bool memoize_key_equal(MemoizeState *mstate, MinimalTuple params);
 
 #define SH_PREFIX memoize
 #define SH_ELEMENT_TYPE MemoizeEntry
@@ -222,12 +284,23 @@ MemoizeHash_equal(struct memoize_hash *tb, const MemoizeKey *key1,
 				  const MemoizeKey *key2)
 {
 	MemoizeState *mstate = (MemoizeState *) tb->private_data;
+
+	return memoize_key_equal(mstate, key1->params);
+}
+
+/*
+ * memoize_key_equal
+ *		Does the key tuple 'params' match the values in mstate's probeslot?
+ */
+static bool
+memoize_key_equal(MemoizeState *mstate, MinimalTuple params)
+{
 	ExprContext *econtext = mstate->ss.ps.ps_ExprContext;
 	TupleTableSlot *tslot = mstate->tableslot;
 	TupleTableSlot *pslot = mstate->probeslot;
 
 	/* probeslot should have already been prepared by prepare_probe_slot() */
-	ExecStoreMinimalTuple(key1->params, tslot, false);
+	ExecStoreMinimalTuple(params, tslot, false);
 
 	if (mstate->binary_mode)
 	{
@@ -693,6 +766,252 @@ cache_store_tuple(MemoizeState *mstate, TupleTableSlot *slot)
 	return true;
 }
 
+/*
+ * shared_cache_size
+ *		Size of a shared cache's control structure with 'nbuckets' buckets
+ */
+static Size
+shared_cache_size(uint32 nbuckets)
+{
+	return add_size(offsetof(MemoizeSharedCache, buckets),
+					mul_size(nbuckets, sizeof(dsa_pointer)));
+}
+
+/*
+ * shared_cache_usable
+ *		Can this node use a cache shared with other parallel participants?
+ *
+ * The planner asks for a shared cache, but we only use one if the results
+ * of the subplan depend on nothing but the cache keys.  A local cache is
+ * purged when another parameter changes (see ExecReScanMemoize), but we have
+ * no way to coordinate that across participants.
+ */
+static bool
+shared_cache_usable(MemoizeState *mstate)
+{
+	Memoize    *node = (Memoize *) mstate->ss.ps.plan;
+
+	return node->shared_cache &&
+		bms_is_subset(outerPlan(node)->extParam, mstate->keyparamids);
+}
+
+/*
+ * shared_cache_evict
+ *		Run the clock sweep until the shared cache has room for 'needed' more
+ *		bytes, or until we've swept every bucket twice.
+ *
+ * An entry that was looked up since the sweep last passed its bucket gets
+ * its reference bit cleared; otherwise it is removed.  Returns true if there
+ * is room now.
+ */
+static bool
+shared_cache_evict(MemoizeState *mstate, Size needed)
+{
+	MemoizeSharedCache *cache = mstate->shared_cache;
+	uint32		mask = cache->nbuckets - 1;
+	uint64		evictions = 0;
+
+	for (uint32 steps = 0; steps < 2 * cache->nbuckets; steps++)
+	{
+		uint32		bucketno;
+		LWLock	   *lock;
+		dsa_pointer *prevp;
+		dsa_pointer dp;
+
+		if (pg_atomic_read_u64(&cache->mem_used) + needed <= cache->mem_limit)
+			break;
+
+		bucketno = pg_atomic_fetch_add_u32(&cache->clock_hand, 1) & mask;
+		lock = &cache->locks[bucketno % MEMOIZE_SHARED_LOCKS];
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		prevp = &cache->buckets[bucketno];
+		dp = *prevp;
+		while (DsaPointerIsValid(dp))
+		{
+			MemoizeSharedEntry *sentry = dsa_get_address(mstate->area, dp);
+			dsa_pointer next = sentry->next;
+
+			if (pg_atomic_read_u32(&sentry->referenced) != 0)
+			{
+				pg_atomic_write_u32(&sentry->referenced, 0);
+				prevp = &sentry->next;
+			}
+			else
+			{
+				*prevp = next;
+				pg_atomic_fetch_sub_u64(&cache->mem_used, sentry->size);
+				dsa_free(mstate->area, dp);
+				evictions++;
+			}
+			dp = next;
+		}
+		LWLockRelease(lock);
+	}
+
+	mstate->stats.cache_evictions += evictions; /* Update Stats */
+
+	return pg_atomic_read_u64(&cache->mem_used) + needed <= cache->mem_limit;
+}
+
+/*
+ * shared_cache_fetch
+ *		Try to fill the empty local cache entry 'entry' from the shared cache.
+ *
+ * Returns the local entry, which is marked complete if the shared cache had
+ * it, or NULL if we ran out of local cache memory while copying it, in which
+ * case the local entry is gone.
+ */
+static MemoizeEntry *
+shared_cache_fetch(MemoizeState *mstate, MemoizeEntry *entry)
+{
+	MemoizeSharedCache *cache = mstate->shared_cache;
+	uint32		bucketno = entry->hash & (cache->nbuckets - 1);
+	LWLock	   *lock = &cache->locks[bucketno % MEMOIZE_SHARED_LOCKS];
+	TupleTableSlot *slot = mstate->ss.ss_ScanTupleSlot;
+	MemoizeSharedEntry *copy = NULL;
+	dsa_pointer dp;
+	char	   *ptr;
+
+	Assert(entry->tuplehead == NULL && !entry->complete);
+
+	/* cache evictions may have left some other key in the probeslot */
+	prepare_probe_slot(mstate, entry->key);
+
+	LWLockAcquire(lock, LW_SHARED);
+	for (dp = cache->buckets[bucketno]; DsaPointerIsValid(dp);)
+	{
+		MemoizeSharedEntry *sentry = dsa_get_address(mstate->area, dp);
+
+		if (sentry->hash == entry->hash &&
+			memoize_key_equal(mstate, SharedEntryKey(sentry)))
+		{
+			pg_atomic_write_u32(&sentry->referenced, 1);
+			copy = palloc_extended(sentry->size, MCXT_ALLOC_HUGE);
+			memcpy(copy, sentry, sentry->size);
+			break;
+		}
+		dp = sentry->next;
+	}
+	LWLockRelease(lock);
+
+	if (copy == NULL)
+		return entry;
+
+	/* Copy the tuples into the local entry */
+	mstate->entry = entry;
+	mstate->last_tuple = NULL;
+	ptr = (char *) SharedEntryKey(copy) + MAXALIGN(SharedEntryKey(copy)->t_len);
+	for (uint32 i = 0; i < copy->ntuples; i++)
+	{
+		MinimalTuple mintuple = (MinimalTuple) ptr;
+
+		ExecStoreMinimalTuple(mintuple, slot, false);
+		if (!cache_store_tuple(mstate, slot))
+		{
+			/* our local entry was evicted to make room for its own tuples */
+			ExecClearTuple(slot);
+			pfree(copy);
+			mstate->entry = NULL;
+			mstate->last_tuple = NULL;
+			return NULL;
+		}
+		ptr += MAXALIGN(mintuple->t_len);
+	}
+	ExecClearTuple(slot);
+	pfree(copy);
+
+	/* cache_store_tuple may have moved the entry */
+	entry = mstate->entry;
+	entry->complete = true;
+	mstate->entry = NULL;
+	mstate->last_tuple = NULL;
+
+	return entry;
+}
+
+/*
+ * shared_cache_store
+ *		Publish the complete local cache entry 'entry' in the shared cache.
+ *
+ * Failure to find room for it is not an error; the entry simply stays local.
+ */
+static void
+shared_cache_store(MemoizeState *mstate, MemoizeEntry *entry)
+{
+	MemoizeSharedCache *cache = mstate->shared_cache;
+	uint32		bucketno = entry->hash & (cache->nbuckets - 1);
+	LWLock	   *lock = &cache->locks[bucketno % MEMOIZE_SHARED_LOCKS];
+	MemoizeSharedEntry *sentry;
+	MinimalTuple key = entry->key->params;
+	MemoizeTuple *tuple;
+	uint32		ntuples = 0;
+	Size		size;
+	dsa_pointer newdp;
+	dsa_pointer dp;
+	char	   *ptr;
+
+	Assert(entry->complete);
+
+	size = MAXALIGN(sizeof(MemoizeSharedEntry)) + MAXALIGN(key->t_len);
+	for (tuple = entry->tuplehead; tuple != NULL; tuple = tuple->next)
+	{
+		size += MAXALIGN(tuple->mintuple->t_len);
+		ntuples++;
+	}
+
+	if (size > cache->mem_limit || !shared_cache_evict(mstate, size))
+		return;
+
+	newdp = dsa_allocate_extended(mstate->area, size,
+								  DSA_ALLOC_NO_OOM | DSA_ALLOC_HUGE);
+	if (!DsaPointerIsValid(newdp))
+		return;
+	pg_atomic_fetch_add_u64(&cache->mem_used, size);
+
+	/* Fill in the new entry; nobody else can see it yet */
+	sentry = dsa_get_address(mstate->area, newdp);
+	sentry->hash = entry->hash;
+	sentry->ntuples = ntuples;
+	pg_atomic_init_u32(&sentry->referenced, 1);
+	sentry->size = size;
+	ptr = (char *) SharedEntryKey(sentry);
+	memcpy(ptr, key, key->t_len);
+	ptr += MAXALIGN(key->t_len);
+	for (tuple = entry->tuplehead; tuple != NULL; tuple = tuple->next)
+	{
+		memcpy(ptr, tuple->mintuple, tuple->mintuple->t_len);
+		ptr += MAXALIGN(tuple->mintuple->t_len);
+	}
+
+	prepare_probe_slot(mstate, entry->key);
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+
+	/* Another participant may have published the same key meanwhile */
+	for (dp = cache->buckets[bucketno]; DsaPointerIsValid(dp);)
+	{
+		MemoizeSharedEntry *other = dsa_get_address(mstate->area, dp);
+
+		if (other->hash == entry->hash &&
+			memoize_key_equal(mstate, SharedEntryKey(other)))
+			break;
+		dp = other->next;
+	}
+
+	if (DsaPointerIsValid(dp))
+	{
+		LWLockRelease(lock);
+		pg_atomic_fetch_sub_u64(&cache->mem_used, size);
+		dsa_free(mstate->area, newdp);
+		return;
+	}
+
+	sentry->next = cache->buckets[bucketno];
+	cache->buckets[bucketno] = newdp;
+	LWLockRelease(lock);
+}
+
 static TupleTableSlot *
 ExecMemoize(PlanState *pstate)
 {
@@ -739,6 +1058,16 @@ ExecMemoize(PlanState *pstate)
 				/* see if we've got anything cached for the current parameters */
 				entry = cache_lookup(node, &found);
 
+				/* On a local miss, try the shared cache, if any */
+				if (node->shared_cache != NULL && entry != NULL &&
+					!(found && entry->complete))
+				{
+					if (found)
+						entry_purge_tuples(node, entry);
+					entry = shared_cache_fetch(node, entry);
+					found = (entry != NULL && entry->complete);
+				}
+
 				if (found && entry->complete)
 				{
 					node->stats.cache_hits += 1;	/* stats update */
@@ -797,7 +1126,11 @@ ExecMemoize(PlanState *pstate)
 					 * scan.
 					 */
 					if (likely(entry))
+					{
 						entry->complete = true;
+						if (node->shared_cache != NULL)
+							shared_cache_store(node, entry);
+					}
 
 					node->mstatus = MEMO_END_OF_SCAN;
 					return NULL;
@@ -827,9 +1160,12 @@ ExecMemoize(PlanState *pstate)
 					 * If we only expect a single row from this scan then we
 					 * can mark that we're not expecting more.  This allows
 					 * cache lookups to work even when the scan has not been
-					 * executed to completion.
+					 * executed to completion.  Storing the tuple may have
+					 * moved the entry, so go through node->entry.
 					 */
-					entry->complete = node->singlerow;
+					node->entry->complete = node->singlerow;
+					if (node->singlerow && node->shared_cache != NULL)
+						shared_cache_store(node, node->entry);
 					node->mstatus = MEMO_FILLING_CACHE;
 				}
 
@@ -880,6 +1216,8 @@ ExecMemoize(PlanState *pstate)
 				{
 					/* No more tuples.  Mark it as complete */
 					entry->complete = true;
+					if (node->shared_cache != NULL)
+						shared_cache_store(node, entry);
 					node->mstatus = MEMO_END_OF_SCAN;
 					return NULL;
 				}
@@ -1180,23 +1518,63 @@ ExecEstimateCacheEntryOverheadBytes(double ntuples)
  * ----------------------------------------------------------------
  */
 
+/*
+ * shared_cache_nbuckets
+ *		Choose the number of buckets for a shared cache
+ */
+static uint32
+shared_cache_nbuckets(MemoizeState *node, int nworkers)
+{
+	uint64		nentries = ((Memoize *) node->ss.ps.plan)->est_entries;
+
+	/* Make a guess at a good size when we're not given a valid size. */
+	if (nentries == 0)
+		nentries = 1024;
+
+	/* Each participant's share of the budget holds nentries entries */
+	nentries *= nworkers + 1;
+	nentries = Max(nentries, MEMOIZE_SHARED_LOCKS);
+	nentries = Min(nentries, MEMOIZE_SHARED_MAX_BUCKETS);
+
+	return pg_nextpower2_32((uint32) nentries);
+}
+
+/*
+ * shared_info_size
+ *		Size of the SharedMemoizeInfo for 'nworkers' workers
+ */
+static Size
+shared_info_size(int nworkers)
+{
+	return add_size(offsetof(SharedMemoizeInfo, sinstrument),
+					mul_size(nworkers, sizeof(MemoizeInstrumentation)));
+}
+
  /* ----------------------------------------------------------------
   *		ExecMemoizeEstimate
   *
-  *		Estimate space required to propagate memoize statistics.
+  *		Estimate space required for a shared cache and to propagate
+  *		memoize statistics.
   * ----------------------------------------------------------------
   */
 void
 ExecMemoizeEstimate(MemoizeState *node, ParallelContext *pcxt)
 {
-	Size		size;
+	Size		size = 0;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need this if no workers */
+	if (pcxt->nworkers == 0)
+		return;
+
+	if (shared_cache_usable(node))
+		size = MAXALIGN(shared_cache_size(shared_cache_nbuckets(node,
+																pcxt->nworkers)));
+	if (node->ss.ps.instrument)
+		size = add_size(size, shared_info_size(pcxt->nworkers));
+
+	if (size == 0)
 		return;
 
-	size = mul_size(pcxt->nworkers, sizeof(MemoizeInstrumentation));
-	size = add_size(size, offsetof(SharedMemoizeInfo, sinstrument));
 	shm_toc_estimate_chunk(&pcxt->estimator, size);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 }
@@ -1204,39 +1582,93 @@ ExecMemoizeEstimate(MemoizeState *node, ParallelContext *pcxt)
 /* ----------------------------------------------------------------
  *		ExecMemoizeInitializeDSM
  *
- *		Initialize DSM space for memoize statistics.
+ *		Initialize DSM space for a shared cache and memoize statistics.
  * ----------------------------------------------------------------
  */
 void
 ExecMemoizeInitializeDSM(MemoizeState *node, ParallelContext *pcxt)
 {
+	Size		cache_size = 0;
 	Size		size;
+	uint32		nbuckets = 0;
+	char	   *space;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need this if no workers */
+	if (pcxt->nworkers == 0)
 		return;
 
-	size = offsetof(SharedMemoizeInfo, sinstrument)
-		+ pcxt->nworkers * sizeof(MemoizeInstrumentation);
-	node->shared_info = shm_toc_allocate(pcxt->toc, size);
-	/* ensure any unfilled slots will contain zeroes */
-	memset(node->shared_info, 0, size);
-	node->shared_info->num_workers = pcxt->nworkers;
-	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id,
-				   node->shared_info);
+	if (shared_cache_usable(node))
+	{
+		nbuckets = shared_cache_nbuckets(node, pcxt->nworkers);
+		cache_size = MAXALIGN(shared_cache_size(nbuckets));
+	}
+
+	size = cache_size;
+	if (node->ss.ps.instrument)
+		size = add_size(size, shared_info_size(pcxt->nworkers));
+
+	if (size == 0)
+		return;
+
+	space = shm_toc_allocate(pcxt->toc, size);
+
+	if (cache_size > 0)
+	{
+		MemoizeSharedCache *cache = (MemoizeSharedCache *) space;
+
+		cache->nbuckets = nbuckets;
+		pg_atomic_init_u32(&cache->clock_hand, 0);
+		pg_atomic_init_u64(&cache->mem_used, 0);
+		cache->mem_limit = (uint64) get_hash_memory_limit() *
+			(pcxt->nworkers + 1);
+		for (int i = 0; i < MEMOIZE_SHARED_LOCKS; i++)
+			LWLockInitialize(&cache->locks[i], LWTRANCHE_PARALLEL_MEMOIZE);
+		for (uint32 i = 0; i < nbuckets; i++)
+			cache->buckets[i] = InvalidDsaPointer;
+
+		node->shared_cache = cache;
+		node->area = node->ss.ps.state->es_query_dsa;
+	}
+
+	if (node->ss.ps.instrument)
+	{
+		node->shared_info = (SharedMemoizeInfo *) (space + cache_size);
+		/* ensure any unfilled slots will contain zeroes */
+		memset(node->shared_info, 0, shared_info_size(pcxt->nworkers));
+		node->shared_info->num_workers = pcxt->nworkers;
+	}
+
+	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, space);
 }
 
 /* ----------------------------------------------------------------
  *		ExecMemoizeInitializeWorker
  *
- *		Attach worker to DSM space for memoize statistics.
+ *		Attach worker to DSM space for a shared cache and memoize
+ *		statistics.
  * ----------------------------------------------------------------
  */
 void
 ExecMemoizeInitializeWorker(MemoizeState *node, ParallelWorkerContext *pwcxt)
 {
-	node->shared_info =
-		shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	char	   *space;
+	Size		cache_size = 0;
+
+	space = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	if (space == NULL)
+		return;
+
+	if (shared_cache_usable(node))
+	{
+		MemoizeSharedCache *cache = (MemoizeSharedCache *) space;
+
+		cache_size = MAXALIGN(shared_cache_size(cache->nbuckets));
+		node->shared_cache = cache;
+		node->area = node->ss.ps.state->es_query_dsa;
+	}
+
+	if (node->ss.ps.instrument)
+		node->shared_info = (SharedMemoizeInfo *) (space + cache_size);
 }
 
 /* ----------------------------------------------------------------
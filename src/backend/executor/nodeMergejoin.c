@@ -114,6 +114,19 @@
 #define EXEC_MJ_ENDOUTER				10
 #define EXEC_MJ_ENDINNER				11
 
+/*
+ * How MJCompare compares the values of a mergejoin clause.  Most integer
+ * and integer-like types get comparators that merely compare the Datums,
+ * which MJCompare can do inline instead of calling through ssup.
+ */
+typedef enum
+{
+	MJ_COMPARE_GENERIC,			/* call the SortSupport comparator */
+	MJ_COMPARE_INT32,			/* like ssup_datum_int32_cmp */
+	MJ_COMPARE_SIGNED,			/* like ssup_datum_signed_cmp */
+	MJ_COMPARE_UNSIGNED,		/* like ssup_datum_unsigned_cmp */
+} MJCompareKind;
+
 /*
  * Runtime data for each mergejoin clause
  */
@@ -137,6 +150,7 @@ typedef struct MergeJoinClauseData
 	 * stored here.
 	 */
 	SortSupportData ssup;
+	MJCompareKind cmpkind;		/* how to apply ssup */
 }			MergeJoinClauseData;
 
 /* Result type for MJEvalOuterValues and MJEvalInnerValues */
@@ -262,6 +276,17 @@ MJExamineQuals(List *mergeclauses,
 			PrepareSortSupportComparisonShim(sortfunc, &clause->ssup);
 		}
 
+		if (clause->ssup.comparator == ssup_datum_int32_cmp)
+			clause->cmpkind = MJ_COMPARE_INT32;
+#if SIZEOF_DATUM >= 8
+		else if (clause->ssup.comparator == ssup_datum_signed_cmp)
+			clause->cmpkind = MJ_COMPARE_SIGNED;
+#endif
+		else if (clause->ssup.comparator == ssup_datum_unsigned_cmp)
+			clause->cmpkind = MJ_COMPARE_UNSIGNED;
+		else
+			clause->cmpkind = MJ_COMPARE_GENERIC;
+
 		iClause++;
 	}
 
@@ -417,9 +442,37 @@ MJCompare(MergeJoinState *mergestate)
 			continue;
 		}
 
-		result = ApplySortComparator(clause->ldatum, clause->lisnull,
-									 clause->rdatum, clause->risnull,
-									 &clause->ssup);
+		switch (clause->cmpkind)
+		{
+			case MJ_COMPARE_INT32:
+				result = ApplyInt32SortComparator(clause->ldatum,
+												  clause->lisnull,
+												  clause->rdatum,
+												  clause->risnull,
+												  &clause->ssup);
+				break;
+#if SIZEOF_DATUM >= 8
+			case MJ_COMPARE_SIGNED:
+				result = ApplySignedSortComparator(clause->ldatum,
+												   clause->lisnull,
+												   clause->rdatum,
+												   clause->risnull,
+												   &clause->ssup);
+				break;
+#endif
+			case MJ_COMPARE_UNSIGNED:
+				result = ApplyUnsignedSortComparator(clause->ldatum,
+													 clause->lisnull,
+													 clause->rdatum,
+													 clause->risnull,
+													 &clause->ssup);
+				break;
+			default:
+				result = ApplySortComparator(clause->ldatum, clause->lisnull,
+											 clause->rdatum, clause->risnull,
+											 &clause->ssup);
+				break;
+		}
 
 		if (result != 0)
 			break;
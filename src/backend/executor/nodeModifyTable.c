@@ -1973,6 +1973,8 @@ ExecUpdateAct(ModifyTableContext *context, ResultRelInfo *resultRelInfo,
 {
 	EState	   *estate = context->estate;
 	Relation	resultRelationDesc = resultRelInfo->ri_RelationDesc;
+	TupleTableSlot *oldSlot = resultRelInfo->ri_oldTupleSlot;
+	Bitmapset  *unindexed_attrs = NULL;
 	bool		partition_constraint_failed;
 	TM_Result	result;
 
@@ -2091,6 +2093,16 @@ lreplace:
 	if (resultRelationDesc->rd_att->constr)
 		ExecConstraints(resultRelInfo, slot, estate);
 
+	/*
+	 * If we have the version of the row that we're replacing at hand, let
+	 * the table AM know which columns no index cares about this time.
+	 */
+	if (resultRelInfo->ri_NumIndices > 0 && tupleid != NULL &&
+		oldSlot != NULL && !TTS_EMPTY(oldSlot) &&
+		ItemPointerEquals(&oldSlot->tts_tid, tupleid))
+		unindexed_attrs = ExecGetUnindexedAttrs(resultRelInfo, oldSlot, slot,
+												estate);
+
 	/*
 	 * replace the heap tuple
 	 *
@@ -2105,6 +2117,7 @@ lreplace:
 								estate->es_snapshot,
 								estate->es_crosscheck_snapshot,
 								true /* wait for commit */ ,
+								unindexed_attrs,
 								&context->tmfd, &updateCxt->lockmode,
 								&updateCxt->updateIndexes);
 
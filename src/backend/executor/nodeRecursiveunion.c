@@ -6,6 +6,17 @@
  * To implement UNION (without ALL), we need a hashtable that stores tuples
  * already seen.  The hash key is computed from the grouping columns.
  *
+ * A recursive query can produce far more distinct tuples than fit in
+ * hash_mem.  When the hashtable outgrows it, we switch to checking for
+ * duplicates in batches: the tuples seen so far are written out to one
+ * tuplestore per hash partition, and new tuples are held back in
+ * per-partition tuplestores as well until the term producing them is
+ * exhausted.  Then each partition's seen tuples are loaded into the
+ * (emptied) hashtable in turn, and its held-back tuples that are not found
+ * there are the new ones.  Only then are those returned and added to the
+ * working table, so the first tuples of each batch come out later than they
+ * would otherwise, but the results are the same.
+ *
  *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -23,6 +34,12 @@
 #include "miscadmin.h"
 #include "utils/memutils.h"
 
+/* number of partitions the seen tuples are divided into after spilling */
+#define RU_SPILL_PARTITION_BITS		5
+#define RU_SPILL_PARTITIONS			(1 << RU_SPILL_PARTITION_BITS)
+
+/* use the high bits of the hash, since the hashtable uses the low ones */
+#define RU_SPILL_PARTITION(hash)	((hash) >> (32 - RU_SPILL_PARTITION_BITS))
 
 
 /*
@@ -52,6 +69,156 @@ build_hash_table(RecursiveUnionState *rustate)
 												false);
 }
 
+/*
+ * Move all tuples in the hashtable to the per-partition tuplestores, and
+ * check for duplicates in batches from now on.
+ */
+static void
+spill_hash_table(RecursiveUnionState *rustate)
+{
+	TupleHashIterator iter;
+	TupleHashEntry entry;
+	int			i;
+
+	if (rustate->spill_seen == NULL)
+	{
+		int			maxKBytes = Max(work_mem / RU_SPILL_PARTITIONS, 64);
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(rustate->ps.state->es_query_cxt);
+		rustate->spill_seen = palloc_array(Tuplestorestate *,
+										   RU_SPILL_PARTITIONS);
+		rustate->spill_new = palloc_array(Tuplestorestate *,
+										  RU_SPILL_PARTITIONS);
+		for (i = 0; i < RU_SPILL_PARTITIONS; i++)
+		{
+			rustate->spill_seen[i] = tuplestore_begin_heap(false, false,
+														   maxKBytes);
+			rustate->spill_new[i] = tuplestore_begin_heap(false, false,
+														  maxKBytes);
+		}
+		rustate->spill_output = tuplestore_begin_heap(false, false, work_mem);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	InitTupleHashIterator(rustate->hashtable, &iter);
+	while ((entry = ScanTupleHashTable(rustate->hashtable, &iter)) != NULL)
+	{
+		ExecStoreMinimalTuple(entry->firstTuple, rustate->spill_slot, false);
+		tuplestore_puttupleslot(rustate->spill_seen[RU_SPILL_PARTITION(entry->hash)],
+								rustate->spill_slot);
+	}
+	TermTupleHashIterator(&iter);
+	ExecClearTuple(rustate->spill_slot);
+
+	ResetTupleHashTable(rustate->hashtable);
+	MemoryContextReset(rustate->tableContext);
+
+	rustate->spilled = true;
+}
+
+/*
+ * Check whether a tuple has not been seen yet.
+ *
+ * Returns true if the tuple is new and is to be returned right away.  After
+ * spilling, the tuple is held back instead, and false is returned.
+ */
+static bool
+lookup_tuple(RecursiveUnionState *rustate, TupleTableSlot *slot)
+{
+	bool		isnew;
+
+	if (rustate->spilled)
+	{
+		uint32		hash = TupleHashTableHash(rustate->hashtable, slot);
+
+		MemoryContextReset(rustate->tempContext);
+		tuplestore_puttupleslot(rustate->spill_new[RU_SPILL_PARTITION(hash)],
+								slot);
+		rustate->spill_pending = true;
+		return false;
+	}
+
+	/* Find or build hashtable entry for this tuple's group */
+	LookupTupleHashEntry(rustate->hashtable, slot, &isnew, NULL);
+	/* Must reset temp context after each hashtable lookup */
+	MemoryContextReset(rustate->tempContext);
+
+	if (isnew &&
+		MemoryContextMemAllocated(rustate->tableContext, true) >
+		get_hash_memory_limit())
+		spill_hash_table(rustate);
+
+	return isnew;
+}
+
+/*
+ * Sort out the tuples held back since spilling, one partition at a time.
+ * The new ones are added to the given table and to spill_output, from where
+ * they are returned to the caller.
+ */
+static void
+spill_find_new_tuples(RecursiveUnionState *rustate, Tuplestorestate *table)
+{
+	TupleTableSlot *slot = rustate->spill_slot;
+	bool		isnew;
+	int			i;
+
+	for (i = 0; i < RU_SPILL_PARTITIONS; i++)
+	{
+		Tuplestorestate *seen = rustate->spill_seen[i];
+		Tuplestorestate *held = rustate->spill_new[i];
+
+		if (tuplestore_tuple_count(held) == 0)
+			continue;
+
+		CHECK_FOR_INTERRUPTS();
+
+		ResetTupleHashTable(rustate->hashtable);
+		MemoryContextReset(rustate->tableContext);
+
+		tuplestore_rescan(seen);
+		while (tuplestore_gettupleslot(seen, true, false, slot))
+		{
+			LookupTupleHashEntry(rustate->hashtable, slot, &isnew, NULL);
+			MemoryContextReset(rustate->tempContext);
+		}
+
+		while (tuplestore_gettupleslot(held, true, false, slot))
+		{
+			LookupTupleHashEntry(rustate->hashtable, slot, &isnew, NULL);
+			MemoryContextReset(rustate->tempContext);
+			if (isnew)
+			{
+				tuplestore_puttupleslot(seen, slot);
+				tuplestore_puttupleslot(table, slot);
+				tuplestore_puttupleslot(rustate->spill_output, slot);
+			}
+		}
+		tuplestore_clear(held);
+	}
+
+	ExecClearTuple(slot);
+	rustate->spill_pending = false;
+	rustate->spill_draining = true;
+}
+
+/*
+ * Return the next tuple found by spill_find_new_tuples(), or NULL if there
+ * are no more.
+ */
+static TupleTableSlot *
+spill_next_output(RecursiveUnionState *rustate)
+{
+	if (tuplestore_gettupleslot(rustate->spill_output, true, false,
+								rustate->spill_slot))
+		return rustate->spill_slot;
+
+	tuplestore_clear(rustate->spill_output);
+	rustate->spill_draining = false;
+	return NULL;
+}
+
 
 /* ----------------------------------------------------------------
  *		ExecRecursiveUnion(node)
@@ -79,7 +246,6 @@ ExecRecursiveUnion(PlanState *pstate)
 	PlanState  *innerPlan = innerPlanState(node);
 	RecursiveUnion *plan = (RecursiveUnion *) node->ps.plan;
 	TupleTableSlot *slot;
-	bool		isnew;
 
 	CHECK_FOR_INTERRUPTS();
 
@@ -88,19 +254,29 @@ ExecRecursiveUnion(PlanState *pstate)
 	{
 		for (;;)
 		{
+			/* Return any held-back tuples that turned out to be new */
+			if (node->spill_draining)
+			{
+				slot = spill_next_output(node);
+				if (!TupIsNull(slot))
+					return slot;
+				break;
+			}
+
 			slot = ExecProcNode(outerPlan);
 			if (TupIsNull(slot))
-				break;
-			if (plan->numCols > 0)
 			{
-				/* Find or build hashtable entry for this tuple's group */
-				LookupTupleHashEntry(node->hashtable, slot, &isnew, NULL);
-				/* Must reset temp context after each hashtable lookup */
-				MemoryContextReset(node->tempContext);
-				/* Ignore tuple if already seen */
-				if (!isnew)
+				/* Sort out any tuples we held back after spilling */
+				if (node->spill_pending)
+				{
+					spill_find_new_tuples(node, node->working_table);
 					continue;
+				}
+				break;
 			}
+			/* Ignore tuple if already seen, or if it's held back */
+			if (plan->numCols > 0 && !lookup_tuple(node, slot))
+				continue;
 			/* Each non-duplicate tuple goes to the working table ... */
 			tuplestore_puttupleslot(node->working_table, slot);
 			/* ... and to the caller */
@@ -112,7 +288,29 @@ ExecRecursiveUnion(PlanState *pstate)
 	/* 2. Execute recursive term */
 	for (;;)
 	{
-		slot = ExecProcNode(innerPlan);
+		/* Return any held-back tuples that turned out to be new */
+		if (node->spill_draining)
+		{
+			slot = spill_next_output(node);
+			if (!TupIsNull(slot))
+				return slot;
+			/* the recursive term is already exhausted */
+			slot = NULL;
+		}
+		else
+		{
+			slot = ExecProcNode(innerPlan);
+
+			/* Sort out any tuples we held back after spilling */
+			if (TupIsNull(slot) && node->spill_pending)
+			{
+				spill_find_new_tuples(node, node->intermediate_table);
+				if (tuplestore_tuple_count(node->spill_output) > 0)
+					node->intermediate_empty = false;
+				continue;
+			}
+		}
+
 		if (TupIsNull(slot))
 		{
 			/* Done if there's nothing in the intermediate table */
@@ -138,16 +336,9 @@ ExecRecursiveUnion(PlanState *pstate)
 			continue;
 		}
 
-		if (plan->numCols > 0)
-		{
-			/* Find or build hashtable entry for this tuple's group */
-			LookupTupleHashEntry(node->hashtable, slot, &isnew, NULL);
-			/* Must reset temp context after each hashtable lookup */
-			MemoryContextReset(node->tempContext);
-			/* Ignore tuple if already seen */
-			if (!isnew)
-				continue;
-		}
+		/* Ignore tuple if already seen, or if it's held back */
+		if (plan->numCols > 0 && !lookup_tuple(node, slot))
+			continue;
 
 		/* Else, tuple is good; stash it in intermediate table ... */
 		node->intermediate_empty = false;
@@ -185,6 +376,13 @@ ExecInitRecursiveUnion(RecursiveUnion *node, EState *estate, int eflags)
 	rustate->hashtable = NULL;
 	rustate->tempContext = NULL;
 	rustate->tableContext = NULL;
+	rustate->spilled = false;
+	rustate->spill_pending = false;
+	rustate->spill_draining = false;
+	rustate->spill_seen = NULL;
+	rustate->spill_new = NULL;
+	rustate->spill_output = NULL;
+	rustate->spill_slot = NULL;
 
 	/* initialize processing state */
 	rustate->recursing = false;
@@ -257,6 +455,10 @@ ExecInitRecursiveUnion(RecursiveUnion *node, EState *estate, int eflags)
 							  &rustate->eqfuncoids,
 							  &rustate->hashfunctions);
 		build_hash_table(rustate);
+		rustate->spill_slot =
+			ExecInitExtraTupleSlot(estate,
+								   ExecGetResultType(outerPlanState(rustate)),
+								   &TTSOpsMinimalTuple);
 	}
 
 	return rustate;
@@ -274,6 +476,15 @@ ExecEndRecursiveUnion(RecursiveUnionState *node)
 	/* Release tuplestores */
 	tuplestore_end(node->working_table);
 	tuplestore_end(node->intermediate_table);
+	if (node->spill_seen)
+	{
+		for (int i = 0; i < RU_SPILL_PARTITIONS; i++)
+		{
+			tuplestore_end(node->spill_seen[i]);
+			tuplestore_end(node->spill_new[i]);
+		}
+		tuplestore_end(node->spill_output);
+	}
 
 	/* free subsidiary stuff including hashtable */
 	if (node->tempContext)
@@ -328,4 +539,18 @@ ExecReScanRecursiveUnion(RecursiveUnionState *node)
 	node->intermediate_empty = true;
 	tuplestore_clear(node->working_table);
 	tuplestore_clear(node->intermediate_table);
+
+	/* forget about any spilled tuples, but keep the tuplestores around */
+	if (node->spill_seen)
+	{
+		for (int i = 0; i < RU_SPILL_PARTITIONS; i++)
+		{
+			tuplestore_clear(node->spill_seen[i]);
+			tuplestore_clear(node->spill_new[i]);
+		}
+		tuplestore_clear(node->spill_output);
+	}
+	node->spilled = false;
+	node->spill_pending = false;
+	node->spill_draining = false;
 }
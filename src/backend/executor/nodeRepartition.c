@@ -0,0 +1,472 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeRepartition.c
+ *	  Routines to redistribute rows among the participants of a parallel
+ *	  query.
+ *
+ * A Repartition node sits atop a partial plan, and assigns each of its rows
+ * to one of a number of partitions, by hashing the partitioning columns.
+ * Every participant first sends all rows of its own copy of the subplan to
+ * their partitions, which are shared tuplestores.  Once everyone is done,
+ * the participants take turns at claiming partitions, and return the rows
+ * of the partitions they've claimed.  Thus all rows with equal partitioning
+ * columns come out of the same participant.
+ *
+ * This is used to let the participants of a parallel aggregation finalize
+ * disjoint sets of groups themselves, instead of sending all partially
+ * aggregated rows to the leader to be finalized there.
+ *
+ * When not running in parallel, rows are just passed through.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeRepartition.c
+ *
+ *-------------------------------------------------------------------------
+ */
+/*
+ * INTERFACE ROUTINES
+ *		ExecRepartition			- return the rows of the partitions we own
+ *		ExecInitRepartition		- initialize node and subnodes
+ *		ExecEndRepartition		- shutdown node and subnodes
+ *
+ */
+#include "postgres.h"
+
+#include "common/hashfn.h"
+#include "executor/executor.h"
+#include "executor/nodeRepartition.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+#include "storage/barrier.h"
+#include "utils/sharedtuplestore.h"
+#include "utils/wait_event.h"
+
+/* phases of ParallelRepartitionState's barrier */
+#define REPARTITION_PHASE_WRITE		0
+#define REPARTITION_PHASE_READ		1
+
+/*
+ * Number of partitions per participant.  Partitions are claimed one at a
+ * time, so having a few more of them than participants evens out the work.
+ */
+#define REPARTITION_PARTITIONS_PER_PARTICIPANT	2
+
+/*
+ * Shared state, followed by the partitions' SharedTuplestores.
+ */
+typedef struct ParallelRepartitionState
+{
+	Barrier		barrier;		/* see REPARTITION_PHASE_* */
+	pg_atomic_uint32 nextpart;	/* next partition to be claimed */
+	int			nparticipants;
+	int			npartitions;
+	SharedFileSet fileset;		/* space for the partitions' files */
+} ParallelRepartitionState;
+
+#define RepartitionPartition(pstate, i) \
+	((SharedTuplestore *) \
+	 ((char *) (pstate) + MAXALIGN(sizeof(ParallelRepartitionState)) + \
+	  (i) * MAXALIGN(sts_estimate((pstate)->nparticipants))))
+
+static uint32 ExecRepartitionHash(RepartitionState *node,
+								  TupleTableSlot *slot);
+static void ExecRepartitionWrite(RepartitionState *node);
+static void ExecRepartitionSetupPartitions(RepartitionState *node,
+										   ParallelRepartitionState *pstate,
+										   int participant, bool create);
+
+
+/* ----------------------------------------------------------------
+ *		ExecRepartition
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecRepartition(PlanState *pstate)
+{
+	RepartitionState *node = castNode(RepartitionState, pstate);
+	ParallelRepartitionState *shared = node->pstate;
+	TupleTableSlot *slot = node->ps.ps_ResultTupleSlot;
+
+	CHECK_FOR_INTERRUPTS();
+
+	if (shared == NULL)
+	{
+		TupleTableSlot *outerslot = ExecProcNode(outerPlanState(node));
+
+		if (TupIsNull(outerslot))
+			return NULL;
+		return ExecCopySlot(slot, outerslot);
+	}
+
+	if (!node->written)
+	{
+		ExecRepartitionWrite(node);
+		node->written = true;
+	}
+
+	for (;;)
+	{
+		uint32		part;
+
+		if (node->curpart >= 0)
+		{
+			SharedTuplestoreAccessor *accessor =
+				node->partitions[node->curpart];
+			MinimalTuple tuple;
+
+			tuple = sts_parallel_scan_next(accessor, NULL);
+			if (tuple != NULL)
+				return ExecStoreMinimalTuple(tuple, slot, false);
+
+			sts_end_parallel_scan(accessor);
+			node->curpart = -1;
+		}
+
+		/* claim the next partition, if there is one left */
+		part = pg_atomic_fetch_add_u32(&shared->nextpart, 1);
+		if (part >= shared->npartitions)
+			return ExecClearTuple(slot);
+
+		node->curpart = part;
+		sts_begin_parallel_scan(node->partitions[part]);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Send all rows of the subplan to their partitions, and wait for the other
+ * participants to do the same.
+ *
+ * A participant that arrives after the others have finished writing skips
+ * this.  Its subplan is partial, and the others have consumed all of it.
+ */
+static void
+ExecRepartitionWrite(RepartitionState *node)
+{
+	ParallelRepartitionState *shared = node->pstate;
+	PlanState  *outerNode = outerPlanState(node);
+	ExprContext *econtext = node->ps.ps_ExprContext;
+
+	if (BarrierAttach(&shared->barrier) == REPARTITION_PHASE_WRITE)
+	{
+		for (;;)
+		{
+			TupleTableSlot *outerslot;
+			MinimalTuple tuple;
+			bool		shouldFree;
+			uint32		part;
+
+			outerslot = ExecProcNode(outerNode);
+			if (TupIsNull(outerslot))
+				break;
+
+			ResetExprContext(econtext);
+			part = ExecRepartitionHash(node, outerslot) % shared->npartitions;
+
+			tuple = ExecFetchSlotMinimalTuple(outerslot, &shouldFree);
+			sts_puttuple(node->partitions[part], NULL, tuple);
+			if (shouldFree)
+				heap_free_minimal_tuple(tuple);
+		}
+
+		for (int i = 0; i < shared->npartitions; i++)
+			sts_end_write(node->partitions[i]);
+
+		BarrierArriveAndWait(&shared->barrier, WAIT_EVENT_REPARTITION_WRITE);
+	}
+	BarrierDetach(&shared->barrier);
+}
+
+/*
+ * Compute the hash of the slot's partitioning columns.
+ */
+static uint32
+ExecRepartitionHash(RepartitionState *node, TupleTableSlot *slot)
+{
+	Repartition *plan = (Repartition *) node->ps.plan;
+	MemoryContext oldcontext;
+	uint32		hashkey = 0;
+
+	oldcontext = MemoryContextSwitchTo(node->ps.ps_ExprContext->ecxt_per_tuple_memory);
+
+	for (int i = 0; i < plan->numCols; i++)
+	{
+		Datum		attr;
+		bool		isNull;
+
+		/* combine successive hashkeys by rotating */
+		hashkey = pg_rotate_left32(hashkey, 1);
+
+		attr = slot_getattr(slot, plan->partColIdx[i], &isNull);
+
+		/* treat nulls as having hash key 0 */
+		if (!isNull)
+		{
+			uint32		hkey;
+
+			hkey = DatumGetUInt32(FunctionCall1Coll(&node->hashfunctions[i],
+													plan->partCollations[i],
+													attr));
+			hashkey ^= hkey;
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return murmurhash32(hashkey);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitRepartition
+ * ----------------------------------------------------------------
+ */
+RepartitionState *
+ExecInitRepartition(Repartition *node, EState *estate, int eflags)
+{
+	RepartitionState *state;
+	Oid		   *eqfuncoids;
+
+	/* check for unsupported flags */
+	Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+	/*
+	 * create state structure
+	 */
+	state = makeNode(RepartitionState);
+	state->ps.plan = (Plan *) node;
+	state->ps.state = estate;
+	state->ps.ExecProcNode = ExecRepartition;
+
+	state->pstate = NULL;
+	state->partitions = NULL;
+	state->written = false;
+	state->curpart = -1;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * Repartition nodes don't project, but we need an ExprContext to hash
+	 * in.
+	 */
+	ExecAssignExprContext(estate, &state->ps);
+
+	/*
+	 * initialize child nodes
+	 */
+	outerPlanState(state) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * Initialize result type and slot.  Rows read back from the partitions
+	 * are minimal tuples.
+	 */
+	ExecInitResultTupleSlotTL(&state->ps, &TTSOpsMinimalTuple);
+	state->ps.ps_ProjInfo = NULL;
+
+	execTuplesHashPrepare(node->numCols, node->partOperators,
+						  &eqfuncoids, &state->hashfunctions);
+
+	return state;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndRepartition
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndRepartition(RepartitionState *node)
+{
+	if (node->curpart >= 0)
+		sts_end_parallel_scan(node->partitions[node->curpart]);
+	node->curpart = -1;
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+}
+
+/* ----------------------------------------------------------------
+ *		ExecReScanRepartition
+ *
+ *		The shared state is reset by ExecRepartitionReInitializeDSM().
+ * ----------------------------------------------------------------
+ */
+void
+ExecReScanRepartition(RepartitionState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	if (node->curpart >= 0)
+		sts_end_parallel_scan(node->partitions[node->curpart]);
+	node->curpart = -1;
+	node->written = false;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (outerPlan->chgParam == NULL)
+		ExecReScan(outerPlan);
+}
+
+/* ----------------------------------------------------------------
+ *						Parallel Query Support
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Set up the accessors for all partitions.  The leader creates the shared
+ * tuplestores, workers attach to them.
+ */
+static void
+ExecRepartitionSetupPartitions(RepartitionState *node,
+							   ParallelRepartitionState *pstate,
+							   int participant, bool create)
+{
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(node->ps.state->es_query_cxt);
+
+	if (node->partitions == NULL)
+		node->partitions = palloc(sizeof(SharedTuplestoreAccessor *) *
+								  pstate->npartitions);
+
+	for (int i = 0; i < pstate->npartitions; i++)
+	{
+		SharedTuplestore *sts = RepartitionPartition(pstate, i);
+
+		if (create)
+		{
+			char		name[MAXPGPATH];
+
+			snprintf(name, sizeof(name), "repartition%d.%d",
+					 node->ps.plan->plan_node_id, i);
+			node->partitions[i] = sts_initialize(sts,
+												 pstate->nparticipants,
+												 participant,
+												 0,
+												 SHARED_TUPLESTORE_SINGLE_PASS,
+												 &pstate->fileset,
+												 name);
+		}
+		else
+			node->partitions[i] = sts_attach(sts, participant,
+											 &pstate->fileset);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecRepartitionEstimate
+ *
+ *		Estimate space required to propagate the shared state.
+ * ----------------------------------------------------------------
+ */
+void
+ExecRepartitionEstimate(RepartitionState *node, ParallelContext *pcxt)
+{
+	int			nparticipants = pcxt->nworkers + 1;
+	int			npartitions = nparticipants * REPARTITION_PARTITIONS_PER_PARTICIPANT;
+	Size		size;
+
+	size = add_size(MAXALIGN(sizeof(ParallelRepartitionState)),
+					mul_size(npartitions,
+							 MAXALIGN(sts_estimate(nparticipants))));
+	shm_toc_estimate_chunk(&pcxt->estimator, size);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecRepartitionInitializeDSM
+ *
+ *		Set up the shared state and the partitions.
+ * ----------------------------------------------------------------
+ */
+void
+ExecRepartitionInitializeDSM(RepartitionState *node, ParallelContext *pcxt)
+{
+	int			nparticipants = pcxt->nworkers + 1;
+	int			npartitions = nparticipants * REPARTITION_PARTITIONS_PER_PARTICIPANT;
+	ParallelRepartitionState *pstate;
+	Size		size;
+
+	/*
+	 * Without a real DSM segment there are no workers, and the shared file
+	 * set can't be set up, so just pass the rows through.
+	 */
+	if (pcxt->seg == NULL)
+		return;
+
+	size = add_size(MAXALIGN(sizeof(ParallelRepartitionState)),
+					mul_size(npartitions,
+							 MAXALIGN(sts_estimate(nparticipants))));
+	pstate = shm_toc_allocate(pcxt->toc, size);
+	shm_toc_insert(pcxt->toc, node->ps.plan->plan_node_id, pstate);
+
+	BarrierInit(&pstate->barrier, 0);
+	pg_atomic_init_u32(&pstate->nextpart, 0);
+	pstate->nparticipants = nparticipants;
+	pstate->npartitions = npartitions;
+	SharedFileSetInit(&pstate->fileset, pcxt->seg);
+
+	/* the leader is participant 0 */
+	ExecRepartitionSetupPartitions(node, pstate, 0, true);
+	node->pstate = pstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecRepartitionReInitializeDSM
+ *
+ *		Reset shared state before beginning a fresh scan.
+ * ----------------------------------------------------------------
+ */
+void
+ExecRepartitionReInitializeDSM(RepartitionState *node, ParallelContext *pcxt)
+{
+	ParallelRepartitionState *pstate = node->pstate;
+
+	if (pstate == NULL)
+		return;
+
+	/* Stop reading the previous scan's partition, if we still are. */
+	if (node->curpart >= 0)
+		sts_end_parallel_scan(node->partitions[node->curpart]);
+	node->curpart = -1;
+	node->written = false;
+
+	/* Clear the previous scan's partitions. */
+	SharedFileSetDeleteAll(&pstate->fileset);
+
+	BarrierInit(&pstate->barrier, 0);
+	pg_atomic_write_u32(&pstate->nextpart, 0);
+	ExecRepartitionSetupPartitions(node, pstate, 0, true);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecRepartitionInitializeWorker
+ *
+ *		Attach to the shared state and the partitions.
+ * ----------------------------------------------------------------
+ */
+void
+ExecRepartitionInitializeWorker(RepartitionState *node,
+								ParallelWorkerContext *pwcxt)
+{
+	ParallelRepartitionState *pstate;
+
+	pstate = shm_toc_lookup(pwcxt->toc, node->ps.plan->plan_node_id, true);
+	if (pstate == NULL)
+		return;
+
+	SharedFileSetAttach(&pstate->fileset, pwcxt->seg);
+	ExecRepartitionSetupPartitions(node, pstate, ParallelWorkerNumber + 1,
+								   false);
+	node->pstate = pstate;
+}
@@ -45,6 +45,7 @@
 
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeResult.h"
 #include "miscadmin.h"
@@ -138,6 +139,52 @@ ExecResult(PlanState *pstate)
 	return NULL;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecResultBatch(node)
+ *
+ *		ExecProcNodeBatch method, used when there is an outer plan: fetches
+ *		a batch of tuples from it and returns their projections.
+ * ----------------------------------------------------------------
+ */
+static int
+ExecResultBatch(PlanState *pstate, TupleTableSlot **slots, int maxslots)
+{
+	ResultState *node = castNode(ResultState, pstate);
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	TupleTableSlot *outerslots[EXEC_BATCH_SIZE];
+	int			nslots;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* check constant qualifications, as in ExecResult */
+	if (node->rs_checkqual)
+	{
+		bool		qualResult = ExecQual(node->resconstantqual, econtext);
+
+		node->rs_checkqual = false;
+		if (!qualResult)
+			node->rs_done = true;
+	}
+
+	if (node->rs_done)
+		return 0;
+
+	nslots = ExecProcNodeBatch(outerPlanState(node), outerslots,
+							   Min(maxslots, EXEC_BATCH_SIZE));
+
+	for (int i = 0; i < nslots; i++)
+	{
+		ResetExprContext(econtext);
+		econtext->ecxt_outertuple = outerslots[i];
+
+		/* ExecProject() reuses one slot, so keep a copy of each result */
+		slots[i] = ExecCopySlot(node->rs_batchslots[i],
+								ExecProject(node->ps.ps_ProjInfo));
+	}
+
+	return nslots;
+}
+
 /* ----------------------------------------------------------------
  *		ExecResultMarkPos
  * ----------------------------------------------------------------
@@ -227,6 +274,19 @@ ExecInitResult(Result *node, EState *estate, int eflags)
 	resstate->resconstantqual =
 		ExecInitQual((List *) node->resconstantqual, (PlanState *) resstate);
 
+	/* with an outer plan, we can return batches of tuples */
+	if (outerPlanState(resstate) != NULL)
+	{
+		resstate->rs_batchslots =
+			palloc(sizeof(TupleTableSlot *) * EXEC_BATCH_SIZE);
+		for (int i = 0; i < EXEC_BATCH_SIZE; i++)
+			resstate->rs_batchslots[i] =
+				ExecInitExtraTupleSlot(estate,
+									   resstate->ps.ps_ResultTupleDesc,
+									   &TTSOpsVirtual);
+		resstate->ps.ExecProcNodeBatch = ExecResultBatch;
+	}
+
 	return resstate;
 }
 
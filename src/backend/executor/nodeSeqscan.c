@@ -15,6 +15,7 @@
 /*
  * INTERFACE ROUTINES
  *		ExecSeqScan				sequentially scans a relation.
+ *		ExecSeqScanBatchNext	returns a batch of tuples from the relation.
  *		ExecSeqNext				retrieve next tuple in sequential order.
  *		ExecInitSeqScan			creates and initializes a seqscan node.
  *		ExecEndSeqScan			releases any storage allocated.
@@ -28,12 +29,24 @@
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/skey.h"
+#include "access/stratnum.h"
+#include "access/sysattr.h"
 #include "access/tableam.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeSeqscan.h"
+#include "miscadmin.h"
+#include "optimizer/optimizer.h"
+#include "storage/bufmgr.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
 
 static TupleTableSlot *SeqNext(SeqScanState *node);
+static void SeqScanInitProjection(SeqScanState *node, SeqScan *plan);
+static TupleTableSlot *ExecSeqScanBatch(PlanState *pstate);
+static int	ExecSeqScanBatchNext(PlanState *pstate, TupleTableSlot **slots,
+								 int maxslots);
 
 /* ----------------------------------------------------------------
  *						Scan Support
@@ -71,6 +84,8 @@ SeqNext(SeqScanState *node)
 		scandesc = table_beginscan(node->ss.ss_currentRelation,
 								   estate->es_snapshot,
 								   0, NULL);
+		table_scan_set_projection(scandesc, node->projattrs,
+								  node->nprojkeys, node->projkeys);
 		node->ss.ss_currentScanDesc = scandesc;
 	}
 
@@ -114,6 +129,293 @@ ExecSeqScan(PlanState *pstate)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatch(node)
+ *
+ *		Variant of ExecSeqScan used when the qual can be evaluated by
+ *		ExecBatchQual().  Tuples are fetched EXEC_BATCH_SIZE at a time,
+ *		the qual is applied to the whole batch at once, and the matching
+ *		tuples are then returned one by one through the scan tuple slot.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecSeqScanBatch(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+	EState	   *estate = node->ss.ps.state;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	ProjectionInfo *projInfo = node->ss.ps.ps_ProjInfo;
+	TupleTableSlot *scanslot = node->ss.ss_ScanTupleSlot;
+
+	/* EvalPlanQual rechecks and backward scans take the regular path */
+	if (estate->es_epq_active != NULL ||
+		!ScanDirectionIsForward(estate->es_direction))
+		return ExecSeqScan(pstate);
+
+	for (;;)
+	{
+		/* return the next matching tuple of the current batch, if any */
+		while (node->batchpos < node->batchlen)
+		{
+			int			i = node->batchpos++;
+
+			if (!node->batchmatches[i])
+				continue;
+
+			/*
+			 * Copy the tuple into the scan slot, which for buffer tuples just
+			 * takes another pin; WHERE CURRENT OF looks for it there.
+			 */
+			ExecCopySlot(scanslot, node->batchslots[i]);
+
+			ResetExprContext(econtext);
+			econtext->ecxt_scantuple = scanslot;
+
+			if (projInfo)
+				return ExecProject(projInfo);
+			return scanslot;
+		}
+
+		if (node->batchdone)
+			break;
+
+		/* fill the next batch */
+		node->batchlen = 0;
+		node->batchpos = 0;
+		while (node->batchlen < node->batchsize)
+		{
+			/*
+			 * SeqNext() returns tuples in a slot that only stays valid until
+			 * the next fetch, so keep a copy of each one.
+			 */
+			if (SeqNext(node) == NULL)
+			{
+				node->batchdone = true;
+				break;
+			}
+			ExecCopySlot(node->batchslots[node->batchlen++], scanslot);
+		}
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (node->batchlen > 0)
+		{
+			int			nmatches;
+
+			nmatches = ExecBatchQual(node->batchqual, node->batchslots,
+									 node->batchlen, node->batchmatches);
+			InstrCountFiltered1(node, node->batchlen - nmatches);
+		}
+	}
+
+	/* end of scan; release the pins held by the batch */
+	for (int i = 0; i < EXEC_BATCH_SIZE; i++)
+		ExecClearTuple(node->batchslots[i]);
+	node->batchlen = 0;
+	node->batchpos = 0;
+
+	if (projInfo)
+		return ExecClearTuple(projInfo->pi_state.resultslot);
+	return ExecClearTuple(scanslot);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatchNext(node)
+ *
+ *		ExecProcNodeBatch method: returns the next batch of qualifying
+ *		tuples.  This is only used when the node has no projection to do.
+ * ----------------------------------------------------------------
+ */
+static int
+ExecSeqScanBatchNext(PlanState *pstate, TupleTableSlot **slots, int maxslots)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+	ExprState  *qual = node->ss.ps.qual;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot *scanslot = node->ss.ss_ScanTupleSlot;
+	int			nslots = 0;
+
+	Assert(node->ss.ps.ps_ProjInfo == NULL);
+	Assert(ScanDirectionIsForward(node->ss.ps.state->es_direction));
+
+	maxslots = Min(maxslots, node->batchsize);
+
+	while (nslots == 0 && !node->batchdone)
+	{
+		int			batchlen = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		while (batchlen < maxslots)
+		{
+			if (SeqNext(node) == NULL)
+			{
+				node->batchdone = true;
+				break;
+			}
+			ExecCopySlot(node->batchslots[batchlen++], scanslot);
+		}
+
+		if (qual == NULL)
+		{
+			for (int i = 0; i < batchlen; i++)
+				slots[nslots++] = node->batchslots[i];
+			continue;
+		}
+
+		if (node->batchqual != NULL)
+			ExecBatchQual(node->batchqual, node->batchslots, batchlen,
+						  node->batchmatches);
+		else
+		{
+			for (int i = 0; i < batchlen; i++)
+			{
+				ResetExprContext(econtext);
+				econtext->ecxt_scantuple = node->batchslots[i];
+				node->batchmatches[i] = ExecQual(qual, econtext);
+			}
+		}
+
+		for (int i = 0; i < batchlen; i++)
+		{
+			if (node->batchmatches[i])
+				slots[nslots++] = node->batchslots[i];
+			else
+				InstrCountFiltered1(node, 1);
+		}
+	}
+
+	return nslots;
+}
+
+/*
+ * SeqScanInitProjection -- work out the arguments for
+ * table_scan_set_projection()
+ *
+ * The columns needed are those referenced by the targetlist and the qual.
+ * Keys are made from the qual's "Var op Const" clauses using btree
+ * comparison operators.  Equality is expressed as a pair of >= and <= keys,
+ * as ranges are what AMs can make use of.
+ */
+static void
+SeqScanInitProjection(SeqScanState *node, SeqScan *plan)
+{
+	Index		scanrelid = plan->scan.scanrelid;
+	Bitmapset  *attrs = NULL;
+	ListCell   *lc;
+
+	pull_varattnos((Node *) plan->scan.plan.targetlist, scanrelid, &attrs);
+	pull_varattnos((Node *) plan->scan.plan.qual, scanrelid, &attrs);
+
+	/* a whole-row reference needs all of them */
+	if (bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber,
+					  attrs))
+	{
+		bms_free(attrs);
+		attrs = NULL;
+	}
+	node->projattrs = attrs;
+
+	node->nprojkeys = 0;
+
+	/*
+	 * Tuples rejected by the AM never reach our qual, so they'd be missing
+	 * from EXPLAIN ANALYZE's "Rows Removed by Filter".  Don't pass any keys
+	 * when rows are being counted.
+	 */
+	if (node->ss.ps.state->es_instrument)
+		return;
+
+	node->projkeys = palloc(sizeof(ScanKeyData) * 2 *
+							Max(list_length(plan->scan.plan.qual), 1));
+
+	foreach(lc, plan->scan.plan.qual)
+	{
+		OpExpr	   *opexpr = (OpExpr *) lfirst(lc);
+		Node	   *leftop;
+		Node	   *rightop;
+		Var		   *var;
+		Const	   *con;
+		Oid			opno;
+		List	   *interpretations;
+		OpBtreeInterpretation *interp = NULL;
+		ListCell   *lc2;
+
+		if (!IsA(opexpr, OpExpr) || list_length(opexpr->args) != 2)
+			continue;
+
+		leftop = linitial(opexpr->args);
+		rightop = lsecond(opexpr->args);
+		opno = opexpr->opno;
+		if (IsA(leftop, Var) && IsA(rightop, Const))
+		{
+			var = (Var *) leftop;
+			con = (Const *) rightop;
+		}
+		else if (IsA(leftop, Const) && IsA(rightop, Var))
+		{
+			var = (Var *) rightop;
+			con = (Const *) leftop;
+			opno = get_commutator(opno);
+			if (!OidIsValid(opno))
+				continue;
+		}
+		else
+			continue;
+
+		if (var->varno != scanrelid || var->varlevelsup != 0 ||
+			var->varattno <= 0 || con->constisnull)
+			continue;
+
+		interpretations = get_op_btree_interpretation(opno);
+		foreach(lc2, interpretations)
+		{
+			OpBtreeInterpretation *cand = (OpBtreeInterpretation *) lfirst(lc2);
+
+			if (cand->strategy >= BTLessStrategyNumber &&
+				cand->strategy <= BTGreaterStrategyNumber)
+			{
+				interp = cand;
+				break;
+			}
+		}
+		if (interp == NULL)
+			continue;
+
+		if (interp->strategy == BTEqualStrategyNumber)
+		{
+			Oid			geop;
+			Oid			leop;
+
+			geop = get_opfamily_member(interp->opfamily_id,
+									   interp->oplefttype,
+									   interp->oprighttype,
+									   BTGreaterEqualStrategyNumber);
+			leop = get_opfamily_member(interp->opfamily_id,
+									   interp->oplefttype,
+									   interp->oprighttype,
+									   BTLessEqualStrategyNumber);
+			if (!OidIsValid(geop) || !OidIsValid(leop))
+				continue;
+
+			ScanKeyEntryInitialize(&node->projkeys[node->nprojkeys++], 0,
+								   var->varattno,
+								   BTGreaterEqualStrategyNumber,
+								   interp->oprighttype, opexpr->inputcollid,
+								   get_opcode(geop), con->constvalue);
+			ScanKeyEntryInitialize(&node->projkeys[node->nprojkeys++], 0,
+								   var->varattno,
+								   BTLessEqualStrategyNumber,
+								   interp->oprighttype, opexpr->inputcollid,
+								   get_opcode(leop), con->constvalue);
+		}
+		else
+			ScanKeyEntryInitialize(&node->projkeys[node->nprojkeys++], 0,
+								   var->varattno, interp->strategy,
+								   interp->oprighttype, opexpr->inputcollid,
+								   get_opcode(opno), con->constvalue);
+	}
+}
 
 /* ----------------------------------------------------------------
  *		ExecInitSeqScan
@@ -171,6 +473,58 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	scanstate->ss.ps.qual =
 		ExecInitQual(node->scan.plan.qual, (PlanState *) scanstate);
 
+	/* let the table AM know what's needed, if it cares */
+	if (scanstate->ss.ss_currentRelation->rd_tableam->scan_set_projection)
+		SeqScanInitProjection(scanstate, node);
+
+	/*
+	 * Tuples are fetched ahead of the ones returned when the qual is
+	 * simple enough to be evaluated over batches of tuples, or when the
+	 * node is asked for a batch of tuples.  Neither is done if the scan
+	 * might run backwards, or for EvalPlanQual.  Batches of tuples are
+	 * only returned when there's no projection to do, and when it's safe to
+	 * evaluate the qual on tuples that might never be asked for.
+	 */
+	if (!(eflags & EXEC_FLAG_BACKWARD) && estate->es_epq_active == NULL)
+	{
+		if (scanstate->ss.ps.qual != NULL)
+			scanstate->batchqual = ExecBuildBatchQual(scanstate->ss.ps.qual);
+
+		if (scanstate->ss.ps.ps_ProjInfo == NULL &&
+			!contain_volatile_functions((Node *) node->scan.plan.qual))
+			scanstate->ss.ps.ExecProcNodeBatch = ExecSeqScanBatchNext;
+	}
+
+	if (scanstate->batchqual != NULL ||
+		scanstate->ss.ps.ExecProcNodeBatch != NULL)
+	{
+		Relation	rel = scanstate->ss.ss_currentRelation;
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+		const TupleTableSlotOps *tts_cb;
+		uint32		maxpins = EXEC_BATCH_SIZE;
+
+		/*
+		 * Each tuple of a batch may keep a different buffer pinned, so don't
+		 * let a batch hold more pins than the backend can spare.
+		 */
+		if (RelationUsesLocalBuffers(rel))
+			LimitAdditionalLocalPins(&maxpins);
+		else
+			LimitAdditionalPins(&maxpins);
+		scanstate->batchsize = Max(maxpins, 1);
+
+		tts_cb = table_slot_callbacks(rel);
+		scanstate->batchslots =
+			palloc(sizeof(TupleTableSlot *) * EXEC_BATCH_SIZE);
+		for (int i = 0; i < EXEC_BATCH_SIZE; i++)
+			scanstate->batchslots[i] =
+				ExecInitExtraTupleSlot(estate, tupdesc, tts_cb);
+		scanstate->batchmatches = palloc(sizeof(bool) * EXEC_BATCH_SIZE);
+	}
+
+	if (scanstate->batchqual != NULL)
+		scanstate->ss.ps.ExecProcNode = ExecSeqScanBatch;
+
 	return scanstate;
 }
 
@@ -219,6 +573,15 @@ ExecReScanSeqScan(SeqScanState *node)
 		table_rescan(scan,		/* scan desc */
 					 NULL);		/* new scan keys */
 
+	if (node->batchslots != NULL)
+	{
+		for (int i = 0; i < EXEC_BATCH_SIZE; i++)
+			ExecClearTuple(node->batchslots[i]);
+		node->batchlen = 0;
+		node->batchpos = 0;
+		node->batchdone = false;
+	}
+
 	ExecScanReScan((ScanState *) node);
 }
 
@@ -266,6 +629,8 @@ ExecSeqScanInitializeDSM(SeqScanState *node,
 	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, pscan);
 	node->ss.ss_currentScanDesc =
 		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	table_scan_set_projection(node->ss.ss_currentScanDesc, node->projattrs,
+							  node->nprojkeys, node->projkeys);
 }
 
 /* ----------------------------------------------------------------
@@ -299,4 +664,6 @@ ExecSeqScanInitializeWorker(SeqScanState *node,
 	pscan = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, false);
 	node->ss.ss_currentScanDesc =
 		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	table_scan_set_projection(node->ss.ss_currentScanDesc, node->projattrs,
+							  node->nprojkeys, node->projkeys);
 }
@@ -19,7 +19,50 @@
 #include "executor/execdebug.h"
 #include "executor/nodeSort.h"
 #include "miscadmin.h"
+#include "optimizer/optimizer.h"
+#include "storage/condition_variable.h"
+#include "storage/spin.h"
 #include "utils/tuplesort.h"
+#include "utils/wait_event.h"
+
+/*
+ * Shared state of a parallel-aware (coordinated) sort.
+ *
+ * Every participant, including the leader, sorts the tuples it reads from
+ * its own copy of the outer plan into a run on shared tapes, using a worker
+ * Tuplesortstate.  Once all workers are done, the leader merges all runs
+ * directly, and returns the whole sorted output; the workers return nothing.
+ * Compared with a Gather Merge over separate per-worker sorts, the sorted
+ * tuples don't have to be sent through the tuple queues, and the workers
+ * don't do a final merge of their own runs.
+ *
+ * This requires the leader to run the plan, and to know how many workers
+ * were launched, so the decision whether to coordinate is made by the leader
+ * when it sets up the shared state, and followed by all workers.  Bounded
+ * sorts and sorts that need random access never coordinate.
+ *
+ * The shared tuplesort state follows this struct, and instrumentation data
+ * for EXPLAIN ANALYZE, if any, follows that.
+ */
+typedef struct ParallelSortState
+{
+	bool		coordinated;	/* do a coordinated sort? */
+	slock_t		mutex;			/* protects nworkersdone */
+	int			nworkersdone;	/* number of workers done sorting */
+	ConditionVariable workersdonecv;	/* signaled when a worker is done */
+	Size		instrument_offset;	/* offset of SharedSortInfo, or 0 */
+} ParallelSortState;
+
+#define ParallelSortGetSharedsort(pstate) \
+	((Sharedsort *) ((char *) (pstate) + MAXALIGN(sizeof(ParallelSortState))))
+
+static Tuplesortstate *ExecSortBegin(SortState *node,
+									 SortCoordinate coordinate);
+static void ExecSortFill(SortState *node, Tuplesortstate *tuplesortstate);
+static void ExecSortCoordinated(SortState *node);
+static bool ExecSortCanCoordinate(SortState *node);
+static Size ExecSortSharedSize(SortState *node, ParallelContext *pcxt,
+							   Size *instrument_offset);
 
 
 /* ----------------------------------------------------------------
@@ -74,11 +117,6 @@ ExecSort(PlanState *pstate)
 
 	if (!node->sort_Done)
 	{
-		Sort	   *plannode = (Sort *) node->ss.ps.plan;
-		PlanState  *outerNode;
-		TupleDesc	tupDesc;
-		int			tuplesortopts = TUPLESORT_NONE;
-
 		SO1_printf("ExecSort: %s\n",
 				   "sorting subplan");
 
@@ -88,77 +126,38 @@ ExecSort(PlanState *pstate)
 		 */
 		estate->es_direction = ForwardScanDirection;
 
-		/*
-		 * Initialize tuplesort module.
-		 */
-		SO1_printf("ExecSort: %s\n",
-				   "calling tuplesort_begin");
-
-		outerNode = outerPlanState(node);
-		tupDesc = ExecGetResultType(outerNode);
-
-		if (node->randomAccess)
-			tuplesortopts |= TUPLESORT_RANDOMACCESS;
-		if (node->bounded)
-			tuplesortopts |= TUPLESORT_ALLOWBOUNDED;
-
-		if (node->datumSort)
-			tuplesortstate = tuplesort_begin_datum(TupleDescAttr(tupDesc, 0)->atttypid,
-												   plannode->sortOperators[0],
-												   plannode->collations[0],
-												   plannode->nullsFirst[0],
-												   work_mem,
-												   NULL,
-												   tuplesortopts);
-		else
-			tuplesortstate = tuplesort_begin_heap(tupDesc,
-												  plannode->numCols,
-												  plannode->sortColIdx,
-												  plannode->sortOperators,
-												  plannode->collations,
-												  plannode->nullsFirst,
-												  work_mem,
-												  NULL,
-												  tuplesortopts);
-		if (node->bounded)
-			tuplesort_set_bound(tuplesortstate, node->bound);
-		node->tuplesortstate = (void *) tuplesortstate;
-
-		/*
-		 * Scan the subplan and feed all the tuples to tuplesort using the
-		 * appropriate method based on the type of sort we're doing.
-		 */
-		if (node->datumSort)
+		if (node->pstate != NULL && node->pstate->coordinated &&
+			(IsParallelWorker() || node->pcxt->nworkers_launched > 0))
 		{
-			for (;;)
-			{
-				slot = ExecProcNode(outerNode);
-
-				if (TupIsNull(slot))
-					break;
-				slot_getsomeattrs(slot, 1);
-				tuplesort_putdatum(tuplesortstate,
-								   slot->tts_values[0],
-								   slot->tts_isnull[0]);
-			}
+			/*
+			 * Sort our share of the input for a coordinated parallel sort.
+			 * Leaves tuplesortstate set only in the leader.
+			 */
+			ExecSortCoordinated(node);
+			tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
 		}
 		else
 		{
-			for (;;)
-			{
-				slot = ExecProcNode(outerNode);
-
-				if (TupIsNull(slot))
-					break;
-				tuplesort_puttupleslot(tuplesortstate, slot);
-			}
+			/*
+			 * Initialize tuplesort module.
+			 */
+			SO1_printf("ExecSort: %s\n",
+					   "calling tuplesort_begin");
+
+			tuplesortstate = ExecSortBegin(node, NULL);
+			node->tuplesortstate = (void *) tuplesortstate;
+
+			/*
+			 * Scan the subplan and feed all the tuples to tuplesort.
+			 */
+			ExecSortFill(node, tuplesortstate);
+
+			/*
+			 * Complete the sort.
+			 */
+			tuplesort_performsort(tuplesortstate);
 		}
 
-		/*
-		 * Complete the sort.
-		 */
-		tuplesort_performsort(tuplesortstate);
-
 		/*
 		 * restore to user specified direction
 		 */
@@ -170,7 +169,7 @@ ExecSort(PlanState *pstate)
 		node->sort_Done = true;
 		node->bounded_Done = node->bounded;
 		node->bound_Done = node->bound;
-		if (node->shared_info && node->am_worker)
+		if (node->shared_info && node->am_worker && tuplesortstate != NULL)
 		{
 			TuplesortInstrumentation *si;
 
@@ -187,6 +186,10 @@ ExecSort(PlanState *pstate)
 
 	slot = node->ss.ps.ps_ResultTupleSlot;
 
+	/* workers of a coordinated sort return no tuples */
+	if (tuplesortstate == NULL)
+		return ExecClearTuple(slot);
+
 	/*
 	 * Fetch the next sorted item from the appropriate tuplesort function. For
 	 * datum sorts we must manage the slot ourselves and leave it clear when
@@ -210,6 +213,162 @@ ExecSort(PlanState *pstate)
 	return slot;
 }
 
+/*
+ * Begin a tuplesort for the node, with the given coordinate for a parallel
+ * sort, or NULL.
+ */
+static Tuplesortstate *
+ExecSortBegin(SortState *node, SortCoordinate coordinate)
+{
+	Sort	   *plannode = (Sort *) node->ss.ps.plan;
+	TupleDesc	tupDesc = ExecGetResultType(outerPlanState(node));
+	int			tuplesortopts = TUPLESORT_NONE;
+	Tuplesortstate *tuplesortstate;
+
+	if (node->randomAccess)
+		tuplesortopts |= TUPLESORT_RANDOMACCESS;
+	if (node->bounded)
+		tuplesortopts |= TUPLESORT_ALLOWBOUNDED;
+
+	if (node->datumSort)
+		tuplesortstate = tuplesort_begin_datum(TupleDescAttr(tupDesc, 0)->atttypid,
+											   plannode->sortOperators[0],
+											   plannode->collations[0],
+											   plannode->nullsFirst[0],
+											   work_mem,
+											   coordinate,
+											   tuplesortopts);
+	else
+		tuplesortstate = tuplesort_begin_heap(tupDesc,
+											  plannode->numCols,
+											  plannode->sortColIdx,
+											  plannode->sortOperators,
+											  plannode->collations,
+											  plannode->nullsFirst,
+											  work_mem,
+											  coordinate,
+											  tuplesortopts);
+	if (node->bounded)
+		tuplesort_set_bound(tuplesortstate, node->bound);
+
+	return tuplesortstate;
+}
+
+/*
+ * Scan the subplan and feed all the tuples to tuplesort using the
+ * appropriate method based on the type of sort we're doing.
+ */
+static void
+ExecSortFill(SortState *node, Tuplesortstate *tuplesortstate)
+{
+	PlanState  *outerNode = outerPlanState(node);
+	TupleTableSlot *slot;
+
+	if (node->datumSort)
+	{
+		for (;;)
+		{
+			slot = ExecProcNode(outerNode);
+
+			if (TupIsNull(slot))
+				break;
+			slot_getsomeattrs(slot, 1);
+			tuplesort_putdatum(tuplesortstate,
+							   slot->tts_values[0],
+							   slot->tts_isnull[0]);
+		}
+	}
+	else
+	{
+		for (;;)
+		{
+			slot = ExecProcNode(outerNode);
+
+			if (TupIsNull(slot))
+				break;
+			tuplesort_puttupleslot(tuplesortstate, slot);
+		}
+	}
+}
+
+/*
+ * Take part in a coordinated parallel sort, see ParallelSortState.
+ *
+ * In the leader, this waits for all workers to finish their runs, and leaves
+ * the merged result in node->tuplesortstate.  In workers, it returns as soon
+ * as the worker's run is complete, leaving node->tuplesortstate NULL.
+ */
+static void
+ExecSortCoordinated(SortState *node)
+{
+	ParallelSortState *pstate = node->pstate;
+	SortCoordinateData coordinate;
+	Tuplesortstate *tuplesortstate;
+
+	/* sort the tuples this process reads as one of the participants */
+	coordinate.isWorker = true;
+	coordinate.nParticipants = -1;
+	coordinate.sharedsort = ParallelSortGetSharedsort(pstate);
+
+	tuplesortstate = ExecSortBegin(node, &coordinate);
+	ExecSortFill(node, tuplesortstate);
+	tuplesort_performsort(tuplesortstate);
+
+	if (node->shared_info && node->am_worker)
+	{
+		TuplesortInstrumentation *si;
+
+		Assert(IsParallelWorker());
+		Assert(ParallelWorkerNumber <= node->shared_info->num_workers);
+		si = &node->shared_info->sinstrument[ParallelWorkerNumber];
+		tuplesort_get_stats(tuplesortstate, si);
+	}
+	tuplesort_end(tuplesortstate);
+
+	if (IsParallelWorker())
+	{
+		/* let the leader know that our run is available */
+		SpinLockAcquire(&pstate->mutex);
+		pstate->nworkersdone++;
+		SpinLockRelease(&pstate->mutex);
+		ConditionVariableSignal(&pstate->workersdonecv);
+
+		node->tuplesortstate = NULL;
+		return;
+	}
+
+	/*
+	 * In the leader, wait until all launched workers have finished their
+	 * runs.  Make sure that they all attached first, so that we don't wait
+	 * forever for one that failed to start.
+	 */
+	WaitForParallelWorkersToAttach(node->pcxt);
+	for (;;)
+	{
+		int			nworkersdone;
+
+		SpinLockAcquire(&pstate->mutex);
+		nworkersdone = pstate->nworkersdone;
+		SpinLockRelease(&pstate->mutex);
+
+		if (nworkersdone == node->pcxt->nworkers_launched)
+			break;
+
+		ConditionVariableSleep(&pstate->workersdonecv,
+							   WAIT_EVENT_PARALLEL_SORT);
+	}
+	ConditionVariableCancelSleep();
+
+	/* now merge all the runs, including our own */
+	coordinate.isWorker = false;
+	coordinate.nParticipants = node->pcxt->nworkers_launched + 1;
+	coordinate.sharedsort = ParallelSortGetSharedsort(pstate);
+
+	tuplesortstate = ExecSortBegin(node, &coordinate);
+	tuplesort_performsort(tuplesortstate);
+	node->tuplesortstate = (void *) tuplesortstate;
+}
+
 /* ----------------------------------------------------------------
  *		ExecInitSort
  *
@@ -246,6 +405,8 @@ ExecInitSort(Sort *node, EState *estate, int eflags)
 	sortstate->bounded = false;
 	sortstate->sort_Done = false;
 	sortstate->tuplesortstate = NULL;
+	sortstate->pstate = NULL;
+	sortstate->pcxt = NULL;
 
 	/*
 	 * Miscellaneous initialization
@@ -387,7 +548,8 @@ ExecReScanSort(SortState *node)
 		!node->randomAccess)
 	{
 		node->sort_Done = false;
-		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+		if (node->tuplesortstate != NULL)
+			tuplesort_end((Tuplesortstate *) node->tuplesortstate);
 		node->tuplesortstate = NULL;
 
 		/*
@@ -406,10 +568,47 @@ ExecReScanSort(SortState *node)
  * ----------------------------------------------------------------
  */
 
+/*
+ * Can the sort be done as a coordinated parallel sort?  See ParallelSortState.
+ */
+static bool
+ExecSortCanCoordinate(SortState *node)
+{
+	return parallel_leader_participation &&
+		!node->bounded && !node->randomAccess;
+}
+
+/*
+ * Size of the shared state of a parallel-aware sort.  Sets *instrument_offset
+ * to the offset of the instrumentation data, or 0 if there is none.
+ */
+static Size
+ExecSortSharedSize(SortState *node, ParallelContext *pcxt,
+				   Size *instrument_offset)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(ParallelSortState));
+	size = add_size(size, MAXALIGN(tuplesort_estimate_shared(pcxt->nworkers + 1)));
+
+	if (node->ss.ps.instrument)
+	{
+		*instrument_offset = size;
+		size = add_size(size, offsetof(SharedSortInfo, sinstrument));
+		size = add_size(size, mul_size(pcxt->nworkers,
+									   sizeof(TuplesortInstrumentation)));
+	}
+	else
+		*instrument_offset = 0;
+
+	return size;
+}
+
 /* ----------------------------------------------------------------
  *		ExecSortEstimate
  *
- *		Estimate space required to propagate sort statistics.
+ *		Estimate space required to propagate sort statistics, and, for a
+ *		parallel-aware sort, to coordinate the sort.
  * ----------------------------------------------------------------
  */
 void
@@ -417,12 +616,25 @@ ExecSortEstimate(SortState *node, ParallelContext *pcxt)
 {
 	Size		size;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need anything if there are no workers */
+	if (pcxt->nworkers == 0)
 		return;
 
-	size = mul_size(pcxt->nworkers, sizeof(TuplesortInstrumentation));
-	size = add_size(size, offsetof(SharedSortInfo, sinstrument));
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		Size		instrument_offset;
+
+		size = ExecSortSharedSize(node, pcxt, &instrument_offset);
+	}
+	else
+	{
+		/* don't need this if not instrumenting */
+		if (!node->ss.ps.instrument)
+			return;
+
+		size = mul_size(pcxt->nworkers, sizeof(TuplesortInstrumentation));
+		size = add_size(size, offsetof(SharedSortInfo, sinstrument));
+	}
 	shm_toc_estimate_chunk(&pcxt->estimator, size);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 }
@@ -430,7 +642,8 @@ ExecSortEstimate(SortState *node, ParallelContext *pcxt)
 /* ----------------------------------------------------------------
  *		ExecSortInitializeDSM
  *
- *		Initialize DSM space for sort statistics.
+ *		Initialize DSM space for sort statistics, and, for a parallel-aware
+ *		sort, for coordinating the sort.
  * ----------------------------------------------------------------
  */
 void
@@ -438,8 +651,43 @@ ExecSortInitializeDSM(SortState *node, ParallelContext *pcxt)
 {
 	Size		size;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need anything if there are no workers */
+	if (pcxt->nworkers == 0)
+		return;
+
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		ParallelSortState *pstate;
+		Size		instrument_offset;
+
+		size = ExecSortSharedSize(node, pcxt, &instrument_offset);
+		pstate = shm_toc_allocate(pcxt->toc, size);
+
+		pstate->coordinated = ExecSortCanCoordinate(node);
+		SpinLockInit(&pstate->mutex);
+		pstate->nworkersdone = 0;
+		ConditionVariableInit(&pstate->workersdonecv);
+		pstate->instrument_offset = instrument_offset;
+		tuplesort_initialize_shared(ParallelSortGetSharedsort(pstate),
+									pcxt->nworkers + 1, pcxt->seg);
+
+		if (instrument_offset != 0)
+		{
+			node->shared_info = (SharedSortInfo *)
+				((char *) pstate + instrument_offset);
+			/* ensure any unfilled slots will contain zeroes */
+			memset(node->shared_info, 0, size - instrument_offset);
+			node->shared_info->num_workers = pcxt->nworkers;
+		}
+
+		shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, pstate);
+		node->pstate = pstate;
+		node->pcxt = pcxt;
+		return;
+	}
+
+	/* don't need this if not instrumenting */
+	if (!node->ss.ps.instrument)
 		return;
 
 	size = offsetof(SharedSortInfo, sinstrument)
@@ -452,17 +700,56 @@ ExecSortInitializeDSM(SortState *node, ParallelContext *pcxt)
 				   node->shared_info);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecSortReInitializeDSM
+ *
+ *		Reset shared state of a parallel-aware sort before a rescan.
+ * ----------------------------------------------------------------
+ */
+void
+ExecSortReInitializeDSM(SortState *node, ParallelContext *pcxt)
+{
+	ParallelSortState *pstate = node->pstate;
+
+	if (pstate == NULL)
+		return;
+
+	/* the previous result must be released before its files are removed */
+	if (node->tuplesortstate != NULL)
+	{
+		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
+		node->tuplesortstate = NULL;
+	}
+
+	tuplesort_reset_shared(ParallelSortGetSharedsort(pstate));
+	pstate->nworkersdone = 0;
+	pstate->coordinated = ExecSortCanCoordinate(node);
+}
+
 /* ----------------------------------------------------------------
  *		ExecSortInitializeWorker
  *
- *		Attach worker to DSM space for sort statistics.
+ *		Attach worker to DSM space for sort statistics and coordination.
  * ----------------------------------------------------------------
  */
 void
 ExecSortInitializeWorker(SortState *node, ParallelWorkerContext *pwcxt)
 {
-	node->shared_info =
-		shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		ParallelSortState *pstate;
+
+		pstate = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id,
+								false);
+		tuplesort_attach_shared(ParallelSortGetSharedsort(pstate), pwcxt->seg);
+		if (pstate->instrument_offset != 0)
+			node->shared_info = (SharedSortInfo *)
+				((char *) pstate + pstate->instrument_offset);
+		node->pstate = pstate;
+	}
+	else
+		node->shared_info =
+			shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
 	node->am_worker = true;
 }
 
@@ -155,6 +155,22 @@ typedef struct WindowStatePerAggData
 
 	int64		transValueCount;	/* number of currently-aggregated rows */
 
+	/*
+	 * Aggregates like min() and max(), which have a sort operator but no
+	 * inverse transition function, can still remove rows from the frame head
+	 * if we keep every input value that could yet become the result.  Those
+	 * values form a deque ordered by row position, in which each value is
+	 * "better" per sortopfn than all values after it; the first entry is the
+	 * current result.  The arrays live in the private aggcontext.
+	 */
+	bool		use_deque;		/* use the deque instead of the transfn? */
+	FmgrInfo	sortopfn;		/* lookup data for the aggregate's sortop */
+	Datum	   *dequeValues;	/* candidate result values */
+	int64	   *dequePos;		/* row positions of the candidates */
+	int			dequeStart;		/* index of first live entry */
+	int			dequeEnd;		/* index just past last live entry */
+	int			dequeSize;		/* allocated length of the arrays */
+
 	/* Data local to eval_windowaggregates() */
 	bool		restart;		/* need to restart this agg in this cycle? */
 } WindowStatePerAggData;
@@ -168,6 +184,11 @@ static void advance_windowaggregate(WindowAggState *winstate,
 static bool advance_windowaggregate_base(WindowAggState *winstate,
 										 WindowStatePerFunc perfuncstate,
 										 WindowStatePerAgg peraggstate);
+static void advance_windowaggregate_deque(WindowAggState *winstate,
+										  WindowStatePerFunc perfuncstate,
+										  WindowStatePerAgg peraggstate);
+static void advance_windowaggregate_deque_base(WindowAggState *winstate,
+											   WindowStatePerAgg peraggstate);
 static void finalize_windowaggregate(WindowAggState *winstate,
 									 WindowStatePerFunc perfuncstate,
 									 WindowStatePerAgg peraggstate,
@@ -218,6 +239,15 @@ initialize_windowaggregate(WindowAggState *winstate,
 	if (peraggstate->aggcontext != winstate->aggcontext)
 		MemoryContextReset(peraggstate->aggcontext);
 
+	if (peraggstate->use_deque)
+	{
+		peraggstate->dequeValues = NULL;
+		peraggstate->dequePos = NULL;
+		peraggstate->dequeStart = 0;
+		peraggstate->dequeEnd = 0;
+		peraggstate->dequeSize = 0;
+	}
+
 	if (peraggstate->initValueIsNull)
 		peraggstate->transValue = peraggstate->initValue;
 	else
@@ -253,6 +283,12 @@ advance_windowaggregate(WindowAggState *winstate,
 	ExprContext *econtext = winstate->tmpcontext;
 	ExprState  *filter = wfuncstate->aggfilter;
 
+	if (peraggstate->use_deque)
+	{
+		advance_windowaggregate_deque(winstate, perfuncstate, peraggstate);
+		return;
+	}
+
 	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
 
 	/* Skip anything FILTERed out */
@@ -430,6 +466,12 @@ advance_windowaggregate_base(WindowAggState *winstate,
 	ExprContext *econtext = winstate->tmpcontext;
 	ExprState  *filter = wfuncstate->aggfilter;
 
+	if (peraggstate->use_deque)
+	{
+		advance_windowaggregate_deque_base(winstate, peraggstate);
+		return true;
+	}
+
 	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
 
 	/* Skip anything FILTERed out */
@@ -574,6 +616,159 @@ advance_windowaggregate_base(WindowAggState *winstate,
 	return true;
 }
 
+/*
+ * Make the transition value reflect the head of the deque.  The value is
+ * not copied; it stays owned by the deque.
+ */
+static inline void
+windowaggregate_deque_set_result(WindowStatePerAgg peraggstate)
+{
+	if (peraggstate->dequeStart < peraggstate->dequeEnd)
+	{
+		peraggstate->transValue =
+			peraggstate->dequeValues[peraggstate->dequeStart];
+		peraggstate->transValueIsNull = false;
+	}
+	else
+	{
+		peraggstate->transValue = (Datum) 0;
+		peraggstate->transValueIsNull = true;
+	}
+	peraggstate->transValueCount =
+		peraggstate->dequeEnd - peraggstate->dequeStart;
+}
+
+/*
+ * advance_windowaggregate_deque
+ * Add the current row to an aggregate evaluated with a deque
+ *
+ * Entries at the tail that are no better than the new value can never be the
+ * result again, since the new value will stay in the frame at least as long
+ * as they do; so we remove them before appending the new value.  Each row is
+ * thus appended and removed at most once.
+ */
+static void
+advance_windowaggregate_deque(WindowAggState *winstate,
+							  WindowStatePerFunc perfuncstate,
+							  WindowStatePerAgg peraggstate)
+{
+	WindowFuncExprState *wfuncstate = perfuncstate->wfuncstate;
+	ExprContext *econtext = winstate->tmpcontext;
+	ExprState  *filter = wfuncstate->aggfilter;
+	MemoryContext oldContext;
+	Datum		value;
+	bool		isnull;
+
+	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	/* Skip anything FILTERed out */
+	if (filter)
+	{
+		Datum		res = ExecEvalExpr(filter, econtext, &isnull);
+
+		if (isnull || !DatumGetBool(res))
+		{
+			MemoryContextSwitchTo(oldContext);
+			return;
+		}
+	}
+
+	value = ExecEvalExpr((ExprState *) linitial(wfuncstate->args), econtext,
+						 &isnull);
+
+	/* The transfn is strict, so NULL inputs are ignored */
+	if (isnull)
+	{
+		MemoryContextSwitchTo(oldContext);
+		return;
+	}
+
+	while (peraggstate->dequeEnd > peraggstate->dequeStart)
+	{
+		int			last = peraggstate->dequeEnd - 1;
+
+		if (DatumGetBool(FunctionCall2Coll(&peraggstate->sortopfn,
+										   perfuncstate->winCollation,
+										   peraggstate->dequeValues[last],
+										   value)))
+			break;
+		if (!peraggstate->transtypeByVal)
+			pfree(DatumGetPointer(peraggstate->dequeValues[last]));
+		peraggstate->dequeEnd--;
+	}
+
+	MemoryContextSwitchTo(peraggstate->aggcontext);
+
+	/*
+	 * Make room for the new entry, by sliding the live entries down if at
+	 * least half of the arrays are unused, else by enlarging them.
+	 */
+	if (peraggstate->dequeEnd >= peraggstate->dequeSize)
+	{
+		int			nlive = peraggstate->dequeEnd - peraggstate->dequeStart;
+
+		if (peraggstate->dequeSize == 0)
+		{
+			peraggstate->dequeSize = 64;
+			peraggstate->dequeValues = palloc_array(Datum,
+													peraggstate->dequeSize);
+			peraggstate->dequePos = palloc_array(int64,
+												 peraggstate->dequeSize);
+		}
+		else if (nlive <= peraggstate->dequeSize / 2)
+		{
+			memmove(peraggstate->dequeValues,
+					peraggstate->dequeValues + peraggstate->dequeStart,
+					nlive * sizeof(Datum));
+			memmove(peraggstate->dequePos,
+					peraggstate->dequePos + peraggstate->dequeStart,
+					nlive * sizeof(int64));
+			peraggstate->dequeStart = 0;
+			peraggstate->dequeEnd = nlive;
+		}
+		else
+		{
+			peraggstate->dequeSize *= 2;
+			peraggstate->dequeValues = repalloc_array(peraggstate->dequeValues,
+													  Datum,
+													  peraggstate->dequeSize);
+			peraggstate->dequePos = repalloc_array(peraggstate->dequePos,
+												   int64,
+												   peraggstate->dequeSize);
+		}
+	}
+
+	peraggstate->dequeValues[peraggstate->dequeEnd] =
+		datumCopy(value, peraggstate->transtypeByVal, peraggstate->transtypeLen);
+	peraggstate->dequePos[peraggstate->dequeEnd] = winstate->aggregatedupto;
+	peraggstate->dequeEnd++;
+
+	MemoryContextSwitchTo(oldContext);
+
+	windowaggregate_deque_set_result(peraggstate);
+}
+
+/*
+ * advance_windowaggregate_deque_base
+ * Remove the row at aggregatedbase from an aggregate evaluated with a deque
+ *
+ * The row's value is in the deque only if it was still a candidate, in which
+ * case it must be the first entry.
+ */
+static void
+advance_windowaggregate_deque_base(WindowAggState *winstate,
+								   WindowStatePerAgg peraggstate)
+{
+	if (peraggstate->dequeStart < peraggstate->dequeEnd &&
+		peraggstate->dequePos[peraggstate->dequeStart] <= winstate->aggregatedbase)
+	{
+		if (!peraggstate->transtypeByVal)
+			pfree(DatumGetPointer(peraggstate->dequeValues[peraggstate->dequeStart]));
+		peraggstate->dequeStart++;
+		windowaggregate_deque_set_result(peraggstate);
+	}
+}
+
 /*
  * finalize_windowaggregate
  * parallel to finalize_aggregate in nodeAgg.c
@@ -771,7 +966,7 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * We restart the aggregation:
 	 *	 - if we're processing the first row in the partition, or
 	 *	 - if the frame's head moved and we cannot use an inverse
-	 *	   transition function, or
+	 *	   transition function or a deque, or
 	 *	 - we have an EXCLUSION clause, or
 	 *	 - if the new frame doesn't overlap the old one
 	 *
@@ -786,7 +981,8 @@ eval_windowaggregates(WindowAggState *winstate)
 		peraggstate = &winstate->peragg[i];
 		if (winstate->currentpos == 0 ||
 			(winstate->aggregatedbase != winstate->frameheadpos &&
-			 !OidIsValid(peraggstate->invtransfn_oid)) ||
+			 !OidIsValid(peraggstate->invtransfn_oid) &&
+			 !peraggstate->use_deque) ||
 			(winstate->frameOptions & FRAMEOPTION_EXCLUSION) ||
 			winstate->aggregatedupto <= winstate->frameheadpos)
 		{
@@ -2991,6 +3187,29 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 				(errcode(ERRCODE_INVALID_FUNCTION_DEFINITION),
 				 errmsg("strictness of aggregate's forward and inverse transition functions must match")));
 
+	/*
+	 * If the frame head can move but we have no inverse transition function,
+	 * see whether the aggregate's result is simply its first input in the
+	 * order of its sort operator, like min() and max().  Then we can keep a
+	 * deque of candidate values instead of restarting whenever the head
+	 * moves.  As above, don't do so if that could change the results.
+	 */
+	peraggstate->use_deque = false;
+	if (!OidIsValid(invtransfn_oid) &&
+		OidIsValid(aggform->aggsortop) &&
+		!(winstate->frameOptions & (FRAMEOPTION_START_UNBOUNDED_PRECEDING |
+									FRAMEOPTION_EXCLUSION)) &&
+		numArguments == 1 &&
+		!OidIsValid(finalfn_oid) &&
+		peraggstate->transfn.fn_strict &&
+		peraggstate->initValueIsNull &&
+		!contain_volatile_functions((Node *) wfunc) &&
+		!contain_subplans((Node *) wfunc))
+	{
+		fmgr_info(get_opcode(aggform->aggsortop), &peraggstate->sortopfn);
+		peraggstate->use_deque = true;
+	}
+
 	/*
 	 * Moving aggregates use their own aggcontext.
 	 *
@@ -3005,7 +3224,7 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	 * they have historically been for plain aggregates, but that seems grotty
 	 * and likely to lead to memory leaks.
 	 */
-	if (OidIsValid(invtransfn_oid))
+	if (OidIsValid(invtransfn_oid) || peraggstate->use_deque)
 		peraggstate->aggcontext =
 			AllocSetContextCreate(CurrentMemoryContext,
 								  "WindowAgg Per Aggregate",
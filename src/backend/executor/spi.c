@@ -2677,6 +2677,8 @@ _SPI_execute_plan(SPIPlanPtr plan, const SPIExecuteOptions *options,
 										0);
 				res = _SPI_pquery(qdesc, fire_triggers,
 								  canSetTag ? options->tcount : 0);
+				if (cplan && canSetTag)
+					ReportCachedPlanRows(cplan, stmt, _SPI_current->processed);
 				FreeQueryDesc(qdesc);
 			}
 			else
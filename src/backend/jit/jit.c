@@ -30,12 +30,15 @@
 
 /* GUCs */
 bool		jit_enabled = true;
+bool		jit_cache = false;
+int			jit_cache_size = 65536;
 char	   *jit_provider = NULL;
 bool		jit_debugging_support = false;
 bool		jit_dump_bitcode = false;
 bool		jit_expressions = true;
 bool		jit_profiling_support = false;
 bool		jit_tuple_deforming = true;
+int			jit_tier_up_threshold = 0;
 double		jit_above_cost = 100000;
 double		jit_inline_above_cost = 500000;
 double		jit_optimize_above_cost = 500000;
@@ -130,6 +133,19 @@ jit_reset_after_error(void)
 		provider.reset_after_error();
 }
 
+/*
+ * Remove all cached JIT code, see llvmjit_cache.c.  This is called at server
+ * start, so the cache never contains code from a different server binary.
+ */
+void
+RemoveJitCacheFiles(void)
+{
+	struct stat st;
+
+	if (stat(PG_JIT_CACHE_DIR, &st) == 0 && S_ISDIR(st.st_mode))
+		(void) rmtree(PG_JIT_CACHE_DIR, false);
+}
+
 /*
  * Release resources required by one JIT context.
  */
@@ -149,6 +165,23 @@ jit_release_context(JitContext *context)
  */
 bool
 jit_compile_expr(struct ExprState *state)
+{
+	if (!jit_expr_wanted(state))
+		return false;
+
+	/* this also takes !jit_enabled into account */
+	if (provider_init())
+		return provider.compile_expr(state);
+
+	return false;
+}
+
+/*
+ * Would jit_compile_expr() attempt to compile the expression?  This doesn't
+ * load the provider, so it can be checked cheaply.
+ */
+bool
+jit_expr_wanted(struct ExprState *state)
 {
 	/*
 	 * We can easily create a one-off context for functions without an
@@ -170,11 +203,7 @@ jit_compile_expr(struct ExprState *state)
 	if (!(state->parent->state->es_jit_flags & PGJIT_EXPR))
 		return false;
 
-	/* this also takes !jit_enabled into account */
-	if (provider_init())
-		return provider.compile_expr(state);
-
-	return false;
+	return true;
 }
 
 /* Aggregate JIT instrumentation information */
@@ -182,6 +211,8 @@ void
 InstrJitAgg(JitInstrumentation *dst, JitInstrumentation *add)
 {
 	dst->created_functions += add->created_functions;
+	dst->cache_hits += add->cache_hits;
+	dst->cache_misses += add->cache_misses;
 	INSTR_TIME_ADD(dst->generation_counter, add->generation_counter);
 	INSTR_TIME_ADD(dst->deform_counter, add->deform_counter);
 	INSTR_TIME_ADD(dst->inlining_counter, add->inlining_counter);
@@ -118,6 +118,7 @@ static void llvm_session_initialize(void);
 static void llvm_shutdown(int code, Datum arg);
 static void llvm_compile_module(LLVMJitContext *context);
 static void llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module);
+static void llvm_inline_and_optimize(LLVMJitContext *context);
 
 static void llvm_create_types(void);
 static void llvm_set_target(void);
@@ -726,25 +727,13 @@ llvm_optimize_module(LLVMJitContext *context, LLVMModuleRef module)
 }
 
 /*
- * Emit code for the currently pending module.
+ * Inline and optimize the currently pending module.
  */
 static void
-llvm_compile_module(LLVMJitContext *context)
+llvm_inline_and_optimize(LLVMJitContext *context)
 {
-	LLVMJitHandle *handle;
-	MemoryContext oldcontext;
 	instr_time	starttime;
 	instr_time	endtime;
-#if LLVM_VERSION_MAJOR > 11
-	LLVMOrcLLJITRef compile_orc;
-#else
-	LLVMOrcJITStackRef compile_orc;
-#endif
-
-	if (context->base.flags & PGJIT_OPT3)
-		compile_orc = llvm_opt3_orc;
-	else
-		compile_orc = llvm_opt0_orc;
 
 	/* perform inlining */
 	if (context->base.flags & PGJIT_INLINE)
@@ -785,6 +774,69 @@ llvm_compile_module(LLVMJitContext *context)
 		LLVMWriteBitcodeToFile(context->module, filename);
 		pfree(filename);
 	}
+}
+
+/*
+ * Emit code for the currently pending module.
+ */
+static void
+llvm_compile_module(LLVMJitContext *context)
+{
+	LLVMJitHandle *handle;
+	MemoryContext oldcontext;
+	instr_time	starttime;
+	instr_time	endtime;
+	List	   *cache_names = NIL;
+	char		cache_key[LLVM_CACHE_KEY_LEN + 1];
+	bool		cache_hit = false;
+#if LLVM_VERSION_MAJOR > 11
+	LLVMOrcLLJITRef compile_orc;
+#else
+	LLVMOrcJITStackRef compile_orc;
+#endif
+
+	if (context->base.flags & PGJIT_OPT3)
+		compile_orc = llvm_opt3_orc;
+	else
+		compile_orc = llvm_opt0_orc;
+
+	/*
+	 * Look for an already optimized version of the module in the cache.  The
+	 * time spent on that is accounted as optimization time.
+	 */
+	if (jit_cache)
+	{
+		LLVMModuleRef cached_module;
+
+		INSTR_TIME_SET_CURRENT(starttime);
+		cache_names = llvm_cache_canonicalize(context->module);
+		llvm_cache_compute_key(context->module, context->base.flags,
+							   cache_key);
+		if (llvm_cache_load(LLVMGetModuleContext(context->module),
+							cache_key, &cached_module))
+		{
+			LLVMDisposeModule(context->module);
+			context->module = cached_module;
+			cache_hit = true;
+			context->base.instr.cache_hits++;
+		}
+		else
+			context->base.instr.cache_misses++;
+		INSTR_TIME_SET_CURRENT(endtime);
+		INSTR_TIME_ACCUM_DIFF(context->base.instr.optimization_counter,
+							  endtime, starttime);
+	}
+
+	if (!cache_hit)
+	{
+		llvm_inline_and_optimize(context);
+
+		if (jit_cache)
+			llvm_cache_store(context->module, cache_key);
+	}
+
+	if (jit_cache)
+		llvm_cache_restore_names(context->module, cache_names);
 
 	handle = (LLVMJitHandle *)
 		MemoryContextAlloc(TopMemoryContext, sizeof(LLVMJitHandle));
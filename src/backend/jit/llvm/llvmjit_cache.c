@@ -0,0 +1,356 @@
+/*-------------------------------------------------------------------------
+ *
+ * llvmjit_cache.c
+ *	  Cache of optimized JIT modules, shared by all backends
+ *
+ * Inlining and optimizing a module is usually by far the most expensive
+ * part of JIT compilation.  With jit_cache enabled, the module is written
+ * out as bitcode into PG_JIT_CACHE_DIR once it has been optimized, keyed by
+ * a hash of the module as it was generated.  Later compilations of an
+ * identical module, in any backend, load the optimized module from there
+ * instead, and only code emission is repeated.
+ *
+ * Generated code refers to a lot of executor state by address, so modules
+ * are only identical when those addresses are too.  Since the key covers
+ * the complete module, a cache hit can never produce different code than a
+ * fresh compilation would.  The names of the functions defined in a module
+ * are derived from per-backend counters, though, so they are replaced by
+ * canonical names while the key is computed, and restored afterwards.
+ *
+ * The cache directory is emptied at server start, see RemoveJitCacheFiles(),
+ * so it never contains code built by a different server binary or from
+ * different inlining bitcode.  When it grows beyond jit_cache_size, the
+ * least recently used files are removed.
+ *
+ * Copyright (c) 2016-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/jit/llvm/llvmjit_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Core.h>
+
+#include "common/cryptohash.h"
+#include "common/int.h"
+#include "common/sha2.h"
+#include "jit/llvmjit.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/builtins.h"
+
+/* prefix of the canonical names given to the functions of a module */
+#define LLVM_CACHE_FUNC_PREFIX "pgjit_cached_"
+
+typedef struct LLVMCacheFile
+{
+	char		name[LLVM_CACHE_KEY_LEN + 16];
+	off_t		size;
+	time_t		mtime;
+} LLVMCacheFile;
+
+static void llvm_cache_evict(void);
+static int	llvm_cache_file_cmp(const void *a, const void *b);
+
+/*
+ * Give the functions defined in the module canonical names.  Returns the
+ * original names, for llvm_cache_restore_names().
+ */
+List *
+llvm_cache_canonicalize(LLVMModuleRef mod)
+{
+	List	   *names = NIL;
+	LLVMValueRef func;
+
+	for (func = LLVMGetFirstFunction(mod);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		const char *name;
+		size_t		len;
+		char		newname[NAMEDATALEN];
+
+		if (LLVMIsDeclaration(func))
+			continue;
+
+		name = LLVMGetValueName2(func, &len);
+		names = lappend(names, pnstrdup(name, len));
+
+		snprintf(newname, sizeof(newname), LLVM_CACHE_FUNC_PREFIX "%d",
+				 list_length(names) - 1);
+		LLVMSetValueName2(func, newname, strlen(newname));
+	}
+
+	return names;
+}
+
+/*
+ * Undo llvm_cache_canonicalize(), in the module as optimized.
+ */
+void
+llvm_cache_restore_names(LLVMModuleRef mod, List *names)
+{
+	LLVMValueRef func;
+	size_t		prefixlen = strlen(LLVM_CACHE_FUNC_PREFIX);
+
+	for (func = LLVMGetFirstFunction(mod);
+		 func != NULL;
+		 func = LLVMGetNextFunction(func))
+	{
+		const char *name;
+		size_t		len;
+		int			n;
+
+		name = LLVMGetValueName2(func, &len);
+		if (len <= prefixlen ||
+			strncmp(name, LLVM_CACHE_FUNC_PREFIX, prefixlen) != 0)
+			continue;
+
+		n = atoi(name + prefixlen);
+		if (n >= 0 && n < list_length(names))
+		{
+			const char *orig = list_nth(names, n);
+
+			LLVMSetValueName2(func, orig, strlen(orig));
+		}
+	}
+}
+
+/*
+ * Compute the cache key of the given (canonicalized) module, as a string of
+ * LLVM_CACHE_KEY_LEN hex digits.
+ */
+void
+llvm_cache_compute_key(LLVMModuleRef mod, int jitFlags, char *key)
+{
+	LLVMMemoryBufferRef buf;
+	pg_cryptohash_ctx *ctx;
+	uint8		digest[PG_SHA256_DIGEST_LENGTH];
+	uint32		flags;
+
+	StaticAssertStmt(LLVM_CACHE_KEY_LEN == 2 * PG_SHA256_DIGEST_LENGTH,
+					 "LLVM_CACHE_KEY_LEN doesn't match SHA-256 digest length");
+
+	/* the optimized module depends on the optimization settings, too */
+	flags = jitFlags & (PGJIT_OPT3 | PGJIT_INLINE);
+
+	buf = LLVMWriteBitcodeToMemoryBuffer(mod);
+
+	ctx = pg_cryptohash_create(PG_SHA256);
+	if (pg_cryptohash_init(ctx) < 0 ||
+		pg_cryptohash_update(ctx, (uint8 *) &flags, sizeof(flags)) < 0 ||
+		pg_cryptohash_update(ctx, (uint8 *) LLVMGetBufferStart(buf),
+							 LLVMGetBufferSize(buf)) < 0 ||
+		pg_cryptohash_final(ctx, digest, sizeof(digest)) < 0)
+		elog(ERROR, "could not compute JIT cache key: %s",
+			 pg_cryptohash_error(ctx));
+	pg_cryptohash_free(ctx);
+
+	LLVMDisposeMemoryBuffer(buf);
+
+	hex_encode((char *) digest, sizeof(digest), key);
+	key[LLVM_CACHE_KEY_LEN] = '\0';
+}
+
+/*
+ * Look up the optimized module with the given key.  If found, it's loaded
+ * into *mod, in the given LLVM context.
+ */
+bool
+llvm_cache_load(LLVMContextRef lc, const char *key, LLVMModuleRef *mod)
+{
+	char		path[MAXPGPATH];
+	LLVMMemoryBufferRef buf;
+	char	   *msg;
+
+	snprintf(path, sizeof(path), "%s/%s.bc", PG_JIT_CACHE_DIR, key);
+
+	if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buf, &msg))
+	{
+		/* most likely, it's just not there */
+		LLVMDisposeMessage(msg);
+		return false;
+	}
+
+	if (LLVMParseBitcodeInContext2(lc, buf, mod))
+	{
+		LLVMDisposeMemoryBuffer(buf);
+		ereport(LOG,
+				(errmsg("removing invalid JIT cache file \"%s\"", path)));
+		(void) unlink(path);
+		return false;
+	}
+	LLVMDisposeMemoryBuffer(buf);
+
+	/* remember that the file was used, for llvm_cache_evict() */
+	(void) utime(path, NULL);
+
+	return true;
+}
+
+/*
+ * Store the optimized module under the given key.
+ *
+ * Failing to do so is not an error, the module just won't be cached.
+ */
+void
+llvm_cache_store(LLVMModuleRef mod, const char *key)
+{
+	char		path[MAXPGPATH];
+	char		tmppath[MAXPGPATH];
+	LLVMMemoryBufferRef buf;
+	const char *data;
+	size_t		size;
+	int			fd;
+
+	if (MakePGDirectory(PG_JIT_CACHE_DIR) < 0 && errno != EEXIST)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m",
+						PG_JIT_CACHE_DIR)));
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s.bc", PG_JIT_CACHE_DIR, key);
+	snprintf(tmppath, sizeof(tmppath), "%s/%s.bc.%d.tmp",
+			 PG_JIT_CACHE_DIR, key, MyProcPid);
+
+	fd = OpenTransientFile(tmppath, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmppath)));
+		return;
+	}
+
+	buf = LLVMWriteBitcodeToMemoryBuffer(mod);
+	data = LLVMGetBufferStart(buf);
+	size = LLVMGetBufferSize(buf);
+
+	errno = 0;
+	if (write(fd, data, size) != size)
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmppath)));
+		LLVMDisposeMemoryBuffer(buf);
+		CloseTransientFile(fd);
+		(void) unlink(tmppath);
+		return;
+	}
+	LLVMDisposeMemoryBuffer(buf);
+
+	if (CloseTransientFile(fd) != 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", tmppath)));
+		(void) unlink(tmppath);
+		return;
+	}
+
+	/*
+	 * Rename into place, so that nobody reads a partially written file.
+	 * There's no need to make it durable, the cache is emptied at server
+	 * start anyway.
+	 */
+	if (rename(tmppath, path) < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						tmppath, path)));
+		(void) unlink(tmppath);
+		return;
+	}
+
+	llvm_cache_evict();
+}
+
+/*
+ * Remove the least recently used files, until the cache fits into
+ * jit_cache_size.
+ */
+static void
+llvm_cache_evict(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	LLVMCacheFile *files;
+	int			nfiles = 0;
+	int			maxfiles = 64;
+	uint64		total = 0;
+	uint64		limit = (uint64) jit_cache_size * 1024;
+
+	files = palloc(sizeof(LLVMCacheFile) * maxfiles);
+
+	dir = AllocateDir(PG_JIT_CACHE_DIR);
+	while ((de = ReadDirExtended(dir, PG_JIT_CACHE_DIR, LOG)) != NULL)
+	{
+		char		path[MAXPGPATH];
+		struct stat st;
+		size_t		len = strlen(de->d_name);
+
+		/* only consider complete cache files */
+		if (len < 3 || len >= sizeof(files[0].name) ||
+			strcmp(de->d_name + len - 3, ".bc") != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", PG_JIT_CACHE_DIR, de->d_name);
+		if (stat(path, &st) < 0)
+			continue;			/* concurrently removed */
+
+		if (nfiles >= maxfiles)
+		{
+			maxfiles *= 2;
+			files = repalloc(files, sizeof(LLVMCacheFile) * maxfiles);
+		}
+		strlcpy(files[nfiles].name, de->d_name, sizeof(files[nfiles].name));
+		files[nfiles].size = st.st_size;
+		files[nfiles].mtime = st.st_mtime;
+		nfiles++;
+		total += st.st_size;
+	}
+	FreeDir(dir);
+
+	if (total > limit)
+	{
+		qsort(files, nfiles, sizeof(LLVMCacheFile), llvm_cache_file_cmp);
+
+		for (int i = 0; i < nfiles && total > limit; i++)
+		{
+			char		path[MAXPGPATH];
+
+			snprintf(path, sizeof(path), "%s/%s",
+					 PG_JIT_CACHE_DIR, files[i].name);
+			if (unlink(path) == 0)
+				total -= files[i].size;
+		}
+	}
+
+	pfree(files);
+}
+
+/* qsort comparator, ordering cache files from least recently used */
+static int
+llvm_cache_file_cmp(const void *a, const void *b)
+{
+	const LLVMCacheFile *fa = (const LLVMCacheFile *) a;
+	const LLVMCacheFile *fb = (const LLVMCacheFile *) b;
+
+	return pg_cmp_s64(fa->mtime, fb->mtime);
+}
@@ -9,16 +9,21 @@
  * supported: the hash table never becomes smaller.
  *
  * To deal with concurrency, it has a fixed size set of partitions, each of
- * which is independently locked.  Each bucket maps to a partition; so insert,
- * find and iterate operations normally only acquire one lock.  Therefore,
- * good concurrency is achieved whenever such operations don't collide at the
- * lock partition level.  However, when a resize operation begins, all
- * partition locks must be acquired simultaneously for a brief period.  This
- * is only expected to happen a small number of times until a stable size is
- * found, since growth is geometric.
+ * which is independently locked.  Each partition has its own array of
+ * buckets, so insert, find and iterate operations only acquire one lock.
+ * Therefore, good concurrency is achieved whenever such operations don't
+ * collide at the lock partition level.  A partition that becomes too full
+ * doubles its own bucket array while holding only its own lock; the other
+ * partitions are not disturbed, and grow when they become full themselves.
  *
- * Future versions may support iterators and incremental resizing; for now
- * the implementation is minimalist.
+ * dshash_find_copy() looks up an entry without taking any lock at all.  Each
+ * partition has a change counter that is odd while the partition is locked
+ * exclusively, in the manner of a seqlock.  A lock-free reader copies the
+ * entry into local memory and keeps the copy only if the counter did not
+ * change meanwhile.  Items and bucket arrays may be freed under a reader's
+ * feet, but DSA memory stays mapped in the reader's process, and pointers
+ * are only followed after checking that they lie within a mapped segment;
+ * anything read from freed memory is then discarded by the counter check.
  *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -62,10 +67,16 @@ struct dshash_table_item
 /* A magic value used to identify our hash tables. */
 #define DSHASH_MAGIC 0x75ff6a20
 
+/*
+ * Give up a lock-free lookup after visiting this many items.  Chains are
+ * short at our load factor; a longer one is probably being modified under us.
+ */
+#define DSHASH_MAX_UNLOCKED_STEPS 32
+
 /*
  * Tracking information for each lock partition.  Initially, each partition
- * corresponds to one bucket, but each time the hash table grows, the buckets
- * covered by each partition split so the number of buckets covered doubles.
+ * has one bucket, but each time the partition grows, its buckets split so
+ * the number of buckets doubles.
  *
  * We might want to add padding here so that each partition is on a different
  * cache line, but doing so would bloat this structure considerably.
@@ -73,7 +84,10 @@ struct dshash_table_item
 typedef struct dshash_partition
 {
 	LWLock		lock;			/* Protects all buckets in this partition. */
+	pg_atomic_uint32 changecount;	/* odd while locked exclusively */
 	size_t		count;			/* # of items in this partition's buckets */
+	size_t		size_log2;		/* log2(# of buckets in this partition) */
+	dsa_pointer buckets;		/* this partition's bucket array */
 } dshash_partition;
 
 /*
@@ -86,15 +100,6 @@ typedef struct dshash_table_control
 	uint32		magic;
 	dshash_partition partitions[DSHASH_NUM_PARTITIONS];
 	int			lwlock_tranche_id;
-
-	/*
-	 * The following members are written to only when ALL partitions locks are
-	 * held.  They can be read when any one partition lock is held.
-	 */
-
-	/* Number of buckets expressed as power of 2 (8 = 256 buckets). */
-	size_t		size_log2;		/* log2(number of buckets) */
-	dsa_pointer buckets;		/* current bucket array */
 } dshash_table_control;
 
 /*
@@ -106,8 +111,10 @@ struct dshash_table
 	dshash_parameters params;	/* Parameters. */
 	void	   *arg;			/* User-supplied data pointer. */
 	dshash_table_control *control;	/* Control object in DSM. */
-	dsa_pointer *buckets;		/* Current bucket pointers in DSM. */
-	size_t		size_log2;		/* log2(number of buckets) */
+	/* Bucket arrays of each partition, valid while it is locked. */
+	dsa_pointer *buckets[DSHASH_NUM_PARTITIONS];
+	size_t		size_log2[DSHASH_NUM_PARTITIONS];
+	char	   *scratch;		/* Item copy made by dshash_find_copy(). */
 };
 
 /* Given a pointer to an item, find the entry (user data) it holds. */
@@ -119,54 +126,56 @@ struct dshash_table
 	((dshash_table_item *)((char *)(entry) -							\
 							 MAXALIGN(sizeof(dshash_table_item))))
 
-/* How many resize operations (bucket splits) have there been? */
-#define NUM_SPLITS(size_log2)					\
-	(size_log2 - DSHASH_NUM_PARTITIONS_LOG2)
+/* The size of an item holding an entry. */
+#define ITEM_SIZE(hash_table) \
+	(MAXALIGN(sizeof(dshash_table_item)) + (hash_table)->params.entry_size)
 
 /* How many buckets are there in a given size? */
 #define NUM_BUCKETS(size_log2)		\
 	(((size_t) 1) << (size_log2))
 
-/* How many buckets are there in each partition at a given size? */
-#define BUCKETS_PER_PARTITION(size_log2)		\
-	(((size_t) 1) << NUM_SPLITS(size_log2))
-
 /* Max entries before we need to grow.  Half + quarter = 75% load factor. */
-#define MAX_COUNT_PER_PARTITION(hash_table)				\
-	(BUCKETS_PER_PARTITION(hash_table->size_log2) / 2 + \
-	 BUCKETS_PER_PARTITION(hash_table->size_log2) / 4)
+#define MAX_COUNT_FOR_SIZE(size_log2)				\
+	(NUM_BUCKETS(size_log2) / 2 + NUM_BUCKETS(size_log2) / 4)
+
+/* The hash bits below the partition bits select a bucket within it. */
+#define MAX_PARTITION_SIZE_LOG2 \
+	((sizeof(dshash_hash) * CHAR_BIT) - DSHASH_NUM_PARTITIONS_LOG2)
 
 /* Choose partition based on the highest order bits of the hash. */
 #define PARTITION_FOR_HASH(hash)										\
 	(hash >> ((sizeof(dshash_hash) * CHAR_BIT) - DSHASH_NUM_PARTITIONS_LOG2))
 
 /*
- * Find the bucket index for a given hash and table size.  Each time the table
- * doubles in size, the appropriate bucket for a given hash value doubles and
- * possibly adds one, depending on the newly revealed bit, so that all buckets
- * are split.
+ * Find the bucket index within a partition for a given hash and partition
+ * size.  The bits just below those that chose the partition are used, so
+ * that each time the partition doubles in size, the appropriate bucket for a
+ * given hash value doubles and possibly adds one, depending on the newly
+ * revealed bit, so that all buckets are split.
  */
-#define BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)		\
-	(hash >> ((sizeof(dshash_hash) * CHAR_BIT) - (size_log2)))
-
-/* The index of the first bucket in a given partition. */
-#define BUCKET_INDEX_FOR_PARTITION(partition, size_log2)	\
-	((partition) << NUM_SPLITS(size_log2))
+#define BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)					\
+	((size_log2) == 0 ? 0 :												\
+	 ((dshash_hash) ((hash) << DSHASH_NUM_PARTITIONS_LOG2)) >>			\
+	 ((sizeof(dshash_hash) * CHAR_BIT) - (size_log2)))
 
-/* Choose partition based on bucket index. */
-#define PARTITION_FOR_BUCKET_INDEX(bucket_idx, size_log2)				\
-	((bucket_idx) >> NUM_SPLITS(size_log2))
-
-/* The head of the active bucket for a given hash value (lvalue). */
-#define BUCKET_FOR_HASH(hash_table, hash)								\
-	(hash_table->buckets[												\
+/*
+ * The head of the active bucket for a given hash value (lvalue).  The
+ * partition must be locked.
+ */
+#define BUCKET_FOR_HASH(hash_table, partition, hash)					\
+	(hash_table->buckets[partition][									\
 		BUCKET_INDEX_FOR_HASH_AND_SIZE(hash,							\
-									   hash_table->size_log2)])
+									   hash_table->size_log2[partition])])
 
 static void delete_item(dshash_table *hash_table,
 						dshash_table_item *item);
-static void resize(dshash_table *hash_table, size_t new_size_log2);
-static inline void ensure_valid_bucket_pointers(dshash_table *hash_table);
+static void resize_partition(dshash_table *hash_table, size_t partition_index);
+static inline void lock_partition(dshash_table *hash_table,
+								  size_t partition_index, bool exclusive);
+static inline void unlock_partition(dshash_table *hash_table,
+									size_t partition_index);
+static inline void ensure_valid_bucket_pointers(dshash_table *hash_table,
+												size_t partition_index);
 static inline dshash_table_item *find_in_bucket(dshash_table *hash_table,
 												const void *key,
 												dsa_pointer item_pointer);
@@ -223,7 +232,10 @@ dshash_create(dsa_area *area, const dshash_parameters *params, void *arg)
 	hash_table->control->magic = DSHASH_MAGIC;
 	hash_table->control->lwlock_tranche_id = params->tranche_id;
 
-	/* Set up the array of lock partitions. */
+	/*
+	 * Set up the array of lock partitions, each with an initial array of one
+	 * bucket.
+	 */
 	{
 		dshash_partition *partitions = hash_table->control->partitions;
 		int			tranche_id = hash_table->control->lwlock_tranche_id;
@@ -232,31 +244,30 @@ dshash_create(dsa_area *area, const dshash_parameters *params, void *arg)
 		for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 		{
 			LWLockInitialize(&partitions[i].lock, tranche_id);
+			pg_atomic_init_u32(&partitions[i].changecount, 0);
 			partitions[i].count = 0;
+			partitions[i].size_log2 = 0;
+			partitions[i].buckets =
+				dsa_allocate_extended(area, sizeof(dsa_pointer),
+									  DSA_ALLOC_NO_OOM | DSA_ALLOC_ZERO);
+			if (!DsaPointerIsValid(partitions[i].buckets))
+			{
+				while (--i >= 0)
+					dsa_free(area, partitions[i].buckets);
+				dsa_free(area, control);
+				ereport(ERROR,
+						(errcode(ERRCODE_OUT_OF_MEMORY),
+						 errmsg("out of memory"),
+						 errdetail("Failed on DSA request of size %zu.",
+								   sizeof(dsa_pointer))));
+			}
+			hash_table->buckets[i] =
+				dsa_get_address(area, partitions[i].buckets);
+			hash_table->size_log2[i] = 0;
 		}
 	}
 
-	/*
-	 * Set up the initial array of buckets.  Our initial size is the same as
-	 * the number of partitions.
-	 */
-	hash_table->control->size_log2 = DSHASH_NUM_PARTITIONS_LOG2;
-	hash_table->control->buckets =
-		dsa_allocate_extended(area,
-							  sizeof(dsa_pointer) * DSHASH_NUM_PARTITIONS,
-							  DSA_ALLOC_NO_OOM | DSA_ALLOC_ZERO);
-	if (!DsaPointerIsValid(hash_table->control->buckets))
-	{
-		dsa_free(area, control);
-		ereport(ERROR,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("out of memory"),
-				 errdetail("Failed on DSA request of size %zu.",
-						   sizeof(dsa_pointer) * DSHASH_NUM_PARTITIONS)));
-	}
-	hash_table->buckets = dsa_get_address(area,
-										  hash_table->control->buckets);
-	hash_table->size_log2 = hash_table->control->size_log2;
+	hash_table->scratch = palloc(ITEM_SIZE(hash_table) + 1);
 
 	return hash_table;
 }
@@ -291,8 +302,10 @@ dshash_attach(dsa_area *area, const dshash_parameters *params,
 	 * ensure_valid_bucket_pointers(), at which time we'll be holding a
 	 * partition lock for interlocking against concurrent resizing.
 	 */
-	hash_table->buckets = NULL;
-	hash_table->size_log2 = 0;
+	memset(hash_table->buckets, 0, sizeof(hash_table->buckets));
+	memset(hash_table->size_log2, 0, sizeof(hash_table->size_log2));
+
+	hash_table->scratch = palloc(ITEM_SIZE(hash_table) + 1);
 
 	return hash_table;
 }
@@ -309,6 +322,7 @@ dshash_detach(dshash_table *hash_table)
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
 	/* The hash table may have been destroyed.  Just free local memory. */
+	pfree(hash_table->scratch);
 	pfree(hash_table);
 }
 
@@ -324,26 +338,33 @@ dshash_destroy(dshash_table *hash_table)
 {
 	size_t		size;
 	size_t		i;
+	size_t		j;
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
-	ensure_valid_bucket_pointers(hash_table);
 
-	/* Free all the entries. */
-	size = NUM_BUCKETS(hash_table->size_log2);
-	for (i = 0; i < size; ++i)
+	/* Free all the entries and bucket arrays. */
+	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 	{
-		dsa_pointer item_pointer = hash_table->buckets[i];
+		ensure_valid_bucket_pointers(hash_table, i);
 
-		while (DsaPointerIsValid(item_pointer))
+		size = NUM_BUCKETS(hash_table->size_log2[i]);
+		for (j = 0; j < size; ++j)
 		{
-			dshash_table_item *item;
-			dsa_pointer next_item_pointer;
+			dsa_pointer item_pointer = hash_table->buckets[i][j];
 
-			item = dsa_get_address(hash_table->area, item_pointer);
-			next_item_pointer = item->next;
-			dsa_free(hash_table->area, item_pointer);
-			item_pointer = next_item_pointer;
+			while (DsaPointerIsValid(item_pointer))
+			{
+				dshash_table_item *item;
+				dsa_pointer next_item_pointer;
+
+				item = dsa_get_address(hash_table->area, item_pointer);
+				next_item_pointer = item->next;
+				dsa_free(hash_table->area, item_pointer);
+				item_pointer = next_item_pointer;
+			}
 		}
+
+		dsa_free(hash_table->area, hash_table->control->partitions[i].buckets);
 	}
 
 	/*
@@ -352,10 +373,10 @@ dshash_destroy(dshash_table *hash_table)
 	 */
 	hash_table->control->magic = 0;
 
-	/* Free the active table and control object. */
-	dsa_free(hash_table->area, hash_table->control->buckets);
+	/* Free the control object. */
 	dsa_free(hash_table->area, hash_table->control->handle);
 
+	pfree(hash_table->scratch);
 	pfree(hash_table);
 }
 
@@ -399,17 +420,16 @@ dshash_find(dshash_table *hash_table, const void *key, bool exclusive)
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
-	LWLockAcquire(PARTITION_LOCK(hash_table, partition),
-				  exclusive ? LW_EXCLUSIVE : LW_SHARED);
-	ensure_valid_bucket_pointers(hash_table);
+	lock_partition(hash_table, partition, exclusive);
 
 	/* Search the active bucket. */
-	item = find_in_bucket(hash_table, key, BUCKET_FOR_HASH(hash_table, hash));
+	item = find_in_bucket(hash_table, key,
+						  BUCKET_FOR_HASH(hash_table, partition, hash));
 
 	if (!item)
 	{
 		/* Not found. */
-		LWLockRelease(PARTITION_LOCK(hash_table, partition));
+		unlock_partition(hash_table, partition);
 		return NULL;
 	}
 	else
@@ -419,6 +439,108 @@ dshash_find(dshash_table *hash_table, const void *key, bool exclusive)
 	}
 }
 
+/*
+ * Look up an entry without taking a lock, and copy it to *entry, which must
+ * have room for params.entry_size bytes.  Returns false if no entry with the
+ * given key exists.
+ *
+ * The copy is a consistent snapshot of the entry as it was when no other
+ * backend held the partition lock exclusively, so this is only useful for
+ * entries whose contents are written under that lock.  If the partition is
+ * being modified, or the lock-free lookup otherwise fails, we fall back to
+ * taking the lock in shared mode.
+ *
+ * The caller must not hold a lock already.
+ */
+bool
+dshash_find_copy(dshash_table *hash_table, const void *key, void *entry)
+{
+	dshash_hash hash;
+	size_t		partition_index;
+	dshash_partition *partition;
+	size_t		item_size = ITEM_SIZE(hash_table);
+	dshash_table_item *copy = (dshash_table_item *) hash_table->scratch;
+	void	   *found_entry;
+	int			attempt;
+
+	hash = hash_key(hash_table, key);
+	partition_index = PARTITION_FOR_HASH(hash);
+	partition = &hash_table->control->partitions[partition_index];
+
+	Assert(hash_table->control->magic == DSHASH_MAGIC);
+	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
+
+	/* Keep compare functions that look for a terminator within bounds. */
+	hash_table->scratch[item_size] = '\0';
+
+	for (attempt = 0; attempt < 2; attempt++)
+	{
+		uint32		changecount;
+		size_t		size_log2;
+		dsa_pointer *buckets;
+		dsa_pointer item_pointer;
+		int			steps;
+
+		changecount = pg_atomic_read_u32(&partition->changecount);
+		if (changecount & 1)
+			break;
+		pg_read_barrier();
+
+		size_log2 = partition->size_log2;
+		if (size_log2 > MAX_PARTITION_SIZE_LOG2)
+			continue;
+		buckets = dsa_get_address_if_mapped(hash_table->area,
+											partition->buckets,
+											sizeof(dsa_pointer) *
+											NUM_BUCKETS(size_log2));
+		if (buckets == NULL)
+			continue;
+		item_pointer = buckets[BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)];
+
+		for (steps = 0; steps < DSHASH_MAX_UNLOCKED_STEPS; steps++)
+		{
+			void	   *item;
+
+			if (!DsaPointerIsValid(item_pointer))
+			{
+				pg_read_barrier();
+				if (pg_atomic_read_u32(&partition->changecount) == changecount)
+					return false;
+				break;
+			}
+
+			item = dsa_get_address_if_mapped(hash_table->area, item_pointer,
+											 item_size);
+			if (item == NULL)
+				break;
+			memcpy(copy, item, item_size);
+
+			/* Only look at the copy if nothing changed while we made it. */
+			pg_read_barrier();
+			if (pg_atomic_read_u32(&partition->changecount) != changecount)
+				break;
+
+			if (copy->hash == hash &&
+				equal_keys(hash_table, key, ENTRY_FROM_ITEM(copy)))
+			{
+				memcpy(entry, ENTRY_FROM_ITEM(copy),
+					   hash_table->params.entry_size);
+				return true;
+			}
+			item_pointer = copy->next;
+		}
+	}
+
+	/* Fall back to a locked lookup. */
+	found_entry = dshash_find(hash_table, key, false);
+	if (found_entry == NULL)
+		return false;
+	memcpy(entry, found_entry, hash_table->params.entry_size);
+	dshash_release_lock(hash_table, found_entry);
+
+	return true;
+}
+
 /*
  * Returns a pointer to an exclusively locked item which must be released with
  * dshash_release_lock.  If the key is found in the hash table, 'found' is set
@@ -446,13 +568,11 @@ dshash_find_or_insert(dshash_table *hash_table,
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
-restart:
-	LWLockAcquire(PARTITION_LOCK(hash_table, partition_index),
-				  LW_EXCLUSIVE);
-	ensure_valid_bucket_pointers(hash_table);
+	lock_partition(hash_table, partition_index, true);
 
 	/* Search the active bucket. */
-	item = find_in_bucket(hash_table, key, BUCKET_FOR_HASH(hash_table, hash));
+	item = find_in_bucket(hash_table, key,
+						  BUCKET_FOR_HASH(hash_table, partition_index, hash));
 
 	if (item)
 		*found = true;
@@ -460,29 +580,19 @@ restart:
 	{
 		*found = false;
 
-		/* Check if we are getting too full. */
-		if (partition->count > MAX_COUNT_PER_PARTITION(hash_table))
-		{
-			/*
-			 * The load factor (= keys / buckets) for all buckets protected by
-			 * this partition is > 0.75.  Presumably the same applies
-			 * generally across the whole hash table (though we don't attempt
-			 * to track that directly to avoid contention on some kind of
-			 * central counter; we just assume that this partition is
-			 * representative).  This is a good time to resize.
-			 *
-			 * Give up our existing lock first, because resizing needs to
-			 * reacquire all the locks in the right order to avoid deadlocks.
-			 */
-			LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
-			resize(hash_table, hash_table->size_log2 + 1);
-
-			goto restart;
-		}
+		/*
+		 * Check if we are getting too full.  If the load factor (= keys /
+		 * buckets) of this partition is > 0.75, this is a good time to split
+		 * its buckets.  We already hold the only lock that needs.
+		 */
+		if (partition->count > MAX_COUNT_FOR_SIZE(partition->size_log2) &&
+			partition->size_log2 < MAX_PARTITION_SIZE_LOG2)
+			resize_partition(hash_table, partition_index);
 
 		/* Finally we can try to insert the new item. */
 		item = insert_into_bucket(hash_table, key,
-								  &BUCKET_FOR_HASH(hash_table, hash));
+								  &BUCKET_FOR_HASH(hash_table, partition_index,
+												   hash));
 		item->hash = hash;
 		/* Adjust per-lock-partition counter for load factor knowledge. */
 		++partition->count;
@@ -512,11 +622,10 @@ dshash_delete_key(dshash_table *hash_table, const void *key)
 	hash = hash_key(hash_table, key);
 	partition = PARTITION_FOR_HASH(hash);
 
-	LWLockAcquire(PARTITION_LOCK(hash_table, partition), LW_EXCLUSIVE);
-	ensure_valid_bucket_pointers(hash_table);
+	lock_partition(hash_table, partition, true);
 
 	if (delete_key_from_bucket(hash_table, key,
-							   &BUCKET_FOR_HASH(hash_table, hash)))
+							   &BUCKET_FOR_HASH(hash_table, partition, hash)))
 	{
 		Assert(hash_table->control->partitions[partition].count > 0);
 		found = true;
@@ -525,7 +634,7 @@ dshash_delete_key(dshash_table *hash_table, const void *key)
 	else
 		found = false;
 
-	LWLockRelease(PARTITION_LOCK(hash_table, partition));
+	unlock_partition(hash_table, partition);
 
 	return found;
 }
@@ -548,7 +657,7 @@ dshash_delete_entry(dshash_table *hash_table, void *entry)
 								LW_EXCLUSIVE));
 
 	delete_item(hash_table, item);
-	LWLockRelease(PARTITION_LOCK(hash_table, partition));
+	unlock_partition(hash_table, partition);
 }
 
 /*
@@ -562,7 +671,7 @@ dshash_release_lock(dshash_table *hash_table, void *entry)
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 
-	LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
+	unlock_partition(hash_table, partition_index);
 }
 
 /*
@@ -659,13 +768,11 @@ dshash_seq_next(dshash_seq_status *status)
 	dsa_pointer next_item_pointer;
 
 	/*
-	 * Not yet holding any partition locks. Need to determine the size of the
-	 * hash table, it could have been resized since we were looking last.
-	 * Since we iterate in partition order, we can start by unconditionally
-	 * lock partition 0.
+	 * Not yet holding any partition locks.  We iterate in partition order, so
+	 * start by locking partition 0.
 	 *
-	 * Once we hold the lock, no resizing can happen until the scan ends. So
-	 * we don't need to repeatedly call ensure_valid_bucket_pointers().
+	 * While we hold a partition's lock, it cannot be resized.  Each partition
+	 * has its own bucket array, so we find out its size when we move to it.
 	 */
 	if (status->curpartition == -1)
 	{
@@ -674,15 +781,13 @@ dshash_seq_next(dshash_seq_status *status)
 
 		status->curpartition = 0;
 
-		LWLockAcquire(PARTITION_LOCK(status->hash_table,
-									 status->curpartition),
-					  status->exclusive ? LW_EXCLUSIVE : LW_SHARED);
-
-		ensure_valid_bucket_pointers(status->hash_table);
+		lock_partition(status->hash_table, status->curpartition,
+					   status->exclusive);
 
 		status->nbuckets =
-			NUM_BUCKETS(status->hash_table->control->size_log2);
-		next_item_pointer = status->hash_table->buckets[status->curbucket];
+			NUM_BUCKETS(status->hash_table->size_log2[status->curpartition]);
+		next_item_pointer =
+			status->hash_table->buckets[status->curpartition][status->curbucket];
 	}
 	else
 		next_item_pointer = status->pnextitem;
@@ -694,36 +799,32 @@ dshash_seq_next(dshash_seq_status *status)
 	/* Move to the next bucket if we finished the current bucket */
 	while (!DsaPointerIsValid(next_item_pointer))
 	{
-		int			next_partition;
-
 		if (++status->curbucket >= status->nbuckets)
 		{
-			/* all buckets have been scanned. finish. */
-			return NULL;
-		}
+			int			next_partition = status->curpartition + 1;
 
-		/* Check if move to the next partition */
-		next_partition =
-			PARTITION_FOR_BUCKET_INDEX(status->curbucket,
-									   status->hash_table->size_log2);
+			if (next_partition >= DSHASH_NUM_PARTITIONS)
+			{
+				/* all buckets have been scanned. finish. */
+				return NULL;
+			}
 
-		if (status->curpartition != next_partition)
-		{
 			/*
-			 * Move to the next partition. Lock the next partition then
-			 * release the current, not in the reverse order to avoid
-			 * concurrent resizing.  Avoid dead lock by taking lock in the
-			 * same order with resize().
+			 * Move to the next partition.  Lock the next partition then
+			 * release the current, taking locks in partition order like
+			 * dshash_dump().
 			 */
-			LWLockAcquire(PARTITION_LOCK(status->hash_table,
-										 next_partition),
-						  status->exclusive ? LW_EXCLUSIVE : LW_SHARED);
-			LWLockRelease(PARTITION_LOCK(status->hash_table,
-										 status->curpartition));
+			lock_partition(status->hash_table, next_partition,
+						   status->exclusive);
+			unlock_partition(status->hash_table, status->curpartition);
 			status->curpartition = next_partition;
+			status->curbucket = 0;
+			status->nbuckets =
+				NUM_BUCKETS(status->hash_table->size_log2[next_partition]);
 		}
 
-		next_item_pointer = status->hash_table->buckets[status->curbucket];
+		next_item_pointer =
+			status->hash_table->buckets[status->curpartition][status->curbucket];
 	}
 
 	status->curitem =
@@ -747,7 +848,7 @@ void
 dshash_seq_term(dshash_seq_status *status)
 {
 	if (status->curpartition >= 0)
-		LWLockRelease(PARTITION_LOCK(status->hash_table, status->curpartition));
+		unlock_partition(status->hash_table, status->curpartition);
 }
 
 /*
@@ -786,27 +887,23 @@ dshash_dump(dshash_table *hash_table)
 	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 	{
 		Assert(!LWLockHeldByMe(PARTITION_LOCK(hash_table, i)));
-		LWLockAcquire(PARTITION_LOCK(hash_table, i), LW_SHARED);
+		lock_partition(hash_table, i, false);
 	}
 
-	ensure_valid_bucket_pointers(hash_table);
-
-	fprintf(stderr,
-			"hash table size = %zu\n", (size_t) 1 << hash_table->size_log2);
 	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 	{
 		dshash_partition *partition = &hash_table->control->partitions[i];
-		size_t		begin = BUCKET_INDEX_FOR_PARTITION(i, hash_table->size_log2);
-		size_t		end = BUCKET_INDEX_FOR_PARTITION(i + 1, hash_table->size_log2);
+		size_t		nbuckets = NUM_BUCKETS(hash_table->size_log2[i]);
 
 		fprintf(stderr, "  partition %zu\n", i);
 		fprintf(stderr,
-				"    active buckets (key count = %zu)\n", partition->count);
+				"    active buckets (bucket count = %zu, key count = %zu)\n",
+				nbuckets, partition->count);
 
-		for (j = begin; j < end; ++j)
+		for (j = 0; j < nbuckets; ++j)
 		{
 			size_t		count = 0;
-			dsa_pointer bucket = hash_table->buckets[j];
+			dsa_pointer bucket = hash_table->buckets[i][j];
 
 			while (DsaPointerIsValid(bucket))
 			{
@@ -822,7 +919,7 @@ dshash_dump(dshash_table *hash_table)
 	}
 
 	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
-		LWLockRelease(PARTITION_LOCK(hash_table, i));
+		unlock_partition(hash_table, i);
 }
 
 /*
@@ -837,7 +934,7 @@ delete_item(dshash_table *hash_table, dshash_table_item *item)
 	Assert(LWLockHeldByMe(PARTITION_LOCK(hash_table, partition)));
 
 	if (delete_item_from_bucket(hash_table, item,
-								&BUCKET_FOR_HASH(hash_table, hash)))
+								&BUCKET_FOR_HASH(hash_table, partition, hash)))
 	{
 		Assert(hash_table->control->partitions[partition].count > 0);
 		--hash_table->control->partitions[partition].count;
@@ -849,56 +946,39 @@ delete_item(dshash_table *hash_table, dshash_table_item *item)
 }
 
 /*
- * Grow the hash table if necessary to the requested number of buckets.  The
- * requested size must be double some previously observed size.
- *
- * Must be called without any partition lock held.
+ * Double the number of buckets of a partition.  The caller must hold the
+ * partition lock exclusively.
  */
 static void
-resize(dshash_table *hash_table, size_t new_size_log2)
+resize_partition(dshash_table *hash_table, size_t partition_index)
 {
+	dshash_partition *partition = &hash_table->control->partitions[partition_index];
 	dsa_pointer old_buckets;
 	dsa_pointer new_buckets_shared;
 	dsa_pointer *new_buckets;
+	size_t		size_log2 = partition->size_log2;
+	size_t		new_size_log2 = size_log2 + 1;
 	size_t		size;
-	size_t		new_size = ((size_t) 1) << new_size_log2;
 	size_t		i;
 
-	/*
-	 * Acquire the locks for all lock partitions.  This is expensive, but we
-	 * shouldn't have to do it many times.
-	 */
-	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
-	{
-		Assert(!LWLockHeldByMe(PARTITION_LOCK(hash_table, i)));
-
-		LWLockAcquire(PARTITION_LOCK(hash_table, i), LW_EXCLUSIVE);
-		if (i == 0 && hash_table->control->size_log2 >= new_size_log2)
-		{
-			/*
-			 * Another backend has already increased the size; we can avoid
-			 * obtaining all the locks and return early.
-			 */
-			LWLockRelease(PARTITION_LOCK(hash_table, 0));
-			return;
-		}
-	}
-
-	Assert(new_size_log2 == hash_table->control->size_log2 + 1);
+	Assert(LWLockHeldByMeInMode(PARTITION_LOCK(hash_table, partition_index),
+								LW_EXCLUSIVE));
+	Assert(new_size_log2 <= MAX_PARTITION_SIZE_LOG2);
 
-	/* Allocate the space for the new table. */
+	/* Allocate the space for the new bucket array. */
 	new_buckets_shared = dsa_allocate0(hash_table->area,
-									   sizeof(dsa_pointer) * new_size);
+									   sizeof(dsa_pointer) *
+									   NUM_BUCKETS(new_size_log2));
 	new_buckets = dsa_get_address(hash_table->area, new_buckets_shared);
 
 	/*
 	 * We've allocated the new bucket array; all that remains to do now is to
-	 * reinsert all items, which amounts to adjusting all the pointers.
+	 * reinsert the partition's items, which amounts to adjusting pointers.
 	 */
-	size = ((size_t) 1) << hash_table->control->size_log2;
+	size = NUM_BUCKETS(size_log2);
 	for (i = 0; i < size; ++i)
 	{
-		dsa_pointer item_pointer = hash_table->buckets[i];
+		dsa_pointer item_pointer = hash_table->buckets[partition_index][i];
 
 		while (DsaPointerIsValid(item_pointer))
 		{
@@ -914,31 +994,74 @@ resize(dshash_table *hash_table, size_t new_size_log2)
 		}
 	}
 
-	/* Swap the hash table into place and free the old one. */
-	old_buckets = hash_table->control->buckets;
-	hash_table->control->buckets = new_buckets_shared;
-	hash_table->control->size_log2 = new_size_log2;
-	hash_table->buckets = new_buckets;
+	/* Swap the new bucket array into place and free the old one. */
+	old_buckets = partition->buckets;
+	partition->buckets = new_buckets_shared;
+	partition->size_log2 = new_size_log2;
+	hash_table->buckets[partition_index] = new_buckets;
+	hash_table->size_log2[partition_index] = new_size_log2;
 	dsa_free(hash_table->area, old_buckets);
+}
 
-	/* Release all the locks. */
-	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
-		LWLockRelease(PARTITION_LOCK(hash_table, i));
+/*
+ * Lock a partition and make sure our bucket pointers for it are valid.  An
+ * exclusive lock makes the partition's change counter odd, to tell lock-free
+ * readers that the partition's contents cannot be trusted for now.
+ */
+static inline void
+lock_partition(dshash_table *hash_table, size_t partition_index,
+			   bool exclusive)
+{
+	LWLockAcquire(PARTITION_LOCK(hash_table, partition_index),
+				  exclusive ? LW_EXCLUSIVE : LW_SHARED);
+
+	if (exclusive)
+	{
+		pg_atomic_uint32 *changecount =
+			&hash_table->control->partitions[partition_index].changecount;
+
+		/*
+		 * The counter stays odd if an error released the lock, since
+		 * LWLockReleaseAll() doesn't know about it.  Fix that up here.
+		 */
+		if ((pg_atomic_fetch_add_u32(changecount, 1) & 1) != 0)
+			pg_atomic_fetch_add_u32(changecount, 1);
+	}
+
+	ensure_valid_bucket_pointers(hash_table, partition_index);
 }
 
 /*
- * Make sure that our backend-local bucket pointers are up to date.  The
- * caller must have locked one lock partition, which prevents resize() from
- * running concurrently.
+ * Release a partition lock taken by lock_partition().
  */
 static inline void
-ensure_valid_bucket_pointers(dshash_table *hash_table)
+unlock_partition(dshash_table *hash_table, size_t partition_index)
 {
-	if (hash_table->size_log2 != hash_table->control->size_log2)
+	LWLock	   *lock = PARTITION_LOCK(hash_table, partition_index);
+
+	if (LWLockHeldByMeInMode(lock, LW_EXCLUSIVE))
+		pg_atomic_fetch_add_u32(&hash_table->control->partitions[partition_index].changecount,
+								1);
+
+	LWLockRelease(lock);
+}
+
+/*
+ * Make sure that our backend-local bucket pointers for a partition are up to
+ * date.  The caller must have locked the partition, which prevents
+ * resize_partition() from running concurrently.
+ */
+static inline void
+ensure_valid_bucket_pointers(dshash_table *hash_table, size_t partition_index)
+{
+	dshash_partition *partition = &hash_table->control->partitions[partition_index];
+
+	if (hash_table->buckets[partition_index] == NULL ||
+		hash_table->size_log2[partition_index] != partition->size_log2)
 	{
-		hash_table->buckets = dsa_get_address(hash_table->area,
-											  hash_table->control->buckets);
-		hash_table->size_log2 = hash_table->control->size_log2;
+		hash_table->buckets[partition_index] =
+			dsa_get_address(hash_table->area, partition->buckets);
+		hash_table->size_log2[partition_index] = partition->size_log2;
 	}
 }
 
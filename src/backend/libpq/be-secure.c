@@ -29,6 +29,7 @@
 
 #include "libpq/libpq.h"
 #include "miscadmin.h"
+#include "port/pg_iovec.h"
 #include "tcop/tcopprot.h"
 #include "utils/wait_event.h"
 
@@ -58,6 +59,8 @@ bool		SSLPreferServerCiphers;
 int			ssl_min_protocol_version = PG_TLS1_2_VERSION;
 int			ssl_max_protocol_version = PG_TLS_ANY;
 
+static void secure_write_wait(int waitfor);
+
 /* ------------------------------------------------------------ */
 /*			 Procedures common to all secure sessions			*/
 /* ------------------------------------------------------------ */
@@ -330,33 +333,8 @@ retry:
 
 	if (n < 0 && !port->noblock && (errno == EWOULDBLOCK || errno == EAGAIN))
 	{
-		WaitEvent	event;
-
 		Assert(waitfor);
-
-		ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, waitfor, NULL);
-
-		WaitEventSetWait(FeBeWaitSet, -1 /* no timeout */ , &event, 1,
-						 WAIT_EVENT_CLIENT_WRITE);
-
-		/* See comments in secure_read. */
-		if (event.events & WL_POSTMASTER_DEATH)
-			ereport(FATAL,
-					(errcode(ERRCODE_ADMIN_SHUTDOWN),
-					 errmsg("terminating connection due to unexpected postmaster exit")));
-
-		/* Handle interrupt. */
-		if (event.events & WL_LATCH_SET)
-		{
-			ResetLatch(MyLatch);
-			ProcessClientWriteInterrupt(true);
-
-			/*
-			 * We'll retry the write. Most likely it will return immediately
-			 * because there's still no buffer space available, and we'll wait
-			 * for the socket to become ready again.
-			 */
-		}
+		secure_write_wait(waitfor);
 		goto retry;
 	}
 
@@ -369,6 +347,96 @@ retry:
 	return n;
 }
 
+/*
+ *	Write data from several buffers to the client, in that order.
+ *
+ *	On a plain socket, the buffers are gathered in a single writev() call,
+ *	which saves copying them together first.  With SSL or GSSAPI encryption,
+ *	only the first non-empty buffer is written; like any short write, the
+ *	caller has to come back for the rest.
+ */
+ssize_t
+secure_writev(Port *port, const struct iovec *iov, int iovcnt)
+{
+#ifndef WIN32
+	ssize_t		n;
+	bool		gather = true;
+
+#ifdef USE_SSL
+	if (port->ssl_in_use)
+		gather = false;
+#endif
+#ifdef ENABLE_GSS
+	if (port->gss && port->gss->enc)
+		gather = false;
+#endif
+
+	if (gather)
+	{
+		/* Deal with any already-pending interrupt condition. */
+		ProcessClientWriteInterrupt(false);
+
+		for (;;)
+		{
+			n = writev(port->sock, iov, Min(iovcnt, PG_IOV_MAX));
+			if (n < 0 && !port->noblock &&
+				(errno == EWOULDBLOCK || errno == EAGAIN))
+			{
+				secure_write_wait(WL_SOCKET_WRITEABLE);
+				continue;
+			}
+			break;
+		}
+
+		/* As in secure_write() */
+		ProcessClientWriteInterrupt(false);
+
+		return n;
+	}
+#endif
+
+	while (iovcnt > 1 && iov->iov_len == 0)
+	{
+		iov++;
+		iovcnt--;
+	}
+	return secure_write(port, iov->iov_base, iov->iov_len);
+}
+
+/*
+ *	Wait for the client socket to become ready, for a blocking write that
+ *	would have blocked.  Pending interrupts are processed meanwhile.
+ */
+static void
+secure_write_wait(int waitfor)
+{
+	WaitEvent	event;
+
+	ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, waitfor, NULL);
+
+	WaitEventSetWait(FeBeWaitSet, -1 /* no timeout */ , &event, 1,
+					 WAIT_EVENT_CLIENT_WRITE);
+
+	/* See comments in secure_read. */
+	if (event.events & WL_POSTMASTER_DEATH)
+		ereport(FATAL,
+				(errcode(ERRCODE_ADMIN_SHUTDOWN),
+				 errmsg("terminating connection due to unexpected postmaster exit")));
+
+	/* Handle interrupt. */
+	if (event.events & WL_LATCH_SET)
+	{
+		ResetLatch(MyLatch);
+		ProcessClientWriteInterrupt(true);
+
+		/*
+		 * We'll retry the write. Most likely it will return immediately
+		 * because there's still no buffer space available, and we'll wait
+		 * for the socket to become ready again.
+		 */
+	}
+}
+
 ssize_t
 secure_raw_write(Port *port, const void *ptr, size_t len)
 {
@@ -45,6 +45,10 @@
  *		pq_flush_if_writable - flush pending output if writable without blocking
  *		pq_getbyte_if_available - get a byte if available without blocking
  *
+ * stream compression:
+ *		pq_enable_compression	- compress all further traffic
+ *		pq_get_compression_stats - report the effect of compression
+ *
  * message-level I/O
  *		pq_putmessage	- send a normal message (suppressed in COPY OUT mode)
  *		pq_putmessage_noblock - buffer a normal message (suppressed in COPY OUT)
@@ -72,6 +76,7 @@
 #include <mstcpip.h>
 #endif
 
+#include "common/compress_stream.h"
 #include "common/ip.h"
 #include "libpq/libpq.h"
 #include "miscadmin.h"
@@ -111,11 +116,19 @@ static List *sock_paths = NIL;
 /*
  * Buffers for low-level I/O.
  *
- * The receive buffer is fixed size. Send buffer is usually 8k, but can be
- * enlarged by pq_putmessage_noblock() if the message doesn't fit otherwise.
+ * The receive buffer is fixed size. Send buffer starts out at 8k.  It is
+ * enlarged, up to PQ_SEND_BUFFER_MAX_SIZE, when output keeps filling it up,
+ * since a session that streams out lots of small messages then needs fewer
+ * send() calls.  pq_putmessage_noblock() can enlarge it further if a message
+ * doesn't fit otherwise.
+ *
+ * Message data of at least PQ_SEND_BUFFER_SIZE bytes isn't copied into the
+ * send buffer at all, but written out directly, together with whatever was
+ * already buffered in a single vectored write.
  */
 
 #define PQ_SEND_BUFFER_SIZE 8192
+#define PQ_SEND_BUFFER_MAX_SIZE (128 * 1024)
 #define PQ_RECV_BUFFER_SIZE 8192
 
 static char *PqSendBuffer;
@@ -131,8 +144,37 @@ static int	PqRecvLength;		/* End of data available in PqRecvBuffer */
  * Message status
  */
 static bool PqCommBusy;			/* busy sending data to the client */
+static int	last_reported_send_errno = 0;	/* see internal_report_send_error */
 static bool PqCommReadingMsg;	/* in the middle of reading a message */
 
+/*
+ * Stream compression state, see pq_enable_compression().
+ *
+ * When compression is in use, the send buffer holds uncompressed data, which
+ * is compressed as a whole when it's flushed.  The compressed data is kept
+ * in the compressor's output buffer until it has all been sent, and the send
+ * buffer is only compressed again once that is done.  Likewise, compressed
+ * data is read into PqRecvRawBuffer, and the decompressed result is copied
+ * into PqRecvBuffer, as much as fits; the rest is left in the decompressor's
+ * output buffer until the next pq_recvbuf() call.
+ */
+static pg_compress_algorithm PqCompressionAlgorithm = PG_COMPRESSION_NONE;
+static pg_stream_compressor *PqCompressor = NULL;
+static const char *PqCompressedData;	/* compressed data not sent yet */
+static size_t PqCompressedStart;
+static size_t PqCompressedEnd;
+static pg_stream_decompressor *PqDecompressor = NULL;
+static char *PqRecvRawBuffer;
+static const char *PqDecompressedData;	/* decompressed data not consumed */
+static size_t PqDecompressedStart;
+static size_t PqDecompressedEnd;
+
+/* Statistics reported by pq_get_compression_stats() */
+static uint64 PqRawBytesSent;
+static uint64 PqCompressedBytesSent;
+static uint64 PqRawBytesReceived;
+static uint64 PqCompressedBytesReceived;
+
 
 /* Internal functions */
 static void socket_comm_reset(void);
@@ -145,6 +187,10 @@ static int	socket_putmessage(char msgtype, const char *s, size_t len);
 static void socket_putmessage_noblock(char msgtype, const char *s, size_t len);
 static inline int internal_putbytes(const char *s, size_t len);
 static inline int internal_flush(void);
+static int	internal_flush_compressed(void);
+static ssize_t pq_read_decompressed(void);
+static int	internal_flush_with(const char *s, size_t len);
+static void internal_report_send_error(void);
 static pg_noinline int internal_flush_buffer(const char *buf, size_t *start,
 											 size_t *end);
 
@@ -653,6 +699,22 @@ ListenServerPort(int family, const char *hostName, unsigned short portNumber,
 			continue;
 		}
 
+		/*
+		 * Put the socket into nonblocking mode, so that the postmaster can
+		 * accept all pending connections in one go and stop once the queue
+		 * is empty; see AcceptConnection().
+		 */
+		if (!pg_set_noblock(fd))
+		{
+			ereport(LOG,
+					(errcode_for_socket_access(),
+			/* translator: first %s is IPv4, IPv6, or Unix */
+					 errmsg("could not set %s socket \"%s\" to nonblocking mode: %m",
+							familyDesc, addrDesc)));
+			closesocket(fd);
+			continue;
+		}
+
 		if (addr->ai_family == AF_UNIX)
 			ereport(LOG,
 					(errmsg("listening on Unix socket \"%s\"",
@@ -784,10 +846,11 @@ Setup_AF_UNIX(const char *sock_path)
  *		server port.  Fills *client_sock with the FD and endpoint info
  *		of the new connection.
  *
- * ASSUME: that this doesn't need to be non-blocking because
- *		the Postmaster waits for the socket to be ready to accept().
+ * The server socket is in nonblocking mode, so that the postmaster can
+ *		call this repeatedly to drain the accept queue after a wakeup.
  *
- * RETURNS: STATUS_OK or STATUS_ERROR
+ * RETURNS: STATUS_OK, STATUS_EOF if there was no pending connection,
+ *		or STATUS_ERROR
  */
 int
 AcceptConnection(pgsocket server_fd, ClientSocket *client_sock)
@@ -798,6 +861,10 @@ AcceptConnection(pgsocket server_fd, ClientSocket *client_sock)
 									(struct sockaddr *) &client_sock->raddr.addr,
 									&client_sock->raddr.salen)) == PGINVALID_SOCKET)
 	{
+		/* Nothing (more) to accept, or interrupted by a signal */
+		if (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)
+			return STATUS_EOF;
+
 		ereport(LOG,
 				(errcode_for_socket_access(),
 				 errmsg("could not accept new connection: %m")));
@@ -920,8 +987,11 @@ pq_recvbuf(void)
 
 		errno = 0;
 
-		r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
-						PQ_RECV_BUFFER_SIZE - PqRecvLength);
+		if (PqDecompressor != NULL)
+			r = pq_read_decompressed();
+		else
+			r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
+							PQ_RECV_BUFFER_SIZE - PqRecvLength);
 
 		if (r < 0)
 		{
@@ -955,6 +1025,58 @@ pq_recvbuf(void)
 	}
 }
 
+/* --------------------------------
+ *		pq_read_decompressed - read and decompress data into PqRecvBuffer
+ *
+ * Behaves like secure_read() into the free space of PqRecvBuffer: returns
+ * the number of bytes added, 0 at EOF, or -1 with errno set.  A corrupt
+ * compressed stream is reported to the log and then treated as EOF.
+ * --------------------------------
+ */
+static ssize_t
+pq_read_decompressed(void)
+{
+	for (;;)
+	{
+		ssize_t		r;
+		const char *out;
+		size_t		outlen;
+
+		if (PqDecompressedStart < PqDecompressedEnd)
+		{
+			size_t		amount = PqDecompressedEnd - PqDecompressedStart;
+
+			if (amount > PQ_RECV_BUFFER_SIZE - PqRecvLength)
+				amount = PQ_RECV_BUFFER_SIZE - PqRecvLength;
+			memcpy(PqRecvBuffer + PqRecvLength,
+				   PqDecompressedData + PqDecompressedStart, amount);
+			PqDecompressedStart += amount;
+			return amount;
+		}
+
+		r = secure_read(MyProcPort, PqRecvRawBuffer, PQ_RECV_BUFFER_SIZE);
+		if (r <= 0)
+			return r;
+
+		if (!pg_stream_decompress(PqDecompressor, PqRecvRawBuffer, r,
+								  &out, &outlen))
+		{
+			ereport(COMMERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("could not decompress data from client: %s",
+							pg_stream_decompressor_error(PqDecompressor))));
+			errno = 0;
+			return 0;
+		}
+
+		PqCompressedBytesReceived += r;
+		PqRawBytesReceived += outlen;
+		PqDecompressedData = out;
+		PqDecompressedStart = 0;
+		PqDecompressedEnd = outlen;
+	}
+}
+
 /* --------------------------------
  *		pq_getbyte	- get a single byte from connection, or return EOF
  * --------------------------------
@@ -1017,7 +1139,20 @@ pq_getbyte_if_available(unsigned char *c)
 
 	errno = 0;
 
-	r = secure_read(MyProcPort, c, 1);
+	if (PqDecompressor != NULL)
+	{
+		/* Decompressed data goes through the regular buffer */
+		PqRecvPointer = PqRecvLength = 0;
+		r = pq_read_decompressed();
+		if (r > 0)
+		{
+			PqRecvLength = r;
+			*c = PqRecvBuffer[PqRecvPointer++];
+			r = 1;
+		}
+	}
+	else
+		r = secure_read(MyProcPort, c, 1);
 	if (r < 0)
 	{
 		/*
@@ -1277,26 +1412,42 @@ internal_putbytes(const char *s, size_t len)
 {
 	while (len > 0)
 	{
-		/* If buffer is full, then flush it out */
+		/*
+		 * If buffer is full, then flush it out.  Output that keeps filling
+		 * the buffer is better sent in larger pieces, so enlarge it while
+		 * it's empty.
+		 */
 		if (PqSendPointer >= PqSendBufferSize)
 		{
 			socket_set_nonblocking(false);
 			if (internal_flush())
 				return EOF;
+
+			if (PqSendBufferSize < PQ_SEND_BUFFER_MAX_SIZE &&
+				PqSendStart == PqSendPointer)
+			{
+				pfree(PqSendBuffer);
+				PqSendBufferSize = Min(PqSendBufferSize * 2,
+									   PQ_SEND_BUFFER_MAX_SIZE);
+				PqSendBuffer = MemoryContextAlloc(TopMemoryContext,
+												  PqSendBufferSize);
+				PqSendStart = PqSendPointer = 0;
+			}
 		}
 
 		/*
-		 * If the buffer is empty and data length is larger than the buffer
-		 * size, send it without buffering.  Otherwise, copy as much data as
-		 * possible into the buffer.
+		 * Send large data directly rather than copying it into the buffer
+		 * first, unless it has to be compressed.  Anything that's already
+		 * buffered goes out in the same write.  Otherwise, copy as much data
+		 * as possible into the buffer.
 		 */
-		if (len >= PqSendBufferSize && PqSendStart == PqSendPointer)
+		if (len >= PQ_SEND_BUFFER_SIZE && len >= PqSendBufferSize - PqSendPointer &&
+			PqCompressor == NULL)
 		{
-			size_t		start = 0;
-
 			socket_set_nonblocking(false);
-			if (internal_flush_buffer(s, &start, &len))
+			if (internal_flush_with(s, len))
 				return EOF;
+			len = 0;
 		}
 		else
 		{
@@ -1345,9 +1496,144 @@ socket_flush(void)
 static inline int
 internal_flush(void)
 {
+	if (PqCompressor != NULL)
+		return internal_flush_compressed();
 	return internal_flush_buffer(PqSendBuffer, &PqSendStart, &PqSendPointer);
 }
 
+/* --------------------------------
+ *		internal_flush_compressed - compress and flush pending output
+ *
+ * Finishes sending the previously compressed data first, and compresses the
+ * contents of the send buffer only after that.  Same return convention as
+ * internal_flush().
+ * --------------------------------
+ */
+static int
+internal_flush_compressed(void)
+{
+	const char *out;
+	size_t		outlen;
+
+	if (PqCompressedStart < PqCompressedEnd)
+	{
+		if (internal_flush_buffer(PqCompressedData, &PqCompressedStart,
+								  &PqCompressedEnd))
+			return EOF;
+		if (PqCompressedStart < PqCompressedEnd)
+			return 0;			/* would block */
+	}
+
+	if (PqSendStart == PqSendPointer)
+		return 0;
+
+	if (!pg_stream_compress(PqCompressor, PqSendBuffer + PqSendStart,
+							PqSendPointer - PqSendStart, &out, &outlen))
+	{
+		/*
+		 * There's no way to recover the stream after this, so treat it like
+		 * a lost connection.  As in internal_flush_buffer(), the message must
+		 * only go to the postmaster log.
+		 */
+		ereport(COMMERROR,
+				(errmsg("could not compress data sent to client: %s",
+						pg_stream_compressor_error(PqCompressor))));
+		PqSendStart = PqSendPointer = 0;
+		ClientConnectionLost = 1;
+		InterruptPending = 1;
+		return EOF;
+	}
+
+	PqRawBytesSent += PqSendPointer - PqSendStart;
+	PqCompressedBytesSent += outlen;
+	PqSendStart = PqSendPointer = 0;
+
+	PqCompressedData = out;
+	PqCompressedStart = 0;
+	PqCompressedEnd = outlen;
+	return internal_flush_buffer(PqCompressedData, &PqCompressedStart,
+								 &PqCompressedEnd);
+}
+
+/* --------------------------------
+ *		internal_flush_with - flush pending output followed by more data
+ *
+ * Sends the contents of the send buffer and then 'len' bytes at 's', with
+ * vectored writes, so that 's' doesn't need to be copied into the buffer.
+ * The socket must be in blocking mode.  Returns 0 if OK, or EOF if trouble.
+ * --------------------------------
+ */
+static int
+internal_flush_with(const char *s, size_t len)
+{
+	struct iovec iov[2];
+
+	Assert(!MyProcPort->noblock);
+
+	iov[0].iov_base = PqSendBuffer + PqSendStart;
+	iov[0].iov_len = PqSendPointer - PqSendStart;
+	iov[1].iov_base = unconstify(char *, s);
+	iov[1].iov_len = len;
+
+	while (iov[0].iov_len + iov[1].iov_len > 0)
+	{
+		ssize_t		r;
+
+		r = secure_writev(MyProcPort, iov, 2);
+
+		if (r <= 0)
+		{
+			if (errno == EINTR)
+				continue;		/* Ok if we were interrupted */
+
+			/* As in internal_flush_buffer() */
+			internal_report_send_error();
+			PqSendStart = PqSendPointer = 0;
+			ClientConnectionLost = 1;
+			InterruptPending = 1;
+			return EOF;
+		}
+
+		last_reported_send_errno = 0;	/* reset after any successful send */
+
+		/* Advance past what was written */
+		for (int i = 0; i < 2 && r > 0; i++)
+		{
+			size_t		amount = Min(iov[i].iov_len, (size_t) r);
+
+			iov[i].iov_base = (char *) iov[i].iov_base + amount;
+			iov[i].iov_len -= amount;
+			r -= amount;
+		}
+	}
+
+	PqSendStart = PqSendPointer = 0;
+	return 0;
+}
+
+/*
+ * Log failure to send data to the client.
+ *
+ * Careful: an ereport() that tries to write to the client would cause
+ * recursion to here, leading to stack overflow and core dump!  This message
+ * must go *only* to the postmaster log.
+ *
+ * If a client disconnects while we're in the midst of output, we might write
+ * quite a bit of data before we get to a safe query abort point.  So,
+ * suppress duplicate log messages.
+ */
+static void
+internal_report_send_error(void)
+{
+	if (errno != last_reported_send_errno)
+	{
+		last_reported_send_errno = errno;
+		ereport(COMMERROR,
+				(errcode_for_socket_access(),
+				 errmsg("could not send data to client: %m")));
+	}
+}
+
 /* --------------------------------
  *		internal_flush_buffer - flush the given buffer content
  *
@@ -1358,8 +1644,6 @@ internal_flush(void)
 static pg_noinline int
 internal_flush_buffer(const char *buf, size_t *start, size_t *end)
 {
-	static int	last_reported_send_errno = 0;
-
 	const char *bufptr = buf + *start;
 	const char *bufend = buf + *end;
 
@@ -1384,22 +1668,7 @@ internal_flush_buffer(const char *buf, size_t *start, size_t *end)
 				return 0;
 			}
 
-			/*
-			 * Careful: an ereport() that tries to write to the client would
-			 * cause recursion to here, leading to stack overflow and core
-			 * dump!  This message must go *only* to the postmaster log.
-			 *
-			 * If a client disconnects while we're in the midst of output, we
-			 * might write quite a bit of data before we get to a safe query
-			 * abort point.  So, suppress duplicate log messages.
-			 */
-			if (errno != last_reported_send_errno)
-			{
-				last_reported_send_errno = errno;
-				ereport(COMMERROR,
-						(errcode_for_socket_access(),
-						 errmsg("could not send data to client: %m")));
-			}
+			internal_report_send_error();
 
 			/*
 			 * We drop the buffered data anyway so that processing can
@@ -1434,7 +1703,7 @@ socket_flush_if_writable(void)
 	int			res;
 
 	/* Quick exit if nothing to do */
-	if (PqSendPointer == PqSendStart)
+	if (PqSendPointer == PqSendStart && PqCompressedStart == PqCompressedEnd)
 		return 0;
 
 	/* No-op if reentrant call */
@@ -1457,7 +1726,8 @@ socket_flush_if_writable(void)
 static bool
 socket_is_send_pending(void)
 {
-	return (PqSendStart < PqSendPointer);
+	return (PqSendStart < PqSendPointer ||
+			PqCompressedStart < PqCompressedEnd);
 }
 
 /* --------------------------------
@@ -2082,3 +2352,55 @@ retry:
 
 	return true;
 }
+
+/* --------------------------------
+ *		pq_enable_compression - compress all further traffic
+ *
+ * Called once the use of stream compression has been announced to the
+ * client.  Everything sent after this point is compressed, and everything
+ * received is expected to be compressed.  Any pending output must have been
+ * flushed already, since the client doesn't expect it to be compressed.
+ * --------------------------------
+ */
+void
+pq_enable_compression(pg_compress_algorithm algorithm)
+{
+	const char *errormsg;
+
+	Assert(PqCommMethods == &PqCommSocketMethods);
+	Assert(PqSendStart == PqSendPointer);
+	Assert(PqRecvPointer == PqRecvLength);
+	Assert(PqCompressor == NULL);
+
+	PqCompressor = pg_stream_compressor_create(algorithm, 0, &errormsg);
+	if (PqCompressor == NULL)
+		ereport(FATAL,
+				(errmsg("could not set up protocol compression: %s",
+						errormsg)));
+	PqDecompressor = pg_stream_decompressor_create(algorithm, &errormsg);
+	if (PqDecompressor == NULL)
+		ereport(FATAL,
+				(errmsg("could not set up protocol decompression: %s",
+						errormsg)));
+
+	PqRecvRawBuffer = MemoryContextAlloc(TopMemoryContext, PQ_RECV_BUFFER_SIZE);
+	PqCompressionAlgorithm = algorithm;
+}
+
+/* --------------------------------
+ *		pq_get_compression_stats - report the effect of compression
+ *
+ * Returns the compression algorithm in use by this connection, and the
+ * number of bytes exchanged with the client before and after compression.
+ * --------------------------------
+ */
+pg_compress_algorithm
+pq_get_compression_stats(uint64 *raw_sent, uint64 *compressed_sent,
+						 uint64 *raw_received, uint64 *compressed_received)
+{
+	*raw_sent = PqRawBytesSent;
+	*compressed_sent = PqCompressedBytesSent;
+	*raw_received = PqRawBytesReceived;
+	*compressed_received = PqCompressedBytesReceived;
+	return PqCompressionAlgorithm;
+}
@@ -45,6 +45,7 @@
 #include "common/int.h"
 #include "nodes/bitmapset.h"
 #include "nodes/tidbitmap.h"
+#include "port/pg_bitutils.h"
 #include "storage/lwlock.h"
 #include "utils/dsa.h"
 
@@ -235,9 +236,6 @@ static PagetableEntry *tbm_get_pageentry(TIDBitmap *tbm, BlockNumber pageno);
 static bool tbm_page_is_lossy(const TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_lossify(TIDBitmap *tbm);
-static int	tbm_comparator(const void *left, const void *right);
-static int	tbm_shared_comparator(const void *left, const void *right,
-								  void *arg);
 
 /* define hashtable mapping block numbers to PagetableEntry's */
 #define SH_USE_NONDEFAULT_ALLOCATOR
@@ -247,11 +245,39 @@ static int	tbm_shared_comparator(const void *left, const void *right,
 #define SH_KEY blockno
 #define SH_HASH_KEY(tb, key) murmurhash32(key)
 #define SH_EQUAL(tb, a, b) a == b
+#define SH_USE_TAGS
 #define SH_SCOPE static inline
 #define SH_DEFINE
 #define SH_DECLARE
 #include "lib/simplehash.h"
 
+/*
+ * Define sort functions for putting the page and chunk entries in block
+ * number order before iterating.  Bitmaps can have millions of entries, so
+ * it pays to have the comparisons inlined.
+ */
+typedef PagetableEntry *PagetableEntryPtr;
+
+#define ST_SORT tbm_sort_entries
+#define ST_ELEMENT_TYPE PagetableEntryPtr
+#define ST_COMPARE(a, b) pg_cmp_u32((*(a))->blockno, (*(b))->blockno)
+#define ST_SCOPE static
+#define ST_DEFINE
+#include "lib/sort_template.h"
+
+/*
+ * As above, but for arrays of indexes into the PagetableEntry array of a
+ * shared bitmap.
+ */
+#define ST_SORT tbm_sort_shared_entries
+#define ST_ELEMENT_TYPE int
+#define ST_COMPARE_ARG_TYPE PagetableEntry
+#define ST_COMPARE(a, b, base) \
+	pg_cmp_u32((base)[*(a)].blockno, (base)[*(b)].blockno)
+#define ST_SCOPE static
+#define ST_DEFINE
+#include "lib/sort_template.h"
+
 
 /*
  * tbm_create - create an initially-empty bitmap
@@ -741,11 +767,9 @@ tbm_begin_iterate(TIDBitmap *tbm)
 		Assert(npages == tbm->npages);
 		Assert(nchunks == tbm->nchunks);
 		if (npages > 1)
-			qsort(tbm->spages, npages, sizeof(PagetableEntry *),
-				  tbm_comparator);
+			tbm_sort_entries(tbm->spages, npages);
 		if (nchunks > 1)
-			qsort(tbm->schunks, nchunks, sizeof(PagetableEntry *),
-				  tbm_comparator);
+			tbm_sort_entries(tbm->schunks, nchunks);
 	}
 
 	tbm->iterating = TBM_ITERATING_PRIVATE;
@@ -854,11 +878,11 @@ tbm_prepare_shared_iterate(TIDBitmap *tbm)
 		if (ptbase != NULL)
 			pg_atomic_init_u32(&ptbase->refcount, 0);
 		if (npages > 1)
-			qsort_arg(ptpages->index, npages, sizeof(int),
-					  tbm_shared_comparator, ptbase->ptentry);
+			tbm_sort_shared_entries(ptpages->index, npages,
+									ptbase->ptentry);
 		if (nchunks > 1)
-			qsort_arg(ptchunks->index, nchunks, sizeof(int),
-					  tbm_shared_comparator, ptbase->ptentry);
+			tbm_sort_shared_entries(ptchunks->index, nchunks,
+									ptbase->ptentry);
 	}
 
 	/*
@@ -934,6 +958,16 @@ tbm_extract_page_tuple(PagetableEntry *page, TBMIterateResult *output)
 	return ntuples;
 }
 
+/*
+ * tbm_count_page_tuples - count the tuple offsets of a page
+ */
+static inline int
+tbm_count_page_tuples(PagetableEntry *page)
+{
+	return (int) pg_popcount((const char *) page->words,
+							 WORDS_PER_PAGE * sizeof(bitmapword));
+}
+
 /*
  *	tbm_advance_schunkbit - Advance the schunkbit
  */
@@ -967,8 +1001,8 @@ tbm_advance_schunkbit(PagetableEntry *chunk, int *schunkbitp)
  * be examined, but the condition must be rechecked anyway.  (For ease of
  * testing, recheck is always set true when ntuples < 0.)
  */
-TBMIterateResult *
-tbm_iterate(TBMIterator *iterator)
+static inline TBMIterateResult *
+tbm_iterate_internal(TBMIterator *iterator, bool extract)
 {
 	TIDBitmap  *tbm = iterator->tbm;
 	TBMIterateResult *output = &(iterator->output);
@@ -1029,7 +1063,10 @@ tbm_iterate(TBMIterator *iterator)
 			page = tbm->spages[iterator->spageptr];
 
 		/* scan bitmap to extract individual offset numbers */
-		ntuples = tbm_extract_page_tuple(page, output);
+		if (extract)
+			ntuples = tbm_extract_page_tuple(page, output);
+		else
+			ntuples = tbm_count_page_tuples(page);
 		output->blockno = page->blockno;
 		output->ntuples = ntuples;
 		output->recheck = page->recheck;
@@ -1041,6 +1078,25 @@ tbm_iterate(TBMIterator *iterator)
 	return NULL;
 }
 
+TBMIterateResult *
+tbm_iterate(TBMIterator *iterator)
+{
+	return tbm_iterate_internal(iterator, true);
+}
+
+/*
+ * tbm_iterate_blocks - like tbm_iterate, but don't extract tuple offsets
+ *
+ * The result's offsets[] array is not filled in.  This is cheaper for
+ * callers that only want to know which pages are coming, such as the
+ * prefetching done in bitmap heap scans.
+ */
+TBMIterateResult *
+tbm_iterate_blocks(TBMIterator *iterator)
+{
+	return tbm_iterate_internal(iterator, false);
+}
+
 /*
  *	tbm_shared_iterate - scan through next page of a TIDBitmap
  *
@@ -1048,8 +1104,8 @@ tbm_iterate(TBMIterator *iterator)
  *	across multiple processes.  We need to acquire the iterator LWLock,
  *	before accessing the shared members.
  */
-TBMIterateResult *
-tbm_shared_iterate(TBMSharedIterator *iterator)
+static inline TBMIterateResult *
+tbm_shared_iterate_internal(TBMSharedIterator *iterator, bool extract)
 {
 	TBMIterateResult *output = &iterator->output;
 	TBMSharedIteratorState *istate = iterator->state;
@@ -1115,17 +1171,23 @@ tbm_shared_iterate(TBMSharedIterator *iterator)
 	if (istate->spageptr < istate->npages)
 	{
 		PagetableEntry *page = &ptbase[idxpages[istate->spageptr]];
-		int			ntuples;
 
-		/* scan bitmap to extract individual offset numbers */
-		ntuples = tbm_extract_page_tuple(page, output);
-		output->blockno = page->blockno;
-		output->ntuples = ntuples;
-		output->recheck = page->recheck;
 		istate->spageptr++;
 
+		/*
+		 * The page entries don't change while we iterate, so there's no need
+		 * to keep other processes waiting while we look at this one.
+		 */
 		LWLockRelease(&istate->lock);
 
+		/* scan bitmap to extract individual offset numbers */
+		if (extract)
+			output->ntuples = tbm_extract_page_tuple(page, output);
+		else
+			output->ntuples = tbm_count_page_tuples(page);
+		output->blockno = page->blockno;
+		output->recheck = page->recheck;
+
 		return output;
 	}
 
@@ -1135,6 +1197,22 @@ tbm_shared_iterate(TBMSharedIterator *iterator)
 	return NULL;
 }
 
+TBMIterateResult *
+tbm_shared_iterate(TBMSharedIterator *iterator)
+{
+	return tbm_shared_iterate_internal(iterator, true);
+}
+
+/*
+ * tbm_shared_iterate_blocks - like tbm_shared_iterate, but don't extract
+ * tuple offsets
+ */
+TBMIterateResult *
+tbm_shared_iterate_blocks(TBMSharedIterator *iterator)
+{
+	return tbm_shared_iterate_internal(iterator, false);
+}
+
 /*
  * tbm_end_iterate - finish an iteration over a TIDBitmap
  *
@@ -1417,37 +1495,6 @@ tbm_lossify(TIDBitmap *tbm)
 		tbm->maxentries = Min(tbm->nentries, (INT_MAX - 1) / 2) * 2;
 }
 
-/*
- * qsort comparator to handle PagetableEntry pointers.
- */
-static int
-tbm_comparator(const void *left, const void *right)
-{
-	BlockNumber l = (*((PagetableEntry *const *) left))->blockno;
-	BlockNumber r = (*((PagetableEntry *const *) right))->blockno;
-
-	return pg_cmp_u32(l, r);
-}
-
-/*
- * As above, but this will get index into PagetableEntry array.  Therefore,
- * it needs to get actual PagetableEntry using the index before comparing the
- * blockno.
- */
-static int
-tbm_shared_comparator(const void *left, const void *right, void *arg)
-{
-	PagetableEntry *base = (PagetableEntry *) arg;
-	PagetableEntry *lpage = &base[*(int *) left];
-	PagetableEntry *rpage = &base[*(int *) right];
-
-	if (lpage->blockno < rpage->blockno)
-		return -1;
-	else if (lpage->blockno > rpage->blockno)
-		return 1;
-	return 0;
-}
-
 /*
  *	tbm_attach_shared_iterate
  *
@@ -78,6 +78,7 @@ typedef enum pushdown_safe_type
 /* These parameters are set by GUC */
 bool		enable_geqo = false;	/* just in case GUC doesn't set it */
 int			geqo_threshold;
+int			join_search_method = JOIN_SEARCH_GENETIC;
 int			min_parallel_table_scan_size;
 int			min_parallel_index_scan_size;
 
@@ -3372,7 +3373,21 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 		if (join_search_hook)
 			return (*join_search_hook) (root, levels_needed, initial_rels);
 		else if (enable_geqo && levels_needed >= geqo_threshold)
+		{
+			/*
+			 * The IDP search gives up if its greedy choices lead it into a
+			 * join order it cannot complete; GEQO then has to cope.
+			 */
+			if (join_search_method == JOIN_SEARCH_IDP)
+			{
+				RelOptInfo *rel = idp_join_search(root, levels_needed,
+												  initial_rels);
+
+				if (rel != NULL)
+					return rel;
+			}
 			return geqo(root, levels_needed, initial_rels);
+		}
 		else
 			return standard_join_search(root, levels_needed, initial_rels);
 	}
@@ -42,6 +42,11 @@ static void addRangeClause(RangeQueryClause **rqlist, Node *clause,
 						   bool varonleft, bool isLTsel, Selectivity s2);
 static RelOptInfo *find_single_rel_for_clauses(PlannerInfo *root,
 											   List *clauses);
+static Selectivity clauselist_eqjoin_selectivity(PlannerInfo *root,
+												 List *clauses,
+												 JoinType jointype,
+												 SpecialJoinInfo *sjinfo,
+												 Bitmapset **estimatedclauses);
 static Selectivity clauselist_selectivity_or(PlannerInfo *root,
 											 List *clauses,
 											 int varRelid,
@@ -154,6 +159,16 @@ clauselist_selectivity_ext(PlannerInfo *root,
 											jointype, sjinfo, rel,
 											&estimatedclauses, false);
 	}
+	else if (use_extended_stats && rel == NULL && varRelid == 0 &&
+			 sjinfo != NULL)
+	{
+		/*
+		 * For join clauses, estimate groups of equality clauses between the
+		 * same two relations together, if extended statistics allow.
+		 */
+		s1 = clauselist_eqjoin_selectivity(root, clauses, jointype, sjinfo,
+										   &estimatedclauses);
+	}
 
 	/*
 	 * Apply normal selectivity estimates for remaining clauses. We'll be
@@ -577,6 +592,115 @@ find_single_rel_for_clauses(PlannerInfo *root, List *clauses)
 	return NULL;				/* no clauses */
 }
 
+/*
+ * clauselist_eqjoin_selectivity
+ *		Estimate groups of equality join clauses using eqjoinsel_multi()
+ *
+ * We look for clauses of the form "rel1.x = rel2.y" whose operator uses
+ * eqjoinsel() as its join estimator, and group them by the pair of base
+ * relations they join.  Each group of two or more clauses is estimated as a
+ * whole, if extended statistics on either relation cover the columns.
+ * The 0-based list positions of the clauses estimated here are added to
+ * *estimatedclauses, and the product of the groups' selectivities is
+ * returned.
+ */
+static Selectivity
+clauselist_eqjoin_selectivity(PlannerInfo *root, List *clauses,
+							  JoinType jointype, SpecialJoinInfo *sjinfo,
+							  Bitmapset **estimatedclauses)
+{
+	int			nclauses = list_length(clauses);
+	int		   *relid1;
+	int		   *relid2;
+	Node	  **expr1;
+	Node	  **expr2;
+	Selectivity s = 1.0;
+	int			ncandidates = 0;
+	int			i;
+
+	relid1 = palloc_array(int, nclauses);
+	relid2 = palloc_array(int, nclauses);
+	expr1 = palloc_array(Node *, nclauses);
+	expr2 = palloc_array(Node *, nclauses);
+
+	/* Find the candidate clauses, ordering each one's sides by relid */
+	for (i = 0; i < nclauses; i++)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) list_nth(clauses, i);
+		OpExpr	   *expr;
+		int			left;
+		int			right;
+
+		relid1[i] = 0;
+		if (!IsA(rinfo, RestrictInfo) || rinfo->pseudoconstant ||
+			!is_opclause(rinfo->clause))
+			continue;
+		expr = (OpExpr *) rinfo->clause;
+		if (list_length(expr->args) != 2 ||
+			get_oprjoin(expr->opno) != F_EQJOINSEL)
+			continue;
+		if (!bms_get_singleton_member(rinfo->left_relids, &left) ||
+			!bms_get_singleton_member(rinfo->right_relids, &right) ||
+			left == right)
+			continue;
+
+		if (left < right)
+		{
+			relid1[i] = left;
+			relid2[i] = right;
+			expr1[i] = linitial(expr->args);
+			expr2[i] = lsecond(expr->args);
+		}
+		else
+		{
+			relid1[i] = right;
+			relid2[i] = left;
+			expr1[i] = lsecond(expr->args);
+			expr2[i] = linitial(expr->args);
+		}
+		ncandidates++;
+	}
+
+	/* Estimate each group of at least two clauses joining the same rels */
+	for (i = 0; i < nclauses && ncandidates >= 2; i++)
+	{
+		List	   *lexprs = NIL;
+		List	   *rexprs = NIL;
+		Bitmapset  *group = NULL;
+		Selectivity sel;
+
+		if (relid1[i] == 0)
+			continue;
+
+		for (int j = i; j < nclauses; j++)
+		{
+			if (relid1[j] == relid1[i] && relid2[j] == relid2[i])
+			{
+				lexprs = lappend(lexprs, expr1[j]);
+				rexprs = lappend(rexprs, expr2[j]);
+				group = bms_add_member(group, j);
+				if (j > i)
+					relid1[j] = 0;
+			}
+		}
+		ncandidates -= bms_num_members(group);
+
+		if (list_length(lexprs) >= 2 &&
+			eqjoinsel_multi(root, lexprs, rexprs, jointype, sjinfo, &sel))
+		{
+			s *= sel;
+			*estimatedclauses = bms_add_members(*estimatedclauses, group);
+		}
+	}
+
+	pfree(relid1);
+	pfree(relid2);
+	pfree(expr1);
+	pfree(expr2);
+
+	return s;
+}
+
 /*
  * treat_as_join_clause -
  *	  Decide whether an operator clause is to be handled by the
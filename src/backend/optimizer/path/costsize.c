@@ -149,6 +149,9 @@ bool		enable_partitionwise_join = false;
 bool		enable_partitionwise_aggregate = false;
 bool		enable_parallel_append = true;
 bool		enable_parallel_hash = true;
+bool		enable_parallel_memoize = false;
+bool		enable_parallel_repartition = false;
+bool		enable_parallel_sort = false;
 bool		enable_partition_pruning = true;
 bool		enable_presorted_aggregate = true;
 bool		enable_async_append = true;
@@ -192,6 +195,7 @@ static int32 get_expr_width(PlannerInfo *root, const Node *expr);
 static double relation_byte_size(double tuples, int width);
 static double page_size(double tuples, int width);
 static double get_parallel_divisor(Path *path);
+static double get_parallel_divisor_for_workers(int parallel_workers);
 
 
 /*
@@ -2492,6 +2496,39 @@ cost_material(Path *path,
 	path->total_cost = startup_cost + run_cost;
 }
 
+/*
+ * cost_repartition
+ *	  Determines and returns the cost of redistributing the rows of a partial
+ *	  path among the participants of a parallel query.
+ *
+ * All input is consumed and written out to shared temporary files before
+ * the first row can be returned, and then read back in.  As the input rows
+ * are distributed evenly, each participant gets about as many rows back as
+ * it sent, so the row count per participant doesn't change.
+ */
+void
+cost_repartition(Path *path,
+				 Cost input_startup_cost, Cost input_total_cost,
+				 double tuples, int width)
+{
+	Cost		startup_cost = input_total_cost;
+	Cost		run_cost = 0;
+	double		npages = ceil(relation_byte_size(tuples, width) / BLCKSZ);
+
+	path->rows = tuples;
+
+	/* hashing and writing out each row */
+	startup_cost += (cpu_operator_cost + cpu_tuple_cost) * tuples;
+	startup_cost += seq_page_cost * npages;
+
+	/* reading them back */
+	run_cost += cpu_tuple_cost * tuples;
+	run_cost += seq_page_cost * npages;
+
+	path->startup_cost = startup_cost;
+	path->total_cost = startup_cost + run_cost;
+}
+
 /*
  * cost_memoize_rescan
  *	  Determines the estimated cost of rescanning a Memoize node.
@@ -2504,6 +2541,10 @@ cost_material(Path *path,
  * with too many distinct parameter values.  The worst-case here is that we
  * never see any parameter value twice, in which case we'd never get a cache
  * hit and caching would be a complete waste of effort.
+ *
+ * With a cache shared by the participants of a parallel query, the hit ratio
+ * is determined by the calls made by all of them together, and the cache may
+ * be as large as all their local caches combined.
  */
 static void
 cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
@@ -2519,6 +2560,7 @@ cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
 
 	double		hash_mem_bytes;
 	double		est_entry_bytes;
+	double		est_local_entries;
 	double		est_cache_entries;
 	double		ndistinct;
 	double		evict_ratio;
@@ -2543,7 +2585,21 @@ cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
 		est_entry_bytes += get_expr_width(root, (Node *) lfirst(lc));
 
 	/* estimate on the upper limit of cache entries we can hold at once */
-	est_cache_entries = floor(hash_mem_bytes / est_entry_bytes);
+	est_local_entries = floor(hash_mem_bytes / est_entry_bytes);
+	est_cache_entries = est_local_entries;
+
+	/*
+	 * A shared cache sees the calls of all participants and gets a memory
+	 * budget for each of them.  calls is per participant, so scale it up by
+	 * the same divisor that scaled the outer path's row count down.
+	 */
+	if (mpath->shared_workers > 0)
+	{
+		calls *= get_parallel_divisor_for_workers(mpath->shared_workers);
+		est_cache_entries = floor(hash_mem_bytes *
+								  (mpath->shared_workers + 1) /
+								  est_entry_bytes);
+	}
 
 	/* estimate on the distinct number of parameter values */
 	ndistinct = estimate_num_groups(root, mpath->param_exprs, calls, NULL,
@@ -2567,9 +2623,11 @@ cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
 	 * This will ultimately determine the hash table size that the executor
 	 * will use.  If we leave this at zero, the executor will just choose the
 	 * size itself.  Really this is not the right place to do this, but it's
-	 * convenient since everything is already calculated.
+	 * convenient since everything is already calculated.  A shared cache
+	 * still has a local hash table in each participant, bounded by the local
+	 * memory budget.
 	 */
-	mpath->est_entries = Min(Min(ndistinct, est_cache_entries),
+	mpath->est_entries = Min(Min(ndistinct, est_local_entries),
 							 PG_UINT32_MAX);
 
 	/*
@@ -2598,6 +2656,13 @@ cost_memoize_rescan(PlannerInfo *root, MemoizePath *mpath,
 	 */
 	total_cost = input_total_cost * (1.0 - hit_ratio) + cpu_operator_cost;
 
+	/*
+	 * A local miss in a shared cache is followed by a lookup in the shared
+	 * cache, which requires a lock.  Charge another cpu_operator_cost for it.
+	 */
+	if (mpath->shared_workers > 0)
+		total_cost += cpu_operator_cost;
+
 	/* Now adjust the total cost to account for cache evictions */
 
 	/* Charge a cpu_tuple_cost for evicting the actual cache entry */
@@ -6362,7 +6427,16 @@ page_size(double tuples, int width)
 static double
 get_parallel_divisor(Path *path)
 {
-	double		parallel_divisor = path->parallel_workers;
+	return get_parallel_divisor_for_workers(path->parallel_workers);
+}
+
+/*
+ * As above, for a given number of planned workers.
+ */
+static double
+get_parallel_divisor_for_workers(int parallel_workers)
+{
+	double		parallel_divisor = parallel_workers;
 
 	/*
 	 * Early experience with parallel query suggests that when there is only
@@ -6379,7 +6453,7 @@ get_parallel_divisor(Path *path)
 	{
 		double		leader_contribution;
 
-		leader_contribution = 1.0 - (0.3 * path->parallel_workers);
+		leader_contribution = 1.0 - (0.3 * parallel_workers);
 		if (leader_contribution > 0)
 			parallel_divisor += leader_contribution;
 	}
@@ -33,11 +33,21 @@
 #include "utils/lsyscache.h"
 
 
+static EquivalenceMember *make_eq_member(EquivalenceClass *ec,
+										 Expr *expr, Relids relids,
+										 JoinDomain *jdomain,
+										 EquivalenceMember *parent,
+										 Oid datatype);
 static EquivalenceMember *add_eq_member(EquivalenceClass *ec,
 										Expr *expr, Relids relids,
 										JoinDomain *jdomain,
-										EquivalenceMember *parent,
 										Oid datatype);
+static EquivalenceMember *add_child_eq_member(PlannerInfo *root,
+											  EquivalenceClass *ec,
+											  Expr *expr, Relids relids,
+											  JoinDomain *jdomain,
+											  EquivalenceMember *parent,
+											  Oid datatype, int child_relid);
 static bool is_exprlist_member(Expr *node, List *exprs);
 static void generate_base_implied_equalities_const(PlannerInfo *root,
 												   EquivalenceClass *ec);
@@ -374,7 +384,7 @@ process_equivalence(PlannerInfo *root,
 	{
 		/* Case 3: add item2 to ec1 */
 		em2 = add_eq_member(ec1, item2, item2_relids,
-							jdomain, NULL, item2_type);
+							jdomain, item2_type);
 		ec1->ec_sources = lappend(ec1->ec_sources, restrictinfo);
 		ec1->ec_min_security = Min(ec1->ec_min_security,
 								   restrictinfo->security_level);
@@ -391,7 +401,7 @@ process_equivalence(PlannerInfo *root,
 	{
 		/* Case 3: add item1 to ec2 */
 		em1 = add_eq_member(ec2, item1, item1_relids,
-							jdomain, NULL, item1_type);
+							jdomain, item1_type);
 		ec2->ec_sources = lappend(ec2->ec_sources, restrictinfo);
 		ec2->ec_min_security = Min(ec2->ec_min_security,
 								   restrictinfo->security_level);
@@ -412,6 +422,8 @@ process_equivalence(PlannerInfo *root,
 		ec->ec_opfamilies = opfamilies;
 		ec->ec_collation = collation;
 		ec->ec_members = NIL;
+		ec->ec_childmembers = NULL;
+		ec->ec_childmembers_size = 0;
 		ec->ec_sources = list_make1(restrictinfo);
 		ec->ec_derives = NIL;
 		ec->ec_relids = NULL;
@@ -423,9 +435,9 @@ process_equivalence(PlannerInfo *root,
 		ec->ec_max_security = restrictinfo->security_level;
 		ec->ec_merged = NULL;
 		em1 = add_eq_member(ec, item1, item1_relids,
-							jdomain, NULL, item1_type);
+							jdomain, item1_type);
 		em2 = add_eq_member(ec, item2, item2_relids,
-							jdomain, NULL, item2_type);
+							jdomain, item2_type);
 
 		root->eq_classes = lappend(root->eq_classes, ec);
 
@@ -511,11 +523,11 @@ canonicalize_ec_expression(Expr *expr, Oid req_type, Oid req_collation)
 }
 
 /*
- * add_eq_member - build a new EquivalenceMember and add it to an EC
+ * make_eq_member - build a new EquivalenceMember without adding it to an EC
  */
 static EquivalenceMember *
-add_eq_member(EquivalenceClass *ec, Expr *expr, Relids relids,
-			  JoinDomain *jdomain, EquivalenceMember *parent, Oid datatype)
+make_eq_member(EquivalenceClass *ec, Expr *expr, Relids relids,
+			   JoinDomain *jdomain, EquivalenceMember *parent, Oid datatype)
 {
 	EquivalenceMember *em = makeNode(EquivalenceMember);
 
@@ -546,11 +558,108 @@ add_eq_member(EquivalenceClass *ec, Expr *expr, Relids relids,
 	{
 		ec->ec_relids = bms_add_members(ec->ec_relids, relids);
 	}
+
+	return em;
+}
+
+/*
+ * add_eq_member - build a new non-child EquivalenceMember and add it to an EC
+ */
+static EquivalenceMember *
+add_eq_member(EquivalenceClass *ec, Expr *expr, Relids relids,
+			  JoinDomain *jdomain, Oid datatype)
+{
+	EquivalenceMember *em = make_eq_member(ec, expr, relids, jdomain,
+										   NULL, datatype);
+
 	ec->ec_members = lappend(ec->ec_members, em);
 
 	return em;
 }
 
+/*
+ * add_child_eq_member - build a new child EquivalenceMember and add it to
+ * the EC's list of child members for child_relid
+ *
+ * child_relid must be a member of relids, and should be one of the child
+ * rels rather than a relid that many children share, so that the lists stay
+ * short.
+ */
+static EquivalenceMember *
+add_child_eq_member(PlannerInfo *root, EquivalenceClass *ec, Expr *expr,
+					Relids relids, JoinDomain *jdomain,
+					EquivalenceMember *parent, Oid datatype, int child_relid)
+{
+	EquivalenceMember *em;
+
+	Assert(parent != NULL);
+	Assert(bms_is_member(child_relid, relids));
+
+	em = make_eq_member(ec, expr, relids, jdomain, parent, datatype);
+
+	/* Make room for the relid, growing along with simple_rel_array. */
+	if (child_relid >= ec->ec_childmembers_size)
+	{
+		int			new_size = Max(root->simple_rel_array_size,
+								   child_relid + 1);
+
+		if (ec->ec_childmembers == NULL)
+			ec->ec_childmembers = palloc0_array(List *, new_size);
+		else
+			ec->ec_childmembers = repalloc0_array(ec->ec_childmembers, List *,
+												  ec->ec_childmembers_size,
+												  new_size);
+		ec->ec_childmembers_size = new_size;
+	}
+
+	ec->ec_childmembers[child_relid] =
+		lappend(ec->ec_childmembers[child_relid], em);
+
+	return em;
+}
+
+/*
+ * setup_eclass_member_iterator
+ *		Prepare to iterate over the members of an EC, including the child
+ *		members listed under any of child_relids
+ *
+ * child_relids may be NULL to get just the non-child members.
+ */
+void
+setup_eclass_member_iterator(EquivalenceMemberIterator *it,
+							 EquivalenceClass *ec, Relids child_relids)
+{
+	it->ec = ec;
+	it->child_relids = ec->ec_childmembers != NULL ? child_relids : NULL;
+	it->current_relid = -1;
+	it->current_list = ec->ec_members;
+	it->current_index = 0;
+}
+
+/*
+ * eclass_member_iterator_next
+ *		Return the next member, or NULL when there are no more
+ */
+EquivalenceMember *
+eclass_member_iterator_next(EquivalenceMemberIterator *it)
+{
+	while (it->current_index >= list_length(it->current_list))
+	{
+		EquivalenceClass *ec = it->ec;
+
+		it->current_relid = bms_next_member(it->child_relids,
+											it->current_relid);
+		if (it->current_relid < 0 ||
+			it->current_relid >= ec->ec_childmembers_size)
+			return NULL;
+		it->current_list = ec->ec_childmembers[it->current_relid];
+		it->current_index = 0;
+	}
+
+	return list_nth_node(EquivalenceMember, it->current_list,
+						 it->current_index++);
+}
+
 
 /*
  * get_eclass_for_sort_expr
@@ -597,7 +706,9 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	Relids		expr_relids;
 	EquivalenceClass *newec;
 	EquivalenceMember *newem;
-	ListCell   *lc1;
+	Bitmapset  *matching_ecs;
+	int			expr_relid;
+	int			i;
 	MemoryContext oldcontext;
 
 	/*
@@ -612,12 +723,32 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	jdomain = linitial_node(JoinDomain, root->join_domains);
 
 	/*
-	 * Scan through the existing EquivalenceClasses for a match
+	 * Get the precise set of relids appearing in the expression.
 	 */
-	foreach(lc1, root->eq_classes)
+	expr_relids = pull_varnos(root, (Node *) expr);
+
+	/*
+	 * A matching member has the same relids as the expression, so once
+	 * eclass_indexes are available we need only look at the ECs that mention
+	 * the expression's relation.  That is the common case of a sort key over
+	 * a single base or partition rel, and saves a scan of every EC in the
+	 * query.  Otherwise, scan through all the existing EquivalenceClasses.
+	 */
+	matching_ecs = NULL;
+	if (root->ec_merging_done &&
+		bms_get_singleton_member(expr_relids, &expr_relid) &&
+		root->simple_rel_array[expr_relid] != NULL)
+		matching_ecs = root->simple_rel_array[expr_relid]->eclass_indexes;
+	else if (root->eq_classes != NIL)
+		matching_ecs = bms_add_range(NULL, 0, list_length(root->eq_classes) - 1);
+
+	i = -1;
+	while ((i = bms_next_member(matching_ecs, i)) >= 0)
 	{
-		EquivalenceClass *cur_ec = (EquivalenceClass *) lfirst(lc1);
-		ListCell   *lc2;
+		EquivalenceClass *cur_ec = list_nth_node(EquivalenceClass,
+												 root->eq_classes, i);
+		EquivalenceMemberIterator it;
+		EquivalenceMember *cur_em;
 
 		/*
 		 * Never match to a volatile EC, except when we are looking at another
@@ -632,10 +763,9 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 		if (!equal(opfamilies, cur_ec->ec_opfamilies))
 			continue;
 
-		foreach(lc2, cur_ec->ec_members)
+		setup_eclass_member_iterator(&it, cur_ec, rel);
+		while ((cur_em = eclass_member_iterator_next(&it)) != NULL)
 		{
-			EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc2);
-
 			/*
 			 * Ignore child members unless they match the request.
 			 */
@@ -682,6 +812,8 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	newec->ec_opfamilies = list_copy(opfamilies);
 	newec->ec_collation = collation;
 	newec->ec_members = NIL;
+	newec->ec_childmembers = NULL;
+	newec->ec_childmembers_size = 0;
 	newec->ec_sources = NIL;
 	newec->ec_derives = NIL;
 	newec->ec_relids = NULL;
@@ -696,13 +828,8 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	if (newec->ec_has_volatile && sortref == 0) /* should not happen */
 		elog(ERROR, "volatile EquivalenceClass has no sortref");
 
-	/*
-	 * Get the precise set of relids appearing in the expression.
-	 */
-	expr_relids = pull_varnos(root, (Node *) expr);
-
-	newem = add_eq_member(newec, copyObject(expr), expr_relids,
-						  jdomain, NULL, opcintype);
+	newem = add_eq_member(newec, copyObject(expr), bms_copy(expr_relids),
+						  jdomain, opcintype);
 
 	/*
 	 * add_eq_member doesn't check for volatile functions, set-returning
@@ -731,8 +858,8 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	if (root->ec_merging_done)
 	{
 		int			ec_index = list_length(root->eq_classes) - 1;
-		int			i = -1;
 
+		i = -1;
 		while ((i = bms_next_member(newec->ec_relids, i)) > 0)
 		{
 			RelOptInfo *rel = root->simple_rel_array[i];
@@ -772,15 +899,16 @@ find_ec_member_matching_expr(EquivalenceClass *ec,
 							 Expr *expr,
 							 Relids relids)
 {
-	ListCell   *lc;
+	EquivalenceMemberIterator it;
+	EquivalenceMember *em;
 
 	/* We ignore binary-compatible relabeling on both ends */
 	while (expr && IsA(expr, RelabelType))
 		expr = ((RelabelType *) expr)->arg;
 
-	foreach(lc, ec->ec_members)
+	setup_eclass_member_iterator(&it, ec, relids);
+	while ((em = eclass_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
 		Expr	   *emexpr;
 
 		/*
@@ -839,11 +967,12 @@ find_computable_ec_member(PlannerInfo *root,
 						  Relids relids,
 						  bool require_parallel_safe)
 {
-	ListCell   *lc;
+	EquivalenceMemberIterator it;
+	EquivalenceMember *em;
 
-	foreach(lc, ec->ec_members)
+	setup_eclass_member_iterator(&it, ec, relids);
+	while ((em = eclass_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
 		List	   *exprvars;
 		ListCell   *lc2;
 
@@ -1570,6 +1699,8 @@ generate_join_implied_equalities_normal(PlannerInfo *root,
 	List	   *new_members = NIL;
 	List	   *outer_members = NIL;
 	List	   *inner_members = NIL;
+	EquivalenceMemberIterator it;
+	EquivalenceMember *em;
 	ListCell   *lc1;
 
 	/*
@@ -1581,24 +1712,23 @@ generate_join_implied_equalities_normal(PlannerInfo *root,
 	 * as well as to at least one input member, plus enforce at least one
 	 * outer-rel member equal to at least one inner-rel member.
 	 */
-	foreach(lc1, ec->ec_members)
+	setup_eclass_member_iterator(&it, ec, join_relids);
+	while ((em = eclass_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc1);
-
 		/*
 		 * We don't need to check explicitly for child EC members.  This test
 		 * against join_relids will cause them to be ignored except when
 		 * considering a child inner rel, which is what we want.
 		 */
-		if (!bms_is_subset(cur_em->em_relids, join_relids))
+		if (!bms_is_subset(em->em_relids, join_relids))
 			continue;			/* not computable yet, or wrong child */
 
-		if (bms_is_subset(cur_em->em_relids, outer_relids))
-			outer_members = lappend(outer_members, cur_em);
-		else if (bms_is_subset(cur_em->em_relids, inner_relids))
-			inner_members = lappend(inner_members, cur_em);
+		if (bms_is_subset(em->em_relids, outer_relids))
+			outer_members = lappend(outer_members, em);
+		else if (bms_is_subset(em->em_relids, inner_relids))
+			inner_members = lappend(inner_members, em);
 		else
-			new_members = lappend(new_members, cur_em);
+			new_members = lappend(new_members, em);
 	}
 
 	/*
@@ -2481,8 +2611,6 @@ exprs_known_equal(PlannerInfo *root, Node *item1, Node *item2)
 		{
 			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
 
-			if (em->em_is_child)
-				continue;		/* ignore children here */
 			if (equal(item1, em->em_expr))
 				item1member = true;
 			else if (equal(item2, em->em_expr))
@@ -2554,9 +2682,6 @@ match_eclasses_to_foreign_key_col(PlannerInfo *root,
 			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
 			Var		   *var;
 
-			if (em->em_is_child)
-				continue;		/* ignore children here */
-
 			/* EM must be a Var, possibly with RelabelType */
 			var = (Var *) em->em_expr;
 			while (var && IsA(var, RelabelType))
@@ -2664,7 +2789,7 @@ add_child_rel_equivalences(PlannerInfo *root,
 	while ((i = bms_next_member(parent_rel->eclass_indexes, i)) >= 0)
 	{
 		EquivalenceClass *cur_ec = (EquivalenceClass *) list_nth(root->eq_classes, i);
-		int			num_members;
+		ListCell   *lc;
 
 		/*
 		 * If this EC contains a volatile expression, then generating child
@@ -2678,29 +2803,20 @@ add_child_rel_equivalences(PlannerInfo *root,
 		Assert(bms_is_subset(top_parent_relids, cur_ec->ec_relids));
 
 		/*
-		 * We don't use foreach() here because there's no point in scanning
-		 * newly-added child members, so we can stop after the last
-		 * pre-existing EC member.
+		 * We consider only original EC members here, not already-transformed
+		 * child members, which are not in ec_members.  Otherwise, if some
+		 * original member expression references more than one appendrel,
+		 * we'd get an O(N^2) explosion of useless derived expressions for
+		 * combinations of children.  (But add_child_join_rel_equivalences may
+		 * add targeted combinations for partitionwise-join purposes.)
 		 */
-		num_members = list_length(cur_ec->ec_members);
-		for (int pos = 0; pos < num_members; pos++)
+		foreach(lc, cur_ec->ec_members)
 		{
-			EquivalenceMember *cur_em = (EquivalenceMember *) list_nth(cur_ec->ec_members, pos);
+			EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc);
 
 			if (cur_em->em_is_const)
 				continue;		/* ignore consts here */
 
-			/*
-			 * We consider only original EC members here, not
-			 * already-transformed child members.  Otherwise, if some original
-			 * member expression references more than one appendrel, we'd get
-			 * an O(N^2) explosion of useless derived expressions for
-			 * combinations of children.  (But add_child_join_rel_equivalences
-			 * may add targeted combinations for partitionwise-join purposes.)
-			 */
-			if (cur_em->em_is_child)
-				continue;		/* ignore children here */
-
 			/*
 			 * Consider only members that reference and can be computed at
 			 * child's topmost parent rel.  In particular we want to exclude
@@ -2744,9 +2860,10 @@ add_child_rel_equivalences(PlannerInfo *root,
 											top_parent_relids);
 				new_relids = bms_add_members(new_relids, child_relids);
 
-				(void) add_eq_member(cur_ec, child_expr, new_relids,
-									 cur_em->em_jdomain,
-									 cur_em, cur_em->em_datatype);
+				(void) add_child_eq_member(root, cur_ec, child_expr,
+										   new_relids, cur_em->em_jdomain,
+										   cur_em, cur_em->em_datatype,
+										   child_rel->relid);
 
 				/* Record this EC index for the child rel */
 				child_rel->eclass_indexes = bms_add_member(child_rel->eclass_indexes, i);
@@ -2773,12 +2890,22 @@ add_child_join_rel_equivalences(PlannerInfo *root,
 {
 	Relids		top_parent_relids = child_joinrel->top_parent_relids;
 	Relids		child_relids = child_joinrel->relids;
+	int			child_relid;
 	Bitmapset  *matching_ecs;
 	MemoryContext oldcontext;
 	int			i;
 
 	Assert(IS_JOIN_REL(child_joinrel) && IS_JOIN_REL(parent_joinrel));
 
+	/*
+	 * The new members will be listed under the first of the child's own base
+	 * relids; outer join relids are shared with the parent and its other
+	 * children.
+	 */
+	child_relid = bms_next_member(bms_difference(child_relids,
+												 top_parent_relids), -1);
+	Assert(child_relid >= 0);
+
 	/* We need consider only ECs that mention the parent joinrel */
 	matching_ecs = get_eclass_indexes_for_relids(root, top_parent_relids);
 
@@ -2796,7 +2923,7 @@ add_child_join_rel_equivalences(PlannerInfo *root,
 	while ((i = bms_next_member(matching_ecs, i)) >= 0)
 	{
 		EquivalenceClass *cur_ec = (EquivalenceClass *) list_nth(root->eq_classes, i);
-		int			num_members;
+		ListCell   *lc;
 
 		/*
 		 * If this EC contains a volatile expression, then generating child
@@ -2810,25 +2937,16 @@ add_child_join_rel_equivalences(PlannerInfo *root,
 		Assert(bms_overlap(top_parent_relids, cur_ec->ec_relids));
 
 		/*
-		 * We don't use foreach() here because there's no point in scanning
-		 * newly-added child members, so we can stop after the last
-		 * pre-existing EC member.
+		 * We consider only original EC members here, not already-transformed
+		 * child members, which are not in ec_members.
 		 */
-		num_members = list_length(cur_ec->ec_members);
-		for (int pos = 0; pos < num_members; pos++)
+		foreach(lc, cur_ec->ec_members)
 		{
-			EquivalenceMember *cur_em = (EquivalenceMember *) list_nth(cur_ec->ec_members, pos);
+			EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc);
 
 			if (cur_em->em_is_const)
 				continue;		/* ignore consts here */
 
-			/*
-			 * We consider only original EC members here, not
-			 * already-transformed child members.
-			 */
-			if (cur_em->em_is_child)
-				continue;		/* ignore children here */
-
 			/*
 			 * We may ignore expressions that reference a single baserel,
 			 * because add_child_rel_equivalences should have handled them.
@@ -2872,9 +2990,10 @@ add_child_join_rel_equivalences(PlannerInfo *root,
 											top_parent_relids);
 				new_relids = bms_add_members(new_relids, child_relids);
 
-				(void) add_eq_member(cur_ec, child_expr, new_relids,
-									 cur_em->em_jdomain,
-									 cur_em, cur_em->em_datatype);
+				(void) add_child_eq_member(root, cur_ec, child_expr,
+										   new_relids, cur_em->em_jdomain,
+										   cur_em, cur_em->em_datatype,
+										   child_relid);
 			}
 		}
 	}
@@ -2923,12 +3042,14 @@ add_setop_child_rel_equivalences(PlannerInfo *root, RelOptInfo *child_rel,
 		 * likewise, the JoinDomain can be that of the initial member of the
 		 * Pathkey's EquivalenceClass.
 		 */
-		add_eq_member(pk->pk_eclass,
-					  tle->expr,
-					  child_rel->relids,
-					  parent_em->em_jdomain,
-					  parent_em,
-					  exprType((Node *) tle->expr));
+		add_child_eq_member(root,
+							pk->pk_eclass,
+							tle->expr,
+							child_rel->relids,
+							parent_em->em_jdomain,
+							parent_em,
+							exprType((Node *) tle->expr),
+							child_rel->relid);
 
 		lc2 = lnext(setop_pathkeys, lc2);
 	}
@@ -2995,6 +3116,7 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 	while ((i = bms_next_member(rel->eclass_indexes, i)) >= 0)
 	{
 		EquivalenceClass *cur_ec = (EquivalenceClass *) list_nth(root->eq_classes, i);
+		EquivalenceMemberIterator it;
 		EquivalenceMember *cur_em;
 		ListCell   *lc2;
 
@@ -3018,14 +3140,12 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 		 * corner cases, so for now we live with just reporting the first
 		 * match.  See also get_eclass_for_sort_expr.)
 		 */
-		cur_em = NULL;
-		foreach(lc2, cur_ec->ec_members)
+		setup_eclass_member_iterator(&it, cur_ec, rel->relids);
+		while ((cur_em = eclass_member_iterator_next(&it)) != NULL)
 		{
-			cur_em = (EquivalenceMember *) lfirst(lc2);
 			if (bms_equal(cur_em->em_relids, rel->relids) &&
 				callback(root, rel, cur_ec, cur_em, callback_arg))
 				break;
-			cur_em = NULL;
 		}
 
 		if (!cur_em)
@@ -3041,9 +3161,6 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 			Oid			eq_op;
 			RestrictInfo *rinfo;
 
-			if (other_em->em_is_child)
-				continue;		/* ignore children here */
-
 			/* Make sure it'll be a join to a different rel */
 			if (other_em == cur_em ||
 				bms_overlap(other_em->em_relids, rel->relids))
@@ -3260,9 +3377,6 @@ eclass_useful_for_merging(PlannerInfo *root,
 	{
 		EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc);
 
-		if (cur_em->em_is_child)
-			continue;			/* ignore children here */
-
 		if (!bms_overlap(cur_em->em_relids, relids))
 			return true;
 	}
@@ -0,0 +1,346 @@
+/*-------------------------------------------------------------------------
+ *
+ * idpjoin.c
+ *	  Join order search for large join problems by iterative dynamic
+ *	  programming
+ *
+ * standard_join_search() considers every way of joining the jointree items,
+ * which takes exponential time; above geqo_threshold items we traditionally
+ * hand the problem to the genetic optimizer instead.  GEQO's results depend
+ * on its random seed and its planning time is hard to predict.
+ *
+ * This module offers a deterministic alternative in the style of iterative
+ * dynamic programming (IDP).  Each round picks a small block of at most
+ * idp_block_size "clumps" (jointree items or joins already planned) using
+ * greedy operator ordering: start from the connected pair of clumps whose
+ * join is estimated to produce the fewest rows, and keep adding whichever
+ * connected clump keeps the estimated result smallest.  The block is then
+ * planned exhaustively, the same way standard_join_search() would plan it,
+ * and replaced by its join rel.  Rounds are repeated until a single clump
+ * remains.
+ *
+ * Candidate joins are only sized during the greedy phase (see
+ * make_join_rel_estimate()); paths are built only for the joins within a
+ * block.  The total work is therefore roughly quadratic in the number of
+ * jointree items, times a constant that depends on idp_block_size.
+ *
+ * Greedy choices can lead into a join order that outer-join or LATERAL
+ * restrictions do not allow to complete.  In that case we undo our changes
+ * to the join rel list and return NULL, and the caller falls back to GEQO.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/path/idpjoin.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "optimizer/joininfo.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+
+/* GUC parameter */
+int			idp_block_size = 8;
+
+static bool idp_desirable_join(PlannerInfo *root,
+							   RelOptInfo *rel1, RelOptInfo *rel2);
+static int	idp_choose_block(PlannerInfo *root, List *clumps,
+							 int max_block, RelOptInfo **block);
+static RelOptInfo *idp_plan_block(PlannerInfo *root, RelOptInfo **block,
+								  int nblock);
+static void idp_finish_join_rel(PlannerInfo *root, RelOptInfo *rel);
+
+
+/*
+ * idp_join_search
+ *	  Find a join order for the given jointree items; see header comments.
+ *
+ * Arguments and result are as for standard_join_search(), except that NULL
+ * is returned if no complete join order was found.
+ */
+RelOptInfo *
+idp_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	int			savelength;
+	struct HTAB *savehash;
+	List	   *clumps;
+	RelOptInfo **block;
+
+	Assert(root->join_rel_level == NULL);
+	Assert(levels_needed == list_length(initial_rels));
+
+	/*
+	 * Remember the join rel list so that we can undo our work if we fail, as
+	 * geqo_eval() does.  As there, make sure any hash table built meanwhile
+	 * is a new one.
+	 */
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	root->join_rel_hash = NULL;
+
+	clumps = list_copy(initial_rels);
+	block = palloc_array(RelOptInfo *, idp_block_size);
+
+	while (list_length(clumps) > 1)
+	{
+		RelOptInfo *joinrel;
+		List	   *newclumps = NIL;
+		ListCell   *lc;
+		int			nblock;
+
+		CHECK_FOR_INTERRUPTS();
+
+		nblock = idp_choose_block(root, clumps, idp_block_size, block);
+		if (nblock == 0)
+			break;
+
+		joinrel = idp_plan_block(root, block, nblock);
+		if (joinrel == NULL)
+			break;
+
+		/* Replace the block's members by their join */
+		foreach(lc, clumps)
+		{
+			RelOptInfo *clump = (RelOptInfo *) lfirst(lc);
+			bool		inblock = false;
+
+			for (int i = 0; i < nblock; i++)
+			{
+				if (block[i] == clump)
+				{
+					inblock = true;
+					break;
+				}
+			}
+			if (!inblock)
+				newclumps = lappend(newclumps, clump);
+		}
+		list_free(clumps);
+		clumps = lappend(newclumps, joinrel);
+	}
+
+	pfree(block);
+
+	if (list_length(clumps) != 1)
+	{
+		/* Failed; forget the join rels we made */
+		root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+		root->join_rel_hash = savehash;
+		return NULL;
+	}
+
+	return (RelOptInfo *) linitial(clumps);
+}
+
+/*
+ * Is it worth considering a join between these two rels?  This mirrors the
+ * tests join_search_one_level() uses to avoid clauseless joins.
+ */
+static bool
+idp_desirable_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
+{
+	return have_relevant_joinclause(root, rel1, rel2) ||
+		have_join_order_restriction(root, rel1, rel2);
+}
+
+/*
+ * idp_choose_block
+ *	  Greedily pick up to max_block clumps to be planned together
+ *
+ * The chosen clumps are stored into block[] in the order they were picked,
+ * so that each prefix of two or more of them is known to be a legal join.
+ * Returns the number of clumps chosen, or 0 if no two clumps can be joined.
+ */
+static int
+idp_choose_block(PlannerInfo *root, List *clumps, int max_block,
+				 RelOptInfo **block)
+{
+	RelOptInfo *grouprel = NULL;
+	int			nclumps = list_length(clumps);
+	bool	   *used;
+	int			nblock;
+	int			best1 = -1;
+	int			best2 = -1;
+
+	/*
+	 * Find the pair of clumps whose join is smallest.  Prefer pairs that have
+	 * a join clause or must be joined anyway; only if there are none, allow
+	 * clauseless joins.
+	 */
+	for (int pass = 0; pass < 2 && grouprel == NULL; pass++)
+	{
+		for (int i = 0; i < nclumps; i++)
+		{
+			RelOptInfo *rel1 = list_nth(clumps, i);
+
+			for (int j = i + 1; j < nclumps; j++)
+			{
+				RelOptInfo *rel2 = list_nth(clumps, j);
+				RelOptInfo *joinrel;
+
+				if (pass == 0 && !idp_desirable_join(root, rel1, rel2))
+					continue;
+
+				joinrel = make_join_rel_estimate(root, rel1, rel2);
+				if (joinrel == NULL)
+					continue;
+				if (grouprel == NULL || joinrel->rows < grouprel->rows)
+				{
+					grouprel = joinrel;
+					best1 = i;
+					best2 = j;
+				}
+			}
+		}
+	}
+
+	if (grouprel == NULL)
+		return 0;
+
+	used = palloc0_array(bool, nclumps);
+	block[0] = list_nth(clumps, best1);
+	block[1] = list_nth(clumps, best2);
+	used[best1] = used[best2] = true;
+	nblock = 2;
+
+	/*
+	 * Grow the block one connected clump at a time, always taking the one
+	 * that keeps the join smallest.
+	 */
+	while (nblock < max_block)
+	{
+		RelOptInfo *bestrel = NULL;
+		int			best = -1;
+
+		for (int i = 0; i < nclumps; i++)
+		{
+			RelOptInfo *rel = list_nth(clumps, i);
+			RelOptInfo *joinrel;
+
+			if (used[i] || !idp_desirable_join(root, grouprel, rel))
+				continue;
+
+			joinrel = make_join_rel_estimate(root, grouprel, rel);
+			if (joinrel == NULL)
+				continue;
+			if (bestrel == NULL || joinrel->rows < bestrel->rows)
+			{
+				bestrel = joinrel;
+				best = i;
+			}
+		}
+
+		if (bestrel == NULL)
+			break;
+
+		block[nblock++] = list_nth(clumps, best);
+		used[best] = true;
+		grouprel = bestrel;
+	}
+
+	pfree(used);
+
+	return nblock;
+}
+
+/*
+ * idp_plan_block
+ *	  Plan the join of the given clumps exhaustively
+ *
+ * Every subset of the block is identified by a bitmask over block[].  We
+ * visit the subsets in increasing numeric order, which guarantees that both
+ * halves of any split have been planned before the subset itself, and build
+ * paths from each split whose halves exist and are worth joining.  The splits
+ * that idp_choose_block() used are always tried, so the whole block is sure
+ * to get a join rel even if it needs a clauseless join.
+ */
+static RelOptInfo *
+idp_plan_block(PlannerInfo *root, RelOptInfo **block, int nblock)
+{
+	uint32		full = ((uint32) 1 << nblock) - 1;
+	RelOptInfo **rels;
+	RelOptInfo *result;
+
+	rels = palloc0_array(RelOptInfo *, full + 1);
+	for (int i = 0; i < nblock; i++)
+		rels[(uint32) 1 << i] = block[i];
+
+	for (uint32 set = 3; set <= full; set++)
+	{
+		List	   *joinrels = NIL;
+		uint32		greedy_left = 0;
+		ListCell   *lc;
+
+		/* skip singletons */
+		if ((set & (set - 1)) == 0)
+			continue;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* If this set is a prefix of the greedy order, note its last split */
+		if ((set & (set + 1)) == 0)
+			greedy_left = set >> 1;
+
+		/*
+		 * Visit each split into two nonempty halves once; make_join_rel()
+		 * considers both join directions itself.
+		 */
+		for (uint32 left = (set - 1) & set; left > 0; left = (left - 1) & set)
+		{
+			uint32		right = set & ~left;
+			RelOptInfo *joinrel;
+
+			if (left < right)
+				continue;
+			if (rels[left] == NULL || rels[right] == NULL)
+				continue;
+			if (left != greedy_left && right != greedy_left &&
+				!idp_desirable_join(root, rels[left], rels[right]))
+				continue;
+
+			joinrel = make_join_rel(root, rels[left], rels[right]);
+			if (joinrel == NULL)
+				continue;
+			if (rels[set] == NULL)
+				rels[set] = joinrel;
+			joinrels = list_append_unique_ptr(joinrels, joinrel);
+		}
+
+		/* We're done adding paths to this set's join rel(s) */
+		foreach(lc, joinrels)
+			idp_finish_join_rel(root, (RelOptInfo *) lfirst(lc));
+		list_free(joinrels);
+	}
+
+	result = rels[full];
+	pfree(rels);
+
+	return result;
+}
+
+/*
+ * Finish off a join rel once all its paths have been added, as
+ * standard_join_search() does at the end of each level.
+ */
+static void
+idp_finish_join_rel(PlannerInfo *root, RelOptInfo *rel)
+{
+	/* Create paths for partitionwise joins. */
+	generate_partitionwise_join_paths(root, rel);
+
+	/*
+	 * Except for the topmost scan/join rel, consider gathering partial paths.
+	 * We'll do the same for the topmost scan/join rel once we know the final
+	 * targetlist (see grouping_planner).
+	 */
+	if (!bms_equal(rel->relids, root->all_query_rels))
+		generate_useful_gather_paths(root, rel, false);
+
+	/* Find and save the cheapest paths for this rel */
+	set_cheapest(rel);
+}
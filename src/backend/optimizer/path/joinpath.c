@@ -699,6 +699,16 @@ get_memoize_path(PlannerInfo *root, RelOptInfo *innerrel,
 									&hash_operators,
 									&binary_mode))
 	{
+		int			shared_workers = 0;
+
+		/*
+		 * Below a partial outer path, each participant would otherwise fill
+		 * its own cache with mostly the same entries.  Let them share one if
+		 * allowed.
+		 */
+		if (enable_parallel_memoize && outer_path->parallel_workers > 0)
+			shared_workers = outer_path->parallel_workers;
+
 		return (Path *) create_memoize_path(root,
 											innerrel,
 											inner_path,
@@ -706,7 +716,8 @@ get_memoize_path(PlannerInfo *root, RelOptInfo *innerrel,
 											hash_operators,
 											extra->inner_unique,
 											binary_mode,
-											outer_path->rows);
+											outer_path->rows,
+											shared_workers);
 	}
 
 	return NULL;
@@ -32,6 +32,8 @@ static void make_rels_by_clauseless_joins(PlannerInfo *root,
 										  List *other_rels);
 static bool has_join_restriction(PlannerInfo *root, RelOptInfo *rel);
 static bool has_legal_joinclause(PlannerInfo *root, RelOptInfo *rel);
+static RelOptInfo *make_join_rel_guts(PlannerInfo *root, RelOptInfo *rel1,
+									  RelOptInfo *rel2, bool add_paths);
 static bool restriction_is_constant_false(List *restrictlist,
 										  RelOptInfo *joinrel,
 										  bool only_pushed_down);
@@ -702,6 +704,33 @@ init_dummy_sjinfo(SpecialJoinInfo *sjinfo, Relids left_relids,
  */
 RelOptInfo *
 make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
+{
+	return make_join_rel_guts(root, rel1, rel2, true);
+}
+
+/*
+ * make_join_rel_estimate
+ *	   Find or create the join RelOptInfo for the two given rels, as
+ *	   make_join_rel does, but don't add any paths to it.
+ *
+ * This is for join search strategies that want to compare the size estimates
+ * of candidate joins before committing to one.  The join rel is left in the
+ * join_rel_list without paths; a later make_join_rel() call for the same
+ * set of rels will fill them in.  Returns NULL if the join is not valid.
+ */
+RelOptInfo *
+make_join_rel_estimate(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
+{
+	return make_join_rel_guts(root, rel1, rel2, false);
+}
+
+/*
+ * make_join_rel_guts
+ *	   Common code for make_join_rel and make_join_rel_estimate
+ */
+static RelOptInfo *
+make_join_rel_guts(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
+				   bool add_paths)
 {
 	Relids		joinrelids;
 	SpecialJoinInfo *sjinfo;
@@ -763,9 +792,9 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 
 	/*
 	 * If we've already proven this join is empty, we needn't consider any
-	 * more paths for it.
+	 * more paths for it.  Likewise if the caller only wants the join rel.
 	 */
-	if (is_dummy_rel(joinrel))
+	if (!add_paths || is_dummy_rel(joinrel))
 	{
 		bms_free(joinrelids);
 		return joinrel;
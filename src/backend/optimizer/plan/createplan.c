@@ -90,6 +90,9 @@ static Plan *create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_p
 static Result *create_group_result_plan(PlannerInfo *root,
 										GroupResultPath *best_path);
 static ProjectSet *create_project_set_plan(PlannerInfo *root, ProjectSetPath *best_path);
+static Repartition *create_repartition_plan(PlannerInfo *root,
+											RepartitionPath *best_path,
+											int flags);
 static Material *create_material_plan(PlannerInfo *root, MaterialPath *best_path,
 									  int flags);
 static Memoize *create_memoize_plan(PlannerInfo *root, MemoizePath *best_path,
@@ -278,10 +281,14 @@ static Sort *make_sort_from_groupcols(List *groupcls,
 									  AttrNumber *grpColIdx,
 									  Plan *lefttree);
 static Material *make_material(Plan *lefttree);
+static Repartition *make_repartition(Plan *lefttree, int numCols,
+									 AttrNumber *partColIdx, Oid *partOperators,
+									 Oid *partCollations);
 static Memoize *make_memoize(Plan *lefttree, Oid *hashoperators,
 							 Oid *collations, List *param_exprs,
 							 bool singlerow, bool binary_mode,
-							 uint32 est_entries, Bitmapset *keyparamids);
+							 uint32 est_entries, Bitmapset *keyparamids,
+							 bool shared_cache);
 static WindowAgg *make_windowagg(List *tlist, Index winref,
 								 int partNumCols, AttrNumber *partColIdx, Oid *partOperators, Oid *partCollations,
 								 int ordNumCols, AttrNumber *ordColIdx, Oid *ordOperators, Oid *ordCollations,
@@ -461,6 +468,11 @@ create_plan_recurse(PlannerInfo *root, Path *best_path, int flags)
 												 (MaterialPath *) best_path,
 												 flags);
 			break;
+		case T_Repartition:
+			plan = (Plan *) create_repartition_plan(root,
+													(RepartitionPath *) best_path,
+													flags);
+			break;
 		case T_Memoize:
 			plan = (Plan *) create_memoize_plan(root,
 												(MemoizePath *) best_path,
@@ -1402,6 +1414,12 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path, int flags)
 				make_partition_pruneinfo(root, rel,
 										 best_path->subpaths,
 										 prunequal);
+
+		/* Let plancache.c know what initial pruning is likely to save */
+		if (partpruneinfo != NULL)
+			root->glob->initPruningSavings +=
+				estimate_initial_pruning_savings(root, partpruneinfo,
+												 best_path->subpaths);
 	}
 
 	plan->appendplans = subplans;
@@ -1557,6 +1575,11 @@ create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path,
 			partpruneinfo = make_partition_pruneinfo(root, rel,
 													 best_path->subpaths,
 													 prunequal);
+
+		if (partpruneinfo != NULL)
+			root->glob->initPruningSavings +=
+				estimate_initial_pruning_savings(root, partpruneinfo,
+												 best_path->subpaths);
 	}
 
 	node->mergeplans = subplans;
@@ -1655,6 +1678,40 @@ create_material_plan(PlannerInfo *root, MaterialPath *best_path, int flags)
 	return plan;
 }
 
+/*
+ * create_repartition_plan
+ *	  Create a Repartition plan for 'best_path' and (recursively) plans
+ *	  for its subpaths.
+ *
+ *	  Returns a Plan node.
+ */
+static Repartition *
+create_repartition_plan(PlannerInfo *root, RepartitionPath *best_path,
+						int flags)
+{
+	Repartition *plan;
+	Plan	   *subplan;
+
+	/*
+	 * We need the grouping columns to be labeled, to find them.  Otherwise,
+	 * since Repartition doesn't project, tlist requirements pass through.
+	 */
+	subplan = create_plan_recurse(root, best_path->subpath,
+								  flags | CP_LABEL_TLIST);
+
+	plan = make_repartition(subplan,
+							list_length(best_path->groupClause),
+							extract_grouping_cols(best_path->groupClause,
+												  subplan->targetlist),
+							extract_grouping_ops(best_path->groupClause),
+							extract_grouping_collations(best_path->groupClause,
+														subplan->targetlist));
+
+	copy_generic_path_info(&plan->plan, (Path *) best_path);
+
+	return plan;
+}
+
 /*
  * create_memoize_plan
  *	  Create a Memoize plan for 'best_path' and (recursively) plans for its
@@ -1702,7 +1759,8 @@ create_memoize_plan(PlannerInfo *root, MemoizePath *best_path, int flags)
 
 	plan = make_memoize(subplan, operators, collations, param_exprs,
 						best_path->singlerow, best_path->binary_mode,
-						best_path->est_entries, keyparamids);
+						best_path->est_entries, keyparamids,
+						best_path->shared_workers > 0);
 
 	copy_generic_path_info(&plan->plan, (Path *) best_path);
 
@@ -6515,6 +6573,25 @@ make_material(Plan *lefttree)
 	return node;
 }
 
+static Repartition *
+make_repartition(Plan *lefttree, int numCols, AttrNumber *partColIdx,
+				 Oid *partOperators, Oid *partCollations)
+{
+	Repartition *node = makeNode(Repartition);
+	Plan	   *plan = &node->plan;
+
+	plan->targetlist = lefttree->targetlist;
+	plan->qual = NIL;
+	plan->lefttree = lefttree;
+	plan->righttree = NULL;
+	node->numCols = numCols;
+	node->partColIdx = partColIdx;
+	node->partOperators = partOperators;
+	node->partCollations = partCollations;
+
+	return node;
+}
+
 /*
  * materialize_finished_plan: stick a Material node atop a completed plan
  *
@@ -6567,7 +6644,8 @@ materialize_finished_plan(Plan *subplan)
 static Memoize *
 make_memoize(Plan *lefttree, Oid *hashoperators, Oid *collations,
 			 List *param_exprs, bool singlerow, bool binary_mode,
-			 uint32 est_entries, Bitmapset *keyparamids)
+			 uint32 est_entries, Bitmapset *keyparamids,
+			 bool shared_cache)
 {
 	Memoize    *node = makeNode(Memoize);
 	Plan	   *plan = &node->plan;
@@ -6585,6 +6663,7 @@ make_memoize(Plan *lefttree, Oid *hashoperators, Oid *collations,
 	node->binary_mode = binary_mode;
 	node->est_entries = est_entries;
 	node->keyparamids = keyparamids;
+	node->shared_cache = shared_cache;
 
 	return node;
 }
@@ -7212,6 +7291,7 @@ is_projection_capable_path(Path *path)
 		case T_Hash:
 		case T_Material:
 		case T_Memoize:
+		case T_Repartition:
 		case T_Sort:
 		case T_IncrementalSort:
 		case T_Unique:
@@ -7262,6 +7342,7 @@ is_projection_capable_plan(Plan *plan)
 		case T_Hash:
 		case T_Material:
 		case T_Memoize:
+		case T_Repartition:
 		case T_Sort:
 		case T_Unique:
 		case T_SetOp:
@@ -27,6 +27,7 @@
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
+#include "executor/execQueryCache.h"
 #include "executor/executor.h"
 #include "foreign/fdwapi.h"
 #include "jit/jit.h"
@@ -296,6 +297,13 @@ standard_planner(Query *parse, const char *query_string, int cursorOptions,
 	Plan	   *top_plan;
 	ListCell   *lp,
 			   *lr;
+	bool		queryCacheable;
+
+	/*
+	 * Check whether the result could go into the query cache before planning
+	 * scribbles on the query.
+	 */
+	queryCacheable = query_cache_size > 0 && QueryCacheQueryIsCacheable(parse);
 
 	/*
 	 * Set up global state for this planner invocation.  This data is needed
@@ -323,6 +331,7 @@ standard_planner(Query *parse, const char *query_string, int cursorOptions,
 	glob->lastPlanNodeId = 0;
 	glob->transientPlan = false;
 	glob->dependsOnRole = false;
+	glob->initPruningSavings = 0;
 
 	/*
 	 * Assess whether it's feasible to use parallel mode for this query. We
@@ -544,6 +553,7 @@ standard_planner(Query *parse, const char *query_string, int cursorOptions,
 	result->transientPlan = glob->transientPlan;
 	result->dependsOnRole = glob->dependsOnRole;
 	result->parallelModeNeeded = glob->parallelModeNeeded;
+	result->initPruningSavings = glob->initPruningSavings;
 	result->planTree = top_plan;
 	result->rtable = glob->finalrtable;
 	result->permInfos = glob->finalrteperminfos;
@@ -559,6 +569,8 @@ standard_planner(Query *parse, const char *query_string, int cursorOptions,
 	result->utilityStmt = parse->utilityStmt;
 	result->stmt_location = parse->stmt_location;
 	result->stmt_len = parse->stmt_len;
+	result->queryCacheable = queryCacheable &&
+		QueryCachePlanIsCacheable(result);
 
 	result->jitFlags = PGJIT_NONE;
 	if (jit_enabled && jit_above_cost >= 0 &&
@@ -5269,11 +5281,23 @@ create_ordered_paths(PlannerInfo *root,
 			 * incremental sort when there are presorted keys.
 			 */
 			if (presorted_keys == 0 || !enable_incremental_sort)
+			{
 				sorted_path = (Path *) create_sort_path(root,
 														ordered_rel,
 														input_path,
 														root->sort_pathkeys,
 														limit_tuples);
+
+				/*
+				 * If enabled, make it a coordinated parallel sort, in which
+				 * the leader merges the runs of all participants itself.
+				 * That requires the leader to participate, and isn't
+				 * worthwhile for bounded sorts.
+				 */
+				if (enable_parallel_sort && parallel_leader_participation &&
+					limit_tuples < 0)
+					sorted_path->parallel_aware = true;
+			}
 			else
 				sorted_path = (Path *) create_incremental_sort_path(root,
 																	ordered_rel,
@@ -7079,6 +7103,41 @@ add_paths_to_grouping_rel(PlannerInfo *root, RelOptInfo *input_rel,
 									 agg_final_costs,
 									 dNumGroups));
 		}
+
+		/*
+		 * Alternatively, redistribute the partially grouped rows among the
+		 * parallel workers by the grouping columns, so that each of them can
+		 * finalize its own share of the groups, and gather the finished
+		 * groups.  That avoids finalizing all groups in the leader, which
+		 * becomes the bottleneck with many groups.  The result is a partial
+		 * path of grouped_rel, gathered below.
+		 */
+		if (enable_parallel_repartition && !parse->groupingSets &&
+			grouped_rel->consider_parallel &&
+			partially_grouped_rel && partially_grouped_rel->partial_pathlist)
+		{
+			Path	   *path = linitial(partially_grouped_rel->partial_pathlist);
+			double		dNumPartialGroups;
+
+			path = (Path *) create_repartition_path(root,
+													partially_grouped_rel,
+													path,
+													root->processed_groupClause);
+			dNumPartialGroups = clamp_row_est(dNumGroups /
+											  path->parallel_workers);
+
+			add_partial_path(grouped_rel, (Path *)
+							 create_agg_path(root,
+											 grouped_rel,
+											 path,
+											 grouped_rel->reltarget,
+											 AGG_HASHED,
+											 AGGSPLIT_FINAL_DESERIAL,
+											 root->processed_groupClause,
+											 havingQual,
+											 agg_final_costs,
+											 dNumPartialGroups));
+		}
 	}
 
 	/*
@@ -7121,6 +7180,8 @@ create_partial_grouping_paths(PlannerInfo *root,
 	AggClauseCosts *agg_final_costs = &extra->agg_final_costs;
 	Path	   *cheapest_partial_path = NULL;
 	Path	   *cheapest_total_path = NULL;
+	PathTarget *partial_target;
+	bool		partial_parallel_safe;
 	double		dNumPartialGroups = 0;
 	double		dNumPartialPartialGroups = 0;
 	ListCell   *lc;
@@ -7139,11 +7200,28 @@ create_partial_grouping_paths(PlannerInfo *root,
 		cheapest_total_path = input_rel->cheapest_total_path;
 
 	/*
-	 * If parallelism is possible for grouped_rel, then we should consider
-	 * generating partially-grouped partial paths.  However, if the input rel
-	 * has no partial paths, then we can't.
+	 * Build target list for partial aggregate paths.  These paths cannot just
+	 * emit the same tlist as regular aggregate paths, because (1) we must
+	 * include Vars and Aggrefs needed in HAVING, which might not appear in
+	 * the result tlist, and (2) the Aggrefs must be set in partial mode.
+	 */
+	partial_target = make_partial_grouping_target(root, grouped_rel->reltarget,
+												  extra->havingQual);
+
+	/*
+	 * If parallelism is possible for the partial aggregation, then we should
+	 * consider generating partially-grouped partial paths.  That requires
+	 * only the input rel and the partial target to be parallel-safe, not
+	 * grouped_rel: the final target and the HAVING qual are evaluated by the
+	 * Finalize Aggregate above the Gather.  So a parallel-restricted function
+	 * applied to an aggregate's result doesn't prevent us from aggregating in
+	 * parallel.  However, if the input rel has no partial paths, then we
+	 * can't.
 	 */
-	if (grouped_rel->consider_parallel && input_rel->partial_pathlist != NIL)
+	partial_parallel_safe = grouped_rel->consider_parallel ||
+		(input_rel->consider_parallel &&
+		 is_parallel_safe(root, (Node *) partial_target->exprs));
+	if (partial_parallel_safe && input_rel->partial_pathlist != NIL)
 		cheapest_partial_path = linitial(input_rel->partial_pathlist);
 
 	/*
@@ -7163,23 +7241,13 @@ create_partial_grouping_paths(PlannerInfo *root,
 	partially_grouped_rel = fetch_upper_rel(root,
 											UPPERREL_PARTIAL_GROUP_AGG,
 											grouped_rel->relids);
-	partially_grouped_rel->consider_parallel =
-		grouped_rel->consider_parallel;
+	partially_grouped_rel->consider_parallel = partial_parallel_safe;
 	partially_grouped_rel->reloptkind = grouped_rel->reloptkind;
 	partially_grouped_rel->serverid = grouped_rel->serverid;
 	partially_grouped_rel->userid = grouped_rel->userid;
 	partially_grouped_rel->useridiscurrent = grouped_rel->useridiscurrent;
 	partially_grouped_rel->fdwroutine = grouped_rel->fdwroutine;
-
-	/*
-	 * Build target list for partial aggregate paths.  These paths cannot just
-	 * emit the same tlist as regular aggregate paths, because (1) we must
-	 * include Vars and Aggrefs needed in HAVING, which might not appear in
-	 * the result tlist, and (2) the Aggrefs must be set in partial mode.
-	 */
-	partially_grouped_rel->reltarget =
-		make_partial_grouping_target(root, grouped_rel->reltarget,
-									 extra->havingQual);
+	partially_grouped_rel->reltarget = partial_target;
 
 	if (!extra->partial_costs_set)
 	{
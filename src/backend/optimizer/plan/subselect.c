@@ -2802,6 +2802,7 @@ finalize_plan(PlannerInfo *root, Plan *plan,
 
 		case T_ProjectSet:
 		case T_Material:
+		case T_Repartition:
 		case T_Sort:
 		case T_IncrementalSort:
 		case T_Unique:
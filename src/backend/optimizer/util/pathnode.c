@@ -1590,6 +1590,46 @@ create_material_path(RelOptInfo *rel, Path *subpath)
 	return pathnode;
 }
 
+/*
+ * create_repartition_path
+ *	  Creates a path corresponding to a Repartition plan, returning the
+ *	  pathnode.
+ *
+ * 'subpath' must be a partial path; rows are redistributed among the
+ * participants by hashing the columns of 'groupClause'.
+ */
+RepartitionPath *
+create_repartition_path(PlannerInfo *root, RelOptInfo *rel, Path *subpath,
+						List *groupClause)
+{
+	RepartitionPath *pathnode = makeNode(RepartitionPath);
+
+	Assert(subpath->parent == rel);
+	Assert(subpath->parallel_workers > 0);
+
+	pathnode->path.pathtype = T_Repartition;
+	pathnode->path.parent = rel;
+	pathnode->path.pathtarget = subpath->pathtarget;
+	pathnode->path.param_info = subpath->param_info;
+	pathnode->path.parallel_aware = true;
+	pathnode->path.parallel_safe = rel->consider_parallel &&
+		subpath->parallel_safe;
+	pathnode->path.parallel_workers = subpath->parallel_workers;
+	/* rows come back in no particular order */
+	pathnode->path.pathkeys = NIL;
+
+	pathnode->subpath = subpath;
+	pathnode->groupClause = groupClause;
+
+	cost_repartition(&pathnode->path,
+					 subpath->startup_cost,
+					 subpath->total_cost,
+					 subpath->rows,
+					 subpath->pathtarget->width);
+
+	return pathnode;
+}
+
 /*
  * create_memoize_path
  *	  Creates a path corresponding to a Memoize plan, returning the pathnode.
@@ -1597,7 +1637,8 @@ create_material_path(RelOptInfo *rel, Path *subpath)
 MemoizePath *
 create_memoize_path(PlannerInfo *root, RelOptInfo *rel, Path *subpath,
 					List *param_exprs, List *hash_operators,
-					bool singlerow, bool binary_mode, double calls)
+					bool singlerow, bool binary_mode, double calls,
+					int shared_workers)
 {
 	MemoizePath *pathnode = makeNode(MemoizePath);
 
@@ -1619,6 +1660,7 @@ create_memoize_path(PlannerInfo *root, RelOptInfo *rel, Path *subpath,
 	pathnode->singlerow = singlerow;
 	pathnode->binary_mode = binary_mode;
 	pathnode->calls = calls;
+	pathnode->shared_workers = shared_workers;
 
 	/*
 	 * For now we set est_entries to 0.  cost_memoize_rescan() does all the
@@ -4079,7 +4121,8 @@ reparameterize_path(PlannerInfo *root, Path *path,
 													mpath->hash_operators,
 													mpath->singlerow,
 													mpath->binary_mode,
-													mpath->calls);
+													mpath->calls,
+													mpath->shared_workers);
 			}
 		default:
 			break;
@@ -28,6 +28,7 @@
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "commands/defrem.h"
+#include "commands/matview.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -3014,6 +3015,7 @@ transformCreateTableAsStmt(ParseState *pstate, CreateTableAsStmt *stmt)
 {
 	Query	   *result;
 	Query	   *query;
+	ListCell   *lc;
 
 	/* transform contained query, not allowing SELECT INTO */
 	query = transformStmt(pstate, stmt->query);
@@ -3064,6 +3066,23 @@ transformCreateTableAsStmt(ParseState *pstate, CreateTableAsStmt *stmt)
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 					 errmsg("materialized views cannot be unlogged")));
 
+		/*
+		 * An incrementally maintained view needs a query we know how to
+		 * maintain, and some hidden columns.
+		 */
+		foreach(lc, stmt->into->options)
+		{
+			DefElem    *def = lfirst_node(DefElem, lc);
+
+			if (def->defnamespace == NULL &&
+				strcmp(def->defname, "incremental_maintenance") == 0 &&
+				defGetBoolean(def))
+			{
+				PrepareIncrementalMatViewQuery(pstate, query);
+				break;
+			}
+		}
+
 		/*
 		 * At runtime, we'll need a copy of the parsed-but-not-rewritten Query
 		 * for purposes of creating the view's ON SELECT rule.  We stash that
@@ -54,6 +54,7 @@
 #include "partitioning/partprune.h"
 #include "utils/array.h"
 #include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
 
 
 /*
@@ -144,6 +145,9 @@ static List *make_partitionedrel_pruneinfo(PlannerInfo *root,
 										   Bitmapset *partrelids,
 										   int *relid_subplan_map,
 										   Bitmapset **matchedsubplans);
+static void estimate_survival_for_pinfo(PlannerInfo *root, List *pinfolist,
+										int index, double survival,
+										double *subplan_survival);
 static void gen_partprune_steps(RelOptInfo *rel, List *clauses,
 								PartClauseTarget target,
 								GeneratePruningStepsContext *context);
@@ -359,6 +363,116 @@ make_partition_pruneinfo(PlannerInfo *root, RelOptInfo *parentrel,
 	return pruneinfo;
 }
 
+/*
+ * estimate_initial_pruning_savings
+ *		Estimate how much of the cost of 'subpaths' is saved by initial
+ *		(executor startup) pruning with 'pruneinfo'
+ *
+ * The costs of an Append or MergeAppend with run-time pruning include every
+ * subplan, which makes a generic plan look much more expensive than a custom
+ * plan that was pruned at plan time, even though the executor will remove
+ * the same subplans as soon as the parameter values are known.  The result
+ * of this function lets plancache.c compare the two fairly.
+ *
+ * We have no idea of the parameter values, so this is necessarily crude:
+ * a level of the partition hierarchy whose initial pruning steps only
+ * compare the partition key for equality is assumed to leave one partition,
+ * and any other level a DEFAULT_INEQ_SEL fraction of its partitions.
+ */
+Cost
+estimate_initial_pruning_savings(PlannerInfo *root,
+								 PartitionPruneInfo *pruneinfo,
+								 List *subpaths)
+{
+	double	   *subplan_survival;
+	Cost		savings = 0;
+	ListCell   *lc;
+	int			i;
+
+	subplan_survival = palloc_array(double, list_length(subpaths));
+	for (i = 0; i < list_length(subpaths); i++)
+		subplan_survival[i] = 1.0;
+
+	foreach(lc, pruneinfo->prune_infos)
+		estimate_survival_for_pinfo(root, (List *) lfirst(lc), 0, 1.0,
+									subplan_survival);
+
+	i = 0;
+	foreach(lc, subpaths)
+	{
+		Path	   *path = (Path *) lfirst(lc);
+
+		savings += path->total_cost * (1.0 - subplan_survival[i]);
+		i++;
+	}
+
+	pfree(subplan_survival);
+
+	return savings;
+}
+
+/*
+ * Workhorse for estimate_initial_pruning_savings: set the survival fraction
+ * of each subplan below the index'th PartitionedRelPruneInfo of 'pinfolist',
+ * given that the partitioned rel itself survives with probability 'survival'.
+ */
+static void
+estimate_survival_for_pinfo(PlannerInfo *root, List *pinfolist, int index,
+							double survival, double *subplan_survival)
+{
+	PartitionedRelPruneInfo *pinfo = list_nth_node(PartitionedRelPruneInfo,
+												   pinfolist, index);
+
+	if (pinfo->initial_pruning_steps != NIL)
+	{
+		RelOptInfo *partrel = find_base_rel(root, pinfo->rtindex);
+		bool		equality_only = true;
+		int			nlive = 0;
+		ListCell   *lc;
+
+		foreach(lc, pinfo->initial_pruning_steps)
+		{
+			PartitionPruneStep *step = (PartitionPruneStep *) lfirst(lc);
+
+			/*
+			 * Hash partitioning steps are always equality steps.  IS NULL
+			 * steps have no strategy, and select a single partition too.
+			 */
+			if (IsA(step, PartitionPruneStepOp))
+			{
+				StrategyNumber opstrategy = ((PartitionPruneStepOp *) step)->opstrategy;
+
+				if (partrel->part_scheme->strategy != PARTITION_STRATEGY_HASH &&
+					opstrategy != InvalidStrategy &&
+					opstrategy != BTEqualStrategyNumber)
+					equality_only = false;
+			}
+			else if (((PartitionPruneStepCombine *) step)->combineOp ==
+					 PARTPRUNE_COMBINE_UNION)
+				equality_only = false;
+		}
+
+		for (int i = 0; i < pinfo->nparts; i++)
+		{
+			if (pinfo->subplan_map[i] >= 0 || pinfo->subpart_map[i] >= 0)
+				nlive++;
+		}
+
+		if (nlive > 0)
+			survival *= equality_only ? 1.0 / nlive :
+				Max(1.0 / nlive, DEFAULT_INEQ_SEL);
+	}
+
+	for (int i = 0; i < pinfo->nparts; i++)
+	{
+		if (pinfo->subplan_map[i] >= 0)
+			subplan_survival[pinfo->subplan_map[i]] = survival;
+		else if (pinfo->subpart_map[i] >= 0)
+			estimate_survival_for_pinfo(root, pinfolist, pinfo->subpart_map[i],
+										survival, subplan_survival);
+	}
+}
+
 /*
  * add_part_relids
  *		Add new info to a list of Bitmapsets of partitioned relids.
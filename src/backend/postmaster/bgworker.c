@@ -19,6 +19,7 @@
 #include "port/atomics.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/profiler.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalworker.h"
 #include "storage/ipc.h"
@@ -132,6 +133,9 @@ static const struct
 	},
 	{
 		"TablesyncWorkerMain", TablesyncWorkerMain
+	},
+	{
+		"ProfilerMain", ProfilerMain
 	}
 };
 
@@ -970,10 +974,30 @@ bool
 RegisterDynamicBackgroundWorker(BackgroundWorker *worker,
 								BackgroundWorkerHandle **handle)
 {
-	int			slotno;
-	bool		success = false;
-	bool		parallel;
-	uint64		generation = 0;
+	return RegisterDynamicBackgroundWorkers(worker, 1, handle) == 1;
+}
+
+/*
+ * Register several background workers from a regular backend at once.
+ *
+ * This is equivalent to calling RegisterDynamicBackgroundWorker() for each
+ * element of workers[] in turn and stopping at the first failure, but the
+ * slots are claimed under a single acquisition of BackgroundWorkerLock and
+ * the postmaster is signaled only once.  Since the postmaster starts all the
+ * workers it finds in one pass over the slots, this lets a caller that needs
+ * a group of workers, such as a parallel query, get them started together
+ * rather than one signal round trip after another.
+ *
+ * Returns the number of workers registered, which are always the first ones
+ * of the array.  If handles != NULL, handles[i] is set for each of those as
+ * described for RegisterDynamicBackgroundWorker(), and to NULL for the rest.
+ */
+int
+RegisterDynamicBackgroundWorkers(BackgroundWorker *workers, int nworkers,
+								 BackgroundWorkerHandle **handles)
+{
+	int			slotno = 0;
+	int			nregistered = 0;
 
 	/*
 	 * We can't register dynamic background workers from the postmaster. If
@@ -984,81 +1008,106 @@ RegisterDynamicBackgroundWorker(BackgroundWorker *worker,
 	 * structure.
 	 */
 	if (!IsUnderPostmaster)
-		return false;
+		return 0;
 
-	if (!SanityCheckBackgroundWorker(worker, ERROR))
-		return false;
+	for (int i = 0; i < nworkers; i++)
+	{
+		if (!SanityCheckBackgroundWorker(&workers[i], ERROR))
+			return 0;
+	}
 
-	parallel = (worker->bgw_flags & BGWORKER_CLASS_PARALLEL) != 0;
+	/* Allocate the handles up front; we mustn't palloc while holding the lock */
+	if (handles)
+	{
+		for (int i = 0; i < nworkers; i++)
+			handles[i] = palloc(sizeof(BackgroundWorkerHandle));
+	}
 
 	LWLockAcquire(BackgroundWorkerLock, LW_EXCLUSIVE);
 
-	/*
-	 * If this is a parallel worker, check whether there are already too many
-	 * parallel workers; if so, don't register another one.  Our view of
-	 * parallel_terminate_count may be slightly stale, but that doesn't really
-	 * matter: we would have gotten the same result if we'd arrived here
-	 * slightly earlier anyway.  There's no help for it, either, since the
-	 * postmaster must not take locks; a memory barrier wouldn't guarantee
-	 * anything useful.
-	 */
-	if (parallel && (BackgroundWorkerData->parallel_register_count -
-					 BackgroundWorkerData->parallel_terminate_count) >=
-		max_parallel_workers)
+	while (nregistered < nworkers)
 	{
-		Assert(BackgroundWorkerData->parallel_register_count -
-			   BackgroundWorkerData->parallel_terminate_count <=
-			   MAX_PARALLEL_WORKER_LIMIT);
-		LWLockRelease(BackgroundWorkerLock);
-		return false;
-	}
+		BackgroundWorker *worker = &workers[nregistered];
+		bool		parallel;
+		bool		found = false;
 
-	/*
-	 * Look for an unused slot.  If we find one, grab it.
-	 */
-	for (slotno = 0; slotno < BackgroundWorkerData->total_slots; ++slotno)
-	{
-		BackgroundWorkerSlot *slot = &BackgroundWorkerData->slot[slotno];
+		parallel = (worker->bgw_flags & BGWORKER_CLASS_PARALLEL) != 0;
 
-		if (!slot->in_use)
+		/*
+		 * If this is a parallel worker, check whether there are already too
+		 * many parallel workers; if so, don't register another one.  Our view
+		 * of parallel_terminate_count may be slightly stale, but that doesn't
+		 * really matter: we would have gotten the same result if we'd arrived
+		 * here slightly earlier anyway.  There's no help for it, either,
+		 * since the postmaster must not take locks; a memory barrier wouldn't
+		 * guarantee anything useful.
+		 */
+		if (parallel && (BackgroundWorkerData->parallel_register_count -
+						 BackgroundWorkerData->parallel_terminate_count) >=
+			max_parallel_workers)
 		{
-			memcpy(&slot->worker, worker, sizeof(BackgroundWorker));
-			slot->pid = InvalidPid; /* indicates not started yet */
-			slot->generation++;
-			slot->terminate = false;
-			generation = slot->generation;
-			if (parallel)
-				BackgroundWorkerData->parallel_register_count++;
+			Assert(BackgroundWorkerData->parallel_register_count -
+				   BackgroundWorkerData->parallel_terminate_count <=
+				   MAX_PARALLEL_WORKER_LIMIT);
+			break;
+		}
 
-			/*
-			 * Make sure postmaster doesn't see the slot as in use before it
-			 * sees the new contents.
-			 */
-			pg_write_barrier();
+		/*
+		 * Look for an unused slot.  If we find one, grab it.  Slots before
+		 * the one we took last time are known to be in use already.
+		 */
+		for (; slotno < BackgroundWorkerData->total_slots; ++slotno)
+		{
+			BackgroundWorkerSlot *slot = &BackgroundWorkerData->slot[slotno];
 
-			slot->in_use = true;
-			success = true;
-			break;
+			if (!slot->in_use)
+			{
+				memcpy(&slot->worker, worker, sizeof(BackgroundWorker));
+				slot->pid = InvalidPid; /* indicates not started yet */
+				slot->generation++;
+				slot->terminate = false;
+				if (handles)
+				{
+					handles[nregistered]->slot = slotno;
+					handles[nregistered]->generation = slot->generation;
+				}
+				if (parallel)
+					BackgroundWorkerData->parallel_register_count++;
+
+				/*
+				 * Make sure postmaster doesn't see the slot as in use before
+				 * it sees the new contents.
+				 */
+				pg_write_barrier();
+
+				slot->in_use = true;
+				found = true;
+				break;
+			}
 		}
+
+		if (!found)
+			break;
+		nregistered++;
 	}
 
 	LWLockRelease(BackgroundWorkerLock);
 
-	/* If we found a slot, tell the postmaster to notice the change. */
-	if (success)
+	/* If we found any slots, tell the postmaster to notice the change. */
+	if (nregistered > 0)
 		SendPostmasterSignal(PMSIGNAL_BACKGROUND_WORKER_CHANGE);
 
-	/*
-	 * If we found a slot and the user has provided a handle, initialize it.
-	 */
-	if (success && handle)
+	/* Give back the handles of the workers we couldn't register */
+	if (handles)
 	{
-		*handle = palloc(sizeof(BackgroundWorkerHandle));
-		(*handle)->slot = slotno;
-		(*handle)->generation = generation;
+		for (int i = nregistered; i < nworkers; i++)
+		{
+			pfree(handles[i]);
+			handles[i] = NULL;
+		}
 	}
 
-	return success;
+	return nregistered;
 }
 
 /*
@@ -31,6 +31,7 @@
  */
 #include "postgres.h"
 
+#include "access/slru.h"
 #include "access/xlog.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
@@ -221,6 +222,7 @@ BackgroundWriterMain(char *startup_data, size_t startup_data_len)
 	for (;;)
 	{
 		bool		can_hibernate;
+		bool		resize_done;
 		int			rc;
 
 		/* Clear any already-pending wakeups */
@@ -229,9 +231,17 @@ BackgroundWriterMain(char *startup_data, size_t startup_data_len)
 		HandleMainLoopInterrupts();
 
 		/*
-		 * Do one cycle of dirty-buffer writing.
+		 * Do one cycle of dirty-buffer writing.  Before that, apply any
+		 * change of active_shared_buffers; don't hibernate while buffers
+		 * remain to be evicted to shrink the pool.
 		 */
-		can_hibernate = BgBufferSync(&wb_context);
+		resize_done = BufferPoolResize();
+		can_hibernate = BgBufferSync(&wb_context) && resize_done;
+
+		/* Likewise clean the SLRU pages next in line for replacement */
+		if (bgwriter_lru_maxpages > 0 &&
+			SimpleLruWriteVictims(bgwriter_lru_maxpages) > 0)
+			can_hibernate = false;
 
 		/* Report pending statistics to the cumulative stats system */
 		pgstat_report_bgwriter();
@@ -95,6 +95,7 @@
 #include "common/file_utils.h"
 #include "common/ip.h"
 #include "common/pg_prng.h"
+#include "jit/jit.h"
 #include "lib/ilist.h"
 #include "libpq/libpq.h"
 #include "libpq/pqsignal.h"
@@ -106,6 +107,7 @@
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/profiler.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walsummarizer.h"
 #include "replication/logicallauncher.h"
@@ -221,6 +223,9 @@ int			ReservedConnections;
 static int	NumListenSockets = 0;
 static pgsocket *ListenSockets = NULL;
 
+/* Max number of connections accepted from one listen socket per wakeup */
+#define MAX_ACCEPTS_PER_WAKEUP	32
+
 /* still more option variables */
 bool		EnableSSL = false;
 
@@ -907,6 +912,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	ApplyLauncherRegister();
 
+	/* Register the sampling profiler, if enabled */
+	ProfilerRegister();
+
 	/*
 	 * process any libraries that should be preloaded at postmaster start
 	 */
@@ -929,6 +937,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	InitializeMaxBackends();
 
+	/* Likewise for the number of fast-path lock slots. */
+	InitializeFastPathLocks();
+
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
 	 */
@@ -1295,6 +1306,9 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	RemovePgTempFiles();
 
+	/* Likewise remove cached JIT code, which may be from an older binary */
+	RemoveJitCacheFiles();
+
 	/*
 	 * Initialize the autovacuum subsystem (again, no process start yet)
 	 */
@@ -1668,16 +1682,31 @@ ServerLoop(void)
 
 			if (events[i].events & WL_SOCKET_ACCEPT)
 			{
-				ClientSocket s;
+				/*
+				 * During a connection storm many connections are queued by
+				 * the time we wake up, so accept a batch of them here rather
+				 * than going around the whole loop once per connection.
+				 * Stop early if a shutdown has been requested, since the
+				 * connections would be refused anyway.
+				 */
+				for (int n = 0; n < MAX_ACCEPTS_PER_WAKEUP; n++)
+				{
+					ClientSocket s;
+					int			status;
 
-				if (AcceptConnection(events[i].fd, &s) == STATUS_OK)
-					BackendStartup(&s);
+					status = AcceptConnection(events[i].fd, &s);
+					if (status == STATUS_OK)
+						BackendStartup(&s);
 
-				/* We no longer need the open socket in this process */
-				if (s.sock != PGINVALID_SOCKET)
-				{
-					if (closesocket(s.sock) != 0)
-						elog(LOG, "could not close client socket: %m");
+					/* We no longer need the open socket in this process */
+					if (s.sock != PGINVALID_SOCKET)
+					{
+						if (closesocket(s.sock) != 0)
+							elog(LOG, "could not close client socket: %m");
+					}
+
+					if (status != STATUS_OK || pending_pm_shutdown_request)
+						break;
 				}
 			}
 		}
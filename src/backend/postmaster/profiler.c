@@ -0,0 +1,396 @@
+/*-------------------------------------------------------------------------
+ *
+ * profiler.c
+ *
+ * Background worker implementing a sampling query profiler.
+ *
+ * When profiler_buffer_size is set, a background worker wakes up every
+ * profiler_sample_interval milliseconds and records, for each backend that
+ * is running a query, the query ID, the wait event it's waiting on (if any)
+ * and the plan node it's executing.  The samples are kept in a ring buffer
+ * in shared memory, readable with pg_stat_get_profile_samples() and the
+ * pg_stat_profile view, which aggregates them per query ID, plan node and
+ * wait event.  With enough samples, the fraction of them that fall on a
+ * given node approximates the fraction of time spent there.
+ *
+ * Backends don't ordinarily advertise their current plan node.  When the
+ * profiler is enabled, the executor wraps each node's ExecProcNode callback
+ * to store the node's type and ID in PGPROC->exec_node_info while the node
+ * runs (see execProcnode.c).  That's two stores per call, and nothing at
+ * all when the profiler is disabled.  The sampler reads the field without
+ * any locking; a sample taken while a backend switches nodes may be
+ * attributed to either node, which is harmless for a statistical profile.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/profiler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/nodes.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "postmaster/profiler.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/backend_status.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+#include "utils/wait_event.h"
+
+#define UINT32_ACCESS_ONCE(var)		 ((uint32)(*((volatile uint32 *)&(var))))
+
+/* One sample of one backend */
+typedef struct ProfilerSample
+{
+	TimestampTz sample_time;
+	uint64		query_id;
+	int			pid;
+	uint32		wait_event_info;	/* 0 if running on CPU */
+	uint32		exec_node_info; /* see PROFILER_NODE_INFO, 0 if none */
+} ProfilerSample;
+
+/*
+ * Shared ring buffer of samples.  nsamples is the total number of samples
+ * ever written, so the newest one is at (nsamples - 1) % profiler_buffer_size.
+ * Protected by ProfilerLock.
+ */
+typedef struct ProfilerShmemStruct
+{
+	uint64		nsamples;
+	ProfilerSample samples[FLEXIBLE_ARRAY_MEMBER];
+} ProfilerShmemStruct;
+
+static ProfilerShmemStruct *ProfilerShmem = NULL;
+
+/* GUC parameters */
+int			profiler_buffer_size = 0;
+int			profiler_sample_interval = 10;
+
+static void profiler_take_samples(ProfilerSample *batch);
+static const char *profiler_node_type_name(NodeTag tag);
+
+
+Size
+ProfilerShmemSize(void)
+{
+	if (!ProfilerEnabled())
+		return 0;
+
+	return add_size(offsetof(ProfilerShmemStruct, samples),
+					mul_size(profiler_buffer_size, sizeof(ProfilerSample)));
+}
+
+void
+ProfilerShmemInit(void)
+{
+	bool		found;
+
+	if (!ProfilerEnabled())
+		return;
+
+	ProfilerShmem = (ProfilerShmemStruct *)
+		ShmemInitStruct("Sampling Profiler Data", ProfilerShmemSize(), &found);
+
+	if (!found)
+		ProfilerShmem->nsamples = 0;
+}
+
+/*
+ * Register the profiler background worker, if the profiler is enabled.
+ */
+void
+ProfilerRegister(void)
+{
+	BackgroundWorker bgw;
+
+	if (!ProfilerEnabled())
+		return;
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	bgw.bgw_start_time = BgWorkerStart_ConsistentState;
+	snprintf(bgw.bgw_library_name, MAXPGPATH, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "ProfilerMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN, "sampling profiler");
+	snprintf(bgw.bgw_type, BGW_MAXLEN, "sampling profiler");
+	bgw.bgw_restart_time = 5;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = (Datum) 0;
+
+	RegisterBackgroundWorker(&bgw);
+}
+
+/*
+ * Main loop of the profiler background worker.
+ */
+void
+ProfilerMain(Datum main_arg)
+{
+	ProfilerSample *batch;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	/* There can't be more samples per round than backend status slots */
+	batch = palloc(sizeof(ProfilerSample) *
+				   (MaxBackends + NUM_AUXILIARY_PROCS));
+
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		profiler_take_samples(batch);
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 profiler_sample_interval,
+						 WAIT_EVENT_PROFILER_MAIN);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Take one sample of every backend that's running a query, and append them
+ * to the ring buffer.  "batch" is scratch space for one sample per backend.
+ */
+static void
+profiler_take_samples(ProfilerSample *batch)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	int			nbatch = 0;
+
+	for (int procno = 0; procno < MaxBackends + NUM_AUXILIARY_PROCS; procno++)
+	{
+		PGPROC	   *proc = GetPGProcByNumber(procno);
+		ProfilerSample *sample = &batch[nbatch];
+		BackendState state;
+		int			pid;
+
+		if (proc == MyProc)
+			continue;
+		if (!pgstat_get_backend_sample(procno, &pid, &state,
+									   &sample->query_id))
+			continue;
+		if (state != STATE_RUNNING && state != STATE_FASTPATH)
+			continue;
+
+		sample->sample_time = now;
+		sample->pid = pid;
+		sample->wait_event_info = UINT32_ACCESS_ONCE(proc->wait_event_info);
+		sample->exec_node_info = UINT32_ACCESS_ONCE(proc->exec_node_info);
+		nbatch++;
+	}
+
+	if (nbatch == 0)
+		return;
+
+	LWLockAcquire(ProfilerLock, LW_EXCLUSIVE);
+	for (int i = 0; i < nbatch; i++)
+	{
+		ProfilerShmem->samples[ProfilerShmem->nsamples % profiler_buffer_size] =
+			batch[i];
+		ProfilerShmem->nsamples++;
+	}
+	LWLockRelease(ProfilerLock);
+}
+
+/*
+ * Name of a plan node type, as shown by EXPLAIN.
+ */
+static const char *
+profiler_node_type_name(NodeTag tag)
+{
+	switch (tag)
+	{
+		case T_Result:
+			return "Result";
+		case T_ProjectSet:
+			return "ProjectSet";
+		case T_ModifyTable:
+			return "ModifyTable";
+		case T_Append:
+			return "Append";
+		case T_MergeAppend:
+			return "Merge Append";
+		case T_RecursiveUnion:
+			return "Recursive Union";
+		case T_BitmapAnd:
+			return "BitmapAnd";
+		case T_BitmapOr:
+			return "BitmapOr";
+		case T_NestLoop:
+			return "Nested Loop";
+		case T_MergeJoin:
+			return "Merge Join";
+		case T_HashJoin:
+			return "Hash Join";
+		case T_SeqScan:
+			return "Seq Scan";
+		case T_SampleScan:
+			return "Sample Scan";
+		case T_Gather:
+			return "Gather";
+		case T_GatherMerge:
+			return "Gather Merge";
+		case T_IndexScan:
+			return "Index Scan";
+		case T_IndexOnlyScan:
+			return "Index Only Scan";
+		case T_BitmapIndexScan:
+			return "Bitmap Index Scan";
+		case T_BitmapHeapScan:
+			return "Bitmap Heap Scan";
+		case T_TidScan:
+			return "Tid Scan";
+		case T_TidRangeScan:
+			return "Tid Range Scan";
+		case T_SubqueryScan:
+			return "Subquery Scan";
+		case T_FunctionScan:
+			return "Function Scan";
+		case T_TableFuncScan:
+			return "Table Function Scan";
+		case T_ValuesScan:
+			return "Values Scan";
+		case T_CteScan:
+			return "CTE Scan";
+		case T_NamedTuplestoreScan:
+			return "Named Tuplestore Scan";
+		case T_WorkTableScan:
+			return "WorkTable Scan";
+		case T_ForeignScan:
+			return "Foreign Scan";
+		case T_CustomScan:
+			return "Custom Scan";
+		case T_Material:
+			return "Materialize";
+		case T_Memoize:
+			return "Memoize";
+		case T_Repartition:
+			return "Repartition";
+		case T_Sort:
+			return "Sort";
+		case T_IncrementalSort:
+			return "Incremental Sort";
+		case T_Group:
+			return "Group";
+		case T_Agg:
+			return "Aggregate";
+		case T_WindowAgg:
+			return "WindowAgg";
+		case T_Unique:
+			return "Unique";
+		case T_SetOp:
+			return "SetOp";
+		case T_LockRows:
+			return "LockRows";
+		case T_Limit:
+			return "Limit";
+		case T_Hash:
+			return "Hash";
+		default:
+			return "???";
+	}
+}
+
+/*
+ * Return the samples currently in the ring buffer, oldest first.
+ */
+Datum
+pg_stat_get_profile_samples(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PROFILE_SAMPLES_COLS	7
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	ProfilerSample *samples;
+	uint64		first;
+	uint64		last;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (!ProfilerEnabled())
+		return (Datum) 0;
+
+	/* Copy the buffer, so as not to hold the lock while building tuples */
+	samples = palloc(sizeof(ProfilerSample) * profiler_buffer_size);
+	LWLockAcquire(ProfilerLock, LW_SHARED);
+	last = ProfilerShmem->nsamples;
+	first = last > profiler_buffer_size ? last - profiler_buffer_size : 0;
+	for (uint64 n = first; n < last; n++)
+		samples[n - first] = ProfilerShmem->samples[n % profiler_buffer_size];
+	LWLockRelease(ProfilerLock);
+
+	for (uint64 n = 0; n < last - first; n++)
+	{
+		ProfilerSample *sample = &samples[n];
+		Datum		values[PG_STAT_GET_PROFILE_SAMPLES_COLS] = {0};
+		bool		nulls[PG_STAT_GET_PROFILE_SAMPLES_COLS] = {0};
+		const char *wait_event_type;
+		const char *wait_event;
+
+		values[0] = TimestampTzGetDatum(sample->sample_time);
+		values[1] = Int32GetDatum(sample->pid);
+		if (sample->query_id != 0)
+			values[2] = UInt64GetDatum(sample->query_id);
+		else
+			nulls[2] = true;
+
+		wait_event_type = pgstat_get_wait_event_type(sample->wait_event_info);
+		wait_event = pgstat_get_wait_event(sample->wait_event_info);
+		if (wait_event_type)
+			values[3] = CStringGetTextDatum(wait_event_type);
+		else
+			nulls[3] = true;
+		if (wait_event)
+			values[4] = CStringGetTextDatum(wait_event);
+		else
+			nulls[4] = true;
+
+		if (sample->exec_node_info != 0)
+		{
+			values[5] = CStringGetTextDatum(profiler_node_type_name(sample->exec_node_info >> 16));
+			values[6] = Int32GetDatum(sample->exec_node_info & 0xFFFF);
+		}
+		else
+		{
+			nulls[5] = true;
+			nulls[6] = true;
+		}
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Discard all samples.
+ */
+Datum
+pg_stat_reset_profile(PG_FUNCTION_ARGS)
+{
+	if (ProfilerEnabled())
+	{
+		LWLockAcquire(ProfilerLock, LW_EXCLUSIVE);
+		ProfilerShmem->nsamples = 0;
+		LWLockRelease(ProfilerLock);
+	}
+
+	PG_RETURN_VOID();
+}
@@ -221,6 +221,7 @@ WalWriterMain(char *startup_data, size_t startup_data_len)
 	for (;;)
 	{
 		long		cur_timeout;
+		bool		served_commits;
 
 		/*
 		 * Advertise whether we might hibernate in this cycle.  We do this
@@ -245,9 +246,11 @@ WalWriterMain(char *startup_data, size_t startup_data_len)
 
 		/*
 		 * Do what we're here for; then, if XLogBackgroundFlush() found useful
-		 * work to do, reset hibernation counter.
+		 * work to do, reset hibernation counter.  First serve any backends
+		 * waiting for us to flush their commit records.
 		 */
-		if (XLogBackgroundFlush())
+		served_commits = XLogGroupFlushServe();
+		if (XLogBackgroundFlush() || served_commits)
 			left_till_hibernate = LOOPS_UNTIL_HIBERNATE;
 		else if (left_till_hibernate > 0)
 			left_till_hibernate--;
@@ -255,6 +258,13 @@ WalWriterMain(char *startup_data, size_t startup_data_len)
 		/* report pending statistics to the cumulative stats system */
 		pgstat_report_wal(false);
 
+		/*
+		 * If we flushed for committing backends, more of them have probably
+		 * queued up meanwhile; go around again without sleeping.
+		 */
+		if (served_commits)
+			continue;
+
 		/*
 		 * Sleep until we are signaled or WalWriterDelay has elapsed.  If we
 		 * haven't done anything useful for quite some time, lengthen the
@@ -623,9 +623,34 @@ libpqrcv_startstreaming(WalReceiverConn *conn,
 		appendStringInfoChar(&cmd, ')');
 	}
 	else
+	{
 		appendStringInfo(&cmd, " TIMELINE %u",
 						 options->proto.physical.startpointTLI);
 
+		if (options->proto.physical.compression != NULL)
+		{
+			appendStringInfo(&cmd, " (compression '%s'",
+							 options->proto.physical.compression);
+			if (options->proto.physical.compression_detail != NULL)
+			{
+				char	   *detail_literal;
+
+				detail_literal = PQescapeLiteral(conn->streamConn,
+												 options->proto.physical.compression_detail,
+												 strlen(options->proto.physical.compression_detail));
+				if (!detail_literal)
+					ereport(ERROR,
+							(errcode(ERRCODE_OUT_OF_MEMORY),	/* likely guess */
+							 errmsg("could not start WAL streaming: %s",
+									pchomp(PQerrorMessage(conn->streamConn)))));
+				appendStringInfo(&cmd, ", compression_detail %s",
+								 detail_literal);
+				PQfreemem(detail_literal);
+			}
+			appendStringInfoChar(&cmd, ')');
+		}
+	}
+
 	/* Start streaming. */
 	res = libpqrcv_PQexec(conn->streamConn, cmd.data);
 	pfree(cmd.data);
@@ -97,6 +97,7 @@
 #include "access/xlog_internal.h"
 #include "catalog/catalog.h"
 #include "common/int.h"
+#include "common/pg_lzcompress.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -176,11 +177,20 @@ typedef struct ReorderBufferToastEnt
 /* Disk serialization support datastructures */
 typedef struct ReorderBufferDiskChange
 {
-	Size		size;
+	Size		size;			/* on-disk size, including this header */
+	Size		rawsize;		/* size of the data before compression, or 0
+								 * if the data is stored uncompressed */
 	ReorderBufferChange change;
 	/* data follows */
 } ReorderBufferDiskChange;
 
+/*
+ * Changes whose serialized data is at least this large are compressed with
+ * pglz before being spilled to disk.  Smaller ones rarely compress well
+ * enough to be worth the CPU time.
+ */
+#define REORDER_BUFFER_COMPRESS_MIN_SIZE	1024
+
 #define IsSpecInsert(action) \
 ( \
 	((action) == REORDER_BUFFER_CHANGE_INTERNAL_SPEC_INSERT) \
@@ -359,6 +369,8 @@ ReorderBufferAllocate(void)
 
 	buffer->outbuf = NULL;
 	buffer->outbufsize = 0;
+	buffer->compressbuf = NULL;
+	buffer->compressbufsize = 0;
 	buffer->size = 0;
 
 	/* txn_heap is ordered by transaction size */
@@ -3502,6 +3514,24 @@ ReorderBufferSerializeReserve(ReorderBuffer *rb, Size sz)
 	}
 }
 
+/*
+ * Ensure the compression buffer is >= sz.
+ */
+static void
+ReorderBufferCompressReserve(ReorderBuffer *rb, Size sz)
+{
+	if (!rb->compressbufsize)
+	{
+		rb->compressbuf = MemoryContextAlloc(rb->context, sz);
+		rb->compressbufsize = sz;
+	}
+	else if (rb->compressbufsize < sz)
+	{
+		rb->compressbuf = repalloc(rb->compressbuf, sz);
+		rb->compressbufsize = sz;
+	}
+}
+
 
 /* Compare two transactions by size */
 static int
@@ -3778,6 +3808,7 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 {
 	ReorderBufferDiskChange *ondisk;
 	Size		sz = sizeof(ReorderBufferDiskChange);
+	char	   *outbuf;
 
 	ReorderBufferSerializeReserve(rb, sz);
 
@@ -3954,10 +3985,36 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	}
 
 	ondisk->size = sz;
+	ondisk->rawsize = 0;
+	outbuf = rb->outbuf;
+
+	/*
+	 * Try to compress the data of large changes, to cut down on the spill
+	 * I/O of big transactions.  If pglz can't save enough, store it as is.
+	 */
+	if (sz - sizeof(ReorderBufferDiskChange) >= REORDER_BUFFER_COMPRESS_MIN_SIZE)
+	{
+		Size		rawlen = sz - sizeof(ReorderBufferDiskChange);
+		int32		complen;
+
+		ReorderBufferCompressReserve(rb, sizeof(ReorderBufferDiskChange) +
+									 PGLZ_MAX_OUTPUT(rawlen));
+		complen = pglz_compress(rb->outbuf + sizeof(ReorderBufferDiskChange),
+								rawlen,
+								rb->compressbuf + sizeof(ReorderBufferDiskChange),
+								PGLZ_strategy_default);
+		if (complen >= 0)
+		{
+			ondisk->size = sizeof(ReorderBufferDiskChange) + complen;
+			ondisk->rawsize = rawlen;
+			memcpy(rb->compressbuf, ondisk, sizeof(ReorderBufferDiskChange));
+			outbuf = rb->compressbuf;
+		}
+	}
 
 	errno = 0;
 	pgstat_report_wait_start(WAIT_EVENT_REORDER_BUFFER_WRITE);
-	if (write(fd, rb->outbuf, ondisk->size) != ondisk->size)
+	if (write(fd, outbuf, ondisk->size) != ondisk->size)
 	{
 		int			save_errno = errno;
 
@@ -4254,6 +4311,9 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	{
 		int			readBytes;
 		ReorderBufferDiskChange *ondisk;
+		Size		datalen;
+		Size		rawsize;
+		char	   *readbuf;
 
 		CHECK_FOR_INTERRUPTS();
 
@@ -4324,14 +4384,28 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 		file->curOffset += readBytes;
 
 		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+		datalen = ondisk->size - sizeof(ReorderBufferDiskChange);
+		rawsize = ondisk->rawsize;
 
+		/*
+		 * Compressed data is read into the compression buffer and then
+		 * decompressed into place behind the header; uncompressed data is
+		 * read into place directly.
+		 */
 		ReorderBufferSerializeReserve(rb,
-									  sizeof(ReorderBufferDiskChange) + ondisk->size);
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+									  sizeof(ReorderBufferDiskChange) +
+									  (rawsize > 0 ? rawsize : datalen));
+		if (rawsize > 0)
+		{
+			ReorderBufferCompressReserve(rb, datalen);
+			readbuf = rb->compressbuf;
+		}
+		else
+			readbuf = rb->outbuf + sizeof(ReorderBufferDiskChange);
 
 		readBytes = FileRead(file->vfd,
-							 rb->outbuf + sizeof(ReorderBufferDiskChange),
-							 ondisk->size - sizeof(ReorderBufferDiskChange),
+							 readbuf,
+							 datalen,
 							 file->curOffset,
 							 WAIT_EVENT_REORDER_BUFFER_READ);
 
@@ -4339,15 +4413,23 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					 errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != ondisk->size - sizeof(ReorderBufferDiskChange))
+		else if (readBytes != datalen)
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
 							readBytes,
-							(uint32) (ondisk->size - sizeof(ReorderBufferDiskChange)))));
+							(uint32) datalen)));
 
 		file->curOffset += readBytes;
 
+		if (rawsize > 0 &&
+			pglz_decompress(rb->compressbuf, datalen,
+							rb->outbuf + sizeof(ReorderBufferDiskChange),
+							rawsize, true) != rawsize)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("compressed data in reorderbuffer spill file is corrupted")));
+
 		/*
 		 * ok, read a full change from disk, now restore it into proper
 		 * in-memory format
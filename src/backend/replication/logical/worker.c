@@ -159,6 +159,7 @@
 #include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/execPartition.h"
+#include "executor/nodeModifyTable.h"
 #include "libpq/pqformat.h"
 #include "miscadmin.h"
 #include "optimizer/optimizer.h"
@@ -215,6 +216,28 @@ typedef struct ApplyExecutionData
 	PartitionTupleRouting *proute;	/* partition routing info */
 } ApplyExecutionData;
 
+/*
+ * Consecutive INSERTs into the same plain table are collected into a batch
+ * and written with table_multi_insert(), much like COPY FROM does, instead of
+ * one ExecSimpleRelationInsert() call per row.  Any other message flushes the
+ * pending batch before it is processed, so changes are still applied in
+ * order and within the same transaction.
+ */
+#define APPLY_BATCH_MAX_TUPLES	1000
+#define APPLY_BATCH_MAX_BYTES	65535
+
+typedef struct ApplyInsertBatch
+{
+	LogicalRepRelMapEntry *rel; /* target relation, NULL if nothing pending */
+	ApplyExecutionData *edata;	/* executor state owning the slots */
+	TupleTableSlot *remoteslot; /* scratch slot for building remote tuples */
+	TupleTableSlot *slots[APPLY_BATCH_MAX_TUPLES];
+	int			nused;			/* number of slots holding pending tuples */
+	Size		nbytes;			/* size of the pending INSERT messages */
+} ApplyInsertBatch;
+
+static ApplyInsertBatch apply_insert_batch;
+
 /* Struct for saving and restoring apply errcontext information */
 typedef struct ApplyErrorCallbackArg
 {
@@ -293,6 +316,9 @@ MemoryContext ApplyContext = NULL;
 /* per stream context for streaming transactions */
 static MemoryContext LogicalStreamingContext = NULL;
 
+/* context for the executor state of a pending insert batch */
+static MemoryContext ApplyInsertBatchContext = NULL;
+
 WalReceiverConn *LogRepWorkerWalRcvConn = NULL;
 
 Subscription *MySubscription = NULL;
@@ -382,6 +408,11 @@ static void apply_handle_commit_internal(LogicalRepCommitData *commit_data);
 static void apply_handle_insert_internal(ApplyExecutionData *edata,
 										 ResultRelInfo *relinfo,
 										 TupleTableSlot *remoteslot);
+static bool apply_insert_batchable(LogicalRepRelMapEntry *rel);
+static void apply_insert_batch_add(LogicalRepRelMapEntry *rel,
+								   LogicalRepTupleData *newtup, Size len);
+static void apply_insert_batch_flush(void);
+static void apply_flush_pending_inserts(void);
 static void apply_handle_update_internal(ApplyExecutionData *edata,
 										 ResultRelInfo *relinfo,
 										 TupleTableSlot *remoteslot,
@@ -2118,6 +2149,8 @@ apply_spooled_messages(FileSet *stream_fileset, TransactionId xid,
 	if (stream_fd)
 		stream_close_file();
 
+	apply_flush_pending_inserts();
+
 	elog(DEBUG1, "replayed %d (all) changes from file \"%s\"",
 		 nchanges, path);
 
@@ -2391,6 +2424,20 @@ apply_handle_insert(StringInfo s)
 	begin_replication_step();
 
 	relid = logicalrep_read_insert(s, &newtup);
+
+	/* Add to the pending batch if the row goes to the same relation. */
+	if (apply_insert_batch.rel != NULL)
+	{
+		if (apply_insert_batch.rel->remoterel.remoteid == relid)
+		{
+			apply_insert_batch_add(apply_insert_batch.rel, &newtup, s->len);
+			end_replication_step();
+			return;
+		}
+
+		apply_insert_batch_flush();
+	}
+
 	rel = logicalrep_rel_open(relid, RowExclusiveLock);
 	if (!should_apply_changes_for_rel(rel))
 	{
@@ -2403,6 +2450,17 @@ apply_handle_insert(StringInfo s)
 		return;
 	}
 
+	/*
+	 * Start a new batch if possible.  The relation stays open until the
+	 * batch is flushed.
+	 */
+	if (apply_insert_batchable(rel))
+	{
+		apply_insert_batch_add(rel, &newtup, s->len);
+		end_replication_step();
+		return;
+	}
+
 	/*
 	 * Make sure that any user-supplied code runs as the table owner, unless
 	 * the user has opted out of that behavior.
@@ -2448,6 +2506,199 @@ apply_handle_insert(StringInfo s)
 	end_replication_step();
 }
 
+/*
+ * Can INSERTs into this relation be batched?
+ *
+ * Only plain tables without triggers qualify: tuple routing and per-row
+ * triggers need the row-at-a-time path.
+ */
+static bool
+apply_insert_batchable(LogicalRepRelMapEntry *rel)
+{
+	Relation	localrel = rel->localrel;
+
+	return localrel->rd_rel->relkind == RELKIND_RELATION &&
+		localrel->trigdesc == NULL;
+}
+
+/*
+ * Add a remote tuple to the pending insert batch for 'rel', starting a new
+ * batch if there is none.  The batch is flushed once it is full.
+ */
+static void
+apply_insert_batch_add(LogicalRepRelMapEntry *rel,
+					   LogicalRepTupleData *newtup, Size len)
+{
+	ApplyInsertBatch *batch = &apply_insert_batch;
+	EState	   *estate;
+	TupleTableSlot *slot;
+	UserContext ucxt;
+	bool		run_as_owner;
+	MemoryContext oldctx;
+
+	if (batch->rel == NULL)
+	{
+		if (ApplyInsertBatchContext == NULL)
+			ApplyInsertBatchContext = AllocSetContextCreate(ApplyContext,
+															"ApplyInsertBatchContext",
+															ALLOCSET_DEFAULT_SIZES);
+
+		oldctx = MemoryContextSwitchTo(ApplyInsertBatchContext);
+		batch->rel = rel;
+		batch->edata = create_edata_for_relation(rel);
+		batch->remoteslot = ExecInitExtraTupleSlot(batch->edata->estate,
+												   RelationGetDescr(rel->localrel),
+												   &TTSOpsVirtual);
+		batch->nused = 0;
+		batch->nbytes = 0;
+		MemoryContextSwitchTo(oldctx);
+	}
+
+	Assert(batch->rel == rel);
+	estate = batch->edata->estate;
+
+	/* Make sure that any default expressions run as the table owner. */
+	run_as_owner = MySubscription->runasowner;
+	if (!run_as_owner)
+		SwitchToUntrustedUser(rel->localrel->rd_rel->relowner, &ucxt);
+
+	/* Set relation for error callback */
+	apply_error_callback_arg.rel = rel;
+
+	/* Process the remote tuple, then copy it into a batch slot */
+	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	slot_store_data(batch->remoteslot, rel, newtup);
+	slot_fill_defaults(rel, estate, batch->remoteslot);
+	MemoryContextSwitchTo(estate->es_query_cxt);
+	slot = table_slot_create(rel->localrel, &estate->es_tupleTable);
+	ExecCopySlot(slot, batch->remoteslot);
+	MemoryContextSwitchTo(oldctx);
+	ResetPerTupleExprContext(estate);
+
+	batch->slots[batch->nused++] = slot;
+	batch->nbytes += len;
+
+	/* Reset relation for error callback */
+	apply_error_callback_arg.rel = NULL;
+
+	if (!run_as_owner)
+		RestoreUserContext(&ucxt);
+
+	if (batch->nused >= APPLY_BATCH_MAX_TUPLES ||
+		batch->nbytes >= APPLY_BATCH_MAX_BYTES)
+		apply_insert_batch_flush();
+}
+
+/*
+ * Write out the pending insert batch, if any.
+ *
+ * This does the same work as ExecSimpleRelationInsert() for each tuple, but
+ * inserts the heap tuples with a single table_multi_insert() call.  The
+ * caller must be inside a replication step.
+ */
+static void
+apply_insert_batch_flush(void)
+{
+	ApplyInsertBatch *batch = &apply_insert_batch;
+	LogicalRepRelMapEntry *rel = batch->rel;
+	ResultRelInfo *relinfo;
+	Relation	localrel;
+	EState	   *estate;
+	UserContext ucxt;
+	bool		run_as_owner;
+	LogicalRepRelMapEntry *saved_rel;
+	int			i;
+
+	if (rel == NULL)
+		return;
+
+	localrel = rel->localrel;
+	relinfo = batch->edata->targetRelInfo;
+	estate = batch->edata->estate;
+
+	run_as_owner = MySubscription->runasowner;
+	if (!run_as_owner)
+		SwitchToUntrustedUser(localrel->rd_rel->relowner, &ucxt);
+
+	/* Set relation for error callback */
+	saved_rel = apply_error_callback_arg.rel;
+	apply_error_callback_arg.rel = rel;
+
+	estate->es_output_cid = GetCurrentCommandId(true);
+
+	ExecOpenIndices(relinfo, false);
+	TargetPrivilegesCheck(localrel, ACL_INSERT);
+	CheckCmdReplicaIdentity(localrel, CMD_INSERT);
+
+	for (i = 0; i < batch->nused; i++)
+	{
+		TupleTableSlot *slot = batch->slots[i];
+
+		/* Compute stored generated columns */
+		if (localrel->rd_att->constr &&
+			localrel->rd_att->constr->has_generated_stored)
+			ExecComputeStoredGenerated(relinfo, estate, slot, CMD_INSERT);
+
+		/* Check the constraints of the tuple */
+		if (localrel->rd_att->constr)
+			ExecConstraints(relinfo, slot, estate);
+		if (localrel->rd_rel->relispartition)
+			ExecPartitionCheck(relinfo, slot, estate, true);
+
+		ResetPerTupleExprContext(estate);
+	}
+
+	table_multi_insert(localrel, batch->slots, batch->nused,
+					   estate->es_output_cid, 0, NULL);
+
+	if (relinfo->ri_NumIndices > 0)
+	{
+		for (i = 0; i < batch->nused; i++)
+		{
+			List	   *recheckIndexes;
+
+			recheckIndexes = ExecInsertIndexTuples(relinfo, batch->slots[i],
+												   estate, false, false,
+												   NULL, NIL, false);
+			list_free(recheckIndexes);
+			ResetPerTupleExprContext(estate);
+		}
+	}
+
+	ExecCloseIndices(relinfo);
+
+	/* This also drops the batch slots */
+	finish_edata(batch->edata);
+	MemoryContextReset(ApplyInsertBatchContext);
+
+	apply_error_callback_arg.rel = saved_rel;
+
+	if (!run_as_owner)
+		RestoreUserContext(&ucxt);
+
+	logicalrep_rel_close(rel, NoLock);
+
+	batch->rel = NULL;
+	batch->edata = NULL;
+	batch->remoteslot = NULL;
+	batch->nused = 0;
+	batch->nbytes = 0;
+}
+
+/*
+ * Flush the pending insert batch, if any, in its own replication step.
+ */
+static void
+apply_flush_pending_inserts(void)
+{
+	if (apply_insert_batch.rel == NULL)
+		return;
+
+	begin_replication_step();
+	apply_insert_batch_flush();
+	end_replication_step();
+}
+
 /*
  * Workhorse for apply_handle_insert()
  * relinfo is for the relation we're actually inserting into
@@ -3282,6 +3533,10 @@ apply_dispatch(StringInfo s)
 	saved_command = apply_error_callback_arg.command;
 	apply_error_callback_arg.command = action;
 
+	/* Anything but another INSERT must see the pending inserts applied. */
+	if (action != LOGICAL_REP_MSG_INSERT)
+		apply_flush_pending_inserts();
+
 	switch (action)
 	{
 		case LOGICAL_REP_MSG_BEGIN:
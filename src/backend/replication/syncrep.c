@@ -99,7 +99,7 @@ static int	SyncRepWaitMode = SYNC_REP_NO_WAIT;
 
 static void SyncRepQueueInsert(int mode);
 static void SyncRepCancelWait(void);
-static int	SyncRepWakeQueue(bool all, int mode);
+static int	SyncRepWakeQueue(bool all, int mode, LatchBatch *wakeups);
 
 static bool SyncRepGetSyncRecPtr(XLogRecPtr *writePtr,
 								 XLogRecPtr *flushPtr,
@@ -439,6 +439,7 @@ SyncRepReleaseWaiters(void)
 	int			numwrite = 0;
 	int			numflush = 0;
 	int			numapply = 0;
+	LatchBatch	wakeups = {0};
 
 	/*
 	 * If this WALSender is serving a standby that is not on the list of
@@ -456,6 +457,25 @@ SyncRepReleaseWaiters(void)
 		return;
 	}
 
+#ifdef PG_HAVE_8BYTE_SINGLE_COPY_ATOMICITY
+
+	/*
+	 * Most replies cannot release anybody: the synced positions are each the
+	 * position of some sync standby, so they can only move past the already
+	 * released positions once some standby has gone past them, and that
+	 * standby's WAL sender will do the work when it gets there.  If none of
+	 * our positions is beyond what has been released, skip taking
+	 * SyncRepLock and examining all WAL senders.  The released positions
+	 * only ever advance, so reading them without the lock is safe; at worst
+	 * we see a stale value and take the slow path.  (announce_next_takeover
+	 * is merely left for a later reply to act on.)
+	 */
+	if (MyWalSnd->write <= walsndctl->lsn[SYNC_REP_WAIT_WRITE] &&
+		MyWalSnd->flush <= walsndctl->lsn[SYNC_REP_WAIT_FLUSH] &&
+		MyWalSnd->apply <= walsndctl->lsn[SYNC_REP_WAIT_APPLY])
+		return;
+#endif
+
 	/*
 	 * We're a potential sync standby. Release waiters if there are enough
 	 * sync standbys and we are considered as sync.
@@ -508,21 +528,26 @@ SyncRepReleaseWaiters(void)
 	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < writePtr)
 	{
 		walsndctl->lsn[SYNC_REP_WAIT_WRITE] = writePtr;
-		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE);
+		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE,
+									&wakeups);
 	}
 	if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < flushPtr)
 	{
 		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = flushPtr;
-		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH);
+		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH,
+									&wakeups);
 	}
 	if (walsndctl->lsn[SYNC_REP_WAIT_APPLY] < applyPtr)
 	{
 		walsndctl->lsn[SYNC_REP_WAIT_APPLY] = applyPtr;
-		numapply = SyncRepWakeQueue(false, SYNC_REP_WAIT_APPLY);
+		numapply = SyncRepWakeQueue(false, SYNC_REP_WAIT_APPLY,
+									&wakeups);
 	}
 
 	LWLockRelease(SyncRepLock);
 
+	SetLatches(&wakeups);
+
 	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X, %d procs up to apply %X/%X",
 		 numwrite, LSN_FORMAT_ARGS(writePtr),
 		 numflush, LSN_FORMAT_ARGS(flushPtr),
@@ -854,14 +879,15 @@ SyncRepGetStandbyPriority(void)
 
 /*
  * Walk the specified queue from head.  Set the state of any backends that
- * need to be woken, remove them from the queue, and then wake them.
- * Pass all = true to wake whole queue; otherwise, just wake up to
+ * need to be woken, remove them from the queue, and add their latches to
+ * wakeups.  Pass all = true to wake whole queue; otherwise, just wake up to
  * the walsender's LSN.
  *
- * The caller must hold SyncRepLock in exclusive mode.
+ * The caller must hold SyncRepLock in exclusive mode, and must call
+ * SetLatches(wakeups) after releasing it.
  */
 static int
-SyncRepWakeQueue(bool all, int mode)
+SyncRepWakeQueue(bool all, int mode, LatchBatch *wakeups)
 {
 	volatile WalSndCtlData *walsndctl = WalSndCtl;
 	int			numprocs = 0;
@@ -900,9 +926,10 @@ SyncRepWakeQueue(bool all, int mode)
 		proc->syncRepState = SYNC_REP_WAIT_COMPLETE;
 
 		/*
-		 * Wake only when we have set state and removed from queue.
+		 * Wake only when we have set state and removed from queue.  The
+		 * caller sets the latches once it has released SyncRepLock.
 		 */
-		SetLatch(&(proc->procLatch));
+		AddLatch(wakeups, &(proc->procLatch));
 
 		numprocs++;
 	}
@@ -924,6 +951,8 @@ SyncRepUpdateSyncStandbysDefined(void)
 
 	if (sync_standbys_defined != WalSndCtl->sync_standbys_defined)
 	{
+		LatchBatch	wakeups = {0};
+
 		LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
 
 		/*
@@ -936,7 +965,7 @@ SyncRepUpdateSyncStandbysDefined(void)
 			int			i;
 
 			for (i = 0; i < NUM_SYNC_REP_WAIT_MODE; i++)
-				SyncRepWakeQueue(true, i);
+				SyncRepWakeQueue(true, i, &wakeups);
 		}
 
 		/*
@@ -949,6 +978,8 @@ SyncRepUpdateSyncStandbysDefined(void)
 		WalSndCtl->sync_standbys_defined = sync_standbys_defined;
 
 		LWLockRelease(SyncRepLock);
+
+		SetLatches(&wakeups);
 	}
 }
 
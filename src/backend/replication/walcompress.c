@@ -0,0 +1,394 @@
+/*-------------------------------------------------------------------------
+ *
+ * walcompress.c
+ *	  Stream compression of WAL sent over physical replication connections.
+ *
+ * A physical replication client can ask the walsender to compress the WAL
+ * it streams, by passing a "compression" option to START_REPLICATION.  The
+ * walsender then compresses the WAL payload of each XLogData message as one
+ * continuous stream: the compressor keeps its state from one message to the
+ * next, so that matches can refer back to WAL sent earlier, but its output
+ * is flushed at the end of every message.  The receiver can therefore
+ * decompress and write out each message as soon as it arrives, without
+ * waiting for any later message.
+ *
+ * Portions Copyright (c) 2010-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/walcompress.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "replication/walcompress.h"
+
+/*
+ * LZ4F_HEADER_SIZE_MAX first appeared in v1.7.5 of the library.
+ */
+#if defined(USE_LZ4) && !defined(LZ4F_HEADER_SIZE_MAX)
+#define LZ4F_HEADER_SIZE_MAX	32
+#endif
+
+/* Amount of output space to make available per decompression call */
+#define WAL_DECOMPRESS_CHUNK_SIZE	(64 * 1024)
+
+struct WalCompressor
+{
+	pg_compress_algorithm algorithm;
+#ifdef USE_LZ4
+	LZ4F_compressionContext_t lz4_ctx;
+	LZ4F_preferences_t lz4_prefs;
+	bool		lz4_begun;		/* has the frame header been emitted? */
+#endif
+#ifdef USE_ZSTD
+	ZSTD_CCtx  *zstd_ctx;
+#endif
+};
+
+struct WalDecompressor
+{
+	pg_compress_algorithm algorithm;
+#ifdef USE_LZ4
+	LZ4F_decompressionContext_t lz4_ctx;
+#endif
+#ifdef USE_ZSTD
+	ZSTD_DCtx  *zstd_ctx;
+#endif
+};
+
+static void check_wal_compress_algorithm(pg_compress_algorithm algorithm);
+
+/*
+ * Complain if WAL streaming can't use the given compression algorithm.
+ */
+static void
+check_wal_compress_algorithm(pg_compress_algorithm algorithm)
+{
+	switch (algorithm)
+	{
+		case PG_COMPRESSION_LZ4:
+#ifndef USE_LZ4
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("lz4 compression is not supported by this build")));
+#endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifndef USE_ZSTD
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("zstd compression is not supported by this build")));
+#endif
+			break;
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("compression algorithm \"%s\" is not supported for WAL streaming",
+							get_compress_algorithm_name(algorithm))));
+	}
+}
+
+/*
+ * Set up compression of a WAL stream according to the given, already
+ * validated, compression specification.
+ */
+WalCompressor *
+WalCompressorCreate(pg_compress_specification *spec)
+{
+	WalCompressor *wc;
+
+	check_wal_compress_algorithm(spec->algorithm);
+
+	wc = palloc0(sizeof(WalCompressor));
+	wc->algorithm = spec->algorithm;
+
+#ifdef USE_LZ4
+	if (spec->algorithm == PG_COMPRESSION_LZ4)
+	{
+		LZ4F_errorCode_t ctxError;
+
+		wc->lz4_prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+		wc->lz4_prefs.compressionLevel = spec->level;
+		wc->lz4_prefs.autoFlush = 1;
+
+		ctxError = LZ4F_createCompressionContext(&wc->lz4_ctx, LZ4F_VERSION);
+		if (LZ4F_isError(ctxError))
+			elog(ERROR, "could not create lz4 compression context: %s",
+				 LZ4F_getErrorName(ctxError));
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (spec->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		size_t		ret;
+
+		wc->zstd_ctx = ZSTD_createCCtx();
+		if (!wc->zstd_ctx)
+			elog(ERROR, "could not create zstd compression context");
+
+		ret = ZSTD_CCtx_setParameter(wc->zstd_ctx, ZSTD_c_compressionLevel,
+									 spec->level);
+		if (ZSTD_isError(ret))
+			elog(ERROR, "could not set zstd compression level to %d: %s",
+				 spec->level, ZSTD_getErrorName(ret));
+
+		if ((spec->options & PG_COMPRESSION_OPTION_WORKERS) != 0)
+		{
+			ret = ZSTD_CCtx_setParameter(wc->zstd_ctx, ZSTD_c_nbWorkers,
+										 spec->workers);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("could not set compression worker count to %d: %s",
+							   spec->workers, ZSTD_getErrorName(ret)));
+		}
+
+		if ((spec->options & PG_COMPRESSION_OPTION_LONG_DISTANCE) != 0)
+		{
+			ret = ZSTD_CCtx_setParameter(wc->zstd_ctx,
+										 ZSTD_c_enableLongDistanceMatching,
+										 spec->long_distance);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("could not enable long-distance mode: %s",
+							   ZSTD_getErrorName(ret)));
+		}
+	}
+#endif
+
+	return wc;
+}
+
+/*
+ * Compress 'len' bytes of WAL at 'data', appending the result to 'out'.
+ *
+ * All of the input is flushed out, so the receiver can reconstruct it from
+ * what has been appended to 'out' so far.
+ */
+void
+WalCompressData(WalCompressor *wc, const char *data, size_t len,
+				StringInfo out)
+{
+#ifdef USE_LZ4
+	if (wc->algorithm == PG_COMPRESSION_LZ4)
+	{
+		size_t		bound;
+		size_t		nbytes;
+
+		if (!wc->lz4_begun)
+		{
+			enlargeStringInfo(out, LZ4F_HEADER_SIZE_MAX);
+			nbytes = LZ4F_compressBegin(wc->lz4_ctx,
+										out->data + out->len,
+										LZ4F_HEADER_SIZE_MAX,
+										&wc->lz4_prefs);
+			if (LZ4F_isError(nbytes))
+				elog(ERROR, "could not write lz4 header: %s",
+					 LZ4F_getErrorName(nbytes));
+			out->len += nbytes;
+			wc->lz4_begun = true;
+		}
+
+		bound = LZ4F_compressBound(len, &wc->lz4_prefs);
+		enlargeStringInfo(out, bound);
+		nbytes = LZ4F_compressUpdate(wc->lz4_ctx,
+									 out->data + out->len, bound,
+									 data, len, NULL);
+		if (LZ4F_isError(nbytes))
+			elog(ERROR, "could not compress data: %s",
+				 LZ4F_getErrorName(nbytes));
+		out->len += nbytes;
+
+		/* autoFlush should leave nothing behind, but make sure */
+		bound = LZ4F_compressBound(0, &wc->lz4_prefs);
+		enlargeStringInfo(out, bound);
+		nbytes = LZ4F_flush(wc->lz4_ctx, out->data + out->len, bound, NULL);
+		if (LZ4F_isError(nbytes))
+			elog(ERROR, "could not compress data: %s",
+				 LZ4F_getErrorName(nbytes));
+		out->len += nbytes;
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (wc->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ZSTD_inBuffer inBuf = {data, len, 0};
+		size_t		yet_to_flush;
+
+		do
+		{
+			ZSTD_outBuffer outBuf;
+
+			enlargeStringInfo(out, ZSTD_CStreamOutSize());
+			outBuf.dst = out->data + out->len;
+			outBuf.size = out->maxlen - out->len - 1;
+			outBuf.pos = 0;
+
+			yet_to_flush = ZSTD_compressStream2(wc->zstd_ctx, &outBuf, &inBuf,
+												ZSTD_e_flush);
+			if (ZSTD_isError(yet_to_flush))
+				elog(ERROR, "could not compress data: %s",
+					 ZSTD_getErrorName(yet_to_flush));
+			out->len += outBuf.pos;
+		} while (yet_to_flush > 0);
+	}
+#endif
+
+	out->data[out->len] = '\0';
+}
+
+/*
+ * Release the resources held by a WalCompressor.
+ */
+void
+WalCompressorFree(WalCompressor *wc)
+{
+#ifdef USE_LZ4
+	if (wc->algorithm == PG_COMPRESSION_LZ4)
+		LZ4F_freeCompressionContext(wc->lz4_ctx);
+#endif
+#ifdef USE_ZSTD
+	if (wc->algorithm == PG_COMPRESSION_ZSTD)
+		ZSTD_freeCCtx(wc->zstd_ctx);
+#endif
+	pfree(wc);
+}
+
+/*
+ * Set up decompression of a WAL stream compressed with 'algorithm'.
+ */
+WalDecompressor *
+WalDecompressorCreate(pg_compress_algorithm algorithm)
+{
+	WalDecompressor *wd;
+
+	check_wal_compress_algorithm(algorithm);
+
+	wd = palloc0(sizeof(WalDecompressor));
+	wd->algorithm = algorithm;
+
+#ifdef USE_LZ4
+	if (algorithm == PG_COMPRESSION_LZ4)
+	{
+		LZ4F_errorCode_t ctxError;
+
+		ctxError = LZ4F_createDecompressionContext(&wd->lz4_ctx, LZ4F_VERSION);
+		if (LZ4F_isError(ctxError))
+			elog(ERROR, "could not create lz4 decompression context: %s",
+				 LZ4F_getErrorName(ctxError));
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (algorithm == PG_COMPRESSION_ZSTD)
+	{
+		wd->zstd_ctx = ZSTD_createDCtx();
+		if (!wd->zstd_ctx)
+			elog(ERROR, "could not create zstd decompression context");
+	}
+#endif
+
+	return wd;
+}
+
+/*
+ * Decompress the 'len' bytes at 'data', which must be the complete payload
+ * of one message produced by WalCompressData(), appending the WAL they
+ * represent to 'out'.
+ */
+void
+WalDecompressData(WalDecompressor *wd, const char *data, size_t len,
+				  StringInfo out)
+{
+#ifdef USE_LZ4
+	if (wd->algorithm == PG_COMPRESSION_LZ4)
+	{
+		for (;;)
+		{
+			size_t		avail;
+			size_t		out_size;
+			size_t		in_size = len;
+			size_t		ret;
+
+			enlargeStringInfo(out, WAL_DECOMPRESS_CHUNK_SIZE);
+			avail = out->maxlen - out->len - 1;
+			out_size = avail;
+
+			ret = LZ4F_decompress(wd->lz4_ctx, out->data + out->len, &out_size,
+								  data, &in_size, NULL);
+			if (LZ4F_isError(ret))
+				ereport(ERROR,
+						(errcode(ERRCODE_PROTOCOL_VIOLATION),
+						 errmsg("could not decompress WAL stream: %s",
+								LZ4F_getErrorName(ret))));
+			out->len += out_size;
+			data += in_size;
+			len -= in_size;
+
+			/* Done once all input is consumed and no output is pending */
+			if (len == 0 && out_size < avail)
+				break;
+		}
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (wd->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ZSTD_inBuffer inBuf = {data, len, 0};
+
+		for (;;)
+		{
+			ZSTD_outBuffer outBuf;
+			size_t		ret;
+
+			enlargeStringInfo(out, WAL_DECOMPRESS_CHUNK_SIZE);
+			outBuf.dst = out->data + out->len;
+			outBuf.size = out->maxlen - out->len - 1;
+			outBuf.pos = 0;
+
+			ret = ZSTD_decompressStream(wd->zstd_ctx, &outBuf, &inBuf);
+			if (ZSTD_isError(ret))
+				ereport(ERROR,
+						(errcode(ERRCODE_PROTOCOL_VIOLATION),
+						 errmsg("could not decompress WAL stream: %s",
+								ZSTD_getErrorName(ret))));
+			out->len += outBuf.pos;
+
+			/* Done once all input is consumed and no output is pending */
+			if (inBuf.pos == inBuf.size && outBuf.pos < outBuf.size)
+				break;
+		}
+	}
+#endif
+
+	out->data[out->len] = '\0';
+}
+
+/*
+ * Release the resources held by a WalDecompressor.
+ */
+void
+WalDecompressorFree(WalDecompressor *wd)
+{
+#ifdef USE_LZ4
+	if (wd->algorithm == PG_COMPRESSION_LZ4)
+		LZ4F_freeDecompressionContext(wd->lz4_ctx);
+#endif
+#ifdef USE_ZSTD
+	if (wd->algorithm == PG_COMPRESSION_ZSTD)
+		ZSTD_freeDCtx(wd->zstd_ctx);
+#endif
+	pfree(wd);
+}
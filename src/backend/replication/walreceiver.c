@@ -65,6 +65,7 @@
 #include "pgstat.h"
 #include "postmaster/auxprocess.h"
 #include "postmaster/interrupt.h"
+#include "replication/walcompress.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/ipc.h"
@@ -74,6 +75,7 @@
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/guc_hooks.h"
 #include "utils/pg_lsn.h"
 #include "utils/ps_status.h"
 #include "utils/timestamp.h"
@@ -87,6 +89,7 @@
 int			wal_receiver_status_interval;
 int			wal_receiver_timeout;
 bool		hot_standby_feedback;
+char	   *wal_receiver_compression = NULL;
 
 /* libpqwalreceiver connection */
 static WalReceiverConn *wrconn = NULL;
@@ -130,6 +133,13 @@ static TimestampTz wakeup[NUM_WALRCV_WAKEUPS];
 
 static StringInfoData reply_message;
 
+/*
+ * Decompressor for the WAL stream, if we asked the sender to compress it,
+ * and the buffer that receives the decompressed WAL of each message.
+ */
+static WalDecompressor *wal_decompressor = NULL;
+static StringInfoData decompressed_message;
+
 /* Prototypes for private functions */
 static void WalRcvFetchTimeLineHistoryFiles(TimeLineID first, TimeLineID last);
 static void WalRcvWaitForStartPosition(XLogRecPtr *startpoint, TimeLineID *startpointTLI);
@@ -144,6 +154,8 @@ static void XLogWalRcvSendReply(bool force, bool requestReply);
 static void XLogWalRcvSendHSFeedback(bool immed);
 static void ProcessWalSndrMessage(XLogRecPtr walEnd, TimestampTz sendTime);
 static void WalRcvComputeNextWakeup(WalRcvWakeupReason reason, TimestampTz now);
+static void split_wal_receiver_compression(const char *value,
+										   char **algorithm, char **detail);
 
 /*
  * Process any interrupts the walreceiver process may have received.
@@ -190,6 +202,9 @@ WalReceiverMain(char *startup_data, size_t startup_data_len)
 	TimeLineID	startpointTLI;
 	TimeLineID	primaryTLI;
 	bool		first_stream;
+	char	   *compression;
+	char	   *compression_detail;
+	pg_compress_algorithm compress_algorithm;
 	WalRcvData *walrcv;
 	TimestampTz now;
 	char	   *err;
@@ -412,6 +427,23 @@ WalReceiverMain(char *startup_data, size_t startup_data_len)
 		options.startpoint = startpoint;
 		options.slotname = slotname[0] != '\0' ? slotname : NULL;
 		options.proto.physical.startpointTLI = startpointTLI;
+
+		/* Ask for compression, if configured; the GUC is already validated */
+		split_wal_receiver_compression(wal_receiver_compression,
+									   &compression, &compression_detail);
+		if (!parse_compress_algorithm(compression, &compress_algorithm))
+			compress_algorithm = PG_COMPRESSION_NONE;	/* can't happen */
+		if (compress_algorithm != PG_COMPRESSION_NONE)
+		{
+			options.proto.physical.compression = compression;
+			options.proto.physical.compression_detail = compression_detail;
+		}
+		else
+		{
+			options.proto.physical.compression = NULL;
+			options.proto.physical.compression_detail = NULL;
+		}
+
 		if (walrcv_startstreaming(wrconn, &options))
 		{
 			if (first_stream)
@@ -428,6 +460,12 @@ WalReceiverMain(char *startup_data, size_t startup_data_len)
 			LogstreamResult.Write = LogstreamResult.Flush = GetXLogReplayRecPtr(NULL);
 			initStringInfo(&reply_message);
 
+			if (compress_algorithm != PG_COMPRESSION_NONE)
+			{
+				wal_decompressor = WalDecompressorCreate(compress_algorithm);
+				initStringInfo(&decompressed_message);
+			}
+
 			/* Initialize nap wakeup times. */
 			now = GetCurrentTimestamp();
 			for (int i = 0; i < NUM_WALRCV_WAKEUPS; ++i)
@@ -613,6 +651,13 @@ WalReceiverMain(char *startup_data, size_t startup_data_len)
 			 */
 			walrcv_endstreaming(wrconn, &primaryTLI);
 
+			if (wal_decompressor != NULL)
+			{
+				WalDecompressorFree(wal_decompressor);
+				wal_decompressor = NULL;
+				pfree(decompressed_message.data);
+			}
+
 			/*
 			 * If the server had switched to a new timeline that we didn't
 			 * know about when we began streaming, fetch its timeline history
@@ -867,6 +912,14 @@ XLogWalRcvProcessMsg(unsigned char type, char *buf, Size len, TimeLineID tli)
 
 				buf += hdrlen;
 				len -= hdrlen;
+				if (wal_decompressor != NULL)
+				{
+					resetStringInfo(&decompressed_message);
+					WalDecompressData(wal_decompressor, buf, len,
+									  &decompressed_message);
+					buf = decompressed_message.data;
+					len = decompressed_message.len;
+				}
 				XLogWalRcvWrite(buf, len, dataStart, tli);
 				break;
 			}
@@ -1528,3 +1581,85 @@ pg_stat_get_wal_receiver(PG_FUNCTION_ARGS)
 	/* Returns the record as Datum */
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
+
+/*
+ * Split a wal_receiver_compression value such as "zstd:level=3" into the
+ * algorithm name and the detail string, or NULL if there is none.
+ */
+static void
+split_wal_receiver_compression(const char *value, char **algorithm,
+							   char **detail)
+{
+	const char *sep = strchr(value, ':');
+
+	if (sep == NULL)
+	{
+		*algorithm = pstrdup(value);
+		*detail = NULL;
+	}
+	else
+	{
+		*algorithm = pnstrdup(value, sep - value);
+		*detail = pstrdup(sep + 1);
+	}
+}
+
+/*
+ * GUC check_hook for wal_receiver_compression
+ */
+bool
+check_wal_receiver_compression(char **newval, void **extra, GucSource source)
+{
+	char	   *algorithm;
+	char	   *detail;
+	pg_compress_specification spec;
+	char	   *error_detail;
+
+	split_wal_receiver_compression(*newval, &algorithm, &detail);
+
+	if (!parse_compress_algorithm(algorithm, &spec.algorithm))
+	{
+		GUC_check_errdetail("Unrecognized compression algorithm: \"%s\".",
+							algorithm);
+		return false;
+	}
+
+	switch (spec.algorithm)
+	{
+		case PG_COMPRESSION_NONE:
+			if (detail != NULL)
+			{
+				GUC_check_errdetail("Compression detail cannot be specified unless compression is enabled.");
+				return false;
+			}
+			return true;
+		case PG_COMPRESSION_LZ4:
+#ifndef USE_LZ4
+			GUC_check_errdetail("This build does not support compression with %s.",
+								"LZ4");
+			return false;
+#endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifndef USE_ZSTD
+			GUC_check_errdetail("This build does not support compression with %s.",
+								"ZSTD");
+			return false;
+#endif
+			break;
+		default:
+			GUC_check_errdetail("Compression algorithm \"%s\" is not supported for WAL streaming.",
+								algorithm);
+			return false;
+	}
+
+	parse_compress_specification(spec.algorithm, detail, &spec);
+	error_detail = validate_compress_specification(&spec);
+	if (error_detail != NULL)
+	{
+		GUC_check_errdetail("%s", error_detail);
+		return false;
+	}
+
+	return true;
+}
@@ -75,6 +75,7 @@
 #include "replication/slot.h"
 #include "replication/snapbuild.h"
 #include "replication/syncrep.h"
+#include "replication/walcompress.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "replication/walsender_private.h"
@@ -105,6 +106,14 @@
  */
 #define MAX_SEND_SIZE (XLOG_BLCKSZ * 16)
 
+/*
+ * How far ahead of the decoding position a logical walsender asks the kernel
+ * to read WAL.  Decoding is CPU-bound, so hinting the next chunk of the
+ * segment lets the reads overlap with decoding instead of stalling it a page
+ * at a time.  A new hint is issued once half of the window has been consumed.
+ */
+#define LOGICAL_WAL_READAHEAD_SIZE	(XLOG_BLCKSZ * 128)
+
 /* Array of WalSnds in shared memory */
 WalSndCtlData *WalSndCtl = NULL;
 
@@ -158,6 +167,9 @@ static TimeLineID sendTimeLineNextTLI = 0;
 static bool sendTimeLineIsHistoric = false;
 static XLogRecPtr sendTimeLineValidUpto = InvalidXLogRecPtr;
 
+/* End of the WAL range already hinted for read-ahead by logical decoding */
+static XLogRecPtr logicalReadAheadUpto = InvalidXLogRecPtr;
+
 /*
  * How far have we sent WAL already? This is also advertised in
  * MyWalSnd->sentPtr.  (Actually, this is the next WAL location to send.)
@@ -169,6 +181,13 @@ static StringInfoData output_message;
 static StringInfoData reply_message;
 static StringInfoData tmpbuf;
 
+/*
+ * Compressor for the physical WAL stream, if the client asked for one, and
+ * the buffer in which compressed messages are assembled.
+ */
+static WalCompressor *wal_compressor = NULL;
+static StringInfoData compressed_message;
+
 /* Timestamp of last ProcessRepliesIfAny(). */
 static TimestampTz last_processing = 0;
 
@@ -240,6 +259,8 @@ static void WalSndKill(int code, Datum arg);
 static void WalSndShutdown(void) pg_attribute_noreturn();
 static void XLogSendPhysical(void);
 static void XLogSendLogical(void);
+static void logical_readahead_xlog(XLogReaderState *state, XLogRecPtr startptr,
+								   XLogRecPtr flushptr);
 static void WalSndDone(WalSndSendDataCallback send_data);
 static void IdentifySystem(void);
 static void UploadManifest(void);
@@ -248,6 +269,8 @@ static bool HandleUploadManifestPacket(StringInfo buf, off_t *offset,
 static void ReadReplicationSlot(ReadReplicationSlotCmd *cmd);
 static void CreateReplicationSlot(CreateReplicationSlotCmd *cmd);
 static void DropReplicationSlot(DropReplicationSlotCmd *cmd);
+static void parseStartReplicationOptions(StartReplicationCmd *cmd,
+										 pg_compress_specification *compress);
 static void StartReplication(StartReplicationCmd *cmd);
 static void StartLogicalReplication(StartReplicationCmd *cmd);
 static void ProcessStandbyMessage(void);
@@ -338,6 +361,12 @@ WalSndErrorCleanup(void)
 
 	ReplicationSlotCleanup(false);
 
+	if (wal_compressor != NULL)
+	{
+		WalCompressorFree(wal_compressor);
+		wal_compressor = NULL;
+	}
+
 	replication_active = false;
 
 	/*
@@ -809,6 +838,75 @@ HandleUploadManifestPacket(StringInfo buf, off_t *offset,
 	return false;
 }
 
+/*
+ * Process the options of a physical START_REPLICATION command.
+ */
+static void
+parseStartReplicationOptions(StartReplicationCmd *cmd,
+							 pg_compress_specification *compress)
+{
+	ListCell   *lc;
+	bool		compression_given = false;
+	bool		compression_detail_given = false;
+	char	   *compression_detail = NULL;
+
+	compress->algorithm = PG_COMPRESSION_NONE;
+
+	foreach(lc, cmd->options)
+	{
+		DefElem    *defel = (DefElem *) lfirst(lc);
+
+		if (strcmp(defel->defname, "compression") == 0)
+		{
+			char	   *optval = defGetString(defel);
+
+			if (compression_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			if (!parse_compress_algorithm(optval, &compress->algorithm))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("unrecognized compression algorithm: \"%s\"",
+								optval)));
+			compression_given = true;
+		}
+		else if (strcmp(defel->defname, "compression_detail") == 0)
+		{
+			if (compression_detail_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			compression_detail = defGetString(defel);
+			compression_detail_given = true;
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("unrecognized START_REPLICATION option: \"%s\"",
+							defel->defname)));
+	}
+
+	if (compression_detail_given && !compression_given)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("compression detail cannot be specified unless compression is enabled")));
+
+	if (compress->algorithm != PG_COMPRESSION_NONE)
+	{
+		char	   *error_detail;
+
+		parse_compress_specification(compress->algorithm, compression_detail,
+									 compress);
+		error_detail = validate_compress_specification(compress);
+		if (error_detail != NULL)
+			ereport(ERROR,
+					errcode(ERRCODE_SYNTAX_ERROR),
+					errmsg("invalid compression specification: %s",
+						   error_detail));
+	}
+}
+
 /*
  * Handle START_REPLICATION command.
  *
@@ -821,6 +919,9 @@ StartReplication(StartReplicationCmd *cmd)
 	StringInfoData buf;
 	XLogRecPtr	FlushPtr;
 	TimeLineID	FlushTLI;
+	pg_compress_specification compress;
+
+	parseStartReplicationOptions(cmd, &compress);
 
 	/* create xlogreader for physical replication */
 	xlogreader =
@@ -971,9 +1072,23 @@ StartReplication(StartReplicationCmd *cmd)
 		/* Start streaming from the requested point */
 		sentPtr = cmd->startpoint;
 
+		/* Set up compression of the stream, if requested */
+		if (compress.algorithm != PG_COMPRESSION_NONE)
+		{
+			MemoryContext oldcontext;
+
+			oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+			wal_compressor = WalCompressorCreate(&compress);
+			MemoryContextSwitchTo(oldcontext);
+		}
+
 		/* Initialize shared memory status, too */
 		SpinLockAcquire(&MyWalSnd->mutex);
 		MyWalSnd->sentPtr = sentPtr;
+		MyWalSnd->compression = compress.algorithm;
+		MyWalSnd->compressInBytes = 0;
+		MyWalSnd->compressOutBytes = 0;
+		MyWalSnd->compressTime = 0;
 		SpinLockRelease(&MyWalSnd->mutex);
 
 		SyncRepInitConfig();
@@ -984,6 +1099,12 @@ StartReplication(StartReplicationCmd *cmd)
 		WalSndLoop(XLogSendPhysical);
 
 		replication_active = false;
+
+		if (wal_compressor != NULL)
+		{
+			WalCompressorFree(wal_compressor);
+			wal_compressor = NULL;
+		}
 		if (got_STOPPING)
 			proc_exit(0);
 		WalSndSetState(WALSNDSTATE_STARTUP);
@@ -1113,9 +1234,55 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 	XLByteToSeg(targetPagePtr, segno, state->segcxt.ws_segsize);
 	CheckXLogRemoved(segno, state->seg.ws_tli);
 
+	logical_readahead_xlog(state, targetPagePtr + count, flushptr);
+
 	return count;
 }
 
+/*
+ * Ask the kernel to start reading the WAL following 'startptr' in the
+ * currently open segment, up to 'flushptr'.
+ *
+ * Without this, a logical walsender reads WAL synchronously one page at a
+ * time between decoding records, so every cache miss stalls decoding.
+ */
+static void
+logical_readahead_xlog(XLogReaderState *state, XLogRecPtr startptr,
+					   XLogRecPtr flushptr)
+{
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	int			segsize = state->segcxt.ws_segsize;
+	XLogRecPtr	segend;
+	XLogRecPtr	endptr;
+
+	if (state->seg.ws_file < 0)
+		return;
+
+	/* Forget about an earlier hint if decoding was restarted further back */
+	if (startptr + LOGICAL_WAL_READAHEAD_SIZE < logicalReadAheadUpto)
+		logicalReadAheadUpto = InvalidXLogRecPtr;
+
+	/* Nothing to do until half of the previous window has been consumed */
+	if (startptr + LOGICAL_WAL_READAHEAD_SIZE / 2 < logicalReadAheadUpto)
+		return;
+
+	startptr = Max(startptr, logicalReadAheadUpto);
+	if (XLogSegmentOffset(startptr, segsize) == 0)
+		return;					/* belongs to the next segment */
+
+	segend = startptr - XLogSegmentOffset(startptr, segsize) + segsize;
+	endptr = Min(startptr + LOGICAL_WAL_READAHEAD_SIZE, segend);
+	endptr = Min(endptr, flushptr);
+	if (endptr <= startptr)
+		return;
+
+	(void) posix_fadvise(state->seg.ws_file,
+						 XLogSegmentOffset(startptr, segsize),
+						 endptr - startptr, POSIX_FADV_WILLNEED);
+	logicalReadAheadUpto = endptr;
+#endif
+}
+
 /*
  * Process extra options given to CREATE_REPLICATION_SLOT.
  */
@@ -2084,6 +2251,7 @@ exec_replication_command(const char *cmd_string)
 	 */
 	initStringInfo(&output_message);
 	initStringInfo(&reply_message);
+	initStringInfo(&compressed_message);
 	initStringInfo(&tmpbuf);
 
 	switch (cmd_node->type)
@@ -2934,6 +3102,10 @@ InitWalSenderSlot(void)
 			walsnd->sync_standby_priority = 0;
 			walsnd->latch = &MyProc->procLatch;
 			walsnd->replyTime = 0;
+			walsnd->compression = PG_COMPRESSION_NONE;
+			walsnd->compressInBytes = 0;
+			walsnd->compressOutBytes = 0;
+			walsnd->compressTime = 0;
 
 			/*
 			 * The kind assignment is done here and not in StartReplication()
@@ -3072,6 +3244,12 @@ XLogSendPhysical(void)
 	XLogSegNo	segno;
 	WALReadError errinfo;
 	Size		rbytes;
+	StringInfo	msg;
+	uint64		compress_in = 0;
+	uint64		compress_out = 0;
+	instr_time	compress_time;
+
+	INSTR_TIME_SET_ZERO(compress_time);
 
 	/* If requested switch the WAL sender to the stopping state. */
 	if (got_STOPPING)
@@ -3337,15 +3515,39 @@ retry:
 	output_message.len += nbytes;
 	output_message.data[output_message.len] = '\0';
 
+	/*
+	 * If the client asked for compression, replace the WAL that follows the
+	 * message header with its compressed form.
+	 */
+	msg = &output_message;
+	if (wal_compressor != NULL)
+	{
+		int			hdrlen = 1 + sizeof(int64) + sizeof(int64) + sizeof(int64);
+		instr_time	start;
+
+		resetStringInfo(&compressed_message);
+		appendBinaryStringInfo(&compressed_message, output_message.data, hdrlen);
+
+		INSTR_TIME_SET_CURRENT(start);
+		WalCompressData(wal_compressor, output_message.data + hdrlen,
+						output_message.len - hdrlen, &compressed_message);
+		INSTR_TIME_SET_CURRENT(compress_time);
+		INSTR_TIME_SUBTRACT(compress_time, start);
+
+		compress_in = output_message.len - hdrlen;
+		compress_out = compressed_message.len - hdrlen;
+		msg = &compressed_message;
+	}
+
 	/*
 	 * Fill the send timestamp last, so that it is taken as late as possible.
 	 */
 	resetStringInfo(&tmpbuf);
 	pq_sendint64(&tmpbuf, GetCurrentTimestamp());
-	memcpy(&output_message.data[1 + sizeof(int64) + sizeof(int64)],
+	memcpy(&msg->data[1 + sizeof(int64) + sizeof(int64)],
 		   tmpbuf.data, sizeof(int64));
 
-	pq_putmessage_noblock('d', output_message.data, output_message.len);
+	pq_putmessage_noblock('d', msg->data, msg->len);
 
 	sentPtr = endptr;
 
@@ -3355,6 +3557,9 @@ retry:
 
 		SpinLockAcquire(&walsnd->mutex);
 		walsnd->sentPtr = sentPtr;
+		walsnd->compressInBytes += compress_in;
+		walsnd->compressOutBytes += compress_out;
+		walsnd->compressTime += INSTR_TIME_GET_MICROSEC(compress_time);
 		SpinLockRelease(&walsnd->mutex);
 	}
 
@@ -3862,7 +4067,7 @@ offset_to_interval(TimeOffset offset)
 Datum
 pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_SENDERS_COLS	12
+#define PG_STAT_GET_WAL_SENDERS_COLS	16
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	SyncRepStandbyData *sync_standbys;
 	int			num_standbys;
@@ -3890,6 +4095,10 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		int			pid;
 		WalSndState state;
 		TimestampTz replyTime;
+		pg_compress_algorithm compression;
+		uint64		compressInBytes;
+		uint64		compressOutBytes;
+		int64		compressTime;
 		bool		is_sync_standby;
 		Datum		values[PG_STAT_GET_WAL_SENDERS_COLS];
 		bool		nulls[PG_STAT_GET_WAL_SENDERS_COLS] = {0};
@@ -3913,6 +4122,10 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		applyLag = walsnd->applyLag;
 		priority = walsnd->sync_standby_priority;
 		replyTime = walsnd->replyTime;
+		compression = walsnd->compression;
+		compressInBytes = walsnd->compressInBytes;
+		compressOutBytes = walsnd->compressOutBytes;
+		compressTime = walsnd->compressTime;
 		SpinLockRelease(&walsnd->mutex);
 
 		/*
@@ -4009,6 +4222,21 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 				nulls[11] = true;
 			else
 				values[11] = TimestampTzGetDatum(replyTime);
+
+			if (compression == PG_COMPRESSION_NONE)
+			{
+				nulls[12] = true;
+				nulls[13] = true;
+				nulls[14] = true;
+				nulls[15] = true;
+			}
+			else
+			{
+				values[12] = CStringGetTextDatum(get_compress_algorithm_name(compression));
+				values[13] = Int64GetDatum(compressInBytes);
+				values[14] = Int64GetDatum(compressOutBytes);
+				values[15] = Float8GetDatum((double) compressTime / 1000.0);
+			}
 		}
 
 		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
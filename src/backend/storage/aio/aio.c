@@ -0,0 +1,511 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Per-backend asynchronous I/O submission and completion.
+ *
+ * Each backend that uses asynchronous I/O lazily sets up its own io_uring
+ * instance the first time pgaio_enabled() is called with io_method set to
+ * io_uring.  I/Os are identified by small integer handles, allocated with
+ * pgaio_acquire().  A handle is passed to pgaio_start_readv(),
+ * pgaio_start_writev() or pgaio_start_fsync(), which submit the I/O to the
+ * kernel and return immediately, and then to pgaio_wait(), which blocks until
+ * the I/O has completed, returns its result and releases the handle.
+ *
+ * This module knows nothing about buffers.  Callers are responsible for
+ * interlocking the memory an I/O reads into or writes from (normally with
+ * BM_IO_IN_PROGRESS), and must not let that memory be reused before
+ * pgaio_wait() has returned, including in error cleanup paths.
+ *
+ * If the kernel doesn't allow io_uring to be used (it may be disabled, or
+ * forbidden by a seccomp policy in containers), pgaio_enabled() returns false
+ * and callers fall back to synchronous I/O.
+ *
+ *
+ * Portions Copyright (c) 2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "port/atomics.h"
+#include "storage/aio.h"
+#include "utils/wait_event.h"
+
+/* The C library might not know the system call numbers, even if we do. */
+#if defined(USE_IO_URING) && \
+	!(defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter))
+#undef USE_IO_URING
+#endif
+
+/* GUC */
+int			io_method = DEFAULT_IO_METHOD;
+
+#ifdef USE_IO_URING
+
+/* Submission and completion rings, as mapped from the kernel. */
+typedef struct PgAioUring
+{
+	int			fd;
+
+	/* submission queue */
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned	sq_mask;
+	unsigned   *sq_array;
+	struct io_uring_sqe *sqes;
+
+	/* completion queue */
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned	cq_mask;
+	struct io_uring_cqe *cqes;
+} PgAioUring;
+
+/* State of one handle. */
+typedef struct PgAioHandle
+{
+	bool		in_use;
+	bool		in_flight;
+	bool		is_write;
+	ssize_t		result;
+	struct iovec iov[PG_IOV_MAX];
+} PgAioHandle;
+
+typedef enum PgAioUringState
+{
+	PGAIO_URING_UNINITIALIZED,
+	PGAIO_URING_READY,
+	PGAIO_URING_FAILED,
+} PgAioUringState;
+
+static PgAioUringState uring_state = PGAIO_URING_UNINITIALIZED;
+static PgAioUring uring;
+static PgAioHandle *handles;
+static int	free_handles[PGAIO_MAX_IN_FLIGHT];
+static int	num_free_handles;
+static int	num_in_flight;
+
+static bool pgaio_uring_setup(void);
+static bool pgaio_uring_submit(int handle, int fd, uint8 opcode,
+							   int iovcnt, off_t offset);
+static void pgaio_uring_reap(void);
+
+static int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+				   unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+						 flags, NULL, 0);
+}
+
+/*
+ * Create this backend's io_uring instance and map its rings.  Returns false,
+ * and leaves io_uring permanently disabled for this process, on failure.
+ */
+static bool
+pgaio_uring_setup(void)
+{
+	struct io_uring_params p;
+	size_t		sq_size;
+	size_t		cq_size;
+	char	   *sq_ptr;
+	char	   *cq_ptr;
+	void	   *sqes;
+	int			fd;
+
+	memset(&p, 0, sizeof(p));
+	fd = sys_io_uring_setup(PGAIO_MAX_IN_FLIGHT, &p);
+	if (fd < 0)
+	{
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+				 errmsg_internal("could not set up io_uring, falling back to synchronous I/O: %m")));
+		return false;
+	}
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sq_size = cq_size = Max(sq_size, cq_size);
+
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		goto fail;
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else
+	{
+		cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			goto fail;
+	}
+	sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		goto fail;
+
+	uring.fd = fd;
+	uring.sq_head = (unsigned *) (sq_ptr + p.sq_off.head);
+	uring.sq_tail = (unsigned *) (sq_ptr + p.sq_off.tail);
+	uring.sq_mask = *(unsigned *) (sq_ptr + p.sq_off.ring_mask);
+	uring.sq_array = (unsigned *) (sq_ptr + p.sq_off.array);
+	uring.sqes = (struct io_uring_sqe *) sqes;
+	uring.cq_head = (unsigned *) (cq_ptr + p.cq_off.head);
+	uring.cq_tail = (unsigned *) (cq_ptr + p.cq_off.tail);
+	uring.cq_mask = *(unsigned *) (cq_ptr + p.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *) (cq_ptr + p.cq_off.cqes);
+
+	/*
+	 * WAL writing may get here inside a critical section, where palloc is
+	 * not allowed, so use plain malloc.  The handles live as long as the
+	 * process anyway.
+	 */
+	handles = calloc(PGAIO_MAX_IN_FLIGHT, sizeof(PgAioHandle));
+	if (handles == NULL)
+		goto fail;
+	for (int i = 0; i < PGAIO_MAX_IN_FLIGHT; i++)
+		free_handles[i] = PGAIO_MAX_IN_FLIGHT - i - 1;
+	num_free_handles = PGAIO_MAX_IN_FLIGHT;
+
+	return true;
+
+fail:
+	ereport(DEBUG1,
+			(errcode_for_file_access(),
+			 errmsg_internal("could not map io_uring queues, falling back to synchronous I/O: %m")));
+	close(fd);
+	return false;
+}
+
+/*
+ * Place one request in the submission queue and tell the kernel about it.
+ */
+static bool
+pgaio_uring_submit(int handle, int fd, uint8 opcode, int iovcnt, off_t offset)
+{
+	struct io_uring_sqe *sqe;
+	unsigned	tail;
+	unsigned	index;
+	int			rc;
+
+	tail = *uring.sq_tail;
+	index = tail & uring.sq_mask;
+	sqe = &uring.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	if (opcode != IORING_OP_FSYNC)
+	{
+		sqe->off = offset;
+		sqe->addr = (uint64) (uintptr_t) handles[handle].iov;
+		sqe->len = iovcnt;
+	}
+	sqe->user_data = handle;
+	uring.sq_array[index] = index;
+
+	/* The entry must be visible before the kernel sees the new tail. */
+	pg_write_barrier();
+	*uring.sq_tail = tail + 1;
+
+	do
+	{
+		rc = sys_io_uring_enter(uring.fd, 1, 0, 0);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc != 1)
+	{
+		/*
+		 * Without SQPOLL the kernel only consumes entries inside
+		 * io_uring_enter(), so it's safe to take this one back.
+		 */
+		*uring.sq_tail = tail;
+		ereport(DEBUG1,
+				(errcode_for_file_access(),
+				 errmsg_internal("could not submit asynchronous I/O: %m")));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Consume all available completion queue entries, without waiting.
+ */
+static void
+pgaio_uring_reap(void)
+{
+	unsigned	head = *uring.cq_head;
+
+	for (;;)
+	{
+		struct io_uring_cqe *cqe;
+		PgAioHandle *h;
+
+		/* Read the entry only after the kernel's tail store. */
+		if (head == *((volatile unsigned *) uring.cq_tail))
+			break;
+		pg_read_barrier();
+
+		cqe = &uring.cqes[head & uring.cq_mask];
+		Assert(cqe->user_data < PGAIO_MAX_IN_FLIGHT);
+		h = &handles[cqe->user_data];
+		Assert(h->in_use && h->in_flight);
+		h->result = cqe->res;
+		h->in_flight = false;
+		num_in_flight--;
+		head++;
+	}
+
+	/* Entries must be fully read before the kernel may reuse them. */
+	pg_memory_barrier();
+	*uring.cq_head = head;
+}
+
+#endif							/* USE_IO_URING */
+
+/*
+ * Is asynchronous I/O available in this process?  If so, callers may use
+ * pgaio_acquire() to start I/Os.
+ */
+bool
+pgaio_enabled(void)
+{
+#ifdef USE_IO_URING
+	if (io_method != IOMETHOD_IO_URING)
+		return false;
+	if (likely(uring_state == PGAIO_URING_READY))
+		return true;
+	if (uring_state == PGAIO_URING_UNINITIALIZED)
+		uring_state = pgaio_uring_setup() ?
+			PGAIO_URING_READY : PGAIO_URING_FAILED;
+	return uring_state == PGAIO_URING_READY;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Allocate a handle for a new I/O.  Returns -1 if asynchronous I/O is not
+ * enabled, or if the maximum number of I/Os are already in flight.  In that
+ * case the caller should perform the I/O synchronously.
+ */
+int
+pgaio_acquire(void)
+{
+#ifdef USE_IO_URING
+	int			handle;
+
+	if (!pgaio_enabled() || num_free_handles == 0)
+		return -1;
+
+	handle = free_handles[--num_free_handles];
+	Assert(!handles[handle].in_use);
+	handles[handle].in_use = true;
+	handles[handle].in_flight = false;
+	return handle;
+#else
+	return -1;
+#endif
+}
+
+#ifdef USE_IO_URING
+static bool
+pgaio_start_io(int handle, int fd, const struct iovec *iov, int iovcnt,
+			   off_t offset, bool is_write)
+{
+	PgAioHandle *h = &handles[handle];
+
+	Assert(handle >= 0 && handle < PGAIO_MAX_IN_FLIGHT);
+	Assert(h->in_use && !h->in_flight);
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	/* The kernel may read the iovecs after we return, so keep a copy. */
+	memcpy(h->iov, iov, sizeof(struct iovec) * iovcnt);
+	h->is_write = is_write;
+
+	if (!pgaio_uring_submit(handle, fd,
+							is_write ? IORING_OP_WRITEV : IORING_OP_READV,
+							iovcnt, offset))
+		return false;
+
+	h->in_flight = true;
+	num_in_flight++;
+	return true;
+}
+#endif
+
+/*
+ * Start reading into the memory described by iov from fd at offset.  Returns
+ * false if the read could not be submitted, in which case the caller should
+ * release the handle with pgaio_release() and perform the read synchronously.
+ */
+bool
+pgaio_start_readv(int handle, int fd, const struct iovec *iov, int iovcnt,
+				  off_t offset)
+{
+#ifdef USE_IO_URING
+	return pgaio_start_io(handle, fd, iov, iovcnt, offset, false);
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	pg_unreachable();
+#endif
+}
+
+/*
+ * Like pgaio_start_readv(), but for writes.
+ */
+bool
+pgaio_start_writev(int handle, int fd, const struct iovec *iov, int iovcnt,
+				   off_t offset)
+{
+#ifdef USE_IO_URING
+	return pgaio_start_io(handle, fd, iov, iovcnt, offset, true);
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	pg_unreachable();
+#endif
+}
+
+/*
+ * Start flushing fd to durable storage, like fsync().  Returns false if the
+ * request could not be submitted, as for pgaio_start_readv().  The caller
+ * should wait for it with pgaio_wait_for(); a result of zero means success.
+ */
+bool
+pgaio_start_fsync(int handle, int fd)
+{
+#ifdef USE_IO_URING
+	PgAioHandle *h = &handles[handle];
+
+	Assert(handle >= 0 && handle < PGAIO_MAX_IN_FLIGHT);
+	Assert(h->in_use && !h->in_flight);
+
+	h->is_write = true;
+
+	if (!pgaio_uring_submit(handle, fd, IORING_OP_FSYNC, 0, 0))
+		return false;
+
+	h->in_flight = true;
+	num_in_flight++;
+	return true;
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	pg_unreachable();
+#endif
+}
+
+/*
+ * Wait for the I/O identified by handle to complete, and release the handle.
+ * Returns the number of bytes transferred, or a negated errno value.  Short
+ * transfers are possible, and are left for the caller to deal with.
+ */
+ssize_t
+pgaio_wait(int handle)
+{
+#ifdef USE_IO_URING
+	return pgaio_wait_for(handle, handles[handle].is_write ?
+						  WAIT_EVENT_DATA_FILE_WRITE :
+						  WAIT_EVENT_DATA_FILE_READ);
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	pg_unreachable();
+#endif
+}
+
+/*
+ * Like pgaio_wait(), but report wait_event_info while sleeping, for callers
+ * whose I/O isn't on a data file.
+ */
+ssize_t
+pgaio_wait_for(int handle, uint32 wait_event_info)
+{
+#ifdef USE_IO_URING
+	PgAioHandle *h = &handles[handle];
+	ssize_t		result;
+
+	Assert(handle >= 0 && handle < PGAIO_MAX_IN_FLIGHT);
+	Assert(h->in_use);
+
+	if (h->in_flight)
+		pgaio_uring_reap();
+
+	if (h->in_flight)
+	{
+		pgstat_report_wait_start(wait_event_info);
+		while (h->in_flight)
+		{
+			int			rc;
+
+			rc = sys_io_uring_enter(uring.fd, 0, 1, IORING_ENTER_GETEVENTS);
+			if (rc < 0 && errno != EINTR)
+				elog(PANIC, "could not wait for asynchronous I/O completion: %m");
+			pgaio_uring_reap();
+		}
+		pgstat_report_wait_end();
+	}
+
+	result = h->result;
+	h->in_use = false;
+	free_handles[num_free_handles++] = handle;
+
+	return result;
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	pg_unreachable();
+#endif
+}
+
+/*
+ * Release a handle that was acquired but not successfully used to start an
+ * I/O.
+ */
+void
+pgaio_release(int handle)
+{
+#ifdef USE_IO_URING
+	PgAioHandle *h = &handles[handle];
+
+	Assert(handle >= 0 && handle < PGAIO_MAX_IN_FLIGHT);
+	Assert(h->in_use && !h->in_flight);
+
+	h->in_use = false;
+	free_handles[num_free_handles++] = handle;
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+#endif
+}
+
+/*
+ * Number of handles currently held by this backend, including those of I/Os
+ * that the kernel has already completed but that haven't been waited for.
+ */
+int
+pgaio_in_flight(void)
+{
+#ifdef USE_IO_URING
+	return PGAIO_MAX_IN_FLIGHT - num_free_handles;
+#else
+	return 0;
+#endif
+}
@@ -33,7 +33,9 @@
  *
  * C) I/O is necessary, it appears random, and this system supports fadvise.
  * We'll look further ahead in order to reach the configured level of I/O
- * concurrency.
+ * concurrency.  With asynchronous I/O (see io_method), StartReadBuffers()
+ * submits real reads, so we always aim for this behavior whenever I/O is
+ * necessary, even for sequential access and with direct I/O.
  *
  * The distance increases rapidly and decays slowly, so that it moves towards
  * those levels as different I/O patterns are discovered.  For example, a
@@ -90,6 +92,7 @@
 
 #include "catalog/pg_tablespace.h"
 #include "miscadmin.h"
+#include "storage/aio.h"
 #include "storage/fd.h"
 #include "storage/smgr.h"
 #include "storage/read_stream.h"
@@ -115,6 +118,7 @@ struct ReadStream
 	int16		pinned_buffers;
 	int16		distance;
 	bool		advice_enabled;
+	bool		async_enabled;
 
 	/*
 	 * Small buffer of block numbers, useful for 'ungetting' to resolve flow
@@ -255,11 +259,14 @@ read_stream_start_pending_read(ReadStream *stream, bool suppress_advice)
 
 	/*
 	 * If advice hasn't been suppressed, this system supports it, and this
-	 * isn't a strictly sequential pattern, then we'll issue advice.
+	 * isn't a strictly sequential pattern, then we'll issue advice.  Reads
+	 * that will be started asynchronously are worth issuing early even if
+	 * they are sequential.
 	 */
 	if (!suppress_advice &&
 		stream->advice_enabled &&
-		stream->pending_read_blocknum != stream->seq_blocknum)
+		(stream->async_enabled ||
+		 stream->pending_read_blocknum != stream->seq_blocknum))
 		flags = READ_BUFFERS_ISSUE_ADVICE;
 	else
 		flags = 0;
@@ -397,6 +404,23 @@ read_stream_look_ahead(ReadStream *stream, bool suppress_advice)
 		read_stream_start_pending_read(stream, suppress_advice);
 }
 
+/*
+ * General-use ReadStreamBlockNumberCB for reading a range of blocks, see
+ * BlockRangeReadStreamPrivate.
+ */
+BlockNumber
+block_range_read_stream_cb(ReadStream *stream,
+						   void *callback_private_data,
+						   void *per_buffer_data)
+{
+	BlockRangeReadStreamPrivate *p = callback_private_data;
+
+	if (p->current_blocknum < p->last_exclusive)
+		return p->current_blocknum++;
+
+	return InvalidBlockNumber;
+}
+
 /*
  * Create a new read stream object that can be used to perform the equivalent
  * of a series of ReadBuffer() calls for one fork of one relation.
@@ -518,9 +542,19 @@ read_stream_begin_relation(int flags,
 #endif
 
 	/*
-	 * For now, max_ios = 0 is interpreted as max_ios = 1 with advice disabled
-	 * above.  If we had real asynchronous I/O we might need a slightly
-	 * different definition.
+	 * With asynchronous I/O, StartReadBuffers() can really start reads of
+	 * shared buffers, so look ahead even when advice isn't useful.  The
+	 * caller's READ_STREAM_SEQUENTIAL hint only concerns advice.
+	 */
+	if (max_ios > 0 && !SmgrIsTemp(smgr) && pgaio_enabled())
+	{
+		stream->advice_enabled = true;
+		stream->async_enabled = true;
+	}
+
+	/*
+	 * max_ios = 0 is interpreted as max_ios = 1 with advice and asynchronous
+	 * I/O disabled above.
 	 */
 	if (max_ios == 0)
 		max_ios = 1;
@@ -24,6 +24,12 @@ ConditionVariableMinimallyPadded *BufferIOCVArray;
 WritebackContext BackendWritebackContext;
 CkptSortItem *CkptBufferIds;
 
+/*
+ * GUC variable: number of shared buffers to use, or -1 for all of
+ * shared_buffers.  See BufferPoolResize().
+ */
+int			active_shared_buffers = -1;
+
 
 /*
  * Data Structures:
@@ -144,6 +150,7 @@ InitBufferPool(void)
 
 	/* Init other shared buffer-management stuff */
 	StrategyInitialize(!foundDescs);
+	SecondaryCacheShmemInit();
 
 	/* Initialize per-backend file flush context */
 	WritebackContextInit(&BackendWritebackContext,
@@ -182,5 +189,8 @@ BufferShmemSize(void)
 	/* size of checkpoint sort array in bufmgr.c */
 	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
 
+	/* size of stuff controlled by secondary_cache.c */
+	size = add_size(size, SecondaryCacheShmemSize());
+
 	return size;
 }
@@ -9,6 +9,9 @@
  * in most cases the caller needs to adjust the buffer header contents
  * before the lock is released (see notes in README).
  *
+ * The exception is BufTableLookupOptimistic(), which takes no lock at all
+ * and whose result the caller must validate against the buffer header.
+ *
  *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -21,6 +24,8 @@
  */
 #include "postgres.h"
 
+#include "common/hashfn.h"
+#include "common/int.h"
 #include "storage/buf_internals.h"
 
 /* entry for buffer lookup hashtable */
@@ -30,7 +35,40 @@ typedef struct
 	int			id;				/* Associated buffer ID */
 } BufferLookupEnt;
 
+/*
+ * Residency counters.  A relation fork has one entry for each buffer mapping
+ * partition it has pages in, so that maintaining the counter needs only the
+ * partition lock the caller already holds exclusively.  The hash code of an
+ * entry is arranged to fall into the same partition as the buffers it counts.
+ */
+typedef struct
+{
+	RelFileLocator rlocator;
+	ForkNumber	forkNum;
+	uint32		partition;		/* buffer mapping partition number */
+} BufResidencyKey;
+
+typedef struct
+{
+	BufResidencyKey key;
+	int32		nbuffers;		/* buffers of this fork in this partition */
+} BufResidencyEnt;
+
+StaticAssertDecl((NUM_BUFFER_PARTITIONS & (NUM_BUFFER_PARTITIONS - 1)) == 0,
+				 "NUM_BUFFER_PARTITIONS must be a power of 2");
+
+/* GUC variable */
+bool		track_buffer_residency = false;
+
 static HTAB *SharedBufHash;
+static HTAB *BufResidencyHash;
+
+/*
+ * Give up an unlocked lookup after visiting this many entries.  The table is
+ * sized so that chains are short; hitting this means the chain was being
+ * modified under us, and the locked lookup will sort it out.
+ */
+#define BUF_TABLE_MAX_UNLOCKED_STEPS	32
 
 
 /*
@@ -40,7 +78,12 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	Size		sz = hash_estimate_size(size, sizeof(BufferLookupEnt));
+
+	if (track_buffer_residency)
+		sz = add_size(sz, hash_estimate_size(size, sizeof(BufResidencyEnt)));
+
+	return sz;
 }
 
 /*
@@ -63,6 +106,151 @@ InitBufTable(int size)
 								  size, size,
 								  &info,
 								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+
+	if (track_buffer_residency)
+	{
+		/*
+		 * One entry per buffer is the worst case, reached only if every
+		 * buffer belongs to a different relation fork.
+		 */
+		info.keysize = sizeof(BufResidencyKey);
+		info.entrysize = sizeof(BufResidencyEnt);
+		info.num_partitions = NUM_BUFFER_PARTITIONS;
+
+		BufResidencyHash = ShmemInitHash("Shared Buffer Residency Table",
+										 size, size,
+										 &info,
+										 HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+	}
+}
+
+/*
+ * Adjust the residency counter for the relation fork of *tagPtr by delta.
+ * hashcode is the tag's buffer mapping hash code; the caller holds the
+ * corresponding partition lock exclusively.
+ */
+static void
+BufResidencyAdjust(BufferTag *tagPtr, uint32 hashcode, int delta)
+{
+	BufResidencyKey key;
+	BufResidencyEnt *ent;
+	uint32		rhash;
+	bool		found;
+
+	memset(&key, 0, sizeof(key));
+	key.rlocator = BufTagGetRelFileLocator(tagPtr);
+	key.forkNum = BufTagGetForkNum(tagPtr);
+	key.partition = BufTableHashPartition(hashcode);
+
+	/*
+	 * Keep the low bits of the mapping hash code so that the entry lands in
+	 * the partition that is already locked.  The partition number is part of
+	 * the key, so the remaining bits only need to spread forks apart.
+	 */
+	rhash = hash_bytes((const unsigned char *) &key,
+					   offsetof(BufResidencyKey, partition));
+	rhash = (rhash & ~((uint32) NUM_BUFFER_PARTITIONS - 1)) | key.partition;
+
+	if (delta > 0)
+	{
+		ent = (BufResidencyEnt *)
+			hash_search_with_hash_value(BufResidencyHash, &key, rhash,
+										HASH_ENTER, &found);
+		if (!found)
+			ent->nbuffers = 0;
+		ent->nbuffers += delta;
+	}
+	else
+	{
+		ent = (BufResidencyEnt *)
+			hash_search_with_hash_value(BufResidencyHash, &key, rhash,
+										HASH_FIND, NULL);
+		Assert(ent != NULL && ent->nbuffers >= -delta);
+		if (ent == NULL)
+			return;
+		ent->nbuffers += delta;
+		if (ent->nbuffers <= 0)
+			hash_search_with_hash_value(BufResidencyHash, &key, rhash,
+										HASH_REMOVE, NULL);
+	}
+}
+
+static int
+buffer_residency_cmp(const void *a, const void *b)
+{
+	const BufferResidency *ra = (const BufferResidency *) a;
+	const BufferResidency *rb = (const BufferResidency *) b;
+
+	if (ra->rlocator.spcOid != rb->rlocator.spcOid)
+		return pg_cmp_u32(ra->rlocator.spcOid, rb->rlocator.spcOid);
+	if (ra->rlocator.dbOid != rb->rlocator.dbOid)
+		return pg_cmp_u32(ra->rlocator.dbOid, rb->rlocator.dbOid);
+	if (ra->rlocator.relNumber != rb->rlocator.relNumber)
+		return pg_cmp_u32(ra->rlocator.relNumber, rb->rlocator.relNumber);
+	return pg_cmp_s32(ra->forkNum, rb->forkNum);
+}
+
+/*
+ * BufResidencySnapshot
+ *		Return the number of shared buffers holding pages of each relation fork
+ *
+ * Returns a palloc'd array and sets *nentries, or returns NULL if
+ * track_buffer_residency is off.  All buffer mapping partition locks are
+ * taken in share mode while the counters are copied, so the result is a
+ * consistent picture; the work done under the locks is proportional to the
+ * number of cached relation forks rather than to shared_buffers.
+ */
+BufferResidency *
+BufResidencySnapshot(int *nentries)
+{
+	HASH_SEQ_STATUS status;
+	BufResidencyEnt *ent;
+	BufferResidency *result;
+	long		maxentries;
+	int			n = 0;
+	int			i;
+
+	*nentries = 0;
+	if (BufResidencyHash == NULL)
+		return NULL;
+
+	for (i = 0; i < NUM_BUFFER_PARTITIONS; i++)
+		LWLockAcquire(BufMappingPartitionLockByIndex(i), LW_SHARED);
+
+	maxentries = hash_get_num_entries(BufResidencyHash);
+	result = palloc_array(BufferResidency, Max(maxentries, 1));
+
+	hash_seq_init(&status, BufResidencyHash);
+	while ((ent = (BufResidencyEnt *) hash_seq_search(&status)) != NULL)
+	{
+		Assert(n < maxentries);
+		result[n].rlocator = ent->key.rlocator;
+		result[n].forkNum = ent->key.forkNum;
+		result[n].nbuffers = ent->nbuffers;
+		n++;
+	}
+
+	for (i = NUM_BUFFER_PARTITIONS; --i >= 0;)
+		LWLockRelease(BufMappingPartitionLockByIndex(i));
+
+	/* fold the per-partition entries of each fork together */
+	if (n > 1)
+	{
+		int			j = 0;
+
+		qsort(result, n, sizeof(BufferResidency), buffer_residency_cmp);
+		for (i = 1; i < n; i++)
+		{
+			if (buffer_residency_cmp(&result[j], &result[i]) == 0)
+				result[j].nbuffers += result[i].nbuffers;
+			else
+				result[++j] = result[i];
+		}
+		n = j + 1;
+	}
+
+	*nentries = n;
+	return result;
 }
 
 /*
@@ -104,6 +292,38 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 	return result->id;
 }
 
+/*
+ * BufTableLookupOptimistic
+ *		Lookup the given BufferTag without holding the BufMappingLock
+ *
+ * Returns a buffer ID that held the tag at some recent point, or -1 if we
+ * found nothing (which does not mean the tag is absent).  The ID is always
+ * in range, but the caller must pin the buffer and recheck its tag before
+ * trusting it, and must repeat a miss with BufTableLookup() under the lock.
+ */
+int
+BufTableLookupOptimistic(BufferTag *tagPtr, uint32 hashcode)
+{
+	BufferLookupEnt *result;
+	int			id;
+
+	result = (BufferLookupEnt *)
+		hash_search_unlocked(SharedBufHash,
+							 tagPtr,
+							 hashcode,
+							 BUF_TABLE_MAX_UNLOCKED_STEPS);
+
+	if (!result)
+		return -1;
+
+	/* the entry may be in the middle of being recycled */
+	id = *((volatile int *) &result->id);
+	if (id < 0 || id >= NBuffers)
+		return -1;
+
+	return id;
+}
+
 /*
  * BufTableInsert
  *		Insert a hashtable entry for given tag and buffer ID,
@@ -135,6 +355,9 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 
 	result->id = buf_id;
 
+	if (BufResidencyHash)
+		BufResidencyAdjust(tagPtr, hashcode, 1);
+
 	return -1;
 }
 
@@ -158,4 +381,7 @@ BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 
 	if (!result)				/* shouldn't happen */
 		elog(ERROR, "shared buffer hash table corrupted");
+
+	if (BufResidencyHash)
+		BufResidencyAdjust(tagPtr, hashcode, -1);
 }
@@ -38,6 +38,7 @@
 #include <unistd.h>
 
 #include "access/tableam.h"
+#include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "access/xlogutils.h"
 #include "catalog/storage.h"
@@ -48,15 +49,18 @@
 #include "pg_trace.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
 #include "utils/memdebug.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/resowner.h"
@@ -174,6 +178,35 @@ int			backend_flush_after = DEFAULT_BACKEND_FLUSH_AFTER;
 /* local state for LockBufferForCleanup */
 static BufferDesc *PinCountWaitBuf = NULL;
 
+/*
+ * Reads started asynchronously by StartReadBuffers(), indexed by aio handle.
+ *
+ * We keep a copy of everything needed to complete each read here, rather
+ * than relying on the caller's ReadBuffersOperation, because a read might
+ * have to be completed early: if this backend tries to start I/O on one of
+ * the buffers through some other path, it would otherwise wait for itself
+ * forever.  For the same reason, error cleanup in AbortBufferIO() must wait
+ * for the kernel to finish with a buffer before letting anyone else use it.
+ * Only shared buffers are read asynchronously.
+ */
+typedef struct AsyncReadBuffers
+{
+	uint64		id;				/* 0 if not in use */
+	ResourceOwner owner;
+	SMgrRelation smgr;
+	ForkNumber	forknum;
+	BlockNumber blocknum;
+	int			flags;
+	int			nblocks;
+	IOContext	io_context;
+	instr_time	io_start;
+	Buffer		buffers[MAX_IO_COMBINE_LIMIT];
+} AsyncReadBuffers;
+
+static AsyncReadBuffers *AsyncReads = NULL;
+static int	NumAsyncReads = 0;
+static uint64 NextAsyncReadId = 1;
+
 /*
  * Backend-Private refcount management:
  *
@@ -503,6 +536,8 @@ static BlockNumber ExtendBufferedRelShared(BufferManagerRelation bmr,
 										   Buffer *buffers,
 										   uint32 *extended_by);
 static bool PinBuffer(BufferDesc *buf, BufferAccessStrategy strategy);
+static bool PinBufferIfTagMatches(BufferDesc *buf, const BufferTag *tag,
+								  BufferAccessStrategy strategy, bool *valid);
 static void PinBuffer_Locked(BufferDesc *buf);
 static void UnpinBuffer(BufferDesc *buf);
 static void UnpinBufferNoOwner(BufferDesc *buf);
@@ -510,8 +545,18 @@ static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
 						  WritebackContext *wb_context);
+static int	SyncBufferRun(const int *buf_ids, int nbuf_ids,
+						  bool skip_recently_used, WritebackContext *wb_context,
+						  int *results);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput, bool nowait);
+static int	StartReadBuffersAsync(ReadBuffersOperation *operation);
+static int	FindAsyncRead(Buffer buffer);
+static void CompleteReadBuffersAsync(int handle);
+static void CompleteReadBuffersIO(SMgrRelation smgr, ForkNumber forknum,
+								  int flags, bool is_temp, Buffer *io_buffers,
+								  BlockNumber io_first_block,
+								  int io_buffers_len);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
 							  uint32 set_flag_bits, bool forget_owner);
 static void AbortBufferIO(Buffer buffer);
@@ -526,6 +571,7 @@ static inline BufferDesc *BufferAlloc(SMgrRelation smgr,
 static Buffer GetVictimBuffer(BufferAccessStrategy strategy, IOContext io_context);
 static void FlushBuffer(BufferDesc *buf, SMgrRelation reln,
 						IOObject io_object, IOContext io_context);
+static void FlushBufferRun(BufferDesc **bufs, int nbufs, IOContext io_context);
 static void FindAndDropRelationBuffers(RelFileLocator rlocator,
 									   ForkNumber forkNum,
 									   BlockNumber nForkBlock,
@@ -1185,6 +1231,11 @@ ReadBuffer_common(Relation rel, SMgrRelation smgr, char smgr_persistence,
 
 		buffer = PinBufferForBlock(rel, smgr, smgr_persistence,
 								   forkNum, blockNum, strategy, &found);
+
+		/* An old copy of the block mustn't outlive the new contents. */
+		if (!found && SecondaryCacheEnabled() && !BufferIsLocal(buffer))
+			SecondaryCacheForget(&GetBufferDescriptor(buffer - 1)->tag);
+
 		ZeroBuffer(buffer, mode);
 		return buffer;
 	}
@@ -1260,24 +1311,36 @@ StartReadBuffersImpl(ReadBuffersOperation *operation,
 	operation->flags = flags;
 	operation->nblocks = actual_nblocks;
 	operation->io_buffers_len = io_buffers_len;
+	operation->io_async_len = 0;
 
 	if (flags & READ_BUFFERS_ISSUE_ADVICE)
 	{
-		/*
-		 * In theory we should only do this if PinBufferForBlock() had to
-		 * allocate new buffers above.  That way, if two calls to
-		 * StartReadBuffers() were made for the same blocks before
-		 * WaitReadBuffers(), only the first would issue the advice. That'd be
-		 * a better simulation of true asynchronous I/O, which would only
-		 * start the I/O once, but isn't done here for simplicity.  Note also
-		 * that the following call might actually issue two advice calls if we
-		 * cross a segment boundary; in a true asynchronous version we might
-		 * choose to process only one real I/O at a time in that case.
-		 */
-		smgrprefetch(operation->smgr,
-					 operation->forknum,
-					 blockNum,
-					 operation->io_buffers_len);
+		if (pgaio_enabled())
+		{
+			/*
+			 * Start a real read of as many of the buffers as we can.  Any
+			 * that aren't covered are read synchronously by
+			 * WaitReadBuffers().
+			 */
+			operation->io_async_len = StartReadBuffersAsync(operation);
+		}
+		else
+		{
+			/*
+			 * In theory we should only do this if PinBufferForBlock() had to
+			 * allocate new buffers above.  That way, if two calls to
+			 * StartReadBuffers() were made for the same blocks before
+			 * WaitReadBuffers(), only the first would issue the advice.
+			 * That'd be a better simulation of true asynchronous I/O, which
+			 * would only start the I/O once, but isn't done here for
+			 * simplicity.  Note also that the following call might actually
+			 * issue two advice calls if we cross a segment boundary.
+			 */
+			smgrprefetch(operation->smgr,
+						 operation->forknum,
+						 blockNum,
+						 operation->io_buffers_len);
+		}
 	}
 
 	/* Indicate that WaitReadBuffers() should be called. */
@@ -1297,10 +1360,11 @@ StartReadBuffersImpl(ReadBuffersOperation *operation,
  * object, the caller-supplied array of buffers must remain valid until
  * WaitReadBuffers() is called.
  *
- * Currently the I/O is only started with optional operating system advice if
- * requested by the caller with READ_BUFFERS_ISSUE_ADVICE, and the real I/O
- * happens synchronously in WaitReadBuffers().  In future work, true I/O could
- * be initiated here.
+ * The I/O is only started early if requested by the caller with
+ * READ_BUFFERS_ISSUE_ADVICE.  If asynchronous I/O is enabled (see io_method),
+ * a real read of the leading blocks is submitted here and completed in
+ * WaitReadBuffers().  Otherwise only operating system advice is issued, and
+ * the real I/O happens synchronously in WaitReadBuffers().
  */
 bool
 StartReadBuffers(ReadBuffersOperation *operation,
@@ -1400,7 +1464,16 @@ WaitReadBuffers(ReadBuffersOperation *operation)
 	else
 		pgBufferUsage.shared_blks_read += nblocks;
 
-	for (int i = 0; i < nblocks; ++i)
+	/*
+	 * If StartReadBuffers() started reading the leading buffers
+	 * asynchronously, collect that read first, unless it has already been
+	 * completed early.
+	 */
+	if (operation->io_async_len > 0 &&
+		AsyncReads[operation->io_handle].id == operation->io_async_id)
+		CompleteReadBuffersAsync(operation->io_handle);
+
+	for (int i = operation->io_async_len; i < nblocks; ++i)
 	{
 		int			io_buffers_len;
 		Buffer		io_buffers[MAX_IO_COMBINE_LIMIT];
@@ -1429,6 +1502,16 @@ WaitReadBuffers(ReadBuffersOperation *operation)
 			continue;
 		}
 
+		/* Try the secondary buffer cache before the relation file. */
+		if (SecondaryCacheEnabled() && persistence != RELPERSISTENCE_TEMP &&
+			SecondaryCacheRead(&GetBufferDescriptor(buffers[i] - 1)->tag,
+							   BufferGetBlock(buffers[i])))
+		{
+			CompleteReadBuffersIO(operation->smgr, forknum, operation->flags,
+								  false, &buffers[i], blocknum + i, 1);
+			continue;
+		}
+
 		/* We found a buffer that we need to read in. */
 		io_buffers[0] = buffers[i];
 		io_pages[0] = BufferGetBlock(buffers[i]);
@@ -1440,9 +1523,13 @@ WaitReadBuffers(ReadBuffersOperation *operation)
 		 * other buffers at the same time?  In this case we don't wait if we
 		 * see an I/O already in progress.  We already hold BM_IO_IN_PROGRESS
 		 * for the head block, so we should get on with that I/O as soon as
-		 * possible.  We'll come back to this block again, above.
+		 * possible.  We'll come back to this block again, above.  Blocks
+		 * that the secondary buffer cache holds are left for that, too.
 		 */
 		while ((i + 1) < nblocks &&
+			   !(SecondaryCacheEnabled() &&
+				 persistence != RELPERSISTENCE_TEMP &&
+				 SecondaryCacheContains(&GetBufferDescriptor(buffers[i + 1] - 1)->tag)) &&
 			   WaitReadBuffersCanStartIO(buffers[i + 1], true))
 		{
 			/* Must be consecutive block numbers. */
@@ -1458,71 +1545,242 @@ WaitReadBuffers(ReadBuffersOperation *operation)
 		pgstat_count_io_op_time(io_object, io_context, IOOP_READ, io_start,
 								io_buffers_len);
 
-		/* Verify each block we read, and terminate the I/O. */
-		for (int j = 0; j < io_buffers_len; ++j)
+		CompleteReadBuffersIO(operation->smgr, forknum, operation->flags,
+							  persistence == RELPERSISTENCE_TEMP,
+							  io_buffers, io_first_block, io_buffers_len);
+	}
+}
+
+/*
+ * Verify each block that has just been read into io_buffers, and terminate
+ * the I/O.
+ */
+static void
+CompleteReadBuffersIO(SMgrRelation smgr, ForkNumber forknum, int flags,
+					  bool is_temp, Buffer *io_buffers,
+					  BlockNumber io_first_block, int io_buffers_len)
+{
+	for (int j = 0; j < io_buffers_len; ++j)
+	{
+		BufferDesc *bufHdr;
+		Block		bufBlock;
+
+		if (is_temp)
+		{
+			bufHdr = GetLocalBufferDescriptor(-io_buffers[j] - 1);
+			bufBlock = LocalBufHdrGetBlock(bufHdr);
+		}
+		else
 		{
-			BufferDesc *bufHdr;
-			Block		bufBlock;
+			bufHdr = GetBufferDescriptor(io_buffers[j] - 1);
+			bufBlock = BufHdrGetBlock(bufHdr);
+		}
 
-			if (persistence == RELPERSISTENCE_TEMP)
+		/* check for garbage data */
+		if (!PageIsVerifiedExtended((Page) bufBlock, io_first_block + j,
+									PIV_LOG_WARNING | PIV_REPORT_STAT))
+		{
+			if ((flags & READ_BUFFERS_ZERO_ON_ERROR) || zero_damaged_pages)
 			{
-				bufHdr = GetLocalBufferDescriptor(-io_buffers[j] - 1);
-				bufBlock = LocalBufHdrGetBlock(bufHdr);
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								io_first_block + j,
+								relpath(smgr->smgr_rlocator, forknum))));
+				memset(bufBlock, 0, BLCKSZ);
 			}
 			else
-			{
-				bufHdr = GetBufferDescriptor(io_buffers[j] - 1);
-				bufBlock = BufHdrGetBlock(bufHdr);
-			}
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								io_first_block + j,
+								relpath(smgr->smgr_rlocator, forknum))));
+		}
 
-			/* check for garbage data */
-			if (!PageIsVerifiedExtended((Page) bufBlock, io_first_block + j,
-										PIV_LOG_WARNING | PIV_REPORT_STAT))
-			{
-				if ((operation->flags & READ_BUFFERS_ZERO_ON_ERROR) || zero_damaged_pages)
-				{
-					ereport(WARNING,
-							(errcode(ERRCODE_DATA_CORRUPTED),
-							 errmsg("invalid page in block %u of relation %s; zeroing out page",
-									io_first_block + j,
-									relpath(operation->smgr->smgr_rlocator, forknum))));
-					memset(bufBlock, 0, BLCKSZ);
-				}
-				else
-					ereport(ERROR,
-							(errcode(ERRCODE_DATA_CORRUPTED),
-							 errmsg("invalid page in block %u of relation %s",
-									io_first_block + j,
-									relpath(operation->smgr->smgr_rlocator, forknum))));
-			}
+		/* Terminate I/O and set BM_VALID. */
+		if (is_temp)
+		{
+			uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
 
-			/* Terminate I/O and set BM_VALID. */
-			if (persistence == RELPERSISTENCE_TEMP)
-			{
-				uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+			buf_state |= BM_VALID;
+			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+		}
+		else
+		{
+			/* Set BM_VALID, terminate IO, and wake up any waiters */
+			TerminateBufferIO(bufHdr, false, BM_VALID, true);
+		}
 
-				buf_state |= BM_VALID;
-				pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
-			}
-			else
-			{
-				/* Set BM_VALID, terminate IO, and wake up any waiters */
-				TerminateBufferIO(bufHdr, false, BM_VALID, true);
-			}
+		/* Report I/Os as completing individually. */
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forknum, io_first_block + j,
+										  smgr->smgr_rlocator.locator.spcOid,
+										  smgr->smgr_rlocator.locator.dbOid,
+										  smgr->smgr_rlocator.locator.relNumber,
+										  smgr->smgr_rlocator.backend,
+										  false);
+	}
 
-			/* Report I/Os as completing individually. */
-			TRACE_POSTGRESQL_BUFFER_READ_DONE(forknum, io_first_block + j,
-											  operation->smgr->smgr_rlocator.locator.spcOid,
-											  operation->smgr->smgr_rlocator.locator.dbOid,
-											  operation->smgr->smgr_rlocator.locator.relNumber,
-											  operation->smgr->smgr_rlocator.backend,
-											  false);
+	VacuumPageMiss += io_buffers_len;
+	if (VacuumCostActive)
+		VacuumCostBalance += VacuumCostPageMiss * io_buffers_len;
+}
+
+/*
+ * Try to start an asynchronous read of the leading buffers of a read
+ * operation.  Returns the number of buffers covered by the read, or 0 if none
+ * could be started and WaitReadBuffers() should read them synchronously.
+ */
+static int
+StartReadBuffersAsync(ReadBuffersOperation *operation)
+{
+	Buffer	   *buffers = operation->buffers;
+	void	   *io_pages[MAX_IO_COMBINE_LIMIT];
+	AsyncReadBuffers *ar;
+	int			handle;
+	int			nclaimed;
+	BlockNumber nstarted;
+
+	/* Local buffers are always read synchronously. */
+	if (BufferIsLocal(buffers[0]))
+		return 0;
+
+	handle = pgaio_acquire();
+	if (handle < 0)
+		return 0;
+
+	/*
+	 * Claim as many leading buffers as we can without waiting.  If another
+	 * backend is already reading the first one, let WaitReadBuffers() wait
+	 * for it in the usual way.
+	 */
+	for (nclaimed = 0; nclaimed < operation->io_buffers_len; nclaimed++)
+	{
+		BufferDesc *buf_hdr = GetBufferDescriptor(buffers[nclaimed] - 1);
+
+		/* Leave blocks in the secondary buffer cache to WaitReadBuffers(). */
+		if (SecondaryCacheEnabled() && SecondaryCacheContains(&buf_hdr->tag))
+			break;
+		if (!StartBufferIO(buf_hdr, true, true))
+			break;
+		io_pages[nclaimed] = BufferGetBlock(buffers[nclaimed]);
+	}
+	if (nclaimed == 0)
+	{
+		pgaio_release(handle);
+		return 0;
+	}
+
+	if (AsyncReads == NULL)
+		AsyncReads = MemoryContextAllocZero(TopMemoryContext,
+											sizeof(AsyncReadBuffers) *
+											PGAIO_MAX_IN_FLIGHT);
+
+	/*
+	 * Register the read before submitting it, so that AbortBufferIO() can
+	 * clean up the handle if smgrstartreadv() fails.
+	 */
+	ar = &AsyncReads[handle];
+	Assert(ar->id == 0);
+	ar->id = NextAsyncReadId++;
+	ar->owner = CurrentResourceOwner;
+	ar->smgr = operation->smgr;
+	ar->forknum = operation->forknum;
+	ar->blocknum = operation->blocknum;
+	ar->flags = operation->flags;
+	ar->nblocks = nclaimed;
+	ar->io_context = IOContextForStrategy(operation->strategy);
+	memcpy(ar->buffers, buffers, sizeof(Buffer) * nclaimed);
+	NumAsyncReads++;
+
+	ar->io_start = pgstat_prepare_io_time(track_io_timing);
+	nstarted = smgrstartreadv(operation->smgr, operation->forknum,
+							  operation->blocknum, io_pages, nclaimed,
+							  handle);
+
+	/* Give back any buffers the read doesn't cover, waking up waiters. */
+	for (int i = nstarted; i < nclaimed; i++)
+		TerminateBufferIO(GetBufferDescriptor(buffers[i] - 1), false, 0, true);
+
+	if (nstarted == 0)
+	{
+		ar->id = 0;
+		NumAsyncReads--;
+		pgaio_release(handle);
+		return 0;
+	}
+
+	ar->nblocks = nstarted;
+	operation->io_handle = handle;
+	operation->io_async_id = ar->id;
+
+	return nstarted;
+}
+
+/*
+ * Find the handle of the asynchronous read that covers buffer, if any.
+ */
+static int
+FindAsyncRead(Buffer buffer)
+{
+	for (int handle = 0; handle < PGAIO_MAX_IN_FLIGHT; handle++)
+	{
+		AsyncReadBuffers *ar = &AsyncReads[handle];
+
+		if (ar->id == 0)
+			continue;
+		for (int i = 0; i < ar->nblocks; i++)
+		{
+			if (ar->buffers[i] == buffer)
+				return handle;
 		}
+	}
 
-		VacuumPageMiss += io_buffers_len;
-		if (VacuumCostActive)
-			VacuumCostBalance += VacuumCostPageMiss * io_buffers_len;
+	return -1;
+}
+
+/*
+ * Wait for an asynchronous read to finish, then verify its pages and
+ * terminate the I/O.  Short or failed reads are retried synchronously, which
+ * reports errors in the usual way.
+ */
+static void
+CompleteReadBuffersAsync(int handle)
+{
+	AsyncReadBuffers *ar = &AsyncReads[handle];
+	ResourceOwner save_owner = CurrentResourceOwner;
+	Buffer		io_buffers[MAX_IO_COMBINE_LIMIT];
+	void	   *io_pages[MAX_IO_COMBINE_LIMIT];
+	SMgrRelation smgr = ar->smgr;
+	ForkNumber	forknum = ar->forknum;
+	BlockNumber blocknum = ar->blocknum;
+	int			flags = ar->flags;
+	int			nblocks = ar->nblocks;
+	ssize_t		result;
+
+	result = pgaio_wait(handle);
+	pgstat_count_io_op_time(IOOBJECT_RELATION, ar->io_context, IOOP_READ,
+							ar->io_start, nblocks);
+
+	/*
+	 * Unregister before doing anything that could fail: from now on the
+	 * buffers are just ordinary ones with I/O in progress.
+	 */
+	memcpy(io_buffers, ar->buffers, sizeof(Buffer) * nblocks);
+	ar->id = 0;
+	NumAsyncReads--;
+
+	if (result != (ssize_t) nblocks * BLCKSZ)
+	{
+		for (int i = 0; i < nblocks; i++)
+			io_pages[i] = BufferGetBlock(io_buffers[i]);
+		smgrreadv(smgr, forknum, blocknum, io_pages, nblocks);
 	}
+
+	/* The buffer I/Os are registered with the owner that started them. */
+	CurrentResourceOwner = ar->owner;
+	CompleteReadBuffersIO(smgr, forknum, flags, false,
+						  io_buffers, blocknum, nblocks);
+	CurrentResourceOwner = save_owner;
 }
 
 /*
@@ -1569,6 +1827,26 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
+	/*
+	 * Most lookups are hits on hot pages, so first look the tag up without
+	 * touching the mapping lock at all.  If that finds a buffer still holding
+	 * our page we are done; otherwise repeat the lookup the regular way.
+	 */
+	existing_buf_id = BufTableLookupOptimistic(&newTag, newHash);
+	if (existing_buf_id >= 0)
+	{
+		BufferDesc *buf;
+		bool		valid;
+
+		buf = GetBufferDescriptor(existing_buf_id);
+		if (PinBufferIfTagMatches(buf, &newTag, strategy, &valid))
+		{
+			/* see below about !valid */
+			*foundPtr = valid;
+			return buf;
+		}
+	}
+
 	/* see if the block is in the buffer pool already */
 	LWLockAcquire(newPartitionLock, LW_SHARED);
 	existing_buf_id = BufTableLookup(&newTag, newHash);
@@ -1693,6 +1971,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	if (relpersistence == RELPERSISTENCE_PERMANENT || forkNum == INIT_FORKNUM)
 		victim_buf_state |= BM_PERMANENT;
 
+	StrategyTagAssigned(victim_buf_hdr, newHash);
+
 	UnlockBufHdr(victim_buf_hdr, victim_buf_state);
 
 	LWLockRelease(newPartitionLock);
@@ -1790,6 +2070,7 @@ retry:
 	 * linear scans of the buffer array don't think the buffer is valid.
 	 */
 	oldFlags = buf_state & BUF_FLAG_MASK;
+	StrategyTagRemoved(buf, oldHash, false);
 	ClearBufferTag(&buf->tag);
 	buf_state &= ~(BUF_FLAG_MASK | BUF_USAGECOUNT_MASK);
 	UnlockBufHdr(buf, buf_state);
@@ -1870,6 +2151,7 @@ InvalidateVictimBuffer(BufferDesc *buf_hdr)
 	 * cheaper pre-check for several linear scans of shared buffers use the
 	 * tag (see e.g. FlushDatabaseBuffers()).
 	 */
+	StrategyTagRemoved(buf_hdr, hash, true);
 	ClearBufferTag(&buf_hdr->tag);
 	buf_state &= ~(BUF_FLAG_MASK | BUF_USAGECOUNT_MASK);
 	UnlockBufHdr(buf_hdr, buf_state);
@@ -1895,6 +2177,7 @@ GetVictimBuffer(BufferAccessStrategy strategy, IOContext io_context)
 	Buffer		buf;
 	uint32		buf_state;
 	bool		from_ring;
+	bool		stored;
 
 	/*
 	 * Ensure, while the spinlock's not yet held, that there's a free refcount
@@ -2018,13 +2301,26 @@ again:
 						   from_ring ? IOOP_REUSE : IOOP_EVICT);
 	}
 
+	/*
+	 * Keep a copy of the page in the secondary buffer cache, if there is one.
+	 * Pages cycling through a strategy ring aren't worth the space.  This has
+	 * to happen while the buffer still holds the block, so that nobody can
+	 * read the block from the relation file in between.
+	 */
+	stored = false;
+	if (SecondaryCacheEnabled() && strategy == NULL && (buf_state & BM_VALID))
+		stored = SecondaryCacheStore(&buf_hdr->tag, BufHdrGetBlock(buf_hdr));
+
 	/*
 	 * If the buffer has an entry in the buffer mapping table, delete it. This
 	 * can fail because another backend could have pinned or dirtied the
-	 * buffer.
+	 * buffer.  The copy just stored must then go again, as the block stays
+	 * in shared buffers.
 	 */
 	if ((buf_state & BM_TAG_VALID) && !InvalidateVictimBuffer(buf_hdr))
 	{
+		if (stored)
+			SecondaryCacheForget(&buf_hdr->tag);
 		UnpinBuffer(buf_hdr);
 		goto again;
 	}
@@ -2337,6 +2633,8 @@ ExtendBufferedRelShared(BufferManagerRelation bmr,
 			if (bmr.relpersistence == RELPERSISTENCE_PERMANENT || fork == INIT_FORKNUM)
 				buf_state |= BM_PERMANENT;
 
+			StrategyTagAssigned(victim_buf_hdr, hash);
+
 			UnlockBufHdr(victim_buf_hdr, buf_state);
 
 			LWLockRelease(partition_lock);
@@ -2680,6 +2978,95 @@ PinBuffer(BufferDesc *buf, BufferAccessStrategy strategy)
 	return result;
 }
 
+/*
+ * PinBufferIfTagMatches -- pin buffer only if it holds the given page.
+ *
+ * This is PinBuffer() for a buffer found without holding the buffer mapping
+ * lock, which therefore may have been evicted and reused meanwhile.  We must
+ * not pin a buffer that has no valid tag at all, since whoever is
+ * retagging it expects to hold the only pin, so the pin is taken with a CAS
+ * that requires BM_TAG_VALID.  Once pinned, the tag cannot change under us,
+ * so we can recheck it; if it is no longer ours we drop the pin again.
+ *
+ * Returns true with *valid set as PinBuffer() would return, or false if we
+ * did not end up holding a pin on the requested page.
+ *
+ * Note that ResourceOwnerEnlarge() and ReservePrivateRefCountEntry()
+ * must have been done already.
+ */
+static bool
+PinBufferIfTagMatches(BufferDesc *buf, const BufferTag *tag,
+					  BufferAccessStrategy strategy, bool *valid)
+{
+	Buffer		b = BufferDescriptorGetBuffer(buf);
+	PrivateRefCountEntry *ref;
+	uint32		buf_state;
+	uint32		old_buf_state;
+
+	Assert(!BufferIsLocal(b));
+	Assert(ReservedRefCountEntry != NULL);
+
+	/* If we already hold a pin, the tag is stable and PinBuffer will do */
+	if (GetPrivateRefCountEntry(b, false) != NULL)
+	{
+		if (!BufferTagsEqual(&buf->tag, tag))
+			return false;
+		*valid = PinBuffer(buf, strategy);
+		return true;
+	}
+
+	old_buf_state = pg_atomic_read_u32(&buf->state);
+	for (;;)
+	{
+		if (old_buf_state & BM_LOCKED)
+			old_buf_state = WaitBufHdrUnlocked(buf);
+
+		/* cheap unlocked precheck, so we rarely pin the wrong buffer */
+		if (!(old_buf_state & BM_TAG_VALID) ||
+			!BufferTagsEqual(&buf->tag, tag))
+			return false;
+
+		buf_state = old_buf_state + BUF_REFCOUNT_ONE;
+
+		/* usage count handling must match PinBuffer */
+		if (strategy == NULL)
+		{
+			if (BUF_STATE_GET_USAGECOUNT(buf_state) < BM_MAX_USAGE_COUNT)
+				buf_state += BUF_USAGECOUNT_ONE;
+		}
+		else
+		{
+			if (BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+				buf_state += BUF_USAGECOUNT_ONE;
+		}
+
+		if (pg_atomic_compare_exchange_u32(&buf->state, &old_buf_state,
+										   buf_state))
+			break;
+	}
+
+	ref = NewPrivateRefCountEntry(b);
+	ref->refcount++;
+	ResourceOwnerRememberBuffer(CurrentResourceOwner, b);
+	VALGRIND_MAKE_MEM_DEFINED(BufHdrGetBlock(buf), BLCKSZ);
+
+	/*
+	 * The buffer may have been evicted and given a new tag between the
+	 * precheck and the CAS.  Now that we hold a pin it can't change again.
+	 */
+	if (!BufferTagsEqual(&buf->tag, tag))
+	{
+		UnpinBuffer(buf);
+		/* restore what the caller had set up for its next pin */
+		ResourceOwnerEnlarge(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
+		return false;
+	}
+
+	*valid = (buf_state & BM_VALID) != 0;
+	return true;
+}
+
 /*
  * PinBuffer_Locked -- as above, but caller already locked the buffer header.
  * The spinlock is released before return.
@@ -3040,43 +3427,77 @@ BufferSync(int flags)
 		BufferDesc *bufHdr = NULL;
 		CkptTsStatus *ts_stat = (CkptTsStatus *)
 			DatumGetPointer(binaryheap_first(ts_heap));
+		int			buf_ids[MAX_IO_COMBINE_LIMIT];
+		int			results[MAX_IO_COMBINE_LIMIT];
+		int			nbuf_ids;
+		int			nprocessed = 1;
 
 		buf_id = CkptBufferIds[ts_stat->index].buf_id;
 		Assert(buf_id != -1);
 
 		bufHdr = GetBufferDescriptor(buf_id);
 
-		num_processed++;
-
 		/*
 		 * We don't need to acquire the lock here, because we're only looking
 		 * at a single bit. It's possible that someone else writes the buffer
 		 * and clears the flag right after we check, but that doesn't matter
-		 * since SyncOneBuffer will then do nothing.  However, there is a
+		 * since SyncBufferRun will then do nothing.  However, there is a
 		 * further race condition: it's conceivable that between the time we
-		 * examine the bit here and the time SyncOneBuffer acquires the lock,
+		 * examine the bit here and the time SyncBufferRun acquires the lock,
 		 * someone else not only wrote the buffer but replaced it with another
-		 * page and dirtied it.  In that improbable case, SyncOneBuffer will
+		 * page and dirtied it.  In that improbable case, SyncBufferRun will
 		 * write the buffer though we didn't need to.  It doesn't seem worth
 		 * guarding against this, though.
 		 */
 		if (pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED)
 		{
-			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
+			/*
+			 * Thanks to the sort, buffers holding the following blocks of the
+			 * same relation fork come next in this tablespace.  Collect them
+			 * so that they can be written with a single vectored write.
+			 * SyncBufferRun rechecks their tags under the header lock.
+			 */
+			buf_ids[0] = buf_id;
+			nbuf_ids = 1;
+			while (nbuf_ids < io_combine_limit &&
+				   ts_stat->num_scanned + nbuf_ids < ts_stat->num_to_scan)
 			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				PendingCheckpointerStats.buffers_written++;
-				num_written++;
+				CkptSortItem *prev = &CkptBufferIds[ts_stat->index + nbuf_ids - 1];
+				CkptSortItem *next = prev + 1;
+
+				if (next->relNumber != prev->relNumber ||
+					next->forkNum != prev->forkNum ||
+					next->blockNum != prev->blockNum + 1 ||
+					!(pg_atomic_read_u32(&GetBufferDescriptor(next->buf_id)->state) &
+					  BM_CHECKPOINT_NEEDED))
+					break;
+
+				buf_ids[nbuf_ids++] = next->buf_id;
+			}
+
+			nprocessed = SyncBufferRun(buf_ids, nbuf_ids, false, &wb_context,
+									   results);
+
+			for (i = 0; i < nprocessed; i++)
+			{
+				if (results[i] & BUF_WRITTEN)
+				{
+					TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_ids[i]);
+					PendingCheckpointerStats.buffers_written++;
+					num_written++;
+				}
 			}
 		}
 
+		num_processed += nprocessed;
+
 		/*
 		 * Measure progress independent of actually having to flush the buffer
 		 * - otherwise writing become unbalanced.
 		 */
-		ts_stat->progress += ts_stat->progress_slice;
-		ts_stat->num_scanned++;
-		ts_stat->index++;
+		ts_stat->progress += ts_stat->progress_slice * nprocessed;
+		ts_stat->num_scanned += nprocessed;
+		ts_stat->index += nprocessed;
 
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
@@ -3348,29 +3769,49 @@ BgBufferSync(WritebackContext *wb_context)
 	reusable_buffers = reusable_buffers_est;
 
 	/* Execute the LRU scan */
-	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
+	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est &&
+		   num_written < bgwriter_lru_maxpages)
 	{
-		int			sync_state = SyncOneBuffer(next_to_clean, true,
-											   wb_context);
+		int			buf_ids[MAX_IO_COMBINE_LIMIT];
+		int			results[MAX_IO_COMBINE_LIMIT];
+		int			nbuf_ids;
+		int			nprocessed;
 
-		if (++next_to_clean >= NBuffers)
-		{
-			next_to_clean = 0;
-			next_passes++;
-		}
-		num_to_scan--;
+		/*
+		 * Offer the following buffers along with this one, since buffers
+		 * filled by a sequential scan often hold consecutive blocks and can
+		 * then be written together.  Stay within the remaining scan and write
+		 * budgets, and don't wrap around.
+		 */
+		nbuf_ids = Min(io_combine_limit, num_to_scan);
+		nbuf_ids = Min(nbuf_ids, NBuffers - next_to_clean);
+		nbuf_ids = Min(nbuf_ids, bgwriter_lru_maxpages - num_written);
+		for (int i = 0; i < nbuf_ids; i++)
+			buf_ids[i] = next_to_clean + i;
+
+		nprocessed = SyncBufferRun(buf_ids, nbuf_ids, true, wb_context,
+								   results);
 
-		if (sync_state & BUF_WRITTEN)
+		for (int i = 0; i < nprocessed; i++)
 		{
-			reusable_buffers++;
-			if (++num_written >= bgwriter_lru_maxpages)
+			int			sync_state = results[i];
+
+			if (++next_to_clean >= NBuffers)
 			{
-				PendingBgWriterStats.maxwritten_clean++;
-				break;
+				next_to_clean = 0;
+				next_passes++;
+			}
+			num_to_scan--;
+
+			if (sync_state & BUF_WRITTEN)
+			{
+				reusable_buffers++;
+				if (++num_written >= bgwriter_lru_maxpages)
+					PendingBgWriterStats.maxwritten_clean++;
 			}
+			else if (sync_state & BUF_REUSABLE)
+				reusable_buffers++;
 		}
-		else if (sync_state & BUF_REUSABLE)
-			reusable_buffers++;
 	}
 
 	PendingBgWriterStats.buf_written_clean += num_written;
@@ -3448,8 +3889,7 @@ SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
 	 */
 	buf_state = LockBufHdr(bufHdr);
 
-	if (BUF_STATE_GET_REFCOUNT(buf_state) == 0 &&
-		BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+	if (StrategyBufferIsCandidate(bufHdr, buf_state))
 	{
 		result |= BUF_REUSABLE;
 	}
@@ -3491,6 +3931,154 @@ SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * SyncBufferRun -- process a run of buffers during syncing.
+ *
+ * buf_ids[0] is processed just like SyncOneBuffer() would.  If it gets
+ * written, each following entry of buf_ids[] whose buffer holds the next
+ * block of the same relation fork, and needs writing, is written along with
+ * it in a single vectored write.  The run ends at the first buffer that
+ * doesn't qualify, or whose content lock or I/O can't be acquired without
+ * waiting; we must not wait for those while holding locks on the earlier
+ * buffers of the run, since their lockers might be waiting for us.
+ *
+ * Returns the number of entries of buf_ids[] processed, at least 1, and
+ * stores the corresponding SyncOneBuffer() result bits in results[].  The
+ * caller should offer the first unprocessed entry again later.
+ */
+static int
+SyncBufferRun(const int *buf_ids, int nbuf_ids, bool skip_recently_used,
+			  WritebackContext *wb_context, int *results)
+{
+	BufferDesc *run[MAX_IO_COMBINE_LIMIT];
+	BufferDesc *head;
+	RelFileLocator rlocator;
+	uint32		buf_state;
+	int			nrun;
+
+	Assert(nbuf_ids >= 1 && nbuf_ids <= MAX_IO_COMBINE_LIMIT);
+
+	if (nbuf_ids == 1)
+	{
+		results[0] = SyncOneBuffer(buf_ids[0], skip_recently_used,
+								   wb_context);
+		return 1;
+	}
+
+	/*
+	 * Check whether the first buffer needs writing, exactly as in
+	 * SyncOneBuffer().
+	 */
+	head = GetBufferDescriptor(buf_ids[0]);
+	results[0] = 0;
+
+	ReservePrivateRefCountEntry();
+	ResourceOwnerEnlarge(CurrentResourceOwner);
+
+	buf_state = LockBufHdr(head);
+
+	if (StrategyBufferIsCandidate(head, buf_state))
+	{
+		results[0] |= BUF_REUSABLE;
+	}
+	else if (skip_recently_used)
+	{
+		UnlockBufHdr(head, buf_state);
+		return 1;
+	}
+
+	if (!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+	{
+		UnlockBufHdr(head, buf_state);
+		return 1;
+	}
+
+	PinBuffer_Locked(head);
+	LWLockAcquire(BufferDescriptorGetContentLock(head), LW_SHARED);
+
+	results[0] |= BUF_WRITTEN;
+
+	if (!StartBufferIO(head, false, false))
+	{
+		/* Someone else flushed it already, see FlushBuffer() */
+		LWLockRelease(BufferDescriptorGetContentLock(head));
+		UnpinBuffer(head);
+		return 1;
+	}
+
+	/*
+	 * Extend the run with the following buffers.  Our pin on the head buffer
+	 * keeps its tag stable.
+	 */
+	rlocator = BufTagGetRelFileLocator(&head->tag);
+	run[0] = head;
+	for (nrun = 1; nrun < nbuf_ids; nrun++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(buf_ids[nrun]);
+		int			result = BUF_WRITTEN;
+
+		ReservePrivateRefCountEntry();
+		ResourceOwnerEnlarge(CurrentResourceOwner);
+
+		buf_state = LockBufHdr(bufHdr);
+
+		if (!BufTagMatchesRelFileLocator(&bufHdr->tag, &rlocator) ||
+			BufTagGetForkNum(&bufHdr->tag) != BufTagGetForkNum(&head->tag) ||
+			bufHdr->tag.blockNum != head->tag.blockNum + nrun ||
+			!(buf_state & BM_VALID) || !(buf_state & BM_DIRTY))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			break;
+		}
+
+		if (StrategyBufferIsCandidate(bufHdr, buf_state))
+		{
+			result |= BUF_REUSABLE;
+		}
+		else if (skip_recently_used)
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			break;
+		}
+
+		PinBuffer_Locked(bufHdr);
+
+		if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+									  LW_SHARED))
+		{
+			UnpinBuffer(bufHdr);
+			break;
+		}
+
+		if (!StartBufferIO(bufHdr, false, true))
+		{
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			UnpinBuffer(bufHdr);
+			break;
+		}
+
+		run[nrun] = bufHdr;
+		results[nrun] = result;
+	}
+
+	FlushBufferRun(run, nrun, IOCONTEXT_NORMAL);
+
+	for (int i = 0; i < nrun; i++)
+	{
+		BufferTag	tag;
+
+		LWLockRelease(BufferDescriptorGetContentLock(run[i]));
+
+		tag = run[i]->tag;
+
+		UnpinBuffer(run[i]);
+
+		ScheduleBufferTagForWriteback(wb_context, IOCONTEXT_NORMAL, &tag);
+	}
+
+	return nrun;
+}
+
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
  *
@@ -3854,6 +4442,121 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln, IOObject io_object,
 	error_context_stack = errcallback.previous;
 }
 
+/*
+ * FlushBufferRun
+ *		Physically write out a run of shared buffers holding consecutive
+ *		blocks of one relation fork, with a single vectored write.
+ *
+ * This is FlushBuffer() for several buffers at once, except that the caller
+ * must already have started I/O on all of them (StartBufferIO()), in addition
+ * to holding a pin and share lock on each.  WAL is flushed just once, up to
+ * the highest LSN of any of the pages.
+ */
+static void
+FlushBufferRun(BufferDesc **bufs, int nbufs, IOContext io_context)
+{
+	static char *pageCopies = NULL;
+	const void *pages[MAX_IO_COMBINE_LIMIT];
+	XLogRecPtr	max_recptr = InvalidXLogRecPtr;
+	ErrorContextCallback errcallback;
+	instr_time	io_start;
+	SMgrRelation reln;
+	ForkNumber	forknum = BufTagGetForkNum(&bufs[0]->tag);
+	BlockNumber blocknum = bufs[0]->tag.blockNum;
+
+	Assert(nbufs >= 1 && nbufs <= MAX_IO_COMBINE_LIMIT);
+
+	/*
+	 * Setup error traceback support for ereport().  Report the first buffer;
+	 * the others belong to the same relation.
+	 */
+	errcallback.callback = shared_buffer_write_error_callback;
+	errcallback.arg = (void *) bufs[0];
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	reln = smgropen(BufTagGetRelFileLocator(&bufs[0]->tag), INVALID_PROC_NUMBER);
+
+	for (int i = 0; i < nbufs; i++)
+	{
+		BufferDesc *buf = bufs[i];
+		uint32		buf_state;
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_START(forknum,
+											buf->tag.blockNum,
+											reln->smgr_rlocator.locator.spcOid,
+											reln->smgr_rlocator.locator.dbOid,
+											reln->smgr_rlocator.locator.relNumber);
+
+		/* See FlushBuffer() */
+		buf_state = LockBufHdr(buf);
+		if (buf_state & BM_PERMANENT)
+			max_recptr = Max(max_recptr, BufferGetLSN(buf));
+		buf_state &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(buf, buf_state);
+	}
+
+	/*
+	 * Force XLOG flush up to the highest LSN of the permanent buffers, see
+	 * FlushBuffer().
+	 */
+	if (!XLogRecPtrIsInvalid(max_recptr))
+		XLogFlush(max_recptr);
+
+	/*
+	 * Update page checksums if desired, using private copies as in
+	 * PageSetChecksumCopy().  That only has room for one page, so we keep our
+	 * own space for a full run.
+	 */
+	for (int i = 0; i < nbufs; i++)
+	{
+		Page		page = (Page) BufHdrGetBlock(bufs[i]);
+
+		if (!PageIsNew(page) && DataChecksumsEnabled())
+		{
+			char	   *copy;
+
+			if (pageCopies == NULL)
+				pageCopies = MemoryContextAllocAligned(TopMemoryContext,
+													   MAX_IO_COMBINE_LIMIT * BLCKSZ,
+													   PG_IO_ALIGN_SIZE,
+													   0);
+
+			copy = pageCopies + i * BLCKSZ;
+			memcpy(copy, page, BLCKSZ);
+			PageSetChecksumInplace((Page) copy, blocknum + i);
+			pages[i] = copy;
+		}
+		else
+			pages[i] = page;
+	}
+
+	io_start = pgstat_prepare_io_time(track_io_timing);
+
+	smgrwritev(reln, forknum, blocknum, pages, nbufs, false);
+
+	pgstat_count_io_op_time(IOOBJECT_RELATION, io_context,
+							IOOP_WRITE, io_start, nbufs);
+
+	pgBufferUsage.shared_blks_written += nbufs;
+
+	for (int i = 0; i < nbufs; i++)
+	{
+		BufferDesc *buf = bufs[i];
+
+		TerminateBufferIO(buf, true, 0, true);
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(forknum,
+										   buf->tag.blockNum,
+										   reln->smgr_rlocator.locator.spcOid,
+										   reln->smgr_rlocator.locator.dbOid,
+										   reln->smgr_rlocator.locator.relNumber);
+	}
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
 /*
  * RelationGetNumberOfBlocksInFork
  *		Determines the current number of pages in the specified relation fork.
@@ -3988,7 +4691,7 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 		if (rlocator.backend == MyProcNumber)
 		{
 			for (j = 0; j < nforks; j++)
-				DropRelationLocalBuffers(rlocator.locator, forkNum[j],
+				DropRelationLocalBuffers(smgr_reln, forkNum[j],
 										 firstDelBlock[j]);
 		}
 		return;
@@ -4083,6 +4786,10 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 		if (j >= nforks)
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	if (SecondaryCacheEnabled())
+		SecondaryCacheDropRelationBuffers(rlocator.locator, forkNum, nforks,
+										  NULL, firstDelBlock);
 }
 
 /* ---------------------------------------------------------------------
@@ -4116,7 +4823,7 @@ DropRelationsAllBuffers(SMgrRelation *smgr_reln, int nlocators)
 		if (RelFileLocatorBackendIsTemp(smgr_reln[i]->smgr_rlocator))
 		{
 			if (smgr_reln[i]->smgr_rlocator.backend == MyProcNumber)
-				DropRelationAllLocalBuffers(smgr_reln[i]->smgr_rlocator.locator);
+				DropRelationAllLocalBuffers(smgr_reln[i]);
 		}
 		else
 			rels[n++] = smgr_reln[i];
@@ -4251,6 +4958,9 @@ DropRelationsAllBuffers(SMgrRelation *smgr_reln, int nlocators)
 			UnlockBufHdr(bufHdr, buf_state);
 	}
 
+	if (SecondaryCacheEnabled())
+		SecondaryCacheDropRelationsAllBuffers(locators, n);
+
 	pfree(locators);
 	pfree(rels);
 }
@@ -4312,6 +5022,10 @@ FindAndDropRelationBuffers(RelFileLocator rlocator, ForkNumber forkNum,
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	if (SecondaryCacheEnabled())
+		SecondaryCacheDropRelationBuffers(rlocator, &forkNum, 1,
+										  &nForkBlock, &firstDelBlock);
 }
 
 /* ---------------------------------------------------------------------
@@ -4353,6 +5067,9 @@ DropDatabaseBuffers(Oid dbid)
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	if (SecondaryCacheEnabled())
+		SecondaryCacheDropDatabaseBuffers(dbid);
 }
 
 /* -----------------------------------------------------------------
@@ -5497,6 +6214,19 @@ StartBufferIO(BufferDesc *buf, bool forInput, bool nowait)
 		UnlockBufHdr(buf, buf_state);
 		if (nowait)
 			return false;
+
+		/* If it's our own asynchronous read, finish it instead of waiting. */
+		if (NumAsyncReads > 0)
+		{
+			int			handle = FindAsyncRead(BufferDescriptorGetBuffer(buf));
+
+			if (handle >= 0)
+			{
+				CompleteReadBuffersAsync(handle);
+				continue;
+			}
+		}
+
 		WaitIO(buf);
 	}
 
@@ -5581,6 +6311,22 @@ AbortBufferIO(Buffer buffer)
 	BufferDesc *buf_hdr = GetBufferDescriptor(buffer - 1);
 	uint32		buf_state;
 
+	/*
+	 * If the kernel may still be reading into this buffer, wait for that to
+	 * finish before anyone else can use it.  The result doesn't matter.
+	 */
+	if (NumAsyncReads > 0)
+	{
+		int			handle = FindAsyncRead(buffer);
+
+		if (handle >= 0)
+		{
+			(void) pgaio_wait(handle);
+			AsyncReads[handle].id = 0;
+			NumAsyncReads--;
+		}
+	}
+
 	buf_state = LockBufHdr(buf_hdr);
 	Assert(buf_state & (BM_IO_IN_PROGRESS | BM_TAG_VALID));
 
@@ -6065,3 +6811,76 @@ EvictUnpinnedBuffer(Buffer buf)
 
 	return result;
 }
+
+/*
+ * BufferPoolResize -- apply a change of active_shared_buffers
+ *
+ * Called regularly by the background writer.  Growing the pool just makes
+ * more buffers available for replacement.  To shrink it, we stop handing out
+ * the buffers above the new limit, then evict whatever pages they still
+ * hold, writing them out if they are dirty, and finally give their memory
+ * back to the operating system.  Pinned buffers can't be evicted yet, so
+ * this returns false if it needs to be called again later, true when the
+ * pool has reached its configured size.
+ *
+ * Unlike in general use of EvictUnpinnedBuffer(), an evicted buffer can't be
+ * taken over by some other page behind our back, since buffers above the
+ * limit are never chosen for replacement.
+ */
+bool
+BufferPoolResize(void)
+{
+	/* start of the part of the pool known to be empty and released */
+	static int	released_from = -1;
+	int			active;
+	bool		done = true;
+
+	if (released_from < 0)
+		released_from = NBuffers;
+
+	active = StrategySetActiveBuffers(active_shared_buffers >= 0 ?
+									  active_shared_buffers : NBuffers);
+
+	/* the buffers above the limit are still all empty after growing */
+	released_from = Max(released_from, active);
+	if (released_from == active)
+		return true;
+
+	for (int i = active; i < released_from; i++)
+	{
+		BufferDesc *desc = GetBufferDescriptor(i);
+		uint32		buf_state;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buf_state = LockBufHdr(desc);
+		if (BUF_STATE_GET_REFCOUNT(buf_state) != 0)
+		{
+			/* in use, or chosen for replacement just before the limit moved */
+			UnlockBufHdr(desc, buf_state);
+			done = false;
+		}
+		else if (buf_state & BM_VALID)
+		{
+			UnlockBufHdr(desc, buf_state);
+			if (!EvictUnpinnedBuffer(BufferDescriptorGetBuffer(desc)))
+				done = false;
+		}
+		else if (buf_state & BM_TAG_VALID)
+		{
+			/* a failed read left the tag behind; just drop it */
+			InvalidateBuffer(desc); /* releases spinlock */
+		}
+		else
+			UnlockBufHdr(desc, buf_state);
+	}
+
+	if (!done)
+		return false;
+
+	ShmemRelease(BufferBlocks + (Size) active * BLCKSZ,
+				 (Size) (released_from - active) * BLCKSZ);
+	released_from = active;
+
+	return true;
+}
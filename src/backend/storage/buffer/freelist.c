@@ -17,12 +17,115 @@
 
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "port/pg_numa.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
+#include "storage/pg_shmem.h"
 #include "storage/proc.h"
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/*
+ * The clock sweep is split into partitions, each with its own clock hand, so
+ * that backends allocating buffers concurrently don't all contend on a single
+ * cache line.  Each partition owns every num_partitions'th chunk of
+ * CLOCK_SWEEP_CHUNK_SIZE consecutive buffers, which keeps runs of buffers
+ * filled by a single backend adjacent.  Small buffer pools get just one
+ * partition, which behaves exactly like a single clock hand.
+ *
+ * When active_shared_buffers leaves part of the buffer pool unused, each
+ * partition only sweeps its chunks below that limit.  Since the chunks are
+ * handed out in rows, those are a prefix of the partition's positions, so
+ * only numBuffers needs adjusting.  Buffers above the limit are never handed
+ * out, however they are reached.
+ *
+ * With numa_placement = partition, each partition is assigned a NUMA node and
+ * its chunks are placed on that node.  Every chunk then needs its own kernel
+ * memory mapping entry, so the chunks are made larger to keep their number
+ * at most CLOCK_SWEEP_MAX_NUMA_CHUNKS.
+ */
+#define MAX_CLOCK_SWEEP_PARTITIONS		16
+#define CLOCK_SWEEP_CHUNK_SIZE			64
+#define CLOCK_SWEEP_PARTITION_MIN_SIZE	16384
+#define CLOCK_SWEEP_MAX_NUMA_CHUNKS		4096
+
+/*
+ * Each backend sweeps its home partition, chosen by its ProcNumber, as long
+ * as that partition's hand is not more than CLOCK_SWEEP_MAX_LEAD of a full
+ * pass ahead of the slowest partition's hand.  Otherwise it helps out in the
+ * slowest partition, so that all the partitions age at about the same rate
+ * and a lone backend still ages the whole buffer pool.  This is re-evaluated
+ * after every CLOCK_SWEEP_BALANCE_INTERVAL allocations.
+ */
+#define CLOCK_SWEEP_MAX_LEAD			0.05
+#define CLOCK_SWEEP_BALANCE_INTERVAL	64
+
+/*
+ * With buffer_replacement_policy = 2q, every buffer belongs to one of two
+ * classes.  A page that is read in is put on probation.  Further accesses
+ * while it is on probation are ignored, since they are usually correlated
+ * (several tuples on the same page, a nested loop revisiting it), and it is
+ * replaced when the clock hand next reaches it.  Only a page that is read in
+ * again soon after being replaced becomes protected, and is then managed by
+ * the ordinary clock sweep.  "Soon" is decided by a table of ghost entries,
+ * which remembers the hash codes of recently replaced tags and which class
+ * they were in.  A large scan therefore only ever cycles through the
+ * probationary buffers and cannot push out the protected working set.
+ *
+ * As in ARC, the number of probationary buffers the sweep aims to keep is
+ * adapted: a ghost hit on a page replaced from probation means probation is
+ * too short and grows the target, and a ghost hit on a protected page shrinks
+ * it.  The sweep replaces probationary buffers while there are more of them
+ * than the target, and otherwise runs the clock over the protected ones.
+ * The class counts and targets are kept per clock sweep partition.
+ *
+ * The ghost table is direct-mapped, so a new entry simply overwrites any
+ * older one in its slot.  Each entry holds the tag's hash code with the class
+ * in the low bits, which is never zero for a used slot.
+ */
+#define BUF_CLASS_NONE			0	/* no tag, or replacement under way */
+#define BUF_CLASS_PROBATION		1
+#define BUF_CLASS_PROTECTED		2
+
+#define GHOST_CLASS_MASK		0x3
+
+#define PROBATION_INITIAL_FRACTION	0.25
+#define PROBATION_MIN_FRACTION		0.03
+
+/*
+ * Per-partition clock sweep state.  Padded to a cache line so that the hands
+ * don't share one.
+ */
+typedef struct ClockSweepPartition
+{
+	/* Spinlock: protects completePasses and wraparound of the hand */
+	slock_t		lock;
+
+	/*
+	 * Clock sweep hand: index of the next buffer of this partition to
+	 * consider grabbing.  As with a single hand, the value is only ever
+	 * increased until the backend that passes numBuffers wraps it around.
+	 */
+	pg_atomic_uint32 nextVictimBuffer;
+
+	int			numBuffers;		/* Number of active buffers in this partition */
+	int			node;			/* NUMA node of its buffers, or -1 */
+	uint32		completePasses; /* Complete cycles of this partition */
+	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+
+	/* for buffer_replacement_policy = 2q */
+	pg_atomic_uint32 numProbation;	/* buffers in BUF_CLASS_PROBATION */
+	pg_atomic_uint32 probationTarget;	/* adaptive target for numProbation */
+	uint32		probationMin;	/* bounds for probationTarget */
+	uint32		probationMax;
+} ClockSweepPartition;
+
+typedef union ClockSweepPartitionPadded
+{
+	ClockSweepPartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} ClockSweepPartitionPadded;
+
 
 /*
  * The shared freelist control information.
@@ -32,12 +135,16 @@ typedef struct
 	/* Spinlock: protects the values below */
 	slock_t		buffer_strategy_lock;
 
-	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
-	 */
-	pg_atomic_uint32 nextVictimBuffer;
+	/* Layout of the clock sweep partitions, see ClockSweepLayout */
+	int			numPartitions;
+	int			chunkSize;
+	int			numNodes;
+
+	/* Number of ghost entries, if buffer_replacement_policy = 2q */
+	int			numGhosts;
+
+	/* Buffers with ids at or above this are unused, see active_shared_buffers */
+	pg_atomic_uint32 activeBuffers;
 
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
@@ -47,13 +154,6 @@ typedef struct
 	 * when the list is empty)
 	 */
 
-	/*
-	 * Statistics.  These counters should be wide enough that they can't
-	 * overflow during a single bgwriter cycle.
-	 */
-	uint32		completePasses; /* Complete cycles of the clock sweep */
-	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
-
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
 	 * StrategyNotifyBgWriter.
@@ -63,6 +163,18 @@ typedef struct
 
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
+static ClockSweepPartitionPadded *ClockSweepPartitions = NULL;
+
+/* Class of each buffer and ghost entries, for buffer_replacement_policy = 2q */
+static uint8 *BufferClasses = NULL;
+static pg_atomic_uint32 *GhostEntries = NULL;
+
+/* GUC variable */
+int			buffer_replacement_policy = BUFFER_REPLACEMENT_CLOCK;
+
+/* Partition this backend is currently sweeping, and when to reconsider */
+static int	MyClockSweepPartition = -1;
+static int	ClockSweepBalanceCountdown = 0;
 
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
@@ -98,15 +210,172 @@ static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 static void AddBufferToRing(BufferAccessStrategy strategy,
 							BufferDesc *buf);
 
+/*
+ * ClockSweepLayout - compute the layout of the clock sweep partitions
+ *
+ * Sets the number of partitions, the number of buffers in each of their
+ * chunks, and the number of NUMA nodes the partitions are spread over (0 if
+ * they are not).  The result depends only on settings fixed at server start,
+ * so it is the same in every process.
+ */
+static void
+ClockSweepLayout(int *npartitions, int *chunk_size, int *nnodes)
+{
+	const int  *nodes;
+	int			n = NBuffers / CLOCK_SWEEP_PARTITION_MIN_SIZE;
+
+	*npartitions = Max(1, Min(n, MAX_CLOCK_SWEEP_PARTITIONS));
+	*chunk_size = CLOCK_SWEEP_CHUNK_SIZE;
+	*nnodes = 0;
+
+	if (numa_placement != NUMA_PLACEMENT_PARTITION)
+		return;
+
+	/*
+	 * Give every node the same number of partitions, if the buffer pool is
+	 * big enough for each node to get at least one.
+	 */
+	n = ShmemNumaNodes(&nodes);
+	if (n < 2 || NBuffers / n < CLOCK_SWEEP_PARTITION_MIN_SIZE)
+		return;
+
+	*nnodes = n;
+	*npartitions = Max(1, *npartitions / n) * n;
+	*chunk_size = TYPEALIGN(CLOCK_SWEEP_CHUNK_SIZE,
+							(NBuffers + CLOCK_SWEEP_MAX_NUMA_CHUNKS - 1) /
+							CLOCK_SWEEP_MAX_NUMA_CHUNKS);
+}
+
+/*
+ * ClockSweepPartitionSize - number of positions of a partition that map to
+ * buffer ids below nbuffers
+ *
+ * Whole rows of chunks are shared out evenly, and the partial last row is
+ * handed out in partition order.
+ */
+static int
+ClockSweepPartitionSize(int partition, int nbuffers)
+{
+	int			npartitions = StrategyControl->numPartitions;
+	int			chunk_size = StrategyControl->chunkSize;
+	int			rows = nbuffers / (npartitions * chunk_size);
+	int			extra = nbuffers % (npartitions * chunk_size) -
+		partition * chunk_size;
+
+	return rows * chunk_size + Max(0, Min(extra, chunk_size));
+}
+
+/*
+ * ClockSweepBufferId - map a position within a partition to a buffer id
+ */
+static inline int
+ClockSweepBufferId(int partition, uint32 pos)
+{
+	uint32		chunk_size = StrategyControl->chunkSize;
+	uint32		chunk = pos / chunk_size;
+
+	return (chunk * StrategyControl->numPartitions + partition) *
+		chunk_size + pos % chunk_size;
+}
+
+/*
+ * ClockSweepPartitionOf - return the partition owning a buffer
+ */
+static inline ClockSweepPartition *
+ClockSweepPartitionOf(int buf_id)
+{
+	int			chunk = buf_id / StrategyControl->chunkSize;
+
+	return &ClockSweepPartitions[chunk % StrategyControl->numPartitions].part;
+}
+
+/*
+ * ClockSweepChoosePartition - Helper routine for StrategyGetBuffer()
+ *
+ * Return the partition in which this backend should look for a victim.
+ *
+ * If the partitions are spread over NUMA nodes, the home partition is one
+ * whose buffers are on the node we're currently running on, so that the
+ * pages we read in are local to us.  The scheduler might move us, so this
+ * is reconsidered along with the balance between partitions.
+ */
+static int
+ClockSweepChoosePartition(void)
+{
+	int			npartitions = StrategyControl->numPartitions;
+	int			home;
+	int			slowest;
+	double		home_progress = 0;
+	double		slowest_progress = 0;
+
+	if (npartitions == 1)
+		return 0;
+
+	if (MyClockSweepPartition >= 0 && --ClockSweepBalanceCountdown > 0)
+		return MyClockSweepPartition;
+
+	home = (MyProcNumber != INVALID_PROC_NUMBER) ?
+		MyProcNumber % npartitions : 0;
+	if (StrategyControl->numNodes > 0)
+	{
+		int			node = pg_numa_current_node();
+		int			per_node = npartitions / StrategyControl->numNodes;
+
+		for (int i = 0; i < StrategyControl->numNodes; i++)
+		{
+			/* partition i + k * numNodes has the node of partition i */
+			if (ClockSweepPartitions[i].part.node == node)
+			{
+				home = i + StrategyControl->numNodes *
+					((MyProcNumber != INVALID_PROC_NUMBER) ?
+					 MyProcNumber % per_node : 0);
+				break;
+			}
+		}
+	}
+
+	/*
+	 * Compare the progress of the hands, measured in passes.  We read them
+	 * without locking, so the result may be a little stale, which is fine.
+	 */
+	slowest = home;
+	for (int i = 0; i < npartitions; i++)
+	{
+		ClockSweepPartition *part = &ClockSweepPartitions[i].part;
+		uint32		pos = pg_atomic_read_u32(&part->nextVictimBuffer);
+		double		progress;
+
+		progress = (double) part->completePasses +
+			(double) pos / part->numBuffers;
+		if (i == home)
+			home_progress = progress;
+		if (i == 0 || progress < slowest_progress)
+		{
+			slowest = i;
+			slowest_progress = progress;
+		}
+	}
+
+	if (home_progress - slowest_progress > CLOCK_SWEEP_MAX_LEAD)
+		MyClockSweepPartition = slowest;
+	else
+		MyClockSweepPartition = home;
+	ClockSweepBalanceCountdown = CLOCK_SWEEP_BALANCE_INTERVAL;
+
+	return MyClockSweepPartition;
+}
+
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the given partition's clock hand one buffer ahead of its current
+ * position and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(int partition)
 {
+	ClockSweepPartition *part = &ClockSweepPartitions[partition].part;
+	uint32		numBuffers = INT_ACCESS_ONCE(part->numBuffers);
 	uint32		victim;
 
 	/*
@@ -115,14 +384,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&part->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= numBuffers)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % numBuffers;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -148,19 +417,19 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&part->lock);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % numBuffers;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&part->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					part->completePasses++;
+				SpinLockRelease(&part->lock);
 			}
 		}
 	}
-	return victim;
+	return ClockSweepBufferId(partition, victim);
 }
 
 /*
@@ -197,7 +466,12 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 {
 	BufferDesc *buf;
 	int			bgwprocno;
+	int			partition;
+	int			partitions_left;
 	int			trycounter;
+	bool		first_candidate;
+	bool		use_2q;
+	int			skipsleft;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
 
 	*from_ring = false;
@@ -245,9 +519,11 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 	/*
 	 * We count buffer allocation requests so that the bgwriter can estimate
 	 * the rate of buffer consumption.  Note that buffers recycled by a
-	 * strategy object are intentionally not counted here.
+	 * strategy object are intentionally not counted here.  The count is kept
+	 * in the clock sweep partition we're about to use, to avoid contention.
 	 */
-	pg_atomic_fetch_add_u32(&StrategyControl->numBufferAllocs, 1);
+	partition = ClockSweepChoosePartition();
+	pg_atomic_fetch_add_u32(&ClockSweepPartitions[partition].part.numBufferAllocs, 1);
 
 	/*
 	 * First check, without acquiring the lock, whether there's buffers in the
@@ -296,11 +572,14 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 			 * use it; discard it and retry.  (This can only happen if VACUUM
 			 * put a valid buffer in the freelist and then someone else used
 			 * it before we got to it.  It's probably impossible altogether as
-			 * of 8.3, but we'd better check anyway.)
+			 * of 8.3, but we'd better check anyway.)  Buffers beyond the
+			 * active part of the pool are discarded too; they are put back
+			 * if it grows again.
 			 */
 			local_buf_state = LockBufHdr(buf);
 			if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0
-				&& BUF_STATE_GET_USAGECOUNT(local_buf_state) == 0)
+				&& BUF_STATE_GET_USAGECOUNT(local_buf_state) == 0
+				&& buf->buf_id < StrategyActiveBuffers())
 			{
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
@@ -311,25 +590,73 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
-	trycounter = NBuffers;
+	/*
+	 * Nothing on the freelist, so run the "clock sweep" algorithm, starting
+	 * in our chosen partition.
+	 */
+	trycounter = ClockSweepPartitions[partition].part.numBuffers;
+	partitions_left = StrategyControl->numPartitions;
+	first_candidate = true;
+
+	/*
+	 * With the 2q policy, buffers of the class that is not currently being
+	 * replaced are passed over.  If a whole partition's worth of them has
+	 * been passed over, the other class must be all pinned, so stop being
+	 * choosy.
+	 */
+	use_2q = (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q);
+	skipsleft = trycounter;
+
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		buf = GetBufferDescriptor(ClockSweepTick(partition));
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
 		 * it; decrement the usage_count (unless pinned) and keep scanning.
+		 * With the 2q policy, the usage_count of a probationary buffer is
+		 * ignored.
 		 */
 		local_buf_state = LockBufHdr(buf);
 
+		/*
+		 * The partition may have shrunk after we read its size.  Passing over
+		 * a buffer that is no longer active doesn't change anything.
+		 */
+		if (unlikely(buf->buf_id >= StrategyActiveBuffers()))
+		{
+			UnlockBufHdr(buf, local_buf_state);
+			continue;
+		}
+
 		if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0)
 		{
-			if (BUF_STATE_GET_USAGECOUNT(local_buf_state) != 0)
+			uint8		bufclass = use_2q ? BufferClasses[buf->buf_id] : BUF_CLASS_NONE;
+
+			if (bufclass != BUF_CLASS_NONE && skipsleft > 0)
+			{
+				ClockSweepPartition *part = &ClockSweepPartitions[partition].part;
+				bool		over_target;
+
+				over_target = pg_atomic_read_u32(&part->numProbation) >
+					pg_atomic_read_u32(&part->probationTarget);
+
+				if ((bufclass == BUF_CLASS_PROBATION) != over_target)
+				{
+					skipsleft--;
+					UnlockBufHdr(buf, local_buf_state);
+					first_candidate = false;
+					continue;
+				}
+			}
+
+			if (BUF_STATE_GET_USAGECOUNT(local_buf_state) != 0 &&
+				!(bufclass == BUF_CLASS_PROBATION && skipsleft > 0))
 			{
 				local_buf_state -= BUF_USAGECOUNT_ONE;
 
-				trycounter = NBuffers;
+				trycounter = ClockSweepPartitions[partition].part.numBuffers;
+				partitions_left = StrategyControl->numPartitions;
 			}
 			else
 			{
@@ -337,25 +664,214 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 				if (strategy != NULL)
 					AddBufferToRing(strategy, buf);
 				*buf_state = local_buf_state;
+
+				/* Count victim searches that had to look further */
+				if (!first_candidate)
+					pgstat_count_io_op(IOOBJECT_RELATION,
+									   IOContextForStrategy(strategy),
+									   IOOP_EVICT_RETRY);
 				return buf;
 			}
 		}
 		else if (--trycounter == 0)
 		{
 			/*
-			 * We've scanned all the buffers without making any state changes,
-			 * so all the buffers are pinned (or were when we looked at them).
-			 * We could hope that someone will free one eventually, but it's
-			 * probably better to fail than to risk getting stuck in an
-			 * infinite loop.
+			 * We've scanned all the buffers of this partition without making
+			 * any state changes, so they are all pinned (or were when we
+			 * looked at them).  Move on to the next partition.  If there is
+			 * none left, we could hope that someone will free one eventually,
+			 * but it's probably better to fail than to risk getting stuck in
+			 * an infinite loop.
 			 */
-			UnlockBufHdr(buf, local_buf_state);
-			elog(ERROR, "no unpinned buffers available");
+			if (--partitions_left == 0)
+			{
+				UnlockBufHdr(buf, local_buf_state);
+				elog(ERROR, "no unpinned buffers available");
+			}
+			partition = (partition + 1) % StrategyControl->numPartitions;
+			trycounter = ClockSweepPartitions[partition].part.numBuffers;
 		}
 		UnlockBufHdr(buf, local_buf_state);
+		first_candidate = false;
 	}
 }
 
+/*
+ * ProbationTargetAdjust -- move a partition's probation target by one buffer
+ */
+static void
+ProbationTargetAdjust(ClockSweepPartition *part, bool grow)
+{
+	uint32		oldval = pg_atomic_read_u32(&part->probationTarget);
+	uint32		newval;
+
+	do
+	{
+		if (grow)
+		{
+			if (oldval >= part->probationMax)
+				return;
+			newval = oldval + 1;
+		}
+		else
+		{
+			if (oldval <= part->probationMin)
+				return;
+			newval = oldval - 1;
+		}
+	} while (!pg_atomic_compare_exchange_u32(&part->probationTarget,
+											 &oldval, newval));
+}
+
+/*
+ * StrategyTagAssigned -- note that a buffer has been given a new tag
+ *
+ * hashcode is the buffer mapping hash code of the new tag.  The caller holds
+ * the buffer header spinlock.
+ */
+void
+StrategyTagAssigned(BufferDesc *buf, uint32 hashcode)
+{
+	ClockSweepPartition *part;
+	pg_atomic_uint32 *ghost;
+	uint32		entry;
+
+	if (buffer_replacement_policy != BUFFER_REPLACEMENT_2Q)
+		return;
+
+	Assert(BufferClasses[buf->buf_id] == BUF_CLASS_NONE);
+	part = ClockSweepPartitionOf(buf->buf_id);
+
+	/* Was this page replaced recently?  If so, consume the ghost entry. */
+	ghost = &GhostEntries[hashcode % StrategyControl->numGhosts];
+	entry = pg_atomic_read_u32(ghost);
+	if ((entry & GHOST_CLASS_MASK) != 0 &&
+		(entry & ~GHOST_CLASS_MASK) == (hashcode & ~GHOST_CLASS_MASK) &&
+		pg_atomic_compare_exchange_u32(ghost, &entry, 0))
+	{
+		ProbationTargetAdjust(part,
+							  (entry & GHOST_CLASS_MASK) == BUF_CLASS_PROBATION);
+		BufferClasses[buf->buf_id] = BUF_CLASS_PROTECTED;
+	}
+	else
+	{
+		BufferClasses[buf->buf_id] = BUF_CLASS_PROBATION;
+		pg_atomic_fetch_add_u32(&part->numProbation, 1);
+	}
+}
+
+/*
+ * StrategyTagRemoved -- note that a buffer's tag has been removed
+ *
+ * hashcode is the buffer mapping hash code of the old tag.  If evicted is
+ * true, the page was replaced to make room for another one and is remembered
+ * in a ghost entry; otherwise (the relation was dropped, say) it is simply
+ * forgotten.  The caller holds the buffer header spinlock.
+ */
+void
+StrategyTagRemoved(BufferDesc *buf, uint32 hashcode, bool evicted)
+{
+	uint8		bufclass;
+
+	if (buffer_replacement_policy != BUFFER_REPLACEMENT_2Q)
+		return;
+
+	bufclass = BufferClasses[buf->buf_id];
+	if (bufclass == BUF_CLASS_NONE)
+		return;
+	BufferClasses[buf->buf_id] = BUF_CLASS_NONE;
+
+	if (bufclass == BUF_CLASS_PROBATION)
+		pg_atomic_fetch_sub_u32(&ClockSweepPartitionOf(buf->buf_id)->numProbation, 1);
+
+	if (evicted)
+		pg_atomic_write_u32(&GhostEntries[hashcode % StrategyControl->numGhosts],
+							(hashcode & ~GHOST_CLASS_MASK) | bufclass);
+}
+
+/*
+ * StrategyBufferIsCandidate -- would the clock sweep replace this buffer?
+ *
+ * Used by the background writer to find buffers worth cleaning ahead of the
+ * clock hand.  buf_state is the buffer's state, read with the header
+ * spinlock held.
+ */
+bool
+StrategyBufferIsCandidate(BufferDesc *buf, uint32 buf_state)
+{
+	if (BUF_STATE_GET_REFCOUNT(buf_state) != 0 ||
+		buf->buf_id >= StrategyActiveBuffers())
+		return false;
+	if (BUF_STATE_GET_USAGECOUNT(buf_state) == 0)
+		return true;
+	return buffer_replacement_policy == BUFFER_REPLACEMENT_2Q &&
+		BufferClasses[buf->buf_id] == BUF_CLASS_PROBATION;
+}
+
+/*
+ * StrategyActiveBuffers -- number of buffers in use, see active_shared_buffers
+ */
+int
+StrategyActiveBuffers(void)
+{
+	return (int) pg_atomic_read_u32(&StrategyControl->activeBuffers);
+}
+
+/*
+ * StrategySetActiveBuffers -- change the number of buffers in use
+ *
+ * The number is clamped so that every clock sweep partition keeps at least
+ * one chunk of buffers; the number actually in use is returned.
+ *
+ * Once this returns, no buffer at or beyond the new limit will be chosen for
+ * replacement, but buffers there that still hold pages, or that were chosen
+ * just before the limit moved, are left alone; it's up to the caller to
+ * evict them.  Buffers added by growing the pool are put on the freelist.
+ */
+int
+StrategySetActiveBuffers(int nbuffers)
+{
+	int			oldbuffers = StrategyActiveBuffers();
+
+	nbuffers = Min(nbuffers, NBuffers);
+	nbuffers = Max(nbuffers,
+				   Min(StrategyControl->numPartitions * StrategyControl->chunkSize,
+					   NBuffers));
+	if (nbuffers == oldbuffers)
+		return nbuffers;
+
+	pg_atomic_write_u32(&StrategyControl->activeBuffers, nbuffers);
+	pg_memory_barrier();
+
+	for (int i = 0; i < StrategyControl->numPartitions; i++)
+	{
+		ClockSweepPartition *part = &ClockSweepPartitions[i].part;
+
+		int			oldsize;
+		uint32		target;
+
+		SpinLockAcquire(&part->lock);
+		oldsize = part->numBuffers;
+		part->numBuffers = ClockSweepPartitionSize(i, nbuffers);
+		Assert(part->numBuffers > 0);
+
+		/* scale the 2q policy's probation target along with the partition */
+		part->probationMin = part->numBuffers * PROBATION_MIN_FRACTION;
+		part->probationMax = part->numBuffers - part->probationMin;
+		target = (uint64) pg_atomic_read_u32(&part->probationTarget) *
+			part->numBuffers / oldsize;
+		target = Max(target, part->probationMin);
+		target = Min(target, part->probationMax);
+		pg_atomic_write_u32(&part->probationTarget, target);
+		SpinLockRelease(&part->lock);
+	}
+
+	for (int i = oldbuffers; i < nbuffers; i++)
+		StrategyFreeBuffer(GetBufferDescriptor(i));
+
+	return nbuffers;
+}
+
 /*
  * StrategyFreeBuffer: put a buffer on the freelist
  */
@@ -386,37 +902,48 @@ StrategyFreeBuffer(BufferDesc *buf)
  * BufferSync() will proceed circularly around the buffer array from there.
  *
  * In addition, we return the completed-pass count (which is effectively
- * the higher-order bits of nextVictimBuffer) and the count of recent buffer
+ * the higher-order bits of the clock position) and the count of recent buffer
  * allocs if non-NULL pointers are passed.  The alloc count is reset after
  * being read.
+ *
+ * With several clock sweep partitions, the clock position reported is the
+ * sum of the partitions' hands.  Since the partitions interleave and are kept
+ * aging at about the same rate, that is close to the buffer index the hands
+ * are at, and it advances exactly as fast as buffers are swept.
  */
 int
 StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
 {
-	uint32		nextVictimBuffer;
-	int			result;
+	uint64		ticks = 0;
+	uint32		allocs = 0;
 
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
-
-	if (complete_passes)
+	for (int i = 0; i < StrategyControl->numPartitions; i++)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		ClockSweepPartition *part = &ClockSweepPartitions[i].part;
+		uint32		nextVictimBuffer;
+
+		SpinLockAcquire(&part->lock);
+		nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
 
 		/*
-		 * Additionally add the number of wraparounds that happened before
-		 * completePasses could be incremented. C.f. ClockSweepTick().
+		 * nextVictimBuffer may exceed numBuffers if wraparounds happened
+		 * before completePasses could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		ticks += (uint64) part->completePasses * part->numBuffers +
+			nextVictimBuffer;
+
+		if (num_buf_alloc)
+			allocs += pg_atomic_exchange_u32(&part->numBufferAllocs, 0);
+		SpinLockRelease(&part->lock);
 	}
 
+	if (complete_passes)
+		*complete_passes = (uint32) (ticks / StrategyActiveBuffers());
+
 	if (num_buf_alloc)
-	{
-		*num_buf_alloc = pg_atomic_exchange_u32(&StrategyControl->numBufferAllocs, 0);
-	}
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
-	return result;
+		*num_buf_alloc = allocs;
+
+	return (int) (ticks % StrategyActiveBuffers());
 }
 
 /*
@@ -453,6 +980,9 @@ Size
 StrategyShmemSize(void)
 {
 	Size		size = 0;
+	int			npartitions;
+	int			chunk_size;
+	int			nnodes;
 
 	/* size of lookup hash table ... see comment in StrategyInitialize */
 	size = add_size(size, BufTableShmemSize(NBuffers + NUM_BUFFER_PARTITIONS));
@@ -460,6 +990,19 @@ StrategyShmemSize(void)
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the clock sweep partitions */
+	ClockSweepLayout(&npartitions, &chunk_size, &nnodes);
+	size = add_size(size, mul_size(npartitions,
+								   sizeof(ClockSweepPartitionPadded)));
+
+	/* size of the buffer classes and ghost entries */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		size = add_size(size, MAXALIGN(NBuffers));
+		size = add_size(size, mul_size(Max(NBuffers / 2, 1),
+									   sizeof(pg_atomic_uint32)));
+	}
+
 	return size;
 }
 
@@ -474,6 +1017,12 @@ void
 StrategyInitialize(bool init)
 {
 	bool		found;
+	bool		found_partitions;
+	int			npartitions;
+	int			chunk_size;
+	int			nnodes;
+
+	ClockSweepLayout(&npartitions, &chunk_size, &nnodes);
 
 	/*
 	 * Initialize the shared buffer lookup hashtable.
@@ -495,12 +1044,48 @@ StrategyInitialize(bool init)
 						sizeof(BufferStrategyControl),
 						&found);
 
+	ClockSweepPartitions = (ClockSweepPartitionPadded *)
+		ShmemInitStruct("Buffer Strategy Clock Sweep Partitions",
+						npartitions * sizeof(ClockSweepPartitionPadded),
+						&found_partitions);
+
+	/*
+	 * The 2q policy keeps ghost entries for half as many pages as there are
+	 * buffers, as suggested for the original 2Q algorithm.
+	 */
+	if (buffer_replacement_policy == BUFFER_REPLACEMENT_2Q)
+	{
+		bool		found_classes;
+		bool		found_ghosts;
+		int			nghosts = Max(NBuffers / 2, 1);
+
+		BufferClasses = (uint8 *)
+			ShmemInitStruct("Buffer Strategy Classes", NBuffers,
+							&found_classes);
+		GhostEntries = (pg_atomic_uint32 *)
+			ShmemInitStruct("Buffer Strategy Ghost Entries",
+							nghosts * sizeof(pg_atomic_uint32),
+							&found_ghosts);
+		if (!found_classes)
+		{
+			Assert(!found_ghosts);
+			memset(BufferClasses, BUF_CLASS_NONE, NBuffers);
+			for (int i = 0; i < nghosts; i++)
+				pg_atomic_init_u32(&GhostEntries[i], 0);
+		}
+		if (!found)
+			StrategyControl->numGhosts = nghosts;
+	}
+
 	if (!found)
 	{
+		const int  *nodes;
+
 		/*
 		 * Only done once, usually in postmaster
 		 */
 		Assert(init);
+		Assert(!found_partitions);
 
 		SpinLockInit(&StrategyControl->buffer_strategy_lock);
 
@@ -511,15 +1096,74 @@ StrategyInitialize(bool init)
 		StrategyControl->firstFreeBuffer = 0;
 		StrategyControl->lastFreeBuffer = NBuffers - 1;
 
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
+		/*
+		 * Initialize the clock sweep partitions.  Each gets its share of the
+		 * complete rows of chunks, and the partial last row is handed out in
+		 * order.
+		 */
+		StrategyControl->numPartitions = npartitions;
+		StrategyControl->chunkSize = chunk_size;
+		StrategyControl->numNodes = nnodes;
+		pg_atomic_init_u32(&StrategyControl->activeBuffers, NBuffers);
+		(void) ShmemNumaNodes(&nodes);
+		for (int i = 0; i < npartitions; i++)
+		{
+			ClockSweepPartition *part = &ClockSweepPartitions[i].part;
+
+			SpinLockInit(&part->lock);
+			part->numBuffers = ClockSweepPartitionSize(i, NBuffers);
+			part->node = (nnodes > 0) ? nodes[i % nnodes] : -1;
+			Assert(part->numBuffers > 0);
+
+			/* Initialize the clock sweep pointer */
+			pg_atomic_init_u32(&part->nextVictimBuffer, 0);
+
+			/* Clear statistics */
+			part->completePasses = 0;
+			pg_atomic_init_u32(&part->numBufferAllocs, 0);
+
+			/* Start the 2q policy off with the textbook probation size */
+			part->probationMin = part->numBuffers * PROBATION_MIN_FRACTION;
+			part->probationMax = part->numBuffers - part->probationMin;
+			pg_atomic_init_u32(&part->numProbation, 0);
+			pg_atomic_init_u32(&part->probationTarget,
+							   part->numBuffers * PROBATION_INITIAL_FRACTION);
+		}
+
+		/*
+		 * Place each chunk of buffers, and their descriptors, on the NUMA
+		 * node of the partition owning it.  Otherwise, interleave the whole
+		 * buffer pool across the nodes if numa_placement asks for that.
+		 */
+		if (nnodes > 0)
+		{
+			int			nchunks = (NBuffers + chunk_size - 1) / chunk_size;
 
-		/* Clear statistics */
-		StrategyControl->completePasses = 0;
-		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+			for (int c = 0; c < nchunks; c++)
+			{
+				int			first = c * chunk_size;
+				int			count = Min(chunk_size, NBuffers - first);
+				int			node = ClockSweepPartitions[c % npartitions].part.node;
+
+				ShmemNumaBind(BufferBlocks + (Size) first * BLCKSZ,
+							  (Size) count * BLCKSZ, node);
+				ShmemNumaBind(GetBufferDescriptor(first),
+							  count * sizeof(BufferDescPadded), node);
+			}
+		}
+		else
+		{
+			ShmemNumaInterleave(BufferBlocks, (Size) NBuffers * BLCKSZ);
+			ShmemNumaInterleave(BufferDescriptors,
+								NBuffers * sizeof(BufferDescPadded));
+		}
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
+
+		/* Start with the configured part of the pool */
+		if (active_shared_buffers >= 0)
+			(void) StrategySetActiveBuffers(active_shared_buffers);
 	}
 	else
 		Assert(!init);
@@ -595,8 +1239,8 @@ GetAccessStrategyWithSize(BufferAccessStrategyType btype, int ring_size_kb)
 	if (ring_buffers == 0)
 		return NULL;
 
-	/* Cap to 1/8th of shared_buffers */
-	ring_buffers = Min(NBuffers / 8, ring_buffers);
+	/* Cap to 1/8th of the buffers in use */
+	ring_buffers = Min(StrategyActiveBuffers() / 8, ring_buffers);
 
 	/* NBuffers should never be less than 16, so this shouldn't happen */
 	Assert(ring_buffers > 0);
@@ -724,7 +1368,8 @@ GetBufferFromRing(BufferAccessStrategy strategy, uint32 *buf_state)
 	buf = GetBufferDescriptor(bufnum - 1);
 	local_buf_state = LockBufHdr(buf);
 	if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0
-		&& BUF_STATE_GET_USAGECOUNT(local_buf_state) <= 1)
+		&& BUF_STATE_GET_USAGECOUNT(local_buf_state) <= 1
+		&& buf->buf_id < StrategyActiveBuffers())
 	{
 		*buf_state = local_buf_state;
 		return buf;
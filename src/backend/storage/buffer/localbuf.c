@@ -47,15 +47,43 @@ int32	   *LocalRefCount = NULL;
 
 static int	nextFreeLocalBufId = 0;
 
+/*
+ * Buffers known to hold no page, which GetLocalVictimBuffer() hands out
+ * before resorting to the clock sweep.  Entries can go stale when the sweep
+ * reuses a listed buffer, so they're rechecked when taken off the stack.
+ * LocalBufferOnFreeList keeps any buffer from being listed twice.
+ */
+static int *LocalFreeList = NULL;
+static int	nLocalFree = 0;
+static bool *LocalBufferOnFreeList = NULL;
+
+/*
+ * Set if an extension failed after tagging its buffers, leaving buffers for
+ * blocks past the end of the file.  From then on we can't use the file size
+ * to find a relation's buffers.
+ */
+static bool LocalBuffersPastEOF = false;
+
 static HTAB *LocalBufHash = NULL;
 
 /* number of local buffers pinned at least once */
 static int	NLocalPinnedBuffers = 0;
 
 
+/*
+ * Dropping a relation's buffers looks up each of its blocks in the hash
+ * table instead of scanning all local buffers, when the relation has fewer
+ * blocks than this.
+ */
+#define LOCALBUF_DROP_FULL_SCAN_THRESHOLD	(NLocBuffer / 32)
+
 static void InitLocalBuffers(void);
 static Block GetLocalBufferStorage(void);
 static Buffer GetLocalVictimBuffer(void);
+static void InvalidateLocalBuffer(BufferDesc *bufHdr);
+static void DropLocalBufferRange(RelFileLocator rlocator, ForkNumber forkNum,
+								 BlockNumber firstDelBlock,
+								 BlockNumber nblocks);
 
 
 /*
@@ -183,6 +211,21 @@ GetLocalVictimBuffer(void)
 
 	ResourceOwnerEnlarge(CurrentResourceOwner);
 
+	/* Prefer a buffer that holds no page at all */
+	while (nLocalFree > 0)
+	{
+		victim_bufid = LocalFreeList[--nLocalFree];
+		LocalBufferOnFreeList[victim_bufid] = false;
+
+		bufHdr = GetLocalBufferDescriptor(victim_bufid);
+		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		if (LocalRefCount[victim_bufid] == 0 && !(buf_state & BM_TAG_VALID))
+		{
+			PinLocalBuffer(bufHdr, false);
+			goto found;
+		}
+	}
+
 	/*
 	 * Need to get a new buffer.  We use a clock sweep algorithm (essentially
 	 * the same as what freelist.c does now...)
@@ -220,6 +263,8 @@ GetLocalVictimBuffer(void)
 					 errmsg("no empty local buffer available")));
 	}
 
+found:
+
 	/*
 	 * lazy memory allocation: allocate space on first use of a buffer.
 	 */
@@ -320,6 +365,7 @@ ExtendBufferedRelLocal(BufferManagerRelation bmr,
 {
 	BlockNumber first_block;
 	instr_time	io_start;
+	bool		saved_past_eof;
 
 	/* Initialize local buffers if first request in this session */
 	if (LocalBufHash == NULL)
@@ -362,6 +408,10 @@ ExtendBufferedRelLocal(BufferManagerRelation bmr,
 						relpath(bmr.smgr->smgr_rlocator, fork),
 						MaxBlockNumber)));
 
+	/* in case we fail before the file has been extended */
+	saved_past_eof = LocalBuffersPastEOF;
+	LocalBuffersPastEOF = true;
+
 	for (uint32 i = 0; i < extend_by; i++)
 	{
 		int			victim_buf_id;
@@ -418,6 +468,8 @@ ExtendBufferedRelLocal(BufferManagerRelation bmr,
 	/* actually extend relation */
 	smgrzeroextend(bmr.smgr, fork, first_block, extend_by, false);
 
+	LocalBuffersPastEOF = saved_past_eof;
+
 	pgstat_count_io_op_time(IOOBJECT_TEMP_RELATION, IOCONTEXT_NORMAL, IOOP_EXTEND,
 							io_start, extend_by);
 
@@ -475,26 +527,79 @@ MarkLocalBufferDirty(Buffer buffer)
 }
 
 /*
- * DropRelationLocalBuffers
- *		This function removes from the buffer pool all the pages of the
- *		specified relation that have block numbers >= firstDelBlock.
- *		(In particular, with firstDelBlock = 0, all pages are removed.)
- *		Dirty pages are simply dropped, without bothering to write them
- *		out first.  Therefore, this is NOT rollback-able, and so should be
- *		used only with extreme caution!
+ * InvalidateLocalBuffer -- forget the page held by an unpinned local buffer
  *
- *		See DropRelationBuffers in bufmgr.c for more notes.
+ * Dirty contents are simply thrown away.  The buffer is put on the free list.
  */
-void
-DropRelationLocalBuffers(RelFileLocator rlocator, ForkNumber forkNum,
-						 BlockNumber firstDelBlock)
+static void
+InvalidateLocalBuffer(BufferDesc *bufHdr)
+{
+	int			bufid = -bufHdr->buf_id - 2;
+	LocalBufferLookupEnt *hresult;
+	uint32		buf_state;
+
+	if (LocalRefCount[bufid] != 0)
+		elog(ERROR, "block %u of %s is still referenced (local %u)",
+			 bufHdr->tag.blockNum,
+			 relpathbackend(BufTagGetRelFileLocator(&bufHdr->tag),
+							MyProcNumber,
+							BufTagGetForkNum(&bufHdr->tag)),
+			 LocalRefCount[bufid]);
+
+	/* Remove entry from hashtable */
+	hresult = (LocalBufferLookupEnt *)
+		hash_search(LocalBufHash, &bufHdr->tag, HASH_REMOVE, NULL);
+	if (!hresult)				/* shouldn't happen */
+		elog(ERROR, "local buffer hash table corrupted");
+	/* Mark buffer invalid */
+	ClearBufferTag(&bufHdr->tag);
+	buf_state = pg_atomic_read_u32(&bufHdr->state);
+	buf_state &= ~BUF_FLAG_MASK;
+	buf_state &= ~BUF_USAGECOUNT_MASK;
+	pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+
+	/* Make it the next victim */
+	if (!LocalBufferOnFreeList[bufid])
+	{
+		LocalBufferOnFreeList[bufid] = true;
+		LocalFreeList[nLocalFree++] = bufid;
+	}
+}
+
+/*
+ * DropLocalBufferRange -- drop the given blocks of one fork
+ *
+ * Blocks [firstDelBlock, nblocks) are looked up one at a time if that is
+ * cheaper than scanning all local buffers.  Pass InvalidBlockNumber as
+ * nblocks if the fork's size is unknown.
+ */
+static void
+DropLocalBufferRange(RelFileLocator rlocator, ForkNumber forkNum,
+					 BlockNumber firstDelBlock, BlockNumber nblocks)
 {
 	int			i;
 
+	if (nblocks != InvalidBlockNumber &&
+		(nblocks <= firstDelBlock ||
+		 nblocks - firstDelBlock < LOCALBUF_DROP_FULL_SCAN_THRESHOLD))
+	{
+		for (BlockNumber blkno = firstDelBlock; blkno < nblocks; blkno++)
+		{
+			BufferTag	tag;
+			LocalBufferLookupEnt *hresult;
+
+			InitBufferTag(&tag, &rlocator, forkNum, blkno);
+			hresult = (LocalBufferLookupEnt *)
+				hash_search(LocalBufHash, &tag, HASH_FIND, NULL);
+			if (hresult)
+				InvalidateLocalBuffer(GetLocalBufferDescriptor(hresult->id));
+		}
+		return;
+	}
+
 	for (i = 0; i < NLocBuffer; i++)
 	{
 		BufferDesc *bufHdr = GetLocalBufferDescriptor(i);
-		LocalBufferLookupEnt *hresult;
 		uint32		buf_state;
 
 		buf_state = pg_atomic_read_u32(&bufHdr->state);
@@ -503,29 +608,43 @@ DropRelationLocalBuffers(RelFileLocator rlocator, ForkNumber forkNum,
 			BufTagMatchesRelFileLocator(&bufHdr->tag, &rlocator) &&
 			BufTagGetForkNum(&bufHdr->tag) == forkNum &&
 			bufHdr->tag.blockNum >= firstDelBlock)
-		{
-			if (LocalRefCount[i] != 0)
-				elog(ERROR, "block %u of %s is still referenced (local %u)",
-					 bufHdr->tag.blockNum,
-					 relpathbackend(BufTagGetRelFileLocator(&bufHdr->tag),
-									MyProcNumber,
-									BufTagGetForkNum(&bufHdr->tag)),
-					 LocalRefCount[i]);
-
-			/* Remove entry from hashtable */
-			hresult = (LocalBufferLookupEnt *)
-				hash_search(LocalBufHash, &bufHdr->tag, HASH_REMOVE, NULL);
-			if (!hresult)		/* shouldn't happen */
-				elog(ERROR, "local buffer hash table corrupted");
-			/* Mark buffer invalid */
-			ClearBufferTag(&bufHdr->tag);
-			buf_state &= ~BUF_FLAG_MASK;
-			buf_state &= ~BUF_USAGECOUNT_MASK;
-			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
-		}
+			InvalidateLocalBuffer(bufHdr);
 	}
 }
 
+/*
+ * DropRelationLocalBuffers
+ *		This function removes from the buffer pool all the pages of the
+ *		specified relation that have block numbers >= firstDelBlock.
+ *		(In particular, with firstDelBlock = 0, all pages are removed.)
+ *		Dirty pages are simply dropped, without bothering to write them
+ *		out first.  Therefore, this is NOT rollback-able, and so should be
+ *		used only with extreme caution!
+ *
+ *		Since local buffers are only ever created for blocks that exist on
+ *		disk (extension writes zeroes right away), the size of the file
+ *		normally tells us which blocks can be cached.  For a small relation it is therefore
+ *		cheaper to look up its blocks than to scan all local buffers, which
+ *		matters when temp_buffers is large.
+ *
+ *		See DropRelationBuffers in bufmgr.c for more notes.
+ */
+void
+DropRelationLocalBuffers(SMgrRelation smgr, ForkNumber forkNum,
+						 BlockNumber firstDelBlock)
+{
+	BlockNumber nblocks = InvalidBlockNumber;
+
+	if (NLocBuffer == 0)
+		return;
+
+	if (LOCALBUF_DROP_FULL_SCAN_THRESHOLD > 0 && !LocalBuffersPastEOF)
+		nblocks = smgrnblocks(smgr, forkNum);
+
+	DropLocalBufferRange(smgr->smgr_rlocator.locator, forkNum,
+						 firstDelBlock, nblocks);
+}
+
 /*
  * DropRelationAllLocalBuffers
  *		This function removes from the buffer pool all pages of all forks
@@ -534,39 +653,21 @@ DropRelationLocalBuffers(RelFileLocator rlocator, ForkNumber forkNum,
  *		See DropRelationsAllBuffers in bufmgr.c for more notes.
  */
 void
-DropRelationAllLocalBuffers(RelFileLocator rlocator)
+DropRelationAllLocalBuffers(SMgrRelation smgr)
 {
-	int			i;
+	if (NLocBuffer == 0)
+		return;
 
-	for (i = 0; i < NLocBuffer; i++)
+	for (ForkNumber forkNum = 0; forkNum <= MAX_FORKNUM; forkNum++)
 	{
-		BufferDesc *bufHdr = GetLocalBufferDescriptor(i);
-		LocalBufferLookupEnt *hresult;
-		uint32		buf_state;
+		BlockNumber nblocks = InvalidBlockNumber;
 
-		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		if (LOCALBUF_DROP_FULL_SCAN_THRESHOLD > 0 && !LocalBuffersPastEOF)
+			nblocks = smgrexists(smgr, forkNum) ?
+				smgrnblocks(smgr, forkNum) : 0;
 
-		if ((buf_state & BM_TAG_VALID) &&
-			BufTagMatchesRelFileLocator(&bufHdr->tag, &rlocator))
-		{
-			if (LocalRefCount[i] != 0)
-				elog(ERROR, "block %u of %s is still referenced (local %u)",
-					 bufHdr->tag.blockNum,
-					 relpathbackend(BufTagGetRelFileLocator(&bufHdr->tag),
-									MyProcNumber,
-									BufTagGetForkNum(&bufHdr->tag)),
-					 LocalRefCount[i]);
-			/* Remove entry from hashtable */
-			hresult = (LocalBufferLookupEnt *)
-				hash_search(LocalBufHash, &bufHdr->tag, HASH_REMOVE, NULL);
-			if (!hresult)		/* shouldn't happen */
-				elog(ERROR, "local buffer hash table corrupted");
-			/* Mark buffer invalid */
-			ClearBufferTag(&bufHdr->tag);
-			buf_state &= ~BUF_FLAG_MASK;
-			buf_state &= ~BUF_USAGECOUNT_MASK;
-			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
-		}
+		DropLocalBufferRange(smgr->smgr_rlocator.locator, forkNum, 0,
+							 nblocks);
 	}
 }
 
@@ -600,12 +701,16 @@ InitLocalBuffers(void)
 	LocalBufferDescriptors = (BufferDesc *) calloc(nbufs, sizeof(BufferDesc));
 	LocalBufferBlockPointers = (Block *) calloc(nbufs, sizeof(Block));
 	LocalRefCount = (int32 *) calloc(nbufs, sizeof(int32));
-	if (!LocalBufferDescriptors || !LocalBufferBlockPointers || !LocalRefCount)
+	LocalFreeList = (int *) calloc(nbufs, sizeof(int));
+	LocalBufferOnFreeList = (bool *) calloc(nbufs, sizeof(bool));
+	if (!LocalBufferDescriptors || !LocalBufferBlockPointers ||
+		!LocalRefCount || !LocalFreeList || !LocalBufferOnFreeList)
 		ereport(FATAL,
 				(errcode(ERRCODE_OUT_OF_MEMORY),
 				 errmsg("out of memory")));
 
 	nextFreeLocalBufId = 0;
+	nLocalFree = nbufs;
 
 	/* initialize fields that need to start off nonzero */
 	for (i = 0; i < nbufs; i++)
@@ -620,6 +725,10 @@ InitLocalBuffers(void)
 		 */
 		buf->buf_id = -i - 2;
 
+		/* all buffers start out free; hand out the lowest-numbered first */
+		LocalFreeList[i] = nbufs - 1 - i;
+		LocalBufferOnFreeList[i] = true;
+
 		/*
 		 * Intentionally do not initialize the buffer's atomic variable
 		 * (besides zeroing the underlying memory above). That way we get
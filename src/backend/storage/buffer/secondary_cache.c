@@ -0,0 +1,595 @@
+/*-------------------------------------------------------------------------
+ *
+ * secondary_cache.c
+ *	  routines for keeping evicted pages in a file on fast local storage.
+ *
+ * When the normal replacement policy evicts a valid page from shared
+ * buffers, a copy of it is written to a slot of the secondary cache file, and
+ * its tag is entered in a shared hash table.  A read that misses in shared
+ * buffers looks there before going to the relation file.
+ *
+ * The two tiers are kept exclusive: a block taken back into shared buffers
+ * leaves the secondary cache, and a block is only stored once it is no
+ * longer in shared buffers.  That way there is never an old copy here of a
+ * block that may have been modified in shared buffers.  Dropping or
+ * truncating a relation, or dropping a database, removes its blocks from
+ * here too.
+ *
+ * Slots are reused in FIFO order.  Each slot remembers a checksum of the
+ * copy written to it, computed whether or not data checksums are enabled; a
+ * copy that doesn't match when read back is discarded, and the block is read
+ * from the relation file instead.
+ *
+ * Everything in the cache file is also in the relation files, so it is
+ * recreated empty at server start and never fsync'd.  Writes go through the
+ * kernel's page cache, which writes them back to the device in the
+ * background; evicting backends don't wait for the device.
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/secondary_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/relpath.h"
+#include "storage/buf_internals.h"
+#include "storage/checksum.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "utils/wait_event.h"
+
+/* Number of partitions of the secondary cache lookup table */
+#define NUM_SECONDARY_CACHE_PARTITIONS	128
+
+/* Slot states */
+#define SC_SLOT_EMPTY		0
+#define SC_SLOT_BUSY		1	/* being written or read */
+#define SC_SLOT_VALID		2
+
+/* Give up storing a page after finding this many busy slots in a row */
+#define SC_MAX_BUSY_SLOTS	8
+
+/* Above this many relations, look them up by binary search while dropping */
+#define SC_RELS_BSEARCH_THRESHOLD	20
+
+typedef struct SecondaryCacheSlot
+{
+	BufferTag	tag;			/* block held in this slot */
+	uint16		checksum;		/* checksum of the page as written */
+	pg_atomic_uint32 state;		/* SC_SLOT_xxx */
+} SecondaryCacheSlot;
+
+/* entry for secondary cache lookup hashtable */
+typedef struct
+{
+	BufferTag	key;			/* tag of a disk page */
+	int			slot;			/* slot holding a copy of it */
+} SecondaryCacheLookupEnt;
+
+typedef struct SecondaryCacheControl
+{
+	pg_atomic_uint64 nextSlot;	/* FIFO position, modulo number of slots */
+	LWLockPadded locks[NUM_SECONDARY_CACHE_PARTITIONS];
+} SecondaryCacheControl;
+
+/* GUC variables */
+char	   *secondary_buffer_cache_path = NULL;
+int			secondary_buffer_cache_size = 0;
+
+/* Number of slots, or 0 if the secondary cache is disabled */
+int			SecondaryCacheNumSlots = 0;
+
+static SecondaryCacheControl *SecCacheCtl = NULL;
+static SecondaryCacheSlot *SecCacheSlots = NULL;
+static HTAB *SecCacheHash = NULL;
+
+/* This backend's handle on the cache file */
+static File SecCacheFile = -1;
+
+
+/*
+ * Number of slots the configuration asks for.
+ */
+static int
+SecondaryCacheConfiguredSlots(void)
+{
+	if (secondary_buffer_cache_path == NULL ||
+		secondary_buffer_cache_path[0] == '\0')
+		return 0;
+
+	return secondary_buffer_cache_size;
+}
+
+/*
+ * Estimate space needed for the secondary cache's shared state
+ */
+Size
+SecondaryCacheShmemSize(void)
+{
+	int			nslots = SecondaryCacheConfiguredSlots();
+	Size		size = 0;
+
+	if (nslots == 0)
+		return 0;
+
+	size = add_size(size, sizeof(SecondaryCacheControl));
+	size = add_size(size, mul_size(nslots, sizeof(SecondaryCacheSlot)));
+	size = add_size(size, hash_estimate_size(nslots,
+											 sizeof(SecondaryCacheLookupEnt)));
+
+	return size;
+}
+
+/*
+ * Initialize the secondary cache's shared state, and create its file.
+ */
+void
+SecondaryCacheShmemInit(void)
+{
+	int			nslots = SecondaryCacheConfiguredSlots();
+	bool		foundCtl,
+				foundSlots;
+	HASHCTL		info;
+
+	if (nslots == 0)
+		return;
+
+	SecCacheCtl = (SecondaryCacheControl *)
+		ShmemInitStruct("Secondary Buffer Cache Control",
+						sizeof(SecondaryCacheControl),
+						&foundCtl);
+	SecCacheSlots = (SecondaryCacheSlot *)
+		ShmemInitStruct("Secondary Buffer Cache Slots",
+						mul_size(nslots, sizeof(SecondaryCacheSlot)),
+						&foundSlots);
+
+	/* BufferTag maps to slot */
+	info.keysize = sizeof(BufferTag);
+	info.entrysize = sizeof(SecondaryCacheLookupEnt);
+	info.num_partitions = NUM_SECONDARY_CACHE_PARTITIONS;
+
+	SecCacheHash = ShmemInitHash("Secondary Buffer Cache Lookup Table",
+								 nslots, nslots,
+								 &info,
+								 HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+
+	if (foundCtl || foundSlots)
+	{
+		/* note: this path is only taken in EXEC_BACKEND case */
+		Assert(foundCtl && foundSlots);
+	}
+	else
+	{
+		int			fd;
+
+		pg_atomic_init_u64(&SecCacheCtl->nextSlot, 0);
+		for (int i = 0; i < NUM_SECONDARY_CACHE_PARTITIONS; i++)
+			LWLockInitialize(&SecCacheCtl->locks[i].lock,
+							 LWTRANCHE_SECONDARY_BUFFER_CACHE);
+
+		for (int i = 0; i < nslots; i++)
+		{
+			ClearBufferTag(&SecCacheSlots[i].tag);
+			SecCacheSlots[i].checksum = 0;
+			pg_atomic_init_u32(&SecCacheSlots[i].state, SC_SLOT_EMPTY);
+		}
+
+		/*
+		 * Throw away whatever the file held before; it's no longer known to
+		 * match the relation files.
+		 */
+		fd = BasicOpenFile(secondary_buffer_cache_path,
+						   O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+		if (fd < 0)
+			ereport(FATAL,
+					(errcode_for_file_access(),
+					 errmsg("could not create file \"%s\": %m",
+							secondary_buffer_cache_path)));
+		if (ftruncate(fd, (off_t) nslots * BLCKSZ) != 0)
+		{
+			int			save_errno = errno;
+
+			close(fd);
+			errno = save_errno;
+			ereport(FATAL,
+					(errcode_for_file_access(),
+					 errmsg("could not truncate file \"%s\" to %llu bytes: %m",
+							secondary_buffer_cache_path,
+							(unsigned long long) nslots * BLCKSZ)));
+		}
+		close(fd);
+	}
+
+	SecondaryCacheNumSlots = nslots;
+}
+
+static inline LWLock *
+SecCachePartitionLock(uint32 hashcode)
+{
+	return &SecCacheCtl->locks[hashcode % NUM_SECONDARY_CACHE_PARTITIONS].lock;
+}
+
+/*
+ * Open the cache file in this backend, if not done already.
+ */
+static bool
+SecCacheOpenFile(void)
+{
+	if (SecCacheFile < 0)
+	{
+		SecCacheFile = PathNameOpenFile(secondary_buffer_cache_path,
+										O_RDWR | PG_BINARY);
+		if (SecCacheFile < 0)
+		{
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m",
+							secondary_buffer_cache_path)));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Remove the lookup table entry for *tag, if there is one and it refers to
+ * slotno (or to any slot, if slotno is -1).
+ */
+static void
+SecCacheForgetSlot(const BufferTag *tag, int slotno)
+{
+	uint32		hashcode = get_hash_value(SecCacheHash, tag);
+	LWLock	   *partitionLock = SecCachePartitionLock(hashcode);
+	SecondaryCacheLookupEnt *ent;
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	ent = (SecondaryCacheLookupEnt *)
+		hash_search_with_hash_value(SecCacheHash, tag, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL && (slotno < 0 || ent->slot == slotno))
+		hash_search_with_hash_value(SecCacheHash, tag, hashcode,
+									HASH_REMOVE, NULL);
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * SecondaryCacheStore
+ *		Write a copy of a page that is being evicted from shared buffers
+ *
+ * The caller holds the only pin on the buffer.  Returns true if the page was
+ * stored.  If the buffer then turns out not to be evictable after all, the
+ * caller must take the copy back out with SecondaryCacheForget().
+ */
+bool
+SecondaryCacheStore(const BufferTag *tag, Block block)
+{
+	static PGIOAlignedBlock copy;
+	SecondaryCacheSlot *slot;
+	SecondaryCacheLookupEnt *ent;
+	LWLock	   *partitionLock;
+	uint32		hashcode;
+	uint32		state;
+	uint16		checksum;
+	int			slotno;
+	int			tries;
+	bool		found;
+
+	Assert(SecondaryCacheEnabled());
+
+	if (PageIsNew((Page) block) || !SecCacheOpenFile())
+		return false;
+
+	/*
+	 * Work from a copy, so that the checksum matches what is written even if
+	 * someone sets a hint bit meanwhile.
+	 */
+	memcpy(copy.data, block, BLCKSZ);
+	checksum = pg_checksum_page(copy.data, tag->blockNum);
+
+	/* Claim the next slot that nobody is busy with. */
+	for (tries = 0;; tries++)
+	{
+		if (tries >= SC_MAX_BUSY_SLOTS)
+			return false;
+
+		slotno = pg_atomic_fetch_add_u64(&SecCacheCtl->nextSlot, 1) %
+			SecondaryCacheNumSlots;
+		slot = &SecCacheSlots[slotno];
+		state = pg_atomic_read_u32(&slot->state);
+		if (state != SC_SLOT_BUSY &&
+			pg_atomic_compare_exchange_u32(&slot->state, &state, SC_SLOT_BUSY))
+			break;
+	}
+
+	/* Evict the block the slot held before, if any. */
+	if (state == SC_SLOT_VALID)
+		SecCacheForgetSlot(&slot->tag, slotno);
+
+	if (FileWrite(SecCacheFile, copy.data, BLCKSZ, (off_t) slotno * BLCKSZ,
+				  WAIT_EVENT_SECONDARY_BUFFER_CACHE_WRITE) != BLCKSZ)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m",
+						secondary_buffer_cache_path)));
+		pg_atomic_write_u32(&slot->state, SC_SLOT_EMPTY);
+		return false;
+	}
+
+	slot->tag = *tag;
+	slot->checksum = checksum;
+
+	hashcode = get_hash_value(SecCacheHash, tag);
+	partitionLock = SecCachePartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	ent = (SecondaryCacheLookupEnt *)
+		hash_search_with_hash_value(SecCacheHash, tag, hashcode,
+									HASH_ENTER_NULL, &found);
+	if (ent != NULL)
+		ent->slot = slotno;
+	LWLockRelease(partitionLock);
+
+	/* the lock release orders the slot contents before the state change */
+	pg_atomic_write_u32(&slot->state,
+						ent != NULL ? SC_SLOT_VALID : SC_SLOT_EMPTY);
+
+	return ent != NULL;
+}
+
+/*
+ * SecondaryCacheRead
+ *		Read the page for *tag into block, if the secondary cache has it
+ *
+ * The caller is performing the read I/O of a shared buffer for the tag.
+ * On success, the block leaves the secondary cache.  Returns false if the
+ * block isn't there, or the copy was found to be damaged; in that case the
+ * contents of block are undefined.
+ */
+bool
+SecondaryCacheRead(const BufferTag *tag, Block block)
+{
+	SecondaryCacheSlot *slot;
+	SecondaryCacheLookupEnt *ent;
+	LWLock	   *partitionLock;
+	uint32		hashcode;
+	uint32		state;
+	int			slotno;
+	bool		ok;
+
+	Assert(SecondaryCacheEnabled());
+
+	hashcode = get_hash_value(SecCacheHash, tag);
+	partitionLock = SecCachePartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_SHARED);
+	ent = (SecondaryCacheLookupEnt *)
+		hash_search_with_hash_value(SecCacheHash, tag, hashcode,
+									HASH_FIND, NULL);
+	slotno = ent ? ent->slot : -1;
+	LWLockRelease(partitionLock);
+
+	if (slotno < 0)
+		return false;
+
+	/*
+	 * Take over the slot.  It may be getting reused for another block right
+	 * now, in which case our block is as good as gone.
+	 */
+	slot = &SecCacheSlots[slotno];
+	state = SC_SLOT_VALID;
+	if (!pg_atomic_compare_exchange_u32(&slot->state, &state, SC_SLOT_BUSY))
+		return false;
+	if (!BufferTagsEqual(&slot->tag, tag))
+	{
+		pg_atomic_write_u32(&slot->state, SC_SLOT_VALID);
+		return false;
+	}
+
+	ok = SecCacheOpenFile() &&
+		FileRead(SecCacheFile, block, BLCKSZ, (off_t) slotno * BLCKSZ,
+				 WAIT_EVENT_SECONDARY_BUFFER_CACHE_READ) == BLCKSZ;
+	if (ok &&
+		(PageIsNew((Page) block) ||
+		 pg_checksum_page((char *) block, tag->blockNum) != slot->checksum))
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("discarding damaged copy of block %u of relation %s in secondary buffer cache",
+						tag->blockNum,
+						relpathperm(BufTagGetRelFileLocator(tag),
+									BufTagGetForkNum(tag)))));
+		ok = false;
+	}
+
+	/* Either way, the block leaves the secondary cache. */
+	SecCacheForgetSlot(tag, slotno);
+	pg_atomic_write_u32(&slot->state, SC_SLOT_EMPTY);
+
+	return ok;
+}
+
+/*
+ * SecondaryCacheContains
+ *		Does the secondary cache (probably) hold a copy of *tag?
+ */
+bool
+SecondaryCacheContains(const BufferTag *tag)
+{
+	uint32		hashcode = get_hash_value(SecCacheHash, tag);
+	LWLock	   *partitionLock = SecCachePartitionLock(hashcode);
+	bool		found;
+
+	Assert(SecondaryCacheEnabled());
+
+	LWLockAcquire(partitionLock, LW_SHARED);
+	hash_search_with_hash_value(SecCacheHash, tag, hashcode,
+								HASH_FIND, &found);
+	LWLockRelease(partitionLock);
+
+	return found;
+}
+
+/*
+ * SecondaryCacheForget
+ *		Remove *tag from the secondary cache, if present
+ */
+void
+SecondaryCacheForget(const BufferTag *tag)
+{
+	Assert(SecondaryCacheEnabled());
+
+	SecCacheForgetSlot(tag, -1);
+}
+
+/*
+ * SecondaryCacheDropRelationBuffers
+ *		Remove the blocks of the given relation forks numbered at or above
+ *		firstDelBlock
+ *
+ * If the caller knows the size of each fork, it passes them in nForkBlock,
+ * and we look up the blocks one by one.  Otherwise we scan all slots.  As
+ * for shared buffers, the caller must ensure that no one is loading new
+ * pages of the relation.
+ */
+void
+SecondaryCacheDropRelationBuffers(RelFileLocator rlocator, ForkNumber *forkNum,
+								  int nforks, BlockNumber *nForkBlock,
+								  BlockNumber *firstDelBlock)
+{
+	BufferTag	tag;
+
+	Assert(SecondaryCacheEnabled());
+
+	if (nForkBlock != NULL)
+	{
+		for (int j = 0; j < nforks; j++)
+		{
+			for (BlockNumber blkno = firstDelBlock[j];
+				 blkno < nForkBlock[j]; blkno++)
+			{
+				InitBufferTag(&tag, &rlocator, forkNum[j], blkno);
+				SecCacheForgetSlot(&tag, -1);
+			}
+		}
+		return;
+	}
+
+	for (int i = 0; i < SecondaryCacheNumSlots; i++)
+	{
+		SecondaryCacheSlot *slot = &SecCacheSlots[i];
+
+		/*
+		 * An unlocked precheck is safe for the same reason as in
+		 * DropRelationBuffers(); SecCacheForgetSlot() rechecks the tag.
+		 */
+		if (pg_atomic_read_u32(&slot->state) != SC_SLOT_VALID ||
+			!BufTagMatchesRelFileLocator(&slot->tag, &rlocator))
+			continue;
+
+		tag = slot->tag;
+		for (int j = 0; j < nforks; j++)
+		{
+			if (BufTagGetForkNum(&tag) == forkNum[j] &&
+				tag.blockNum >= firstDelBlock[j])
+			{
+				SecCacheForgetSlot(&tag, i);
+				break;
+			}
+		}
+	}
+}
+
+static int
+sc_rlocator_comparator(const void *p1, const void *p2)
+{
+	const RelFileLocator *n1 = (const RelFileLocator *) p1;
+	const RelFileLocator *n2 = (const RelFileLocator *) p2;
+
+	if (n1->relNumber != n2->relNumber)
+		return n1->relNumber < n2->relNumber ? -1 : 1;
+	if (n1->dbOid != n2->dbOid)
+		return n1->dbOid < n2->dbOid ? -1 : 1;
+	if (n1->spcOid != n2->spcOid)
+		return n1->spcOid < n2->spcOid ? -1 : 1;
+	return 0;
+}
+
+/*
+ * SecondaryCacheDropRelationsAllBuffers
+ *		Remove all blocks of all forks of the given relations
+ *
+ * The locators array may be sorted in place.
+ */
+void
+SecondaryCacheDropRelationsAllBuffers(RelFileLocator *locators, int nlocators)
+{
+	bool		use_bsearch = nlocators > SC_RELS_BSEARCH_THRESHOLD;
+
+	Assert(SecondaryCacheEnabled());
+
+	if (use_bsearch)
+		qsort(locators, nlocators, sizeof(RelFileLocator),
+			  sc_rlocator_comparator);
+
+	for (int i = 0; i < SecondaryCacheNumSlots; i++)
+	{
+		SecondaryCacheSlot *slot = &SecCacheSlots[i];
+		RelFileLocator rlocator;
+		bool		match = false;
+
+		if (pg_atomic_read_u32(&slot->state) != SC_SLOT_VALID)
+			continue;
+
+		rlocator = BufTagGetRelFileLocator(&slot->tag);
+		if (use_bsearch)
+			match = bsearch(&rlocator, locators, nlocators,
+							sizeof(RelFileLocator),
+							sc_rlocator_comparator) != NULL;
+		else
+		{
+			for (int j = 0; j < nlocators && !match; j++)
+				match = RelFileLocatorEquals(rlocator, locators[j]);
+		}
+
+		if (match)
+		{
+			BufferTag	tag = slot->tag;
+
+			SecCacheForgetSlot(&tag, i);
+		}
+	}
+}
+
+/*
+ * SecondaryCacheDropDatabaseBuffers
+ *		Remove all blocks of relations of the given database
+ */
+void
+SecondaryCacheDropDatabaseBuffers(Oid dbid)
+{
+	Assert(SecondaryCacheEnabled());
+
+	for (int i = 0; i < SecondaryCacheNumSlots; i++)
+	{
+		SecondaryCacheSlot *slot = &SecCacheSlots[i];
+
+		if (pg_atomic_read_u32(&slot->state) == SC_SLOT_VALID &&
+			slot->tag.dbOid == dbid)
+		{
+			BufferTag	tag = slot->tag;
+
+			SecCacheForgetSlot(&tag, i);
+		}
+	}
+}
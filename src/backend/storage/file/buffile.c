@@ -17,7 +17,13 @@
  * when the buffer is filled or emptied.  This is an even bigger win
  * for virtual Files than for ordinary kernel files, since reducing the
  * frequency with which a virtual File is touched reduces "thrashing"
- * of opening/closing file descriptors.
+ * of opening/closing file descriptors.  Reads of at least a block that
+ * find the buffer empty bypass it, and are passed down as one large read.
+ *
+ * When a file is read sequentially, we also ask the kernel to read ahead
+ * up to BUFFILE_PREFETCH_DISTANCE blocks, rather than relying on its own
+ * heuristics.  Those tend to be defeated by callers like logtape.c and
+ * hash join batches, which interleave reads of several streams.
  *
  * Note that BufFile structs are allocated with palloc(), and therefore
  * will go away automatically at query/transaction end.  Since the underlying
@@ -36,6 +42,15 @@
  * infrastructure for parallel execution.  Such files need to be created as a
  * member of a SharedFileSet that all participants are attached to.
  *
+ * BufFiles created with BufFileCreateCompressTemp are compressed, as chosen by
+ * temp_file_compression.  Each bufferload is compressed on its own, and
+ * stored as a chunk consisting of a BufFileChunkHeader and the compressed
+ * data.  Chunks never cross a segment boundary.  Since positions within the
+ * logical file no longer map to physical offsets, such files must be written
+ * sequentially, and then read sequentially after rewinding them with
+ * BufFileSeek(file, 0, 0, SEEK_SET); that is all that hash join batch files
+ * need.
+ *
  * BufFile also supports temporary files that can be used by the single backend
  * when the corresponding files need to be survived across the transaction and
  * need to be opened and closed multiple times.  Such files need to be created
@@ -45,13 +60,22 @@
 
 #include "postgres.h"
 
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "commands/tablespace.h"
+#include "common/pg_lzcompress.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/buffile.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
+#include "utils/memutils.h"
 #include "utils/resowner.h"
 
 /*
@@ -62,6 +86,55 @@
 #define MAX_PHYSICAL_FILESIZE	0x40000000
 #define BUFFILE_SEG_SIZE		(MAX_PHYSICAL_FILESIZE / BLCKSZ)
 
+/*
+ * How far ahead of sequential reads to prefetch, in blocks.  A new prefetch
+ * request is issued whenever less than half of that remains.
+ */
+#define BUFFILE_PREFETCH_DISTANCE	32
+
+/* size of the buffer needed to compress a bufferload */
+#ifdef USE_LZ4
+#define LZ4_MAX_BLCKSZ		LZ4_COMPRESSBOUND(BLCKSZ)
+#else
+#define LZ4_MAX_BLCKSZ		0
+#endif
+
+#ifdef USE_ZSTD
+#define ZSTD_MAX_BLCKSZ		ZSTD_COMPRESSBOUND(BLCKSZ)
+#else
+#define ZSTD_MAX_BLCKSZ		0
+#endif
+
+#define PGLZ_MAX_BLCKSZ		PGLZ_MAX_OUTPUT(BLCKSZ)
+
+#define COMPRESS_BUFSIZE	Max(Max(PGLZ_MAX_BLCKSZ, LZ4_MAX_BLCKSZ), ZSTD_MAX_BLCKSZ)
+
+/*
+ * Header of each chunk of a compressed BufFile.  A bufferload that doesn't
+ * get smaller by compression is stored as is, with complen = 0.
+ */
+typedef struct BufFileChunkHeader
+{
+	int32		rawlen;			/* length of the bufferload */
+	int32		complen;		/* length of the compressed data, or 0 */
+} BufFileChunkHeader;
+
+typedef struct BufFileChunk
+{
+	BufFileChunkHeader hdr;
+	char		data[COMPRESS_BUFSIZE];
+} BufFileChunk;
+
+/* GUC variable */
+int			temp_file_compression = TEMP_FILE_COMPRESSION_NONE;
+
+/*
+ * Work space for compressing and decompressing chunks.  Allocated on first
+ * use, and shared by all BufFiles of the backend, since (de)compression is
+ * done synchronously.
+ */
+static BufFileChunk *compress_chunk = NULL;
+
 /*
  * This data structure represents a buffered file that consists of one or
  * more physical files (each accessed through a virtual file descriptor
@@ -76,6 +149,7 @@ struct BufFile
 	bool		isInterXact;	/* keep open over transactions? */
 	bool		dirty;			/* does buffer need to be written? */
 	bool		readOnly;		/* has the file been set to read only? */
+	int			compress;		/* TempFileCompression of the file */
 
 	FileSet    *fileset;		/* space for fileset based segment files */
 	const char *name;			/* name of fileset based BufFile */
@@ -96,6 +170,14 @@ struct BufFile
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
 
+	/*
+	 * Read-ahead window: the range of component file prefetchFile that has
+	 * been read or prefetched since the last non-sequential read.
+	 */
+	int			prefetchFile;
+	off_t		prefetchStart;
+	off_t		prefetchEnd;
+
 	/*
 	 * XXX Should ideally us PGIOAlignedBlock, but might need a way to avoid
 	 * wasting per-file alignment padding when some users create many files.
@@ -106,8 +188,11 @@ struct BufFile
 static BufFile *makeBufFileCommon(int nfiles);
 static BufFile *makeBufFile(File firstfile);
 static void extendBufFile(BufFile *file);
+static int	BufFileReadSegment(BufFile *file, void *ptr, size_t size);
 static void BufFileLoadBuffer(BufFile *file);
+static void BufFileLoadCompressedBuffer(BufFile *file);
 static void BufFileDumpBuffer(BufFile *file);
+static void BufFileDumpCompressedBuffer(BufFile *file);
 static void BufFileFlush(BufFile *file);
 static File MakeNewFileSetSegment(BufFile *buffile, int segment);
 
@@ -122,11 +207,15 @@ makeBufFileCommon(int nfiles)
 	file->numFiles = nfiles;
 	file->isInterXact = false;
 	file->dirty = false;
+	file->compress = TEMP_FILE_COMPRESSION_NONE;
 	file->resowner = CurrentResourceOwner;
 	file->curFile = 0;
 	file->curOffset = 0;
 	file->pos = 0;
 	file->nbytes = 0;
+	file->prefetchFile = -1;
+	file->prefetchStart = 0;
+	file->prefetchEnd = 0;
 
 	return file;
 }
@@ -215,6 +304,28 @@ BufFileCreateTemp(bool interXact)
 	return file;
 }
 
+/*
+ * Create a BufFile like BufFileCreateTemp, but compressed with the method
+ * selected by temp_file_compression, if any.
+ *
+ * Only sequential access is supported on such files, see the notes at the
+ * top of the file.
+ */
+BufFile *
+BufFileCreateCompressTemp(bool interXact)
+{
+	BufFile    *file = BufFileCreateTemp(interXact);
+
+	file->compress = temp_file_compression;
+
+	if (file->compress != TEMP_FILE_COMPRESSION_NONE &&
+		compress_chunk == NULL)
+		compress_chunk = MemoryContextAlloc(TopMemoryContext,
+											sizeof(BufFileChunk));
+
+	return file;
+}
+
 /*
  * Build the name for a given segment of a given BufFile.
  */
@@ -424,16 +535,18 @@ BufFileClose(BufFile *file)
 }
 
 /*
- * BufFileLoadBuffer
+ * BufFileReadSegment
  *
- * Load some data into buffer, if possible, starting from curOffset.
- * At call, must have dirty = false, pos and nbytes = 0.
- * On exit, nbytes is number of bytes loaded.
+ * Read up to size bytes into ptr, starting from curOffset, but not beyond the
+ * end of the current component file.  Returns the number of bytes read.
+ * At call, must have dirty = false, pos and nbytes = 0.  curOffset is not
+ * advanced, and temp_blks_read is left for the caller to count.
  */
-static void
-BufFileLoadBuffer(BufFile *file)
+static int
+BufFileReadSegment(BufFile *file, void *ptr, size_t size)
 {
 	File		thisfile;
+	int			nread;
 	instr_time	io_start;
 	instr_time	io_time;
 
@@ -449,27 +562,56 @@ BufFileLoadBuffer(BufFile *file)
 
 	thisfile = file->files[file->curFile];
 
+	size = Min(size, Max(MAX_PHYSICAL_FILESIZE - file->curOffset, 0));
+
+	/*
+	 * If this read continues the previous ones, make sure that the kernel is
+	 * reading ahead of us.  Otherwise, start a new read-ahead window here.
+	 */
+	if (file->curFile == file->prefetchFile &&
+		file->curOffset >= file->prefetchStart &&
+		file->curOffset <= file->prefetchEnd)
+	{
+		off_t		target;
+
+		target = Min(file->curOffset + size +
+					 (off_t) BUFFILE_PREFETCH_DISTANCE * BLCKSZ,
+					 MAX_PHYSICAL_FILESIZE);
+		if (file->prefetchEnd - file->curOffset <
+			(off_t) BUFFILE_PREFETCH_DISTANCE * BLCKSZ / 2 &&
+			target > file->prefetchEnd)
+		{
+			off_t		start = Max(file->prefetchEnd,
+									file->curOffset + (off_t) size);
+
+			if (target > start)
+				(void) FilePrefetch(thisfile, start, target - start,
+									WAIT_EVENT_BUFFILE_READ);
+			file->prefetchEnd = target;
+		}
+	}
+	else
+	{
+		file->prefetchFile = file->curFile;
+		file->prefetchStart = file->curOffset;
+		file->prefetchEnd = file->curOffset + size;
+	}
+
 	if (track_io_timing)
 		INSTR_TIME_SET_CURRENT(io_start);
 	else
 		INSTR_TIME_SET_ZERO(io_start);
 
-	/*
-	 * Read whatever we can get, up to a full bufferload.
-	 */
-	file->nbytes = FileRead(thisfile,
-							file->buffer.data,
-							sizeof(file->buffer),
-							file->curOffset,
-							WAIT_EVENT_BUFFILE_READ);
-	if (file->nbytes < 0)
-	{
-		file->nbytes = 0;
+	nread = FileRead(thisfile,
+					 ptr,
+					 size,
+					 file->curOffset,
+					 WAIT_EVENT_BUFFILE_READ);
+	if (nread < 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
 				 errmsg("could not read file \"%s\": %m",
 						FilePathName(thisfile))));
-	}
 
 	if (track_io_timing)
 	{
@@ -477,12 +619,156 @@ BufFileLoadBuffer(BufFile *file)
 		INSTR_TIME_ACCUM_DIFF(pgBufferUsage.temp_blk_read_time, io_time, io_start);
 	}
 
+	return nread;
+}
+
+/*
+ * BufFileLoadBuffer
+ *
+ * Load some data into buffer, if possible, starting from curOffset.
+ * At call, must have dirty = false, pos and nbytes = 0.
+ * On exit, nbytes is number of bytes loaded.
+ */
+static void
+BufFileLoadBuffer(BufFile *file)
+{
+	if (file->compress != TEMP_FILE_COMPRESSION_NONE)
+	{
+		BufFileLoadCompressedBuffer(file);
+		return;
+	}
+
+	/*
+	 * Read whatever we can get, up to a full bufferload.
+	 */
+	file->nbytes = BufFileReadSegment(file,
+									  file->buffer.data,
+									  sizeof(file->buffer));
+
 	/* we choose not to advance curOffset here */
 
 	if (file->nbytes > 0)
 		pgBufferUsage.temp_blks_read++;
 }
 
+/*
+ * BufFileLoadCompressedBuffer
+ *
+ * Load and decompress the chunk starting at curOffset.
+ * At call, must have dirty = false, pos and nbytes = 0.
+ * On exit, nbytes is number of bytes loaded, and curOffset is advanced past
+ * the chunk.
+ */
+static void
+BufFileLoadCompressedBuffer(BufFile *file)
+{
+	BufFileChunkHeader *hdr = &compress_chunk->hdr;
+	int			nread;
+	int			datalen;
+
+	nread = BufFileReadSegment(file, hdr, sizeof(BufFileChunkHeader));
+
+	/*
+	 * The writer moves on to the next component file early if a chunk
+	 * doesn't fit into the current one, so reaching the end of one doesn't
+	 * mean the end of the BufFile.
+	 */
+	while (nread == 0 && file->curFile + 1 < file->numFiles)
+	{
+		file->curFile++;
+		file->curOffset = 0;
+		nread = BufFileReadSegment(file, hdr, sizeof(BufFileChunkHeader));
+	}
+
+	if (nread == 0)
+		return;					/* no more data available */
+
+	if (nread != sizeof(BufFileChunkHeader) ||
+		hdr->rawlen <= 0 || hdr->rawlen > BLCKSZ ||
+		hdr->complen < 0 || hdr->complen > COMPRESS_BUFSIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid chunk header in temporary file \"%s\"",
+						FilePathName(file->files[file->curFile]))));
+
+	file->curOffset += sizeof(BufFileChunkHeader);
+
+	if (hdr->complen == 0)
+	{
+		/* stored as is */
+		datalen = hdr->rawlen;
+		nread = BufFileReadSegment(file, file->buffer.data, datalen);
+	}
+	else
+	{
+		int			rawlen = -1;
+
+		datalen = hdr->complen;
+		nread = BufFileReadSegment(file, compress_chunk->data, datalen);
+
+		if (nread == datalen)
+		{
+			switch ((TempFileCompression) file->compress)
+			{
+				case TEMP_FILE_COMPRESSION_PGLZ:
+					rawlen = pglz_decompress(compress_chunk->data, datalen,
+											 file->buffer.data, hdr->rawlen,
+											 true);
+					break;
+
+				case TEMP_FILE_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+					rawlen = LZ4_decompress_safe(compress_chunk->data,
+												 file->buffer.data,
+												 datalen, BLCKSZ);
+#else
+					elog(ERROR, "LZ4 is not supported by this build");
+#endif
+					break;
+
+				case TEMP_FILE_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+					{
+						size_t		result;
+
+						result = ZSTD_decompress(file->buffer.data, BLCKSZ,
+												 compress_chunk->data,
+												 datalen);
+						if (!ZSTD_isError(result))
+							rawlen = (int) result;
+					}
+#else
+					elog(ERROR, "zstd is not supported by this build");
+#endif
+					break;
+
+				case TEMP_FILE_COMPRESSION_NONE:
+					Assert(false);	/* cannot happen */
+					break;
+					/* no default case, so that compiler will warn */
+			}
+
+			if (rawlen != hdr->rawlen)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not decompress chunk in temporary file \"%s\"",
+								FilePathName(file->files[file->curFile]))));
+		}
+	}
+
+	if (nread != datalen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("unexpected end of chunk in temporary file \"%s\"",
+						FilePathName(file->files[file->curFile]))));
+
+	pgBufferUsage.temp_blks_read +=
+		(sizeof(BufFileChunkHeader) + datalen + BLCKSZ - 1) / BLCKSZ;
+
+	file->curOffset += datalen;
+	file->nbytes = hdr->rawlen;
+}
+
 /*
  * BufFileDumpBuffer
  *
@@ -497,6 +783,12 @@ BufFileDumpBuffer(BufFile *file)
 	int			bytestowrite;
 	File		thisfile;
 
+	if (file->compress != TEMP_FILE_COMPRESSION_NONE)
+	{
+		BufFileDumpCompressedBuffer(file);
+		return;
+	}
+
 	/*
 	 * Unlike BufFileLoadBuffer, we must dump the whole buffer even if it
 	 * crosses a component-file boundary; so we need a loop.
@@ -579,6 +871,129 @@ BufFileDumpBuffer(BufFile *file)
 	file->nbytes = 0;
 }
 
+/*
+ * BufFileDumpCompressedBuffer
+ *
+ * Compress the buffer contents, and write them as a chunk at curOffset.
+ * At call, should have dirty = true, nbytes > 0, and pos = nbytes, since
+ * compressed files are only written sequentially.
+ * On exit, dirty is cleared, and curOffset is advanced past the chunk.
+ */
+static void
+BufFileDumpCompressedBuffer(BufFile *file)
+{
+	BufFileChunkHeader *hdr = &compress_chunk->hdr;
+	int			len = -1;
+	int			chunklen;
+	int			nwritten;
+	File		thisfile;
+	instr_time	io_start;
+	instr_time	io_time;
+
+	Assert(file->pos == file->nbytes);
+
+	switch ((TempFileCompression) file->compress)
+	{
+		case TEMP_FILE_COMPRESSION_PGLZ:
+			len = pglz_compress(file->buffer.data, file->nbytes,
+								compress_chunk->data, PGLZ_strategy_default);
+			break;
+
+		case TEMP_FILE_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			len = LZ4_compress_default(file->buffer.data,
+									   compress_chunk->data,
+									   file->nbytes, COMPRESS_BUFSIZE);
+			if (len <= 0)
+				len = -1;		/* failure */
+#else
+			elog(ERROR, "LZ4 is not supported by this build");
+#endif
+			break;
+
+		case TEMP_FILE_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				size_t		result;
+
+				/* favor speed, temporary files are short-lived */
+				result = ZSTD_compress(compress_chunk->data, COMPRESS_BUFSIZE,
+									   file->buffer.data, file->nbytes, 1);
+				if (!ZSTD_isError(result))
+					len = (int) result;
+			}
+#else
+			elog(ERROR, "zstd is not supported by this build");
+#endif
+			break;
+
+		case TEMP_FILE_COMPRESSION_NONE:
+			Assert(false);		/* cannot happen */
+			break;
+			/* no default case, so that compiler will warn */
+	}
+
+	hdr->rawlen = file->nbytes;
+	if (len >= 0 && len < file->nbytes)
+		hdr->complen = len;
+	else
+	{
+		/* not compressible, store as is */
+		hdr->complen = 0;
+		len = file->nbytes;
+		memcpy(compress_chunk->data, file->buffer.data, len);
+	}
+	chunklen = sizeof(BufFileChunkHeader) + len;
+
+	/*
+	 * Advance to next component file if the chunk doesn't fit into the
+	 * current one.
+	 */
+	if (file->curOffset + chunklen > MAX_PHYSICAL_FILESIZE)
+	{
+		while (file->curFile + 1 >= file->numFiles)
+			extendBufFile(file);
+		file->curFile++;
+		file->curOffset = 0;
+	}
+
+	thisfile = file->files[file->curFile];
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(io_start);
+	else
+		INSTR_TIME_SET_ZERO(io_start);
+
+	nwritten = FileWrite(thisfile,
+						 compress_chunk,
+						 chunklen,
+						 file->curOffset,
+						 WAIT_EVENT_BUFFILE_WRITE);
+	if (nwritten != chunklen)
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (nwritten >= 0)
+			errno = ENOSPC;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m",
+						FilePathName(thisfile))));
+	}
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_ACCUM_DIFF(pgBufferUsage.temp_blk_write_time, io_time, io_start);
+	}
+
+	pgBufferUsage.temp_blks_written += (chunklen + BLCKSZ - 1) / BLCKSZ;
+
+	file->curOffset += chunklen;
+	file->dirty = false;
+	file->pos = 0;
+	file->nbytes = 0;
+}
+
 /*
  * BufFileRead variants
  *
@@ -602,10 +1017,37 @@ BufFileReadCommon(BufFile *file, void *ptr, size_t size, bool exact, bool eofOK)
 	{
 		if (file->pos >= file->nbytes)
 		{
-			/* Try to load more data into buffer. */
-			file->curOffset += file->pos;
+			/*
+			 * For a compressed file, curOffset already points to the next
+			 * chunk, and the data can only be read through the buffer.
+			 */
+			if (file->compress == TEMP_FILE_COMPRESSION_NONE)
+				file->curOffset += file->pos;
 			file->pos = 0;
 			file->nbytes = 0;
+
+			/*
+			 * If at least a whole buffer's worth is wanted, read as much of
+			 * it as we can directly into the caller's memory.
+			 */
+			if (size >= sizeof(file->buffer) &&
+				file->compress == TEMP_FILE_COMPRESSION_NONE)
+			{
+				nthistime = BufFileReadSegment(file, ptr,
+											   size - size % sizeof(file->buffer));
+				if (nthistime > 0)
+				{
+					pgBufferUsage.temp_blks_read +=
+						(nthistime + BLCKSZ - 1) / BLCKSZ;
+					file->curOffset += nthistime;
+					ptr = (char *) ptr + nthistime;
+					size -= nthistime;
+					nread += nthistime;
+					continue;
+				}
+			}
+
+			/* Try to load more data into buffer. */
 			BufFileLoadBuffer(file);
 			if (file->nbytes <= 0)
 				break;			/* no more data available */
@@ -689,6 +1131,7 @@ BufFileWrite(BufFile *file, const void *ptr, size_t size)
 			else
 			{
 				/* Hmm, went directly from reading to writing? */
+				Assert(file->compress == TEMP_FILE_COMPRESSION_NONE);
 				file->curOffset += file->pos;
 				file->pos = 0;
 				file->nbytes = 0;
@@ -742,6 +1185,20 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 	int			newFile;
 	off_t		newOffset;
 
+	/* compressed files can only be rewound */
+	if (file->compress != TEMP_FILE_COMPRESSION_NONE)
+	{
+		if (whence != SEEK_SET || fileno != 0 || offset != 0)
+			elog(ERROR, "cannot seek in compressed temporary file");
+
+		BufFileFlush(file);
+		file->curFile = 0;
+		file->curOffset = 0;
+		file->pos = 0;
+		file->nbytes = 0;
+		return 0;
+	}
+
 	switch (whence)
 	{
 		case SEEK_SET:
@@ -832,6 +1289,9 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 void
 BufFileTell(BufFile *file, int *fileno, off_t *offset)
 {
+	/* positions within compressed files are meaningless to the caller */
+	Assert(file->compress == TEMP_FILE_COMPRESSION_NONE);
+
 	*fileno = file->curFile;
 	*offset = file->curOffset + file->pos;
 }
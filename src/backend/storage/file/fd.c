@@ -158,6 +158,19 @@ int			max_files_per_process = 1000;
  */
 int			max_safe_fds = FD_MINFREE;	/* default if not changed */
 
+#ifdef HAVE_GETRLIMIT
+/*
+ * The postmaster raises the soft RLIMIT_NOFILE as far as needed for
+ * max_files_per_process, up to the hard limit, and forked subprocesses
+ * inherit that.  The original limit is kept so that it can be restored
+ * while running external programs, some of which misbehave with very high
+ * descriptor limits (select() with FD_SETSIZE, closing every possible fd).
+ */
+static struct rlimit original_max_open_files;
+static struct rlimit custom_max_open_files;
+static bool saved_original_max_open_files = false;
+#endif
+
 /* Whether it is safe to continue running after fsync() fails. */
 bool		data_sync_retry = false;
 
@@ -981,6 +994,32 @@ count_usable_fds(int max_to_probe, int *usable_fds, int *already_open)
 	getrlimit_status = getrlimit(RLIMIT_NOFILE, &rlim);
 	if (getrlimit_status != 0)
 		ereport(WARNING, (errmsg("getrlimit failed: %m")));
+	else if (rlim.rlim_cur != RLIM_INFINITY &&
+			 rlim.rlim_cur < (rlim_t) max_to_probe + NUM_RESERVED_FDS &&
+			 rlim.rlim_cur < rlim.rlim_max)
+	{
+		struct rlimit newlim = rlim;
+
+		/*
+		 * The soft limit would keep us from using max_files_per_process
+		 * descriptors; raise it as far as the hard limit allows.  The probe
+		 * below then sees the new limit.
+		 */
+		newlim.rlim_cur = Min(rlim.rlim_max,
+							  (rlim_t) max_to_probe + NUM_RESERVED_FDS);
+		if (setrlimit(RLIMIT_NOFILE, &newlim) == 0)
+		{
+			if (!saved_original_max_open_files)
+			{
+				original_max_open_files = rlim;
+				saved_original_max_open_files = true;
+			}
+			custom_max_open_files = newlim;
+			rlim = newlim;
+		}
+		else
+			ereport(WARNING, (errmsg("setrlimit failed: %m")));
+	}
 #endif							/* HAVE_GETRLIMIT */
 
 	/* dup until failure or probe limit reached */
@@ -1079,6 +1118,53 @@ set_max_safe_fds(void)
 		 max_safe_fds, usable_fds, already_open);
 }
 
+/*
+ * RestoreOriginalOpenFileLimit
+ *		Put back the RLIMIT_NOFILE that was in effect before we raised it
+ *
+ * Call this before starting an external program, and
+ * RestoreCustomOpenFileLimit() once it has been started.
+ */
+static void
+RestoreOriginalOpenFileLimit(void)
+{
+#ifdef HAVE_GETRLIMIT
+	if (saved_original_max_open_files &&
+		setrlimit(RLIMIT_NOFILE, &original_max_open_files) != 0)
+		ereport(WARNING, (errmsg("setrlimit failed: %m")));
+#endif
+}
+
+static void
+RestoreCustomOpenFileLimit(void)
+{
+#ifdef HAVE_GETRLIMIT
+	if (saved_original_max_open_files &&
+		setrlimit(RLIMIT_NOFILE, &custom_max_open_files) != 0)
+		ereport(WARNING, (errmsg("setrlimit failed: %m")));
+#endif
+}
+
+/*
+ * System
+ *		Run a shell command with system(3), using the file descriptor limit
+ *		the server was started with.
+ *
+ * Callers are responsible for flushing stdio and reporting wait events, as
+ * with a plain system() call.
+ */
+int
+System(const char *command)
+{
+	int			rc;
+
+	RestoreOriginalOpenFileLimit();
+	rc = system(command);
+	RestoreCustomOpenFileLimit();
+
+	return rc;
+}
+
 /*
  * Open a file with BasicOpenFilePerm() and pass default file mode for the
  * fileMode parameter.
@@ -2415,6 +2501,17 @@ FileSize(File file)
 
 	if (FileIsNotOpen(file))
 	{
+		struct stat st;
+
+		/*
+		 * Rather than reopening the file, which would push some other file
+		 * out of the LRU ring, just ask for the size by name.  Only if that
+		 * fails, say because the file has been unlinked while we still have
+		 * it, reopen it and let lseek() decide.
+		 */
+		if (stat(VfdCache[file].fileName, &st) == 0)
+			return st.st_size;
+
 		if (FileAccess(file) < 0)
 			return (off_t) -1;
 	}
@@ -2466,7 +2563,9 @@ FilePathName(File file)
 }
 
 /*
- * Return the raw file descriptor of an opened file.
+ * Return the raw file descriptor of an opened file, reopening it first if it
+ * has been closed to stay under the open file limit.  Returns -1 with errno
+ * set if that fails.
  *
  * The returned file descriptor will be valid until the file is closed, but
  * there are a lot of things that can make that happen.  So the caller should
@@ -2476,7 +2575,14 @@ FilePathName(File file)
 int
 FileGetRawDesc(File file)
 {
+	int			returnCode;
+
 	Assert(FileIsValid(file));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
 	return VfdCache[file].fd;
 }
 
@@ -2704,9 +2810,11 @@ OpenPipeStream(const char *command, const char *mode)
 TryAgain:
 	fflush(NULL);
 	pqsignal(SIGPIPE, SIG_DFL);
+	RestoreOriginalOpenFileLimit();
 	errno = 0;
 	file = popen(command, mode);
 	save_errno = errno;
+	RestoreCustomOpenFileLimit();
 	pqsignal(SIGPIPE, SIG_IGN);
 	errno = save_errno;
 	if (file != NULL)
@@ -141,6 +141,48 @@ GetPageWithFreeSpace(Relation rel, Size spaceNeeded)
 	return fsm_search(rel, min_cat);
 }
 
+/*
+ * GetOtherPageWithFreeSpace - like GetPageWithFreeSpace, but avoid busyPage
+ *
+ * This is for a caller that found busyPage locked by another backend and
+ * would rather go elsewhere than wait.  We look for another page on the same
+ * FSM page first, starting just after busyPage, so that concurrent callers
+ * spread out over neighboring pages instead of converging on one.  The
+ * FSM's next-slot hint is moved past busyPage too, so that later searches
+ * don't send other backends to it either.  busyPage can still be returned
+ * if it's the only candidate.
+ */
+BlockNumber
+GetOtherPageWithFreeSpace(Relation rel, BlockNumber busyPage,
+						  Size spaceNeeded)
+{
+	int			search_cat = fsm_space_needed_to_cat(spaceNeeded);
+	FSMAddress	addr;
+	uint16		slot;
+	Buffer		buf;
+
+	addr = fsm_get_location(busyPage, &slot);
+	buf = fsm_readbuf(rel, addr, false);
+	if (BufferIsValid(buf))
+	{
+		int			search_slot;
+
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		fsm_set_next_slot(BufferGetPage(buf), slot + 1);
+		search_slot = fsm_search_avail(buf, search_cat, true, false);
+		UnlockReleaseBuffer(buf);
+
+		if (search_slot != -1 && search_slot != slot)
+		{
+			BlockNumber blknum = fsm_get_heap_blk(addr, search_slot);
+
+			if (fsm_does_block_exist(rel, blknum))
+				return blknum;
+		}
+	}
+	return fsm_search(rel, search_cat);
+}
+
 /*
  * RecordAndGetPageWithFreeSpace - update info about a page and try again.
  *
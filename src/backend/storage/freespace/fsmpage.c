@@ -305,6 +305,21 @@ restart:
 	return slot;
 }
 
+/*
+ * Sets the next-target pointer of the page, where the next search starts.
+ *
+ * Like fsm_search_avail(), this only requires a shared lock, since the
+ * pointer is just a hint.
+ */
+void
+fsm_set_next_slot(Page page, int slot)
+{
+	FSMPage		fsmpage = (FSMPage) PageGetContents(page);
+
+	/* wrap-around is handled by fsm_search_avail */
+	fsmpage->fp_next_slot = slot;
+}
+
 /*
  * Sets the available space to zero for all slots numbered >= nslots.
  * Returns true if the page was modified.
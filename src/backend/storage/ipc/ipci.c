@@ -25,12 +25,15 @@
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
 #include "commands/async.h"
+#include "commands/sequence.h"
+#include "executor/execQueryCache.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/profiler.h"
 #include "postmaster/walsummarizer.h"
 #include "replication/logicallauncher.h"
 #include "replication/origin.h"
@@ -49,6 +52,7 @@
 #include "storage/procarray.h"
 #include "storage/procsignal.h"
 #include "storage/sinvaladt.h"
+#include "storage/smgr.h"
 #include "storage/spin.h"
 #include "utils/guc.h"
 #include "utils/injection_point.h"
@@ -117,6 +121,9 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, dsm_estimate_size());
 	size = add_size(size, DSMRegistryShmemSize());
 	size = add_size(size, BufferShmemSize());
+	size = add_size(size, RelSizeCacheShmemSize());
+	size = add_size(size, SeqCacheShmemSize());
+	size = add_size(size, QueryCacheShmemSize());
 	size = add_size(size, LockShmemSize());
 	size = add_size(size, PredicateLockShmemSize());
 	size = add_size(size, ProcGlobalShmemSize());
@@ -131,6 +138,7 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, BackgroundWorkerShmemSize());
 	size = add_size(size, MultiXactShmemSize());
 	size = add_size(size, LWLockShmemSize());
+	size = add_size(size, LWLockReaderSlotsShmemSize());
 	size = add_size(size, ProcArrayShmemSize());
 	size = add_size(size, BackendStatusShmemSize());
 	size = add_size(size, SInvalShmemSize());
@@ -145,6 +153,7 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, WalSummarizerShmemSize());
 	size = add_size(size, PgArchShmemSize());
 	size = add_size(size, ApplyLauncherShmemSize());
+	size = add_size(size, ProfilerShmemSize());
 	size = add_size(size, BTreeShmemSize());
 	size = add_size(size, SyncScanShmemSize());
 	size = add_size(size, AsyncShmemSize());
@@ -291,6 +300,8 @@ CreateOrAttachShmemStructs(void)
 	 */
 	InitShmemIndex();
 
+	LWLockReaderSlotsShmemInit();
+
 	dsm_shmem_init();
 	DSMRegistryShmemInit();
 
@@ -306,6 +317,9 @@ CreateOrAttachShmemStructs(void)
 	SUBTRANSShmemInit();
 	MultiXactShmemInit();
 	InitBufferPool();
+	RelSizeCacheShmemInit();
+	SeqCacheShmemInit();
+	QueryCacheShmemInit();
 
 	/*
 	 * Set up lock manager
@@ -346,6 +360,7 @@ CreateOrAttachShmemStructs(void)
 	WalSummarizerShmemInit();
 	PgArchShmemInit();
 	ApplyLauncherShmemInit();
+	ProfilerShmemInit();
 	SlotSyncShmemInit();
 
 	/*
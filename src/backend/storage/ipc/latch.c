@@ -197,6 +197,8 @@ static void WaitEventAdjustWin32(WaitEventSet *set, WaitEvent *event);
 static inline int WaitEventSetWaitBlock(WaitEventSet *set, int cur_timeout,
 										WaitEvent *occurred_events, int nevents);
 
+static void WakeLatchOwner(Latch *latch);
+
 /* ResourceOwner support to hold WaitEventSets */
 static void ResOwnerReleaseWaitEventSet(Datum res);
 
@@ -631,12 +633,6 @@ WaitLatchOrSocket(Latch *latch, int wakeEvents, pgsocket sock,
 void
 SetLatch(Latch *latch)
 {
-#ifndef WIN32
-	pid_t		owner_pid;
-#else
-	HANDLE		handle;
-#endif
-
 	/*
 	 * The memory barrier has to be placed here to ensure that any flag
 	 * variables possibly changed by this process have been flushed to main
@@ -654,7 +650,69 @@ SetLatch(Latch *latch)
 	if (!latch->maybe_sleeping)
 		return;
 
+	WakeLatchOwner(latch);
+}
+
+/*
+ * Add a latch to a batch to be set by SetLatches().  If the batch is full,
+ * the latches already in it are set first.
+ */
+void
+AddLatch(LatchBatch *batch, Latch *latch)
+{
+	if (batch->size == LATCH_BATCH_SIZE)
+		SetLatches(batch);
+	batch->latches[batch->size++] = latch;
+}
+
+/*
+ * Set all latches of a batch, and empty it.
+ *
+ * This has the same effect as calling SetLatch() on each of them, but needs
+ * only two memory barriers for the whole batch, and wakes the owners only
+ * after all the latches are set, so a woken process doesn't have to compete
+ * with us for the CPU while we're still setting the rest.  It also lets
+ * callers collect latches while holding a lock, and do the system calls
+ * needed to wake their owners after releasing it.
+ */
+void
+SetLatches(LatchBatch *batch)
+{
+	int			nwake = 0;
+
+	pg_memory_barrier();
+
+	for (int i = 0; i < batch->size; i++)
+	{
+		Latch	   *latch = batch->latches[i];
+
+		if (latch->is_set)
+			continue;
+		latch->is_set = true;
+		batch->latches[nwake++] = latch;
+	}
+
+	pg_memory_barrier();
+
+	for (int i = 0; i < nwake; i++)
+	{
+		Latch	   *latch = batch->latches[i];
+
+		if (latch->maybe_sleeping)
+			WakeLatchOwner(latch);
+	}
+
+	batch->size = 0;
+}
+
+/*
+ * Wake up the owner of a latch that we have just set, if it's waiting on it.
+ */
+static void
+WakeLatchOwner(Latch *latch)
+{
 #ifndef WIN32
+	pid_t		owner_pid;
 
 	/*
 	 * See if anyone's waiting for the latch. It can be the current process if
@@ -695,6 +753,7 @@ SetLatch(Latch *latch)
 		kill(owner_pid, SIGURG);
 
 #else
+	HANDLE		handle;
 
 	/*
 	 * See if anyone's waiting for the latch. It can be the current process if
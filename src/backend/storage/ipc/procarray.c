@@ -99,6 +99,38 @@ typedef struct ProcArrayStruct
 	int			pgprocnos[FLEXIBLE_ARRAY_MEMBER];
 } ProcArrayStruct;
 
+/*
+ * Shared cache of the most recently computed snapshot.
+ *
+ * Building a snapshot means scanning the xids of every connected backend,
+ * which gets expensive with thousands of (mostly idle) connections.  But
+ * between two transaction completions, every backend without an xid of its
+ * own computes the same snapshot (apart from xids >= xmax, which don't
+ * matter), so the first backend to scan publishes its result here and the
+ * others just copy it.  This works the same way and for the same reason as
+ * GetSnapshotDataReuse(), except across backends: completionCount is the
+ * xactCompletionCount the contents were computed for, and since that cannot
+ * change while ProcArrayLock is held, neither can contents that match it.
+ *
+ * Publishing happens with ProcArrayLock held in shared mode only, so writers
+ * are serialized by the busy flag, and readers detect a partially written
+ * cache because completionCount is zeroed first and set last.  Snapshots
+ * with more subxids than fit are simply not published.
+ */
+typedef struct SnapshotCacheData
+{
+	pg_atomic_flag busy;		/* set while a backend is filling the cache */
+	pg_atomic_uint64 completionCount;	/* 0 if contents invalid */
+	TransactionId xmin;
+	int			xcnt;
+	int			subxcnt;
+	bool		suboverflowed;
+	/* xcnt xids, then subxcnt subxids */
+	TransactionId xids[FLEXIBLE_ARRAY_MEMBER];
+} SnapshotCacheData;
+
+#define SNAPSHOT_CACHE_MAX_SUBXIDS	PROCARRAY_MAXPROCS
+
 /*
  * State for the GlobalVisTest* family of functions. Those functions can
  * e.g. be used to decide if a deleted row can be removed without violating
@@ -266,8 +298,13 @@ typedef enum KAXCompressReason
 } KAXCompressReason;
 
 
+/* GUC variable */
+bool		procarray_big_reader_lock = false;
+
 static ProcArrayStruct *procArray;
 
+static SnapshotCacheData *snapshotCache;
+
 static PGPROC *allProcs;
 
 /*
@@ -365,6 +402,16 @@ static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
 static void MaintainLatestCompletedXid(TransactionId latestXid);
 static void MaintainLatestCompletedXidRecovery(TransactionId latestXid);
 
+static Size SnapshotCacheShmemSize(void);
+static bool GetSnapshotDataFromCache(Snapshot snapshot,
+									 uint64 curXactCompletionCount,
+									 TransactionId *xmin, int *count,
+									 int *subcount, bool *suboverflowed);
+static void SnapshotCachePublish(Snapshot snapshot,
+								 uint64 curXactCompletionCount,
+								 TransactionId xmin, int count, int subcount,
+								 bool suboverflowed);
+
 static inline FullTransactionId FullXidRelativeTo(FullTransactionId rel,
 												  TransactionId xid);
 static void GlobalVisUpdateApply(ComputeXidHorizonsResult *horizons);
@@ -397,7 +444,7 @@ ProcArrayShmemSize(void)
 	 * shared memory is being set up.
 	 */
 #define TOTAL_MAX_CACHED_SUBXIDS \
-	((PGPROC_MAX_CACHED_SUBXIDS + 1) * PROCARRAY_MAXPROCS)
+	((PGPROC_MIN_CACHED_SUBXIDS + 1) * PROCARRAY_MAXPROCS)
 
 	if (EnableHotStandby)
 	{
@@ -408,9 +455,24 @@ ProcArrayShmemSize(void)
 						mul_size(sizeof(bool), TOTAL_MAX_CACHED_SUBXIDS));
 	}
 
+	/* Shared snapshot cache */
+	size = add_size(size, SnapshotCacheShmemSize());
+
 	return size;
 }
 
+/*
+ * Report shared-memory space needed by the shared snapshot cache
+ */
+static Size
+SnapshotCacheShmemSize(void)
+{
+	return add_size(offsetof(SnapshotCacheData, xids),
+					mul_size(sizeof(TransactionId),
+							 add_size(PROCARRAY_MAXPROCS,
+									  SNAPSHOT_CACHE_MAX_SUBXIDS)));
+}
+
 /*
  * Initialize the shared PGPROC array during postmaster startup.
  */
@@ -442,10 +504,28 @@ CreateSharedProcArray(void)
 		procArray->replication_slot_xmin = InvalidTransactionId;
 		procArray->replication_slot_catalog_xmin = InvalidTransactionId;
 		TransamVariables->xactCompletionCount = 1;
+
+		/*
+		 * ProcArrayLock is taken in shared mode far more often than in
+		 * exclusive mode, by every snapshot, so optionally let readers avoid
+		 * writing to it.
+		 */
+		if (procarray_big_reader_lock &&
+			!LWLockMakeBigReader(ProcArrayLock))
+			elog(ERROR, "could not make ProcArrayLock a big-reader lock");
 	}
 
 	allProcs = ProcGlobal->allProcs;
 
+	snapshotCache = (SnapshotCacheData *)
+		ShmemInitStruct("Proc Array Snapshot Cache", SnapshotCacheShmemSize(),
+						&found);
+	if (!found)
+	{
+		pg_atomic_init_flag(&snapshotCache->busy);
+		pg_atomic_init_u64(&snapshotCache->completionCount, 0);
+	}
+
 	/* Create or attach to the KnownAssignedXids arrays too, if needed */
 	if (EnableHotStandby)
 	{
@@ -1319,7 +1399,7 @@ ProcArrayApplyXidAssignment(TransactionId topxid,
 	 * NOTE: This will fail if the subxid contains too many previously
 	 * unobserved xids to fit into known-assigned-xids. That shouldn't happen
 	 * as the code stands, because xid-assignment records should never contain
-	 * more than PGPROC_MAX_CACHED_SUBXIDS entries.
+	 * more than PGPROC_MIN_CACHED_SUBXIDS entries.
 	 */
 	RecordKnownAssignedTransactionIds(max_xid);
 
@@ -2067,7 +2147,8 @@ GetMaxSnapshotXidCount(void)
 int
 GetMaxSnapshotSubxidCount(void)
 {
-	return TOTAL_MAX_CACHED_SUBXIDS;
+	return Max(TOTAL_MAX_CACHED_SUBXIDS,
+			   max_cached_subxids * PROCARRAY_MAXPROCS);
 }
 
 /*
@@ -2129,6 +2210,91 @@ GetSnapshotDataReuse(Snapshot snapshot)
 	return true;
 }
 
+/*
+ * Helper function for GetSnapshotData() that fills in the running xids from
+ * the shared snapshot cache, if it is valid for curXactCompletionCount.
+ * Only usable by a backend that has no xid of its own, since the cached
+ * snapshot doesn't exclude anybody's xid.  Returns false if the snapshot has
+ * to be built the hard way.
+ */
+static bool
+GetSnapshotDataFromCache(Snapshot snapshot, uint64 curXactCompletionCount,
+						 TransactionId *xmin, int *count, int *subcount,
+						 bool *suboverflowed)
+{
+	SnapshotCacheData *cache = snapshotCache;
+
+	Assert(LWLockHeldByMe(ProcArrayLock));
+
+	if (pg_atomic_read_u64(&cache->completionCount) != curXactCompletionCount)
+		return false;
+
+	/* pairs with the write barriers in SnapshotCachePublish() */
+	pg_read_barrier();
+
+	*xmin = cache->xmin;
+	*count = cache->xcnt;
+	*subcount = cache->subxcnt;
+	*suboverflowed = cache->suboverflowed;
+	memcpy(snapshot->xip, cache->xids, *count * sizeof(TransactionId));
+	memcpy(snapshot->subxip, cache->xids + *count,
+		   *subcount * sizeof(TransactionId));
+
+	/*
+	 * Nobody may start rewriting the cache as long as its completionCount
+	 * matches the current one and we hold ProcArrayLock, so this cannot
+	 * fail; but check anyway rather than risk using a torn snapshot.
+	 */
+	pg_read_barrier();
+	if (unlikely(pg_atomic_read_u64(&cache->completionCount) !=
+				 curXactCompletionCount))
+		return false;
+
+	return true;
+}
+
+/*
+ * Helper function for GetSnapshotData() that publishes a freshly built
+ * snapshot in the shared snapshot cache, unless somebody else already did or
+ * is doing so.  The caller must have no xid of its own.
+ */
+static void
+SnapshotCachePublish(Snapshot snapshot, uint64 curXactCompletionCount,
+					 TransactionId xmin, int count, int subcount,
+					 bool suboverflowed)
+{
+	SnapshotCacheData *cache = snapshotCache;
+
+	Assert(LWLockHeldByMe(ProcArrayLock));
+
+	if (subcount > SNAPSHOT_CACHE_MAX_SUBXIDS)
+		return;
+	if (pg_atomic_read_u64(&cache->completionCount) == curXactCompletionCount)
+		return;
+	if (!pg_atomic_test_set_flag(&cache->busy))
+		return;
+
+	/* recheck, somebody might have finished just before we got the flag */
+	if (pg_atomic_read_u64(&cache->completionCount) != curXactCompletionCount)
+	{
+		pg_atomic_write_u64(&cache->completionCount, 0);
+		pg_write_barrier();
+
+		cache->xmin = xmin;
+		cache->xcnt = count;
+		cache->subxcnt = subcount;
+		cache->suboverflowed = suboverflowed;
+		memcpy(cache->xids, snapshot->xip, count * sizeof(TransactionId));
+		memcpy(cache->xids + count, snapshot->subxip,
+			   subcount * sizeof(TransactionId));
+
+		pg_write_barrier();
+		pg_atomic_write_u64(&cache->completionCount, curXactCompletionCount);
+	}
+
+	pg_atomic_clear_flag(&cache->busy);
+}
+
 /*
  * GetSnapshotData -- returns information about running transactions.
  *
@@ -2248,7 +2414,14 @@ GetSnapshotData(Snapshot snapshot)
 
 	snapshot->takenDuringRecovery = RecoveryInProgress();
 
-	if (!snapshot->takenDuringRecovery)
+	if (!snapshot->takenDuringRecovery &&
+		!TransactionIdIsValid(myxid) &&
+		GetSnapshotDataFromCache(snapshot, curXactCompletionCount,
+								 &xmin, &count, &subcount, &suboverflowed))
+	{
+		/* got it from the shared snapshot cache */
+	}
+	else if (!snapshot->takenDuringRecovery)
 	{
 		int			numProcs = arrayP->numProcs;
 		TransactionId *xip = snapshot->xip;
@@ -2352,6 +2525,11 @@ GetSnapshotData(Snapshot snapshot)
 				}
 			}
 		}
+
+		/* Let other backends without an xid reuse what we just computed */
+		if (!TransactionIdIsValid(myxid))
+			SnapshotCachePublish(snapshot, curXactCompletionCount,
+								 xmin, count, subcount, suboverflowed);
 	}
 	else
 	{
@@ -2770,7 +2948,12 @@ GetRunningTransactionData(void)
 			TransactionIdPrecedes(xid, oldestRunningXid))
 			oldestDatabaseRunningXid = xid;
 
-		if (ProcGlobal->subxidStates[index].overflowed)
+		/*
+		 * A standby cannot track more than PGPROC_MIN_CACHED_SUBXIDS subxids
+		 * per transaction, so a larger cache looks overflowed from there.
+		 */
+		if (ProcGlobal->subxidStates[index].overflowed ||
+			ProcGlobal->subxidStates[index].count > PGPROC_MIN_CACHED_SUBXIDS)
 			suboverflowed = true;
 
 		/*
@@ -4347,9 +4530,9 @@ FullXidRelativeTo(FullTransactionId rel, TransactionId xid)
  * links are *not* maintained (which does not affect visibility).
  *
  * We have room in KnownAssignedXids and in snapshots to hold maxProcs *
- * (1 + PGPROC_MAX_CACHED_SUBXIDS) XIDs, so every primary transaction must
+ * (1 + PGPROC_MIN_CACHED_SUBXIDS) XIDs, so every primary transaction must
  * report its subtransaction XIDs in a WAL XLOG_XACT_ASSIGNMENT record at
- * least every PGPROC_MAX_CACHED_SUBXIDS.  When we receive one of these
+ * least every PGPROC_MIN_CACHED_SUBXIDS.  When we receive one of these
  * records, we mark the subXIDs as children of the top XID in pg_subtrans,
  * and then remove them from KnownAssignedXids.  This prevents overflow of
  * KnownAssignedXids and snapshots, at the cost that status checks for these
@@ -65,9 +65,14 @@
 
 #include "postgres.h"
 
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
 #include "fmgr.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "port/pg_numa.h"
 #include "storage/lwlock.h"
 #include "storage/pg_shmem.h"
 #include "storage/shmem.h"
@@ -486,6 +491,165 @@ ShmemInitStruct(const char *name, Size size, bool *foundPtr)
 }
 
 
+/*
+ * ShmemNumaNodes -- get the NUMA nodes to place shared memory on
+ *
+ * Returns the number of nodes, and sets *nodes to point to their ids.  If
+ * numa_placement is off, or this system doesn't offer more than one node,
+ * returns 0.
+ */
+int
+ShmemNumaNodes(const int **nodes)
+{
+	static int	numa_nodes[PG_NUMA_MAX_NODES];
+	static int	num_numa_nodes = -1;
+
+	*nodes = numa_nodes;
+
+	if (numa_placement == NUMA_PLACEMENT_OFF)
+		return 0;
+
+	if (num_numa_nodes < 0)
+	{
+		num_numa_nodes = pg_numa_get_nodes(numa_nodes, PG_NUMA_MAX_NODES);
+		if (num_numa_nodes < 0)
+			ereport(WARNING,
+					(errmsg("could not determine NUMA nodes: %m"),
+					 errdetail("\"numa_placement\" will have no effect.")));
+		if (num_numa_nodes < 2)
+			num_numa_nodes = 0;
+	}
+
+	return num_numa_nodes;
+}
+
+/*
+ * Return the size of the pages backing the main shared memory segment.
+ */
+static Size
+ShmemPageSize(void)
+{
+	static Size page_size = 0;
+
+	if (page_size == 0)
+	{
+#ifndef WIN32
+		if (huge_pages_status == HUGE_PAGES_ON)
+			GetHugePageSize(&page_size, NULL);
+		else
+			page_size = sysconf(_SC_PAGESIZE);
+#endif
+		if (page_size == 0)
+			page_size = 4096;
+	}
+
+	return page_size;
+}
+
+/*
+ * Helper for ShmemNumaInterleave and ShmemNumaBind: round a range of shared
+ * memory to page boundaries, as the kernel requires.  Both ends are rounded
+ * down, so that adjacent ranges don't overlap.  Returns false if the range
+ * covers no page start.
+ */
+static bool
+ShmemNumaAlignRange(void **ptr, Size *size)
+{
+	Size		page_size = ShmemPageSize();
+	uintptr_t	start;
+	uintptr_t	end;
+
+	start = TYPEALIGN_DOWN(page_size, (uintptr_t) *ptr);
+	end = TYPEALIGN_DOWN(page_size, (uintptr_t) *ptr + *size);
+	if (start == end)
+		return false;
+
+	*ptr = (void *) start;
+	*size = end - start;
+	return true;
+}
+
+/*
+ * ShmemNumaInterleave -- interleave a shared memory range across the NUMA
+ * nodes returned by ShmemNumaNodes()
+ *
+ * Does nothing unless numa_placement is enabled.  This is meant to be called
+ * while the shared memory is being created, before its contents are touched.
+ * Failures are reported as a warning, once.
+ */
+void
+ShmemNumaInterleave(void *ptr, Size size)
+{
+	static bool warned = false;
+	const int  *nodes;
+	int			nnodes = ShmemNumaNodes(&nodes);
+
+	if (nnodes == 0 || !ShmemNumaAlignRange(&ptr, &size))
+		return;
+
+	if (pg_numa_interleave(ptr, size, nodes, nnodes) != 0 && !warned)
+	{
+		ereport(WARNING,
+				(errmsg("could not interleave shared memory across NUMA nodes: %m")));
+		warned = true;
+	}
+}
+
+/*
+ * ShmemNumaBind -- place a shared memory range on one NUMA node
+ *
+ * Like ShmemNumaInterleave, but for one of the nodes returned by
+ * ShmemNumaNodes().
+ */
+void
+ShmemNumaBind(void *ptr, Size size, int node)
+{
+	static bool warned = false;
+	const int  *nodes;
+
+	if (ShmemNumaNodes(&nodes) == 0 || !ShmemNumaAlignRange(&ptr, &size))
+		return;
+
+	if (pg_numa_bind(ptr, size, node) != 0 && !warned)
+	{
+		ereport(WARNING,
+				(errmsg("could not place shared memory on NUMA node %d: %m",
+						node)));
+		warned = true;
+	}
+}
+
+/*
+ * ShmemRelease -- give the memory backing a shared memory range back to the
+ * operating system
+ *
+ * Only the pages lying entirely within the range are released.  Their
+ * contents are lost, and they are backed by fresh zeroed pages when touched
+ * again.  The caller must make sure no process is using the range.  This is
+ * a no-op where the kernel offers no way to do it; failures are reported as
+ * a warning, once.
+ */
+void
+ShmemRelease(void *ptr, Size size)
+{
+#ifdef MADV_REMOVE
+	static bool warned = false;
+	Size		page_size = ShmemPageSize();
+	uintptr_t	start = TYPEALIGN(page_size, (uintptr_t) ptr);
+	uintptr_t	end = TYPEALIGN_DOWN(page_size, (uintptr_t) ptr + size);
+
+	if (start >= end)
+		return;
+
+	if (madvise((void *) start, end - start, MADV_REMOVE) != 0 && !warned)
+	{
+		ereport(WARNING,
+				(errmsg("could not release shared memory: %m")));
+		warned = true;
+	}
+#endif
+}
+
 /*
  * Add two Size values, checking for overflow
  */
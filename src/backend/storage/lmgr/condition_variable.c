@@ -284,6 +284,7 @@ ConditionVariableBroadcast(ConditionVariable *cv)
 	int			pgprocno = MyProcNumber;
 	PGPROC	   *proc = NULL;
 	bool		have_sentinel = false;
+	LatchBatch	wakeups = {0};
 
 	/*
 	 * In some use-cases, it is common for awakened processes to immediately
@@ -336,9 +337,12 @@ ConditionVariableBroadcast(ConditionVariable *cv)
 	while (have_sentinel)
 	{
 		/*
-		 * Each time through the loop, remove the first wakeup list entry, and
-		 * signal it unless it's our sentinel.  Repeat as long as the sentinel
-		 * remains in the list.
+		 * Each time through the loop, remove wakeup list entries up to and
+		 * including our sentinel, at most a batch's worth, and signal all
+		 * but the sentinel.  Repeat as long as the sentinel remains in the
+		 * list.  Taking several entries per spinlock acquisition, and setting
+		 * their latches together, makes waking up many processes much
+		 * cheaper.
 		 *
 		 * Notice that if someone else removes our sentinel, we will waken one
 		 * additional process before exiting.  That's intentional, because if
@@ -347,14 +351,18 @@ ConditionVariableBroadcast(ConditionVariable *cv)
 		 * sentinel.  Better to give a spurious wakeup (which should be
 		 * harmless beyond wasting some cycles) than to lose a wakeup.
 		 */
-		proc = NULL;
 		SpinLockAcquire(&cv->mutex);
-		if (!proclist_is_empty(&cv->wakeup))
-			proc = proclist_pop_head_node(&cv->wakeup, cvWaitLink);
-		have_sentinel = proclist_contains(&cv->wakeup, pgprocno, cvWaitLink);
+		do
+		{
+			proc = NULL;
+			if (!proclist_is_empty(&cv->wakeup))
+				proc = proclist_pop_head_node(&cv->wakeup, cvWaitLink);
+			have_sentinel = proclist_contains(&cv->wakeup, pgprocno, cvWaitLink);
+			if (proc != NULL && proc != MyProc)
+				AddLatch(&wakeups, &proc->procLatch);
+		} while (have_sentinel && wakeups.size < LATCH_BATCH_SIZE);
 		SpinLockRelease(&cv->mutex);
 
-		if (proc != NULL && proc != MyProc)
-			SetLatch(&proc->procLatch);
+		SetLatches(&wakeups);
 	}
 }
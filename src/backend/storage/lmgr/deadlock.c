@@ -16,6 +16,7 @@
  *
  *	Interface:
  *
+ *	DeadLockPrecheck()
  *	DeadLockCheck()
  *	DeadLockReport()
  *	RememberSimpleDeadLock()
@@ -88,6 +89,8 @@ static bool FindLockCycleRecurseMember(PGPROC *checkProc,
 static bool ExpandConstraints(EDGE *constraints, int nConstraints);
 static bool TopoSort(LOCK *lock, EDGE *constraints, int nConstraints,
 					 PGPROC **ordering);
+static bool PrecheckWaiter(PGPROC *startProc, PGPROC *checkProc);
+static bool PrecheckEdge(PGPROC *startProc, PGPROC *blocker);
 
 #ifdef DEBUG_DEADLOCK
 static void PrintLockQueue(LOCK *lock, const char *info);
@@ -127,6 +130,11 @@ static int	nDeadlockDetails;
 /* PGPROC pointer of any blocking autovacuum worker found */
 static PGPROC *blocking_autovacuum_proc = NULL;
 
+/* Workspace for DeadLockPrecheck, indexed by proc number */
+static PGPROC **precheckQueue;	/* procs still to be visited */
+static int	nPrecheckQueue;
+static bool *precheckVisited;	/* procs already queued */
+
 
 /*
  * InitDeadLockChecking -- initialize deadlock checker during backend startup
@@ -195,9 +203,187 @@ InitDeadLockChecking(void)
 	possibleConstraints =
 		(EDGE *) palloc(maxPossibleConstraints * sizeof(EDGE));
 
+	/*
+	 * DeadLockPrecheck can reach any PGPROC, including those of auxiliary
+	 * processes and prepared transactions, but visits each just once.
+	 */
+	precheckQueue = (PGPROC **)
+		palloc(ProcGlobal->allProcCount * sizeof(PGPROC *));
+	precheckVisited = (bool *) palloc(ProcGlobal->allProcCount * sizeof(bool));
+
 	MemoryContextSwitchTo(oldcxt);
 }
 
+/*
+ * DeadLockPrecheck -- Rule out a deadlock without locking the lock table
+ *
+ * DeadLockCheck needs a consistent picture of the whole lock table, so its
+ * caller locks every lock partition, which stalls all lock traffic while the
+ * check runs.  Usually, though, the waiter is just queued behind a busy lock
+ * holder and there is no cycle to be found.  This function establishes that
+ * more cheaply: it follows the waits-for edges, hard and soft, leading out of
+ * the given process, holding only the partition lock of one awaited lock at a
+ * time, in shared mode.  If the process can't be reached again, it is not
+ * part of a deadlock.
+ *
+ * Returns false if there is certainly no deadlock involving proc, true if
+ * DeadLockCheck is needed to tell.
+ *
+ * Because partitions are examined one at a time, the graph we see need not
+ * be consistent.  That cannot make us miss a deadlock, though.  The edges of
+ * a deadlock cycle don't go away by themselves, so a cycle that was complete
+ * when we started will be seen in full; and if it was completed while we
+ * looked, the process that completed it will run its own check after
+ * deadlock_timeout.  Edges that vanish under us can only lead to a needless
+ * full check.
+ *
+ * Lock groups, and autovacuum workers blocking proc directly, are left to
+ * DeadLockCheck, which knows how to deal with them.
+ *
+ * Caller must not hold any lock partition lock.
+ */
+bool
+DeadLockPrecheck(PGPROC *proc)
+{
+	if (proc->lockGroupLeader != NULL)
+		return true;
+
+	memset(precheckVisited, 0, ProcGlobal->allProcCount * sizeof(bool));
+	precheckVisited[GetNumberFromPGProc(proc)] = true;
+	precheckQueue[0] = proc;
+	nPrecheckQueue = 1;
+
+	for (int i = 0; i < nPrecheckQueue; i++)
+	{
+		if (PrecheckWaiter(proc, precheckQueue[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Queue up the processes that checkProc waits for.  Returns true if one of
+ * them is startProc or calls for the full check.
+ */
+static bool
+PrecheckWaiter(PGPROC *startProc, PGPROC *checkProc)
+{
+	volatile PGPROC *vproc = checkProc;
+	LOCK	   *lock;
+	LWLock	   *partitionLock;
+	LockMethod	lockMethodTable;
+	int			conflictMask;
+	dlist_iter	proclock_iter;
+	dlist_iter	proc_iter;
+	bool		result = false;
+
+	/*
+	 * Find out which lock the process is waiting for, if any.  We need the
+	 * lock's tag to know which partition lock protects it, so read it without
+	 * any lock and check again once we hold the partition lock.  If the
+	 * process is granted its lock and starts waiting for another one in the
+	 * meantime, just try again.
+	 */
+	for (;;)
+	{
+		uint32		hashcode;
+
+		lock = vproc->waitLock;
+		if (lock == NULL)
+			return false;
+
+		hashcode = LockTagHashCode(&lock->tag);
+		partitionLock = LockHashPartitionLock(hashcode);
+		LWLockAcquire(partitionLock, LW_SHARED);
+
+		if (vproc->waitLock == lock && vproc->links.next != NULL &&
+			LockTagHashCode(&lock->tag) == hashcode)
+			break;
+
+		LWLockRelease(partitionLock);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* As in FindLockCycleRecurseMember, extension locks can't deadlock */
+	if (LOCK_LOCKTAG(*lock) == LOCKTAG_RELATION_EXTEND)
+	{
+		LWLockRelease(partitionLock);
+		return false;
+	}
+
+	lockMethodTable = GetLocksMethodTable(lock);
+	conflictMask = lockMethodTable->conflictTab[checkProc->waitLockMode];
+
+	/* Hard edges: procs that hold conflicting locks */
+	dlist_foreach(proclock_iter, &lock->procLocks)
+	{
+		PROCLOCK   *proclock = dlist_container(PROCLOCK, lockLink, proclock_iter.cur);
+		PGPROC	   *proc = proclock->tag.myProc;
+
+		if (proc == checkProc || (proclock->holdMask & conflictMask) == 0)
+			continue;
+
+		/* let DeadLockCheck report it; see FindLockCycleRecurseMember */
+		if (checkProc == startProc && proc->statusFlags & PROC_IS_AUTOVACUUM)
+		{
+			result = true;
+			break;
+		}
+
+		if (PrecheckEdge(startProc, proc))
+		{
+			result = true;
+			break;
+		}
+	}
+
+	/* Soft edges: procs ahead of us in the queue with conflicting requests */
+	if (!result)
+	{
+		dclist_foreach(proc_iter, &lock->waitProcs)
+		{
+			PGPROC	   *proc = dlist_container(PGPROC, links, proc_iter.cur);
+
+			if (proc == checkProc)
+				break;
+
+			if ((LOCKBIT_ON(proc->waitLockMode) & conflictMask) != 0 &&
+				PrecheckEdge(startProc, proc))
+			{
+				result = true;
+				break;
+			}
+		}
+	}
+
+	LWLockRelease(partitionLock);
+
+	return result;
+}
+
+/*
+ * Handle a waits-for edge pointing at blocker.  Returns true if the full
+ * check is needed.
+ */
+static bool
+PrecheckEdge(PGPROC *startProc, PGPROC *blocker)
+{
+	int			procno;
+
+	if (blocker == startProc || blocker->lockGroupLeader != NULL)
+		return true;
+
+	procno = GetNumberFromPGProc(blocker);
+	if (!precheckVisited[procno])
+	{
+		precheckVisited[procno] = true;
+		precheckQueue[nPrecheckQueue++] = blocker;
+	}
+
+	return false;
+}
+
 /*
  * DeadLockCheck -- Checks for deadlocks for a given process
  *
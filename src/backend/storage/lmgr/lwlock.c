@@ -72,6 +72,19 @@
  *
  * This protects us against the problem from above as nobody can release too
  *	  quick, before we're queued, since after Phase 2 we're already queued.
+ *
+ *
+ * Even the uncontended CAS makes the cache line holding 'state' bounce
+ * between all CPUs taking a heavily-read lock in shared mode.  A small number
+ * of locks can therefore be turned into "big-reader" locks with
+ * LWLockMakeBigReader().  Each process owns one cache line of reader slots,
+ * with one counter per big-reader lock.  A shared locker increments its own
+ * counter, then checks that no exclusive lock is held or being acquired; if
+ * one is, it backs out and takes the regular path.  An exclusive locker sets
+ * LW_VAL_EXCLUSIVE as usual, which stops new fast-path readers, and then
+ * waits for every process' counter for the lock to drain to zero.  Shared
+ * acquisition thereby touches only process-local cache lines, at the price of
+ * exclusive acquisition having to look at one cache line per PGPROC.
  * -------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -105,6 +118,14 @@ extern slock_t *ShmemLock;
 /* Must be greater than MAX_BACKENDS - which is 2^23-1, so we're fine. */
 #define LW_SHARED_MASK				((uint32) ((1 << 24)-1))
 
+/*
+ * Big-reader locks keep their reader slot index, plus one, in these otherwise
+ * unused bits; zero means a regular lock.
+ */
+#define LW_BIGREADER_SHIFT			25
+#define LW_BIGREADER_MASK			((uint32) 7 << LW_BIGREADER_SHIFT)
+#define MAX_BIG_READER_LWLOCKS		7
+
 StaticAssertDecl(LW_VAL_EXCLUSIVE > (uint32) MAX_BACKENDS,
 				 "MAX_BACKENDS too big for lwlock.c");
 
@@ -169,6 +190,10 @@ static const char *const BuiltinTrancheNames[] = {
 	[LWTRANCHE_SUBTRANS_SLRU] = "SubtransSLRU",
 	[LWTRANCHE_XACT_SLRU] = "XactSLRU",
 	[LWTRANCHE_PARALLEL_VACUUM_DSA] = "ParallelVacuumDSA",
+	[LWTRANCHE_SECONDARY_BUFFER_CACHE] = "SecondaryBufferCache",
+	[LWTRANCHE_PARALLEL_MEMOIZE] = "ParallelMemoize",
+	[LWTRANCHE_QUERY_CACHE] = "QueryCache",
+	[LWTRANCHE_QUERY_CACHE_DSA] = "QueryCacheDSA",
 };
 
 StaticAssertDecl(lengthof(BuiltinTrancheNames) ==
@@ -203,11 +228,28 @@ typedef struct LWLockHandle
 {
 	LWLock	   *lock;
 	LWLockMode	mode;
+	bool		fastpath;		/* shared hold recorded in a reader slot */
 } LWLockHandle;
 
 static int	num_held_lwlocks = 0;
 static LWLockHandle held_lwlocks[MAX_SIMUL_LWLOCKS];
 
+/*
+ * Per-process reader slots for big-reader locks, indexed by ProcNumber.  Each
+ * process only ever modifies its own slot, which fills a whole cache line.
+ */
+typedef union LWLockReaderSlot
+{
+	pg_atomic_uint32 held[MAX_BIG_READER_LWLOCKS];
+	char		pad[PG_CACHE_LINE_SIZE];
+} LWLockReaderSlot;
+
+static LWLockReaderSlot *LWLockReaderSlots = NULL;
+static int	NumLWLockReaderSlots = 0;
+
+/* number of big-reader locks created so far; only used by the postmaster */
+static int	NumBigReaderLWLocks = 0;
+
 /* struct representing the LWLock tranche request for named tranche */
 typedef struct NamedLWLockTrancheRequest
 {
@@ -773,6 +815,156 @@ GetLWLockIdentifier(uint32 classId, uint16 eventId)
 	return GetLWTrancheName(eventId);
 }
 
+/*
+ * Compute shmem space needed for the reader slots of big-reader LWLocks.
+ */
+Size
+LWLockReaderSlotsShmemSize(void)
+{
+	return mul_size(MaxBackends + NUM_AUXILIARY_PROCS,
+					sizeof(LWLockReaderSlot));
+}
+
+/*
+ * Allocate and initialize, or attach to, the reader slots of big-reader
+ * LWLocks.
+ */
+void
+LWLockReaderSlotsShmemInit(void)
+{
+	bool		found;
+
+	NumLWLockReaderSlots = MaxBackends + NUM_AUXILIARY_PROCS;
+	LWLockReaderSlots = (LWLockReaderSlot *)
+		ShmemInitStruct("LWLock Reader Slots", LWLockReaderSlotsShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		for (int i = 0; i < NumLWLockReaderSlots; i++)
+			for (int j = 0; j < MAX_BIG_READER_LWLOCKS; j++)
+				pg_atomic_init_u32(&LWLockReaderSlots[i].held[j], 0);
+	}
+}
+
+/*
+ * LWLockMakeBigReader - turn an initialized, unlocked lwlock into a
+ * big-reader lock
+ *
+ * Shared acquisition of a big-reader lock does not write to the lock itself,
+ * which makes it scale to many concurrent readers, while exclusive
+ * acquisition becomes proportionally more expensive.  Only a few locks can be
+ * big-reader locks; returns false, leaving the lock unchanged, if the supply
+ * is exhausted.  Must be called while shared memory is being initialized.
+ */
+bool
+LWLockMakeBigReader(LWLock *lock)
+{
+	Assert(!IsUnderPostmaster);
+	Assert((pg_atomic_read_u32(&lock->state) &
+			(LW_LOCK_MASK | LW_BIGREADER_MASK)) == 0);
+
+	if (NumBigReaderLWLocks >= MAX_BIG_READER_LWLOCKS)
+		return false;
+
+	pg_atomic_fetch_or_u32(&lock->state,
+						   (uint32) (++NumBigReaderLWLocks) << LW_BIGREADER_SHIFT);
+	return true;
+}
+
+/*
+ * Return the pointer to my reader slot counter for a big-reader lock, or NULL
+ * if the lock isn't one or we don't have a slot.
+ */
+static inline pg_atomic_uint32 *
+LWLockMyReaderSlot(LWLock *lock)
+{
+	uint32		idx;
+
+	idx = (pg_atomic_read_u32(&lock->state) & LW_BIGREADER_MASK) >> LW_BIGREADER_SHIFT;
+	if (idx == 0 || MyProcNumber == INVALID_PROC_NUMBER ||
+		MyProcNumber >= NumLWLockReaderSlots)
+		return NULL;
+
+	return &LWLockReaderSlots[MyProcNumber].held[idx - 1];
+}
+
+/*
+ * Try to acquire a big-reader lock in shared mode without touching the lock's
+ * state.  Returns true on success; on failure, the caller has to fall back to
+ * the regular protocol.
+ */
+static inline bool
+LWLockAttemptLockFastPath(LWLock *lock)
+{
+	pg_atomic_uint32 *slot = LWLockMyReaderSlot(lock);
+
+	if (slot == NULL)
+		return false;
+
+	/*
+	 * Announce ourselves before looking at the lock state; the full barrier
+	 * implied by the atomic increment pairs with the one in the exclusive
+	 * locker's compare & exchange, so that at least one of us sees the other.
+	 */
+	pg_atomic_fetch_add_u32(slot, 1);
+
+	if ((pg_atomic_read_u32(&lock->state) & LW_VAL_EXCLUSIVE) == 0)
+		return true;
+
+	/* an exclusive locker is in, back out */
+	pg_atomic_fetch_sub_u32(slot, 1);
+	return false;
+}
+
+/*
+ * Wait for the fast-path readers of a big-reader lock that we have just
+ * acquired in exclusive mode to go away.  If 'nowait', return false instead
+ * of waiting when there are some.
+ */
+static bool
+LWLockDrainReaders(LWLock *lock, bool nowait)
+{
+	uint32		idx;
+	bool		waited = false;
+
+	idx = (pg_atomic_read_u32(&lock->state) & LW_BIGREADER_MASK) >> LW_BIGREADER_SHIFT;
+	if (idx == 0)
+		return true;
+
+	for (int i = 0; i < NumLWLockReaderSlots; i++)
+	{
+		pg_atomic_uint32 *slot = &LWLockReaderSlots[i].held[idx - 1];
+		SpinDelayStatus delayStatus;
+
+		if (pg_atomic_read_u32(slot) == 0)
+			continue;
+
+		if (nowait)
+			return false;
+
+		if (!waited)
+		{
+			LWLockReportWaitStart(lock);
+			waited = true;
+		}
+
+		/* readers hold the lock only briefly, so just spin */
+		init_local_spin_delay(&delayStatus);
+		while (pg_atomic_read_u32(slot) != 0)
+			perform_spin_delay(&delayStatus);
+		finish_spin_delay(&delayStatus);
+	}
+
+	if (waited)
+		LWLockReportWaitEnd();
+
+	/* don't let reads of the protected data move before the checks above */
+	pg_memory_barrier();
+
+	return true;
+}
+
 /*
  * Internal function that tries to atomically acquire the lwlock in the passed
  * in mode.
@@ -1208,6 +1400,19 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 	 */
 	HOLD_INTERRUPTS();
 
+	/* Share-lock big-reader locks without touching the lock, if possible */
+	if (mode == LW_SHARED && LWLockAttemptLockFastPath(lock))
+	{
+		LOG_LWDEBUG("LWLockAcquire", lock, "acquired in fast path");
+		if (TRACE_POSTGRESQL_LWLOCK_ACQUIRE_ENABLED())
+			TRACE_POSTGRESQL_LWLOCK_ACQUIRE(T_NAME(lock), mode);
+
+		held_lwlocks[num_held_lwlocks].lock = lock;
+		held_lwlocks[num_held_lwlocks].mode = mode;
+		held_lwlocks[num_held_lwlocks++].fastpath = true;
+		return true;
+	}
+
 	/*
 	 * Loop here to try to acquire lock after each time we are signaled by
 	 * LWLockRelease.
@@ -1314,12 +1519,17 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 		result = false;
 	}
 
+	/* Wait out any fast-path readers of a big-reader lock */
+	if (mode == LW_EXCLUSIVE)
+		LWLockDrainReaders(lock, false);
+
 	if (TRACE_POSTGRESQL_LWLOCK_ACQUIRE_ENABLED())
 		TRACE_POSTGRESQL_LWLOCK_ACQUIRE(T_NAME(lock), mode);
 
 	/* Add lock to list of locks held by this backend */
 	held_lwlocks[num_held_lwlocks].lock = lock;
-	held_lwlocks[num_held_lwlocks++].mode = mode;
+	held_lwlocks[num_held_lwlocks].mode = mode;
+	held_lwlocks[num_held_lwlocks++].fastpath = false;
 
 	/*
 	 * Fix the process wait semaphore's count for any absorbed wakeups.
@@ -1357,6 +1567,16 @@ LWLockConditionalAcquire(LWLock *lock, LWLockMode mode)
 	 */
 	HOLD_INTERRUPTS();
 
+	if (mode == LW_SHARED && LWLockAttemptLockFastPath(lock))
+	{
+		held_lwlocks[num_held_lwlocks].lock = lock;
+		held_lwlocks[num_held_lwlocks].mode = mode;
+		held_lwlocks[num_held_lwlocks++].fastpath = true;
+		if (TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE_ENABLED())
+			TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE(T_NAME(lock), mode);
+		return true;
+	}
+
 	/* Check for the lock */
 	mustwait = LWLockAttemptLock(lock, mode);
 
@@ -1373,7 +1593,22 @@ LWLockConditionalAcquire(LWLock *lock, LWLockMode mode)
 	{
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
-		held_lwlocks[num_held_lwlocks++].mode = mode;
+		held_lwlocks[num_held_lwlocks].mode = mode;
+		held_lwlocks[num_held_lwlocks++].fastpath = false;
+
+		/*
+		 * A big-reader lock isn't really ours while fast-path readers remain.
+		 * Rather than waiting for them, give the lock back.
+		 */
+		if (mode == LW_EXCLUSIVE && !LWLockDrainReaders(lock, true))
+		{
+			LWLockRelease(lock);
+			LOG_LWDEBUG("LWLockConditionalAcquire", lock, "failed, readers present");
+			if (TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE_FAIL_ENABLED())
+				TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE_FAIL(T_NAME(lock), mode);
+			return false;
+		}
+
 		if (TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE_ENABLED())
 			TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE(T_NAME(lock), mode);
 	}
@@ -1502,9 +1737,12 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 	else
 	{
 		LOG_LWDEBUG("LWLockAcquireOrWait", lock, "succeeded");
+		if (mode == LW_EXCLUSIVE)
+			LWLockDrainReaders(lock, false);
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
-		held_lwlocks[num_held_lwlocks++].mode = mode;
+		held_lwlocks[num_held_lwlocks].mode = mode;
+		held_lwlocks[num_held_lwlocks++].fastpath = false;
 		if (TRACE_POSTGRESQL_LWLOCK_ACQUIRE_OR_WAIT_ENABLED())
 			TRACE_POSTGRESQL_LWLOCK_ACQUIRE_OR_WAIT(T_NAME(lock), mode);
 	}
@@ -1783,6 +2021,7 @@ void
 LWLockRelease(LWLock *lock)
 {
 	LWLockMode	mode;
+	bool		fastpath;
 	uint32		oldstate;
 	bool		check_waiters;
 	int			i;
@@ -1799,6 +2038,7 @@ LWLockRelease(LWLock *lock)
 		elog(ERROR, "lock %s is not held", T_NAME(lock));
 
 	mode = held_lwlocks[i].mode;
+	fastpath = held_lwlocks[i].fastpath;
 
 	num_held_lwlocks--;
 	for (; i < num_held_lwlocks; i++)
@@ -1806,6 +2046,22 @@ LWLockRelease(LWLock *lock)
 
 	PRINT_LWDEBUG("LWLockRelease", lock, mode);
 
+	/*
+	 * A fast-path hold of a big-reader lock is just a count in our reader
+	 * slot.  An exclusive locker waiting for it is spinning, not sleeping, so
+	 * there is nobody to wake up.
+	 */
+	if (fastpath)
+	{
+		pg_atomic_fetch_sub_u32(LWLockMyReaderSlot(lock), 1);
+
+		if (TRACE_POSTGRESQL_LWLOCK_RELEASE_ENABLED())
+			TRACE_POSTGRESQL_LWLOCK_RELEASE(T_NAME(lock));
+
+		RESUME_INTERRUPTS();
+		return;
+	}
+
 	/*
 	 * Release my hold on lock, after that it can immediately be acquired by
 	 * others, even if we still have to wakeup other waiters.
@@ -430,6 +430,26 @@ static bool MyXactDidWrite = false;
  */
 static SERIALIZABLEXACT *SavedSerializableXact = InvalidSerializableXact;
 
+/*
+ * Number of serialization failures raised by this backend that have not yet
+ * been reported to the cumulative statistics system.  They are reported when
+ * the transaction's predicate locks are released, since we may be holding
+ * LWLocks at the point where the error is thrown.
+ */
+static int	MySerializationFailures = 0;
+
+/*
+ * A small direct-mapped filter of top-level xids that
+ * CheckForSerializableConflictOut() found to belong to neither an active
+ * nor a summarized serializable transaction.  Such an xid can never become
+ * one, so further tuples written by it need no conflict check, and in
+ * particular no trip through SerializableXactHashLock.  The filter is reset
+ * whenever a new serializable transaction begins.
+ */
+#define CONFLICT_OUT_FILTER_SIZE	64
+
+static TransactionId ConflictOutFilter[CONFLICT_OUT_FILTER_SIZE];
+
 /* local functions */
 
 static SERIALIZABLEXACT *CreatePredXact(void);
@@ -1916,6 +1936,7 @@ GetSerializableTransactionSnapshotInt(Snapshot snapshot,
 
 	LWLockRelease(SerializableXactHashLock);
 
+	memset(ConflictOutFilter, 0, sizeof(ConflictOutFilter));
 	CreateLocalPredicateLockHash();
 
 	return snapshot;
@@ -2355,6 +2376,7 @@ CheckAndPromotePredicateLockRequest(const PREDICATELOCKTARGETTAG *reqtag)
 	{
 		/* acquire coarsest ancestor eligible for promotion */
 		PredicateLockAcquire(&promotiontag);
+		pgstat_report_predicate_lock_promotion();
 		return true;
 	}
 	else
@@ -3315,6 +3337,12 @@ ReleasePredicateLocks(bool isCommit, bool isReadOnlySafe)
 	/* We can't be both committing and releasing early due to RO_SAFE. */
 	Assert(!(isCommit && isReadOnlySafe));
 
+	if (MySerializationFailures > 0)
+	{
+		pgstat_report_serialization_failures(MySerializationFailures);
+		MySerializationFailures = 0;
+	}
+
 	/* Are we at the end of a transaction, that is, a commit or abort? */
 	if (!isReadOnlySafe)
 	{
@@ -3981,6 +4009,7 @@ CheckForSerializableConflictOutNeeded(Relation relation, Snapshot snapshot)
 	/* Check if someone else has already decided that we need to die */
 	if (SxactIsDoomed(MySerializableXact))
 	{
+		MySerializationFailures++;
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4017,6 +4046,7 @@ CheckForSerializableConflictOut(Relation relation, TransactionId xid, Snapshot s
 	/* Check if someone else has already decided that we need to die */
 	if (SxactIsDoomed(MySerializableXact))
 	{
+		MySerializationFailures++;
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4028,6 +4058,11 @@ CheckForSerializableConflictOut(Relation relation, TransactionId xid, Snapshot s
 	if (TransactionIdEquals(xid, GetTopTransactionIdIfAny()))
 		return;
 
+	/* Already known not to be a serializable transaction? */
+	if (TransactionIdEquals(ConflictOutFilter[xid % CONFLICT_OUT_FILTER_SIZE],
+							xid))
+		return;
+
 	/*
 	 * Find sxact or summarized info for the top level xid.
 	 */
@@ -4050,22 +4085,30 @@ CheckForSerializableConflictOut(Relation relation, TransactionId xid, Snapshot s
 				&& (!SxactIsReadOnly(MySerializableXact)
 					|| conflictCommitSeqNo
 					<= MySerializableXact->SeqNo.lastCommitBeforeSnapshot))
+			{
+				MySerializationFailures++;
 				ereport(ERROR,
 						(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 						 errmsg("could not serialize access due to read/write dependencies among transactions"),
 						 errdetail_internal("Reason code: Canceled on conflict out to old pivot %u.", xid),
 						 errhint("The transaction might succeed if retried.")));
+			}
 
 			if (SxactHasSummaryConflictIn(MySerializableXact)
 				|| !dlist_is_empty(&MySerializableXact->inConflicts))
+			{
+				MySerializationFailures++;
 				ereport(ERROR,
 						(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 						 errmsg("could not serialize access due to read/write dependencies among transactions"),
 						 errdetail_internal("Reason code: Canceled on identification as a pivot, with conflict out to old committed transaction %u.", xid),
 						 errhint("The transaction might succeed if retried.")));
+			}
 
 			MySerializableXact->flags |= SXACT_FLAG_SUMMARY_CONFLICT_OUT;
 		}
+		else
+			ConflictOutFilter[xid % CONFLICT_OUT_FILTER_SIZE] = xid;
 
 		/* It's not serializable or otherwise not important. */
 		LWLockRelease(SerializableXactHashLock);
@@ -4097,6 +4140,7 @@ CheckForSerializableConflictOut(Relation relation, TransactionId xid, Snapshot s
 		else
 		{
 			LWLockRelease(SerializableXactHashLock);
+			MySerializationFailures++;
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4327,11 +4371,14 @@ CheckForSerializableConflictIn(Relation relation, ItemPointer tid, BlockNumber b
 
 	/* Check if someone else has already decided that we need to die */
 	if (SxactIsDoomed(MySerializableXact))
+	{
+		MySerializationFailures++;
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
 				 errdetail_internal("Reason code: Canceled on identification as a pivot, during conflict in checking."),
 				 errhint("The transaction might succeed if retried.")));
+	}
 
 	/*
 	 * We're doing a write which might cause rw-conflicts now or later.
@@ -4646,6 +4693,7 @@ OnConflict_CheckForSerializationFailure(const SERIALIZABLEXACT *reader,
 		if (MySerializableXact == writer)
 		{
 			LWLockRelease(SerializableXactHashLock);
+			MySerializationFailures++;
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4658,6 +4706,7 @@ OnConflict_CheckForSerializationFailure(const SERIALIZABLEXACT *reader,
 
 			/* if we're not the writer, we have to be the reader */
 			Assert(MySerializableXact == reader);
+			MySerializationFailures++;
 			ereport(ERROR,
 					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 					 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4705,6 +4754,7 @@ PreCommit_CheckForSerializationFailure(void)
 		!SxactIsPartiallyReleased(MySerializableXact))
 	{
 		LWLockRelease(SerializableXactHashLock);
+		MySerializationFailures++;
 		ereport(ERROR,
 				(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 				 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -4741,6 +4791,7 @@ PreCommit_CheckForSerializationFailure(void)
 					if (SxactIsPrepared(nearConflict->sxactOut))
 					{
 						LWLockRelease(SerializableXactHashLock);
+						MySerializationFailures++;
 						ereport(ERROR,
 								(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
 								 errmsg("could not serialize access due to read/write dependencies among transactions"),
@@ -61,6 +61,7 @@ int			IdleInTransactionSessionTimeout = 0;
 int			TransactionTimeout = 0;
 int			IdleSessionTimeout = 0;
 bool		log_lock_waits = false;
+int			max_cached_subxids = PGPROC_MIN_CACHED_SUBXIDS;
 
 /* Pointer to this process's PGPROC struct, if any */
 PGPROC	   *MyProc = NULL;
@@ -93,6 +94,39 @@ static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
 
 
+/*
+ * Report shared-memory space needed by the fast-path lock arrays of each
+ * PGPROC, which are allocated separately since their size depends on
+ * max_locks_per_transaction.
+ */
+static Size
+FastPathLockShmemSize(void)
+{
+	Size		TotalProcs =
+		add_size(MaxBackends, add_size(NUM_AUXILIARY_PROCS, max_prepared_xacts));
+	Size		fpLockBitsSize;
+	Size		fpRelIdSize;
+
+	fpLockBitsSize = MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64));
+	fpRelIdSize = MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+
+	return mul_size(TotalProcs, add_size(fpLockBitsSize, fpRelIdSize));
+}
+
+/*
+ * Report shared-memory space needed by the subtransaction XID caches of each
+ * PGPROC, whose size is set by max_cached_subxids.
+ */
+static Size
+SubxidCacheShmemSize(void)
+{
+	Size		TotalProcs =
+		add_size(MaxBackends, add_size(NUM_AUXILIARY_PROCS, max_prepared_xacts));
+
+	return mul_size(TotalProcs,
+					MAXALIGN(mul_size(max_cached_subxids, sizeof(TransactionId))));
+}
+
 /*
  * Report shared-memory space needed by InitProcGlobal.
  */
@@ -112,6 +146,9 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->subxidStates)));
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->statusFlags)));
 
+	size = add_size(size, FastPathLockShmemSize());
+	size = add_size(size, SubxidCacheShmemSize());
+
 	return size;
 }
 
@@ -161,6 +198,11 @@ InitProcGlobal(void)
 				j;
 	bool		found;
 	uint32		TotalProcs = MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts;
+	char	   *fpPtr;
+	Size		fpLockBitsSize;
+	Size		fpRelIdSize;
+	char	   *subxidPtr;
+	Size		subxidSize;
 
 	/* Create the ProcGlobal shared structure */
 	ProcGlobal = (PROC_HDR *)
@@ -190,6 +232,7 @@ InitProcGlobal(void)
 	 * between groups.
 	 */
 	procs = (PGPROC *) ShmemAlloc(TotalProcs * sizeof(PGPROC));
+	ShmemNumaInterleave(procs, TotalProcs * sizeof(PGPROC));
 	MemSet(procs, 0, TotalProcs * sizeof(PGPROC));
 	ProcGlobal->allProcs = procs;
 	/* XXX allProcCount isn't really all of them; it excludes prepared xacts */
@@ -210,12 +253,31 @@ InitProcGlobal(void)
 	ProcGlobal->statusFlags = (uint8 *) ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->statusFlags));
 	MemSet(ProcGlobal->statusFlags, 0, TotalProcs * sizeof(*ProcGlobal->statusFlags));
 
+	/* Allocate the fast-path lock arrays, carved up per PGPROC below. */
+	fpPtr = ShmemAlloc(FastPathLockShmemSize());
+	MemSet(fpPtr, 0, FastPathLockShmemSize());
+
+	fpLockBitsSize = MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64));
+	fpRelIdSize = MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+
+	/* Likewise the subtransaction XID caches. */
+	subxidPtr = ShmemAlloc(SubxidCacheShmemSize());
+	subxidSize = MAXALIGN(max_cached_subxids * sizeof(TransactionId));
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		PGPROC	   *proc = &procs[i];
 
 		/* Common initialization for all PGPROCs, regardless of type. */
 
+		proc->fpLockBits = (uint64 *) fpPtr;
+		fpPtr += fpLockBitsSize;
+		proc->fpRelId = (Oid *) fpPtr;
+		fpPtr += fpRelIdSize;
+
+		proc->subxids.xids = (TransactionId *) subxidPtr;
+		subxidPtr += subxidSize;
+
 		/*
 		 * Set up per-PGPROC semaphore, latch, and fpInfoLock.  Prepared xact
 		 * dummy PGPROCs don't need these though - they're never associated
@@ -427,6 +489,7 @@ InitProcess(void)
 
 	/* Initialize wait event information. */
 	MyProc->wait_event_info = 0;
+	MyProc->exec_node_info = 0;
 
 	/* Initialize fields for group transaction status update. */
 	MyProc->clogGroupMember = false;
@@ -1754,6 +1817,24 @@ static void
 CheckDeadLock(void)
 {
 	int			i;
+	instr_time	start;
+	instr_time	duration;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	/*
+	 * Locking the entire lock table stops all lock traffic, so first see
+	 * whether we can tell that there's no deadlock more cheaply.
+	 */
+	if (!DeadLockPrecheck(MyProc))
+	{
+		deadlock_state = DS_NO_DEADLOCK;
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		pgstat_report_deadlock_check(false, INSTR_TIME_GET_MICROSEC(duration));
+		return;
+	}
 
 	/*
 	 * Acquire exclusive lock on the entire shared lock data structures. Must
@@ -1829,6 +1910,10 @@ CheckDeadLock(void)
 check_done:
 	for (i = NUM_LOCK_PARTITIONS; --i >= 0;)
 		LWLockRelease(LockHashPartitionLockByIndex(i));
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	pgstat_report_deadlock_check(true, INSTR_TIME_GET_MICROSEC(duration));
 }
 
 /*
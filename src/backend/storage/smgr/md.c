@@ -31,6 +31,7 @@
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/md.h"
@@ -917,6 +918,48 @@ mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	}
 }
 
+/*
+ * mdstartreadv() -- Start an asynchronous read of the specified blocks.
+ *
+ * The read covers at most the blocks up to the end of the segment file that
+ * contains blocknum.  Returns the number of blocks it covers, to be waited
+ * for with pgaio_wait(handle).  Returns 0 if the read could not be started,
+ * in which case the caller still owns the handle and should use mdreadv().
+ */
+BlockNumber
+mdstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 void **buffers, BlockNumber nblocks, int handle)
+{
+	struct iovec iov[PG_IOV_MAX];
+	int			iovcnt;
+	off_t		seekpos;
+	int			fd;
+	MdfdVec    *v;
+	BlockNumber nblocks_this_segment;
+
+	v = _mdfd_getseg(reln, forknum, blocknum, false,
+					 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+	nblocks_this_segment =
+		Min(nblocks,
+			RELSEG_SIZE - (blocknum % ((BlockNumber) RELSEG_SIZE)));
+	nblocks_this_segment = Min(nblocks_this_segment, lengthof(iov));
+
+	fd = FileGetRawDesc(v->mdfd_vfd);
+	if (fd < 0)
+		return 0;
+
+	iovcnt = buffers_to_iovec(iov, buffers, nblocks_this_segment);
+	if (!pgaio_start_readv(handle, fd, iov, iovcnt, seekpos))
+		return 0;
+
+	return nblocks_this_segment;
+}
+
 /*
  * mdwritev() -- Write the supplied blocks at the appropriate location.
  *
@@ -1779,6 +1822,26 @@ mdsyncfiletag(const FileTag *ftag, char *path)
 	return result;
 }
 
+/*
+ * Open a file given a file tag, for a caller that wants to sync it by other
+ * means than mdsyncfiletag().  The path is written into an output buffer as
+ * there.  The caller must close the returned file.
+ *
+ * Return the file on success, -1 on failure, with errno set.
+ */
+File
+mdopenfiletag(const FileTag *ftag, char *path)
+{
+	SMgrRelation reln = smgropen(ftag->rlocator, INVALID_PROC_NUMBER);
+	char	   *p;
+
+	p = _mdfd_segpath(reln, ftag->forknum, ftag->segno);
+	strlcpy(path, p, MAXPGPATH);
+	pfree(p);
+
+	return PathNameOpenFile(path, _mdfd_open_flags());
+}
+
 /*
  * Unlink a file, given a file tag.  Write the path into an output
  * buffer so the caller can use it in error messages.
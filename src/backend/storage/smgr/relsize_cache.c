@@ -0,0 +1,367 @@
+/*-------------------------------------------------------------------------
+ *
+ * relsize_cache.c
+ *	  shared cache of relation fork sizes
+ *
+ * smgrnblocks() has to ask the kernel for the size of every segment of a
+ * relation fork, which costs one lseek() per segment.  Outside recovery the
+ * result could not be cached even within one backend, because nothing told
+ * other backends when a relation was extended.  This module keeps the size
+ * of recently used relation forks in shared memory instead, where every
+ * process that changes the size of a fork updates it.
+ *
+ * The cache is a set-associative table: a fork's key hashes to one bucket
+ * of RELSIZE_CACHE_WAYS entries, protected by a spinlock.  A full bucket
+ * evicts one of its entries with a small clock sweep.  Losing an entry is
+ * always harmless, since the next lookup simply asks the kernel again.
+ *
+ * Entries must never claim a size that is older than the file.  Extension
+ * and truncation go through smgr.c, which stores the new size once the file
+ * has been changed.  A backend that misses in the cache first installs a
+ * placeholder entry, then asks the kernel, and stores the result only if
+ * nobody has touched the entry in the meantime; each change to an entry
+ * gives it a new version number so that this can be checked.  A concurrent
+ * extension or truncation therefore always wins over a size read from the
+ * kernel before it happened.
+ *
+ * Dropped relations and databases have their entries removed, so that a
+ * reused relfilenumber starts afresh.  Temporary relations are not cached,
+ * since no other backend can see them.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/smgr/relsize_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "common/hashfn.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+
+#define RELSIZE_CACHE_WAYS		4
+
+typedef struct RelSizeCacheEntry
+{
+	RelFileLocator rlocator;
+	ForkNumber	forknum;		/* InvalidForkNumber if the entry is unused */
+	BlockNumber nblocks;		/* InvalidBlockNumber while being filled */
+	uint32		version;		/* bumped by every change of the entry */
+	bool		recently_used;	/* clock sweep reference bit */
+} RelSizeCacheEntry;
+
+typedef struct RelSizeCacheBucket
+{
+	slock_t		mutex;			/* protects the fields below */
+	uint32		next_version;
+	int			clock_hand;
+	RelSizeCacheEntry ways[RELSIZE_CACHE_WAYS];
+} RelSizeCacheBucket;
+
+/* GUC variable: number of relation forks the cache can hold */
+int			relation_size_cache_size = 4096;
+
+static RelSizeCacheBucket *RelSizeCache = NULL;
+static int	RelSizeCacheNumBuckets = 0;
+
+static inline int
+RelSizeCacheBucketCount(void)
+{
+	return (relation_size_cache_size + RELSIZE_CACHE_WAYS - 1) /
+		RELSIZE_CACHE_WAYS;
+}
+
+/*
+ * Report shared-memory space needed by RelSizeCacheShmemInit.
+ */
+Size
+RelSizeCacheShmemSize(void)
+{
+	return mul_size(RelSizeCacheBucketCount(), sizeof(RelSizeCacheBucket));
+}
+
+/*
+ * Initialize the shared relation size cache during postmaster startup.
+ */
+void
+RelSizeCacheShmemInit(void)
+{
+	bool		found;
+	int			nbuckets = RelSizeCacheBucketCount();
+
+	if (nbuckets == 0)
+		return;
+
+	RelSizeCache = (RelSizeCacheBucket *)
+		ShmemInitStruct("Shared Relation Size Cache",
+						RelSizeCacheShmemSize(), &found);
+	RelSizeCacheNumBuckets = nbuckets;
+
+	if (!found)
+	{
+		for (int i = 0; i < nbuckets; i++)
+		{
+			RelSizeCacheBucket *bucket = &RelSizeCache[i];
+
+			SpinLockInit(&bucket->mutex);
+			bucket->next_version = 1;
+			bucket->clock_hand = 0;
+			for (int j = 0; j < RELSIZE_CACHE_WAYS; j++)
+				bucket->ways[j].forknum = InvalidForkNumber;
+		}
+	}
+}
+
+/*
+ * Return the bucket for the given fork, or NULL if it cannot be cached.
+ */
+static RelSizeCacheBucket *
+RelSizeCacheGetBucket(RelFileLocatorBackend rlocator, ForkNumber forknum)
+{
+	uint32		hash;
+
+	if (RelSizeCache == NULL || RelFileLocatorBackendIsTemp(rlocator))
+		return NULL;
+
+	hash = hash_bytes((const unsigned char *) &rlocator.locator,
+					  sizeof(RelFileLocator));
+	hash = hash_combine(hash, (uint32) forknum);
+
+	return &RelSizeCache[hash % RelSizeCacheNumBuckets];
+}
+
+/*
+ * Find the entry for the given fork in a bucket whose lock we hold.
+ */
+static RelSizeCacheEntry *
+RelSizeCacheFindEntry(RelSizeCacheBucket *bucket, const RelFileLocator *rlocator,
+					  ForkNumber forknum)
+{
+	for (int i = 0; i < RELSIZE_CACHE_WAYS; i++)
+	{
+		RelSizeCacheEntry *entry = &bucket->ways[i];
+
+		if (entry->forknum == forknum &&
+			RelFileLocatorEquals(entry->rlocator, *rlocator))
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * Claim an entry for the given fork in a bucket whose lock we hold,
+ * evicting another fork's entry if the bucket is full.
+ */
+static RelSizeCacheEntry *
+RelSizeCacheClaimEntry(RelSizeCacheBucket *bucket, const RelFileLocator *rlocator,
+					   ForkNumber forknum)
+{
+	RelSizeCacheEntry *entry = NULL;
+
+	for (int i = 0; i < RELSIZE_CACHE_WAYS; i++)
+	{
+		if (bucket->ways[i].forknum == InvalidForkNumber)
+		{
+			entry = &bucket->ways[i];
+			break;
+		}
+	}
+
+	/* no free entry; run the clock hand until it finds an unused one */
+	while (entry == NULL)
+	{
+		RelSizeCacheEntry *victim = &bucket->ways[bucket->clock_hand];
+
+		bucket->clock_hand = (bucket->clock_hand + 1) % RELSIZE_CACHE_WAYS;
+		if (victim->recently_used)
+			victim->recently_used = false;
+		else
+			entry = victim;
+	}
+
+	entry->rlocator = *rlocator;
+	entry->forknum = forknum;
+	entry->nblocks = InvalidBlockNumber;
+	entry->recently_used = true;
+
+	return entry;
+}
+
+/*
+ * RelSizeCacheLookup
+ *		Return the cached size of a relation fork, or InvalidBlockNumber
+ *
+ * On a miss, *token is set to a value to be passed to RelSizeCacheFill()
+ * together with the size that the caller then obtains from the storage
+ * manager, or to zero if the fork cannot be cached.
+ */
+BlockNumber
+RelSizeCacheLookup(RelFileLocatorBackend rlocator, ForkNumber forknum,
+				   uint32 *token)
+{
+	RelSizeCacheBucket *bucket;
+	RelSizeCacheEntry *entry;
+	BlockNumber result = InvalidBlockNumber;
+
+	*token = 0;
+
+	bucket = RelSizeCacheGetBucket(rlocator, forknum);
+	if (bucket == NULL)
+		return InvalidBlockNumber;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = RelSizeCacheFindEntry(bucket, &rlocator.locator, forknum);
+	if (entry != NULL && entry->nblocks != InvalidBlockNumber)
+	{
+		entry->recently_used = true;
+		result = entry->nblocks;
+	}
+	else
+	{
+		/* install a placeholder, unless another backend already did */
+		if (entry == NULL)
+		{
+			entry = RelSizeCacheClaimEntry(bucket, &rlocator.locator, forknum);
+			entry->version = bucket->next_version++;
+			if (bucket->next_version == 0)
+				bucket->next_version = 1;
+		}
+		*token = entry->version;
+	}
+	SpinLockRelease(&bucket->mutex);
+
+	return result;
+}
+
+/*
+ * RelSizeCacheFill
+ *		Store a size obtained from the storage manager after a cache miss
+ *
+ * The size is stored only if the placeholder installed by RelSizeCacheLookup()
+ * is still there; if the fork was extended or truncated in the meantime, the
+ * entry already holds a size at least as new as ours.
+ */
+void
+RelSizeCacheFill(RelFileLocatorBackend rlocator, ForkNumber forknum,
+				 uint32 token, BlockNumber nblocks)
+{
+	RelSizeCacheBucket *bucket;
+	RelSizeCacheEntry *entry;
+
+	if (token == 0)
+		return;
+
+	bucket = RelSizeCacheGetBucket(rlocator, forknum);
+	if (bucket == NULL)
+		return;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = RelSizeCacheFindEntry(bucket, &rlocator.locator, forknum);
+	if (entry != NULL && entry->version == token &&
+		entry->nblocks == InvalidBlockNumber)
+		entry->nblocks = nblocks;
+	SpinLockRelease(&bucket->mutex);
+}
+
+/*
+ * RelSizeCacheUpdate
+ *		Record the new size of a relation fork after extending or truncating it
+ *
+ * With extended = true, the fork is known to be at least nblocks long, and a
+ * larger cached size is kept.  Otherwise nblocks is the exact new size.
+ */
+void
+RelSizeCacheUpdate(RelFileLocatorBackend rlocator, ForkNumber forknum,
+				   BlockNumber nblocks, bool extended)
+{
+	RelSizeCacheBucket *bucket;
+	RelSizeCacheEntry *entry;
+
+	bucket = RelSizeCacheGetBucket(rlocator, forknum);
+	if (bucket == NULL)
+		return;
+
+	SpinLockAcquire(&bucket->mutex);
+	entry = RelSizeCacheFindEntry(bucket, &rlocator.locator, forknum);
+	if (entry == NULL)
+		entry = RelSizeCacheClaimEntry(bucket, &rlocator.locator, forknum);
+	if (!extended || entry->nblocks == InvalidBlockNumber ||
+		entry->nblocks < nblocks)
+		entry->nblocks = nblocks;
+	entry->version = bucket->next_version++;
+	if (bucket->next_version == 0)
+		bucket->next_version = 1;
+	SpinLockRelease(&bucket->mutex);
+}
+
+/*
+ * RelSizeCacheForget
+ *		Remove the cached size of one fork, or of all forks if forknum is
+ *		InvalidForkNumber
+ */
+void
+RelSizeCacheForget(RelFileLocatorBackend rlocator, ForkNumber forknum)
+{
+	ForkNumber	first = forknum;
+	ForkNumber	last = forknum;
+
+	if (forknum == InvalidForkNumber)
+	{
+		first = 0;
+		last = MAX_FORKNUM;
+	}
+
+	for (ForkNumber fork = first; fork <= last; fork++)
+	{
+		RelSizeCacheBucket *bucket;
+		RelSizeCacheEntry *entry;
+
+		bucket = RelSizeCacheGetBucket(rlocator, fork);
+		if (bucket == NULL)
+			return;
+
+		SpinLockAcquire(&bucket->mutex);
+		entry = RelSizeCacheFindEntry(bucket, &rlocator.locator, fork);
+		if (entry != NULL)
+		{
+			entry->forknum = InvalidForkNumber;
+			entry->recently_used = false;
+		}
+		SpinLockRelease(&bucket->mutex);
+	}
+}
+
+/*
+ * RelSizeCacheForgetDatabase
+ *		Remove the cached sizes of all relations of a database
+ *
+ * This scans the whole cache, but is only used when a database's files are
+ * removed or moved in bulk.
+ */
+void
+RelSizeCacheForgetDatabase(Oid dbid)
+{
+	for (int i = 0; i < RelSizeCacheNumBuckets; i++)
+	{
+		RelSizeCacheBucket *bucket = &RelSizeCache[i];
+
+		SpinLockAcquire(&bucket->mutex);
+		for (int j = 0; j < RELSIZE_CACHE_WAYS; j++)
+		{
+			RelSizeCacheEntry *entry = &bucket->ways[j];
+
+			if (entry->forknum != InvalidForkNumber &&
+				entry->rlocator.dbOid == dbid)
+			{
+				entry->forknum = InvalidForkNumber;
+				entry->recently_used = false;
+			}
+		}
+		SpinLockRelease(&bucket->mutex);
+	}
+}
@@ -91,6 +91,10 @@ typedef struct f_smgr
 	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
 							   BlockNumber blocknum,
 							   void **buffers, BlockNumber nblocks);
+	BlockNumber (*smgr_startreadv) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum,
+									void **buffers, BlockNumber nblocks,
+									int handle);
 	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
 								BlockNumber blocknum,
 								const void **buffers, BlockNumber nblocks,
@@ -118,6 +122,7 @@ static const f_smgr smgrsw[] = {
 		.smgr_zeroextend = mdzeroextend,
 		.smgr_prefetch = mdprefetch,
 		.smgr_readv = mdreadv,
+		.smgr_startreadv = mdstartreadv,
 		.smgr_writev = mdwritev,
 		.smgr_writeback = mdwriteback,
 		.smgr_nblocks = mdnblocks,
@@ -227,6 +232,8 @@ smgropen(RelFileLocator rlocator, ProcNumber backend)
 	{
 		/* hash_search already filled in the lookup key */
 		reln->smgr_targblock = InvalidBlockNumber;
+		reln->smgr_reserved_next = InvalidBlockNumber;
+		reln->smgr_reserved_last = InvalidBlockNumber;
 		for (int i = 0; i <= MAX_FORKNUM; ++i)
 			reln->smgr_cached_nblocks[i] = InvalidBlockNumber;
 		reln->smgr_which = 0;	/* we only have md.c at present */
@@ -305,6 +312,8 @@ smgrrelease(SMgrRelation reln)
 		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
 	}
 	reln->smgr_targblock = InvalidBlockNumber;
+	reln->smgr_reserved_next = InvalidBlockNumber;
+	reln->smgr_reserved_last = InvalidBlockNumber;
 }
 
 /*
@@ -410,6 +419,9 @@ smgrexists(SMgrRelation reln, ForkNumber forknum)
 void
 smgrcreate(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 {
+	/* a stale size must not survive into a new incarnation of the fork */
+	RelSizeCacheForget(reln->smgr_rlocator, forknum);
+
 	smgrsw[reln->smgr_which].smgr_create(reln, forknum, isRedo);
 }
 
@@ -516,6 +528,8 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 
 		for (forknum = 0; forknum <= MAX_FORKNUM; forknum++)
 			smgrsw[which].smgr_unlink(rlocators[i], forknum, isRedo);
+
+		RelSizeCacheForget(rlocators[i], InvalidForkNumber);
 	}
 
 	pfree(rlocators);
@@ -547,6 +561,8 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		reln->smgr_cached_nblocks[forknum] = blocknum + 1;
 	else
 		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+
+	RelSizeCacheUpdate(reln->smgr_rlocator, forknum, blocknum + 1, true);
 }
 
 /*
@@ -572,6 +588,8 @@ smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		reln->smgr_cached_nblocks[forknum] = blocknum + nblocks;
 	else
 		reln->smgr_cached_nblocks[forknum] = InvalidBlockNumber;
+
+	RelSizeCacheUpdate(reln->smgr_rlocator, forknum, blocknum + nblocks, true);
 }
 
 /*
@@ -604,6 +622,24 @@ smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 										nblocks);
 }
 
+/*
+ * smgrstartreadv() -- start an asynchronous read of a particular block range
+ *					   from a relation into the supplied buffers.
+ *
+ * handle must have been obtained with pgaio_acquire().  Returns the number of
+ * blocks covered by the read, which may be fewer than requested, or 0 if no
+ * read was started; in that case the caller still owns the handle, and
+ * should fall back to smgrreadv().  The buffers must not be accessed until
+ * pgaio_wait() has returned.
+ */
+BlockNumber
+smgrstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   void **buffers, BlockNumber nblocks, int handle)
+{
+	return smgrsw[reln->smgr_which].smgr_startreadv(reln, forknum, blocknum,
+													buffers, nblocks, handle);
+}
+
 /*
  * smgrwritev() -- Write the supplied buffers out.
  *
@@ -655,15 +691,22 @@ BlockNumber
 smgrnblocks(SMgrRelation reln, ForkNumber forknum)
 {
 	BlockNumber result;
+	uint32		token;
 
 	/* Check and return if we get the cached value for the number of blocks. */
 	result = smgrnblocks_cached(reln, forknum);
 	if (result != InvalidBlockNumber)
 		return result;
 
+	/* Then try the shared cache, which is valid outside recovery too. */
+	result = RelSizeCacheLookup(reln->smgr_rlocator, forknum, &token);
+	if (result != InvalidBlockNumber)
+		return result;
+
 	result = smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
 
 	reln->smgr_cached_nblocks[forknum] = result;
+	RelSizeCacheFill(reln->smgr_rlocator, forknum, token, result);
 
 	return result;
 }
@@ -727,6 +770,7 @@ smgrtruncate(SMgrRelation reln, ForkNumber *forknum, int nforks, BlockNumber *nb
 	{
 		/* Make the cached size is invalid if we encounter an error. */
 		reln->smgr_cached_nblocks[forknum[i]] = InvalidBlockNumber;
+		RelSizeCacheForget(reln->smgr_rlocator, forknum[i]);
 
 		smgrsw[reln->smgr_which].smgr_truncate(reln, forknum[i], nblocks[i]);
 
@@ -738,6 +782,7 @@ smgrtruncate(SMgrRelation reln, ForkNumber *forknum, int nforks, BlockNumber *nb
 		 * But these ensure they aren't outright wrong until then.
 		 */
 		reln->smgr_cached_nblocks[forknum[i]] = nblocks[i];
+		RelSizeCacheUpdate(reln->smgr_rlocator, forknum[i], nblocks[i], false);
 	}
 }
 
@@ -26,6 +26,7 @@
 #include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/fd.h"
 #include "storage/latch.h"
 #include "storage/md.h"
@@ -58,6 +59,7 @@ typedef struct
 	FileTag		tag;			/* identifies handler and file */
 	CycleCtr	cycle_ctr;		/* sync_cycle_ctr of oldest request */
 	bool		canceled;		/* canceled is true if we canceled "recently" */
+	bool		fsync_started;	/* asynchronous fsync issued in this cycle */
 } PendingFsyncEntry;
 
 typedef struct
@@ -74,6 +76,33 @@ static MemoryContext pendingOpsCxt; /* context for the above  */
 static CycleCtr sync_cycle_ctr = 0;
 static CycleCtr checkpoint_cycle_ctr = 0;
 
+/*
+ * With checkpoint_sync_concurrency > 1, ProcessSyncRequests() submits the
+ * fsyncs of relation segments through the asynchronous I/O layer and keeps
+ * up to that many of them in flight, so that the kernel can flush files on
+ * different devices or tablespaces at the same time.  Entries whose fsync has
+ * been submitted are marked fsync_started and removed from pendingOps only
+ * at the end of the pass.  A request absorbed for such an entry in the
+ * meantime may describe a write that the fsync did not cover, so
+ * RememberSyncRequest() treats it as new, and the entry is kept for the next
+ * cycle.
+ */
+typedef struct InFlightFsync
+{
+	PendingFsyncEntry *entry;
+	File		file;
+	int			handle;
+	instr_time	start;
+	char		path[MAXPGPATH];
+} InFlightFsync;
+
+static InFlightFsync *inFlightFsyncs = NULL;	/* ring of PGAIO_MAX_IN_FLIGHT */
+static int	inFlightHead = 0;
+static int	numInFlightFsyncs = 0;
+
+/* GUC variable */
+int			checkpoint_sync_concurrency = 1;
+
 /* Intervals for calling AbsorbSyncRequests */
 #define FSYNCS_PER_ABSORB		10
 #define UNLINKS_PER_ABSORB		10
@@ -87,6 +116,7 @@ typedef struct SyncOps
 	int			(*sync_unlinkfiletag) (const FileTag *ftag, char *path);
 	bool		(*sync_filetagmatches) (const FileTag *ftag,
 										const FileTag *candidate);
+	File		(*sync_openfiletag) (const FileTag *ftag, char *path);
 } SyncOps;
 
 /*
@@ -97,7 +127,8 @@ static const SyncOps syncsw[] = {
 	[SYNC_HANDLER_MD] = {
 		.sync_syncfiletag = mdsyncfiletag,
 		.sync_unlinkfiletag = mdunlinkfiletag,
-		.sync_filetagmatches = mdfiletagmatches
+		.sync_filetagmatches = mdfiletagmatches,
+		.sync_openfiletag = mdopenfiletag
 	},
 	/* pg_xact */
 	[SYNC_HANDLER_CLOG] = {
@@ -279,6 +310,101 @@ SyncPostCheckpoint(void)
 	}
 }
 
+/*
+ * Try to start an asynchronous fsync of the file that entry identifies.
+ * Returns false if it should be synced synchronously instead, for example
+ * because its handler cannot open it for us or the file could not be opened.
+ */
+static bool
+SyncStartAsync(PendingFsyncEntry *entry)
+{
+	InFlightFsync *inflight;
+	int			handle;
+	File		file;
+
+	if (syncsw[entry->tag.handler].sync_openfiletag == NULL)
+		return false;
+
+	handle = pgaio_acquire();
+	if (handle < 0)
+		return false;
+
+	inflight = &inFlightFsyncs[(inFlightHead + numInFlightFsyncs) %
+							   PGAIO_MAX_IN_FLIGHT];
+	file = syncsw[entry->tag.handler].sync_openfiletag(&entry->tag,
+													   inflight->path);
+	if (file < 0)
+	{
+		pgaio_release(handle);
+		return false;
+	}
+
+	INSTR_TIME_SET_CURRENT(inflight->start);
+	if (!pgaio_start_fsync(handle, FileGetRawDesc(file)))
+	{
+		pgaio_release(handle);
+		FileClose(file);
+		return false;
+	}
+
+	inflight->entry = entry;
+	inflight->file = file;
+	inflight->handle = handle;
+	numInFlightFsyncs++;
+	entry->fsync_started = true;
+
+	return true;
+}
+
+/*
+ * Wait for the oldest asynchronous fsync, and update the statistics of
+ * ProcessSyncRequests() like a synchronous one would.
+ */
+static void
+SyncFinishOldest(int *processed, uint64 *longest, uint64 *total_elapsed)
+{
+	InFlightFsync *inflight = &inFlightFsyncs[inFlightHead];
+	ssize_t		result;
+	instr_time	sync_end;
+	uint64		elapsed;
+
+	Assert(numInFlightFsyncs > 0);
+
+	result = pgaio_wait_for(inflight->handle, WAIT_EVENT_DATA_FILE_SYNC);
+	FileClose(inflight->file);
+	inFlightHead = (inFlightHead + 1) % PGAIO_MAX_IN_FLIGHT;
+	numInFlightFsyncs--;
+
+	/* An error doesn't matter if the file has been unlinked meanwhile */
+	if (inflight->entry->canceled)
+		return;
+	if (result < 0)
+	{
+		errno = -result;
+		ereport(data_sync_elevel(ERROR),
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m",
+						inflight->path)));
+	}
+
+	pgstat_count_io_op_time(IOOBJECT_RELATION, IOCONTEXT_NORMAL,
+							IOOP_FSYNC, inflight->start, 1);
+
+	INSTR_TIME_SET_CURRENT(sync_end);
+	INSTR_TIME_SUBTRACT(sync_end, inflight->start);
+	elapsed = INSTR_TIME_GET_MICROSEC(sync_end);
+	if (elapsed > *longest)
+		*longest = elapsed;
+	*total_elapsed += elapsed;
+	(*processed)++;
+
+	if (log_checkpoints)
+		elog(DEBUG1, "checkpoint sync: number=%d file=%s time=%.3f ms",
+			 *processed,
+			 inflight->path,
+			 (double) elapsed / 1000);
+}
+
 /*
  *	ProcessSyncRequests() -- Process queued fsync requests.
  */
@@ -290,6 +416,9 @@ ProcessSyncRequests(void)
 	HASH_SEQ_STATUS hstat;
 	PendingFsyncEntry *entry;
 	int			absorb_counter;
+	bool		batch_fsyncs;
+	List	   *started = NIL;
+	ListCell   *lc;
 
 	/* Statistics on sync times */
 	int			processed = 0;
@@ -349,9 +478,29 @@ ProcessSyncRequests(void)
 		while ((entry = (PendingFsyncEntry *) hash_seq_search(&hstat)) != NULL)
 		{
 			entry->cycle_ctr = sync_cycle_ctr;
+			entry->fsync_started = false;
+		}
+
+		/* also wait out any asynchronous fsyncs it left behind */
+		while (numInFlightFsyncs > 0)
+		{
+			InFlightFsync *inflight = &inFlightFsyncs[inFlightHead];
+
+			(void) pgaio_wait_for(inflight->handle, WAIT_EVENT_DATA_FILE_SYNC);
+			FileClose(inflight->file);
+			inFlightHead = (inFlightHead + 1) % PGAIO_MAX_IN_FLIGHT;
+			numInFlightFsyncs--;
 		}
 	}
 
+	/* Decide whether to keep several fsyncs in flight, see above */
+	batch_fsyncs = checkpoint_sync_concurrency > 1 && enableFsync &&
+		pgaio_enabled();
+	if (batch_fsyncs && inFlightFsyncs == NULL)
+		inFlightFsyncs = (InFlightFsync *)
+			MemoryContextAlloc(pendingOpsCxt,
+							   PGAIO_MAX_IN_FLIGHT * sizeof(InFlightFsync));
+
 	/* Advance counter so that new hashtable entries are distinguishable */
 	sync_cycle_ctr++;
 
@@ -396,6 +545,21 @@ ProcessSyncRequests(void)
 				absorb_counter = FSYNCS_PER_ABSORB;
 			}
 
+			/*
+			 * If batching, start an asynchronous fsync, first making room for
+			 * it if needed.  The entry is removed at the end.
+			 */
+			if (batch_fsyncs && !entry->canceled)
+			{
+				while (numInFlightFsyncs >= checkpoint_sync_concurrency)
+					SyncFinishOldest(&processed, &longest, &total_elapsed);
+				if (SyncStartAsync(entry))
+				{
+					started = lappend(started, entry);
+					continue;
+				}
+			}
+
 			/*
 			 * The fsync table could contain requests to fsync segments that
 			 * have been deleted (unlinked) by the time we get to them. Rather
@@ -465,6 +629,22 @@ ProcessSyncRequests(void)
 			elog(ERROR, "pendingOps corrupted");
 	}							/* end loop over hashtable entries */
 
+	/* Collect the remaining asynchronous fsyncs, and remove their entries */
+	while (numInFlightFsyncs > 0)
+		SyncFinishOldest(&processed, &longest, &total_elapsed);
+	foreach(lc, started)
+	{
+		entry = (PendingFsyncEntry *) lfirst(lc);
+		entry->fsync_started = false;
+
+		/* keep it if a request arrived after the fsync was started */
+		if (entry->cycle_ctr == sync_cycle_ctr)
+			continue;
+		if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "pendingOps corrupted");
+	}
+	list_free(started);
+
 	/* Return sync performance metrics for report at checkpoint end */
 	CheckpointStats.ckpt_sync_rels = processed;
 	CheckpointStats.ckpt_longest_sync = longest;
@@ -553,8 +733,14 @@ RememberSyncRequest(const FileTag *ftag, SyncRequestType type)
 												  ftag,
 												  HASH_ENTER,
 												  &found);
-		/* if new entry, or was previously canceled, initialize it */
-		if (!found || entry->canceled)
+		/*
+		 * If new entry, or was previously canceled, initialize it.  Likewise
+		 * if an asynchronous fsync of the file has already been started, as
+		 * it might not cover the write this request is for.
+		 */
+		if (!found)
+			entry->fsync_started = false;
+		if (!found || entry->canceled || entry->fsync_started)
 		{
 			entry->cycle_ctr = sync_cycle_ctr;
 			entry->canceled = false;
@@ -18,6 +18,7 @@
 #include <unistd.h>
 
 #include "access/xlog.h"
+#include "common/compress_stream.h"
 #include "common/ip.h"
 #include "common/string.h"
 #include "libpq/libpq.h"
@@ -44,6 +45,7 @@ static void BackendInitialize(ClientSocket *client_sock, CAC_state cac);
 static int	ProcessSSLStartup(Port *port);
 static int	ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done);
 static void SendNegotiateProtocolVersion(List *unrecognized_protocol_options);
+static pg_compress_algorithm choose_protocol_compression(char *requested);
 static void process_startup_packet_die(SIGNAL_ARGS);
 static void StartupPacketTimeoutHandler(void);
 
@@ -694,6 +696,7 @@ ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done)
 	{
 		int32		offset = sizeof(ProtocolVersion);
 		List	   *unrecognized_protocol_options = NIL;
+		char	   *protocol_compression = NULL;
 
 		/*
 		 * Scan packet body for name/option pairs.  We can assume any string
@@ -743,12 +746,14 @@ ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done)
 									valptr),
 							 errhint("Valid values are: \"false\", 0, \"true\", 1, \"database\".")));
 			}
+			else if (strcmp(nameptr, "_pq_.compression") == 0)
+				protocol_compression = pstrdup(valptr);
 			else if (strncmp(nameptr, "_pq_.", 5) == 0)
 			{
 				/*
 				 * Any option beginning with _pq_. is reserved for use as a
-				 * protocol-level option, but at present no such options are
-				 * defined.
+				 * protocol-level option.  _pq_.compression is the only one
+				 * defined at present.
 				 */
 				unrecognized_protocol_options =
 					lappend(unrecognized_protocol_options, pstrdup(nameptr));
@@ -793,6 +798,16 @@ ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done)
 		if (PG_PROTOCOL_MINOR(proto) > PG_PROTOCOL_MINOR(PG_PROTOCOL_LATEST) ||
 			unrecognized_protocol_options != NIL)
 			SendNegotiateProtocolVersion(unrecognized_protocol_options);
+
+		/*
+		 * Pick the first of the stream compression algorithms requested by
+		 * the client that we support.  Replication connections are never
+		 * compressed; physical replication has its own, optional compression
+		 * of the WAL stream.
+		 */
+		port->compression = PG_COMPRESSION_NONE;
+		if (protocol_compression != NULL && !am_walsender)
+			port->compression = choose_protocol_compression(protocol_compression);
 	}
 
 	/* Check a user name was given. */
@@ -829,6 +844,29 @@ ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done)
 	return STATUS_OK;
 }
 
+/*
+ * Choose a stream compression algorithm from the comma-separated list of
+ * algorithm names requested by the client, in order of preference.  Names
+ * we don't know or don't support are skipped.
+ */
+static pg_compress_algorithm
+choose_protocol_compression(char *requested)
+{
+	char	   *tok;
+	char	   *saveptr;
+
+	for (tok = strtok_r(requested, ", ", &saveptr); tok != NULL;
+		 tok = strtok_r(NULL, ", ", &saveptr))
+	{
+		pg_compress_algorithm algorithm;
+
+		if (pg_stream_compress_algorithm_by_name(tok, &algorithm))
+			return algorithm;
+	}
+
+	return PG_COMPRESSION_NONE;
+}
+
 /*
  * Send a NegotiateProtocolVersion to the client.  This lets the client know
  * that they have requested a newer minor protocol version than we are able
@@ -4094,8 +4094,9 @@ PostgresSingleUserMain(int argc, char *argv[],
 	 */
 	process_shared_preload_libraries();
 
-	/* Initialize MaxBackends */
+	/* Initialize MaxBackends and the fast-path lock arrays' size */
 	InitializeMaxBackends();
+	InitializeFastPathLocks();
 
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
@@ -4282,6 +4283,21 @@ PostgresMain(const char *dbname, const char *username)
 		pq_sendint32(&buf, (int32) MyCancelKey);
 		pq_endmessage(&buf);
 		/* Need not flush since ReadyForQuery will do it. */
+
+		/*
+		 * If the client asked for stream compression and we agreed to one of
+		 * the algorithms, announce it.  Everything after the announcement is
+		 * compressed, so flush it out in the clear before switching over.
+		 */
+		if (MyProcPort->compression != PG_COMPRESSION_NONE)
+		{
+			pq_beginmessage(&buf, PqMsg_ParameterStatus);
+			pq_sendstring(&buf, "compression");
+			pq_sendstring(&buf, get_compress_algorithm_name(MyProcPort->compression));
+			pq_endmessage(&buf);
+			pq_flush();
+			pq_enable_compression(MyProcPort->compression);
+		}
 	}
 
 	/* Welcome banner for standalone case */
@@ -1279,6 +1279,8 @@ PortalRunMulti(Portal portal,
 							 portal->portalParams,
 							 portal->queryEnv,
 							 dest, qc);
+				if (portal->cplan && qc)
+					ReportCachedPlanRows(portal->cplan, pstmt, qc->nprocessed);
 			}
 			else
 			{
@@ -14,12 +14,55 @@
 
 #include "postgres.h"
 
+#include "common/hashfn.h"
 #include "tsearch/ts_cache.h"
 #include "tsearch/ts_utils.h"
+#include "utils/hsearch.h"
+#include "utils/catcache.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
 #include "varatt.h"
 
 #define IGNORE_LONGLEXEME	1
 
+/*
+ * Lexeme cache
+ *
+ * Running a word through a configuration's dictionaries (Snowball stemming,
+ * ispell affix rules, ...) is the bulk of the cost of to_tsvector(), and
+ * natural-language text uses the same words over and over.  So we remember
+ * the normalized lexemes of each word we've seen, per configuration and
+ * token type, and skip the dictionaries next time.  A cached entry with
+ * NULL lexemes means no dictionary recognized the word.
+ *
+ * Words are cached only when they were lexized on their own.  Whenever a
+ * dictionary asks for the following words too (as the thesaurus dictionary
+ * does), the result depends on more than one word and is not cached.
+ *
+ * The whole cache is discarded when it fills up, and whenever any text
+ * search configuration, dictionary or template changes.
+ */
+#define TS_LEXEME_CACHE_SIZE	16384
+
+typedef struct LexemeCacheKey
+{
+	Oid			cfgId;
+	int			type;
+	int			len;
+	const char *word;			/* not null-terminated */
+} LexemeCacheKey;
+
+typedef struct LexemeCacheEntry
+{
+	LexemeCacheKey key;			/* must be first */
+	TSLexeme   *lexemes;		/* NULL-terminated array, or NULL */
+} LexemeCacheEntry;
+
+static HTAB *LexemeCache = NULL;
+static MemoryContext LexemeCacheContext = NULL;
+static bool LexemeCacheValid = false;
+
 /*
  * Lexize subsystem
  */
@@ -57,6 +100,131 @@ typedef struct
 	TSLexeme   *tmpRes;
 } LexizeData;
 
+static uint32
+lexeme_cache_hash(const void *key, Size keysize)
+{
+	const LexemeCacheKey *k = (const LexemeCacheKey *) key;
+	uint32		h;
+
+	h = hash_bytes((const unsigned char *) k->word, k->len);
+	h = hash_combine(h, (uint32) k->cfgId);
+	return hash_combine(h, (uint32) k->type);
+}
+
+static int
+lexeme_cache_match(const void *key1, const void *key2, Size keysize)
+{
+	const LexemeCacheKey *k1 = (const LexemeCacheKey *) key1;
+	const LexemeCacheKey *k2 = (const LexemeCacheKey *) key2;
+
+	if (k1->cfgId != k2->cfgId || k1->type != k2->type || k1->len != k2->len)
+		return 1;
+	return memcmp(k1->word, k2->word, k1->len);
+}
+
+static void
+InvalidateLexemeCacheCallBack(Datum arg, int cacheid, uint32 hashvalue)
+{
+	LexemeCacheValid = false;
+}
+
+/*
+ * Make sure the lexeme cache exists and is empty if it has gone stale.
+ */
+static void
+lexeme_cache_prepare(void)
+{
+	HASHCTL		ctl;
+
+	if (LexemeCache != NULL && LexemeCacheValid &&
+		hash_get_num_entries(LexemeCache) < TS_LEXEME_CACHE_SIZE)
+		return;
+
+	if (LexemeCacheContext == NULL)
+	{
+		if (!CacheMemoryContext)
+			CreateCacheMemoryContext();
+		LexemeCacheContext = AllocSetContextCreate(CacheMemoryContext,
+												   "Tsearch lexeme cache",
+												   ALLOCSET_DEFAULT_SIZES);
+		CacheRegisterSyscacheCallback(TSCONFIGOID, InvalidateLexemeCacheCallBack,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TSCONFIGMAP, InvalidateLexemeCacheCallBack,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TSDICTOID, InvalidateLexemeCacheCallBack,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TSTEMPLATEOID, InvalidateLexemeCacheCallBack,
+									  (Datum) 0);
+	}
+	else
+		MemoryContextReset(LexemeCacheContext);
+
+	ctl.keysize = sizeof(LexemeCacheKey);
+	ctl.entrysize = sizeof(LexemeCacheEntry);
+	ctl.hash = lexeme_cache_hash;
+	ctl.match = lexeme_cache_match;
+	ctl.hcxt = LexemeCacheContext;
+	LexemeCache = hash_create("Tsearch lexeme cache", 1024, &ctl,
+							  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE |
+							  HASH_CONTEXT);
+	LexemeCacheValid = true;
+}
+
+/*
+ * Copy a NULL-terminated TSLexeme array, or return NULL for NULL, into the
+ * current memory context.
+ */
+static TSLexeme *
+copy_lexemes(const TSLexeme *lexemes)
+{
+	TSLexeme   *result;
+	int			n = 0;
+
+	if (lexemes == NULL)
+		return NULL;
+
+	while (lexemes[n].lexeme)
+		n++;
+	result = palloc_array(TSLexeme, n + 1);
+	for (int i = 0; i < n; i++)
+	{
+		result[i] = lexemes[i];
+		result[i].lexeme = pstrdup(lexemes[i].lexeme);
+	}
+	memset(&result[n], 0, sizeof(TSLexeme));
+
+	return result;
+}
+
+/*
+ * Remember the lexemes of a word that was lexized on its own.
+ */
+static void
+lexeme_cache_store(Oid cfgId, int type, const char *word, int len,
+				   const TSLexeme *lexemes)
+{
+	LexemeCacheKey key;
+	LexemeCacheEntry *entry;
+	MemoryContext oldcontext;
+	bool		found;
+
+	lexeme_cache_prepare();
+
+	key.cfgId = cfgId;
+	key.type = type;
+	key.len = len;
+	key.word = word;
+	entry = (LexemeCacheEntry *) hash_search(LexemeCache, &key, HASH_ENTER,
+											 &found);
+	if (found)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(LexemeCacheContext);
+	entry->key.word = pnstrdup(word, len);
+	entry->lexemes = copy_lexemes(lexemes);
+	MemoryContextSwitchTo(oldcontext);
+}
+
 static void
 LexizeInit(LexizeData *ld, TSConfigCacheEntry *cfg)
 {
@@ -176,6 +344,7 @@ LexizeExec(LexizeData *ld, ParsedLex **correspondLexem)
 	ListDictionary *map;
 	TSDictionaryCacheEntry *dict;
 	TSLexeme   *res;
+	bool		cacheable;
 
 	if (ld->curDictId == InvalidOid)
 	{
@@ -199,6 +368,32 @@ LexizeExec(LexizeData *ld, ParsedLex **correspondLexem)
 				continue;
 			}
 
+			/*
+			 * Unless we're retrying this word after a multi-word dictionary
+			 * gave up on it, see if we know its lexemes already.
+			 */
+			cacheable = (ld->posDict == 0);
+			if (cacheable && LexemeCache != NULL && LexemeCacheValid)
+			{
+				LexemeCacheKey key;
+				LexemeCacheEntry *entry;
+
+				key.cfgId = ld->cfg->cfgId;
+				key.type = curVal->type;
+				key.len = curValLenLemm;
+				key.word = curValLemm;
+				entry = (LexemeCacheEntry *) hash_search(LexemeCache, &key,
+														 HASH_FIND, NULL);
+				if (entry != NULL)
+				{
+					RemoveHead(ld);
+					if (entry->lexemes == NULL)
+						continue;
+					setCorrLex(ld, correspondLexem);
+					return copy_lexemes(entry->lexemes);
+				}
+			}
+
 			for (i = ld->posDict; i < map->len; i++)
 			{
 				dict = lookup_ts_dictionary_cache(map->dictIds[i]);
@@ -236,11 +431,17 @@ LexizeExec(LexizeData *ld, ParsedLex **correspondLexem)
 					continue;
 				}
 
+				if (cacheable)
+					lexeme_cache_store(ld->cfg->cfgId, curVal->type,
+									   curVal->lemm, curVal->lenlemm, res);
 				RemoveHead(ld);
 				setCorrLex(ld, correspondLexem);
 				return res;
 			}
 
+			if (cacheable)
+				lexeme_cache_store(ld->cfg->cfgId, curVal->type,
+								   curVal->lemm, curVal->lenlemm, NULL);
 			RemoveHead(ld);
 		}
 	}
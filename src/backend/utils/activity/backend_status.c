@@ -61,6 +61,12 @@ static PgBackendSSLStatus *BackendSslStatusBuffer = NULL;
 static PgBackendGSSStatus *BackendGssStatusBuffer = NULL;
 #endif
 
+/*
+ * Sum of the st_allocated_bytes of all entries, and our own contribution to
+ * it.
+ */
+static pg_atomic_uint64 *BackendMemoryTotal = NULL;
+static Size MyReportedAllocatedBytes = 0;
 
 /* Status for backends including auxiliary */
 static LocalPgBackendStatus *localBackendStatusTable = NULL;
@@ -105,6 +111,8 @@ BackendStatusShmemSize(void)
 	size = add_size(size,
 					mul_size(sizeof(PgBackendGSSStatus), NumBackendStatSlots));
 #endif
+	/* BackendMemoryTotal: */
+	size = add_size(size, sizeof(pg_atomic_uint64));
 	return size;
 }
 
@@ -233,6 +241,13 @@ CreateSharedBackendStatus(void)
 		}
 	}
 #endif
+
+	/* Create or attach to the backend memory total */
+	BackendMemoryTotal = (pg_atomic_uint64 *)
+		ShmemInitStruct("Backend Memory Total", sizeof(pg_atomic_uint64),
+						&found);
+	if (!found)
+		pg_atomic_init_u64(BackendMemoryTotal, 0);
 }
 
 /*
@@ -251,6 +266,9 @@ pgstat_beinit(void)
 	Assert(MyProcNumber >= 0 && MyProcNumber < NumBackendStatSlots);
 	MyBEEntry = &BackendStatusArray[MyProcNumber];
 
+	/* Start counting our memory in the shared total */
+	MemoryContextReportAllocated();
+
 	/* Set up a process-exit hook to clean up */
 	on_shmem_exit(pgstat_beshutdown_hook, 0);
 }
@@ -381,6 +399,7 @@ pgstat_bestart(void)
 	lbeentry.st_progress_command = PROGRESS_COMMAND_INVALID;
 	lbeentry.st_progress_command_target = InvalidOid;
 	lbeentry.st_query_id = UINT64CONST(0);
+	lbeentry.st_allocated_bytes = MyReportedAllocatedBytes;
 
 	/*
 	 * we don't zero st_progress_param here to save cycles; nobody should
@@ -449,9 +468,14 @@ pgstat_beshutdown_hook(int code, Datum arg)
 	PGSTAT_BEGIN_WRITE_ACTIVITY(beentry);
 
 	beentry->st_procpid = 0;	/* mark invalid */
+	beentry->st_allocated_bytes = 0;
 
 	PGSTAT_END_WRITE_ACTIVITY(beentry);
 
+	/* Our memory no longer counts towards the shared total */
+	pg_atomic_fetch_sub_u64(BackendMemoryTotal, MyReportedAllocatedBytes);
+	MyReportedAllocatedBytes = 0;
+
 	/* so that functions can check if backend_status.c is up via MyBEEntry */
 	MyBEEntry = NULL;
 }
@@ -642,6 +666,31 @@ pgstat_report_query_id(uint64 query_id, bool force)
 	PGSTAT_END_WRITE_ACTIVITY(beentry);
 }
 
+/* --------
+ * pgstat_report_allocated_bytes() -
+ *
+ * Called by the memory context code to publish the total memory allocated
+ * by this process, and to fold the change into the shared total.  This runs
+ * inside allocation paths, so it must not allocate.
+ * --------
+ */
+void
+pgstat_report_allocated_bytes(Size allocated)
+{
+	volatile PgBackendStatus *beentry = MyBEEntry;
+
+	if (!beentry)
+		return;
+
+	pg_atomic_fetch_add_u64(BackendMemoryTotal,
+							(int64) allocated - (int64) MyReportedAllocatedBytes);
+	MyReportedAllocatedBytes = allocated;
+
+	PGSTAT_BEGIN_WRITE_ACTIVITY(beentry);
+	beentry->st_allocated_bytes = allocated;
+	PGSTAT_END_WRITE_ACTIVITY(beentry);
+}
+
 
 /* ----------
  * pgstat_report_appname() -
@@ -1038,6 +1087,49 @@ pgstat_get_my_query_id(void)
 	return MyBEEntry->st_query_id;
 }
 
+/* ----------
+ * pgstat_get_backend_sample() -
+ *
+ *	Read the PID, state and query ID of the backend in the given slot,
+ *	without taking a snapshot of all backends as
+ *	pgstat_read_current_status() does.  Used by the sampling profiler.
+ *	Returns false if the slot is not in use.
+ * ----------
+ */
+bool
+pgstat_get_backend_sample(ProcNumber procNumber, int *pid,
+						  BackendState *state, uint64 *query_id)
+{
+	volatile PgBackendStatus *beentry;
+
+	if (procNumber < 0 || procNumber >= NumBackendStatSlots)
+		return false;
+
+	beentry = &BackendStatusArray[procNumber];
+	for (;;)
+	{
+		int			before_changecount;
+		int			after_changecount;
+
+		pgstat_begin_read_activity(beentry, before_changecount);
+
+		*pid = beentry->st_procpid;
+		*state = beentry->st_state;
+		*query_id = beentry->st_query_id;
+
+		pgstat_end_read_activity(beentry, after_changecount);
+
+		if (pgstat_read_activity_complete(before_changecount,
+										  after_changecount))
+			break;
+
+		/* Make sure we can break out of loop if stuck... */
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	return *pid != 0;
+}
+
 /* ----------
  * cmp_lbestatus
  *
@@ -1136,6 +1228,24 @@ pgstat_get_local_beentry_by_index(int idx)
 }
 
 
+/* ----------
+ * pgstat_get_total_allocated_bytes() -
+ *
+ *	Return, in *total, the memory allocated by all processes that have a
+ *	backend status entry, as last reported by each.  Returns false if this
+ *	process is not counted itself.
+ * ----------
+ */
+bool
+pgstat_get_total_allocated_bytes(uint64 *total)
+{
+	if (!MyBEEntry)
+		return false;
+
+	*total = pg_atomic_read_u64(BackendMemoryTotal);
+	return true;
+}
+
 /* ----------
  * pgstat_fetch_stat_numbackends() -
  *
@@ -127,6 +127,12 @@
 
 #define PGSTAT_SNAPSHOT_HASH_SIZE	512
 
+/*
+ * Copies of variable-numbered stats not used by this many consecutive
+ * snapshots are dropped from the snapshot cache.
+ */
+#define PGSTAT_SNAPSHOT_CACHE_MAX_AGE	8
+
 
 /* hash table for statistics snapshots entry */
 typedef struct PgStat_SnapshotEntry
@@ -136,6 +142,16 @@ typedef struct PgStat_SnapshotEntry
 	void	   *data;			/* the stats data itself */
 } PgStat_SnapshotEntry;
 
+/* hash table for copies of stats entries retained across snapshots */
+typedef struct PgStat_SnapshotCacheEntry
+{
+	PgStat_HashKey key;
+	char		status;			/* for simplehash use */
+	uint32		last_used;		/* cache_epoch of last snapshot using it */
+	uint64		generation;		/* generation of the shared entry copied */
+	void	   *data;			/* the copied stats data */
+} PgStat_SnapshotCacheEntry;
+
 
 /* ----------
  * Backend-local Hash Table Definitions
@@ -156,6 +172,20 @@ typedef struct PgStat_SnapshotEntry
 #define SH_DECLARE
 #include "lib/simplehash.h"
 
+/* for copies retained across snapshots */
+#define SH_PREFIX pgstat_snapcache
+#define SH_ELEMENT_TYPE PgStat_SnapshotCacheEntry
+#define SH_KEY_TYPE PgStat_HashKey
+#define SH_KEY key
+#define SH_HASH_KEY(tb, key) \
+	pgstat_hash_hash_key(&key, sizeof(PgStat_HashKey), NULL)
+#define SH_EQUAL(tb, a, b) \
+	pgstat_cmp_hash_key(&a, &b, sizeof(PgStat_HashKey), NULL) == 0
+#define SH_SCOPE static inline
+#define SH_DEFINE
+#define SH_DECLARE
+#include "lib/simplehash.h"
+
 
 /* ----------
  * Local function forward declarations
@@ -172,6 +202,9 @@ static bool pgstat_flush_pending_entries(bool nowait);
 static void pgstat_prep_snapshot(void);
 static void pgstat_build_snapshot(void);
 static void pgstat_build_snapshot_fixed(PgStat_Kind kind);
+static void *pgstat_snapshot_copy_entry(PgStat_HashKey key,
+										PgStatShared_Common *shstats);
+static void pgstat_trim_snapshot_cache(bool all);
 
 static inline bool pgstat_is_kind_valid(int ikind);
 
@@ -781,6 +814,8 @@ pgstat_reset_of_kind(PgStat_Kind kind)
 void
 pgstat_clear_snapshot(void)
 {
+	bool		had_snapshot = pgStatLocal.snapshot.stats != NULL;
+
 	pgstat_assert_is_up();
 
 	memset(&pgStatLocal.snapshot.fixed_valid, 0,
@@ -797,6 +832,16 @@ pgstat_clear_snapshot(void)
 		pgStatLocal.snapshot.context = NULL;
 	}
 
+	/*
+	 * Forget copies that recent snapshots haven't needed, or all of them if
+	 * we won't be caching anymore.
+	 */
+	if (pgStatLocal.snapshot.cache &&
+		(had_snapshot ||
+		 pgstat_fetch_consistency == PGSTAT_FETCH_CONSISTENCY_NONE))
+		pgstat_trim_snapshot_cache(pgstat_fetch_consistency ==
+								   PGSTAT_FETCH_CONSISTENCY_NONE);
+
 	/*
 	 * Historically the backend_status.c facilities lived in this file, and
 	 * were reset with the same function. For now keep it that way, and
@@ -870,19 +915,20 @@ pgstat_fetch_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
 	/*
 	 * Allocate in caller's context for PGSTAT_FETCH_CONSISTENCY_NONE,
 	 * otherwise we could quickly end up with a fair bit of memory used due to
-	 * repeated accesses.
+	 * repeated accesses.  When caching, reuse an earlier copy if possible.
 	 */
 	if (pgstat_fetch_consistency == PGSTAT_FETCH_CONSISTENCY_NONE)
+	{
 		stats_data = palloc(kind_info->shared_data_len);
-	else
-		stats_data = MemoryContextAlloc(pgStatLocal.snapshot.context,
-										kind_info->shared_data_len);
 
-	pgstat_lock_entry_shared(entry_ref, false);
-	memcpy(stats_data,
-		   pgstat_get_entry_data(kind, entry_ref->shared_stats),
-		   kind_info->shared_data_len);
-	pgstat_unlock_entry(entry_ref);
+		pgstat_lock_entry_shared(entry_ref, false);
+		memcpy(stats_data,
+			   pgstat_get_entry_data(kind, entry_ref->shared_stats),
+			   kind_info->shared_data_len);
+		pgstat_unlock_entry(entry_ref);
+	}
+	else
+		stats_data = pgstat_snapshot_copy_entry(key, entry_ref->shared_stats);
 
 	if (pgstat_fetch_consistency > PGSTAT_FETCH_CONSISTENCY_NONE)
 	{
@@ -970,6 +1016,103 @@ pgstat_prep_snapshot(void)
 		pgstat_snapshot_create(pgStatLocal.snapshot.context,
 							   PGSTAT_SNAPSHOT_HASH_SIZE,
 							   NULL);
+
+	if (!pgStatLocal.snapshot.cache)
+	{
+		pgStatLocal.snapshot.cache_context =
+			AllocSetContextCreate(TopMemoryContext,
+								  "PgStat Snapshot Cache",
+								  ALLOCSET_DEFAULT_SIZES);
+		pgStatLocal.snapshot.cache =
+			pgstat_snapcache_create(pgStatLocal.snapshot.cache_context,
+									PGSTAT_SNAPSHOT_HASH_SIZE,
+									NULL);
+	}
+	pgStatLocal.snapshot.cache_epoch++;
+}
+
+/*
+ * Return a copy of the stats data of shared entry 'shstats', for use until
+ * the current snapshot is cleared.
+ *
+ * Copies are kept across snapshots, so that with many stats objects only
+ * those that changed since the last snapshot need to be copied again.
+ * Whether one has is told by the entry's generation, which can be checked
+ * without taking the entry's lock; it is advanced before any change to the
+ * contents is made, so a matching generation means our copy is current.
+ */
+static void *
+pgstat_snapshot_copy_entry(PgStat_HashKey key, PgStatShared_Common *shstats)
+{
+	const PgStat_KindInfo *kind_info = pgstat_get_kind_info(key.kind);
+	PgStat_SnapshotCacheEntry *cached;
+
+	cached = pgstat_snapcache_lookup(pgStatLocal.snapshot.cache, key);
+	if (cached == NULL)
+	{
+		void	   *data;
+		bool		found;
+
+		/* allocate first, so that an error can't leave a bogus entry */
+		data = MemoryContextAlloc(pgStatLocal.snapshot.cache_context,
+								  kind_info->shared_data_len);
+		cached = pgstat_snapcache_insert(pgStatLocal.snapshot.cache, key,
+										 &found);
+		Assert(!found);
+		cached->data = data;
+	}
+	else if (cached->generation == pg_atomic_read_u64(&shstats->generation))
+	{
+		cached->last_used = pgStatLocal.snapshot.cache_epoch;
+		return cached->data;
+	}
+
+	/*
+	 * Acquire the LWLock directly instead of using
+	 * pg_stat_lock_entry_shared() which requires a reference.
+	 */
+	LWLockAcquire(&shstats->lock, LW_SHARED);
+	cached->generation = pg_atomic_read_u64(&shstats->generation);
+	memcpy(cached->data,
+		   pgstat_get_entry_data(key.kind, shstats),
+		   kind_info->shared_data_len);
+	LWLockRelease(&shstats->lock);
+
+	cached->last_used = pgStatLocal.snapshot.cache_epoch;
+
+	return cached->data;
+}
+
+/*
+ * Drop the snapshot cache's copies that haven't been used by the last
+ * PGSTAT_SNAPSHOT_CACHE_MAX_AGE snapshots, e.g. those of dropped objects, or
+ * the whole cache if 'all' is true.
+ */
+static void
+pgstat_trim_snapshot_cache(bool all)
+{
+	pgstat_snapcache_iterator iter;
+	PgStat_SnapshotCacheEntry *cached;
+	uint32		epoch = pgStatLocal.snapshot.cache_epoch;
+
+	if (all)
+	{
+		MemoryContextDelete(pgStatLocal.snapshot.cache_context);
+		pgStatLocal.snapshot.cache_context = NULL;
+		pgStatLocal.snapshot.cache = NULL;
+		return;
+	}
+
+	pgstat_snapcache_start_iterate(pgStatLocal.snapshot.cache, &iter);
+	while ((cached = pgstat_snapcache_iterate(pgStatLocal.snapshot.cache,
+											  &iter)) != NULL)
+	{
+		if (epoch - cached->last_used >= PGSTAT_SNAPSHOT_CACHE_MAX_AGE)
+		{
+			pfree(cached->data);
+			pgstat_snapcache_delete_item(pgStatLocal.snapshot.cache, cached);
+		}
+	}
 }
 
 static void
@@ -1002,6 +1145,7 @@ pgstat_build_snapshot(void)
 		bool		found;
 		PgStat_SnapshotEntry *entry;
 		PgStatShared_Common *stats_data;
+		void	   *data;
 
 		/*
 		 * Check if the stats object should be included in the snapshot.
@@ -1023,21 +1167,11 @@ pgstat_build_snapshot(void)
 		stats_data = dsa_get_address(pgStatLocal.dsa, p->body);
 		Assert(stats_data);
 
+		data = pgstat_snapshot_copy_entry(p->key, stats_data);
+
 		entry = pgstat_snapshot_insert(pgStatLocal.snapshot.stats, p->key, &found);
 		Assert(!found);
-
-		entry->data = MemoryContextAlloc(pgStatLocal.snapshot.context,
-										 kind_info->shared_size);
-
-		/*
-		 * Acquire the LWLock directly instead of using
-		 * pg_stat_lock_entry_shared() which requires a reference.
-		 */
-		LWLockAcquire(&stats_data->lock, LW_SHARED);
-		memcpy(entry->data,
-			   pgstat_get_entry_data(kind, stats_data),
-			   kind_info->shared_size);
-		LWLockRelease(&stats_data->lock);
+		entry->data = data;
 	}
 	dshash_seq_term(&hstat);
 
@@ -133,6 +133,69 @@ pgstat_report_deadlock(void)
 	dbent->deadlocks++;
 }
 
+/*
+ * Report a deadlock check, and whether it had to lock the whole lock table.
+ */
+void
+pgstat_report_deadlock_check(bool full, PgStat_Counter usecs)
+{
+	PgStat_StatDBEntry *dbent;
+
+	if (!pgstat_track_counts)
+		return;
+
+	dbent = pgstat_prep_database_pending(MyDatabaseId);
+	dbent->deadlock_checks++;
+	if (full)
+		dbent->deadlock_full_checks++;
+	dbent->deadlock_check_time += usecs;
+}
+
+/*
+ * Report a transaction whose subtransaction XID cache overflowed.
+ */
+void
+pgstat_report_subxid_overflow(void)
+{
+	PgStat_StatDBEntry *dbent;
+
+	if (!pgstat_track_counts)
+		return;
+
+	dbent = pgstat_prep_database_pending(MyDatabaseId);
+	dbent->subxid_overflows++;
+}
+
+/*
+ * Report that a predicate lock request was promoted to a coarser lock.
+ */
+void
+pgstat_report_predicate_lock_promotion(void)
+{
+	PgStat_StatDBEntry *dbent;
+
+	if (!pgstat_track_counts)
+		return;
+
+	dbent = pgstat_prep_database_pending(MyDatabaseId);
+	dbent->predlock_promotions++;
+}
+
+/*
+ * Report serialization failures raised by serializable snapshot isolation.
+ */
+void
+pgstat_report_serialization_failures(int count)
+{
+	PgStat_StatDBEntry *dbent;
+
+	if (!pgstat_track_counts)
+		return;
+
+	dbent = pgstat_prep_database_pending(MyDatabaseId);
+	dbent->serialization_failures += count;
+}
+
 /*
  * Report one or more checksum failures.
  */
@@ -410,6 +473,12 @@ pgstat_database_flush_cb(PgStat_EntryRef *entry_ref, bool nowait)
 	PGSTAT_ACCUM_DBCOUNT(temp_bytes);
 	PGSTAT_ACCUM_DBCOUNT(temp_files);
 	PGSTAT_ACCUM_DBCOUNT(deadlocks);
+	PGSTAT_ACCUM_DBCOUNT(deadlock_checks);
+	PGSTAT_ACCUM_DBCOUNT(deadlock_full_checks);
+	PGSTAT_ACCUM_DBCOUNT(deadlock_check_time);
+	PGSTAT_ACCUM_DBCOUNT(subxid_overflows);
+	PGSTAT_ACCUM_DBCOUNT(predlock_promotions);
+	PGSTAT_ACCUM_DBCOUNT(serialization_failures);
 
 	/* checksum failures are reported immediately */
 	Assert(pendingent->checksum_failures == 0);
@@ -434,7 +434,8 @@ pgstat_tracks_io_op(BackendType bktype, IOObject io_object,
 	 * Some BackendTypes will not do certain IOOps.
 	 */
 	if ((bktype == B_BG_WRITER || bktype == B_CHECKPOINTER) &&
-		(io_op == IOOP_READ || io_op == IOOP_EVICT || io_op == IOOP_HIT))
+		(io_op == IOOP_READ || io_op == IOOP_EVICT ||
+		 io_op == IOOP_EVICT_RETRY || io_op == IOOP_HIT))
 		return false;
 
 	if ((bktype == B_AUTOVAC_LAUNCHER || bktype == B_BG_WRITER ||
@@ -443,10 +444,12 @@ pgstat_tracks_io_op(BackendType bktype, IOObject io_object,
 
 	/*
 	 * Temporary tables are not logged and thus do not require fsync'ing.
-	 * Writeback is not requested for temporary tables.
+	 * Writeback is not requested for temporary tables.  Local buffers are
+	 * not chosen by the shared clock sweep.
 	 */
 	if (io_object == IOOBJECT_TEMP_RELATION &&
-		(io_op == IOOP_FSYNC || io_op == IOOP_WRITEBACK))
+		(io_op == IOOP_FSYNC || io_op == IOOP_WRITEBACK ||
+		 io_op == IOOP_EVICT_RETRY))
 		return false;
 
 	/*
@@ -195,6 +195,7 @@ StatsShmemInit(void)
 		dsa_detach(dsa);
 
 		pg_atomic_init_u64(&ctl->gc_request_count, 1);
+		pg_atomic_init_u64(&ctl->next_generation, 1);
 
 
 		/* initialize fixed-numbered stats */
@@ -280,6 +281,7 @@ pgstat_init_entry(PgStat_Kind kind,
 	shhashent->body = chunk;
 
 	LWLockInitialize(&shheader->lock, LWTRANCHE_PGSTATS_DATA);
+	pg_atomic_init_u64(&shheader->generation, pgstat_new_generation());
 
 	return shheader;
 }
@@ -297,6 +299,7 @@ pgstat_reinit_entry(PgStat_Kind kind, PgStatShared_HashEntry *shhashent)
 
 	/* reinitialize content */
 	Assert(shheader->magic == 0xdeadbeef);
+	pg_atomic_write_u64(&shheader->generation, pgstat_new_generation());
 	memset(pgstat_get_entry_data(kind, shheader), 0,
 		   pgstat_get_entry_len(kind));
 
@@ -578,9 +581,14 @@ pgstat_lock_entry(PgStat_EntryRef *entry_ref, bool nowait)
 	LWLock	   *lock = &entry_ref->shared_stats->lock;
 
 	if (nowait)
-		return LWLockConditionalAcquire(lock, LW_EXCLUSIVE);
+	{
+		if (!LWLockConditionalAcquire(lock, LW_EXCLUSIVE))
+			return false;
+	}
+	else
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 
-	LWLockAcquire(lock, LW_EXCLUSIVE);
+	pgstat_entry_changed(entry_ref->shared_stats);
 	return true;
 }
 
@@ -920,6 +928,8 @@ shared_stat_reset_contents(PgStat_Kind kind, PgStatShared_Common *header,
 {
 	const PgStat_KindInfo *kind_info = pgstat_get_kind_info(kind);
 
+	pgstat_entry_changed(header);
+
 	memset(pgstat_get_entry_data(kind, header), 0,
 		   pgstat_get_entry_len(kind));
 
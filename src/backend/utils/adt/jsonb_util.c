@@ -13,6 +13,8 @@
  */
 #include "postgres.h"
 
+#include "access/detoast.h"
+#include "access/heaptoast.h"
 #include "catalog/pg_collation.h"
 #include "common/hashfn.h"
 #include "miscadmin.h"
@@ -36,9 +38,19 @@
 #define JSONB_MAX_ELEMS (Min(MaxAllocSize / sizeof(JsonbValue), JB_CMASK))
 #define JSONB_MAX_PAIRS (Min(MaxAllocSize / sizeof(JsonbPair), JB_CMASK))
 
+/*
+ * Out-of-line jsonb values smaller than this are always detoasted in full by
+ * getKeyJsonValueFromDatum(); fetching them piecemeal would need more TOAST
+ * index lookups than it saves chunk reads.
+ */
+#define JSONB_PARTIAL_FETCH_MIN_SIZE	(8 * TOAST_MAX_CHUNK_SIZE)
+
 static void fillJsonbValue(JsonbContainer *container, int index,
 						   char *base_addr, uint32 offset,
 						   JsonbValue *result);
+static void fillJsonbValueFromEntry(JEntry entry, char *base_addr,
+									uint32 offset, uint32 len,
+									JsonbValue *result);
 static bool equalsJsonbScalarValue(JsonbValue *a, JsonbValue *b);
 static int	compareJsonbScalarValue(JsonbValue *a, JsonbValue *b);
 static Jsonb *convertToJsonb(JsonbValue *val);
@@ -389,14 +401,14 @@ findJsonbValueFromContainer(JsonbContainer *container, uint32 flags,
 }
 
 /*
- * Find value by key in Jsonb object and fetch it into 'res', which is also
- * returned.
+ * Binary search an object container for a key.
  *
- * 'res' can be passed in as NULL, in which case it's newly palloc'ed here.
+ * Returns the index of the key's JEntry, or -1 if the key is not present.
+ * Only the JEntries and the keys of the container are looked at, not the
+ * values, so the container may be truncated after its last key.
  */
-JsonbValue *
-getKeyJsonValueFromContainer(JsonbContainer *container,
-							 const char *keyVal, int keyLen, JsonbValue *res)
+static int
+findJsonbKeyIndex(JsonbContainer *container, const char *keyVal, int keyLen)
 {
 	JEntry	   *children = container->children;
 	int			count = JsonContainerSize(container);
@@ -406,10 +418,6 @@ getKeyJsonValueFromContainer(JsonbContainer *container,
 
 	Assert(JsonContainerIsObject(container));
 
-	/* Quick out without a palloc cycle if object is empty */
-	if (count <= 0)
-		return NULL;
-
 	/*
 	 * Binary search the container. Since we know this is an object, account
 	 * for *Pairs* of Jentrys
@@ -421,42 +429,324 @@ getKeyJsonValueFromContainer(JsonbContainer *container,
 	{
 		uint32		stopMiddle;
 		int			difference;
+		uint32		candidateOff;
 		const char *candidateVal;
 		int			candidateLen;
 
 		stopMiddle = stopLow + (stopHigh - stopLow) / 2;
 
-		candidateVal = baseAddr + getJsonbOffset(container, stopMiddle);
-		candidateLen = getJsonbLength(container, stopMiddle);
+		/* as getJsonbLength(), but without walking back to the offset twice */
+		candidateOff = getJsonbOffset(container, stopMiddle);
+		candidateVal = baseAddr + candidateOff;
+		if (JBE_HAS_OFF(children[stopMiddle]))
+			candidateLen = JBE_OFFLENFLD(children[stopMiddle]) - candidateOff;
+		else
+			candidateLen = JBE_OFFLENFLD(children[stopMiddle]);
 
 		difference = lengthCompareJsonbString(candidateVal, candidateLen,
 											  keyVal, keyLen);
 
 		if (difference == 0)
-		{
-			/* Found our key, return corresponding value */
-			int			index = stopMiddle + count;
+			return stopMiddle;
+		else if (difference < 0)
+			stopLow = stopMiddle + 1;
+		else
+			stopHigh = stopMiddle;
+	}
+
+	/* Not found */
+	return -1;
+}
+
+/*
+ * Find value by key in Jsonb object and fetch it into 'res', which is also
+ * returned.
+ *
+ * 'res' can be passed in as NULL, in which case it's newly palloc'ed here.
+ */
+JsonbValue *
+getKeyJsonValueFromContainer(JsonbContainer *container,
+							 const char *keyVal, int keyLen, JsonbValue *res)
+{
+	int			count = JsonContainerSize(container);
+	int			index;
+
+	Assert(JsonContainerIsObject(container));
+
+	/* Quick out without a palloc cycle if object is empty */
+	if (count <= 0)
+		return NULL;
+
+	index = findJsonbKeyIndex(container, keyVal, keyLen);
+	if (index < 0)
+		return NULL;
+
+	/* Found our key, return corresponding value */
+	index += count;
+
+	if (!res)
+		res = palloc(sizeof(JsonbValue));
+
+	fillJsonbValue(container, index,
+				   (char *) (container->children + count * 2),
+				   getJsonbOffset(container, index),
+				   res);
+
+	return res;
+}
+
+/*
+ * Fetch part of the data of a toasted jsonb datum into a palloc'd buffer.
+ * 'offset' is relative to the start of the root container.
+ */
+static char *
+fetchJsonbSlice(struct varlena *attr, uint32 offset, uint32 length)
+{
+	struct varlena *slice;
+
+	slice = detoast_attr_slice(attr, offset, length);
+	if (VARSIZE_ANY_EXHDR(slice) < length)
+		elog(ERROR, "unexpected end of toasted jsonb data");
+
+	/* slices are never short-header, so the data is suitably aligned */
+	Assert(!VARATT_IS_SHORT(slice));
+	return VARDATA(slice);
+}
+
+/*
+ * Find value by key in the root object of a jsonb datum, like
+ * getKeyJsonValueFromContainer().
+ *
+ * *isobject is set to whether the root container is an object; if it is not,
+ * NULL is returned.
+ *
+ * Operators that want a single top-level key would normally detoast the
+ * whole datum.  If it's large and stored out of line without compression,
+ * we instead fetch just the JEntries and keys of the root object, followed
+ * by the one value that's wanted.  Compressed values still have to be
+ * decompressed from the start, so there's nothing to gain for them.
+ */
+JsonbValue *
+getKeyJsonValueFromDatum(Datum jsonb, const char *keyVal, int keyLen,
+						 JsonbValue *res, bool *isobject)
+{
+	struct varlena *attr = (struct varlena *) DatumGetPointer(jsonb);
+	struct varatt_external toast_pointer;
+	JsonbContainer *container;
+	uint32		header;
+	uint32		count;
+	uint32		keysEnd;
+	uint32		valueOff;
+	uint32		valueLen;
+	uint32		pad;
+	uint32		prefixLen;
+	JEntry		entry;
+	int			index;
+	char	   *value;
+
+	if (VARATT_IS_EXTERNAL_ONDISK(attr))
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+
+	if (!VARATT_IS_EXTERNAL_ONDISK(attr) ||
+		VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer) ||
+		VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer) < JSONB_PARTIAL_FETCH_MIN_SIZE)
+	{
+		Jsonb	   *jb = DatumGetJsonbP(jsonb);
+
+		*isobject = JB_ROOT_IS_OBJECT(jb);
+		if (!*isobject)
+			return NULL;
+		return getKeyJsonValueFromContainer(&jb->root, keyVal, keyLen, res);
+	}
+
+	/*
+	 * Fetching the first TOAST chunk costs the same as fetching the header
+	 * alone, and it is often enough to hold all the JEntries and keys too.
+	 */
+	prefixLen = Min(VARATT_EXTERNAL_GET_EXTSIZE(toast_pointer),
+					TOAST_MAX_CHUNK_SIZE);
+	container = (JsonbContainer *) fetchJsonbSlice(attr, 0, prefixLen);
+	header = container->header;
+	*isobject = (header & JB_FOBJECT) != 0;
+	if (!*isobject)
+		return NULL;
+
+	count = header & JB_CMASK;
+	if (count == 0)
+		return NULL;
+
+	if (prefixLen < offsetof(JsonbContainer, children) + count * 2 * sizeof(JEntry))
+	{
+		prefixLen = offsetof(JsonbContainer, children) + count * 2 * sizeof(JEntry);
+		container = (JsonbContainer *) fetchJsonbSlice(attr, 0, prefixLen);
+	}
+
+	keysEnd = getJsonbOffset(container, count);
+	if (prefixLen < offsetof(JsonbContainer, children) +
+		count * 2 * sizeof(JEntry) + keysEnd)
+	{
+		prefixLen = offsetof(JsonbContainer, children) +
+			count * 2 * sizeof(JEntry) + keysEnd;
+		container = (JsonbContainer *) fetchJsonbSlice(attr, 0, prefixLen);
+	}
+
+	index = findJsonbKeyIndex(container, keyVal, keyLen);
+	if (index < 0)
+		return NULL;
+
+	/*
+	 * Fetch the value.  Containers and numerics are int-aligned relative to
+	 * the start of the root container, so start fetching at an aligned
+	 * offset to keep them aligned in our buffer too.
+	 */
+	index += count;
+	entry = container->children[index];
+	valueOff = getJsonbOffset(container, index);
+	valueLen = getJsonbLength(container, index);
+	pad = valueOff - TYPEALIGN_DOWN(ALIGNOF_INT, valueOff);
+	value = fetchJsonbSlice(attr,
+							offsetof(JsonbContainer, children) +
+							count * 2 * sizeof(JEntry) + valueOff - pad,
+							pad + valueLen);
+
+	if (!res)
+		res = palloc(sizeof(JsonbValue));
+
+	fillJsonbValueFromEntry(entry, value, pad, valueLen, res);
 
-			if (!res)
-				res = palloc(sizeof(JsonbValue));
+	return res;
+}
 
-			fillJsonbValue(container, index, baseAddr,
-						   getJsonbOffset(container, index),
-						   res);
+/*
+ * Key lookup request for getKeyJsonValuesFromContainer, sorted by key
+ */
+typedef struct JsonbKeyRequest
+{
+	const char *key;
+	int			keyLen;
+	int			pos;			/* position in the caller's arrays */
+} JsonbKeyRequest;
 
-			return res;
+static int
+compareJsonbKeyRequest(const void *a, const void *b)
+{
+	const JsonbKeyRequest *ra = (const JsonbKeyRequest *) a;
+	const JsonbKeyRequest *rb = (const JsonbKeyRequest *) b;
+
+	return lengthCompareJsonbString(ra->key, ra->keyLen,
+									rb->key, rb->keyLen);
+}
+
+/*
+ * Find the values of several keys of an object container at once.
+ *
+ * For each i, res[i] is filled with the value of key keys[i] (of length
+ * keyLens[i]) and found[i] is set to true, or found[i] is set to false if
+ * the object has no such key.
+ *
+ * Rather than binary-searching for each key, which recomputes JEntry offsets
+ * for every probe, we sort the requested keys the same way the object's keys
+ * are sorted and merge the two lists in a single pass, accumulating offsets
+ * as we go.  That's cheaper once more than a few keys of an object are
+ * wanted.
+ */
+void
+getKeyJsonValuesFromContainer(JsonbContainer *container, int nkeys,
+							  const char **keys, const int *keyLens,
+							  JsonbValue *res, bool *found)
+{
+	JEntry	   *children = container->children;
+	int			count = JsonContainerSize(container);
+	char	   *baseAddr = (char *) (children + count * 2);
+	JsonbKeyRequest *requests;
+	int		   *matches;
+	uint32		offset;
+	int			r;
+	int			lastmatch = -1;
+
+	Assert(JsonContainerIsObject(container));
+
+	memset(found, 0, sizeof(bool) * nkeys);
+	if (count <= 0 || nkeys <= 0)
+		return;
+
+	requests = palloc_array(JsonbKeyRequest, nkeys);
+	for (int i = 0; i < nkeys; i++)
+	{
+		requests[i].key = keys[i];
+		requests[i].keyLen = keyLens[i];
+		requests[i].pos = i;
+	}
+	qsort(requests, nkeys, sizeof(JsonbKeyRequest), compareJsonbKeyRequest);
+
+	/* First pass: match the object's keys against the sorted requests */
+	matches = palloc_array(int, count);
+	offset = 0;
+	r = 0;
+	for (int i = 0; i < count && r < nkeys; i++)
+	{
+		uint32		len = JBE_OFFLENFLD(children[i]);
+		const char *key = baseAddr + offset;
+		int			difference = 1;
+
+		if (JBE_HAS_OFF(children[i]))
+			len -= offset;
+		offset += len;
+		matches[i] = -1;
+
+		/* requests for keys sorting before this one can't be satisfied */
+		while (r < nkeys &&
+			   (difference = lengthCompareJsonbString(key, len,
+													  requests[r].key,
+													  requests[r].keyLen)) > 0)
+			r++;
+
+		if (r < nkeys && difference == 0)
+		{
+			matches[i] = r;
+			lastmatch = i;
+			/* the same key may have been requested more than once */
+			while (r < nkeys &&
+				   lengthCompareJsonbString(key, len, requests[r].key,
+											requests[r].keyLen) == 0)
+				r++;
 		}
-		else
+	}
+
+	/* Second pass: fetch the matched values, continuing the offset count */
+	if (lastmatch >= 0)
+	{
+		offset = getJsonbOffset(container, count);
+		for (int i = 0; i <= lastmatch; i++)
 		{
-			if (difference < 0)
-				stopLow = stopMiddle + 1;
-			else
-				stopHigh = stopMiddle;
+			int			index = count + i;
+			uint32		len = JBE_OFFLENFLD(children[index]);
+
+			if (JBE_HAS_OFF(children[index]))
+				len -= offset;
+
+			if (matches[i] >= 0)
+			{
+				JsonbKeyRequest *req = &requests[matches[i]];
+
+				fillJsonbValue(container, index, baseAddr, offset,
+							   &res[req->pos]);
+				found[req->pos] = true;
+
+				for (int d = matches[i] + 1;
+					 d < nkeys && compareJsonbKeyRequest(req, &requests[d]) == 0;
+					 d++)
+				{
+					res[requests[d].pos] = res[req->pos];
+					found[requests[d].pos] = true;
+				}
+			}
+			offset += len;
 		}
 	}
 
-	/* Not found */
-	return NULL;
+	pfree(matches);
+	pfree(requests);
 }
 
 /*
@@ -507,7 +797,23 @@ fillJsonbValue(JsonbContainer *container, int index,
 			   JsonbValue *result)
 {
 	JEntry		entry = container->children[index];
+	uint32		len = 0;
+
+	/* Only strings and containers need the length */
+	if (JBE_ISSTRING(entry) || JBE_ISCONTAINER(entry))
+		len = getJsonbLength(container, index);
+
+	fillJsonbValueFromEntry(entry, base_addr, offset, len, result);
+}
 
+/*
+ * Workhorse for fillJsonbValue(), for callers that have the JEntry and the
+ * length of the node's data at hand rather than the node's container.
+ */
+static void
+fillJsonbValueFromEntry(JEntry entry, char *base_addr, uint32 offset,
+						uint32 len, JsonbValue *result)
+{
 	if (JBE_ISNULL(entry))
 	{
 		result->type = jbvNull;
@@ -516,8 +822,7 @@ fillJsonbValue(JsonbContainer *container, int index,
 	{
 		result->type = jbvString;
 		result->val.string.val = base_addr + offset;
-		result->val.string.len = getJsonbLength(container, index);
-		Assert(result->val.string.len >= 0);
+		result->val.string.len = len;
 	}
 	else if (JBE_ISNUMERIC(entry))
 	{
@@ -540,8 +845,7 @@ fillJsonbValue(JsonbContainer *container, int index,
 		result->type = jbvBinary;
 		/* Remove alignment padding from data pointer and length */
 		result->val.binary.data = (JsonbContainer *) (base_addr + INTALIGN(offset));
-		result->val.binary.len = getJsonbLength(container, index) -
-			(INTALIGN(offset) - offset);
+		result->val.binary.len = len - (INTALIGN(offset) - offset);
 	}
 }
 
@@ -858,18 +858,16 @@ json_object_field(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
 	text	   *key = PG_GETARG_TEXT_PP(1);
 	JsonbValue *v;
 	JsonbValue	vbuf;
+	bool		isobject;
 
-	if (!JB_ROOT_IS_OBJECT(jb))
-		PG_RETURN_NULL();
-
-	v = getKeyJsonValueFromContainer(&jb->root,
-									 VARDATA_ANY(key),
-									 VARSIZE_ANY_EXHDR(key),
-									 &vbuf);
+	/* avoid detoasting all of a large object for one key, if we can */
+	v = getKeyJsonValueFromDatum(PG_GETARG_DATUM(0),
+								 VARDATA_ANY(key),
+								 VARSIZE_ANY_EXHDR(key),
+								 &vbuf, &isobject);
 
 	if (v != NULL)
 		PG_RETURN_JSONB_P(JsonbValueToJsonb(v));
@@ -896,18 +894,16 @@ json_object_field_text(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field_text(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
 	text	   *key = PG_GETARG_TEXT_PP(1);
 	JsonbValue *v;
 	JsonbValue	vbuf;
+	bool		isobject;
 
-	if (!JB_ROOT_IS_OBJECT(jb))
-		PG_RETURN_NULL();
-
-	v = getKeyJsonValueFromContainer(&jb->root,
-									 VARDATA_ANY(key),
-									 VARSIZE_ANY_EXHDR(key),
-									 &vbuf);
+	/* avoid detoasting all of a large object for one key, if we can */
+	v = getKeyJsonValueFromDatum(PG_GETARG_DATUM(0),
+								 VARDATA_ANY(key),
+								 VARSIZE_ANY_EXHDR(key),
+								 &vbuf, &isobject);
 
 	if (v != NULL && v->type != jbvNull)
 		PG_RETURN_TEXT_P(JsonbValueAsText(v));
@@ -915,6 +911,82 @@ jsonb_object_field_text(PG_FUNCTION_ARGS)
 	PG_RETURN_NULL();
 }
 
+/*
+ * jsonb_object_fields_text
+ *		Fetch several fields of a jsonb object as text, in one pass
+ *
+ * The result array has one element per requested key, which is NULL if the
+ * key is NULL or absent or its value is a JSON null.
+ */
+Datum
+jsonb_object_fields_text(PG_FUNCTION_ARGS)
+{
+	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	ArrayType  *keys = PG_GETARG_ARRAYTYPE_P(1);
+	Datum	   *keytext;
+	bool	   *keynulls;
+	int			nkeys;
+	const char **keyvals;
+	int		   *keylens;
+	JsonbValue *vals;
+	bool	   *found;
+	Datum	   *result;
+	bool	   *resultnulls;
+	int			dims[1];
+	int			lbs[1];
+
+	if (!JB_ROOT_IS_OBJECT(jb))
+		PG_RETURN_NULL();
+
+	deconstruct_array_builtin(keys, TEXTOID, &keytext, &keynulls, &nkeys);
+
+	if (nkeys == 0)
+		PG_RETURN_ARRAYTYPE_P(construct_empty_array(TEXTOID));
+
+	keyvals = palloc_array(const char *, nkeys);
+	keylens = palloc_array(int, nkeys);
+	for (int i = 0; i < nkeys; i++)
+	{
+		/* a null key can't match; look for "" and ignore the result */
+		if (keynulls[i])
+		{
+			keyvals[i] = "";
+			keylens[i] = 0;
+		}
+		else
+		{
+			keyvals[i] = VARDATA_ANY(DatumGetTextPP(keytext[i]));
+			keylens[i] = VARSIZE_ANY_EXHDR(DatumGetTextPP(keytext[i]));
+		}
+	}
+
+	vals = palloc_array(JsonbValue, nkeys);
+	found = palloc_array(bool, nkeys);
+	getKeyJsonValuesFromContainer(&jb->root, nkeys, keyvals, keylens,
+								  vals, found);
+
+	result = palloc_array(Datum, nkeys);
+	resultnulls = palloc_array(bool, nkeys);
+	for (int i = 0; i < nkeys; i++)
+	{
+		if (keynulls[i] || !found[i] || vals[i].type == jbvNull)
+		{
+			result[i] = (Datum) 0;
+			resultnulls[i] = true;
+		}
+		else
+		{
+			result[i] = PointerGetDatum(JsonbValueAsText(&vals[i]));
+			resultnulls[i] = false;
+		}
+	}
+
+	dims[0] = nkeys;
+	lbs[0] = 1;
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(result, resultnulls, 1, dims, lbs,
+											 TEXTOID, -1, false, TYPALIGN_INT));
+}
+
 Datum
 json_array_element(PG_FUNCTION_ARGS)
 {
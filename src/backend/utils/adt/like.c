@@ -24,6 +24,7 @@
 #include "miscadmin.h"
 #include "utils/fmgrprotos.h"
 #include "utils/pg_locale.h"
+#include "utils/varlena.h"
 #include "varatt.h"
 
 
@@ -127,6 +128,7 @@ SB_lower_char(unsigned char c, pg_locale_t locale, bool locale_is_c)
 
 #define MatchText	SB_MatchText
 #define do_like_escape	SB_do_like_escape
+#define MATCH_FIND_LITERAL
 
 #include "like_match.c"
 
@@ -142,6 +144,7 @@ SB_lower_char(unsigned char c, pg_locale_t locale, bool locale_is_c)
 #define NextChar(p, plen) \
 	do { (p)++; (plen)--; } while ((plen) > 0 && (*(p) & 0xC0) == 0x80 )
 #define MatchText	UTF8_MatchText
+#define MATCH_FIND_LITERAL
 
 #include "like_match.c"
 
@@ -15,6 +15,8 @@
  * MatchText - to name of function wanted
  * do_like_escape - name of function if wanted - needs CHAREQ and CopyAdvChar
  * MATCH_LOWER - define for case (4) to specify case folding for 1-byte chars
+ * MATCH_FIND_LITERAL - define if every byte match of a pattern character in
+ *		the text is at a character boundary, as in cases (1) and (2)
  *
  * Copyright (c) 1996-2024, PostgreSQL Global Development Group
  *
@@ -171,6 +173,43 @@ MatchText(const char *t, int tlen, const char *p, int plen,
 			else
 				firstpat = GETCHAR(*p);
 
+#ifdef MATCH_FIND_LITERAL
+
+			/*
+			 * If the rest of the pattern starts with a run of unescaped
+			 * literal bytes, search for the whole run instead, which is much
+			 * faster than testing each text byte.  Any match found starts at
+			 * a character boundary, so we stay char-synced.
+			 */
+			if (*p != '\\')
+			{
+				int			litlen = 1;
+
+				while (litlen < plen && p[litlen] != '%' &&
+					   p[litlen] != '_' && p[litlen] != '\\')
+					litlen++;
+
+				while (tlen > 0)
+				{
+					const char *next = varstr_find(t, tlen, p, litlen);
+					int			matched;
+
+					if (next == NULL)
+						break;
+					tlen -= next - t;
+					t = next;
+
+					matched = MatchText(t, tlen, p, plen, locale, locale_is_c);
+					if (matched != LIKE_FALSE)
+						return matched; /* TRUE or ABORT */
+
+					NextChar(t, tlen);
+				}
+
+				return LIKE_ABORT;
+			}
+#endif
+
 			while (tlen > 0)
 			{
 				if (GETCHAR(*t) == firstpat)
@@ -356,5 +395,8 @@ do_like_escape(text *pat, text *esc)
 
 #ifdef MATCH_LOWER
 #undef MATCH_LOWER
+#endif
 
+#ifdef MATCH_FIND_LITERAL
+#undef MATCH_FIND_LITERAL
 #endif
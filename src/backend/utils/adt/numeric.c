@@ -527,6 +527,9 @@ static bool numericvar_to_uint64(const NumericVar *var, uint64 *result);
 #ifdef HAVE_INT128
 static bool numericvar_to_int128(const NumericVar *var, int128 *result);
 static void int128_to_numericvar(int128 val, NumericVar *var);
+static bool numeric_to_fixed(Numeric num, int dscale, int128 limit,
+							 int128 *result);
+static Numeric fixed_to_numeric(int128 val, int dscale);
 #endif
 static double numericvar_to_double_no_overflow(const NumericVar *var);
 
@@ -2839,6 +2842,139 @@ hash_numeric_extended(PG_FUNCTION_ARGS)
  */
 
 
+#ifdef HAVE_INT128
+/*
+ * Fixed-point fast path for add, subtract and multiply.
+ *
+ * Most numeric values in practice, money amounts for instance, have only a
+ * few digits.  For those, scaling the inputs to integers and doing the
+ * arithmetic on int128 is much cheaper than the general digit-array routines,
+ * and gives exactly the same result.  numeric_to_fixed() refuses anything
+ * that might not fit, and the caller then takes the general path.
+ */
+#define NUMERIC_FIXED_MAX_NDIGITS	4	/* NBASE digits accepted per input */
+#define NUMERIC_FIXED_MAX_SHIFT		18	/* largest power of 10 applied */
+
+static const int64 fixed_pow10[NUMERIC_FIXED_MAX_SHIFT + 1] = {
+	INT64CONST(1), INT64CONST(10), INT64CONST(100), INT64CONST(1000),
+	INT64CONST(10000), INT64CONST(100000), INT64CONST(1000000),
+	INT64CONST(10000000), INT64CONST(100000000), INT64CONST(1000000000),
+	INT64CONST(10000000000), INT64CONST(100000000000),
+	INT64CONST(1000000000000), INT64CONST(10000000000000),
+	INT64CONST(100000000000000), INT64CONST(1000000000000000),
+	INT64CONST(10000000000000000), INT64CONST(100000000000000000),
+	INT64CONST(1000000000000000000)
+};
+
+/*
+ * Input limits that keep results within 10^37, as fixed_to_numeric()
+ * requires: sums and differences of two values below 10^36 (in practice the
+ * inputs are below 10^34), and products of two values below 10^17.
+ */
+#define NUMERIC_FIXED_ADD_LIMIT	((int128) fixed_pow10[18] * fixed_pow10[18])
+#define NUMERIC_FIXED_MUL_LIMIT	((int128) fixed_pow10[17])
+
+/*
+ * Convert a finite numeric to an integer holding its value times
+ * 10^dscale, which must be at least the numeric's own dscale.  Returns false
+ * if the numeric has too many digits, or if the absolute value of the result
+ * would not be less than limit.
+ */
+static bool
+numeric_to_fixed(Numeric num, int dscale, int128 limit, int128 *result)
+{
+	int			ndigits = NUMERIC_NDIGITS(num);
+	NumericDigit *digits = NUMERIC_DIGITS(num);
+	int			shift;
+	int128		val = 0;
+
+	Assert(!NUMERIC_IS_SPECIAL(num));
+	Assert(dscale >= NUMERIC_DSCALE(num));
+
+	if (ndigits == 0)
+	{
+		*result = 0;
+		return true;
+	}
+	if (ndigits > NUMERIC_FIXED_MAX_NDIGITS)
+		return false;
+
+	/* decimal exponent of the last digit, relative to 10^-dscale */
+	shift = (NUMERIC_WEIGHT(num) - ndigits + 1) * DEC_DIGITS + dscale;
+	if (shift > NUMERIC_FIXED_MAX_SHIFT || shift <= -DEC_DIGITS)
+		return false;
+
+	for (int i = 0; i < ndigits; i++)
+		val = val * NBASE + digits[i];
+
+	/*
+	 * A negative shift means the last digit extends below 10^-dscale; its
+	 * low-order decimal digits should then be zero, since dscale is at least
+	 * the numeric's own.
+	 */
+	if (shift >= 0)
+		val *= fixed_pow10[shift];
+	else
+	{
+		if (val % fixed_pow10[-shift] != 0)
+			return false;
+		val /= fixed_pow10[-shift];
+	}
+
+	if (val >= limit)
+		return false;
+
+	*result = (NUMERIC_SIGN(num) == NUMERIC_NEG) ? -val : val;
+	return true;
+}
+
+/*
+ * Convert val / 10^dscale back into a numeric.  The absolute value of val
+ * must be less than 10^37.
+ */
+static Numeric
+fixed_to_numeric(int128 val, int dscale)
+{
+	NumericVar	var;
+	NumericDigit digits[40 / DEC_DIGITS];
+	NumericDigit *ptr = digits + lengthof(digits);
+	int			pad = (DEC_DIGITS - dscale % DEC_DIGITS) % DEC_DIGITS;
+	uint128		uval;
+
+	/* Make the scale a whole number of NBASE digits */
+	val *= fixed_pow10[pad];
+
+	var.buf = NULL;
+	var.dscale = dscale;
+	if (val < 0)
+	{
+		var.sign = NUMERIC_NEG;
+		uval = -val;
+	}
+	else
+	{
+		var.sign = NUMERIC_POS;
+		uval = val;
+	}
+
+	while (uval != 0)
+	{
+		uint128		newuval = uval / NBASE;
+
+		*--ptr = (NumericDigit) (uval - newuval * NBASE);
+		uval = newuval;
+	}
+	var.digits = ptr;
+	var.ndigits = digits + lengthof(digits) - ptr;
+	if (var.ndigits == 0)
+		var.weight = 0;
+	else
+		var.weight = var.ndigits - 1 - (dscale + pad) / DEC_DIGITS;
+
+	return make_result(&var);
+}
+#endif							/* HAVE_INT128 */
+
 /*
  * numeric_add() -
  *
@@ -2899,6 +3035,18 @@ numeric_add_opt_error(Numeric num1, Numeric num2, bool *have_error)
 		return make_result(&const_ninf);
 	}
 
+#ifdef HAVE_INT128
+	{
+		int			rscale = Max(NUMERIC_DSCALE(num1), NUMERIC_DSCALE(num2));
+		int128		val1;
+		int128		val2;
+
+		if (numeric_to_fixed(num1, rscale, NUMERIC_FIXED_ADD_LIMIT, &val1) &&
+			numeric_to_fixed(num2, rscale, NUMERIC_FIXED_ADD_LIMIT, &val2))
+			return fixed_to_numeric(val1 + val2, rscale);
+	}
+#endif
+
 	/*
 	 * Unpack the values, let add_var() compute the result and return it.
 	 */
@@ -2977,6 +3125,18 @@ numeric_sub_opt_error(Numeric num1, Numeric num2, bool *have_error)
 		return make_result(&const_pinf);
 	}
 
+#ifdef HAVE_INT128
+	{
+		int			rscale = Max(NUMERIC_DSCALE(num1), NUMERIC_DSCALE(num2));
+		int128		val1;
+		int128		val2;
+
+		if (numeric_to_fixed(num1, rscale, NUMERIC_FIXED_ADD_LIMIT, &val1) &&
+			numeric_to_fixed(num2, rscale, NUMERIC_FIXED_ADD_LIMIT, &val2))
+			return fixed_to_numeric(val1 - val2, rscale);
+	}
+#endif
+
 	/*
 	 * Unpack the values, let sub_var() compute the result and return it.
 	 */
@@ -3098,6 +3258,21 @@ numeric_mul_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	 * correctly rounded (rounding in mul_var() using a truncated product
 	 * would not guarantee this).
 	 */
+#ifdef HAVE_INT128
+	{
+		int			dscale1 = NUMERIC_DSCALE(num1);
+		int			dscale2 = NUMERIC_DSCALE(num2);
+		int128		val1;
+		int128		val2;
+
+		/* the exact product is representable, so no rounding is needed */
+		if (dscale1 + dscale2 <= NUMERIC_DSCALE_MAX &&
+			numeric_to_fixed(num1, dscale1, NUMERIC_FIXED_MUL_LIMIT, &val1) &&
+			numeric_to_fixed(num2, dscale2, NUMERIC_FIXED_MUL_LIMIT, &val2))
+			return fixed_to_numeric(val1 * val2, dscale1 + dscale2);
+	}
+#endif
+
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
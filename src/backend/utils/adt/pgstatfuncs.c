@@ -22,10 +22,12 @@
 #include "catalog/pg_type.h"
 #include "common/ip.h"
 #include "funcapi.h"
+#include "libpq/libpq.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/bgworker.h"
 #include "replication/logicallauncher.h"
+#include "storage/bufmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "utils/acl.h"
@@ -302,7 +304,7 @@ pg_stat_get_progress_info(PG_FUNCTION_ARGS)
 Datum
 pg_stat_get_activity(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_ACTIVITY_COLS	31
+#define PG_STAT_GET_ACTIVITY_COLS	32
 	int			num_backends = pgstat_fetch_stat_numbackends();
 	int			curr_backend;
 	int			pid = PG_ARGISNULL(0) ? -1 : PG_GETARG_INT32(0);
@@ -348,6 +350,8 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 		else
 			nulls[3] = true;
 
+		values[31] = Int64GetDatum((int64) beentry->st_allocated_bytes);
+
 		if (TransactionIdIsValid(local_beentry->backend_xid))
 			values[15] = TransactionIdGetDatum(local_beentry->backend_xid);
 		else
@@ -1027,6 +1031,21 @@ PG_STAT_GET_DBENTRY_INT64(conflict_tablespace)
 /* pg_stat_get_db_deadlocks */
 PG_STAT_GET_DBENTRY_INT64(deadlocks)
 
+/* pg_stat_get_db_deadlock_checks */
+PG_STAT_GET_DBENTRY_INT64(deadlock_checks)
+
+/* pg_stat_get_db_deadlock_full_checks */
+PG_STAT_GET_DBENTRY_INT64(deadlock_full_checks)
+
+/* pg_stat_get_db_subxid_overflows */
+PG_STAT_GET_DBENTRY_INT64(subxid_overflows)
+
+/* pg_stat_get_db_predlock_promotions */
+PG_STAT_GET_DBENTRY_INT64(predlock_promotions)
+
+/* pg_stat_get_db_serialization_failures */
+PG_STAT_GET_DBENTRY_INT64(serialization_failures)
+
 /* pg_stat_get_db_sessions */
 PG_STAT_GET_DBENTRY_INT64(sessions)
 
@@ -1176,6 +1195,9 @@ PG_STAT_GET_DBENTRY_FLOAT8_MS(blk_write_time)
 /* pg_stat_get_db_idle_in_transaction_time */
 PG_STAT_GET_DBENTRY_FLOAT8_MS(idle_in_transaction_time)
 
+/* pg_stat_get_db_deadlock_check_time */
+PG_STAT_GET_DBENTRY_FLOAT8_MS(deadlock_check_time)
+
 /* pg_stat_get_db_session_time */
 PG_STAT_GET_DBENTRY_FLOAT8_MS(session_time)
 
@@ -1282,6 +1304,7 @@ typedef enum io_stat_col
 	IO_COL_CONVERSION,
 	IO_COL_HITS,
 	IO_COL_EVICTIONS,
+	IO_COL_EVICTION_RETRIES,
 	IO_COL_REUSES,
 	IO_COL_FSYNCS,
 	IO_COL_FSYNC_TIME,
@@ -1300,6 +1323,8 @@ pgstat_get_io_op_index(IOOp io_op)
 	{
 		case IOOP_EVICT:
 			return IO_COL_EVICTIONS;
+		case IOOP_EVICT_RETRY:
+			return IO_COL_EVICTION_RETRIES;
 		case IOOP_EXTEND:
 			return IO_COL_EXTENDS;
 		case IOOP_FSYNC:
@@ -1338,6 +1363,7 @@ pgstat_get_io_time_index(IOOp io_op)
 		case IOOP_FSYNC:
 			return pgstat_get_io_op_index(io_op) + 1;
 		case IOOP_EVICT:
+		case IOOP_EVICT_RETRY:
 		case IOOP_HIT:
 		case IOOP_REUSE:
 			return IO_COL_INVALID;
@@ -1462,6 +1488,53 @@ pg_stat_get_io(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Returns the number of shared buffers holding pages of each relation fork
+ * of the current database and of the shared catalogs, as maintained when
+ * track_buffer_residency is on.
+ */
+Datum
+pg_stat_get_buffer_residency(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_BUFFER_RESIDENCY_COLS	5
+	ReturnSetInfo *rsinfo;
+	BufferResidency *entries;
+	int			nentries;
+
+	if (!track_buffer_residency)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("buffer residency tracking is not enabled"),
+				 errhint("Enable \"%s\" and restart the server.",
+						 "track_buffer_residency")));
+
+	InitMaterializedSRF(fcinfo, 0);
+	rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	entries = BufResidencySnapshot(&nentries);
+
+	for (int i = 0; i < nentries; i++)
+	{
+		Datum		values[PG_STAT_GET_BUFFER_RESIDENCY_COLS] = {0};
+		bool		nulls[PG_STAT_GET_BUFFER_RESIDENCY_COLS] = {0};
+
+		if (entries[i].rlocator.dbOid != MyDatabaseId &&
+			entries[i].rlocator.dbOid != InvalidOid)
+			continue;
+
+		values[0] = ObjectIdGetDatum(entries[i].rlocator.spcOid);
+		values[1] = ObjectIdGetDatum(entries[i].rlocator.dbOid);
+		values[2] = ObjectIdGetDatum(entries[i].rlocator.relNumber);
+		values[3] = Int16GetDatum(entries[i].forkNum);
+		values[4] = Int64GetDatum(entries[i].nbuffers);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 /*
  * Returns statistics of WAL activity
  */
@@ -1526,6 +1599,42 @@ pg_stat_get_wal(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
+/*
+ * Returns statistics about the stream compression of the current session's
+ * client connection
+ */
+Datum
+pg_stat_get_protocol_compression(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PROTOCOL_COMPRESSION_COLS	6
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_PROTOCOL_COMPRESSION_COLS] = {0};
+	bool		nulls[PG_STAT_GET_PROTOCOL_COMPRESSION_COLS] = {0};
+	pg_compress_algorithm algorithm;
+	uint64		raw_sent;
+	uint64		compressed_sent;
+	uint64		raw_received;
+	uint64		compressed_received;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	algorithm = pq_get_compression_stats(&raw_sent, &compressed_sent,
+										 &raw_received, &compressed_received);
+
+	values[0] = Int32GetDatum(MyProcPid);
+	if (algorithm != PG_COMPRESSION_NONE)
+		values[1] = CStringGetTextDatum(get_compress_algorithm_name(algorithm));
+	else
+		nulls[1] = true;
+	values[2] = Int64GetDatum(raw_sent);
+	values[3] = Int64GetDatum(compressed_sent);
+	values[4] = Int64GetDatum(raw_received);
+	values[5] = Int64GetDatum(compressed_received);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 /*
  * Returns statistics of SLRU caches.
  */
@@ -30,7 +30,9 @@
 #include "postgres.h"
 
 #include "catalog/pg_type.h"
+#include "common/hashfn.h"
 #include "funcapi.h"
+#include "lib/ilist.h"
 #include "regex/regex.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
@@ -67,33 +69,30 @@ typedef struct regexp_matches_ctx
 } regexp_matches_ctx;
 
 /*
- * We cache precompiled regular expressions using a "self organizing list"
- * structure, in which recently-used items tend to be near the front.
- * Whenever we use an entry, it's moved up to the front of the list.
- * Over time, an item's average position corresponds to its frequency of use.
+ * We cache precompiled regular expressions, since compiling them is costly
+ * and queries tend to use the same few patterns over and over.  Cached
+ * entries are found through a hash table and kept in a list in order of
+ * use: whenever we use an entry, it's moved to the front of the list.
  *
- * When we first create an entry, it's inserted at the front of
- * the array, dropping the entry at the end of the array if necessary to
- * make room.  (This might seem to be weighting the new entry too heavily,
- * but if we insert new entries further back, we'll be unable to adjust to
- * a sudden shift in the query mix where we are presented with MAX_CACHED_RES
- * never-before-seen items used circularly.  We ought to be able to handle
- * that case, so we have to insert at the front.)
+ * When we first create an entry, it's inserted at the front of the list,
+ * and entries are dropped from the end of the list until the cache fits
+ * within regexp_cache_size again.  (This might seem to be weighting the new
+ * entry too heavily, but if we insert new entries further back, we'll be
+ * unable to adjust to a sudden shift in the query mix where we are presented
+ * with more never-before-seen items than fit in the cache, used circularly.
+ * We ought to be able to handle that case, so we have to insert at the
+ * front.)  The limit is on memory rather than on the number of entries,
+ * because compiled regexps vary in size by orders of magnitude.
  *
- * Knuth mentions a variant strategy in which a used item is moved up just
- * one place in the list.  Although he says this uses fewer comparisons on
- * average, it seems not to adapt very well to the situation where you have
- * both some reusable patterns and a steady stream of non-reusable patterns.
- * A reusable pattern that isn't used at least as often as non-reusable
- * patterns are seen will "fail to keep up" and will drop off the end of the
- * cache.  With move-to-front, a reusable pattern is guaranteed to stay in
- * the cache as long as it's used at least once in every MAX_CACHED_RES uses.
+ * A regex_t returned by RE_compile_and_cache() therefore stays valid only
+ * until the next call, which might evict it.
  */
 
-/* this is the maximum number of cached regular expressions */
-#ifndef MAX_CACHED_RES
-#define MAX_CACHED_RES	32
-#endif
+/* number of hash buckets; the cache is meant to hold hundreds of entries */
+#define RE_CACHE_BUCKETS	1024
+
+/* GUC variable: cache size limit, in kilobytes */
+int			regexp_cache_size = 4096;
 
 /* A parent memory context for regular expressions. */
 static MemoryContext RegexpCacheMemoryContext;
@@ -101,6 +100,10 @@ static MemoryContext RegexpCacheMemoryContext;
 /* this structure describes one cached regular expression */
 typedef struct cached_re_str
 {
+	dlist_node	cre_lru_node;	/* link in re_lru list */
+	dlist_node	cre_hash_node;	/* link in re_buckets[] chain */
+	uint32		cre_hash;		/* hash of pattern, flags and collation */
+	Size		cre_size;		/* memory used by this entry */
 	MemoryContext cre_context;	/* memory context for this regexp */
 	char	   *cre_pat;		/* original RE (not null terminated!) */
 	int			cre_pat_len;	/* length of original RE, in bytes */
@@ -109,8 +112,9 @@ typedef struct cached_re_str
 	regex_t		cre_re;			/* the compiled regular expression */
 } cached_re_str;
 
-static int	num_res = 0;		/* # of cached re's */
-static cached_re_str re_array[MAX_CACHED_RES];	/* cached re's */
+static dlist_head re_lru = DLIST_STATIC_INIT(re_lru);	/* most recent first */
+static dlist_head *re_buckets = NULL;	/* hash table of cached re's */
+static Size re_cache_used = 0;	/* memory used by cached re's */
 
 
 /* Local functions */
@@ -144,48 +148,54 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	char	   *text_re_val = VARDATA_ANY(text_re);
 	pg_wchar   *pattern;
 	int			pattern_len;
-	int			i;
+	uint32		hash;
+	dlist_head *bucket;
+	dlist_iter	iter;
 	int			regcomp_result;
-	cached_re_str re_temp;
+	MemoryContext re_context;
+	cached_re_str *re_new;
 	char		errMsg[100];
 	MemoryContext oldcontext;
 
-	/*
-	 * Look for a match among previously compiled REs.  Since the data
-	 * structure is self-organizing with most-used entries at the front, our
-	 * search strategy can just be to scan from the front.
-	 */
-	for (i = 0; i < num_res; i++)
-	{
-		if (re_array[i].cre_pat_len == text_re_len &&
-			re_array[i].cre_flags == cflags &&
-			re_array[i].cre_collation == collation &&
-			memcmp(re_array[i].cre_pat, text_re_val, text_re_len) == 0)
-		{
-			/*
-			 * Found a match; move it to front if not there already.
-			 */
-			if (i > 0)
-			{
-				re_temp = re_array[i];
-				memmove(&re_array[1], &re_array[0], i * sizeof(cached_re_str));
-				re_array[0] = re_temp;
-			}
-
-			return &re_array[0].cre_re;
-		}
-	}
-
-	/* Set up the cache memory on first go through. */
+	/* Set up the cache on first go through. */
 	if (unlikely(RegexpCacheMemoryContext == NULL))
+	{
 		RegexpCacheMemoryContext =
 			AllocSetContextCreate(TopMemoryContext,
 								  "RegexpCacheMemoryContext",
 								  ALLOCSET_SMALL_SIZES);
+		re_buckets = MemoryContextAlloc(RegexpCacheMemoryContext,
+										RE_CACHE_BUCKETS * sizeof(dlist_head));
+		for (int i = 0; i < RE_CACHE_BUCKETS; i++)
+			dlist_init(&re_buckets[i]);
+	}
+
+	/* Look for a match among previously compiled REs. */
+	hash = hash_bytes((const unsigned char *) text_re_val, text_re_len);
+	hash = hash_combine(hash, (uint32) cflags);
+	hash = hash_combine(hash, (uint32) collation);
+	bucket = &re_buckets[hash % RE_CACHE_BUCKETS];
+
+	dlist_foreach(iter, bucket)
+	{
+		cached_re_str *cre = dlist_container(cached_re_str, cre_hash_node,
+											 iter.cur);
+
+		if (cre->cre_hash == hash &&
+			cre->cre_pat_len == text_re_len &&
+			cre->cre_flags == cflags &&
+			cre->cre_collation == collation &&
+			memcmp(cre->cre_pat, text_re_val, text_re_len) == 0)
+		{
+			/* Found a match; move it to front of the use order. */
+			dlist_move_head(&re_lru, &cre->cre_lru_node);
+
+			return &cre->cre_re;
+		}
+	}
 
 	/*
-	 * Couldn't find it, so try to compile the new RE.  To avoid leaking
-	 * resources on failure, we build into the re_temp local.
+	 * Couldn't find it, so try to compile the new RE.
 	 */
 
 	/* Convert pattern string to wide characters */
@@ -195,18 +205,21 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 									   text_re_len);
 
 	/*
-	 * Make a memory context for this compiled regexp.  This is initially a
-	 * child of the current memory context, so it will be cleaned up
-	 * automatically if compilation is interrupted and throws an ERROR. We'll
-	 * re-parent it under the longer lived cache context if we make it to the
-	 * bottom of this function.
+	 * Make a memory context for this compiled regexp, and build the cache
+	 * entry in it.  This is initially a child of the current memory context,
+	 * so it will be cleaned up automatically if compilation is interrupted
+	 * and throws an ERROR. We'll re-parent it under the longer lived cache
+	 * context if we make it to the bottom of this function.
 	 */
-	re_temp.cre_context = AllocSetContextCreate(CurrentMemoryContext,
-												"RegexpMemoryContext",
-												ALLOCSET_SMALL_SIZES);
-	oldcontext = MemoryContextSwitchTo(re_temp.cre_context);
+	re_context = AllocSetContextCreate(CurrentMemoryContext,
+									   "RegexpMemoryContext",
+									   ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(re_context);
 
-	regcomp_result = pg_regcomp(&re_temp.cre_re,
+	re_new = palloc(sizeof(cached_re_str));
+	re_new->cre_context = re_context;
+
+	regcomp_result = pg_regcomp(&re_new->cre_re,
 								pattern,
 								pattern_len,
 								cflags,
@@ -217,51 +230,57 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	if (regcomp_result != REG_OKAY)
 	{
 		/* re didn't compile (no need for pg_regfree, if so) */
-		pg_regerror(regcomp_result, &re_temp.cre_re, errMsg, sizeof(errMsg));
+		pg_regerror(regcomp_result, &re_new->cre_re, errMsg, sizeof(errMsg));
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_REGULAR_EXPRESSION),
 				 errmsg("invalid regular expression: %s", errMsg)));
 	}
 
 	/* Copy the pattern into the per-regexp memory context. */
-	re_temp.cre_pat = palloc(text_re_len + 1);
-	memcpy(re_temp.cre_pat, text_re_val, text_re_len);
+	re_new->cre_pat = palloc(text_re_len + 1);
+	memcpy(re_new->cre_pat, text_re_val, text_re_len);
 
 	/*
 	 * NUL-terminate it only for the benefit of the identifier used for the
 	 * memory context, visible in the pg_backend_memory_contexts view.
 	 */
-	re_temp.cre_pat[text_re_len] = 0;
-	MemoryContextSetIdentifier(re_temp.cre_context, re_temp.cre_pat);
+	re_new->cre_pat[text_re_len] = 0;
+	MemoryContextSetIdentifier(re_context, re_new->cre_pat);
 
-	re_temp.cre_pat_len = text_re_len;
-	re_temp.cre_flags = cflags;
-	re_temp.cre_collation = collation;
+	re_new->cre_pat_len = text_re_len;
+	re_new->cre_flags = cflags;
+	re_new->cre_collation = collation;
+	re_new->cre_hash = hash;
+	re_new->cre_size = MemoryContextMemAllocated(re_context, true);
 
 	/*
-	 * Okay, we have a valid new item in re_temp; insert it into the storage
-	 * array.  Discard last entry if needed.
+	 * Okay, we have a valid new entry; make room for it by discarding the
+	 * least recently used entries, then insert it.  We always keep the new
+	 * entry, even if it alone exceeds the limit.
 	 */
-	if (num_res >= MAX_CACHED_RES)
+	while (!dlist_is_empty(&re_lru) &&
+		   re_cache_used + re_new->cre_size > (Size) regexp_cache_size * 1024)
 	{
-		--num_res;
-		Assert(num_res < MAX_CACHED_RES);
+		cached_re_str *victim = dlist_tail_element(cached_re_str,
+												   cre_lru_node, &re_lru);
+
+		dlist_delete(&victim->cre_lru_node);
+		dlist_delete(&victim->cre_hash_node);
+		re_cache_used -= victim->cre_size;
 		/* Delete the memory context holding the regexp and pattern. */
-		MemoryContextDelete(re_array[num_res].cre_context);
+		MemoryContextDelete(victim->cre_context);
 	}
 
 	/* Re-parent the memory context to our long-lived cache context. */
-	MemoryContextSetParent(re_temp.cre_context, RegexpCacheMemoryContext);
-
-	if (num_res > 0)
-		memmove(&re_array[1], &re_array[0], num_res * sizeof(cached_re_str));
+	MemoryContextSetParent(re_context, RegexpCacheMemoryContext);
 
-	re_array[0] = re_temp;
-	num_res++;
+	dlist_push_head(&re_lru, &re_new->cre_lru_node);
+	dlist_push_head(bucket, &re_new->cre_hash_node);
+	re_cache_used += re_new->cre_size;
 
 	MemoryContextSwitchTo(oldcontext);
 
-	return &re_array[0].cre_re;
+	return &re_new->cre_re;
 }
 
 /*
@@ -23,11 +23,14 @@
 
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/htup_details.h"
+#include "access/stratnum.h"
 #include "access/sysattr.h"
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/xact.h"
+#include "catalog/pg_am_d.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_constraint.h"
 #include "commands/trigger.h"
@@ -108,6 +111,7 @@ typedef struct RI_ConstraintInfo
 	NameData	conname;		/* name of the FK constraint */
 	Oid			pk_relid;		/* referenced relation */
 	Oid			fk_relid;		/* referencing relation */
+	Oid			conindid;		/* unique index on referenced columns */
 	char		confupdtype;	/* foreign key's ON UPDATE action */
 	char		confdeltype;	/* foreign key's ON DELETE action */
 	int			ndelsetcols;	/* number of columns referenced in ON DELETE
@@ -216,6 +220,9 @@ static const RI_ConstraintInfo *ri_LoadConstraintInfo(Oid constraintOid);
 static Oid	get_ri_constraint_root(Oid constrOid);
 static SPIPlanPtr ri_PlanCheck(const char *querystr, int nargs, Oid *argtypes,
 							   RI_QueryKey *qkey, Relation fk_rel, Relation pk_rel);
+static bool ri_FastPathCheck(const RI_ConstraintInfo *riinfo,
+							 Relation fk_rel, Relation pk_rel,
+							 TupleTableSlot *newslot);
 static bool ri_PerformCheck(const RI_ConstraintInfo *riinfo,
 							RI_QueryKey *qkey, SPIPlanPtr qplan,
 							Relation fk_rel, Relation pk_rel,
@@ -340,6 +347,16 @@ RI_FKey_check(TriggerData *trigdata)
 			break;
 	}
 
+	/*
+	 * In the common case, probe the PK index directly rather than paying for
+	 * an SPI query execution per row.
+	 */
+	if (ri_FastPathCheck(riinfo, fk_rel, pk_rel, newslot))
+	{
+		table_close(pk_rel, RowShareLock);
+		return PointerGetDatum(NULL);
+	}
+
 	if (SPI_connect() != SPI_OK_CONNECT)
 		elog(ERROR, "SPI_connect failed");
 
@@ -2159,6 +2176,7 @@ ri_LoadConstraintInfo(Oid constraintOid)
 	memcpy(&riinfo->conname, &conForm->conname, sizeof(NameData));
 	riinfo->pk_relid = conForm->confrelid;
 	riinfo->fk_relid = conForm->conrelid;
+	riinfo->conindid = conForm->conindid;
 	riinfo->confupdtype = conForm->confupdtype;
 	riinfo->confdeltype = conForm->confdeltype;
 	riinfo->confmatchtype = conForm->confmatchtype;
@@ -2305,6 +2323,202 @@ ri_PlanCheck(const char *querystr, int nargs, Oid *argtypes,
 	return qplan;
 }
 
+/*
+ * ri_FastPathCheck -
+ *
+ * Check that the key of newslot exists in the PK table by scanning the
+ * constraint's unique index directly, locking the row found FOR KEY SHARE.
+ * This does the same as the RI_PLAN_CHECK_LOOKUPPK query, without the
+ * overhead of SPI and the executor.  Reports a violation if no row is found.
+ *
+ * Returns false without doing anything if the PK table or its index is not
+ * of a kind handled here; the caller must then run the query.  We only
+ * handle plain tables without row level security, whose owner has the
+ * privileges the query needs, and btree indexes whose operator families
+ * contain the constraint's equality operators for the FK column types.
+ */
+static bool
+ri_FastPathCheck(const RI_ConstraintInfo *riinfo,
+				 Relation fk_rel, Relation pk_rel,
+				 TupleTableSlot *newslot)
+{
+	Relation	idx_rel;
+	Oid			owner = RelationGetForm(pk_rel)->relowner;
+	ScanKeyData skey[RI_MAX_NUMKEYS];
+	AttrNumber	pk_attnos[RI_MAX_NUMKEYS];
+	int			nkeys;
+	Snapshot	snapshot;
+	IndexScanDesc scan;
+	TupleTableSlot *pkslot;
+	bool		found = false;
+	Oid			save_userid;
+	int			save_sec_context;
+
+	if (pk_rel->rd_rel->relkind != RELKIND_RELATION ||
+		pk_rel->rd_rel->relrowsecurity ||
+		!OidIsValid(riinfo->conindid))
+		return false;
+
+	/* Leave it to the query to report any permission failure */
+	if (pg_class_aclcheck(RelationGetRelid(pk_rel), owner,
+						  ACL_SELECT) != ACLCHECK_OK ||
+		pg_class_aclcheck(RelationGetRelid(pk_rel), owner,
+						  ACL_UPDATE) != ACLCHECK_OK)
+		return false;
+
+	idx_rel = index_open(riinfo->conindid, AccessShareLock);
+	nkeys = IndexRelationGetNumberOfKeyAttributes(idx_rel);
+	if (idx_rel->rd_rel->relam != BTREE_AM_OID || nkeys != riinfo->nkeys)
+	{
+		index_close(idx_rel, AccessShareLock);
+		return false;
+	}
+
+	/* Build a scan key for each index column from the matching FK column */
+	for (int i = 0; i < nkeys; i++)
+	{
+		AttrNumber	idxattno = idx_rel->rd_index->indkey.values[i];
+		int			k;
+		Oid			fk_type;
+		Oid			eq_opr;
+		int			strategy;
+		Oid			lefttype;
+		Oid			righttype;
+		bool		isnull;
+		Datum		value;
+
+		for (k = 0; k < riinfo->nkeys; k++)
+		{
+			if (riinfo->pk_attnums[k] == idxattno)
+				break;
+		}
+		if (k >= riinfo->nkeys)
+		{
+			index_close(idx_rel, AccessShareLock);
+			return false;
+		}
+
+		fk_type = RIAttType(fk_rel, riinfo->fk_attnums[k]);
+		eq_opr = riinfo->pf_eq_oprs[k];
+		if (!op_in_opfamily(eq_opr, idx_rel->rd_opfamily[i]))
+		{
+			index_close(idx_rel, AccessShareLock);
+			return false;
+		}
+		get_op_opfamily_properties(eq_opr, idx_rel->rd_opfamily[i], false,
+								   &strategy, &lefttype, &righttype);
+		if (strategy != BTEqualStrategyNumber ||
+			(fk_type != righttype && !IsBinaryCoercible(fk_type, righttype)))
+		{
+			index_close(idx_rel, AccessShareLock);
+			return false;
+		}
+
+		value = slot_getattr(newslot, riinfo->fk_attnums[k], &isnull);
+		Assert(!isnull);
+		ScanKeyEntryInitialize(&skey[i], 0, i + 1, strategy, righttype,
+							   idx_rel->rd_indcollation[i],
+							   get_opcode(eq_opr), value);
+		pk_attnos[i] = idxattno;
+	}
+
+	/*
+	 * Scan with the snapshot SPI would use: a fresh one in READ COMMITTED
+	 * mode, else the transaction snapshot.  Like SPI, make our own earlier
+	 * changes visible first.
+	 */
+	CommandCounterIncrement();
+	snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/* Run any user-defined comparison functions as the PK table's owner */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(owner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_NOFORCE_RLS);
+
+	pkslot = table_slot_create(pk_rel, NULL);
+	scan = index_beginscan(pk_rel, idx_rel, snapshot, nkeys, 0);
+	index_rescan(scan, skey, nkeys, NULL, 0);
+
+	while (!found && index_getnext_slot(scan, ForwardScanDirection, pkslot))
+	{
+		TM_FailureData tmfd;
+		TM_Result	res;
+
+		res = table_tuple_lock(pk_rel, &pkslot->tts_tid, snapshot, pkslot,
+							   GetCurrentCommandId(false),
+							   LockTupleKeyShare, LockWaitBlock,
+							   TUPLE_LOCK_FLAG_LOCK_UPDATE_IN_PROGRESS |
+							   (IsolationUsesXactSnapshot() ? 0 :
+								TUPLE_LOCK_FLAG_FIND_LAST_VERSION),
+							   &tmfd);
+		switch (res)
+		{
+			case TM_Ok:
+
+				/*
+				 * If we locked a newer version of the row, as the executor's
+				 * EvalPlanQual would, recheck that it still has our key.
+				 */
+				found = true;
+				if (tmfd.traversed)
+				{
+					for (int i = 0; i < nkeys; i++)
+					{
+						bool		isnull;
+						Datum		value;
+
+						value = slot_getattr(pkslot, pk_attnos[i], &isnull);
+						if (isnull ||
+							!DatumGetBool(FunctionCall2Coll(&skey[i].sk_func,
+															skey[i].sk_collation,
+															value,
+															skey[i].sk_argument)))
+						{
+							found = false;
+							break;
+						}
+					}
+				}
+				break;
+
+			case TM_SelfModified:
+				/* updated or deleted by a later command of ours; skip it */
+				break;
+
+			case TM_Updated:
+			case TM_Deleted:
+				if (IsolationUsesXactSnapshot())
+					ereport(ERROR,
+							(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+							 errmsg("could not serialize access due to concurrent update")));
+				/* in READ COMMITTED mode, the row is gone; try the next */
+				break;
+
+			default:
+				elog(ERROR, "unexpected table_tuple_lock status: %u", res);
+				break;
+		}
+	}
+
+	index_endscan(scan);
+	ExecDropSingleTupleTableSlot(pkslot);
+
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	UnregisterSnapshot(snapshot);
+	index_close(idx_rel, AccessShareLock);
+
+	if (!found)
+		ri_ReportViolation(riinfo,
+						   pk_rel, fk_rel,
+						   newslot,
+						   NULL,
+						   RI_PLAN_CHECK_LOOKUPPK, false);
+
+	return true;
+}
+
 /*
  * Perform a query to enforce an RI restriction
  */
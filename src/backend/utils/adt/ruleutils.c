@@ -12069,6 +12069,10 @@ get_from_clause_item(Node *jtnode, Query *query, deparse_context *context)
 			case RTE_CTE:
 				appendStringInfoString(buf, quote_identifier(rte->ctename));
 				break;
+			case RTE_NAMEDTUPLESTORE:
+				/* Ephemeral named relation, such as a transition table */
+				appendStringInfoString(buf, quote_identifier(rte->enrname));
+				break;
 			default:
 				elog(ERROR, "unrecognized RTE kind: %d", (int) rte->rtekind);
 				break;
@@ -12277,6 +12281,12 @@ get_rte_alias(RangeTblEntry *rte, int varno, bool use_as,
 		if (strcmp(refname, rte->ctename) != 0)
 			printalias = true;
 	}
+	else if (rte->rtekind == RTE_NAMEDTUPLESTORE)
+	{
+		/* Likewise for an ephemeral named relation */
+		if (strcmp(refname, rte->enrname) != 0)
+			printalias = true;
+	}
 
 	if (printalias)
 		appendStringInfo(context->buf, "%s%s",
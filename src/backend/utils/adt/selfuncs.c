@@ -3751,6 +3751,205 @@ estimate_num_groups(PlannerInfo *root, List *groupExprs, double input_rows,
 	return numdistinct;
 }
 
+/*
+ * Helper routine for eqjoinsel_multi: estimate the number of distinct
+ * combinations of the given expressions, which must all belong to one base
+ * relation, and the fraction of rows in which none of them is null.
+ *
+ * Returns false if no multivariate ndistinct statistics were applicable; in
+ * that case only *relp (NULL if the expressions are not all from one base
+ * relation) and *nonnullfrac are set.
+ */
+static bool
+multi_join_ndistinct(PlannerInfo *root, List *exprs, RelOptInfo **relp,
+					 double *ndistinct, bool *isdefault, double *nonnullfrac)
+{
+	List	   *varinfos = NIL;
+	RelOptInfo *rel = NULL;
+	double		reldistinct = 1.0;
+	double		relmaxndistinct = 1.0;
+	bool		usedstats = false;
+	ListCell   *lc;
+
+	*relp = NULL;
+	*isdefault = false;
+	*nonnullfrac = 1.0;
+
+	foreach(lc, exprs)
+	{
+		Node	   *expr = (Node *) lfirst(lc);
+		VariableStatData vardata;
+
+		examine_variable(root, expr, 0, &vardata);
+		if (vardata.rel == NULL || (rel != NULL && vardata.rel != rel))
+		{
+			ReleaseVariableStats(vardata);
+			return false;
+		}
+		rel = vardata.rel;
+
+		/* rows with a null in any join column cannot match; assume independence */
+		if (HeapTupleIsValid(vardata.statsTuple))
+		{
+			Form_pg_statistic stats;
+
+			stats = (Form_pg_statistic) GETSTRUCT(vardata.statsTuple);
+			*nonnullfrac *= 1.0 - stats->stanullfrac;
+		}
+
+		varinfos = add_unique_group_var(root, varinfos, expr, &vardata);
+		ReleaseVariableStats(vardata);
+	}
+
+	*relp = rel;
+	if (rel == NULL || rel->statlist == NIL || list_length(varinfos) < 2)
+		return false;
+
+	/* as in estimate_num_groups, but without its fudge factors */
+	while (varinfos != NIL)
+	{
+		double		mvndistinct;
+
+		if (estimate_multivariate_ndistinct(root, rel, &varinfos,
+											&mvndistinct))
+		{
+			reldistinct *= mvndistinct;
+			relmaxndistinct = Max(relmaxndistinct, mvndistinct);
+			usedstats = true;
+		}
+		else
+		{
+			foreach(lc, varinfos)
+			{
+				GroupVarInfo *varinfo = (GroupVarInfo *) lfirst(lc);
+
+				reldistinct *= varinfo->ndistinct;
+				relmaxndistinct = Max(relmaxndistinct, varinfo->ndistinct);
+				if (varinfo->isdefault)
+					*isdefault = true;
+			}
+			varinfos = NIL;
+		}
+	}
+
+	if (!usedstats)
+		return false;
+
+	if (rel->tuples > 0 && reldistinct > rel->tuples)
+		reldistinct = Max(relmaxndistinct, rel->tuples);
+
+	*ndistinct = clamp_row_est(reldistinct);
+	return true;
+}
+
+/*
+ * eqjoinsel_multi
+ *		Estimate the combined selectivity of equality join clauses
+ *		"l1 = r1 AND l2 = r2 ..." between two base relations using
+ *		multivariate ndistinct statistics
+ *
+ * lexprs and rexprs hold the two sides of the clauses, in matching order;
+ * each list's expressions belong to a single base relation.  eqjoinsel()
+ * estimates each clause on its own and the caller multiplies the results,
+ * which grossly underestimates the join size when the columns on either side
+ * are correlated.  Here we instead treat each side's combination of columns
+ * as a single join key, whose number of distinct values comes from extended
+ * statistics where possible, and apply the formulas eqjoinsel_inner() and
+ * eqjoinsel_semi() use when no MCV lists are available.
+ *
+ * Returns false if neither side has applicable extended statistics, in which
+ * case the caller should estimate the clauses one by one.
+ */
+bool
+eqjoinsel_multi(PlannerInfo *root, List *lexprs, List *rexprs,
+				JoinType jointype, SpecialJoinInfo *sjinfo,
+				Selectivity *selec)
+{
+	RelOptInfo *rel1 = NULL;
+	RelOptInfo *rel2 = NULL;
+	double		nd1;
+	double		nd2;
+	bool		isdefault1;
+	bool		isdefault2;
+	double		nonnull1;
+	double		nonnull2;
+	bool		stats1;
+	bool		stats2;
+	double		sel;
+
+	Assert(list_length(lexprs) == list_length(rexprs));
+
+	stats1 = multi_join_ndistinct(root, lexprs, &rel1, &nd1, &isdefault1,
+								  &nonnull1);
+	stats2 = multi_join_ndistinct(root, rexprs, &rel2, &nd2, &isdefault2,
+								  &nonnull2);
+	if ((!stats1 && !stats2) || rel1 == NULL || rel2 == NULL)
+		return false;
+
+	/* For a side without extended statistics, combine the columns as usual */
+	if (!stats1)
+	{
+		nd1 = estimate_num_groups(root, lexprs, rel1->tuples, NULL, NULL);
+		isdefault1 = false;
+	}
+	if (!stats2)
+	{
+		nd2 = estimate_num_groups(root, rexprs, rel2->tuples, NULL, NULL);
+		isdefault2 = false;
+	}
+
+	switch (jointype)
+	{
+		case JOIN_SEMI:
+		case JOIN_ANTI:
+			{
+				RelOptInfo *inner_rel;
+
+				/* make side 1 the outer side, as eqjoinsel() does */
+				if (bms_is_subset(rel1->relids, sjinfo->min_righthand))
+				{
+					RelOptInfo *trel = rel1;
+					double		tnd = nd1;
+					bool		tdef = isdefault1;
+					double		tnn = nonnull1;
+
+					rel1 = rel2;
+					nd1 = nd2;
+					isdefault1 = isdefault2;
+					nonnull1 = nonnull2;
+					rel2 = trel;
+					nd2 = tnd;
+					isdefault2 = tdef;
+					nonnull2 = tnn;
+				}
+
+				/* see eqjoinsel_semi() about clamping nd2 */
+				inner_rel = find_join_input_rel(root, sjinfo->min_righthand);
+				if (nd2 > rel2->rows)
+					nd2 = rel2->rows;
+				if (nd2 > inner_rel->rows)
+					nd2 = inner_rel->rows;
+				if (!isdefault1 && !isdefault2)
+				{
+					if (nd1 <= nd2)
+						sel = nonnull1;
+					else
+						sel = (nd2 / nd1) * nonnull1;
+				}
+				else
+					sel = 0.5 * nonnull1;
+			}
+			break;
+		default:
+			sel = nonnull1 * nonnull2 / Max(nd1, nd2);
+			break;
+	}
+
+	CLAMP_PROBABILITY(sel);
+	*selec = sel;
+	return true;
+}
+
 /*
  * Estimate hash bucket statistics when the specified expression is used
  * as a hash key for the given number of buckets.
@@ -6783,6 +6982,61 @@ add_predicate_to_index_quals(IndexOptInfo *index, List *indexQuals)
 	return list_concat(predExtraQuals, indexQuals);
 }
 
+/*
+ * Estimate the number of primitive index scans of a btree skip scan
+ *
+ * A btree scan whose first index qual is on the second index column, with no
+ * ScalarArrayOpExpr or RowCompareExpr quals, is performed as a skip scan (see
+ * nbtree/README): one primitive index scan per distinct value of the first
+ * column, each of which can use the quals on the second column as boundary
+ * quals.  Returns that number of distinct values, or 0 if we'd better cost
+ * the scan as a full index scan.  That's the case when we have no statistics
+ * for the first column, and when it has so many distinct values that btree
+ * would end up reading on without skipping.  We use the same cutoff as for
+ * ScalarArrayOpExpr descents.
+ *
+ * Parallel index scans never skip.  We don't know about those here, but a
+ * skip scan reads few enough index pages to be unlikely to get any workers.
+ */
+static double
+btskipscans(PlannerInfo *root, IndexPath *path)
+{
+	IndexOptInfo *index = path->indexinfo;
+	TargetEntry *tle;
+	VariableStatData vardata;
+	double		ndistinct;
+	bool		isdefault;
+	ListCell   *lc;
+
+	if (path->indexclauses == NIL ||
+		linitial_node(IndexClause, path->indexclauses)->indexcol != 1)
+		return 0;
+
+	foreach(lc, path->indexclauses)
+	{
+		IndexClause *iclause = lfirst_node(IndexClause, lc);
+		ListCell   *lc2;
+
+		foreach(lc2, iclause->indexquals)
+		{
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc2);
+
+			if (IsA(rinfo->clause, ScalarArrayOpExpr) ||
+				IsA(rinfo->clause, RowCompareExpr))
+				return 0;
+		}
+	}
+
+	tle = linitial_node(TargetEntry, index->indextlist);
+	examine_variable(root, (Node *) tle->expr, 0, &vardata);
+	ndistinct = get_variable_numdistinct(&vardata, &isdefault);
+	ReleaseVariableStats(vardata);
+
+	if (isdefault || ndistinct > ceil(index->pages * 0.3333333))
+		return 0;
+
+	return Max(ndistinct, 1);
+}
 
 void
 btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
@@ -6803,6 +7057,7 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	bool		found_saop;
 	bool		found_is_null_op;
 	double		num_sa_scans;
+	double		num_skip_scans;
 	ListCell   *lc;
 
 	/*
@@ -6821,6 +7076,9 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 * If there's a ScalarArrayOpExpr in the quals, we'll actually perform up
 	 * to N index descents (not just one), but the ScalarArrayOpExpr's
 	 * operator can be considered to act the same as it normally does.
+	 *
+	 * A skip scan acts as if there was an '=' qual for the first column,
+	 * which is one descent per distinct value of that column.
 	 */
 	indexBoundQuals = NIL;
 	indexcol = 0;
@@ -6828,6 +7086,12 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	found_saop = false;
 	found_is_null_op = false;
 	num_sa_scans = 1;
+	num_skip_scans = btskipscans(root, path);
+	if (num_skip_scans > 0)
+	{
+		indexcol = 1;
+		num_sa_scans = num_skip_scans;
+	}
 	foreach(lc, path->indexclauses)
 	{
 		IndexClause *iclause = lfirst_node(IndexClause, lc);
@@ -6909,11 +7173,13 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 * If index is unique and we found an '=' clause for each column, we can
 	 * just assume numIndexTuples = 1 and skip the expensive
 	 * clauselist_selectivity calculations.  However, a ScalarArrayOp or
-	 * NullTest invalidates that theory, even though it sets eqQualHere.
+	 * NullTest invalidates that theory, even though it sets eqQualHere, and
+	 * so does a skip scan, which has no '=' clause for the first column.
 	 */
 	if (index->unique &&
 		indexcol == index->nkeycolumns - 1 &&
 		eqQualHere &&
+		num_skip_scans == 0 &&
 		!found_saop &&
 		!found_is_null_op)
 		numIndexTuples = 1.0;
@@ -32,7 +32,9 @@
 #include "miscadmin.h"
 #include "nodes/execnodes.h"
 #include "parser/scansup.h"
+#include "port/pg_bitutils.h"
 #include "port/pg_bswap.h"
+#include "port/simd.h"
 #include "regex/regex.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
@@ -61,7 +63,7 @@ typedef struct
 	int			len1;			/* string lengths in bytes */
 	int			len2;
 
-	/* Skip table for Boyer-Moore-Horspool search algorithm: */
+	/* Skip table for Boyer-Moore-Horspool search algorithm, without SIMD: */
 	int			skiptablemask;	/* mask for ANDing with skiptable subscripts */
 	int			skiptable[256]; /* skip distance for given mismatched char */
 
@@ -1256,6 +1258,8 @@ text_position_setup(text *t1, text *t2, Oid collid, TextPositionState *state)
 	state->refpoint = state->str1;
 	state->refpos = 0;
 
+#ifdef USE_NO_SIMD
+
 	/*
 	 * Prepare the skip table for Boyer-Moore-Horspool searching.  In these
 	 * notes we use the terminology that the "haystack" is the string to be
@@ -1264,7 +1268,8 @@ text_position_setup(text *t1, text *t2, Oid collid, TextPositionState *state)
 	 * If the needle is empty or bigger than the haystack then there is no
 	 * point in wasting cycles initializing the table.  We also choose not to
 	 * use B-M-H for needles of length 1, since the skip table can't possibly
-	 * save anything in that case.
+	 * save anything in that case.  With SIMD, text_position_next_internal()
+	 * doesn't use B-M-H at all.
 	 */
 	if (len1 >= len2 && len2 > 1)
 	{
@@ -1322,6 +1327,7 @@ text_position_setup(text *t1, text *t2, Oid collid, TextPositionState *state)
 		for (i = 0; i < last; i++)
 			state->skiptable[(unsigned char) str2[i] & skiptablemask] = last - i;
 	}
+#endif
 }
 
 /*
@@ -1401,14 +1407,25 @@ text_position_next_internal(char *start_ptr, TextPositionState *state)
 {
 	int			haystack_len = state->len1;
 	int			needle_len = state->len2;
-	int			skiptablemask = state->skiptablemask;
 	const char *haystack = state->str1;
 	const char *needle = state->str2;
 	const char *haystack_end = &haystack[haystack_len];
+#ifdef USE_NO_SIMD
+	int			skiptablemask = state->skiptablemask;
 	const char *hptr;
+#endif
 
 	Assert(start_ptr >= haystack && start_ptr <= haystack_end);
 
+#ifndef USE_NO_SIMD
+
+	/*
+	 * Testing a whole vector of candidate positions at once for the needle's
+	 * first and last byte beats B-M-H, so we don't need the skip table.
+	 */
+	return (char *) varstr_find(start_ptr, haystack_end - start_ptr,
+								needle, needle_len);
+#else
 	if (needle_len == 1)
 	{
 		/* No point in using B-M-H for a one-character needle */
@@ -1457,6 +1474,76 @@ text_position_next_internal(char *start_ptr, TextPositionState *state)
 	}
 
 	return 0;					/* not found */
+#endif
+}
+
+/*
+ * varstr_find
+ *		Find the first occurrence of a byte string in another
+ *
+ * Returns a pointer to the start of the first occurrence of 'needle' in
+ * 'haystack', or NULL if there is none.  Multibyte characters are not
+ * considered; callers must check the match is at a character boundary if
+ * the encoding needs it.
+ *
+ * When SIMD instructions are available, we compare a vector's worth of
+ * haystack positions at a time with the needle's first byte and, shifted by
+ * the needle length, with its last byte.  Only positions where both match
+ * need to be compared in full, which is rare in most text.
+ */
+const char *
+varstr_find(const char *haystack, int haystack_len,
+			const char *needle, int needle_len)
+{
+	int			limit;
+	int			i = 0;
+
+	if (needle_len <= 0)
+		return haystack;
+	if (needle_len > haystack_len)
+		return NULL;
+
+	/* number of positions the needle can start at */
+	limit = haystack_len - needle_len + 1;
+
+#ifndef USE_NO_SIMD
+	{
+		const Vector8 first = vector8_broadcast((uint8) needle[0]);
+		const Vector8 last = vector8_broadcast((uint8) needle[needle_len - 1]);
+
+		for (; i + (int) sizeof(Vector8) <= limit; i += sizeof(Vector8))
+		{
+			Vector8		hfirst;
+			Vector8		hlast;
+			uint32		mask;
+
+			vector8_load(&hfirst, (const uint8 *) &haystack[i]);
+			vector8_load(&hlast, (const uint8 *) &haystack[i + needle_len - 1]);
+			mask = vector8_highbit_mask(vector8_eq(hfirst, first)) &
+				vector8_highbit_mask(vector8_eq(hlast, last));
+
+			while (mask != 0)
+			{
+				int			pos = i + pg_rightmost_one_pos32(mask);
+
+				if (needle_len <= 2 ||
+					memcmp(&haystack[pos + 1], needle + 1, needle_len - 2) == 0)
+					return &haystack[pos];
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+
+	/* handle the remaining positions one at a time */
+	for (; i < limit; i++)
+	{
+		if (haystack[i] == needle[0] &&
+			memcmp(&haystack[i + 1], needle + 1, needle_len - 1) == 0)
+			return &haystack[i];
+	}
+
+	return NULL;
 }
 
 /*
@@ -5099,6 +5186,9 @@ pg_column_compression(PG_FUNCTION_ARGS)
 		case TOAST_LZ4_COMPRESSION_ID:
 			result = "lz4";
 			break;
+		case TOAST_ZSTD_COMPRESSION_ID:
+			result = "zstd";
+			break;
 		default:
 			elog(ERROR, "invalid compression method id %d", cmid);
 	}
@@ -115,6 +115,7 @@
 #include "access/xloginsert.h"
 #include "catalog/catalog.h"
 #include "catalog/pg_constraint.h"
+#include "executor/execQueryCache.h"
 #include "miscadmin.h"
 #include "storage/sinval.h"
 #include "storage/smgr.h"
@@ -547,6 +548,9 @@ RegisterCatcacheInvalidation(int cacheId,
 {
 	AddCatcacheInvalidationMessage(&transInvalInfo->CurrentCmdInvalidMsgs,
 								   cacheId, hashValue, dbId);
+
+	/* Cached results of queries using a changed function may become stale */
+	QueryCacheNoteCatalogChange(dbId, cacheId, hashValue);
 }
 
 /*
@@ -580,6 +584,9 @@ RegisterRelcacheInvalidation(Oid dbId, Oid relId)
 	 */
 	(void) GetCurrentCommandId(true);
 
+	/* Cached results of queries on the relation may become stale, too */
+	QueryCacheNoteChange(dbId, relId);
+
 	/*
 	 * If the relation being invalidated is one of those cached in a relcache
 	 * init file, mark that we need to zap that file at commit. For simplicity
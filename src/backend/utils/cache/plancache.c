@@ -58,6 +58,7 @@
 
 #include "access/transam.h"
 #include "catalog/namespace.h"
+#include "common/hashfn.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
@@ -99,7 +100,43 @@ static dlist_head saved_plan_list = DLIST_STATIC_INIT(saved_plan_list);
  */
 static dlist_head cached_expression_list = DLIST_STATIC_INIT(cached_expression_list);
 
+/*
+ * Custom-plan statistics of dropped saved CachedPlanSources, keyed by a hash
+ * of their query string.  When the same statement is prepared again, as
+ * happens when clients of a connection pooler keep re-preparing the same
+ * statements on each backend, the new CachedPlanSource starts from these
+ * statistics, so choose_custom_plan doesn't have to build another five
+ * custom plans before it considers the generic plan.  A hash collision only
+ * affects that heuristic, never the validity of a plan.
+ */
+typedef struct PlanChoiceHistoryEntry
+{
+	uint32		query_hash;		/* hash key --- MUST BE FIRST */
+	double		total_custom_cost;
+	int64		num_custom_plans;
+} PlanChoiceHistoryEntry;
+
+/* Maximum number of statements to remember */
+#define PLAN_CHOICE_HISTORY_SIZE	1024
+
+/*
+ * A generic plan that produces more than this many times the rows its top
+ * node was estimated to produce is no longer trusted; see
+ * ReportCachedPlanRows.  Row estimates that are off by a factor of ten or a
+ * hundred are common and usually still yield a reasonable plan, and a plan
+ * that was right to be chosen must not be thrown out over them, since we
+ * then pay for planning on every execution.  An error of three orders of
+ * magnitude, on the other hand, means the estimate is unrelated to the
+ * parameter values in use, and any join method or scan chosen on its basis
+ * is a guess.
+ */
+#define PLAN_ROWS_UNDERESTIMATE_FACTOR	1000.0
+
+static HTAB *plan_choice_history = NULL;
+
 static void ReleaseGenericPlan(CachedPlanSource *plansource);
+static void RememberPlanChoice(CachedPlanSource *plansource);
+static void RecallPlanChoice(CachedPlanSource *plansource);
 static List *RevalidateCachedQuery(CachedPlanSource *plansource,
 								   QueryEnvironment *queryEnv);
 static bool CheckCachedPlan(CachedPlanSource *plansource);
@@ -512,6 +549,9 @@ SaveCachedPlan(CachedPlanSource *plansource)
 	dlist_push_tail(&saved_plan_list, &plansource->node);
 
 	plansource->is_saved = true;
+
+	/* Start from what we learned about the same statement before, if any */
+	RecallPlanChoice(plansource);
 }
 
 /*
@@ -530,6 +570,7 @@ DropCachedPlan(CachedPlanSource *plansource)
 	/* If it's been saved, remove it from the list */
 	if (plansource->is_saved)
 	{
+		RememberPlanChoice(plansource);
 		dlist_delete(&plansource->node);
 		plansource->is_saved = false;
 	}
@@ -548,6 +589,76 @@ DropCachedPlan(CachedPlanSource *plansource)
 		MemoryContextDelete(plansource->context);
 }
 
+/*
+ * RememberPlanChoice: save the custom-plan statistics of a saved
+ * CachedPlanSource that is about to be dropped, for RecallPlanChoice.
+ *
+ * Only statements that have completed the initial round of custom plans are
+ * remembered; the others have nothing useful to pass on.
+ */
+static void
+RememberPlanChoice(CachedPlanSource *plansource)
+{
+	PlanChoiceHistoryEntry *entry;
+	uint32		query_hash;
+	bool		found;
+
+	if (plansource->num_custom_plans < 5)
+		return;
+
+	if (plan_choice_history == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(PlanChoiceHistoryEntry);
+		ctl.hcxt = CacheMemoryContext;
+		plan_choice_history = hash_create("Plan choice history",
+										  64, &ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	query_hash = hash_bytes((const unsigned char *) plansource->query_string,
+							strlen(plansource->query_string));
+
+	/* Don't let the table grow without bound; keep what we have */
+	if (hash_get_num_entries(plan_choice_history) >= PLAN_CHOICE_HISTORY_SIZE)
+	{
+		entry = hash_search(plan_choice_history, &query_hash, HASH_FIND, NULL);
+		if (entry == NULL)
+			return;
+	}
+	else
+		entry = hash_search(plan_choice_history, &query_hash, HASH_ENTER,
+							&found);
+
+	entry->total_custom_cost = plansource->total_custom_cost;
+	entry->num_custom_plans = plansource->num_custom_plans;
+}
+
+/*
+ * RecallPlanChoice: seed a newly saved CachedPlanSource with the custom-plan
+ * statistics remembered for the same query string, if any.
+ */
+static void
+RecallPlanChoice(CachedPlanSource *plansource)
+{
+	PlanChoiceHistoryEntry *entry;
+	uint32		query_hash;
+
+	if (plan_choice_history == NULL || plansource->num_custom_plans > 0)
+		return;
+
+	query_hash = hash_bytes((const unsigned char *) plansource->query_string,
+							strlen(plansource->query_string));
+	entry = hash_search(plan_choice_history, &query_hash, HASH_FIND, NULL);
+	if (entry == NULL)
+		return;
+
+	plansource->total_custom_cost = entry->total_custom_cost;
+	plansource->num_custom_plans = entry->num_custom_plans;
+}
+
 /*
  * ReleaseGenericPlan: release a CachedPlanSource's generic plan, if any.
  */
@@ -1028,6 +1139,7 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	plan->is_oneshot = plansource->is_oneshot;
 	plan->is_saved = false;
 	plan->is_valid = true;
+	plan->rows_underestimated = false;
 
 	/* assign generation number to new plan */
 	plan->generation = ++(plansource->generation);
@@ -1070,10 +1182,21 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 	if (plansource->cursor_options & CURSOR_OPT_CUSTOM_PLAN)
 		return true;
 
-	/* Generate custom plans until we have done at least 5 (arbitrary) */
+	/*
+	 * Generate custom plans until we have done at least 5 (arbitrary).  A
+	 * statement prepared again may already have inherited them from its
+	 * predecessor, see RecallPlanChoice.
+	 */
 	if (plansource->num_custom_plans < 5)
 		return true;
 
+	/*
+	 * Don't trust a generic plan that has been seen to badly underestimate
+	 * its result size; see ReportCachedPlanRows.
+	 */
+	if (plansource->gplan && plansource->gplan->rows_underestimated)
+		return true;
+
 	avg_custom_cost = plansource->total_custom_cost / plansource->num_custom_plans;
 
 	/*
@@ -1112,7 +1235,15 @@ cached_plan_cost(CachedPlan *plan, bool include_planner)
 		if (plannedstmt->commandType == CMD_UTILITY)
 			continue;			/* Ignore utility statements */
 
-		result += plannedstmt->planTree->total_cost;
+		/*
+		 * Run-time partition pruning will remove some of the plan's subplans
+		 * as soon as the executor starts, so don't count what the planner
+		 * expects that to save.  This matters mostly for generic plans,
+		 * whose costs would otherwise include partitions that a custom plan
+		 * prunes at plan time.
+		 */
+		result += plannedstmt->planTree->total_cost -
+			plannedstmt->initPruningSavings;
 
 		if (include_planner)
 		{
@@ -1202,6 +1333,9 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 			/* Link the new generic plan into the plansource */
 			plansource->gplan = plan;
 			plan->refcount++;
+			/* Its nodes may keep expression states between executions */
+			foreach_node(PlannedStmt, stmt, plan->stmt_list)
+				stmt->cacheExprStates = true;
 			/* Immediately reparent into appropriate context */
 			if (plansource->is_saved)
 			{
@@ -1276,6 +1410,32 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 	return plan;
 }
 
+/*
+ * ReportCachedPlanRows: report the number of rows an execution of one of a
+ * cached plan's statements produced.
+ *
+ * A generic plan's row estimates cannot take the actual parameter values
+ * into account.  If it once produces far more rows than estimated, the plan
+ * shape chosen for the estimate (typically nested loops) is likely to be a
+ * poor one for the values in use, so we remember that and have
+ * choose_custom_plan() prefer custom plans from then on.  Only
+ * underestimates count, since executions that stop early (cursors, LIMIT in
+ * the caller) legitimately produce fewer rows than estimated.
+ */
+void
+ReportCachedPlanRows(CachedPlan *plan, PlannedStmt *stmt, uint64 nrows)
+{
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+
+	if (plan->rows_underestimated || stmt->commandType == CMD_UTILITY ||
+		stmt->planTree == NULL)
+		return;
+
+	if ((double) nrows >
+		stmt->planTree->plan_rows * PLAN_ROWS_UNDERESTIMATE_FACTOR)
+		plan->rows_underestimated = true;
+}
+
 /*
  * ReleaseCachedPlan: release active use of a cached plan.
  *
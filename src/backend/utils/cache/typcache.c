@@ -1768,18 +1768,20 @@ lookup_rowtype_tupdesc_internal(Oid type_id, int32 typmod, bool noError)
 			/* Are we attached to a shared record typmod registry? */
 			if (CurrentSession->shared_typmod_registry != NULL)
 			{
-				SharedTypmodTableEntry *entry;
+				SharedTypmodTableEntry entry;
 
-				/* Try to find it in the shared typmod index. */
-				entry = dshash_find(CurrentSession->shared_typmod_table,
-									&typmod, false);
-				if (entry != NULL)
+				/*
+				 * Try to find it in the shared typmod index.  Entries never
+				 * change once inserted, so a lock-free copy will do.
+				 */
+				if (dshash_find_copy(CurrentSession->shared_typmod_table,
+									 &typmod, &entry))
 				{
 					TupleDesc	tupdesc;
 
 					tupdesc = (TupleDesc)
 						dsa_get_address(CurrentSession->area,
-										entry->shared_tupdesc);
+										entry.shared_tupdesc);
 					Assert(typmod == tupdesc->tdtypmod);
 
 					/* We may need to extend the local RecordCacheArray. */
@@ -1798,9 +1800,6 @@ lookup_rowtype_tupdesc_internal(Oid type_id, int32 typmod, bool noError)
 					 */
 					RecordCacheArray[typmod].id = ++tupledesc_id_counter;
 
-					dshash_release_lock(CurrentSession->shared_typmod_table,
-										entry);
-
 					return RecordCacheArray[typmod].tupdesc;
 				}
 			}
@@ -1122,6 +1122,53 @@ hash_search_with_hash_value(HTAB *hashp,
 	return NULL;				/* keep compiler quiet */
 }
 
+/*
+ * hash_search_unlocked -- look up key without holding the partition lock
+ *
+ * This is a HASH_FIND that may run concurrently with insertions and
+ * deletions in the same partition.  It is only usable on partitioned tables,
+ * which never split buckets, so the bucket a key hashes to stays fixed and
+ * every element we can reach remains allocated memory of this table, either
+ * in some bucket chain or on a freelist.  An element can however be unlinked
+ * and reused while we stand on it, so the walk can wander into another chain
+ * or a freelist, and since insertions link an element in before copying its
+ * key, the key we compare may be half-written.  The result is therefore only
+ * a hint: a non-NULL return may point to an entry that no longer holds this
+ * key, and a NULL return does not prove the key absent.  The caller must
+ * validate a hit against data it can check independently, and must repeat a
+ * miss under the partition lock before acting on it.
+ *
+ * To guarantee termination when links are being changed under us, we give up
+ * and return NULL after max_steps elements.
+ */
+void *
+hash_search_unlocked(HTAB *hashp,
+					 const void *keyPtr,
+					 uint32 hashvalue,
+					 int max_steps)
+{
+	HASHHDR    *hctl = hashp->hctl;
+	Size		keysize = hashp->keysize;
+	HashCompareFunc match = hashp->match;
+	HASHBUCKET *bucketptr;
+	HASHBUCKET	currBucket;
+
+	Assert(IS_PARTITIONED(hctl));
+
+	(void) hash_initial_lookup(hashp, hashvalue, &bucketptr);
+	currBucket = *((volatile HASHBUCKET *) bucketptr);
+
+	while (currBucket != NULL && max_steps-- > 0)
+	{
+		if (currBucket->hashvalue == hashvalue &&
+			match(ELEMENTKEY(currBucket), keyPtr, keysize) == 0)
+			return (void *) ELEMENTKEY(currBucket);
+		currBucket = *((volatile HASHBUCKET *) &currBucket->link);
+	}
+
+	return NULL;
+}
+
 /*
  * hash_update_hash_key -- change the hash key of an existing table entry
  *
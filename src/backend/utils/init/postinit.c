@@ -585,6 +585,28 @@ InitializeMaxBackends(void)
 		elog(ERROR, "too many backends configured");
 }
 
+/*
+ * Initialize the number of fast-path lock groups, based on the
+ * max_locks_per_transaction setting.
+ *
+ * Queries touching many relations, such as ones on partitioned tables with
+ * many partitions, are expected to come with a higher setting, so size the
+ * arrays to fit that many locks.  The value is passed from the postmaster to
+ * subprocesses like MaxBackends.
+ */
+void
+InitializeFastPathLocks(void)
+{
+	Assert(FastPathLockGroupsPerBackend == 0);
+
+	/* we need at least one group */
+	FastPathLockGroupsPerBackend = 1;
+
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX &&
+		   FastPathLockSlotsPerBackend() < max_locks_per_xact)
+		FastPathLockGroupsPerBackend *= 2;
+}
+
 /*
  * GUC check_hook for max_connections
  */
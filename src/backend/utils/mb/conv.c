@@ -12,6 +12,7 @@
  */
 #include "postgres.h"
 #include "mb/pg_wchar.h"
+#include "utils/ascii.h"
 
 
 /*
@@ -532,6 +533,21 @@ UtfToLocal(const unsigned char *utf, int len,
 		if (*utf == '\0')
 			break;
 
+		if (!IS_HIGHBIT_SET(*utf))
+		{
+			/*
+			 * ASCII case is easy, assume it's one-to-one conversion.  Copy a
+			 * whole run of it at once if there is one.
+			 */
+			l = ascii_chunks_prefix_len(utf, len);
+			if (l == 0)
+				l = 1;
+			memcpy(iso, utf, l);
+			iso += l;
+			utf += l;
+			continue;
+		}
+
 		l = pg_utf_mblen(utf);
 		if (len < l)
 			break;
@@ -539,13 +555,6 @@ UtfToLocal(const unsigned char *utf, int len,
 		if (!pg_utf8_islegal(utf, l))
 			break;
 
-		if (l == 1)
-		{
-			/* ASCII case is easy, assume it's one-to-one conversion */
-			*iso++ = *utf++;
-			continue;
-		}
-
 		/* collect coded char of length l */
 		if (l == 2)
 		{
@@ -745,9 +754,16 @@ LocalToUtf(const unsigned char *iso, int len,
 
 		if (!IS_HIGHBIT_SET(*iso))
 		{
-			/* ASCII case is easy, assume it's one-to-one conversion */
-			*utf++ = *iso++;
-			l = 1;
+			/*
+			 * ASCII case is easy, assume it's one-to-one conversion.  Copy a
+			 * whole run of it at once if there is one.
+			 */
+			l = ascii_chunks_prefix_len(iso, len);
+			if (l == 0)
+				l = 1;
+			memcpy(utf, iso, l);
+			utf += l;
+			iso += l;
 			continue;
 		}
 
@@ -14,6 +14,7 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "mb/pg_wchar.h"
+#include "utils/ascii.h"
 
 PG_MODULE_MAGIC;
 
@@ -56,7 +57,20 @@ iso8859_1_to_utf8(PG_FUNCTION_ARGS)
 			report_invalid_encoding(PG_LATIN1, (const char *) src, len);
 		}
 		if (!IS_HIGHBIT_SET(c))
+		{
+			/* copy a run of ASCII in bulk, if there is one */
+			int			n = ascii_chunks_prefix_len(src, len);
+
+			if (n > 0)
+			{
+				memcpy(dest, src, n);
+				dest += n;
+				src += n;
+				len -= n;
+				continue;
+			}
 			*dest++ = c;
+		}
 		else
 		{
 			*dest++ = (c >> 6) | 0xc0;
@@ -95,9 +109,14 @@ utf8_to_iso8859_1(PG_FUNCTION_ARGS)
 		/* fast path for ASCII-subset characters */
 		if (!IS_HIGHBIT_SET(c))
 		{
-			*dest++ = c;
-			src++;
-			len--;
+			int			n = ascii_chunks_prefix_len(src, len);
+
+			if (n == 0)
+				n = 1;
+			memcpy(dest, src, n);
+			dest += n;
+			src += n;
+			len -= n;
 		}
 		else
 		{
@@ -28,6 +28,7 @@
 
 #include "access/commit_ts.h"
 #include "access/gin.h"
+#include "access/multixact.h"
 #include "access/slru.h"
 #include "access/toast_compression.h"
 #include "access/twophase.h"
@@ -39,10 +40,12 @@
 #include "catalog/storage.h"
 #include "commands/async.h"
 #include "commands/event_trigger.h"
+#include "commands/sequence.h"
 #include "commands/tablespace.h"
 #include "commands/trigger.h"
 #include "commands/user.h"
 #include "commands/vacuum.h"
+#include "executor/execQueryCache.h"
 #include "common/file_utils.h"
 #include "common/scram-common.h"
 #include "jit/jit.h"
@@ -58,23 +61,31 @@
 #include "parser/parse_expr.h"
 #include "parser/parser.h"
 #include "pgstat.h"
+#include "port/pg_numa.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/profiler.h"
 #include "postmaster/startup.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walsummarizer.h"
 #include "postmaster/walwriter.h"
+#include "regex/regex.h"
 #include "replication/logicallauncher.h"
 #include "replication/slot.h"
 #include "replication/slotsync.h"
 #include "replication/syncrep.h"
+#include "storage/aio.h"
+#include "storage/buffile.h"
 #include "storage/bufmgr.h"
 #include "storage/large_object.h"
 #include "storage/pg_shmem.h"
 #include "storage/predicate.h"
+#include "storage/procarray.h"
+#include "storage/smgr.h"
 #include "storage/standby.h"
+#include "storage/sync.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
 #include "utils/builtins.h"
@@ -378,6 +389,21 @@ static const struct config_enum_entry huge_pages_status_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry numa_placement_options[] = {
+	{"off", NUMA_PLACEMENT_OFF, false},
+#ifdef USE_NUMA
+	{"interleave", NUMA_PLACEMENT_INTERLEAVE, false},
+	{"partition", NUMA_PLACEMENT_PARTITION, false},
+#endif
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry buffer_replacement_policy_options[] = {
+	{"clock", BUFFER_REPLACEMENT_CLOCK, false},
+	{"2q", BUFFER_REPLACEMENT_2Q, false},
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry recovery_prefetch_options[] = {
 	{"off", RECOVERY_PREFETCH_OFF, false},
 	{"on", RECOVERY_PREFETCH_ON, false},
@@ -391,6 +417,14 @@ static const struct config_enum_entry recovery_prefetch_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry io_method_options[] = {
+	{"sync", IOMETHOD_SYNC, false},
+#ifdef USE_IO_URING
+	{"io_uring", IOMETHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry debug_parallel_query_options[] = {
 	{"off", DEBUG_PARALLEL_OFF, false},
 	{"on", DEBUG_PARALLEL_ON, false},
@@ -404,6 +438,12 @@ static const struct config_enum_entry debug_parallel_query_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry join_search_method_options[] = {
+	{"genetic", JOIN_SEARCH_GENETIC, false},
+	{"idp", JOIN_SEARCH_IDP, false},
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry plan_cache_mode_options[] = {
 	{"auto", PLAN_CACHE_MODE_AUTO, false},
 	{"force_generic_plan", PLAN_CACHE_MODE_FORCE_GENERIC_PLAN, false},
@@ -460,6 +500,9 @@ static const struct config_enum_entry default_toast_compression_options[] = {
 	{"pglz", TOAST_PGLZ_COMPRESSION, false},
 #ifdef  USE_LZ4
 	{"lz4", TOAST_LZ4_COMPRESSION, false},
+#endif
+#ifdef  USE_ZSTD
+	{"zstd", TOAST_ZSTD_COMPRESSION, false},
 #endif
 	{NULL, 0, false}
 };
@@ -483,6 +526,18 @@ static const struct config_enum_entry wal_compression_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry temp_file_compression_options[] = {
+	{"off", TEMP_FILE_COMPRESSION_NONE, false},
+	{"pglz", TEMP_FILE_COMPRESSION_PGLZ, false},
+#ifdef USE_LZ4
+	{"lz4", TEMP_FILE_COMPRESSION_LZ4, false},
+#endif
+#ifdef USE_ZSTD
+	{"zstd", TEMP_FILE_COMPRESSION_ZSTD, false},
+#endif
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
@@ -564,6 +619,7 @@ int			ssl_renegotiation_limit;
 int			huge_pages = HUGE_PAGES_TRY;
 int			huge_page_size;
 int			huge_pages_status = HUGE_PAGES_UNKNOWN;
+int			numa_placement = NUMA_PLACEMENT_OFF;
 
 /*
  * These variables are all dummies that don't do anything, except in some
@@ -949,6 +1005,40 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_parallel_memoize", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of memoize plans with a cache shared by parallel workers."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_parallel_memoize,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_parallel_repartition", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of repartitioning parallel aggregation plans."),
+			gettext_noop("Allows parallel workers to redistribute partially aggregated "
+						 "rows among themselves, and finalize the aggregation of their "
+						 "share of the groups."),
+			GUC_EXPLAIN
+		},
+		&enable_parallel_repartition,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_parallel_sort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of coordinated parallel sorts."),
+			gettext_noop("Allows parallel workers to sort their share of the input into "
+						 "shared runs, which the leader merges directly, rather than "
+						 "sorting separately below a Gather Merge."),
+			GUC_EXPLAIN
+		},
+		&enable_parallel_sort,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_partition_pruning", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables plan-time and execution-time partition pruning."),
@@ -1186,6 +1276,18 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_writer_group_commit", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Leaves flushing WAL for transaction commits to the WAL writer."),
+			gettext_noop("Committing sessions wait for the WAL writer to flush their "
+						 "commit records rather than flushing WAL themselves, so that "
+						 "concurrent commits share WAL flushes.")
+		},
+		&wal_writer_group_commit,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_checkpoints", PGC_SIGHUP, LOGGING_WHAT,
 			gettext_noop("Logs each checkpoint."),
@@ -1415,6 +1517,15 @@ struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"track_buffer_residency", PGC_POSTMASTER, STATS_CUMULATIVE,
+			gettext_noop("Maintains per-relation counts of pages held in shared buffers."),
+			NULL
+		},
+		&track_buffer_residency,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"track_wal_io_timing", PGC_SUSET, STATS_CUMULATIVE,
 			gettext_noop("Collects timing statistics for WAL I/O activity."),
@@ -1910,6 +2021,16 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"analyze_ndistinct_full_scan", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Makes ANALYZE scan whole tables to estimate the number of distinct values."),
+			gettext_noop("Otherwise the estimate is derived from the sampled rows only.")
+		},
+		&analyze_ndistinct_full_scan,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"jit", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Allow JIT compilation."),
@@ -1921,6 +2042,29 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"jit_cache", PGC_SUSET, QUERY_TUNING_OTHER,
+			gettext_noop("Reuse optimized JIT code across backends."),
+			gettext_noop("Optimized JIT code is stored on disk, and reused "
+						 "whenever identical code is generated again.")
+		},
+		&jit_cache,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"query_cache", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Reuse results of read-only queries across executions."),
+			gettext_noop("Results are kept in the shared memory set aside by "
+						 "query_cache_size, until the tables they were computed "
+						 "from change.")
+		},
+		&query_cache,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"jit_debugging_support", PGC_SU_BACKEND, DEVELOPER_OPTIONS,
 			gettext_noop("Register JIT-compiled functions with debugger."),
@@ -2025,6 +2169,16 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"procarray_big_reader_lock", PGC_POSTMASTER, LOCK_MANAGEMENT,
+			gettext_noop("Lets ProcArrayLock be share-locked without writing to the lock."),
+			gettext_noop("Makes taking snapshots scale better on many-core machines, at the cost of slower transaction commit and backend exit."),
+		},
+		&procarray_big_reader_lock,
+		false,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, false, NULL, NULL, NULL
@@ -2079,6 +2233,30 @@ struct config_int ConfigureNamesInt[] =
 		8, 1, INT_MAX,
 		NULL, NULL, NULL
 	},
+
+	{
+		{"jit_cache_size", PGC_SIGHUP, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the maximum disk space used by cached JIT code."),
+			NULL,
+			GUC_UNIT_KB
+		},
+		&jit_cache_size,
+		65536, 1024, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"jit_tier_up_threshold", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of evaluations after which an expression is JIT compiled."),
+			gettext_noop("Expressions are interpreted until then. "
+						 "0 compiles expressions at executor startup."),
+			GUC_EXPLAIN
+		},
+		&jit_tier_up_threshold,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"join_collapse_limit", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Sets the FROM-list size beyond which JOIN "
@@ -2132,6 +2310,16 @@ struct config_int ConfigureNamesInt[] =
 		0, 0, INT_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"idp_block_size", PGC_USERSET, QUERY_TUNING_GEQO,
+			gettext_noop("Sets the number of FROM items the IDP join search plans exhaustively at a time."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&idp_block_size,
+		8, 2, 12,
+		NULL, NULL, NULL
+	},
 
 	{
 		/* This is PGC_SUSET to prevent hiding from log_lock_waits. */
@@ -2258,6 +2446,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"active_shared_buffers", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared memory buffers in use."),
+			gettext_noop("-1 means use all of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&active_shared_buffers,
+		-1, -1, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_buffer_usage_limit", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the buffer pool size for VACUUM, ANALYZE, and autovacuum."),
@@ -2324,6 +2523,16 @@ struct config_int ConfigureNamesInt[] =
 		check_multixact_offset_buffers, NULL, NULL
 	},
 
+	{
+		{"multixact_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of entries in the shared MultiXact member cache."),
+			gettext_noop("0 disables the cache.")
+		},
+		&multixact_cache_size,
+		4096, 0, INT_MAX / 64,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("Sets the size of the dedicated buffer pool used for the LISTEN/NOTIFY message cache."),
@@ -2335,6 +2544,26 @@ struct config_int ConfigureNamesInt[] =
 		check_notify_buffers, NULL, NULL
 	},
 
+	{
+		{"relation_size_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of relation forks whose size is cached in shared memory."),
+			gettext_noop("0 disables the cache.")
+		},
+		&relation_size_cache_size,
+		4096, 0, INT_MAX / 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_sequence_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of sequences whose values can be handed out from shared memory."),
+			gettext_noop("0 disables the cache.")
+		},
+		&shared_sequence_cache_size,
+		0, 0, INT_MAX / 64,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"serializable_buffers", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("Sets the size of the dedicated buffer pool used for the serializable transaction cache."),
@@ -2446,6 +2675,18 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_total_backend_memory", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Limits the total memory allocated by all backends."),
+			gettext_noop("Allocations that would exceed the limit fail with an "
+						 "out-of-memory error. 0 disables the limit."),
+			GUC_UNIT_MB
+		},
+		&max_total_backend_memory,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"maintenance_work_mem", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum memory to be used for maintenance operations."),
@@ -2469,6 +2710,28 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"regexp_cache_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for caching compiled regular expressions."),
+			NULL,
+			GUC_UNIT_KB
+		},
+		&regexp_cache_size,
+		4096, 64, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"query_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the shared memory used to cache query results."),
+			gettext_noop("0 disables the cache."),
+			GUC_UNIT_KB
+		},
+		&query_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -2569,6 +2832,29 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"prepared_state_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of state data kept in shared memory for each prepared transaction."),
+			gettext_noop("Finishing a prepared transaction whose state data did not fit "
+						 "requires reading it back from WAL or from its state file."),
+			GUC_UNIT_BYTE
+		},
+		&prepared_state_cache_size,
+		2048, 0, 1024 * 1024,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_cached_subxids", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of subtransaction XIDs cached per backend."),
+			gettext_noop("Transactions with more subtransactions than this "
+						 "make snapshots consult pg_subtrans.")
+		},
+		&max_cached_subxids,
+		PGPROC_MIN_CACHED_SUBXIDS, PGPROC_MIN_CACHED_SUBXIDS, PGPROC_MAX_CACHED_SUBXIDS_LIMIT,
+		NULL, NULL, NULL
+	},
+
 #ifdef LOCK_DEBUG
 	{
 		{"trace_lock_oidmin", PGC_SUSET, DEVELOPER_OPTIONS,
@@ -2705,6 +2991,15 @@ struct config_int ConfigureNamesInt[] =
 		1600000000, 0, 2100000000,
 		NULL, NULL, NULL
 	},
+	{
+		{"vacuum_retail_delete_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the maximum number of dead item identifiers for which VACUUM deletes index entries one by one."),
+			gettext_noop("Zero disables retail deletion of index entries.")
+		},
+		&vacuum_retail_delete_limit,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
 
 	/*
 	 * See also CheckRequiredParameterValues() if this parameter changes
@@ -2789,6 +3084,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"secondary_buffer_cache_size", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Sets the size of the secondary buffer cache."),
+			gettext_noop("0 disables the secondary buffer cache."),
+			GUC_UNIT_BLOCKS
+		},
+		&secondary_buffer_cache_size,
+		0, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_decode_buffer_size", PGC_POSTMASTER, WAL_RECOVERY,
 			gettext_noop("Buffer size for reading ahead in the WAL during recovery."),
@@ -2872,6 +3178,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"checkpoint_sync_concurrency", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Sets the maximum number of concurrent file syncs performed by a checkpoint."),
+			gettext_noop("Values above 1 require io_method = io_uring."),
+		},
+		&checkpoint_sync_concurrency,
+		1, 1, PGAIO_MAX_IN_FLIGHT,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -2883,6 +3199,16 @@ struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks for concurrent WAL insertion."),
+			gettext_noop("Specify -1 to have this value determined by the number of CPUs."),
+		},
+		&XLOGinsertLocks,
+		-1, -1, MAX_XLOGINSERT_LOCKS,
+		check_wal_insert_locks, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Time between WAL flushes performed in the WAL writer."),
@@ -2905,6 +3231,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_write_concurrency", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Sets the maximum number of concurrent writes used to write out WAL."),
+			gettext_noop("Values above 1 require io_method = io_uring."),
+		},
+		&wal_write_concurrency,
+		1, 1, PGAIO_MAX_IN_FLIGHT,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_skip_threshold", PGC_USERSET, WAL_SETTINGS,
 			gettext_noop("Minimum size of new file to fsync instead of writing WAL."),
@@ -3389,6 +3725,15 @@ struct config_int ConfigureNamesInt[] =
 		3, 1, MAX_BACKENDS,
 		check_autovacuum_max_workers, NULL, NULL
 	},
+	{
+		{"autovacuum_max_parallel_workers", PGC_SIGHUP, AUTOVACUUM,
+			gettext_noop("Sets the maximum number of parallel processes per autovacuum operation."),
+			gettext_noop("Zero disables parallel vacuum in autovacuum.")
+		},
+		&autovacuum_max_parallel_workers,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"max_parallel_maintenance_workers", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
@@ -3557,6 +3902,27 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"profiler_buffer_size", PGC_POSTMASTER, STATS_MONITORING,
+			gettext_noop("Sets the number of samples kept by the sampling profiler."),
+			gettext_noop("Zero disables the sampling profiler.")
+		},
+		&profiler_buffer_size,
+		0, 0, INT_MAX / 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"profiler_sample_interval", PGC_SIGHUP, STATS_MONITORING,
+			gettext_noop("Sets the time between samples taken by the sampling profiler."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&profiler_sample_interval,
+		10, 1, 60000,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gin_pending_list_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum size of the pending list for GIN index."),
@@ -3568,6 +3934,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"toast_zstd_level", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the compression level used for zstd-compressed TOAST values."),
+			NULL
+		},
+		&toast_zstd_level,
+		3, 1, 22,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"tcp_user_timeout", PGC_USERSET, CONN_AUTH_TCP,
 			gettext_noop("TCP user timeout."),
@@ -3845,6 +4221,16 @@ struct config_real ConfigureNamesReal[] =
 		check_random_seed, assign_random_seed, show_random_seed
 	},
 
+	{
+		{"vacuum_max_eager_freeze_failure_rate", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Fraction of pages in a region that VACUUM can fail to freeze when scanning all-visible pages eagerly."),
+			gettext_noop("Zero disables eager scanning.")
+		},
+		&vacuum_max_eager_freeze_failure_rate,
+		0.03, 0.0, 1.0,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_cost_delay", PGC_USERSET, RESOURCES_VACUUM_DELAY,
 			gettext_noop("Vacuum cost delay in milliseconds."),
@@ -4064,6 +4450,16 @@ struct config_string ConfigureNamesString[] =
 		check_primary_slot_name, NULL, NULL
 	},
 
+	{
+		{"wal_receiver_compression", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Sets the compression method the sending server is asked to use for streamed WAL."),
+			NULL
+		},
+		&wal_receiver_compression,
+		"none",
+		check_wal_receiver_compression, NULL, NULL
+	},
+
 	{
 		{"client_encoding", PGC_USERSET, CLIENT_CONN_LOCALE,
 			gettext_noop("Sets the client's character set encoding."),
@@ -4129,6 +4525,17 @@ struct config_string ConfigureNamesString[] =
 		check_default_tablespace, NULL, NULL
 	},
 
+	{
+		{"secondary_buffer_cache_path", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Sets the file holding the secondary buffer cache."),
+			gettext_noop("An empty string disables the secondary buffer cache."),
+			GUC_SUPERUSER_ONLY
+		},
+		&secondary_buffer_cache_path,
+		"",
+		NULL, NULL, NULL
+	},
+
 	{
 		{"temp_tablespaces", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the tablespace(s) to use for temporary tables and sort files."),
@@ -4767,6 +5174,17 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"join_search_method", PGC_USERSET, QUERY_TUNING_GEQO,
+			gettext_noop("Selects the join order search used for queries at or above geqo_threshold."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&join_search_method,
+		JOIN_SEARCH_GENETIC, join_search_method_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"default_toast_compression", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the default compression method for compressible values."),
@@ -5015,6 +5433,26 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"numa_placement", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets how shared memory is placed on NUMA nodes."),
+			NULL
+		},
+		&numa_placement,
+		NUMA_PLACEMENT_OFF, numa_placement_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"buffer_replacement_policy", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the policy for choosing shared buffers to replace."),
+			NULL
+		},
+		&buffer_replacement_policy,
+		BUFFER_REPLACEMENT_CLOCK, buffer_replacement_policy_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"huge_pages_status", PGC_INTERNAL, PRESET_OPTIONS,
 			gettext_noop("Indicates the status of huge pages."),
@@ -5026,6 +5464,26 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"io_method", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method for executing asynchronous I/O."),
+			NULL
+		},
+		&io_method,
+		DEFAULT_IO_METHOD, io_method_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"temp_file_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Sets the method used to compress hash join temporary files."),
+			NULL
+		},
+		&temp_file_compression,
+		TEMP_FILE_COMPRESSION_NONE, temp_file_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"recovery_prefetch", PGC_SIGHUP, WAL_RECOVERY,
 			gettext_noop("Prefetch referenced blocks during recovery."),
@@ -424,6 +424,7 @@ AllocSetContextCreateInternal(MemoryContext parent,
 
 			((MemoryContext) set)->mem_allocated =
 				KeeperBlock(set)->endptr - ((char *) set);
+			MemoryContextAccountAllocated(((MemoryContext) set)->mem_allocated);
 
 			return (MemoryContext) set;
 		}
@@ -517,6 +518,7 @@ AllocSetContextCreateInternal(MemoryContext parent,
 						name);
 
 	((MemoryContext) set)->mem_allocated = firstBlockSize;
+	MemoryContextAccountAllocated(firstBlockSize);
 
 	return (MemoryContext) set;
 }
@@ -581,6 +583,7 @@ AllocSetReset(MemoryContext context)
 		{
 			/* Normal case, release the block */
 			context->mem_allocated -= block->endptr - ((char *) block);
+			MemoryContextAccountAllocated(-(block->endptr - ((char *) block)));
 
 #ifdef CLOBBER_FREED_MEMORY
 			wipe_mem(block, block->freeptr - ((char *) block));
@@ -635,6 +638,12 @@ AllocSetDelete(MemoryContext context)
 		if (!context->isReset)
 			MemoryContextResetOnly(context);
 
+		/*
+		 * The memory of contexts on the freelist is not accounted for; it is
+		 * small and bounded, and counted again when the context is reused.
+		 */
+		MemoryContextAccountAllocated(-(int64) keepersize);
+
 		/*
 		 * If the freelist is full, just discard what's already in it.  See
 		 * comments with context_freelists[].
@@ -668,7 +677,10 @@ AllocSetDelete(MemoryContext context)
 		AllocBlock	next = block->next;
 
 		if (!IsKeeperBlock(set, block))
+		{
 			context->mem_allocated -= block->endptr - ((char *) block);
+			MemoryContextAccountAllocated(-(block->endptr - ((char *) block)));
+		}
 
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, block->freeptr - ((char *) block));
@@ -681,6 +693,7 @@ AllocSetDelete(MemoryContext context)
 	}
 
 	Assert(context->mem_allocated == keepersize);
+	MemoryContextAccountAllocated(-(int64) context->mem_allocated);
 
 	/* Finally, free the context header, including the keeper block */
 	free(set);
@@ -712,11 +725,14 @@ AllocSetAllocLarge(MemoryContext context, Size size, int flags)
 #endif
 
 	blksize = chunk_size + ALLOC_BLOCKHDRSZ + ALLOC_CHUNKHDRSZ;
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (AllocBlock) malloc(blksize);
 	if (block == NULL)
 		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	block->aset = set;
 	block->freeptr = block->endptr = ((char *) block) + blksize;
@@ -905,6 +921,8 @@ AllocSetAllocFromNewBlock(MemoryContext context, Size size, int flags,
 		blksize <<= 1;
 
 	/* Try to allocate it */
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (AllocBlock) malloc(blksize);
 
 	/*
@@ -923,6 +941,7 @@ AllocSetAllocFromNewBlock(MemoryContext context, Size size, int flags,
 		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	block->aset = set;
 	block->freeptr = ((char *) block) + ALLOC_BLOCKHDRSZ;
@@ -1100,6 +1119,7 @@ AllocSetFree(void *pointer)
 			block->next->prev = block->prev;
 
 		set->header.mem_allocated -= block->endptr - ((char *) block);
+		MemoryContextAccountAllocated(-(block->endptr - ((char *) block)));
 
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, block->freeptr - ((char *) block));
@@ -1223,6 +1243,14 @@ AllocSetRealloc(void *pointer, Size size, int flags)
 		blksize = chksize + ALLOC_BLOCKHDRSZ + ALLOC_CHUNKHDRSZ;
 		oldblksize = block->endptr - ((char *) block);
 
+		if (blksize > oldblksize &&
+			!MemoryContextAllocationAllowed(blksize - oldblksize))
+		{
+			/* Disallow access to the chunk header. */
+			VALGRIND_MAKE_MEM_NOACCESS(chunk, ALLOC_CHUNKHDRSZ);
+			return MemoryContextAllocationFailure(&set->header, size, flags);
+		}
+
 		block = (AllocBlock) realloc(block, blksize);
 		if (block == NULL)
 		{
@@ -1234,6 +1262,7 @@ AllocSetRealloc(void *pointer, Size size, int flags)
 		/* updated separately, not to underflow when (oldblksize > blksize) */
 		set->header.mem_allocated -= oldblksize;
 		set->header.mem_allocated += blksize;
+		MemoryContextAccountAllocated((int64) blksize - (int64) oldblksize);
 
 		block->freeptr = block->endptr = ((char *) block) + blksize;
 
@@ -228,6 +228,7 @@ BumpContextCreate(MemoryContext parent, const char *name, Size minContextSize,
 						parent, name);
 
 	((MemoryContext) set)->mem_allocated = allocSize;
+	MemoryContextAccountAllocated(allocSize);
 
 	return (MemoryContext) set;
 }
@@ -279,6 +280,7 @@ BumpDelete(MemoryContext context)
 {
 	/* Reset to release all releasable BumpBlocks */
 	BumpReset(context);
+	MemoryContextAccountAllocated(-(int64) context->mem_allocated);
 	/* And free the context header and keeper block */
 	free(context);
 }
@@ -314,11 +316,14 @@ BumpAllocLarge(MemoryContext context, Size size, int flags)
 	required_size = chunk_size + Bump_CHUNKHDRSZ;
 	blksize = required_size + Bump_BLOCKHDRSZ;
 
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (BumpBlock *) malloc(blksize);
 	if (block == NULL)
-		return NULL;
+		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	/* the block is completely full */
 	block->freeptr = block->endptr = ((char *) block) + blksize;
@@ -450,12 +455,15 @@ BumpAllocFromNewBlock(MemoryContext context, Size size, int flags,
 	if (blksize < required_size)
 		blksize = pg_nextpower2_size_t(required_size);
 
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (BumpBlock *) malloc(blksize);
 
 	if (block == NULL)
 		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	/* initialize the new block */
 	BumpBlockInit(set, block, blksize);
@@ -601,6 +609,7 @@ BumpBlockFree(BumpContext *set, BumpBlock *block)
 	dlist_delete(&block->node);
 
 	((MemoryContext) set)->mem_allocated -= ((char *) block->endptr - (char *) block);
+	MemoryContextAccountAllocated(-((char *) block->endptr - (char *) block));
 
 #ifdef CLOBBER_FREED_MEMORY
 	wipe_mem(block, ((char *) block->endptr - (char *) block));
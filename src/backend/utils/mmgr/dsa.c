@@ -966,6 +966,39 @@ dsa_get_address(dsa_area *area, dsa_pointer dp)
 	return area->segment_maps[index].mapped_address + offset;
 }
 
+/*
+ * Like dsa_get_address, but for a dsa_pointer that may be stale or garbage,
+ * read without holding whatever lock protects it.  Returns NULL unless the
+ * 'size' bytes at dp lie within a segment that this backend has already
+ * mapped.  Segments are never mapped or unmapped as a side effect, so the
+ * result can be dereferenced without risk of a fault, but what it points to
+ * may be free space or an unrelated object; the caller must validate
+ * anything it reads there by other means.
+ */
+void *
+dsa_get_address_if_mapped(dsa_area *area, dsa_pointer dp, size_t size)
+{
+	dsa_segment_index index;
+	size_t		offset;
+	dsa_segment_map *segment_map;
+
+	if (!DsaPointerIsValid(dp))
+		return NULL;
+
+	index = DSA_EXTRACT_SEGMENT_NUMBER(dp);
+	offset = DSA_EXTRACT_OFFSET(dp);
+	if (index >= DSA_MAX_SEGMENTS)
+		return NULL;
+
+	segment_map = &area->segment_maps[index];
+	if (segment_map->mapped_address == NULL ||
+		offset >= segment_map->header->size ||
+		size > segment_map->header->size - offset)
+		return NULL;
+
+	return segment_map->mapped_address + offset;
+}
+
 /*
  * Pin this area, so that it will continue to exist even if all backends
  * detach from it.  In that case, the area can still be reattached to if a
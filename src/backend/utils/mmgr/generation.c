@@ -266,6 +266,7 @@ GenerationContextCreate(MemoryContext parent,
 						name);
 
 	((MemoryContext) set)->mem_allocated = firstBlockSize;
+	MemoryContextAccountAllocated(firstBlockSize);
 
 	return (MemoryContext) set;
 }
@@ -329,6 +330,7 @@ GenerationDelete(MemoryContext context)
 {
 	/* Reset to release all releasable GenerationBlocks */
 	GenerationReset(context);
+	MemoryContextAccountAllocated(-(int64) context->mem_allocated);
 	/* And free the context header and keeper block */
 	free(context);
 }
@@ -361,11 +363,14 @@ GenerationAllocLarge(MemoryContext context, Size size, int flags)
 	required_size = chunk_size + Generation_CHUNKHDRSZ;
 	blksize = required_size + Generation_BLOCKHDRSZ;
 
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (GenerationBlock *) malloc(blksize);
 	if (block == NULL)
 		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	/* block with a single (used) chunk */
 	block->context = set;
@@ -482,12 +487,15 @@ GenerationAllocFromNewBlock(MemoryContext context, Size size, int flags,
 	if (blksize < required_size)
 		blksize = pg_nextpower2_size_t(required_size);
 
+	if (!MemoryContextAllocationAllowed(blksize))
+		return MemoryContextAllocationFailure(context, size, flags);
 	block = (GenerationBlock *) malloc(blksize);
 
 	if (block == NULL)
 		return MemoryContextAllocationFailure(context, size, flags);
 
 	context->mem_allocated += blksize;
+	MemoryContextAccountAllocated(blksize);
 
 	/* initialize the new block */
 	GenerationBlockInit(set, block, blksize);
@@ -672,6 +680,7 @@ GenerationBlockFree(GenerationContext *set, GenerationBlock *block)
 	dlist_delete(&block->node);
 
 	((MemoryContext) set)->mem_allocated -= block->blksize;
+	MemoryContextAccountAllocated(-(int64) block->blksize);
 
 #ifdef CLOBBER_FREED_MEMORY
 	wipe_mem(block, block->blksize);
@@ -23,6 +23,7 @@
 
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "utils/backend_status.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
 #include "utils/memutils_internal.h"
@@ -157,6 +158,16 @@ MemoryContext CurTransactionContext = NULL;
 /* This is a transient link to the active portal's memory context: */
 MemoryContext PortalContext = NULL;
 
+/*
+ * Memory accounting.  MemoryContextBackendReported is the value of
+ * MemoryContextBackendAllocated last passed to pgstat_report_allocated_bytes.
+ */
+Size		MemoryContextBackendAllocated = 0;
+Size		MemoryContextBackendReported = 0;
+
+/* GUC variable */
+int			max_total_backend_memory = 0;
+
 static void MemoryContextDeleteOnly(MemoryContext context);
 static void MemoryContextCallResetCallbacks(MemoryContext context);
 static void MemoryContextStatsInternal(MemoryContext context, int level,
@@ -778,6 +789,55 @@ MemoryContextMemAllocated(MemoryContext context, bool recurse)
 	return total;
 }
 
+/*
+ * MemoryContextReportAllocated
+ *		Publish MemoryContextBackendAllocated to pg_stat_activity and to the
+ *		shared total that max_total_backend_memory is checked against.
+ */
+void
+MemoryContextReportAllocated(void)
+{
+	MemoryContextBackendReported = MemoryContextBackendAllocated;
+	pgstat_report_allocated_bytes(MemoryContextBackendAllocated);
+}
+
+/*
+ * MemoryContextCheckTotalLimit
+ *		Slow path of MemoryContextAllocationAllowed().
+ *
+ * Only processes running queries on behalf of clients are limited; the
+ * postmaster and auxiliary processes must keep working.  Allocations in
+ * critical sections are never refused either, since failing there would
+ * mean a PANIC.  The shared total is only refreshed every
+ * MEMORY_ACCOUNTING_REPORT_THRESHOLD bytes per process, so the limit is
+ * approximate.
+ */
+bool
+MemoryContextCheckTotalLimit(Size size)
+{
+	uint64		total;
+	int64		limit;
+
+	if (CritSectionCount > 0)
+		return true;
+
+	if (MyBackendType != B_BACKEND &&
+		MyBackendType != B_BG_WORKER &&
+		MyBackendType != B_AUTOVAC_WORKER &&
+		MyBackendType != B_WAL_SENDER)
+		return true;
+
+	if (!pgstat_get_total_allocated_bytes(&total))
+		return true;
+
+	limit = (int64) max_total_backend_memory * 1024 * 1024;
+
+	return (int64) total +
+		((int64) MemoryContextBackendAllocated -
+		 (int64) MemoryContextBackendReported) +
+		(int64) size <= limit;
+}
+
 /*
  * Return the memory consumption statistics about the given context and its
  * children.
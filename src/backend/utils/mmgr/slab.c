@@ -453,6 +453,7 @@ SlabReset(MemoryContext context)
 #endif
 		free(block);
 		context->mem_allocated -= slab->blockSize;
+		MemoryContextAccountAllocated(-(int64) slab->blockSize);
 	}
 
 	/* walk over blocklist and free the blocks */
@@ -469,6 +470,7 @@ SlabReset(MemoryContext context)
 #endif
 			free(block);
 			context->mem_allocated -= slab->blockSize;
+			MemoryContextAccountAllocated(-(int64) slab->blockSize);
 		}
 	}
 
@@ -562,6 +564,8 @@ SlabAllocFromNewBlock(MemoryContext context, Size size, int flags)
 	}
 	else
 	{
+		if (!MemoryContextAllocationAllowed(slab->blockSize))
+			return MemoryContextAllocationFailure(context, size, flags);
 		block = (SlabBlock *) malloc(slab->blockSize);
 
 		if (unlikely(block == NULL))
@@ -569,6 +573,7 @@ SlabAllocFromNewBlock(MemoryContext context, Size size, int flags)
 
 		block->slab = slab;
 		context->mem_allocated += slab->blockSize;
+		MemoryContextAccountAllocated(slab->blockSize);
 
 		/* use the first chunk in the new block */
 		chunk = SlabBlockGetChunk(slab, block, 0);
@@ -797,6 +802,7 @@ SlabFree(void *pointer)
 #endif
 			free(block);
 			slab->header.mem_allocated -= slab->blockSize;
+			MemoryContextAccountAllocated(-(int64) slab->blockSize);
 		}
 
 		/*
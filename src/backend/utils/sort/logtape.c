@@ -46,7 +46,11 @@
  *
  * To further make the I/Os more sequential, we can use a larger buffer
  * when reading, and read multiple blocks from the same tape in one go,
- * whenever the buffer becomes empty.
+ * whenever the buffer becomes empty.  Since a tape's blocks are usually
+ * allocated in runs of consecutive block numbers, we read ahead as many
+ * consecutive blocks as fit in the buffer with a single request, as soon
+ * as one block has been seen to be followed by the next one, and keep
+ * those that turn out to belong to the tape.
  *
  * To support the above policy of writing to the lowest free block, the
  * freelist is a min heap.
@@ -222,6 +226,8 @@ struct LogicalTapeSet
 static LogicalTape *ltsCreateTape(LogicalTapeSet *lts);
 static void ltsWriteBlock(LogicalTapeSet *lts, int64 blocknum, const void *buffer);
 static void ltsReadBlock(LogicalTapeSet *lts, int64 blocknum, void *buffer);
+static int	ltsReadBlocks(LogicalTapeSet *lts, int64 blocknum, int nblocks,
+						  void *buffer);
 static int64 ltsGetBlock(LogicalTapeSet *lts, LogicalTape *lt);
 static int64 ltsGetFreeBlock(LogicalTapeSet *lts);
 static int64 ltsGetPreallocBlock(LogicalTapeSet *lts, LogicalTape *lt);
@@ -289,6 +295,33 @@ ltsReadBlock(LogicalTapeSet *lts, int64 blocknum, void *buffer)
 	BufFileReadExact(lts->pfile, buffer, BLCKSZ);
 }
 
+/*
+ * Read up to nblocks consecutive blocks, starting with the specified block,
+ * which must exist.  Blocks past the end of the underlying file are not
+ * read.  Returns the number of blocks read.
+ */
+static int
+ltsReadBlocks(LogicalTapeSet *lts, int64 blocknum, int nblocks, void *buffer)
+{
+	size_t		nread;
+
+	Assert(nblocks >= 1);
+
+	if (BufFileSeekBlock(lts->pfile, blocknum) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek to block %lld of temporary file",
+						(long long) blocknum)));
+	nread = BufFileRead(lts->pfile, buffer, (size_t) nblocks * BLCKSZ);
+	if (nread < BLCKSZ)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read block %lld of temporary file: read only %zu of %zu bytes",
+						(long long) blocknum, nread, (size_t) BLCKSZ)));
+
+	return nread / BLCKSZ;
+}
+
 /*
  * Read as many blocks as we can into the per-tape buffer.
  *
@@ -297,6 +330,8 @@ ltsReadBlock(LogicalTapeSet *lts, int64 blocknum, void *buffer)
 static bool
 ltsReadFillBuffer(LogicalTape *lt)
 {
+	bool		consecutive = false;
+
 	lt->pos = 0;
 	lt->nbytes = 0;
 
@@ -304,6 +339,7 @@ ltsReadFillBuffer(LogicalTape *lt)
 	{
 		char	   *thisbuf = lt->buffer + lt->nbytes;
 		int64		datablocknum = lt->nextBlockNumber;
+		int			nblocks;
 
 		/* Fetch next block number */
 		if (datablocknum == -1L)
@@ -311,24 +347,59 @@ ltsReadFillBuffer(LogicalTape *lt)
 		/* Apply worker offset, needed for leader tapesets */
 		datablocknum += lt->offsetBlockNumber;
 
-		/* Read the block */
-		ltsReadBlock(lt->tapeSet, datablocknum, thisbuf);
-		if (!lt->frozen)
-			ltsReleaseBlock(lt->tapeSet, datablocknum);
-		lt->curBlockNumber = lt->nextBlockNumber;
+		/*
+		 * Read the block.  If the previous block was followed by the next
+		 * one in the file, guess that the following blocks are too, and read
+		 * as many of them as fit in the buffer.  The loop below uses only
+		 * those that are actually part of the tape.
+		 */
+		if (consecutive)
+			nblocks = ltsReadBlocks(lt->tapeSet, datablocknum,
+									(lt->buffer_size - lt->nbytes) / BLCKSZ,
+									thisbuf);
+		else
+		{
+			ltsReadBlock(lt->tapeSet, datablocknum, thisbuf);
+			nblocks = 1;
+		}
 
-		lt->nbytes += TapeBlockGetNBytes(thisbuf);
-		if (TapeBlockIsLast(thisbuf))
+		for (int i = 0; i < nblocks; i++)
 		{
-			lt->nextBlockNumber = -1L;
-			/* EOF */
-			break;
+			char	   *blockbuf = thisbuf + (size_t) i * BLCKSZ;
+			int			nbytes;
+
+			if (i > 0)
+			{
+				/* stop at the first block that doesn't continue the tape */
+				if (lt->nextBlockNumber != lt->curBlockNumber + 1)
+					break;
+				datablocknum++;
+
+				/* squeeze out the trailer of the previous block */
+				memmove(lt->buffer + lt->nbytes, blockbuf, BLCKSZ);
+				blockbuf = lt->buffer + lt->nbytes;
+			}
+
+			if (!lt->frozen)
+				ltsReleaseBlock(lt->tapeSet, datablocknum);
+			lt->curBlockNumber = lt->nextBlockNumber;
+
+			nbytes = TapeBlockGetNBytes(blockbuf);
+			if (TapeBlockIsLast(blockbuf))
+				lt->nextBlockNumber = -1L;
+			else
+				lt->nextBlockNumber = TapeBlockGetTrailer(blockbuf)->next;
+			lt->nbytes += nbytes;
+
+			if (lt->nextBlockNumber == -1L)
+				break;			/* EOF */
 		}
-		else
-			lt->nextBlockNumber = TapeBlockGetTrailer(thisbuf)->next;
+
+		consecutive = (lt->nextBlockNumber == lt->curBlockNumber + 1);
 
 		/* Advance to next block, if we have buffer space left */
-	} while (lt->buffer_size - lt->nbytes > BLCKSZ);
+	} while (lt->nextBlockNumber != -1L &&
+			 lt->buffer_size - lt->nbytes > BLCKSZ);
 
 	return (lt->nbytes > 0);
 }
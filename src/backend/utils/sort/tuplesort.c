@@ -104,6 +104,7 @@
 #include "commands/tablespace.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "port/pg_bitutils.h"
 #include "storage/shmem.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -119,6 +120,24 @@
 #define INITIAL_MEMTUPSIZE Max(1024, \
 	ALLOCSET_SEPARATE_THRESHOLD / sizeof(SortTuple) + 1)
 
+/*
+ * Minimum number of tuples to sort with radix sort.  Smaller sorts, and the
+ * small buckets radix sort produces, are sorted with quicksort.
+ */
+#define RADIX_SORT_MIN_TUPLES	1024
+
+/*
+ * How to turn the leading key in datum1 into an unsigned integer that sorts
+ * in the same order, for radix sort.
+ */
+typedef struct RadixSortKey
+{
+	bool		int32key;		/* is datum1 an int32? */
+	uint64		xormask;		/* bits to flip after conversion */
+	/* quicksort to use for small buckets */
+	void		(*sortfunc) (SortTuple *data, size_t n, Tuplesortstate *state);
+} RadixSortKey;
+
 /* GUC variables */
 #ifdef TRACE_SORT
 bool		trace_sort = false;
@@ -622,6 +641,197 @@ qsort_tuple_int32_compare(SortTuple *a, SortTuple *b, Tuplesortstate *state)
 #define ST_DEFINE
 #include "lib/sort_template.h"
 
+/*
+ * Radix sort of SortTuples on datum1.
+ *
+ * This is used instead of quicksort for larger sorts when the leading key's
+ * comparator is one of the specialized integer comparators above, that is
+ * when datum1 holds an integer, or an abbreviated key that compares as an
+ * unsigned integer (text in the C collation, uuid, and others).  datum1 is
+ * mapped to an unsigned integer that sorts the same way, and the tuples are
+ * sorted by it with an in-place MSD radix sort, one byte at a time.  Tuples
+ * that have equal keys are then sorted with the tiebreak comparator, which
+ * takes the remaining sort keys and any abbreviated leading key into
+ * account.  So radix sort replaces comparator calls only for the leading
+ * key, which is where most of them are made.
+ */
+static inline uint64
+radix_sort_key(const SortTuple *tup, const RadixSortKey *key)
+{
+	uint64		k;
+
+	if (key->int32key)
+		k = (uint32) DatumGetInt32(tup->datum1);
+	else
+		k = (uint64) tup->datum1;
+
+	return k ^ key->xormask;
+}
+
+static inline int
+radix_sort_digit(const SortTuple *tup, const RadixSortKey *key, int level)
+{
+	return (radix_sort_key(tup, key) >> (level * 8)) & 0xFF;
+}
+
+/* sort tuples whose leading keys are all equal */
+static void
+radix_sort_tiebreak(SortTuple *data, size_t n, Tuplesortstate *state)
+{
+	if (n > 1 && state->base.onlyKey == NULL)
+		qsort_tuple(data, n, state->base.comparetup_tiebreak, state);
+}
+
+/*
+ * Sort tuples whose keys are known to be equal in all bytes above "level".
+ */
+static void
+radix_sort_level(SortTuple *data, size_t n, int level,
+				 const RadixSortKey *key, Tuplesortstate *state)
+{
+	size_t		counts[256];
+	size_t		next[256];
+	size_t		start;
+	int			b;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* skip over bytes that are the same in all keys */
+	for (;;)
+	{
+		if (n < RADIX_SORT_MIN_TUPLES)
+		{
+			key->sortfunc(data, n, state);
+			return;
+		}
+
+		memset(counts, 0, sizeof(counts));
+		for (size_t i = 0; i < n; i++)
+			counts[radix_sort_digit(&data[i], key, level)]++;
+
+		if (counts[radix_sort_digit(&data[0], key, level)] < n)
+			break;
+
+		if (level == 0)
+		{
+			radix_sort_tiebreak(data, n, state);
+			return;
+		}
+		level--;
+	}
+
+	/* move each tuple into its bucket, following permutation cycles */
+	start = 0;
+	for (b = 0; b < 256; b++)
+	{
+		next[b] = start;
+		start += counts[b];
+	}
+
+	start = 0;
+	for (b = 0; b < 256; b++)
+	{
+		size_t		end = start + counts[b];
+
+		while (next[b] < end)
+		{
+			SortTuple	tup = data[next[b]];
+			int			d = radix_sort_digit(&tup, key, level);
+
+			while (d != b)
+			{
+				SortTuple	tmp = data[next[d]];
+
+				data[next[d]++] = tup;
+				tup = tmp;
+				d = radix_sort_digit(&tup, key, level);
+			}
+			data[next[b]++] = tup;
+		}
+		start = end;
+	}
+
+	/* and sort the buckets by the remaining bytes */
+	start = 0;
+	for (b = 0; b < 256; b++)
+	{
+		if (counts[b] > 1)
+		{
+			if (level > 0)
+				radix_sort_level(data + start, counts[b], level - 1, key, state);
+			else
+				radix_sort_tiebreak(data + start, counts[b], state);
+		}
+		start += counts[b];
+	}
+}
+
+static void
+radix_sort_tuple(SortTuple *data, size_t n, const RadixSortKey *key,
+				 Tuplesortstate *state)
+{
+	SortSupport ssup = &state->base.sortKeys[0];
+	SortTuple  *nulls;
+	size_t		nnulls = 0;
+	SortTuple  *notnull;
+	size_t		nnotnull;
+	uint64		first;
+	uint64		diff = 0;
+
+	/*
+	 * NULLs sort before or after all other values, and are all equal as far
+	 * as the leading key is concerned.
+	 */
+	if (ssup->ssup_nulls_first)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (data[i].isnull1)
+			{
+				SortTuple	tmp = data[i];
+
+				data[i] = data[nnulls];
+				data[nnulls++] = tmp;
+			}
+		}
+		nulls = data;
+		notnull = data + nnulls;
+	}
+	else
+	{
+		for (size_t i = n; i > 0; i--)
+		{
+			if (data[i - 1].isnull1)
+			{
+				SortTuple	tmp = data[i - 1];
+
+				nnulls++;
+				data[i - 1] = data[n - nnulls];
+				data[n - nnulls] = tmp;
+			}
+		}
+		notnull = data;
+		nulls = data + n - nnulls;
+	}
+	nnotnull = n - nnulls;
+
+	radix_sort_tiebreak(nulls, nnulls, state);
+
+	if (nnotnull <= 1)
+		return;
+
+	/* start at the most significant byte in which any keys differ */
+	first = radix_sort_key(&notnull[0], key);
+	for (size_t i = 1; i < nnotnull; i++)
+		diff |= radix_sort_key(&notnull[i], key) ^ first;
+
+	if (diff == 0)
+		radix_sort_tiebreak(notnull, nnotnull, state);
+	else
+		radix_sort_level(notnull, nnotnull, pg_leftmost_one_pos64(diff) / 8,
+						 key, state);
+}
+
 /*
  *		tuplesort_begin_xxx
  *
@@ -2706,9 +2916,9 @@ sort_bounded_heap(Tuplesortstate *state)
 }
 
 /*
- * Sort all memtuples using specialized qsort() routines.
+ * Sort all memtuples using radix sort or specialized qsort() routines.
  *
- * Quicksort is used for small in-memory sorts, and external sort runs.
+ * This is used for in-memory sorts, and external sort runs.
  */
 static void
 tuplesort_sort_memtuples(Tuplesortstate *state)
@@ -2723,27 +2933,44 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 		 */
 		if (state->base.haveDatum1 && state->base.sortKeys)
 		{
-			if (state->base.sortKeys[0].comparator == ssup_datum_unsigned_cmp)
+			SortSupport ssup = &state->base.sortKeys[0];
+			RadixSortKey key;
+
+			if (ssup->comparator == ssup_datum_unsigned_cmp)
 			{
-				qsort_tuple_unsigned(state->memtuples,
-									 state->memtupcount,
-									 state);
-				return;
+				key.int32key = false;
+				key.xormask = 0;
+				key.sortfunc = qsort_tuple_unsigned;
 			}
 #if SIZEOF_DATUM >= 8
-			else if (state->base.sortKeys[0].comparator == ssup_datum_signed_cmp)
+			else if (ssup->comparator == ssup_datum_signed_cmp)
 			{
-				qsort_tuple_signed(state->memtuples,
-								   state->memtupcount,
-								   state);
-				return;
+				key.int32key = false;
+				key.xormask = UINT64CONST(1) << 63;
+				key.sortfunc = qsort_tuple_signed;
 			}
 #endif
-			else if (state->base.sortKeys[0].comparator == ssup_datum_int32_cmp)
+			else if (ssup->comparator == ssup_datum_int32_cmp)
 			{
-				qsort_tuple_int32(state->memtuples,
-								  state->memtupcount,
-								  state);
+				key.int32key = true;
+				key.xormask = UINT64CONST(1) << 31;
+				key.sortfunc = qsort_tuple_int32;
+			}
+			else
+				key.sortfunc = NULL;
+
+			if (key.sortfunc != NULL)
+			{
+				if (state->memtupcount < RADIX_SORT_MIN_TUPLES)
+					key.sortfunc(state->memtuples, state->memtupcount, state);
+				else
+				{
+					if (ssup->ssup_reverse)
+						key.xormask ^= key.int32key ?
+							PG_UINT32_MAX : PG_UINT64_MAX;
+					radix_sort_tuple(state->memtuples, state->memtupcount,
+									 &key, state);
+				}
 				return;
 			}
 		}
@@ -2990,6 +3217,30 @@ tuplesort_initialize_shared(Sharedsort *shared, int nWorkers, dsm_segment *seg)
 	}
 }
 
+/*
+ * tuplesort_reset_shared - reset shared tuplesort state for another sort
+ *
+ * Must be called from leader process, after all participants of the previous
+ * sort have called tuplesort_end(), and before workers are relaunched.  The
+ * temporary files written for the previous sort are removed.
+ */
+void
+tuplesort_reset_shared(Sharedsort *shared)
+{
+	int			i;
+
+	SharedFileSetDeleteAll(&shared->fileset);
+
+	SpinLockAcquire(&shared->mutex);
+	shared->currentWorker = 0;
+	shared->workersFinished = 0;
+	for (i = 0; i < shared->nTapes; i++)
+	{
+		shared->tapes[i].firstblocknumber = 0L;
+	}
+	SpinLockRelease(&shared->mutex);
+}
+
 /*
  * tuplesort_attach_shared - attach to shared tuplesort state
  *
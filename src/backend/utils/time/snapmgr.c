@@ -591,7 +591,12 @@ CopySnapshot(Snapshot snapshot)
 	newsnap->regd_count = 0;
 	newsnap->active_count = 0;
 	newsnap->copied = true;
-	newsnap->snapXactCompletionCount = 0;
+
+	/*
+	 * Copies are never passed to GetSnapshotData(), so keeping the completion
+	 * count can't make it reuse stale contents.  The query cache needs it to
+	 * tell which transactions the snapshot sees.
+	 */
 
 	/* setup XID array */
 	if (snapshot->xcnt > 0)
@@ -17,6 +17,12 @@
 #include <lz4frame.h>
 #endif
 
+/* Parallel compression uses POSIX threads, which Windows lacks */
+#if defined(USE_LZ4) && !defined(WIN32)
+#define LZ4_PARALLEL_COMPRESSION
+#include <pthread.h>
+#endif
+
 #include "bbstreamer.h"
 #include "common/file_perm.h"
 #include "common/logging.h"
@@ -62,6 +68,76 @@ const bbstreamer_ops bbstreamer_lz4_decompressor_ops = {
 };
 #endif
 
+#ifdef LZ4_PARALLEL_COMPRESSION
+/*
+ * With the "workers" option, the input is cut into blocks that are
+ * compressed by a pool of threads, each block becoming a complete lz4 frame.
+ * A sequence of frames is a valid lz4 stream.  The frames are passed on in
+ * their original order; blocks are assigned to threads and written out in
+ * sequence order, and each block uses ring slot (sequence % nslots).
+ */
+#define LZ4_PARALLEL_BLOCK_SIZE		(1024 * 1024)
+
+typedef enum
+{
+	LZ4_SLOT_FREE,				/* being filled with input, or unused */
+	LZ4_SLOT_PENDING,			/* waiting to be compressed */
+	LZ4_SLOT_DONE,				/* compressed, waiting to be written */
+} bbstreamer_lz4_slot_state;
+
+typedef struct bbstreamer_lz4_slot
+{
+	bbstreamer_lz4_slot_state state;
+	char	   *in;
+	size_t		in_len;
+	char	   *out;
+	size_t		out_len;		/* or an lz4 error code */
+} bbstreamer_lz4_slot;
+
+typedef struct bbstreamer_lz4_parallel
+{
+	bbstreamer	base;
+
+	LZ4F_preferences_t prefs;
+	size_t		out_bound;		/* output size needed for one block */
+
+	int			nworkers;
+	pthread_t  *threads;
+	int			nslots;
+	bbstreamer_lz4_slot *slots;
+
+	/* protected by mutex: */
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cv;		/* signaled when a block is submitted */
+	pthread_cond_t done_cv;		/* signaled when a block is compressed */
+	uint64		next_submit;	/* sequence number of block being filled */
+	uint64		next_compress;	/* next block for a thread to take */
+	bool		shutdown;
+
+	/* used only by the main thread: */
+	uint64		next_write;		/* next block to pass on */
+} bbstreamer_lz4_parallel;
+
+static void bbstreamer_lz4_parallel_content(bbstreamer *streamer,
+											bbstreamer_member *member,
+											const char *data, int len,
+											bbstreamer_archive_context context);
+static void bbstreamer_lz4_parallel_finalize(bbstreamer *streamer);
+static void bbstreamer_lz4_parallel_free(bbstreamer *streamer);
+
+const bbstreamer_ops bbstreamer_lz4_parallel_ops = {
+	.content = bbstreamer_lz4_parallel_content,
+	.finalize = bbstreamer_lz4_parallel_finalize,
+	.free = bbstreamer_lz4_parallel_free
+};
+
+static bbstreamer *bbstreamer_lz4_parallel_new(bbstreamer *next,
+											   pg_compress_specification *compress);
+static void *bbstreamer_lz4_parallel_worker(void *arg);
+static void bbstreamer_lz4_parallel_write_one(bbstreamer_lz4_parallel *mystreamer);
+static void bbstreamer_lz4_parallel_stop(bbstreamer_lz4_parallel *mystreamer);
+#endif
+
 /*
  * Create a new base backup streamer that performs lz4 compression of tar
  * blocks.
@@ -76,6 +152,17 @@ bbstreamer_lz4_compressor_new(bbstreamer *next, pg_compress_specification *compr
 
 	Assert(next != NULL);
 
+	if ((compress->options & PG_COMPRESSION_OPTION_WORKERS) != 0 &&
+		compress->workers > 0)
+	{
+#ifdef LZ4_PARALLEL_COMPRESSION
+		return bbstreamer_lz4_parallel_new(next, compress);
+#else
+		pg_log_warning("this build does not support parallel compression with %s",
+					   "LZ4");
+#endif
+	}
+
 	streamer = palloc0(sizeof(bbstreamer_lz4_frame));
 	*((const bbstreamer_ops **) &streamer->base.bbs_ops) =
 		&bbstreamer_lz4_compressor_ops;
@@ -267,6 +354,239 @@ bbstreamer_lz4_compressor_free(bbstreamer *streamer)
 }
 #endif
 
+#ifdef LZ4_PARALLEL_COMPRESSION
+/*
+ * Create a streamer that compresses with compress->workers threads.
+ */
+static bbstreamer *
+bbstreamer_lz4_parallel_new(bbstreamer *next,
+							pg_compress_specification *compress)
+{
+	bbstreamer_lz4_parallel *streamer;
+
+	streamer = palloc0(sizeof(bbstreamer_lz4_parallel));
+	*((const bbstreamer_ops **) &streamer->base.bbs_ops) =
+		&bbstreamer_lz4_parallel_ops;
+
+	streamer->base.bbs_next = next;
+	initStringInfo(&streamer->base.bbs_buffer);
+
+	streamer->prefs.frameInfo.blockSizeID = LZ4F_max256KB;
+	streamer->prefs.compressionLevel = compress->level;
+	streamer->out_bound = LZ4F_compressFrameBound(LZ4_PARALLEL_BLOCK_SIZE,
+												  &streamer->prefs);
+
+	/* Two slots per thread let the threads work while we write out */
+	streamer->nworkers = compress->workers;
+	streamer->nslots = 2 * streamer->nworkers;
+	streamer->slots = palloc0(streamer->nslots * sizeof(bbstreamer_lz4_slot));
+	for (int i = 0; i < streamer->nslots; i++)
+	{
+		streamer->slots[i].in = palloc(LZ4_PARALLEL_BLOCK_SIZE);
+		streamer->slots[i].out = palloc(streamer->out_bound);
+	}
+
+	pthread_mutex_init(&streamer->mutex, NULL);
+	pthread_cond_init(&streamer->work_cv, NULL);
+	pthread_cond_init(&streamer->done_cv, NULL);
+
+	streamer->threads = palloc(streamer->nworkers * sizeof(pthread_t));
+	for (int i = 0; i < streamer->nworkers; i++)
+	{
+		int			rc;
+
+		rc = pthread_create(&streamer->threads[i], NULL,
+							bbstreamer_lz4_parallel_worker, streamer);
+		if (rc != 0)
+			pg_fatal("could not create compression thread: %s",
+					 strerror(rc));
+	}
+
+	return &streamer->base;
+}
+
+/*
+ * Thread main loop: compress submitted blocks until told to stop.
+ */
+static void *
+bbstreamer_lz4_parallel_worker(void *arg)
+{
+	bbstreamer_lz4_parallel *mystreamer = arg;
+
+	pthread_mutex_lock(&mystreamer->mutex);
+	for (;;)
+	{
+		bbstreamer_lz4_slot *slot;
+		size_t		out_len;
+
+		while (mystreamer->next_compress == mystreamer->next_submit &&
+			   !mystreamer->shutdown)
+			pthread_cond_wait(&mystreamer->work_cv, &mystreamer->mutex);
+		if (mystreamer->next_compress == mystreamer->next_submit)
+			break;
+
+		slot = &mystreamer->slots[mystreamer->next_compress % mystreamer->nslots];
+		mystreamer->next_compress++;
+		Assert(slot->state == LZ4_SLOT_PENDING);
+		pthread_mutex_unlock(&mystreamer->mutex);
+
+		out_len = LZ4F_compressFrame(slot->out, mystreamer->out_bound,
+									 slot->in, slot->in_len,
+									 &mystreamer->prefs);
+
+		pthread_mutex_lock(&mystreamer->mutex);
+		slot->out_len = out_len;
+		slot->state = LZ4_SLOT_DONE;
+		pthread_cond_broadcast(&mystreamer->done_cv);
+	}
+	pthread_mutex_unlock(&mystreamer->mutex);
+
+	return NULL;
+}
+
+/*
+ * Wait for the oldest submitted block to be compressed, and pass it on.
+ */
+static void
+bbstreamer_lz4_parallel_write_one(bbstreamer_lz4_parallel *mystreamer)
+{
+	bbstreamer_lz4_slot *slot;
+
+	Assert(mystreamer->next_write < mystreamer->next_submit);
+	slot = &mystreamer->slots[mystreamer->next_write % mystreamer->nslots];
+
+	pthread_mutex_lock(&mystreamer->mutex);
+	while (slot->state != LZ4_SLOT_DONE)
+		pthread_cond_wait(&mystreamer->done_cv, &mystreamer->mutex);
+	pthread_mutex_unlock(&mystreamer->mutex);
+
+	if (LZ4F_isError(slot->out_len))
+		pg_fatal("could not compress data: %s",
+				 LZ4F_getErrorName(slot->out_len));
+
+	bbstreamer_content(mystreamer->base.bbs_next, NULL,
+					   slot->out, slot->out_len, BBSTREAMER_UNKNOWN);
+
+	slot->state = LZ4_SLOT_FREE;
+	slot->in_len = 0;
+	mystreamer->next_write++;
+}
+
+/*
+ * Collect input into the current block, submitting each block once full.
+ */
+static void
+bbstreamer_lz4_parallel_content(bbstreamer *streamer,
+								bbstreamer_member *member,
+								const char *data, int len,
+								bbstreamer_archive_context context)
+{
+	bbstreamer_lz4_parallel *mystreamer = (bbstreamer_lz4_parallel *) streamer;
+
+	while (len > 0)
+	{
+		bbstreamer_lz4_slot *slot;
+		size_t		nbytes;
+
+		/* If the slot is still in use by an older block, write that out */
+		if (mystreamer->next_submit - mystreamer->next_write >= mystreamer->nslots)
+			bbstreamer_lz4_parallel_write_one(mystreamer);
+
+		slot = &mystreamer->slots[mystreamer->next_submit % mystreamer->nslots];
+		nbytes = Min(LZ4_PARALLEL_BLOCK_SIZE - slot->in_len, len);
+		memcpy(slot->in + slot->in_len, data, nbytes);
+		slot->in_len += nbytes;
+		data += nbytes;
+		len -= nbytes;
+
+		if (slot->in_len == LZ4_PARALLEL_BLOCK_SIZE)
+		{
+			pthread_mutex_lock(&mystreamer->mutex);
+			slot->state = LZ4_SLOT_PENDING;
+			mystreamer->next_submit++;
+			pthread_cond_signal(&mystreamer->work_cv);
+			pthread_mutex_unlock(&mystreamer->mutex);
+		}
+	}
+}
+
+/*
+ * Submit the last partial block, write out all blocks, and stop the threads.
+ */
+static void
+bbstreamer_lz4_parallel_finalize(bbstreamer *streamer)
+{
+	bbstreamer_lz4_parallel *mystreamer = (bbstreamer_lz4_parallel *) streamer;
+	bbstreamer_lz4_slot *slot;
+
+	if (mystreamer->next_submit - mystreamer->next_write >= mystreamer->nslots)
+		bbstreamer_lz4_parallel_write_one(mystreamer);
+
+	/* An empty stream still gets one (empty) frame */
+	slot = &mystreamer->slots[mystreamer->next_submit % mystreamer->nslots];
+	if (slot->in_len > 0 || mystreamer->next_submit == 0)
+	{
+		pthread_mutex_lock(&mystreamer->mutex);
+		slot->state = LZ4_SLOT_PENDING;
+		mystreamer->next_submit++;
+		pthread_cond_signal(&mystreamer->work_cv);
+		pthread_mutex_unlock(&mystreamer->mutex);
+	}
+
+	while (mystreamer->next_write < mystreamer->next_submit)
+		bbstreamer_lz4_parallel_write_one(mystreamer);
+
+	bbstreamer_lz4_parallel_stop(mystreamer);
+
+	bbstreamer_finalize(mystreamer->base.bbs_next);
+}
+
+/*
+ * Make the threads exit once no work is left, and wait for them.
+ */
+static void
+bbstreamer_lz4_parallel_stop(bbstreamer_lz4_parallel *mystreamer)
+{
+	if (mystreamer->threads == NULL)
+		return;
+
+	pthread_mutex_lock(&mystreamer->mutex);
+	mystreamer->shutdown = true;
+	pthread_cond_broadcast(&mystreamer->work_cv);
+	pthread_mutex_unlock(&mystreamer->mutex);
+
+	for (int i = 0; i < mystreamer->nworkers; i++)
+		pthread_join(mystreamer->threads[i], NULL);
+
+	pfree(mystreamer->threads);
+	mystreamer->threads = NULL;
+}
+
+/*
+ * Free memory.
+ */
+static void
+bbstreamer_lz4_parallel_free(bbstreamer *streamer)
+{
+	bbstreamer_lz4_parallel *mystreamer = (bbstreamer_lz4_parallel *) streamer;
+
+	bbstreamer_lz4_parallel_stop(mystreamer);
+	bbstreamer_free(streamer->bbs_next);
+
+	for (int i = 0; i < mystreamer->nslots; i++)
+	{
+		pfree(mystreamer->slots[i].in);
+		pfree(mystreamer->slots[i].out);
+	}
+	pfree(mystreamer->slots);
+	pthread_mutex_destroy(&mystreamer->mutex);
+	pthread_cond_destroy(&mystreamer->work_cv);
+	pthread_cond_destroy(&mystreamer->done_cv);
+	pfree(streamer->bbs_buffer.data);
+	pfree(streamer);
+}
+#endif
+
 /*
  * Create a new base backup streamer that performs decompression of lz4
  * compressed blocks.
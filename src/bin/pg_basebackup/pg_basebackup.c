@@ -2656,7 +2656,24 @@ main(int argc, char **argv)
 					 compression_algorithm);
 
 		parse_compress_specification(alg, compression_detail, &client_compress);
-		error_detail = validate_compress_specification(&client_compress);
+
+		/*
+		 * The lz4 library has no worker threads, but our client-side lz4
+		 * compressor can run several compressions at once (see
+		 * bbstreamer_lz4.c), so accept a worker count for it.
+		 */
+		if (alg == PG_COMPRESSION_LZ4 &&
+			(client_compress.options & PG_COMPRESSION_OPTION_WORKERS) != 0)
+		{
+			if (client_compress.workers < 0)
+				pg_fatal("invalid compression specification: %s",
+						 "worker count must not be negative");
+			client_compress.options &= ~PG_COMPRESSION_OPTION_WORKERS;
+			error_detail = validate_compress_specification(&client_compress);
+			client_compress.options |= PG_COMPRESSION_OPTION_WORKERS;
+		}
+		else
+			error_detail = validate_compress_specification(&client_compress);
 		if (error_detail != NULL)
 			pg_fatal("invalid compression specification: %s",
 					 error_detail);
@@ -16,13 +16,18 @@
 
 #include <dirent.h>
 #include <limits.h>
+#include <signal.h>
 #include <time.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "common/controldata_utils.h"
 #include "common/file_perm.h"
 #include "common/file_utils.h"
+#include "common/int.h"
 #include "common/logging.h"
 #include "common/relpath.h"
 #include "fe_utils/option_utils.h"
@@ -45,6 +50,48 @@ static bool do_sync = true;
 static bool verbose = false;
 static bool showprogress = false;
 static DataDirSyncMethod sync_method = DATA_DIR_SYNC_METHOD_FSYNC;
+static int	num_jobs = 1;
+
+/*
+ * Number of blocks to read from a file at once.  Files are always read
+ * sequentially, so larger reads mean fewer system calls and better
+ * readahead.
+ */
+#define SCAN_CHUNK_BLOCKS	64
+
+/*
+ * With --jobs, the files to scan are collected into this array first, and
+ * then dealt out to the worker processes.
+ */
+typedef struct ScanFileEntry
+{
+	char	   *path;
+	int			segmentno;
+	int64		size;
+	int			worker;			/* worker process assigned to the file */
+} ScanFileEntry;
+
+static ScanFileEntry *scan_files = NULL;
+static int	num_scan_files = 0;
+static int	max_scan_files = 0;
+
+/*
+ * What a --jobs worker sends to the parent through a pipe: the counter
+ * increments since its previous report.  This is small enough for a single
+ * write() to a pipe to be atomic, so all workers can share one pipe.
+ */
+typedef struct ScanWorkerReport
+{
+	int64		files_scanned;
+	int64		files_written;
+	int64		blocks_scanned;
+	int64		blocks_written;
+	int64		badblocks;
+	int64		current_size;
+} ScanWorkerReport;
+
+/* In a --jobs worker, the pipe to report to the parent through */
+static int	report_pipe = -1;
 
 typedef enum
 {
@@ -76,6 +123,7 @@ usage(void)
 	printf(_("  -d, --disable            disable data checksums\n"));
 	printf(_("  -e, --enable             enable data checksums\n"));
 	printf(_("  -f, --filenode=FILENODE  check only relation with specified filenode\n"));
+	printf(_("  -j, --jobs=NUM           use this many processes to check or enable checksums\n"));
 	printf(_("  -N, --no-sync            do not wait for changes to be written safely to disk\n"));
 	printf(_("  -P, --progress           show progress information\n"));
 	printf(_("      --sync-method=METHOD set method for syncing files to disk\n"));
@@ -172,13 +220,47 @@ skipfile(const char *fn)
 	return false;
 }
 
+#ifndef WIN32
+
+/*
+ * Send the counter increments since the previous report to the parent
+ * process of a --jobs worker.
+ */
+static void
+send_worker_report(void)
+{
+	ScanWorkerReport report;
+	ssize_t		rc;
+
+	report.files_scanned = files_scanned;
+	report.files_written = files_written;
+	report.blocks_scanned = blocks_scanned;
+	report.blocks_written = blocks_written;
+	report.badblocks = badblocks;
+	report.current_size = current_size;
+
+	do
+	{
+		rc = write(report_pipe, &report, sizeof(report));
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc != sizeof(report))
+		pg_fatal("could not write to pipe: %m");
+
+	files_scanned = files_written = 0;
+	blocks_scanned = blocks_written = 0;
+	badblocks = 0;
+	current_size = 0;
+}
+
+#endif							/* !WIN32 */
+
 static void
 scan_file(const char *fn, int segmentno)
 {
-	PGIOAlignedBlock buf;
-	PageHeader	header = (PageHeader) buf.data;
+	static PGIOAlignedBlock buf[SCAN_CHUNK_BLOCKS];
 	int			f;
-	BlockNumber blockno;
+	BlockNumber blockno = 0;
 	int			flags;
 	int64		blocks_written_in_file = 0;
 
@@ -193,82 +275,104 @@ scan_file(const char *fn, int segmentno)
 
 	files_scanned++;
 
-	for (blockno = 0;; blockno++)
+	for (;;)
 	{
-		uint16		csum;
-		int			r = read(f, buf.data, BLCKSZ);
+		int			nread = 0;
+		int			nblocks;
 
-		if (r == 0)
-			break;
-		if (r != BLCKSZ)
+		/* Fill the buffer, unless the end of the file comes first */
+		while (nread < sizeof(buf))
 		{
+			int			r = read(f, (char *) buf + nread, sizeof(buf) - nread);
+
 			if (r < 0)
 				pg_fatal("could not read block %u in file \"%s\": %m",
-						 blockno, fn);
-			else
-				pg_fatal("could not read block %u in file \"%s\": read %d of %d",
-						 blockno, fn, r, BLCKSZ);
+						 blockno + nread / BLCKSZ, fn);
+			if (r == 0)
+				break;
+			nread += r;
 		}
-		blocks_scanned++;
-
-		/*
-		 * Since the file size is counted as total_size for progress status
-		 * information, the sizes of all pages including new ones in the file
-		 * should be counted as current_size. Otherwise the progress reporting
-		 * calculated using those counters may not reach 100%.
-		 */
-		current_size += r;
-
-		/* New pages have no checksum yet */
-		if (PageIsNew(buf.data))
-			continue;
 
-		csum = pg_checksum_page(buf.data, blockno + segmentno * RELSEG_SIZE);
-		if (mode == PG_MODE_CHECK)
-		{
-			if (csum != header->pd_checksum)
-			{
-				if (ControlFile->data_checksum_version == PG_DATA_CHECKSUM_VERSION)
-					pg_log_error("checksum verification failed in file \"%s\", block %u: calculated checksum %X but block contains %X",
-								 fn, blockno, csum, header->pd_checksum);
-				badblocks++;
-			}
-		}
-		else if (mode == PG_MODE_ENABLE)
+		nblocks = nread / BLCKSZ;
+		if (nread % BLCKSZ != 0)
+			pg_fatal("could not read block %u in file \"%s\": read %d of %d",
+					 blockno + nblocks, fn, nread % BLCKSZ, BLCKSZ);
+
+		for (int i = 0; i < nblocks; i++, blockno++)
 		{
-			int			w;
+			char	   *page = buf[i].data;
+			PageHeader	header = (PageHeader) page;
+			uint16		csum;
+
+			blocks_scanned++;
 
 			/*
-			 * Do not rewrite if the checksum is already set to the expected
-			 * value.
+			 * Since the file size is counted as total_size for progress
+			 * status information, the sizes of all pages including new ones
+			 * in the file should be counted as current_size. Otherwise the
+			 * progress reporting calculated using those counters may not
+			 * reach 100%.
 			 */
-			if (header->pd_checksum == csum)
-				continue;
-
-			blocks_written_in_file++;
-
-			/* Set checksum in page header */
-			header->pd_checksum = csum;
+			current_size += BLCKSZ;
 
-			/* Seek back to beginning of block */
-			if (lseek(f, -BLCKSZ, SEEK_CUR) < 0)
-				pg_fatal("seek failed for block %u in file \"%s\": %m", blockno, fn);
+			/* New pages have no checksum yet */
+			if (PageIsNew(page))
+				continue;
 
-			/* Write block with checksum */
-			w = write(f, buf.data, BLCKSZ);
-			if (w != BLCKSZ)
+			csum = pg_checksum_page(page, blockno + segmentno * RELSEG_SIZE);
+			if (mode == PG_MODE_CHECK)
 			{
-				if (w < 0)
-					pg_fatal("could not write block %u in file \"%s\": %m",
-							 blockno, fn);
-				else
-					pg_fatal("could not write block %u in file \"%s\": wrote %d of %d",
-							 blockno, fn, w, BLCKSZ);
+				if (csum != header->pd_checksum)
+				{
+					if (ControlFile->data_checksum_version == PG_DATA_CHECKSUM_VERSION)
+						pg_log_error("checksum verification failed in file \"%s\", block %u: calculated checksum %X but block contains %X",
+									 fn, blockno, csum, header->pd_checksum);
+					badblocks++;
+				}
+			}
+			else if (mode == PG_MODE_ENABLE)
+			{
+				int			w;
+
+				/*
+				 * Do not rewrite if the checksum is already set to the
+				 * expected value.
+				 */
+				if (header->pd_checksum == csum)
+					continue;
+
+				blocks_written_in_file++;
+
+				/* Set checksum in page header */
+				header->pd_checksum = csum;
+
+				/* Write block with checksum */
+				w = pg_pwrite(f, page, BLCKSZ, (off_t) blockno * BLCKSZ);
+				if (w != BLCKSZ)
+				{
+					if (w < 0)
+						pg_fatal("could not write block %u in file \"%s\": %m",
+								 blockno, fn);
+					else
+						pg_fatal("could not write block %u in file \"%s\": wrote %d of %d",
+								 blockno, fn, w, BLCKSZ);
+				}
 			}
 		}
 
 		if (showprogress)
-			progress_report(false);
+		{
+#ifndef WIN32
+			if (report_pipe >= 0)
+				send_worker_report();
+			else
+#endif
+				progress_report(false);
+		}
+
+		/* A short read means that we have reached the end of the file */
+		if (nread < sizeof(buf))
+			break;
 	}
 
 	if (verbose)
@@ -287,6 +391,31 @@ scan_file(const char *fn, int segmentno)
 	}
 
 	close(f);
+
+#ifndef WIN32
+	if (report_pipe >= 0)
+		send_worker_report();
+#endif
+}
+
+/*
+ * Remember a file for scan_files_parallel() to scan.
+ */
+static void
+add_scan_file(const char *fn, int segmentno, int64 size)
+{
+	if (num_scan_files >= max_scan_files)
+	{
+		max_scan_files = Max(max_scan_files * 2, 1024);
+		scan_files = pg_realloc_array(scan_files, ScanFileEntry,
+									  max_scan_files);
+	}
+
+	scan_files[num_scan_files].path = pg_strdup(fn);
+	scan_files[num_scan_files].segmentno = segmentno;
+	scan_files[num_scan_files].size = size;
+	scan_files[num_scan_files].worker = 0;
+	num_scan_files++;
 }
 
 /*
@@ -375,10 +504,16 @@ scan_directory(const char *basedir, const char *subdir, bool sizeonly)
 
 			/*
 			 * No need to work on the file when calculating only the size of
-			 * the items in the data folder.
+			 * the items in the data folder.  With --jobs, just remember the
+			 * file for the worker processes.
 			 */
 			if (!sizeonly)
-				scan_file(fn, segmentno);
+			{
+				if (num_jobs > 1)
+					add_scan_file(fn, segmentno, st.st_size);
+				else
+					scan_file(fn, segmentno);
+			}
 		}
 		else if (S_ISDIR(st.st_mode) || S_ISLNK(st.st_mode))
 		{
@@ -429,6 +564,181 @@ scan_directory(const char *basedir, const char *subdir, bool sizeonly)
 	return dirsize;
 }
 
+#ifndef WIN32
+
+/*
+ * qsort comparator to put the largest files first.
+ */
+static int
+scan_file_size_cmp(const void *a, const void *b)
+{
+	const ScanFileEntry *fa = (const ScanFileEntry *) a;
+	const ScanFileEntry *fb = (const ScanFileEntry *) b;
+
+	return pg_cmp_s64(fb->size, fa->size);
+}
+
+/*
+ * Send SIGTERM to all --jobs workers that have not been waited for yet.
+ */
+static void
+terminate_scan_workers(pid_t *pids, int nworkers)
+{
+	for (int i = 0; i < nworkers; i++)
+	{
+		if (pids[i] != 0)
+			kill(pids[i], SIGTERM);
+	}
+}
+
+/*
+ * Collect the exit status of --jobs workers that have exited, or of all of
+ * them if "wait" is true.  A worker exits with a nonzero status only after
+ * a fatal error, which it has reported itself; stop the others in that case.
+ */
+static void
+reap_scan_workers(pid_t *pids, int nworkers, bool wait)
+{
+	for (int i = 0; i < nworkers; i++)
+	{
+		int			status;
+		pid_t		rc;
+
+		if (pids[i] == 0)
+			continue;
+
+		rc = waitpid(pids[i], &status, wait ? 0 : WNOHANG);
+		if (rc == 0)
+			continue;
+		if (rc < 0)
+			pg_fatal("could not wait for worker process: %m");
+		pids[i] = 0;
+
+		if (status != 0)
+		{
+			terminate_scan_workers(pids, nworkers);
+			pg_fatal("worker process failed: %s", wait_result_to_str(status));
+		}
+	}
+}
+
+/*
+ * Scan the files collected by scan_directory() using num_jobs worker
+ * processes.
+ *
+ * The files are dealt out largest first, each to the worker with the fewest
+ * bytes to read so far, so that the workers finish at about the same time.
+ * Every worker sends its counters to us through a shared pipe after each
+ * file, and with --progress also after each chunk it has read.
+ */
+static void
+scan_files_parallel(void)
+{
+	int			nworkers = Min(num_jobs, num_scan_files);
+	int64	   *load;
+	pid_t	   *pids;
+	int			pipefd[2];
+
+	if (num_scan_files == 0)
+		return;
+
+	qsort(scan_files, num_scan_files, sizeof(ScanFileEntry),
+		  scan_file_size_cmp);
+
+	load = pg_malloc0_array(int64, nworkers);
+	for (int i = 0; i < num_scan_files; i++)
+	{
+		int			best = 0;
+
+		for (int w = 1; w < nworkers; w++)
+		{
+			if (load[w] < load[best])
+				best = w;
+		}
+		scan_files[i].worker = best;
+		load[best] += scan_files[i].size;
+	}
+
+	if (pipe(pipefd) < 0)
+		pg_fatal("could not create pipe: %m");
+
+	pids = pg_malloc_array(pid_t, nworkers);
+
+	/* flush stdio channels before fork, to avoid double output */
+	fflush(NULL);
+
+	for (int w = 0; w < nworkers; w++)
+	{
+		pids[w] = fork();
+		if (pids[w] < 0)
+		{
+			terminate_scan_workers(pids, w);
+			pg_fatal("could not fork worker process: %m");
+		}
+
+		if (pids[w] == 0)
+		{
+			close(pipefd[0]);
+			report_pipe = pipefd[1];
+
+			for (int i = 0; i < num_scan_files; i++)
+			{
+				if (scan_files[i].worker == w)
+					scan_file(scan_files[i].path, scan_files[i].segmentno);
+			}
+
+			exit(0);
+		}
+	}
+	close(pipefd[1]);
+
+	/* Add up the reports until every worker has closed the pipe. */
+	for (;;)
+	{
+		ScanWorkerReport report;
+		char	   *ptr = (char *) &report;
+		size_t		left = sizeof(report);
+
+		while (left > 0)
+		{
+			ssize_t		rc = read(pipefd[0], ptr, left);
+
+			if (rc < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				pg_fatal("could not read from pipe: %m");
+			}
+			if (rc == 0)
+				break;
+			ptr += rc;
+			left -= rc;
+		}
+		if (left > 0)
+			break;
+
+		files_scanned += report.files_scanned;
+		files_written += report.files_written;
+		blocks_scanned += report.blocks_scanned;
+		blocks_written += report.blocks_written;
+		badblocks += report.badblocks;
+		current_size += report.current_size;
+
+		if (showprogress)
+			progress_report(false);
+
+		reap_scan_workers(pids, nworkers, false);
+	}
+	close(pipefd[0]);
+
+	reap_scan_workers(pids, nworkers, true);
+
+	pg_free(pids);
+	pg_free(load);
+}
+
+#endif							/* !WIN32 */
+
 int
 main(int argc, char *argv[])
 {
@@ -438,6 +748,7 @@ main(int argc, char *argv[])
 		{"disable", no_argument, NULL, 'd'},
 		{"enable", no_argument, NULL, 'e'},
 		{"filenode", required_argument, NULL, 'f'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"no-sync", no_argument, NULL, 'N'},
 		{"progress", no_argument, NULL, 'P'},
 		{"verbose", no_argument, NULL, 'v'},
@@ -468,7 +779,7 @@ main(int argc, char *argv[])
 		}
 	}
 
-	while ((c = getopt_long(argc, argv, "cdD:ef:NPv", long_options, &option_index)) != -1)
+	while ((c = getopt_long(argc, argv, "cdD:ef:j:NPv", long_options, &option_index)) != -1)
 	{
 		switch (c)
 		{
@@ -491,6 +802,11 @@ main(int argc, char *argv[])
 					exit(1);
 				only_filenode = pstrdup(optarg);
 				break;
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &num_jobs))
+					exit(1);
+				break;
 			case 'N':
 				do_sync = false;
 				break;
@@ -544,6 +860,15 @@ main(int argc, char *argv[])
 		exit(1);
 	}
 
+#ifdef WIN32
+	if (num_jobs > 1)
+	{
+		pg_log_error("option %s is not supported on this platform",
+					 "-j/--jobs");
+		exit(1);
+	}
+#endif
+
 	/* Read the control file and check compatibility */
 	ControlFile = get_controlfile(DataDir, &crc_ok);
 	if (!crc_ok)
@@ -584,21 +909,39 @@ main(int argc, char *argv[])
 	/* Operate on all files if checking or enabling checksums */
 	if (mode == PG_MODE_CHECK || mode == PG_MODE_ENABLE)
 	{
-		/*
-		 * If progress status information is requested, we need to scan the
-		 * directory tree twice: once to know how much total data needs to be
-		 * processed and once to do the real work.
-		 */
-		if (showprogress)
+		if (num_jobs > 1)
 		{
-			total_size = scan_directory(DataDir, "global", true);
-			total_size += scan_directory(DataDir, "base", true);
-			total_size += scan_directory(DataDir, "pg_tblspc", true);
+			/*
+			 * With --jobs, the directory tree is scanned once to collect the
+			 * files, which also yields the total size for progress reports,
+			 * and the worker processes do the real work.
+			 */
+			total_size = scan_directory(DataDir, "global", false);
+			total_size += scan_directory(DataDir, "base", false);
+			total_size += scan_directory(DataDir, "pg_tblspc", false);
+
+#ifndef WIN32
+			scan_files_parallel();
+#endif
 		}
+		else
+		{
+			/*
+			 * If progress status information is requested, we need to scan
+			 * the directory tree twice: once to know how much total data
+			 * needs to be processed and once to do the real work.
+			 */
+			if (showprogress)
+			{
+				total_size = scan_directory(DataDir, "global", true);
+				total_size += scan_directory(DataDir, "base", true);
+				total_size += scan_directory(DataDir, "pg_tblspc", true);
+			}
 
-		(void) scan_directory(DataDir, "global", false);
-		(void) scan_directory(DataDir, "base", false);
-		(void) scan_directory(DataDir, "pg_tblspc", false);
+			(void) scan_directory(DataDir, "global", false);
+			(void) scan_directory(DataDir, "base", false);
+			(void) scan_directory(DataDir, "pg_tblspc", false);
+		}
 
 		if (showprogress)
 			progress_report(true);
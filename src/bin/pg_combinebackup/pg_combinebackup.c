@@ -16,6 +16,12 @@
 #include <fcntl.h>
 #include <limits.h>
 
+/* --jobs uses POSIX threads, which Windows lacks */
+#ifndef WIN32
+#define CB_PARALLEL
+#include <pthread.h>
+#endif
+
 #include "backup_label.h"
 #include "common/blkreftable.h"
 #include "common/checksum_helper.h"
@@ -70,8 +76,65 @@ typedef struct cb_options
 	bool		no_manifest;
 	DataDirSyncMethod sync_method;
 	CopyMethod	copy_method;
+	int			jobs;
 } cb_options;
 
+/*
+ * Work to be done for one file of the output directory: either reconstruct
+ * it from an incremental file, or copy it.
+ *
+ * If checksum_length is not 0, checksum_payload is a checksum taken from the
+ * final backup's manifest that can be reused for the output file.
+ */
+typedef struct cb_file_job
+{
+	bool		incremental;
+	char		ifullpath[MAXPGPATH];
+	char		ofullpath[MAXPGPATH];
+	char		manifest_path[MAXPGPATH];
+	char		manifest_prefix[MAXPGPATH]; /* only if incremental */
+	char	   *bare_file_name; /* last component of ofullpath */
+	pg_checksum_type checksum_type;
+	int			checksum_length;
+	uint8	   *checksum_payload;
+	struct cb_file_job *next;
+} cb_file_job;
+
+#ifdef CB_PARALLEL
+/*
+ * Threads processing files for --jobs.
+ *
+ * The main thread walks the input directories, creating output directories
+ * as it goes, and queues a cb_file_job for each file.  The threads take jobs
+ * from the queue in order.  The queue is kept short so that the directory
+ * walk doesn't run far ahead.  Manifest entries are added under
+ * manifest_lock, so their order depends on the order the jobs finish in.
+ */
+typedef struct cb_job_pool
+{
+	int			nthreads;
+	pthread_t  *threads;
+
+	/* arguments for process_file() */
+	int			n_prior_backups;
+	char	  **prior_backup_dirs;
+	manifest_data **manifests;
+	manifest_writer *mwriter;
+	cb_options *opt;
+
+	pthread_mutex_t lock;		/* protects the fields below */
+	pthread_cond_t queue_cv;	/* signaled when the queue changes */
+	cb_file_job *head;
+	cb_file_job *tail;
+	int			nqueued;
+	bool		shutdown;
+
+	pthread_mutex_t manifest_lock;	/* serializes add_file_to_manifest() */
+} cb_job_pool;
+#else
+typedef struct cb_job_pool cb_job_pool;
+#endif
+
 /*
  * Data about a tablespace.
  *
@@ -91,6 +154,9 @@ typedef struct cb_tablespace
 /* Directories to be removed if we exit uncleanly. */
 cb_cleanup_dir *cleanup_dir_list = NULL;
 
+/* Threads for --jobs, or NULL to process each file as we find it. */
+static cb_job_pool *job_pool = NULL;
+
 static void add_tablespace_mapping(cb_options *opt, char *arg);
 static StringInfo check_backup_label_files(int n_backups, char **backup_dirs);
 static uint64 check_control_files(int n_backups, char **backup_dirs);
@@ -108,6 +174,23 @@ static void process_directory_recursively(Oid tsoid,
 										  manifest_data **manifests,
 										  manifest_writer *mwriter,
 										  cb_options *opt);
+static void process_file(cb_file_job *job,
+						 int n_prior_backups,
+						 char **prior_backup_dirs,
+						 manifest_data **manifests,
+						 manifest_writer *mwriter,
+						 cb_options *opt);
+#ifdef CB_PARALLEL
+static cb_job_pool *start_job_pool(int nthreads,
+								   int n_prior_backups,
+								   char **prior_backup_dirs,
+								   manifest_data **manifests,
+								   manifest_writer *mwriter,
+								   cb_options *opt);
+static void *job_pool_thread(void *arg);
+static void finish_job_pool(cb_job_pool *pool);
+#endif
+static void submit_file_job(cb_job_pool *pool, cb_file_job *job);
 static int	read_pg_version_file(char *directory);
 static void remember_to_cleanup_directory(char *target_path, bool rmtopdir);
 static void reset_directory_cleanup_list(void);
@@ -124,6 +207,7 @@ main(int argc, char *argv[])
 	static struct option long_options[] = {
 		{"debug", no_argument, NULL, 'd'},
 		{"dry-run", no_argument, NULL, 'n'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"no-sync", no_argument, NULL, 'N'},
 		{"output", required_argument, NULL, 'o'},
 		{"tablespace-mapping", required_argument, NULL, 'T'},
@@ -161,9 +245,10 @@ main(int argc, char *argv[])
 	opt.manifest_checksums = CHECKSUM_TYPE_CRC32C;
 	opt.sync_method = DATA_DIR_SYNC_METHOD_FSYNC;
 	opt.copy_method = COPY_METHOD_COPY;
+	opt.jobs = 1;
 
 	/* process command-line options */
-	while ((c = getopt_long(argc, argv, "dnNo:T:",
+	while ((c = getopt_long(argc, argv, "dj:nNo:T:",
 							long_options, &optindex)) != -1)
 	{
 		switch (c)
@@ -172,6 +257,11 @@ main(int argc, char *argv[])
 				opt.debug = true;
 				pg_logging_increase_verbosity();
 				break;
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &opt.jobs))
+					exit(1);
+				break;
 			case 'n':
 				opt.dry_run = true;
 				break;
@@ -253,6 +343,11 @@ main(int argc, char *argv[])
 #endif
 	}
 
+#ifndef CB_PARALLEL
+	if (opt.jobs > 1)
+		pg_fatal("parallel jobs are not supported on this platform");
+#endif
+
 	/* Read the server version from the final backup. */
 	version = read_pg_version_file(argv[argc - 1]);
 
@@ -341,6 +436,14 @@ main(int argc, char *argv[])
 						   opt.manifest_checksums, mwriter);
 	}
 
+#ifdef CB_PARALLEL
+	/* Start the threads that will process the files, if requested. */
+	if (opt.jobs > 1 && !opt.dry_run)
+		job_pool = start_job_pool(opt.jobs, n_prior_backups,
+								  prior_backup_dirs, manifests, mwriter,
+								  &opt);
+#endif
+
 	/* Process everything that's not part of a user-defined tablespace. */
 	pg_log_debug("processing backup directory \"%s\"", last_input_dir);
 	process_directory_recursively(InvalidOid, last_input_dir, opt.output,
@@ -395,6 +498,15 @@ main(int argc, char *argv[])
 									  manifests, mwriter, &opt);
 	}
 
+#ifdef CB_PARALLEL
+	/* Wait for the threads to process the remaining files. */
+	if (job_pool != NULL)
+	{
+		finish_job_pool(job_pool);
+		job_pool = NULL;
+	}
+#endif
+
 	/* Finalize the backup_manifest, if we're generating one. */
 	if (mwriter != NULL)
 		finalize_manifest(mwriter,
@@ -749,6 +861,7 @@ help(const char *progname)
 	printf(_("  %s [OPTION]... DIRECTORY...\n"), progname);
 	printf(_("\nOptions:\n"));
 	printf(_("  -d, --debug               generate lots of debugging output\n"));
+	printf(_("  -j, --jobs=NUM            use this many parallel jobs to write files\n"));
 	printf(_("  -n, --dry-run             do not actually do anything\n"));
 	printf(_("  -N, --no-sync             do not wait for changes to be written safely to disk\n"));
 	printf(_("  -o, --output              output directory\n"));
@@ -922,12 +1035,8 @@ process_directory_recursively(Oid tsoid,
 	{
 		PGFileType	type;
 		char		ifullpath[MAXPGPATH];
-		char		ofullpath[MAXPGPATH];
-		char		manifest_path[MAXPGPATH];
 		Oid			oid = InvalidOid;
-		int			checksum_length = 0;
-		uint8	   *checksum_payload = NULL;
-		pg_checksum_context checksum_ctx;
+		cb_file_job *job;
 
 		/* Ignore "." and ".." entries. */
 		if (strcmp(de->d_name, ".") == 0 ||
@@ -994,6 +1103,11 @@ process_directory_recursively(Oid tsoid,
 			 strcmp(de->d_name, "backup_manifest") == 0))
 			continue;
 
+		/* Describe the work to be done on this file. */
+		job = pg_malloc0(sizeof(cb_file_job));
+		job->checksum_type = checksum_type;
+		strlcpy(job->ifullpath, ifullpath, MAXPGPATH);
+
 		/*
 		 * If it's an incremental file, hand it off to the reconstruction
 		 * code, which will figure out what to do.
@@ -1002,35 +1116,24 @@ process_directory_recursively(Oid tsoid,
 			strncmp(de->d_name, INCREMENTAL_PREFIX,
 					INCREMENTAL_PREFIX_LENGTH) == 0)
 		{
+			job->incremental = true;
+
 			/* Output path should not include "INCREMENTAL." prefix. */
-			snprintf(ofullpath, MAXPGPATH, "%s/%s", ofulldir,
+			snprintf(job->ofullpath, MAXPGPATH, "%s/%s", ofulldir,
 					 de->d_name + INCREMENTAL_PREFIX_LENGTH);
-
+			job->bare_file_name = job->ofullpath + strlen(ofulldir) + 1;
 
 			/* Manifest path likewise omits incremental prefix. */
-			snprintf(manifest_path, MAXPGPATH, "%s%s", manifest_prefix,
+			snprintf(job->manifest_path, MAXPGPATH, "%s%s", manifest_prefix,
 					 de->d_name + INCREMENTAL_PREFIX_LENGTH);
-
-			/* Reconstruction logic will do the rest. */
-			reconstruct_from_incremental_file(ifullpath, ofullpath,
-											  manifest_prefix,
-											  de->d_name + INCREMENTAL_PREFIX_LENGTH,
-											  n_prior_backups,
-											  prior_backup_dirs,
-											  manifests,
-											  manifest_path,
-											  checksum_type,
-											  &checksum_length,
-											  &checksum_payload,
-											  opt->copy_method,
-											  opt->debug,
-											  opt->dry_run);
+			strlcpy(job->manifest_prefix, manifest_prefix, MAXPGPATH);
 		}
 		else
 		{
 			/* Construct the path that the backup_manifest will use. */
-			snprintf(manifest_path, MAXPGPATH, "%s%s", manifest_prefix,
+			snprintf(job->manifest_path, MAXPGPATH, "%s%s", manifest_prefix,
 					 de->d_name);
+			snprintf(job->ofullpath, MAXPGPATH, "%s/%s", ofulldir, de->d_name);
 
 			/*
 			 * It's not an incremental file, so we need to copy the entire
@@ -1046,7 +1149,7 @@ process_directory_recursively(Oid tsoid,
 				manifest_file *mfile;
 
 				mfile = manifest_files_lookup(latest_manifest->files,
-											  manifest_path);
+											  job->manifest_path);
 				if (mfile == NULL)
 				{
 					char	   *bmpath;
@@ -1058,78 +1161,256 @@ process_directory_recursively(Oid tsoid,
 					bmpath = psprintf("%s/%s", input_directory,
 									  "backup_manifest");
 					pg_log_warning("\"%s\" contains no entry for \"%s\"",
-								   bmpath, manifest_path);
+								   bmpath, job->manifest_path);
 					pfree(bmpath);
 				}
 				else if (mfile->checksum_type == checksum_type)
 				{
-					checksum_length = mfile->checksum_length;
-					checksum_payload = mfile->checksum_payload;
+					job->checksum_length = mfile->checksum_length;
+					job->checksum_payload = mfile->checksum_payload;
 				}
 			}
+		}
 
-			/*
-			 * If we're reusing a checksum, then we don't need copy_file() to
-			 * compute one for us, but otherwise, it needs to compute whatever
-			 * type of checksum we need.
-			 */
-			if (checksum_length != 0)
-				pg_checksum_init(&checksum_ctx, CHECKSUM_TYPE_NONE);
-			else
-				pg_checksum_init(&checksum_ctx, checksum_type);
+		/* Do the work now, or let a worker thread do it. */
+		if (job_pool != NULL)
+			submit_file_job(job_pool, job);
+		else
+		{
+			process_file(job, n_prior_backups, prior_backup_dirs, manifests,
+						 mwriter, opt);
+			pfree(job);
+		}
+	}
 
-			/* Actually copy the file. */
-			snprintf(ofullpath, MAXPGPATH, "%s/%s", ofulldir, de->d_name);
-			copy_file(ifullpath, ofullpath, &checksum_ctx,
-					  opt->copy_method, opt->dry_run);
+	closedir(dir);
+}
 
-			/*
-			 * If copy_file() performed a checksum calculation for us, then
-			 * save the results (except in dry-run mode, when there's no
-			 * point).
-			 */
-			if (checksum_ctx.type != CHECKSUM_TYPE_NONE && !opt->dry_run)
-			{
-				checksum_payload = pg_malloc(PG_CHECKSUM_MAX_LENGTH);
-				checksum_length = pg_checksum_final(&checksum_ctx,
-													checksum_payload);
-			}
-		}
+/*
+ * Reconstruct or copy one file, and add it to the manifest if needed.
+ */
+static void
+process_file(cb_file_job *job,
+			 int n_prior_backups,
+			 char **prior_backup_dirs,
+			 manifest_data **manifests,
+			 manifest_writer *mwriter,
+			 cb_options *opt)
+{
+	int			checksum_length = job->checksum_length;
+	uint8	   *checksum_payload = NULL;
+
+	if (job->incremental)
+	{
+		/* Reconstruction logic will do the rest. */
+		reconstruct_from_incremental_file(job->ifullpath, job->ofullpath,
+										  job->manifest_prefix,
+										  job->bare_file_name,
+										  n_prior_backups,
+										  prior_backup_dirs,
+										  manifests,
+										  job->manifest_path,
+										  job->checksum_type,
+										  &checksum_length,
+										  &checksum_payload,
+										  opt->copy_method,
+										  opt->debug,
+										  opt->dry_run);
+	}
+	else
+	{
+		pg_checksum_context checksum_ctx;
+
+		/*
+		 * If we're reusing a checksum, then we don't need copy_file() to
+		 * compute one for us, but otherwise, it needs to compute whatever
+		 * type of checksum we need.
+		 */
+		if (checksum_length != 0)
+			pg_checksum_init(&checksum_ctx, CHECKSUM_TYPE_NONE);
+		else
+			pg_checksum_init(&checksum_ctx, job->checksum_type);
+
+		/* Actually copy the file. */
+		copy_file(job->ifullpath, job->ofullpath, &checksum_ctx,
+				  opt->copy_method, opt->dry_run);
 
-		/* Generate manifest entry, if needed. */
-		if (mwriter != NULL)
+		/*
+		 * If copy_file() performed a checksum calculation for us, then save
+		 * the results (except in dry-run mode, when there's no point).
+		 */
+		if (checksum_ctx.type != CHECKSUM_TYPE_NONE && !opt->dry_run)
 		{
-			struct stat sb;
+			checksum_payload = pg_malloc(PG_CHECKSUM_MAX_LENGTH);
+			checksum_length = pg_checksum_final(&checksum_ctx,
+												checksum_payload);
+		}
+	}
 
-			/*
-			 * In order to generate a manifest entry, we need the file size
-			 * and mtime. We have no way to know the correct mtime except to
-			 * stat() the file, so just do that and get the size as well.
-			 *
-			 * If we didn't need the mtime here, we could try to obtain the
-			 * file size from the reconstruction or file copy process above,
-			 * although that is actually not convenient in all cases. If we
-			 * write the file ourselves then clearly we can keep a count of
-			 * bytes, but if we use something like CopyFile() then it's
-			 * trickier. Since we have to stat() anyway to get the mtime,
-			 * there's no point in worrying about it.
-			 */
-			if (stat(ofullpath, &sb) < 0)
-				pg_fatal("could not stat file \"%s\": %m", ofullpath);
-
-			/* OK, now do the work. */
-			add_file_to_manifest(mwriter, manifest_path,
-								 sb.st_size, sb.st_mtime,
-								 checksum_type, checksum_length,
-								 checksum_payload);
+	/* Generate manifest entry, if needed. */
+	if (mwriter != NULL)
+	{
+		struct stat sb;
+
+		/*
+		 * In order to generate a manifest entry, we need the file size and
+		 * mtime. We have no way to know the correct mtime except to stat()
+		 * the file, so just do that and get the size as well.
+		 *
+		 * If we didn't need the mtime here, we could try to obtain the file
+		 * size from the reconstruction or file copy process above, although
+		 * that is actually not convenient in all cases. If we write the file
+		 * ourselves then clearly we can keep a count of bytes, but if we use
+		 * something like CopyFile() then it's trickier. Since we have to
+		 * stat() anyway to get the mtime, there's no point in worrying about
+		 * it.
+		 */
+		if (stat(job->ofullpath, &sb) < 0)
+			pg_fatal("could not stat file \"%s\": %m", job->ofullpath);
+
+		/* OK, now do the work. */
+#ifdef CB_PARALLEL
+		if (job_pool != NULL)
+			pthread_mutex_lock(&job_pool->manifest_lock);
+#endif
+		add_file_to_manifest(mwriter, job->manifest_path,
+							 sb.st_size, sb.st_mtime,
+							 job->checksum_type, checksum_length,
+							 checksum_payload != NULL ? checksum_payload :
+							 job->checksum_payload);
+#ifdef CB_PARALLEL
+		if (job_pool != NULL)
+			pthread_mutex_unlock(&job_pool->manifest_lock);
+#endif
+	}
+
+	/*
+	 * Avoid leaking memory.  A checksum reused from the manifest is not ours
+	 * to free.
+	 */
+	if (checksum_payload != NULL)
+		pfree(checksum_payload);
+}
+
+#ifdef CB_PARALLEL
+/*
+ * Start nthreads threads to process files with process_file().
+ */
+static cb_job_pool *
+start_job_pool(int nthreads,
+			   int n_prior_backups,
+			   char **prior_backup_dirs,
+			   manifest_data **manifests,
+			   manifest_writer *mwriter,
+			   cb_options *opt)
+{
+	cb_job_pool *pool = pg_malloc0(sizeof(cb_job_pool));
+
+	pool->nthreads = nthreads;
+	pool->n_prior_backups = n_prior_backups;
+	pool->prior_backup_dirs = prior_backup_dirs;
+	pool->manifests = manifests;
+	pool->mwriter = mwriter;
+	pool->opt = opt;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->queue_cv, NULL);
+	pthread_mutex_init(&pool->manifest_lock, NULL);
+
+	pool->threads = pg_malloc(nthreads * sizeof(pthread_t));
+	for (int i = 0; i < nthreads; i++)
+	{
+		int			rc;
+
+		rc = pthread_create(&pool->threads[i], NULL, job_pool_thread, pool);
+		if (rc != 0)
+			pg_fatal("could not create thread: %s", strerror(rc));
+	}
+
+	return pool;
+}
+
+/*
+ * Main loop of a thread: process queued files until told to stop.
+ */
+static void *
+job_pool_thread(void *arg)
+{
+	cb_job_pool *pool = arg;
+
+	for (;;)
+	{
+		cb_file_job *job;
+
+		pthread_mutex_lock(&pool->lock);
+		while (pool->head == NULL && !pool->shutdown)
+			pthread_cond_wait(&pool->queue_cv, &pool->lock);
+		job = pool->head;
+		if (job != NULL)
+		{
+			pool->head = job->next;
+			if (pool->head == NULL)
+				pool->tail = NULL;
+			pool->nqueued--;
+			pthread_cond_broadcast(&pool->queue_cv);
 		}
+		pthread_mutex_unlock(&pool->lock);
 
-		/* Avoid leaking memory. */
-		if (checksum_payload != NULL)
-			pfree(checksum_payload);
+		/* Queue empty and no more work coming? */
+		if (job == NULL)
+			break;
+
+		process_file(job, pool->n_prior_backups, pool->prior_backup_dirs,
+					 pool->manifests, pool->mwriter, pool->opt);
+		pfree(job);
 	}
 
-	closedir(dir);
+	return NULL;
+}
+
+/*
+ * Wait until all queued files have been processed, and stop the threads.
+ */
+static void
+finish_job_pool(cb_job_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->queue_cv);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->queue_cv);
+	pthread_mutex_destroy(&pool->manifest_lock);
+	pfree(pool->threads);
+	pfree(pool);
+}
+#endif
+
+/*
+ * Queue a file for processing by the job pool, waiting if the queue is full.
+ */
+static void
+submit_file_job(cb_job_pool *pool, cb_file_job *job)
+{
+#ifdef CB_PARALLEL
+	pthread_mutex_lock(&pool->lock);
+	while (pool->nqueued >= 2 * pool->nthreads)
+		pthread_cond_wait(&pool->queue_cv, &pool->lock);
+	job->next = NULL;
+	if (pool->tail == NULL)
+		pool->head = job;
+	else
+		pool->tail->next = job;
+	pool->tail = job;
+	pool->nqueued++;
+	pthread_cond_broadcast(&pool->queue_cv);
+	pthread_mutex_unlock(&pool->lock);
+#else
+	pg_fatal("parallel jobs are not supported on this platform");
+#endif
 }
 
 /*
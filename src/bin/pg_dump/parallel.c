@@ -21,7 +21,9 @@
  *
  * The leader process dispatches an individual work item to one of the worker
  * processes in DispatchJobForTocEntry().  We send a command string such as
- * "DUMP 1234" or "RESTORE 1234", where 1234 is the TocEntry ID.
+ * "DUMP 1234" or "RESTORE 1234 0", where 1234 is the TocEntry ID and 0 is
+ * the number of server parallel workers the item may use (see
+ * TocEntry.parallelWorkers).
  * The worker process receives and decodes the command and passes it to the
  * routine pointed to by AH->WorkerJobDumpPtr or AH->WorkerJobRestorePtr,
  * which are routines of the current archive format.  That routine performs
@@ -1111,7 +1113,8 @@ buildWorkerCommand(ArchiveHandle *AH, TocEntry *te, T_Action act,
 	if (act == ACT_DUMP)
 		snprintf(buf, buflen, "DUMP %d", te->dumpId);
 	else if (act == ACT_RESTORE)
-		snprintf(buf, buflen, "RESTORE %d", te->dumpId);
+		snprintf(buf, buflen, "RESTORE %d %d", te->dumpId,
+				 te->parallelWorkers);
 	else
 		Assert(false);
 }
@@ -1124,6 +1127,7 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 				   const char *msg)
 {
 	DumpId		dumpId;
+	int			parallelWorkers;
 	int			nBytes;
 
 	if (messageStartsWith(msg, "DUMP "))
@@ -1137,10 +1141,11 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 	else if (messageStartsWith(msg, "RESTORE "))
 	{
 		*act = ACT_RESTORE;
-		sscanf(msg, "RESTORE %d%n", &dumpId, &nBytes);
+		sscanf(msg, "RESTORE %d %d%n", &dumpId, &parallelWorkers, &nBytes);
 		Assert(nBytes == strlen(msg));
 		*te = getTocEntryByDumpId(AH, dumpId);
 		Assert(*te != NULL);
+		(*te)->parallelWorkers = parallelWorkers;
 	}
 	else
 		pg_fatal("unrecognized command received from leader: \"%s\"",
@@ -1277,6 +1282,22 @@ IsEveryWorkerIdle(ParallelState *pstate)
 	return true;
 }
 
+/*
+ * Return the number of workers in the WRKR_IDLE state.
+ */
+int
+CountIdleWorkers(ParallelState *pstate)
+{
+	int			count = 0;
+
+	for (int i = 0; i < pstate->numWorkers; i++)
+	{
+		if (pstate->parallelSlot[i].workerStatus == WRKR_IDLE)
+			count++;
+	}
+	return count;
+}
+
 /*
  * Acquire lock on a table to be dumped by a worker process.
  *
@@ -172,6 +172,8 @@ typedef struct _dumpOptions
 	bool		aclsSkip;
 	const char *lockWaitTimeout;
 	int			dump_inserts;	/* 0 = COPY, otherwise rows per INSERT */
+	int			table_chunk_size;	/* 0 = don't split tables, otherwise
+									 * chunk size in megabytes */
 
 	/* flags for various command-line long options */
 	int			disable_dollar_quoting;
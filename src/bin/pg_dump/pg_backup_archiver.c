@@ -102,6 +102,8 @@ static int	TocEntrySizeCompareBinaryheap(void *p1, void *p2, void *arg);
 static void move_to_ready_heap(TocEntry *pending_list,
 							   binaryheap *ready_heap,
 							   RestorePass pass);
+static int	choose_parallel_workers(ArchiveHandle *AH, ParallelState *pstate,
+									TocEntry *te, binaryheap *ready_heap);
 static TocEntry *pop_next_work_item(binaryheap *ready_heap,
 									ParallelState *pstate);
 static void mark_dump_job_done(ArchiveHandle *AH,
@@ -1965,7 +1967,9 @@ buildTocEntryArrays(ArchiveHandle *AH)
 		 * tableDataId provides the TABLE DATA item's dump ID for each TABLE
 		 * TOC entry that has a DATA item.  We compute this by reversing the
 		 * TABLE DATA item's dependency, knowing that a TABLE DATA item has
-		 * just one dependency and it is the TABLE item.
+		 * just one dependency and it is the TABLE item.  If the table's data
+		 * was dumped in several chunks, the other TABLE DATA items are
+		 * chained from that one through nextDataChunk.
 		 */
 		if (strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
 		{
@@ -1979,6 +1983,7 @@ buildTocEntryArrays(ArchiveHandle *AH)
 			if (tableId <= 0 || tableId > maxDumpId)
 				pg_fatal("bad table dumpId for TABLE DATA item");
 
+			te->nextDataChunk = AH->tableDataId[tableId];
 			AH->tableDataId[tableId] = te->dumpId;
 		}
 	}
@@ -4313,6 +4318,9 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 						next_work_item->dumpId,
 						next_work_item->desc, next_work_item->tag);
 
+			next_work_item->parallelWorkers =
+				choose_parallel_workers(AH, pstate, next_work_item, ready_heap);
+
 			/* Dispatch to some worker */
 			DispatchJobForTocEntry(AH, pstate, next_work_item, ACT_RESTORE,
 								   mark_restore_job_done, ready_heap);
@@ -4523,6 +4531,38 @@ move_to_ready_heap(TocEntry *pending_list,
 	}
 }
 
+/*
+ * Decide how many server parallel workers an index build may use.
+ *
+ * Near the end of a restore there are often fewer ready items than idle
+ * jobs, and a few large index builds hold everything up.  Let such a build
+ * use the jobs that nothing else can use as parallel maintenance workers on
+ * the server, so that the total work in progress stays close to what -j
+ * asked for.  Returns 0 to leave the server's setting alone.
+ */
+static int
+choose_parallel_workers(ArchiveHandle *AH, ParallelState *pstate,
+						TocEntry *te, binaryheap *ready_heap)
+{
+	int			spare;
+
+	/* Parallel index builds exist since v11 */
+	if (AH->public.remoteVersion < 110000)
+		return 0;
+
+	/* Only items that build an index can use them */
+	if (strcmp(te->desc, "INDEX") != 0 &&
+		strcmp(te->desc, "CONSTRAINT") != 0)
+		return 0;
+
+	/* Jobs left idle after this item and every other ready item started */
+	spare = CountIdleWorkers(pstate) - 1 - binaryheap_size(ready_heap);
+	if (spare <= 0)
+		return 0;
+
+	return spare;
+}
+
 /*
  * Find the next work item (if any) that is capable of being run now,
  * and remove it from the ready_heap.
@@ -4601,9 +4641,23 @@ parallel_restore(ArchiveHandle *AH, TocEntry *te)
 	/* Count only errors associated with this TOC entry */
 	AH->public.n_errors = 0;
 
+	/* Let an index build use the parallel workers the leader granted it */
+	if (te->parallelWorkers > 0)
+	{
+		char		buf[64];
+
+		snprintf(buf, sizeof(buf),
+				 "SET max_parallel_maintenance_workers = %d",
+				 te->parallelWorkers);
+		ExecuteSqlStatement(&AH->public, buf);
+	}
+
 	/* Restore the TOC item */
 	status = restore_toc_entry(AH, te, true);
 
+	if (te->parallelWorkers > 0)
+		ExecuteSqlStatement(&AH->public, "RESET max_parallel_maintenance_workers");
+
 	return status;
 }
 
@@ -4790,13 +4844,15 @@ repoint_table_dependencies(ArchiveHandle *AH)
 {
 	TocEntry   *te;
 	int			i;
+	int			nOrigDeps;
 	DumpId		olddep;
 
 	for (te = AH->toc->next; te != AH->toc; te = te->next)
 	{
 		if (te->section != SECTION_POST_DATA)
 			continue;
-		for (i = 0; i < te->nDeps; i++)
+		nOrigDeps = te->nDeps;
+		for (i = 0; i < nOrigDeps; i++)
 		{
 			olddep = te->dependencies[i];
 			if (olddep <= AH->maxDumpId &&
@@ -4804,11 +4860,29 @@ repoint_table_dependencies(ArchiveHandle *AH)
 			{
 				DumpId		tabledataid = AH->tableDataId[olddep];
 				TocEntry   *tabledatate = AH->tocsByDumpId[tabledataid];
+				pgoff_t		tabledatalen = 0;
 
 				te->dependencies[i] = tabledataid;
-				te->dataLength = Max(te->dataLength, tabledatate->dataLength);
 				pg_log_debug("transferring dependency %d -> %d to %d",
 							 te->dumpId, olddep, tabledataid);
+
+				/* If the data is in chunks, depend on all of them */
+				for (;;)
+				{
+					tabledatalen += tabledatate->dataLength;
+					tabledataid = tabledatate->nextDataChunk;
+					if (tabledataid == 0)
+						break;
+					tabledatate = AH->tocsByDumpId[tabledataid];
+
+					te->dependencies = pg_realloc_array(te->dependencies,
+														DumpId, te->nDeps + 1);
+					te->dependencies[te->nDeps++] = tabledataid;
+					pg_log_debug("transferring dependency %d -> %d to %d",
+								 te->dumpId, olddep, tabledataid);
+				}
+
+				te->dataLength = Max(te->dataLength, tabledatalen);
 			}
 		}
 	}
@@ -4922,6 +4996,9 @@ reduce_dependencies(ArchiveHandle *AH, TocEntry *te,
 /*
  * Set the created flag on the DATA member corresponding to the given
  * TABLE member
+ *
+ * The flag lets the data be loaded after a TRUNCATE, so it is not set if the
+ * data was dumped in chunks: each chunk would wipe out the ones before it.
  */
 static void
 mark_create_done(ArchiveHandle *AH, TocEntry *te)
@@ -4930,12 +5007,13 @@ mark_create_done(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->created = true;
+		if (ted->nextDataChunk == 0)
+			ted->created = true;
 	}
 }
 
 /*
- * Mark the DATA member corresponding to the given TABLE member
+ * Mark the DATA member(s) corresponding to the given TABLE member
  * as not wanted
  */
 static void
@@ -4944,11 +5022,12 @@ inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 	pg_log_info("table \"%s\" could not be created, will not restore its data",
 				te->tag);
 
-	if (AH->tableDataId[te->dumpId] != 0)
+	for (DumpId id = AH->tableDataId[te->dumpId]; id != 0;)
 	{
-		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
+		TocEntry   *ted = AH->tocsByDumpId[id];
 
 		ted->reqs = 0;
+		id = ted->nextDataChunk;
 	}
 }
 
@@ -372,6 +372,8 @@ struct _tocEntry
 	int			reqs;			/* do we need schema and/or data of object
 								 * (REQ_* bit mask) */
 	bool		created;		/* set for DATA member if TABLE was created */
+	DumpId		nextDataChunk;	/* next DATA member of the same TABLE, if its
+								 * data was dumped in chunks; else 0 */
 
 	/* working state (needed only for parallel restore) */
 	struct _tocEntry *pending_prev; /* list links for pending-items list; */
@@ -381,6 +383,8 @@ struct _tocEntry
 	int			nRevDeps;		/* number of such dependencies */
 	DumpId	   *lockDeps;		/* dumpIds of objects this one needs lock on */
 	int			nLockDeps;		/* number of such dependencies */
+	int			parallelWorkers;	/* if > 0, max_parallel_maintenance_workers
+									 * to use while restoring the item */
 };
 
 extern int	parallel_restore(ArchiveHandle *AH, TocEntry *te);
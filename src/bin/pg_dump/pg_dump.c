@@ -203,6 +203,11 @@ static void prohibit_crossdb_refs(PGconn *conn, const char *dbname,
 
 static NamespaceInfo *findNamespace(Oid nsoid);
 static void dumpTableData(Archive *fout, const TableDataInfo *tdinfo);
+static BlockNumber tableDataChunkPages(Archive *fout,
+									   const TableDataInfo *tdinfo);
+static void dumpTableDataChunks(Archive *fout, const TableDataInfo *tdinfo,
+								const char *tdDefn, const char *copyStmt,
+								DataDumperPtr dumpFn);
 static void refreshMatViewData(Archive *fout, const TableDataInfo *tdinfo);
 static const char *getRoleName(const char *roleoid_str);
 static void collectRoleNames(Archive *fout);
@@ -448,6 +453,7 @@ main(int argc, char **argv)
 		{"sync-method", required_argument, NULL, 15},
 		{"filter", required_argument, NULL, 16},
 		{"exclude-extension", required_argument, NULL, 17},
+		{"table-chunk-size", required_argument, NULL, 18},
 
 		{NULL, 0, NULL, 0}
 	};
@@ -688,6 +694,12 @@ main(int argc, char **argv)
 										  optarg);
 				break;
 
+			case 18:			/* split large tables into chunks */
+				if (!option_parse_int(optarg, "--table-chunk-size", 1,
+									  INT_MAX / 1024, &dopt.table_chunk_size))
+					exit_nicely(1);
+				break;
+
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -1166,6 +1178,8 @@ help(const char *progname)
 			 "                               match at least one entity each\n"));
 	printf(_("  --table-and-children=PATTERN dump only the specified table(s), including\n"
 			 "                               child and partition tables\n"));
+	printf(_("  --table-chunk-size=SIZE      dump data of tables larger than SIZE megabytes\n"
+			 "                               in separate chunks of that size\n"));
 	printf(_("  --use-set-session-authorization\n"
 			 "                               use SET SESSION AUTHORIZATION commands instead of\n"
 			 "                               ALTER OWNER commands to set ownership\n"));
@@ -2156,10 +2170,26 @@ dumpTableData_copy(Archive *fout, const void *dcontext)
 
 	/*
 	 * Use COPY (SELECT ...) TO when dumping a foreign table's data, and when
-	 * a filter condition was specified.  For other cases a simple COPY
-	 * suffices.
+	 * a filter condition was specified or we're dumping a chunk of the
+	 * table.  For other cases a simple COPY suffices.
 	 */
-	if (tdinfo->filtercond || tbinfo->relkind == RELKIND_FOREIGN_TABLE)
+	if (tdinfo->chunkcond)
+	{
+		appendPQExpBufferStr(q, "COPY (SELECT ");
+		/* klugery to get rid of parens in column list */
+		if (strlen(column_list) > 2)
+		{
+			appendPQExpBufferStr(q, column_list + 1);
+			q->data[q->len - 1] = ' ';
+		}
+		else
+			appendPQExpBufferStr(q, "* ");
+
+		appendPQExpBuffer(q, "FROM ONLY %s %s) TO stdout;",
+						  fmtQualifiedDumpable(tbinfo),
+						  tdinfo->chunkcond);
+	}
+	else if (tdinfo->filtercond || tbinfo->relkind == RELKIND_FOREIGN_TABLE)
 	{
 		appendPQExpBufferStr(q, "COPY (SELECT ");
 		/* klugery to get rid of parens in column list */
@@ -2330,6 +2360,8 @@ dumpTableData_insert(Archive *fout, const void *dcontext)
 					  fmtQualifiedDumpable(tbinfo));
 	if (tdinfo->filtercond)
 		appendPQExpBuffer(q, " %s", tdinfo->filtercond);
+	else if (tdinfo->chunkcond)
+		appendPQExpBuffer(q, " %s", tdinfo->chunkcond);
 
 	ExecuteSqlStatement(fout, q->data);
 
@@ -2656,7 +2688,11 @@ dumpTableData(Archive *fout, const TableDataInfo *tdinfo)
 	 * dependency on its table as "special" and pass it to ArchiveEntry now.
 	 * See comments for BuildArchiveDependencies.
 	 */
-	if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
+	if (!(tdinfo->dobj.dump & DUMP_COMPONENT_DATA))
+		;
+	else if (tableDataChunkPages(fout, tdinfo) > 0)
+		dumpTableDataChunks(fout, tdinfo, tdDefn, copyStmt, dumpFn);
+	else
 	{
 		TocEntry   *te;
 
@@ -2702,6 +2738,112 @@ dumpTableData(Archive *fout, const TableDataInfo *tdinfo)
 	destroyPQExpBuffer(clistBuf);
 }
 
+/*
+ * tableDataChunkPages -
+ *	  decide whether to dump a table's data in chunks
+ *
+ * Returns the number of pages per chunk, or 0 if the data is to be dumped
+ * in one piece.  Chunks are selected by ctid ranges, which can be scanned
+ * efficiently only since v14.
+ */
+static BlockNumber
+tableDataChunkPages(Archive *fout, const TableDataInfo *tdinfo)
+{
+	static int	block_size = 0;
+	TableInfo  *tbinfo = tdinfo->tdtable;
+	BlockNumber chunk_pages;
+
+	if (fout->dopt->table_chunk_size == 0 ||
+		fout->remoteVersion < 140000 ||
+		tbinfo->relkind != RELKIND_RELATION ||
+		tdinfo->filtercond != NULL)
+		return 0;
+
+	/* relpages counts the server's blocks, whose size we must ask for */
+	if (block_size == 0)
+	{
+		PGresult   *res;
+
+		res = ExecuteSqlQueryForSingleRow(fout,
+										  "SELECT pg_catalog.current_setting('block_size')");
+		block_size = atoi(PQgetvalue(res, 0, 0));
+		PQclear(res);
+		if (block_size <= 0)
+			pg_fatal("invalid block size reported by server");
+	}
+
+	chunk_pages = (BlockNumber) ((uint64) fout->dopt->table_chunk_size *
+								 1024 * 1024 / block_size);
+	if (chunk_pages == 0 || (BlockNumber) tbinfo->relpages <= chunk_pages)
+		return 0;
+
+	return chunk_pages;
+}
+
+/*
+ * dumpTableDataChunks -
+ *	  make one TABLE DATA entry per chunk of a large table
+ *
+ * Each chunk covers a range of the table's pages, so that parallel dump and
+ * parallel restore can process the chunks concurrently.  The first chunk
+ * uses the dump ID of the TableDataInfo; the others get new ones.  The last
+ * chunk has no upper bound, in case the table grew since relpages was set.
+ */
+static void
+dumpTableDataChunks(Archive *fout, const TableDataInfo *tdinfo,
+					const char *tdDefn, const char *copyStmt,
+					DataDumperPtr dumpFn)
+{
+	TableInfo  *tbinfo = tdinfo->tdtable;
+	BlockNumber relpages = (BlockNumber) tbinfo->relpages;
+	BlockNumber chunk_pages = tableDataChunkPages(fout, tdinfo);
+	BlockNumber nchunks = (relpages + chunk_pages - 1) / chunk_pages;
+
+	for (BlockNumber i = 0; i < nchunks; i++)
+	{
+		TableDataInfo *chunk;
+		PQExpBuffer cond = createPQExpBuffer();
+		TocEntry   *te;
+
+		chunk = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+		memcpy(chunk, tdinfo, sizeof(TableDataInfo));
+		if (i > 0)
+			chunk->dobj.dumpId = createDumpId();
+
+		if (i == 0)
+			appendPQExpBuffer(cond, "WHERE ctid < '(%u,0)'::pg_catalog.tid",
+							  chunk_pages);
+		else if (i == nchunks - 1)
+			appendPQExpBuffer(cond, "WHERE ctid >= '(%u,0)'::pg_catalog.tid",
+							  i * chunk_pages);
+		else
+			appendPQExpBuffer(cond,
+							  "WHERE ctid >= '(%u,0)'::pg_catalog.tid AND ctid < '(%u,0)'::pg_catalog.tid",
+							  i * chunk_pages, (i + 1) * chunk_pages);
+		chunk->chunkcond = cond->data;
+		/* the buffer's data now belongs to the chunk */
+		free(cond);
+
+		te = ArchiveEntry(fout, chunk->dobj.catId, chunk->dobj.dumpId,
+						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+									   .namespace = tbinfo->dobj.namespace->dobj.name,
+									   .owner = tbinfo->rolname,
+									   .description = "TABLE DATA",
+									   .section = SECTION_DATA,
+									   .createStmt = tdDefn,
+									   .copyStmt = copyStmt,
+									   .deps = &(tbinfo->dobj.dumpId),
+									   .nDeps = 1,
+									   .dumpFn = dumpFn,
+									   .dumpArg = chunk));
+
+		/* Measure dataLength in pages, as dumpTableData does */
+		te->dataLength = (i == nchunks - 1) ?
+			relpages - i * chunk_pages : chunk_pages;
+		te->dataLength += (BlockNumber) tbinfo->toastpages / nchunks;
+	}
+}
+
 /*
  * refreshMatViewData -
  *	  load or refresh the contents of a single materialized view
@@ -2819,6 +2961,7 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo)
 	tdinfo->dobj.namespace = tbinfo->dobj.namespace;
 	tdinfo->tdtable = tbinfo;
 	tdinfo->filtercond = NULL;	/* might get set later */
+	tdinfo->chunkcond = NULL;
 	addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
 
 	/* A TableDataInfo contains data, of course */
@@ -16411,6 +16554,9 @@ dumpTableSchema(Archive *fout, const TableInfo *tbinfo)
 					case 'l':
 						cmname = "lz4";
 						break;
+					case 'z':
+						cmname = "zstd";
+						break;
 					default:
 						cmname = NULL;
 						break;
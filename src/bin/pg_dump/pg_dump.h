@@ -384,6 +384,8 @@ typedef struct _tableDataInfo
 	DumpableObject dobj;
 	TableInfo  *tdtable;		/* link to table to dump */
 	char	   *filtercond;		/* WHERE condition to limit rows dumped */
+	char	   *chunkcond;		/* WHERE condition selecting a ctid range, if
+								 * this is one chunk of the table's data */
 } TableDataInfo;
 
 typedef struct _indxInfo
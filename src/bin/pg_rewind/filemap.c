@@ -114,6 +114,9 @@ static const char *const excludeDirContents[] =
 	/* Contents removed on startup, see DeleteAllExportedSnapshotFiles(). */
 	"pg_snapshots",
 
+	/* Contents removed on startup, see RemoveJitCacheFiles(). */
+	"pg_jitcache",				/* defined as PG_JIT_CACHE_DIR */
+
 	/* Contents zeroed on startup, see StartupSUBTRANS(). */
 	"pg_subtrans",
 
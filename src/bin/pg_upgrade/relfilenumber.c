@@ -15,7 +15,8 @@
 #include "catalog/pg_class_d.h"
 #include "pg_upgrade.h"
 
-static void transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace);
+static void transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace,
+								   int slice, int nslices, int *relnum);
 static void transfer_relfile(FileNameMap *map, const char *type_suffix, bool vm_must_add_frozenbit);
 
 
@@ -51,24 +52,33 @@ transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 	 * NULL tablespace path, which matches all tablespaces.  In parallel mode,
 	 * we pass the default tablespace and all user-created tablespaces and let
 	 * those operations happen in parallel.
+	 *
+	 * Most clusters keep nearly everything in one tablespace, so we also
+	 * split the relations of each tablespace into one slice per job, each
+	 * slice taking every jobs'th relation in turn.
 	 */
 	if (user_opts.jobs <= 1)
 		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, NULL);
+									  new_pgdata, NULL, 0, 1);
 	else
 	{
 		int			tblnum;
+		int			slice;
 
 		/* transfer default tablespace */
-		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, old_pgdata);
+		for (slice = 0; slice < user_opts.jobs; slice++)
+			parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
+										  new_pgdata, old_pgdata,
+										  slice, user_opts.jobs);
 
 		for (tblnum = 0; tblnum < os_info.num_old_tablespaces; tblnum++)
-			parallel_transfer_all_new_dbs(old_db_arr,
-										  new_db_arr,
-										  old_pgdata,
-										  new_pgdata,
-										  os_info.old_tablespaces[tblnum]);
+			for (slice = 0; slice < user_opts.jobs; slice++)
+				parallel_transfer_all_new_dbs(old_db_arr,
+											  new_db_arr,
+											  old_pgdata,
+											  new_pgdata,
+											  os_info.old_tablespaces[tblnum],
+											  slice, user_opts.jobs);
 		/* reap all children */
 		while (reap_child(true) == true)
 			;
@@ -84,13 +94,18 @@ transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
  *
  * Responsible for upgrading all database. invokes routines to generate mappings and then
  * physically link the databases.
+ *
+ * Only the relations of old_tablespace (all tablespaces if NULL) are
+ * transferred, and of those only slice number "slice" out of "nslices".
  */
 void
 transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-					 char *old_pgdata, char *new_pgdata, char *old_tablespace)
+					 char *old_pgdata, char *new_pgdata, char *old_tablespace,
+					 int slice, int nslices)
 {
 	int			old_dbnum,
 				new_dbnum;
+	int			relnum = 0;
 
 	/* Scan the old cluster databases and transfer their files */
 	for (old_dbnum = new_dbnum = 0;
@@ -122,7 +137,8 @@ transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 									new_pgdata);
 		if (n_maps)
 		{
-			transfer_single_new_db(mappings, n_maps, old_tablespace);
+			transfer_single_new_db(mappings, n_maps, old_tablespace,
+								   slice, nslices, &relnum);
 		}
 		/* We allocate something even for n_maps == 0 */
 		pg_free(mappings);
@@ -133,9 +149,13 @@ transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
  * transfer_single_new_db()
  *
  * create links for mappings stored in "maps" array.
+ *
+ * *relnum counts the relations of old_tablespace seen so far, across
+ * databases; those whose number modulo nslices is slice are ours.
  */
 static void
-transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
+transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace,
+					   int slice, int nslices, int *relnum)
 {
 	int			mapnum;
 	bool		vm_must_add_frozenbit = false;
@@ -152,6 +172,9 @@ transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
 		if (old_tablespace == NULL ||
 			strcmp(maps[mapnum].old_tablespace, old_tablespace) == 0)
 		{
+			if ((*relnum)++ % nslices != slice)
+				continue;
+
 			/* transfer primary file */
 			transfer_relfile(&maps[mapnum], "", vm_must_add_frozenbit);
 
@@ -15,13 +15,20 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 #include <time.h>
 
 #include "common/controldata_utils.h"
 #include "common/hashfn_unstable.h"
+#include "common/int.h"
 #include "common/logging.h"
 #include "common/parse_manifest.h"
+#include "fe_utils/option_utils.h"
 #include "fe_utils/simple_list.h"
 #include "getopt_long.h"
 #include "pgtime.h"
@@ -45,6 +52,13 @@
  */
 #define READ_CHUNK_SIZE				(128 * 1024)
 
+/*
+ * How many bytes should we try to read at once from a file whose checksum
+ * we are verifying?  Checksum verification reads whole files sequentially,
+ * so larger reads mean fewer system calls and better readahead.
+ */
+#define CHECKSUM_READ_CHUNK_SIZE	(1024 * 1024)
+
 /*
  * Each file described by the manifest file is parsed to produce an object
  * like this.
@@ -143,6 +157,11 @@ static void verify_control_file(const char *controlpath,
 								uint64 manifest_system_identifier);
 static void report_extra_backup_files(verifier_context *context);
 static void verify_backup_checksums(verifier_context *context);
+#ifndef WIN32
+static void verify_backup_checksums_parallel(verifier_context *context,
+											 manifest_file **files,
+											 int nfiles);
+#endif
 static void verify_file_checksum(verifier_context *context,
 								 manifest_file *m, char *fullpath,
 								 uint8 *buffer);
@@ -165,6 +184,10 @@ static const char *progname;
 /* options */
 static bool show_progress = false;
 static bool skip_checksums = false;
+static int	num_jobs = 1;
+
+/* In a --jobs worker, the pipe to report progress to the parent through */
+static int	progress_pipe = -1;
 
 /* Progress indicators */
 static uint64 total_size = 0;
@@ -179,6 +202,7 @@ main(int argc, char **argv)
 	static struct option long_options[] = {
 		{"exit-on-error", no_argument, NULL, 'e'},
 		{"ignore", required_argument, NULL, 'i'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"manifest-path", required_argument, NULL, 'm'},
 		{"no-parse-wal", no_argument, NULL, 'n'},
 		{"progress", no_argument, NULL, 'P'},
@@ -237,7 +261,7 @@ main(int argc, char **argv)
 	simple_string_list_append(&context.ignore_list, "recovery.signal");
 	simple_string_list_append(&context.ignore_list, "standby.signal");
 
-	while ((c = getopt_long(argc, argv, "ei:m:nPqsw:", long_options, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "ei:j:m:nPqsw:", long_options, NULL)) != -1)
 	{
 		switch (c)
 		{
@@ -252,6 +276,11 @@ main(int argc, char **argv)
 					simple_string_list_append(&context.ignore_list, arg);
 					break;
 				}
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &num_jobs))
+					exit(1);
+				break;
 			case 'm':
 				manifest_path = pstrdup(optarg);
 				canonicalize_path(manifest_path);
@@ -303,6 +332,12 @@ main(int argc, char **argv)
 		pg_fatal("cannot specify both %s and %s",
 				 "-P/--progress", "-q/--quiet");
 
+#ifdef WIN32
+	if (num_jobs > 1)
+		pg_fatal("option %s is not supported on this platform",
+				 "-j/--jobs");
+#endif
+
 	/* Unless --no-parse-wal was specified, we will need pg_waldump. */
 	if (!no_parse_wal)
 	{
@@ -817,7 +852,31 @@ verify_backup_checksums(verifier_context *context)
 
 	progress_report(false);
 
-	buffer = pg_malloc(READ_CHUNK_SIZE * sizeof(uint8));
+#ifndef WIN32
+	if (num_jobs > 1)
+	{
+		manifest_file **files;
+		int			nfiles = 0;
+
+		files = pg_malloc_array(manifest_file *, manifest->files->members);
+
+		manifest_files_start_iterate(manifest->files, &it);
+		while ((m = manifest_files_iterate(manifest->files, &it)) != NULL)
+		{
+			if (should_verify_checksum(m) &&
+				!should_ignore_relpath(context, m->pathname))
+				files[nfiles++] = m;
+		}
+
+		verify_backup_checksums_parallel(context, files, nfiles);
+
+		pg_free(files);
+		progress_report(true);
+		return;
+	}
+#endif
+
+	buffer = pg_malloc(CHECKSUM_READ_CHUNK_SIZE * sizeof(uint8));
 
 	manifest_files_start_iterate(manifest->files, &it);
 	while ((m = manifest_files_iterate(manifest->files, &it)) != NULL)
@@ -844,6 +903,221 @@ verify_backup_checksums(verifier_context *context)
 	progress_report(true);
 }
 
+#ifndef WIN32
+
+/*
+ * qsort comparator to put the largest manifest files first.
+ */
+static int
+compare_file_size_desc(const void *a, const void *b)
+{
+	const manifest_file *fa = *(manifest_file *const *) a;
+	const manifest_file *fb = *(manifest_file *const *) b;
+
+	return pg_cmp_size(fb->size, fa->size);
+}
+
+/*
+ * Send SIGTERM to all --jobs workers that have not been waited for yet.
+ */
+static void
+terminate_checksum_workers(pid_t *pids, int nworkers)
+{
+	for (int i = 0; i < nworkers; i++)
+	{
+		if (pids[i] != 0)
+			kill(pids[i], SIGTERM);
+	}
+}
+
+/*
+ * Collect the exit status of --jobs workers that have exited, or of all of
+ * them if "wait" is true.
+ *
+ * A worker exits with status 1 if it reported a problem with the backup.
+ * That makes us exit too if --exit-on-error was given; any other failure of
+ * a worker is fatal.
+ */
+static void
+reap_checksum_workers(verifier_context *context, pid_t *pids, int nworkers,
+					  bool wait)
+{
+	for (int i = 0; i < nworkers; i++)
+	{
+		int			status;
+		pid_t		rc;
+
+		if (pids[i] == 0)
+			continue;
+
+		rc = waitpid(pids[i], &status, wait ? 0 : WNOHANG);
+		if (rc == 0)
+			continue;
+		if (rc < 0)
+			report_fatal_error("could not wait for worker process: %m");
+		pids[i] = 0;
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 1)
+		{
+			context->saw_any_error = true;
+			if (context->exit_on_error)
+			{
+				terminate_checksum_workers(pids, nworkers);
+				exit(1);
+			}
+		}
+		else if (status != 0)
+		{
+			terminate_checksum_workers(pids, nworkers);
+			report_fatal_error("worker process failed: %s",
+							   wait_result_to_str(status));
+		}
+	}
+}
+
+/*
+ * Verify the checksums of the given files using num_jobs worker processes.
+ *
+ * The files are dealt out largest first, each to the worker with the fewest
+ * bytes to read so far, so that the workers finish at about the same time.
+ * Workers report problems themselves and tell us through their exit status
+ * whether they found any.  They also send us the number of bytes read after
+ * each chunk through a shared pipe, which drives the progress report and
+ * lets us notice promptly when a worker exits early.
+ */
+static void
+verify_backup_checksums_parallel(verifier_context *context,
+								 manifest_file **files, int nfiles)
+{
+	int			nworkers = Min(num_jobs, nfiles);
+	int		   *owner;
+	uint64	   *load;
+	pid_t	   *pids;
+	int			pipefd[2];
+
+	if (nfiles == 0)
+		return;
+
+	qsort(files, nfiles, sizeof(manifest_file *), compare_file_size_desc);
+
+	owner = pg_malloc_array(int, nfiles);
+	load = pg_malloc0_array(uint64, nworkers);
+	for (int i = 0; i < nfiles; i++)
+	{
+		int			best = 0;
+
+		for (int w = 1; w < nworkers; w++)
+		{
+			if (load[w] < load[best])
+				best = w;
+		}
+		owner[i] = best;
+		load[best] += files[i]->size;
+	}
+
+	if (pipe(pipefd) < 0)
+		report_fatal_error("could not create pipe: %m");
+
+	pids = pg_malloc_array(pid_t, nworkers);
+
+	/* flush stdio channels before fork, to avoid double output */
+	fflush(NULL);
+
+	for (int w = 0; w < nworkers; w++)
+	{
+		pids[w] = fork();
+		if (pids[w] < 0)
+		{
+			terminate_checksum_workers(pids, w);
+			report_fatal_error("could not fork worker process: %m");
+		}
+
+		if (pids[w] == 0)
+		{
+			uint8	   *buffer;
+
+			close(pipefd[0]);
+			progress_pipe = pipefd[1];
+			context->saw_any_error = false;
+
+			buffer = pg_malloc(CHECKSUM_READ_CHUNK_SIZE * sizeof(uint8));
+
+			for (int i = 0; i < nfiles; i++)
+			{
+				char	   *fullpath;
+
+				if (owner[i] != w)
+					continue;
+
+				fullpath = psprintf("%s/%s", context->backup_directory,
+									files[i]->pathname);
+				verify_file_checksum(context, files[i], fullpath, buffer);
+				pfree(fullpath);
+			}
+
+			exit(context->saw_any_error ? 1 : 0);
+		}
+	}
+	close(pipefd[1]);
+
+	/* Read progress messages until every worker has closed the pipe. */
+	for (;;)
+	{
+		uint64		nbytes;
+		char	   *ptr = (char *) &nbytes;
+		size_t		left = sizeof(nbytes);
+
+		while (left > 0)
+		{
+			ssize_t		rc = read(pipefd[0], ptr, left);
+
+			if (rc < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				report_fatal_error("could not read from pipe: %m");
+			}
+			if (rc == 0)
+				break;
+			ptr += rc;
+			left -= rc;
+		}
+		if (left > 0)
+			break;
+
+		done_size += nbytes;
+		progress_report(false);
+
+		reap_checksum_workers(context, pids, nworkers, false);
+	}
+	close(pipefd[0]);
+
+	reap_checksum_workers(context, pids, nworkers, true);
+
+	pg_free(pids);
+	pg_free(load);
+	pg_free(owner);
+}
+
+#endif							/* !WIN32 */
+
+/*
+ * Tell the parent process how many more bytes a --jobs worker has read.
+ */
+static void
+report_worker_progress(uint64 nbytes)
+{
+	ssize_t		rc;
+
+	do
+	{
+		rc = write(progress_pipe, &nbytes, sizeof(nbytes));
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc != sizeof(nbytes))
+		report_fatal_error("could not write to pipe: %m");
+}
+
 /*
  * Verify the checksum of a single file.
  */
@@ -877,7 +1151,7 @@ verify_file_checksum(verifier_context *context, manifest_file *m,
 	}
 
 	/* Read the file chunk by chunk, updating the checksum as we go. */
-	while ((rc = read(fd, buffer, READ_CHUNK_SIZE)) > 0)
+	while ((rc = read(fd, buffer, CHECKSUM_READ_CHUNK_SIZE)) > 0)
 	{
 		bytes_read += rc;
 		if (pg_checksum_update(&checksum_ctx, buffer, rc) < 0)
@@ -889,8 +1163,13 @@ verify_file_checksum(verifier_context *context, manifest_file *m,
 		}
 
 		/* Report progress */
-		done_size += rc;
-		progress_report(false);
+		if (progress_pipe >= 0)
+			report_worker_progress(rc);
+		else
+		{
+			done_size += rc;
+			progress_report(false);
+		}
 	}
 	if (rc < 0)
 		report_backup_error(context, "could not read file \"%s\": %m",
@@ -1091,6 +1370,7 @@ usage(void)
 	printf(_("Options:\n"));
 	printf(_("  -e, --exit-on-error         exit immediately on error\n"));
 	printf(_("  -i, --ignore=RELATIVE_PATH  ignore indicated path\n"));
+	printf(_("  -j, --jobs=NUM              use this many processes to verify checksums\n"));
 	printf(_("  -m, --manifest-path=PATH    use specified path for manifest\n"));
 	printf(_("  -n, --no-parse-wal          do not try to parse WAL files\n"));
 	printf(_("  -P, --progress              show progress information\n"));
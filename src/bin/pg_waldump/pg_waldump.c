@@ -16,6 +16,9 @@
 #include <limits.h>
 #include <signal.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "access/transam.h"
@@ -78,8 +81,21 @@ typedef struct XLogDumpConfig
 
 	/* save options */
 	char	   *save_fullpage_path;
+
+	/* number of processes to compute statistics with */
+	int			jobs;
 } XLogDumpConfig;
 
+/*
+ * What a --jobs worker process sends back to the parent through a pipe.
+ */
+typedef struct XLogDumpWorkerResult
+{
+	XLogStats	stats;
+	bool		failed;			/* did it stop at an invalid record? */
+	char		errormsg[1024]; /* if so, the error to report */
+} XLogDumpWorkerResult;
+
 
 /*
  * When sigint is called, just tell the system to exit at the next possible
@@ -752,6 +768,245 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 		   total_len, "[100%]");
 }
 
+/*
+ * Does the record pass all the filters specified?
+ */
+static bool
+XLogDumpRecordMatchesFilters(XLogDumpConfig *config, XLogReaderState *record)
+{
+	if (config->filter_by_rmgr_enabled &&
+		!config->filter_by_rmgr[XLogRecGetRmid(record)])
+		return false;
+
+	if (config->filter_by_xid_enabled &&
+		config->filter_by_xid != XLogRecGetXid(record))
+		return false;
+
+	/* check for extended filtering */
+	if (config->filter_by_extended &&
+		!XLogRecordMatchesRelationBlock(record,
+										config->filter_by_relation_enabled ?
+										config->filter_by_relation :
+										emptyRelFileLocator,
+										config->filter_by_relation_block_enabled ?
+										config->filter_by_relation_block :
+										InvalidBlockNumber,
+										config->filter_by_relation_forknum))
+		return false;
+
+	if (config->filter_by_fpw && !XLogRecordHasFPW(record))
+		return false;
+
+	return true;
+}
+
+#ifndef WIN32
+
+/*
+ * Body of a --jobs worker process: collect statistics on the records that
+ * start between private->startptr and stopptr.  The last of these records
+ * may end beyond stopptr; reading is bounded by private->endptr only.
+ */
+static void
+XLogDumpWorkerStats(XLogDumpConfig *config, XLogDumpPrivate *private,
+					const char *waldir, XLogRecPtr stopptr,
+					XLogDumpWorkerResult *result)
+{
+	XLogReaderState *xlogreader_state;
+	XLogRecPtr	first_record;
+	char	   *errormsg;
+
+	memset(result, 0, sizeof(XLogDumpWorkerResult));
+	result->stats.startptr = InvalidXLogRecPtr;
+	result->stats.endptr = InvalidXLogRecPtr;
+
+	xlogreader_state =
+		XLogReaderAllocate(WalSegSz, waldir,
+						   XL_ROUTINE(.page_read = WALDumpReadPage,
+									  .segment_open = WALDumpOpenSegment,
+									  .segment_close = WALDumpCloseSegment),
+						   private);
+	if (!xlogreader_state)
+		pg_fatal("out of memory while allocating a WAL reading processor");
+
+	first_record = XLogFindNextRecord(xlogreader_state, private->startptr);
+	if (first_record == InvalidXLogRecPtr)
+	{
+		result->failed = true;
+		snprintf(result->errormsg, sizeof(result->errormsg),
+				 _("could not find a valid record after %X/%X"),
+				 LSN_FORMAT_ARGS(private->startptr));
+		return;
+	}
+	result->stats.startptr = first_record;
+
+	/* the next record starts at or after EndRecPtr */
+	while (!time_to_stop && xlogreader_state->EndRecPtr < stopptr)
+	{
+		if (!XLogReadRecord(xlogreader_state, &errormsg))
+		{
+			if (errormsg)
+			{
+				result->failed = true;
+				snprintf(result->errormsg, sizeof(result->errormsg),
+						 _("error in WAL record at %X/%X: %s"),
+						 LSN_FORMAT_ARGS(xlogreader_state->ReadRecPtr),
+						 errormsg);
+			}
+			break;
+		}
+
+		if (!XLogDumpRecordMatchesFilters(config, xlogreader_state))
+			continue;
+
+		XLogRecStoreStats(&result->stats, xlogreader_state);
+		result->stats.endptr = xlogreader_state->EndRecPtr;
+
+		if (config->save_fullpage_path != NULL)
+			XLogRecordSaveFPWs(xlogreader_state, config->save_fullpage_path);
+	}
+
+	XLogReaderFree(xlogreader_state);
+}
+
+/*
+ * Compute statistics for --stats using config->jobs worker processes.
+ *
+ * The WAL range is split at segment boundaries, and each worker collects
+ * statistics on the records that start in its part.  XLogFindNextRecord()
+ * lets a worker skip over the tail of a record that began in the previous
+ * part, so every record is counted exactly once.  The results are merged in
+ * WAL order, stopping at the first part that ended with an invalid record,
+ * just as a single pass over the WAL would.  Returns the error to report in
+ * that case, or NULL.
+ */
+static char *
+XLogDumpStatsParallel(XLogDumpConfig *config, XLogDumpPrivate *private,
+					  const char *waldir, XLogStats *stats)
+{
+	XLogSegNo	startsegno;
+	XLogSegNo	endsegno;
+	XLogSegNo	nsegs;
+	int			jobs = config->jobs;
+	pid_t	   *pids;
+	int		   *fds;
+	XLogDumpWorkerResult *result;
+	char	   *failure = NULL;
+
+	XLByteToSeg(private->startptr, startsegno, WalSegSz);
+	XLByteToPrevSeg(private->endptr, endsegno, WalSegSz);
+	nsegs = endsegno - startsegno + 1;
+	if (jobs > nsegs)
+		jobs = nsegs;
+
+	pids = pg_malloc_array(pid_t, jobs);
+	fds = pg_malloc_array(int, jobs);
+	result = pg_malloc_object(XLogDumpWorkerResult);
+
+	/* flush stdio channels before fork, to avoid double output */
+	fflush(NULL);
+
+	for (int i = 0; i < jobs; i++)
+	{
+		XLogDumpPrivate wprivate = *private;
+		XLogRecPtr	stopptr;
+		int			pipefd[2];
+
+		if (i > 0)
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * i / jobs, 0,
+									WalSegSz, wprivate.startptr);
+		if (i < jobs - 1)
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * (i + 1) / jobs, 0,
+									WalSegSz, stopptr);
+		else
+			stopptr = private->endptr;
+
+		if (pipe(pipefd) < 0)
+			pg_fatal("could not create pipe: %m");
+
+		pids[i] = fork();
+		if (pids[i] < 0)
+			pg_fatal("could not fork worker process: %m");
+
+		if (pids[i] == 0)
+		{
+			char	   *ptr = (char *) result;
+			size_t		left = sizeof(XLogDumpWorkerResult);
+
+			for (int j = 0; j < i; j++)
+				close(fds[j]);
+			close(pipefd[0]);
+
+			XLogDumpWorkerStats(config, &wprivate, waldir, stopptr, result);
+
+			while (left > 0)
+			{
+				ssize_t		rc = write(pipefd[1], ptr, left);
+
+				if (rc < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					pg_fatal("could not write to pipe: %m");
+				}
+				ptr += rc;
+				left -= rc;
+			}
+			exit(0);
+		}
+
+		close(pipefd[1]);
+		fds[i] = pipefd[0];
+	}
+
+	for (int i = 0; i < jobs; i++)
+	{
+		char	   *ptr = (char *) result;
+		size_t		left = sizeof(XLogDumpWorkerResult);
+		int			status;
+
+		while (left > 0)
+		{
+			ssize_t		rc = read(fds[i], ptr, left);
+
+			if (rc < 0 && errno == EINTR)
+				continue;
+			if (rc <= 0)
+				break;			/* worker died; waitpid will tell */
+			ptr += rc;
+			left -= rc;
+		}
+		close(fds[i]);
+
+		if (waitpid(pids[i], &status, 0) != pids[i])
+			pg_fatal("could not wait for worker process: %m");
+
+		/* parts after an invalid record don't count, whatever happened */
+		if (failure != NULL)
+			continue;
+
+		if (status != 0)
+			pg_fatal("worker process failed: %s", wait_result_to_str(status));
+
+		if (i == 0)
+			stats->startptr = result->stats.startptr;
+		XLogStatsMerge(stats, &result->stats);
+		if (!XLogRecPtrIsInvalid(result->stats.endptr))
+			stats->endptr = result->stats.endptr;
+
+		if (result->failed)
+			failure = pg_strdup(result->errormsg);
+	}
+
+	pg_free(result);
+	pg_free(fds);
+	pg_free(pids);
+
+	return failure;
+}
+
+#endif							/* !WIN32 */
+
 static void
 usage(void)
 {
@@ -766,6 +1021,7 @@ usage(void)
 	printf(_("  -f, --follow           keep retrying after reaching end of WAL\n"));
 	printf(_("  -F, --fork=FORK        only show records that modify blocks in fork FORK;\n"
 			 "                         valid names are main, fsm, vm, init\n"));
+	printf(_("  -j, --jobs=NUM         use this many processes to compute --stats\n"));
 	printf(_("  -n, --limit=N          number of records to display\n"));
 	printf(_("  -p, --path=PATH        directory in which to find WAL segment files or a\n"
 			 "                         directory with a ./pg_wal that contains such files\n"
@@ -810,6 +1066,7 @@ main(int argc, char **argv)
 		{"fork", required_argument, NULL, 'F'},
 		{"fullpage", no_argument, NULL, 'w'},
 		{"help", no_argument, NULL, '?'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"limit", required_argument, NULL, 'n'},
 		{"path", required_argument, NULL, 'p'},
 		{"quiet", no_argument, NULL, 'q'},
@@ -875,6 +1132,7 @@ main(int argc, char **argv)
 	config.save_fullpage_path = NULL;
 	config.stats = false;
 	config.stats_per_record = false;
+	config.jobs = 1;
 
 	stats.startptr = InvalidXLogRecPtr;
 	stats.endptr = InvalidXLogRecPtr;
@@ -885,7 +1143,7 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
-	while ((option = getopt_long(argc, argv, "bB:e:fF:n:p:qr:R:s:t:wx:z",
+	while ((option = getopt_long(argc, argv, "bB:e:fF:j:n:p:qr:R:s:t:wx:z",
 								 long_options, &optindex)) != -1)
 	{
 		switch (option)
@@ -924,6 +1182,14 @@ main(int argc, char **argv)
 				}
 				config.filter_by_extended = true;
 				break;
+			case 'j':
+				if (sscanf(optarg, "%d", &config.jobs) != 1 ||
+					config.jobs < 1)
+				{
+					pg_log_error("invalid value \"%s\" for option %s", optarg, "-j/--jobs");
+					goto bad_argument;
+				}
+				break;
 			case 'n':
 				if (sscanf(optarg, "%d", &config.stop_after_records) != 1)
 				{
@@ -1198,8 +1464,56 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
+	if (config.jobs > 1)
+	{
+#ifdef WIN32
+		pg_log_error("option %s is not supported on this platform",
+					 "-j/--jobs");
+		goto bad_argument;
+#else
+		if (!config.stats)
+		{
+			pg_log_error("option %s requires option %s to be specified",
+						 "-j/--jobs", "-z/--stats");
+			goto bad_argument;
+		}
+		if (config.follow || config.stop_after_records > 0)
+		{
+			pg_log_error("option %s cannot be used together with options %s or %s",
+						 "-j/--jobs", "-f/--follow", "-n/--limit");
+			goto bad_argument;
+		}
+		if (XLogRecPtrIsInvalid(private.endptr))
+		{
+			pg_log_error("option %s requires an end WAL location or ENDSEG",
+						 "-j/--jobs");
+			goto bad_argument;
+		}
+#endif
+	}
+
 	/* done with argument parsing, do the actual work */
 
+#ifndef WIN32
+	if (config.jobs > 1)
+	{
+		char	   *failure;
+
+		failure = XLogDumpStatsParallel(&config, &private, waldir, &stats);
+
+		if (!config.quiet)
+			XLogDumpDisplayStats(&config, &stats);
+
+		if (time_to_stop)
+			exit(0);
+
+		if (failure)
+			pg_fatal("%s", failure);
+
+		return EXIT_SUCCESS;
+	}
+#endif
+
 	/* we have everything we need, start reading */
 	xlogreader_state =
 		XLogReaderAllocate(WalSegSz, waldir,
@@ -1256,27 +1570,7 @@ main(int argc, char **argv)
 		}
 
 		/* apply all specified filters */
-		if (config.filter_by_rmgr_enabled &&
-			!config.filter_by_rmgr[record->xl_rmid])
-			continue;
-
-		if (config.filter_by_xid_enabled &&
-			config.filter_by_xid != record->xl_xid)
-			continue;
-
-		/* check for extended filtering */
-		if (config.filter_by_extended &&
-			!XLogRecordMatchesRelationBlock(xlogreader_state,
-											config.filter_by_relation_enabled ?
-											config.filter_by_relation :
-											emptyRelFileLocator,
-											config.filter_by_relation_block_enabled ?
-											config.filter_by_relation_block :
-											InvalidBlockNumber,
-											config.filter_by_relation_forknum))
-			continue;
-
-		if (config.filter_by_fpw && !XLogRecordHasFPW(xlogreader_state))
+		if (!XLogDumpRecordMatchesFilters(&config, xlogreader_state))
 			continue;
 
 		/* perform any per-record work */
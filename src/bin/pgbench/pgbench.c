@@ -42,8 +42,16 @@
 #include <sys/time.h>
 #include <sys/resource.h>		/* for getrlimit */
 
-/* For testing, PGBENCH_USE_SELECT can be defined to force use of that code */
-#if defined(HAVE_PPOLL) && !defined(PGBENCH_USE_SELECT)
+/*
+ * For testing, PGBENCH_USE_SELECT or PGBENCH_USE_PPOLL can be defined to
+ * force use of that code
+ */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_PPOLL) && \
+	!defined(PGBENCH_USE_SELECT) && !defined(PGBENCH_USE_PPOLL)
+#define POLL_USING_EPOLL
+#include <poll.h>
+#include <sys/epoll.h>
+#elif defined(HAVE_PPOLL) && !defined(PGBENCH_USE_SELECT)
 #define POLL_USING_PPOLL
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -90,6 +98,23 @@
  * Multi-platform socket set implementations
  */
 
+#ifdef POLL_USING_EPOLL
+#define SOCKET_WAIT_METHOD "epoll_wait"
+
+typedef struct socket_set
+{
+	int			epfd;			/* epoll instance */
+	int			curfds;			/* number of sockets added since clear */
+	int			maxevents;		/* allocated length of events[] */
+	int			nevents;		/* number of events returned by last wait */
+	struct epoll_event *events;
+	int			fdlen;			/* allocated length of the arrays below */
+	bool	   *armed;			/* is the socket registered and enabled? */
+	bool	   *ready;			/* did the last wait report input? */
+} socket_set;
+
+#endif							/* POLL_USING_EPOLL */
+
 #ifdef POLL_USING_PPOLL
 #define SOCKET_WAIT_METHOD "ppoll"
 
@@ -160,7 +185,7 @@ typedef struct socket_set
  * some configurable parameters */
 
 #define DEFAULT_INIT_STEPS "dtgvp"	/* default -I setting */
-#define ALL_INIT_STEPS "dtgGvpf"	/* all possible steps */
+#define ALL_INIT_STEPS "dtgGvpfa"	/* all possible steps */
 
 #define LOG_STEP_SECONDS	5	/* seconds between log messages */
 #define DEFAULT_NXACTS	10		/* default nxacts */
@@ -233,6 +258,9 @@ typedef enum
 static partition_method_t partition_method = PART_NONE;
 static const char *const PARTITION_METHOD[] = {"none", "range", "hash"};
 
+/* number of connections used to generate the analytical tables */
+static int	init_jobs = 1;
+
 /* random seed used to initialize base_random_sequence */
 int64		random_seed = -1;
 
@@ -245,6 +273,25 @@ int64		random_seed = -1;
 #define ntellers	10
 #define naccounts	100000
 
+/*
+ * Sizes of the tables of the analytical schema, per unit of scale.  Each
+ * order has 4 line items on average, so a scale of 10 is roughly the size of
+ * TPC-H at scale factor 1.
+ */
+#define nparts		20000
+#define ncustomers	15000
+#define norders		150000
+
+/*
+ * SQL expressions used by both the data generator and the builtin scripts of
+ * the analytical schema: a part's retail price (as in TPC-H), and an order's
+ * date, between 1992-01-01 and 1998-08-02.
+ */
+#define ANALYTICAL_RETAILPRICE(p) \
+	"(90000 + mod(" p " / 10, 20001) + 100 * mod(" p ", 1000)) / 100.0"
+#define ANALYTICAL_ORDERDATE(o) \
+	"(date '1992-01-01' + mod(" o " * 104729, 2406)::int)"
+
 /*
  * The scale factor at/beyond which 32bit integers are incapable of storing
  * 64bit values.
@@ -261,6 +308,7 @@ int			agg_interval;		/* log aggregates instead of individual
 bool		per_script_stats = false;	/* whether to collect stats per script */
 int			progress = 0;		/* thread progress report every this seconds */
 bool		progress_timestamp = false; /* progress report with Unix time */
+bool		latency_percentiles = false;	/* collect latency histograms */
 int			nclients = 1;		/* number of clients */
 int			nthreads = 1;		/* number of threads */
 bool		is_connect;			/* establish connection for each transaction */
@@ -362,6 +410,28 @@ typedef struct SimpleStats
 	double		sum2;			/* sum of squared values */
 } SimpleStats;
 
+/*
+ * Latency histogram, in the manner of HdrHistogram: values are sorted into
+ * buckets covering powers of two, each of which is divided into
+ * LATENCY_HIST_SUB_COUNT linear sub-buckets.  Values (in microseconds) below
+ * LATENCY_HIST_SUB_COUNT are recorded exactly, larger ones with a relative
+ * error of at most 1 / LATENCY_HIST_SUB_COUNT, which is enough to report
+ * tail percentiles like p99.99 meaningfully with constant cost per value.
+ * Values above 2^LATENCY_HIST_MAX_BITS us (about 25 days) are clamped.
+ */
+#define LATENCY_HIST_SUB_BITS	9
+#define LATENCY_HIST_SUB_COUNT	(1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_BITS	41
+#define LATENCY_HIST_BUCKETS \
+	((LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB_COUNT)
+
+typedef struct LatencyHistogram
+{
+	int64		count;			/* total number of values */
+	int64		max;			/* the maximum seen */
+	int64		buckets[LATENCY_HIST_BUCKETS];
+} LatencyHistogram;
+
 /*
  * The instr_time type is expensive when dealing with time arithmetic.  Define
  * a type to hold microseconds instead.  Type int64 is good enough for about
@@ -658,7 +728,7 @@ typedef struct
 	pg_prng_state ts_throttle_rs;	/* random state for transaction throttling */
 	pg_prng_state ts_sample_rs; /* random state for log sampling */
 
-	int64		throttle_trigger;	/* previous/next throttling (us) */
+	double		throttle_trigger;	/* previous/next throttling (us) */
 	FILE	   *logfile;		/* where to log, or NULL */
 
 	/* per thread collected stats in microseconds */
@@ -669,6 +739,7 @@ typedef struct
 									 * delays */
 
 	StatsData	stats;
+	LatencyHistogram *latency_hist; /* latencies, under --latency-percentiles */
 	int64		latency_late;	/* count executed but late transactions */
 } TState;
 
@@ -775,6 +846,7 @@ typedef struct BuiltinScript
 	const char *name;			/* very short name for -b ... */
 	const char *desc;			/* short description */
 	const char *script;			/* actual pgbench script */
+	bool		analytical;		/* uses the analytical tables? */
 } BuiltinScript;
 
 static const BuiltinScript builtin_script[] =
@@ -812,6 +884,74 @@ static const BuiltinScript builtin_script[] =
 		"<builtin: select only>",
 		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
 		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+	},
+	{
+		"analytical",
+		"<builtin: analytical queries (TPC-H-like)>",
+		"\\set query random(1, 3)\n"
+		"\\if :query = 1\n"
+		"\\set delta random(60, 120)\n"
+		"SELECT l_returnflag, l_linestatus, sum(l_quantity) AS sum_qty, "
+		"sum(l_extendedprice) AS sum_base_price, "
+		"sum(l_extendedprice * (1 - l_discount)) AS sum_disc_price, "
+		"sum(l_extendedprice * (1 - l_discount) * (1 + l_tax)) AS sum_charge, "
+		"avg(l_quantity) AS avg_qty, avg(l_extendedprice) AS avg_price, "
+		"avg(l_discount) AS avg_disc, count(*) AS count_order "
+		"FROM pgbench_lineitems WHERE l_shipdate <= date '1998-12-01' - :delta::int "
+		"GROUP BY l_returnflag, l_linestatus ORDER BY l_returnflag, l_linestatus;\n"
+		"\\elif :query = 2\n"
+		"\\set segment random(1, 5)\n"
+		"\\set day random(0, 30)\n"
+		"SELECT l_orderkey, sum(l_extendedprice * (1 - l_discount)) AS revenue, "
+		"o_orderdate, o_orderpriority "
+		"FROM pgbench_customers, pgbench_orders, pgbench_lineitems "
+		"WHERE c_mktsegment = (ARRAY['AUTOMOBILE', 'BUILDING', 'FURNITURE', 'HOUSEHOLD', 'MACHINERY'])[:segment::int] "
+		"AND c_custkey = o_custkey AND l_orderkey = o_orderkey "
+		"AND o_orderdate < date '1995-03-01' + :day::int "
+		"AND l_shipdate > date '1995-03-01' + :day::int "
+		"GROUP BY l_orderkey, o_orderdate, o_orderpriority "
+		"ORDER BY revenue DESC, o_orderdate LIMIT 10;\n"
+		"\\else\n"
+		"\\set year random(1993, 1997)\n"
+		"\\set discount random(2, 9)\n"
+		"\\set quantity random(24, 25)\n"
+		"SELECT sum(l_extendedprice * l_discount) AS revenue FROM pgbench_lineitems "
+		"WHERE l_shipdate >= make_date(:year::int, 1, 1) "
+		"AND l_shipdate < make_date(:year::int + 1, 1, 1) "
+		"AND l_discount BETWEEN (:discount::int - 1) / 100.0 AND (:discount::int + 1) / 100.0 "
+		"AND l_quantity < :quantity::int;\n"
+		"\\endif\n",
+		true
+	},
+	{
+		"htap",
+		"<builtin: new orders mixed with analytical queries>",
+		"\\set r random(1, 100)\n"
+		"\\if :r <= 5\n"
+		"\\set year random(1993, 1997)\n"
+		"SELECT sum(l_extendedprice * l_discount) AS revenue FROM pgbench_lineitems "
+		"WHERE l_shipdate >= make_date(:year::int, 1, 1) "
+		"AND l_shipdate < make_date(:year::int + 1, 1, 1) "
+		"AND l_discount BETWEEN 0.05 AND 0.07 AND l_quantity < 24;\n"
+		"\\else\n"
+		"\\set custkey random(1, " CppAsString2(ncustomers) " * :scale)\n"
+		"\\set partkey random(1, " CppAsString2(nparts) " * :scale)\n"
+		"\\set quantity random(1, 50)\n"
+		"BEGIN;\n"
+		"SELECT c_acctbal FROM pgbench_customers WHERE c_custkey = :custkey;\n"
+		"SELECT p_retailprice FROM pgbench_parts WHERE p_partkey = :partkey \\gset\n"
+		"INSERT INTO pgbench_orders (o_custkey, o_orderstatus, o_totalprice, o_orderdate, o_orderpriority) "
+		"VALUES (:custkey, 'O', :quantity::int * :p_retailprice::numeric, CURRENT_DATE, '3-MEDIUM') "
+		"RETURNING o_orderkey \\gset\n"
+		"INSERT INTO pgbench_lineitems (l_orderkey, l_linenumber, l_partkey, l_quantity, "
+		"l_extendedprice, l_discount, l_tax, l_returnflag, l_linestatus, l_shipdate, l_shipmode) "
+		"VALUES (:o_orderkey, 1, :partkey, :quantity, :quantity::int * :p_retailprice::numeric, "
+		"0, 0, 'N', 'O', CURRENT_DATE + 1, 'MAIL');\n"
+		"UPDATE pgbench_customers SET c_acctbal = c_acctbal - :quantity::int * :p_retailprice::numeric "
+		"WHERE c_custkey = :custkey;\n"
+		"END;\n"
+		"\\endif\n",
+		true
 	}
 };
 
@@ -883,11 +1023,14 @@ usage(void)
 		   "                           v: invoke VACUUM on the standard tables\n"
 		   "                           p: create primary key indexes on the standard tables\n"
 		   "                           f: create foreign keys between the standard tables\n"
+		   "                           a: create and generate the analytical tables, server-side\n"
 		   "  -F, --fillfactor=NUM     set fill factor\n"
 		   "  -n, --no-vacuum          do not run VACUUM during initialization\n"
 		   "  -q, --quiet              quiet logging (one message each 5 seconds)\n"
 		   "  -s, --scale=NUM          scaling factor\n"
 		   "  --foreign-keys           create foreign key constraints between tables\n"
+		   "  --init-jobs=NUM          number of connections generating the analytical\n"
+		   "                           tables in parallel (default: 1)\n"
 		   "  --index-tablespace=TABLESPACE\n"
 		   "                           create indexes in the specified tablespace\n"
 		   "  --partition-method=(range|hash)\n"
@@ -924,6 +1067,7 @@ usage(void)
 		   "  --aggregate-interval=NUM aggregate data over NUM seconds\n"
 		   "  --exit-on-abort          exit when any client is aborted\n"
 		   "  --failures-detailed      report the failures grouped by basic types\n"
+		   "  --latency-percentiles    report latency percentiles, up to p99.99\n"
 		   "  --log-prefix=PREFIX      prefix for transaction time log file\n"
 		   "                           (default: \"pgbench_log\")\n"
 		   "  --max-tries=NUM          max number of tries to run transaction (default: 1)\n"
@@ -1172,10 +1316,11 @@ getGaussianRand(pg_prng_state *state, int64 min, int64 max,
  * random number generator: generate a value, such that the series of values
  * will approximate a Poisson distribution centered on the given value.
  *
- * Individual results are rounded to integers, though the center value need
- * not be one.
+ * Results are not rounded to integers: with very high --rate settings the
+ * center value can be around a microsecond or less, and rounding each
+ * inter-arrival time would then noticeably skew the achieved rate.
  */
-static int64
+static double
 getPoissonRand(pg_prng_state *state, double center)
 {
 	/*
@@ -1187,7 +1332,7 @@ getPoissonRand(pg_prng_state *state, double center)
 	/* pg_prng_double value in [0, 1), uniform in (0, 1] */
 	uniform = 1.0 - pg_prng_double(state);
 
-	return (int64) (-log(uniform) * center + 0.5);
+	return -log(uniform) * center;
 }
 
 /*
@@ -1426,6 +1571,97 @@ mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 	acc->sum2 += ss->sum2;
 }
 
+/*
+ * Accumulate one latency, in microseconds, into a LatencyHistogram.
+ */
+static void
+addToLatencyHistogram(LatencyHistogram *hist, int64 val)
+{
+	int			idx;
+
+	if (val < 0)
+		val = 0;
+	if (val > hist->max)
+		hist->max = val;
+
+	if (val < LATENCY_HIST_SUB_COUNT)
+		idx = val;
+	else
+	{
+		int			msb = pg_leftmost_one_pos64(val);
+		int			shift;
+
+		if (msb >= LATENCY_HIST_MAX_BITS)
+		{
+			msb = LATENCY_HIST_MAX_BITS - 1;
+			val = (INT64CONST(1) << LATENCY_HIST_MAX_BITS) - 1;
+		}
+
+		/* the bucket, and the sub-bucket given by the next highest bits */
+		shift = msb - LATENCY_HIST_SUB_BITS;
+		idx = (shift + 1) * LATENCY_HIST_SUB_COUNT +
+			(int) (val >> shift) - LATENCY_HIST_SUB_COUNT;
+	}
+
+	hist->buckets[idx]++;
+	hist->count++;
+}
+
+/*
+ * Merge two LatencyHistogram objects
+ */
+static void
+mergeLatencyHistogram(LatencyHistogram *acc, const LatencyHistogram *hist)
+{
+	if (hist->max > acc->max)
+		acc->max = hist->max;
+	acc->count += hist->count;
+	for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		acc->buckets[i] += hist->buckets[i];
+}
+
+/*
+ * Return the given percentile of the values in a LatencyHistogram, in
+ * microseconds.  The result is the midpoint of the sub-bucket the percentile
+ * falls in.
+ */
+static double
+getLatencyPercentile(const LatencyHistogram *hist, double percentile)
+{
+	int64		rank;
+	int64		seen = 0;
+
+	if (hist->count == 0)
+		return 0.0;
+
+	rank = (int64) ceil(percentile / 100.0 * hist->count);
+	if (rank < 1)
+		rank = 1;
+
+	for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+		{
+			int			shift = i / LATENCY_HIST_SUB_COUNT - 1;
+			int64		sub = i % LATENCY_HIST_SUB_COUNT;
+			int64		low;
+			int64		width;
+
+			if (shift < 0)
+				return (double) sub;
+
+			low = (sub + LATENCY_HIST_SUB_COUNT) << shift;
+			width = INT64CONST(1) << shift;
+
+			/* never report more than the actual maximum */
+			return Min(low + (width - 1) / 2.0, (double) hist->max);
+		}
+	}
+
+	return (double) hist->max;
+}
+
 /*
  * Initialize a StatsData struct to mostly zeroes, with its start time set to
  * the given value.
@@ -3704,7 +3940,7 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 
 				thread->throttle_trigger +=
 					getPoissonRand(&thread->ts_throttle_rs, throttle_delay);
-				st->txn_scheduled = thread->throttle_trigger;
+				st->txn_scheduled = (pg_time_usec_t) thread->throttle_trigger;
 
 				/*
 				 * If --latency-limit is used, and this slot is already late
@@ -3716,7 +3952,7 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 				{
 					pg_time_now_lazy(&now);
 
-					if (thread->throttle_trigger < now - latency_limit)
+					if (st->txn_scheduled < now - latency_limit)
 					{
 						processXactStats(thread, st, &now, true, agg);
 
@@ -4669,7 +4905,7 @@ processXactStats(TState *thread, CState *st, pg_time_usec_t *now,
 	double		latency = 0.0,
 				lag = 0.0;
 	bool		detailed = progress || throttle_delay || latency_limit ||
-		use_log || per_script_stats;
+		use_log || per_script_stats || latency_percentiles;
 
 	if (detailed && !skipped && st->estatus == ESTATUS_NO_ERROR)
 	{
@@ -4683,6 +4919,9 @@ processXactStats(TState *thread, CState *st, pg_time_usec_t *now,
 	/* keep detailed thread stats */
 	accumStats(&thread->stats, skipped, latency, lag, st->estatus, st->tries);
 
+	if (thread->latency_hist && !skipped && st->estatus == ESTATUS_NO_ERROR)
+		addToLatencyHistogram(thread->latency_hist, (int64) latency);
+
 	/* count transactions over the latency limit, if needed */
 	if (latency_limit && latency > latency_limit)
 		thread->latency_late++;
@@ -4726,7 +4965,12 @@ initDropTables(PGconn *con)
 					 "pgbench_accounts, "
 					 "pgbench_branches, "
 					 "pgbench_history, "
-					 "pgbench_tellers");
+					 "pgbench_tellers, "
+					 "pgbench_nations, "
+					 "pgbench_parts, "
+					 "pgbench_customers, "
+					 "pgbench_orders, "
+					 "pgbench_lineitems");
 }
 
 /*
@@ -5192,6 +5436,315 @@ initCreateFKeys(PGconn *con)
 	}
 }
 
+/*
+ * Run the given statements over several connections, keeping each connection
+ * busy with one statement at a time, and wait for all of them to complete.
+ */
+static void
+executeStatementsInParallel(PGconn **conns, int nconns,
+							char **sqls, int nsqls)
+{
+	int		   *running = (int *) pg_malloc(sizeof(int) * nconns);
+	socket_set *sockets = alloc_socket_set(nconns);
+	int			next = 0;
+	int			nrunning = 0;
+
+	for (int i = 0; i < nconns; i++)
+		running[i] = -1;
+
+	for (;;)
+	{
+		bool		any_done = false;
+		int			nsocks = 0;
+
+		/* start the next statements on idle connections */
+		for (int i = 0; i < nconns && next < nsqls; i++)
+		{
+			if (running[i] >= 0)
+				continue;
+			if (!PQsendQuery(conns[i], sqls[next]))
+			{
+				pg_log_error("query failed: %s", PQerrorMessage(conns[i]));
+				pg_log_error_detail("Query was: %s", sqls[next]);
+				exit(1);
+			}
+			running[i] = next++;
+			nrunning++;
+		}
+
+		if (nrunning == 0)
+			break;
+
+		/* collect the results of completed statements */
+		for (int i = 0; i < nconns; i++)
+		{
+			PGresult   *res;
+
+			if (running[i] < 0 || PQisBusy(conns[i]))
+				continue;
+
+			while ((res = PQgetResult(conns[i])) != NULL)
+			{
+				if (PQresultStatus(res) != PGRES_COMMAND_OK)
+				{
+					pg_log_error("query failed: %s", PQerrorMessage(conns[i]));
+					pg_log_error_detail("Query was: %s", sqls[running[i]]);
+					exit(1);
+				}
+				PQclear(res);
+			}
+			running[i] = -1;
+			nrunning--;
+			any_done = true;
+		}
+
+		if (any_done)
+			continue;
+
+		/* wait for more input on the busy connections */
+		clear_socket_set(sockets);
+		for (int i = 0; i < nconns; i++)
+		{
+			if (running[i] >= 0)
+				add_socket_to_set(sockets, PQsocket(conns[i]), nsocks++);
+		}
+		if (wait_on_socket_set(sockets, 0) < 0 && errno != EINTR)
+			pg_fatal("%s() failed: %m", SOCKET_WAIT_METHOD);
+
+		nsocks = 0;
+		for (int i = 0; i < nconns; i++)
+		{
+			if (running[i] < 0)
+				continue;
+			if (socket_has_input(sockets, PQsocket(conns[i]), nsocks++) &&
+				!PQconsumeInput(conns[i]))
+				pg_fatal("could not read result: %s",
+						 PQerrorMessage(conns[i]));
+		}
+	}
+
+	free_socket_set(sockets);
+	pg_free(running);
+}
+
+/*
+ * Append statements that run sqlfmt over chunks of the key range [1, total]
+ * to *sqls, one chunk per initialization job.  sqlfmt must contain two
+ * INT64_FORMAT placeholders, for the first and last key of the chunk.
+ */
+static void
+appendChunkedStatements(char ***sqls, int *nsqls, const char *sqlfmt,
+						int64 total)
+{
+	int			nchunks = (int) Min((int64) init_jobs, total);
+
+	*sqls = pg_realloc(*sqls, sizeof(char *) * (*nsqls + nchunks));
+	for (int i = 0; i < nchunks; i++)
+	{
+		int64		first = total * i / nchunks + 1;
+		int64		last = total * (i + 1) / nchunks;
+
+		(*sqls)[(*nsqls)++] = psprintf(sqlfmt, first, last);
+	}
+}
+
+/*
+ * Create and fill the tables of the analytical (TPC-H-like) schema, used by
+ * the "analytical" and "htap" builtin scripts.
+ *
+ * The data is generated server-side with generate_series(), split into
+ * chunks that are loaded over --init-jobs connections in parallel.  All
+ * values are computed from the keys, so the data only depends on the scale.
+ */
+static void
+initAnalyticalTables(PGconn *con)
+{
+	static const char *const DDLs[][2] = {
+		{
+			"pgbench_nations",
+			"n_nationkey int not null, n_name text, n_regionkey int"
+		},
+		{
+			"pgbench_parts",
+			"p_partkey int not null, p_name text, p_brand text, p_type text, "
+			"p_size int, p_retailprice numeric(12,2)"
+		},
+		{
+			"pgbench_customers",
+			"c_custkey int not null, c_name text, c_nationkey int, "
+			"c_acctbal numeric(12,2), c_mktsegment text"
+		},
+		{
+			"pgbench_orders",
+			"o_orderkey bigint generated by default as identity, o_custkey int, "
+			"o_orderstatus char(1), o_totalprice numeric(12,2), "
+			"o_orderdate date, o_orderpriority text"
+		},
+		{
+			"pgbench_lineitems",
+			"l_orderkey bigint not null, l_linenumber int not null, "
+			"l_partkey int, l_quantity numeric(12,2), "
+			"l_extendedprice numeric(12,2), l_discount numeric(12,2), "
+			"l_tax numeric(12,2), l_returnflag char(1), l_linestatus char(1), "
+			"l_shipdate date, l_shipmode text"
+		}
+	};
+	static const char *const PKeys[] = {
+		"alter table pgbench_nations add primary key (n_nationkey)",
+		"alter table pgbench_parts add primary key (p_partkey)",
+		"alter table pgbench_customers add primary key (c_custkey)",
+		"alter table pgbench_orders add primary key (o_orderkey)",
+		"alter table pgbench_lineitems add primary key (l_orderkey, l_linenumber)"
+	};
+	PGconn	  **conns;
+	PGresult   *res;
+	char	  **sqls = NULL;
+	int			nsqls = 0;
+	char	   *sqlfmt;
+	PQExpBufferData query;
+
+	fprintf(stderr, "creating analytical tables...\n");
+
+	executeStatement(con, "drop table if exists "
+					 "pgbench_nations, pgbench_parts, pgbench_customers, "
+					 "pgbench_orders, pgbench_lineitems");
+
+	initPQExpBuffer(&query);
+	for (int i = 0; i < lengthof(DDLs); i++)
+	{
+		printfPQExpBuffer(&query, "create%s table %s(%s)",
+						  unlogged_tables ? " unlogged" : "",
+						  DDLs[i][0], DDLs[i][1]);
+
+		if (tablespace != NULL)
+		{
+			char	   *escape_tablespace;
+
+			escape_tablespace = PQescapeIdentifier(con, tablespace, strlen(tablespace));
+			appendPQExpBuffer(&query, " tablespace %s", escape_tablespace);
+			PQfreemem(escape_tablespace);
+		}
+
+		executeStatement(con, query.data);
+	}
+
+	/* one connection per job, reusing ours for the first one */
+	conns = (PGconn **) pg_malloc(sizeof(PGconn *) * init_jobs);
+	conns[0] = con;
+	for (int i = 1; i < init_jobs; i++)
+	{
+		if ((conns[i] = doConnect()) == NULL)
+			pg_fatal("could not create connection for initialization");
+	}
+
+	fprintf(stderr, "generating analytical data (server-side, %d %s)...\n",
+			init_jobs, init_jobs == 1 ? "connection" : "connections");
+
+	sqls = pg_malloc(sizeof(char *));
+	sqls[nsqls++] = pg_strdup("insert into pgbench_nations "
+							  "select n, 'NATION ' || n, mod(n, 5) "
+							  "from generate_series(0, 24) as n");
+
+	appendChunkedStatements(&sqls, &nsqls,
+							"insert into pgbench_parts "
+							"select p, 'part ' || p, "
+							"'Brand#' || (mod(p, 5) + 1) || (mod(p / 5, 5) + 1), "
+							"(array['STANDARD','SMALL','MEDIUM','LARGE','ECONOMY','PROMO'])[mod(p, 6) + 1] || ' ' || "
+							"(array['ANODIZED','BURNISHED','PLATED','POLISHED','BRUSHED'])[mod(p / 6, 5) + 1] || ' ' || "
+							"(array['TIN','NICKEL','BRASS','STEEL','COPPER'])[mod(p / 30, 5) + 1], "
+							"mod(p, 50) + 1, " ANALYTICAL_RETAILPRICE("p") " "
+							"from generate_series(" INT64_FORMAT "::bigint, " INT64_FORMAT ") as p",
+							(int64) nparts * scale);
+
+	appendChunkedStatements(&sqls, &nsqls,
+							"insert into pgbench_customers "
+							"select c, 'Customer#' || lpad(c::text, 9, '0'), mod(c, 25), "
+							"(mod(c * 7919, 1099999) - 99999) / 100.0, "
+							"(array['AUTOMOBILE','BUILDING','FURNITURE','HOUSEHOLD','MACHINERY'])[mod(c, 5) + 1] "
+							"from generate_series(" INT64_FORMAT "::bigint, " INT64_FORMAT ") as c",
+							(int64) ncustomers * scale);
+
+	sqlfmt = psprintf("insert into pgbench_orders "
+					  "select o, mod(o * 7919, " INT64_FORMAT ") + 1, "
+					  "case when " ANALYTICAL_ORDERDATE("o") " < date '1995-06-17' "
+					  "then 'F' else 'O' end, "
+					  "(mod(o * 31337, 45000000) + 100000) / 100.0, "
+					  ANALYTICAL_ORDERDATE("o") ", "
+					  "(array['1-URGENT','2-HIGH','3-MEDIUM','4-NOT SPECIFIED','5-LOW'])[mod(o, 5) + 1] "
+					  "from generate_series(%s::bigint, %s) as o",
+					  (int64) ncustomers * scale, INT64_FORMAT, INT64_FORMAT);
+	appendChunkedStatements(&sqls, &nsqls, sqlfmt, (int64) norders * scale);
+	pg_free(sqlfmt);
+
+	/* each order has between 1 and 7 line items, 4 on average */
+	sqlfmt = psprintf("insert into pgbench_lineitems "
+					  "select o, l, x.p, x.q, x.q * " ANALYTICAL_RETAILPRICE("x.p") ", "
+					  "mod(o + l, 11) / 100.0, mod(o * 3 + l, 9) / 100.0, "
+					  "case when x.shipdate > date '1995-06-17' then 'N' "
+					  "when mod(o + l, 2) = 0 then 'R' else 'A' end, "
+					  "case when x.shipdate > date '1995-06-17' then 'O' else 'F' end, "
+					  "x.shipdate, "
+					  "(array['REG AIR','AIR','RAIL','SHIP','TRUCK','MAIL','FOB'])[mod(o + l, 7) + 1] "
+					  "from generate_series(%s::bigint, %s) as o, "
+					  "generate_series(1, (mod(o, 7) + 1)::int) as l, "
+					  "lateral (select mod(o * 7 + l * 104723, " INT64_FORMAT ") + 1 as p, "
+					  "mod(o * 13 + l * 7, 50) + 1 as q, "
+					  ANALYTICAL_ORDERDATE("o") " + (mod(o + l * 31, 121) + 1)::int as shipdate) as x",
+					  INT64_FORMAT, INT64_FORMAT, (int64) nparts * scale);
+	appendChunkedStatements(&sqls, &nsqls, sqlfmt, (int64) norders * scale);
+	pg_free(sqlfmt);
+
+	executeStatementsInParallel(conns, init_jobs, sqls, nsqls);
+
+	/* new orders inserted by the scripts get keys from the identity */
+	res = PQexec(con,
+				 "select pg_catalog.setval(pg_catalog.pg_get_serial_sequence('pgbench_orders', 'o_orderkey'), "
+				 "max(o_orderkey)) from pgbench_orders");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pg_fatal("could not set order key sequence: %s", PQerrorMessage(con));
+	PQclear(res);
+
+	for (int i = 0; i < nsqls; i++)
+		pg_free(sqls[i]);
+	nsqls = 0;
+
+	fprintf(stderr, "creating primary keys on analytical tables...\n");
+	sqls = pg_realloc(sqls, sizeof(char *) * lengthof(PKeys));
+	for (int i = 0; i < lengthof(PKeys); i++)
+	{
+		printfPQExpBuffer(&query, "%s", PKeys[i]);
+		if (index_tablespace != NULL)
+		{
+			char	   *escape_tablespace;
+
+			escape_tablespace = PQescapeIdentifier(con, index_tablespace,
+												   strlen(index_tablespace));
+			appendPQExpBuffer(&query, " using index tablespace %s", escape_tablespace);
+			PQfreemem(escape_tablespace);
+		}
+		sqls[nsqls++] = pg_strdup(query.data);
+	}
+	executeStatementsInParallel(conns, init_jobs, sqls, nsqls);
+
+	for (int i = 0; i < nsqls; i++)
+		pg_free(sqls[i]);
+	nsqls = 0;
+
+	fprintf(stderr, "vacuuming analytical tables...\n");
+	for (int i = 0; i < lengthof(DDLs); i++)
+		sqls[nsqls++] = psprintf("vacuum analyze %s", DDLs[i][0]);
+	executeStatementsInParallel(conns, init_jobs, sqls, nsqls);
+
+	for (int i = 0; i < nsqls; i++)
+		pg_free(sqls[i]);
+	pg_free(sqls);
+	termPQExpBuffer(&query);
+
+	for (int i = 1; i < init_jobs; i++)
+		PQfinish(conns[i]);
+	pg_free(conns);
+}
+
 /*
  * Validate an initialization-steps string
  *
@@ -5271,6 +5824,10 @@ runInitSteps(const char *initialize_steps)
 				op = "foreign keys";
 				initCreateFKeys(con);
 				break;
+			case 'a':
+				op = "analytical tables";
+				initAnalyticalTables(con);
+				break;
 			case ' ':
 				break;			/* ignore */
 			default:
@@ -5409,6 +5966,40 @@ GetTableInfo(PGconn *con, bool scale_given)
 	PQclear(res);
 }
 
+/*
+ * Like GetTableInfo, for the analytical tables: get the scaling factor from
+ * the number of parts.
+ */
+static void
+GetAnalyticalTableInfo(PGconn *con, bool scale_given)
+{
+	PGresult   *res;
+
+	res = PQexec(con, "select coalesce(max(p_partkey), 0) from pgbench_parts");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		char	   *sqlState = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+
+		pg_log_error("could not count number of parts: %s", PQerrorMessage(con));
+
+		if (sqlState && strcmp(sqlState, ERRCODE_UNDEFINED_TABLE) == 0)
+			pg_log_error_hint("Perhaps you need to do initialization (\"pgbench -i -I a\") in database \"%s\".",
+							  PQdb(con));
+
+		exit(1);
+	}
+	scale = atoi(PQgetvalue(res, 0, 0)) / nparts;
+	if (scale <= 0)
+		pg_fatal("invalid number of parts in pgbench_parts: \"%s\"",
+				 PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	/* warn if we override user-given -s switch */
+	if (scale_given)
+		pg_log_warning("scale option ignored, using count from pgbench_parts table (%d)",
+					   scale);
+}
+
 /*
  * Replace :param with $n throughout the command's SQL text, which
  * is a modifiable string in cmd->lines.
@@ -6227,6 +6818,8 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 				stdev;
 	char		tbuf[315];
 	StatsData	cur;
+	static LatencyHistogram *last_hist = NULL;
+	LatencyHistogram *cur_hist = NULL;
 
 	/*
 	 * Add up the statistics of all threads.
@@ -6252,6 +6845,20 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 		cur.deadlock_failures += threads[i].stats.deadlock_failures;
 	}
 
+	/*
+	 * Likewise for the latency histograms, if we have them.  The percentiles
+	 * are computed from the difference with the previous report, which gives
+	 * the distribution of the latencies within this interval.
+	 */
+	if (latency_percentiles)
+	{
+		cur_hist = pg_malloc0(sizeof(LatencyHistogram));
+		if (last_hist == NULL)
+			last_hist = pg_malloc0(sizeof(LatencyHistogram));
+		for (int i = 0; i < nthreads; i++)
+			mergeLatencyHistogram(cur_hist, threads[i].latency_hist);
+	}
+
 	/* we count only actually executed transactions */
 	cnt = cur.cnt - last->cnt;
 	total_run = (now - test_start) / 1000000.0;
@@ -6285,6 +6892,24 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 			"progress: %s, %.1f tps, lat %.3f ms stddev %.3f, " INT64_FORMAT " failed",
 			tbuf, tps, latency, stdev, failures);
 
+	if (cur_hist)
+	{
+		LatencyHistogram *interval = last_hist;
+
+		/* turn last_hist into this interval's histogram */
+		interval->count = cur_hist->count - last_hist->count;
+		interval->max = cur_hist->max;
+		for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+			interval->buckets[i] = cur_hist->buckets[i] - last_hist->buckets[i];
+
+		fprintf(stderr, ", p99 %.3f ms, p99.9 %.3f ms",
+				0.001 * getLatencyPercentile(interval, 99.0),
+				0.001 * getLatencyPercentile(interval, 99.9));
+
+		pg_free(last_hist);
+		last_hist = cur_hist;
+	}
+
 	if (throttle_delay)
 	{
 		fprintf(stderr, ", lag %.3f ms", lag);
@@ -6354,7 +6979,7 @@ printResults(StatsData *total,
 			 pg_time_usec_t total_duration, /* benchmarking time */
 			 pg_time_usec_t conn_total_duration,	/* is_connect */
 			 pg_time_usec_t conn_elapsed_duration,	/* !is_connect */
-			 int64 latency_late)
+			 int64 latency_late, LatencyHistogram *latency_hist)
 {
 	/* tps is about actually executed transactions during benchmarking */
 	int64		failures = getFailures(total);
@@ -6424,7 +7049,7 @@ printResults(StatsData *total,
 			   latency_limit / 1000.0, latency_late, total->cnt,
 			   (total->cnt > 0) ? 100.0 * latency_late / total->cnt : 0.0);
 
-	if (throttle_delay || progress || latency_limit)
+	if (throttle_delay || progress || latency_limit || latency_percentiles)
 		printSimpleStats("latency", &total->latency);
 	else
 	{
@@ -6446,6 +7071,17 @@ printResults(StatsData *total,
 			   0.001 * total->lag.sum / total->cnt, 0.001 * total->lag.max);
 	}
 
+	if (latency_hist && latency_hist->count > 0)
+	{
+		static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+		printf("latency percentiles:");
+		for (int i = 0; i < lengthof(percentiles); i++)
+			printf("%s p%g = %.3f ms", i > 0 ? "," : "", percentiles[i],
+				   0.001 * getLatencyPercentile(latency_hist, percentiles[i]));
+		printf(", max = %.3f ms\n", 0.001 * latency_hist->max);
+	}
+
 	/*
 	 * Under -C/--connect, each transaction incurs a significant connection
 	 * cost, it would not make much sense to ignore it in tps, and it would
@@ -6663,6 +7299,8 @@ main(int argc, char **argv)
 		{"verbose-errors", no_argument, NULL, 15},
 		{"exit-on-abort", no_argument, NULL, 16},
 		{"debug", no_argument, NULL, 17},
+		{"latency-percentiles", no_argument, NULL, 18},
+		{"init-jobs", required_argument, NULL, 19},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -6678,6 +7316,7 @@ main(int argc, char **argv)
 	bool		benchmarking_option_set = false;
 	bool		initialization_option_set = false;
 	bool		internal_script_used = false;
+	bool		analytical_script_used = false;
 
 	CState	   *state;			/* status of clients */
 	TState	   *threads;		/* array of thread */
@@ -6689,6 +7328,7 @@ main(int argc, char **argv)
 										 * threads */
 	int64		latency_late = 0;
 	StatsData	stats;
+	LatencyHistogram *latency_hist = NULL;
 	int			weight;
 
 	int			i;
@@ -6746,10 +7386,18 @@ main(int argc, char **argv)
 					listAvailableScripts();
 					exit(0);
 				}
-				weight = parseScriptWeight(optarg, &script);
-				process_builtin(findBuiltin(script), weight);
-				benchmarking_option_set = true;
-				internal_script_used = true;
+				{
+					const BuiltinScript *bi;
+
+					weight = parseScriptWeight(optarg, &script);
+					bi = findBuiltin(script);
+					process_builtin(bi, weight);
+					benchmarking_option_set = true;
+					if (bi->analytical)
+						analytical_script_used = true;
+					else
+						internal_script_used = true;
+				}
 				break;
 			case 'c':
 				benchmarking_option_set = true;
@@ -7003,6 +7651,16 @@ main(int argc, char **argv)
 			case 17:			/* debug */
 				pg_logging_increase_verbosity();
 				break;
+			case 18:			/* latency-percentiles */
+				benchmarking_option_set = true;
+				latency_percentiles = true;
+				break;
+			case 19:			/* init-jobs */
+				initialization_option_set = true;
+				if (!option_parse_int(optarg, "--init-jobs", 1, INT_MAX,
+									  &init_jobs))
+					exit(1);
+				break;
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -7216,6 +7874,8 @@ main(int argc, char **argv)
 
 	if (internal_script_used)
 		GetTableInfo(con, scale_given);
+	else if (analytical_script_used)
+		GetAnalyticalTableInfo(con, scale_given);
 
 	/*
 	 * :scale variables normally get -s or database scale, but don't override
@@ -7261,7 +7921,8 @@ main(int argc, char **argv)
 				exit(1);
 	}
 
-	if (!is_no_vacuum)
+	/* the standard tables needn't exist if only analytical scripts are used */
+	if (!is_no_vacuum && !(analytical_script_used && !internal_script_used))
 	{
 		fprintf(stderr, "starting vacuum...");
 		tryExecuteStatement(con, "vacuum pgbench_branches");
@@ -7296,6 +7957,8 @@ main(int argc, char **argv)
 		thread->logfile = NULL; /* filled in later */
 		thread->latency_late = 0;
 		initStats(&thread->stats, 0);
+		thread->latency_hist = latency_percentiles ?
+			pg_malloc0(sizeof(LatencyHistogram)) : NULL;
 
 		nclients_dealt += thread->nstate;
 	}
@@ -7336,6 +7999,8 @@ main(int argc, char **argv)
 
 	/* wait for other threads and accumulate results */
 	initStats(&stats, 0);
+	if (latency_percentiles)
+		latency_hist = pg_malloc0(sizeof(LatencyHistogram));
 	conn_total_duration = 0;
 
 	for (i = 0; i < nthreads; i++)
@@ -7359,6 +8024,8 @@ main(int argc, char **argv)
 		stats.serialization_failures += thread->stats.serialization_failures;
 		stats.deadlock_failures += thread->stats.deadlock_failures;
 		latency_late += thread->latency_late;
+		if (latency_hist)
+			mergeLatencyHistogram(latency_hist, thread->latency_hist);
 		conn_total_duration += thread->conn_duration;
 
 		/* first recorded benchmarking start time */
@@ -7381,7 +8048,7 @@ main(int argc, char **argv)
 	 * underestimated.
 	 */
 	printResults(&stats, pg_time_now() - bench_start, conn_total_duration,
-				 bench_start - start_time, latency_late);
+				 bench_start - start_time, latency_late, latency_hist);
 
 	THREAD_BARRIER_DESTROY(&barrier);
 
@@ -7750,11 +8417,13 @@ setalarm(int seconds)
  * These functions provide an abstraction layer that hides the syscall
  * we use to wait for input on a set of sockets.
  *
- * Currently there are two implementations, based on ppoll(2) and select(2).
- * ppoll() is preferred where available due to its typically higher ceiling
- * on the number of usable sockets.  We do not use the more-widely-available
- * poll(2) because it only offers millisecond timeout resolution, which could
- * be problematic with high --rate settings.
+ * Currently there are three implementations, based on epoll(7), ppoll(2) and
+ * select(2).  epoll is preferred where available, because its cost doesn't
+ * grow with the number of clients waiting for a result; failing that,
+ * ppoll() is preferred due to its typically higher ceiling on the number of
+ * usable sockets.  We do not use the more-widely-available poll(2) because it
+ * only offers millisecond timeout resolution, which could be problematic with
+ * high --rate settings.
  *
  * Function APIs:
  *
@@ -7781,6 +8450,142 @@ setalarm(int seconds)
  * and add_socket_to_set again before waiting again.
  */
 
+#ifdef POLL_USING_EPOLL
+
+/*
+ * The epoll implementation keeps sockets registered across waits, so that a
+ * wait costs time proportional to the number of sockets that become ready
+ * rather than to the number of sockets waited on.  Sockets are registered
+ * with EPOLLONESHOT: once a socket has reported input, it is disabled until
+ * it is added to the set again.  Since clients only stop waiting on their
+ * socket after it has reported input, this means that a socket that is not
+ * added to the set after a clear can never make us wake up spuriously.
+ *
+ * epoll_wait() only offers millisecond timeout resolution, so when a timeout
+ * is given, we wait for the epoll descriptor itself to become readable with
+ * ppoll() first.
+ */
+static socket_set *
+alloc_socket_set(int count)
+{
+	socket_set *sa;
+
+	sa = (socket_set *) pg_malloc0(sizeof(socket_set));
+	sa->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (sa->epfd < 0)
+		pg_fatal("epoll_create1() failed: %m");
+	sa->maxevents = Max(count, 1);
+	sa->events = (struct epoll_event *)
+		pg_malloc(sizeof(struct epoll_event) * sa->maxevents);
+	return sa;
+}
+
+static void
+free_socket_set(socket_set *sa)
+{
+	close(sa->epfd);
+	pg_free(sa->events);
+	pg_free(sa->armed);
+	pg_free(sa->ready);
+	pg_free(sa);
+}
+
+static void
+clear_socket_set(socket_set *sa)
+{
+	for (int i = 0; i < sa->nevents; i++)
+		sa->ready[sa->events[i].data.fd] = false;
+	sa->nevents = 0;
+	sa->curfds = 0;
+}
+
+static void
+add_socket_to_set(socket_set *sa, int fd, int idx)
+{
+	struct epoll_event ev;
+
+	Assert(idx < sa->maxevents && idx == sa->curfds);
+	sa->curfds++;
+
+	if (fd >= sa->fdlen)
+	{
+		int			newlen = Max(fd + 1, sa->fdlen * 2);
+
+		sa->armed = pg_realloc(sa->armed, newlen * sizeof(bool));
+		sa->ready = pg_realloc(sa->ready, newlen * sizeof(bool));
+		memset(sa->armed + sa->fdlen, 0, (newlen - sa->fdlen) * sizeof(bool));
+		memset(sa->ready + sa->fdlen, 0, (newlen - sa->fdlen) * sizeof(bool));
+		sa->fdlen = newlen;
+	}
+
+	if (sa->armed[fd])
+		return;
+
+	/*
+	 * Re-enable the socket.  If it's not registered, because it has never
+	 * been or because it was closed and its descriptor reused for a new
+	 * connection, register it.
+	 */
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = fd;
+	if (epoll_ctl(sa->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+	{
+		if (errno != ENOENT || epoll_ctl(sa->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+			pg_fatal("epoll_ctl() failed: %m");
+	}
+	sa->armed[fd] = true;
+}
+
+static int
+wait_on_socket_set(socket_set *sa, int64 usecs)
+{
+	int			rc;
+
+	if (usecs > 0)
+	{
+		struct pollfd pfd;
+		struct timespec timeout;
+
+		pfd.fd = sa->epfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		timeout.tv_sec = usecs / 1000000;
+		timeout.tv_nsec = (usecs % 1000000) * 1000;
+		rc = ppoll(&pfd, 1, &timeout, NULL);
+		if (rc <= 0)
+			return rc;
+		rc = epoll_wait(sa->epfd, sa->events, sa->maxevents, 0);
+	}
+	else
+		rc = epoll_wait(sa->epfd, sa->events, sa->maxevents, -1);
+
+	if (rc > 0)
+	{
+		sa->nevents = rc;
+		for (int i = 0; i < rc; i++)
+		{
+			int			fd = sa->events[i].data.fd;
+
+			/* EPOLLONESHOT disabled the socket */
+			sa->armed[fd] = false;
+			sa->ready[fd] = true;
+		}
+	}
+	return rc;
+}
+
+static bool
+socket_has_input(socket_set *sa, int fd, int idx)
+{
+	/* See the ppoll implementation for why an empty set is special */
+	if (sa->curfds == 0 || fd >= sa->fdlen)
+		return false;
+
+	return sa->ready[fd];
+}
+
+#endif							/* POLL_USING_EPOLL */
+
 #ifdef POLL_USING_PPOLL
 
 static socket_set *
@@ -30,6 +30,12 @@
 #include "portability/instr_time.h"
 #include "settings.h"
 
+/*
+ * Chunk size used to stream results to a file when FETCH_COUNT is not set;
+ * see ExecQueryAndProcessResults.
+ */
+#define STREAM_FETCH_COUNT 1000
+
 static bool DescribeQuery(const char *query, double *elapsed_msec);
 static int	ExecQueryAndProcessResults(const char *query,
 									   double *elapsed_msec,
@@ -1463,6 +1469,7 @@ ExecQueryAndProcessResults(const char *query,
 	PGresult   *result;
 	FILE	   *gfile_fout = NULL;
 	bool		gfile_is_pipe = false;
+	int			fetch_count = pset.fetch_count;
 
 	if (timing)
 		INSTR_TIME_SET_CURRENT(before);
@@ -1502,12 +1509,25 @@ ExecQueryAndProcessResults(const char *query,
 	 *
 	 * * We're doing \watch: users probably don't want us to force use of the
 	 * pager for that, plus chunking could break the min_rows check.
+	 *
+	 * Even without FETCH_COUNT, stream the result when it goes to a file or
+	 * pipe (from \g or \o) in unaligned or CSV format.  Those formats print
+	 * each row by itself, so the output is the same as if we had collected
+	 * the whole result first, but memory use no longer grows with its size.
 	 */
-	if (pset.fetch_count > 0 && pset.show_all_results &&
+	if (fetch_count <= 0 && (pset.gfname || pset.queryFout != stdout))
+	{
+		enum printFormat format = opt ? opt->topt.format : pset.popt.topt.format;
+
+		if (format == PRINT_UNALIGNED || format == PRINT_CSV)
+			fetch_count = STREAM_FETCH_COUNT;
+	}
+
+	if (fetch_count > 0 && pset.show_all_results &&
 		!pset.crosstab_flag && !pset.gexec_flag &&
 		!pset.gset_prefix && !is_watch)
 	{
-		if (!PQsetChunkedRowsMode(pset.db, pset.fetch_count))
+		if (!PQsetChunkedRowsMode(pset.db, fetch_count))
 			pg_log_warning("fetching results in chunked mode failed");
 	}
 
@@ -0,0 +1,524 @@
+/*-------------------------------------------------------------------------
+ *
+ * compress_stream.c
+ *	  Streaming compression of network traffic with LZ4 or zstd.
+ *
+ * A compressor turns a sequence of chunks of data into one continuous
+ * compressed stream: its state carries over from one chunk to the next, so
+ * that matches can refer back to earlier data, but the output produced for
+ * each chunk is flushed, so that the peer can reconstruct everything sent so
+ * far from what it has received so far.  This suits protocols where data is
+ * compressed whenever it is about to be written to a socket.
+ *
+ * The code is shared by the backend and libpq.  Since libpq must never exit
+ * on its own, nothing here reports errors through elog() or exits on
+ * allocation failure: functions return NULL or false instead, and a
+ * description of the problem is available through the *_error() functions.
+ * Memory is managed with plain malloc() for the same reason, and nothing
+ * from common/compression.c is used beyond the algorithm enum, since that
+ * code allocates with palloc().
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  src/common/compress_stream.c
+ *-------------------------------------------------------------------------
+ */
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "common/compress_stream.h"
+
+/*
+ * LZ4F_HEADER_SIZE_MAX first appeared in v1.7.5 of the library.
+ */
+#if defined(USE_LZ4) && !defined(LZ4F_HEADER_SIZE_MAX)
+#define LZ4F_HEADER_SIZE_MAX	32
+#endif
+
+/* Minimum amount of free output space to offer per (de)compression call */
+#define STREAM_OUTPUT_CHUNK_SIZE	(64 * 1024)
+
+/* Growable output buffer, reused from one call to the next */
+typedef struct StreamBuffer
+{
+	char	   *data;
+	size_t		len;
+	size_t		size;
+} StreamBuffer;
+
+struct pg_stream_compressor
+{
+	pg_compress_algorithm algorithm;
+	StreamBuffer out;
+	const char *error;
+#ifdef USE_LZ4
+	LZ4F_compressionContext_t lz4_ctx;
+	LZ4F_preferences_t lz4_prefs;
+	bool		lz4_begun;		/* has the frame header been emitted? */
+#endif
+#ifdef USE_ZSTD
+	ZSTD_CCtx  *zstd_ctx;
+#endif
+};
+
+struct pg_stream_decompressor
+{
+	pg_compress_algorithm algorithm;
+	StreamBuffer out;
+	const char *error;
+#ifdef USE_LZ4
+	LZ4F_decompressionContext_t lz4_ctx;
+#endif
+#ifdef USE_ZSTD
+	ZSTD_DCtx  *zstd_ctx;
+#endif
+};
+
+static const char *oom_error = "out of memory";
+
+#if defined(USE_LZ4) || defined(USE_ZSTD)
+/*
+ * Make sure there are at least 'needed' bytes of free space after the
+ * current contents of 'buf'.  Returns false if out of memory.
+ */
+static bool
+stream_buffer_reserve(StreamBuffer *buf, size_t needed)
+{
+	size_t		newsize;
+	char	   *newdata;
+
+	if (buf->size - buf->len >= needed)
+		return true;
+
+	newsize = Max(buf->size, STREAM_OUTPUT_CHUNK_SIZE);
+	while (newsize - buf->len < needed)
+		newsize *= 2;
+
+	newdata = realloc(buf->data, newsize);
+	if (newdata == NULL)
+		return false;
+	buf->data = newdata;
+	buf->size = newsize;
+	return true;
+}
+#endif
+
+/*
+ * Is streaming compression with the given algorithm available in this build?
+ */
+bool
+pg_stream_compress_supported(pg_compress_algorithm algorithm)
+{
+	switch (algorithm)
+	{
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			return true;
+#else
+			return false;
+#endif
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			return true;
+#else
+			return false;
+#endif
+		default:
+			return false;
+	}
+}
+
+/*
+ * Look up a stream compression algorithm by name.  Returns false if the name
+ * is not that of an algorithm usable for streaming in this build.
+ */
+bool
+pg_stream_compress_algorithm_by_name(const char *name,
+									 pg_compress_algorithm *algorithm)
+{
+	if (strcmp(name, "lz4") == 0)
+		*algorithm = PG_COMPRESSION_LZ4;
+	else if (strcmp(name, "zstd") == 0)
+		*algorithm = PG_COMPRESSION_ZSTD;
+	else
+		return false;
+
+	return pg_stream_compress_supported(*algorithm);
+}
+
+/*
+ * Set up a compressor for the given algorithm.  A level of 0 selects the
+ * library's default compression level.  Returns NULL and sets *errormsg on
+ * failure.
+ */
+pg_stream_compressor *
+pg_stream_compressor_create(pg_compress_algorithm algorithm, int level,
+							const char **errormsg)
+{
+	pg_stream_compressor *cs;
+
+	if (!pg_stream_compress_supported(algorithm))
+	{
+		*errormsg = "compression algorithm not supported for streaming by this build";
+		return NULL;
+	}
+
+	cs = calloc(1, sizeof(pg_stream_compressor));
+	if (cs == NULL)
+	{
+		*errormsg = oom_error;
+		return NULL;
+	}
+	cs->algorithm = algorithm;
+
+#ifdef USE_LZ4
+	if (algorithm == PG_COMPRESSION_LZ4)
+	{
+		LZ4F_errorCode_t ctxError;
+
+		cs->lz4_prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+		cs->lz4_prefs.compressionLevel = level;
+		cs->lz4_prefs.autoFlush = 1;
+
+		ctxError = LZ4F_createCompressionContext(&cs->lz4_ctx, LZ4F_VERSION);
+		if (LZ4F_isError(ctxError))
+		{
+			*errormsg = LZ4F_getErrorName(ctxError);
+			free(cs);
+			return NULL;
+		}
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (algorithm == PG_COMPRESSION_ZSTD)
+	{
+		size_t		ret;
+
+		cs->zstd_ctx = ZSTD_createCCtx();
+		if (!cs->zstd_ctx)
+		{
+			*errormsg = "could not create zstd compression context";
+			free(cs);
+			return NULL;
+		}
+
+		ret = ZSTD_CCtx_setParameter(cs->zstd_ctx, ZSTD_c_compressionLevel,
+									 level);
+		if (ZSTD_isError(ret))
+		{
+			*errormsg = ZSTD_getErrorName(ret);
+			ZSTD_freeCCtx(cs->zstd_ctx);
+			free(cs);
+			return NULL;
+		}
+	}
+#endif
+
+	return cs;
+}
+
+/*
+ * Compress 'len' bytes at 'data'.
+ *
+ * On success, *out and *outlen are set to the compressed data, which stays
+ * valid until the next call.  All of the input is flushed out, so the peer
+ * can reconstruct it from the output of this and all previous calls.
+ */
+bool
+pg_stream_compress(pg_stream_compressor *cs, const char *data, size_t len,
+				   const char **out, size_t *outlen)
+{
+	StreamBuffer *buf = &cs->out;
+
+	buf->len = 0;
+
+#ifdef USE_LZ4
+	if (cs->algorithm == PG_COMPRESSION_LZ4)
+	{
+		size_t		bound;
+		size_t		nbytes;
+
+		if (!cs->lz4_begun)
+		{
+			if (!stream_buffer_reserve(buf, LZ4F_HEADER_SIZE_MAX))
+			{
+				cs->error = oom_error;
+				return false;
+			}
+			nbytes = LZ4F_compressBegin(cs->lz4_ctx, buf->data,
+										LZ4F_HEADER_SIZE_MAX,
+										&cs->lz4_prefs);
+			if (LZ4F_isError(nbytes))
+			{
+				cs->error = LZ4F_getErrorName(nbytes);
+				return false;
+			}
+			buf->len += nbytes;
+			cs->lz4_begun = true;
+		}
+
+		/* autoFlush means that nothing is left behind in the context */
+		bound = LZ4F_compressBound(len, &cs->lz4_prefs);
+		if (!stream_buffer_reserve(buf, bound))
+		{
+			cs->error = oom_error;
+			return false;
+		}
+		nbytes = LZ4F_compressUpdate(cs->lz4_ctx, buf->data + buf->len, bound,
+									 data, len, NULL);
+		if (LZ4F_isError(nbytes))
+		{
+			cs->error = LZ4F_getErrorName(nbytes);
+			return false;
+		}
+		buf->len += nbytes;
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (cs->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ZSTD_inBuffer inBuf = {data, len, 0};
+		size_t		yet_to_flush;
+
+		do
+		{
+			ZSTD_outBuffer outBuf;
+
+			if (!stream_buffer_reserve(buf, ZSTD_CStreamOutSize()))
+			{
+				cs->error = oom_error;
+				return false;
+			}
+			outBuf.dst = buf->data + buf->len;
+			outBuf.size = buf->size - buf->len;
+			outBuf.pos = 0;
+
+			yet_to_flush = ZSTD_compressStream2(cs->zstd_ctx, &outBuf, &inBuf,
+												ZSTD_e_flush);
+			if (ZSTD_isError(yet_to_flush))
+			{
+				cs->error = ZSTD_getErrorName(yet_to_flush);
+				return false;
+			}
+			buf->len += outBuf.pos;
+		} while (yet_to_flush > 0);
+	}
+#endif
+
+	*out = buf->data;
+	*outlen = buf->len;
+	return true;
+}
+
+/*
+ * Describe the reason why the last pg_stream_compress() call failed.
+ */
+const char *
+pg_stream_compressor_error(pg_stream_compressor *cs)
+{
+	return cs->error ? cs->error : "unknown error";
+}
+
+/*
+ * Release the resources held by a compressor.
+ */
+void
+pg_stream_compressor_free(pg_stream_compressor *cs)
+{
+#ifdef USE_LZ4
+	if (cs->algorithm == PG_COMPRESSION_LZ4)
+		LZ4F_freeCompressionContext(cs->lz4_ctx);
+#endif
+#ifdef USE_ZSTD
+	if (cs->algorithm == PG_COMPRESSION_ZSTD)
+		ZSTD_freeCCtx(cs->zstd_ctx);
+#endif
+	free(cs->out.data);
+	free(cs);
+}
+
+/*
+ * Set up decompression of a stream compressed with 'algorithm'.  Returns
+ * NULL and sets *errormsg on failure.
+ */
+pg_stream_decompressor *
+pg_stream_decompressor_create(pg_compress_algorithm algorithm,
+							  const char **errormsg)
+{
+	pg_stream_decompressor *ds;
+
+	if (!pg_stream_compress_supported(algorithm))
+	{
+		*errormsg = "compression algorithm not supported for streaming by this build";
+		return NULL;
+	}
+
+	ds = calloc(1, sizeof(pg_stream_decompressor));
+	if (ds == NULL)
+	{
+		*errormsg = oom_error;
+		return NULL;
+	}
+	ds->algorithm = algorithm;
+
+#ifdef USE_LZ4
+	if (algorithm == PG_COMPRESSION_LZ4)
+	{
+		LZ4F_errorCode_t ctxError;
+
+		ctxError = LZ4F_createDecompressionContext(&ds->lz4_ctx, LZ4F_VERSION);
+		if (LZ4F_isError(ctxError))
+		{
+			*errormsg = LZ4F_getErrorName(ctxError);
+			free(ds);
+			return NULL;
+		}
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ds->zstd_ctx = ZSTD_createDCtx();
+		if (!ds->zstd_ctx)
+		{
+			*errormsg = "could not create zstd decompression context";
+			free(ds);
+			return NULL;
+		}
+	}
+#endif
+
+	return ds;
+}
+
+/*
+ * Decompress the 'len' bytes at 'data', which can be any part of the stream,
+ * not necessarily the complete output of one pg_stream_compress() call.
+ *
+ * On success, *out and *outlen are set to the data reconstructed from the
+ * input, which stays valid until the next call.  *outlen can be zero if the
+ * input ended in the middle of a compressed block.
+ */
+bool
+pg_stream_decompress(pg_stream_decompressor *ds, const char *data, size_t len,
+					 const char **out, size_t *outlen)
+{
+	StreamBuffer *buf = &ds->out;
+
+	buf->len = 0;
+
+#ifdef USE_LZ4
+	if (ds->algorithm == PG_COMPRESSION_LZ4)
+	{
+		for (;;)
+		{
+			size_t		avail;
+			size_t		out_size;
+			size_t		in_size = len;
+			size_t		ret;
+
+			if (!stream_buffer_reserve(buf, STREAM_OUTPUT_CHUNK_SIZE))
+			{
+				ds->error = oom_error;
+				return false;
+			}
+			avail = buf->size - buf->len;
+			out_size = avail;
+
+			ret = LZ4F_decompress(ds->lz4_ctx, buf->data + buf->len, &out_size,
+								  data, &in_size, NULL);
+			if (LZ4F_isError(ret))
+			{
+				ds->error = LZ4F_getErrorName(ret);
+				return false;
+			}
+			buf->len += out_size;
+			data += in_size;
+			len -= in_size;
+
+			/* Done once all input is consumed and no output is pending */
+			if (len == 0 && out_size < avail)
+				break;
+		}
+	}
+#endif
+
+#ifdef USE_ZSTD
+	if (ds->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ZSTD_inBuffer inBuf = {data, len, 0};
+
+		for (;;)
+		{
+			ZSTD_outBuffer outBuf;
+			size_t		ret;
+
+			if (!stream_buffer_reserve(buf, STREAM_OUTPUT_CHUNK_SIZE))
+			{
+				ds->error = oom_error;
+				return false;
+			}
+			outBuf.dst = buf->data + buf->len;
+			outBuf.size = buf->size - buf->len;
+			outBuf.pos = 0;
+
+			ret = ZSTD_decompressStream(ds->zstd_ctx, &outBuf, &inBuf);
+			if (ZSTD_isError(ret))
+			{
+				ds->error = ZSTD_getErrorName(ret);
+				return false;
+			}
+			buf->len += outBuf.pos;
+
+			/* Done once all input is consumed and no output is pending */
+			if (inBuf.pos == inBuf.size && outBuf.pos < outBuf.size)
+				break;
+		}
+	}
+#endif
+
+	*out = buf->data;
+	*outlen = buf->len;
+	return true;
+}
+
+/*
+ * Describe the reason why the last pg_stream_decompress() call failed.
+ */
+const char *
+pg_stream_decompressor_error(pg_stream_decompressor *ds)
+{
+	return ds->error ? ds->error : "unknown error";
+}
+
+/*
+ * Release the resources held by a decompressor.
+ */
+void
+pg_stream_decompressor_free(pg_stream_decompressor *ds)
+{
+#ifdef USE_LZ4
+	if (ds->algorithm == PG_COMPRESSION_LZ4)
+		LZ4F_freeDecompressionContext(ds->lz4_ctx);
+#endif
+#ifdef USE_ZSTD
+	if (ds->algorithm == PG_COMPRESSION_ZSTD)
+		ZSTD_freeDCtx(ds->zstd_ctx);
+#endif
+	free(ds->out.data);
+	free(ds);
+}
@@ -113,6 +113,15 @@ typedef bool (*aminsert_function) (Relation indexRelation,
 								   bool indexUnchanged,
 								   struct IndexInfo *indexInfo);
 
+/* insert a batch of tuples, without uniqueness checks */
+typedef void (*aminsertbatch_function) (Relation indexRelation,
+										Datum **values,
+										bool **isnull,
+										ItemPointer heap_tids,
+										int ntuples,
+										Relation heapRelation,
+										struct IndexInfo *indexInfo);
+
 /* cleanup after insert */
 typedef void (*aminsertcleanup_function) (Relation indexRelation,
 										  struct IndexInfo *indexInfo);
@@ -123,6 +132,11 @@ typedef IndexBulkDeleteResult *(*ambulkdelete_function) (IndexVacuumInfo *info,
 														 IndexBulkDeleteCallback callback,
 														 void *callback_state);
 
+/* retail deletion of given index tuples */
+typedef bool (*amretaildelete_function) (IndexVacuumInfo *info,
+										 struct IndexTupleData **itups,
+										 int nitups);
+
 /* post-VACUUM cleanup */
 typedef IndexBulkDeleteResult *(*amvacuumcleanup_function) (IndexVacuumInfo *info,
 															IndexBulkDeleteResult *stats);
@@ -267,8 +281,10 @@ typedef struct IndexAmRoutine
 	ambuild_function ambuild;
 	ambuildempty_function ambuildempty;
 	aminsert_function aminsert;
+	aminsertbatch_function aminsertbatch;	/* can be NULL */
 	aminsertcleanup_function aminsertcleanup;
 	ambulkdelete_function ambulkdelete;
+	amretaildelete_function amretaildelete; /* can be NULL */
 	amvacuumcleanup_function amvacuumcleanup;
 	amcanreturn_function amcanreturn;	/* can be NULL */
 	amcostestimate_function amcostestimate;
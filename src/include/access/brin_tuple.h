@@ -108,5 +108,8 @@ extern BrinMemTuple *brin_memtuple_initialize(BrinMemTuple *dtuple,
 											  BrinDesc *brdesc);
 extern BrinMemTuple *brin_deform_tuple(BrinDesc *brdesc,
 									   BrinTuple *tuple, BrinMemTuple *dMemtuple);
+extern BrinMemTuple *brin_deform_tuple_nocopy(BrinDesc *brdesc,
+											  BrinTuple *tuple,
+											  BrinMemTuple *dMemtuple);
 
 #endif							/* BRIN_TUPLE_H */
@@ -0,0 +1,227 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar.h
+ *	  POSTGRES columnar table access method definitions.
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/columnar.h
+ *
+ * NOTES
+ *	  See src/backend/access/columnar/README for a description of the
+ *	  storage format.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "access/htup_details.h"
+#include "access/skey.h"
+#include "executor/tuptable.h"
+#include "storage/block.h"
+#include "storage/bufmgr.h"
+#include "storage/itemptr.h"
+#include "utils/relcache.h"
+#include "utils/snapshot.h"
+
+/*
+ * Block 0 of a columnar table is the metapage.  It's only created when the
+ * first rows are written, so an empty table has no blocks at all.
+ */
+#define COLUMNAR_METAPAGE_BLKNO		0
+
+#define COLUMNAR_MAGIC				0x434F4C52
+#define COLUMNAR_VERSION			1
+
+typedef struct ColumnarMetaPageData
+{
+	uint32		magic;
+	uint32		version;
+	BlockNumber dir_first;		/* first directory page */
+	BlockNumber dir_last;		/* last directory page, for appending */
+	uint64		next_row;		/* next row number to hand out */
+} ColumnarMetaPageData;
+
+#define ColumnarPageGetMeta(page) \
+	((ColumnarMetaPageData *) PageGetContents(page))
+
+/*
+ * Each stripe holds a run of consecutive row numbers, all inserted by the
+ * same (sub)transaction and command.  The directory is an append-only array
+ * of these entries, spread over a chain of directory pages.
+ *
+ * The row numbers of a stripe are reserved as soon as its first row is
+ * inserted, so that the rows can be given TIDs and be indexed right away.
+ * Until the stripe is written, the entry is marked COLUMNAR_STRIPE_RESERVED
+ * and nrows is the number of row numbers reserved.
+ */
+typedef struct ColumnarStripeEntry
+{
+	uint64		first_row;		/* row number of the first row */
+	uint32		nrows;			/* number of rows */
+	TransactionId xmin;			/* inserting transaction */
+	CommandId	cid;			/* inserting command */
+	BlockNumber start_block;	/* first block of the stripe's data */
+	uint32		nblocks;		/* number of blocks of data */
+	uint16		flags;
+} ColumnarStripeEntry;
+
+#define COLUMNAR_STRIPE_RESERVED	0x0001	/* data not written yet */
+#define COLUMNAR_STRIPE_INVALID		0x0002	/* inserter aborted */
+
+/* special space of directory pages */
+typedef struct ColumnarDirPageOpaqueData
+{
+	BlockNumber next;			/* next directory page, or InvalidBlockNumber */
+	uint16		nentries;		/* number of entries used on this page */
+	uint16		page_id;		/* for identification of columnar pages */
+} ColumnarDirPageOpaqueData;
+
+typedef ColumnarDirPageOpaqueData *ColumnarDirPageOpaque;
+
+#define COLUMNAR_DIR_PAGE_ID		0xFF91
+
+#define ColumnarPageGetDirOpaque(page) \
+	((ColumnarDirPageOpaque) PageGetSpecialPointer(page))
+
+#define ColumnarPageGetDirEntries(page) \
+	((ColumnarStripeEntry *) PageGetContents(page))
+
+#define COLUMNAR_DIR_ENTRIES_PER_PAGE \
+	((BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - \
+	  MAXALIGN(sizeof(ColumnarDirPageOpaqueData))) / \
+	 sizeof(ColumnarStripeEntry))
+
+/*
+ * The data of a stripe is a stream of bytes, stored in consecutive blocks
+ * right after the page header.  It starts with a ColumnarStripeHeader,
+ * followed by one chunk per column.
+ */
+#define COLUMNAR_BYTES_PER_PAGE		(BLCKSZ - MAXALIGN(SizeOfPageHeaderData))
+
+/*
+ * A chunk is a varlena, possibly compressed.  Once decompressed, it holds a
+ * null bitmap if the column has any nulls, followed by the non-null values,
+ * aligned and laid out the same way as the attributes of a heap tuple.
+ *
+ * min and max are only kept for pass-by-value types with a btree ordering.
+ */
+typedef struct ColumnarChunkInfo
+{
+	uint32		offset;			/* offset of the chunk in the stripe */
+	uint32		size;			/* stored size of the chunk */
+	uint32		nnulls;			/* number of null values */
+	bool		has_minmax;		/* are min and max set? */
+	Datum		min;
+	Datum		max;
+} ColumnarChunkInfo;
+
+typedef struct ColumnarStripeHeader
+{
+	uint32		natts;			/* number of chunks */
+	uint32		nrows;
+	ColumnarChunkInfo chunks[FLEXIBLE_ARRAY_MEMBER];
+} ColumnarStripeHeader;
+
+#define SizeOfColumnarStripeHeader(natts) \
+	MAXALIGN(offsetof(ColumnarStripeHeader, chunks) + \
+			 (natts) * sizeof(ColumnarChunkInfo))
+
+/*
+ * Rows are identified by their row number, which is mapped to a TID as if
+ * rows were stored MaxHeapTuplesPerPage to a block.  Those TIDs have no
+ * relationship with the blocks the data is stored in.
+ */
+#define COLUMNAR_ROWS_PER_TID_BLOCK		MaxHeapTuplesPerPage
+#define COLUMNAR_MAX_ROW_NUMBER \
+	((uint64) MaxBlockNumber * COLUMNAR_ROWS_PER_TID_BLOCK)
+
+static inline void
+columnar_row_to_tid(uint64 row, ItemPointer tid)
+{
+	ItemPointerSet(tid, (BlockNumber) (row / COLUMNAR_ROWS_PER_TID_BLOCK),
+				   (OffsetNumber) (row % COLUMNAR_ROWS_PER_TID_BLOCK) + 1);
+}
+
+static inline uint64
+columnar_tid_to_row(ItemPointer tid)
+{
+	return (uint64) ItemPointerGetBlockNumberNoCheck(tid) *
+		COLUMNAR_ROWS_PER_TID_BLOCK +
+		ItemPointerGetOffsetNumberNoCheck(tid) - 1;
+}
+
+/*
+ * A stripe being read.  The columns are only decoded when needed, into
+ * memory belonging to cxt.
+ */
+typedef struct ColumnarStripe
+{
+	ColumnarStripeEntry entry;
+	ColumnarStripeHeader *header;
+	int			natts;			/* number of attributes in the relation */
+	bool	   *loaded;			/* which columns have been decoded? */
+	Datum	  **values;			/* per column, the values of all rows */
+	bool	  **isnull;
+	MemoryContext cxt;
+} ColumnarStripe;
+
+/* Rows buffered by a backend, before they are written as a stripe */
+typedef struct ColumnarWriteState ColumnarWriteState;
+
+/* columnar_storage.c */
+extern uint64 columnar_reserve_rows(Relation rel, uint32 nrows,
+									TransactionId xmin, CommandId cid,
+									BlockNumber *dirblock, uint16 *dirindex);
+extern void columnar_write_stripe(Relation rel, BlockNumber dirblock,
+								  uint16 dirindex, uint32 nrows,
+								  const char *data, Size len);
+extern ColumnarStripeEntry *columnar_read_directory(Relation rel,
+													int *nentries);
+extern void columnar_read_bytes(Relation rel,
+								const ColumnarStripeEntry *entry,
+								uint32 offset, uint32 len, char *dest,
+								BufferAccessStrategy strategy);
+extern bool columnar_stripe_visible(const ColumnarStripeEntry *entry,
+									Snapshot snapshot);
+extern int	columnar_find_stripe(const ColumnarStripeEntry *entries,
+								 int nentries, uint64 row);
+extern uint64 columnar_vacuum_directory(Relation rel,
+										TransactionId OldestXmin);
+
+/* columnar_reader.c */
+extern ColumnarStripe *columnar_begin_stripe(Relation rel,
+											 const ColumnarStripeEntry *entry,
+											 MemoryContext cxt,
+											 BufferAccessStrategy strategy);
+extern bool columnar_stripe_excluded(ColumnarStripe *stripe, int nkeys,
+									 ScanKey keys);
+extern void columnar_load_column(Relation rel, ColumnarStripe *stripe,
+								 int attoff, BufferAccessStrategy strategy);
+extern void columnar_stripe_fill_slot(Relation rel, ColumnarStripe *stripe,
+									  uint32 rowidx, const bool *needed,
+									  TupleTableSlot *slot,
+									  BufferAccessStrategy strategy);
+
+/* columnar_writer.c */
+extern ColumnarWriteState *columnar_begin_write(Relation rel,
+												TransactionId xmin,
+												CommandId cid);
+extern uint64 columnar_write_row(ColumnarWriteState *state, Relation rel,
+								 const Datum *values, const bool *isnull);
+extern void columnar_end_write(ColumnarWriteState *state, Relation rel);
+extern void columnar_insert(Relation rel, TupleTableSlot *slot,
+							CommandId cid);
+extern void columnar_flush_pending(Relation rel);
+extern void columnar_discard_pending(Relation rel);
+extern bool columnar_fetch_pending(Relation rel, uint64 row,
+								   TupleTableSlot *slot, CommandId *cid);
+extern void PreCommit_Columnar(void);
+extern void AtEOXact_Columnar(bool isCommit);
+extern void AtEOSubXact_Columnar(bool isCommit, SubTransactionId mySubid,
+								 SubTransactionId parentSubid);
+
+#endif							/* COLUMNAR_H */
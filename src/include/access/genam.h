@@ -149,6 +149,11 @@ extern bool index_insert(Relation indexRelation,
 						 IndexUniqueCheck checkUnique,
 						 bool indexUnchanged,
 						 struct IndexInfo *indexInfo);
+extern void index_insert_batch(Relation indexRelation,
+							   Datum **values, bool **isnull,
+							   ItemPointer heap_tids, int ntuples,
+							   Relation heapRelation,
+							   struct IndexInfo *indexInfo);
 extern void index_insert_cleanup(Relation indexRelation,
 								 struct IndexInfo *indexInfo);
 
@@ -186,6 +191,9 @@ extern IndexBulkDeleteResult *index_bulk_delete(IndexVacuumInfo *info,
 												IndexBulkDeleteResult *istat,
 												IndexBulkDeleteCallback callback,
 												void *callback_state);
+struct IndexTupleData;
+extern bool index_retail_delete(IndexVacuumInfo *info,
+								struct IndexTupleData **itups, int nitups);
 extern IndexBulkDeleteResult *index_vacuum_cleanup(IndexVacuumInfo *info,
 												   IndexBulkDeleteResult *istat);
 extern bool index_can_return(Relation indexRelation, int attno);
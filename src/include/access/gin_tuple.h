@@ -0,0 +1,67 @@
+/*--------------------------------------------------------------------------
+ * gin_tuple.h
+ *	  Declarations for the tuples used by parallel GIN index builds.
+ *
+ *	Copyright (c) 2006-2024, PostgreSQL Global Development Group
+ *
+ *	src/include/access/gin_tuple.h
+ *--------------------------------------------------------------------------
+ */
+#ifndef GIN_TUPLE_H
+#define GIN_TUPLE_H
+
+#include "access/ginblock.h"
+#include "storage/itemptr.h"
+#include "utils/sortsupport.h"
+
+/*
+ * A key and a sorted list of TIDs, passed from the workers of a parallel
+ * GIN index build to the leader through a tuplesort.  The header is followed
+ * by the key value (if category is GIN_CAT_NORM_KEY), starting at a
+ * MAXALIGN'd offset, and then by the TIDs, starting at a SHORTALIGN'd offset.
+ */
+typedef struct GinTuple
+{
+	int			tuplen;			/* length of the whole tuple */
+	OffsetNumber attrnum;		/* index attribute of the key */
+	GinNullCategory category;	/* category of the key */
+	bool		typbyval;		/* typbyval of the key */
+	int16		typlen;			/* typlen of the key */
+	int			keylen;			/* bytes of data used by the key */
+	int			nitems;			/* number of TIDs */
+} GinTuple;
+
+#define SizeOfGinTuple(keylen, nitems) \
+	(MAXALIGN(sizeof(GinTuple)) + SHORTALIGN(keylen) + \
+	 (nitems) * sizeof(ItemPointerData))
+
+static inline char *
+GinTupleGetKeyData(GinTuple *tup)
+{
+	return (char *) tup + MAXALIGN(sizeof(GinTuple));
+}
+
+static inline ItemPointer
+GinTupleGetItems(GinTuple *tup)
+{
+	return (ItemPointer) (GinTupleGetKeyData(tup) + SHORTALIGN(tup->keylen));
+}
+
+static inline Datum
+GinTupleGetKey(GinTuple *tup)
+{
+	Datum		key = (Datum) 0;
+
+	if (tup->category != GIN_CAT_NORM_KEY)
+		return key;
+	if (tup->typbyval)
+	{
+		memcpy(&key, GinTupleGetKeyData(tup), sizeof(Datum));
+		return key;
+	}
+	return PointerGetDatum(GinTupleGetKeyData(tup));
+}
+
+extern int	_gin_compare_tuples(GinTuple *a, GinTuple *b, SortSupport ssup);
+
+#endif							/* GIN_TUPLE_H */
@@ -24,7 +24,9 @@
 #include "common/hashfn.h"
 #include "lib/stringinfo.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm.h"
 #include "storage/lockdefs.h"
+#include "storage/shm_toc.h"
 #include "utils/hsearch.h"
 #include "utils/relcache.h"
 
@@ -448,11 +450,15 @@ extern bool _hash_first(IndexScanDesc scan, ScanDirection dir);
 /* hashsort.c */
 typedef struct HSpool HSpool;	/* opaque struct in hashsort.c */
 
-extern HSpool *_h_spoolinit(Relation heap, Relation index, uint32 num_buckets);
+extern HSpool *_h_spoolinit(Relation heap, Relation index, uint32 num_buckets,
+							bool isconcurrent, int request);
 extern void _h_spooldestroy(HSpool *hspool);
+extern bool _h_spool_is_parallel(HSpool *hspool);
+extern double _h_parallel_heapscan(HSpool *hspool, double *indtuples);
 extern void _h_spool(HSpool *hspool, ItemPointer self,
 					 const Datum *values, const bool *isnull);
 extern void _h_indexbuild(HSpool *hspool, Relation heapRel);
+extern void _hash_parallel_build_main(dsm_segment *seg, shm_toc *toc);
 
 /* hashutil.c */
 extern bool _hash_checkqual(IndexScanDesc scan, IndexTuple itup);
@@ -96,6 +96,8 @@ typedef struct xl_multixact_truncate
 #define SizeOfMultiXactTruncate (sizeof(xl_multixact_truncate))
 
 
+extern PGDLLIMPORT int multixact_cache_size;
+
 extern MultiXactId MultiXactIdCreate(TransactionId xid1,
 									 MultiXactStatus status1, TransactionId xid2,
 									 MultiXactStatus status2);
@@ -1037,6 +1037,58 @@ typedef struct BTArrayKeyInfo
 	Datum	   *elem_values;	/* array of num_elems Datums */
 } BTArrayKeyInfo;
 
+/*
+ * A skip scan has no keys on the first index column, but still positions
+ * itself using the keys on the second one.  It does so by treating each
+ * distinct value of the first column as a separate group of tuples, read by
+ * a primitive index scan of its own that gets a "= value" key on the first
+ * column.  The next value is found by a primitive index scan that only reads
+ * the first tuple past the current one.  See _bt_skip_advance() for details.
+ */
+typedef enum BTSkipMode
+{
+	BTSKIP_SEEK,				/* find the first value past the current one */
+	BTSKIP_GROUP,				/* read the tuples with the current value */
+	BTSKIP_RANGE,				/* read on past the current value, no skipping */
+} BTSkipMode;
+
+/* Position of a skip scan, the part of it that btrestrpos has to restore */
+typedef struct BTSkipPosData
+{
+	BTSkipMode	mode;
+	bool		haskey;			/* use a key on the first column? */
+	ScanDirection dir;			/* direction that "past the value" refers to */
+	bool		isnull;			/* current value of the first column */
+	Datum		value;
+} BTSkipPosData;
+
+typedef struct BTSkipData
+{
+	BTSkipPosData cur;			/* current position */
+	BTSkipPosData mark;			/* position saved along with markPos */
+
+	/* first column of the tuple that ended the last _bt_readpage call */
+	bool		havestop;
+	bool		stopisnull;
+	Datum		stopvalue;
+
+	/* consecutive groups whose first leaf page was the last one read */
+	int			nwasted;
+	BlockNumber lastpage;		/* last leaf page read by a GROUP scan */
+
+	/* key on the first column followed by a copy of scan->keyData[] */
+	ScanKey		keys;
+
+	/* first column's operators and type */
+	FmgrInfo   *orderproc;		/* BTORDER_PROC, to compare values */
+	FmgrInfo	eqproc;			/* "=" */
+	FmgrInfo	ltproc;			/* "<" */
+	FmgrInfo	gtproc;			/* ">" */
+	Oid			collation;
+	bool		attbyval;
+	int16		attlen;
+} BTSkipData;
+
 typedef struct BTScanOpaqueData
 {
 	/* these fields are set by _bt_preprocess_keys(): */
@@ -1052,10 +1104,27 @@ typedef struct BTScanOpaqueData
 	FmgrInfo   *orderProcs;		/* ORDER procs for required equality keys */
 	MemoryContext arrayContext; /* scan-lifespan context for array data */
 
+	/* workspace for skip scans (skip is NULL if not a skip scan) */
+	BTSkipData *skip;
+	MemoryContext skipContext;	/* context that skip is allocated in */
+
 	/* info about killed items if any (killedItems is NULL if never used) */
 	int		   *killedItems;	/* currPos.items indexes of killed items */
 	int			numKilled;		/* number of currently stored items */
 
+	/*
+	 * Prefetching of the heap pages of upcoming currPos items, and of the
+	 * next leaf page, see _bt_prefetch().  prefetchTarget is -1 until the
+	 * first call, and 0 if not prefetching heap pages.
+	 */
+	int			prefetchTarget; /* maximum prefetch distance, in items */
+	int			prefetchDistance;	/* current prefetch distance */
+	bool		prefetchLeaf;	/* prefetch the next leaf page? */
+	BlockNumber prefetchPage;	/* leaf page prefetchItem refers to */
+	int			prefetchItem;	/* next currPos item to prefetch */
+	BlockNumber prefetchLastBlock;	/* heap block last prefetched */
+	Buffer		prefetchVMBuffer;	/* for index-only scans */
+
 	/*
 	 * If we are doing an index-only scan, these are the tuple storage
 	 * workspaces for the currPos and markPos respectively.  Each is of size
@@ -1168,6 +1237,9 @@ extern bool btinsert(Relation rel, Datum *values, bool *isnull,
 					 IndexUniqueCheck checkUnique,
 					 bool indexUnchanged,
 					 struct IndexInfo *indexInfo);
+extern void btinsertbatch(Relation rel, Datum **values, bool **isnull,
+						  ItemPointer ht_ctids, int ntuples, Relation heapRel,
+						  struct IndexInfo *indexInfo);
 extern IndexScanDesc btbeginscan(Relation rel, int nkeys, int norderbys);
 extern Size btestimateparallelscan(int nkeys, int norderbys);
 extern void btinitparallelscan(void *target);
@@ -1183,6 +1255,8 @@ extern IndexBulkDeleteResult *btbulkdelete(IndexVacuumInfo *info,
 										   IndexBulkDeleteResult *stats,
 										   IndexBulkDeleteCallback callback,
 										   void *callback_state);
+extern bool btretaildelete(IndexVacuumInfo *info, IndexTuple *itups,
+						   int nitups);
 extern IndexBulkDeleteResult *btvacuumcleanup(IndexVacuumInfo *info,
 											  IndexBulkDeleteResult *stats);
 extern bool btcanreturn(Relation index, int attno);
@@ -1220,6 +1294,8 @@ extern IndexTuple _bt_swap_posting(IndexTuple newitem, IndexTuple oposting,
 extern bool _bt_doinsert(Relation rel, IndexTuple itup,
 						 IndexUniqueCheck checkUnique, bool indexUnchanged,
 						 Relation heapRel);
+extern void _bt_doinsert_batch(Relation rel, IndexTuple *itups, int ntuples,
+							   Relation heapRel);
 extern void _bt_finish_split(Relation rel, Relation heaprel, Buffer lbuf,
 							 BTStack stack);
 extern Buffer _bt_getstackbuf(Relation rel, Relation heaprel, BTStack stack,
@@ -1289,6 +1365,12 @@ extern void _bt_freestack(BTStack stack);
 extern bool _bt_start_prim_scan(IndexScanDesc scan, ScanDirection dir);
 extern void _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir);
 extern void _bt_preprocess_keys(IndexScanDesc scan);
+extern void _bt_skip_setup(IndexScanDesc scan);
+extern bool _bt_skip_advance(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_skip_stop(IndexScanDesc scan, IndexTuple tuple);
+extern void _bt_skip_change_dir(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_skip_mark(IndexScanDesc scan);
+extern void _bt_skip_restore(IndexScanDesc scan);
 extern bool _bt_checkkeys(IndexScanDesc scan, BTReadPageState *pstate, bool arrayKeys,
 						  IndexTuple tuple, int tupnatts);
 extern void _bt_killitems(IndexScanDesc scan);
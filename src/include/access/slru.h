@@ -133,6 +133,12 @@ typedef struct SlruCtlData
 	 */
 	bits16		bank_mask;
 
+	/*
+	 * The page this process last read from disk, to detect sequential reads
+	 * that are worth reading ahead.
+	 */
+	int64		last_read_pageno;
+
 	/*
 	 * If true, use long segment filenames formed from lower 48 bits of the
 	 * segment number, e.g. pg_xact/000000001234. Otherwise, use short
@@ -197,6 +203,7 @@ extern int	SimpleLruReadPage_ReadOnly(SlruCtl ctl, int64 pageno,
 									   TransactionId xid);
 extern void SimpleLruWritePage(SlruCtl ctl, int slotno);
 extern void SimpleLruWriteAll(SlruCtl ctl, bool allow_redirtied);
+extern int	SimpleLruWriteVictims(int maxpages);
 #ifdef USE_ASSERT_CHECKING
 extern void SlruPagePrecedesUnitTests(SlruCtl ctl, int per_page);
 #else
@@ -381,6 +381,29 @@ typedef struct TableAmRoutine
 											  ScanDirection direction,
 											  TupleTableSlot *slot);
 
+	/*
+	 * Optional callback telling the AM which columns of the rows returned by
+	 * scan_getnextslot are going to be looked at, and by which conditions
+	 * they are going to be filtered, so that it can avoid work.
+	 *
+	 * `attrs` holds attribute numbers offset by
+	 * FirstLowInvalidHeapAttributeNumber, as produced by pull_varattnos().
+	 * Attributes not included may be returned with any value, e.g. as NULL.
+	 * NULL means that all attributes are needed.
+	 *
+	 * `keys` are conditions all returned rows will be checked against by the
+	 * caller.  Rows not satisfying them may, but don't have to, be skipped by
+	 * the AM.  Only strict operators are used, so that rows with a NULL value
+	 * for any of the keys' attributes may be skipped as well.
+	 *
+	 * Called before the first scan_getnextslot call.  The settings stay in
+	 * effect across rescans.
+	 */
+	void		(*scan_set_projection) (TableScanDesc scan,
+										struct Bitmapset *attrs,
+										int nkeys,
+										struct ScanKeyData *keys);
+
 	/* ------------------------------------------------------------------------
 	 * Parallel table scan related functions.
 	 * ------------------------------------------------------------------------
@@ -548,6 +571,7 @@ typedef struct TableAmRoutine
 								 Snapshot snapshot,
 								 Snapshot crosscheck,
 								 bool wait,
+								 Bitmapset *unindexed_attrs,
 								 TM_FailureData *tmfd,
 								 LockTupleMode *lockmode,
 								 TU_UpdateIndexes *update_indexes);
@@ -1031,6 +1055,20 @@ table_endscan(TableScanDesc scan)
 	scan->rs_rd->rd_tableam->scan_end(scan);
 }
 
+/*
+ * Tell the AM which attributes of the scanned rows are needed, and which
+ * conditions they will be filtered by; see the scan_set_projection callback.
+ * This is only a hint, and ignored by AMs that don't support it.
+ */
+static inline void
+table_scan_set_projection(TableScanDesc scan, struct Bitmapset *attrs,
+						  int nkeys, struct ScanKeyData *keys)
+{
+	if (scan->rs_rd->rd_tableam->scan_set_projection != NULL)
+		scan->rs_rd->rd_tableam->scan_set_projection(scan, attrs,
+													 nkeys, keys);
+}
+
 /*
  * Restart a relation scan.
  */
@@ -1521,6 +1559,10 @@ table_tuple_delete(Relation rel, ItemPointer tid, CommandId cid,
  *		cmax/cmin if successful)
  *	crosscheck - if not InvalidSnapshot, also check old tuple against this
  *	wait - true if should wait for any conflicting update to commit/abort
+ *	unindexed_attrs - if not NULL, columns (offset by
+ *		FirstLowInvalidHeapAttributeNumber) that are used only by indexes
+ *		which need entries for neither the old nor the new version of this
+ *		tuple; the AM may treat changes to them as not affecting any index
  * Output parameters:
  *	tmfd - filled in failure cases (see below)
  *	lockmode - filled with lock mode acquired on tuple
@@ -1544,12 +1586,13 @@ table_tuple_delete(Relation rel, ItemPointer tid, CommandId cid,
 static inline TM_Result
 table_tuple_update(Relation rel, ItemPointer otid, TupleTableSlot *slot,
 				   CommandId cid, Snapshot snapshot, Snapshot crosscheck,
-				   bool wait, TM_FailureData *tmfd, LockTupleMode *lockmode,
+				   bool wait, Bitmapset *unindexed_attrs,
+				   TM_FailureData *tmfd, LockTupleMode *lockmode,
 				   TU_UpdateIndexes *update_indexes)
 {
 	return rel->rd_tableam->tuple_update(rel, otid, slot,
 										 cid, snapshot, crosscheck,
-										 wait, tmfd,
+										 wait, unindexed_attrs, tmfd,
 										 lockmode, update_indexes);
 }
 
@@ -25,8 +25,9 @@
  */
 typedef struct GlobalTransactionData *GlobalTransaction;
 
-/* GUC variable */
+/* GUC variables */
 extern PGDLLIMPORT int max_prepared_xacts;
+extern PGDLLIMPORT int prepared_state_cache_size;
 
 extern Size TwoPhaseShmemSize(void);
 extern void TwoPhaseShmemInit(void);
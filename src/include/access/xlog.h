@@ -40,6 +40,8 @@ extern PGDLLIMPORT int max_wal_size_mb;
 extern PGDLLIMPORT int wal_keep_size_mb;
 extern PGDLLIMPORT int max_slot_wal_keep_size_mb;
 extern PGDLLIMPORT int XLOGbuffers;
+extern PGDLLIMPORT int XLOGinsertLocks;
+extern PGDLLIMPORT int wal_write_concurrency;
 extern PGDLLIMPORT int XLogArchiveTimeout;
 extern PGDLLIMPORT int wal_retrieve_retry_interval;
 extern PGDLLIMPORT char *XLogArchiveCommand;
@@ -49,6 +51,7 @@ extern PGDLLIMPORT bool wal_log_hints;
 extern PGDLLIMPORT int wal_compression;
 extern PGDLLIMPORT bool wal_init_zero;
 extern PGDLLIMPORT bool wal_recycle;
+extern PGDLLIMPORT bool wal_writer_group_commit;
 extern PGDLLIMPORT bool *wal_consistency_checking;
 extern PGDLLIMPORT char *wal_consistency_checking_string;
 extern PGDLLIMPORT bool log_checkpoints;
@@ -57,6 +60,12 @@ extern PGDLLIMPORT int wal_decode_buffer_size;
 
 extern PGDLLIMPORT int CheckPointSegments;
 
+/*
+ * Upper limit for wal_insert_locks.  WALInsertLockAcquireExclusive holds all
+ * of them at once, so this must stay well below MAX_SIMUL_LWLOCKS.
+ */
+#define MAX_XLOGINSERT_LOCKS	128
+
 /* Archive modes */
 typedef enum ArchiveMode
 {
@@ -200,8 +209,11 @@ extern XLogRecPtr XLogInsertRecord(struct XLogRecData *rdata,
 								   XLogRecPtr fpw_lsn,
 								   uint8 flags,
 								   int num_fpi,
-								   bool topxid_included);
+								   bool topxid_included,
+								   bool crc_pending);
 extern void XLogFlush(XLogRecPtr record);
+extern void XLogGroupFlush(XLogRecPtr record);
+extern bool XLogGroupFlushServe(void);
 extern bool XLogBackgroundFlush(void);
 extern bool XLogNeedsFlush(XLogRecPtr record);
 extern int	XLogFileInit(XLogSegNo logsegno, TimeLineID logtli);
@@ -39,5 +39,6 @@ typedef struct XLogStats
 extern void XLogRecGetLen(XLogReaderState *record, uint32 *rec_len,
 						  uint32 *fpi_len);
 extern void XLogRecStoreStats(XLogStats *stats, XLogReaderState *record);
+extern void XLogStatsMerge(XLogStats *stats, const XLogStats *other);
 
 #endif							/* XLOGSTATS_H */
@@ -311,6 +311,18 @@
 #define unlikely(x) ((x) != 0)
 #endif
 
+/*
+ * Hint to the CPU that the memory at the given address is going to be read
+ * soon.  This can hide memory latency in code that can work out the
+ * addresses it needs ahead of time, e.g. when probing a large hash table
+ * for a batch of keys.  It never faults, so the address needn't be valid.
+ */
+#if defined(__GNUC__)
+#define pg_prefetch_mem(addr)	__builtin_prefetch(addr)
+#else
+#define pg_prefetch_mem(addr)	((void) 0)
+#endif
+
 /*
  * CppAsString
  *		Convert the argument to a string, using the C preprocessor.
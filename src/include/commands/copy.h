@@ -84,6 +84,7 @@ typedef struct CopyFormatOptions
 	CopyOnErrorChoice on_error; /* what to do when error happened */
 	CopyLogVerbosityChoice log_verbosity;	/* verbosity of logged messages */
 	List	   *convert_select; /* list of column names (can be NIL) */
+	int			parallel_workers;	/* number of workers for COPY FROM, or 0 */
 } CopyFormatOptions;
 
 /* These are private in commands/copy[from|to].c */
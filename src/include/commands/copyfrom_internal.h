@@ -17,6 +17,8 @@
 #include "commands/copy.h"
 #include "commands/trigger.h"
 #include "nodes/miscnodes.h"
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
 
 /*
  * Represents the different source cases we need to worry about at
@@ -52,6 +54,25 @@ typedef enum CopyInsertMethod
 								 * ExecForeignBatchInsert only if valid */
 } CopyInsertMethod;
 
+/*
+ * Fixed-width types whose binary format COPY FROM decodes itself, instead of
+ * copying each field to attribute_buf and calling the receive function.
+ */
+typedef enum CopyBinaryFastType
+{
+	COPY_BINARY_RECV = 0,		/* call the type's receive function */
+	COPY_BINARY_BOOL,
+	COPY_BINARY_INT2,
+	COPY_BINARY_INT4,
+	COPY_BINARY_OID,
+	COPY_BINARY_INT8,
+	COPY_BINARY_FLOAT4,
+	COPY_BINARY_FLOAT8,
+	COPY_BINARY_DATE,
+	COPY_BINARY_TIMESTAMP,		/* timestamp or timestamptz, without typmod */
+	COPY_BINARY_UUID,
+} CopyBinaryFastType;
+
 /*
  * This struct contains all the state variables used throughout a COPY FROM
  * operation.
@@ -95,6 +116,8 @@ typedef struct CopyFromStateData
 								 * default value */
 	FmgrInfo   *in_functions;	/* array of input functions for each attrs */
 	Oid		   *typioparams;	/* array of element types for in_functions */
+	CopyBinaryFastType *binary_fast;	/* in binary mode, how to decode each
+										 * attr */
 	ErrorSaveContext *escontext;	/* soft error trapper during in_functions
 									 * execution */
 	uint64		num_errors;		/* total number of rows which contained soft
@@ -178,9 +201,27 @@ typedef struct CopyFromStateData
 #define RAW_BUF_BYTES(cstate) ((cstate)->raw_buf_len - (cstate)->raw_buf_index)
 
 	uint64		bytes_processed;	/* number of bytes processed so far */
+
+	/*
+	 * Parallel COPY FROM state.  The column and option lists are kept only if
+	 * the PARALLEL option was given, so that they can be passed to workers;
+	 * pcopy is non-NULL while workers are parsing the input.
+	 */
+	List	   *parallel_attnamelist;
+	List	   *parallel_options;
+	struct ParallelCopyState *pcopy;
 } CopyFromStateData;
 
 extern void ReceiveCopyBegin(CopyFromState cstate);
 extern void ReceiveCopyBinaryHeader(CopyFromState cstate);
+extern bool CopyFromReadLine(CopyFromState cstate, uint64 *prev_lineno);
+extern void CopyFromRestartInput(CopyFromState cstate, uint64 lineno);
+
+/* in copyfromparallel.c */
+extern void BeginParallelCopyFrom(CopyFromState cstate);
+extern bool ParallelCopyFromNext(CopyFromState cstate, Datum *values,
+								 bool *nulls);
+extern void EndParallelCopyFrom(CopyFromState cstate);
+extern void ParallelCopyFromMain(dsm_segment *seg, shm_toc *toc);
 
 #endif							/* COPYFROM_INTERNAL_H */
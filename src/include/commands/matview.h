@@ -17,6 +17,7 @@
 #include "catalog/objectaddress.h"
 #include "nodes/params.h"
 #include "nodes/parsenodes.h"
+#include "parser/parse_node.h"
 #include "tcop/dest.h"
 #include "utils/relcache.h"
 
@@ -30,4 +31,8 @@ extern DestReceiver *CreateTransientRelDestReceiver(Oid transientoid);
 
 extern bool MatViewIncrementalMaintenanceIsEnabled(void);
 
+extern void PrepareIncrementalMatViewQuery(ParseState *pstate, Query *query);
+extern void CreateIncrementalMatViewTriggers(Oid matviewOid);
+extern void CheckIncrementalMatViewInheritance(Oid relid);
+
 #endif							/* MATVIEW_H */
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * compress_stream.h
+ *	  Streaming compression of network traffic with LZ4 or zstd.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  src/include/common/compress_stream.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef COMPRESS_STREAM_H
+#define COMPRESS_STREAM_H
+
+#include "common/compression.h"
+
+typedef struct pg_stream_compressor pg_stream_compressor;
+typedef struct pg_stream_decompressor pg_stream_decompressor;
+
+extern bool pg_stream_compress_supported(pg_compress_algorithm algorithm);
+extern bool pg_stream_compress_algorithm_by_name(const char *name,
+												 pg_compress_algorithm *algorithm);
+
+extern pg_stream_compressor *pg_stream_compressor_create(pg_compress_algorithm algorithm,
+														 int level,
+														 const char **errormsg);
+extern bool pg_stream_compress(pg_stream_compressor *cs,
+							   const char *data, size_t len,
+							   const char **out, size_t *outlen);
+extern const char *pg_stream_compressor_error(pg_stream_compressor *cs);
+extern void pg_stream_compressor_free(pg_stream_compressor *cs);
+
+extern pg_stream_decompressor *pg_stream_decompressor_create(pg_compress_algorithm algorithm,
+															 const char **errormsg);
+extern bool pg_stream_decompress(pg_stream_decompressor *ds,
+								 const char *data, size_t len,
+								 const char **out, size_t *outlen);
+extern const char *pg_stream_decompressor_error(pg_stream_decompressor *ds);
+extern void pg_stream_decompressor_free(pg_stream_decompressor *ds);
+
+#endif							/* COMPRESS_STREAM_H */
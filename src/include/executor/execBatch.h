@@ -0,0 +1,68 @@
+/*-------------------------------------------------------------------------
+ * execBatch.h
+ *		Support for batch-at-a-time execution
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/executor/execBatch.h
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "executor/executor.h"
+
+/* Maximum number of tuples processed as one batch */
+#define EXEC_BATCH_SIZE 64
+
+/*
+ * State for reading the tuples of a child node a batch at a time, through
+ * ExecProcNodeBatch(), for a node that consumes them one at a time.  Each
+ * tuple returned by ExecBatchReaderNext() stays valid until the next call,
+ * just as with ExecProcNode().  The reader must be reset whenever the child
+ * node is rescanned.
+ */
+typedef struct ExecBatchReader
+{
+	int			nslots;			/* number of tuples in slots[] */
+	int			next;			/* next one to return */
+	TupleTableSlot *slots[EXEC_BATCH_SIZE];
+} ExecBatchReader;
+
+/* opaque, see execBatch.c */
+typedef struct BatchQual BatchQual;
+
+extern BatchQual *ExecBuildBatchQual(ExprState *qual);
+extern int	ExecBatchQual(BatchQual *bq, TupleTableSlot **slots, int nslots,
+						  bool *matches);
+
+static inline void
+ExecBatchReaderReset(ExecBatchReader *reader)
+{
+	reader->nslots = 0;
+	reader->next = 0;
+}
+
+/*
+ * Return the next tuple from the given node, or NULL at the end.
+ */
+#ifndef FRONTEND
+static inline TupleTableSlot *
+ExecBatchReaderNext(PlanState *node, ExecBatchReader *reader)
+{
+	if (reader->next >= reader->nslots)
+	{
+		reader->nslots = ExecProcNodeBatch(node, reader->slots,
+										   EXEC_BATCH_SIZE);
+		reader->next = 0;
+		if (reader->nslots == 0)
+			return NULL;
+	}
+	return reader->slots[reader->next++];
+}
+#endif
+
+#endif							/* EXECBATCH_H */
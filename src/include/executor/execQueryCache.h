@@ -0,0 +1,54 @@
+/*-------------------------------------------------------------------------
+ *
+ * execQueryCache.h
+ *	  Shared cache of the results of read-only queries
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execQueryCache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECQUERYCACHE_H
+#define EXECQUERYCACHE_H
+
+#include "executor/execdesc.h"
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+
+/* GUC variables */
+extern PGDLLIMPORT int query_cache_size;
+extern PGDLLIMPORT bool query_cache;
+
+extern Size QueryCacheShmemSize(void);
+extern void QueryCacheShmemInit(void);
+
+/* planner support */
+extern bool QueryCacheQueryIsCacheable(Query *parse);
+extern bool QueryCachePlanIsCacheable(PlannedStmt *stmt);
+
+/* executor support */
+extern bool QueryCacheApplies(QueryDesc *queryDesc);
+extern bool QueryCacheBegin(QueryDesc *queryDesc, DestReceiver *dest,
+							DestReceiver **capture);
+extern void QueryCacheEnd(QueryDesc *queryDesc, DestReceiver *capture);
+
+/* tracking of changes */
+extern void QueryCacheNoteChange(Oid dbId, Oid relId);
+extern void QueryCacheNoteCatalogChange(Oid dbId, int cacheId,
+										uint32 hashValue);
+extern void PreCommit_QueryCache(void);
+extern void AtPrepare_QueryCache(void);
+extern void PostPrepare_QueryCache(void);
+extern void AtEOXact_QueryCache(void);
+
+extern void querycache_twophase_recover(TransactionId xid, uint16 info,
+										void *recdata, uint32 len);
+extern void querycache_twophase_postcommit(TransactionId xid, uint16 info,
+										   void *recdata, uint32 len);
+extern void querycache_twophase_postabort(TransactionId xid, uint16 info,
+										  void *recdata, uint32 len);
+
+#endif							/* EXECQUERYCACHE_H */
@@ -18,6 +18,7 @@
 #include "fmgr.h"
 #include "nodes/lockoptions.h"
 #include "nodes/parsenodes.h"
+#include "postmaster/profiler.h"
 #include "utils/memutils.h"
 
 
@@ -154,6 +155,7 @@ extern TupleHashEntry LookupTupleHashEntry(TupleHashTable hashtable,
 										   bool *isnew, uint32 *hash);
 extern uint32 TupleHashTableHash(TupleHashTable hashtable,
 								 TupleTableSlot *slot);
+extern void TupleHashTablePrefetch(TupleHashTable hashtable, uint32 hash);
 extern TupleHashEntry LookupTupleHashEntryHash(TupleHashTable hashtable,
 											   TupleTableSlot *slot,
 											   bool *isnew, uint32 hash);
@@ -253,6 +255,8 @@ extern void EvalPlanQualEnd(EPQState *epqstate);
 extern PlanState *ExecInitNode(Plan *node, EState *estate, int eflags);
 extern void ExecSetExecProcNode(PlanState *node, ExecProcNodeMtd function);
 extern Node *MultiExecProcNode(PlanState *node);
+extern int	ExecProcNodeBatchInstr(PlanState *node, TupleTableSlot **slots,
+								   int maxslots);
 extern void ExecEndNode(PlanState *node);
 extern void ExecShutdownNode(PlanState *node);
 extern void ExecSetTupleBound(int64 tuples_needed, PlanState *child_node);
@@ -273,6 +277,35 @@ ExecProcNode(PlanState *node)
 
 	return node->ExecProcNode(node);
 }
+
+/* ----------------------------------------------------------------
+ *		ExecProcNodeBatch
+ *
+ *		Execute the given node to return up to maxslots tuples, see
+ *		ExecProcNodeBatchMtd.  Nodes that don't support returning batches
+ *		return one tuple at a time.
+ * ----------------------------------------------------------------
+ */
+static inline int
+ExecProcNodeBatch(PlanState *node, TupleTableSlot **slots, int maxslots)
+{
+	if (node->ExecProcNodeBatch == NULL)
+	{
+		TupleTableSlot *slot = ExecProcNode(node);
+
+		if (TupIsNull(slot))
+			return 0;
+		slots[0] = slot;
+		return 1;
+	}
+
+	if (node->chgParam != NULL) /* something changed? */
+		ExecReScan(node);		/* let ReScan handle this */
+
+	if (node->instrument || ProfilerEnabled())
+		return ExecProcNodeBatchInstr(node, slots, maxslots);
+	return node->ExecProcNodeBatch(node, slots, maxslots);
+}
 #endif
 
 /*
@@ -316,6 +349,14 @@ extern ExprState *ExecPrepareQual(List *qual, EState *estate);
 extern ExprState *ExecPrepareCheck(List *qual, EState *estate);
 extern List *ExecPrepareExprList(List *nodes, EState *estate);
 
+/*
+ * prototypes from functions in execExprCache.c
+ */
+extern ExprState *ExecGetCachedQual(List *qual, PlanState *parent);
+extern ProjectionInfo *ExecGetCachedProjection(PlanState *planstate,
+											   TupleDesc inputDesc);
+extern void ExecReleasePlanExprCache(PlanState *planstate);
+
 /*
  * ExecEvalExpr
  *
@@ -535,6 +576,7 @@ extern void end_tup_output(TupOutputState *tstate);
  */
 extern EState *CreateExecutorState(void);
 extern void FreeExecutorState(EState *estate);
+extern MemoryContext ExecGetArenaContext(EState *estate);
 extern ExprContext *CreateExprContext(EState *estate);
 extern ExprContext *CreateWorkExprContext(EState *estate);
 extern ExprContext *CreateStandaloneExprContext(void);
@@ -633,6 +675,16 @@ extern List *ExecInsertIndexTuples(ResultRelInfo *resultRelInfo,
 								   bool noDupErr,
 								   bool *specConflict, List *arbiterIndexes,
 								   bool onlySummarizing);
+extern bool *ExecInsertIndexTuplesBatch(ResultRelInfo *resultRelInfo,
+										TupleTableSlot **slots, int nslots,
+										EState *estate);
+extern List *ExecInsertRemainingIndexTuples(ResultRelInfo *resultRelInfo,
+											TupleTableSlot *slot,
+											EState *estate,
+											const bool *batched);
+extern Bitmapset *ExecGetUnindexedAttrs(ResultRelInfo *resultRelInfo,
+										TupleTableSlot *oldslot,
+										TupleTableSlot *slot, EState *estate);
 extern bool ExecCheckIndexConstraints(ResultRelInfo *resultRelInfo,
 									  TupleTableSlot *slot,
 									  EState *estate, ItemPointer conflictTid,
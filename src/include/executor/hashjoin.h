@@ -153,6 +153,37 @@ typedef struct HashMemoryChunkData *HashMemoryChunk;
 /* tuples exceeding HASH_CHUNK_THRESHOLD bytes are put in their own chunk */
 #define HASH_CHUNK_THRESHOLD	(HASH_CHUNK_SIZE / 4)
 
+/*
+ * When the in-memory hash table is much larger than the CPU caches, probing
+ * it in the order the outer tuples arrive incurs a cache miss on almost every
+ * probe.  In that case the hash join instead reads the outer relation in
+ * chunks of up to work_mem, and radix-partitions each chunk on the high bits
+ * of the bucket number.  Probing the chunk one partition at a time then only
+ * touches a range of the bucket array small enough to stay cached.
+ *
+ * The table is partitioned when it takes up more than
+ * HJ_RADIX_MIN_TABLE_SIZE, into partitions of about HJ_RADIX_PARTITION_SIZE,
+ * but no more than HJ_RADIX_MAX_PARTITIONS.
+ */
+#define HJ_RADIX_MIN_TABLE_SIZE		(16 * 1024 * 1024L)
+#define HJ_RADIX_PARTITION_SIZE		(1024 * 1024L)
+#define HJ_RADIX_MAX_PARTITIONS		1024
+
+typedef struct HashJoinRadixBuffer
+{
+	MemoryContext cxt;			/* holds the buffered tuples */
+	int			partshift;		/* bucketno >> partshift is the partition */
+	int			npartitions;	/* number of partitions (a power of 2!) */
+	int			ntuples;		/* # tuples in the buffer */
+	int			maxtuples;		/* allocated length of the arrays */
+	int			next;			/* next tuple to return, in order[] */
+	bool		exhausted;		/* has outer plan returned NULL? */
+	MinimalTuple *tuples;		/* buffered tuples, in arrival order */
+	uint32	   *hashvalues;		/* their hash values */
+	int		   *order;			/* indexes of tuples, sorted by partition */
+	int		   *partstart;		/* npartitions + 1 offsets into order[] */
+} HashJoinRadixBuffer;
+
 /*
  * For each batch of a Parallel Hash Join, we have a ParallelHashJoinBatch
  * object in shared memory to coordinate access to it.  Since they are
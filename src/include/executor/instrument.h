@@ -55,6 +55,19 @@ typedef struct WalUsage
 	uint64		wal_bytes;		/* size of WAL records produced */
 } WalUsage;
 
+/*
+ * HwCounterUsage holds CPU hardware event counts, as collected for
+ * EXPLAIN (ANALYZE, HWCOUNTERS).  Only user-space events of the current
+ * process are counted.
+ */
+typedef struct HwCounterUsage
+{
+	int64		cycles;			/* # of CPU cycles */
+	int64		instructions;	/* # of instructions retired */
+	int64		llc_misses;		/* # of last-level cache misses */
+	int64		branch_misses;	/* # of mispredicted branches */
+} HwCounterUsage;
+
 /* Flag bits included in InstrAlloc's instrument_options bitmask */
 typedef enum InstrumentOption
 {
@@ -62,6 +75,7 @@ typedef enum InstrumentOption
 	INSTRUMENT_BUFFERS = 1 << 1,	/* needs buffer usage */
 	INSTRUMENT_ROWS = 1 << 2,	/* needs row count */
 	INSTRUMENT_WAL = 1 << 3,	/* needs WAL usage */
+	INSTRUMENT_HWCOUNTERS = 1 << 4, /* needs hardware counters */
 	INSTRUMENT_ALL = PG_INT32_MAX
 } InstrumentOption;
 
@@ -71,6 +85,7 @@ typedef struct Instrumentation
 	bool		need_timer;		/* true if we need timer data */
 	bool		need_bufusage;	/* true if we need buffer usage data */
 	bool		need_walusage;	/* true if we need WAL usage data */
+	bool		need_hwcounters;	/* true if we need hardware counters */
 	bool		async_mode;		/* true if node is in async mode */
 	/* Info about current plan cycle: */
 	bool		running;		/* true if we've completed first tuple */
@@ -80,6 +95,7 @@ typedef struct Instrumentation
 	double		tuplecount;		/* # of tuples emitted so far this cycle */
 	BufferUsage bufusage_start; /* buffer usage at start */
 	WalUsage	walusage_start; /* WAL usage at start */
+	HwCounterUsage hwcounters_start;	/* hardware counters at start */
 	/* Accumulated statistics across all completed cycles: */
 	double		startup;		/* total startup time (in seconds) */
 	double		total;			/* total time (in seconds) */
@@ -90,6 +106,7 @@ typedef struct Instrumentation
 	double		nfiltered2;		/* # of tuples removed by "other" quals */
 	BufferUsage bufusage;		/* total buffer usage */
 	WalUsage	walusage;		/* total WAL usage */
+	HwCounterUsage hwcounters;	/* total hardware counters */
 } Instrumentation;
 
 typedef struct WorkerInstrumentation
@@ -116,5 +133,6 @@ extern void BufferUsageAccumDiff(BufferUsage *dst,
 								 const BufferUsage *add, const BufferUsage *sub);
 extern void WalUsageAccumDiff(WalUsage *dst, const WalUsage *add,
 							  const WalUsage *sub);
+extern void InstrHwCountersInit(void);
 
 #endif							/* INSTRUMENT_H */
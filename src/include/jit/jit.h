@@ -15,6 +15,9 @@
 #include "utils/resowner.h"
 
 
+/* Directory holding cached JIT code, relative to the data directory */
+#define PG_JIT_CACHE_DIR "pg_jitcache"
+
 /* Flags determining what kind of JIT operations to perform */
 #define PGJIT_NONE     0
 #define PGJIT_PERFORM  (1 << 0)
@@ -43,6 +46,10 @@ typedef struct JitInstrumentation
 
 	/* accumulated time for code emission */
 	instr_time	emission_counter;
+
+	/* number of modules found in, and missing from, the JIT cache */
+	size_t		cache_hits;
+	size_t		cache_misses;
 } JitInstrumentation;
 
 /*
@@ -83,18 +90,22 @@ struct JitProviderCallbacks
 
 /* GUCs */
 extern PGDLLIMPORT bool jit_enabled;
+extern PGDLLIMPORT bool jit_cache;
+extern PGDLLIMPORT int jit_cache_size;
 extern PGDLLIMPORT char *jit_provider;
 extern PGDLLIMPORT bool jit_debugging_support;
 extern PGDLLIMPORT bool jit_dump_bitcode;
 extern PGDLLIMPORT bool jit_expressions;
 extern PGDLLIMPORT bool jit_profiling_support;
 extern PGDLLIMPORT bool jit_tuple_deforming;
+extern PGDLLIMPORT int jit_tier_up_threshold;
 extern PGDLLIMPORT double jit_above_cost;
 extern PGDLLIMPORT double jit_inline_above_cost;
 extern PGDLLIMPORT double jit_optimize_above_cost;
 
 
 extern void jit_reset_after_error(void);
+extern void RemoveJitCacheFiles(void);
 extern void jit_release_context(JitContext *context);
 
 /*
@@ -102,6 +113,7 @@ extern void jit_release_context(JitContext *context);
  * not be able to perform JIT (i.e. return false).
  */
 extern bool jit_compile_expr(struct ExprState *state);
+extern bool jit_expr_wanted(struct ExprState *state);
 extern void InstrJitAgg(JitInstrumentation *dst, JitInstrumentation *add);
 
 
@@ -114,6 +114,16 @@ extern LLVMValueRef llvm_function_reference(LLVMJitContext *context,
 extern void llvm_inline_reset_caches(void);
 extern void llvm_inline(LLVMModuleRef mod);
 
+/* length of keys of the cache of optimized modules, in hex digits */
+#define LLVM_CACHE_KEY_LEN 64
+
+extern List *llvm_cache_canonicalize(LLVMModuleRef mod);
+extern void llvm_cache_restore_names(LLVMModuleRef mod, List *names);
+extern void llvm_cache_compute_key(LLVMModuleRef mod, int jitFlags, char *key);
+extern bool llvm_cache_load(LLVMContextRef lc, const char *key,
+							LLVMModuleRef *mod);
+extern void llvm_cache_store(LLVMModuleRef mod, const char *key);
+
 /*
  ****************************************************************************
  * Code generation functions.
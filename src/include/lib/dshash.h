@@ -72,8 +72,8 @@ typedef struct dshash_table_item dshash_table_item;
 typedef struct dshash_seq_status
 {
 	dshash_table *hash_table;	/* dshash table working on */
-	int			curbucket;		/* bucket number we are at */
-	int			nbuckets;		/* total number of buckets in the dshash */
+	int			curbucket;		/* bucket number in current partition */
+	int			nbuckets;		/* number of buckets in current partition */
 	dshash_table_item *curitem; /* item we are currently at */
 	dsa_pointer pnextitem;		/* dsa-pointer to the next item */
 	int			curpartition;	/* partition number we are at */
@@ -95,6 +95,8 @@ extern void dshash_destroy(dshash_table *hash_table);
 /* Finding, creating, deleting entries. */
 extern void *dshash_find(dshash_table *hash_table,
 						 const void *key, bool exclusive);
+extern bool dshash_find_copy(dshash_table *hash_table,
+							 const void *key, void *entry);
 extern void *dshash_find_or_insert(dshash_table *hash_table,
 								   const void *key, bool *found);
 extern bool dshash_delete_key(dshash_table *hash_table, const void *key);
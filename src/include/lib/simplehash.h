@@ -50,6 +50,7 @@
  *	  - SH_HASH_KEY(table, key) - generate hash for the key
  *	  - SH_STORE_HASH - if defined the hash is stored in the elements
  *	  - SH_GET_HASH(tb, a) - return the field to store the hash in
+ *	  - SH_USE_TAGS - if defined, keep a one-byte tag per bucket, see below
  *
  *	  The element type is required to contain a "status" member that can store
  *	  the range of values defined in the SH_STATUS enum.
@@ -87,6 +88,15 @@
  *	  looking or is done - buckets following a deleted element are shifted
  *	  backwards, unless they're empty or already at their optimal position.
  *
+ *	  With SH_USE_TAGS, a separate byte array mirrors the buckets: zero for
+ *	  an empty bucket, otherwise the high bit plus the top seven bits of the
+ *	  element's hash.  Lookups then compare the tags of a whole group of
+ *	  buckets at once using SIMD instructions, and only look at elements
+ *	  whose tag matches, which saves cache misses and key comparisons when
+ *	  elements are large or comparing keys is expensive.  The tag array has
+ *	  SH_TAG_PADDING extra bytes that repeat its beginning, so that a group
+ *	  can be loaded from any bucket without wrapping around.
+ *
  * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -94,6 +104,9 @@
  */
 
 #include "port/pg_bitutils.h"
+#ifdef SH_USE_TAGS
+#include "port/simd.h"
+#endif
 
 /* helpers */
 #define SH_MAKE_PREFIX(a) CppConcat(a,_)
@@ -137,6 +150,8 @@
 #define SH_ENTRY_HASH SH_MAKE_NAME(entry_hash)
 #define SH_INSERT_HASH_INTERNAL SH_MAKE_NAME(insert_hash_internal)
 #define SH_LOOKUP_HASH_INTERNAL SH_MAKE_NAME(lookup_hash_internal)
+#define SH_ALLOCATE_TAGS SH_MAKE_NAME(allocate_tags)
+#define SH_SET_TAG SH_MAKE_NAME(set_tag)
 
 /* generate forward declarations necessary to use the hash table */
 #ifdef SH_DECLARE
@@ -163,6 +178,9 @@ typedef struct SH_TYPE
 	/* hash buckets */
 	SH_ELEMENT_TYPE *data;
 
+	/* per-bucket tags, only used with SH_USE_TAGS */
+	uint8	   *tags;
+
 #ifndef SH_RAW_ALLOCATOR
 	/* memory context to use for allocations */
 	MemoryContext ctx;
@@ -283,6 +301,13 @@ SH_SCOPE void SH_STAT(SH_TYPE * tb);
 #define SH_COMPARE_KEYS(tb, ahash, akey, b) (SH_EQUAL(tb, b->SH_KEY, akey))
 #endif
 
+#ifdef SH_USE_TAGS
+/* tag of an in-use bucket holding an element with the given hash */
+#define SH_HASH_TAG(hash) ((uint8) (0x80 | ((hash) >> 25)))
+/* tag bytes repeated past the end of the tag array; at least sizeof(Vector8) */
+#define SH_TAG_PADDING 16
+#endif
+
 /*
  * Wrap the following definitions in include guards, to avoid multiple
  * definition errors if this header is included more than once.  The rest of
@@ -401,6 +426,31 @@ SH_ENTRY_HASH(SH_TYPE * tb, SH_ELEMENT_TYPE * entry)
 #endif
 }
 
+#ifdef SH_USE_TAGS
+/*
+ * Allocate a zeroed tag array for a table of the given size.  Tags are only
+ * ever used by the local process, so they don't go through SH_ALLOCATE.
+ */
+static inline uint8 *
+SH_ALLOCATE_TAGS(SH_TYPE * tb, uint64 size)
+{
+#ifdef SH_RAW_ALLOCATOR
+	return (uint8 *) SH_RAW_ALLOCATOR(size + SH_TAG_PADDING);
+#else
+	return (uint8 *) MemoryContextAllocExtended(tb->ctx, size + SH_TAG_PADDING,
+												MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+#endif
+}
+
+/* set the tag of a bucket, including its copies in the padding */
+static inline void
+SH_SET_TAG(SH_TYPE * tb, uint32 elem, uint8 tag)
+{
+	for (uint64 i = elem; i < tb->size + SH_TAG_PADDING; i += tb->size)
+		tb->tags[i] = tag;
+}
+#endif
+
 /* default memory allocator function */
 static inline void *SH_ALLOCATE(SH_TYPE * type, Size size);
 static inline void SH_FREE(SH_TYPE * type, void *pointer);
@@ -462,6 +512,9 @@ SH_CREATE(MemoryContext ctx, uint32 nelements, void *private_data)
 	size = SH_COMPUTE_SIZE(size);
 
 	tb->data = (SH_ELEMENT_TYPE *) SH_ALLOCATE(tb, sizeof(SH_ELEMENT_TYPE) * size);
+#ifdef SH_USE_TAGS
+	tb->tags = SH_ALLOCATE_TAGS(tb, size);
+#endif
 
 	SH_UPDATE_PARAMETERS(tb, size);
 	return tb;
@@ -472,6 +525,9 @@ SH_SCOPE void
 SH_DESTROY(SH_TYPE * tb)
 {
 	SH_FREE(tb, tb->data);
+#ifdef SH_USE_TAGS
+	pfree(tb->tags);
+#endif
 	pfree(tb);
 }
 
@@ -480,6 +536,9 @@ SH_SCOPE void
 SH_RESET(SH_TYPE * tb)
 {
 	memset(tb->data, 0, sizeof(SH_ELEMENT_TYPE) * tb->size);
+#ifdef SH_USE_TAGS
+	memset(tb->tags, 0, tb->size + SH_TAG_PADDING);
+#endif
 	tb->members = 0;
 }
 
@@ -496,6 +555,10 @@ SH_GROW(SH_TYPE * tb, uint64 newsize)
 	uint64		oldsize = tb->size;
 	SH_ELEMENT_TYPE *olddata = tb->data;
 	SH_ELEMENT_TYPE *newdata;
+#ifdef SH_USE_TAGS
+	uint8	   *oldtags = tb->tags;
+	uint8	   *newtags;
+#endif
 	uint32		i;
 	uint32		startelem = 0;
 	uint32		copyelem;
@@ -506,7 +569,12 @@ SH_GROW(SH_TYPE * tb, uint64 newsize)
 
 	newsize = SH_COMPUTE_SIZE(newsize);
 
-	tb->data = (SH_ELEMENT_TYPE *) SH_ALLOCATE(tb, sizeof(SH_ELEMENT_TYPE) * newsize);
+	newdata = (SH_ELEMENT_TYPE *) SH_ALLOCATE(tb, sizeof(SH_ELEMENT_TYPE) * newsize);
+#ifdef SH_USE_TAGS
+	newtags = SH_ALLOCATE_TAGS(tb, newsize);
+	tb->tags = newtags;
+#endif
+	tb->data = newdata;
 
 	/*
 	 * Update parameters for new table after allocation succeeds to avoid
@@ -588,6 +656,9 @@ SH_GROW(SH_TYPE * tb, uint64 newsize)
 
 			/* copy entry to new slot */
 			memcpy(newentry, oldentry, sizeof(SH_ELEMENT_TYPE));
+#ifdef SH_USE_TAGS
+			SH_SET_TAG(tb, curelem, SH_HASH_TAG(hash));
+#endif
 		}
 
 		/* can't use SH_NEXT here, would use new size */
@@ -599,6 +670,9 @@ SH_GROW(SH_TYPE * tb, uint64 newsize)
 	}
 
 	SH_FREE(tb, olddata);
+#ifdef SH_USE_TAGS
+	pfree(oldtags);
+#endif
 }
 
 /*
@@ -657,6 +731,9 @@ restart:
 			SH_GET_HASH(tb, entry) = hash;
 #endif
 			entry->status = SH_STATUS_IN_USE;
+#ifdef SH_USE_TAGS
+			SH_SET_TAG(tb, curelem, SH_HASH_TAG(hash));
+#endif
 			*found = false;
 			return entry;
 		}
@@ -734,6 +811,9 @@ restart:
 				moveentry = &data[moveelem];
 
 				memcpy(lastentry, moveentry, sizeof(SH_ELEMENT_TYPE));
+#ifdef SH_USE_TAGS
+				SH_SET_TAG(tb, lastentry - data, tb->tags[moveelem]);
+#endif
 				lastentry = moveentry;
 			}
 
@@ -745,6 +825,9 @@ restart:
 			SH_GET_HASH(tb, entry) = hash;
 #endif
 			entry->status = SH_STATUS_IN_USE;
+#ifdef SH_USE_TAGS
+			SH_SET_TAG(tb, curelem, SH_HASH_TAG(hash));
+#endif
 			*found = false;
 			return entry;
 		}
@@ -802,6 +885,50 @@ SH_LOOKUP_HASH_INTERNAL(SH_TYPE * tb, SH_KEY_TYPE key, uint32 hash)
 	const uint32 startelem = SH_INITIAL_BUCKET(tb, hash);
 	uint32		curelem = startelem;
 
+#if defined(SH_USE_TAGS) && !defined(USE_NO_SIMD)
+	const Vector8 tagvec = vector8_broadcast(SH_HASH_TAG(hash));
+	const Vector8 emptyvec = vector8_broadcast(0);
+
+	/*
+	 * Examine a group of buckets at a time.  Elements whose tag matches are
+	 * candidates, up to the first empty bucket, which ends the search.  As
+	 * the table is never full, we'll get to an empty bucket eventually.
+	 */
+	while (true)
+	{
+		Vector8		chunk;
+		uint32		matches;
+		uint32		empties;
+
+		vector8_load(&chunk, &tb->tags[curelem]);
+		matches = vector8_highbit_mask(vector8_eq(chunk, tagvec));
+		empties = vector8_highbit_mask(vector8_eq(chunk, emptyvec));
+
+		/* ignore candidates after the first empty bucket */
+		if (empties != 0)
+			matches &= (empties & (~empties + 1)) - 1;
+
+		while (matches != 0)
+		{
+			uint32		elem;
+			SH_ELEMENT_TYPE *entry;
+
+			elem = (curelem + pg_rightmost_one_pos32(matches)) & tb->sizemask;
+			entry = &tb->data[elem];
+			Assert(entry->status == SH_STATUS_IN_USE);
+
+			if (SH_COMPARE_KEYS(tb, hash, key, entry))
+				return entry;
+
+			matches &= matches - 1;
+		}
+
+		if (empties != 0)
+			return NULL;
+
+		curelem = (curelem + sizeof(Vector8)) & tb->sizemask;
+	}
+#else
 	while (true)
 	{
 		SH_ELEMENT_TYPE *entry = &tb->data[curelem];
@@ -813,8 +940,14 @@ SH_LOOKUP_HASH_INTERNAL(SH_TYPE * tb, SH_KEY_TYPE key, uint32 hash)
 
 		Assert(entry->status == SH_STATUS_IN_USE);
 
+#ifdef SH_USE_TAGS
+		if (tb->tags[curelem] == SH_HASH_TAG(hash) &&
+			SH_COMPARE_KEYS(tb, hash, key, entry))
+			return entry;
+#else
 		if (SH_COMPARE_KEYS(tb, hash, key, entry))
 			return entry;
+#endif
 
 		/*
 		 * TODO: we could stop search based on distance. If the current
@@ -825,6 +958,7 @@ SH_LOOKUP_HASH_INTERNAL(SH_TYPE * tb, SH_KEY_TYPE key, uint32 hash)
 
 		curelem = SH_NEXT(tb, curelem, startelem);
 	}
+#endif
 }
 
 /*
@@ -893,6 +1027,9 @@ SH_DELETE(SH_TYPE * tb, SH_KEY_TYPE key)
 				if (curentry->status != SH_STATUS_IN_USE)
 				{
 					lastentry->status = SH_STATUS_EMPTY;
+#ifdef SH_USE_TAGS
+					SH_SET_TAG(tb, lastentry - tb->data, 0);
+#endif
 					break;
 				}
 
@@ -903,11 +1040,17 @@ SH_DELETE(SH_TYPE * tb, SH_KEY_TYPE key)
 				if (curoptimal == curelem)
 				{
 					lastentry->status = SH_STATUS_EMPTY;
+#ifdef SH_USE_TAGS
+					SH_SET_TAG(tb, lastentry - tb->data, 0);
+#endif
 					break;
 				}
 
 				/* shift */
 				memcpy(lastentry, curentry, sizeof(SH_ELEMENT_TYPE));
+#ifdef SH_USE_TAGS
+				SH_SET_TAG(tb, lastentry - tb->data, tb->tags[curelem]);
+#endif
 
 				lastentry = curentry;
 			}
@@ -956,6 +1099,9 @@ SH_DELETE_ITEM(SH_TYPE * tb, SH_ELEMENT_TYPE * entry)
 		if (curentry->status != SH_STATUS_IN_USE)
 		{
 			lastentry->status = SH_STATUS_EMPTY;
+#ifdef SH_USE_TAGS
+			SH_SET_TAG(tb, lastentry - tb->data, 0);
+#endif
 			break;
 		}
 
@@ -966,11 +1112,17 @@ SH_DELETE_ITEM(SH_TYPE * tb, SH_ELEMENT_TYPE * entry)
 		if (curoptimal == curelem)
 		{
 			lastentry->status = SH_STATUS_EMPTY;
+#ifdef SH_USE_TAGS
+			SH_SET_TAG(tb, lastentry - tb->data, 0);
+#endif
 			break;
 		}
 
 		/* shift */
 		memcpy(lastentry, curentry, sizeof(SH_ELEMENT_TYPE));
+#ifdef SH_USE_TAGS
+		SH_SET_TAG(tb, lastentry - tb->data, tb->tags[curelem]);
+#endif
 
 		lastentry = curentry;
 	}
@@ -1155,6 +1307,7 @@ SH_STAT(SH_TYPE * tb)
 #undef SH_GET_HASH
 #undef SH_STORE_HASH
 #undef SH_USE_NONDEFAULT_ALLOCATOR
+#undef SH_USE_TAGS
 #undef SH_EQUAL
 
 /* undefine locally declared macros */
@@ -1167,6 +1320,8 @@ SH_STAT(SH_TYPE * tb)
 #undef SH_GROW_MAX_MOVE
 #undef SH_GROW_MIN_FILLFACTOR
 #undef SH_MAX_SIZE
+#undef SH_HASH_TAG
+#undef SH_TAG_PADDING
 
 /* types */
 #undef SH_TYPE
@@ -1204,3 +1359,5 @@ SH_STAT(SH_TYPE * tb)
 #undef SH_ENTRY_HASH
 #undef SH_INSERT_HASH_INTERNAL
 #undef SH_LOOKUP_HASH_INTERNAL
+#undef SH_ALLOCATE_TAGS
+#undef SH_SET_TAG
@@ -53,6 +53,7 @@ typedef struct
 #endif
 #endif							/* ENABLE_SSPI */
 
+#include "common/compression.h"
 #include "datatype/timestamp.h"
 #include "libpq/hba.h"
 #include "libpq/pqcomm.h"
@@ -160,6 +161,14 @@ typedef struct Port
 	 */
 	char	   *application_name;
 
+	/*
+	 * Stream compression algorithm chosen from the ones the client offered
+	 * in the _pq_.compression startup option, or PG_COMPRESSION_NONE.
+	 * Compression starts once it has been announced to the client, right
+	 * before the first ReadyForQuery.
+	 */
+	pg_compress_algorithm compression;
+
 	/*
 	 * Information that needs to be held during the authentication cycle.
 	 */
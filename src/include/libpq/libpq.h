@@ -18,6 +18,7 @@
 
 #include "lib/stringinfo.h"
 #include "libpq/libpq-be.h"
+#include "port/pg_iovec.h"
 #include "storage/latch.h"
 
 
@@ -82,6 +83,11 @@ extern int	pq_getbyte_if_available(unsigned char *c);
 extern ssize_t pq_buffer_remaining_data(void);
 extern int	pq_putmessage_v2(char msgtype, const char *s, size_t len);
 extern bool pq_check_connection(void);
+extern void pq_enable_compression(pg_compress_algorithm algorithm);
+extern pg_compress_algorithm pq_get_compression_stats(uint64 *raw_sent,
+													  uint64 *compressed_sent,
+													  uint64 *raw_received,
+													  uint64 *compressed_received);
 
 /*
  * prototypes for functions in be-secure.c
@@ -106,6 +112,7 @@ extern int	secure_open_server(Port *port);
 extern void secure_close(Port *port);
 extern ssize_t secure_read(Port *port, void *ptr, size_t len);
 extern ssize_t secure_write(Port *port, void *ptr, size_t len);
+extern ssize_t secure_writev(Port *port, const struct iovec *iov, int iovcnt);
 extern ssize_t secure_raw_read(Port *port, void *ptr, size_t len);
 extern ssize_t secure_raw_write(Port *port, const void *ptr, size_t len);
 
@@ -51,12 +51,17 @@
 
 struct PlanState;				/* forward references in this file */
 struct ParallelHashJoinState;
+struct ParallelRepartitionState;
+struct ParallelSortState;
+struct ParallelContext;
 struct ExecRowMark;
 struct ExprState;
 struct ExprContext;
 struct RangeTblEntry;			/* avoid including parsenodes.h here */
 struct ExprEvalStep;			/* avoid including execExpr.h everywhere */
 struct CopyMultiInsertBuffer;
+struct BatchQual;
+struct ExecBatchReader;
 struct LogicalTapeSet;
 
 
@@ -136,6 +141,12 @@ typedef struct ExprState
 	 * before calling ExecInitExprRec() if the caller wants errors thrown.
 	 */
 	ErrorSaveContext *escontext;
+
+	/*
+	 * Number of evaluations left before the expression is JIT compiled, while
+	 * it is still being interpreted; see ExecReadyTieredExpr().
+	 */
+	int			jit_countdown;
 } ExprState;
 
 
@@ -665,6 +676,9 @@ typedef struct EState
 
 	/* Other working state: */
 	MemoryContext es_query_cxt; /* per-query context in which EState lives */
+	MemoryContext es_arena_cxt; /* bump context under es_query_cxt, or NULL
+								 * if not created yet; see
+								 * ExecGetArenaContext */
 
 	List	   *es_tupleTable;	/* List of TupleTableSlots */
 
@@ -1101,6 +1115,44 @@ typedef struct JsonExprState
  */
 typedef TupleTableSlot *(*ExecProcNodeMtd) (struct PlanState *pstate);
 
+/* ----------------
+ *	 ExecProcNodeBatchMtd
+ *
+ * This is the optional method called by ExecProcNodeBatch to return up to
+ * maxslots tuples from an executor node at once, storing pointers to them
+ * into slots[].  The slots belong to the node and stay valid until the next
+ * call.  It returns the number of tuples, which is 0 only if no more tuples
+ * are available.
+ * ----------------
+ */
+typedef int (*ExecProcNodeBatchMtd) (struct PlanState *pstate,
+									 TupleTableSlot **slots,
+									 int maxslots);
+
+/* ----------------
+ *		PlanExprCache node
+ *
+ * Expression states of a plan node kept across executions of a generic
+ * cached plan; see execExprCache.c.  This hangs off the Plan node and lives
+ * in its own memory context under the plan's.
+ * ----------------
+ */
+typedef struct PlanExprCache
+{
+	NodeTag		type;
+
+	MemoryContext context;		/* holds the cache and everything below */
+	bool		in_use;			/* checked out by a PlanState? */
+	LocalTransactionId checkout_lxid;	/* top-level transaction that
+										 * checked it out */
+	bool		building;		/* building one of the states right now? */
+	bool		qual_done;		/* tried to cache the qual? */
+	bool		proj_done;		/* tried to cache the projection? */
+	ExprState  *qual;			/* cached qual, or NULL if not cacheable */
+	ProjectionInfo *projection; /* cached projection, or NULL */
+	List	   *funcids;		/* functions called by the cached states */
+} PlanExprCache;
+
 /* ----------------
  *		PlanState node
  *
@@ -1123,6 +1175,8 @@ typedef struct PlanState
 	ExecProcNodeMtd ExecProcNode;	/* function to return next tuple */
 	ExecProcNodeMtd ExecProcNodeReal;	/* actual function, if above is a
 										 * wrapper */
+	ExecProcNodeBatchMtd ExecProcNodeBatch; /* function to return a batch
+											 * of tuples, or NULL */
 
 	Instrumentation *instrument;	/* Optional runtime stats for this node */
 	WorkerInstrumentation *worker_instrument;	/* per-worker instrumentation */
@@ -1155,6 +1209,7 @@ typedef struct PlanState
 	TupleTableSlot *ps_ResultTupleSlot; /* slot for my result tuples */
 	ExprContext *ps_ExprContext;	/* node's expression-evaluation context */
 	ProjectionInfo *ps_ProjInfo;	/* info for doing tuple projection */
+	PlanExprCache *exprcache;	/* plan's expression cache, if checked out */
 
 	bool		async_capable;	/* true if node is async-capable */
 
@@ -1321,6 +1376,7 @@ typedef struct ResultState
 	ExprState  *resconstantqual;
 	bool		rs_done;		/* are we done? */
 	bool		rs_checkqual;	/* do we need to check the qual? */
+	TupleTableSlot **rs_batchslots; /* slots for ExecProcNodeBatch results */
 } ResultState;
 
 /* ----------------
@@ -1501,6 +1557,9 @@ typedef struct MergeAppendState
  *		intermediate_empty	T if intermediate_table is currently empty
  *		working_table		working table (to be scanned by recursive term)
  *		intermediate_table	current recursive output (next generation of WT)
+ *
+ * If the hash table for UNION outgrows hash_mem, the tuples seen so far are
+ * moved into per-partition tuplestores; see nodeRecursiveunion.c.
  * ----------------
  */
 typedef struct RecursiveUnionState
@@ -1516,6 +1575,13 @@ typedef struct RecursiveUnionState
 	MemoryContext tempContext;	/* short-term context for comparisons */
 	TupleHashTable hashtable;	/* hash table for tuples already seen */
 	MemoryContext tableContext; /* memory context containing hash table */
+	bool		spilled;		/* seen tuples are kept in spill_seen? */
+	bool		spill_pending;	/* any tuples held back in spill_new? */
+	bool		spill_draining; /* returning tuples from spill_output? */
+	Tuplestorestate **spill_seen;	/* per-partition tuples already seen */
+	Tuplestorestate **spill_new;	/* per-partition tuples held back */
+	Tuplestorestate *spill_output;	/* new tuples left to be returned */
+	TupleTableSlot *spill_slot; /* slot for reading the above */
 } RecursiveUnionState;
 
 /* ----------------
@@ -1575,6 +1641,20 @@ typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+
+	/* these fields are used only when tuples are fetched in batches */
+	struct BatchQual *batchqual;	/* batch form of ss.ps.qual, or NULL */
+	TupleTableSlot **batchslots;	/* the tuples of the current batch */
+	bool	   *batchmatches;	/* which of them pass the qual */
+	int			batchsize;		/* max number of tuples in a batch */
+	int			batchlen;		/* number of tuples in the batch */
+	int			batchpos;		/* next tuple of the batch to look at */
+	bool		batchdone;		/* reached the end of the scan? */
+
+	/* passed to table_scan_set_projection() */
+	Bitmapset  *projattrs;		/* columns needed, or NULL for all */
+	int			nprojkeys;		/* number of keys derived from the qual */
+	struct ScanKeyData *projkeys;	/* array of nprojkeys keys */
 } SeqScanState;
 
 /* ----------------
@@ -2177,6 +2257,10 @@ typedef struct MergeJoinState
  *		hj_JoinState			current state of ExecHashJoin state machine
  *		hj_MatchedOuter			true if found a join match for current outer
  *		hj_OuterNotEmpty		true if outer relation known not empty
+ *		hj_OuterHashes			hash values of the tuples in hj_OuterReader
+ *		hj_OuterHashable		whether each of those tuples can match at all
+ *		hj_RadixBuffer			partitioned outer tuples, if probing the hash
+ *								table in radix partitions
  * ----------------
  */
 
@@ -2204,6 +2288,10 @@ typedef struct HashJoinState
 	int			hj_JoinState;
 	bool		hj_MatchedOuter;
 	bool		hj_OuterNotEmpty;
+	struct ExecBatchReader *hj_OuterReader; /* reads the outer plan */
+	uint32	   *hj_OuterHashes;
+	bool	   *hj_OuterHashable;
+	struct HashJoinRadixBuffer *hj_RadixBuffer;
 } HashJoinState;
 
 
@@ -2229,9 +2317,31 @@ typedef struct MaterialState
 	Tuplestorestate *tuplestorestate;
 } MaterialState;
 
+/* ----------------
+ *	 RepartitionState information
+ *
+ *		repartition nodes send each row of their subplan to the participant
+ *		of a parallel query that owns its partition, through shared
+ *		tuplestores, and return the rows of the partitions they own.
+ *
+ *		pstate is NULL when not running in parallel, in which case rows are
+ *		just passed through.
+ * ----------------
+ */
+typedef struct RepartitionState
+{
+	PlanState	ps;				/* its first field is NodeTag */
+	FmgrInfo   *hashfunctions;	/* hash function for each column */
+	struct ParallelRepartitionState *pstate;
+	SharedTuplestoreAccessor **partitions;	/* one per partition */
+	bool		written;		/* subplan's rows sent to their partitions? */
+	int			curpart;		/* partition being read, or -1 */
+} RepartitionState;
+
 struct MemoizeEntry;
 struct MemoizeTuple;
 struct MemoizeKey;
+struct MemoizeSharedCache;
 
 typedef struct MemoizeInstrumentation
 {
@@ -2297,6 +2407,9 @@ typedef struct MemoizeState
 	SharedMemoizeInfo *shared_info; /* statistics for parallel workers */
 	Bitmapset  *keyparamids;	/* Param->paramids of expressions belonging to
 								 * param_exprs */
+	struct MemoizeSharedCache *shared_cache;	/* cache shared by parallel
+												 * workers, or NULL */
+	struct dsa_area *area;		/* DSA area holding shared cache entries */
 } MemoizeState;
 
 /* ----------------
@@ -2340,6 +2453,8 @@ typedef struct SortState
 	bool		am_worker;		/* are we a worker? */
 	bool		datumSort;		/* Datum sort instead of tuple sort? */
 	SharedSortInfo *shared_info;	/* one entry per worker */
+	struct ParallelSortState *pstate;	/* shared state for parallel sort */
+	struct ParallelContext *pcxt;	/* leader's parallel context, if any */
 } SortState;
 
 /* ----------------
@@ -2495,6 +2610,7 @@ typedef struct AggState
 	Tuplesortstate *sort_in;	/* sorted input to phases > 1 */
 	Tuplesortstate *sort_out;	/* input is copied here for next phase */
 	TupleTableSlot *sort_slot;	/* slot for sort results */
+	struct ExecBatchReader *input_reader;	/* reads the outer plan */
 	/* these fields are used in AGG_PLAIN and AGG_SORTED modes: */
 	AggStatePerGroup *pergroups;	/* grouping set indexed array of per-group
 									 * pointers */
@@ -2672,7 +2788,10 @@ typedef struct GatherState
 	int64		tuples_needed;	/* tuple bound, see ExecSetTupleBound */
 	/* these fields are set up once: */
 	TupleTableSlot *funnel_slot;
+	struct ExecBatchReader *local_reader;	/* reads the local plan */
 	struct ParallelExecutorInfo *pei;
+	Oid			into_relid;		/* table for workers to insert into, or
+								 * InvalidOid to have them return tuples */
 	/* all remaining fields are reinitialized during a rescan: */
 	int			nworkers_launched;	/* original number of workers */
 	int			nreaders;		/* number of still-active workers */
@@ -2689,6 +2808,7 @@ typedef struct GatherState
  * ----------------
  */
 struct GMReaderTupleBuffer;		/* private in nodeGatherMerge.c */
+struct GMLoserTree;				/* private in nodeGatherMerge.c */
 
 typedef struct GatherMergeState
 {
@@ -2701,6 +2821,8 @@ typedef struct GatherMergeState
 	TupleDesc	tupDesc;		/* descriptor for subplan result tuples */
 	int			gm_nkeys;		/* number of sort columns */
 	SortSupport gm_sortkeys;	/* array of length gm_nkeys */
+	MemoryContext gm_tuple_cxt; /* holds tuples read from workers */
+	struct ExecBatchReader *local_reader;	/* reads the local plan */
 	struct ParallelExecutorInfo *pei;
 	/* all remaining fields are reinitialized during a rescan */
 	/* (but the arrays are not reallocated, just cleared) */
@@ -2709,7 +2831,7 @@ typedef struct GatherMergeState
 	TupleTableSlot **gm_slots;	/* array with nreaders+1 entries */
 	struct TupleQueueReader **reader;	/* array with nreaders active entries */
 	struct GMReaderTupleBuffer *gm_tuple_buffers;	/* nreaders tuple buffers */
-	struct binaryheap *gm_heap; /* binary heap of slot indices */
+	struct GMLoserTree *gm_tree;	/* loser tree of slot indices */
 } GatherMergeState;
 
 /* ----------------
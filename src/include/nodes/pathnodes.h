@@ -161,6 +161,9 @@ typedef struct PlannerGlobal
 	/* worst PROPARALLEL hazard level */
 	char		maxParallelHazard;
 
+	/* estimated cost of subplans removed by initial partition pruning */
+	Cost		initPruningSavings;
+
 	/* partition descriptors */
 	PartitionDirectory partition_directory pg_node_attr(read_write_ignore);
 } PlannerGlobal;
@@ -1378,11 +1381,14 @@ typedef struct EquivalenceClass
 
 	List	   *ec_opfamilies;	/* btree operator family OIDs */
 	Oid			ec_collation;	/* collation, if datatypes are collatable */
-	List	   *ec_members;		/* list of EquivalenceMembers */
+	List	   *ec_members;		/* list of EquivalenceMembers, except for
+								 * child members (see below) */
+	/* array indexed by relid of lists of child members, or NULL */
+	List	  **ec_childmembers pg_node_attr(read_write_ignore);
+	int			ec_childmembers_size;	/* # of elements in ec_childmembers */
 	List	   *ec_sources;		/* list of generating RestrictInfos */
 	List	   *ec_derives;		/* list of derived RestrictInfos */
-	Relids		ec_relids;		/* all relids appearing in ec_members, except
-								 * for child members (see below) */
+	Relids		ec_relids;		/* all relids appearing in ec_members */
 	bool		ec_has_const;	/* any pseudoconstants in ec_members? */
 	bool		ec_has_volatile;	/* the (sole) member is a volatile expr */
 	bool		ec_broken;		/* failed to generate needed clauses? */
@@ -1412,9 +1418,15 @@ typedef struct EquivalenceClass
  * relation.  An em_is_child member should never be marked em_is_const nor
  * cause ec_has_const or ec_has_volatile to be set, either.  Thus, em_is_child
  * members are not really full-fledged members of the EC, but just reflections
- * or doppelgangers of real members.  Most operations on EquivalenceClasses
- * should ignore em_is_child members, and those that don't should test
- * em_relids to make sure they only consider relevant members.
+ * or doppelgangers of real members.
+ *
+ * Child members are therefore not kept in ec_members.  With thousands of
+ * partitions, scanning them would make every search of an EC slow.  Instead
+ * each child member is listed in ec_childmembers under one of the child
+ * relids in its em_relids, and the EquivalenceMemberIterator finds the child
+ * members that may belong to a given set of relids.  Operations that must
+ * consider child members should use the iterator and then test em_relids to
+ * make sure they only consider relevant members.
  *
  * em_datatype is usually the same as exprType(em_expr), but can be
  * different when dealing with a binary-compatible opfamily; in particular
@@ -1437,6 +1449,25 @@ typedef struct EquivalenceMember
 	struct EquivalenceMember *em_parent pg_node_attr(read_write_ignore);
 } EquivalenceMember;
 
+/*
+ * EquivalenceMemberIterator - iterates over the members of an EC
+ *
+ * Returns all the non-child members of the EC, followed by the child members
+ * listed under any relid in child_relids.  The latter are a superset of the
+ * child members whose em_relids are a subset of child_relids; callers must
+ * filter on em_relids as they see fit.  Use setup_eclass_member_iterator()
+ * and eclass_member_iterator_next(); adding members to the EC during the
+ * iteration is not allowed.
+ */
+typedef struct EquivalenceMemberIterator
+{
+	EquivalenceClass *ec;		/* EC being iterated */
+	Relids		child_relids;	/* relids whose child members to return */
+	int			current_relid;	/* relid of current_list, or -1 */
+	List	   *current_list;	/* list being returned */
+	int			current_index;	/* next index into current_list */
+} EquivalenceMemberIterator;
+
 /*
  * PathKeys
  *
@@ -1971,6 +2002,18 @@ typedef struct MaterialPath
 	Path	   *subpath;
 } MaterialPath;
 
+/*
+ * RepartitionPath represents redistribution of the rows of a partial path
+ * among the participants of a parallel query, by hashing the grouping
+ * columns in groupClause.
+ */
+typedef struct RepartitionPath
+{
+	Path		path;
+	Path	   *subpath;
+	List	   *groupClause;	/* a list of SortGroupClause's */
+} RepartitionPath;
+
 /*
  * MemoizePath represents a Memoize plan node, i.e., a cache that caches
  * tuples from parameterized paths to save the underlying node from having to
@@ -1990,6 +2033,8 @@ typedef struct MemoizePath
 	uint32		est_entries;	/* The maximum number of entries that the
 								 * planner expects will fit in the cache, or 0
 								 * if unknown */
+	int			shared_workers; /* number of parallel workers sharing one
+								 * cache, or 0 for a backend-local cache */
 } MemoizePath;
 
 /*
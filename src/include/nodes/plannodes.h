@@ -65,8 +65,17 @@ typedef struct PlannedStmt
 
 	bool		parallelModeNeeded; /* parallel mode required to execute? */
 
+	bool		cacheExprStates;	/* generic cached plan, whose nodes may
+									 * keep expression states across
+									 * executions? */
+
+	bool		queryCacheable; /* may its result go into the query cache? */
+
 	int			jitFlags;		/* which forms of JIT should be performed */
 
+	Cost		initPruningSavings; /* estimated cost of subplans removed by
+									 * initial partition pruning */
+
 	struct Plan *planTree;		/* tree of Plan nodes */
 
 	List	   *rtable;			/* list of RangeTblEntry nodes */
@@ -169,6 +178,13 @@ typedef struct Plan
 	 */
 	Bitmapset  *extParam;
 	Bitmapset  *allParam;
+
+	/*
+	 * Expression states kept across executions of a generic cached plan; see
+	 * execExprCache.c.  This is executor state, and is neither copied nor
+	 * passed to parallel workers.
+	 */
+	struct PlanExprCache *exprcache pg_node_attr(copy_as(NULL), read_write_ignore, read_as(NULL));
 } Plan;
 
 /* ----------------
@@ -922,6 +938,12 @@ typedef struct Memoize
 
 	/* paramids from param_exprs */
 	Bitmapset  *keyparamids;
+
+	/*
+	 * true if the participants of a parallel query should share their cache
+	 * entries through dynamic shared memory
+	 */
+	bool		shared_cache;
 } Memoize;
 
 /* ----------------
@@ -1126,6 +1148,31 @@ typedef struct Unique
 	Oid		   *uniqCollations pg_node_attr(array_size(numCols));
 } Unique;
 
+/* ----------------
+ *		repartition node
+ *
+ * Redistributes the rows of a partial plan among the participants of a
+ * parallel query by hashing the given columns, so that rows with equal
+ * values in them all end up in the same participant.
+ * ----------------
+ */
+typedef struct Repartition
+{
+	Plan		plan;
+
+	/* number of columns to hash */
+	int			numCols;
+
+	/* their indexes in the target list */
+	AttrNumber *partColIdx pg_node_attr(array_size(numCols));
+
+	/* equality operators, whose hash functions are used */
+	Oid		   *partOperators pg_node_attr(array_size(numCols));
+
+	/* collations to hash with */
+	Oid		   *partCollations pg_node_attr(array_size(numCols));
+} Repartition;
+
 /* ------------
  *		gather node
  *
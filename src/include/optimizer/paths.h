@@ -25,6 +25,14 @@ extern PGDLLIMPORT int geqo_threshold;
 extern PGDLLIMPORT int min_parallel_table_scan_size;
 extern PGDLLIMPORT int min_parallel_index_scan_size;
 extern PGDLLIMPORT bool enable_group_by_reordering;
+extern PGDLLIMPORT int join_search_method;
+
+/* possible values for join_search_method */
+typedef enum JoinSearchMethod
+{
+	JOIN_SEARCH_GENETIC,		/* genetic query optimizer, see geqo_main.c */
+	JOIN_SEARCH_IDP,			/* iterative dynamic programming */
+} JoinSearchMethod;
 
 /* Hook for plugins to get control in set_rel_pathlist() */
 typedef void (*set_rel_pathlist_hook_type) (PlannerInfo *root,
@@ -64,6 +72,15 @@ extern void create_partial_bitmap_paths(PlannerInfo *root, RelOptInfo *rel,
 extern void generate_partitionwise_join_paths(PlannerInfo *root,
 											  RelOptInfo *rel);
 
+/*
+ * idpjoin.c
+ *	  join order search for large join problems
+ */
+extern PGDLLIMPORT int idp_block_size;
+
+extern RelOptInfo *idp_join_search(PlannerInfo *root, int levels_needed,
+								   List *initial_rels);
+
 /*
  * indxpath.c
  *	  routines to generate index paths
@@ -101,6 +118,8 @@ extern void add_paths_to_joinrel(PlannerInfo *root, RelOptInfo *joinrel,
 extern void join_search_one_level(PlannerInfo *root, int level);
 extern RelOptInfo *make_join_rel(PlannerInfo *root,
 								 RelOptInfo *rel1, RelOptInfo *rel2);
+extern RelOptInfo *make_join_rel_estimate(PlannerInfo *root,
+										  RelOptInfo *rel1, RelOptInfo *rel2);
 extern Relids add_outer_joins_to_relids(PlannerInfo *root, Relids input_relids,
 										SpecialJoinInfo *sjinfo,
 										List **pushed_down_joins);
@@ -177,6 +196,10 @@ extern void add_setop_child_rel_equivalences(PlannerInfo *root,
 											 RelOptInfo *child_rel,
 											 List *child_tlist,
 											 List *setop_pathkeys);
+extern void setup_eclass_member_iterator(EquivalenceMemberIterator *it,
+										 EquivalenceClass *ec,
+										 Relids child_relids);
+extern EquivalenceMember *eclass_member_iterator_next(EquivalenceMemberIterator *it);
 extern List *generate_implied_equalities_for_column(PlannerInfo *root,
 													RelOptInfo *rel,
 													ec_matches_callback_type callback,
@@ -74,6 +74,9 @@ extern PartitionPruneInfo *make_partition_pruneinfo(struct PlannerInfo *root,
 													struct RelOptInfo *parentrel,
 													List *subpaths,
 													List *prunequal);
+extern Cost estimate_initial_pruning_savings(struct PlannerInfo *root,
+											 PartitionPruneInfo *pruneinfo,
+											 List *subpaths);
 extern Bitmapset *prune_append_rel_partitions(struct RelOptInfo *rel);
 extern Bitmapset *get_matching_partitions(PartitionPruneContext *context,
 										  List *pruning_steps);
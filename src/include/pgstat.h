@@ -235,7 +235,7 @@ typedef struct PgStat_TableXactStatus
  * ------------------------------------------------------------
  */
 
-#define PGSTAT_FILE_FORMAT_ID	0x01A5BCAC
+#define PGSTAT_FILE_FORMAT_ID	0x01A5BCB0
 
 typedef struct PgStat_ArchiverStats
 {
@@ -296,6 +296,7 @@ typedef enum IOContext
 typedef enum IOOp
 {
 	IOOP_EVICT,
+	IOOP_EVICT_RETRY,
 	IOOP_EXTEND,
 	IOOP_FSYNC,
 	IOOP_HIT,
@@ -341,6 +342,12 @@ typedef struct PgStat_StatDBEntry
 	PgStat_Counter temp_files;
 	PgStat_Counter temp_bytes;
 	PgStat_Counter deadlocks;
+	PgStat_Counter deadlock_checks;
+	PgStat_Counter deadlock_full_checks;
+	PgStat_Counter deadlock_check_time; /* time in microseconds */
+	PgStat_Counter subxid_overflows;
+	PgStat_Counter predlock_promotions;
+	PgStat_Counter serialization_failures;
 	PgStat_Counter checksum_failures;
 	TimestampTz last_checksum_failure;
 	PgStat_Counter blk_read_time;	/* times in microseconds */
@@ -545,6 +552,10 @@ extern void pgstat_drop_database(Oid databaseid);
 extern void pgstat_report_autovac(Oid dboid);
 extern void pgstat_report_recovery_conflict(int reason);
 extern void pgstat_report_deadlock(void);
+extern void pgstat_report_deadlock_check(bool full, PgStat_Counter usecs);
+extern void pgstat_report_subxid_overflow(void);
+extern void pgstat_report_predicate_lock_promotion(void);
+extern void pgstat_report_serialization_failures(int count);
 extern void pgstat_report_checksum_failures_in_db(Oid dboid, int failurecount);
 extern void pgstat_report_checksum_failure(void);
 extern void pgstat_report_connect(Oid dboid);
@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.h
+ *	  Basic NUMA memory placement support.
+ *
+ * This is implemented with raw Linux system calls, so libnuma is not needed.
+ * On other platforms, and on kernels without NUMA support, the functions fail
+ * with ENOSYS.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * src/include/port/pg_numa.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_NUMA_H
+#define PG_NUMA_H
+
+#if defined(__linux__) && defined(HAVE_LINUX_MEMPOLICY_H)
+#define USE_NUMA
+#endif
+
+/* Highest number of nodes we will work with */
+#define PG_NUMA_MAX_NODES 64
+
+extern int	pg_numa_get_nodes(int *nodes, int max_nodes);
+extern int	pg_numa_current_node(void);
+extern int	pg_numa_interleave(void *ptr, size_t size,
+							   const int *nodes, int nnodes);
+extern int	pg_numa_bind(void *ptr, size_t size, int node);
+extern int	pg_numa_query_pages(unsigned long count, void **pages,
+								int *status);
+
+#endif							/* PG_NUMA_H */
@@ -0,0 +1,35 @@
+/*-------------------------------------------------------------------------
+ *
+ * profiler.h
+ *
+ * Header file for the sampling query profiler.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/include/postmaster/profiler.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+extern PGDLLIMPORT int profiler_buffer_size;
+extern PGDLLIMPORT int profiler_sample_interval;
+
+/*
+ * Backends publish the plan node they are executing in
+ * PGPROC->exec_node_info only when the profiler is enabled.
+ */
+#define ProfilerEnabled()	(profiler_buffer_size > 0)
+
+/* Pack a plan node's type and ID into a PGPROC->exec_node_info value */
+#define PROFILER_NODE_INFO(tag, plan_node_id) \
+	(((uint32) (tag) << 16) | ((uint32) (plan_node_id) & 0xFFFF))
+
+extern Size ProfilerShmemSize(void);
+extern void ProfilerShmemInit(void);
+extern void ProfilerRegister(void);
+extern void ProfilerMain(Datum main_arg) pg_attribute_noreturn();
+
+#endif							/* PROFILER_H */
@@ -181,6 +181,8 @@ extern size_t pg_regerror(int errcode, const regex_t *preg, char *errbuf,
 						  size_t errbuf_size);
 
 /* regexp.c */
+extern PGDLLIMPORT int regexp_cache_size;
+
 extern regex_t *RE_compile_and_cache(text *text_re, int cflags, Oid collation);
 extern bool RE_compile_and_execute(text *text_re, char *dat, int dat_len,
 								   int cflags, Oid collation,
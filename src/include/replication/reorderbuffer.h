@@ -634,6 +634,10 @@ struct ReorderBuffer
 	char	   *outbuf;
 	Size		outbufsize;
 
+	/* buffer for compressing and decompressing spilled changes */
+	char	   *compressbuf;
+	Size		compressbufsize;
+
 	/* memory accounting */
 	Size		size;
 
@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * walcompress.h
+ *	  Stream compression of WAL sent over physical replication connections.
+ *
+ * Portions Copyright (c) 2010-2024, PostgreSQL Global Development Group
+ *
+ * src/include/replication/walcompress.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _WALCOMPRESS_H
+#define _WALCOMPRESS_H
+
+#include "common/compression.h"
+#include "lib/stringinfo.h"
+
+typedef struct WalCompressor WalCompressor;
+typedef struct WalDecompressor WalDecompressor;
+
+extern WalCompressor *WalCompressorCreate(pg_compress_specification *spec);
+extern void WalCompressData(WalCompressor *wc, const char *data, size_t len,
+							StringInfo out);
+extern void WalCompressorFree(WalCompressor *wc);
+
+extern WalDecompressor *WalDecompressorCreate(pg_compress_algorithm algorithm);
+extern void WalDecompressData(WalDecompressor *wd, const char *data,
+							  size_t len, StringInfo out);
+extern void WalDecompressorFree(WalDecompressor *wd);
+
+#endif							/* _WALCOMPRESS_H */
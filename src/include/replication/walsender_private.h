@@ -13,6 +13,7 @@
 #define _WALSENDER_PRIVATE_H
 
 #include "access/xlog.h"
+#include "common/compression.h"
 #include "lib/ilist.h"
 #include "nodes/nodes.h"
 #include "nodes/replnodes.h"
@@ -83,6 +84,16 @@ typedef struct WalSnd
 	TimestampTz replyTime;
 
 	ReplicationKind kind;
+
+	/*
+	 * Compression of the WAL stream, if the client asked for it: bytes of WAL
+	 * fed to the compressor, bytes of compressed data it produced, and time
+	 * spent compressing, in microseconds.
+	 */
+	pg_compress_algorithm compression;
+	uint64		compressInBytes;
+	uint64		compressOutBytes;
+	int64		compressTime;
 } WalSnd;
 
 extern PGDLLIMPORT WalSnd *MyWalSnd;
@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Per-backend asynchronous I/O submission and completion.
+ *
+ * The buffer manager uses this to start reads and writes without waiting for
+ * them, and to collect their results later.  The only asynchronous
+ * implementation is Linux io_uring.  With io_method = sync, or if the
+ * asynchronous implementation is unavailable at runtime, pgaio_enabled()
+ * returns false and callers perform the I/O synchronously as before.
+ *
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+#include "port/pg_iovec.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#define USE_IO_URING
+#endif
+
+/* Possible values for io_method GUC */
+typedef enum IoMethod
+{
+	IOMETHOD_SYNC = 0,
+	IOMETHOD_IO_URING,
+} IoMethod;
+
+#define DEFAULT_IO_METHOD IOMETHOD_SYNC
+
+/*
+ * Maximum number of asynchronous I/Os a single backend can have in flight.
+ * Each one may cover up to PG_IOV_MAX iovecs.
+ */
+#define PGAIO_MAX_IN_FLIGHT 128
+
+/* GUC */
+extern PGDLLIMPORT int io_method;
+
+extern bool pgaio_enabled(void);
+extern int	pgaio_acquire(void);
+extern bool pgaio_start_readv(int handle, int fd, const struct iovec *iov,
+							  int iovcnt, off_t offset);
+extern bool pgaio_start_writev(int handle, int fd, const struct iovec *iov,
+							   int iovcnt, off_t offset);
+extern bool pgaio_start_fsync(int handle, int fd);
+extern ssize_t pgaio_wait(int handle);
+extern ssize_t pgaio_wait_for(int handle, uint32 wait_event_info);
+extern void pgaio_release(int handle);
+extern int	pgaio_in_flight(void);
+
+#endif							/* AIO_H */
@@ -424,6 +424,11 @@ extern IOContext IOContextForStrategy(BufferAccessStrategy strategy);
 extern BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy,
 									 uint32 *buf_state, bool *from_ring);
 extern void StrategyFreeBuffer(BufferDesc *buf);
+extern void StrategyTagAssigned(BufferDesc *buf, uint32 hashcode);
+extern void StrategyTagRemoved(BufferDesc *buf, uint32 hashcode, bool evicted);
+extern bool StrategyBufferIsCandidate(BufferDesc *buf, uint32 buf_state);
+extern int	StrategyActiveBuffers(void);
+extern int	StrategySetActiveBuffers(int nbuffers);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 								 BufferDesc *buf, bool from_ring);
 
@@ -439,9 +444,29 @@ extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupOptimistic(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
+/* secondary_cache.c */
+extern PGDLLIMPORT int SecondaryCacheNumSlots;
+
+#define SecondaryCacheEnabled() (SecondaryCacheNumSlots > 0)
+
+extern Size SecondaryCacheShmemSize(void);
+extern void SecondaryCacheShmemInit(void);
+extern bool SecondaryCacheStore(const BufferTag *tag, Block block);
+extern bool SecondaryCacheRead(const BufferTag *tag, Block block);
+extern bool SecondaryCacheContains(const BufferTag *tag);
+extern void SecondaryCacheForget(const BufferTag *tag);
+extern void SecondaryCacheDropRelationBuffers(RelFileLocator rlocator,
+											  ForkNumber *forkNum, int nforks,
+											  BlockNumber *nForkBlock,
+											  BlockNumber *firstDelBlock);
+extern void SecondaryCacheDropRelationsAllBuffers(RelFileLocator *locators,
+												  int nlocators);
+extern void SecondaryCacheDropDatabaseBuffers(Oid dbid);
+
 /* localbuf.c */
 extern bool PinLocalBuffer(BufferDesc *buf_hdr, bool adjust_usagecount);
 extern void UnpinLocalBuffer(Buffer buffer);
@@ -459,10 +484,10 @@ extern BlockNumber ExtendBufferedRelLocal(BufferManagerRelation bmr,
 										  Buffer *buffers,
 										  uint32 *extended_by);
 extern void MarkLocalBufferDirty(Buffer buffer);
-extern void DropRelationLocalBuffers(RelFileLocator rlocator,
+extern void DropRelationLocalBuffers(SMgrRelation smgr,
 									 ForkNumber forkNum,
 									 BlockNumber firstDelBlock);
-extern void DropRelationAllLocalBuffers(RelFileLocator rlocator);
+extern void DropRelationAllLocalBuffers(SMgrRelation smgr);
 extern void AtEOXact_LocalBuffers(bool isCommit);
 
 #endif							/* BUFMGR_INTERNALS_H */
@@ -32,11 +32,24 @@
 
 typedef struct BufFile BufFile;
 
+/* Compression algorithms for temporary files */
+typedef enum TempFileCompression
+{
+	TEMP_FILE_COMPRESSION_NONE = 0,
+	TEMP_FILE_COMPRESSION_PGLZ,
+	TEMP_FILE_COMPRESSION_LZ4,
+	TEMP_FILE_COMPRESSION_ZSTD,
+} TempFileCompression;
+
+/* GUC variable */
+extern PGDLLIMPORT int temp_file_compression;
+
 /*
  * prototypes for functions in buffile.c
  */
 
 extern BufFile *BufFileCreateTemp(bool interXact);
+extern BufFile *BufFileCreateCompressTemp(bool interXact);
 extern void BufFileClose(BufFile *file);
 extern pg_nodiscard size_t BufFileRead(BufFile *file, void *ptr, size_t size);
 extern void BufFileReadExact(BufFile *file, void *ptr, size_t size);
@@ -109,7 +109,7 @@ typedef struct BufferManagerRelation
 
 /* Zero out page if reading fails. */
 #define READ_BUFFERS_ZERO_ON_ERROR (1 << 0)
-/* Call smgrprefetch() if I/O necessary. */
+/* Start I/O early if necessary, asynchronously or with smgrprefetch(). */
 #define READ_BUFFERS_ISSUE_ADVICE (1 << 1)
 
 struct ReadBuffersOperation
@@ -135,10 +135,21 @@ struct ReadBuffersOperation
 	int			flags;
 	int16		nblocks;
 	int16		io_buffers_len;
+	int16		io_async_len;	/* leading buffers read asynchronously */
+	int			io_handle;
+	uint64		io_async_id;
 };
 
 typedef struct ReadBuffersOperation ReadBuffersOperation;
 
+/* Number of shared buffers holding pages of one relation fork */
+typedef struct BufferResidency
+{
+	RelFileLocator rlocator;
+	ForkNumber	forkNum;
+	int64		nbuffers;
+} BufferResidency;
+
 /* forward declared, to avoid having to expose buf_internals.h here */
 struct WritebackContext;
 
@@ -302,15 +313,33 @@ extern void LimitAdditionalPins(uint32 *additional_pins);
 extern void LimitAdditionalLocalPins(uint32 *additional_pins);
 
 extern bool EvictUnpinnedBuffer(Buffer buf);
+extern bool BufferPoolResize(void);
 
 /* in buf_init.c */
+extern PGDLLIMPORT int active_shared_buffers;
 extern void InitBufferPool(void);
 extern Size BufferShmemSize(void);
 
+/* in buf_table.c */
+extern PGDLLIMPORT bool track_buffer_residency;
+extern BufferResidency *BufResidencySnapshot(int *nentries);
+
 /* in localbuf.c */
 extern void AtProcExit_LocalBuffers(void);
 
+/* in secondary_cache.c */
+extern PGDLLIMPORT char *secondary_buffer_cache_path;
+extern PGDLLIMPORT int secondary_buffer_cache_size;
+
 /* in freelist.c */
+extern PGDLLIMPORT int buffer_replacement_policy;
+
+/* Possible values for buffer_replacement_policy */
+typedef enum BufferReplacementPolicy
+{
+	BUFFER_REPLACEMENT_CLOCK,
+	BUFFER_REPLACEMENT_2Q,
+} BufferReplacementPolicy;
 
 extern BufferAccessStrategy GetAccessStrategy(BufferAccessStrategyType btype);
 extern BufferAccessStrategy GetAccessStrategyWithSize(BufferAccessStrategyType btype,
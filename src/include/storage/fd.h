@@ -135,6 +135,7 @@ extern int	FreeFile(FILE *file);
 
 /* Operations that allow use of pipe streams (popen/pclose) */
 extern FILE *OpenPipeStream(const char *command, const char *mode);
+extern int	System(const char *command);
 extern int	ClosePipeStream(FILE *file);
 
 /* Operations to allow use of the <dirent.h> library routines */
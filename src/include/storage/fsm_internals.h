@@ -67,6 +67,7 @@ extern uint8 fsm_get_avail(Page page, int slot);
 extern uint8 fsm_get_max_avail(Page page);
 extern bool fsm_set_avail(Page page, int slot, uint8 value);
 extern bool fsm_truncate_avail(Page page, int nslots);
+extern void fsm_set_next_slot(Page page, int slot);
 extern bool fsm_rebuild_page(Page page);
 
 #endif							/* FSM_INTERNALS_H */
@@ -38,6 +38,9 @@
  * postmaster child processes to wake up immediately on postmaster death.
  * See latch.c for detailed specifications for the exported functions.
  *
+ * Code that wakes up many processes at once can collect their latches in a
+ * LatchBatch with AddLatch, and set them all with SetLatches.
+ *
  * The correct pattern to wait for event(s) is:
  *
  * for (;;)
@@ -120,6 +123,18 @@ typedef struct Latch
 #endif
 } Latch;
 
+/*
+ * A set of latches to be set together by SetLatches().  Initialize with
+ * LatchBatch batch = {0}.
+ */
+#define LATCH_BATCH_SIZE	64
+
+typedef struct LatchBatch
+{
+	int			size;
+	Latch	   *latches[LATCH_BATCH_SIZE];
+} LatchBatch;
+
 /*
  * Bitmasks for events that may wake-up WaitLatch(), WaitLatchOrSocket(), or
  * WaitEventSetWait().
@@ -172,6 +187,8 @@ extern void InitSharedLatch(Latch *latch);
 extern void OwnLatch(Latch *latch);
 extern void DisownLatch(Latch *latch);
 extern void SetLatch(Latch *latch);
+extern void AddLatch(LatchBatch *batch, Latch *latch);
+extern void SetLatches(LatchBatch *batch);
 extern void ResetLatch(Latch *latch);
 extern void ShutdownLatchSupport(void);
 
@@ -138,6 +138,9 @@ extern void LWLockUpdateVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 val);
 
 extern Size LWLockShmemSize(void);
 extern void CreateLWLocks(void);
+extern Size LWLockReaderSlotsShmemSize(void);
+extern void LWLockReaderSlotsShmemInit(void);
+extern bool LWLockMakeBigReader(LWLock *lock);
 extern void InitLWLockAccess(void);
 
 extern const char *GetLWLockIdentifier(uint32 classId, uint16 eventId);
@@ -215,6 +218,10 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_SUBTRANS_SLRU,
 	LWTRANCHE_XACT_SLRU,
 	LWTRANCHE_PARALLEL_VACUUM_DSA,
+	LWTRANCHE_SECONDARY_BUFFER_CACHE,
+	LWTRANCHE_PARALLEL_MEMOIZE,
+	LWTRANCHE_QUERY_CACHE,
+	LWTRANCHE_QUERY_CACHE_DSA,
 	LWTRANCHE_FIRST_USER_DEFINED,
 }			BuiltinTrancheIds;
 
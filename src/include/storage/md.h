@@ -15,6 +15,7 @@
 #define MD_H
 
 #include "storage/block.h"
+#include "storage/fd.h"
 #include "storage/relfilelocator.h"
 #include "storage/smgr.h"
 #include "storage/sync.h"
@@ -34,6 +35,9 @@ extern bool mdprefetch(SMgrRelation reln, ForkNumber forknum,
 					   BlockNumber blocknum, int nblocks);
 extern void mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 					void **buffers, BlockNumber nblocks);
+extern BlockNumber mdstartreadv(SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum, void **buffers,
+								BlockNumber nblocks, int handle);
 extern void mdwritev(SMgrRelation reln, ForkNumber forknum,
 					 BlockNumber blocknum,
 					 const void **buffers, BlockNumber nblocks, bool skipFsync);
@@ -50,6 +54,7 @@ extern void DropRelationFiles(RelFileLocator *delrels, int ndelrels, bool isRedo
 
 /* md sync callbacks */
 extern int	mdsyncfiletag(const FileTag *ftag, char *path);
+extern File mdopenfiletag(const FileTag *ftag, char *path);
 extern int	mdunlinkfiletag(const FileTag *ftag, char *path);
 extern bool mdfiletagmatches(const FileTag *ftag, const FileTag *candidate);
 
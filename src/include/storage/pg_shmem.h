@@ -45,6 +45,8 @@ typedef struct PGShmemHeader	/* standard header for all Postgres shmem */
 extern PGDLLIMPORT int shared_memory_type;
 extern PGDLLIMPORT int huge_pages;
 extern PGDLLIMPORT int huge_page_size;
+extern PGDLLIMPORT int huge_pages_status;
+extern PGDLLIMPORT int numa_placement;
 
 /* Possible values for huge_pages and huge_pages_status */
 typedef enum
@@ -55,6 +57,14 @@ typedef enum
 	HUGE_PAGES_UNKNOWN,			/* only for huge_pages_status */
 }			HugePagesType;
 
+/* Possible values for numa_placement */
+typedef enum
+{
+	NUMA_PLACEMENT_OFF,
+	NUMA_PLACEMENT_INTERLEAVE,
+	NUMA_PLACEMENT_PARTITION,
+}			NumaPlacementType;
+
 /* Possible values for shared_memory_type */
 typedef enum
 {
@@ -24,9 +24,10 @@
 #include "storage/procnumber.h"
 
 /*
- * Each backend advertises up to PGPROC_MAX_CACHED_SUBXIDS TransactionIds
- * for non-aborted subtransactions of its current top transaction.  These
- * have to be treated as running XIDs by other backends.
+ * Each backend advertises up to max_cached_subxids TransactionIds for
+ * non-aborted subtransactions of its current top transaction.  These have to
+ * be treated as running XIDs by other backends.  The cache arrays are carved
+ * out of shared memory at startup, so their size is fixed until restart.
  *
  * We also keep track of whether the cache overflowed (ie, the transaction has
  * generated at least one subtransaction that didn't fit in the cache).
@@ -34,21 +35,28 @@
  * listed anywhere in the PGPROC array is not a running transaction.  Else we
  * have to look at pg_subtrans.
  *
+ * PGPROC_MIN_CACHED_SUBXIDS is the smallest cache size allowed.  It is also
+ * the batch size in which subxids are reported to standbys, which cannot
+ * track more than that many subxids per transaction.
+ *
  * See src/test/isolation/specs/subxid-overflow.spec if you change this.
  */
-#define PGPROC_MAX_CACHED_SUBXIDS 64	/* XXX guessed-at value */
+#define PGPROC_MIN_CACHED_SUBXIDS 64
+#define PGPROC_MAX_CACHED_SUBXIDS_LIMIT 8192
+
+extern PGDLLIMPORT int max_cached_subxids;
 
 typedef struct XidCacheStatus
 {
-	/* number of cached subxids, never more than PGPROC_MAX_CACHED_SUBXIDS */
-	uint8		count;
+	/* number of cached subxids, never more than max_cached_subxids */
+	uint16		count;
 	/* has PGPROC->subxids overflowed */
 	bool		overflowed;
 } XidCacheStatus;
 
 struct XidCache
 {
-	TransactionId xids[PGPROC_MAX_CACHED_SUBXIDS];
+	TransactionId *xids;		/* max_cached_subxids entries */
 };
 
 /*
@@ -78,12 +86,21 @@ struct XidCache
 #define		PROC_XMIN_FLAGS (PROC_IN_VACUUM | PROC_IN_SAFE_IC)
 
 /*
- * We allow a small number of "weak" relation locks (AccessShareLock,
+ * We allow a limited number of "weak" relation locks (AccessShareLock,
  * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
  * rather than the main lock table.  This eases contention on the lock
  * manager LWLocks.  See storage/lmgr/README for additional details.
+ *
+ * The slots are organized in groups of FP_LOCK_SLOTS_PER_GROUP, so that the
+ * lock modes of a whole group fit into one uint64.  The number of groups is
+ * derived from max_locks_per_transaction at server start.
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+extern PGDLLIMPORT int FastPathLockGroupsPerBackend;
+
+#define		FP_LOCK_GROUPS_PER_BACKEND_MAX	1024
+#define		FP_LOCK_SLOTS_PER_GROUP		16	/* don't change */
+#define		FastPathLockSlotsPerBackend() \
+	(FP_LOCK_SLOTS_PER_GROUP * FastPathLockGroupsPerBackend)
 
 /*
  * Flags for PGPROC.delayChkptFlags
@@ -279,6 +296,7 @@ struct PGPROC
 	TransactionId procArrayGroupMemberXid;
 
 	uint32		wait_event_info;	/* proc's wait information */
+	uint32		exec_node_info; /* plan node being executed, if profiling */
 
 	/* Support for group transaction status update. */
 	bool		clogGroupMember;	/* true, if member of clog group */
@@ -293,8 +311,9 @@ struct PGPROC
 
 	/* Lock manager data, recording fast-path locks taken by this backend. */
 	LWLock		fpInfoLock;		/* protects per-backend fast-path state */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND]; /* slots for rel oids */
+	uint64	   *fpLockBits;		/* lock modes held for each fast-path slot,
+								 * one word per group of slots */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
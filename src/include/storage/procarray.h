@@ -20,6 +20,8 @@
 #include "utils/snapshot.h"
 
 
+extern PGDLLIMPORT bool procarray_big_reader_lock;
+
 extern Size ProcArrayShmemSize(void);
 extern void CreateSharedProcArray(void);
 extern void ProcArrayAdd(PGPROC *proc);
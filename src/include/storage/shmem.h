@@ -37,6 +37,10 @@ extern HTAB *ShmemInitHash(const char *name, long init_size, long max_size,
 extern void *ShmemInitStruct(const char *name, Size size, bool *foundPtr);
 extern Size add_size(Size s1, Size s2);
 extern Size mul_size(Size s1, Size s2);
+extern int	ShmemNumaNodes(const int **nodes);
+extern void ShmemNumaInterleave(void *ptr, Size size);
+extern void ShmemNumaBind(void *ptr, Size size, int node);
+extern void ShmemRelease(void *ptr, Size size);
 
 /* ipci.c */
 extern void RequestAddinShmemSpace(Size size);
@@ -43,6 +43,8 @@ typedef struct SMgrRelationData
 	 * invalidation for fork extension.
 	 */
 	BlockNumber smgr_targblock; /* current insertion target block */
+	BlockNumber smgr_reserved_next; /* next block set aside for inserts */
+	BlockNumber smgr_reserved_last; /* last block set aside for inserts */
 	BlockNumber smgr_cached_nblocks[MAX_FORKNUM + 1];	/* last known size */
 
 	/* additional public fields may someday exist here */
@@ -95,6 +97,10 @@ extern bool smgrprefetch(SMgrRelation reln, ForkNumber forknum,
 extern void smgrreadv(SMgrRelation reln, ForkNumber forknum,
 					  BlockNumber blocknum,
 					  void **buffer, BlockNumber nblocks);
+extern BlockNumber smgrstartreadv(SMgrRelation reln, ForkNumber forknum,
+								  BlockNumber blocknum,
+								  void **buffers, BlockNumber nblocks,
+								  int handle);
 extern void smgrwritev(SMgrRelation reln, ForkNumber forknum,
 					   BlockNumber blocknum,
 					   const void **buffer, BlockNumber nblocks,
@@ -110,6 +116,22 @@ extern void smgrregistersync(SMgrRelation reln, ForkNumber forknum);
 extern void AtEOXact_SMgr(void);
 extern bool ProcessBarrierSmgrRelease(void);
 
+/* relsize_cache.c */
+extern PGDLLIMPORT int relation_size_cache_size;
+
+extern Size RelSizeCacheShmemSize(void);
+extern void RelSizeCacheShmemInit(void);
+extern BlockNumber RelSizeCacheLookup(RelFileLocatorBackend rlocator,
+									  ForkNumber forknum, uint32 *token);
+extern void RelSizeCacheFill(RelFileLocatorBackend rlocator, ForkNumber forknum,
+							 uint32 token, BlockNumber nblocks);
+extern void RelSizeCacheUpdate(RelFileLocatorBackend rlocator,
+							   ForkNumber forknum, BlockNumber nblocks,
+							   bool extended);
+extern void RelSizeCacheForget(RelFileLocatorBackend rlocator,
+							   ForkNumber forknum);
+extern void RelSizeCacheForgetDatabase(Oid dbid);
+
 static inline void
 smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		 void *buffer)
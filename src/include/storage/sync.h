@@ -55,6 +55,8 @@ typedef struct FileTag
 	uint64		segno;
 } FileTag;
 
+extern PGDLLIMPORT int checkpoint_sync_concurrency;
+
 extern void InitSync(void);
 extern void SyncPreCheckpoint(void);
 extern void SyncPostCheckpoint(void);
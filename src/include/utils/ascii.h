@@ -81,4 +81,23 @@ is_valid_ascii(const unsigned char *s, int len)
 	return true;
 }
 
+/*
+ * Return the length of the longest prefix of the input that consists of
+ * whole chunks of valid ASCII, as checked by is_valid_ascii().
+ *
+ * This lets encoding conversion routines copy runs of ASCII a vector at a
+ * time; they handle any remaining bytes one at a time as usual.
+ */
+static inline int
+ascii_chunks_prefix_len(const unsigned char *s, int len)
+{
+	int			n = 0;
+
+	while (len - n >= (int) sizeof(Vector8) &&
+		   is_valid_ascii(s + n, sizeof(Vector8)))
+		n += sizeof(Vector8);
+
+	return n;
+}
+
 #endif							/* _ASCII_H_ */
@@ -402,6 +402,13 @@ extern JsonbValue *findJsonbValueFromContainer(JsonbContainer *container,
 extern JsonbValue *getKeyJsonValueFromContainer(JsonbContainer *container,
 												const char *keyVal, int keyLen,
 												JsonbValue *res);
+extern JsonbValue *getKeyJsonValueFromDatum(Datum jsonb,
+											const char *keyVal, int keyLen,
+											JsonbValue *res, bool *isobject);
+extern void getKeyJsonValuesFromContainer(JsonbContainer *container,
+										  int nkeys, const char **keys,
+										  const int *keyLens,
+										  JsonbValue *res, bool *found);
 extern JsonbValue *getIthJsonbValueFromContainer(JsonbContainer *container,
 												 uint32 i);
 extern JsonbValue *pushJsonbValue(JsonbParseState **pstate,
@@ -66,6 +66,15 @@ extern PGDLLIMPORT MemoryContext CurTransactionContext;
 /* This is a transient link to the active portal's memory context: */
 extern PGDLLIMPORT MemoryContext PortalContext;
 
+/*
+ * Memory malloc'd by all memory contexts of this process, maintained
+ * incrementally by the context implementations.
+ */
+extern PGDLLIMPORT Size MemoryContextBackendAllocated;
+
+/* GUC variable, in megabytes; 0 means no limit */
+extern PGDLLIMPORT int max_total_backend_memory;
+
 
 /*
  * Memory-context-type-independent functions in mcxt.c
@@ -84,6 +93,8 @@ extern Size GetMemoryChunkSpace(void *pointer);
 extern MemoryContext MemoryContextGetParent(MemoryContext context);
 extern bool MemoryContextIsEmpty(MemoryContext context);
 extern Size MemoryContextMemAllocated(MemoryContext context, bool recurse);
+extern bool MemoryContextCheckTotalLimit(Size size);
+extern void MemoryContextReportAllocated(void);
 extern void MemoryContextMemConsumed(MemoryContext context,
 									 MemoryContextCounters *consumed);
 extern void MemoryContextStats(MemoryContext context);
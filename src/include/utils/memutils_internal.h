@@ -163,6 +163,46 @@ extern void *MemoryContextAllocationFailure(MemoryContext context, Size size,
 extern void MemoryContextSizeFailure(MemoryContext context, Size size,
 									 int flags) pg_attribute_noreturn();
 
+/*
+ * The backend's allocation total is published for other processes whenever
+ * it has drifted this far from the value last published.
+ */
+#define MEMORY_ACCOUNTING_REPORT_THRESHOLD	(1024 * 1024)
+
+extern PGDLLIMPORT Size MemoryContextBackendReported;
+
+/*
+ * MemoryContextAccountAllocated
+ *		Track a change in the memory malloc'd by a context implementation.
+ *
+ * Implementations call this with every change they make to mem_allocated,
+ * which makes the backend-wide total available in O(1).
+ */
+static inline void
+MemoryContextAccountAllocated(int64 delta)
+{
+	MemoryContextBackendAllocated += delta;
+
+	if (unlikely(MemoryContextBackendAllocated >=
+				 MemoryContextBackendReported + MEMORY_ACCOUNTING_REPORT_THRESHOLD ||
+				 MemoryContextBackendAllocated + MEMORY_ACCOUNTING_REPORT_THRESHOLD <=
+				 MemoryContextBackendReported))
+		MemoryContextReportAllocated();
+}
+
+/*
+ * MemoryContextAllocationAllowed
+ *		Check whether a new block of the given size may be malloc'd without
+ *		exceeding max_total_backend_memory.
+ */
+static inline bool
+MemoryContextAllocationAllowed(Size size)
+{
+	if (likely(max_total_backend_memory == 0))
+		return true;
+	return MemoryContextCheckTotalLimit(size);
+}
+
 static inline void
 MemoryContextCheckSize(MemoryContext context, Size size, int flags)
 {
@@ -109,6 +109,15 @@ typedef struct PgStatShared_Common
 	uint32		magic;			/* just a validity cross-check */
 	/* lock protecting stats contents (i.e. data following the header) */
 	LWLock		lock;
+
+	/*
+	 * Advanced, while holding the lock exclusively, whenever the contents may
+	 * change.  Lets backends reuse their copy from an earlier snapshot
+	 * without taking the lock if the entry hasn't changed since.  Each entry
+	 * starts at a distinct multiple of 2^32, so that an entry recreated for
+	 * the same object isn't mistaken for its predecessor.
+	 */
+	pg_atomic_uint64 generation;
 } PgStatShared_Common;
 
 /*
@@ -424,6 +433,9 @@ typedef struct PgStat_ShmemControl
 	 */
 	pg_atomic_uint64 gc_request_count;
 
+	/* source of initial PgStatShared_Common->generation values */
+	pg_atomic_uint64 next_generation;
+
 	/*
 	 * Stats data for fixed-numbered objects.
 	 */
@@ -463,6 +475,15 @@ typedef struct PgStat_Snapshot
 	/* to free snapshot in bulk */
 	MemoryContext context;
 	struct pgstat_snapshot_hash *stats;
+
+	/*
+	 * Copies of variable-numbered stats made for recent snapshots, reused
+	 * by later ones if the shared entry's generation is unchanged.  Kept
+	 * across transactions, in their own context.
+	 */
+	MemoryContext cache_context;
+	struct pgstat_snapcache_hash *cache;
+	uint32		cache_epoch;	/* advanced for each new snapshot */
 } PgStat_Snapshot;
 
 
@@ -492,6 +513,9 @@ static inline bool pgstat_end_changecount_read(uint32 *cc, uint32 cc_before);
 static inline void pgstat_copy_changecounted_stats(void *dst, void *src, size_t len,
 												   uint32 *cc);
 
+static inline uint64 pgstat_new_generation(void);
+static inline void pgstat_entry_changed(PgStatShared_Common *header);
+
 static inline int pgstat_cmp_hash_key(const void *a, const void *b, size_t size, void *arg);
 static inline uint32 pgstat_hash_hash_key(const void *d, size_t size, void *arg);
 static inline size_t pgstat_get_entry_len(PgStat_Kind kind);
@@ -765,6 +789,27 @@ pgstat_copy_changecounted_stats(void *dst, void *src, size_t len,
 	while (!pgstat_end_changecount_read(cc, cc_before));
 }
 
+/*
+ * Initial generation for a newly created or reinitialized shared stats
+ * entry.
+ */
+static inline uint64
+pgstat_new_generation(void)
+{
+	return pg_atomic_fetch_add_u64(&pgStatLocal.shmem->next_generation, 1) << 32;
+}
+
+/*
+ * Note that the contents of a shared stats entry may be about to change.
+ * Caller must hold the entry's lock exclusively, so a plain increment does.
+ */
+static inline void
+pgstat_entry_changed(PgStatShared_Common *header)
+{
+	pg_atomic_write_u64(&header->generation,
+						pg_atomic_read_u64(&header->generation) + 1);
+}
+
 /* helpers for dshash / simplehash hashtables */
 static inline int
 pgstat_cmp_hash_key(const void *a, const void *b, size_t size, void *arg)
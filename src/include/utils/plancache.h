@@ -156,6 +156,8 @@ typedef struct CachedPlan
 	TransactionId saved_xmin;	/* if valid, replan when TransactionXmin
 								 * changes from this value */
 	int			generation;		/* parent's generation number for this plan */
+	bool		rows_underestimated;	/* produced far more rows than the
+										 * planner estimated? */
 	int			refcount;		/* count of live references to this struct */
 	MemoryContext context;		/* context containing this CachedPlan */
 } CachedPlan;
@@ -224,6 +226,8 @@ extern CachedPlan *GetCachedPlan(CachedPlanSource *plansource,
 								 ResourceOwner owner,
 								 QueryEnvironment *queryEnv);
 extern void ReleaseCachedPlan(CachedPlan *plan, ResourceOwner owner);
+extern void ReportCachedPlanRows(CachedPlan *plan, PlannedStmt *stmt,
+								 uint64 nrows);
 
 extern bool CachedPlanAllowsSimpleValidityCheck(CachedPlanSource *plansource,
 												CachedPlan *plan,
@@ -343,6 +343,7 @@ typedef struct StdRdOptions
 	int			parallel_workers;	/* max number of parallel workers */
 	StdRdOptIndexCleanup vacuum_index_cleanup;	/* controls index vacuuming */
 	bool		vacuum_truncate;	/* enables vacuum to truncate a relation */
+	bool		incremental_maintenance;	/* maintain matview incrementally */
 } StdRdOptions;
 
 #define HEAP_MIN_FILLFACTOR			10
@@ -389,6 +390,16 @@ typedef struct StdRdOptions
 	  (relation)->rd_rel->relkind == RELKIND_MATVIEW) ? \
 	 ((StdRdOptions *) (relation)->rd_options)->user_catalog_table : false)
 
+/*
+ * RelationIsIncrementallyMaintained
+ *		Returns whether the relation is a materialized view that is kept up
+ *		to date incrementally, as its base tables are modified.
+ */
+#define RelationIsIncrementallyMaintained(relation)	\
+	((relation)->rd_options && \
+	 (relation)->rd_rel->relkind == RELKIND_MATVIEW ? \
+	 ((StdRdOptions *) (relation)->rd_options)->incremental_maintenance : false)
+
 /*
  * RelationGetParallelWorkers
  *		Returns the relation's parallel_workers reloption setting.
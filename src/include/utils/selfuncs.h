@@ -213,6 +213,9 @@ extern void mergejoinscansel(PlannerInfo *root, Node *clause,
 							 Selectivity *leftstart, Selectivity *leftend,
 							 Selectivity *rightstart, Selectivity *rightend);
 
+extern bool eqjoinsel_multi(PlannerInfo *root, List *lexprs, List *rexprs,
+							JoinType jointype, SpecialJoinInfo *sjinfo,
+							Selectivity *selec);
 extern double estimate_num_groups(PlannerInfo *root, List *groupExprs,
 								  double input_rows, List **pgset,
 								  EstimationInfo *estinfo);
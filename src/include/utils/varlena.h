@@ -18,6 +18,8 @@
 
 extern int	varstr_cmp(const char *arg1, int len1, const char *arg2, int len2, Oid collid);
 extern void varstr_sortsupport(SortSupport ssup, Oid typid, Oid collid);
+extern const char *varstr_find(const char *haystack, int haystack_len,
+							   const char *needle, int needle_len);
 extern int	varstr_levenshtein(const char *source, int slen,
 							   const char *target, int tlen,
 							   int ins_c, int del_c, int sub_c,
@@ -364,6 +364,14 @@ static const internalPQconninfoOption PQconninfoOptions[] = {
 		"Load-Balance-Hosts", "", 8,	/* sizeof("disable") = 8 */
 	offsetof(struct pg_conn, load_balance_hosts)},
 
+	{"compression", "PGCOMPRESSION", NULL, NULL,
+		"Compression", "", 9,	/* sizeof("lz4,zstd") = 9 */
+	offsetof(struct pg_conn, compression)},
+
+	{"statement_cache_size", "PGSTATEMENTCACHESIZE", "0", NULL,
+		"Statement-Cache-Size", "", 6,
+	offsetof(struct pg_conn, statement_cache_size)},
+
 	/* Terminating entry --- MUST BE LAST */
 	{NULL, NULL, NULL, NULL,
 	NULL, NULL, 0}
@@ -485,6 +493,22 @@ pqDropConnection(PGconn *conn, bool flushInput)
 	/* Always discard any unsent data */
 	conn->outCount = 0;
 
+	/* Stream compression, if any, starts afresh with the next connection */
+	if (conn->compressor)
+	{
+		pg_stream_compressor_free(conn->compressor);
+		conn->compressor = NULL;
+	}
+	if (conn->decompressor)
+	{
+		pg_stream_decompressor_free(conn->decompressor);
+		conn->decompressor = NULL;
+	}
+	conn->outCompressed = 0;
+
+	/* Cached prepared statements don't survive the session either */
+	pqStmtCacheReset(conn);
+
 	/* Likewise, discard any pending pipelined commands */
 	pqFreeCommandQueue(conn->cmd_queue_head);
 	conn->cmd_queue_head = conn->cmd_queue_tail = NULL;
@@ -1812,6 +1836,57 @@ pqConnectOptions2(PGconn *conn)
 	else
 		conn->load_balance_type = LOAD_BALANCE_DISABLE;
 
+	/*
+	 * validate compression option: it must be a comma-separated list of
+	 * stream compression algorithms supported by this build
+	 */
+	if (conn->compression && conn->compression[0])
+	{
+		char	   *s = conn->compression;
+		bool		more = true;
+
+		while (more)
+		{
+			char	   *part;
+			pg_compress_algorithm algorithm;
+
+			part = parse_comma_separated_list(&s, &more);
+			if (part == NULL)
+				goto oom_error;
+
+			if (!pg_stream_compress_algorithm_by_name(part, &algorithm))
+			{
+				conn->status = CONNECTION_BAD;
+				libpq_append_conn_error(conn, "invalid %s value: \"%s\"",
+										"compression", part);
+				free(part);
+				return false;
+			}
+			free(part);
+		}
+	}
+
+	/*
+	 * validate statement_cache_size option
+	 */
+	if (conn->statement_cache_size)
+	{
+		if (!pqParseIntParam(conn->statement_cache_size, &conn->stmtCacheSize,
+							 conn, "statement_cache_size"))
+		{
+			conn->status = CONNECTION_BAD;
+			return false;
+		}
+		if (conn->stmtCacheSize < 0)
+		{
+			conn->status = CONNECTION_BAD;
+			libpq_append_conn_error(conn, "invalid %s value: \"%s\"",
+									"statement_cache_size",
+									conn->statement_cache_size);
+			return false;
+		}
+	}
+
 	if (conn->load_balance_type == LOAD_BALANCE_RANDOM)
 	{
 		libpq_prng_init(conn);
@@ -3852,13 +3927,22 @@ keep_going:						/* We will come back to here until there is
 				}
 				else if (beresp == PqMsg_NegotiateProtocolVersion)
 				{
-					if (pqGetNegotiateProtocolVersion3(conn))
+					res = pqGetNegotiateProtocolVersion3(conn);
+					if (res == EOF)
 					{
 						libpq_append_conn_error(conn, "received invalid protocol negotiation message");
 						goto error_return;
 					}
 					/* OK, we read the message; mark data consumed */
 					conn->inStart = conn->inCursor;
+
+					/*
+					 * If the server merely declined the options that are
+					 * safe to ignore, keep waiting for its authentication
+					 * request.
+					 */
+					if (res == 1)
+						goto keep_going;
 					goto error_return;
 				}
 
@@ -4712,6 +4796,10 @@ freePGconn(PGconn *conn)
 	free(conn->rowBuf);
 	free(conn->target_session_attrs);
 	free(conn->load_balance_hosts);
+	free(conn->compression);
+	free(conn->statement_cache_size);
+	pqStmtCacheReset(conn);
+	free(conn->stmtCacheBuckets);
 	termPQExpBuffer(&conn->errorMessage);
 	termPQExpBuffer(&conn->workBuffer);
 
@@ -24,6 +24,7 @@
 #include <unistd.h>
 #endif
 
+#include "common/hashfn.h"
 #include "libpq-fe.h"
 #include "libpq-int.h"
 #include "mb/pg_wchar.h"
@@ -63,6 +64,15 @@ static bool static_std_strings = false;
 static PGEvent *dupEvents(PGEvent *events, int count, size_t *memSize);
 static bool pqAddTuple(PGresult *res, PGresAttValue *tup,
 					   const char **errmsgp);
+static bool pqAddColumnarRow(PGresult *res, const PGdataValue *values,
+							 const char **errmsgp);
+static PGstmtCacheEntry *stmtCacheLookup(PGconn *conn, const char *command,
+										 int nParams, const Oid *paramTypes,
+										 bool *isNew);
+static PGstmtCacheEntry *stmtCacheFind(PGconn *conn, uint32 id);
+static void stmtCacheRemove(PGconn *conn, PGstmtCacheEntry *entry);
+static void stmtCacheFreeEntry(PGstmtCacheEntry *entry);
+static int	stmtCacheSendClose(PGconn *conn);
 static int	PQsendQueryInternal(PGconn *conn, const char *query, bool newQuery);
 static bool PQsendQueryStart(PGconn *conn, bool newQuery);
 static int	PQsendQueryGuts(PGconn *conn,
@@ -169,6 +179,8 @@ PQmakeEmptyPGresult(PGconn *conn, ExecStatusType status)
 	result->attDescs = NULL;
 	result->tuples = NULL;
 	result->tupArrSize = 0;
+	result->columns = NULL;
+	result->colArrSize = 0;
 	result->numParameters = 0;
 	result->paramDescs = NULL;
 	result->resultStatus = status;
@@ -352,8 +364,9 @@ PQcopyResult(const PGresult *src, int flags)
 			for (field = 0; field < src->numAttributes; field++)
 			{
 				if (!PQsetvalue(dest, tup, field,
-								src->tuples[tup][field].value,
-								src->tuples[tup][field].len))
+								PQgetvalue(src, tup, field),
+								PQgetisnull(src, tup, field) ? NULL_LEN :
+								PQgetlength(src, tup, field)))
 				{
 					PQclear(dest);
 					return NULL;
@@ -458,6 +471,10 @@ PQsetvalue(PGresult *res, int tup_num, int field_num, char *value, int len)
 	if (!res || (const PGresult *) res == &OOM_result)
 		return false;
 
+	/* Columnar results can't be modified */
+	if (res->columns)
+		return false;
+
 	/* Invalid field_num? */
 	if (!check_field_number(res, field_num))
 		return false;
@@ -757,9 +774,22 @@ PQclear(PGresult *res)
 	/* Free the top-level tuple pointer array */
 	free(res->tuples);
 
+	/* Free the column arrays of a columnar result */
+	if (res->columns)
+	{
+		for (i = 0; i < res->numAttributes; i++)
+		{
+			free(res->columns[i].data);
+			free(res->columns[i].offsets);
+			free(res->columns[i].validity);
+		}
+		free(res->columns);
+	}
+
 	/* zero out the pointer fields to catch programming errors */
 	res->attDescs = NULL;
 	res->tuples = NULL;
+	res->columns = NULL;
 	res->paramDescs = NULL;
 	res->errFields = NULL;
 	res->events = NULL;
@@ -1234,6 +1264,19 @@ pqRowProcessor(PGconn *conn, const char **errmsgp)
 		conn->result = res;
 	}
 
+	/*
+	 * In columnar mode, append the values to the result's column arrays
+	 * instead of making a tuple out of them.
+	 */
+	if (conn->columnarMode)
+	{
+		if (!pqAddColumnarRow(res, columns, errmsgp))
+			return 0;
+		if (res->ntups >= conn->maxChunkSize)
+			conn->asyncStatus = PGASYNC_READY_MORE;
+		return 1;
+	}
+
 	/*
 	 * Basically we just allocate space in the PGresult for each field and
 	 * copy the data over.
@@ -1291,6 +1334,118 @@ pqRowProcessor(PGconn *conn, const char **errmsgp)
 }
 
 
+/*
+ * pqAddColumnarRow
+ *	  add a row to the column arrays of a PGresult in columnar mode
+ *
+ * Each value is copied straight from the input buffer to the end of its
+ * column's data buffer; all buffers grow geometrically, so there is no
+ * allocation per value or per row.
+ *
+ * Returns true if OK, false if an error prevented adding the row.  On error,
+ * *errmsgp can be set to an error string to be returned; if it is left NULL,
+ * the error is presumed to be "out of memory".
+ */
+static bool
+pqAddColumnarRow(PGresult *res, const PGdataValue *values,
+				 const char **errmsgp)
+{
+	int			nfields = res->numAttributes;
+	int			row = res->ntups;
+	int			i;
+
+	if (res->columns == NULL)
+	{
+		res->columns = (PGresColumn *)
+			calloc(Max(nfields, 1), sizeof(PGresColumn));
+		if (res->columns == NULL)
+			return false;
+		res->memorySize += Max(nfields, 1) * sizeof(PGresColumn);
+	}
+
+	/* Make room for another row in the offset and validity arrays */
+	if (row >= res->colArrSize)
+	{
+		int			newSize;
+		int			oldBytes = (res->colArrSize + 7) / 8;
+		int			newBytes;
+
+		if (res->colArrSize <= INT_MAX / 2 - 8)
+			newSize = (res->colArrSize > 0) ? res->colArrSize * 2 : 128;
+		else
+		{
+			*errmsgp = libpq_gettext("PGresult cannot support more than INT_MAX tuples");
+			return false;
+		}
+		newBytes = (newSize + 7) / 8;
+
+		for (i = 0; i < nfields; i++)
+		{
+			PGresColumn *col = &res->columns[i];
+			int		   *newOffsets;
+			unsigned char *newValidity;
+
+			newOffsets = (int *) realloc(col->offsets,
+										 (newSize + 1) * sizeof(int));
+			if (newOffsets == NULL)
+				return false;
+			col->offsets = newOffsets;
+
+			newValidity = (unsigned char *) realloc(col->validity, newBytes);
+			if (newValidity == NULL)
+				return false;
+			memset(newValidity + oldBytes, 0, newBytes - oldBytes);
+			col->validity = newValidity;
+		}
+		res->memorySize += (size_t) nfields *
+			((newSize - res->colArrSize) * sizeof(int) + newBytes - oldBytes);
+		res->colArrSize = newSize;
+	}
+
+	for (i = 0; i < nfields; i++)
+	{
+		PGresColumn *col = &res->columns[i];
+		int			clen = values[i].len;
+
+		if (row == 0)
+			col->offsets[0] = 0;
+
+		if (clen >= 0)
+		{
+			if (clen > col->dataSize - col->dataLen)
+			{
+				int			newSize;
+				char	   *newData;
+
+				if (clen > INT_MAX / 2 - col->dataLen)
+				{
+					*errmsgp = libpq_gettext("column data in a result chunk cannot exceed 1GB");
+					return false;
+				}
+				newSize = Max(col->dataSize, 1024);
+				while (newSize - col->dataLen < clen)
+					newSize *= 2;
+
+				newData = (char *) realloc(col->data, newSize);
+				if (newData == NULL)
+					return false;
+				res->memorySize += newSize - col->dataSize;
+				col->data = newData;
+				col->dataSize = newSize;
+			}
+
+			memcpy(col->data + col->dataLen, values[i].value, clen);
+			col->dataLen += clen;
+			col->validity[row / 8] |= (unsigned char) (1 << (row % 8));
+		}
+
+		col->offsets[row + 1] = col->dataLen;
+	}
+
+	res->ntups++;
+	return true;
+}
+
 /*
  * pqAllocCmdQueueEntry
  *		Get a command queue entry for caller to fill.
@@ -1323,6 +1478,7 @@ pqAllocCmdQueueEntry(PGconn *conn)
 	}
 	entry->next = NULL;
 	entry->query = NULL;
+	entry->stmtCacheId = 0;
 
 	return entry;
 }
@@ -1739,6 +1895,7 @@ PQsendQueryStart(PGconn *conn, bool newQuery)
 		/* reset partial-result mode */
 		conn->partialResMode = false;
 		conn->singleRowMode = false;
+		conn->columnarMode = false;
 		conn->maxChunkSize = 0;
 	}
 
@@ -1766,18 +1923,50 @@ PQsendQueryGuts(PGconn *conn,
 {
 	int			i;
 	PGcmdQueueEntry *entry;
+	PGstmtCacheEntry *newCached = NULL;
+	bool		sendParse = (command != NULL);
+	char		cachedName[32];
 
 	entry = pqAllocCmdQueueEntry(conn);
 	if (entry == NULL)
 		return 0;				/* error msg already set */
 
+	/*
+	 * If the statement cache is enabled, an unnamed statement sent by
+	 * PQsendQueryParams is replaced by a named one from the cache, which only
+	 * needs to be parsed the first time it's used.  If we can't allocate a
+	 * cache entry, just carry on with the unnamed statement.
+	 */
+	if (command && stmtName[0] == '\0' && conn->stmtCacheSize > 0)
+	{
+		PGstmtCacheEntry *cached;
+		bool		isNew;
+
+		cached = stmtCacheLookup(conn, command, nParams, paramTypes, &isNew);
+		if (cached)
+		{
+			snprintf(cachedName, sizeof(cachedName), "_pq_stmt_%u",
+					 cached->id);
+			stmtName = cachedName;
+			entry->stmtCacheId = cached->id;
+			if (isNew)
+				newCached = cached;
+			else
+				sendParse = false;
+		}
+
+		/* Deallocate statements dropped from the cache */
+		if (stmtCacheSendClose(conn) < 0)
+			goto sendFailed;
+	}
+
 	/*
 	 * We will send Parse (if needed), Bind, Describe Portal, Execute, Sync
 	 * (if not in pipeline mode), using specified statement name and the
 	 * unnamed portal.
 	 */
 
-	if (command)
+	if (sendParse)
 	{
 		/* construct the Parse message */
 		if (pqPutMsgStart(PqMsg_Parse, conn) < 0 ||
@@ -1913,11 +2102,267 @@ PQsendQueryGuts(PGconn *conn,
 	return 1;
 
 sendFailed:
+	if (newCached)
+		pqStmtCacheInvalidate(conn, newCached->id);
 	pqRecycleCmdQueueEntry(conn, entry);
 	/* error message should be set up already */
 	return 0;
 }
 
+/*
+ * stmtCacheLookup
+ *	  Find the cached statement for a query, or create a new entry for it.
+ *
+ * The entry becomes the most recently used one.  *isNew is set to true if the
+ * entry was created, meaning that the caller has to send the Parse message.
+ * If the cache is full, the least recently used entry is evicted.  Returns
+ * NULL if out of memory.
+ */
+static PGstmtCacheEntry *
+stmtCacheLookup(PGconn *conn, const char *command, int nParams,
+				const Oid *paramTypes, bool *isNew)
+{
+	PGstmtCacheEntry *entry;
+	uint32		hash;
+	int			bucket;
+
+	if (conn->stmtCacheBuckets == NULL)
+	{
+		int			nbuckets = 16;
+
+		while (nbuckets < conn->stmtCacheSize && nbuckets < (1 << 20))
+			nbuckets *= 2;
+		conn->stmtCacheBuckets = (PGstmtCacheEntry **)
+			calloc(nbuckets, sizeof(PGstmtCacheEntry *));
+		if (conn->stmtCacheBuckets == NULL)
+			return NULL;
+		conn->stmtCacheNBuckets = nbuckets;
+	}
+
+	if (!paramTypes)
+		nParams = 0;
+	hash = hash_bytes((const unsigned char *) command, strlen(command));
+	bucket = hash & (conn->stmtCacheNBuckets - 1);
+
+	for (entry = conn->stmtCacheBuckets[bucket]; entry; entry = entry->hashNext)
+	{
+		if (entry->hash == hash &&
+			entry->nParams == nParams &&
+			strcmp(entry->query, command) == 0 &&
+			(nParams == 0 ||
+			 memcmp(entry->paramTypes, paramTypes, nParams * sizeof(Oid)) == 0))
+			break;
+	}
+
+	if (entry)
+	{
+		/* Move it to the front of the LRU list */
+		if (entry->lruPrev)
+		{
+			entry->lruPrev->lruNext = entry->lruNext;
+			if (entry->lruNext)
+				entry->lruNext->lruPrev = entry->lruPrev;
+			else
+				conn->stmtCacheLruTail = entry->lruPrev;
+			entry->lruPrev = NULL;
+			entry->lruNext = conn->stmtCacheLruHead;
+			conn->stmtCacheLruHead->lruPrev = entry;
+			conn->stmtCacheLruHead = entry;
+		}
+		*isNew = false;
+		return entry;
+	}
+
+	/* Make room for the new entry, if needed */
+	if (conn->stmtCacheCount >= conn->stmtCacheSize)
+	{
+		PGstmtCacheEntry *victim = conn->stmtCacheLruTail;
+
+		stmtCacheRemove(conn, victim);
+		victim->hashNext = conn->stmtCacheDead;
+		conn->stmtCacheDead = victim;
+	}
+
+	entry = (PGstmtCacheEntry *) calloc(1, sizeof(PGstmtCacheEntry));
+	if (entry == NULL)
+		return NULL;
+	entry->query = strdup(command);
+	if (nParams > 0)
+	{
+		entry->paramTypes = (Oid *) malloc(nParams * sizeof(Oid));
+		if (entry->paramTypes)
+			memcpy(entry->paramTypes, paramTypes, nParams * sizeof(Oid));
+	}
+	if (entry->query == NULL || (nParams > 0 && entry->paramTypes == NULL))
+	{
+		stmtCacheFreeEntry(entry);
+		return NULL;
+	}
+
+	/* ids are never zero, since that means "not cached" in PGcmdQueueEntry */
+	if (++conn->stmtCacheNextId == 0)
+		conn->stmtCacheNextId = 1;
+	entry->id = conn->stmtCacheNextId;
+	entry->hash = hash;
+	entry->nParams = nParams;
+
+	entry->hashNext = conn->stmtCacheBuckets[bucket];
+	conn->stmtCacheBuckets[bucket] = entry;
+	entry->lruNext = conn->stmtCacheLruHead;
+	if (conn->stmtCacheLruHead)
+		conn->stmtCacheLruHead->lruPrev = entry;
+	else
+		conn->stmtCacheLruTail = entry;
+	conn->stmtCacheLruHead = entry;
+	conn->stmtCacheCount++;
+
+	*isNew = true;
+	return entry;
+}
+
+/*
+ * stmtCacheFind
+ *	  Find a statement cache entry by id, or return NULL if it's gone.
+ *
+ * This is used only when the server responds to the first use of a statement,
+ * or on errors, so a linear search starting from the most recently used entry
+ * is good enough.
+ */
+static PGstmtCacheEntry *
+stmtCacheFind(PGconn *conn, uint32 id)
+{
+	PGstmtCacheEntry *entry;
+
+	for (entry = conn->stmtCacheLruHead; entry; entry = entry->lruNext)
+	{
+		if (entry->id == id)
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * stmtCacheRemove
+ *	  Unlink an entry from the statement cache, without freeing it.
+ */
+static void
+stmtCacheRemove(PGconn *conn, PGstmtCacheEntry *entry)
+{
+	PGstmtCacheEntry **prev;
+
+	prev = &conn->stmtCacheBuckets[entry->hash & (conn->stmtCacheNBuckets - 1)];
+	while (*prev != entry)
+		prev = &(*prev)->hashNext;
+	*prev = entry->hashNext;
+	entry->hashNext = NULL;
+
+	if (entry->lruPrev)
+		entry->lruPrev->lruNext = entry->lruNext;
+	else
+		conn->stmtCacheLruHead = entry->lruNext;
+	if (entry->lruNext)
+		entry->lruNext->lruPrev = entry->lruPrev;
+	else
+		conn->stmtCacheLruTail = entry->lruPrev;
+	entry->lruPrev = entry->lruNext = NULL;
+
+	conn->stmtCacheCount--;
+}
+
+static void
+stmtCacheFreeEntry(PGstmtCacheEntry *entry)
+{
+	free(entry->query);
+	free(entry->paramTypes);
+	free(entry);
+}
+
+/*
+ * stmtCacheSendClose
+ *	  Queue Close messages for the statements dropped from the cache.
+ *
+ * pqParseInput3 ignores the server's CloseComplete responses.  Closing a
+ * statement that doesn't exist is not an error.
+ */
+static int
+stmtCacheSendClose(PGconn *conn)
+{
+	while (conn->stmtCacheDead)
+	{
+		PGstmtCacheEntry *entry = conn->stmtCacheDead;
+		char		name[32];
+
+		snprintf(name, sizeof(name), "_pq_stmt_%u", entry->id);
+		if (pqPutMsgStart(PqMsg_Close, conn) < 0 ||
+			pqPutc('S', conn) < 0 ||
+			pqPuts(name, conn) < 0 ||
+			pqPutMsgEnd(conn) < 0)
+			return -1;
+
+		conn->stmtCacheDead = entry->hashNext;
+		stmtCacheFreeEntry(entry);
+	}
+	return 0;
+}
+
+/*
+ * pqStmtCacheSetPrepared
+ *	  Note that the server has parsed a cached statement.
+ */
+void
+pqStmtCacheSetPrepared(PGconn *conn, uint32 id)
+{
+	PGstmtCacheEntry *entry = stmtCacheFind(conn, id);
+
+	if (entry)
+		entry->prepared = true;
+}
+
+/*
+ * pqStmtCacheInvalidate
+ *	  Remove a statement from the cache, because it failed to be prepared or
+ *	  the server can no longer execute it.
+ *
+ * The statement is closed before the next cached query is sent, and will be
+ * prepared again under a new name if it's used again.
+ */
+void
+pqStmtCacheInvalidate(PGconn *conn, uint32 id)
+{
+	PGstmtCacheEntry *entry = stmtCacheFind(conn, id);
+
+	if (entry)
+	{
+		stmtCacheRemove(conn, entry);
+		entry->hashNext = conn->stmtCacheDead;
+		conn->stmtCacheDead = entry;
+	}
+}
+
+/*
+ * pqStmtCacheReset
+ *	  Forget all cached statements, because they no longer exist on the
+ *	  server (after DISCARD ALL or DEALLOCATE ALL, or on a new connection).
+ */
+void
+pqStmtCacheReset(PGconn *conn)
+{
+	while (conn->stmtCacheLruHead)
+	{
+		PGstmtCacheEntry *entry = conn->stmtCacheLruHead;
+
+		stmtCacheRemove(conn, entry);
+		stmtCacheFreeEntry(entry);
+	}
+	while (conn->stmtCacheDead)
+	{
+		PGstmtCacheEntry *entry = conn->stmtCacheDead;
+
+		conn->stmtCacheDead = entry->hashNext;
+		stmtCacheFreeEntry(entry);
+	}
+}
+
 /*
  * Is it OK to change partial-result mode now?
  */
@@ -1951,6 +2396,7 @@ PQsetSingleRowMode(PGconn *conn)
 	{
 		conn->partialResMode = true;
 		conn->singleRowMode = true;
+		conn->columnarMode = false;
 		conn->maxChunkSize = 1;
 		return 1;
 	}
@@ -1968,6 +2414,28 @@ PQsetChunkedRowsMode(PGconn *conn, int chunkSize)
 	{
 		conn->partialResMode = true;
 		conn->singleRowMode = false;
+		conn->columnarMode = false;
+		conn->maxChunkSize = chunkSize;
+		return 1;
+	}
+	else
+		return 0;
+}
+
+/*
+ * Select columnar results processing mode
+ *
+ * Like chunked rows mode, but the rows of each chunk are stored column by
+ * column; see PQcolumnValues().
+ */
+int
+PQsetColumnarMode(PGconn *conn, int chunkSize)
+{
+	if (chunkSize > 0 && canChangeResultMode(conn))
+	{
+		conn->partialResMode = true;
+		conn->singleRowMode = false;
+		conn->columnarMode = true;
 		conn->maxChunkSize = chunkSize;
 		return 1;
 	}
@@ -3167,6 +3635,19 @@ pqCommandQueueAdvance(PGconn *conn, bool isReadyForQuery, bool gotSync)
 	if (conn->cmd_queue_head == NULL)
 		conn->cmd_queue_tail = NULL;
 
+	/*
+	 * If the query was the first to use a cached statement, but the server
+	 * never acknowledged its Parse (because it failed, or was skipped after
+	 * an error in the pipeline), the statement doesn't exist.
+	 */
+	if (prevquery->stmtCacheId != 0)
+	{
+		PGstmtCacheEntry *cached = stmtCacheFind(conn, prevquery->stmtCacheId);
+
+		if (cached && !cached->prepared)
+			pqStmtCacheInvalidate(conn, prevquery->stmtCacheId);
+	}
+
 	/* and make the queue element recyclable */
 	prevquery->next = NULL;
 	pqRecycleCmdQueueEntry(conn, prevquery);
@@ -3216,6 +3697,7 @@ pqPipelineProcessQueue(PGconn *conn)
 	 */
 	conn->partialResMode = false;
 	conn->singleRowMode = false;
+	conn->columnarMode = false;
 	conn->maxChunkSize = 0;
 
 	/*
@@ -3877,6 +4359,14 @@ PQgetvalue(const PGresult *res, int tup_num, int field_num)
 {
 	if (!check_tuple_field_number(res, tup_num, field_num))
 		return NULL;
+	if (res->columns)
+	{
+		/* note: not null-terminated */
+		if (res->columns[field_num].data == NULL)
+			return (char *) res->null_field;
+		return res->columns[field_num].data +
+			res->columns[field_num].offsets[tup_num];
+	}
 	return res->tuples[tup_num][field_num].value;
 }
 
@@ -3888,6 +4378,9 @@ PQgetlength(const PGresult *res, int tup_num, int field_num)
 {
 	if (!check_tuple_field_number(res, tup_num, field_num))
 		return 0;
+	if (res->columns)
+		return res->columns[field_num].offsets[tup_num + 1] -
+			res->columns[field_num].offsets[tup_num];
 	if (res->tuples[tup_num][field_num].len != NULL_LEN)
 		return res->tuples[tup_num][field_num].len;
 	else
@@ -3902,12 +4395,41 @@ PQgetisnull(const PGresult *res, int tup_num, int field_num)
 {
 	if (!check_tuple_field_number(res, tup_num, field_num))
 		return 1;				/* pretend it is null */
+	if (res->columns)
+		return (res->columns[field_num].validity[tup_num / 8] &
+				(1 << (tup_num % 8))) == 0;
 	if (res->tuples[tup_num][field_num].len == NULL_LEN)
 		return 1;
 	else
 		return 0;
 }
 
+/* PQcolumnValues:
+ *	returns all values of a column of a result in columnar form.
+ *
+ * The values are stored back to back in the returned buffer, and are not
+ * null-terminated.  *offsets is set to an array of PQntuples() + 1 offsets
+ * into the buffer: value i occupies bytes offsets[i] up to offsets[i + 1].
+ * *validity is set to a bitmap with one bit per row, least significant bit
+ * first, which is set for non-null values.  Returns NULL if the result is
+ * not in columnar form.
+ */
+const char *
+PQcolumnValues(const PGresult *res, int field_num,
+			   const int **offsets, const unsigned char **validity)
+{
+	if (!check_field_number(res, field_num))
+		return NULL;
+	if (!res->columns)
+		return NULL;
+
+	*offsets = res->columns[field_num].offsets;
+	*validity = res->columns[field_num].validity;
+	if (res->columns[field_num].data == NULL)
+		return res->null_field;
+	return res->columns[field_num].data;
+}
+
 /* PQnparams:
  *	returns the number of input parameters of a prepared statement.
  */
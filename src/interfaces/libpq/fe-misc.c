@@ -550,6 +550,55 @@ pqPutMsgEnd(PGconn *conn)
 	return 0;
 }
 
+/*
+ * pqReadSome: read data from the socket into the free space of inBuffer,
+ * decompressing it if stream compression is in use
+ *
+ * Same return convention as pqsecure_read().  Since decompression can
+ * produce more data than fits, inBuffer is enlarged as needed.
+ */
+static ssize_t
+pqReadSome(PGconn *conn)
+{
+	char		raw[8192];
+	ssize_t		nread;
+	const char *out;
+	size_t		outlen;
+
+	if (conn->decompressor == NULL)
+		return pqsecure_read(conn, conn->inBuffer + conn->inEnd,
+							 conn->inBufSize - conn->inEnd);
+
+	nread = pqsecure_read(conn, raw, sizeof(raw));
+	if (nread <= 0)
+		return nread;
+
+	if (!pg_stream_decompress(conn->decompressor, raw, nread, &out, &outlen))
+	{
+		libpq_append_conn_error(conn, "could not decompress data received from server: %s",
+								pg_stream_decompressor_error(conn->decompressor));
+		/* the stream can't be resynchronized, so give up on the connection */
+		SOCK_ERRNO_SET(ECONNRESET);
+		return -1;
+	}
+
+	/* the data read might not have completed a compressed block yet */
+	if (outlen == 0)
+	{
+		SOCK_ERRNO_SET(EWOULDBLOCK);
+		return -1;
+	}
+
+	if (pqCheckInBufferSpace(conn->inEnd + outlen, conn))
+	{
+		/* decompressed data would be lost, so give up on the connection */
+		SOCK_ERRNO_SET(ECONNRESET);
+		return -1;
+	}
+	memcpy(conn->inBuffer + conn->inEnd, out, outlen);
+	return outlen;
+}
+
 /* ----------
  * pqReadData: read more data, if any is available
  * Possible return values:
@@ -613,8 +662,7 @@ pqReadData(PGconn *conn)
 
 	/* OK, try to read some data */
 retry3:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqReadSome(conn);
 	if (nread < 0)
 	{
 		switch (SOCK_ERRNO)
@@ -708,8 +756,7 @@ retry3:
 	 * arrived.
 	 */
 retry4:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqReadSome(conn);
 	if (nread < 0)
 	{
 		switch (SOCK_ERRNO)
@@ -783,8 +830,8 @@ definitelyFailed:
 static int
 pqSendSome(PGconn *conn, int len)
 {
-	char	   *ptr = conn->outBuffer;
-	int			remaining = conn->outCount;
+	char	   *ptr;
+	int			remaining;
 	int			result = 0;
 
 	/*
@@ -800,6 +847,7 @@ pqSendSome(PGconn *conn, int len)
 	{
 		/* conn->write_err_msg should be set up already */
 		conn->outCount = 0;
+		conn->outCompressed = 0;
 		/* Absorb input data if any, and detect socket closure */
 		if (conn->sock != PGINVALID_SOCKET)
 		{
@@ -817,9 +865,46 @@ pqSendSome(PGconn *conn, int len)
 		conn->write_err_msg = strdup(libpq_gettext("connection not open\n"));
 		/* Discard queued data; no chance it'll ever be sent */
 		conn->outCount = 0;
+		conn->outCompressed = 0;
 		return 0;
 	}
 
+	/*
+	 * With stream compression, compress the part of the data to send that
+	 * hasn't been compressed yet, and replace it in the buffer with the
+	 * compressed data.  Then send only compressed data.
+	 */
+	if (conn->compressor != NULL && len > conn->outCompressed)
+	{
+		const char *out;
+		size_t		outlen;
+		int			tail = conn->outCount - len;
+
+		if (!pg_stream_compress(conn->compressor,
+								conn->outBuffer + conn->outCompressed,
+								len - conn->outCompressed, &out, &outlen))
+		{
+			libpq_append_conn_error(conn, "could not compress data: %s",
+									pg_stream_compressor_error(conn->compressor));
+			/* Discard queued data; no chance it'll ever be sent */
+			conn->outCount = 0;
+			conn->outCompressed = 0;
+			return -1;
+		}
+		if (pqCheckOutBufferSpace(conn->outCompressed + outlen + tail, conn))
+			return -1;
+		memmove(conn->outBuffer + conn->outCompressed + outlen,
+				conn->outBuffer + len, tail);
+		memcpy(conn->outBuffer + conn->outCompressed, out, outlen);
+		conn->outCompressed += outlen;
+		conn->outCount = conn->outCompressed + tail;
+	}
+	if (conn->compressor != NULL)
+		len = conn->outCompressed;
+
+	ptr = conn->outBuffer;
+	remaining = conn->outCount;
+
 	/* while there's still data to send */
 	while (len > 0)
 	{
@@ -856,6 +941,7 @@ pqSendSome(PGconn *conn, int len)
 				default:
 					/* Discard queued data; no chance it'll ever be sent */
 					conn->outCount = 0;
+					conn->outCompressed = 0;
 
 					/* Absorb input data if any, and detect socket closure */
 					if (conn->sock != PGINVALID_SOCKET)
@@ -937,6 +1023,8 @@ pqSendSome(PGconn *conn, int len)
 	if (remaining > 0)
 		memmove(conn->outBuffer, ptr, remaining);
 	conn->outCount = remaining;
+	if (conn->compressor != NULL)
+		conn->outCompressed -= ptr - conn->outBuffer;
 
 	return result;
 }
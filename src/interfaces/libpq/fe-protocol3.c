@@ -55,6 +55,7 @@ static void reportErrorPosition(PQExpBuffer msg, const char *query,
 								int loc, int encoding);
 static int	build_startup_packet(const PGconn *conn, char *packet,
 								 const PQEnvironmentOption *options);
+static bool enableCompression(PGconn *conn, const char *algorithm_name);
 
 
 /*
@@ -213,6 +214,11 @@ pqParseInput3(PGconn *conn)
 					if (conn->result)
 						strlcpy(conn->result->cmdStatus, conn->workBuffer.data,
 								CMDSTATUS_LEN);
+					/* these drop all our cached prepared statements */
+					if (conn->stmtCacheCount > 0 &&
+						(strcmp(conn->workBuffer.data, "DISCARD ALL") == 0 ||
+						 strcmp(conn->workBuffer.data, "DEALLOCATE ALL") == 0))
+						pqStmtCacheReset(conn);
 					conn->asyncStatus = PGASYNC_READY;
 					break;
 				case PqMsg_ErrorResponse:
@@ -259,6 +265,11 @@ pqParseInput3(PGconn *conn)
 					conn->asyncStatus = PGASYNC_READY;
 					break;
 				case PqMsg_ParseComplete:
+					/* A cached statement is now usable */
+					if (conn->cmd_queue_head &&
+						conn->cmd_queue_head->stmtCacheId != 0)
+						pqStmtCacheSetPrepared(conn,
+											   conn->cmd_queue_head->stmtCacheId);
 					/* If we're doing PQprepare, we're done; else ignore */
 					if (conn->cmd_queue_head &&
 						conn->cmd_queue_head->queryclass == PGQUERY_PREPARE)
@@ -949,6 +960,18 @@ pqGetErrorNotice3(PGconn *conn, bool isError)
 	if (have_position && res && conn->cmd_queue_head && conn->cmd_queue_head->query)
 		res->errQuery = pqResultStrdup(res, conn->cmd_queue_head->query);
 
+	/*
+	 * If a cached statement can't be executed anymore, because its result
+	 * type changed ("cached plan must not change result type") or because it
+	 * was deallocated behind our back, drop it from the cache so that the
+	 * next execution prepares it afresh.
+	 */
+	if (isError && conn->cmd_queue_head &&
+		conn->cmd_queue_head->stmtCacheId != 0 &&
+		(strcmp(conn->last_sqlstate, "0A000") == 0 ||
+		 strcmp(conn->last_sqlstate, "26000") == 0))
+		pqStmtCacheInvalidate(conn, conn->cmd_queue_head->stmtCacheId);
+
 	/*
 	 * Now build the "overall" error message for PQresultErrorMessage.
 	 */
@@ -1405,8 +1428,15 @@ reportErrorPosition(PQExpBuffer msg, const char *query, int loc, int encoding)
 /*
  * Attempt to read a NegotiateProtocolVersion message.
  * Entry: 'v' message type and length have already been consumed.
- * Exit: returns 0 if successfully consumed message.
+ * Exit: returns 1 if successfully consumed message, and the connection
+ *		 attempt can go on regardless.
+ *		 returns 0 if successfully consumed message, and the connection
+ *		 attempt has failed; conn->errorMessage is set.
  *		 returns EOF if not enough data.
+ *
+ * The only protocol extension that the server may decline without failing
+ * the connection is _pq_.compression, since we can just as well go on
+ * without compression.
  */
 int
 pqGetNegotiateProtocolVersion3(PGconn *conn)
@@ -1414,6 +1444,7 @@ pqGetNegotiateProtocolVersion3(PGconn *conn)
 	int			tmp;
 	ProtocolVersion their_version;
 	int			num;
+	int			num_ignorable = 0;
 	PQExpBufferData buf;
 
 	if (pqGetInt(&tmp, 4, conn) != 0)
@@ -1431,10 +1462,23 @@ pqGetNegotiateProtocolVersion3(PGconn *conn)
 			termPQExpBuffer(&buf);
 			return EOF;
 		}
+		if (strcmp(conn->workBuffer.data, "_pq_.compression") == 0)
+		{
+			num_ignorable++;
+			continue;
+		}
 		if (buf.len > 0)
 			appendPQExpBufferChar(&buf, ' ');
 		appendPQExpBufferStr(&buf, conn->workBuffer.data);
 	}
+	num -= num_ignorable;
+
+	/* nothing we can't live without was declined? */
+	if (!(their_version < conn->pversion) && num == 0 && num_ignorable > 0)
+	{
+		termPQExpBuffer(&buf);
+		return 1;
+	}
 
 	if (their_version < conn->pversion)
 		libpq_append_conn_error(conn, "protocol version not supported by server: client uses %u.%u, server supports up to %u.%u",
@@ -1480,12 +1524,91 @@ getParameterStatus(PGconn *conn)
 		termPQExpBuffer(&valueBuf);
 		return EOF;
 	}
+	/* The server switches to stream compression right after announcing it */
+	if (strcmp(conn->workBuffer.data, "compression") == 0 &&
+		conn->decompressor == NULL)
+	{
+		if (!enableCompression(conn, valueBuf.data))
+		{
+			termPQExpBuffer(&valueBuf);
+			/* build an error result holding the error message */
+			pqSaveErrorResult(conn);
+			conn->asyncStatus = PGASYNC_READY;	/* drop out of PQgetResult wait loop */
+			/* the rest of the input can't be interpreted, so discard it */
+			conn->inEnd = conn->inCursor;
+			pqDropConnection(conn, false);
+			conn->status = CONNECTION_BAD;	/* No more connection to backend */
+			return 0;
+		}
+	}
 	/* And save it */
 	pqSaveParameterStatus(conn, conn->workBuffer.data, valueBuf.data);
 	termPQExpBuffer(&valueBuf);
 	return 0;
 }
 
+/*
+ * Start stream compression with the algorithm announced by the server.
+ *
+ * Everything following the announcement in the input buffer is compressed,
+ * so decompress it in place.  Output that's already queued but not sent yet
+ * is sent uncompressed, which the server expects since it can only have been
+ * written before the announcement.
+ *
+ * Returns false, with conn->errorMessage set, on failure.
+ */
+static bool
+enableCompression(PGconn *conn, const char *algorithm_name)
+{
+	pg_compress_algorithm algorithm;
+	const char *errormsg;
+	const char *out;
+	size_t		outlen;
+
+	if (!pg_stream_compress_algorithm_by_name(algorithm_name, &algorithm))
+	{
+		libpq_append_conn_error(conn, "server selected unsupported compression algorithm \"%s\"",
+								algorithm_name);
+		return false;
+	}
+
+	conn->compressor = pg_stream_compressor_create(algorithm, 0, &errormsg);
+	if (conn->compressor == NULL)
+	{
+		libpq_append_conn_error(conn, "could not set up compression: %s",
+								errormsg);
+		return false;
+	}
+	conn->decompressor = pg_stream_decompressor_create(algorithm, &errormsg);
+	if (conn->decompressor == NULL)
+	{
+		libpq_append_conn_error(conn, "could not set up decompression: %s",
+								errormsg);
+		return false;
+	}
+	conn->outCompressed = conn->outCount;
+
+	if (conn->inCursor < conn->inEnd)
+	{
+		if (!pg_stream_decompress(conn->decompressor,
+								  conn->inBuffer + conn->inCursor,
+								  conn->inEnd - conn->inCursor,
+								  &out, &outlen))
+		{
+			libpq_append_conn_error(conn, "could not decompress data received from server: %s",
+									pg_stream_decompressor_error(conn->decompressor));
+			return false;
+		}
+		conn->inEnd = conn->inCursor;
+		if (pqCheckInBufferSpace(conn->inEnd + outlen, conn))
+			return false;
+		memcpy(conn->inBuffer + conn->inEnd, out, outlen);
+		conn->inEnd += outlen;
+	}
+
+	return true;
+}
+
 
 /*
  * Attempt to read a Notify response message.
@@ -2304,6 +2427,9 @@ build_startup_packet(const PGconn *conn, char *packet,
 	if (conn->client_encoding_initial && conn->client_encoding_initial[0])
 		ADD_STARTUP_OPTION("client_encoding", conn->client_encoding_initial);
 
+	if (conn->compression && conn->compression[0])
+		ADD_STARTUP_OPTION("_pq_.compression", conn->compression);
+
 	/* Add any environment-driven GUC settings needed */
 	for (next_eo = options; next_eo->envName; next_eo++)
 	{
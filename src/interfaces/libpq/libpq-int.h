@@ -81,6 +81,7 @@ typedef struct
 #endif
 #endif							/* USE_OPENSSL */
 
+#include "common/compress_stream.h"
 #include "common/pg_prng.h"
 
 /*
@@ -167,6 +168,22 @@ typedef struct PGEvent
 	bool		resultInitialized;	/* T if RESULTCREATE/COPY succeeded */
 } PGEvent;
 
+/*
+ * In columnar mode, the values of each column of a result are stored back to
+ * back in one buffer instead of in tuples, in the layout of an Apache Arrow
+ * variable-size binary array.  Value i is data[offsets[i]..offsets[i+1]),
+ * and bit i of validity (least significant bit first) is set unless it is
+ * null.  The values are not null-terminated.
+ */
+typedef struct pgresColumn
+{
+	char	   *data;			/* values of this column, back to back */
+	int			dataLen;		/* used length of data */
+	int			dataSize;		/* allocated size of data */
+	int		   *offsets;		/* ntups + 1 offsets into data */
+	unsigned char *validity;	/* one bit per row, set for non-null */
+} PGresColumn;
+
 struct pg_result
 {
 	int			ntups;
@@ -175,6 +192,9 @@ struct pg_result
 	PGresAttValue **tuples;		/* each PGresult tuple is an array of
 								 * PGresAttValue's */
 	int			tupArrSize;		/* allocated size of tuples array */
+	PGresColumn *columns;		/* numAttributes columns, in columnar mode;
+								 * tuples is unused then */
+	int			colArrSize;		/* number of rows the columns have room for */
 	int			numParameters;
 	PGresParamDesc *paramDescs;
 	ExecStatusType resultStatus;
@@ -338,9 +358,29 @@ typedef struct PGcmdQueueEntry
 {
 	PGQueryClass queryclass;	/* Query type */
 	char	   *query;			/* SQL command, or NULL if none/unknown/OOM */
+	uint32		stmtCacheId;	/* statement cache entry used, or 0 */
 	struct PGcmdQueueEntry *next;	/* list link */
 } PGcmdQueueEntry;
 
+/*
+ * An entry of the automatic prepared statement cache.  Statements sent with
+ * PQsendQueryParams() are prepared under the name "_pq_stmt_<id>" and kept
+ * in a hash table, as well as in a list ordered by recency of use so that
+ * the least recently used statement can be evicted when the cache is full.
+ */
+typedef struct PGstmtCacheEntry
+{
+	uint32		id;				/* determines the statement name */
+	uint32		hash;			/* hash of query */
+	bool		prepared;		/* has the server acknowledged the Parse? */
+	char	   *query;			/* SQL command */
+	int			nParams;		/* number of entries in paramTypes */
+	Oid		   *paramTypes;		/* parameter types, or NULL */
+	struct PGstmtCacheEntry *hashNext;	/* hash chain link */
+	struct PGstmtCacheEntry *lruPrev;	/* more recently used entry */
+	struct PGstmtCacheEntry *lruNext;	/* less recently used entry */
+} PGstmtCacheEntry;
+
 /*
  * pg_conn_host stores all information about each of possibly several hosts
  * mentioned in the connection string.  Most fields are derived by splitting
@@ -415,6 +455,9 @@ struct pg_conn
 	char	   *target_session_attrs;	/* desired session properties */
 	char	   *require_auth;	/* name of the expected auth method */
 	char	   *load_balance_hosts; /* load balance over hosts */
+	char	   *compression;	/* stream compression algorithms to offer */
+	char	   *statement_cache_size;	/* max automatically prepared
+										 * statements */
 
 	bool		cancelRequest;	/* true if this connection is used to send a
 								 * cancel request, instead of being a normal
@@ -443,6 +486,7 @@ struct pg_conn
 	PGpipelineStatus pipelineStatus;	/* status of pipeline mode */
 	bool		partialResMode; /* true if single-row or chunked mode */
 	bool		singleRowMode;	/* return current query result row-by-row? */
+	bool		columnarMode;	/* return chunks of rows in columnar form? */
 	int			maxChunkSize;	/* return query result in chunks not exceeding
 								 * this number of rows */
 	char		copy_is_binary; /* 1 = copy binary, 0 = copy text */
@@ -469,6 +513,20 @@ struct pg_conn
 	 */
 	PGcmdQueueEntry *cmd_queue_recycle;
 
+	/*
+	 * Automatic prepared statement cache (see PGstmtCacheEntry).  Entries
+	 * that have been evicted or invalidated are moved to stmtCacheDead, and a
+	 * Close message is sent for each of them before the next cached query.
+	 */
+	int			stmtCacheSize;	/* max number of entries; 0 disables */
+	int			stmtCacheCount; /* current number of entries */
+	int			stmtCacheNBuckets;	/* size of stmtCacheBuckets */
+	PGstmtCacheEntry **stmtCacheBuckets;	/* hash table */
+	PGstmtCacheEntry *stmtCacheLruHead; /* most recently used */
+	PGstmtCacheEntry *stmtCacheLruTail; /* least recently used */
+	PGstmtCacheEntry *stmtCacheDead;	/* statements to be closed */
+	uint32		stmtCacheNextId;	/* next id to assign */
+
 	/* Connection data */
 	pgsocket	sock;			/* FD for socket, PGINVALID_SOCKET if
 								 * unconnected */
@@ -535,6 +593,16 @@ struct pg_conn
 								 * msg has no length word */
 	int			outMsgEnd;		/* offset to msg end (so far) */
 
+	/*
+	 * Stream compression state, set up once the server has announced the
+	 * algorithm chosen from those we offered.  The first outCompressed bytes
+	 * of outBuffer have already been compressed; the rest of outBuffer
+	 * contains uncompressed data, which is compressed by pqSendSome().
+	 */
+	pg_stream_compressor *compressor;
+	pg_stream_decompressor *decompressor;
+	int			outCompressed;	/* number of compressed chars in outBuffer */
+
 	/* Row processor interface workspace */
 	PGdataValue *rowBuf;		/* array for passing values to rowProcessor */
 	int			rowBufLen;		/* number of entries allocated in rowBuf */
@@ -711,6 +779,9 @@ extern int	pqRowProcessor(PGconn *conn, const char **errmsgp);
 extern void pqCommandQueueAdvance(PGconn *conn, bool isReadyForQuery,
 								  bool gotSync);
 extern int	PQsendQueryContinue(PGconn *conn, const char *query);
+extern void pqStmtCacheSetPrepared(PGconn *conn, uint32 id);
+extern void pqStmtCacheInvalidate(PGconn *conn, uint32 id);
+extern void pqStmtCacheReset(PGconn *conn);
 
 /* === in fe-protocol3.c === */
 
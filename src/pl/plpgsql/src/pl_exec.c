@@ -6153,6 +6153,41 @@ exec_eval_simple_expr(PLpgSQL_execstate *estate,
 	*rettype = expr->expr_simple_type;
 	*rettypmod = expr->expr_simple_typmod;
 
+	/*
+	 * Expressions that are just a constant, as in "x := 0", or just a plain
+	 * variable, as in "RETURN x", are common enough to be worth evaluating
+	 * here directly, without setting up the executor.  The results are the
+	 * same as the Const and Param evaluation steps would produce.
+	 */
+	if (IsA(expr->expr_simple_expr, Const))
+	{
+		Const	   *con = (Const *) expr->expr_simple_expr;
+
+		*result = con->constvalue;
+		*isNull = con->constisnull;
+		return true;
+	}
+	else if (IsA(expr->expr_simple_expr, Param) &&
+			 ((Param *) expr->expr_simple_expr)->paramkind == PARAM_EXTERN)
+	{
+		int			dno = ((Param *) expr->expr_simple_expr)->paramid - 1;
+		PLpgSQL_var *var;
+
+		Assert(dno >= 0 && dno < estate->ndatums);
+		var = (PLpgSQL_var *) estate->datums[dno];
+		if (var->dtype == PLPGSQL_DTYPE_VAR)
+		{
+			Assert(var->datatype->typoid == expr->expr_simple_type);
+			if (var->datatype->typlen == -1)
+				*result = MakeExpandedObjectReadOnly(var->value, var->isnull,
+													 -1);
+			else
+				*result = var->value;
+			*isNull = var->isnull;
+			return true;
+		}
+	}
+
 	/*
 	 * Set up ParamListInfo to pass to executor.  For safety, save and restore
 	 * estate->paramLI->parserSetupArg around our use of the param list.
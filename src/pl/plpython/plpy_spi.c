@@ -14,6 +14,7 @@
 #include "executor/spi.h"
 #include "mb/pg_wchar.h"
 #include "parser/parse_type.h"
+#include "parser/parser.h"
 #include "plpy_elog.h"
 #include "plpy_main.h"
 #include "plpy_planobject.h"
@@ -22,11 +23,38 @@
 #include "plpy_resultobject.h"
 #include "plpy_spi.h"
 #include "plpython.h"
+#include "tcop/utility.h"
 #include "utils/memutils.h"
+#include "utils/plancache.h"
 #include "utils/syscache.h"
 
+/*
+ * DestReceiver that converts query result rows to Python objects as the
+ * executor produces them, instead of collecting them in an SPITupleTable
+ * first.
+ */
+typedef struct PLySPIReceiver
+{
+	DestReceiver pub;			/* publicly-known function pointers */
+	PLyProcedure *proc;			/* procedure we're executing for */
+	MemoryContext cxt;			/* context holding ininfo and tupdesc */
+	PLyDatumToOb ininfo;		/* conversion info for result rows */
+	TupleDesc	tupdesc;		/* descriptor of the rows, or NULL */
+	PyObject   *rows;			/* list of converted rows, or NULL */
+	uint64		nrows;			/* number of rows in the list */
+} PLySPIReceiver;
+
 static PyObject *PLy_spi_execute_query(char *query, long limit);
-static PyObject *PLy_spi_execute_fetch_result(SPITupleTable *tuptable,
+static PLySPIReceiver *PLy_spi_receiver_create(PLyProcedure *proc);
+static void PLy_spi_receiver_free(PLySPIReceiver *receiver);
+static void PLy_spi_receiver_startup(DestReceiver *self, int operation,
+									 TupleDesc typeinfo);
+static bool PLy_spi_receiver_receive(TupleTableSlot *slot, DestReceiver *self);
+static void PLy_spi_receiver_shutdown(DestReceiver *self);
+static void PLy_spi_receiver_destroy(DestReceiver *self);
+static bool PLy_spi_result_has_rows(int status, SPIPlanPtr plan,
+									const char *query);
+static PyObject *PLy_spi_execute_fetch_result(PLySPIReceiver *receiver,
 											  uint64 rows, int status);
 static void PLy_spi_exception_set(PyObject *excclass, ErrorData *edata);
 
@@ -181,6 +209,7 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit)
 	volatile MemoryContext oldcontext;
 	volatile ResourceOwner oldowner;
 	PyObject   *ret;
+	PLySPIReceiver *volatile receiver = NULL;
 
 	if (list != NULL)
 	{
@@ -222,17 +251,16 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit)
 	PG_TRY();
 	{
 		PLyExecutionContext *exec_ctx = PLy_current_execution_context();
-		char	   *volatile nulls;
+		ParamListInfo paramLI;
+		SPIExecuteOptions options;
 		volatile int j;
 
-		if (nargs > 0)
-			nulls = palloc(nargs * sizeof(char));
-		else
-			nulls = NULL;
+		paramLI = makeParamList(nargs);
 
 		for (j = 0; j < nargs; j++)
 		{
 			PLyObToDatum *arg = &plan->args[j];
+			ParamExternData *prm = &paramLI->params[j];
 			PyObject   *elem;
 
 			elem = PySequence_GetItem(list, j);
@@ -241,7 +269,10 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit)
 				bool		isnull;
 
 				plan->values[j] = PLy_output_convert(arg, elem, &isnull);
-				nulls[j] = isnull ? 'n' : ' ';
+				prm->value = plan->values[j];
+				prm->isnull = isnull;
+				prm->pflags = PARAM_FLAG_CONST;
+				prm->ptype = plan->types[j];
 			}
 			PG_FINALLY(2);
 			{
@@ -250,12 +281,21 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit)
 			PG_END_TRY(2);
 		}
 
-		rv = SPI_execute_plan(plan->plan, plan->values, nulls,
-							  exec_ctx->curr_proc->fn_readonly, limit);
-		ret = PLy_spi_execute_fetch_result(SPI_tuptable, SPI_processed, rv);
+		receiver = PLy_spi_receiver_create(exec_ctx->curr_proc);
+
+		memset(&options, 0, sizeof(options));
+		options.params = paramLI;
+		options.read_only = exec_ctx->curr_proc->fn_readonly;
+		options.tcount = limit;
+		options.dest = (DestReceiver *) receiver;
+
+		rv = SPI_execute_plan_extended(plan->plan, &options);
+		if (receiver->rows && !PLy_spi_result_has_rows(rv, plan->plan, NULL))
+			Py_CLEAR(receiver->rows);
+		ret = PLy_spi_execute_fetch_result(receiver, SPI_processed, rv);
+		receiver = NULL;
 
-		if (nargs > 0)
-			pfree(nulls);
+		pfree(paramLI);
 
 		PLy_spi_subtransaction_commit(oldcontext, oldowner);
 	}
@@ -263,6 +303,9 @@ PLy_spi_execute_plan(PyObject *ob, PyObject *list, long limit)
 	{
 		int			k;
 
+		if (receiver != NULL)
+			PLy_spi_receiver_free(receiver);
+
 		/*
 		 * cleanup plan->values array
 		 */
@@ -309,6 +352,7 @@ PLy_spi_execute_query(char *query, long limit)
 	volatile MemoryContext oldcontext;
 	volatile ResourceOwner oldowner;
 	PyObject   *ret = NULL;
+	PLySPIReceiver *volatile receiver = NULL;
 
 	oldcontext = CurrentMemoryContext;
 	oldowner = CurrentResourceOwner;
@@ -318,15 +362,29 @@ PLy_spi_execute_query(char *query, long limit)
 	PG_TRY();
 	{
 		PLyExecutionContext *exec_ctx = PLy_current_execution_context();
+		SPIExecuteOptions options;
 
 		pg_verifymbstr(query, strlen(query), false);
-		rv = SPI_execute(query, exec_ctx->curr_proc->fn_readonly, limit);
-		ret = PLy_spi_execute_fetch_result(SPI_tuptable, SPI_processed, rv);
+
+		receiver = PLy_spi_receiver_create(exec_ctx->curr_proc);
+
+		memset(&options, 0, sizeof(options));
+		options.read_only = exec_ctx->curr_proc->fn_readonly;
+		options.tcount = limit;
+		options.dest = (DestReceiver *) receiver;
+
+		rv = SPI_execute_extended(query, &options);
+		if (receiver->rows && !PLy_spi_result_has_rows(rv, NULL, query))
+			Py_CLEAR(receiver->rows);
+		ret = PLy_spi_execute_fetch_result(receiver, SPI_processed, rv);
+		receiver = NULL;
 
 		PLy_spi_subtransaction_commit(oldcontext, oldowner);
 	}
 	PG_CATCH();
 	{
+		if (receiver != NULL)
+			PLy_spi_receiver_free(receiver);
 		PLy_spi_subtransaction_abort(oldcontext, oldowner);
 		return NULL;
 	}
@@ -344,113 +402,209 @@ PLy_spi_execute_query(char *query, long limit)
 	return ret;
 }
 
+/*
+ * Create a DestReceiver to collect query results for PLy_spi_execute_fetch_result
+ */
+static PLySPIReceiver *
+PLy_spi_receiver_create(PLyProcedure *proc)
+{
+	PLySPIReceiver *receiver = palloc0(sizeof(PLySPIReceiver));
+
+	receiver->pub.receiveSlot = PLy_spi_receiver_receive;
+	receiver->pub.rStartup = PLy_spi_receiver_startup;
+	receiver->pub.rShutdown = PLy_spi_receiver_shutdown;
+	receiver->pub.rDestroy = PLy_spi_receiver_destroy;
+	receiver->pub.mydest = DestNone;
+	receiver->proc = proc;
+	receiver->cxt = AllocSetContextCreate(CurrentMemoryContext,
+										  "PL/Python temp context",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	/* Initialize for converting result tuples to Python */
+	PLy_input_setup_func(&receiver->ininfo, receiver->cxt, RECORDOID, -1,
+						 proc);
+
+	return receiver;
+}
+
+/*
+ * Release a receiver and anything it still holds
+ */
+static void
+PLy_spi_receiver_free(PLySPIReceiver *receiver)
+{
+	Py_XDECREF(receiver->rows);
+	MemoryContextDelete(receiver->cxt);
+	pfree(receiver);
+}
+
+/*
+ * Start receiving the rows of a query.  If a query string contains several
+ * queries, only the result of the last one is kept, as with SPI_tuptable.
+ */
+static void
+PLy_spi_receiver_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	PLySPIReceiver *receiver = (PLySPIReceiver *) self;
+	MemoryContext oldcontext;
+
+	Py_XDECREF(receiver->rows);
+	receiver->rows = NULL;
+	receiver->nrows = 0;
+	if (receiver->tupdesc)
+		FreeTupleDesc(receiver->tupdesc);
+
+	/* The descriptor must outlive the query, see PLy_input_setup_tuple */
+	oldcontext = MemoryContextSwitchTo(receiver->cxt);
+	receiver->tupdesc = CreateTupleDescCopy(typeinfo);
+	MemoryContextSwitchTo(oldcontext);
+
+	PLy_input_setup_tuple(&receiver->ininfo, receiver->tupdesc,
+						  receiver->proc);
+
+	receiver->rows = PyList_New(0);
+	if (receiver->rows == NULL)
+		PLy_elog(ERROR, "could not create new Python list");
+}
+
+/*
+ * Convert one result row and append it to the list
+ */
+static bool
+PLy_spi_receiver_receive(TupleTableSlot *slot, DestReceiver *self)
+{
+	PLySPIReceiver *receiver = (PLySPIReceiver *) self;
+	PyObject   *row;
+
+	/*
+	 * PyList_Append() uses Py_ssize_t for the list size; so we cannot support
+	 * a result larger than PY_SSIZE_T_MAX.
+	 */
+	if (receiver->nrows >= (uint64) PY_SSIZE_T_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("query result has too many rows to fit in a Python list")));
+
+	row = PLy_input_from_slot(&receiver->ininfo, slot, true);
+	if (row == NULL || PyList_Append(receiver->rows, row) < 0)
+	{
+		Py_XDECREF(row);
+		PLy_elog(ERROR, "could not add row to query result");
+	}
+	Py_DECREF(row);
+	receiver->nrows++;
+
+	return true;
+}
+
+static void
+PLy_spi_receiver_shutdown(DestReceiver *self)
+{
+	/* nothing to do */
+}
+
+static void
+PLy_spi_receiver_destroy(DestReceiver *self)
+{
+	/* the receiver is freed by our caller, once it has taken the rows */
+}
+
+/*
+ * Did the statement that determined the status of an execution return rows?
+ *
+ * The receiver keeps the rows of the last statement that returned any.  If
+ * a query string or plan holds several statements, that might have been an
+ * earlier one than the statement SPI reports the status of, and then the
+ * result must not have any rows, as with SPI_tuptable.  The status tells
+ * for everything but utility statements, which are looked up.
+ */
+static bool
+PLy_spi_result_has_rows(int status, SPIPlanPtr plan, const char *query)
+{
+	Node	   *stmt;
+
+	switch (status)
+	{
+		case SPI_OK_SELECT:
+		case SPI_OK_INSERT_RETURNING:
+		case SPI_OK_DELETE_RETURNING:
+		case SPI_OK_UPDATE_RETURNING:
+		case SPI_OK_MERGE_RETURNING:
+			return true;
+		case SPI_OK_UTILITY:
+			break;
+		default:
+			return false;
+	}
+
+	if (plan != NULL)
+	{
+		CachedPlanSource *plansource = llast(SPI_plan_get_plan_sources(plan));
+
+		return plansource->resultDesc != NULL;
+	}
+
+	/* SPI has parsed the string successfully, so this can't fail */
+	stmt = llast_node(RawStmt, raw_parser(query, RAW_PARSE_DEFAULT))->stmt;
+
+	/* Output arguments of a CALL are only known after parse analysis */
+	if (IsA(stmt, CallStmt))
+		return true;
+
+	return UtilityReturnsTuples(stmt);
+}
+
+/*
+ * Build the Python result object of a query, taking over the rows that the
+ * receiver collected, and free the receiver.
+ */
 static PyObject *
-PLy_spi_execute_fetch_result(SPITupleTable *tuptable, uint64 rows, int status)
+PLy_spi_execute_fetch_result(PLySPIReceiver *receiver, uint64 rows, int status)
 {
 	PLyResultObject *result;
-	PLyExecutionContext *exec_ctx = PLy_current_execution_context();
-	volatile MemoryContext oldcontext;
 
 	result = (PLyResultObject *) PLy_result_new();
 	if (!result)
 	{
-		SPI_freetuptable(tuptable);
+		PLy_spi_receiver_free(receiver);
 		return NULL;
 	}
 	Py_DECREF(result->status);
 	result->status = PyLong_FromLong(status);
 
-	if (status > 0 && tuptable == NULL)
+	if (status > 0 && receiver->rows == NULL)
 	{
 		Py_DECREF(result->nrows);
 		result->nrows = PyLong_FromUnsignedLongLong(rows);
 	}
-	else if (status > 0 && tuptable != NULL)
+	else if (status > 0)
 	{
-		PLyDatumToOb ininfo;
-		MemoryContext cxt;
+		MemoryContext oldcontext;
 
+		/*
+		 * Report the number of rows we got, like SPI_tuptable would; for a
+		 * utility statement returning rows, SPI_processed could be zero.
+		 */
 		Py_DECREF(result->nrows);
-		result->nrows = PyLong_FromUnsignedLongLong(rows);
-
-		cxt = AllocSetContextCreate(CurrentMemoryContext,
-									"PL/Python temp context",
-									ALLOCSET_DEFAULT_SIZES);
-
-		/* Initialize for converting result tuples to Python */
-		PLy_input_setup_func(&ininfo, cxt, RECORDOID, -1,
-							 exec_ctx->curr_proc);
+		result->nrows = PyLong_FromUnsignedLongLong(receiver->nrows);
 
-		oldcontext = CurrentMemoryContext;
-		PG_TRY();
-		{
-			MemoryContext oldcontext2;
-
-			if (rows)
-			{
-				uint64		i;
-
-				/*
-				 * PyList_New() and PyList_SetItem() use Py_ssize_t for list
-				 * size and list indices; so we cannot support a result larger
-				 * than PY_SSIZE_T_MAX.
-				 */
-				if (rows > (uint64) PY_SSIZE_T_MAX)
-					ereport(ERROR,
-							(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
-							 errmsg("query result has too many rows to fit in a Python list")));
-
-				Py_DECREF(result->rows);
-				result->rows = PyList_New(rows);
-				if (result->rows)
-				{
-					PLy_input_setup_tuple(&ininfo, tuptable->tupdesc,
-										  exec_ctx->curr_proc);
-
-					for (i = 0; i < rows; i++)
-					{
-						PyObject   *row = PLy_input_from_tuple(&ininfo,
-															   tuptable->vals[i],
-															   tuptable->tupdesc,
-															   true);
-
-						PyList_SetItem(result->rows, i, row);
-					}
-				}
-			}
+		Py_DECREF(result->rows);
+		result->rows = receiver->rows;
+		receiver->rows = NULL;
 
-			/*
-			 * Save tuple descriptor for later use by result set metadata
-			 * functions.  Save it in TopMemoryContext so that it survives
-			 * outside of an SPI context.  We trust that PLy_result_dealloc()
-			 * will clean it up when the time is right.  (Do this as late as
-			 * possible, to minimize the number of ways the tupdesc could get
-			 * leaked due to errors.)
-			 */
-			oldcontext2 = MemoryContextSwitchTo(TopMemoryContext);
-			result->tupdesc = CreateTupleDescCopy(tuptable->tupdesc);
-			MemoryContextSwitchTo(oldcontext2);
-		}
-		PG_CATCH();
-		{
-			MemoryContextSwitchTo(oldcontext);
-			MemoryContextDelete(cxt);
-			Py_DECREF(result);
-			PG_RE_THROW();
-		}
-		PG_END_TRY();
-
-		MemoryContextDelete(cxt);
-		SPI_freetuptable(tuptable);
-
-		/* in case PyList_New() failed above */
-		if (!result->rows)
-		{
-			Py_DECREF(result);
-			result = NULL;
-		}
+		/*
+		 * Save tuple descriptor for later use by result set metadata
+		 * functions.  Save it in TopMemoryContext so that it survives outside
+		 * of an SPI context.  We trust that PLy_result_dealloc() will clean
+		 * it up when the time is right.
+		 */
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		result->tupdesc = CreateTupleDescCopy(receiver->tupdesc);
+		MemoryContextSwitchTo(oldcontext);
 	}
 
+	PLy_spi_receiver_free(receiver);
+
 	return (PyObject *) result;
 }
 
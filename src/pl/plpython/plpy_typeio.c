@@ -37,7 +37,8 @@ static PyObject *PLyList_FromArray(PLyDatumToOb *arg, Datum d);
 static PyObject *PLyList_FromArray_recurse(PLyDatumToOb *elm, int *dims, int ndim, int dim,
 										   char **dataptr_p, bits8 **bitmap_p, int *bitmask_p);
 static PyObject *PLyDict_FromComposite(PLyDatumToOb *arg, Datum d);
-static PyObject *PLyDict_FromTuple(PLyDatumToOb *arg, HeapTuple tuple, TupleDesc desc, bool include_generated);
+static PyObject *PLyDict_FromTuple(PLyDatumToOb *arg, HeapTuple tuple, TupleTableSlot *slot,
+								   TupleDesc desc, bool include_generated);
 
 /* conversion from Python objects to Datums */
 static Datum PLyObject_ToBool(PLyObToDatum *arg, PyObject *plrv,
@@ -145,7 +146,37 @@ PLy_input_from_tuple(PLyDatumToOb *arg, HeapTuple tuple, TupleDesc desc, bool in
 
 	oldcontext = MemoryContextSwitchTo(scratch_context);
 
-	dict = PLyDict_FromTuple(arg, tuple, desc, include_generated);
+	dict = PLyDict_FromTuple(arg, tuple, NULL, desc, include_generated);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return dict;
+}
+
+/*
+ * Transform a tuple in a TupleTableSlot to a Python dict object.
+ *
+ * This is like PLy_input_from_tuple, but reads the column values straight
+ * from the slot, so that the caller need not form a HeapTuple first.
+ */
+PyObject *
+PLy_input_from_slot(PLyDatumToOb *arg, TupleTableSlot *slot, bool include_generated)
+{
+	PyObject   *dict;
+	PLyExecutionContext *exec_ctx = PLy_current_execution_context();
+	MemoryContext scratch_context = PLy_get_scratch_context(exec_ctx);
+	MemoryContext oldcontext;
+
+	/*
+	 * As in PLy_input_convert, do the work in the scratch context.
+	 */
+	MemoryContextReset(scratch_context);
+
+	oldcontext = MemoryContextSwitchTo(scratch_context);
+
+	slot_getallattrs(slot);
+	dict = PLyDict_FromTuple(arg, NULL, slot, slot->tts_tupleDescriptor,
+							 include_generated);
 
 	MemoryContextSwitchTo(oldcontext);
 
@@ -801,7 +832,7 @@ PLyDict_FromComposite(PLyDatumToOb *arg, Datum d)
 	tmptup.t_len = HeapTupleHeaderGetDatumLength(td);
 	tmptup.t_data = td;
 
-	dict = PLyDict_FromTuple(arg, &tmptup, tupdesc, true);
+	dict = PLyDict_FromTuple(arg, &tmptup, NULL, tupdesc, true);
 
 	ReleaseTupleDesc(tupdesc);
 
@@ -810,9 +841,13 @@ PLyDict_FromComposite(PLyDatumToOb *arg, Datum d)
 
 /*
  * Transform a tuple into a Python dict object.
+ *
+ * The tuple is taken from slot if that's not NULL, in which case the caller
+ * must have deformed it already; else from tuple.
  */
 static PyObject *
-PLyDict_FromTuple(PLyDatumToOb *arg, HeapTuple tuple, TupleDesc desc, bool include_generated)
+PLyDict_FromTuple(PLyDatumToOb *arg, HeapTuple tuple, TupleTableSlot *slot,
+				  TupleDesc desc, bool include_generated)
 {
 	PyObject   *volatile dict;
 
@@ -847,7 +882,13 @@ PLyDict_FromTuple(PLyDatumToOb *arg, HeapTuple tuple, TupleDesc desc, bool inclu
 			}
 
 			key = NameStr(attr->attname);
-			vattr = heap_getattr(tuple, (i + 1), desc, &is_null);
+			if (slot != NULL)
+			{
+				vattr = slot->tts_values[i];
+				is_null = slot->tts_isnull[i];
+			}
+			else
+				vattr = heap_getattr(tuple, (i + 1), desc, &is_null);
 
 			if (is_null)
 				PyDict_SetItemString(dict, key, Py_None);
@@ -6,6 +6,7 @@
 #define PLPY_TYPEIO_H
 
 #include "access/htup.h"
+#include "executor/tuptable.h"
 #include "fmgr.h"
 #include "plpython.h"
 #include "utils/typcache.h"
@@ -153,6 +154,8 @@ extern PGDLLEXPORT Datum PLy_output_convert(PLyObToDatum *arg, PyObject *val,
 
 extern PGDLLEXPORT PyObject *PLy_input_from_tuple(PLyDatumToOb *arg, HeapTuple tuple,
 												  TupleDesc desc, bool include_generated);
+extern PGDLLEXPORT PyObject *PLy_input_from_slot(PLyDatumToOb *arg, TupleTableSlot *slot,
+												 bool include_generated);
 
 extern PGDLLEXPORT void PLy_input_setup_func(PLyDatumToOb *arg, MemoryContext arg_mcxt,
 											 Oid typeOid, int32 typmod,
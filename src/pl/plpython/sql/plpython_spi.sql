@@ -194,6 +194,17 @@ $$ LANGUAGE plpython3u;
 SELECT result_str_test($$SELECT 1 AS foo UNION SELECT 2$$);
 SELECT result_str_test($$CREATE TEMPORARY TABLE foo1 (a int, b text)$$);
 
+-- only the last statement of a query string determines the result
+CREATE FUNCTION result_multi_test(cmd text) RETURNS text
+AS $$
+result = plpy.execute(cmd)
+return str(result)
+$$ LANGUAGE plpython3u;
+SELECT result_multi_test($$SELECT 1 AS foo; UPDATE foo3 SET b = 'x' WHERE a = 1$$);
+SELECT result_multi_test($$UPDATE foo3 SET b = 'y' WHERE a = 1; SELECT a FROM foo3 WHERE a = 1$$);
+SELECT result_multi_test($$SELECT 1 AS foo; SET LOCAL work_mem = '4MB'$$);
+SELECT result_multi_test($$SELECT 1 AS foo; SHOW standard_conforming_strings$$);
+
 -- cursor objects
 
 CREATE FUNCTION simple_cursor_test() RETURNS int AS $$
@@ -0,0 +1,181 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.c
+ *	  Basic NUMA memory placement support.
+ *
+ * On Linux we use the get_mempolicy(), mbind(), move_pages() and getcpu()
+ * system calls directly.  Memory ranges passed to pg_numa_interleave() and
+ * pg_numa_bind() must be aligned to the page size of the mapping.  Pages
+ * that were already faulted in are migrated.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_numa.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#include "port/pg_numa.h"
+
+#ifdef USE_NUMA
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if !defined(SYS_get_mempolicy) || !defined(SYS_mbind) || \
+	!defined(SYS_move_pages) || !defined(SYS_getcpu)
+#undef USE_NUMA
+#endif
+#endif
+
+#ifdef USE_NUMA
+
+#define NODEMASK_WORDS (PG_NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
+/*
+ * The kernel only looks at the first maxnode - 1 bits of a node mask.
+ */
+#define NODEMASK_MAXNODE (PG_NUMA_MAX_NODES + 1)
+
+#define NODEMASK_SET(mask, node) \
+	((mask)[(node) / (8 * sizeof(unsigned long))] |= \
+	 1UL << ((node) % (8 * sizeof(unsigned long))))
+#define NODEMASK_ISSET(mask, node) \
+	(((mask)[(node) / (8 * sizeof(unsigned long))] & \
+	  (1UL << ((node) % (8 * sizeof(unsigned long))))) != 0)
+
+/*
+ * Store the ids of the nodes this process may allocate memory on into
+ * nodes[], in ascending order, and return their number, or -1 on failure.
+ */
+int
+pg_numa_get_nodes(int *nodes, int max_nodes)
+{
+	unsigned long mask[NODEMASK_WORDS] = {0};
+	int			mode;
+	int			n = 0;
+
+	if (syscall(SYS_get_mempolicy, &mode, mask, NODEMASK_MAXNODE, NULL,
+				MPOL_F_MEMS_ALLOWED) != 0)
+		return -1;
+
+	for (int node = 0; node < PG_NUMA_MAX_NODES && n < max_nodes; node++)
+	{
+		if (NODEMASK_ISSET(mask, node))
+			nodes[n++] = node;
+	}
+
+	return n;
+}
+
+/*
+ * Return the node of the CPU we are currently running on, or -1 on failure.
+ * The scheduler may move us at any time, so this is just a hint.
+ */
+int
+pg_numa_current_node(void)
+{
+	unsigned int cpu;
+	unsigned int node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+		return -1;
+
+	return (int) node;
+}
+
+/*
+ * Interleave the pages of a memory range across the given nodes.
+ */
+int
+pg_numa_interleave(void *ptr, size_t size, const int *nodes, int nnodes)
+{
+	unsigned long mask[NODEMASK_WORDS] = {0};
+
+	for (int i = 0; i < nnodes; i++)
+	{
+		if (nodes[i] < 0 || nodes[i] >= PG_NUMA_MAX_NODES)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		NODEMASK_SET(mask, nodes[i]);
+	}
+
+	return syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, mask,
+				   NODEMASK_MAXNODE, MPOL_MF_MOVE);
+}
+
+/*
+ * Place the pages of a memory range on the given node.
+ *
+ * We use MPOL_PREFERRED rather than MPOL_BIND, so that running out of memory
+ * on one node doesn't make allocations fail.
+ */
+int
+pg_numa_bind(void *ptr, size_t size, int node)
+{
+	unsigned long mask[NODEMASK_WORDS] = {0};
+
+	if (node < 0 || node >= PG_NUMA_MAX_NODES)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	NODEMASK_SET(mask, node);
+
+	return syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, mask,
+				   NODEMASK_MAXNODE, MPOL_MF_MOVE);
+}
+
+/*
+ * Find out which node each of the given pages resides on.  On success,
+ * status[i] is set to the node of pages[i], or to a negative errno value,
+ * such as -ENOENT for a page that hasn't been faulted in yet.
+ */
+int
+pg_numa_query_pages(unsigned long count, void **pages, int *status)
+{
+	return syscall(SYS_move_pages, 0, count, pages, NULL, status, 0);
+}
+
+#else							/* !USE_NUMA */
+
+int
+pg_numa_get_nodes(int *nodes, int max_nodes)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_current_node(void)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_interleave(void *ptr, size_t size, const int *nodes, int nnodes)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_bind(void *ptr, size_t size, int node)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_query_pages(unsigned long count, void **pages, int *status)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif							/* USE_NUMA */
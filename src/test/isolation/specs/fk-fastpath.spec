@@ -0,0 +1,53 @@
+# Foreign key checks that look up the referenced row through the PK index
+# directly, while the row is concurrently deleted or updated.
+
+setup
+{
+  CREATE TABLE fp_pk (
+	id			int		PRIMARY KEY,
+	v			int
+  );
+
+  CREATE TABLE fp_fk (
+	id			int		REFERENCES fp_pk
+  );
+
+  INSERT INTO fp_pk VALUES (1, 0), (2, 0);
+}
+
+teardown
+{
+  DROP TABLE fp_fk, fp_pk;
+}
+
+session s1
+step s1b	{ BEGIN; }
+step s1del	{ DELETE FROM fp_pk WHERE id = 1; }
+step s1upk	{ UPDATE fp_pk SET id = 3 WHERE id = 1; }
+step s1upv	{ UPDATE fp_pk SET v = v + 1 WHERE id = 1; }
+step s1c	{ COMMIT; }
+step s1r	{ ROLLBACK; }
+
+session s2
+step s2brr	{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step s2s	{ SELECT count(*) FROM fp_fk; }
+step s2ins	{ INSERT INTO fp_fk VALUES (1); }
+step s2c	{ COMMIT; }
+step s2sfk	{ SELECT * FROM fp_fk; }
+
+# the referenced row is deleted: the check waits for the deleter, and fails
+# only if it commits
+permutation s1b s1del s2ins s1c s2sfk
+permutation s1b s1del s2ins s1r s2sfk
+
+# the referenced key is updated: the check follows the update chain and finds
+# the key gone
+permutation s1b s1upk s2ins s1c s2sfk
+
+# a non-key update does not conflict with the key share lock
+permutation s1b s1upv s2ins s1c s2sfk
+
+# in transaction-snapshot mode, a concurrently deleted row is a
+# serialization failure
+permutation s2brr s2s s1b s1del s1c s2ins s2c s2sfk
+permutation s2brr s2s s1b s1upv s1c s2ins s2c s2sfk
@@ -0,0 +1,46 @@
+/* src/test/modules/bench_primitives/bench_primitives--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION bench_primitives" to load this file. \quit
+
+--
+-- Each function returns the best (lowest) time per operation, in
+-- nanoseconds, observed across "runs" repetitions of the benchmark.
+--
+
+CREATE FUNCTION bench_lwlock(mode text DEFAULT 'exclusive',
+							 loops int8 DEFAULT 10000000,
+							 runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION bench_dynahash(nentries int4 DEFAULT 10000,
+							   loops int8 DEFAULT 10000000,
+							   runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION bench_simplehash(nentries int4 DEFAULT 10000,
+								 loops int8 DEFAULT 10000000,
+								 runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION bench_lfind32(nelements int4 DEFAULT 32,
+							  loops int8 DEFAULT 10000000,
+							  runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION bench_tuplesort(typ regtype DEFAULT 'int4',
+								nelements int4 DEFAULT 1000000,
+								runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION bench_allocset(chunk_size int4 DEFAULT 64,
+							   nchunks int4 DEFAULT 1000,
+							   loops int8 DEFAULT 10000,
+							   runs int4 DEFAULT 5)
+	RETURNS pg_catalog.float8
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
@@ -0,0 +1,472 @@
+/*--------------------------------------------------------------------------
+ *
+ * bench_primitives.c
+ *		Microbenchmarks for hot backend primitives.
+ *
+ * Each SQL-callable function here times a tight loop around one primitive
+ * (LWLock acquire/release, dynahash and simplehash lookups, pg_lfind32(),
+ * tuplesort, AllocSet allocation) and returns the best time per operation,
+ * in nanoseconds, seen across a number of runs.  Taking the minimum rather
+ * than the mean filters out most of the noise from interrupts, frequency
+ * scaling and other processes, which is what makes the numbers comparable
+ * between builds.  Inputs are generated from a fixed seed, outside of the
+ * timed section.
+ *
+ * Copyright (c) 2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/bench_primitives/bench_primitives.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <float.h>
+
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "common/pg_prng.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "parser/parse_oper.h"
+#include "portability/instr_time.h"
+#include "port/pg_lfind.h"
+#include "storage/lwlock.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/tuplesort.h"
+
+PG_MODULE_MAGIC;
+
+/* seed for all generated inputs, so that runs are reproducible */
+#define BENCH_SEED			UINT64CONST(0x5DEECE66D)
+
+/* number of distinct lookup keys cycled through by the lookup benchmarks */
+#define BENCH_NKEYS			65536
+
+/* results are folded in here so that the compiler can't drop the loops */
+static volatile uint64 bench_sink;
+
+/* simplehash table with uint32 keys */
+typedef struct BenchHashEntry
+{
+	uint32		key;
+	uint32		value;
+	char		status;
+} BenchHashEntry;
+
+#define SH_PREFIX benchhash
+#define SH_ELEMENT_TYPE BenchHashEntry
+#define SH_KEY_TYPE uint32
+#define SH_KEY key
+#define SH_HASH_KEY(tb, key) murmurhash32(key)
+#define SH_EQUAL(tb, a, b) ((a) == (b))
+#define SH_SCOPE static inline
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+PG_FUNCTION_INFO_V1(bench_lwlock);
+PG_FUNCTION_INFO_V1(bench_dynahash);
+PG_FUNCTION_INFO_V1(bench_simplehash);
+PG_FUNCTION_INFO_V1(bench_lfind32);
+PG_FUNCTION_INFO_V1(bench_tuplesort);
+PG_FUNCTION_INFO_V1(bench_allocset);
+
+static void
+check_positive(int64 value, const char *name)
+{
+	if (value <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("\"%s\" must be greater than zero", name)));
+}
+
+/*
+ * Return the time elapsed since "start" divided by "ops", in nanoseconds.
+ */
+static double
+ns_per_op(instr_time start, uint64 ops)
+{
+	instr_time	duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	return (double) INSTR_TIME_GET_NANOSEC(duration) / ops;
+}
+
+/*
+ * Build the array of keys looked up by the hash table benchmarks.  The
+ * tables hold the keys scatter_key(0) .. scatter_key(nentries - 1), and every
+ * lookup hits.
+ */
+static inline uint32
+scatter_key(uint32 i)
+{
+	return i * 2654435761U;
+}
+
+static uint32 *
+make_lookup_keys(int nentries)
+{
+	uint32	   *keys = palloc(sizeof(uint32) * BENCH_NKEYS);
+	pg_prng_state prng;
+
+	pg_prng_seed(&prng, BENCH_SEED);
+	for (int i = 0; i < BENCH_NKEYS; i++)
+		keys[i] = scatter_key(pg_prng_uint64_range(&prng, 0, nentries - 1));
+
+	return keys;
+}
+
+/*
+ * Uncontended acquire/release of a backend-local LWLock, in the given mode.
+ */
+Datum
+bench_lwlock(PG_FUNCTION_ARGS)
+{
+	char	   *modename = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int64		loops = PG_GETARG_INT64(1);
+	int32		runs = PG_GETARG_INT32(2);
+	static int	tranche_id = 0;
+	LWLockMode	mode;
+	LWLock		lock;
+	double		best = DBL_MAX;
+
+	if (strcmp(modename, "exclusive") == 0)
+		mode = LW_EXCLUSIVE;
+	else if (strcmp(modename, "shared") == 0)
+		mode = LW_SHARED;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid lock mode \"%s\"", modename),
+				 errhint("Valid modes are \"exclusive\" and \"shared\".")));
+	check_positive(loops, "loops");
+	check_positive(runs, "runs");
+
+	if (tranche_id == 0)
+	{
+		tranche_id = LWLockNewTrancheId();
+		LWLockRegisterTranche(tranche_id, "bench_primitives");
+	}
+	LWLockInitialize(&lock, tranche_id);
+
+	for (int run = 0; run < runs; run++)
+	{
+		instr_time	start;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		for (int64 i = 0; i < loops; i++)
+		{
+			LWLockAcquire(&lock, mode);
+			LWLockRelease(&lock);
+		}
+		best = Min(best, ns_per_op(start, loops));
+	}
+
+	PG_RETURN_FLOAT8(best);
+}
+
+/*
+ * HASH_FIND lookups in a backend-local dynahash table with uint32 keys.
+ */
+Datum
+bench_dynahash(PG_FUNCTION_ARGS)
+{
+	int32		nentries = PG_GETARG_INT32(0);
+	int64		loops = PG_GETARG_INT64(1);
+	int32		runs = PG_GETARG_INT32(2);
+	HASHCTL		ctl;
+	HTAB	   *htab;
+	uint32	   *keys;
+	double		best = DBL_MAX;
+
+	check_positive(nentries, "nentries");
+	check_positive(loops, "loops");
+	check_positive(runs, "runs");
+
+	ctl.keysize = sizeof(uint32);
+	ctl.entrysize = sizeof(BenchHashEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("bench_dynahash", nentries, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	for (int i = 0; i < nentries; i++)
+	{
+		uint32		key = scatter_key(i);
+		BenchHashEntry *entry;
+
+		entry = hash_search(htab, &key, HASH_ENTER, NULL);
+		entry->value = i;
+	}
+	keys = make_lookup_keys(nentries);
+
+	for (int run = 0; run < runs; run++)
+	{
+		instr_time	start;
+		uint64		sum = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		for (int64 i = 0; i < loops; i++)
+		{
+			BenchHashEntry *entry;
+
+			entry = hash_search(htab, &keys[i % BENCH_NKEYS], HASH_FIND, NULL);
+			sum += entry->value;
+		}
+		best = Min(best, ns_per_op(start, loops));
+		bench_sink += sum;
+	}
+
+	hash_destroy(htab);
+	pfree(keys);
+
+	PG_RETURN_FLOAT8(best);
+}
+
+/*
+ * Lookups in a simplehash table with uint32 keys, for comparison with
+ * bench_dynahash().
+ */
+Datum
+bench_simplehash(PG_FUNCTION_ARGS)
+{
+	int32		nentries = PG_GETARG_INT32(0);
+	int64		loops = PG_GETARG_INT64(1);
+	int32		runs = PG_GETARG_INT32(2);
+	benchhash_hash *htab;
+	uint32	   *keys;
+	double		best = DBL_MAX;
+
+	check_positive(nentries, "nentries");
+	check_positive(loops, "loops");
+	check_positive(runs, "runs");
+
+	htab = benchhash_create(CurrentMemoryContext, nentries, NULL);
+	for (int i = 0; i < nentries; i++)
+	{
+		bool		found;
+		BenchHashEntry *entry;
+
+		entry = benchhash_insert(htab, scatter_key(i), &found);
+		entry->value = i;
+	}
+	keys = make_lookup_keys(nentries);
+
+	for (int run = 0; run < runs; run++)
+	{
+		instr_time	start;
+		uint64		sum = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		for (int64 i = 0; i < loops; i++)
+		{
+			BenchHashEntry *entry;
+
+			entry = benchhash_lookup(htab, keys[i % BENCH_NKEYS]);
+			sum += entry->value;
+		}
+		best = Min(best, ns_per_op(start, loops));
+		bench_sink += sum;
+	}
+
+	benchhash_destroy(htab);
+	pfree(keys);
+
+	PG_RETURN_FLOAT8(best);
+}
+
+/*
+ * pg_lfind32() over an array of the given length.  Half of the searched keys
+ * are present, at uniformly distributed positions.
+ */
+Datum
+bench_lfind32(PG_FUNCTION_ARGS)
+{
+	int32		nelements = PG_GETARG_INT32(0);
+	int64		loops = PG_GETARG_INT64(1);
+	int32		runs = PG_GETARG_INT32(2);
+	uint32	   *array;
+	uint32	   *keys;
+	pg_prng_state prng;
+	double		best = DBL_MAX;
+
+	check_positive(nelements, "nelements");
+	check_positive(loops, "loops");
+	check_positive(runs, "runs");
+
+	array = palloc(sizeof(uint32) * nelements);
+	for (int i = 0; i < nelements; i++)
+		array[i] = 2 * i;
+	keys = palloc(sizeof(uint32) * BENCH_NKEYS);
+	pg_prng_seed(&prng, BENCH_SEED);
+	for (int i = 0; i < BENCH_NKEYS; i++)
+		keys[i] = pg_prng_uint64_range(&prng, 0, 2 * (uint64) nelements - 1);
+
+	for (int run = 0; run < runs; run++)
+	{
+		instr_time	start;
+		uint64		found = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		for (int64 i = 0; i < loops; i++)
+			found += pg_lfind32(keys[i % BENCH_NKEYS], array, nelements);
+		best = Min(best, ns_per_op(start, loops));
+		bench_sink += found;
+	}
+
+	pfree(array);
+	pfree(keys);
+
+	PG_RETURN_FLOAT8(best);
+}
+
+/*
+ * In-memory datum sort of random values, using the type's default btree
+ * ordering.  The time reported is per element, and covers loading the sort,
+ * sorting and reading the result back.  This mostly measures the
+ * comparators: the specialized ones for int4, int8 and float8 (which are
+ * also abbreviated on 64-bit platforms), and the abbreviated-key path of
+ * text.
+ */
+Datum
+bench_tuplesort(PG_FUNCTION_ARGS)
+{
+	Oid			typid = PG_GETARG_OID(0);
+	int32		nelements = PG_GETARG_INT32(1);
+	int32		runs = PG_GETARG_INT32(2);
+	Oid			sortop;
+	Oid			collation;
+	Datum	   *values;
+	pg_prng_state prng;
+	double		best = DBL_MAX;
+
+	check_positive(nelements, "nelements");
+	check_positive(runs, "runs");
+
+	if (typid != INT4OID && typid != INT8OID && typid != FLOAT8OID &&
+		typid != TEXTOID)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("unsupported type %s", format_type_be(typid)),
+				 errhint("Supported types are integer, bigint, double precision and text.")));
+
+	get_sort_group_operators(typid, true, false, false, &sortop,
+							 NULL, NULL, NULL);
+	collation = get_typcollation(typid);
+
+	values = palloc(sizeof(Datum) * nelements);
+	pg_prng_seed(&prng, BENCH_SEED);
+	for (int i = 0; i < nelements; i++)
+	{
+		uint64		r = pg_prng_uint64(&prng);
+
+		switch (typid)
+		{
+			case INT4OID:
+				values[i] = Int32GetDatum((int32) r);
+				break;
+			case INT8OID:
+				values[i] = Int64GetDatum((int64) r);
+				break;
+			case FLOAT8OID:
+				values[i] = Float8GetDatum(pg_prng_double(&prng));
+				break;
+			case TEXTOID:
+				values[i] = PointerGetDatum(cstring_to_text(psprintf("%016" INT64_MODIFIER "x", r)));
+				break;
+		}
+	}
+
+	for (int run = 0; run < runs; run++)
+	{
+		instr_time	start;
+		Tuplesortstate *state;
+		Datum		value;
+		bool		isnull;
+		uint64		count = 0;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(start);
+		state = tuplesort_begin_datum(typid, sortop, collation, false,
+									  work_mem, NULL, TUPLESORT_NONE);
+		for (int i = 0; i < nelements; i++)
+			tuplesort_putdatum(state, values[i], false);
+		tuplesort_performsort(state);
+		while (tuplesort_getdatum(state, true, false, &value, &isnull, NULL))
+			count++;
+		tuplesort_end(state);
+		best = Min(best, ns_per_op(start, nelements));
+		bench_sink += count;
+	}
+
+	PG_RETURN_FLOAT8(best);
+}
+
+/*
+ * palloc/pfree pairs in an AllocSet context.  Each loop allocates "nchunks"
+ * chunks of "chunk_size" bytes and then frees them in allocation order, so
+ * that both the freelist and the block allocation paths are exercised.
+ */
+Datum
+bench_allocset(PG_FUNCTION_ARGS)
+{
+	int32		chunk_size = PG_GETARG_INT32(0);
+	int32		nchunks = PG_GETARG_INT32(1);
+	int64		loops = PG_GETARG_INT64(2);
+	int32		runs = PG_GETARG_INT32(3);
+	void	  **chunks;
+	double		best = DBL_MAX;
+
+	check_positive(chunk_size, "chunk_size");
+	check_positive(nchunks, "nchunks");
+	check_positive(loops, "loops");
+	check_positive(runs, "runs");
+	if (!AllocSizeIsValid(chunk_size))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("\"%s\" is out of range", "chunk_size")));
+
+	chunks = palloc(sizeof(void *) * nchunks);
+
+	for (int run = 0; run < runs; run++)
+	{
+		MemoryContext cxt;
+		instr_time	start;
+
+		CHECK_FOR_INTERRUPTS();
+
+		cxt = AllocSetContextCreate(CurrentMemoryContext,
+									"bench_allocset",
+									ALLOCSET_DEFAULT_SIZES);
+
+		INSTR_TIME_SET_CURRENT(start);
+		for (int64 i = 0; i < loops; i++)
+		{
+			for (int j = 0; j < nchunks; j++)
+				chunks[j] = MemoryContextAlloc(cxt, chunk_size);
+			for (int j = 0; j < nchunks; j++)
+				pfree(chunks[j]);
+		}
+		best = Min(best, ns_per_op(start, loops * nchunks));
+
+		MemoryContextDelete(cxt);
+	}
+
+	pfree(chunks);
+
+	PG_RETURN_FLOAT8(best);
+}
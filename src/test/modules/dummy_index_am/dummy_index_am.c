@@ -304,7 +304,9 @@ dihandler(PG_FUNCTION_ARGS)
 	amroutine->ambuild = dibuild;
 	amroutine->ambuildempty = dibuildempty;
 	amroutine->aminsert = diinsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->ambulkdelete = dibulkdelete;
+	amroutine->amretaildelete = NULL;
 	amroutine->amvacuumcleanup = divacuumcleanup;
 	amroutine->amcanreturn = NULL;
 	amroutine->amcostestimate = dicostestimate;
@@ -0,0 +1,17 @@
+CREATE EXTENSION test_dshash;
+SELECT test_dshash_get(1);
+SELECT test_dshash_set(1, 100);
+SELECT test_dshash_set(1, 101);
+SELECT test_dshash_get(1);
+\c
+SELECT test_dshash_get(1);
+-- enough entries to make every partition grow a few times
+SELECT count(*) FILTER (WHERE test_dshash_set(i, i * 3))
+  FROM generate_series(1, 20000) i;
+SELECT count(*) FROM generate_series(1, 20000) i WHERE test_dshash_get(i) = i * 3;
+SELECT test_dshash_count();
+SELECT count(*) FILTER (WHERE test_dshash_delete(i))
+  FROM generate_series(1, 20000, 2) i;
+SELECT test_dshash_delete(1);
+SELECT test_dshash_get(1), test_dshash_get(2);
+SELECT test_dshash_count();
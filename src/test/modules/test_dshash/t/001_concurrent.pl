@@ -0,0 +1,56 @@
+
+# Copyright (c) 2024, PostgreSQL Global Development Group
+
+# Test lock-free lookups in a dshash table that concurrent backends insert
+# into, update and delete from.  Readers check every entry they copy, so a
+# torn copy makes them fail.
+use strict;
+use warnings FATAL => 'all';
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+$node->start;
+$node->safe_psql('postgres', 'CREATE EXTENSION test_dshash');
+
+# Start with a few entries, few enough that inserts make partitions grow
+# while the readers run.
+$node->safe_psql('postgres',
+	'SELECT test_dshash_set(i, i) FROM generate_series(1, 100) i');
+
+$node->pgbench(
+	'--no-vacuum --client=8 --transactions=500',
+	0,
+	[qr{actually processed}],
+	[qr{^$}],
+	'concurrent dshash writers and lock-free readers',
+	{
+		'001_dshash_set' => q(
+			\set k random(1, 20000)
+			\set v random(1, 1000000000)
+			SELECT test_dshash_set(:k, :v);
+		),
+		'001_dshash_delete' => q(
+			\set k random(1, 20000)
+			SELECT test_dshash_delete(:k);
+		),
+		'001_dshash_get' => q(
+			\set k random(1, 20000)
+			SELECT test_dshash_get((:k + i) % 20000 + 1) FROM generate_series(1, 50) i;
+			SELECT test_dshash_count();
+		),
+	});
+
+# Every entry left behind is still intact, and visible to all lookups.
+my $result = $node->safe_psql(
+	'postgres', q(
+	SELECT count(*) = test_dshash_count()
+	FROM generate_series(1, 20000) i WHERE test_dshash_get(i) IS NOT NULL));
+is($result, 't', 'lookups agree with a sequential scan');
+
+$node->stop;
+done_testing();
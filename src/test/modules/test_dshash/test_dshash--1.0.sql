@@ -0,0 +1,16 @@
+/* src/test/modules/test_dshash/test_dshash--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION test_dshash" to load this file. \quit
+
+CREATE FUNCTION test_dshash_set(key INT, val BIGINT) RETURNS BOOL
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION test_dshash_get(key INT) RETURNS BIGINT
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION test_dshash_delete(key INT) RETURNS BOOL
+	AS 'MODULE_PATHNAME' LANGUAGE C STRICT;
+
+CREATE FUNCTION test_dshash_count() RETURNS BIGINT
+	AS 'MODULE_PATHNAME' LANGUAGE C;
@@ -0,0 +1,173 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_dshash.c
+ *	  Test the concurrent hash tables in dynamic shared memory.
+ *
+ * The table lives in a DSA area whose handles are kept in a segment of the
+ * DSM registry, so that all backends share it.  Each entry holds a value and
+ * its complement, written separately, so that a reader that sees one without
+ * the other has copied a torn entry.
+ *
+ * Copyright (c) 2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_dshash/test_dshash.c
+ *
+ * -------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "lib/dshash.h"
+#include "storage/dsm_registry.h"
+#include "storage/lwlock.h"
+#include "utils/dsa.h"
+#include "utils/memutils.h"
+
+PG_MODULE_MAGIC;
+
+typedef struct TestDshashEntry
+{
+	int32		key;
+	int64		val;
+	int64		check;			/* ~val */
+} TestDshashEntry;
+
+typedef struct TestDshashState
+{
+	int			tranche_id;
+	dsa_handle	area_handle;
+	dshash_table_handle table_handle;
+} TestDshashState;
+
+static const dshash_parameters tdh_params = {
+	sizeof(int32),
+	sizeof(TestDshashEntry),
+	dshash_memcmp,
+	dshash_memhash,
+	dshash_memcpy,
+	0							/* set at creation */
+};
+
+static dshash_table *tdh_table = NULL;
+
+static void
+tdh_init_shmem(void *ptr)
+{
+	TestDshashState *state = (TestDshashState *) ptr;
+	dshash_parameters params = tdh_params;
+	dsa_area   *area;
+	dshash_table *table;
+
+	state->tranche_id = LWLockNewTrancheId();
+	LWLockRegisterTranche(state->tranche_id, "test_dshash");
+
+	area = dsa_create(state->tranche_id);
+	dsa_pin(area);
+	dsa_pin_mapping(area);
+
+	params.tranche_id = state->tranche_id;
+	table = dshash_create(area, &params, NULL);
+
+	state->area_handle = dsa_get_handle(area);
+	state->table_handle = dshash_get_hash_table_handle(table);
+
+	tdh_table = table;
+}
+
+static void
+tdh_attach_shmem(void)
+{
+	TestDshashState *state;
+	dsa_area   *area;
+	MemoryContext oldcontext;
+	bool		found;
+
+	if (tdh_table != NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	state = GetNamedDSMSegment("test_dshash", sizeof(TestDshashState),
+							   tdh_init_shmem, &found);
+	if (found)
+	{
+		LWLockRegisterTranche(state->tranche_id, "test_dshash");
+		area = dsa_attach(state->area_handle);
+		dsa_pin_mapping(area);
+		tdh_table = dshash_attach(area, &tdh_params, state->table_handle,
+								  NULL);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+PG_FUNCTION_INFO_V1(test_dshash_set);
+Datum
+test_dshash_set(PG_FUNCTION_ARGS)
+{
+	int32		key = PG_GETARG_INT32(0);
+	int64		val = PG_GETARG_INT64(1);
+	TestDshashEntry *entry;
+	bool		found;
+
+	tdh_attach_shmem();
+
+	entry = dshash_find_or_insert(tdh_table, &key, &found);
+	entry->val = val;
+	entry->check = ~val;
+	dshash_release_lock(tdh_table, entry);
+
+	PG_RETURN_BOOL(found);
+}
+
+PG_FUNCTION_INFO_V1(test_dshash_get);
+Datum
+test_dshash_get(PG_FUNCTION_ARGS)
+{
+	int32		key = PG_GETARG_INT32(0);
+	TestDshashEntry entry;
+
+	tdh_attach_shmem();
+
+	if (!dshash_find_copy(tdh_table, &key, &entry))
+		PG_RETURN_NULL();
+
+	if (entry.key != key || entry.check != ~entry.val)
+		elog(ERROR, "copied inconsistent entry for key %d", key);
+
+	PG_RETURN_INT64(entry.val);
+}
+
+PG_FUNCTION_INFO_V1(test_dshash_delete);
+Datum
+test_dshash_delete(PG_FUNCTION_ARGS)
+{
+	int32		key = PG_GETARG_INT32(0);
+
+	tdh_attach_shmem();
+
+	PG_RETURN_BOOL(dshash_delete_key(tdh_table, &key));
+}
+
+PG_FUNCTION_INFO_V1(test_dshash_count);
+Datum
+test_dshash_count(PG_FUNCTION_ARGS)
+{
+	dshash_seq_status status;
+	TestDshashEntry *entry;
+	int64		count = 0;
+
+	tdh_attach_shmem();
+
+	dshash_seq_init(&status, tdh_table, false);
+	while ((entry = dshash_seq_next(&status)) != NULL)
+	{
+		if (entry->check != ~entry->val)
+			elog(ERROR, "found inconsistent entry for key %d", entry->key);
+		count++;
+	}
+	dshash_seq_term(&status);
+
+	PG_RETURN_INT64(count);
+}
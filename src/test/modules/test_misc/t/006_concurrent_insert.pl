@@ -0,0 +1,63 @@
+# Copyright (c) 2024, PostgreSQL Global Development Group
+
+# Test heap inserts from many backends at once into a table with free space
+# on all-visible pages.  Inserters that find a page's buffer lock busy move
+# on to another page, and the ones that get it at once pin the visibility
+# map page only after locking.
+use strict;
+use warnings FATAL => 'all';
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+$node->append_conf('postgresql.conf', 'autovacuum = off');
+$node->start;
+$node->safe_psql('postgres', 'CREATE EXTENSION pg_visibility');
+
+# Leave free space on every page, and have VACUUM mark the pages
+# all-visible and record the free space in the FSM.
+$node->safe_psql(
+	'postgres', q(
+	CREATE TABLE t_006 (id int, filler text);
+	INSERT INTO t_006 SELECT i, repeat('x', 100) FROM generate_series(1, 20000) i;
+	DELETE FROM t_006 WHERE id % 4 <> 0;
+	VACUUM (FREEZE) t_006;
+));
+my $pages = $node->safe_psql('postgres',
+	"SELECT pg_relation_size('t_006') / current_setting('block_size')::int");
+
+$node->pgbench(
+	'--no-vacuum --client=8 --transactions=1000',
+	0,
+	[qr{actually processed}],
+	[qr{^$}],
+	'concurrent single-row inserts',
+	{
+		'006_insert' => q(
+			INSERT INTO t_006 VALUES (-1, repeat('y', 100));
+		),
+	});
+
+my $result = $node->safe_psql('postgres',
+	"SELECT count(*) FROM t_006 WHERE id = -1");
+is($result, '8000', 'all inserted rows are there');
+
+# The inserts cleared the all-visible bits of the pages they went to.
+$result = $node->safe_psql('postgres',
+	"SELECT count(*) FROM pg_check_visible('t_006')");
+is($result, '0', 'no page is wrongly marked all-visible');
+$result = $node->safe_psql('postgres',
+	"SELECT count(*) FROM pg_check_frozen('t_006')");
+is($result, '0', 'no page is wrongly marked all-frozen');
+
+# Being passed over because of a busy lock must not make inserters extend
+# the table while there is room elsewhere.
+$result = $node->safe_psql('postgres',
+	"SELECT pg_relation_size('t_006') / current_setting('block_size')::int");
+is($result, $pages, 'the table did not grow');
+
+$node->stop;
+done_testing();
@@ -0,0 +1,45 @@
+# Tests of the shared query cache with concurrent changes
+#
+# s2 runs the same cacheable query over and over.  noisy() raises a notice
+# for every row it is computed for, so a result that is served from the cache
+# shows no notices.
+
+setup
+{
+  CREATE FUNCTION noisy(int) RETURNS int IMMUTABLE LANGUAGE plpgsql AS
+    $$ BEGIN RAISE NOTICE 'computing %', $1; RETURN $1; END $$;
+  CREATE TABLE qc (a int, b int);
+  INSERT INTO qc VALUES (1, 10), (2, 20);
+}
+
+teardown
+{
+  DROP TABLE qc;
+  DROP FUNCTION noisy(int);
+}
+
+session s1
+step s1b	{ BEGIN; }
+step s1ins	{ INSERT INTO qc VALUES (3, 30); }
+step s1upd	{ UPDATE qc SET b = b + 1 WHERE a = 1; }
+step s1del	{ DELETE FROM qc WHERE a = 2; }
+step s1alter	{ ALTER TABLE qc ALTER COLUMN b TYPE int USING b + 100; }
+step s1trunc	{ TRUNCATE qc; }
+step s1func	{ CREATE OR REPLACE FUNCTION noisy(int) RETURNS int IMMUTABLE LANGUAGE plpgsql AS $$ BEGIN RAISE NOTICE 'recomputing %', $1; RETURN $1 * 10; END $$; }
+step s1prep	{ PREPARE TRANSACTION 'qc'; }
+step s1c	{ COMMIT; }
+step s1cp	{ COMMIT PREPARED 'qc'; }
+
+session s2
+setup		{ SET query_cache = on; }
+step s2sel	{ SELECT noisy(a), b FROM qc ORDER BY a; }
+
+# Committed changes of every kind invalidate the result
+permutation s2sel s2sel s1ins s2sel s2sel s1upd s2sel s2sel s1del s2sel s2sel s1alter s2sel s2sel s1trunc s2sel
+# Until the change is committed, the cached result stays valid
+permutation s2sel s1b s1ins s2sel s2sel s1c s2sel s2sel
+# A prepared transaction keeps the result from being cached until it is
+# committed
+permutation s2sel s1b s1ins s1prep s2sel s2sel s1cp s2sel s2sel
+# Redefining a function the query uses invalidates the result
+permutation s2sel s2sel s1func s2sel s2sel
@@ -0,0 +1,133 @@
+--
+-- Tests of the shared query cache
+--
+-- noisy() raises a notice for every row it is computed for, so a result
+-- that is served from the cache shows no notices.
+CREATE FUNCTION noisy(int) RETURNS int IMMUTABLE LANGUAGE plpgsql AS
+$$ BEGIN RAISE NOTICE 'computing %', $1; RETURN $1; END $$;
+
+-- Set up everything first, so that creating it can't invalidate anything
+CREATE TABLE qc (a int, b int);
+INSERT INTO qc VALUES (1, 10), (2, 20);
+CREATE SCHEMA qcs;
+CREATE TABLE qcs.qc (a int, b int);
+INSERT INTO qcs.qc VALUES (1, 99);
+CREATE TABLE qc_rls (a int);
+INSERT INTO qc_rls VALUES (1);
+ALTER TABLE qc_rls ENABLE ROW LEVEL SECURITY;
+CREATE TEMP TABLE qc_temp (a int);
+INSERT INTO qc_temp VALUES (1);
+
+SET query_cache = on;
+
+-- The first execution fills the cache, the next ones are served from it
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SET query_cache = off;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SET query_cache = on;
+SELECT noisy(a), b FROM qc ORDER BY a;
+
+-- Changes to the table invalidate the result
+INSERT INTO qc VALUES (3, 30);
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+UPDATE qc SET b = 31 WHERE a = 3;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+DELETE FROM qc WHERE a = 3;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+ALTER TABLE qc ALTER COLUMN b TYPE int USING b + 100;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+TRUNCATE qc;
+SELECT noisy(a), b FROM qc ORDER BY a;
+INSERT INTO qc VALUES (1, 10), (2, 20);
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+
+-- A transaction doesn't use the cache once it has written something, and
+-- a change that is rolled back invalidates nothing
+BEGIN;
+INSERT INTO qc VALUES (3, 30);
+SELECT noisy(a), b FROM qc ORDER BY a;
+ROLLBACK;
+SELECT noisy(a), b FROM qc ORDER BY a;
+
+-- A prepared transaction invalidates the result until it is committed
+BEGIN;
+INSERT INTO qc VALUES (3, 30);
+PREPARE TRANSACTION 'qc_prep';
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+COMMIT PREPARED 'qc_prep';
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+DELETE FROM qc WHERE a = 3;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+
+-- Parameter values are part of the key
+PREPARE qc_param(int) AS SELECT noisy(a), b FROM qc WHERE a = $1;
+EXECUTE qc_param(1);
+EXECUTE qc_param(1);
+EXECUTE qc_param(2);
+EXECUTE qc_param(2);
+EXECUTE qc_param(1);
+DEALLOCATE qc_param;
+
+-- So are the settings that affect how the text of the query is read
+SET search_path = qcs, public;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
+RESET search_path;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SET TimeZone = 'UTC';
+SELECT noisy(a), timestamptz '2024-01-01 00:00' AS t FROM qc WHERE a = 1;
+SELECT noisy(a), timestamptz '2024-01-01 00:00' AS t FROM qc WHERE a = 1;
+SET TimeZone = 'America/New_York';
+SELECT noisy(a), timestamptz '2024-01-01 00:00' AS t FROM qc WHERE a = 1;
+SELECT noisy(a), timestamptz '2024-01-01 00:00' AS t FROM qc WHERE a = 1;
+SET TimeZone = 'UTC';
+SELECT noisy(a), timestamptz '2024-01-01 00:00' AS t FROM qc WHERE a = 1;
+RESET TimeZone;
+SELECT noisy(a), '{NULL}'::text[] AS arr FROM qc WHERE a = 1;
+SELECT noisy(a), '{NULL}'::text[] AS arr FROM qc WHERE a = 1;
+SET array_nulls = off;
+SELECT noisy(a), '{NULL}'::text[] AS arr FROM qc WHERE a = 1;
+SELECT noisy(a), '{NULL}'::text[] AS arr FROM qc WHERE a = 1;
+RESET array_nulls;
+SELECT noisy(a), '{NULL}'::text[] AS arr FROM qc WHERE a = 1;
+
+-- Queries that are never cached
+-- volatile and stable functions
+SELECT noisy(a), random() < 2 AS r FROM qc ORDER BY a;
+SELECT noisy(a), random() < 2 AS r FROM qc ORDER BY a;
+SELECT noisy(a), now() IS NOT NULL AS n FROM qc ORDER BY a;
+SELECT noisy(a), now() IS NOT NULL AS n FROM qc ORDER BY a;
+-- row level security
+SELECT noisy(a) FROM qc_rls;
+SELECT noisy(a) FROM qc_rls;
+-- temporary tables
+SELECT noisy(a) FROM qc_temp;
+SELECT noisy(a) FROM qc_temp;
+-- row locks
+SELECT noisy(a), b FROM qc ORDER BY a FOR UPDATE;
+SELECT noisy(a), b FROM qc ORDER BY a FOR UPDATE;
+-- serializable transactions
+BEGIN ISOLATION LEVEL SERIALIZABLE;
+SELECT noisy(a), b FROM qc ORDER BY a;
+COMMIT;
+-- cursors
+BEGIN;
+DECLARE qc_cursor CURSOR FOR SELECT noisy(a), b FROM qc ORDER BY a;
+FETCH ALL qc_cursor;
+COMMIT;
+SELECT noisy(a), b FROM qc ORDER BY a;
+
+-- Redefining a function that the query uses invalidates the result
+CREATE OR REPLACE FUNCTION noisy(int) RETURNS int IMMUTABLE LANGUAGE plpgsql AS
+$$ BEGIN RAISE NOTICE 'recomputing %', $1; RETURN $1 * 10; END $$;
+SELECT noisy(a), b FROM qc ORDER BY a;
+SELECT noisy(a), b FROM qc ORDER BY a;
@@ -0,0 +1,46 @@
+# Tests of the shared sequence cache with two sessions
+#
+# The first nextval() of either session logs values in advance, and the
+# other session then takes its values from the shared cache.
+
+setup
+{
+  CREATE SEQUENCE seqc;
+}
+
+teardown
+{
+  DROP SEQUENCE seqc;
+}
+
+session s1
+step s1b       { BEGIN; }
+step s1n       { SELECT nextval('seqc'); }
+step s1c       { COMMIT; }
+step s1r       { ROLLBACK; }
+
+session s2
+step s2n       { SELECT nextval('seqc'); }
+step s2setval  { SELECT setval('seqc', 100); }
+step s2restart { ALTER SEQUENCE seqc RESTART; }
+step s2cache   { ALTER SEQUENCE seqc CACHE 5; }
+step s2cycle   { ALTER SEQUENCE seqc MAXVALUE 3 CYCLE; }
+
+# Both sessions see one sequence of values
+permutation s1n s2n s1n s2n
+
+# setval() and ALTER SEQUENCE in one session drop the values the other
+# one would have taken from the shared cache
+permutation s1n s2n s2setval s1n s2restart s1n s2n
+
+# ALTER SEQUENCE waits for a transaction that used nextval()
+permutation s1b s1n s2restart s1c s1n s2n
+
+# Values taken by a transaction that rolls back are not reused
+permutation s1b s1n s1r s2n s1n
+
+# Each session takes up to CACHE values from the shared cache at a time
+permutation s2cache s1n s2n s1n s2n
+
+# CYCLE sequences bypass the shared cache and wrap around as usual
+permutation s2cycle s1n s2n s1n s2n
@@ -0,0 +1,87 @@
+--
+-- Tests of the shared sequence cache
+--
+SHOW shared_sequence_cache_size;
+
+-- The first nextval() logs values in advance for all sessions, and the
+-- sequence tuple shows them as fetched
+CREATE SEQUENCE seqc1;
+SELECT nextval('seqc1');
+SELECT last_value, log_cnt, is_called FROM seqc1;
+
+-- Later calls take them from the shared cache without touching the tuple
+SELECT nextval('seqc1') FROM generate_series(1, 3);
+SELECT currval('seqc1'), lastval();
+SELECT last_value, log_cnt, is_called FROM seqc1;
+
+-- Once they are used up, the next call logs a new batch
+SELECT count(*), min(v), max(v)
+  FROM (SELECT nextval('seqc1') AS v FROM generate_series(1, 253)) s;
+SELECT nextval('seqc1');
+SELECT last_value, log_cnt, is_called FROM seqc1;
+
+-- setval() drops the values handed out in advance
+SELECT setval('seqc1', 1000);
+SELECT nextval('seqc1');
+SELECT last_value, log_cnt, is_called FROM seqc1;
+SELECT setval('seqc1', 2000, false);
+SELECT nextval('seqc1'), nextval('seqc1');
+
+-- So does ALTER SEQUENCE.  Values already handed out in advance are lost,
+-- leaving a gap as with CACHE.
+ALTER SEQUENCE seqc1 RESTART;
+SELECT nextval('seqc1'), nextval('seqc1');
+ALTER SEQUENCE seqc1 INCREMENT BY 10;
+SELECT nextval('seqc1'), nextval('seqc1');
+
+-- Values logged for a rewritten sequence whose transaction rolls back are
+-- not used
+BEGIN;
+ALTER SEQUENCE seqc1 RESTART WITH 5000;
+SELECT nextval('seqc1');
+ROLLBACK;
+SELECT nextval('seqc1');
+
+-- As usual, values taken in a transaction that rolls back are not reused
+BEGIN;
+SELECT nextval('seqc1');
+ROLLBACK;
+SELECT nextval('seqc1');
+
+-- A session takes up to CACHE values from the shared cache at a time
+CREATE SEQUENCE seqc2 CACHE 10;
+SELECT nextval('seqc2');
+DISCARD SEQUENCES;
+SELECT nextval('seqc2'), nextval('seqc2');
+SELECT last_value, log_cnt, is_called FROM seqc2;
+
+-- Descending sequences
+CREATE SEQUENCE seqc3 INCREMENT BY -2;
+SELECT nextval('seqc3') FROM generate_series(1, 3);
+SELECT last_value, log_cnt, is_called FROM seqc3;
+
+-- Only the values up to MAXVALUE are handed out in advance
+CREATE SEQUENCE seqc4 MAXVALUE 4;
+SELECT nextval('seqc4') FROM generate_series(1, 4);
+SELECT last_value, log_cnt, is_called FROM seqc4;
+SELECT nextval('seqc4');
+
+-- CYCLE, temporary and unlogged sequences don't use the shared cache
+CREATE SEQUENCE seqc5 MAXVALUE 3 CYCLE;
+SELECT nextval('seqc5') FROM generate_series(1, 5);
+SELECT last_value, is_called FROM seqc5;
+CREATE TEMPORARY SEQUENCE seqc_temp;
+CREATE UNLOGGED SEQUENCE seqc_unlogged;
+SELECT nextval('seqc_temp'), nextval('seqc_unlogged');
+SELECT last_value, is_called FROM seqc_temp;
+SELECT last_value, is_called FROM seqc_unlogged;
+
+-- RESTART IDENTITY drops the values handed out in advance
+CREATE TABLE seqc_tab (id int GENERATED BY DEFAULT AS IDENTITY, t text);
+INSERT INTO seqc_tab (t) VALUES ('a'), ('b');
+TRUNCATE seqc_tab RESTART IDENTITY;
+INSERT INTO seqc_tab (t) VALUES ('c');
+SELECT * FROM seqc_tab;
+
+DROP TABLE seqc_tab;
+DROP SEQUENCE seqc1, seqc2, seqc3, seqc4, seqc5, seqc_temp, seqc_unlogged;
@@ -0,0 +1,142 @@
+
+# Copyright (c) 2024, PostgreSQL Global Development Group
+
+# Tests of finding prepared transactions by GID and by XID, with many of them
+# at once, finished out of order, and across crash and clean restarts.
+use strict;
+use warnings FATAL => 'all';
+
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq(
+	max_prepared_transactions = 100
+));
+$node->start;
+
+$node->safe_psql('postgres', "CREATE TABLE t_043 (id int, gid text)");
+
+# Prepare many transactions at once.  Each one holds an advisory lock on its
+# own number.  The even ones also hold enough other locks that their state
+# data doesn't fit in prepared_state_cache_size, and finishing them has to
+# read it back from WAL or from their state file.
+my $nxacts = 80;
+my $script = '';
+foreach my $i (1 .. $nxacts)
+{
+	$script .= "BEGIN;\n";
+	$script .= "INSERT INTO t_043 VALUES ($i, 'px_$i');\n";
+	$script .= "SELECT pg_advisory_xact_lock($i);\n";
+	$script .=
+	  "SELECT pg_advisory_xact_lock(1000 * $i + g) FROM generate_series(1, 100) g;\n"
+	  if $i % 2 == 0;
+	$script .= "PREPARE TRANSACTION 'px_$i';\n";
+}
+$node->safe_psql('postgres', $script);
+
+# Check the number of prepared transactions, and that the advisory lock on
+# its number is held by each of them, which is found through its XID.
+sub check_prepared
+{
+	local $Test::Builder::Level = $Test::Builder::Level + 1;
+
+	my ($expected, $msg) = @_;
+
+	my $result = $node->safe_psql('postgres',
+		"SELECT count(*) FROM pg_prepared_xacts WHERE gid LIKE 'px\\_%'");
+	is($result, $expected, "$msg: number of prepared transactions");
+
+	$result = $node->safe_psql(
+		'postgres', qq(
+		SELECT count(*) FROM pg_prepared_xacts p
+		  JOIN pg_locks x ON x.locktype = 'transactionid'
+		   AND x.transactionid = p.transaction
+		  JOIN pg_locks a ON a.virtualtransaction = x.virtualtransaction
+		   AND a.locktype = 'advisory'
+		   AND a.objid = substr(p.gid, 4)::oid
+		WHERE p.gid LIKE 'px\\_%'));
+	is($result, $expected, "$msg: locks held by prepared transactions");
+	return;
+}
+
+check_prepared($nxacts, 'after PREPARE');
+
+# Finish the first twenty in reverse order, committing the odd ones.
+$script = '';
+foreach my $i (reverse 1 .. 20)
+{
+	$script .= ($i % 2 ? "COMMIT" : "ROLLBACK") . " PREPARED 'px_$i';\n";
+}
+$node->safe_psql('postgres', $script);
+check_prepared($nxacts - 20, 'after finishing some');
+
+my $result = $node->safe_psql('postgres',
+	"SELECT bool_and(pg_try_advisory_xact_lock(g)) FROM generate_series(1, 20) g"
+);
+is($result, 't', 'locks of finished transactions are released');
+$result = $node->safe_psql('postgres',
+	"SELECT pg_try_advisory_xact_lock(21)");
+is($result, 'f', 'locks of other transactions are still held');
+
+# A GID can be used again once its transaction is finished, but not while
+# it is prepared.
+$node->safe_psql(
+	'postgres', "
+	BEGIN;
+	INSERT INTO t_043 VALUES (1001, 'px_1');
+	SELECT pg_advisory_xact_lock(1);
+	PREPARE TRANSACTION 'px_1';");
+my ($ret, $stdout, $stderr) = $node->psql('postgres',
+	"BEGIN; PREPARE TRANSACTION 'px_21';");
+like(
+	$stderr,
+	qr/transaction identifier "px_21" is already in use/,
+	'GID of a prepared transaction cannot be reused');
+check_prepared($nxacts - 19, 'after reusing a GID');
+
+# After a crash, the prepared transactions are restored from WAL.
+$node->stop('immediate');
+$node->start;
+check_prepared($nxacts - 19, 'after crash restart');
+
+# Finish some more, then restart cleanly so that the rest are restored from
+# their state files.
+$node->safe_psql('postgres', 'CHECKPOINT');
+$script = '';
+foreach my $i (21 .. 50)
+{
+	$script .= ($i % 2 ? "COMMIT" : "ROLLBACK") . " PREPARED 'px_$i';\n";
+}
+$node->safe_psql('postgres', $script);
+$node->restart;
+check_prepared($nxacts - 49, 'after clean restart');
+
+# Finish the rest, in reverse order again.
+$script = "COMMIT PREPARED 'px_1';\n";
+foreach my $i (reverse 51 .. $nxacts)
+{
+	$script .= ($i % 2 ? "COMMIT" : "ROLLBACK") . " PREPARED 'px_$i';\n";
+}
+$node->safe_psql('postgres', $script);
+check_prepared(0, 'after finishing all');
+
+$result = $node->safe_psql(
+	'postgres', qq(
+	SELECT bool_and(pg_try_advisory_xact_lock(g))
+	FROM generate_series(1, $nxacts) g));
+is($result, 't', 'all locks on transaction numbers are released');
+$result = $node->safe_psql(
+	'postgres', qq(
+	SELECT bool_and(pg_try_advisory_xact_lock(1000 * $nxacts + g))
+	FROM generate_series(1, 100) g));
+is($result, 't', 'other locks are released');
+
+$result = $node->safe_psql('postgres',
+	"SELECT count(*), count(*) FILTER (WHERE id % 2 = 0) FROM t_043");
+is($result, '41|0', 'only the committed transactions are visible');
+
+done_testing();
@@ -282,3 +282,75 @@ CREATE TABLE btree_part (id int4) PARTITION BY RANGE (id);
 CREATE INDEX btree_part_idx ON btree_part(id);
 ALTER INDEX btree_part_idx ALTER COLUMN id SET (n_distinct=100);
 DROP TABLE btree_part;
+
+--
+-- Test B-tree skip scans
+--
+CREATE TABLE btree_skip (a int, b int);
+INSERT INTO btree_skip SELECT i % 4, i / 4 FROM generate_series(0, 9999) i;
+INSERT INTO btree_skip VALUES (NULL, 10);
+CREATE INDEX ON btree_skip (a, b);
+VACUUM ANALYZE btree_skip;
+
+-- A leading column with few distinct values makes skipping cheap
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a;
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a;
+
+-- Backward scan
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b BETWEEN 10 AND 11 ORDER BY a DESC, b DESC;
+SELECT a, b FROM btree_skip WHERE b BETWEEN 10 AND 11 ORDER BY a DESC, b DESC;
+
+-- Changes of scan direction
+BEGIN;
+DECLARE btree_skip_cur SCROLL CURSOR FOR
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a;
+FETCH 2 FROM btree_skip_cur;
+FETCH BACKWARD 1 FROM btree_skip_cur;
+FETCH 3 FROM btree_skip_cur;
+FETCH BACKWARD 2 FROM btree_skip_cur;
+FETCH ALL FROM btree_skip_cur;
+FETCH BACKWARD ALL FROM btree_skip_cur;
+COMMIT;
+
+-- Mark and restore, by a merge join whose outer side has duplicate keys
+SET enable_hashjoin = off;
+SET enable_nestloop = off;
+SET enable_material = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*), sum(o.b * 100 + i.b) FROM btree_skip o JOIN btree_skip i ON i.a = o.a
+WHERE o.b BETWEEN 10 AND 11 AND i.b BETWEEN 10 AND 12;
+SELECT count(*), sum(o.b * 100 + i.b) FROM btree_skip o JOIN btree_skip i ON i.a = o.a
+WHERE o.b BETWEEN 10 AND 11 AND i.b BETWEEN 10 AND 12;
+RESET enable_hashjoin;
+RESET enable_nestloop;
+RESET enable_material;
+
+-- DESC columns
+DROP INDEX btree_skip_a_b_idx;
+CREATE INDEX btree_skip_desc_idx ON btree_skip (a DESC, b DESC);
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a DESC;
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a DESC;
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a;
+SELECT a, b FROM btree_skip WHERE b = 10 ORDER BY a;
+
+-- With many distinct values in the leading column, the scan soon gives up
+-- skipping and reads on through the index
+CREATE TABLE btree_skip_many AS
+SELECT i AS a, i % 10 AS b FROM generate_series(1, 5000) i;
+CREATE INDEX ON btree_skip_many (a, b);
+VACUUM ANALYZE btree_skip_many;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+EXPLAIN (COSTS OFF)
+SELECT count(*), min(a), max(a) FROM btree_skip_many WHERE b = 3;
+SELECT count(*), min(a), max(a) FROM btree_skip_many WHERE b = 3;
+EXPLAIN (COSTS OFF)
+SELECT a FROM btree_skip_many WHERE b = 3 ORDER BY a DESC LIMIT 3;
+SELECT a FROM btree_skip_many WHERE b = 3 ORDER BY a DESC LIMIT 3;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE btree_skip, btree_skip_many;
@@ -0,0 +1,81 @@
+--
+-- Tests for the columnar table access method
+--
+CREATE TABLE columnar_tbl (a int, b text, c float8) USING columnar;
+SELECT count(*) FROM columnar_tbl;
+INSERT INTO columnar_tbl SELECT g, 'row ' || g, g / 2.0
+  FROM generate_series(1, 1000) g;
+SELECT count(*), sum(a), min(b), max(c) FROM columnar_tbl;
+-- only the columns needed are decoded, and stripes can be skipped
+SELECT sum(c) FROM columnar_tbl WHERE a > 990;
+SELECT count(*) FROM columnar_tbl WHERE a < 0;
+SELECT b FROM columnar_tbl WHERE a = 500;
+-- nulls, and values large enough to be toasted in a heap table
+INSERT INTO columnar_tbl VALUES (1001, NULL, NULL), (1002, repeat('x', 10000), 0);
+SELECT a, b IS NULL AS b_null, length(b), c FROM columnar_tbl WHERE a > 1000 ORDER BY a;
+-- rows of aborted transactions and subtransactions are not visible
+BEGIN;
+INSERT INTO columnar_tbl VALUES (2000, 'in xact', 1);
+SELECT count(*) FROM columnar_tbl;
+SAVEPOINT s1;
+INSERT INTO columnar_tbl VALUES (2001, 'in subxact', 1);
+SELECT count(*) FROM columnar_tbl;
+ROLLBACK TO s1;
+INSERT INTO columnar_tbl VALUES (2002, 'in subxact, not written', 1);
+ROLLBACK TO s1;
+SELECT count(*) FROM columnar_tbl;
+ROLLBACK;
+SELECT count(*) FROM columnar_tbl;
+-- indexes
+CREATE INDEX columnar_tbl_a_idx ON columnar_tbl (a);
+SET enable_seqscan = off;
+SELECT a, b FROM columnar_tbl WHERE a BETWEEN 10 AND 12 ORDER BY a;
+-- rows not written yet are found through the index
+BEGIN;
+INSERT INTO columnar_tbl VALUES (3000, 'indexed', 1);
+SELECT a, b FROM columnar_tbl WHERE a = 3000;
+COMMIT;
+CREATE UNIQUE INDEX columnar_tbl_a_key ON columnar_tbl (a);
+INSERT INTO columnar_tbl VALUES (5, 'duplicate', 1);
+RESET enable_seqscan;
+-- rows can only be inserted
+UPDATE columnar_tbl SET b = 'updated' WHERE a = 1;
+DELETE FROM columnar_tbl WHERE a = 1;
+SELECT * FROM columnar_tbl WHERE a = 1 FOR UPDATE;
+INSERT INTO columnar_tbl VALUES (4000, 'conflict', 1) ON CONFLICT DO NOTHING;
+-- added and dropped columns
+ALTER TABLE columnar_tbl ADD COLUMN d int DEFAULT 7;
+ALTER TABLE columnar_tbl DROP COLUMN c;
+INSERT INTO columnar_tbl (a, b) VALUES (5000, 'after alter');
+SELECT count(*), sum(d) FROM columnar_tbl;
+SELECT * FROM columnar_tbl WHERE a >= 3000 ORDER BY a;
+-- maintenance
+VACUUM columnar_tbl;
+ANALYZE columnar_tbl;
+SELECT relpages > 0 AS has_pages, reltuples FROM pg_class WHERE relname = 'columnar_tbl';
+VACUUM FULL columnar_tbl;
+SELECT count(*), sum(a) FROM columnar_tbl;
+CLUSTER columnar_tbl USING columnar_tbl_a_idx;
+SET enable_seqscan = off;
+SELECT b FROM columnar_tbl WHERE a = 500;
+RESET enable_seqscan;
+SELECT count(*) FROM columnar_tbl TABLESAMPLE SYSTEM (100);
+SELECT count(*) FROM columnar_tbl TABLESAMPLE BERNOULLI (100);
+SELECT count(*) FROM columnar_tbl WHERE ctid < '(1,0)';
+-- CREATE TABLE AS, cursors and TRUNCATE
+CREATE TABLE columnar_ctas USING columnar AS
+  SELECT a, b FROM columnar_tbl WHERE a <= 100;
+BEGIN;
+DECLARE cur SCROLL CURSOR FOR SELECT a FROM columnar_ctas;
+FETCH 3 FROM cur;
+FETCH BACKWARD 2 FROM cur;
+FETCH LAST FROM cur;
+COMMIT;
+BEGIN;
+INSERT INTO columnar_ctas VALUES (101, 'gone');
+TRUNCATE columnar_ctas;
+INSERT INTO columnar_ctas VALUES (1, 'one');
+SELECT * FROM columnar_ctas;
+ROLLBACK;
+SELECT count(*) FROM columnar_ctas;
+DROP TABLE columnar_tbl, columnar_ctas;
@@ -0,0 +1,56 @@
+--
+-- Tests for TOAST compression with zstd
+--
+-- skip test if the server was built without zstd support
+SELECT NOT(enumvals @> '{zstd}') AS skip_test FROM pg_settings WHERE
+  name = 'default_toast_compression' \gset
+\if :skip_test
+\quit
+\endif
+
+\set HIDE_TOAST_COMPRESSION false
+
+-- ensure we get stable results regardless of installation's default
+SET default_toast_compression = 'pglz';
+
+-- test creating table with compression method
+CREATE TABLE cmdata_zstd(f1 text COMPRESSION zstd);
+INSERT INTO cmdata_zstd VALUES(repeat('1234567890', 1004));
+\d+ cmdata_zstd
+SELECT pg_column_compression(f1) FROM cmdata_zstd;
+
+-- decompress whole values and slices
+SELECT length(f1), f1 = repeat('1234567890', 1004) AS same FROM cmdata_zstd;
+SELECT SUBSTR(f1, 200, 5) FROM cmdata_zstd;
+SELECT SUBSTR(f1, 2000, 50) FROM cmdata_zstd;
+
+-- test externally stored compressed data
+INSERT INTO cmdata_zstd SELECT
+  (SELECT array_agg(fipshash(g::text))::text FROM generate_series(1, 256) g) ||
+  repeat('a', 4000);
+SELECT pg_column_compression(f1) FROM cmdata_zstd;
+SELECT SUBSTR(f1, 200, 5) FROM cmdata_zstd;
+SELECT length(f1) FROM cmdata_zstd;
+
+-- copying a value keeps its compression method
+CREATE TABLE cmmove_zstd(f1 text COMPRESSION pglz);
+INSERT INTO cmmove_zstd SELECT * FROM cmdata_zstd;
+SELECT pg_column_compression(f1) FROM cmmove_zstd;
+
+-- default_toast_compression and toast_zstd_level
+SET default_toast_compression = 'zstd';
+SET toast_zstd_level = 19;
+CREATE TABLE cmdata_zstd2(f1 text);
+INSERT INTO cmdata_zstd2 SELECT f1 || '' FROM cmdata_zstd;
+SELECT pg_column_compression(f1) FROM cmdata_zstd2;
+SELECT count(*) FROM cmdata_zstd a JOIN cmdata_zstd2 b ON a.f1 = b.f1;
+RESET toast_zstd_level;
+RESET default_toast_compression;
+
+-- change the compression method of a column
+ALTER TABLE cmmove_zstd ALTER COLUMN f1 SET COMPRESSION zstd;
+\d+ cmmove_zstd
+INSERT INTO cmmove_zstd VALUES(repeat('0987654321', 1004));
+SELECT pg_column_compression(f1) FROM cmmove_zstd;
+
+DROP TABLE cmdata_zstd, cmdata_zstd2, cmmove_zstd;
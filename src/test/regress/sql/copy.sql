@@ -320,3 +320,68 @@ COPY parted_si(id, data) FROM :'filename';
 SELECT tableoid::regclass, id % 2 = 0 is_even, count(*) from parted_si GROUP BY 1, 2 ORDER BY 1;
 
 DROP TABLE parted_si;
+
+-- Test parsing of long lines, where runs of ordinary bytes are scanned
+-- several at a time
+CREATE TEMP TABLE copy_long (id int, a text, b text);
+COPY copy_long FROM stdin;
+1	abcdefghijklmnopqrstuvwxyz0123456789	ABCDEFGHIJKLMNOPQRSTUVWXYZ\\ABCDEFGHIJKLMNOPQRSTUVWXYZ\tend
+2	xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\nyyyyyyyyyyyyyyyyyyyy	\N
+\.
+COPY copy_long FROM stdin (format csv);
+3,"quoted field longer than sixteen bytes, with ""embedded"" quotes",plain field longer than sixteen bytes
+4,"multi-line quoted field longer than sixteen bytes
+second line of it",
+\.
+SELECT id,
+       a = CASE id
+         WHEN 1 THEN 'abcdefghijklmnopqrstuvwxyz0123456789'
+         WHEN 2 THEN E'xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\nyyyyyyyyyyyyyyyyyyyy'
+         WHEN 3 THEN 'quoted field longer than sixteen bytes, with "embedded" quotes'
+         WHEN 4 THEN E'multi-line quoted field longer than sixteen bytes\nsecond line of it'
+       END AS a_ok,
+       b IS NOT DISTINCT FROM CASE id
+         WHEN 1 THEN E'ABCDEFGHIJKLMNOPQRSTUVWXYZ\\ABCDEFGHIJKLMNOPQRSTUVWXYZ\tend'
+         WHEN 3 THEN 'plain field longer than sixteen bytes'
+       END AS b_ok
+  FROM copy_long ORDER BY id;
+DROP TABLE copy_long;
+
+-- Test parsing the input in parallel workers
+CREATE TABLE copy_parallel (id int, t text, d int DEFAULT 42);
+COPY copy_parallel (id, t) FROM stdin (PARALLEL 2, FORMAT csv, HEADER);
+id,t
+1,one
+2,"two
+lines"
+3,three
+\.
+SELECT id, replace(t, E'\n', '|') AS t, d FROM copy_parallel ORDER BY id;
+COPY copy_parallel (id, t) FROM stdin (PARALLEL 2, ON_ERROR ignore);
+4	four
+bad	five
+\.
+SELECT count(*) FROM copy_parallel;
+COPY copy_parallel TO stdout (PARALLEL 2);
+COPY copy_parallel FROM stdin (PARALLEL 2, FORMAT binary);
+DROP TABLE copy_parallel;
+
+-- Test binary input of the types that are decoded without calling their
+-- receive function
+CREATE TEMP TABLE copy_binfast (b bool, s int2, i int4, o oid, l int8,
+  r float4, f float8, d date, ts timestamp, tstz timestamptz, u uuid);
+INSERT INTO copy_binfast VALUES
+  (true, -2, 2147483647, 4294967295, -9223372036854775808, 1.5, 'NaN',
+   '2024-02-29', 'infinity', '2024-05-01 12:34:56.789+02',
+   'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'),
+  (NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+\set filename :abs_builddir '/results/copy_binfast.data'
+COPY copy_binfast TO :'filename' (FORMAT binary);
+CREATE TEMP TABLE copy_binfast2 (LIKE copy_binfast);
+COPY copy_binfast2 FROM :'filename' (FORMAT binary);
+SELECT count(*) FROM
+  (SELECT * FROM copy_binfast2 EXCEPT ALL SELECT * FROM copy_binfast) x;
+-- a field of the wrong size is still rejected
+COPY (SELECT 1::int8 AS i) TO :'filename' (FORMAT binary);
+COPY copy_binfast2 (i) FROM :'filename' (FORMAT binary);
+DROP TABLE copy_binfast, copy_binfast2;
@@ -2069,3 +2069,37 @@ UPDATE fkpart11.pk SET a = 3 WHERE a = 4;
 UPDATE fkpart11.pk SET a = 1 WHERE a = 2;
 
 DROP SCHEMA fkpart11 CASCADE;
+
+-- foreign key checks against PK tables of kinds that the index probe skips
+-- must still give the same results
+CREATE TABLE fkfast_ppk (a int PRIMARY KEY) PARTITION BY RANGE (a);
+CREATE TABLE fkfast_ppk1 PARTITION OF fkfast_ppk FOR VALUES FROM (0) TO (10);
+CREATE TABLE fkfast_ppk2 PARTITION OF fkfast_ppk FOR VALUES FROM (10) TO (20);
+INSERT INTO fkfast_ppk VALUES (1), (11);
+CREATE TABLE fkfast_pfk (a int REFERENCES fkfast_ppk);
+INSERT INTO fkfast_pfk VALUES (1), (11);
+INSERT INTO fkfast_pfk VALUES (2);
+CREATE TABLE fkfast_pk (a int PRIMARY KEY);
+INSERT INTO fkfast_pk VALUES (1);
+CREATE TABLE fkfast_bfk (a bigint REFERENCES fkfast_pk);
+INSERT INTO fkfast_bfk VALUES (1);
+INSERT INTO fkfast_bfk VALUES (2);
+-- deferred checks see PK rows inserted or deleted later in the transaction
+CREATE TABLE fkfast_dfk (a int REFERENCES fkfast_pk DEFERRABLE INITIALLY DEFERRED);
+BEGIN;
+INSERT INTO fkfast_dfk VALUES (2);
+INSERT INTO fkfast_pk VALUES (2);
+COMMIT;
+BEGIN;
+INSERT INTO fkfast_dfk VALUES (3);
+INSERT INTO fkfast_pk VALUES (3);
+DELETE FROM fkfast_pk WHERE a = 3;
+COMMIT;
+BEGIN;
+INSERT INTO fkfast_pk VALUES (4);
+INSERT INTO fkfast_dfk VALUES (4);
+UPDATE fkfast_pk SET a = 5 WHERE a = 4;
+COMMIT;
+SELECT * FROM fkfast_dfk;
+SELECT * FROM fkfast_pk;
+DROP TABLE fkfast_pfk, fkfast_ppk, fkfast_bfk, fkfast_dfk, fkfast_pk;
@@ -157,6 +157,20 @@ $$
 $$);
 rollback to settings;
 
+-- non-parallel, with compressed batch files
+savepoint settings;
+set local max_parallel_workers_per_gather = 0;
+set local work_mem = '128kB';
+set local hash_mem_multiplier = 1.0;
+set local temp_file_compression = pglz;
+select count(*), sum(r.id) from simple r join simple s using (id);
+select original > 1 as initially_multibatch, final > original as increased_batches
+  from hash_join_batches(
+$$
+  select count(*) from simple r join simple s using (id);
+$$);
+rollback to settings;
+
 -- parallel with parallel-oblivious hash join
 savepoint settings;
 set local max_parallel_workers_per_gather = 2;
@@ -507,6 +521,54 @@ $$);
 rollback to settings;
 
 
+-- A hash table bigger than HJ_RADIX_MIN_TABLE_SIZE (16MB) is probed in radix
+-- partitions, reading the outer side in work_mem-sized chunks.  The inner
+-- side's estimated size makes for 2M buckets, which take up 16MB, and the
+-- outer side takes a few chunks.
+savepoint settings;
+set local max_parallel_workers_per_gather = 0;
+set local enable_mergejoin = off;
+set local enable_nestloop = off;
+set local work_mem = '2MB';
+set local hash_mem_multiplier = 200;
+create table radix_probe (id int);
+alter table radix_probe set (autovacuum_enabled = 'false');
+insert into radix_probe
+  select case when g % 1000 = 0 then null else g % 50000 end
+  from generate_series(1, 100000) g;
+analyze radix_probe;
+update pg_class set reltuples = 2e6 where relname = 'radix_probe';
+create function hash_join_buckets(query text)
+returns table (buckets int, batches int) language plpgsql
+as
+$$
+declare
+  whole_plan json;
+  hash_node json;
+begin
+  for whole_plan in
+    execute 'explain (analyze, format ''json'') ' || query
+  loop
+    hash_node := find_hash(json_extract_path(whole_plan, '0', 'Plan'));
+    buckets := hash_node->>'Hash Buckets';
+    batches := hash_node->>'Hash Batches';
+    return next;
+  end loop;
+end;
+$$;
+select buckets, batches from hash_join_buckets(
+$$
+  select count(*) from radix_probe r join radix_probe s using (id);
+$$);
+select count(*), sum(r.id::int8 + s.id)
+  from radix_probe r join radix_probe s using (id);
+-- outer tuples with NULL keys must still be returned
+select count(*), count(s.id)
+  from radix_probe r left join radix_probe s using (id);
+select count(*) from radix_probe r
+  where not exists (select 1 from radix_probe s where s.id = r.id + 1);
+rollback to settings;
+
 -- Hash join reuses the HOT status bit to indicate match status. This can only
 -- be guaranteed to produce correct results if all the hash join tuple match
 -- bits are reset before reuse. This is done upon loading them into the
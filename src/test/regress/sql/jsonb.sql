@@ -481,6 +481,21 @@ SELECT jsonb_extract_path_text('{"f2":{"f3":1},"f4":{"f5":null,"f6":"stringy"}}'
 SELECT jsonb_extract_path('{"f2":{"f3":1},"f4":[0,1,2,null]}','f4','3') IS NULL AS expect_false;
 SELECT jsonb_extract_path_text('{"f2":{"f3":1},"f4":[0,1,2,null]}','f4','3') IS NULL AS expect_true;
 
+-- object_fields_text
+SELECT jsonb_object_fields_text('{"a":1,"b":"two","c":null,"d":true,"e":[1,2],"f":{"g":3}}',
+                                'a', 'b', 'c', 'd', 'e', 'f');
+SELECT jsonb_object_fields_text('{"a":1,"b":2}', 'b', 'x', 'a', NULL);
+SELECT jsonb_object_fields_text('{"a":1,"bb":2}', 'bb', 'a', 'bb', 'a', 'x', 'x');
+SELECT jsonb_object_fields_text('{"":0,"a":1}', '', NULL);
+SELECT jsonb_object_fields_text('{}', 'a');
+SELECT jsonb_object_fields_text('{"a":1}', VARIADIC '{}'::text[]);
+SELECT jsonb_object_fields_text(jsonb_object_agg('k' || i, i), 'k7', 'k33', 'k40', 'k41')
+  FROM generate_series(1, 40) i;
+SELECT jsonb_object_fields_text('[{"a":1}]', 'a') IS NULL AS expect_true;
+SELECT jsonb_object_fields_text('"a"', 'a') IS NULL AS expect_true;
+SELECT jsonb_object_fields_text(NULL, 'a') IS NULL AS expect_true;
+SELECT jsonb_object_fields_text('{"a":1}', VARIADIC NULL::text[]) IS NULL AS expect_true;
+
 -- extract_path operators
 SELECT '{"f2":{"f3":1},"f4":{"f5":99,"f6":"stringy"}}'::jsonb#>array['f4','f6'];
 SELECT '{"f2":{"f3":1},"f4":{"f5":99,"f6":"stringy"}}'::jsonb#>array['f2'];
@@ -314,3 +314,74 @@ EXPLAIN (ANALYZE, COSTS OFF, SUMMARY OFF, TIMING OFF)
   CREATE MATERIALIZED VIEW IF NOT EXISTS matview_ine_tab AS
     SELECT 1 / 0 WITH NO DATA; -- ok
 DROP MATERIALIZED VIEW matview_ine_tab;
+
+-- incremental maintenance
+CREATE TABLE mvtest_ivm_t (k int, v int);
+INSERT INTO mvtest_ivm_t VALUES (1, 10), (1, 20), (2, 5), (NULL, 1);
+CREATE TABLE mvtest_ivm_u (k int PRIMARY KEY, name text);
+INSERT INTO mvtest_ivm_u VALUES (1, 'one'), (2, 'two');
+CREATE MATERIALIZED VIEW mvtest_ivm_agg WITH (incremental_maintenance) AS
+  SELECT k, count(*) AS n, sum(v) AS s, avg(v) AS a
+    FROM mvtest_ivm_t GROUP BY k;
+CREATE MATERIALIZED VIEW mvtest_ivm_rows WITH (incremental_maintenance) AS
+  SELECT k, v FROM mvtest_ivm_t WHERE v > 1;
+CREATE MATERIALIZED VIEW mvtest_ivm_join WITH (incremental_maintenance) AS
+  SELECT u.name, count(*) AS n, sum(t.v) AS s
+    FROM mvtest_ivm_t t JOIN mvtest_ivm_u u ON t.k = u.k GROUP BY u.name;
+CREATE MATERIALIZED VIEW mvtest_ivm_total WITH (incremental_maintenance) AS
+  SELECT count(*) AS n, sum(v) AS s FROM mvtest_ivm_t;
+-- hidden columns
+SELECT attname FROM pg_attribute
+  WHERE attrelid = 'mvtest_ivm_agg'::regclass AND attnum > 0 ORDER BY attnum;
+INSERT INTO mvtest_ivm_t VALUES (2, 7), (3, NULL), (NULL, 2);
+UPDATE mvtest_ivm_t SET v = v + 1 WHERE k = 1;
+DELETE FROM mvtest_ivm_t WHERE k = 2 AND v = 5;
+SELECT k, n, s, a FROM mvtest_ivm_agg ORDER BY k;
+SELECT * FROM mvtest_ivm_rows ORDER BY k, v;
+SELECT n, s FROM mvtest_ivm_total;
+INSERT INTO mvtest_ivm_u VALUES (3, 'three');
+UPDATE mvtest_ivm_u SET name = 'uno' WHERE k = 1;
+SELECT name, n, s FROM mvtest_ivm_join ORDER BY name;
+TRUNCATE mvtest_ivm_u;
+SELECT count(*) FROM mvtest_ivm_join;
+INSERT INTO mvtest_ivm_u VALUES (2, 'two');
+SELECT name, n, s FROM mvtest_ivm_join ORDER BY name;
+DELETE FROM mvtest_ivm_t;
+SELECT count(*) FROM mvtest_ivm_agg;
+SELECT count(*) FROM mvtest_ivm_rows;
+SELECT n, s FROM mvtest_ivm_total;
+-- unsupported queries and changes
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT DISTINCT k FROM mvtest_ivm_t;
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k, max(v) FROM mvtest_ivm_t GROUP BY k;
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT t.k FROM mvtest_ivm_t t LEFT JOIN mvtest_ivm_u u ON t.k = u.k;
+ALTER MATERIALIZED VIEW mvtest_ivm_rows SET (incremental_maintenance = false);
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k, sum(v::real) FROM mvtest_ivm_t GROUP BY k;
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k, sum(v::float8) FROM mvtest_ivm_t GROUP BY k;
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k, avg(v::float8) FROM mvtest_ivm_t GROUP BY k;
+-- inheritance, at creation and later
+CREATE TABLE mvtest_ivm_p (k int, name text);
+CREATE TABLE mvtest_ivm_c () INHERITS (mvtest_ivm_p);
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k FROM mvtest_ivm_p;
+CREATE MATERIALIZED VIEW mvtest_ivm_err WITH (incremental_maintenance) AS
+  SELECT k FROM mvtest_ivm_c;
+CREATE TABLE mvtest_ivm_err () INHERITS (mvtest_ivm_u);
+ALTER TABLE mvtest_ivm_u INHERIT mvtest_ivm_p;
+CREATE TABLE mvtest_ivm_pt (k int, name text) PARTITION BY LIST (k);
+ALTER TABLE mvtest_ivm_pt ATTACH PARTITION mvtest_ivm_u FOR VALUES IN (1, 2, 3, 4);
+DROP TABLE mvtest_ivm_p, mvtest_ivm_c, mvtest_ivm_pt;
+-- a statement modifying two base tables makes the view be recomputed
+WITH ins AS (INSERT INTO mvtest_ivm_u VALUES (4, 'four') RETURNING k)
+  INSERT INTO mvtest_ivm_t SELECT k, 40 FROM ins;
+SELECT name, n, s FROM mvtest_ivm_join ORDER BY name;
+UPDATE mvtest_ivm_t SET v = 41 WHERE k = 4;
+SELECT name, n, s FROM mvtest_ivm_join ORDER BY name;
+DROP MATERIALIZED VIEW mvtest_ivm_agg, mvtest_ivm_rows, mvtest_ivm_join,
+  mvtest_ivm_total;
+DROP TABLE mvtest_ivm_t, mvtest_ivm_u;
@@ -222,4 +222,123 @@ explain (costs off) execute test_mode_pp(2);
 select name, generic_plans, custom_plans from pg_prepared_statements
   where  name = 'test_mode_pp';
 
+-- a statement prepared again starts from its predecessor's custom plans,
+-- and goes on to the generic plan right away
+deallocate test_mode_pp;
+prepare test_mode_pp (int) as select count(*) from test_mode where a = $1;
+select name, generic_plans, custom_plans from pg_prepared_statements
+  where  name = 'test_mode_pp';
+set plan_cache_mode to auto;
+explain (costs off) execute test_mode_pp(2);
+select name, generic_plans, custom_plans from pg_prepared_statements
+  where  name = 'test_mode_pp';
+
+-- but only if the query string is the same
+prepare test_mode_pp2 (int) as select count(*) from test_mode where a = $1;
+explain (costs off) execute test_mode_pp2(2);
+select name, generic_plans, custom_plans from pg_prepared_statements
+  where  name = 'test_mode_pp2';
+deallocate test_mode_pp2;
+
 drop table test_mode;
+
+-- A generic plan that is seen to produce far more rows than estimated is
+-- not used again
+create table test_underest (a int, b int) with (autovacuum_enabled = off);
+insert into test_underest select 0, g from generate_series(1, 10000) g;
+insert into test_underest select g, g from generate_series(1, 10000) g;
+create index on test_underest (a);
+analyze test_underest;
+
+prepare test_underest_pp (int) as
+  update test_underest set b = b + 1 where a = $1;
+set plan_cache_mode to auto;
+execute test_underest_pp(1); -- 1x
+execute test_underest_pp(2); -- 2x
+execute test_underest_pp(3); -- 3x
+execute test_underest_pp(4); -- 4x
+execute test_underest_pp(5); -- 5x
+
+-- the generic plan expects two rows, whatever the parameter
+explain (costs off) execute test_underest_pp(1);
+select name, generic_plans, custom_plans from pg_prepared_statements
+  where  name = 'test_underest_pp';
+
+-- a = 0 matches half of the table, and we go back to custom plans
+execute test_underest_pp(0);
+explain (costs off) execute test_underest_pp(1);
+select name, generic_plans, custom_plans from pg_prepared_statements
+  where  name = 'test_underest_pp';
+
+drop table test_underest;
+deallocate test_underest_pp;
+
+-- Qual and projection states of generic plans are kept across executions;
+-- check that they see new parameter values, survive errors and recursion,
+-- and recheck permissions
+set plan_cache_mode to force_generic_plan;
+create table test_ecache (a int);
+insert into test_ecache select generate_series(1, 10);
+
+prepare test_ecache_q1 (int, int) as
+  select a, a * $2 as b from test_ecache where a > $1 and a <= $1 + 3
+  order by a;
+execute test_ecache_q1(0, 1);
+execute test_ecache_q1(5, 10);
+execute test_ecache_q1(8, -1);
+select generic_plans, custom_plans from pg_prepared_statements
+  where name = 'test_ecache_q1';
+
+-- an error leaves the states of the failed execution unusable for a while
+prepare test_ecache_q2 (int) as
+  select count(*) from test_ecache where a / $1 > 1;
+execute test_ecache_q2(0);
+execute test_ecache_q2(2);
+begin;
+savepoint s;
+execute test_ecache_q2(0);
+rollback to savepoint s;
+execute test_ecache_q2(3);
+commit;
+execute test_ecache_q2(1);
+
+-- the same plan run again while its first execution is still going on
+create function test_ecache_rec(n int) returns int language plpgsql as $$
+declare
+  r int;
+begin
+  if n = 0 then
+    return 0;
+  end if;
+  select count(*) + test_ecache_rec(n - 1) into r
+    from test_ecache where a % 2 = 0;
+  return r;
+end
+$$;
+select test_ecache_rec(3);
+select test_ecache_rec(3);
+
+-- execute permission is checked again at each execution
+create function test_ecache_eq(int, int) returns bool
+  language internal immutable strict as 'int4eq';
+create role regress_ecache_user;
+grant select on test_ecache to regress_ecache_user;
+set role regress_ecache_user;
+prepare test_ecache_q3 (int) as
+  select count(*) from test_ecache where test_ecache_eq(a, $1);
+execute test_ecache_q3(4);
+execute test_ecache_q3(5);
+reset role;
+revoke execute on function test_ecache_eq(int, int) from public;
+set role regress_ecache_user;
+execute test_ecache_q3(4);
+reset role;
+
+deallocate test_ecache_q1;
+deallocate test_ecache_q2;
+deallocate test_ecache_q3;
+drop function test_ecache_rec(int);
+drop function test_ecache_eq(int, int);
+drop table test_ecache;
+drop role regress_ecache_user;
+reset plan_cache_mode;
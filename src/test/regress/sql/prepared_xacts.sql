@@ -158,7 +158,39 @@ SELECT * FROM pxtest3;
 -- There should be no prepared transactions
 SELECT gid FROM pg_prepared_xacts WHERE gid ~ '^regress_' ORDER BY gid;
 
+-- Test reusing a gid once its transaction is finished, while another
+-- prepared transaction exists
+CREATE TABLE pxtest5 (a int);
+BEGIN;
+INSERT INTO pxtest5 VALUES (1);
+PREPARE TRANSACTION 'regress_reuse';
+BEGIN;
+INSERT INTO pxtest5 VALUES (2);
+PREPARE TRANSACTION 'regress_other';
+COMMIT PREPARED 'regress_reuse';
+BEGIN;
+INSERT INTO pxtest5 VALUES (3);
+PREPARE TRANSACTION 'regress_reuse';
+SELECT gid FROM pg_prepared_xacts WHERE gid ~ '^regress_' ORDER BY gid;
+ROLLBACK PREPARED 'regress_reuse';
+COMMIT PREPARED 'regress_other';
+SELECT * FROM pxtest5 ORDER BY a;
+
+-- Test state data too large to be kept in shared memory, which has to be
+-- read back to finish the transaction
+BEGIN;
+INSERT INTO pxtest5 VALUES (4);
+DO $$ BEGIN PERFORM pg_advisory_xact_lock(g) FROM generate_series(1001, 1200) g; END $$;
+PREPARE TRANSACTION 'regress_big';
+SELECT count(*) FROM pg_locks
+  WHERE locktype = 'advisory' AND pid IS NULL AND objid BETWEEN 1001 AND 1200;
+COMMIT PREPARED 'regress_big';
+SELECT count(*) FROM pg_locks
+  WHERE locktype = 'advisory' AND objid BETWEEN 1001 AND 1200;
+SELECT * FROM pxtest5 ORDER BY a;
+
 -- Clean up
 DROP TABLE pxtest2;
 DROP TABLE pxtest3;  -- will still be there if prepared xacts are disabled
 DROP TABLE pxtest4;
+DROP TABLE pxtest5;
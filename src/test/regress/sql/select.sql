@@ -262,3 +262,55 @@ create table list_parted_tbl1 partition of list_parted_tbl
   for values in (1) partition by list(b);
 explain (costs off) select * from list_parted_tbl;
 drop table list_parted_tbl;
+
+-- Rows that the table AM filters out before the qual sees them must still
+-- be counted as removed by the filter
+create temp table seqscan_keys (a int, b text);
+insert into seqscan_keys select g, g::text from generate_series(1, 1000) g;
+explain (costs off, analyze on, timing off, summary off)
+select * from seqscan_keys where a < 100;
+explain (costs off, analyze on, timing off, summary off)
+select * from seqscan_keys where a = 500 and b = '500';
+select count(*) from seqscan_keys where a < 100;
+select * from seqscan_keys where a = 500 and b = '500';
+drop table seqscan_keys;
+
+-- Simple quals are evaluated over batches of tuples; check each kind of
+-- comparison against NULLs and NaNs, on scans that span several batches.
+-- The constants are of the column types, as cross-type comparisons are left
+-- to the expression interpreter.
+create temp table batchq (i int, s int2, b int8, f4 float4, f8 float8,
+  d date, ts timestamp, n int);
+insert into batchq
+  select g, g % 10, g * 1000,
+    case when g % 50 = 0 then 'NaN' else g / 4.0 end,
+    case when g % 7 = 0 then null when g % 50 = 0 then 'NaN' else g / 4.0 end,
+    date '2000-01-01' + g % 100,
+    timestamp '2000-01-01' + g * interval '1 hour',
+    case when g % 3 = 0 then null else g end
+  from generate_series(1, 1000) g;
+explain (costs off, analyze on, timing off, summary off)
+select * from batchq where i >= 10 and i < 900;
+select count(*) from batchq where i >= 10 and i < 900;
+select count(*) from batchq where 500 > i;
+select count(*) from batchq where s <> 3::int2;
+select count(*) from batchq where b between 100000::int8 and 200000::int8;
+select count(*) from batchq where f8 > 200;
+select count(*) from batchq where f4 = 'NaN';
+select count(*) from batchq where f4 < 10::float4;
+select count(*) from batchq where d < '2000-01-11';
+select count(*) from batchq where ts >= '2000-02-01';
+select count(*) from batchq where n is null;
+select count(*) from batchq where n is not null and i > 990;
+select count(*) from batchq where f8 is null and s = 0::int2;
+-- batches are started afresh on rescans, even in the middle of a batch
+select x, (select i + x from batchq where i > 100 offset 70 limit 1)
+  from generate_series(1, 3) x;
+-- the current tuple of a batch scan can be updated through a cursor
+begin;
+declare c cursor for select i from batchq where i > 100;
+fetch 2 from c;
+update batchq set n = -1 where current of c;
+commit;
+select i, n from batchq where n < 0;
+drop table batchq;
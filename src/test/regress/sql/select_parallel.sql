@@ -98,6 +98,21 @@ explain (costs off)
 	select  sum(sp_parallel_restricted(unique1)) from tenk1
 	group by(sp_parallel_restricted(unique1));
 
+-- test repartitioning parallel aggregation; the plan is cost-dependent, so
+-- check only the results
+set enable_parallel_repartition = on;
+select count(*), sum(c), min(c), max(c)
+  from (select four, ten, count(*) as c from tenk1 group by four, ten) s;
+reset enable_parallel_repartition;
+
+-- test coordinated parallel sort; check only that the results are complete
+-- and in order
+set enable_parallel_sort = on;
+select count(*), count(*) filter (where prev > unique1) as out_of_order
+  from (select unique1, lag(unique1) over () as prev
+          from (select unique1 from tenk1 order by unique1 offset 0) ss) s;
+reset enable_parallel_sort;
+
 -- test prepared statement
 prepare tenk1_count(integer) As select  count((unique1)) from tenk1 where hundred > $1;
 explain (costs off) execute tenk1_count(1);
@@ -847,6 +847,38 @@ SELECT COUNT(*) FROM brin_hot_3 WHERE a = 2;
 
 DROP TABLE brin_hot_3;
 
+-- Test that changes to columns that only partial indexes refer to don't
+-- block HOT, as long as neither version of the row is in the index.
+CREATE TABLE hot_partial (id int PRIMARY KEY, a int, b int)
+  WITH (autovacuum_enabled = off);
+CREATE INDEX hot_partial_b ON hot_partial (b) WHERE a > 100;
+INSERT INTO hot_partial VALUES (1, 1, 1), (2, 200, 2);
+
+-- HOT: the predicate is false for both versions
+UPDATE hot_partial SET b = b + 1 WHERE id = 1;
+UPDATE hot_partial SET a = a + 1 WHERE id = 1;
+-- not HOT: the old version is in the index
+UPDATE hot_partial SET b = b + 1 WHERE id = 2;
+-- not HOT: the new version is in the index
+UPDATE hot_partial SET a = 300 WHERE id = 1;
+SELECT pg_stat_force_next_flush();
+SELECT pg_stat_get_tuples_updated('hot_partial'::regclass) AS updated,
+  pg_stat_get_tuples_hot_updated('hot_partial'::regclass) AS hot_updated;
+
+-- a column that another index also refers to still blocks HOT
+CREATE INDEX hot_partial_b_all ON hot_partial (b);
+INSERT INTO hot_partial VALUES (3, 3, 3);
+UPDATE hot_partial SET b = b + 1 WHERE id = 3;
+UPDATE hot_partial SET a = a + 1 WHERE id = 3;
+SELECT pg_stat_force_next_flush();
+SELECT pg_stat_get_tuples_updated('hot_partial'::regclass) AS updated,
+  pg_stat_get_tuples_hot_updated('hot_partial'::regclass) AS hot_updated;
+
+-- the partial index has the rows that qualify, and only those
+SELECT * FROM hot_partial WHERE a > 100 ORDER BY id;
+
+DROP TABLE hot_partial;
+
 SET enable_seqscan = on;
 
 -- End of Stats Test
@@ -546,6 +546,24 @@ SELECT * FROM check_estimated_rows('SELECT COUNT(*) FROM ndistinct GROUP BY a, (
 DROP STATISTICS s11;
 DROP STATISTICS s12;
 
+-- equality joins on correlated columns, estimated as a whole with ndistinct
+-- statistics
+CREATE TABLE stxjoin1 (a int, b int) WITH (autovacuum_enabled = off);
+CREATE TABLE stxjoin2 (a int, b int) WITH (autovacuum_enabled = off);
+INSERT INTO stxjoin1 SELECT i % 100, i % 100 FROM generate_series(1, 10000) s(i);
+INSERT INTO stxjoin2 SELECT i % 100, i % 100 FROM generate_series(1, 1000) s(i);
+ANALYZE stxjoin1, stxjoin2;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM stxjoin1 j1 JOIN stxjoin2 j2 ON j1.a = j2.a AND j1.b = j2.b');
+
+CREATE STATISTICS stxjoin1_ab (ndistinct) ON a, b FROM stxjoin1;
+CREATE STATISTICS stxjoin2_ab (ndistinct) ON a, b FROM stxjoin2;
+ANALYZE stxjoin1, stxjoin2;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM stxjoin1 j1 JOIN stxjoin2 j2 ON j1.a = j2.a AND j1.b = j2.b');
+
+DROP TABLE stxjoin1, stxjoin2;
+
 -- functional dependencies tests
 CREATE TABLE functional_dependencies (
     filler1 TEXT,
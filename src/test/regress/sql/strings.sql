@@ -492,6 +492,36 @@ SELECT 'foo' LIKE '%__' as t, 'foo' LIKE '%___' as t, 'foo' LIKE '%____' as f;
 SELECT 'jack' LIKE '%____%' AS t;
 
 
+--
+-- test literal runs after %, which are searched for as a whole
+--
+
+SELECT 'hawkeye' LIKE '%wk_ye' AS t, 'hawkeye' LIKE '%wk__' AS f;
+SELECT 'abcabcabd' LIKE '%cab_' AS t, 'abcabcabd' LIKE '%abc_d' AS f;
+SELECT 'ab%cd' LIKE '%b\%c%' AS t, 'abxcd' LIKE '%b\%c%' AS f;
+SELECT 'a\b' LIKE '%a\\b' AS t, 'a\\b' LIKE '%a\\b' AS f;
+SELECT 'ab%cd' LIKE '%b#%c%' ESCAPE '#' AS t, 'abxcd' LIKE '%b#%c%' ESCAPE '#' AS f;
+SELECT 'hawkeye' LIKE '%eyes' AS f, 'hawk' LIKE '%hawkeye%' AS f, 'hawkeye' LIKE '%e%eye' AS f;
+SELECT 'hawkeye' LIKE '%k%eye' AS t;
+
+-- with multibyte characters, only tested with UTF8
+SELECT s, p FROM (VALUES
+  ('\x61c3b162'::bytea, '\x25c3b162'::bytea, true),      -- U&'a\00F1b' LIKE U&'%\00F1b'
+  ('\x61c3b162', '\x25c3b15f', true),                    -- U&'a\00F1b' LIKE U&'%\00F1_'
+  ('\xc3b1c3b1', '\x25c3b15f', true),                    -- U&'\00F1\00F1' LIKE U&'%\00F1_'
+  ('\xc3b1c3b1', '\x25c3b15f5f', false),                 -- U&'\00F1\00F1' LIKE U&'%\00F1__'
+  ('\xc3b1616e64c3ba', '\x2564c3ba', true),              -- U&'\00F1and\00FA' LIKE U&'%d\00FA'
+  ('\xc3b1616e64c3ba', '\x2564c3ba61', false),           -- U&'\00F1and\00FA' LIKE U&'%d\00FAa'
+  ('\xc3b1616e64c3ba', '\x256e5fc3ba', true),            -- U&'\00F1and\00FA' LIKE U&'%n_\00FA'
+  ('\xe697a5e69cace8aa9e', '\x25e69cac5f', true),        -- U&'\65E5\672C\8A9E' LIKE U&'%\672C_'
+  ('\xe697a5e69cace8aa9e', '\x25e69cac5f5f', false),     -- U&'\65E5\672C\8A9E' LIKE U&'%\672C__'
+  ('\xe697a5e69cace8aa9e', '\x25e69cac5ce8aa9e', true),  -- U&'\65E5\672C\8A9E' LIKE U&'%\672C\\\8A9E'
+  ('\xe697a5e69cace8aa9e', '\x25e8aa9ee69cac', false)    -- U&'\65E5\672C\8A9E' LIKE U&'%\8A9E\672C'
+) AS v(s, p, expected)
+WHERE getdatabaseencoding() = 'UTF8' AND
+  (convert_from(s, 'UTF8') LIKE convert_from(p, 'UTF8')) <> expected;
+
+
 --
 -- basic tests of LIKE with indexes
 --
@@ -572,6 +602,39 @@ SELECT pg_relation_size(reltoastrelid) = 0 AS is_empty
 
 DROP TABLE toasttest;
 
+--
+-- detoasting a value several times in a transaction, as when it is passed
+-- to several functions, gives the same result each time, and the new value
+-- once it's replaced
+--
+CREATE TABLE toastcache (id int, f1 text);
+ALTER TABLE toastcache ALTER COLUMN f1 SET STORAGE EXTERNAL;
+INSERT INTO toastcache VALUES
+  (1, repeat('abcdefghij', 5000)), (2, repeat('0123456789', 5000));
+
+BEGIN;
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+UPDATE toastcache SET f1 = repeat('klmnopqrst', 5000) WHERE id = 1;
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+SAVEPOINT s1;
+UPDATE toastcache SET f1 = f1 || 'x' WHERE id = 2;
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+ROLLBACK TO s1;
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+-- too big to be kept
+SET LOCAL work_mem = '64kB';
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+COMMIT;
+SELECT id, length(f1), left(f1, 10), right(f1, 10), f1 = f1 AS same
+  FROM toastcache ORDER BY id;
+
+DROP TABLE toastcache;
+
 --
 -- test substr with toasted bytea values
 --
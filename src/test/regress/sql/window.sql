@@ -1720,6 +1720,64 @@ WINDOW fwd AS (
 	ORDER BY vs.i ROWS BETWEEN CURRENT ROW AND UNBOUNDED FOLLOWING
 );
 
+-- min() and max() over frames whose head moves keep a deque of candidate
+-- values instead of restarting; NULLs are skipped, and a frame without
+-- any non-null value gives NULL
+SELECT i, v, min(v) OVER w, max(v) OVER w
+FROM (VALUES
+	(1, 3), (2, NULL), (3, 3), (4, 1), (5, NULL),
+	(6, NULL), (7, 2), (8, NULL), (9, NULL)
+) AS t(i, v)
+WINDOW w AS (ORDER BY i ROWS BETWEEN 1 PRECEDING AND 1 FOLLOWING)
+ORDER BY i;
+
+-- compare with the same aggregates made to restart by a volatile FILTER,
+-- with ties in the ORDER BY and among the values, by-reference values, a
+-- deque longer than its initial allocation, and frames using EXCLUDE,
+-- which always restart
+CREATE TEMP TABLE wdeque AS
+	SELECT g, g % 3 AS p, g / 6 AS o,
+		CASE WHEN g % 7 = 0 THEN NULL ELSE (g * 37) % 11 END AS v
+	FROM generate_series(0, 599) g;
+DO $$
+DECLARE
+	frame text;
+	mismatches bigint;
+BEGIN
+	FOREACH frame IN ARRAY ARRAY[
+		'ROWS BETWEEN 2 PRECEDING AND 1 FOLLOWING',
+		'ROWS BETWEEN 1 FOLLOWING AND 3 FOLLOWING',
+		'ROWS BETWEEN 100 PRECEDING AND CURRENT ROW',
+		'RANGE BETWEEN 1 PRECEDING AND CURRENT ROW',
+		'RANGE BETWEEN CURRENT ROW AND 2 FOLLOWING',
+		'GROUPS BETWEEN 1 PRECEDING AND 1 FOLLOWING',
+		'GROUPS BETWEEN 2 PRECEDING AND 1 PRECEDING',
+		'ROWS BETWEEN 2 PRECEDING AND 2 FOLLOWING EXCLUDE CURRENT ROW',
+		'RANGE BETWEEN 1 PRECEDING AND 1 FOLLOWING EXCLUDE TIES',
+		'GROUPS BETWEEN 1 PRECEDING AND 1 FOLLOWING EXCLUDE GROUP'
+	]
+	LOOP
+		EXECUTE 'SELECT count(*) FILTER (WHERE d) FROM (SELECT
+			(min(v) OVER w, max(v) OVER w, min(v::text) OVER w,
+			 max(v::text) OVER w, min(g) OVER w, max(g) OVER w,
+			 min(v) FILTER (WHERE g % 4 <> 1) OVER w)
+			IS DISTINCT FROM
+			(min(v) FILTER (WHERE random() >= 0) OVER w,
+			 max(v) FILTER (WHERE random() >= 0) OVER w,
+			 min(v::text) FILTER (WHERE random() >= 0) OVER w,
+			 max(v::text) FILTER (WHERE random() >= 0) OVER w,
+			 min(g) FILTER (WHERE random() >= 0) OVER w,
+			 max(g) FILTER (WHERE random() >= 0) OVER w,
+			 min(v) FILTER (WHERE g % 4 <> 1 AND random() >= 0) OVER w) AS d
+			FROM wdeque
+			WINDOW w AS (PARTITION BY p ORDER BY o ' || frame || ')) s'
+			INTO mismatches;
+		RAISE NOTICE '%: % mismatches', frame, mismatches;
+	END LOOP;
+END
+$$;
+DROP TABLE wdeque;
+
 --
 -- Test various built-in aggregates that have moving-aggregate support
 --
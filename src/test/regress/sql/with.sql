@@ -1656,3 +1656,42 @@ create temp table with_test (i int);
 with with_test as (select 42) insert into with_test select * from with_test;
 select * from with_test;
 drop table with_test;
+
+--
+-- Recursive UNION whose table of seen tuples outgrows hash_mem, already in
+-- the non-recursive term, or only in the recursive term, and when rescanned.
+-- The results must not change when it doesn't spill.
+--
+create temp view rspill_nonrec as
+with recursive t(n) as (
+    select g % 4000 from generate_series(1, 8000) g
+  union
+    select n + 4000 from t, (values (1), (2)) v(d) where n < 8000
+)
+select count(*), count(distinct n) as ndistinct, sum(n) from t;
+create temp view rspill_rec as
+with recursive t(n) as (
+    select 0
+  union
+    select (n * 3 + k) % 10007 from t, generate_series(0, 2) k
+)
+select count(*), count(distinct n) as ndistinct, sum(n) from t;
+create temp view rspill_rescan as
+select x, s.* from (values (0), (100)) v(x),
+  lateral (with recursive t(n) as (
+               select g % 4000 + x from generate_series(1, 8000) g
+             union
+               select n + 4000 from t, (values (1), (2)) v(d) where n < 8000
+           )
+           select count(*), sum(n) from t) s;
+set work_mem = '64kB';
+set hash_mem_multiplier = 1;
+select * from rspill_nonrec;
+select * from rspill_rec;
+select * from rspill_rescan order by x;
+reset work_mem;
+reset hash_mem_multiplier;
+select * from rspill_nonrec;
+select * from rspill_rec;
+select * from rspill_rescan order by x;
+drop view rspill_nonrec, rspill_rec, rspill_rescan;